@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Battery.h"
+
+// combines several batteries, each served by its own provider on its own
+// set of battery interface pins, into a single view: the SoC is weighted by
+// the configured capacities, the currents are summed, the voltage is the
+// mean of the packs' voltages, and the most restrictive discharge and charge
+// current limits apply. the DPL and the grid charger thus act on the system
+// totals. only the aggregate is published to MQTT.
+class AggregateBattery : public BatteryProvider {
+public:
+    bool init(bool verboseLogging) final;
+    void deinit() final;
+    void loop() final;
+    std::shared_ptr<BatteryStats> getStats() const final { return _stats; }
+    std::vector<CanMessageStats> getCanMessageStats() const final;
+
+private:
+    void merge();
+
+    struct Child {
+        std::unique_ptr<BatteryProvider> upProvider;
+        uint8_t Provider;
+        uint16_t CapacityAmpHours;
+        std::shared_ptr<BatteryStats const> spSnapshot;
+    };
+
+    bool _verboseLogging = false;
+    std::vector<Child> _children;
+    uint32_t _lastMerge = 0;
+
+    std::shared_ptr<AggregateBatteryStats> _stats =
+        std::make_shared<AggregateBatteryStats>();
+};
@@ -1,11 +1,17 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 #include <TaskSchedulerDeclarations.h>
 
 #include "BatteryStats.h"
+#include "BatteryResistanceEstimator.h"
+#include "PinMapping.h"
 
 class BatteryProvider {
 public:
@@ -14,6 +20,49 @@ public:
     virtual void deinit() = 0;
     virtual void loop() = 0;
     virtual std::shared_ptr<BatteryStats> getStats() const = 0;
+
+    // returns an immutable copy of the current stats. called by the battery
+    // task after loop() whenever the stats were updated. providers updating
+    // their stats from another task must override this to synchronize.
+    virtual std::shared_ptr<BatteryStats const> getSnapshot() { return getStats()->clone(); }
+
+    struct CanMessageStats {
+        uint32_t Id;
+        uint32_t Frames;
+        uint32_t Dropped;
+        float Rate; // frames per second
+    };
+
+    // voltage and current taken from the same measurement
+    struct ElectricalSample {
+        float Volts;
+        float Amps; // positive while charging
+        uint32_t Millis;
+    };
+
+    // the most recent sample of providers which receive voltage and current
+    // as a pair. called by the battery task right after loop(), such that
+    // the sample is forwarded as soon as it was received.
+    virtual std::optional<ElectricalSample> getElectricalSample() const { return std::nullopt; }
+
+    // per-identifier receive statistics of CAN bus based providers
+    virtual std::vector<CanMessageStats> getCanMessageStats() const { return {}; }
+
+    // selects the battery interface pins used by init(), such that several
+    // providers can run side by side. must be called before init().
+    void setPinSet(uint8_t pinSet) { _pinSet = pinSet; }
+
+protected:
+    BatteryPins_t getPins() const { return PinMapping.getBatteryPins(_pinSet); }
+
+    // the name used to allocate a serial port, unique per pin set
+    std::string getSerialPortOwner(char const* name) const {
+        std::string owner(name);
+        if (_pinSet > 0) { owner += " " + std::to_string(_pinSet + 1); }
+        return owner;
+    }
+
+    uint8_t _pinSet = 0;
 };
 
 class BatteryClass {
@@ -25,12 +74,48 @@ public:
 
     std::shared_ptr<BatteryStats const> getStats() const;
 
+    std::vector<BatteryProvider::CanMessageStats> getCanMessageStats() const;
+
+    // the most recent voltage and current sample of the provider, if it
+    // provides samples and the sample is not older than the given age.
+    std::optional<BatteryProvider::ElectricalSample> getElectricalSample(uint32_t maxAgeMs) const;
+
+    // the internal resistance of the battery as estimated from voltage and
+    // current samples, std::nullopt if there is no plausible estimate yet.
+    std::optional<float> getInternalResistance() const;
+
+    // creates the provider with the given (configured) number, or returns
+    // nullptr if the number is unknown.
+    static std::unique_ptr<BatteryProvider> createProvider(uint8_t provider);
+
 private:
+    void registerMetrics();
     void loop();
 
     Task _loopTask;
     mutable std::mutex _mutex;
     std::unique_ptr<BatteryProvider> _upProvider = nullptr;
+
+    // immutable snapshot of the provider's stats, replaced atomically by the
+    // battery task, such that readers do not need to take the mutex.
+    std::shared_ptr<BatteryStats const> _spStats = nullptr;
+    uint32_t _lastSnapshot = 0;
+    void publishSnapshot();
+
+    // voltage (mV, upper half) and current (mA, lower half) packed into one
+    // word, such that readers cannot see a voltage and a current from
+    // different samples. the timestamp is zero if there is no sample.
+    std::atomic<uint64_t> _electricalSample = 0;
+    std::atomic<uint32_t> _electricalSampleMillis = 0;
+    void forwardElectricalSample();
+
+    // fed with the provider's electrical samples or, for providers without
+    // those, with voltage and current readings updated at the same time.
+    BatteryResistanceEstimator _resistanceEstimator;
+    uint32_t _lastEstimatorSample = 0;
+    static constexpr uint32_t _maxEstimatorSampleSkewMs = 100;
+    std::atomic<float> _internalResistance = 0; // zero if unknown
+    void updateResistanceEstimate();
 };
 
 extern BatteryClass Battery;
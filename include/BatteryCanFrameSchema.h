@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// declarative description of the numeric content of battery CAN frames. a
+// field names the location of a value in the payload, how it is encoded and
+// scaled, and how it is applied to the stats. the fields of a frame and the
+// frames of a protocol are constant tables, such that decoding a frame is a
+// lookup and a loop over its fields, and supporting another battery using
+// these common encodings is a matter of adding tables. frames with strings
+// or with values derived from several fields still need code.
+namespace BatteryCanSchema {
+
+enum class Encoding : uint8_t {
+    U8,
+    U16, // little endian, like all multi-byte encodings
+    S16,
+    U32,
+    Bit
+};
+
+template<typename StatsT>
+struct Field {
+    using apply_t = void (*)(StatsT& stats, float value, uint32_t now);
+
+    char const* Name;
+    Encoding Kind;
+    uint8_t Offset; // of the first byte
+    uint8_t Bit; // only used with Encoding::Bit
+    float Scale;
+    float Bias; // added after scaling
+    apply_t Apply;
+
+    constexpr uint8_t getSize() const {
+        switch (Kind) {
+            case Encoding::U16:
+            case Encoding::S16:
+                return 2;
+            case Encoding::U32:
+                return 4;
+            default:
+                break;
+        }
+        return 1;
+    }
+
+    float decode(uint8_t const* data) const {
+        uint8_t const* p = data + Offset;
+        float raw = 0;
+        switch (Kind) {
+            case Encoding::U8:
+                raw = p[0];
+                break;
+            case Encoding::U16:
+                raw = static_cast<uint16_t>(p[0] | (p[1] << 8));
+                break;
+            case Encoding::S16:
+                raw = static_cast<int16_t>(p[0] | (p[1] << 8));
+                break;
+            case Encoding::U32:
+                raw = static_cast<uint32_t>(p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+                break;
+            case Encoding::Bit:
+                raw = (p[0] >> Bit) & 0x01;
+                break;
+        }
+        return raw * Scale + Bias;
+    }
+};
+
+template<typename StatsT>
+struct Frame {
+    uint32_t Id;
+    Field<StatsT> const* Fields;
+    size_t Count;
+};
+
+template<typename StatsT, size_t N>
+constexpr bool isSorted(Frame<StatsT> const (&frames)[N])
+{
+    for (size_t i = 1; i < N; ++i) {
+        if (frames[i - 1].Id >= frames[i].Id) { return false; }
+    }
+    return true;
+}
+
+// true if all fields of all frames fit into a classic CAN payload
+template<typename StatsT, size_t N>
+constexpr bool fitsPayload(Frame<StatsT> const (&frames)[N])
+{
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t f = 0; f < frames[i].Count; ++f) {
+            auto const& field = frames[i].Fields[f];
+            if (field.Offset + field.getSize() > 8) { return false; }
+            if (field.Kind == Encoding::Bit && field.Bit > 7) { return false; }
+        }
+    }
+    return true;
+}
+
+// true if the identifiers of all frames are contained in the given sorted
+// identifiers, i.e., if the frames are let pass by the acceptance filters.
+template<typename StatsT, size_t N, typename IdsT>
+constexpr bool isSubsetOf(Frame<StatsT> const (&frames)[N], IdsT const& ids)
+{
+    size_t j = 0;
+    for (size_t i = 0; i < N; ++i) {
+        while (j < ids.size() && ids[j] < frames[i].Id) { ++j; }
+        if (j == ids.size() || ids[j] != frames[i].Id) { return false; }
+    }
+    return true;
+}
+
+} // namespace BatteryCanSchema
@@ -2,8 +2,17 @@
 #pragma once
 
 #include "Battery.h"
+#include "CanBus.h"
+#include "BatteryCanFrameSchema.h"
+#include "MessageOutput.h"
 #include <driver/twai.h>
+#include <freertos/queue.h>
 #include <Arduino.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 class BatteryCanReceiver : public BatteryProvider {
 public:
@@ -11,9 +20,63 @@ public:
     void deinit() final;
     void loop() final;
 
+    std::vector<CanMessageStats> getCanMessageStats() const final;
+
     virtual void onMessage(twai_message_t rx_message) = 0;
 
 protected:
+    struct MessageIds {
+        uint32_t const* Ids;
+        size_t Count;
+    };
+
+    // the standard frame identifiers handled by onMessage(), which must be
+    // sorted in ascending order. these are used to program the acceptance
+    // filters and to discard other frames before they reach onMessage().
+    virtual MessageIds getMessageIds() const = 0;
+
+    template<size_t N>
+    static constexpr bool isSorted(std::array<uint32_t, N> const& ids) {
+        for (size_t i = 1; i < N; ++i) {
+            if (ids[i - 1] >= ids[i]) { return false; }
+        }
+        return true;
+    }
+
+    // decodes the frame using the given schema and applies its fields to
+    // the stats. returns false if the schema does not cover the frame.
+    template<typename StatsT, size_t N>
+    bool decodeFrame(BatteryCanSchema::Frame<StatsT> const (&frames)[N],
+            StatsT& stats, twai_message_t const& rx_message)
+    {
+        auto end = frames + N;
+        auto it = std::lower_bound(frames, end, rx_message.identifier,
+                [](BatteryCanSchema::Frame<StatsT> const& frame, uint32_t id) {
+                    return frame.Id < id;
+                });
+        if (it == end || it->Id != rx_message.identifier) { return false; }
+
+        uint32_t now = millis();
+        if (_verboseLogging) { MessageOutput.printf("[%s]", _providerName); }
+
+        for (size_t i = 0; i < it->Count; ++i) {
+            auto const& field = it->Fields[i];
+
+            // tolerate short frames, which would otherwise be read beyond
+            // their payload.
+            if (field.Offset + field.getSize() > rx_message.data_length_code) { continue; }
+
+            float value = field.decode(rx_message.data);
+            field.Apply(stats, value, now);
+
+            if (_verboseLogging) { MessageOutput.printf(" %s: %g", field.Name, value); }
+        }
+
+        if (_verboseLogging) { MessageOutput.println(); }
+
+        return true;
+    }
+
     uint8_t readUnsignedInt8(uint8_t *data);
     uint16_t readUnsignedInt16(uint8_t *data);
     int16_t readSignedInt16(uint8_t *data);
@@ -25,5 +88,24 @@ protected:
     bool _verboseLogging = true;
 
 private:
+    void onFrame(twai_message_t const& rx_message);
+    int findMessageIndex(twai_message_t const& rx_message) const;
+    std::vector<CanBusClass::Filter> getFilters() const;
+    void updateRates();
+
     char const* _providerName = "Battery CAN";
+
+    // frames are received by the CAN bus' receive task, which blocks on the
+    // TWAI driver, and handed to loop() through this queue.
+    int _subscription = -1;
+    QueueHandle_t _rxQueue = nullptr;
+
+    struct MessageCounters {
+        std::atomic<uint32_t> Frames = 0;
+        std::atomic<uint32_t> Dropped = 0; // rx queue was full
+        uint32_t FramesAtLastRateUpdate = 0;
+        float Rate = 0;
+    };
+    std::unique_ptr<MessageCounters[]> _upCounters;
+    uint32_t _lastRateUpdate = 0;
 };
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+// estimates the internal resistance of the battery from voltage and current
+// samples taken at the same time, fitting V = Voc + R * I (current positive
+// while charging) with recursive least squares and exponential forgetting,
+// such that the estimate follows changes due to temperature and SoC. the
+// resistance only shows while the current changes, so a sample is only used
+// (and old samples are only forgotten) if its current differs enough from
+// the sample used last. this keeps the estimate from drifting while the
+// current is constant.
+class BatteryResistanceEstimator {
+public:
+    BatteryResistanceEstimator() { reset(); }
+
+    void reset();
+    void addSample(float volts, float amps);
+
+    // std::nullopt until enough samples with differing currents were used
+    // and as long as the estimate is implausible.
+    std::optional<float> getResistance() const;
+
+    uint32_t getUpdateCount() const { return _updates; }
+
+private:
+    static constexpr double _forgettingFactor = 0.99;
+    static constexpr float _minCurrentStep = 1.0; // A
+    static constexpr uint32_t _minUpdates = 10;
+    static constexpr float _maxResistance = 1.0; // Ohm
+
+    bool _initialized;
+    uint32_t _updates;
+    float _lastAmps;
+
+    // parameters (Voc, R) and their covariance
+    double _voc;
+    double _resistance;
+    double _p00, _p01, _p11;
+};
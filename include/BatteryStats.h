@@ -9,6 +9,7 @@
 #include "JbdBmsDataPoints.h"
 #include "VeDirectShuntController.h"
 #include <cfloat>
+#include <memory>
 
 // mandatory interface for all kinds of batteries
 class BatteryStats {
@@ -44,6 +45,8 @@ class BatteryStats {
         bool isSoCValid() const { return _lastUpdateSoC > 0; }
         bool isVoltageValid() const { return _lastUpdateVoltage > 0; }
         bool isCurrentValid() const { return _lastUpdateCurrent > 0; }
+        uint32_t getLastUpdateVoltage() const { return _lastUpdateVoltage; }
+        uint32_t getLastUpdateCurrent() const { return _lastUpdateCurrent; }
         bool isDischargeCurrentLimitValid() const { return _lastUpdateDischargeCurrentLimit > 0; }
 
         // returns true if the battery reached a critically low voltage/SoC,
@@ -54,9 +57,38 @@ class BatteryStats {
 
         virtual bool supportsAlarmsAndWarnings() const { return true; };
 
+        // returns an immutable copy of these stats, which is handed to
+        // readers on other tasks while the provider keeps updating the
+        // original. must be overridden by every derived class.
+        virtual std::shared_ptr<BatteryStats const> clone() const {
+            return std::make_shared<BatteryStats>(*this);
+        }
+
     protected:
         virtual void mqttPublish() const;
 
+        // used by mqttPublish() to publish battery/<subtopic>, or to add the
+        // value to the bundled message. the value is only published if it
+        // changed by more than the deadband since it was last published, or
+        // if it was not published for getMqttFullPublishIntervalMs(). group
+        // and subtopic must point to static storage.
+        template<typename T>
+        static void publishValue(char const* subtopic, T const& value, float deadband = 0) {
+            publishGroupValue(nullptr, subtopic, value, deadband);
+        }
+
+        template<typename T>
+        static void publishGroupValue(char const* group, char const* subtopic, T const& value, float deadband = 0) {
+            if (!mqttValueChanged(group, subtopic, static_cast<float>(value), deadband)) { return; }
+            mqttPublishPayload(group, subtopic, String(value));
+        }
+
+        static void publishValue(char const* subtopic, String const& value) {
+            publishGroupValue(nullptr, subtopic, value);
+        }
+
+        static void publishGroupValue(char const* group, char const* subtopic, String const& value);
+
         void setSoC(float soc, uint8_t precision, uint32_t timestamp) {
             _soc = soc;
             _socPrecision = precision;
@@ -87,6 +119,9 @@ class BatteryStats {
         uint32_t _lastUpdate = 0;
 
     private:
+        static bool mqttValueChanged(char const* group, char const* subtopic, float value, float deadband);
+        static void mqttPublishPayload(char const* group, char const* subtopic, String const& payload);
+
         String _manufacturer = "unknown";
         uint32_t _lastMqttPublish = 0;
         float _soc = 0;
@@ -109,6 +144,10 @@ class PylontechBatteryStats : public BatteryStats {
     friend class PylontechCanReceiver;
 
     public:
+        std::shared_ptr<BatteryStats const> clone() const final {
+            return std::make_shared<PylontechBatteryStats>(*this);
+        }
+
         void getLiveViewData(JsonVariant& root) const final;
         void mqttPublish() const final;
         bool getImmediateChargingRequest() const { return _chargeImmediately; } ;
@@ -150,6 +189,10 @@ class SBSBatteryStats : public BatteryStats {
     friend class SBSCanReceiver;
 
     public:
+        std::shared_ptr<BatteryStats const> clone() const final {
+            return std::make_shared<SBSBatteryStats>(*this);
+        }
+
         void getLiveViewData(JsonVariant& root) const final;
         void mqttPublish() const final;
         float getChargeCurrent() const { return _current; } ;
@@ -181,6 +224,10 @@ class PytesBatteryStats : public BatteryStats {
     friend class PytesCanReceiver;
 
     public:
+        std::shared_ptr<BatteryStats const> clone() const final {
+            return std::make_shared<PytesBatteryStats>(*this);
+        }
+
         void getLiveViewData(JsonVariant& root) const final;
         void mqttPublish() const final;
         bool getImmediateChargingRequest() const { return _chargeImmediately; };
@@ -257,6 +304,10 @@ class PytesBatteryStats : public BatteryStats {
 
 class JkBmsBatteryStats : public BatteryStats {
     public:
+        std::shared_ptr<BatteryStats const> clone() const final {
+            return std::make_shared<JkBmsBatteryStats>(*this);
+        }
+
         void getLiveViewData(JsonVariant& root) const final {
             getJsonData(root, false);
         }
@@ -277,6 +328,7 @@ class JkBmsBatteryStats : public BatteryStats {
         JkBms::DataPointContainer _dataPoints;
         mutable uint32_t _lastMqttPublish = 0;
         mutable uint32_t _lastFullMqttPublish = 0;
+        mutable tCellVoltages _publishedCellVoltages;
 
         uint16_t _cellMinMilliVolt = 0;
         uint16_t _cellAvgMilliVolt = 0;
@@ -286,6 +338,10 @@ class JkBmsBatteryStats : public BatteryStats {
 
 class JbdBmsBatteryStats : public BatteryStats {
     public:
+        std::shared_ptr<BatteryStats const> clone() const final {
+            return std::make_shared<JbdBmsBatteryStats>(*this);
+        }
+
         void getLiveViewData(JsonVariant& root) const final {
             getJsonData(root, false);
         }
@@ -306,6 +362,7 @@ class JbdBmsBatteryStats : public BatteryStats {
         JbdBms::DataPointContainer _dataPoints;
         mutable uint32_t _lastMqttPublish = 0;
         mutable uint32_t _lastFullMqttPublish = 0;
+        mutable tCellVoltages _publishedCellVoltages;
 
         uint16_t _cellMinMilliVolt = 0;
         uint16_t _cellAvgMilliVolt = 0;
@@ -315,6 +372,10 @@ class JbdBmsBatteryStats : public BatteryStats {
 
 class VictronSmartShuntStats : public BatteryStats {
     public:
+        std::shared_ptr<BatteryStats const> clone() const final {
+            return std::make_shared<VictronSmartShuntStats>(*this);
+        }
+
         void getLiveViewData(JsonVariant& root) const final;
         void mqttPublish() const final;
 
@@ -344,9 +405,33 @@ class MqttBatteryStats : public BatteryStats {
     friend class MqttBattery;
 
     public:
+        std::shared_ptr<BatteryStats const> clone() const final {
+            return std::make_shared<MqttBatteryStats>(*this);
+        }
+
         // since the source of information was MQTT in the first place,
         // we do NOT publish the same data under a different topic.
         void mqttPublish() const final { }
 
         bool supportsAlarmsAndWarnings() const final { return false; }
 };
+
+class AggregateBatteryStats : public BatteryStats {
+    friend class AggregateBattery;
+
+    public:
+        std::shared_ptr<BatteryStats const> clone() const final {
+            return std::make_shared<AggregateBatteryStats>(*this);
+        }
+
+        void getLiveViewData(JsonVariant& root) const final;
+
+        bool getImmediateChargingRequest() const final { return _chargeImmediately; }
+        float getChargeCurrentLimitation() const final { return _chargeCurrentLimitation; }
+        bool supportsAlarmsAndWarnings() const final { return false; }
+
+    private:
+        uint8_t _batteries = 0;
+        bool _chargeImmediately = false;
+        float _chargeCurrentLimitation = FLT_MAX;
+};
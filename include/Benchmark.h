@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+
+// build environments defining OPENDTU_BENCHMARK boot into this benchmark
+// runner instead of the regular setup. it measures the CPU cycles spent in
+// selected hot paths and prints one JSON object per line, such that results
+// of different chips and firmware versions can be compared.
+class BenchmarkClass {
+public:
+    void run();
+
+private:
+    template<typename F>
+    void measure(char const* name, uint32_t iterations, F&& op);
+
+    void benchmarkCrc();
+    void benchmarkDataPoints();
+    void benchmarkCellVoltages();
+    void benchmarkLiveJson();
+    void benchmarkPrometheus();
+    void benchmarkMqttPublish();
+    void benchmarkConfig();
+};
+
+extern BenchmarkClass Benchmark;
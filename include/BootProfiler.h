@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+// records the duration of the individual stages of the system startup,
+// including the stages which are deferred until the main loop is running.
+class BootProfilerClass {
+public:
+    // ends the current stage (if any) and starts a new one. the name must
+    // be a string literal, as only the pointer is stored.
+    void beginStage(char const* name, bool deferred = false);
+
+    // ends the current stage without starting a new one
+    void endStage();
+
+    // records a stage measured by another FreeRTOS task, without affecting
+    // the current stage. start is in microseconds since reset.
+    void addStage(char const* name, bool deferred, uint32_t start, uint32_t duration);
+
+    void serialize(JsonObject& target) const;
+
+private:
+    struct Stage {
+        char const* Name;
+        bool Deferred; // executed after setup() returned
+        uint32_t Start; // microseconds since reset
+        uint32_t Duration; // microseconds
+    };
+
+    static constexpr size_t _maxStages = 32;
+
+    mutable std::mutex _mutex;
+    std::array<Stage, _maxStages> _stages;
+    size_t _count = 0;
+    bool _running = false;
+};
+
+extern BootProfilerClass BootProfiler;
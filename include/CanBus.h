@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <driver/twai.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// owns the ESP32's TWAI controller, such that multiple consumers (battery
+// and grid charger) can share one CAN bus. consumers subscribe using a set
+// of filters and are handed all matching frames. the controller's acceptance
+// filters are programmed from the union of all subscriptions, if possible.
+class CanBusClass {
+public:
+    // a frame matches if its identifier equals Code in all bits which are not
+    // set in Mask, i.e., set bits in Mask are "don't care" bits.
+    struct Filter {
+        uint32_t Code;
+        uint32_t Mask;
+        bool Extended;
+    };
+
+    // called from the context of the receive task for every frame matching
+    // any of the subscription's filters. must not block.
+    using Callback = std::function<void(twai_message_t const&)>;
+
+    struct Subscription {
+        char const* Name;
+        int8_t PinRx;
+        int8_t PinTx;
+        uint16_t BitrateKbps;
+        std::vector<Filter> Filters;
+        Callback OnFrame;
+    };
+
+    // returns a handle to use with unsubscribe(), or -1 if the subscription
+    // could not be setup, e.g., because the bus is already in use with
+    // different pins or a different bitrate.
+    int subscribe(Subscription subscription);
+    void unsubscribe(int handle);
+
+    bool transmit(twai_message_t const& message, TickType_t timeout);
+
+private:
+    void unsubscribeLocked(int handle);
+    bool start();
+    void stop();
+    twai_filter_config_t getFilterConfig() const;
+
+    static void receiveLoopHelper(void* context);
+    void receiveLoop();
+
+    static bool matches(Filter const& filter, twai_message_t const& message);
+
+    // serializes (un)subscribing, which restarts the bus
+    std::mutex _configMutex;
+
+    // protects the subscriptions, which are iterated by the receive task
+    mutable std::mutex _mutex;
+    std::vector<std::pair<int, Subscription>> _subscriptions;
+    int _nextHandle = 0;
+
+    std::atomic<bool> _running = false;
+    TaskHandle_t _receiveTaskHandle = nullptr;
+    std::atomic<bool> _receiveTaskDone = false;
+    std::atomic<bool> _stopReceiving = false;
+};
+
+extern CanBusClass CanBus;
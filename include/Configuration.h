@@ -7,8 +7,11 @@
 #include <TaskSchedulerDeclarations.h>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 
 #define CONFIG_FILENAME "/config.json"
+#define CONFIG_SNAPSHOT_FILENAME "/config.bin"
+#define CONFIG_JOURNAL_FILENAME "/config.jnl"
 #define CONFIG_VERSION 0x00011d00 // 0.1.29 // make sure to clean all after change
 #define CONFIG_VERSION_ONBATTERY 5
 
@@ -17,6 +20,7 @@
 #define WIFI_MAX_HOSTNAME_STRLEN 31
 
 #define SYSLOG_MAX_HOSTNAME_STRLEN 128
+#define TELEMETRY_MAX_HOSTNAME_STRLEN 128
 
 #define NTP_MAX_SERVER_STRLEN 31
 #define NTP_MAX_TIMEZONE_STRLEN 50
@@ -32,7 +36,12 @@
 #define MQTT_MAX_JSON_PATH_STRLEN 256
 
 #define INV_MAX_NAME_STRLEN 31
+// the inverter configuration is part of the (fixed size) config structure,
+// so every slot costs memory even if unused. boards with PSRAM may support
+// more inverters by overriding this in the build flags.
+#ifndef INV_MAX_COUNT
 #define INV_MAX_COUNT 10
+#endif
 #define INV_MAX_CHAN_COUNT 6
 
 #define CHAN_MAX_NAME_STRLEN 31
@@ -46,8 +55,15 @@
 #define HTTP_REQUEST_MAX_HEADER_KEY_STRLEN 64
 #define HTTP_REQUEST_MAX_HEADER_VALUE_STRLEN 256
 
+#define POWERLIMITER_CLUSTER_KEY_STRLEN 64
+
 #define POWERMETER_MQTT_MAX_VALUES 3
 #define POWERMETER_HTTP_JSON_MAX_VALUES 3
+#define POWERMETER_FILTER_MAX_WINDOW 9
+#define POWERMETER_MAX_ADDITIONAL 2
+#define POWERMETER_SDM_MAX_SUBMETERS 3
+
+#define BATTERY_AGGREGATE_MAX_CHILDREN 3
 
 struct CHANNEL_CONFIG_T {
     uint16_t MaxChannelPower;
@@ -68,6 +84,7 @@ struct INVERTER_CONFIG_T {
     bool ZeroYieldDayOnMidnight;
     bool ClearEventlogOnMidnight;
     bool YieldDayCorrection;
+    uint8_t NrfRadio; // 1 based, 0 to assign automatically
     CHANNEL_CONFIG_T channel[INV_MAX_CHAN_COUNT];
 };
 
@@ -101,9 +118,20 @@ struct POWERMETER_MQTT_CONFIG_T {
 };
 using PowerMeterMqttConfig = struct POWERMETER_MQTT_CONFIG_T;
 
+// an SDM on the same RS485 bus as the grid meter, whose reading is added
+// to or subtracted from the reading of the grid meter.
+struct POWERMETER_SDM_SUBMETER_CONFIG_T {
+    uint8_t Address; // zero if not used
+    bool ThreePhases;
+    bool Subtract;
+    uint8_t PollDivider; // read in every n-th poll of the grid meter
+};
+using PowerMeterSdmSubMeterConfig = struct POWERMETER_SDM_SUBMETER_CONFIG_T;
+
 struct POWERMETER_SERIAL_SDM_CONFIG_T {
     uint32_t Address;
     uint32_t PollingInterval;
+    PowerMeterSdmSubMeterConfig SubMeters[POWERMETER_SDM_MAX_SUBMETERS];
 };
 using PowerMeterSerialSdmConfig = struct POWERMETER_SERIAL_SDM_CONFIG_T;
 
@@ -132,6 +160,33 @@ struct POWERMETER_HTTP_SML_CONFIG_T {
 };
 using PowerMeterHttpSmlConfig = struct POWERMETER_HTTP_SML_CONFIG_T;
 
+struct POWERMETER_UDP_CONFIG_T {
+    uint16_t Port;
+
+    // Text: key=value pairs (power, power1 to power3) or a single number.
+    // Float32: total power, optionally followed by L1 to L3 (little endian).
+    enum Format { Text = 0, Float32 = 1 };
+    Format PayloadFormat;
+};
+using PowerMeterUdpConfig = struct POWERMETER_UDP_CONFIG_T;
+
+struct POWERMETER_FILTER_CONFIG_T {
+    enum Mode { None = 0, Median = 1, Ema = 2 };
+    Mode FilterMode;
+    uint8_t Window; // number of samples, up to POWERMETER_FILTER_MAX_WINDOW
+    uint16_t StepThreshold; // watts, zero disables outlier rejection
+};
+using PowerMeterFilterConfig = struct POWERMETER_FILTER_CONFIG_T;
+
+// a power meter whose reading is combined with the reading of the primary
+// power meter (PowerMeterConfig::Source) into one virtual power meter.
+struct POWERMETER_ADDITIONAL_CONFIG_T {
+    enum Operation { Disabled = 0, Add = 1, Subtract = 2, Standby = 3 };
+    Operation Op;
+    uint32_t Source;
+};
+using PowerMeterAdditionalConfig = struct POWERMETER_ADDITIONAL_CONFIG_T;
+
 struct POWERLIMITER_INVERTER_CONFIG_T {
     uint64_t Serial;
     bool IsGoverned;
@@ -143,6 +198,8 @@ struct POWERLIMITER_INVERTER_CONFIG_T {
 
     enum InverterPowerSource { Battery = 0, Solar = 1, SmartBuffer = 2 };
     InverterPowerSource PowerSource;
+
+    uint8_t Phase; // 1 to 3 for L1 to L3, 0 if feeding all phases evenly
 };
 using PowerLimiterInverterConfig = struct POWERLIMITER_INVERTER_CONFIG_T;
 
@@ -154,6 +211,7 @@ struct POWERLIMITER_CONFIG_T {
     bool BatteryAlwaysUseAtNight;
     int16_t TargetPowerConsumption;
     uint16_t TargetPowerConsumptionHysteresis;
+    uint16_t ExportGuardThreshold; // W, zero if disabled
     uint16_t BaseLoadLimit;
     bool IgnoreSoc;
     uint16_t BatterySocStartThreshold;
@@ -161,6 +219,7 @@ struct POWERLIMITER_CONFIG_T {
     float VoltageStartThreshold;
     float VoltageStopThreshold;
     float VoltageLoadCorrectionFactor;
+    bool VoltageLoadCorrectionAutomatic;
     uint16_t FullSolarPassThroughSoc;
     float FullSolarPassThroughStartVoltage;
     float FullSolarPassThroughStopVoltage;
@@ -168,6 +227,20 @@ struct POWERLIMITER_CONFIG_T {
     uint8_t InverterChannelIdForDcVoltage;
     int8_t RestartHour;
     uint16_t TotalUpperPowerLimit;
+    bool PredictiveMode;
+    bool OptimizedDispatch;
+
+    // Total regulates the sum of all phases. PerPhase covers the import of
+    // each phase with the inverters on that phase only, for meters billing
+    // each phase. WorstPhase regulates the sum, but lowers the phase with
+    // the highest import first.
+    enum PhaseModes { Total = 0, PerPhase = 1, WorstPhase = 2 };
+    PhaseModes PhaseMode;
+    bool BatteryDischargePlan;
+    uint32_t BatteryCapacity; // Wh
+    uint8_t BatteryDischargePlanReserveSoc;
+    bool Cluster;
+    char ClusterKey[POWERLIMITER_CLUSTER_KEY_STRLEN + 1];
     PowerLimiterInverterConfig Inverters[INV_MAX_COUNT];
 };
 using PowerLimiterConfig = struct POWERLIMITER_CONFIG_T;
@@ -176,6 +249,15 @@ enum BatteryVoltageUnit { Volts = 0, DeciVolts = 1, CentiVolts = 2, MilliVolts =
 
 enum BatteryAmperageUnit { Amps = 0, MilliAmps = 1 };
 
+// one of the batteries combined by the aggregate provider. the child at
+// index i uses the battery interface pins of set i.
+struct BATTERY_AGGREGATE_CHILD_CONFIG_T {
+    bool Enabled;
+    uint8_t Provider;
+    uint16_t CapacityAmpHours; // weight of the child's SoC
+};
+using BatteryAggregateChildConfig = struct BATTERY_AGGREGATE_CHILD_CONFIG_T;
+
 struct BATTERY_CONFIG_T {
     bool Enabled;
     bool VerboseLogging;
@@ -195,6 +277,8 @@ struct BATTERY_CONFIG_T {
     char MqttDischargeCurrentTopic[MQTT_MAX_TOPIC_STRLEN + 1];
     char MqttDischargeCurrentJsonPath[MQTT_MAX_JSON_PATH_STRLEN + 1];
     BatteryAmperageUnit MqttAmperageUnit;
+    bool MqttBundled;
+    BatteryAggregateChildConfig AggregateChildren[BATTERY_AGGREGATE_MAX_CHILDREN];
 };
 using BatteryConfig = struct BATTERY_CONFIG_T;
 
@@ -222,6 +306,10 @@ enum SolarChargerProviderType { VEDIRECT = 0, MQTT = 1 };
 struct SOLARCHARGER_MQTT_CONFIG_T {
     bool CalculateOutputPower;
 
+    // if set, all values are taken from messages of this topic using the
+    // JSON paths below, instead of subscribing to a topic per value.
+    char CombinedTopic[MQTT_MAX_TOPIC_STRLEN + 1];
+
     enum WattageUnit { KiloWatts = 0, Watts = 1, MilliWatts = 2 };
     char PowerTopic[MQTT_MAX_TOPIC_STRLEN + 1];
     char PowerJsonPath[MQTT_MAX_JSON_PATH_STRLEN + 1];
@@ -266,6 +354,7 @@ struct CONFIG_T {
         bool Dhcp;
         char Hostname[WIFI_MAX_HOSTNAME_STRLEN + 1];
         uint32_t ApTimeout;
+        uint8_t LatencyMode; // see NetworkSettingsClass::LatencyMode
     } WiFi;
 
     struct {
@@ -278,6 +367,26 @@ struct CONFIG_T {
         uint16_t Port;
     } Syslog;
 
+    struct {
+        bool Enabled;
+        char Hostname[TELEMETRY_MAX_HOSTNAME_STRLEN + 1];
+        uint16_t Port;
+        uint32_t Interval; // milliseconds
+    } Telemetry;
+
+    struct {
+        bool Enabled;
+        HttpRequestConfig HttpRequest;
+        uint32_t Interval; // seconds between samples
+        uint32_t PushInterval; // seconds
+    } MetricsPush;
+
+    struct {
+        bool Enabled;
+        uint16_t Port;
+        bool AllowWrite;
+    } Modbus;
+
     struct {
         char Server[NTP_MAX_SERVER_STRLEN + 1];
         char Timezone[NTP_MAX_TIMEZONE_STRLEN + 1];
@@ -300,6 +409,18 @@ struct CONFIG_T {
         uint32_t PublishInterval;
         bool CleanSession;
 
+        // minimum change of an inverter value before it is published
+        // again, zero to publish every change.
+        struct {
+            float Power; // W, also reactive power
+            float Voltage; // V
+            float Current; // A
+            float Frequency; // Hz
+            float Temperature; // °C
+            float PowerFactor;
+            float Percent; // efficiency and irradiation
+        } Deadband;
+
         struct {
             char Topic[MQTT_MAX_TOPIC_STRLEN + 1];
             char Value_Online[MQTT_MAX_LWTVALUE_STRLEN + 1];
@@ -334,8 +455,10 @@ struct CONFIG_T {
             int8_t PaLevel;
             uint32_t Frequency;
             uint8_t CountryMode;
+            bool FrequencyAgility;
         } Cmt;
         bool VerboseLogging;
+        bool NightMode;
     } Dtu;
 
     struct {
@@ -369,6 +492,9 @@ struct CONFIG_T {
         PowerMeterSerialSdmConfig SerialSdm;
         PowerMeterHttpJsonConfig HttpJson;
         PowerMeterHttpSmlConfig HttpSml;
+        PowerMeterUdpConfig Udp;
+        PowerMeterFilterConfig Filter;
+        PowerMeterAdditionalConfig Additional[POWERMETER_MAX_ADDITIONAL];
     } PowerMeter;
 
     PowerLimiterConfig PowerLimiter;
@@ -387,6 +513,10 @@ public:
     bool read();
     bool write();
     void migrate();
+
+    // writes pending journal entries to config.json, e.g., before the
+    // file is downloaded.
+    void flush();
     void migrateOnBattery();
     CONFIG_T const& get();
 
@@ -413,6 +543,9 @@ public:
     static void serializePowerMeterSerialSdmConfig(PowerMeterSerialSdmConfig const& source, JsonObject& target);
     static void serializePowerMeterHttpJsonConfig(PowerMeterHttpJsonConfig const& source, JsonObject& target);
     static void serializePowerMeterHttpSmlConfig(PowerMeterHttpSmlConfig const& source, JsonObject& target);
+    static void serializePowerMeterUdpConfig(PowerMeterUdpConfig const& source, JsonObject& target);
+    static void serializePowerMeterFilterConfig(PowerMeterFilterConfig const& source, JsonObject& target);
+    static void serializePowerMeterAdditionalConfig(PowerMeterAdditionalConfig const* source, JsonArray& target);
     static void serializeBatteryConfig(BatteryConfig const& source, JsonObject& target);
     static void serializePowerLimiterConfig(PowerLimiterConfig const& source, JsonObject& target);
     static void serializeGridChargerConfig(GridChargerConfig const& source, JsonObject& target);
@@ -424,6 +557,9 @@ public:
     static void deserializePowerMeterSerialSdmConfig(JsonObject const& source, PowerMeterSerialSdmConfig& target);
     static void deserializePowerMeterHttpJsonConfig(JsonObject const& source, PowerMeterHttpJsonConfig& target);
     static void deserializePowerMeterHttpSmlConfig(JsonObject const& source, PowerMeterHttpSmlConfig& target);
+    static void deserializePowerMeterUdpConfig(JsonObject const& source, PowerMeterUdpConfig& target);
+    static void deserializePowerMeterFilterConfig(JsonObject const& source, PowerMeterFilterConfig& target);
+    static void deserializePowerMeterAdditionalConfig(JsonArray const& source, PowerMeterAdditionalConfig* target);
     static void deserializeBatteryConfig(JsonObject const& source, BatteryConfig& target);
     static void deserializePowerLimiterConfig(JsonObject const& source, PowerLimiterConfig& target);
     static void deserializeGridChargerConfig(JsonObject const& source, GridChargerConfig& target);
@@ -432,7 +568,43 @@ private:
     void loop();
     static double roundedFloat(float val);
 
+    // binary snapshot of CONFIG_T written next to config.json. it is only
+    // used if it was written by the same firmware build and is newer than
+    // the JSON file, which always remains the authoritative copy.
+    bool readSnapshot();
+    void writeSnapshot(uint32_t jsonSize);
+    static uint32_t getBuildId();
+    static uint32_t getConfigCrc();
+
+    // changes of individual sections are appended to a journal which
+    // amends the snapshot, rather than writing config.json. the journal is
+    // compacted (config.json and the snapshot are rewritten) once no more
+    // changes were made for a while, or if it grows too large.
+    struct Section {
+        size_t Offset;
+        size_t Size;
+    };
+    static std::vector<Section> const& getSections();
+    static std::vector<uint32_t> getSectionCrcs();
+    bool writeFull();
+    bool appendJournal();
+    void replayJournal();
+
+    static constexpr size_t _maxJournalSize = 16 * 1024;
+    static constexpr uint32_t _compactionDelayMs = 60 * 1000;
+
     Task _loopTask;
+
+    // CRC of the config as it was last persisted, used to skip writes
+    // which would not change the content of config.json
+    uint32_t _persistedCrc = 0;
+
+    // empty if there is no valid snapshot the journal could amend
+    std::vector<uint32_t> _persistedSectionCrcs;
+    size_t _journalSize = 0;
+    bool _compactionDue = false;
+    uint32_t _lastJournalWrite = 0;
+    std::mutex _persistMutex; // serializes writing the files
 };
 
 extern ConfigurationClass Configuration;
@@ -1,19 +1,138 @@
 #pragma once
 
 #include <Arduino.h>
-#include <map>
+#include <array>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <variant>
 #include <limits>
 #include <algorithm>
 
-using tCellVoltages = std::map<uint8_t, uint16_t>;
+// the cell voltages of a battery pack in a packed array. a bit mask tracks
+// the cells which reported a voltage. minimum, maximum and sum are updated
+// as cells are set, such that reporting them does not need a pass over all
+// cells, unless the cell holding the minimum or maximum changes direction.
+class tCellVoltages {
+    public:
+        static constexpr size_t MaxCells = 32;
+
+        // cells with an index beyond MaxCells are ignored
+        void set(uint8_t idx, uint16_t milliVolt) {
+            if (idx >= MaxCells) { return; }
+
+            uint32_t bit = 1UL << idx;
+            uint16_t previous = _milliVolts[idx];
+            bool known = (_valid & bit) != 0;
+            if (known && previous == milliVolt) { return; }
+
+            _milliVolts[idx] = milliVolt;
+            _valid |= bit;
+            _sum += milliVolt;
+
+            if (!known) {
+                ++_count;
+                if (_count == 1) { _min = _max = milliVolt; return; }
+            }
+            else {
+                _sum -= previous;
+                if ((previous == _min && milliVolt > _min) ||
+                        (previous == _max && milliVolt < _max)) {
+                    rescan();
+                    return;
+                }
+            }
+
+            _min = std::min(_min, milliVolt);
+            _max = std::max(_max, milliVolt);
+        }
+
+        void clear() { *this = tCellVoltages(); }
+
+        // number of cells which reported a voltage
+        size_t size() const { return _count; }
+        bool empty() const { return _count == 0; }
+
+        bool has(uint8_t idx) const { return idx < MaxCells && (_valid & (1UL << idx)) != 0; }
+        uint16_t get(uint8_t idx) const { return has(idx) ? _milliVolts[idx] : 0; }
+
+        uint16_t getMinMilliVolt() const { return _min; }
+        uint16_t getMaxMilliVolt() const { return _max; }
+        uint16_t getAvgMilliVolt() const { return _count > 0 ? _sum / _count : 0; }
+        uint16_t getDeltaMilliVolt() const { return _max - _min; }
+
+        bool operator==(tCellVoltages const& other) const {
+            return _valid == other._valid && _milliVolts == other._milliVolts;
+        }
+        bool operator!=(tCellVoltages const& other) const { return !(*this == other); }
+
+        // iterates the valid cells as (index, millivolts) pairs
+        class const_iterator {
+            public:
+                using value_type = std::pair<uint8_t, uint16_t>;
+
+                const_iterator(tCellVoltages const& cells, uint8_t idx)
+                    : _cells(cells), _idx(idx) { skipInvalid(); }
+
+                value_type operator*() const { return { _idx, _cells._milliVolts[_idx] }; }
+
+                struct ArrowProxy {
+                    value_type _pair;
+                    value_type const* operator->() const { return &_pair; }
+                };
+                ArrowProxy operator->() const { return { **this }; }
+
+                const_iterator& operator++() { ++_idx; skipInvalid(); return *this; }
+
+                bool operator==(const_iterator const& other) const { return _idx == other._idx; }
+                bool operator!=(const_iterator const& other) const { return _idx != other._idx; }
+
+            private:
+                void skipInvalid() {
+                    while (_idx < MaxCells && !_cells.has(_idx)) { ++_idx; }
+                }
+
+                tCellVoltages const& _cells;
+                uint8_t _idx;
+        };
+
+        const_iterator cbegin() const { return const_iterator(*this, 0); }
+        const_iterator cend() const { return const_iterator(*this, MaxCells); }
+        const_iterator begin() const { return cbegin(); }
+        const_iterator end() const { return cend(); }
+
+    private:
+        // visits the valid cells only, lowest index first
+        void rescan() {
+            uint32_t valid = _valid;
+            if (valid == 0) { return; }
+
+            uint16_t min = std::numeric_limits<uint16_t>::max();
+            uint16_t max = 0;
+            do {
+                uint16_t milliVolt = _milliVolts[__builtin_ctz(valid)];
+                min = std::min(min, milliVolt);
+                max = std::max(max, milliVolt);
+                valid &= valid - 1;
+            } while (valid != 0);
+
+            _min = min;
+            _max = max;
+        }
+
+        std::array<uint16_t, MaxCells> _milliVolts = {};
+        uint32_t _valid = 0;
+        uint8_t _count = 0;
+        uint32_t _sum = 0;
+        uint16_t _min = 0;
+        uint16_t _max = 0;
+};
+
+template<typename T> std::string dataPointValueToStr(T const& v);
 
 template<typename... V>
 class DataPoint {
-    template<typename, typename L, template<L> class>
+    template<typename, typename L, template<L> class, L, L>
     friend class DataPointContainer;
 
     public:
@@ -21,57 +140,66 @@ class DataPoint {
 
         DataPoint() = delete;
 
-        DataPoint(DataPoint const& other)
-            : _strLabel(other._strLabel)
-            , _strValue(other._strValue)
-            , _strUnit(other._strUnit)
-            , _value(other._value)
-            , _timestamp(other._timestamp) { }
-
-        DataPoint(std::string const& strLabel, std::string const& strValue,
-                std::string const& strUnit, tValue value, uint32_t timestamp)
+        // label and unit are expected to point to static storage (the
+        // respective label's traits), they are not copied.
+        DataPoint(char const* strLabel, char const* strUnit,
+                tValue value, uint32_t timestamp)
             : _strLabel(strLabel)
-            , _strValue(strValue)
             , _strUnit(strUnit)
             , _value(std::move(value))
             , _timestamp(timestamp) { }
 
-        std::string const& getLabelText() const { return _strLabel; }
-        std::string const& getValueText() const { return _strValue; }
-        std::string const& getUnitText() const { return _strUnit; }
+        char const* getLabelText() const { return _strLabel; }
+        char const* getUnitText() const { return _strUnit; }
         uint32_t getTimestamp() const { return _timestamp; }
 
+        // the value text is only needed when publishing or logging, so
+        // it is formatted on demand rather than with every new value.
+        std::string getValueText() const {
+            return std::visit([](auto const& v) { return dataPointValueToStr(v); }, _value);
+        }
+
         bool operator==(DataPoint const& other) const {
             return _value == other._value;
         }
 
     private:
-        std::string _strLabel;
-        std::string _strValue;
-        std::string _strUnit;
+        char const* _strLabel;
+        char const* _strUnit;
         tValue _value;
         uint32_t _timestamp;
 };
 
-template<typename T> std::string dataPointValueToStr(T const& v);
-
-template<typename DataPoint, typename Label, template<Label> class Traits>
+// holds at most one data point per label in a fixed array, indexed by the
+// label's value relative to the first label. First and Last must be the
+// labels with the lowest and highest value, respectively.
+template<typename DataPoint, typename Label, template<Label> class Traits, Label First, Label Last>
 class DataPointContainer {
+    static_assert(First <= Last, "invalid label range");
+
+    static constexpr size_t index(Label l) {
+        return static_cast<size_t>(l) - static_cast<size_t>(First);
+    }
+
+    static constexpr size_t Capacity = index(Last) + 1;
+    using tSlots = std::array<std::optional<DataPoint>, Capacity>;
+
     public:
         DataPointContainer() = default;
 
         template<Label L>
         void add(typename Traits<L>::type val) {
-            _dataPoints.emplace(
-                    L,
-                    DataPoint(
-                        Traits<L>::name,
-                        dataPointValueToStr(val),
-                        Traits<L>::unit,
-                        typename DataPoint::tValue(std::move(val)),
-                        millis()
-                    )
-            );
+            static_assert(L >= First && L <= Last, "label out of range");
+
+            auto& slot = _dataPoints[index(L)];
+            if (slot.has_value()) {
+                slot->_value = std::move(val);
+                slot->_timestamp = millis();
+                return;
+            }
+
+            slot.emplace(Traits<L>::name, Traits<L>::unit,
+                    typename DataPoint::tValue(std::move(val)), millis());
         }
 
         // make sure add() is only called with the type expected for the
@@ -79,51 +207,119 @@ class DataPointContainer {
         template<Label L, typename T>
         void add(T) = delete;
 
+        // provides in-place access to the value for the label, which is
+        // value-initialized if there is no data point for the label yet.
+        // the data point's timestamp is refreshed.
+        template<Label L>
+        typename Traits<L>::type& update() {
+            static_assert(L >= First && L <= Last, "label out of range");
+            using T = typename Traits<L>::type;
+
+            auto& slot = _dataPoints[index(L)];
+            if (!slot.has_value()) {
+                slot.emplace(Traits<L>::name, Traits<L>::unit,
+                        typename DataPoint::tValue(std::in_place_type<T>), millis());
+            }
+
+            slot->_timestamp = millis();
+            return std::get<T>(slot->_value);
+        }
+
+        // returns nullptr if there is no data point for the label
         template<Label L>
-        std::optional<DataPoint const> getDataPointFor() const {
-            auto it = _dataPoints.find(L);
-            if (it == _dataPoints.end()) { return std::nullopt; }
-            return it->second;
+        DataPoint const* getDataPointFor() const {
+            static_assert(L >= First && L <= Last, "label out of range");
+            auto const& slot = _dataPoints[index(L)];
+            return slot.has_value() ? &*slot : nullptr;
         }
 
         template<Label L>
         std::optional<typename Traits<L>::type> get() const {
-            auto optionalDataPoint = getDataPointFor<L>();
-            if (!optionalDataPoint.has_value()) { return std::nullopt; }
-            return std::get<typename Traits<L>::type>(optionalDataPoint->_value);
+            auto pDataPoint = getDataPointFor<L>();
+            if (pDataPoint == nullptr) { return std::nullopt; }
+            return std::get<typename Traits<L>::type>(pDataPoint->_value);
         }
 
-        using tMap = std::unordered_map<Label, DataPoint const>;
-        typename tMap::const_iterator cbegin() const { return _dataPoints.cbegin(); }
-        typename tMap::const_iterator cend() const { return _dataPoints.cend(); }
+        // true if source holds a data point for the label, and its value
+        // differs from the value of the respective data point in this instance.
+        template<Label L>
+        bool hasChangedIn(DataPointContainer const& source) const {
+            auto pSource = source.getDataPointFor<L>();
+            if (pSource == nullptr) { return false; }
+            auto pOwn = getDataPointFor<L>();
+            return pOwn == nullptr || !(*pOwn == *pSource);
+        }
+
+        // iterates the available data points as (label, data point) pairs
+        class const_iterator {
+            public:
+                using value_type = std::pair<Label, DataPoint const&>;
+
+                const_iterator(tSlots const& slots, size_t idx)
+                    : _slots(slots), _idx(idx) { skipEmpty(); }
+
+                value_type operator*() const {
+                    return { static_cast<Label>(static_cast<size_t>(First) + _idx), *_slots[_idx] };
+                }
+
+                struct ArrowProxy {
+                    value_type _pair;
+                    value_type const* operator->() const { return &_pair; }
+                };
+                ArrowProxy operator->() const { return { **this }; }
+
+                const_iterator& operator++() { ++_idx; skipEmpty(); return *this; }
+
+                bool operator==(const_iterator const& other) const { return _idx == other._idx; }
+                bool operator!=(const_iterator const& other) const { return _idx != other._idx; }
+
+            private:
+                void skipEmpty() {
+                    while (_idx < Capacity && !_slots[_idx].has_value()) { ++_idx; }
+                }
+
+                tSlots const& _slots;
+                size_t _idx;
+        };
+
+        const_iterator cbegin() const { return const_iterator(_dataPoints, 0); }
+        const_iterator cend() const { return const_iterator(_dataPoints, Capacity); }
+        const_iterator begin() const { return cbegin(); }
+        const_iterator end() const { return cend(); }
 
         // copy all data points from source into this instance, overwriting
         // existing data points in this instance.
         void updateFrom(DataPointContainer const& source)
         {
-            for (auto iter = source.cbegin(); iter != source.cend(); ++iter) {
-                auto pos = _dataPoints.find(iter->first);
+            for (size_t i = 0; i < Capacity; ++i) {
+                auto const& src = source._dataPoints[i];
+                if (!src.has_value()) { continue; }
 
-                if (pos != _dataPoints.end()) {
-                    // do not update existing data points with the same value
-                    if (pos->second == iter->second) { continue; }
+                // do not update existing data points with the same value
+                auto& dst = _dataPoints[i];
+                if (dst.has_value() && *dst == *src) { continue; }
 
-                    _dataPoints.erase(pos);
-                }
-                _dataPoints.insert(*iter);
+                dst = src;
             }
         }
 
+        // removes all data points, which does not free any memory
+        void clear()
+        {
+            for (auto& slot : _dataPoints) { slot.reset(); }
+        }
+
         uint32_t getLastUpdate() const
         {
             uint32_t now = millis();
             uint32_t diff = std::numeric_limits<uint32_t>::max()/2;
-            for (auto iter = _dataPoints.cbegin(); iter != _dataPoints.cend(); ++iter) {
-                diff = std::min(diff, now - iter->second.getTimestamp());
+            for (auto const& slot : _dataPoints) {
+                if (!slot.has_value()) { continue; }
+                diff = std::min(diff, now - slot->getTimestamp());
             }
             return now - diff;
         }
 
     private:
-        tMap _dataPoints;
+        tSlots _dataPoints;
 };
@@ -1,8 +1,14 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
 #include <TaskSchedulerDeclarations.h>
-#include <mutex>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class InverterAbstract;
 
 class DatastoreClass {
 public:
@@ -57,29 +63,70 @@ public:
     // True if all enabled inverters are reachable
     bool getIsAllEnabledReachable();
 
+    // the aggregates published to readers, which may run in any task. a
+    // snapshot is never modified, it is replaced once any value changed.
+    struct Totals {
+        float AcYieldTotalEnabled = 0;
+        float AcYieldDayEnabled = 0;
+        float AcPowerEnabled = 0;
+        float DcPowerEnabled = 0;
+        float DcPowerIrradiation = 0;
+        float DcIrradiationInstalled = 0;
+        float DcIrradiation = 0;
+        uint32_t AcYieldTotalDigits = 0;
+        uint32_t AcYieldDayDigits = 0;
+        uint32_t AcPowerDigits = 0;
+        uint32_t DcPowerDigits = 0;
+        bool IsAtLeastOneReachable = false;
+        bool IsAtLeastOneProducing = false;
+        bool IsAllEnabledProducing = false;
+        bool IsAllEnabledReachable = false;
+        bool IsAtLeastOnePollEnabled = false;
+    };
+
+    // all values of a single point in time, as opposed to the getters
+    std::shared_ptr<Totals const> getTotals() const { return std::atomic_load(&_spTotals); }
+
+    // called from the Datastore's task whenever the totals changed
+    using UpdateCallback = std::function<void()>;
+    void onUpdate(UpdateCallback callback);
+
 private:
+    void registerMetrics();
     void loop();
+    bool syncInverters();
 
     Task _loopTask;
 
-    std::mutex _mutex;
-
-    float _totalAcYieldTotalEnabled = 0;
-    float _totalAcYieldDayEnabled = 0;
-    float _totalAcPowerEnabled = 0;
-    float _totalDcPowerEnabled = 0;
-    float _totalDcPowerIrradiation = 0;
-    float _totalDcIrradiationInstalled = 0;
-    float _totalDcIrradiation = 0;
-    uint32_t _totalAcYieldTotalDigits = 0;
-    uint32_t _totalAcYieldDayDigits = 0;
-    uint32_t _totalAcPowerDigits = 0;
-    uint32_t _totalDcPowerDigits = 0;
-    bool _isAtLeastOneReachable = false;
-    bool _isAtLeastOneProducing = false;
-    bool _isAllEnabledProducing = false;
-    bool _isAllEnabledReachable = false;
-    bool _isAtLeastOnePollEnabled = false;
+    std::shared_ptr<Totals const> _spTotals = std::make_shared<Totals const>();
+    std::vector<UpdateCallback> _updateCallbacks;
+
+    // the contribution of a single inverter to the totals, which is only
+    // recalculated if the inverter's statistics changed.
+    struct InverterState {
+        std::shared_ptr<InverterAbstract> Inverter;
+        INVERTER_CONFIG_T const* Config;
+        std::shared_ptr<std::atomic<bool>> spUpdated;
+
+        bool PollEnabled = false;
+        bool ConfigPollEnabled = false;
+        bool Producing = false;
+        bool Reachable = false;
+
+        float AcYieldTotal = 0;
+        float AcYieldDay = 0;
+        float AcPower = 0;
+        float DcPower = 0;
+        float DcPowerIrradiation = 0;
+        float DcIrradiationInstalled = 0;
+        uint32_t AcYieldTotalDigits = 0;
+        uint32_t AcYieldDayDigits = 0;
+        uint32_t AcPowerDigits = 0;
+        uint32_t DcPowerDigits = 0;
+
+        void updateContribution();
+    };
+    std::vector<InverterState> _inverters;
 };
 
 extern DatastoreClass Datastore;
@@ -5,6 +5,9 @@
 #include "defaults.h"
 #include <TaskSchedulerDeclarations.h>
 #include <U8g2lib.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 #define CHART_HEIGHT 20 // chart area hight in pixels
 #define CHART_WIDTH 47 // chart area width in pixels
@@ -50,18 +53,28 @@ public:
     bool enableScreensaver = true;
 
 private:
+    static void renderLoopHelper(void* context);
+    void renderLoop();
     void loop();
+    void sendChangedTiles();
     void printText(const char* text, const uint8_t line);
     void calcLineHeights();
     void setFont(const uint8_t line);
     bool isValidDisplay();
 
-    Task _loopTask;
+    // the frame is rendered by a low-priority task, as transferring it to the
+    // display takes tens of milliseconds, which must not delay control work.
+    TaskHandle_t _renderTaskHandle = nullptr;
+    std::mutex _mutex;
+
+    // the frame last sent to the display, used to only send changed tiles
+    std::vector<uint8_t> _sentBuffer;
+    bool _fullRefresh = true;
 
     U8G2* _display;
     DisplayGraphicDiagramClass _diagram;
 
-    bool _displayTurnedOn;
+    std::atomic<bool> _displayTurnedOn = false;
 
     DisplayType_t _display_type = DisplayType_t::None;
     DiagramMode_t _diagram_mode = DiagramMode_t::Off;
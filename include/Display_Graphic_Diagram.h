@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TimeSeries.h"
 #include <TaskSchedulerDeclarations.h>
 #include <U8g2lib.h>
-#include <array>
+#include <mutex>
+#include <vector>
 
 #define MAX_DATAPOINTS 128
 
@@ -17,20 +19,18 @@ public:
     void updatePeriod();
 
 private:
-    void averageLoop();
-    void dataPointLoop();
+    void refreshLoop();
 
-    uint32_t getSecondsPerDot();
-
-    Task _averageTask;
-    Task _dataPointTask;
+    Task _refreshTask;
 
     U8G2* _display = nullptr;
-    std::array<float, MAX_DATAPOINTS> _graphValues = {};
-    uint8_t _graphValuesCount = 0;
 
-    uint8_t _chartWidth = MAX_DATAPOINTS;
+    // the diagram is drawn by the display's render task, while the buckets
+    // are fetched from the time-series store by the main loop. there is one
+    // bucket per pixel of the chart's width.
+    std::mutex _mutex;
+    std::vector<TimeSeriesClass::Bucket> _buckets;
+    uint32_t _bucketWidth = 0; // in seconds
 
-    float _iRunningAverage = 0;
-    uint16_t _iRunningAverageCnt = 0;
+    uint8_t _chartWidth = MAX_DATAPOINTS;
 };
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <IPAddress.h>
+#include <TaskSchedulerDeclarations.h>
+#include <WString.h>
+#include <map>
+#include <mutex>
+
+// resolves host names for the network clients (HTTP power meters, MQTT,
+// syslog) and keeps the results, such that a slow DNS server does not delay
+// every (re-)connect. addresses are refreshed in the background before they
+// expire, using the asynchronous lwIP resolver. failures are kept for a
+// while as well, so an unresolvable name does not block each attempt.
+class DnsCacheClass {
+public:
+    DnsCacheClass();
+    void init(Scheduler& scheduler);
+
+    // provides the cached address, also if it is due to be refreshed, and
+    // never blocks. unknown names are resolved in the background.
+    bool lookup(String const& host, IPAddress& address);
+
+    // like lookup(), but resolves unknown names right away (first via mDNS
+    // if enabled, then via DNS). blocks for up to the resolver's timeout.
+    bool resolve(String const& host, IPAddress& address);
+
+    // called with the result of a background query
+    void onQueryResult(String const& host, IPAddress const& address, bool success);
+
+private:
+    void loop();
+
+    enum class Source : uint8_t {
+        Dns,
+        Mdns
+    };
+
+    struct Entry {
+        IPAddress Address = INADDR_NONE; // of the last successful query
+        Source Src = Source::Dns;
+        uint32_t CheckedMillis = 0; // when the last query completed
+        uint32_t LastUsedMillis = 0;
+        bool Checked = false; // a query completed at least once
+        bool Failed = false; // the last query failed
+        bool Unresolvable = false; // neither mDNS nor DNS know the name
+        bool Pending = false; // a background query is in flight
+    };
+
+    // must be called with _mutex held. nullptr if the cache is full.
+    Entry* getEntry(String const& host, uint32_t now);
+    bool isRefreshDue(Entry const& entry, uint32_t now) const;
+    void store(Entry& entry, Source source, IPAddress const& address, bool success);
+
+    // the lwIP resolver does not provide the TTL of the records. if a
+    // refresh fails, the previous address is still used.
+    static constexpr uint32_t _refreshMillis = 5 * 60 * 1000;
+    static constexpr uint32_t _negativeTtlMillis = 30 * 1000;
+    static constexpr uint32_t _unusedMillis = 15 * 60 * 1000;
+    static constexpr size_t _maxEntries = 8;
+
+    Task _loopTask;
+
+    std::mutex _mutex;
+    std::map<String, Entry> _entries;
+};
+
+extern DnsCacheClass DnsCache;
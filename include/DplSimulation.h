@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// stands in for a governed inverter in the DPL simulation. commands are not
+// sent to the radio, but become effective after a fixed latency, and new
+// statistics are published periodically, like a polled inverter would.
+// the model is a HM-800-2T, which is unlimited by its DC input.
+class DplSimulationInverter : public HM_2CH {
+public:
+    explicit DplSimulationInverter(const uint64_t serial);
+
+    void update(uint32_t now, float dcVoltage);
+    float getOutputAcWatts() const { return _outputAcWatts; }
+
+    uint32_t getLimitCommands() const { return _limitCommands; }
+    uint32_t getPowerCommands() const { return _powerCommands; }
+    void resetCommandCounters() { _limitCommands = _powerCommands = 0; }
+
+    bool sendStatsRequest() final { return true; }
+    bool sendAlarmLogRequest(const bool force = false) final { return true; }
+    bool sendDevInfoRequest() final { return true; }
+    bool sendSystemConfigParaRequest() final { return true; }
+    bool sendActivePowerControlRequest(float limit, const PowerLimitControlType type) final;
+    bool resendActivePowerControlRequest() final { return true; }
+    bool sendPowerControlRequest(const bool turnOn) final;
+    bool sendRestartControlRequest() final;
+    bool resendPowerControlRequest() final { return true; }
+    bool sendGridOnProFileParaRequest() final { return true; }
+    bool sendChangeChannelRequest() final { return true; }
+
+private:
+    void publishStats(uint32_t now, float dcVoltage);
+
+    static constexpr uint16_t _maxPowerWatts = 800;
+    static constexpr uint32_t _commandLatencyMs = 2500;
+    static constexpr uint32_t _statsIntervalMs = 5000;
+
+    float _limitPercent = 100;
+    bool _producing = true;
+    float _outputAcWatts = 0;
+
+    uint32_t _lastStats = 0;
+
+    // pending commands become effective at the given time
+    uint32_t _limitDue = 0;
+    float _pendingLimitPercent = 0;
+    bool _limitPending = false;
+    uint32_t _powerDue = 0;
+    bool _pendingProducing = false;
+    bool _powerPending = false;
+
+    uint32_t _limitCommands = 0;
+    uint32_t _powerCommands = 0;
+};
+
+// builds of environments defining OPENDTU_DPL_SIMULATION replace the
+// governed inverters and the power meter by simulated ones. the household
+// consumption recorded in /dplsim.csv is replayed in real time, and the grid
+// power seen by the DPL is the consumption minus the output of the simulated
+// inverters behind the power meter. every pass through the recording results
+// in a report, such that different DPL settings can be compared by changing
+// them in the web UI between passes.
+//
+// each line of the recording reads "<seconds>,<consumption W>[,<DC voltage>]".
+// the DC voltage is reported as the input voltage of all inverters, which the
+// DPL uses as battery voltage if no battery interface is enabled.
+class DplSimulationClass {
+public:
+    void init(Scheduler& scheduler);
+
+    // the grid power as measured by the simulated power meter. returns
+    // false if no new reading is available since the last call.
+    bool getMeterReading(float& watts);
+
+private:
+    void loop();
+    bool loadRecording();
+    void startPass();
+    void report();
+
+    struct Sample {
+        uint32_t Millis;
+        int16_t ConsumptionWatts;
+        float DcVoltage;
+    };
+
+    static constexpr size_t _maxSamples = 8192;
+    static constexpr uint32_t _meterIntervalMs = 1000;
+
+    Task _loopTask;
+
+    std::vector<Sample> _samples;
+    size_t _sampleIdx = 0;
+    std::vector<std::shared_ptr<DplSimulationInverter>> _inverters;
+    std::vector<bool> _behindPowerMeter; // per entry in _inverters
+
+    uint32_t _pass = 0;
+    uint32_t _passStart = 0;
+    uint32_t _lastLoop = 0;
+    uint32_t _lastMeterReading = 0;
+
+    std::mutex _meterMutex;
+    float _meterWatts = 0;
+    bool _meterUpdated = false;
+
+    // statistics of the current pass
+    double _importWh = 0;
+    double _exportWh = 0;
+    uint32_t _steps = 0;
+    uint32_t _settledSteps = 0;
+    uint32_t _settlingSumMs = 0;
+    uint32_t _settlingMaxMs = 0;
+    uint32_t _settlingStart = 0;
+    bool _settling = false;
+    uint32_t _lastCommands = 0;
+    uint32_t _lastCommandMillis = 0;
+};
+
+extern DplSimulationClass DplSimulation;
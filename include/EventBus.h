@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <tuple>
+
+class BatteryStats;
+
+// the events published on the bus. payloads are handed to the subscribers
+// by reference and are only valid while they are dispatched.
+namespace Events {
+
+// an inverter's statistics (live data) were updated
+struct InverterStatsUpdated {
+    uint64_t Serial;
+};
+
+// a power meter provider received a new reading
+struct MeterSample {
+    float PowerTotal;
+    uint32_t ReceivedMillis;
+};
+
+// the battery published a new snapshot of its stats
+struct BatterySnapshot {
+    BatteryStats const& Stats;
+};
+
+// the DPL completed a calculation
+struct DplDecision {
+    int32_t ExpectedOutputWatts;
+    bool LimitUpdated;
+};
+
+}; // namespace Events
+
+// a topic keeps a fixed number of subscribers. subscribing is meant to
+// happen while initializing, subscribers cannot be removed.
+template<typename Event, size_t MaxSubscribers = 4>
+class EventTopic {
+public:
+    using Callback = std::function<void(Event const&)>;
+
+    bool subscribe(Callback callback)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t count = _count.load(std::memory_order_relaxed);
+        if (count >= MaxSubscribers) { return false; }
+
+        _subscribers[count] = std::move(callback);
+        _count.store(count + 1, std::memory_order_release);
+        return true;
+    }
+
+    // the subscribers are called in the context of the publisher. they must
+    // not block and shall only note that something is to be done, e.g., by
+    // raising a flag.
+    void publish(Event const& event) const
+    {
+        size_t count = _count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) { _subscribers[i](event); }
+    }
+
+private:
+    std::array<Callback, MaxSubscribers> _subscribers;
+    std::atomic<size_t> _count = 0;
+    std::mutex _mutex; // serializes subscribing, publishing is lock-free
+};
+
+// notifies subsystems of new data, such that they do not need to compare
+// the timestamps of other subsystems' data to detect it. dispatching never
+// allocates memory nor copies the payload.
+class EventBusClass {
+public:
+    template<typename Event>
+    bool subscribe(typename EventTopic<Event>::Callback callback)
+    {
+        return std::get<EventTopic<Event>>(_topics).subscribe(std::move(callback));
+    }
+
+    template<typename Event>
+    void publish(Event const& event) const
+    {
+        std::get<EventTopic<Event>>(_topics).publish(event);
+    }
+
+private:
+    std::tuple<
+        EventTopic<Events::InverterStatsUpdated>,
+        EventTopic<Events::MeterSample>,
+        EventTopic<Events::BatterySnapshot>,
+        EventTopic<Events::DplDecision>
+    > _topics;
+};
+
+extern EventBusClass EventBus;
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+// accounts for the writes to LittleFS per category of files and limits the
+// rate of writes which can be deferred without losing anything important.
+//
+// the budget is a token bucket of bytes. every write drains it, but only
+// deferrable writes are refused if it is exhausted. the owner of a refused
+// write keeps the data in memory and retries later.
+class FsWriteMonitorClass {
+public:
+    enum class Category : uint8_t {
+        Config,
+        LanguagePack,
+        Upload,
+        TimeSeries,
+        YieldCheckpoint,
+        DataCache,
+        Count
+    };
+
+    // returns false if a deferrable write shall be postponed. writes of
+    // other categories are always admitted.
+    bool admit(Category category, size_t bytes);
+
+    // to be called after data was written, also if it was admitted
+    void record(Category category, size_t bytes);
+
+    void serialize(JsonObject& target) const;
+
+private:
+    static bool isDeferrable(Category category);
+    void refill();
+
+    struct Counters {
+        uint32_t Ops;
+        uint32_t Bytes;
+        uint32_t Erases; // estimated
+        uint32_t Deferred;
+    };
+
+    // LittleFS copies a block on every write to it, so each write costs at
+    // least one erase of a block of the flash.
+    static constexpr size_t _blockSize = 4096;
+
+    // a LittleFS partition of 1.5 MiB rated for 100k erase cycles per block
+    // lasts 10 years at about seven block erases per minute. deferrable
+    // writes are allowed half of that on average.
+    static constexpr int32_t _budgetPerMinute = 4 * _blockSize;
+    static constexpr int32_t _budgetCapacity = 16 * _blockSize;
+
+    mutable std::mutex _mutex;
+    std::array<Counters, static_cast<size_t>(Category::Count)> _counters = {};
+    int32_t _budget = _budgetCapacity;
+    uint32_t _lastRefillMillis = 0;
+};
+
+extern FsWriteMonitorClass FsWriteMonitor;
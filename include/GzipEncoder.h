@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// produces a gzip stream from input provided in arbitrary pieces. the LZ77
+// window is limited to _windowSize and matches are encoded with the fixed
+// Huffman codes of deflate, such that the encoder needs about 14 kB of RAM,
+// as opposed to the hundreds of kB of a full zlib compressor. the ratio is
+// still good for JSON and other repetitive text.
+class GzipEncoder {
+public:
+    GzipEncoder();
+
+    // compresses the given data and appends the output produced so far
+    void write(uint8_t const* data, size_t len, std::vector<uint8_t>& out);
+
+    // compresses all pending input and appends the trailer
+    void finish(std::vector<uint8_t>& out);
+
+private:
+    static constexpr size_t _windowSize = 2048;
+    static constexpr size_t _minMatch = 3;
+    static constexpr size_t _maxMatch = 258;
+    static constexpr size_t _hashBits = 10;
+    static constexpr size_t _maxChain = 16;
+
+    void compress(bool flush, std::vector<uint8_t>& out);
+    void slide();
+    void insertHash(size_t pos);
+    size_t findMatch(size_t pos, size_t available, size_t& distance) const;
+
+    void putBits(uint32_t value, uint8_t count, std::vector<uint8_t>& out);
+    void putHuffman(uint16_t code, uint8_t length, std::vector<uint8_t>& out);
+    void putLiteral(uint16_t symbol, std::vector<uint8_t>& out);
+    void putMatch(size_t length, size_t distance, std::vector<uint8_t>& out);
+
+    // the window preceding _pos and the pending input following it
+    std::array<uint8_t, 2 * _windowSize> _buffer;
+    size_t _pos = 0;
+    size_t _end = 0;
+
+    // most recent position + 1 per hash, and per position its predecessor
+    // with the same hash, zero if there is none
+    std::array<uint16_t, 1 << _hashBits> _head;
+    std::array<uint16_t, 2 * _windowSize> _prev;
+
+    uint32_t _bitBuffer = 0;
+    uint8_t _bitCount = 0;
+
+    uint32_t _crc = 0xFFFFFFFF;
+    uint32_t _size = 0;
+    bool _headerWritten = false;
+};
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <TaskSchedulerDeclarations.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+// tracks the amount of free heap and the largest free block over time, such
+// that fragmentation building up over weeks of uptime becomes visible, and
+// counts failed JSON allocations by call site.
+//
+// when built with HEAP_CALLSITE_TRACING (requires the ESP-IDF standalone heap
+// tracing to be enabled in the sdkconfig), allocations that are still alive
+// at the end of each sampling period are aggregated by their call stack.
+// the addresses can be resolved using addr2line and the firmware's ELF file.
+class HeapMonitorClass {
+public:
+    void init(Scheduler& scheduler);
+
+    // function must be a string literal, i.e., __FUNCTION__
+    void recordAllocFailure(char const* function, uint16_t line);
+
+    // fragmentation in percent, i.e., the share of free heap which is not
+    // part of the largest free block.
+    static uint8_t getFragmentation();
+
+    void serialize(JsonObject& target) const;
+
+    static constexpr uint32_t SamplingIntervalMillis = 60 * 1000;
+
+private:
+    void loop();
+
+    struct Sample {
+        uint32_t FreeHeap;
+        uint32_t MaxAllocHeap;
+    };
+
+    // a ring buffer of samples, where Next is the index of the oldest sample
+    // once the buffer is full.
+    template<size_t N>
+    struct History {
+        std::array<Sample, N> Samples;
+        size_t Next = 0;
+        size_t Size = 0;
+
+        void add(Sample const& sample) {
+            Samples[Next] = sample;
+            Next = (Next + 1) % N;
+            Size = std::min(Size + 1, N);
+        }
+
+        void serialize(JsonArray target) const;
+    };
+
+    Task _loopTask;
+
+    mutable std::mutex _mutex;
+
+    // one sample per minute for the last two hours
+    History<120> _recent;
+
+    // the worst values per hour for the last week
+    static constexpr uint32_t _samplesPerHour = 60;
+    History<168> _hourly;
+    Sample _currentHour = { UINT32_MAX, UINT32_MAX };
+    uint32_t _samplesInCurrentHour = 0;
+
+    struct AllocFailure {
+        char const* Function;
+        uint16_t Line;
+        uint32_t Count;
+        uint32_t LastUptime; // in seconds
+    };
+    static constexpr size_t _maxAllocFailureSites = 16;
+    std::array<AllocFailure, _maxAllocFailureSites> _allocFailures;
+    size_t _allocFailureSites = 0;
+
+#ifdef HEAP_CALLSITE_TRACING
+    void collectCallSites();
+
+    static constexpr size_t _callStackDepth = 4;
+    struct CallSite {
+        std::array<void*, _callStackDepth> Stack;
+        uint32_t Allocations;
+        uint64_t Bytes;
+    };
+    static constexpr size_t _maxCallSites = 32;
+    std::array<CallSite, _maxCallSites> _callSites;
+    size_t _callSiteCount = 0;
+#endif
+};
+
+extern HeapMonitorClass HeapMonitor;
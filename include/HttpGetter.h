@@ -3,6 +3,7 @@
 
 #include "Configuration.h"
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <utility>
 #include <string>
@@ -12,31 +13,52 @@
 class HttpGetterClient : public HTTPClient {
 public:
     void restartTCP() {
-        // keeps the NetworkClient, and closes the TCP connections (as we
-        // effectively do not support keep-alive with HTTP 1.0).
+        // keeps the NetworkClient, and closes the TCP connection, e.g., if
+        // the server announced that it will not keep the connection alive.
         HTTPClient::disconnect(true);
         HTTPClient::connect();
     }
+
+    // opens the connection ahead of the request, see performGetRequest()
+    bool connectNow() { return HTTPClient::connect(); }
 };
 
-using up_http_client_t = std::unique_ptr<HttpGetterClient>;
 using sp_wifi_client_t = std::shared_ptr<WiFiClient>;
 
+// a TCP (or TLS) connection to a server, shared by all HttpGetter instances
+// targeting the same protocol, host and port. the HTTP client is kept such
+// that HTTP/1.1 persistent connections are used across requests.
+struct HttpConnection {
+    std::mutex Mutex; // held while a request and its response are processed
+    sp_wifi_client_t spWiFiClient;
+    String Address; // resolved address of the currently open connection
+    uint32_t NetworkGeneration = 0; // see HttpGetter::invalidateConnections()
+
+    // the wifi client *must* die *after* the http client, as the http
+    // client uses the wifi client in its destructor.
+    HttpGetterClient HttpClient;
+};
+
+using sp_http_connection_t = std::shared_ptr<HttpConnection>;
+
+// the response of a successful request. the connection is locked for other
+// HttpGetter instances until the result is destroyed, so results must not
+// be kept while performing another request.
 class HttpRequestResult {
 public:
     HttpRequestResult(bool success,
-            up_http_client_t upHttpClient = nullptr,
-            sp_wifi_client_t spWiFiClient = nullptr)
+            sp_http_connection_t spConnection = nullptr,
+            std::unique_lock<std::mutex> lock = {},
+            std::unique_ptr<Stream> upBody = nullptr)
         : _success(success)
-        , _upHttpClient(std::move(upHttpClient))
-        , _spWiFiClient(std::move(spWiFiClient)) { }
+        , _spConnection(std::move(spConnection))
+        , _lock(std::move(lock))
+        , _upBody(std::move(upBody)) { }
 
     ~HttpRequestResult() {
-        // the wifi client *must* die *after* the http client, as the http
-        // client uses the wifi client in its destructor.
-        if (_upHttpClient) { _upHttpClient->end(); }
-        _upHttpClient = nullptr;
-        _spWiFiClient = nullptr;
+        // keeps the TCP connection open if the server allows it
+        _upBody = nullptr;
+        if (_spConnection) { _spConnection->HttpClient.end(); }
     }
 
     HttpRequestResult(HttpRequestResult const&) = delete;
@@ -46,15 +68,14 @@ public:
 
     operator bool() const { return _success; }
 
-    Stream* getStream() {
-        if(!_upHttpClient) { return nullptr; }
-        return _upHttpClient->getStreamPtr();
-    }
+    // the response body, limited to the announced content length
+    Stream* getStream() { return _upBody.get(); }
 
 private:
     bool _success;
-    up_http_client_t _upHttpClient;
-    sp_wifi_client_t _spWiFiClient;
+    sp_http_connection_t _spConnection;
+    std::unique_lock<std::mutex> _lock;
+    std::unique_ptr<Stream> _upBody;
 };
 
 class HttpGetter {
@@ -66,10 +87,26 @@ public:
     void addHeader(char const* key, char const* value);
     HttpRequestResult performGetRequest();
 
+    // sends the payload, any 2xx status code counts as success
+    HttpRequestResult performPostRequest(uint8_t const* payload, size_t size);
+
+    // opens the connection ahead of the next request if it is not open, e.g.,
+    // as the server closed it, such that the request does not wait for the
+    // TCP (and TLS) handshake.
+    bool prewarm();
+    static constexpr uint32_t PrewarmLeadMillis = 1000;
+
     char const* getErrorText() const { return _errBuffer; }
 
+    // marks all open connections as stale, e.g., after the network interface
+    // changed. they are closed before they are used the next time.
+    static void invalidateConnections();
+
 private:
-    std::pair<bool, String> getAuthDigest();
+    HttpRequestResult performRequest(char const* method, uint8_t const* payload, size_t size);
+    std::pair<bool, String> getAuthDigest(char const* method);
+    void closeIfStale();
+    bool resolveAddress();
     HttpRequestConfig const& _config;
 
     template<typename... Args>
@@ -84,7 +121,9 @@ private:
     String _wwwAuthenticate = "";
     unsigned _nonceCounter = 0;
 
-    sp_wifi_client_t _spWiFiClient; // reused for multiple HTTP requests
+    sp_http_connection_t _spConnection; // shared with getters for the same server
+
+    static sp_http_connection_t getConnection(bool useHttps, String const& host, uint16_t port);
 
     std::vector<std::pair<std::string, std::string>> _additionalHeaders;
 };
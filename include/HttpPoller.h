@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+
+// polls all HTTP-based providers from a single task, such that each of them
+// does not need a task (and stack) of its own. a provider registers a job,
+// which is polled whenever its interval elapsed. if the previous poll
+// failed, the job is asked to prewarm its connections shortly before the
+// next poll, see HttpGetter::prewarm().
+//
+// the jobs are polled one after another. a job whose poll consists of
+// several requests may still perform them concurrently.
+class HttpPollerClass {
+public:
+    struct Job {
+        std::function<uint32_t()> IntervalMillis;
+        std::function<bool()> Poll; // returns false if polling failed
+        std::function<void()> Prewarm;
+    };
+
+    using job_id_t = uint32_t;
+
+    job_id_t add(Job job);
+
+    // waits for the job to complete if it is being polled, such that the
+    // job's owner may be destroyed after this returns.
+    void remove(job_id_t id);
+
+    // to be called if a job's interval changed, e.g., due to the standby
+    void reschedule();
+
+private:
+    static constexpr uint32_t _taskStackSize = 3072;
+    static constexpr uint32_t _idleMillis = 60 * 1000;
+
+    static void pollingLoopHelper(void* context);
+    void pollingLoop();
+
+    struct Entry {
+        job_id_t Id;
+        Job Callbacks;
+        uint32_t LastPoll = 0;
+        bool Prewarmed = true;
+    };
+
+    // entries are not moved, so a job may be polled while others are added
+    std::list<Entry> _entries;
+    job_id_t _nextId = 1;
+    job_id_t _runningId = 0; // the job being polled, zero if none
+    bool _scheduleChanged = false;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    TaskHandle_t _taskHandle = nullptr;
+};
+
+extern HttpPollerClass HttpPoller;
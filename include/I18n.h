@@ -4,11 +4,15 @@
 #include <TaskSchedulerDeclarations.h>
 #include <WString.h>
 #include <list>
+#include <mutex>
 
 struct LanguageInfo_t {
     String code;
     String name;
     String filename;
+    size_t size; // of the file when it was indexed
+    size_t displayOffset; // location of the "display" object within the file
+    size_t displayLength; // zero if the file has no "display" object
 };
 
 class I18nClass {
@@ -26,11 +30,21 @@ public:
         String& yield_today_wh, String& yield_today_kwh,
         String& yield_total_kwh, String& yield_total_mwh);
 
+    // to be called after a language pack was written or removed, such that
+    // the index reflects the change when booting the next time.
+    void updateIndex(const String& filename);
+    void removeFromIndex(const String& filename);
+
 private:
     void readLangPacks();
-    void readConfig(String file);
+    bool readConfig(const String& file, LanguageInfo_t& lang);
+
+    static bool readIndex(std::list<LanguageInfo_t>& languages);
+    static void writeIndex(const std::list<LanguageInfo_t>& languages);
 
     std::list<LanguageInfo_t> _availLanguages;
+
+    std::mutex _indexMutex; // serializes changes of the index file
 };
 
 extern I18nClass I18n;
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <Hoymiles.h>
+
+// publishes the completion of every control command (limit, power and
+// restart) to <serial>/cmd/completed, such that clients which issued a
+// command can wait for its actual outcome. the id of the command matches the
+// id returned by the REST API and published to <serial>/cmd/accepted.
+class InverterCommandEventsClass {
+public:
+    void init();
+
+    static void serialize(CommandCompletion const& completion, JsonObject& target);
+    static char const* getResultName(CommandResult result);
+
+private:
+    void onCompletion(CommandCompletion const& completion);
+};
+
+extern InverterCommandEventsClass InverterCommandEvents;
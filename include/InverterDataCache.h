@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+class InverterAbstract;
+
+// keeps the grid profile, the device info and the system config (current
+// limit) of each inverter on LittleFS, such that they are restored at boot
+// instead of being downloaded again from every inverter before the DPL can
+// regulate. the restored device info and system config are provisional:
+// the timestamps of the respective parsers are left untouched, such that
+// they are still requested from the inverter in the background as usual
+// and replace the restored copy. the grid profile is taken as is, as it
+// only changes along with the firmware.
+//
+// entries are keyed by serial and firmware build version: other entries are
+// only restored if they were written with the firmware the cached device
+// info names, and are discarded once the inverter reports another firmware.
+// an entry is written whenever its checksum differs from the cached copy.
+// the system config changes with every limit command, hence it is written
+// at most every _systemConfigSaveIntervalMs to spare the flash.
+class InverterDataCacheClass {
+public:
+    InverterDataCacheClass();
+    void init(Scheduler& scheduler);
+
+    // removes all cached data of the given inverter
+    void remove(uint64_t serial);
+
+private:
+    enum Kind : uint8_t {
+        DevInfo,
+        GridProfile,
+        SystemConfigPara,
+        KindCount
+    };
+
+    struct State {
+        std::array<uint32_t, KindCount> Crc = {}; // zero if nothing is cached
+        std::array<uint32_t, KindCount> SavedMillis = {};
+        uint16_t Firmware = 0; // the cached entries were written with
+    };
+
+    void loop();
+    void restore(InverterAbstract& inv, State& state);
+    bool restore(InverterAbstract& inv, Kind kind, std::vector<uint8_t> const& data);
+    static bool getConfirmedData(InverterAbstract& inv, Kind kind, std::vector<uint8_t>& data);
+
+    bool read(uint64_t serial, Kind kind, std::vector<uint8_t>& data, uint16_t& firmware, uint32_t& crc);
+    bool write(uint64_t serial, Kind kind, std::vector<uint8_t> const& data, uint16_t firmware, uint32_t crc);
+    void erase(uint64_t serial, Kind kind);
+    static String getFilename(uint64_t serial, Kind kind);
+
+    struct Header {
+        uint32_t Magic;
+        uint8_t Version;
+        uint8_t Length;
+        uint16_t Firmware;
+        uint32_t Crc;
+    };
+
+    static constexpr uint32_t _magic = 0x43444948; // "HIDC"
+    static constexpr uint8_t _version = 1;
+    static constexpr uint32_t _systemConfigSaveIntervalMs = 15 * 60 * 1000;
+
+    Task _loopTask;
+
+    std::mutex _mutex;
+    std::map<uint64_t, State> _states;
+};
+
+extern InverterDataCacheClass InverterDataCache;
@@ -2,6 +2,8 @@
 #pragma once
 
 #include <TaskSchedulerDeclarations.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <cstdint>
 
 #define INVERTER_UPDATE_SETTINGS_INTERVAL 60000l
@@ -13,10 +15,24 @@ public:
 
 private:
     void settingsLoop();
+    static void radioLoopHelper(void* context);
+    void radioLoop();
+
+    // hands command completions to the rest of the firmware
     void hoyLoop();
+    void updateNightMode(const bool isDayPeriod, const bool anyReachable);
 
     Task _settingsTask;
     Task _hoyTask;
+    TaskHandle_t _radioTaskHandle = nullptr;
+
+    static constexpr uint32_t _radioLoopIntervalMs = 1;
+    static constexpr uint32_t _hoyLoopIntervalMs = 20;
+
+    // the CPU frequency before night mode scaled it down, zero if it did not
+    uint32_t _cpuFrequencyMhz = 0;
+    static constexpr uint32_t _nightCpuFrequencyMhz = 80; // lowest one supporting WiFi
+    static constexpr uint32_t _nightModeSunriseLeadSeconds = 30 * 60;
 };
 
 extern InverterSettingsClass InverterSettings;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <memory>
+#include <optional>
 #include <vector>
 #include <frozen/string.h>
 
@@ -41,7 +43,10 @@ class Controller : public BatteryProvider {
 
         frozen::string const& getStatusText(Status status);
         void announceStatus(Status status);
-        void sendRequest(uint8_t pollInterval);
+        void sendRequest();
+        void startCycle();
+        void abortCycle() { _cycleIndex = _cycleLength; }
+        uint32_t getPollIntervalMs() const;
         void rxData(uint8_t inbyte);
         void reset();
         void frameComplete();
@@ -78,6 +83,27 @@ class Controller : public BatteryProvider {
         Status _lastStatus = Status::Initializing;
         uint32_t _lastStatusPrinted = 0;
         uint32_t _lastRequest = 0;
+
+        // a poll cycle consists of up to three requests, which are sent back
+        // to back. basic information (voltage, current, SoC) is requested in
+        // every cycle, cell voltages and the hardware version only in every
+        // n-th cycle. the poll interval is shortened for a while if the
+        // current changes quickly.
+        using Command = SerialCommand::Command;
+        std::array<Command, 3> _cycle = {};
+        size_t _cycleLength = 0;
+        size_t _cycleIndex = 0;
+        uint32_t _cycleCounter = 0;
+        uint32_t _lastCycleStart = 0;
+        std::optional<int32_t> _oLastCurrentMilliAmps = std::nullopt;
+        uint32_t _fastPollingUntil = 0;
+
+        static constexpr uint32_t _cellVoltagesEveryNthCycle = 4;
+        static constexpr uint32_t _hardwareVersionEveryNthCycle = 360;
+        static constexpr uint32_t _responseTimeoutMs = 1000;
+        static constexpr uint32_t _fastPollIntervalMs = 1000;
+        static constexpr uint32_t _fastPollingDurationMs = 30 * 1000;
+        static constexpr int32_t _fastPollingCurrentDeltaMilliAmps = 2000;
         uint8_t _dataLength = 0;
         JbdBms::SerialResponse::tData _buffer = {};
         std::shared_ptr<JbdBmsBatteryStats> _stats =
@@ -111,8 +111,10 @@ LABEL_TRAIT(ActualBatteryCapacityAmpHours,          uint32_t,    "Ah");
 using JbdBmsDataPoint = DataPoint<bool, uint8_t, uint16_t, uint32_t,
               int16_t, int32_t, std::string, JbdBms::tCells>;
 
-template class DataPointContainer<JbdBmsDataPoint, JbdBms::DataPointLabel, JbdBms::DataPointLabelTraits>;
+template class DataPointContainer<JbdBmsDataPoint, JbdBms::DataPointLabel, JbdBms::DataPointLabelTraits,
+                                  JbdBms::DataPointLabel::CellsMilliVolt, JbdBms::DataPointLabel::ActualBatteryCapacityAmpHours>;
 
 namespace JbdBms {
-    using DataPointContainer = DataPointContainer<JbdBmsDataPoint, DataPointLabel, DataPointLabelTraits>;
+    using DataPointContainer = DataPointContainer<JbdBmsDataPoint, DataPointLabel, DataPointLabelTraits,
+                                                  DataPointLabel::CellsMilliVolt, DataPointLabel::ActualBatteryCapacityAmpHours>;
 } /* namespace JbdBms */
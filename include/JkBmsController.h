@@ -1,7 +1,7 @@
 #pragma once
 
+#include <array>
 #include <memory>
-#include <vector>
 #include <frozen/string.h>
 
 #include "Battery.h"
@@ -78,7 +78,13 @@ class Controller : public BatteryProvider {
         uint32_t _lastRequest = 0;
         uint16_t _frameLength = 0;
         uint8_t _protocolVersion = -1;
-        SerialResponse::tData _buffer = {};
+
+        // frames are assembled and parsed in place, and the data points are
+        // updated in place, such that no memory is allocated per frame.
+        std::array<uint8_t, SerialMessage::maxFrameSize> _buffer = {};
+        size_t _bufferLength = 0;
+        DataPointContainer _dataPoints;
+
         std::shared_ptr<JkBmsBatteryStats> _stats =
             std::make_shared<JkBmsBatteryStats>();
 };
@@ -209,8 +209,10 @@ LABEL_TRAIT(ProtocolVersion,                        uint8_t,     "");
 using JkBmsDataPoint = DataPoint<bool, uint8_t, uint16_t, uint32_t,
               int16_t, int32_t, std::string, JkBms::tCells>;
 
-template class DataPointContainer<JkBmsDataPoint, JkBms::DataPointLabel, JkBms::DataPointLabelTraits>;
+template class DataPointContainer<JkBmsDataPoint, JkBms::DataPointLabel, JkBms::DataPointLabelTraits,
+                                  JkBms::DataPointLabel::CellsMilliVolt, JkBms::DataPointLabel::ProtocolVersion>;
 
 namespace JkBms {
-    using DataPointContainer = DataPointContainer<JkBmsDataPoint, DataPointLabel, DataPointLabelTraits>;
+    using DataPointContainer = DataPointContainer<JkBmsDataPoint, DataPointLabel, DataPointLabelTraits,
+                                                  DataPointLabel::CellsMilliVolt, DataPointLabel::ProtocolVersion>;
 } /* namespace JkBms */
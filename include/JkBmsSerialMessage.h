@@ -1,7 +1,7 @@
 #pragma once
 
+#include <array>
 #include <utility>
-#include <vector>
 #include <Arduino.h>
 
 #include "JkBmsDataPoints.h"
@@ -10,7 +10,27 @@ namespace JkBms {
 
 class SerialMessage {
     public:
-        using tData = std::vector<uint8_t>;
+        // non-owning view of the bytes of a frame (stand-in for std::span),
+        // such that messages can be parsed in place.
+        class tData {
+            public:
+                using const_iterator = uint8_t const*;
+
+                tData(uint8_t const* data, size_t size) : _data(data), _size(size) { }
+
+                const_iterator cbegin() const { return _data; }
+                const_iterator cend() const { return _data + _size; }
+                uint8_t const* data() const { return _data; }
+                size_t size() const { return _size; }
+                uint8_t operator[](size_t idx) const { return _data[idx]; }
+
+            private:
+                uint8_t const* _data;
+                size_t _size;
+        };
+
+        // no valid frame is expected to be larger than this
+        static constexpr size_t maxFrameSize = 512;
 
         SerialMessage() = delete;
 
@@ -53,41 +73,48 @@ class SerialMessage {
 
         bool isValid() const;
 
-        uint8_t const* data() { return _raw.data(); }
-        size_t size() { return _raw.size(); }
+        uint8_t const* data() const { return _raw.data(); }
+        size_t size() const { return _raw.size(); }
 
     protected:
-        template <typename... Args>
-        explicit SerialMessage(Args&&... args) : _raw(std::forward<Args>(args)...) { }
+        explicit SerialMessage(tData raw) : _raw(raw) { }
 
         template<typename T, typename It> T get(It&& pos) const;
         template<typename It> bool getBool(It&& pos) const;
         template<typename It> int16_t getTemperature(It&& pos) const;
         template<typename It> std::string getString(It&& pos, size_t len, bool replaceZeroes = false) const;
-        void processBatteryCurrent(tData::const_iterator& pos, uint8_t protocolVersion);
-        template<typename T> void set(tData::iterator const& pos, T val);
         uint16_t calcChecksum() const;
-        void updateChecksum();
 
         tData _raw;
-        JkBms::DataPointContainer _dp;
 
         static constexpr uint16_t startMarker = 0x4e57;
         static constexpr uint8_t endMarker = 0x68;
 };
 
+// parses the frame in place. the data points found in the frame are written
+// to the given container, which is expected to be reused for all frames,
+// such that the values may be updated in place.
 class SerialResponse : public SerialMessage {
     public:
-        using tData = SerialMessage::tData;
-        explicit SerialResponse(tData&& raw, uint8_t protocolVersion = -1);
+        explicit SerialResponse(tData raw, DataPointContainer& dp, uint8_t protocolVersion = -1);
 
         DataPointContainer const& getDataPoints() const { return _dp; }
+
+    private:
+        void processBatteryCurrent(tData::const_iterator& pos, uint8_t protocolVersion);
+
+        DataPointContainer& _dp;
 };
 
 class SerialCommand : public SerialMessage {
     public:
         using Command = SerialMessage::Command;
         explicit SerialCommand(Command cmd);
+
+    private:
+        template<typename T> void set(size_t offset, T val);
+
+        std::array<uint8_t, 20> _frame = {};
 };
 
 } /* namespace JkBms */
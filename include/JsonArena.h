@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+// a small pool of fixed-size memory blocks, allocated once during startup
+// (in PSRAM if available), which back short-lived JSON documents, e.g., the
+// documents created per web request or websocket update. this keeps these
+// documents from fragmenting the heap.
+class JsonArenaClass {
+public:
+    void init();
+
+    // returns nullptr if all blocks are in use
+    uint8_t* acquire();
+    void release(uint8_t* block);
+
+    size_t getBlockSize() const { return _blockSize; }
+
+    // called if a document needed more memory than a block provides
+    void countOverflow();
+
+    void serialize(JsonObject& target) const;
+
+private:
+    static constexpr size_t _maxBlocks = 4;
+
+    mutable std::mutex _mutex;
+    std::array<uint8_t*, _maxBlocks> _blocks = {};
+    std::array<bool, _maxBlocks> _inUse = {};
+    size_t _blockCount = 0;
+    size_t _blockSize = 0;
+    bool _psram = false;
+
+    uint32_t _acquisitions = 0;
+    uint32_t _exhausted = 0; // no block was available
+    uint32_t _overflows = 0; // a block was too small
+};
+
+extern JsonArenaClass JsonArena;
+
+// an ArduinoJson allocator which hands out memory from one block of the json
+// arena using a bump pointer. the block is acquired on first use and released
+// when the allocator is destroyed. if no block is available, or if the block
+// is used up, bulk memory is allocated from the heap instead. the allocator must
+// outlive the JsonDocument using it, i.e., declare it first:
+//
+//     JsonArenaAllocator allocator;
+//     JsonDocument doc(&allocator);
+class JsonArenaAllocator : public ArduinoJson::Allocator {
+public:
+    JsonArenaAllocator() = default;
+    ~JsonArenaAllocator();
+
+    JsonArenaAllocator(JsonArenaAllocator const&) = delete;
+    JsonArenaAllocator& operator=(JsonArenaAllocator const&) = delete;
+
+    void* allocate(size_t size) override;
+    void deallocate(void* ptr) override;
+    void* reallocate(void* ptr, size_t newSize) override;
+
+private:
+    // every allocation within the block is preceeded by its size
+    static constexpr size_t _alignment = 8;
+    static constexpr size_t _headerSize = _alignment;
+
+    bool owns(void* ptr) const;
+    static size_t& sizeOf(void* ptr);
+    void* allocateFromBlock(size_t size);
+
+    uint8_t* _block = nullptr;
+    bool _blockRequested = false;
+    size_t _used = 0;
+    void* _last = nullptr; // most recent allocation within the block
+};
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// a JSON path as understood by Utils::getJsonValueByPath(), i.e., keys and
+// array indices ("[n]") separated by forward slashes, which is split into its
+// segments once. the value is then located by scanning the JSON text, without
+// building a document, such that frequently received payloads are processed
+// without heap allocations. the text is not validated beyond the parts which
+// are scanned. an empty path refers to the payload itself.
+class JsonPath {
+public:
+    explicit JsonPath(String const& path);
+    JsonPath() : JsonPath(String()) { }
+
+    bool isEmpty() const { return _segments.empty(); }
+
+    // returns the value at the path, which must be a number or a string
+    // containing a number, and an empty string, or an error message.
+    std::pair<float, String> getFloat(char const* json, size_t len) const;
+
+private:
+    struct Segment {
+        String Key; // empty for array indices
+        int32_t Index;
+    };
+
+    String _path;
+    std::vector<Segment> _segments;
+};
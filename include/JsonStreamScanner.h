@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <WString.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// extracts the numbers found at a set of paths from a JSON text which is
+// passed in arbitrary chunks, e.g., as it arrives from the network, such
+// that the text is neither buffered nor deserialized as a whole. a path
+// consists of the object keys separated by dots ("params.em:0.act_power"),
+// array elements are not addressed.
+class JsonStreamScanner {
+public:
+    explicit JsonStreamScanner(std::vector<String> const& paths);
+
+    using callback_t = std::function<void(size_t pathIndex, float value)>;
+
+    // prepares for the next JSON text
+    void reset();
+
+    // returns false once the text turned out to be malformed, after which
+    // the remaining chunks of the text are ignored.
+    bool feed(char const* data, size_t length, callback_t const& callback);
+
+    // true if a complete JSON text was scanned
+    bool isComplete() const { return _state == State::Done; }
+
+private:
+    bool consume(char c, callback_t const& callback);
+    bool beginValue(char c);
+    void endContainer();
+    void endNumber(callback_t const& callback);
+
+    enum class State : uint8_t {
+        Value,
+        ObjectKey,
+        Colon,
+        AfterValue,
+        String,
+        Number,
+        Literal,
+        Done,
+        Error
+    };
+
+    static constexpr size_t _maxDepth = 6;
+    static constexpr size_t _maxKeyLength = 23;
+
+    struct Level {
+        bool IsArray;
+        bool KeyOverflow; // the key is longer than supported
+        uint8_t KeyLength;
+        char Key[_maxKeyLength + 1];
+    };
+
+    std::vector<std::vector<String>> _paths;
+
+    State _state = State::Value;
+    bool _stringIsKey = false;
+    bool _escape = false;
+    size_t _depth = 0; // levels deeper than _maxDepth are counted only
+    std::array<Level, _maxDepth> _levels;
+    char _number[24];
+    uint8_t _numberLength = 0;
+};
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "MessageOutput.h"
+#include <pgmspace.h>
+
+// leveled and tagged log messages. messages with a level above DTU_LOG_LEVEL
+// are removed at compile time, including the evaluation of their arguments.
+// all other messages are filtered at runtime by the level configured for
+// their tag (see MessageOutputClass::setLogLevel()), before the message is
+// formatted. usage:
+//
+//     DTU_LOGI("PowerMeter", "new reading: %.1f W", value);
+//
+// the format string must be a string literal. a line break is appended.
+#define DTU_LOG_LEVEL_NONE    0
+#define DTU_LOG_LEVEL_ERROR   1
+#define DTU_LOG_LEVEL_WARN    2
+#define DTU_LOG_LEVEL_INFO    3
+#define DTU_LOG_LEVEL_DEBUG   4
+#define DTU_LOG_LEVEL_VERBOSE 5
+
+#ifndef DTU_LOG_LEVEL
+#define DTU_LOG_LEVEL DTU_LOG_LEVEL_DEBUG
+#endif
+
+#define DTU_LOG(level, tag, fmt, ...) \
+    do { \
+        if (MessageOutput.isLogLevelEnabled(tag, level)) { \
+            MessageOutput.log(level, tag, PSTR(fmt), ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define DTU_LOG_DISABLED(tag, fmt, ...) do { } while (0)
+
+#if DTU_LOG_LEVEL >= DTU_LOG_LEVEL_ERROR
+#define DTU_LOGE(tag, fmt, ...) DTU_LOG(DTU_LOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#else
+#define DTU_LOGE(tag, fmt, ...) DTU_LOG_DISABLED(tag, fmt)
+#endif
+
+#if DTU_LOG_LEVEL >= DTU_LOG_LEVEL_WARN
+#define DTU_LOGW(tag, fmt, ...) DTU_LOG(DTU_LOG_LEVEL_WARN, tag, fmt, ##__VA_ARGS__)
+#else
+#define DTU_LOGW(tag, fmt, ...) DTU_LOG_DISABLED(tag, fmt)
+#endif
+
+#if DTU_LOG_LEVEL >= DTU_LOG_LEVEL_INFO
+#define DTU_LOGI(tag, fmt, ...) DTU_LOG(DTU_LOG_LEVEL_INFO, tag, fmt, ##__VA_ARGS__)
+#else
+#define DTU_LOGI(tag, fmt, ...) DTU_LOG_DISABLED(tag, fmt)
+#endif
+
+#if DTU_LOG_LEVEL >= DTU_LOG_LEVEL_DEBUG
+#define DTU_LOGD(tag, fmt, ...) DTU_LOG(DTU_LOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
+#else
+#define DTU_LOGD(tag, fmt, ...) DTU_LOG_DISABLED(tag, fmt)
+#endif
+
+#if DTU_LOG_LEVEL >= DTU_LOG_LEVEL_VERBOSE
+#define DTU_LOGV(tag, fmt, ...) DTU_LOG(DTU_LOG_LEVEL_VERBOSE, tag, fmt, ##__VA_ARGS__)
+#else
+#define DTU_LOGV(tag, fmt, ...) DTU_LOG_DISABLED(tag, fmt)
+#endif
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// a measured value as a scaled integer, i.e., Mantissa * 10^Exponent, which
+// is how most meters and BMSs transmit their values. formatting is exact and
+// does not allocate, conversion to float is only needed for calculations.
+struct Measurement {
+    int32_t Mantissa = 0;
+    int8_t Exponent = 0;
+
+    // the value mantissa * 10^exponent expressed with the target exponent.
+    // rounds half away from zero and saturates if the mantissa overflows.
+    static Measurement fromScaled(int64_t mantissa, int8_t exponent, int8_t targetExponent);
+    static Measurement fromFloat(float value, int8_t targetExponent);
+
+    Measurement rescaled(int8_t exponent) const { return fromScaled(Mantissa, Exponent, exponent); }
+
+    float toFloat() const;
+
+    // writes the decimal representation, e.g., "-12.34" for -1234 * 10^-2,
+    // and returns its length. returns zero and writes an empty string if
+    // the buffer is too small.
+    size_t format(char* buffer, size_t size) const;
+
+    // sufficient for exponents between -12 and 12
+    static constexpr size_t MaxTextSize = 25;
+
+    bool operator==(Measurement const& other) const {
+        return Mantissa == other.Mantissa && Exponent == other.Exponent;
+    }
+    bool operator!=(Measurement const& other) const { return !(*this == other); }
+};
+
+// the values of a set of fields, each stored with the fixed decimal exponent
+// of its field, along with a validity mask and the time of the snapshot.
+// comparing snapshots is an integer compare. Field is an enum whose values
+// index the exponents.
+template<typename Field, size_t N>
+class MeasurementSnapshot {
+    static_assert(N <= 32, "the validity mask holds 32 fields");
+
+public:
+    using exponents_t = std::array<int8_t, N>;
+
+    // the exponents must have static storage duration
+    explicit constexpr MeasurementSnapshot(exponents_t const& exponents)
+        : _pExponents(&exponents) { }
+
+    int8_t exponent(Field field) const { return (*_pExponents)[index(field)]; }
+
+    void set(Field field, Measurement value) {
+        auto i = index(field);
+        _values[i] = value.rescaled((*_pExponents)[i]).Mantissa;
+        _valid |= 1UL << i;
+    }
+
+    void set(Field field, float value) {
+        auto i = index(field);
+        _values[i] = Measurement::fromFloat(value, (*_pExponents)[i]).Mantissa;
+        _valid |= 1UL << i;
+    }
+
+    bool has(Field field) const { return (_valid & (1UL << index(field))) != 0; }
+
+    std::optional<Measurement> getMeasurement(Field field) const {
+        if (!has(field)) { return std::nullopt; }
+        auto i = index(field);
+        return Measurement { _values[i], (*_pExponents)[i] };
+    }
+
+    std::optional<float> get(Field field) const {
+        auto value = getMeasurement(field);
+        if (!value) { return std::nullopt; }
+        return value->toFloat();
+    }
+
+    void clear() {
+        _values = {};
+        _valid = 0;
+        _timestamp = 0;
+    }
+
+    uint32_t getTimestamp() const { return _timestamp; }
+    void setTimestamp(uint32_t millis) { _timestamp = millis; }
+
+    // the values only, regardless of the time they were taken
+    bool operator==(MeasurementSnapshot const& other) const {
+        return _valid == other._valid && _values == other._values;
+    }
+    bool operator!=(MeasurementSnapshot const& other) const { return !(*this == other); }
+
+private:
+    static constexpr size_t index(Field field) { return static_cast<size_t>(field); }
+
+    exponents_t const* _pExponents;
+    std::array<int32_t, N> _values = {}; // zero if not valid
+    uint32_t _valid = 0;
+    uint32_t _timestamp = 0;
+};
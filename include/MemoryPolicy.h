@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// decides where buffers are placed. setup() already moves every allocation
+// above a threshold to PSRAM (if available), which is a matter of size
+// rather than of use. buffers which are large and rarely accessed should
+// be allocated as Bulk, such that they end up in PSRAM regardless of their
+// size. buffers used from ISRs, by DMA, or on the radio path must be
+// allocated as Internal. internal RAM is scarce and better left to lwIP and
+// TLS, which cannot use PSRAM.
+class MemoryPolicy {
+public:
+    enum class Placement : uint8_t {
+        Bulk, // PSRAM if available, internal RAM otherwise
+        Internal // always internal RAM
+    };
+
+    static bool hasPsram();
+
+    // memory obtained from these functions must be released using release()
+    static void* allocate(size_t size, Placement placement);
+    static void* reallocate(void* ptr, size_t size, Placement placement);
+    static void release(void* ptr);
+
+    // for JsonDocuments holding, e.g., Home Assistant discovery payloads:
+    //     JsonDocument doc(MemoryPolicy::getBulkJsonAllocator());
+    static ArduinoJson::Allocator* getBulkJsonAllocator();
+
+    // for containers which grow large, e.g., std::vector<T, BulkAllocator<T>>
+    template<typename T>
+    struct BulkAllocator {
+        using value_type = T;
+
+        BulkAllocator() = default;
+        template<typename U>
+        BulkAllocator(BulkAllocator<U> const&) { }
+
+        T* allocate(size_t n)
+        {
+            void* ptr = MemoryPolicy::allocate(n * sizeof(T), Placement::Bulk);
+            if (ptr == nullptr) { throw std::bad_alloc(); }
+            return static_cast<T*>(ptr);
+        }
+
+        void deallocate(T* ptr, size_t) { MemoryPolicy::release(ptr); }
+
+        template<typename U>
+        bool operator==(BulkAllocator<U> const&) const { return true; }
+        template<typename U>
+        bool operator!=(BulkAllocator<U> const&) const { return false; }
+    };
+
+    template<typename T>
+    using BulkVector = std::vector<T, BulkAllocator<T>>;
+};
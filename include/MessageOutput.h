@@ -4,12 +4,19 @@
 #include <AsyncWebSocket.h>
 #include <TaskSchedulerDeclarations.h>
 #include <Print.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
 #include <freertos/task.h>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <unordered_map>
 #include <queue>
 
+class WebApiWsHubClass;
+
 class MessageOutputClass : public Print {
 public:
     MessageOutputClass();
@@ -17,25 +24,98 @@ public:
     size_t write(uint8_t c) override;
     size_t write(const uint8_t* buffer, size_t size) override;
     void register_ws_output(AsyncWebSocket* output);
+    void register_ws_hub(WebApiWsHubClass* hub);
 
-private:
-    void loop();
+    // the most recent output, starting with a complete line, which is sent
+    // to console clients when they connect. empty if nothing was output yet.
+    std::shared_ptr<std::vector<uint8_t>> getBacklog() const;
+
+    // leveled and tagged messages, use the macros from Logging.h
+    bool isLogLevelEnabled(char const* tag, uint8_t level) const;
+    void log(uint8_t level, char const* tag, char const* format, ...) __attribute__((format(printf, 4, 5)));
+
+    // the tag "*" changes the level of all tags without explicit level.
+    // returns false if no more tags can be added.
+    bool setLogLevel(char const* tag, uint8_t level);
+    uint8_t getLogLevel(char const* tag) const;
+    void printLogLevels();
 
-    Task _loopTask;
+    static char const* getLogLevelName(uint8_t level);
+    static bool parseLogLevel(char const* name, uint8_t& level);
+
+private:
+    static void drainLoopHelper(void* context);
+    void drainLoop();
 
     using message_t = std::vector<uint8_t>;
 
-    // we keep a buffer for every task and only write complete lines to the
-    // serial output and then move them to be pushed through the websocket.
-    // this way we prevent mangling of messages from different contexts.
-    std::unordered_map<TaskHandle_t, message_t> _task_messages;
-    std::queue<message_t> _lines;
+    void output(uint8_t const* data, size_t size);
+    void serialWrite(uint8_t const* data, size_t size);
+    void appendBacklog(uint8_t const* data, size_t size);
+
+    // writers never block. every task assembles its current line in a slot it
+    // owns until the line is complete, such that messages from different
+    // contexts are not mangled. complete lines are put into a ring buffer,
+    // which is drained by a separate task into the serial port, the syslog
+    // and the websocket.
+    static constexpr size_t _slotCount = 12;
+    static constexpr size_t _lineSize = 256; // longer lines are split
+    static constexpr size_t _ringBufferSize = 4096;
+
+    struct Slot {
+        std::atomic<TaskHandle_t> Owner = nullptr;
+        size_t Length = 0;
+        std::array<uint8_t, _lineSize> Data;
+    };
+
+    Slot* acquireSlot();
+    void releaseSlot(Slot& slot);
+    void commitLine(Slot& slot);
+    void releaseOrphanedSlots();
+
+    std::array<Slot, _slotCount> _slots;
+    RingbufHandle_t _ringBuffer = nullptr;
+    TaskHandle_t _drainTaskHandle = nullptr;
+
+    // the drain task collects the lines that are available into one batch,
+    // such that the sinks are invoked (e.g., a websocket frame is sent) once
+    // per batch rather than once per line.
+    static constexpr size_t _batchSize = 1024;
+    std::array<uint8_t, _batchSize> _batch;
+
+    // the output is also kept in a ring of bytes, allocated in init()
+    static constexpr size_t _backlogSize = 4096;
+    uint8_t* _backlog = nullptr;
+    size_t _backlogStart = 0; // of the oldest byte
+    size_t _backlogLength = 0;
+    bool _backlogWrapped = false; // the oldest line is incomplete
+    mutable std::mutex _backlogMutex;
+
+    // lines discarded because the ring buffer was full or because no slot
+    // was available. reported by the drain task.
+    std::atomic<uint32_t> _droppedLines = 0;
+    uint32_t _reportedDroppedLines = 0;
+
+    std::atomic<AsyncWebSocket*> _ws = nullptr;
+    std::atomic<WebApiWsHubClass*> _wsHub = nullptr;
+
+    // tags are only ever added, such that they can be looked up by the
+    // logging tasks without locking.
+    static constexpr size_t _maxLogTags = 24;
+    static constexpr size_t _maxLogTagLength = 16;
 
-    AsyncWebSocket* _ws = nullptr;
+    struct LogTag {
+        std::array<char, _maxLogTagLength> Name = {};
+        std::atomic<uint8_t> Level = 0;
+    };
 
-    std::mutex _msgLock;
+    LogTag const* findLogTag(char const* tag) const;
 
-    void serialWrite(message_t const& m);
+    std::array<LogTag, _maxLogTags> _logTags;
+    std::atomic<size_t> _logTagCount = 0;
+    std::atomic<uint8_t> _defaultLogLevel;
+    std::atomic<uint8_t> _maxLogLevel; // of all tags, fast path to skip messages
+    std::mutex _logTagMutex; // serializes changing the tags
 };
 
 extern MessageOutputClass MessageOutput;
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Configuration.h"
+#include "HttpGetter.h"
+#include "HttpPoller.h"
+#include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// pushes the samples of the metrics registry to an endpoint accepting the
+// InfluxDB line protocol, e.g., InfluxDB (/write or /api/v2/write),
+// VictoriaMetrics or Telegraf. the registry is sampled at the configured
+// interval, and the samples collected since are sent gzip-compressed as
+// one request per push interval. while the endpoint is unreachable, the
+// samples are kept in a bounded buffer, which discards its oldest samples
+// once it is full.
+//
+// each value is sent as one line, named like the Prometheus metric, with
+// the hostname and the metric's labels as tags and a timestamp in ns:
+//   opendtu_http_busy_rejections,host=opendtu,lane=live value=3 <timestamp>
+class MetricsPushClass {
+public:
+    void init(Scheduler& scheduler);
+
+private:
+    void loop();
+    void updateSettings();
+    void sample();
+    bool push(); // called by the HTTP poller's task
+
+    void registerMetrics();
+
+    static void appendEscaped(std::string& out, char const* text, size_t len, char const* special);
+    static void appendLine(std::string& out, std::string const& hostTag,
+            char const* name, char const* labels, float value, int64_t epochMillis);
+
+    Task _loopTask;
+
+    // the settings the HTTP getter was created from
+    std::atomic<bool> _enabled = false; // also read by the metrics exporter
+    HttpRequestConfig _httpConfig = {};
+    std::unique_ptr<HttpGetter> _upHttpGetter = nullptr;
+    HttpPollerClass::job_id_t _pollerJob = 0;
+
+    uint32_t _lastSampleMillis = 0;
+    std::string _hostTag; // escaped hostname
+
+    struct Round {
+        uint32_t Sequence;
+        int64_t EpochMillis;
+        std::vector<float> Values; // by registry index, NaN if without value
+    };
+
+    // rounds are appended by the sampling task and removed by the poller's
+    // task once they were pushed
+    std::mutex _mutex;
+    std::deque<Round> _rounds;
+    uint32_t _sequence = 0;
+
+    // the number of values buffered at most, and the number of rounds sent
+    // per request at most, such that a backlog is sent in portions
+    static constexpr size_t _maxBufferedValues = 8 * 1024;
+    static constexpr size_t _maxRoundsPerPush = 30;
+
+    // read by the metrics exporter
+    std::atomic<uint32_t> _droppedRounds = 0;
+    std::atomic<uint32_t> _pushFailures = 0;
+    std::atomic<uint32_t> _bufferedRounds = 0;
+};
+
+extern MetricsPushClass MetricsPush;
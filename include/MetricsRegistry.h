@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// the scalar metrics of the subsystems, registered once by each subsystem
+// and exported by iterating the registry. a metric is identified by its name
+// and static labels, e.g., R"(phase="1")". values are pulled through the
+// getters of the metrics and kept in one contiguous array, which is refreshed
+// in place at most once per second, regardless of the number of exporters.
+// metrics without a value, e.g., of a disabled subsystem, are skipped.
+class MetricsRegistryClass {
+public:
+    enum class Type : uint8_t {
+        Gauge,
+        Counter
+    };
+
+    using getter_t = std::function<std::optional<float>()>;
+
+    // name, help and labels must outlive the registry, i.e., be literals
+    void add(char const* name, char const* help, Type type, getter_t getter, char const* labels = nullptr);
+
+    struct Sample {
+        char const* Name;
+        char const* Help;
+        Type MetricType;
+        char const* Labels; // nullptr if without labels
+        float Value;
+    };
+
+    // refreshes the values unless they were refreshed within the last second
+    void collect();
+
+    // the number of registered metrics, samples of a metric family are
+    // adjacent to each other.
+    size_t size() const;
+
+    // the sample with the given index as of the last collect(). returns
+    // false if the index is out of range or the metric has no value.
+    bool getSample(size_t index, Sample& sample) const;
+
+    // like getSample(), but also for metrics without a value, whose value
+    // is NaN then. returns false if the index is out of range only.
+    bool getMetric(size_t index, Sample& sample) const;
+
+    static char const* getTypeName(Type type);
+
+private:
+    struct Metric {
+        char const* Name;
+        char const* Help;
+        Type MetricType;
+        char const* Labels;
+        getter_t Getter;
+    };
+
+    mutable std::mutex _mutex;
+    std::vector<Metric> _metrics;
+    std::vector<float> _values;
+    std::vector<bool> _valid;
+    uint32_t _lastCollectMillis = 0;
+    bool _collected = false;
+};
+
+extern MetricsRegistryClass MetricsRegistry;
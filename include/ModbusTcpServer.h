@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <AsyncTCP.h>
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// serves readings as Modbus TCP holding/input registers (function codes 3
+// and 4) and accepts writes to the control registers of each inverter
+// (function codes 6 and 16) if allowed by the settings. reads are served
+// from a snapshot of all registers, which is updated once per second, such
+// that requests never access the data sources directly.
+//
+// values of type f32 occupy two registers (IEEE 754, high word first) and
+// are NaN if unknown, u64 values occupy four registers (high word first).
+//
+//   0: register map version          1: number of inverters
+//   2: total AC power (f32, W)       4: total yield day (f32, Wh)
+//   6: total yield total (f32, kWh)  8: total DC power (f32, W)
+//  10: flags (bit 0: all enabled reachable, bit 1: at least one producing)
+//  20: battery SoC (f32, %)         22: battery voltage (f32, V)
+//  24: battery current (f32, A)     26: battery data age (s)
+//  30: power meter power (f32, W)   32: power meter data valid
+//  40: DPL state                    41: DPL mode
+//  42: DPL expected inverter output (W)
+//  43: DPL inverter update timeouts
+//
+// inverter i (in order of the inverter list) starts at register
+// 100 + 100 * i:
+//   +0: serial (u64)                 +4: flags (bit 0: reachable,
+//                                        bit 1: producing)
+//   +5: current limit (0.1 %)        +6: AC power (f32, W)
+//   +8: AC voltage (f32, V)         +10: AC current (f32, A)
+//  +12: frequency (f32, Hz)         +14: power factor (f32)
+//  +16: temperature (f32, °C)       +18: efficiency (f32, %)
+//  +20: yield day (f32, Wh)         +22: yield total (f32, kWh)
+//  +24: DC power (f32, W)           +26: data age (s)
+//  +30 + 10 * c: DC input c (up to 6): power (f32, W), voltage (f32, V),
+//                current (f32, A), yield day (f32, Wh), yield total (f32, kWh)
+// control registers, which read as zero:
+//  +90: set non-persistent limit (0.1 %)
+//  +91: set non-persistent limit (W)
+//  +92: power on (1) or off (0)
+//  +93: restart (1)
+class ModbusTcpServerClass {
+public:
+    void init(Scheduler& scheduler);
+
+    static constexpr uint16_t MapVersion = 1;
+
+private:
+    void loop();
+    void updateSnapshot();
+    void start(uint16_t port);
+    void stop();
+
+    void onClient(AsyncClient* client);
+    void onData(AsyncClient* client, std::vector<uint8_t>& rx, uint8_t const* data, size_t len);
+
+    // handles the PDU of one request and returns the PDU of the response
+    std::vector<uint8_t> handleRequest(uint8_t const* pdu, size_t len);
+    std::vector<uint8_t> handleRead(uint8_t function, uint16_t address, uint16_t count);
+    std::vector<uint8_t> handleWrite(uint8_t function, uint16_t address, uint16_t const* values, uint16_t count);
+    static std::vector<uint8_t> exception(uint8_t function, uint8_t code);
+
+    // returns zero or the exception code to respond with
+    uint8_t writeControlRegister(std::shared_ptr<InverterAbstract> const& inv, uint16_t offset, uint16_t value);
+
+    static constexpr uint16_t _inverterBase = 100;
+    static constexpr uint16_t _inverterSize = 100;
+    static constexpr uint16_t _controlOffset = 90;
+    static constexpr uint16_t _controlCount = 4;
+    static constexpr uint16_t _maxReadCount = 125;
+    static constexpr uint16_t _maxWriteCount = 123;
+    static constexpr size_t _maxClients = 4;
+
+    Task _loopTask;
+    std::unique_ptr<AsyncServer> _upServer;
+    uint16_t _port = 0;
+    std::atomic<size_t> _clients = 0;
+
+    using registers_t = std::vector<uint16_t>;
+    std::shared_ptr<registers_t const> _spRegisters;
+};
+
+extern ModbusTcpServerClass ModbusTcpServer;
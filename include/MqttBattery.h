@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include <optional>
 #include "Battery.h"
 #include <espMqttClient.h>
@@ -13,11 +14,15 @@ public:
     void loop() final { return; } // this class is event-driven
     std::shared_ptr<BatteryStats> getStats() const final { return _stats; }
 
+    // the stats are updated from the MQTT task
+    std::shared_ptr<BatteryStats const> getSnapshot() final;
+
 private:
     bool _verboseLogging = false;
     String _socTopic;
     String _voltageTopic;
     String _dischargeCurrentLimitTopic;
+    std::mutex _mutex;
     std::shared_ptr<MqttBatteryStats> _stats = std::make_shared<MqttBatteryStats>();
     uint8_t _socPrecision = 0;
 
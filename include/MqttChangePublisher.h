@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <cstdio>
+#include <vector>
+
+// publishes a fixed set of values, each identified by its index, and skips
+// values identical to the one published last. all values are published
+// again after reset(), e.g., after reconnecting to the broker, and once per
+// refresh interval, such that a broker which lost them gets them back.
+class MqttChangePublisher {
+public:
+    explicit MqttChangePublisher(size_t count);
+
+    // true if the next round publishes all values
+    bool isRefreshDue() const;
+
+    // to be called before publishing the values of a round
+    void beginRound();
+
+    void publish(size_t index, char const* subtopic, char const* payload);
+
+    template<typename... Args>
+    void publishf(size_t index, char const* subtopic, char const* format, Args... args)
+    {
+        char payload[24];
+        snprintf(payload, sizeof(payload), format, args...);
+        publish(index, subtopic, payload);
+    }
+
+    void reset() { _refreshPending = true; }
+
+private:
+    static constexpr uint32_t _refreshIntervalMs = 60 * 1000;
+
+    std::vector<String> _payloads;
+    uint32_t _lastRefresh = 0;
+    bool _refreshPending = true;
+    bool _refreshing = false;
+};
@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "MqttChangePublisher.h"
 #include <TaskSchedulerDeclarations.h>
+#include <atomic>
 #include <cstdint>
 
 class MqttHandleDtuClass {
@@ -9,10 +11,30 @@ public:
     MqttHandleDtuClass();
     void init(Scheduler& scheduler);
 
+    // publishes all values during the next round, even if unchanged
+    void forceUpdate() { _forceUpdate = true; }
+
 private:
     void loop();
 
+    enum Value : size_t {
+        Uptime,
+        Ip,
+        Hostname,
+        HeapSize,
+        HeapFree,
+        HeapMinFree,
+        HeapMaxAlloc,
+        Rssi,
+        Bssid,
+        Temperature,
+        Count
+    };
+
     Task _loopTask;
+    MqttChangePublisher _publisher { Value::Count };
+    std::atomic<bool> _forceUpdate = false;
+    bool _wasConnected = false;
 };
 
 extern MqttHandleDtuClass MqttHandleDtu;
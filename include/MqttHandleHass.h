@@ -74,6 +74,7 @@ public:
 
 private:
     void loop();
+    void publishNextStep();
     static void publish(const String& subtopic, const String& payload);
     static void publish(const String& subtopic, const JsonDocument& doc);
 
@@ -102,6 +103,7 @@ private:
 
     bool _wasConnected = false;
     bool _updateForced = false;
+    int16_t _nextPublishStep = -1; // -1 if idle
 };
 
 extern MqttHandleHassClass MqttHandleHass;
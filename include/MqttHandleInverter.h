@@ -4,6 +4,11 @@
 #include "Configuration.h"
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <espMqttClient.h>
 #include <frozen/map.h>
 #include <frozen/string.h>
@@ -18,15 +23,91 @@ public:
     void subscribeTopics();
     void unsubscribeTopics();
 
+    // publishes all values during the next round, even if unchanged
+    void forceUpdate() { _forceUpdate = true; }
+
 private:
     void loop();
-    void publishField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
+    void publishInverter(const uint8_t idx);
+
+    // values are only published if they changed (by more than the deadband
+    // of the respective field) or if they were not published for a while.
+    struct PublishedField {
+        // full topic including the prefix, formatted once when the value is
+        // published first and shared with the outbox of MqttSettings.
+        std::shared_ptr<const String> spTopic;
+        float Value = 0; // last published value
+        uint32_t LastPublish = 0;
+        bool Published = false;
+    };
+
+    // values other than channel fields are compared by their payload
+    struct PublishedValue : PublishedField {
+        String Payload; // last published payload
+    };
+
+    static constexpr size_t _publishFieldCount = 14;
+
+    struct ChannelCache {
+        ChannelType_t Type = TYPE_AC;
+        ChannelNum_t Channel = CH0;
+        PublishedValue Name; // of DC channels
+        std::array<PublishedField, _publishFieldCount> Fields; // as in _publishFields
+    };
+
+    // values which are not channel fields, as index into InverterCache::Values
+    enum class Value : uint8_t {
+        Name = 0,
+        TxRequest,
+        TxReRequest,
+        RxSuccess,
+        RxFailNothing,
+        RxFailPartial,
+        RxFailCorrupt,
+        RxDropped,
+        Rssi,
+        BootloaderVersion,
+        FwBuildVersion,
+        FwBuildDateTime,
+        HwPartNumber,
+        HwVersion,
+        LimitRelative,
+        LimitAbsolute,
+        Reachable,
+        Producing,
+        LastUpdate,
+        Count
+    };
+
+    struct InverterCache {
+        uint64_t Serial = 0;
+        std::array<PublishedValue, static_cast<size_t>(Value::Count)> Values;
+        std::vector<ChannelCache> Channels; // in the order they are published
+    };
+
+    void publishField(PublishedField& field, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const float deadband);
+    PublishedValue& getValue(const uint8_t idx, const Value key, const char* subtopic);
+    ChannelCache& getChannel(const uint8_t idx, const size_t pos, const ChannelType_t type, const ChannelNum_t channel);
+    void publishValue(PublishedValue& value, const char* payload);
+    void publishValue(PublishedValue& value, const String& payload);
+    void publishValue(PublishedField& field, const float numeric, const float deadband, const uint8_t digits);
+    void markPublished(PublishedField& field);
+
+    static std::shared_ptr<const String> makeTopic(const String& subtopic);
+    bool isExpired(PublishedField const& field) const;
+
+    static float getDeadband(const FieldId_t fieldId);
 
     Task _loopTask;
 
-    uint32_t _lastPublishStats[INV_MAX_COUNT] = { 0 };
+    // per inverter position, grown on demand
+    std::vector<uint32_t> _lastPublishStats;
+    std::vector<InverterCache> _cache;
+    uint8_t _nextInverter = 0;
+    bool _wasConnected = false;
+    std::atomic<bool> _forceUpdate = false;
 
-    FieldId_t _publishFields[14] = {
+    FieldId_t _publishFields[_publishFieldCount] = {
         FLD_UDC,
         FLD_IDC,
         FLD_PDC,
@@ -65,6 +146,34 @@ private:
     };
 
     void onMqttMessage(Topic t, const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total);
+
+    // limits for several inverters are set with a single JSON message to
+    // the bulk topic. the batch is validated as a whole and either rejected
+    // or enqueued entirely. the outcome for each inverter is published to
+    // the result topic as soon as all inverters acknowledged (or timed out).
+    static constexpr frozen::string _limitBatchTopic = "cmd/limits";
+    static constexpr uint32_t _limitBatchTimeoutMs = 30 * 1000;
+
+    struct LimitBatch {
+        String Id; // chosen by the client to match the result
+        uint32_t Started;
+
+        struct Target {
+            std::shared_ptr<InverterAbstract> spInverter;
+            uint32_t CommandId; // zero if not enqueued
+            LastCommandSuccess Result;
+        };
+        std::vector<Target> Targets;
+    };
+
+    void onLimitBatchMessage(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total);
+    void limitBatchLoop();
+    static void publishLimitBatchResult(LimitBatch const& batch, bool timedOut);
+    static void publishLimitBatchRejection(String const& id, String const& error);
+
+    Task _limitBatchTask;
+    std::mutex _limitBatchMutex;
+    std::vector<LimitBatch> _limitBatches;
 };
 
 extern MqttHandleInverterClass MqttHandleInverter;
@@ -1,17 +1,39 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "MqttChangePublisher.h"
 #include <TaskSchedulerDeclarations.h>
+#include <atomic>
 
 class MqttHandleInverterTotalClass {
 public:
     MqttHandleInverterTotalClass();
     void init(Scheduler& scheduler);
 
+    // publishes all values during the next round, even if unchanged
+    void forceUpdate() { _forceUpdate = true; }
+
 private:
     void loop();
 
+    enum Value : size_t {
+        AcPower,
+        AcYieldTotal,
+        AcYieldDay,
+        AcIsValid,
+        DcPower,
+        DcIrradiation,
+        DcIsValid,
+        Count
+    };
+
     Task _loopTask;
+    MqttChangePublisher _publisher { Value::Count };
+
+    // raised by the Datastore whenever the totals changed
+    std::atomic<bool> _updated = true;
+    std::atomic<bool> _forceUpdate = false;
+    bool _wasConnected = false;
 };
 
 extern MqttHandleInverterTotalClass MqttHandleInverterTotal;
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+// publishes Home Assistant auto discovery messages on behalf of all
+// integrations. a hash of each payload is kept per topic, and messages are
+// only published if their payload changed. the cache is cleared once Home
+// Assistant announces that it (re-)started using its birth message.
+class MqttHassPublisherClass {
+public:
+    MqttHassPublisherClass();
+    void init(Scheduler& scheduler);
+
+    void publish(const String& subtopic, const String& payload);
+
+    // publish all messages again, even if their payload did not change
+    void invalidate();
+
+private:
+    void loop();
+    void subscribeTopics();
+    void unsubscribeTopics();
+
+    static uint32_t hash(const String& value);
+
+    Task _loopTask;
+
+    std::mutex _mutex;
+    std::unordered_map<uint32_t, uint32_t> _payloadHashes; // by topic hash
+
+    String _birthTopic;
+    std::atomic<bool> _birthReceived = false;
+};
+
+extern MqttHassPublisherClass MqttHassPublisher;
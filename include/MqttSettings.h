@@ -5,8 +5,26 @@
 #include <MqttSubscribeParser.h>
 #include <Ticker.h>
 #include <espMqttClient.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 
+// messages are queued and published by a separate task, such that a slow
+// broker does not delay the callers. the queue of each priority is bounded,
+// the oldest messages are dropped first. discovery messages are never
+// dropped, as they are retained and only published again once they change.
+// their publishers shall wait for room instead, see hasOutboxRoom().
+enum class MqttPublishPriority : uint8_t {
+    Control = 0, // DPL state and other values used to control devices
+    Discovery, // Home Assistant auto discovery
+    Telemetry, // everything else
+    Count
+};
+
 class MqttSettingsClass {
 public:
     MqttSettingsClass();
@@ -14,8 +32,30 @@ public:
     void loop();
     void performReconnect();
     bool getConnected();
-    void publish(const String& subtopic, const String& payload);
-    void publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos = 0);
+    void publish(const String& subtopic, const String& payload,
+            const MqttPublishPriority priority = MqttPublishPriority::Telemetry);
+    // onPublished is called by the publishing task once the message was
+    // handed to the client
+    void publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos = 0,
+            const MqttPublishPriority priority = MqttPublishPriority::Telemetry,
+            std::function<void()> onPublished = nullptr);
+
+    // publishes the payload as is to a topic which includes the prefix
+    // already. the topic is shared with the outbox rather than copied, such
+    // that callers publishing the same topics repeatedly format them once.
+    void publishPrefixed(const std::shared_ptr<const String>& spTopic, const char* payload,
+            const MqttPublishPriority priority = MqttPublishPriority::Telemetry);
+
+    struct OutboxStats {
+        size_t Queued; // messages currently waiting
+        size_t QueuedBytes;
+        uint32_t Published;
+        uint32_t Dropped;
+    };
+    OutboxStats getOutboxStats(const MqttPublishPriority priority);
+
+    // whether the outbox of the priority is below its limit
+    bool hasOutboxRoom(const MqttPublishPriority priority);
 
     void subscribe(const String& topic, const uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb);
     void unsubscribe(const String& topic);
@@ -35,11 +75,56 @@ private:
 
     void createMqttClientObject();
 
+    bool publishImmediately(const String& topic, const String& payload, const bool retain, const uint8_t qos);
+
+    static void publishTaskHelper(void* context);
+    void publishTask();
+
+    void enqueue(std::shared_ptr<const String> spTopic, String payload, const bool retain, const uint8_t qos,
+            const MqttPublishPriority priority, std::function<void()> onPublished = nullptr);
+
+    struct OutboundMessage {
+        std::shared_ptr<const String> spTopic;
+        String Payload;
+        bool Retain;
+        uint8_t Qos;
+        std::function<void()> OnPublished;
+    };
+
+    struct Outbox {
+        std::deque<OutboundMessage> Messages;
+        size_t Bytes = 0;
+        uint32_t Published = 0;
+        uint32_t Dropped = 0;
+    };
+
+    // limits of the queued topic and payload bytes per priority. discovery
+    // messages are not dropped, their publishers pace themselves such that
+    // the outbox holds at most this much plus one burst of messages.
+    static constexpr std::array<size_t, static_cast<size_t>(MqttPublishPriority::Count)> _outboxLimits = {
+        4 * 1024, // Control
+        4 * 1024, // Discovery
+        16 * 1024 // Telemetry
+    };
+
+    std::array<Outbox, static_cast<size_t>(MqttPublishPriority::Count)> _outboxes;
+    std::mutex _outboxMutex;
+    std::condition_variable _outboxCv;
+    TaskHandle_t _publishTaskHandle = nullptr;
+
     MqttClient* _mqttClient = nullptr;
     Ticker _mqttReconnectTimer;
     MqttSubscribeParser _mqttSubscribeParser;
     std::mutex _clientLock;
     bool _verboseLogging = true;
+
+    // a failed TLS connection attempt costs seconds of CPU time and tens of
+    // kilobytes of heap, so retries are spaced further apart each time.
+    static constexpr uint32_t _reconnectDelayMin = 2; // seconds
+    static constexpr uint32_t _reconnectDelayMax = 64;
+    std::atomic<uint32_t> _reconnectDelay = _reconnectDelayMin;
+    std::atomic<bool> _tlsConnecting = false;
+    std::atomic<uint32_t> _connectStartMillis = 0;
 };
 
 extern MqttSettingsClass MqttSettings;
@@ -5,6 +5,7 @@
 #include <DNSServer.h>
 #include <TaskSchedulerDeclarations.h>
 #include <WiFi.h>
+#include <optional>
 #include <vector>
 
 enum class network_mode {
@@ -21,6 +22,7 @@ enum class network_event {
     NETWORK_DISCONNECTED,
     NETWORK_GOT_IP,
     NETWORK_LOST_IP,
+    NETWORK_INTERFACE_CHANGED, // connections over the previous interface are dead
     NETWORK_EVENT_MAX
 };
 
@@ -54,6 +56,12 @@ public:
     bool isConnected() const;
     network_mode NetworkMode() const;
 
+    enum class LatencyMode : uint8_t {
+        PowerSave = 0,
+        Auto = 1, // low latency while the DPL governs producing inverters
+        LowLatency = 2
+    };
+
     bool onEvent(DtuNetworkEventCb cbEvent, const network_event event = network_event::NETWORK_EVENT_MAX);
     void raiseEvent(const network_event event);
 
@@ -63,6 +71,7 @@ private:
     void setStaticIp();
     void handleMDNS();
     void setupMode();
+    void handleLatencyMode();
     void NetworkEvent(const WiFiEvent_t event, WiFiEventInfo_t info);
 
     Task _loopTask;
@@ -84,6 +93,8 @@ private:
     bool _ethConnected = false;
     std::vector<DtuNetworkEventCbList_t> _cbEventList;
     bool _lastMdnsEnabled = false;
+    std::optional<bool> _lowLatency;
+    UBaseType_t _asyncTcpPriority = 0; // as created by the library
     std::unique_ptr<W5500> _w5500;
 };
 
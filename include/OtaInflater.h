@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// decompresses a gzip-compressed firmware image while it is received, using
+// the inflater in ROM. the decompressed data is handed to the sink in pieces
+// of at most the size of the inflater's dictionary (32 KiB).
+class OtaInflater {
+public:
+    using sink_t = std::function<bool(uint8_t const* data, size_t len)>;
+
+    ~OtaInflater() { end(); }
+
+    static bool isCompressed(uint8_t const* data, size_t len)
+    {
+        return len >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+    }
+
+    // allocates about 43 KiB, returns false if that fails
+    bool begin(sink_t sink);
+    void end();
+
+    // returns false if the data is not a valid gzip stream or the sink
+    // failed, see getError()
+    bool write(uint8_t const* data, size_t len);
+
+    // true if the stream ended and its length and checksum matched
+    bool isComplete() const { return _stage == Stage::Done; }
+
+    char const* getError() const { return _error; }
+
+private:
+    enum class Stage : uint8_t {
+        Header,
+        Extra, // optional fields of the header
+        Name,
+        Comment,
+        HeaderCrc,
+        Deflate,
+        Trailer,
+        Done,
+        Failed
+    };
+
+    size_t parseHeader(uint8_t const* data, size_t len);
+    size_t inflate(uint8_t const* data, size_t len);
+    size_t parseTrailer(uint8_t const* data, size_t len);
+    bool fail(char const* error);
+
+    sink_t _sink;
+    void* _pDecompressor = nullptr;
+    uint8_t* _pDictionary = nullptr;
+    size_t _dictionaryOffset = 0;
+
+    Stage _stage = Stage::Header;
+    uint8_t _flags = 0;
+    uint8_t _fieldBytes[10]; // the fixed part of the header or the trailer
+    size_t _fieldLength = 0;
+    size_t _skip = 0; // remaining bytes of the extra field
+
+    uint32_t _crc = 0;
+    uint32_t _size = 0;
+
+    char const* _error = ""; // string literal
+};
@@ -6,6 +6,7 @@
 #include <stdint.h>
 
 #define PINMAPPING_FILENAME "/pin_mapping.json"
+#define PINMAPPING_CACHE_FILENAME "/pin_mapping.bin"
 #define PINMAPPING_LED_COUNT 2
 
 #define MAPPING_NAME_STRLEN 31
@@ -19,6 +20,13 @@ struct PinMapping_t {
     int8_t nrf24_irq;
     int8_t nrf24_en;
     int8_t nrf24_cs;
+    // additional modules on the same bus
+    int8_t nrf24_irq2;
+    int8_t nrf24_en2;
+    int8_t nrf24_cs2;
+    int8_t nrf24_irq3;
+    int8_t nrf24_en3;
+    int8_t nrf24_cs3;
 
     int8_t cmt_clk;
     int8_t cmt_cs;
@@ -33,6 +41,7 @@ struct PinMapping_t {
     int8_t w5500_cs;
     int8_t w5500_int;
     int8_t w5500_rst;
+    uint8_t w5500_spi_mhz;
 
 #if CONFIG_ETH_USE_ESP32_EMAC
     int8_t eth_phy_addr;
@@ -63,6 +72,14 @@ struct PinMapping_t {
     int8_t battery_rxen;
     int8_t battery_tx;
     int8_t battery_txen;
+    int8_t battery_rx2;
+    int8_t battery_rxen2;
+    int8_t battery_tx2;
+    int8_t battery_txen2;
+    int8_t battery_rx3;
+    int8_t battery_rxen3;
+    int8_t battery_tx3;
+    int8_t battery_txen3;
     int8_t huawei_miso;
     int8_t huawei_mosi;
     int8_t huawei_clk;
@@ -78,15 +95,28 @@ struct PinMapping_t {
     int8_t powermeter_txen;
 };
 
+struct BatteryPins_t {
+    int8_t rx;
+    int8_t rxen;
+    int8_t tx;
+    int8_t txen;
+};
+
 class PinMappingClass {
 public:
     PinMappingClass();
     bool init(const String& deviceMapping);
     PinMapping_t& get();
 
+    // the pins of the given battery interface (0 to 2). the second and
+    // third interface are used by the children of the aggregate provider.
+    BatteryPins_t getBatteryPins(uint8_t set) const;
+
     bool isMappingSelected() const { return _mappingSelected; }
 
     bool isValidNrf24Config() const;
+    // index 1 and 2 refer to the additional modules
+    bool isValidNrf24Config(const uint8_t index) const;
     bool isValidCmt2300Config() const;
     bool isValidW5500Config() const;
 #if CONFIG_ETH_USE_ESP32_EMAC
@@ -94,6 +124,12 @@ public:
 #endif
 
 private:
+    // the selected mapping as binary record, such that the JSON file, which
+    // may describe many boards, is only parsed if it or the selection changed.
+    bool readCache(const String& deviceMapping, uint32_t jsonSize, uint32_t jsonTime);
+    void writeCache(const String& deviceMapping, uint32_t jsonSize, uint32_t jsonTime);
+    static uint32_t getBuildId();
+
     PinMapping_t _pinMapping;
 
     bool _mappingSelected = false;
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+// decides, once per power meter sample, whether the battery is discharged
+// by the DPL's battery-powered inverters or charged by the grid charger, if
+// both the DPL and the grid charger's automatic power control are active.
+// both controllers act on the same power meter, and used to interlock each
+// other only after the fact, i.e., after the other one started producing or
+// consuming. this let them fight over the grid power.
+//
+// the arbiter calculates the grid power that would be measured if neither
+// the charger nor the battery-powered inverters were running. if that power
+// is below the charger's target, the surplus goes to the charger, otherwise
+// the demand above the DPL's target is covered by the inverters. switching
+// between the two requires the other side's share to exceed a hysteresis
+// and the current mode to be held for a minimum duration. as the charger's
+// setpoint is calculated from that power directly, and as the DPL
+// disregards the power of the charger being shut down, both converge within
+// one step.
+class PowerArbiterClass {
+public:
+    enum class Mode : uint8_t {
+        Discharge,
+        Charge
+    };
+
+    // called by the DPL in every cycle it governs its inverters
+    void setInverterState(bool governsBatteryPoweredInverters, float batteryInvertersOutputWatts);
+
+    // called by the grid charger whenever it received new values
+    void setChargerState(bool autoPowerControl, float inputPowerWatts);
+
+    // true if both the DPL and the grid charger were reported active
+    // recently, i.e., if the decisions below shall be used.
+    bool isActive();
+
+    Mode getMode();
+
+    // the input power the grid charger shall consume, zero unless charging
+    float getChargerSetpoint();
+
+    // the charger's consumption the DPL shall disregard as the charger is
+    // being shut down in favor of discharging the battery.
+    float getChargerPowerToDisregard();
+
+private:
+    void update();
+
+    static constexpr uint32_t _stateTimeoutMs = 10 * 1000;
+    static constexpr float _switchHysteresisWatts = 50;
+    static constexpr uint32_t _minModeDurationMs = 30 * 1000;
+
+    std::mutex _mutex;
+
+    bool _inverterActive = false;
+    float _batteryInvertersOutputWatts = 0;
+    uint32_t _inverterStateMillis = 0;
+
+    bool _chargerActive = false;
+    float _chargerInputWatts = 0;
+    uint32_t _chargerStateMillis = 0;
+
+    uint32_t _lastSample = 0;
+    Mode _mode = Mode::Discharge;
+    uint32_t _modeSinceMillis = 0;
+    float _chargerSetpoint = 0;
+
+    bool isActiveUnlocked() const;
+};
+
+extern PowerArbiterClass PowerArbiter;
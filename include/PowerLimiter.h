@@ -5,6 +5,7 @@
 #include "PowerLimiterInverter.h"
 #include <espMqttClient.h>
 #include <Arduino.h>
+#include <array>
 #include <atomic>
 #include <deque>
 #include <memory>
@@ -34,10 +35,21 @@ public:
         InverterStatsPending,
         UnconditionalSolarPassthrough,
         Stable,
+        ClusterSharePending,
     };
 
     void init(Scheduler& scheduler);
-    void triggerReloadingConfig() { _reloadConfigFlag = true; }
+    void triggerReloadingConfig() { _reloadConfigFlag = true; _slowInputsUpdatedFlag = true; }
+
+    // called (potentially from a different task) for every new power meter
+    // reading published on the event bus, and by the cluster whenever the
+    // leader assigned a new share, such that the DPL skips its calculation
+    // backoff and acts on the new input right away.
+    void notifyPowerMeterUpdate() { _inputUpdatedFlag = true; }
+
+    // likewise, called by solar charger providers which receive a
+    // consistent set of output values at once.
+    void notifySolarChargerUpdate() { _inputUpdatedFlag = true; _slowInputsUpdatedFlag = true; }
     uint8_t getInverterUpdateTimeouts() const;
     uint8_t getPowerLimiterState();
     int32_t getInverterOutput() { return _lastExpectedInverterOutput; }
@@ -49,7 +61,7 @@ public:
         UnconditionalFullSolarPassthrough = 2
     };
 
-    void setMode(Mode m) { _mode = m; }
+    void setMode(Mode m) { _mode = m; _slowInputsUpdatedFlag = true; }
     Mode getMode() const { return _mode; }
     bool usesBatteryPoweredInverter();
     bool usesSmartBufferPoweredInverter();
@@ -57,12 +69,34 @@ public:
     // used to interlock Huawei R48xx grid charger against battery-powered inverters
     bool isGovernedBatteryPoweredInverterProducing();
 
+    // true if the DPL is enabled and at least one governed inverter produces
+    bool isGoverningProducingInverters() const;
+
 private:
+    void registerMetrics();
     void loop();
 
     Task _loopTask;
 
     std::atomic<bool> _reloadConfigFlag = true;
+    std::atomic<bool> _inputUpdatedFlag = false;
+
+    // the inputs which change slowly compared to the power meter reading
+    // are evaluated again only after the battery or the solar charger
+    // reported new data, the settings changed, or after their max age. the
+    // calculations in between use the cached values, such that an iteration
+    // triggered by a power meter reading only calculates the consumption and
+    // distributes it among the inverters.
+    struct SlowInputs {
+        bool FullSolarPassthroughActive;
+        bool BelowStopThreshold;
+        std::optional<uint16_t> BatteryDischargeLimit;
+    };
+    SlowInputs _slowInputs = {};
+    std::atomic<bool> _slowInputsUpdatedFlag = true;
+    uint32_t _slowInputsMillis = 0;
+    static constexpr uint32_t _slowInputsMaxAgeMs = 5 * 1000;
+    bool isSlowInputsEvaluationDue();
     uint16_t _lastExpectedInverterOutput = 0;
     Status _lastStatus = Status::Initializing;
     uint32_t _lastStatusPrinted = 0;
@@ -82,22 +116,68 @@ private:
     frozen::string const& getStatusText(Status status);
     void announceStatus(Status status);
     bool isDisabled();
-    void reloadConfig();
+    bool reloadConfig();
     std::pair<float, char const*> getInverterDcVoltage();
     float getBatteryVoltage(bool log = false);
     uint16_t dcPowerBusToInverterAc(uint16_t dcPower);
     void unconditionalFullSolarPassthrough();
     int16_t calcConsumption();
+    int16_t predictConsumption(int16_t consumption);
+
+    // power of the inverters feeding all phases evenly (index 0) and of the
+    // inverters assigned to phases L1 to L3 (indices 1 to 3)
+    using phase_power_t = std::array<uint16_t, 4>;
+    std::optional<phase_power_t> calcPhaseRequests(int16_t consumption, uint16_t totalRequested);
+    static uint16_t sum(phase_power_t const& power);
+    static phase_power_t remaining(phase_power_t const& requested, phase_power_t const& covered);
+    static phase_power_t distribute(phase_power_t const& weights, uint16_t total);
     using inverter_filter_t = std::function<bool(PowerLimiterInverter const&)>;
     uint16_t updateInverterLimits(uint16_t powerRequested, inverter_filter_t filter, std::string const& filterExpression);
+    using inverter_capacity_t = std::function<uint16_t(PowerLimiterInverter const&)>;
+    std::vector<PowerLimiterInverter*> selectInverters(
+            std::vector<PowerLimiterInverter*> const& candidates, uint16_t change,
+            uint16_t hysteresis, inverter_capacity_t capacity, inverter_filter_t switchesPowerState);
+    static constexpr size_t _maxOptimizedDispatchInverters = 12;
     uint16_t calcPowerBusUsage(uint16_t powerRequested);
     bool updateInverters();
+    void applyExportGuard();
+    uint32_t _exportGuardMeterMillis = 0;
     uint16_t getSolarPassthroughPower();
     std::optional<uint16_t> getBatteryDischargeLimit();
     float getBatteryInvertersOutputAcWatts();
 
+    // recent (millis, consumption) samples used by the predictive mode, a
+    // ring buffer where the oldest sample is at index First.
+    static constexpr size_t _consumptionHistorySize = 8;
+    struct ConsumptionHistory {
+        std::array<std::pair<uint32_t, int16_t>, _consumptionHistorySize> Samples;
+        size_t First = 0;
+        size_t Size = 0;
+
+        std::pair<uint32_t, int16_t> const& operator[](size_t i) const {
+            return Samples[(First + i) % _consumptionHistorySize];
+        }
+        std::pair<uint32_t, int16_t> const& front() const { return (*this)[0]; }
+        std::pair<uint32_t, int16_t> const& back() const { return (*this)[Size - 1]; }
+
+        void push_back(std::pair<uint32_t, int16_t> const& sample) {
+            Samples[(First + Size) % _consumptionHistorySize] = sample;
+            if (Size < _consumptionHistorySize) { ++Size; }
+            else { First = (First + 1) % _consumptionHistorySize; }
+        }
+        void pop_front() {
+            First = (First + 1) % _consumptionHistorySize;
+            --Size;
+        }
+    };
+    ConsumptionHistory _consumptionHistory;
+    static constexpr uint32_t _consumptionHistoryMaxAgeMs = 30 * 1000;
+    static constexpr uint32_t _predictionLeadTimeDefaultMs = 5 * 1000;
+
     std::optional<float> _oLoadCorrectedVoltage = std::nullopt;
     float getLoadCorrectedVoltage();
+    std::optional<float> getResistanceCorrectedVoltage();
+    static constexpr uint32_t _electricalSampleMaxAgeMs = 5 * 1000;
 
     bool testThreshold(float socThreshold, float voltThreshold,
             std::function<bool(float, float)> compare);
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <AsyncUDP.h>
+#include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// lets the DPLs of several units, each polling its own inverters, act as
+// one. every unit announces the state of its inverters to the others by UDP
+// multicast once per second. the unit with the lowest node id (derived from
+// the MAC address) among the units with an enabled DPL is the leader. its
+// DPL uses the power meter to calculate the power requested from all
+// inverters and distributes it among the units in proportion to the power
+// their governed inverters are able to produce. the DPLs of the other units
+// apply the share assigned to them to their own inverters, i.e., commands
+// are always sent by the unit owning the respective inverter. if the leader
+// goes silent, the unit with the next higher node id takes over.
+//
+// every datagram carries a sequence number and a truncated HMAC-SHA256
+// keyed with the cluster key. datagrams failing the check, or replaying a
+// sequence number already seen, are dropped. clustering stays inactive as
+// long as no cluster key is configured.
+class PowerLimiterClusterClass {
+public:
+    void init(Scheduler& scheduler);
+
+    // true if this unit calculates the power requested from the cluster,
+    // which is also the case if clustering is disabled.
+    bool isLeader();
+
+    // called by the DPL of the leader. caps the power requested from all
+    // units at the sum of their total upper power limits, distributes it
+    // and returns the share of this unit.
+    uint16_t distribute(uint16_t powerRequested);
+
+    // called by the DPL of a follower. returns the share assigned by the
+    // leader, or std::nullopt if there is no recent assignment.
+    std::optional<uint16_t> getShare();
+
+    // called by the DPL in every cycle to announce the power its governed
+    // inverters are able to produce, the power currently produced by those
+    // wired behind the power meter, and its total upper power limit.
+    void setLocalSummary(uint16_t maxPowerWatts, uint16_t behindMeterOutputWatts,
+            uint16_t upperLimitWatts);
+
+    // the output of the governed inverters of the other units which are
+    // wired behind the power meter, such that the leader accounts for them.
+    uint16_t getPeersBehindMeterOutputWatts();
+
+    void debug();
+
+private:
+    void loop();
+    void onPacket(uint8_t const* buffer, size_t length);
+    void send();
+    void expirePeers();
+    void sign(uint8_t const* data, size_t length, uint8_t* mac);
+
+    static constexpr uint16_t _port = 4244;
+    static constexpr uint8_t _version = 2;
+    static constexpr size_t _macSize = 16;
+    static constexpr uint32_t _announceIntervalMs = 1000;
+    static constexpr uint32_t _peerTimeoutMs = 5 * 1000;
+
+    struct Inverter {
+        uint64_t Serial;
+        bool Reachable;
+        bool Producing;
+        uint16_t OutputWatts;
+        uint16_t LimitPermille; // of the inverter's max power
+    };
+
+    struct Node {
+        uint32_t LastSeen = 0;
+        uint32_t Sequence = 0;
+        bool DplEnabled = false;
+        uint16_t MaxPowerWatts = 0;
+        uint16_t UpperLimitWatts = 0;
+        uint16_t BehindMeterOutputWatts = 0;
+        std::vector<Inverter> Inverters;
+    };
+
+    Task _loopTask;
+    AsyncUDP _udp;
+    std::atomic<bool> _listening = false;
+    bool _keyMissingLogged = false;
+    uint64_t _nodeId = 0;
+
+    std::mutex _mutex;
+    std::string _key; // copy of the configured cluster key
+    uint32_t _sequence = 0;
+    std::map<uint64_t, Node> _peers;
+    uint16_t _localMaxPowerWatts = 0;
+    uint16_t _localBehindMeterOutputWatts = 0;
+    uint16_t _localUpperLimitWatts = 0;
+
+    // shares assigned by this unit while it is the leader
+    std::map<uint64_t, uint16_t> _assignedShares;
+
+    // share assigned to this unit by the leader
+    std::optional<uint16_t> _oShare = std::nullopt;
+    uint32_t _shareMillis = 0;
+};
+
+extern PowerLimiterClusterClass PowerLimiterCluster;
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ctime>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// plans the battery discharge of a night, such that the battery reaches the
+// target state of charge at sunrise. the plan is derived from the history
+// kept by the TimeSeries module: the yield of the past days serves as
+// forecast of the next day's yield, which determines the target SoC, and the
+// consumption of the past nights at the same time of the night serves as
+// consumption profile. the discharge power is capped at the lowest level
+// which still supplies the available energy until sunrise, which keeps the
+// battery current low and avoids depleting the battery early in the evening.
+class PowerLimiterDischargePlanClass {
+public:
+    // recalculates the plan if it is outdated. the plan is only active at
+    // night, if enabled, and if the battery's SoC is known.
+    void update();
+
+    bool isActive() const { return _active; }
+
+    // whether the battery shall be discharged at all, i.e., the SoC is
+    // above the target SoC.
+    bool isDischargeAllowed() const { return _active && _dischargeAllowed; }
+
+    // the DC power that shall be drawn from the battery at most. nullopt if
+    // the plan does not limit the discharge (or is not active).
+    std::optional<uint16_t> getDischargeLimit() const;
+
+    float getTargetSoc() const { return _targetSoc; }
+    float getForecastYieldWh() const { return _forecastYieldWh; }
+
+private:
+    void calculate(time_t now, time_t sunrise, float soc);
+    float forecastYield(time_t now) const;
+    std::vector<float> consumptionProfile(time_t now, time_t sunrise) const;
+    static std::optional<float> waterLevel(std::vector<float> profile, float energyWh);
+
+    static constexpr uint32_t _slotSeconds = 15 * 60; // as TimeSeries tier 2
+    static constexpr uint8_t _historyDays = 3;
+    static constexpr uint32_t _updateIntervalMs = 5 * 60 * 1000;
+
+    // AC consumption to DC battery power
+    static constexpr float _inverterEfficiency = 0.95;
+
+    bool _active = false;
+    bool _dischargeAllowed = false;
+    uint32_t _lastUpdate = 0;
+    float _lastSoc = -1;
+    float _targetSoc = 0;
+    float _forecastYieldWh = 0;
+    std::optional<float> _oDischargeLimit = std::nullopt;
+};
+
+extern PowerLimiterDischargePlanClass PowerLimiterDischargePlan;
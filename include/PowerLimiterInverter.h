@@ -2,6 +2,8 @@
 #pragma once
 
 #include "Configuration.h"
+#include "PowerLimiterLatency.h"
+#include "PowerLimiterResponseModel.h"
 #include <Hoymiles.h>
 #include <optional>
 #include <memory>
@@ -23,6 +25,11 @@ public:
     // the amount of times an update command issued to the inverter timed out
     uint8_t getUpdateTimeouts() const { return _updateTimeouts; }
 
+    // the amount of update cycles started since the DPL took control, and the
+    // duration of the most recent update cycle that reached its target state.
+    uint32_t getUpdateCycles() const { return _updateCycles; }
+    uint32_t getLastUpdateDurationMillis() const { return _lastUpdateDurationMillis; }
+
     // maximum amount of AC power the inverter is able to produce
     // (not regarding the configured upper power limit)
     uint16_t getInverterMaxPowerWatts() const;
@@ -36,6 +43,10 @@ public:
     // this differs from current output power if new limit was assigned
     uint16_t getExpectedOutputAcWatts() const;
 
+    // true if the pending update lowers the limit or puts the inverter into
+    // standby, i.e., if the inverter's AC power output is about to decrease.
+    bool hasPendingReduction() const;
+
     // the maximum reduction of power output the inverter
     // can achieve with or withouth going into standby.
     virtual uint16_t getMaxReductionWatts(bool allowStandby) const = 0;
@@ -50,6 +61,11 @@ public:
     virtual uint16_t applyReduction(uint16_t reduction, bool allowStandby) = 0;
     virtual uint16_t applyIncrease(uint16_t increase) = 0;
 
+    // applies the reduction and sends the new limit right away, starting a
+    // new update cycle even if one is in progress. returns zero if a limit
+    // command is pending, as it cannot be superseded.
+    uint16_t curtail(uint16_t reduction);
+
     // stop producing AC power. returns the change in power output
     // that will become effective (once update() returns false).
     virtual uint16_t standby() = 0;
@@ -66,8 +82,14 @@ public:
     bool isProducing() const { return _spInverter->isProducing(); }
 
     uint64_t getSerial() const { return _config.Serial; }
+
+    // true if this instance was created from the given settings and still
+    // controls the respective inverter, i.e., it needs not be recreated.
+    bool matches(PowerLimiterInverterConfig const& config) const;
+    void setVerboseLogging(bool verboseLogging) { _verboseLogging = verboseLogging; }
     char const* getSerialStr() const { return _serialStr; }
     bool isBehindPowerMeter() const { return _config.IsBehindPowerMeter; }
+    uint8_t getPhase() const { return _config.Phase; }
 
     bool isBatteryPowered() const { return _config.PowerSource == PowerLimiterInverterConfig::InverterPowerSource::Battery; }
     bool isSolarPowered() const { return _config.PowerSource == PowerLimiterInverterConfig::InverterPowerSource::Solar; }
@@ -92,6 +114,11 @@ protected:
 
     uint16_t getCurrentLimitWatts() const;
 
+    // the output the current limit is expected to result in, and the output
+    // the inverter is expected to achieve at most, as per its learned response
+    uint16_t getModeledOutputWatts() const;
+    uint16_t getModeledMaxOutputWatts() const;
+
     void setTargetPowerLimitWatts(uint16_t power) { _oTargetPowerLimitWatts = power; }
     void setTargetPowerState(bool enable) { _oTargetPowerState = enable; }
     void setExpectedOutputAcWatts(uint16_t power) { _expectedOutputAcWatts = power; }
@@ -107,17 +134,30 @@ protected:
     bool _verboseLogging;
     char _logPrefix[32];
 
+    PowerLimiterResponseModel _responseModel;
+
 private:
     virtual void setAcOutput(uint16_t expectedOutputWatts) = 0;
 
+    // reports the stage durations of the current limit update to the
+    // latency statistics once stats reflecting the new limit arrived.
+    void trackLatency();
+
+    // feeds the stats of the producing inverter into the response model
+    void trackResponse();
+
     char _serialStr[16];
 
     // track (target) state
     uint8_t _updateTimeouts = 0;
+    uint32_t _updateCycles = 0;
+    uint32_t _lastUpdateDurationMillis = 0;
     std::optional<uint32_t> _oUpdateStartMillis = std::nullopt;
     std::optional<uint16_t> _oTargetPowerLimitWatts = std::nullopt;
     std::optional<bool> _oTargetPowerState = std::nullopt;
     mutable std::optional<uint32_t> _oStatsMillis = std::nullopt;
+    static constexpr uint32_t _maxSettleWaitMillis = 10 * 1000;
+    std::optional<PowerLimiterLatencyClass::Timestamps> _oLatency = std::nullopt;
 
     // the expected AC output (possibly is different from the target limit)
     uint16_t _expectedOutputAcWatts = 0;
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+// collects the durations of the individual stages of the control loop, i.e.,
+// from a power meter reading to the inverter reporting its new output, and
+// provides percentiles over a rolling window of the most recent samples.
+class PowerLimiterLatencyClass {
+public:
+    enum class Stage : uint8_t {
+        MeterToDecision = 0, // power meter reading until DPL decision
+        DecisionToEnqueue, // DPL decision until limit command is queued
+        EnqueueToTx, // limit command is queued until it is sent first
+        TxToAck, // limit command is sent first until inverter acknowledged
+        AckToStats, // acknowledge until first stats reflecting the change
+        Total, // power meter reading until first stats after change
+        Count
+    };
+
+    struct Timestamps {
+        uint32_t MeterSample; // zero if the power meter was not used
+        uint32_t Decision;
+        uint32_t Enqueued;
+        uint32_t FirstTx;
+        uint32_t Acknowledged;
+        uint32_t Stats;
+    };
+
+    // feeds the durations between all known timestamps of one
+    // completed limit update into the respective rolling windows.
+    void addSample(Timestamps const& ts);
+
+    struct Summary {
+        uint32_t Count; // number of samples in the rolling window
+        uint32_t P50;
+        uint32_t P95;
+        uint32_t P99;
+        uint32_t Max;
+    };
+
+    Summary getSummary(Stage stage) const;
+    static char const* getStageName(Stage stage);
+
+    void serialize(JsonObject& target) const;
+
+private:
+    static constexpr size_t _windowSize = 64;
+
+    struct Window {
+        std::array<uint32_t, _windowSize> Samples;
+        size_t Next = 0; // index where the next sample is stored
+        size_t Size = 0; // number of valid samples
+    };
+
+    void addDuration(Stage stage, uint32_t start, uint32_t end);
+
+    mutable std::mutex _mutex;
+    std::array<Window, static_cast<size_t>(Stage::Count)> _windows;
+};
+
+extern PowerLimiterLatencyClass PowerLimiterLatency;
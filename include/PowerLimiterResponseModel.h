@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+// learns how the AC output of an inverter responds to its power limit: the
+// ratio of output to limit, the output the inverter is able to achieve at
+// most (MPPT-limited or derated), and the time it takes the output to settle
+// after the inverter acknowledged a new limit. this allows to choose limits
+// which land on the target in one step rather than approaching it in several
+// update cycles.
+class PowerLimiterResponseModel {
+public:
+    // the inverter acknowledged the limit at the given time
+    void onLimitApplied(uint32_t ackMillis);
+
+    // new stats of the producing inverter while no update is pending
+    void onStats(uint16_t limitWatts, uint16_t outputWatts, uint32_t statsMillis);
+
+    // the limit expected to result in the output and vice versa
+    uint16_t getLimitFor(uint16_t outputWatts) const;
+    uint16_t getOutputFor(uint16_t limitWatts) const;
+
+    // the output the inverter achieved while limited above it, if this was
+    // observed recently
+    std::optional<uint16_t> getCeilingWatts() const;
+
+    // the time from acknowledging a limit until the output settled, zero
+    // until this was observed
+    uint32_t getSettleMillis() const { return _settleMillis; }
+
+    float getRatio() const { return _ratio; }
+
+private:
+    static bool isNear(uint16_t actual, uint16_t expected);
+
+    float _ratio = 1.0f; // output per watt of limit
+
+    std::optional<uint16_t> _oCeilingWatts = std::nullopt;
+    uint32_t _ceilingMillis = 0;
+
+    bool _settling = false;
+    uint32_t _ackMillis = 0;
+    uint8_t _statsSinceAck = 0;
+    uint32_t _settleMillis = 0;
+
+    uint32_t _lastStatsMillis = 0;
+    uint16_t _lastOutputWatts = 0;
+
+    static constexpr float _ratioMin = 0.85f;
+    static constexpr float _ratioMax = 1.05f;
+    static constexpr float _ratioWeight = 0.2f;
+    static constexpr uint16_t _minLimitWatts = 50; // output jitters too much below
+    static constexpr uint16_t _toleranceWatts = 5;
+    static constexpr uint32_t _ceilingMaxAgeMillis = 5 * 60 * 1000;
+    static constexpr uint32_t _settleMaxMillis = 30 * 1000;
+};
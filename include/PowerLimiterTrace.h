@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// a ring buffer of compact records of the DPL's recent decisions, which is
+// always recorded, such that oscillations can be analyzed after the fact
+// without verbose logging. a record is added for every calculation and for
+// every change of the status while no calculation takes place.
+//
+// the download (see serialize()) starts with a header
+//     char[4] "DPLT", uint8_t version, uint8_t record size,
+//     uint16_t record count, uint32_t millis at the time of the download
+// followed by the records, the oldest first. all values are little endian.
+class PowerLimiterTraceClass {
+public:
+    static constexpr size_t MaxInverters = 8;
+
+    enum Flags : uint8_t {
+        Calculated = 1 << 0, // the record holds the inputs and outputs of a calculation
+        MeterValid = 1 << 1,
+        BatteryDischarge = 1 << 2, // battery discharge is allowed
+        NighttimeDischarge = 1 << 3,
+        ClusterLeader = 1 << 4,
+        LimitUpdated = 1 << 5, // at least one inverter received a new limit
+        SlowInputsEvaluated = 1 << 6, // thresholds and battery limits were evaluated again
+    };
+
+    struct __attribute__((packed)) Inverter {
+        uint32_t Serial; // lower 32 bits
+        uint16_t OutputWatts; // AC output when the calculation started
+        uint16_t ExpectedBeforeWatts; // expected output before the calculation
+        uint16_t ExpectedAfterWatts; // expected output after the calculation
+    };
+
+    struct __attribute__((packed)) Record {
+        uint32_t Millis;
+        uint32_t Time; // unix time, zero if unknown
+        uint8_t Status; // see PowerLimiterClass::Status
+        uint8_t Flags;
+        int16_t MeterWatts;
+        uint16_t BatteryCentiVolts; // zero if unknown
+        uint8_t BatterySoC; // 255 if unknown
+        uint8_t InverterCount;
+        uint16_t SolarWatts; // solar charger output
+        int16_t ConsumptionWatts; // minus the target consumption
+        uint16_t RequestedWatts; // after the total upper limit and the cluster
+        uint16_t SolarCoveredWatts;
+        uint16_t SmartBufferCoveredWatts;
+        uint16_t PowerBusWatts; // requested from battery-powered inverters
+        uint16_t BatteryCoveredWatts;
+        // durations in microseconds, saturating at 65535
+        uint16_t InputsMicros; // evaluating thresholds and inputs
+        uint16_t ConsumptionMicros;
+        uint16_t DispatchMicros; // distributing the power among the inverters
+        uint16_t UpdateMicros; // sending new limits
+        Inverter Inverters[MaxInverters];
+    };
+    static_assert(sizeof(Record) <= 0xFF, "the record size is part of the header");
+
+    void addRecord(Record const& record);
+
+    // records a status change if no calculation took place
+    void addStatus(uint8_t status);
+
+    // the header and all records in the format described above
+    std::shared_ptr<std::vector<uint8_t>> serialize() const;
+
+    static uint16_t toMicros(int64_t start, int64_t end);
+
+private:
+    static constexpr uint8_t _version = 1;
+
+    // must be called with _mutex held
+    bool allocate();
+
+    mutable std::mutex _mutex;
+    Record* _records = nullptr; // allocated on first use
+    size_t _capacity = 0;
+    size_t _next = 0;
+    size_t _size = 0;
+    uint8_t _lastStatus = 0xFF;
+};
+
+extern PowerLimiterTraceClass PowerLimiterTrace;
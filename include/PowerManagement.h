@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <esp_pm.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// lets the ESP-IDF power management scale the CPU clock down to 80 MHz (the
+// lowest one supporting WiFi) while no subsystem needs the full speed. a
+// subsystem holds a lock while it is active:
+//   - the radios unless in night mode,
+//   - the DPL while it governs producing inverters, e.g., at night while
+//     discharging the battery,
+//   - the web server for a while after each request.
+// without any lock held, the chip enters automatic light sleep between DTIM
+// beacons, if the firmware was built with tickless idle and the network is
+// not using Ethernet.
+//
+// the power management is not available in builds without CONFIG_PM_ENABLE,
+// in which case the night mode scales the CPU clock down on its own.
+class PowerManagementClass {
+public:
+    enum class Lock : uint8_t {
+        Radio,
+        Dpl,
+        Http,
+        Count
+    };
+
+    PowerManagementClass();
+    void init(Scheduler& scheduler);
+
+    bool isEnabled() const { return _enabled; }
+
+    // holds the lock until the subsystem was idle for a while. may be
+    // called from any task.
+    void poke(Lock lock);
+
+private:
+    void loop();
+    void hold(Lock lock, bool held);
+
+    static constexpr size_t _lockCount = static_cast<size_t>(Lock::Count);
+    static constexpr uint32_t _minFrequencyMhz = 80;
+    static constexpr uint32_t _pokeHoldMillis = 10 * 1000;
+
+    Task _loopTask;
+    bool _enabled = false;
+
+    std::mutex _mutex; // serializes acquiring and releasing locks
+    std::array<esp_pm_lock_handle_t, _lockCount> _locks = {};
+    std::array<bool, _lockCount> _held = {};
+    std::array<std::atomic<uint32_t>, _lockCount> _lastPoke = {};
+};
+
+extern PowerManagementClass PowerManagement;
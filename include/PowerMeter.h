@@ -5,23 +5,62 @@
 #include <TaskSchedulerDeclarations.h>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <vector>
 
+// combines the primary power meter and optional additional power meters
+// into one virtual power meter. each provider runs its own polling.
+// additional power meters on standby substitute the primary power meter
+// while its readings are stale, the first one with fresh readings is used.
 class PowerMeterClass {
 public:
     void init(Scheduler& scheduler);
 
+    // recreates the providers only if settings relevant to them changed.
+    // other changes are applied to the running providers.
     void updateSettings();
 
+    // returns the filtered total power, which is what the DPL acts on
     float getPowerTotal() const;
+    float getPowerTotalRaw() const;
+
+    // the unfiltered power per phase, available only if every power meter
+    // in use reads the power of each phase
+    std::optional<PowerMeterProvider::phase_values_t> getPowerPhases() const;
+
+    // the most recent update of any of the power meters
     uint32_t getLastUpdate() const;
+
+    // true if the data of all power meters in use is valid
     bool isDataValid() const;
 
+    // the sample statistics of each power meter, the primary one first
+    std::vector<PowerMeterProvider::Metrics> getMetrics() const;
+
 private:
+    void registerMetrics();
     void loop();
 
+    static std::unique_ptr<PowerMeterProvider> createProvider(PowerMeterProvider::Type type);
+    static uint32_t getProviderSettingsCrc();
+
+    struct Meter {
+        float Sign; // +1 or -1, depending on the configured operation
+        bool Standby; // substitutes the primary power meter
+        PowerMeterProvider::Type Type;
+        std::unique_ptr<PowerMeterProvider> upProvider;
+    };
+
+    // whether the readings of the meter are part of the total, must be
+    // called with _mutex held.
+    bool isInUse(size_t index) const;
+    void selectActive();
+
     Task _loopTask;
     mutable std::mutex _mutex;
-    std::unique_ptr<PowerMeterProvider> _upProvider = nullptr;
+    std::vector<Meter> _meters; // the primary one is always the first
+    size_t _active = 0; // the primary power meter or the standby substituting it
+    std::optional<uint32_t> _oProviderSettingsCrc = std::nullopt;
 };
 
 extern PowerMeterClass PowerMeter;
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include "PowerMeterProvider.h"
+
+// receives the readings of a companion ESP32 next to the grid meter via
+// ESP-NOW, i.e., as WiFi action frames which need neither the access point
+// nor TCP/IP. the companion sends one broadcast (or unicast) frame per
+// reading on the channel of the access point the DTU is connected to. the
+// readings are delivered within milliseconds, unless the modem sleep of the
+// WiFi station is enabled, see the network latency mode.
+//
+// frame layout (little endian, 32 bytes):
+//   uint32_t magic 0x574e504f ("OPNW"), uint8_t version 1,
+//   uint8_t flags (bit 0: phases are valid), uint16_t reserved,
+//   uint32_t sequence number (incremented for each reading),
+//   float total power in W, float power of L1, L2 and L3 in W,
+//   uint32_t CRC-32 (esp_rom_crc32_le(0, ...)) of the preceding 28 bytes
+class PowerMeterEspNow : public PowerMeterProvider {
+public:
+    ~PowerMeterEspNow();
+
+    bool init() final;
+    void loop() final;
+    float getPowerTotal() const final;
+    std::optional<phase_values_t> getPowerPhases() const final;
+    void doMqttPublish() const final;
+
+    // executed by the WiFi task for every received ESP-NOW frame
+    void onFrame(uint8_t const* mac, uint8_t const* data, int length);
+
+#pragma pack(push, 1)
+    struct Frame {
+        uint32_t Magic;
+        uint8_t Version;
+        uint8_t Flags;
+        uint16_t Reserved;
+        uint32_t Sequence;
+        float PowerTotal;
+        float PowerPhases[3];
+        uint32_t Crc;
+    };
+#pragma pack(pop)
+
+    static constexpr uint32_t FrameMagic = 0x574e504f; // "OPNW"
+    static constexpr uint8_t FrameVersion = 1;
+    static constexpr uint8_t FlagPhasesValid = 0x01;
+
+private:
+    // ESP-NOW can only be used once WiFi was started, which happens late or
+    // not at all if an Ethernet connection is used.
+    bool start();
+
+    bool _started = false;
+    uint32_t _lastStartAttempt = 0;
+
+    mutable std::mutex _mutex;
+    float _powerTotal = 0.0;
+    phase_values_t _powerPhases = {};
+    bool _phasesValid = false;
+
+    // the sender of the frames accepted last and its sequence number. a
+    // different sender is only accepted once the current one fell silent.
+    std::array<uint8_t, 6> _sender = {};
+    uint32_t _sequence = 0;
+    uint32_t _lastFrameMillis = 0;
+    bool _synced = false;
+
+    uint32_t _invalidFrames = 0;
+    uint32_t _staleFrames = 0; // duplicated, reordered or of another sender
+    uint32_t _lostFrames = 0; // gaps in the sequence numbers
+    uint32_t _lastStatsLog = 0;
+};
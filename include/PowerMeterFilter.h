@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Configuration.h"
+#include <array>
+#include <mutex>
+
+// smoothes the power meter readings before they are handed to the DPL. the
+// samples are kept in a fixed ring, such that adding a sample takes constant
+// time. a glitchy sample which differs from the filtered value by more than
+// the step threshold is rejected. if the following sample deviates in the
+// same direction, the change is considered a real step and the filter is
+// reset to follow it immediately.
+class PowerMeterFilter {
+public:
+    explicit PowerMeterFilter(PowerMeterFilterConfig const& cfg);
+
+    void addSample(float value);
+    float getFiltered() const;
+
+    // applies changed settings. the filtered value is kept, such that the
+    // DPL does not see a jump, but the history of samples is dropped.
+    void setConfig(PowerMeterFilterConfig const& cfg);
+
+private:
+    void reset(float value);
+
+    PowerMeterFilterConfig _cfg;
+
+    mutable std::mutex _mutex;
+    std::array<float, POWERMETER_FILTER_MAX_WINDOW> _samples;
+    size_t _next = 0; // index where the next sample is stored
+    size_t _count = 0; // number of valid samples
+    float _filtered = 0;
+    int8_t _pendingStep = 0; // direction of a rejected sample, zero if none
+};
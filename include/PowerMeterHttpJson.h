@@ -1,14 +1,17 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
-#include <atomic>
 #include <array>
+#include <atomic>
 #include <variant>
 #include <memory>
-#include <condition_variable>
 #include <mutex>
 #include <stdint.h>
 #include "HttpGetter.h"
+#include "HttpPoller.h"
+#include <ArduinoJson.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include "Configuration.h"
 #include "PowerMeterProvider.h"
 
@@ -25,7 +28,9 @@ public:
     bool init() final;
     void loop() final;
     float getPowerTotal() const final;
+    std::optional<phase_values_t> getPowerPhases() const final;
     bool isDataValid() const final;
+    void setStandby(bool standby) final;
     void doMqttPublish() const final;
 
     using power_values_t = std::array<float, POWERMETER_HTTP_JSON_MAX_VALUES>;
@@ -33,21 +38,42 @@ public:
     poll_result_t poll();
 
 private:
-    static void pollingLoopHelper(void* context);
-    std::atomic<bool> _taskDone;
-    void pollingLoop();
+    static uint32_t constexpr _taskStackSize = 3072;
 
-    PowerMeterHttpJsonConfig const _cfg;
+    bool pollAndPublish();
+    void prewarm();
 
-    uint32_t _lastPoll = 0;
+    PowerMeterHttpJsonConfig const _cfg;
 
     mutable std::mutex _valueMutex;
     power_values_t _powerValues = {};
 
     std::array<std::unique_ptr<HttpGetter>, POWERMETER_HTTP_JSON_MAX_VALUES> _httpGetters;
 
-    TaskHandle_t _taskHandle = nullptr;
-    bool _stopPolling;
-    mutable std::mutex _pollingMutex;
-    std::condition_variable _cv;
+    // deserialization filters per HTTP getter, keeping only the configured
+    // values of the respective responses.
+    std::array<JsonDocument, POWERMETER_HTTP_JSON_MAX_VALUES> _jsonFilters;
+
+    // a request for an individual value. all but the first value are
+    // requested by a worker task each, which is started once and woken for
+    // every poll, such that all values of one sample set are requested
+    // concurrently. the first value is requested by the polling task.
+    struct FetchJob {
+        PowerMeterHttpJson* pInstance = nullptr;
+        uint8_t Index = 0;
+        TaskHandle_t TaskHandle = nullptr; // nullptr if there is no worker
+        SemaphoreHandle_t Done = nullptr;
+        std::atomic<bool> StopTask = false;
+        JsonDocument Response;
+        String Error;
+    };
+
+    std::array<FetchJob, POWERMETER_HTTP_JSON_MAX_VALUES> _jobs;
+
+    static void fetchLoopHelper(void* context);
+    void startWorker(FetchJob& job);
+    void stopWorkers();
+    String fetch(uint8_t idx, JsonDocument& response);
+
+    HttpPollerClass::job_id_t _pollerJob = 0;
 };
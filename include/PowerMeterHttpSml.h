@@ -1,13 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
-#include <atomic>
 #include <memory>
-#include <condition_variable>
-#include <mutex>
 #include <stdint.h>
 #include <Arduino.h>
 #include "HttpGetter.h"
+#include "HttpPoller.h"
 #include "Configuration.h"
 #include "PowerMeterSml.h"
 
@@ -22,24 +20,18 @@ public:
     bool init() final;
     void loop() final;
     bool isDataValid() const final;
+    void setStandby(bool standby) final;
 
     // returns an empty string on success,
     // returns an error message otherwise.
     String poll();
 
 private:
-    static void pollingLoopHelper(void* context);
-    std::atomic<bool> _taskDone;
-    void pollingLoop();
+    bool pollAndPublish();
 
     PowerMeterHttpSmlConfig const _cfg;
 
-    uint32_t _lastPoll = 0;
-
     std::unique_ptr<HttpGetter> _upHttpGetter;
 
-    TaskHandle_t _taskHandle = nullptr;
-    bool _stopPolling;
-    mutable std::mutex _pollingMutex;
-    std::condition_variable _cv;
+    HttpPollerClass::job_id_t _pollerJob = 0;
 };
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "Configuration.h"
+#include "JsonPath.h"
 #include "PowerMeterProvider.h"
 #include <espMqttClient.h>
 #include <vector>
@@ -18,12 +19,13 @@ public:
     bool init() final;
     void loop() final { }
     float getPowerTotal() const final;
+    std::optional<phase_values_t> getPowerPhases() const final;
 
 private:
     using MsgProperties = espMqttClientTypes::MessageProperties;
     void onMessage(MsgProperties const& properties, char const* topic,
             uint8_t const* payload, size_t len, size_t index,
-            size_t total, float* targetVariable, PowerMeterMqttValue const* cfg);
+            size_t total, size_t valueIndex);
 
     // we don't need to republish data received from MQTT
     void doMqttPublish() const final { };
@@ -33,6 +35,9 @@ private:
     using power_values_t = std::array<float, POWERMETER_MQTT_MAX_VALUES>;
     power_values_t _powerValues;
 
+    // compiled once, as values may arrive multiple times per second
+    std::array<JsonPath, POWERMETER_MQTT_MAX_VALUES> _jsonPaths;
+
     std::vector<String> _mqttSubscriptions;
 
     mutable std::mutex _mutex;
@@ -1,8 +1,13 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <mutex>
+#include <optional>
 #include "Configuration.h"
+#include "Measurement.h"
+#include "PowerMeterFilter.h"
 
 class PowerMeterProvider {
 public:
@@ -15,7 +20,10 @@ public:
         HTTP_JSON = 3,
         SERIAL_SML = 4,
         SMAHM2 = 5,
-        HTTP_SML = 6
+        HTTP_SML = 6,
+        ESP_NOW = 7,
+        SHELLY = 8,
+        UDP = 9
     };
 
     // returns true if the provider is ready for use, false otherwise
@@ -23,20 +31,69 @@ public:
 
     virtual void loop() = 0;
     virtual float getPowerTotal() const = 0;
+
+    // the unfiltered power of phases L1 to L3, if the meter reads them
+    using phase_values_t = std::array<float, 3>;
+    virtual std::optional<phase_values_t> getPowerPhases() const { return std::nullopt; }
+
+    // the total power after smoothing and outlier rejection, which is
+    // updated whenever the provider reports a new reading.
+    float getPowerTotalFiltered() const { return _filter.getFiltered(); }
     virtual bool isDataValid() const;
 
     uint32_t getLastUpdate() const { return _lastUpdate; }
     void mqttLoop() const;
 
+    // true if no reading arrived within twice the recent sample interval,
+    // i.e., at least one reading is overdue, or if the data is invalid.
+    bool isStale() const;
+
+    // a provider on standby only substitutes another one whose readings
+    // went stale. providers which poll their meter do so at a lower rate
+    // while on standby, and right away once they are needed.
+    virtual void setStandby(bool standby) { _standby = standby; }
+    bool isStandby() const { return _standby; }
+
+    struct Metrics {
+        uint32_t Samples;
+        float JitterMs; // mean deviation between consecutive sample intervals
+        float DecodeMicros; // average time to decode a reading, zero if unknown
+        uint32_t DecodeMicrosMax;
+    };
+    Metrics getMetrics() const;
+
+    // applies the settings shared by all providers without recreating them
+    void updateCommonSettings(CONFIG_T::PowerMeterConfig const& config) {
+        _verboseLogging = config.VerboseLogging;
+        _filter.setConfig(config.Filter);
+    }
+
 protected:
-    PowerMeterProvider() {
+    PowerMeterProvider()
+        : _filter(Configuration.get().PowerMeter.Filter) {
         auto const& config = Configuration.get();
         _verboseLogging = config.PowerMeter.VerboseLogging;
     }
 
-    void gotUpdate() { _lastUpdate = millis(); }
+    // records the time of the new reading and publishes it on the event
+    // bus, which wakes the DPL, such that it can act on the new reading
+    // without waiting for its calculation backoff.
+    // providers which know when the reading was received, before it was
+    // decoded, pass that time, which the DPL then accounts for.
+    void gotUpdate() { gotUpdate(millis()); }
+    void gotUpdate(uint32_t receivedMillis);
+
+    void addDecodeDuration(uint32_t micros);
+
+    // the polling interval in ms to use given the configured one
+    uint32_t getPollingIntervalMillis(uint32_t configuredSeconds) const {
+        return configuredSeconds * 1000 * (_standby ? _standbyPollingFactor : 1);
+    }
+
+    std::atomic<bool> _standby = false;
 
     void mqttPublish(String const& topic, float const& value) const;
+    void mqttPublish(String const& topic, Measurement const& value) const;
 
     bool _verboseLogging;
 
@@ -47,5 +104,13 @@ private:
     // than users that request to read this variable through getLastUpdate().
     std::atomic<uint32_t> _lastUpdate = 0;
 
+    PowerMeterFilter _filter;
+
     mutable uint32_t _lastMqttPublish = 0;
+
+    static constexpr uint32_t _standbyPollingFactor = 4;
+
+    mutable std::mutex _metricsMutex;
+    Metrics _metrics = {};
+    uint32_t _lastInterval = 0;
 };
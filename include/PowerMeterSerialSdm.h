@@ -1,14 +1,23 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 #include <SoftwareSerial.h>
 #include "Configuration.h"
 #include "PowerMeterProvider.h"
 #include "SDM.h"
 
+// owns the RS485 bus and polls the grid meter as well as the sub-meters
+// configured on the same bus, whose readings are added to or subtracted
+// from the grid meter's reading. the grid meter is read in every poll and
+// the sub-meters in every n-th poll only, such that they do not delay the
+// grid meter's readings. a sub-meter that does not reply is polled at an
+// even lower rate, and the data becomes invalid once its readings are
+// overdue, just like if the grid meter's readings are overdue.
 class PowerMeterSerialSdm : public PowerMeterProvider {
 public:
     enum class Phases {
@@ -16,21 +25,45 @@ public:
         Three
     };
 
-    PowerMeterSerialSdm(Phases phases, PowerMeterSerialSdmConfig const& cfg)
-        : _phases(phases)
-        , _cfg(cfg) { }
+    PowerMeterSerialSdm(Phases phases, PowerMeterSerialSdmConfig const& cfg);
 
     ~PowerMeterSerialSdm();
 
     bool init() final;
     void loop() final;
     float getPowerTotal() const final;
+    std::optional<phase_values_t> getPowerPhases() const final;
     bool isDataValid() const final;
+    void setStandby(bool standby) final;
     void doMqttPublish() const final;
 
 private:
+    struct Device {
+        uint8_t Address;
+        bool ThreePhases;
+        float Sign;
+        uint8_t PollDivider;
+
+        // cleared if the meter rejects reading several registers at once
+        bool BatchReads = true;
+
+        uint8_t Failures = 0; // consecutive failed polls
+        uint8_t SkipPolls = 0; // polls of the grid meter until read again
+        uint32_t LastUpdate = 0;
+
+        // protected by _valueMutex
+        std::array<float, 3> Power = {};
+        std::array<float, 3> Voltage = {};
+    };
+
     static void pollingLoopHelper(void* context);
-    bool readValue(std::unique_lock<std::mutex>& lock, uint16_t reg, float& targetVar);
+    bool readValues(std::unique_lock<std::mutex>& lock, Device& device, uint16_t reg, uint8_t count, float* targets);
+    bool readValue(std::unique_lock<std::mutex>& lock, Device& device, uint16_t reg, float& targetVar) {
+        return readValues(lock, device, reg, 1, &targetVar);
+    }
+    bool readPowerValues(std::unique_lock<std::mutex>& lock, Device& device);
+    bool readEnergyValues(std::unique_lock<std::mutex>& lock);
+    void pollSubMeters(std::unique_lock<std::mutex>& lock);
     std::atomic<bool> _taskDone;
     void pollingLoop();
 
@@ -39,12 +72,19 @@ private:
 
     uint32_t _lastPoll = 0;
 
-    float _phase1Power = 0.0;
-    float _phase2Power = 0.0;
-    float _phase3Power = 0.0;
-    float _phase1Voltage = 0.0;
-    float _phase2Voltage = 0.0;
-    float _phase3Voltage = 0.0;
+    // the energy counters change slowly, so they are read less often
+    static constexpr uint32_t _energyPollIntervalMillis = 60 * 1000;
+    uint32_t _lastEnergyPoll = 0;
+
+    static constexpr uint32_t _baud = 9600;
+
+    // a sub-meter which failed this many polls in a row is polled less often
+    static constexpr uint8_t _failuresUntilBackoff = 3;
+    static constexpr uint8_t _backoffFactor = 8;
+
+    // the grid meter first, followed by the sub-meters in use
+    std::vector<Device> _devices;
+
     float _energyImport = 0.0;
     float _energyExport = 0.0;
 
@@ -2,7 +2,9 @@
 #pragma once
 
 #include "PowerMeterSml.h"
-#include <SoftwareSerial.h>
+#include <driver/uart.h>
+#include <freertos/queue.h>
+#include <optional>
 
 class PowerMeterSerialSml : public PowerMeterSml {
 public:
@@ -21,24 +23,29 @@ private:
 
     static uint32_t constexpr _baud = 9600;
 
-    // size in bytes of the software serial receive buffer. must have the
-    // capacity to hold a full SML datagram, as we are processing the datagrams
-    // only after all data of one datagram was received.
-    static int constexpr _bufCapacity = 1024; // memory usage: 1 byte each
+    static char constexpr _serialPortOwner[] = "SML power meter";
 
-    // amount of bits (RX pin state transitions) the software serial can buffer
-    // without decoding bits to bytes and storing those in the receive buffer.
-    // this value dictates how ofter we need to call a function of the software
-    // serial instance that performs bit decoding (we call available()).
-    static int constexpr _isrCapacity = 256; // memory usage: 8 bytes each (timestamp + pointer)
+    // size in bytes of the UART driver's receive ring buffer, which is filled
+    // from the hardware FIFO by the UART ISR. holds more than a full SML
+    // datagram, such that a busy polling task does not lose data.
+    static size_t constexpr _rxBufferSize = 2048;
+
+    static int constexpr _eventQueueSize = 16;
+
+    // the SML escape character. four of them start and end a datagram.
+    static uint8_t constexpr _escapeChar = 0x1b;
+    static uint8_t constexpr _escapeCount = 4;
 
     static void pollingLoopHelper(void* context);
     std::atomic<bool> _taskDone;
     void pollingLoop();
+    void readBytes(size_t amount);
+    void recover();
 
     TaskHandle_t _taskHandle = nullptr;
     bool _stopPolling;
     mutable std::mutex _pollingMutex;
 
-    std::unique_ptr<SoftwareSerial> _upSmlSerial = nullptr;
+    std::optional<uart_port_t> _oPort = std::nullopt;
+    QueueHandle_t _uartQueue = nullptr;
 };
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include "JsonStreamScanner.h"
+#include "PowerMeterProvider.h"
+
+// ingests the power readings a Shelly Gen2+ energy meter pushes through its
+// outbound websocket (Settings -> Outbound WebSocket: ws://<opendtu>/shelly)
+// as soon as they change, see WebApiWsShellyClass. the readings of a
+// three-phase meter (em:0) or the channels of a single-phase meter (em1:0
+// to em1:2, as phases L1 to L3) are used. as notifications only carry the
+// values which changed, the status is requested once the readings would
+// otherwise become stale.
+class PowerMeterShelly : public PowerMeterProvider {
+public:
+    PowerMeterShelly();
+    ~PowerMeterShelly();
+
+    bool init() final;
+    void loop() final;
+    float getPowerTotal() const final;
+    std::optional<phase_values_t> getPowerPhases() const final;
+    void doMqttPublish() const final;
+
+private:
+    // executed by the async_tcp task
+    void onChunk(uint8_t const* data, size_t len, bool first, bool last);
+    void onValue(size_t pathIndex, float value);
+
+    enum class Field : uint8_t {
+        EmTotal = 0,
+        EmL1,
+        EmL2,
+        EmL3,
+        Em1Channel0,
+        Em1Channel1,
+        Em1Channel2,
+        Count
+    };
+    static constexpr size_t _fieldCount = static_cast<size_t>(Field::Count);
+    using fields_t = std::array<float, _fieldCount>;
+
+    JsonStreamScanner _scanner; // only accessed by the async_tcp task
+
+    // the values found in the message being received
+    fields_t _received = {};
+    uint8_t _receivedMask = 0;
+    uint32_t _receivedMillis = 0;
+    uint32_t _decodeMicros = 0;
+
+    mutable std::mutex _mutex;
+    fields_t _fields = {};
+    uint8_t _fieldsMask = 0; // the fields reported so far
+    float _powerTotal = 0.0;
+
+    uint32_t _lastStatusRequest = 0;
+    uint32_t _requestId = 0;
+    static constexpr uint32_t _statusRequestMillis = 2000;
+};
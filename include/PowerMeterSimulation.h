@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "PowerMeterProvider.h"
+#include <atomic>
+
+// reports the grid power of the DPL simulation, see DplSimulation.h
+class PowerMeterSimulation : public PowerMeterProvider {
+public:
+    bool init() final { return true; }
+    void loop() final;
+    float getPowerTotal() const final { return _powerTotal; }
+
+private:
+    void doMqttPublish() const final { }
+
+    std::atomic<float> _powerTotal = 0;
+};
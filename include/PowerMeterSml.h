@@ -1,19 +1,20 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
-#include <list>
 #include <mutex>
 #include <optional>
 #include <stdint.h>
 #include <Arduino.h>
 #include <HTTPClient.h>
 #include "Configuration.h"
+#include "Measurement.h"
 #include "PowerMeterProvider.h"
 #include "sml.h"
 
 class PowerMeterSml : public PowerMeterProvider {
 public:
     float getPowerTotal() const final;
+    std::optional<phase_values_t> getPowerPhases() const final;
     void doMqttPublish() const final;
 
 protected:
@@ -27,43 +28,41 @@ private:
     std::string _user;
     mutable std::mutex _mutex;
 
-    using values_t = struct {
-        std::optional<float> activePowerTotal = std::nullopt;
-        std::optional<float> activePowerL1 = std::nullopt;
-        std::optional<float> activePowerL2 = std::nullopt;
-        std::optional<float> activePowerL3 = std::nullopt;
-        std::optional<float> voltageL1 = std::nullopt;
-        std::optional<float> voltageL2 = std::nullopt;
-        std::optional<float> voltageL3 = std::nullopt;
-        std::optional<float> currentL1 = std::nullopt;
-        std::optional<float> currentL2 = std::nullopt;
-        std::optional<float> currentL3 = std::nullopt;
-        std::optional<float> energyImport = std::nullopt;
-        std::optional<float> energyExport = std::nullopt;
+    enum class Field : uint8_t {
+        ActivePowerTotal,
+        ActivePowerL1,
+        ActivePowerL2,
+        ActivePowerL3,
+        VoltageL1,
+        VoltageL2,
+        VoltageL3,
+        CurrentL1,
+        CurrentL2,
+        CurrentL3,
+        EnergyImport,
+        EnergyExport,
+        Count
     };
 
-    values_t _values;
-    values_t _cache;
+    static constexpr size_t _fieldCount = static_cast<size_t>(Field::Count);
+
+    // centiwatts, centivolts, milliamperes and watt hours
+    static constexpr MeasurementSnapshot<Field, _fieldCount>::exponents_t _exponents = {
+        -2, -2, -2, -2, -2, -2, -2, -3, -3, -3, 0, 0
+    };
+
+    using values_t = MeasurementSnapshot<Field, _fieldCount>;
+
+    values_t _values { _exponents };
+    values_t _cache { _exponents };
 
     using OBISHandler = struct {
-        uint8_t const OBIS[6];
-        void (*decoder)(float&);
-        std::optional<float>* target;
+        Field target;
+        sml_units_t unit;
         char const* name;
     };
 
-    const std::list<OBISHandler> smlHandlerList{
-        {{0x01, 0x00, 0x10, 0x07, 0x00, 0xff}, &smlOBISW, &_cache.activePowerTotal, "active power total"},
-        {{0x01, 0x00, 0x24, 0x07, 0x00, 0xff}, &smlOBISW, &_cache.activePowerL1, "active power L1"},
-        {{0x01, 0x00, 0x38, 0x07, 0x00, 0xff}, &smlOBISW, &_cache.activePowerL2, "active power L2"},
-        {{0x01, 0x00, 0x4c, 0x07, 0x00, 0xff}, &smlOBISW, &_cache.activePowerL3, "active power L3"},
-        {{0x01, 0x00, 0x20, 0x07, 0x00, 0xff}, &smlOBISVolt, &_cache.voltageL1, "voltage L1"},
-        {{0x01, 0x00, 0x34, 0x07, 0x00, 0xff}, &smlOBISVolt, &_cache.voltageL2, "voltage L2"},
-        {{0x01, 0x00, 0x48, 0x07, 0x00, 0xff}, &smlOBISVolt, &_cache.voltageL3, "voltage L3"},
-        {{0x01, 0x00, 0x1f, 0x07, 0x00, 0xff}, &smlOBISAmpere, &_cache.currentL1, "current L1"},
-        {{0x01, 0x00, 0x33, 0x07, 0x00, 0xff}, &smlOBISAmpere, &_cache.currentL2, "current L2"},
-        {{0x01, 0x00, 0x47, 0x07, 0x00, 0xff}, &smlOBISAmpere, &_cache.currentL3, "current L3"},
-        {{0x01, 0x00, 0x01, 0x08, 0x00, 0xff}, &smlOBISWh, &_cache.energyImport, "energy import"},
-        {{0x01, 0x00, 0x02, 0x08, 0x00, 0xff}, &smlOBISWh, &_cache.energyExport, "energy export"}
-    };
+    static OBISHandler const* findHandler(uint64_t obis);
+
+    SmlParser _parser;
 };
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <AsyncUDP.h>
+#include "Configuration.h"
+#include "PowerMeterProvider.h"
+
+// receives readings pushed as UDP datagrams (unicast or broadcast) by
+// Tasmota rules, ESPHome, Modbus bridges and the like, one reading per
+// datagram. the payload is either text, e.g., "power=-123.4 power1=..."
+// with the pairs separated by spaces, commas, semicolons, ampersands or
+// line breaks, or a single number, or binary, see PowerMeterUdpConfig.
+class PowerMeterUdp : public PowerMeterProvider {
+public:
+    explicit PowerMeterUdp(PowerMeterUdpConfig const& cfg)
+        : _cfg(cfg) { }
+
+    ~PowerMeterUdp();
+
+    bool init() final;
+    void loop() final { }
+    float getPowerTotal() const final;
+    std::optional<phase_values_t> getPowerPhases() const final;
+    void doMqttPublish() const final;
+
+private:
+    // executed by the AsyncUDP task for every received datagram
+    void onPacket(uint8_t const* buffer, size_t length);
+
+    struct Reading {
+        float Total = 0.0;
+        phase_values_t Phases = {};
+        bool HasTotal = false;
+        bool HasPhases = false;
+    };
+    bool decodeText(char const* text, size_t length, Reading& reading) const;
+    bool decodeFloat32(uint8_t const* buffer, size_t length, Reading& reading) const;
+
+    PowerMeterUdpConfig const _cfg;
+
+    AsyncUDP _udp;
+
+    mutable std::mutex _mutex;
+    float _powerTotal = 0.0;
+    phase_values_t _powerPhases = {};
+    bool _phasesValid = false;
+};
@@ -4,7 +4,10 @@
  */
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <mutex>
+#include <AsyncUDP.h>
 #include "PowerMeterProvider.h"
 
 class PowerMeterUdpSmaHomeManager : public PowerMeterProvider {
@@ -13,19 +16,67 @@ public:
 
     bool init() final;
     void loop() final;
-    float getPowerTotal() const final { return _powerMeterPower; }
+    float getPowerTotal() const final;
     void doMqttPublish() const final;
 
 private:
-    void Soutput(int kanal, int index, int art, int tarif,
-            char const* name, float value, uint32_t timestamp);
+    // the measurements used by the DPL, all in 0.1 W
+    enum class Channel : uint8_t {
+        ImportTotal = 0,
+        ExportTotal,
+        ImportL1,
+        ExportL1,
+        ImportL2,
+        ExportL2,
+        ImportL3,
+        ExportL3,
+        Count
+    };
+    static constexpr size_t _channelCount = static_cast<size_t>(Channel::Count);
+    using values_t = std::array<uint32_t, _channelCount>;
 
-    uint8_t* decodeGroup(uint8_t* offset, uint16_t grouplen);
+    // executed by the AsyncUDP task for every received datagram
+    void onPacket(uint8_t const* buffer, size_t length);
 
+    // offset of the value of each channel within the datagram, and the
+    // measurement header (channel, index, type, tariff) expected before it
+    struct ChannelLocation {
+        uint16_t Offset;
+        uint32_t Header;
+    };
+
+    struct Layout {
+        size_t Length = 0; // datagram length the offsets apply to, zero if unknown
+        uint16_t TimestampOffset = 0;
+        std::array<ChannelLocation, _channelCount> Channels;
+    };
+
+    // decodes a datagram using the offsets of the channels found in the
+    // previous datagram. returns false if the layout changed.
+    bool decodeFast(uint8_t const* buffer, size_t length,
+            values_t& values, uint32_t& timestamp) const;
+
+    // walks all groups and measurements of a datagram and records the
+    // offsets of the channels for the fast path.
+    bool decodeFull(uint8_t const* buffer, size_t length,
+            values_t& values, uint32_t& timestamp);
+    void decodeGroup(uint8_t const* offset, uint8_t const* endOfGroup,
+            uint8_t const* buffer, values_t& values, uint32_t& timestamp,
+            Layout& layout, size_t& found);
+
+    void Soutput(char const* name, float value, uint32_t timestamp) const;
+
+    AsyncUDP _udp;
+
+    Layout _layout; // only accessed by the AsyncUDP task
+
+    mutable std::mutex _mutex;
     float _powerMeterPower = 0.0;
     float _powerMeterL1 = 0.0;
     float _powerMeterL2 = 0.0;
     float _powerMeterL3 = 0.0;
-    uint32_t _previousMillis = 0;
+    uint32_t _timestamp = 0; // timestamp of the latest datagram (device time)
     uint32_t _serial = 0;
+
+    uint32_t _lastLogged = 0; // timestamp of the datagram logged last
 };
@@ -14,7 +14,15 @@ public:
 
     std::shared_ptr<BatteryStats> getStats() const final { return _stats; }
 
+protected:
+    MessageIds getMessageIds() const final { return { _messageIds.data(), _messageIds.size() }; }
+
 private:
+    static constexpr std::array<uint32_t, 6> _messageIds = {
+        0x351, 0x355, 0x356, 0x359, 0x35C, 0x35E
+    };
+    static_assert(isSorted(_messageIds), "message ids must be sorted");
+
     void dummyData();
 
     std::shared_ptr<PylontechBatteryStats> _stats =
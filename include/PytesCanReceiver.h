@@ -13,7 +13,17 @@ public:
 
     std::shared_ptr<BatteryStats> getStats() const final { return _stats; }
 
+protected:
+    MessageIds getMessageIds() const final { return { _messageIds.data(), _messageIds.size() }; }
+
 private:
+    static constexpr std::array<uint32_t, 30> _messageIds = {
+        0x351, 0x355, 0x356, 0x35A, 0x35E, 0x35F, 0x360, 0x372, 0x373, 0x374,
+        0x375, 0x376, 0x377, 0x378, 0x379, 0x380, 0x381, 0x400, 0x401, 0x402,
+        0x403, 0x404, 0x405, 0x406, 0x408, 0x409, 0x40A, 0x40B, 0x40D, 0x41E
+    };
+    static_assert(isSorted(_messageIds), "message ids must be sorted");
+
     std::shared_ptr<PytesBatteryStats> _stats =
         std::make_shared<PytesBatteryStats>();
 };
@@ -7,12 +7,16 @@ class RestartHelperClass {
 public:
     RestartHelperClass();
     void init(Scheduler& scheduler);
-    void triggerRestart();
+    // configuration changes which were only journaled yet are written to
+    // config.json before restarting, as a new firmware discards the journal.
+    // callers which replaced or removed config.json shall not persist.
+    void triggerRestart(const bool persistConfig = true);
 
 private:
     void loop();
 
     Task _rebootTask;
+    bool _persistConfig = true;
 };
 
 extern RestartHelperClass RestartHelper;
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <cstdint>
+#include <optional>
+
+// the state the DPL needs to resume regulating, kept by the DPL itself
+struct RtcDplState {
+    uint8_t Mode;
+    bool BatteryDischargeEnabled;
+    bool NighttimeDischarging;
+    bool FullSolarPassThroughEnabled;
+
+    bool operator==(RtcDplState const& other) const {
+        return Mode == other.Mode
+            && BatteryDischargeEnabled == other.BatteryDischargeEnabled
+            && NighttimeDischarging == other.NighttimeDischarging
+            && FullSolarPassThroughEnabled == other.FullSolarPassThroughEnabled;
+    }
+    bool operator!=(RtcDplState const& other) const { return !(*this == other); }
+};
+
+// keeps the wall-clock time, the system config (current limit) of each
+// inverter and the state of the DPL in RTC slow memory, which survives soft
+// resets (restarts, panics and watchdog resets). after such a reset, the
+// time is restored unless the system time survived as well, such that the
+// inverters can be controlled before NTP synchronized, and the limits are
+// restored like the ones cached on LittleFS, but more recent.
+//
+// each section is covered by its own CRC and written by a single task, so a
+// reset while writing only invalidates the section being written.
+class RtcStateClass {
+public:
+    RtcStateClass();
+
+    // to be called after the inverters were added and their cached data
+    // was restored from LittleFS
+    void init(Scheduler& scheduler);
+
+    // the state of the DPL before the soft reset, if any
+    std::optional<RtcDplState> getDplState() const { return _oDplState; }
+    void setDplState(RtcDplState const& state);
+
+private:
+    void loop();
+    void restoreTime();
+    void restoreInverters();
+
+    static constexpr uint32_t _magic = 0x53435452; // "RTCS"
+    static constexpr uint8_t _version = 1;
+
+    Task _loopTask;
+
+    bool _valid = false; // the record survived a soft reset
+    std::optional<RtcDplState> _oDplState = std::nullopt;
+    RtcDplState _lastDplState = {};
+};
+
+extern RtcStateClass RtcState;
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// periodically enumerates all FreeRTOS tasks and records their priority,
+// core affinity, stack high water mark and, if the run-time statistics are
+// available in the underlying FreeRTOS configuration, their share of CPU
+// time within the sampling window.
+class RtosTaskProfilerClass {
+public:
+    void init(Scheduler& scheduler);
+
+    struct TaskInfo {
+        std::array<char, configMAX_TASK_NAME_LEN> Name;
+        UBaseType_t Priority;
+        int8_t Core; // -1 if the task is not pinned to a core
+        uint32_t StackWatermark; // minimum amount of free stack in bytes
+        std::optional<float> CpuShare; // in percent of one core
+    };
+
+    std::vector<TaskInfo> getTasks() const;
+
+    static constexpr uint32_t SamplingWindowMillis = 10 * 1000;
+
+private:
+    void loop();
+
+    Task _loopTask;
+
+    mutable std::mutex _mutex;
+    std::vector<TaskInfo> _tasks;
+
+    // run-time counters as of the last sample, by task number
+    std::vector<std::pair<UBaseType_t, uint32_t>> _previousRunTime;
+    uint32_t _previousTotalRunTime = 0;
+};
+
+extern RtosTaskProfilerClass RtosTaskProfiler;
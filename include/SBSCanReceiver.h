@@ -12,7 +12,15 @@ public:
 
     std::shared_ptr<BatteryStats> getStats() const final { return _stats; }
 
+protected:
+    MessageIds getMessageIds() const final { return { _messageIds.data(), _messageIds.size() }; }
+
 private:
+    static constexpr std::array<uint32_t, 6> _messageIds = {
+        0x610, 0x630, 0x640, 0x650, 0x660, 0x670
+    };
+    static_assert(isSorted(_messageIds), "message ids must be sorted");
+
     void dummyData();
     std::shared_ptr<SBSBatteryStats> _stats =
         std::make_shared<SBSBatteryStats>();
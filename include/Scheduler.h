@@ -2,5 +2,40 @@
 #pragma once
 
 #include <TaskSchedulerDeclarations.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
-extern Scheduler scheduler;
\ No newline at end of file
+// the core the control plane is pinned to, see below. defaults to the core
+// not running the Arduino loop on chips with two cores.
+#ifndef CONTROL_PLANE_CORE
+#if portNUM_PROCESSORS > 1
+#define CONTROL_PLANE_CORE (1 - ARDUINO_RUNNING_CORE)
+#else
+#define CONTROL_PLANE_CORE 0
+#endif
+#endif
+
+// the I/O plane: web server, websockets, MQTT, display and logging. it is
+// executed by the Arduino loop.
+extern Scheduler scheduler;
+
+// the control plane: inverter radios, dynamic power limiter, power meter,
+// battery, solar charger and grid charger. executed by a task of its own
+// pinned to CONTROL_PLANE_CORE, such that its latency does not depend on
+// the load of the I/O plane.
+extern Scheduler controlScheduler;
+
+class ControlPlaneClass {
+public:
+    // starts executing the control scheduler. to be called at the end of
+    // setup(), after all control plane tasks were added.
+    void init();
+
+private:
+    static void loopHelper(void* context);
+    void loop();
+
+    TaskHandle_t _taskHandle = nullptr;
+};
+
+extern ControlPlaneClass ControlPlane;
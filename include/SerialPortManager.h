@@ -1,7 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <HardwareSerial.h>
 #include <array>
+#include <atomic>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -12,16 +15,61 @@ class SerialPortManagerClass {
 public:
     void init();
 
-    std::optional<uint8_t> allocatePort(std::string const& owner);
+    // the receive buffer size is applied by createSerial(), or is to be
+    // used by owners installing the UART driver themselves.
+    std::optional<uint8_t> allocatePort(std::string const& owner,
+            size_t rxBufferSize = _defaultRxBufferSize);
     void freePort(std::string const& owner);
 
+    // creates an instance for an allocated port which receives into a ring
+    // buffer of the size requested at allocation. the UART driver's event
+    // task fills this buffer and reports receive errors, and bytes read
+    // from the instance are counted. begin() must be called by the owner.
+    std::unique_ptr<HardwareSerial> createSerial(uint8_t port);
+
+    size_t getRxBufferSize(uint8_t port) const;
+
+    enum class Error : uint8_t {
+        Overrun, // FIFO overflow or receive buffer full
+        Framing,
+        Parity,
+        Break
+    };
+
+    // for owners which read from the UART driver themselves
+    void countRx(uint8_t port, size_t bytes);
+    void countError(uint8_t port, Error error);
+
+    struct Stats {
+        uint32_t RxBytes;
+        uint32_t Overruns;
+        uint32_t FramingErrors;
+        uint32_t ParityErrors;
+        uint32_t Breaks;
+    };
+    std::optional<Stats> getStats(uint8_t port) const;
+
     using allocations_t = std::vector<std::pair<int8_t, std::string>>;
     allocations_t getAllocations() const;
 
 private:
+    static size_t constexpr _defaultRxBufferSize = 256;
+
+    struct Counters {
+        std::atomic<uint32_t> RxBytes = 0;
+        std::atomic<uint32_t> Overruns = 0;
+        std::atomic<uint32_t> FramingErrors = 0;
+        std::atomic<uint32_t> ParityErrors = 0;
+        std::atomic<uint32_t> Breaks = 0;
+    };
+
+    class CountingSerial;
+
     // the amount of hardare UARTs available on supported ESP32 chips
     static size_t constexpr _num_controllers = 3;
     std::array<std::string, _num_controllers> _ports = { "" };
+    std::array<size_t, _num_controllers> _rxBufferSizes = { 0 };
+    std::array<Counters, _num_controllers> _counters;
     std::set<std::string> _rejects;
 };
 
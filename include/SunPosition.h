@@ -3,6 +3,8 @@
 
 #include <TaskSchedulerDeclarations.h>
 #include <atomic>
+#include <ctime>
+#include <mutex>
 #include <sunset.h>
 
 class SunPositionClass {
@@ -12,6 +14,10 @@ public:
 
     bool isDayPeriod() const;
     bool isSunsetAvailable() const;
+
+    // true if the sunrise of the current day is at most the given number
+    // of seconds ahead
+    bool isSunriseWithin(const uint32_t seconds) const;
     bool sunsetTime(struct tm* info) const;
     bool sunriseTime(struct tm* info) const;
     void setDoRecalc(const bool doRecalc);
@@ -19,18 +25,26 @@ public:
 private:
     void loop();
     void updateSunData();
-    bool checkRecalcDayChanged() const;
-    bool getSunTime(struct tm* info, const uint32_t offset) const;
 
-    Task _loopTask;
+    // the events of the current day, calculated once per day (and if the
+    // settings change), such that queries only compare against the time.
+    struct EventTable {
+        time_t Sunrise = 0;
+        time_t Sunset = 0;
+        time_t DayStart = 0; // local midnight
+        time_t DayEnd = 0; // next local midnight, table must be recalculated
+        bool IsSunsetAvailable = true;
+        bool IsValidInfo = false;
+    };
 
-    bool _isSunsetAvailable = true;
-    uint32_t _sunriseMinutes = 0;
-    uint32_t _sunsetMinutes = 0;
+    EventTable getEvents() const;
+    bool getSunTime(struct tm* info, time_t event) const;
+
+    Task _loopTask;
 
-    bool _isValidInfo = false;
+    mutable std::mutex _mutex;
+    EventTable _events;
     std::atomic_bool _doRecalc = true;
-    uint32_t _lastSunPositionCalculatedYMD = 0;
 };
 
 extern SunPositionClass SunPosition;
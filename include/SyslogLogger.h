@@ -2,6 +2,7 @@
 #pragma once
 #include <WiFiUdp.h>
 #include <TaskSchedulerDeclarations.h>
+#include <array>
 #include <mutex>
 
 class SyslogLogger {
@@ -20,6 +21,27 @@ private:
         return _address != INADDR_NONE;
     }
 
+    // messages are collected as octet-counted frames (RFC 6587) and sent as
+    // one datagram once it is full or when the loop task runs, such that
+    // verbose logging does not flood the network with tiny packets.
+    void appendFrame(char const* message, size_t length);
+    void flush();
+    void reportDropped(uint32_t dropped);
+
+    static constexpr uint32_t _flushIntervalMillis = 100;
+    static constexpr size_t _maxDatagramSize = 1400; // below the Ethernet MTU
+    static constexpr size_t _maxLineSize = 256; // longer lines are split
+
+    std::array<char, _maxLineSize> _line;
+    size_t _lineLength = 0;
+    std::array<char, _maxDatagramSize> _datagram;
+    size_t _datagramLength = 0;
+    uint16_t _datagramFrames = 0;
+
+    uint32_t _droppedFrames = 0; // protected by _mutex
+    uint32_t _reportedDroppedFrames = 0; // only accessed by the loop task
+    uint32_t _lastDropReport = 0;
+
     Task _loopTask;
     std::mutex _mutex;
     WiFiUDP _udp;
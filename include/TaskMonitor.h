@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <TaskSchedulerDeclarations.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// accounts for the invocations of the tasks executed by the (cooperative)
+// scheduler: number of invocations, cumulative and maximum runtime, and the
+// maximum lateness with respect to the task's schedule. a low-priority
+// FreeRTOS task acts as a watchdog and logs tasks which overran.
+//
+// the instance does not require dynamic initialization, such that wrap()
+// can be used in constructors of other global objects.
+class TaskMonitorClass {
+public:
+    // registers the scheduler executed by the calling FreeRTOS task
+    void init(Scheduler& scheduler);
+
+    // registers a further scheduler, executed by the calling FreeRTOS task
+    void addScheduler(Scheduler& scheduler);
+
+    // returns a callback which executes the given callback and accounts
+    // for it. the name must be a string literal, as only the pointer is
+    // stored. to be used when setting up a task's callback.
+    TaskCallback wrap(char const* name, TaskCallback callback);
+
+    struct TaskStats {
+        char const* Name;
+        uint32_t Invocations;
+        uint64_t TotalMicros;
+        uint32_t MaxMicros;
+        uint32_t MaxLatenessMillis;
+        uint32_t Overruns;
+    };
+
+    std::vector<TaskStats> getStats() const;
+
+    void serialize(JsonArray& target) const;
+
+    // invocations running longer are considered overruns
+    static constexpr uint32_t OverrunThresholdMillis = 250;
+
+private:
+    void execute(size_t idx, TaskCallback const& callback);
+
+    static void watchdogLoopHelper(void* context);
+    void watchdogLoop();
+
+    struct Entry {
+        char const* Name = nullptr;
+        uint32_t Invocations = 0;
+        uint64_t TotalMicros = 0;
+        uint32_t MaxMicros = 0;
+        uint32_t LastMicros = 0;
+        uint32_t MaxLatenessMillis = 0;
+        uint32_t Overruns = 0;
+    };
+
+    static constexpr size_t _maxTasks = 64;
+
+    static constexpr int _noTask = -1;
+
+    // a scheduler and the FreeRTOS task executing it
+    struct Plane {
+        Scheduler* pScheduler = nullptr;
+        TaskHandle_t Handle = nullptr;
+
+        // the task currently executed, observed by the watchdog
+        std::atomic<int> Current = _noTask;
+        std::atomic<uint32_t> CurrentStartMillis = 0;
+
+        // only accessed by the watchdog task
+        int ReportedTask = _noTask;
+        uint32_t ReportedStart = 0;
+    };
+
+    // the plane of the calling FreeRTOS task, if any
+    Plane* getPlane();
+
+    static constexpr size_t _maxPlanes = 2;
+    std::array<Plane, _maxPlanes> _planes;
+    std::atomic<size_t> _planeCount = 0;
+
+    // entries are registered from constructors and setup() only, i.e.,
+    // before the scheduler and any reader are running.
+    std::atomic<size_t> _count = 0;
+
+    mutable std::mutex _mutex;
+    std::array<Entry, _maxTasks> _entries;
+
+    // only accessed by the watchdog task
+    std::array<uint32_t, _maxTasks> _reportedOverruns = {};
+};
+
+extern TaskMonitorClass TaskMonitor;
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <WiFiUdp.h>
+#include <vector>
+
+// pushes readings as fixed-layout binary records by UDP to a collector at
+// the configured interval, which is much cheaper than formatting them as
+// MQTT or JSON payloads. all values are little-endian, floats are IEEE 754
+// single precision and NaN if unknown.
+//
+// each datagram starts with a header, followed by records:
+//   char[4] magic "ODTT", u8 schema version, u8 record count,
+//   u16 reserved, u32 sequence number, u32 uptime in milliseconds
+//
+// each record starts with u8 type and u8 total record length, such that
+// collectors can skip unknown records. the payload of the types is:
+//   Totals (1): f32 AC power, f32 yield day (Wh), f32 yield total (kWh),
+//       f32 DC power, u8 flags (bit 0: all enabled reachable, bit 1: at
+//       least one producing)
+//   Inverter (2): u64 serial, u8 flags (bit 0: reachable, bit 1:
+//       producing), u32 data age in milliseconds, f32 limit (%),
+//       u8 channel count, followed per channel by u8 channel type, u8
+//       channel number and five f32 values:
+//         AC: power, voltage, current, frequency, power factor
+//         DC: power, voltage, current, yield day, yield total
+//         INV: DC power, yield day, yield total, temperature, efficiency
+//   Battery (3): f32 SoC (%), f32 voltage, f32 current, u32 data age
+//       in seconds
+//   PowerMeter (4): f32 power, u32 data age in milliseconds, u8 valid
+//   PowerLimiter (5): u8 state, u8 mode, u16 expected inverter output (W),
+//       u8 inverter update timeouts
+//
+// if the records do not fit into one datagram, further datagrams with the
+// following sequence numbers are sent.
+class TelemetryStreamClass {
+public:
+    void init(Scheduler& scheduler);
+
+    static constexpr uint8_t SchemaVersion = 1;
+
+private:
+    enum class Record : uint8_t {
+        Totals = 1,
+        Inverter = 2,
+        Battery = 3,
+        PowerMeter = 4,
+        PowerLimiter = 5,
+    };
+
+    void loop();
+    bool resolve();
+    void send();
+
+    void beginRecord(Record type);
+    void endRecord();
+    void addInverterRecord(std::shared_ptr<InverterAbstract> const& inv);
+    void putFloat(float value);
+    void putUint(uint64_t value, size_t bytes);
+    void flush();
+
+    static constexpr size_t _maxDatagramSize = 1400; // below the Ethernet MTU
+    static constexpr size_t _headerSize = 16;
+
+    Task _loopTask;
+    WiFiUDP _udp;
+    bool _started = false;
+    IPAddress _address;
+    String _hostname; // _address was resolved for
+    uint16_t _port = 0;
+    uint32_t _sequence = 0;
+
+    // the datagram being assembled, and the record being appended, which
+    // is moved to the next datagram if it does not fit anymore
+    std::vector<uint8_t> _datagram;
+    std::vector<uint8_t> _record;
+    uint8_t _recordCount = 0;
+};
+
+extern TelemetryStreamClass TelemetryStream;
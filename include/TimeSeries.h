@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "MemoryPolicy.h"
+#include <ArduinoJson.h>
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// keeps a history of inverter, battery and power meter values on the device.
+// samples are taken every 10 seconds and downsampled into tiers of coarser
+// resolution. values are delta/varint encoded into fixed-size segments, which
+// are persisted to LittleFS into one file per series holding a ring of
+// segments for each tier.
+class TimeSeriesClass {
+public:
+    TimeSeriesClass();
+    void init(Scheduler& scheduler);
+
+    static constexpr uint8_t TierCount = 3;
+    static uint32_t getTierInterval(uint8_t tier);
+
+    // lists all known series (key and unit)
+    void serializeSeries(JsonArray& target) const;
+
+    // appends [timestamp, value] pairs of all samples of the given series and
+    // tier within [from, to] (unix time). returns false if the series is not
+    // known. at most maxPoints are added, the oldest first.
+    bool query(String const& key, uint8_t tier, uint32_t from, uint32_t to,
+            size_t maxPoints, JsonArray& target, bool& truncated) const;
+
+    struct Bucket {
+        float Min;
+        float Max;
+        float Avg;
+        uint16_t Count; // zero if there are no samples within the bucket
+    };
+
+    // returns the coarsest tier which still provides at least one sample per
+    // bucket of the given width (in seconds).
+    static uint8_t selectTier(uint32_t bucketWidth);
+
+    // splits [from, to) into count buckets of equal width and aggregates
+    // the samples of the given series and tier within each of them. returns
+    // false if the series is not known.
+    bool getBuckets(String const& key, uint8_t tier, uint32_t from, uint32_t to,
+            size_t count, std::vector<Bucket>& target) const;
+
+    // compact binary form of the bucket averages of [from, from + count * step)
+    // as sent to the web application. all values are little endian:
+    //   uint8_t version, uint8_t tier, uint16_t count,
+    //   uint32_t from, uint32_t step, float scale,
+    //   followed by count int16_t deltas of the value * scale to the value
+    //   of the previous bucket with samples (initially zero).
+    // the delta RangeGap marks a bucket without samples, RangeEscape is
+    // followed by the absolute value as int32_t if the delta exceeds int16_t.
+    static constexpr uint8_t RangeVersion = 1;
+    static constexpr int16_t RangeGap = INT16_MIN;
+    static constexpr int16_t RangeEscape = INT16_MIN + 1;
+    bool getRange(String const& key, uint8_t tier, uint32_t from, uint32_t step,
+            size_t count, std::vector<uint8_t>& target) const;
+
+private:
+    void loop();
+    void addMissingSeries();
+
+    using getter_t = std::function<std::optional<float>()>;
+    void addSeries(String const& key, char const* unit, float scale, getter_t getter);
+
+    static constexpr size_t SegmentSize = 128;
+
+    struct Segment {
+        uint32_t Start; // unix time of the first sample, zero for empty slots
+        uint16_t Count; // number of samples
+        uint16_t Length; // number of used bytes in Data
+        uint8_t Data[SegmentSize - 8];
+    };
+    static_assert(sizeof(Segment) == SegmentSize, "unexpected segment padding");
+
+    struct Tier {
+        Segment Active = {};
+        int32_t LastValue = 0; // last encoded value of the active segment
+        size_t Slot = 0; // slot of the active segment within the ring file
+        bool Dirty = false; // active segment changed since it was persisted
+
+        uint32_t BucketStart = 0; // start of the bucket being aggregated
+        float BucketSum = 0;
+        uint16_t BucketCount = 0;
+    };
+
+    struct Series {
+        String Key;
+        char const* Unit;
+        float Scale; // values are stored as integers of value * scale
+        getter_t Getter;
+        std::array<Tier, TierCount> Tiers;
+    };
+
+    void addSample(Series& series, uint32_t timestamp, std::optional<float> value);
+    void append(Series& series, uint8_t tier, uint32_t timestamp, std::optional<float> value);
+    void closeSegment(Series& series, uint8_t tier);
+    // a deferrable write is postponed if the flash write budget is exhausted,
+    // the segment stays dirty then.
+    void persist(Series& series, uint8_t tier, bool deferrable = false);
+
+    static String getFilename(Series const& series);
+    static size_t getSlotCount(uint8_t tier);
+    static size_t getSlotOffset(uint8_t tier);
+    static size_t findNextSlot(String const& filename, uint8_t tier);
+    static bool createFile(String const& filename);
+    static void decode(Segment const& segment, uint32_t interval, float scale,
+            std::function<void(uint32_t, float)> callback);
+
+    Series const* findSeries(String const& key) const;
+    // segments of a range are cold data, see MemoryPolicy
+    static MemoryPolicy::BulkVector<Segment> loadSegments(Series const& series, uint8_t tier,
+            uint32_t from, uint32_t to);
+
+    Task _loopTask;
+
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<Series>> _series;
+    uint32_t _lastPersist = 0;
+    uint32_t _lastTimestamp = 0;
+};
+
+extern TimeSeriesClass TimeSeries;
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+// accounts for the TLS handshakes of the MQTT client and the HTTP(S)
+// power meters, which cost seconds of CPU time and tens of kilobytes of
+// heap each. also reports whether mbedTLS uses the crypto accelerators,
+// which is decided when the framework is built.
+class TlsMonitorClass {
+public:
+    enum class Client : uint8_t {
+        Mqtt,
+        Http,
+        Count
+    };
+
+    void recordHandshake(Client client, bool success, uint32_t durationMs);
+
+    void serialize(JsonObject& target) const;
+
+private:
+    struct Counters {
+        uint32_t Handshakes = 0;
+        uint32_t Failures = 0;
+        uint32_t LastDurationMs = 0;
+        uint32_t MaxDurationMs = 0;
+        uint64_t TotalDurationMs = 0; // of successful handshakes
+    };
+
+    mutable std::mutex _mutex;
+    std::array<Counters, static_cast<size_t>(Client::Count)> _counters;
+};
+
+extern TlsMonitorClass TlsMonitor;
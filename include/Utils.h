@@ -4,7 +4,9 @@
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 #include <cstdint>
+#include <memory>
 #include <utility>
+#include <vector>
 
 class Utils {
 public:
@@ -12,6 +14,14 @@ public:
     static uint64_t generateDtuSerial();
     static int getTimezoneOffset();
     static bool checkJsonAlloc(const JsonDocument& doc, const char* function, const uint16_t line);
+
+    // serializes the document into a buffer of exactly the required size,
+    // which can be shared among all websocket clients without copies.
+    static std::shared_ptr<std::vector<uint8_t>> serializeJsonShared(const JsonDocument& doc);
+
+    // JSON merge patches (RFC 7386) as sent by the live view websockets
+    static bool generateJsonMergePatch(JsonObjectConst previous, JsonObjectConst current, JsonObject delta);
+    static void applyJsonMergePatch(JsonObject state, JsonObjectConst delta);
     static void removeAllFiles();
     static String generateMd5FromFile(String file);
     static void skipBom(File& f);
@@ -20,6 +30,11 @@ public:
     template<typename T>
     static std::pair<T, String> getJsonValueByPath(JsonDocument const& root, String const& path);
 
+    // adds the nodes along the given JSON path to a deserialization filter,
+    // such that only the values required by getJsonValueByPath() are kept
+    // while the JSON input is parsed as a stream.
+    static void addJsonPathToFilter(JsonDocument& filter, String const& path);
+
     template <typename T>
     static std::optional<T> getNumericValueFromMqttPayload(char const* client,
             std::string const& src, char const* topic, char const* jsonPath);
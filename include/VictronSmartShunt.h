@@ -9,9 +9,11 @@ public:
     void deinit() final;
     void loop() final;
     std::shared_ptr<BatteryStats> getStats() const final { return _stats; }
+    std::optional<ElectricalSample> getElectricalSample() const final;
 
 private:
     static char constexpr _serialPortOwner[] = "SmartShunt";
+    static size_t constexpr _rxBufferSize = 512;
 
     uint32_t _lastUpdate = 0;
     std::shared_ptr<VictronSmartShuntStats> _stats =
@@ -17,7 +17,7 @@ public:
     W5500& operator=(const W5500&) = delete;
     ~W5500();
 
-    static std::unique_ptr<W5500> setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin_sclk, int8_t pin_cs, int8_t pin_int, int8_t pin_rst);
+    static std::unique_ptr<W5500> setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin_sclk, int8_t pin_cs, int8_t pin_int, int8_t pin_rst, uint8_t spi_mhz);
     String macAddress();
 
 private:
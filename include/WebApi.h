@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "WebApi_admission.h"
 #include "WebApi_battery.h"
+#include "WebApi_bootstrap.h"
 #include "WebApi_device.h"
 #include "WebApi_devinfo.h"
 #include "WebApi_dtu.h"
@@ -23,17 +25,25 @@
 #include "WebApi_prometheus.h"
 #include "WebApi_security.h"
 #include "WebApi_sysstatus.h"
+#include "WebApi_timeseries.h"
 #include "WebApi_webapp.h"
 #include "WebApi_ws_console.h"
+#include "WebApi_ws_hub.h"
 #include "WebApi_ws_live.h"
+#include "WebApi_ws_shelly.h"
 #include <AsyncJson.h>
 #include "WebApi_ws_solarcharger_live.h"
 #include "WebApi_solarcharger.h"
 #include "WebApi_ws_Huawei.h"
 #include "WebApi_Huawei.h"
 #include "WebApi_ws_battery.h"
+#include "MemoryPolicy.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
 
 class WebApiClass {
 public:
@@ -41,21 +51,69 @@ public:
     void init(Scheduler& scheduler);
     void reload();
 
-    static bool checkCredentials(AsyncWebServerRequest* request);
+    // a session token is accepted in place of the password, unless the
+    // request is meant to prove knowledge of the password.
+    static bool checkCredentials(AsyncWebServerRequest* request, const bool acceptSessionToken = true);
     static bool checkCredentialsReadonly(AsyncWebServerRequest* request);
 
     static void sendTooManyRequests(AsyncWebServerRequest* request);
 
     static void writeConfig(JsonVariant& retMsg, const WebApiError code = WebApiError::GenericSuccess, const String& message = "Settings saved!");
 
+    // deserializes the JSON body collected by onRequestBody(), or the
+    // "data" form field if the request carries form data
     static bool parseRequestData(AsyncWebServerRequest* request, AsyncJsonResponse* response, JsonDocument& json_document);
+
+    // body handler of POST endpoints using parseRequestData(). a body sent
+    // as application/json is kept in the chunks it arrives in, such that no
+    // contiguous buffer of the body's size is needed, neither while it is
+    // received nor while it is deserialized.
+    static void onRequestBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+
+    using body_chunks_t = std::vector<MemoryPolicy::BulkVector<char>>;
     static uint64_t parseSerialFromRequest(AsyncWebServerRequest* request, String param_name = "inv");
     static bool sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResponse* response, const char* function, const uint16_t line);
 
+    // responses smaller than this are not worth compressing
+    static constexpr size_t GzipMinSize = 1024;
+
+    static bool acceptsGzip(AsyncWebServerRequest* request);
+    static std::shared_ptr<std::vector<uint8_t>> gzip(std::vector<uint8_t> const& data);
+
+    // sends the buffer, which is kept alive by the response
+    static void sendBuffer(AsyncWebServerRequest* request, const char* contentType, std::shared_ptr<std::vector<uint8_t>> const& data, bool gzipped);
+
+    // like AsyncWebServerRequest::beginChunkedResponse(), but compresses the
+    // output of the filler while it is sent if the client accepts gzip.
+    static AsyncWebServerResponse* beginChunkedResponse(AsyncWebServerRequest* request, const char* contentType, AwsResponseFiller filler);
+
+    // the request only provides a single disconnect handler, which is
+    // shared by all callbacks registered using this function. they are
+    // called once the request is finished or aborted.
+    void onRequestEnd(AsyncWebServerRequest* request, std::function<void()> callback);
+
+    WebApiWsHubClass& getWsHub() { return _webApiWsHub; }
+    WebApiWsShellyClass& getWsShelly() { return _webApiWsShelly; }
+    WebApiWsLiveClass& getWsLive() { return _webApiWsLive; }
+
 private:
     AsyncWebServer _server;
 
+    struct RequestBody {
+        body_chunks_t Chunks;
+        bool Overflowed = false;
+    };
+
+    // requests are handled by the web server's task only
+    std::map<AsyncWebServerRequest const*, RequestBody> _requestBodies;
+    static constexpr size_t _maxRequestBodySize = 64 * 1024;
+
+    std::map<AsyncWebServerRequest const*, std::vector<std::function<void()>>> _requestEndCallbacks;
+
+    WebApiAdmissionMiddleware _admission;
+
     WebApiBatteryClass _webApiBattery;
+    WebApiBootstrapClass _webApiBootstrap;
     WebApiDeviceClass _webApiDevice;
     WebApiDevInfoClass _webApiDevInfo;
     WebApiDtuClass _webApiDtu;
@@ -76,13 +134,18 @@ private:
     WebApiPrometheusClass _webApiPrometheus;
     WebApiSecurityClass _webApiSecurity;
     WebApiSysstatusClass _webApiSysstatus;
+    WebApiTimeSeriesClass _webApiTimeSeries;
     WebApiWebappClass _webApiWebapp;
     WebApiWsConsoleClass _webApiWsConsole;
+    WebApiWsHubClass _webApiWsHub;
     WebApiWsLiveClass _webApiWsLive;
+    WebApiWsShellyClass _webApiWsShelly;
     WebApiWsSolarChargerLiveClass _webApiWsSolarChargerLive;
     WebApiSolarChargerlass _webApiSolarCharger;
+#ifndef OPENDTU_WITHOUT_HUAWEI
     WebApiHuaweiClass _webApiHuaweiClass;
     WebApiWsHuaweiLiveClass _webApiWsHuaweiLive;
+#endif
     WebApiWsBatteryLiveClass _webApiWsBatteryLive;
 };
 
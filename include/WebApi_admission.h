@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// limits the number of requests served at the same time per class of
+// route, such that a couple of dashboards and a Prometheus scrape cannot
+// saturate the TCP stack shared with the networked power meters. while the
+// heap runs low, requests are rejected with 503 and a Retry-After header.
+// control commands (limit and power) are always admitted, as are websocket
+// upgrades, which are limited by their handlers.
+class WebApiAdmissionMiddleware : public AsyncMiddleware {
+public:
+    enum class Lane : uint8_t {
+        Control,
+        Static, // the web application's assets
+        Live, // live data polled by dashboards
+        Config, // all other API endpoints
+        Metrics, // Prometheus scrapes
+        Count
+    };
+
+    void init();
+    void run(AsyncWebServerRequest* request, ArMiddlewareNext next) override;
+
+private:
+    static Lane classify(AsyncWebServerRequest* request);
+    static void reject(AsyncWebServerRequest* request, char const* retryAfter);
+
+    // requests are handled by the web server's task only
+    bool admit(AsyncWebServerRequest* request, Lane lane);
+    void release(AsyncWebServerRequest const* request);
+    void expireStale();
+
+    static constexpr size_t _laneCount = static_cast<size_t>(Lane::Count);
+
+    // zero if not limited
+    static constexpr std::array<uint8_t, _laneCount> _limits = { 0, 3, 3, 2, 1 };
+
+    // below this largest free block, only control requests are admitted
+    static constexpr uint32_t _minMaxAllocHeap = 16 * 1024;
+
+    // a slot is released when the client disconnects. should that be
+    // missed, slots are released after this long, which is longer than
+    // any regular response takes.
+    static constexpr uint32_t _staleMillis = 60 * 1000;
+
+    struct Slot {
+        AsyncWebServerRequest const* Request = nullptr; // nullptr if unused
+        Lane RouteLane = Lane::Control;
+        uint32_t StartMillis = 0;
+    };
+    std::array<Slot, 16> _slots;
+    std::array<uint8_t, _laneCount> _inFlight = {};
+
+    // read by the metrics exporter
+    std::array<std::atomic<uint32_t>, _laneCount> _busyRejections = {};
+    std::atomic<uint32_t> _heapRejections = 0;
+};
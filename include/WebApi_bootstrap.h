@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+
+// everything the home view needs on its initial load in a single response:
+// the live data status as sent by /api/livedata/status along with the limit,
+// power command and device info status of all inverters.
+class WebApiBootstrapClass {
+public:
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+
+private:
+    void onBootstrap(AsyncWebServerRequest* request);
+};
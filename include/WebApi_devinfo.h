@@ -1,13 +1,18 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 
+class InverterAbstract;
+
 class WebApiDevInfoClass {
 public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
+    static void generateStatus(JsonObject root, InverterAbstract& inv);
+
 private:
     void onDevInfoStatus(AsyncWebServerRequest* request);
 };
@@ -13,6 +13,11 @@ private:
     void onDtuAdminGet(AsyncWebServerRequest* request);
     void onDtuAdminPost(AsyncWebServerRequest* request);
 
+    // records the radio traffic, see RadioRecorder
+    void onCaptureGet(AsyncWebServerRequest* request);
+    void onCapturePost(AsyncWebServerRequest* request);
+    static constexpr size_t _maxCaptureSize = 4000;
+
     Task _applyDataTask;
     void applyDataTaskCb();
 };
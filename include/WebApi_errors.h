@@ -17,6 +17,7 @@ enum WebApiError {
     DtuInvalidPowerLevel,
     DtuInvalidCmtFrequency,
     DtuInvalidCmtCountry,
+    DtuInvalidCaptureSize,
 
     FileBase = 3000,
     FileNotDeleted,
@@ -63,6 +64,7 @@ enum WebApiError {
     MqttHassTopicCharacter,
     MqttLwtQos,
     MqttClientIdLength,
+    MqttDeadband,
 
     NetworkBase = 8000,
     NetworkIpInvalid,
@@ -73,6 +75,12 @@ enum WebApiError {
     NetworkApTimeoutInvalid,
     NetworkSyslogHostnameLength,
     NetworkSyslogPort,
+    NetworkTelemetryHostnameLength,
+    NetworkTelemetryPort,
+    NetworkTelemetryInterval,
+    NetworkModbusPort,
+    NetworkMetricsPushUrl,
+    NetworkMetricsPushInterval,
 
     NtpBase = 9000,
     NtpServerLength,
@@ -2,7 +2,9 @@
 #pragma once
 
 #include <ESPAsyncWebServer.h>
+#include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
+#include <vector>
 
 class WebApiEventlogClass {
 public:
@@ -10,4 +12,26 @@ public:
 
 private:
     void onEventlogStatus(AsyncWebServerRequest* request);
+
+    struct Event {
+        uint8_t Index; // position in the inverter's event log
+        uint32_t Sequence;
+        AlarmLogEntry_t Entry;
+    };
+
+    // the events are collected when the request is received and serialized
+    // one by one while the response is sent.
+    struct Generator {
+        String Pending; // generated output not yet handed to the web server
+        size_t Offset = 0; // number of bytes of Pending already handed over
+        uint8_t Count = 0;
+        uint32_t Sequence = 0;
+        std::vector<Event> Events;
+        size_t NextEvent = 0;
+        bool HeaderDone = false;
+        bool Done = false;
+    };
+
+    static size_t fillChunk(Generator& gen, uint8_t* buffer, size_t maxLen);
+    static bool generateNext(Generator& gen);
 };
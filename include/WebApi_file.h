@@ -2,7 +2,13 @@
 #pragma once
 
 #include <ESPAsyncWebServer.h>
+#include <LittleFS.h>
 #include <TaskSchedulerDeclarations.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 class WebApiFileClass {
 public:
@@ -15,4 +21,31 @@ private:
     void onFileListGet(AsyncWebServerRequest* request);
     void onFileUploadFinish(AsyncWebServerRequest* request);
     void onFileUpload(AsyncWebServerRequest* request, String filename, size_t index, uint8_t* data, size_t len, bool final);
+
+    // the chunks of an upload are written by a task of their own, such that
+    // the TCP stack is not blocked while the flash is written. only one
+    // upload is processed at a time.
+    struct Upload {
+        AsyncWebServerRequest* Request; // nullptr once disconnected
+        String Name;
+        File F; // only accessed by the writer task
+        std::deque<std::vector<uint8_t>> Chunks;
+        size_t QueuedBytes = 0;
+        bool Complete = false; // all chunks were received or aborted
+        bool Done = false; // all chunks were written and the file closed
+        bool Failed = false;
+    };
+
+    // the TCP callback waits for the writer once this much data is queued
+    static constexpr size_t _maxQueuedBytes = 16 * 1024;
+
+    static void writerLoopHelper(void* context);
+    void writerLoop();
+    bool writeChunk(Upload& upload, std::vector<uint8_t> const& chunk);
+    void finishUpload(Upload& upload, bool aborted);
+
+    std::mutex _uploadMutex;
+    std::condition_variable _uploadCv;
+    std::shared_ptr<Upload> _spUpload;
+    TaskHandle_t _writerTaskHandle = nullptr;
 };
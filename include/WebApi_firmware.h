@@ -1,12 +1,19 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "OtaInflater.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+#include <atomic>
 
 class WebApiFirmwareClass {
 public:
+    WebApiFirmwareClass();
     void init(AsyncWebServer& server, Scheduler& scheduler);
+    void reload();
 
 private:
     bool otaSupported() const;
@@ -14,4 +21,60 @@ private:
     void onFirmwareUpdateFinish(AsyncWebServerRequest* request);
     void onFirmwareUpdateUpload(AsyncWebServerRequest* request, String filename, size_t index, uint8_t* data, size_t len, bool final);
     void onFirmwareStatus(AsyncWebServerRequest* request);
+
+    // the upload handler only copies the received data into a stream buffer,
+    // which is drained by a task writing the flash, such that the web server
+    // does not wait for flash erase and write cycles.
+    bool startWriter(size_t expectedSize);
+    void abortWriter();
+    static void writerLoopHelper(void* context);
+    void writerLoop();
+
+    enum class State : uint8_t {
+        Idle,
+        Receiving,
+        Verifying,
+        Done,
+        Failed
+    };
+    static char const* getStateName(State state);
+    void fail(char const* error);
+
+    void progressLoop();
+    void sendProgress();
+
+    static constexpr size_t _streamBufferSize = 16 * 1024;
+    static constexpr uint32_t _writerIdleTimeoutMillis = 30 * 1000;
+    static constexpr uint32_t _finishWaitMillis = 100;
+
+    StreamBufferHandle_t _streamBuffer = nullptr;
+    SemaphoreHandle_t _writerDone = nullptr;
+    TaskHandle_t _writerTaskHandle = nullptr;
+
+    // the request uploading the firmware, only accessed by the web server
+    AsyncWebServerRequest* _uploadRequest = nullptr;
+
+    std::atomic<State> _state = State::Idle;
+    std::atomic<bool> _uploadComplete = false;
+    std::atomic<bool> _abortRequested = false;
+    std::atomic<bool> _restartOnDone = false; // set if the result is sent by the websocket
+    std::atomic<uint32_t> _expectedSize = 0; // including multipart overhead
+    std::atomic<uint32_t> _received = 0;
+    std::atomic<uint32_t> _written = 0;
+    std::atomic<uint32_t> _startMillis = 0;
+    std::atomic<uint32_t> _durationMillis = 0;
+    std::atomic<char const*> _error = ""; // string literal
+
+    // gzip-compressed images are decompressed by the writer task. the MD5
+    // sum sent along refers to the uploaded file, so it is verified by the
+    // writer task rather than the updater in that case.
+    std::atomic<bool> _compressed = false;
+    String _uploadMd5;
+    OtaInflater _inflater; // only accessed by the writer task
+
+    AsyncWebSocket _ws;
+    AsyncAuthenticationMiddleware _simpleDigestAuth;
+
+    Task _progressTask;
+    State _lastSentState = State::Idle;
 };
@@ -15,4 +15,19 @@ private:
     void onInverterDelete(AsyncWebServerRequest* request);
     void onInverterOrder(AsyncWebServerRequest* request);
     void onInverterStatReset(AsyncWebServerRequest* request);
+
+    // the list is generated from the configuration one inverter at a time
+    // while the response is sent, such that the memory used does not
+    // depend on the number of inverters.
+    struct Generator {
+        String Pending; // generated output not yet handed to the web server
+        size_t Offset = 0; // number of bytes of Pending already handed over
+        uint8_t NextInverter = 0; // position in the configuration
+        uint8_t Count = 0; // inverters generated so far
+        bool HeaderDone = false;
+        bool Done = false;
+    };
+
+    static size_t fillChunk(Generator& gen, uint8_t* buffer, size_t maxLen);
+    static bool generateNext(Generator& gen);
 };
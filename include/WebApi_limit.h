@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 
@@ -8,6 +9,9 @@ class WebApiLimitClass {
 public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
+    // the limits of all inverters keyed by their serial
+    static void generateStatus(JsonObject root);
+
 private:
     void onLimitStatus(AsyncWebServerRequest* request);
     void onLimitPost(AsyncWebServerRequest* request);
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 
@@ -8,6 +9,9 @@ class WebApiPowerClass {
 public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
+    // the state of the last power command per inverter keyed by its serial
+    static void generateStatus(JsonObject root);
+
 private:
     void onPowerStatus(AsyncWebServerRequest* request);
     void onPowerPost(AsyncWebServerRequest* request);
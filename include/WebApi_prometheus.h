@@ -4,18 +4,70 @@
 #include <ESPAsyncWebServer.h>
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
-#include <map>
+#include <set>
+#include <vector>
 
 class WebApiPrometheusClass {
+    friend class BenchmarkClass;
+
 public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
 private:
     void onPrometheusMetricsGet(AsyncWebServerRequest* request);
 
-    void addField(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName = nullptr);
+    // the response is generated in chunks, one section or inverter at a
+    // time, such that no buffer for the complete response is required.
+    enum class Step : uint8_t {
+        System = 0,
+        Latency,
+        Tasks,
+        RtosTasks,
+        Registry,
+        Battery,
+        PowerMeter,
+        Inverters,
+        Done
+    };
+
+    struct Generator {
+        String Pending; // generated output not yet handed to the web server
+        size_t Offset = 0; // number of bytes of Pending already handed over
+        Step NextStep = Step::System;
+        uint8_t NextInverter = 0;
+        size_t NextMetric = 0; // of the metrics registry
+        std::set<String> Families; // metric families whose header was added
+    };
+
+    size_t fillChunk(Generator& gen, uint8_t* buffer, size_t maxLen);
+    bool generateNext(Generator& gen);
+
+    static void appendf(String& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+    static void addHeader(Generator& gen, const char* name, const char* help, const char* type);
+
+    void addSystemMetrics(Generator& gen);
+    void addLatencyMetrics(Generator& gen);
+    void addTaskMetrics(Generator& gen);
+    void addRtosTaskMetrics(Generator& gen);
+    bool addRegistryMetrics(Generator& gen);
+    void addBatteryMetrics(Generator& gen);
+    void addPowerMeterMetrics(Generator& gen);
+    void addInverterMetrics(Generator& gen, const uint8_t idx);
+
+    // the labels shared by all metrics of an inverter, by its position.
+    // they are only formatted again if the inverter or its name changed.
+    struct InverterLabels {
+        uint64_t Serial = 0;
+        String Name;
+        String Labels;
+    };
+    std::vector<InverterLabels> _inverterLabels;
+    const String& getInverterLabels(std::shared_ptr<InverterAbstract> inv, const uint8_t idx);
+
+    void addField(Generator& gen, const String& labels, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName = nullptr);
 
-    void addPanelInfo(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel);
+    void addPanelInfo(Generator& gen, const String& labels, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel);
+    void addRadioHistograms(Generator& gen, const String& labels, std::shared_ptr<InverterAbstract> inv);
 
     enum MetricType_t {
         NONE = 0,
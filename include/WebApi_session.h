@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+// issues short-lived session tokens after a successful login, which are
+// accepted in place of the password afterwards. a token is an expiry time
+// and a nonce, signed with a HMAC that uses a random key generated at boot,
+// so validating it is much cheaper than checking digest credentials. tokens
+// validated recently are remembered, such that polling clients do not even
+// cause a HMAC calculation. all tokens become invalid on reboot and whenever
+// the security settings change.
+//
+// tokens are passed as "Authorization: Bearer <token>" header. only
+// websockets, where clients cannot set headers, also accept them as "token"
+// query parameter, as URLs end up in logs and browser histories. the web
+// app sends its token as "X-Session-Token" header along with the basic
+// credentials, which are checked if the token is no longer valid.
+class WebApiSessionClass {
+public:
+    // generates a new key, which invalidates all tokens issued so far.
+    // must be called once the random number generator is seeded by the radio.
+    void reset();
+
+    String issue();
+    bool isValid(AsyncWebServerRequest* request, const bool acceptQueryParam = false);
+
+    static constexpr uint32_t LifetimeSeconds = 60 * 60;
+
+private:
+    static constexpr size_t _payloadSize = 12; // expiry and nonce
+    static constexpr size_t _macSize = 16; // truncated HMAC-SHA256
+    static constexpr size_t _tokenSize = _payloadSize + _macSize;
+    static constexpr size_t _cacheSize = 8;
+
+    using token_t = std::array<uint8_t, _tokenSize>;
+
+    bool validate(String const& hex);
+    void sign(token_t& token) const;
+    static uint32_t getUptimeSeconds();
+    static bool equalConstantTime(uint8_t const* a, uint8_t const* b, size_t len);
+
+    struct CacheEntry {
+        token_t Token;
+        uint32_t Expiry = 0; // zero if unused
+        uint32_t LastUse = 0;
+    };
+
+    std::mutex _mutex;
+    std::array<uint8_t, 32> _key = {};
+    std::array<CacheEntry, _cacheSize> _cache;
+};
+
+extern WebApiSessionClass WebApiSession;
+
+// lets requests with a valid session token, which may also be passed as
+// query parameter, pass and hands all others to the given middleware,
+// i.e., the digest authentication of a websocket.
+class WebApiSessionMiddleware : public AsyncMiddleware {
+public:
+    explicit WebApiSessionMiddleware(AsyncMiddleware& fallback)
+        : _fallback(fallback) { }
+
+    void run(AsyncWebServerRequest* request, ArMiddlewareNext next) override;
+
+private:
+    AsyncMiddleware& _fallback;
+};
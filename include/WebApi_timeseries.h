@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+
+class WebApiTimeSeriesClass {
+public:
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+
+private:
+    void onSeriesList(AsyncWebServerRequest* request);
+    void onQuery(AsyncWebServerRequest* request);
+    void onRange(AsyncWebServerRequest* request);
+};
@@ -9,5 +9,8 @@ public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
 private:
-    void responseBinaryDataWithETagCache(AsyncWebServerRequest* request, const String &contentType, const String &contentEncoding, const uint8_t *content, size_t len);
+    static constexpr char const* RevalidateCacheControl = "public, must-revalidate";
+    static constexpr char const* ImmutableCacheControl = "public, max-age=31536000, immutable";
+
+    void responseBinaryDataWithETagCache(AsyncWebServerRequest* request, const String &contentType, const String &contentEncoding, const uint8_t *content, size_t len, const char* eTag, const char* cacheControl = RevalidateCacheControl);
 };
@@ -2,6 +2,8 @@
 #pragma once
 
 #include "ArduinoJson.h"
+#include "WebApi_session.h"
+#include "WebApi_ws_flow.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 #include <mutex>
@@ -19,7 +21,9 @@ private:
 
     AsyncWebServer* _server;
     AsyncWebSocket _ws;
+    WebApiWsFlowControl _flow { _ws };
     AsyncAuthenticationMiddleware _simpleDigestAuth;
+    WebApiSessionMiddleware _sessionAuth { _simpleDigestAuth };
 
     std::mutex _mutex;
     
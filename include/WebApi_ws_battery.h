@@ -2,9 +2,14 @@
 #pragma once
 
 #include "ArduinoJson.h"
+#include "BatteryStats.h"
+#include "WebApi_session.h"
+#include "WebApi_ws_flow.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 class WebApiWsBatteryLiveClass {
 public:
@@ -13,19 +18,40 @@ public:
     void reload();
 
 private:
-    void generateCommonJsonResponse(JsonVariant& root);
     void onLivedataStatus(AsyncWebServerRequest* request);
     void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
 
+    // regenerates the live view if the battery published a new snapshot
+    // since, writing the changes into delta. returns true if there are any.
+    bool updateState(JsonObject delta);
+
+    // adds the cached live view with its data age relative to now
+    void addState(JsonObject root);
+
+    void sendSnapshot(std::vector<uint32_t> const& clientIds, std::vector<uint32_t> const& hubClientIds);
+    void requestHubSnapshot(uint32_t clientId);
+
     AsyncWebServer* _server;
     AsyncWebSocket _ws;
+    WebApiWsFlowControl _flow { _ws, true }; // deltas need a resync
     AsyncAuthenticationMiddleware _simpleDigestAuth;
-
-    uint32_t _lastUpdateCheck = 0;
-    static constexpr uint16_t _responseSize = 1024 + 512;
+    WebApiSessionMiddleware _sessionAuth { _simpleDigestAuth };
 
     std::mutex _mutex;
 
+    // the live view of the snapshot it was generated from, which is reused
+    // until the battery publishes the next one. deltas are generated
+    // against it. protected by _mutex.
+    std::shared_ptr<BatteryStats const> _spStateStats = nullptr;
+    JsonDocument _state;
+    uint32_t _sequence = 0;
+    uint32_t _lastPublish = 0;
+
+    // clients which need a full snapshot before they can apply deltas
+    std::mutex _snapshotMutex;
+    std::vector<uint32_t> _snapshotClients;
+    std::vector<uint32_t> _hubSnapshotClients; // subscribers of the hub websocket
+
     Task _wsCleanupTask;
     void wsCleanupTaskCb();
 
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// broadcasts the messages of a live view websocket only to clients which
+// sent everything queued for them before. as each message supersedes the
+// previous one, a slow client skips messages and later receives the newest
+// instead of an ever-growing queue. clients which could not be sent a
+// message for too long are disconnected.
+class WebApiWsFlowControl {
+public:
+    // with resync, a client which skipped messages is not sent further
+    // messages until it was handed out by takeResync(). this suits streams
+    // of deltas, which such a client cannot apply anymore.
+    explicit WebApiWsFlowControl(AsyncWebSocket& ws, bool resync = false);
+
+    // to be called for all events of the websocket
+    void onEvent(AsyncWebSocketClient* client, AwsEventType type);
+
+    void textAll(std::shared_ptr<std::vector<uint8_t>> const& message);
+
+    // the ids of clients which caught up after skipping messages and need
+    // to be sent the full state. clears the list.
+    std::vector<uint32_t> takeResync();
+
+private:
+    AsyncWebSocket& _ws;
+    const bool _resync;
+
+    static constexpr uint32_t _maxLagMillis = 30 * 1000;
+
+    struct Client {
+        uint32_t Id;
+        uint32_t LastDeliveryMillis;
+        uint16_t Skipped; // messages since the last delivery
+        bool AwaitingResync;
+    };
+    std::vector<Client> _clients; // as many as the websocket accepts
+    std::vector<uint32_t> _resyncIds;
+
+    // events arrive in the context of the web server's task
+    std::mutex _mutex;
+};
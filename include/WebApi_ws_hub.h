@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "WebApi_session.h"
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// a single websocket carrying the data of all live views, such that a web
+// app showing several of them only costs one connection. a client
+// subscribes to the topics it shows by sending
+//     {"subscribe":["livedata","battery"]} or {"unsubscribe":["battery"]}
+// and receives the messages of those topics as {"topic":"battery","data":...},
+// where data is what the websocket of the respective view sends. messages
+// to a topic, e.g., "resync" of the live data, are sent as
+//     {"topic":"livedata","data":"resync"}.
+// producers skip generating data for topics without subscribers.
+class WebApiWsHubClass {
+public:
+    enum class Topic : uint8_t {
+        LiveData,
+        Battery,
+        SolarCharger,
+        Huawei,
+        Console,
+        Count
+    };
+
+    WebApiWsHubClass();
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+    void reload();
+
+    bool hasSubscribers(Topic topic) const;
+
+    // sends the serialized JSON to all subscribers of the topic
+    void publish(Topic topic, std::shared_ptr<std::vector<uint8_t>> const& json);
+    void send(uint32_t clientId, Topic topic, std::shared_ptr<std::vector<uint8_t>> const& json);
+
+    // sends the text as JSON string to all subscribers of the topic which
+    // are able to take it right away.
+    void publishText(Topic topic, uint8_t const* text, size_t len);
+    void sendText(uint32_t clientId, Topic topic, uint8_t const* text, size_t len);
+
+    // called with the client id whenever a client subscribes to the topic
+    using SubscribeHandler = std::function<void(uint32_t)>;
+    void onSubscribe(Topic topic, SubscribeHandler handler);
+
+    // called with the client id and the text a client sent to the topic
+    using MessageHandler = std::function<void(uint32_t, char const*)>;
+    void onMessage(Topic topic, MessageHandler handler);
+
+private:
+    void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+    void handleMessage(uint32_t clientId, uint8_t const* data, size_t len);
+    void updateTopics();
+
+    static char const* getTopicName(Topic topic);
+    static bool parseTopic(char const* name, Topic& topic);
+    static std::shared_ptr<std::vector<uint8_t>> wrap(Topic topic, std::vector<uint8_t> const& json);
+    static std::shared_ptr<std::vector<uint8_t>> wrapText(Topic topic, uint8_t const* text, size_t len);
+
+    // client ids subscribed to the topic
+    std::vector<uint32_t> getSubscribers(Topic topic);
+
+    AsyncWebSocket _ws;
+    AsyncAuthenticationMiddleware _simpleDigestAuth;
+    WebApiSessionMiddleware _sessionAuth { _simpleDigestAuth };
+
+    static constexpr size_t _maxMessageSize = 256;
+
+    std::mutex _mutex;
+    std::map<uint32_t, uint8_t> _subscriptions; // topic bits by client id
+    std::atomic<uint8_t> _topics = 0; // bits of all subscribed topics
+
+    std::array<SubscribeHandler, static_cast<size_t>(Topic::Count)> _subscribeHandlers;
+    std::array<MessageHandler, static_cast<size_t>(Topic::Count)> _messageHandlers;
+
+    Task _wsCleanupTask;
+    void wsCleanupTaskCb();
+};
@@ -2,44 +2,115 @@
 #pragma once
 
 #include "Configuration.h"
+#include "MemoryPolicy.h"
+#include "WebApi_session.h"
+#include "WebApi_ws_flow.h"
 #include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <vector>
 
 class WebApiWsLiveClass {
+    friend class BenchmarkClass;
+
 public:
     WebApiWsLiveClass();
     void init(AsyncWebServer& server, Scheduler& scheduler);
     void reload();
 
+    // the serialized status of all inverters as sent by /api/livedata/status,
+    // nullptr if it could not be generated
+    std::shared_ptr<std::vector<uint8_t>> getStatus();
+
 private:
     static void generateInverterCommonJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv);
     static void generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv);
     static void generateCommonJsonResponse(JsonVariant& root);
 
+    // the common data and the channels of an inverter are generated once per
+    // update of the inverter's data and reused by the websocket and the
+    // REST API until then. values relative to the current time are updated
+    // when adding the cached copy. protected by _mutex.
+    void addInverterJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv);
+    using inverter_cache_key_t = std::array<uint32_t, 6>;
+    static inverter_cache_key_t getInverterCacheKey(InverterAbstract& inv);
+    static constexpr uint32_t _inverterCacheMaxAge = 10 * 1000;
+
+    struct InverterCache {
+        JsonDocument Doc { MemoryPolicy::getBulkJsonAllocator() };
+        inverter_cache_key_t Key = {};
+        uint32_t Millis = 0;
+    };
+    std::map<uint64_t, InverterCache> _inverterCache;
+
     void generateOnBatteryJsonResponse(JsonVariant& root, bool all);
-    void sendOnBatteryStats();
 
     static void addField(JsonObject& root, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, String topic = "");
     static void addTotalField(JsonObject& root, const String& name, const float value, const String& unit, const uint8_t digits);
 
+    void sendSnapshot(std::vector<uint32_t> const& clientIds, std::vector<uint32_t> const& hubClientIds);
+    void requestHubSnapshot(uint32_t clientId);
+
     void onLivedataStatus(AsyncWebServerRequest* request);
+
+    // the serialized status of all inverters is reused by subsequent
+    // requests until any of the values changes. values relative to the
+    // current time (data_age_ms) are at most _statusCacheMaxAge old.
+    bool isStatusCacheValid() const;
+    std::shared_ptr<std::vector<uint8_t>> generateStatus(uint64_t serial); // zero for all inverters
+    void sendStatus(AsyncWebServerRequest* request, std::shared_ptr<std::vector<uint8_t>> const& data);
+    static constexpr uint32_t _statusCacheMaxAge = 1000;
+
+    struct StatusCache {
+        std::shared_ptr<std::vector<uint8_t>> Data;
+        std::shared_ptr<std::vector<uint8_t>> Gzip; // compressed on demand
+        uint32_t Millis = 0;
+        size_t NumInverters = 0;
+        uint32_t HuaweiGeneration = 0;
+    };
+    StatusCache _statusCache; // protected by _mutex
     void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
 
+    // forwards completions of inverter control commands as messages of
+    // type "command", which are not part of the delta sequence.
+    void onCommandCompletion(CommandCompletion const& completion);
+
     AsyncWebSocket _ws;
+    WebApiWsFlowControl _flow { _ws, true }; // deltas need a resync
     AsyncAuthenticationMiddleware _simpleDigestAuth;
+    WebApiSessionMiddleware _sessionAuth { _simpleDigestAuth };
 
     uint32_t _lastPublishOnBatteryFull = 0;
     uint32_t _lastPublishSolarCharger = 0;
-    uint32_t _lastPublishHuawei = 0;
-    uint32_t _lastPublishBattery = 0;
-    uint32_t _lastPublishPowerMeter = 0;
+    uint32_t _lastPublishHuawei = 0; // data generation
+
+    // raised by the event bus, potentially from a different task
+    std::atomic<bool> _inverterStatsUpdated = true;
+    std::atomic<bool> _batteryUpdated = true;
+    std::atomic<bool> _powerMeterUpdated = true;
 
-    uint32_t _lastPublishStats[INV_MAX_COUNT] = { 0 };
+    std::vector<uint32_t> _lastPublishStats; // per inverter position
+    uint32_t _lastStatsRefresh = 0;
 
     std::mutex _mutex;
 
+    // last published state, which deltas are generated against. inverters
+    // are keyed by their serial.
+    JsonDocument _state;
+    uint32_t _sequence = 0;
+    uint32_t _lastPublish = 0;
+
+    // clients which need a full snapshot before they can apply deltas
+    std::mutex _snapshotMutex;
+    std::vector<uint32_t> _snapshotClients;
+    std::vector<uint32_t> _hubSnapshotClients; // subscribers of the hub websocket
+
     Task _wsCleanupTask;
     void wsCleanupTaskCb();
 
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+#include <functional>
+#include <mutex>
+
+// the endpoint Shelly Gen2+ devices connect to with their outbound
+// websocket (ws://<opendtu>/shelly), through which they push JSON-RPC
+// notifications. only one Shelly is served at a time, a new connection
+// replaces the previous one. the Shelly cannot authenticate, hence
+// connections are only accepted while a provider is attached.
+class WebApiWsShellyClass {
+public:
+    WebApiWsShellyClass();
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+
+    // called by the async_tcp task with the chunks of each text message in
+    // order. the handler must not call into this class.
+    using Handler = std::function<void(uint8_t const* data, size_t len, bool first, bool last)>;
+
+    // an empty handler detaches the provider and closes the connection.
+    // returns once the handler previously set cannot be called anymore.
+    void setHandler(Handler handler);
+
+    // sends a JSON-RPC request to the connected Shelly
+    bool send(String const& text);
+
+private:
+    void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+
+    AsyncWebSocket _ws;
+
+    Task _wsCleanupTask;
+    void wsCleanupTaskCb();
+
+    std::mutex _mutex;
+    Handler _handler;
+    uint32_t _clientId = 0; // zero if no Shelly is connected
+};
@@ -3,9 +3,12 @@
 
 #include "ArduinoJson.h"
 #include "Configuration.h"
+#include "WebApi_session.h"
+#include "WebApi_ws_flow.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 #include <VeDirectMpptController.h>
+#include <atomic>
 #include <mutex>
 
 class WebApiWsSolarChargerLiveClass {
@@ -21,10 +24,13 @@ private:
 
     AsyncWebServer* _server;
     AsyncWebSocket _ws;
+    WebApiWsFlowControl _flow { _ws };
     AsyncAuthenticationMiddleware _simpleDigestAuth;
+    WebApiSessionMiddleware _sessionAuth { _simpleDigestAuth };
 
     uint32_t _lastFullPublish = 0;
     uint32_t _lastPublish = 0;
+    std::atomic<bool> _dplDecided = false; // raised by the event bus
 
     std::mutex _mutex;
 
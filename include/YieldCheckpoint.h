@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Configuration.h"
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <cstdint>
+
+// keeps the yield day correction of the inverters across reboots. the
+// offsets and last known yield per channel are checkpointed into a ring of
+// fixed-size slots within a file on LittleFS, every write going to the slot
+// following the most recent one. each slot carries a sequence number and a
+// checksum, such that a write torn by a brown-out only invalidates this very
+// slot and the previous checkpoint is restored instead. a checkpoint is only
+// restored on the day it was written, and only once the time is known.
+//
+// the totals of the datastore are derived from the corrected yield of the
+// inverters, hence they are exact again as soon as the inverters answer.
+class YieldCheckpointClass {
+public:
+    YieldCheckpointClass();
+    void init(Scheduler& scheduler);
+
+private:
+    void loop();
+    void restore(uint32_t day);
+    void write(uint32_t day);
+
+    struct Entry {
+        uint64_t Serial;
+        yieldDayCorrectionState_t State;
+    };
+
+    struct Slot {
+        uint32_t Magic;
+        uint32_t Sequence; // zero if unused
+        uint32_t Day; // year * 1000 + day of year
+        uint32_t Count; // number of valid entries
+        Entry Entries[INV_MAX_COUNT];
+        uint32_t Crc;
+    };
+
+    static constexpr uint32_t _magic = 0x4B435944; // "DYCK"
+    static constexpr size_t _slotCount = 8;
+    static constexpr uint32_t _intervalMs = 5 * 60 * 1000;
+
+    void collect(Slot& slot);
+    static uint32_t getCrc(Slot const& slot);
+    static uint32_t getOffsetsCrc(Slot const& slot);
+    static bool createFile();
+
+    Task _loopTask;
+
+    bool _restored = false;
+    uint32_t _sequence = 0;
+    size_t _nextSlot = 0;
+    uint32_t _lastCrc = 0;
+    uint32_t _lastOffsetsCrc = 0;
+    uint32_t _lastWriteMillis = 0;
+};
+
+extern YieldCheckpointClass YieldCheckpoint;
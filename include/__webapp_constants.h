@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// The referenced values are generated by pio-scripts/compile_webapp.py
+
+extern const char *__WEBAPP_ETAG_INDEX_HTML__;
+extern const char *__WEBAPP_ETAG_ZONES_JSON__;
+extern const char *__WEBAPP_ETAG_FAVICON_ICO__;
+extern const char *__WEBAPP_ETAG_FAVICON_PNG__;
+extern const char *__WEBAPP_ETAG_APP_JS__;
+extern const char *__WEBAPP_ETAG_VIEWS_JS__;
+extern const char *__WEBAPP_ETAG_SITE_WEBMANIFEST__;
+extern const char *__WEBAPP_ETAG_SW_JS__;
+
+// the content-hashed path index.html references app.js by
+extern const char *__WEBAPP_APP_JS_PATH__;
@@ -10,6 +10,7 @@
 #define ACCESS_POINT_NAME "OpenDTU-"
 #define ACCESS_POINT_PASSWORD "openDTU42"
 #define ACCESS_POINT_TIMEOUT 3
+#define WIFI_LATENCY_MODE 1 // automatic
 #define AUTH_USERNAME "admin"
 #define SECURITY_ALLOW_READONLY true
 
@@ -25,6 +26,18 @@
 #define SYSLOG_ENABLED false
 #define SYSLOG_PORT 514
 
+#define TELEMETRY_ENABLED false
+#define TELEMETRY_PORT 4245
+#define TELEMETRY_INTERVAL 1000
+
+#define METRICS_PUSH_ENABLED false
+#define METRICS_PUSH_INTERVAL 10
+#define METRICS_PUSH_PUSH_INTERVAL 60
+
+#define MODBUS_ENABLED false
+#define MODBUS_PORT 502
+#define MODBUS_ALLOW_WRITE false
+
 #define NTP_SERVER_OLD "pool.ntp.org"
 #define NTP_SERVER "opendtu.pool.ntp.org"
 #define NTP_TIMEZONE "CET-1CEST,M3.5.0,M10.5.0/3"
@@ -83,12 +96,22 @@
 #define MQTT_PUBLISH_INTERVAL 5U
 #define MQTT_CLEAN_SESSION true
 
+#define MQTT_DEADBAND_POWER 1.0f
+#define MQTT_DEADBAND_VOLTAGE 0.5f
+#define MQTT_DEADBAND_CURRENT 0.05f
+#define MQTT_DEADBAND_FREQUENCY 0.05f
+#define MQTT_DEADBAND_TEMPERATURE 0.5f
+#define MQTT_DEADBAND_POWER_FACTOR 0.01f
+#define MQTT_DEADBAND_PERCENT 0.1f
+
 #define DTU_SERIAL 0x99978563412U
 #define DTU_POLL_INTERVAL 5000U
 #define DTU_NRF_PA_LEVEL 0U
 #define DTU_CMT_PA_LEVEL 0
 #define DTU_CMT_FREQUENCY 865000000U
 #define DTU_CMT_COUNTRY_MODE 0U
+#define DTU_CMT_FREQUENCY_AGILITY false
+#define DTU_NIGHT_MODE false
 
 #define MQTT_HASS_ENABLED false
 #define MQTT_HASS_EXPIRE true
@@ -113,6 +136,7 @@
 #define MAX_INVERTER_LIMIT 2250
 
 #define LANG_PACK_SUFFIX ".lang.json"
+#define LANG_PACK_INDEX_FILENAME "/lang.idx"
 
 // values specific to downstream project OpenDTU-OnBattery start here:
 #define SOLAR_CHARGER_ENABLED false
@@ -123,6 +147,11 @@
 #define POWERMETER_POLLING_INTERVAL 10
 #define POWERMETER_SOURCE 0
 #define POWERMETER_SDMADDRESS 1
+#define POWERMETER_SDM_POLL_DIVIDER 3
+#define POWERMETER_UDP_PORT 9523
+#define POWERMETER_FILTER_MODE 0
+#define POWERMETER_FILTER_WINDOW 3
+#define POWERMETER_FILTER_STEP_THRESHOLD 150
 
 #define HTTP_REQUEST_TIMEOUT_MS 1000
 
@@ -145,10 +174,20 @@
 #define POWERLIMITER_VOLTAGE_START_THRESHOLD 50.0
 #define POWERLIMITER_VOLTAGE_STOP_THRESHOLD 49.0
 #define POWERLIMITER_VOLTAGE_LOAD_CORRECTION_FACTOR 0.001
+#define POWERLIMITER_VOLTAGE_LOAD_CORRECTION_AUTOMATIC false
 #define POWERLIMITER_RESTART_HOUR -1
 #define POWERLIMITER_FULL_SOLAR_PASSTHROUGH_SOC 100
 #define POWERLIMITER_FULL_SOLAR_PASSTHROUGH_START_VOLTAGE 66.0
 #define POWERLIMITER_FULL_SOLAR_PASSTHROUGH_STOP_VOLTAGE 66.0
+#define POWERLIMITER_PREDICTIVE_MODE false
+#define POWERLIMITER_OPTIMIZED_DISPATCH false
+#define POWERLIMITER_EXPORT_GUARD_THRESHOLD 0
+#define POWERLIMITER_PHASE_MODE 0
+#define POWERLIMITER_BATTERY_DISCHARGE_PLAN false
+#define POWERLIMITER_BATTERY_CAPACITY 5000
+#define POWERLIMITER_BATTERY_DISCHARGE_PLAN_RESERVE_SOC 30
+#define POWERLIMITER_CLUSTER false
+#define POWERLIMITER_CLUSTER_KEY ""
 
 #define BATTERY_ENABLED false
 #define BATTERY_PROVIDER 0 // Pylontech CAN receiver
@@ -159,6 +198,8 @@
 #define BATTERY_DISCHARGE_CURRENT_LIMIT_BELOW_SOC 100.0
 #define BATTERY_DISCHARGE_CURRENT_LIMIT_BELOW_VOLTAGE 60.0
 #define BATTERY_USE_BATTERY_REPORTED_DISCHARGE_CURRENT_LIMIT false
+#define BATTERY_MQTT_BUNDLED false
+#define BATTERY_AGGREGATE_CAPACITY 100 // Ah
 
 #define HUAWEI_ENABLED false
 #define HUAWEI_CAN_CONTROLLER_FREQUENCY 8000000UL
@@ -2,7 +2,9 @@
 #pragma once
 
 #include <cstdint>
+#include <atomic>
 #include <memory>
+#include <optional>
 #include <ArduinoJson.h>
 #include <TaskSchedulerDeclarations.h>
 #include <gridcharger/huawei/HardwareInterface.h>
@@ -27,15 +29,27 @@ public:
     void setMode(uint8_t mode);
 
     DataPointContainer const& getDataPoints() const { return _dataPoints; }
+
+    // incremented whenever new values were received from the PSU
+    uint32_t getDataGeneration() const { return _dataGeneration; }
     void getJsonData(JsonVariant& root) const;
 
     bool getAutoPowerStatus() const { return _autoPowerEnabled; };
     uint8_t getMode() const { return _mode; };
 
 private:
+    void registerMetrics();
     void loop();
     void _setParameter(float val, HardwareInterface::Setting setting);
 
+    // the auto power control runs in its own task, which is notified by the
+    // hardware interface whenever new values were received from the PSU.
+    static void controlLoopHelper(void* context);
+    void controlLoop();
+    void autoPowerControl();
+    void resetAutoPowerControl();
+    void setOutputCurrent(float current);
+
     // these control the pin named "power", which in turn is supposed to control
     // a relay (or similar) to enable or disable the PSU using it's slot detect
     // pins.
@@ -44,17 +58,44 @@ private:
     int8_t _huaweiPower;
 
     Task _loopTask;
+    TaskHandle_t _controlTaskHandle = nullptr;
     std::unique_ptr<HardwareInterface> _upHardwareInterface;
 
-    std::mutex _mutex;
+    mutable std::mutex _mutex;
     uint8_t _mode = HUAWEI_MODE_AUTO_EXT;
 
     DataPointContainer _dataPoints;
+    std::atomic<uint32_t> _dataGeneration = 0;
 
     uint32_t _outputCurrentOnSinceMillis;         // Timestamp since when the PSU was idle at zero amps
     uint32_t _nextAutoModePeriodicIntMillis;      // When to set the next output voltage in automatic mode
     uint32_t _lastPowerMeterUpdateReceivedMillis; // Timestamp of last seen power meter value
-    uint32_t _autoModeBlockedTillMillis = 0;      // Timestamp to block running auto mode for some time
+
+    // the PSU is polled faster while the auto power control is running
+    static uint32_t constexpr AutoModeDataRequestIntervalMillis = 500;
+
+    // gains of the incremental PI controller, which determines the requested
+    // AC input power. the error is the deviation of the power meter reading
+    // from the target grid consumption. a proportional gain below one does
+    // not compensate the full error at once such that the output does not
+    // overshoot before the power meter reflects a change.
+    static float constexpr AutoPowerKp = 0.3;
+    static float constexpr AutoPowerKi = 0.5;
+    std::optional<float> _oAutoPowerSetpoint;     // requested AC input power in W
+    float _lastPowerError = 0;
+
+    // output current setpoints are sent at most this often, unless the
+    // output must be reduced to zero, and only if the value changed or
+    // if the previous value was sent a while ago.
+    static uint32_t constexpr MinSetpointIntervalMillis = 500;
+    static uint32_t constexpr SetpointRefreshMillis = 10000;
+    static float constexpr SetpointDeadbandAmps = 0.1;
+    uint32_t _lastSetpointMillis = 0;
+    std::optional<float> _oLastSetpoint;
+
+    // determined by the (scheduler) loop, as the power limiter's state must
+    // not be accessed from the control task.
+    std::atomic<bool> _inverterProducing = false;
 
     uint8_t _autoPowerEnabledCounter = 0;
     bool _autoPowerEnabled = false;
@@ -5,7 +5,7 @@
 #include <array>
 #include <mutex>
 #include <memory>
-#include <queue>
+#include <deque>
 #include <cstdint>
 #include <gridcharger/huawei/DataPoints.h>
 
@@ -27,9 +27,26 @@ public:
     };
     void setParameter(Setting setting, float val);
 
-    std::unique_ptr<DataPointContainer> getCurrentData();
+    // returns the latest complete set of values if it was not yet retrieved,
+    // nullptr otherwise. the data is valid until the next call. must only be
+    // called by a single consumer.
+    DataPointContainer const* getCurrentData();
+
+    // the number of complete sets of values received so far
+    uint32_t getGeneration() const { return _generation; }
+
+    // the given task is notified whenever a complete set of new values
+    // is available through getCurrentData().
+    void setDataConsumer(TaskHandle_t task);
 
     static uint32_t constexpr DataRequestIntervalMillis = 2500;
+    void setDataRequestInterval(uint32_t intervalMillis);
+
+    struct ReceiveStats {
+        uint32_t Frames;
+        uint32_t Overruns; // frames lost as the controller's buffers were full
+    };
+    virtual ReceiveStats getReceiveStats() const { return { 0, 0 }; }
 
 protected:
     struct CAN_MESSAGE_T {
@@ -58,14 +75,30 @@ private:
     std::atomic<bool> _taskDone = false;
     bool _stopLoop = false;
 
-    std::unique_ptr<DataPointContainer> _upDataCurrent = nullptr;
-    std::unique_ptr<DataPointContainer> _upDataInFlight = nullptr;
+    void publishData();
+
+    // triple buffer: the task of the hardware interface writes into one of
+    // the containers, another one holds the latest complete set of values,
+    // and the consumer reads from the third one. the containers are handed
+    // over by exchanging indices, so neither allocation nor copying is
+    // required, and the producer never waits for the consumer.
+    std::array<DataPointContainer, 3> _dataBuffers;
+    uint8_t _writeBuffer = 0;   // only accessed by the hardware interface's task
+    uint8_t _readBuffer = 1;    // only accessed by the consumer
+    static uint8_t constexpr FreshDataFlag = 0x80;
+    std::atomic<uint8_t> _readyBuffer = 2; // index, FreshDataFlag if unread
+    std::atomic<uint32_t> _generation = 0;
+    bool _dataInFlight = false;
+
+    TaskHandle_t _dataConsumer = nullptr;
 
-    std::queue<std::pair<HardwareInterface::Setting, uint16_t>> _sendQueue;
+    // holds at most one (the most recent) value per setting
+    std::deque<std::pair<HardwareInterface::Setting, uint16_t>> _sendQueue;
 
     static unsigned constexpr _maxCurrentMultiplier = 20;
 
     uint32_t _nextRequestMillis = 0; // When to send next data request to PSU
+    uint32_t _dataRequestIntervalMillis = DataRequestIntervalMillis;
 };
 
 } // namespace GridCharger::Huawei
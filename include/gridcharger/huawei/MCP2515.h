@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <memory>
 #include <SPI.h>
 #include <mcp_can.h>
@@ -19,7 +21,29 @@ public:
 
     bool sendMessage(uint32_t canId, std::array<uint8_t, 8> const& data) final;
 
+    ReceiveStats getReceiveStats() const final { return { _rxFrameCount, _rxOverrunCount }; }
+
 private:
+    // the R48xx answers a data request with a burst of frames, while the
+    // MCP2515 only has two receive buffers. rather than reading one frame
+    // per interrupt through the library, which takes several SPI
+    // transactions per frame, all pending frames are drained at once, each
+    // using a single "read RX buffer" transaction.
+    size_t drainRxBuffers(); // returns the number of buffers read
+    uint8_t spiReadStatus();
+    uint8_t spiReadRegister(uint8_t address);
+    void spiBitModify(uint8_t address, uint8_t mask, uint8_t data);
+    void spiReadRxBuffer(uint8_t instruction);
+    void spiBegin();
+    void spiEnd();
+
+    std::array<can_message_t, 8> _rxFrames;
+    size_t _rxFramesPending = 0;
+    size_t _rxFramesConsumed = 0;
+    std::atomic<uint32_t> _rxFrameCount = 0;
+    std::atomic<uint32_t> _rxOverrunCount = 0;
+    uint8_t _huaweiCs;
+
     // this is static because we cannot give back the bus once we claimed it.
     // as we are going to use a shared host/bus in the future, we won't use a
     // workaround for the limited time we use it like this.
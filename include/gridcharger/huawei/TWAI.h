@@ -1,8 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
-#include <atomic>
 #include <gridcharger/huawei/HardwareInterface.h>
+#include <driver/twai.h>
+#include <freertos/queue.h>
 
 namespace GridCharger::Huawei {
 
@@ -17,11 +18,10 @@ public:
     bool sendMessage(uint32_t canId, std::array<uint8_t, 8> const& data) final;
 
 private:
-    TaskHandle_t _pollingTaskHandle = nullptr;
-    std::atomic<bool> _pollingTaskDone = false;
-    std::atomic<bool> _stopPolling = false;
+    void onFrame(twai_message_t const& rxMessage);
 
-    static void pollAlerts(void* context);
+    int _subscription = -1;
+    QueueHandle_t _rxQueue = nullptr;
 };
 
 } // namespace GridCharger::Huawei
@@ -13,10 +13,12 @@ class Controller {
 public:
     void init(Scheduler&);
     void updateSettings();
+    void forcePublishSensors() { _forcePublishSensors = true; }
 
     std::shared_ptr<Stats const> getStats() const;
 
 private:
+    void registerMetrics();
     void loop();
 
     Task _loopTask;
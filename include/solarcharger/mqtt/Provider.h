@@ -6,6 +6,7 @@
 #include <TaskSchedulerDeclarations.h>
 #include <solarcharger/Provider.h>
 #include <solarcharger/mqtt/Stats.h>
+#include <JsonPath.h>
 #include <VeDirectMpptController.h>
 #include <espMqttClient.h>
 
@@ -34,6 +35,13 @@ private:
     std::vector<String> _subscribedTopics;
     std::shared_ptr<Stats> _stats = std::make_shared<Stats>();
 
+    // of the combined topic only
+    JsonPath _powerPath;
+    JsonPath _voltagePath;
+    JsonPath _currentPath;
+
+    bool initCombined();
+
     void onMqttMessageOutputPower(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
             char const* jsonPath) const;
@@ -45,6 +53,9 @@ private:
     void onMqttMessageOutputCurrent(espMqttClientTypes::MessageProperties const& properties,
             char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total,
             char const* jsonPath) const;
+
+    void onMqttMessageCombined(espMqttClientTypes::MessageProperties const& properties,
+            char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total) const;
 };
 
 } // namespace SolarChargers::Mqtt
@@ -41,6 +41,10 @@ protected:
 
     void setOutputCurrent(const float current);
 
+    // sets the values received in one message, sharing one timestamp
+    void setOutputValues(std::optional<float> powerWatts,
+            std::optional<float> voltage, std::optional<float> current);
+
 private:
     uint32_t _lastUpdate = 0;
 
@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <memory>
+#include <vector>
 #include <TaskSchedulerDeclarations.h>
 #include <solarcharger/Provider.h>
 #include <solarcharger/victron/Stats.h>
@@ -26,9 +28,38 @@ private:
     Provider& operator=(Provider const& other) = delete;
     Provider& operator=(Provider&& other) = delete;
 
+    // data of a controller as published by its reader task
+    struct Snapshot {
+        VeDirectMpptController::data_t Data;
+        bool Valid;
+        uint32_t LastUpdate;
+    };
+
+    // every controller is driven by its own task, which is woken up by the
+    // UART driver when data arrives, such that a busy main loop cannot cause
+    // the UART's buffers to overflow.
+    struct Controller {
+        std::unique_ptr<VeDirectMpptController> upMppt;
+        TaskHandle_t TaskHandle = nullptr;
+        std::atomic<bool> StopTask = false;
+        std::atomic<bool> TaskDone = false;
+
+        // only accessed through std::atomic_load() and std::atomic_store()
+        std::shared_ptr<Snapshot const> spSnapshot;
+
+        // the snapshot last processed by loop()
+        std::shared_ptr<Snapshot const> spProcessed;
+    };
+
+    // holds about two text frames of an MPPT charge controller
+    static size_t constexpr _rxBufferSize = 512;
+
+    static void readerLoopHelper(void* context);
+    static void readerLoop(Controller& controller);
+    static void stopReader(Controller& controller);
+
     mutable std::mutex _mutex;
-    using controller_t = std::unique_ptr<VeDirectMpptController>;
-    std::vector<controller_t> _controllers;
+    std::vector<std::unique_ptr<Controller>> _controllers;
     std::vector<String> _serialPortOwners;
     std::shared_ptr<Stats> _stats = std::make_shared<Stats>();
 
@@ -4,7 +4,9 @@
 #include <solarcharger/Stats.h>
 #include <solarcharger/victron/HassIntegration.h>
 #include <VeDirectMpptController.h>
+#include <array>
 #include <map>
+#include <memory>
 
 namespace SolarChargers::Victron {
 
@@ -26,6 +28,10 @@ public:
 
     void update(const String serial, const std::optional<VeDirectMpptController::data_t> mpptData, uint32_t lastUpdate) const;
 
+    // computes the values aggregated across all charge controllers. to be
+    // called after updating the data of the charge controllers.
+    void updateAggregate() const;
+
 private:
     // TODO(andreasboehm): _data and _lastUpdate in two different structures is not ideal and needs to change
     mutable std::map<String, std::optional<VeDirectMpptController::data_t>> _data;
@@ -33,6 +39,42 @@ private:
 
     mutable std::map<String, VeDirectMpptController::data_t> _previousData;
 
+    // the frames of the charge controllers arrive at different points in
+    // time. the power of each charge controller is extrapolated from its
+    // last two frames to the time of the most recent frame of any charge
+    // controller before summing up, and the totals are withheld if a charge
+    // controller lags behind by more than _maxSkewMillis.
+    struct PowerSample {
+        uint32_t Millis;
+        float OutputPowerWatts;
+        float PanelPowerWatts;
+    };
+    mutable std::map<String, std::array<PowerSample, 2>> _powerSamples; // previous and latest
+    static constexpr uint32_t _maxSkewMillis = 3000;
+    static constexpr uint32_t _maxExtrapolationGapMillis = 5000;
+    mutable bool _skewReported = false;
+
+    // the power of the charge controller at the given point in time
+    static PowerSample extrapolate(std::array<PowerSample, 2> const& samples, uint32_t at);
+
+    struct Aggregate {
+        std::optional<uint32_t> OldestUpdate;
+        std::optional<float> OutputPowerWatts;
+        std::optional<float> OutputVoltage;
+        std::optional<uint16_t> PanelPowerWatts;
+        std::optional<float> YieldTotal;
+        std::optional<float> YieldDay;
+        std::optional<Stats::StateOfOperation> State;
+        std::optional<float> FloatVoltage;
+        std::optional<float> AbsorptionVoltage;
+    };
+
+    // the aggregated values are published as an immutable snapshot, such
+    // that readers in any context do not need to take a lock. must only be
+    // accessed through std::atomic_load() and std::atomic_store().
+    mutable std::shared_ptr<Aggregate const> _spAggregate = std::make_shared<Aggregate const>();
+    std::shared_ptr<Aggregate const> getAggregate() const { return std::atomic_load(&_spAggregate); }
+
     // point of time in millis() when updated values will be published
     mutable uint32_t _nextPublishUpdatesOnly = 0;
 
@@ -47,7 +47,7 @@ void cmt_spi3_init(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin
         .post_cb = post_cb,
     };
 
-    spi = SpiManagerInst.alloc_device("", bus_config, device_config);
+    spi = SpiManagerInst.alloc_device("", bus_config, device_config, "cmt2300a");
     if (!spi)
         ESP_ERROR_CHECK(ESP_FAIL);
 
@@ -108,6 +108,9 @@ uint8_t cmt_spi3_read(const uint8_t addr)
     return data;
 }
 
+// the CMT2300A requires FCSB to stay high for some microseconds between
+// FIFO bytes. queued transactions toggle it back to back from the SPI
+// interrupt, so every byte is a polling transaction of its own.
 void cmt_spi3_write_fifo(const uint8_t* buf, const uint16_t len)
 {
     spi_transaction_t trans {
@@ -17,19 +17,36 @@
 #include "inverters/HM_2CH.h"
 #include "inverters/HM_4CH.h"
 #include <Arduino.h>
+#include <algorithm>
 
 HoymilesClass Hoymiles;
 
 void HoymilesClass::init()
 {
     _pollInterval = 0;
-    _radioNrf.reset(new HoymilesRadio_NRF());
+    _radiosNrf[0].reset(new HoymilesRadio_NRF());
+    _numRadiosNrf = 1;
     _radioCmt.reset(new HoymilesRadio_CMT());
 }
 
 void HoymilesClass::initNRF(SPIClass* initialisedSpiBus, const uint8_t pinCE, const uint8_t pinIRQ)
 {
-    _radioNrf->init(initialisedSpiBus, pinCE, pinIRQ);
+    _radiosNrf[0]->init(initialisedSpiBus, pinCE, pinIRQ);
+}
+
+bool HoymilesClass::addNRF(const uint8_t pinCE, const uint8_t pinCS, const uint8_t pinIRQ)
+{
+    auto spiBus = _radiosNrf[0]->getSpiBus();
+    if (_numRadiosNrf >= HOY_NRF_RADIO_COUNT || spiBus == nullptr) {
+        return false;
+    }
+
+    auto radio = std::make_unique<HoymilesRadio_NRF>();
+    radio->init(std::move(spiBus), pinCE, pinCS, pinIRQ);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _radiosNrf[_numRadiosNrf++] = std::move(radio);
+    return true;
 }
 
 void HoymilesClass::initCMT(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin_cs, const int8_t pin_fcs, const int8_t pin_gpio2, const int8_t pin_gpio3)
@@ -40,114 +57,225 @@ void HoymilesClass::initCMT(const int8_t pin_sdio, const int8_t pin_clk, const i
 void HoymilesClass::loop()
 {
     std::lock_guard<std::mutex> lock(_mutex);
-    _radioNrf->loop();
+    updateNightMode();
+    for (uint8_t i = 0; i < _numRadiosNrf; i++) {
+        _radiosNrf[i]->loop();
+    }
     _radioCmt->loop();
 
     if (getNumInverters() == 0) {
         return;
     }
 
-    if (millis() - _lastPoll > _pollInterval) {
-        static uint8_t inverterPos = 0;
+    // All radios are polled independently of each other, so a busy or
+    // retransmitting radio does not delay the inverters of the other ones.
+    for (uint8_t i = 0; i < _numRadiosNrf; i++) {
+        pollInverters(_radiosNrf[i].get(), _pollStatesNrf[i]);
+    }
+    pollInverters(_radioCmt.get(), _pollStateCmt);
+
+    // Perform housekeeping of all inverters on day change
+    const int8_t currentWeekDay = Utils::getWeekDay();
+    static int8_t lastWeekDay = -1;
+    if (lastWeekDay == -1) {
+        lastWeekDay = currentWeekDay;
+    } else {
+        if (currentWeekDay != lastWeekDay) {
 
-        std::shared_ptr<InverterAbstract> iv = getInverterByPos(inverterPos);
-        if ((iv == nullptr) || ((iv != nullptr) && (!iv->getRadio()->isInitialized()))) {
-            if (++inverterPos >= getNumInverters()) {
-                inverterPos = 0;
+            for (auto& inv : _inverters) {
+                inv->performDailyTask();
             }
+
+            lastWeekDay = currentWeekDay;
         }
+    }
+}
 
-        if (iv != nullptr && iv->getRadio()->isInitialized()) {
+void HoymilesClass::updateNightMode()
+{
+    if (!_nightMode) {
+        return;
+    }
 
-            if (iv->getZeroValuesIfUnreachable() && !iv->isReachable()) {
-                iv->Statistics()->zeroRuntimeData();
+    for (auto& inv : _inverters) {
+        if (inv->isReachable()) {
+            _messageOutput->println("Inverter answered, leaving night mode");
+            _nightMode = false;
+            for (uint8_t i = 0; i < _numRadiosNrf; i++) {
+                _radiosNrf[i]->setStandby(false);
             }
+            _radioCmt->setStandby(false);
+            return;
+        }
+    }
 
-            if (iv->getEnablePolling() || iv->getEnableCommands()) {
-                _messageOutput->print("Fetch inverter: ");
-                _messageOutput->println(iv->serial(), HEX);
+    for (uint8_t i = 0; i < _numRadiosNrf; i++) {
+        _radiosNrf[i]->setStandby(_radiosNrf[i]->isIdle() && _radiosNrf[i]->isQueueEmpty());
+    }
+    _radioCmt->setStandby(_radioCmt->isIdle() && _radioCmt->isQueueEmpty());
+}
 
-                if (!iv->isReachable()) {
-                    iv->sendChangeChannelRequest();
-                }
+void HoymilesClass::pollInverters(HoymilesRadio* radio, PollState& state)
+{
+    const uint32_t interval = _nightMode ? std::max<uint32_t>(_pollInterval, HOY_NIGHT_PROBE_INTERVAL) : _pollInterval;
+    if (!radio->isInitialized() || millis() - state.LastPoll <= interval) {
+        return;
+    }
 
-                iv->sendStatsRequest();
+    // Starting at the current position, find the next inverter of this radio
+    // which is due. Inverters with a low poll demand are skipped for a few cycles.
+    std::shared_ptr<InverterAbstract> iv = nullptr;
+    for (uint8_t i = 0; i < getNumInverters(); i++) {
+        if (state.InverterPos >= getNumInverters()) {
+            state.InverterPos = 0;
+        }
 
-                // Fetch event log
-                const bool force = iv->EventLog()->getLastAlarmRequestSuccess() == CMD_NOK;
-                iv->sendAlarmLogRequest(force);
+        auto candidate = getInverterByPos(state.InverterPos);
+        if (candidate != nullptr && candidate->getRadio() == radio
+            && millis() - candidate->getLastPoll() >= getInverterPollInterval(candidate.get())) {
+            iv = candidate;
+            break;
+        }
 
-                // Fetch limit
-                if (((millis() - iv->SystemConfigPara()->getLastUpdateRequest() > HOY_SYSTEM_CONFIG_PARA_POLL_INTERVAL)
-                        && (millis() - iv->SystemConfigPara()->getLastUpdateCommand() > HOY_SYSTEM_CONFIG_PARA_POLL_MIN_DURATION))) {
-                    _messageOutput->println("Request SystemConfigPara");
-                    iv->sendSystemConfigParaRequest();
-                }
+        ++state.InverterPos;
+    }
 
-                // Set limit if required
-                if (iv->SystemConfigPara()->getLastLimitCommandSuccess() == CMD_NOK) {
-                    _messageOutput->println("Resend ActivePowerControl");
-                    iv->resendActivePowerControlRequest();
-                }
+    if (iv == nullptr) {
+        // No inverter is due, check again after the next interval
+        state.LastPoll = millis();
+        return;
+    }
 
-                // Set power status if required
-                if (iv->PowerCommand()->getLastPowerCommandSuccess() == CMD_NOK) {
-                    _messageOutput->println("Resend PowerCommand");
-                    iv->resendPowerControlRequest();
-                }
+    if (iv->getZeroValuesIfUnreachable() && !iv->isReachable()) {
+        iv->Statistics()->zeroRuntimeData();
+    }
 
-                // Fetch dev info (but first fetch stats)
-                if (iv->Statistics()->getLastUpdate() > 0) {
-                    const bool invalidDevInfo = !iv->DevInfo()->containsValidData()
-                        && iv->DevInfo()->getLastUpdateAll() > 0
-                        && iv->DevInfo()->getLastUpdateSimple() > 0;
-
-                    if (invalidDevInfo) {
-                        _messageOutput->println("DevInfo: No Valid Data");
-                    }
-
-                    if ((iv->DevInfo()->getLastUpdateAll() == 0)
-                        || (iv->DevInfo()->getLastUpdateSimple() == 0)
-                        || invalidDevInfo) {
-                        _messageOutput->println("Request device info");
-                        iv->sendDevInfoRequest();
-                    }
-                }
+    if (iv->getEnablePolling() || iv->getEnableCommands()) {
+        _messageOutput->print("Fetch inverter: ");
+        _messageOutput->println(iv->serial(), HEX);
 
-                // Fetch grid profile
-                if (iv->Statistics()->getLastUpdate() > 0 && (iv->GridProfile()->getLastUpdate() == 0 || !iv->GridProfile()->containsValidData())) {
-                    iv->sendGridOnProFileParaRequest();
-                }
+        // the radio decides whether the inverter needs to be told its frequency
+        iv->sendChangeChannelRequest();
+
+        iv->sendStatsRequest();
 
-                 _messageOutput->printf("Queue size - NRF: %" PRId32 " CMT: %" PRId32 "\r\n", _radioNrf->getQueueSize(), _radioCmt->getQueueSize());
-                _lastPoll = millis();
+        // Fetch event log
+        const bool force = iv->EventLog()->getLastAlarmRequestSuccess() == CMD_NOK;
+        iv->sendAlarmLogRequest(force);
+
+        // Fetch limit, unless an acknowledged limit command is still in effect
+        if (iv->isLimitReadbackRequired()
+            && (millis() - iv->SystemConfigPara()->getLastUpdateRequest() > HOY_SYSTEM_CONFIG_PARA_POLL_INTERVAL)
+            && (millis() - iv->SystemConfigPara()->getLastUpdateCommand() > HOY_SYSTEM_CONFIG_PARA_POLL_MIN_DURATION)) {
+            _messageOutput->println("Request SystemConfigPara");
+            iv->sendSystemConfigParaRequest();
+        }
+
+        // Set limit if required
+        if (iv->SystemConfigPara()->getLastLimitCommandSuccess() == CMD_NOK) {
+            _messageOutput->println("Resend ActivePowerControl");
+            iv->resendActivePowerControlRequest();
+        }
+
+        // Set power status if required
+        if (iv->PowerCommand()->getLastPowerCommandSuccess() == CMD_NOK) {
+            _messageOutput->println("Resend PowerCommand");
+            iv->resendPowerControlRequest();
+        }
+
+        // Fetch dev info (but first fetch stats)
+        if (iv->Statistics()->getLastUpdate() > 0) {
+            const bool invalidDevInfo = !iv->DevInfo()->containsValidData()
+                && iv->DevInfo()->getLastUpdateAll() > 0
+                && iv->DevInfo()->getLastUpdateSimple() > 0;
+
+            if (invalidDevInfo) {
+                _messageOutput->println("DevInfo: No Valid Data");
             }
 
-            if (++inverterPos >= getNumInverters()) {
-                inverterPos = 0;
+            if ((iv->DevInfo()->getLastUpdateAll() == 0)
+                || (iv->DevInfo()->getLastUpdateSimple() == 0)
+                || invalidDevInfo) {
+                _messageOutput->println("Request device info");
+                iv->sendDevInfoRequest();
             }
         }
 
-        // Perform housekeeping of all inverters on day change
-        const int8_t currentWeekDay = Utils::getWeekDay();
-        static int8_t lastWeekDay = -1;
-        if (lastWeekDay == -1) {
-            lastWeekDay = currentWeekDay;
-        } else {
-            if (currentWeekDay != lastWeekDay) {
+        // Fetch grid profile
+        if (iv->Statistics()->getLastUpdate() > 0 && (iv->GridProfile()->getLastUpdate() == 0 || !iv->GridProfile()->containsValidData())) {
+            iv->sendGridOnProFileParaRequest();
+        }
 
-                for (auto& inv : _inverters) {
-                    inv->performDailyTask();
+        if (_verboseLogging) {
+            _messageOutput->print("Queue size - NRF:");
+            for (uint8_t i = 0; i < _numRadiosNrf; i++) {
+                _messageOutput->printf(" %" PRId32, _radiosNrf[i]->getQueueSize());
+            }
+            _messageOutput->printf(" CMT: %" PRId32 "\r\n", _radioCmt->getQueueSize());
+            if (state.InverterPos == 0) {
+                for (uint8_t i = 0; i < _numRadiosNrf; i++) {
+                    _messageOutput->printf("Queue statistics - NRF %d:\r\n", i + 1);
+                    _radiosNrf[i]->dumpQueueStats(_messageOutput);
                 }
-
-                lastWeekDay = currentWeekDay;
+                _messageOutput->println("Queue statistics - CMT:");
+                _radioCmt->dumpQueueStats(_messageOutput);
             }
         }
+        state.LastPoll = millis();
+        iv->setLastPoll(state.LastPoll);
+    }
+
+    if (++state.InverterPos >= getNumInverters()) {
+        state.InverterPos = 0;
+    }
+}
+
+uint32_t HoymilesClass::getInverterPollInterval(InverterAbstract* iv)
+{
+    // Disabled inverters are only visited to zero their values
+    if (!(iv->getEnablePolling() || iv->getEnableCommands())) {
+        return 0;
+    }
+
+    // Interval which results from polling all inverters of the radio in turn
+    const uint32_t roundTrip = _pollInterval * getNumInverters(iv->getRadio());
+
+    switch (iv->getPollDemand()) {
+    case PollDemand::Normal:
+        return roundTrip * HOY_POLL_STABLE_FACTOR;
+    case PollDemand::Low:
+        return roundTrip * HOY_POLL_STANDBY_FACTOR;
+    default:
+        return 0;
+    }
+}
+
+HoymilesRadio_NRF* HoymilesClass::selectRadioNrf(const uint8_t nrfRadio) const
+{
+    if (nrfRadio > 0 && nrfRadio <= _numRadiosNrf && _radiosNrf[nrfRadio - 1]->isInitialized()) {
+        return _radiosNrf[nrfRadio - 1].get();
+    }
+
+    // Assign to the initialized radio with the fewest inverters
+    HoymilesRadio_NRF* selected = _radiosNrf[0].get();
+    size_t selectedCount = SIZE_MAX;
+    for (uint8_t i = 0; i < _numRadiosNrf; i++) {
+        if (!_radiosNrf[i]->isInitialized()) {
+            continue;
+        }
+        const size_t count = getNumInverters(_radiosNrf[i].get());
+        if (count < selectedCount) {
+            selected = _radiosNrf[i].get();
+            selectedCount = count;
+        }
     }
+    return selected;
 }
 
-std::shared_ptr<InverterAbstract> HoymilesClass::addInverter(const char* name, const uint64_t serial)
+std::shared_ptr<InverterAbstract> HoymilesClass::addInverter(const char* name, const uint64_t serial, const uint8_t nrfRadio)
 {
+    HoymilesRadio_NRF* radioNrf = selectRadioNrf(nrfRadio);
+
     std::shared_ptr<InverterAbstract> i = nullptr;
     if (HMT_4CH::isValidSerial(serial)) {
         i = std::make_shared<HMT_4CH>(_radioCmt.get(), serial);
@@ -162,29 +290,38 @@ std::shared_ptr<InverterAbstract> HoymilesClass::addInverter(const char* name, c
     } else if (HMS_1CHv2::isValidSerial(serial)) {
         i = std::make_shared<HMS_1CHv2>(_radioCmt.get(), serial);
     } else if (HM_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HM_4CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HM_4CH>(radioNrf, serial);
     } else if (HM_2CH::isValidSerial(serial)) {
-        i = std::make_shared<HM_2CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HM_2CH>(radioNrf, serial);
     } else if (HM_1CH::isValidSerial(serial)) {
-        i = std::make_shared<HM_1CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HM_1CH>(radioNrf, serial);
     } else if (HERF_1CH::isValidSerial(serial)) {
-        i = std::make_shared<HERF_1CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HERF_1CH>(radioNrf, serial);
     } else if (HERF_2CH::isValidSerial(serial)) {
-        i = std::make_shared<HERF_2CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HERF_2CH>(radioNrf, serial);
     } else if (HERF_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HERF_4CH>(_radioNrf.get(), serial);
+        i = std::make_shared<HERF_4CH>(radioNrf, serial);
     }
 
     if (i) {
         i->setName(name);
         i->init();
-        _inverters.push_back(std::move(i));
-        return _inverters.back();
+        std::lock_guard<std::mutex> lock(_mutex);
+        _inverters.push_back(i);
+        return i;
     }
 
     return nullptr;
 }
 
+void HoymilesClass::addInverter(const char* name, std::shared_ptr<InverterAbstract> inverter)
+{
+    inverter->setName(name);
+    inverter->init();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _inverters.push_back(std::move(inverter));
+}
+
 std::shared_ptr<InverterAbstract> HoymilesClass::getInverterByPos(const uint8_t pos)
 {
     if (pos >= _inverters.size()) {
@@ -237,14 +374,67 @@ void HoymilesClass::removeInverterBySerial(const uint64_t serial)
     }
 }
 
+void HoymilesClass::setInverterRadioNrf(const uint64_t serial, const uint8_t nrfRadio)
+{
+    auto inv = getInverterBySerial(serial);
+    if (inv == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Only inverters talking to an NRF24 module can be moved
+    auto current = inv->getRadio();
+    auto isRadioNrf = [this](const HoymilesRadio* radio) {
+        return std::any_of(_radiosNrf.begin(), _radiosNrf.begin() + _numRadiosNrf,
+            [radio](const std::unique_ptr<HoymilesRadio_NRF>& r) { return r.get() == radio; });
+    };
+    if (!isRadioNrf(current)) {
+        return;
+    }
+
+    // Keep the inverter where it is unless it was assigned explicitly
+    if (nrfRadio == 0 && current->isInitialized()) {
+        return;
+    }
+
+    HoymilesRadio_NRF* radio = selectRadioNrf(nrfRadio);
+    if (radio == current) {
+        return;
+    }
+
+    current->removeCommands(inv.get());
+    inv->setRadio(radio);
+}
+
 size_t HoymilesClass::getNumInverters() const
 {
     return _inverters.size();
 }
 
-HoymilesRadio_NRF* HoymilesClass::getRadioNrf()
+size_t HoymilesClass::getNumInverters(const HoymilesRadio* radio) const
 {
-    return _radioNrf.get();
+    return std::count_if(_inverters.begin(), _inverters.end(),
+        [radio](const std::shared_ptr<InverterAbstract>& inv) { return inv->getRadio() == radio; });
+}
+
+void HoymilesClass::withRadios(std::function<void()> const& fn)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    fn();
+}
+
+HoymilesRadio_NRF* HoymilesClass::getRadioNrf(const uint8_t index)
+{
+    if (index >= _numRadiosNrf) {
+        return nullptr;
+    }
+    return _radiosNrf[index].get();
+}
+
+uint8_t HoymilesClass::getNumRadiosNrf() const
+{
+    return _numRadiosNrf;
 }
 
 HoymilesRadio_CMT* HoymilesClass::getRadioCmt()
@@ -252,9 +442,84 @@ HoymilesRadio_CMT* HoymilesClass::getRadioCmt()
     return _radioCmt.get();
 }
 
+RadioRecorder& HoymilesClass::getRecorder()
+{
+    return _recorder;
+}
+
 bool HoymilesClass::isAllRadioIdle() const
 {
-    return _radioNrf.get()->isIdle() && _radioCmt.get()->isIdle();
+    for (uint8_t i = 0; i < _numRadiosNrf; i++) {
+        if (!_radiosNrf[i]->isIdle()) {
+            return false;
+        }
+    }
+    return _radioCmt->isIdle();
+}
+
+void HoymilesClass::setNightMode(const bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (enabled == _nightMode) {
+        return;
+    }
+
+    _nightMode = enabled;
+    _messageOutput->println(enabled ? "Entering night mode" : "Leaving night mode");
+
+    if (!enabled) {
+        for (uint8_t i = 0; i < _numRadiosNrf; i++) {
+            _radiosNrf[i]->setStandby(false);
+        }
+        _radioCmt->setStandby(false);
+    }
+}
+
+bool HoymilesClass::getNightMode() const
+{
+    return _nightMode;
+}
+
+void HoymilesClass::onCommandCompletion(CommandCompletionHandler handler)
+{
+    _commandCompletionHandlers.push_back(std::move(handler));
+}
+
+void HoymilesClass::notifyCommandCompletion(CommandAbstract const& cmd, const CommandResult result)
+{
+    if (cmd.getPriority() != CommandPriority::Control || _commandCompletionHandlers.empty()) {
+        return;
+    }
+
+    CommandCompletion completion = {
+        cmd.getId(),
+        cmd.getTargetAddress(),
+        cmd.getCommandName(),
+        result,
+        cmd.getEnqueueMillis(),
+        cmd.getFirstTxMillis(),
+        millis(),
+        cmd.getSendCount()
+    };
+
+    std::lock_guard<std::mutex> lock(_completionMutex);
+    _pendingCompletions.push_back(std::move(completion));
+}
+
+void HoymilesClass::dispatchCommandCompletions()
+{
+    std::deque<CommandCompletion> completions;
+    {
+        std::lock_guard<std::mutex> lock(_completionMutex);
+        std::swap(completions, _pendingCompletions);
+    }
+
+    for (auto const& completion : completions) {
+        for (auto const& handler : _commandCompletionHandlers) {
+            handler(completion);
+        }
+    }
 }
 
 uint32_t HoymilesClass::PollInterval() const
@@ -3,20 +3,32 @@
 
 #include "HoymilesRadio_CMT.h"
 #include "HoymilesRadio_NRF.h"
+#include "RadioRecorder.h"
 #include "inverters/InverterAbstract.h"
 #include "types.h"
 #include <Print.h>
 #include <SPI.h>
+#include <array>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #define HOY_SYSTEM_CONFIG_PARA_POLL_INTERVAL (2 * 60 * 1000) // 2 minutes
 #define HOY_SYSTEM_CONFIG_PARA_POLL_MIN_DURATION (4 * 60 * 1000) // at least 4 minutes between sending limit command and read request. Otherwise eventlog entry
+#define HOY_POLL_STABLE_FACTOR 2 // inverters with stable output are polled every second round
+#define HOY_POLL_STANDBY_FACTOR 6 // inverters which are not producing are polled every sixth round
+#define HOY_NIGHT_PROBE_INTERVAL (5 * 60 * 1000) // 5 minutes
+#define HOY_NRF_RADIO_COUNT 3 // NRF24 modules sharing the SPI bus of the first one
 
 class HoymilesClass {
 public:
     void init();
     void initNRF(SPIClass* initialisedSpiBus, const uint8_t pinCE, const uint8_t pinIRQ);
+    // Adds another NRF24 module on the bus of the one passed to initNRF().
+    // Each radio runs its own command queue and polls its own inverters.
+    bool addNRF(const uint8_t pinCE, const uint8_t pinCS, const uint8_t pinIRQ);
     void initCMT(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin_cs, const int8_t pin_fcs, const int8_t pin_gpio2, const int8_t pin_gpio3);
     void loop();
 
@@ -24,34 +36,83 @@ public:
     Print* getMessageOutput();
     Print* getVerboseMessageOutput();
 
-    std::shared_ptr<InverterAbstract> addInverter(const char* name, const uint64_t serial);
+    // nrfRadio selects the NRF24 module (1 based) an HM inverter is assigned
+    // to. With 0 or an unavailable module, the least busy one is chosen.
+    std::shared_ptr<InverterAbstract> addInverter(const char* name, const uint64_t serial, const uint8_t nrfRadio = 0);
+    // adds an inverter of a type which is not derived from the serial
+    void addInverter(const char* name, std::shared_ptr<InverterAbstract> inverter);
     std::shared_ptr<InverterAbstract> getInverterByPos(const uint8_t pos);
     std::shared_ptr<InverterAbstract> getInverterBySerial(const uint64_t serial);
     std::shared_ptr<InverterAbstract> getInverterByFragment(const fragment_t& fragment);
     void removeInverterBySerial(const uint64_t serial);
+    // Moves an HM inverter to another NRF24 module, see addInverter()
+    void setInverterRadioNrf(const uint64_t serial, const uint8_t nrfRadio);
     size_t getNumInverters() const;
+    size_t getNumInverters(const HoymilesRadio* radio) const;
 
-    HoymilesRadio_NRF* getRadioNrf();
+    // runs fn while the radio loop is not executing, such that fn may use
+    // the radios, i.e., their SPI bus, from any other task. fn must not
+    // call back into methods of this class which lock as well.
+    void withRadios(std::function<void()> const& fn);
+
+    HoymilesRadio_NRF* getRadioNrf(const uint8_t index = 0);
+    uint8_t getNumRadiosNrf() const;
     HoymilesRadio_CMT* getRadioCmt();
 
+    RadioRecorder& getRecorder();
+
     uint32_t PollInterval() const;
     void setPollInterval(const uint32_t interval);
     void setVerboseLogging(bool verboseLogging);
 
     bool isAllRadioIdle() const;
 
+    // while all inverters are asleep, they are only probed once per
+    // HOY_NIGHT_PROBE_INTERVAL and the radios are in standby in between.
+    // night mode ends by itself as soon as an inverter answers.
+    void setNightMode(const bool enabled);
+    bool getNightMode() const;
+
+    // handlers are called whenever a control command (limit, power,
+    // restart) ends, successfully or not. the completions are collected by
+    // the radio loop, which may run in a task of its own, and handed to the
+    // handlers by dispatchCommandCompletions().
+    using CommandCompletionHandler = std::function<void(CommandCompletion const&)>;
+    void onCommandCompletion(CommandCompletionHandler handler);
+    void notifyCommandCompletion(CommandAbstract const& cmd, const CommandResult result);
+    void dispatchCommandCompletions();
+
 private:
+    struct PollState {
+        uint32_t LastPoll = 0;
+        uint8_t InverterPos = 0;
+    };
+
+    void pollInverters(HoymilesRadio* radio, PollState& state);
+    void updateNightMode();
+    uint32_t getInverterPollInterval(InverterAbstract* iv);
+    HoymilesRadio_NRF* selectRadioNrf(const uint8_t nrfRadio) const;
+
     std::vector<std::shared_ptr<InverterAbstract>> _inverters;
-    std::unique_ptr<HoymilesRadio_NRF> _radioNrf;
+    std::array<std::unique_ptr<HoymilesRadio_NRF>, HOY_NRF_RADIO_COUNT> _radiosNrf;
+    uint8_t _numRadiosNrf = 0;
     std::unique_ptr<HoymilesRadio_CMT> _radioCmt;
 
+    RadioRecorder _recorder;
+
     std::mutex _mutex;
 
     uint32_t _pollInterval = 0;
+    bool _nightMode = false;
     bool _verboseLogging = true;
-    uint32_t _lastPoll = 0;
+    std::array<PollState, HOY_NRF_RADIO_COUNT> _pollStatesNrf;
+    PollState _pollStateCmt;
 
     Print* _messageOutput = &Serial;
+
+    std::vector<CommandCompletionHandler> _commandCompletionHandlers;
+    std::mutex _completionMutex;
+    std::deque<CommandCompletion> _pendingCompletions;
 };
 
 extern HoymilesClass Hoymiles;
\ No newline at end of file
@@ -5,6 +5,22 @@
 #include "HoymilesRadio.h"
 #include "Hoymiles.h"
 #include "crc.h"
+#include <esp_heap_caps.h>
+#include <new>
+
+void* HoymilesRadio::operator new(size_t size)
+{
+    void* ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void HoymilesRadio::operator delete(void* ptr)
+{
+    heap_caps_free(ptr);
+}
 
 serial_u HoymilesRadio::DtuSerial() const
 {
@@ -41,14 +57,46 @@ void HoymilesRadio::sendRetransmitPacket(const uint8_t fragment_id)
     CommandAbstract* requestCmd = cmd->getRequestFrameCommand(fragment_id);
 
     if (requestCmd != nullptr) {
-        sendEsbPacket(*requestCmd);
+        transmit(*requestCmd, true);
     }
 }
 
 void HoymilesRadio::sendLastPacketAgain()
 {
     CommandAbstract* cmd = _commandQueue.front().get();
-    sendEsbPacket(*cmd);
+    transmit(*cmd, false);
+}
+
+void HoymilesRadio::transmit(CommandAbstract& cmd, const bool reRequest)
+{
+    _lastTxMillis = millis();
+    _lastTxReRequest = reRequest;
+
+    sendEsbPacket(cmd);
+
+    if (!reRequest) {
+        return;
+    }
+
+    auto inv = Hoymiles.getInverterBySerial(cmd.getTargetAddress());
+    if (nullptr != inv) {
+        _rxTimeout.set(inv->getReRequestRxTimeout(cmd.getTimeout()));
+    }
+}
+
+void HoymilesRadio::learnRoundTrip(InverterAbstract& inv) const
+{
+    if (!_lastTxReRequest) {
+        return;
+    }
+
+    // nothing received in reply to the re-request
+    const int32_t rtt = static_cast<int32_t>(inv.getLastRxFragmentMillis() - _lastTxMillis);
+    if (rtt <= 0) {
+        return;
+    }
+
+    inv.learnReRequestRoundTrip(rtt);
 }
 
 void HoymilesRadio::handleReceivedPackage()
@@ -59,6 +107,8 @@ void HoymilesRadio::handleReceivedPackage()
 
         if (nullptr != inv) {
             CommandAbstract* cmd = _commandQueue.front().get();
+            learnRoundTrip(*inv);
+
             uint8_t verifyResult = inv->verifyAllFragments(*cmd);
             if (verifyResult == FRAGMENT_ALL_MISSING_RESEND) {
                 Hoymiles.getMessageOutput()->println("Nothing received, resend whole request");
@@ -71,6 +121,8 @@ void HoymilesRadio::handleReceivedPackage()
                     inv->RadioStats.RxFailNoAnswer++;
                 }
 
+                onCommandCompleted(*cmd, CommandResult::Timeout, *inv);
+                Hoymiles.notifyCommandCompletion(*cmd, CommandResult::Timeout);
                 _commandQueue.pop();
                 _busyFlag = false;
 
@@ -81,6 +133,8 @@ void HoymilesRadio::handleReceivedPackage()
                     inv->RadioStats.RxFailPartialAnswer++;
                 }
 
+                onCommandCompleted(*cmd, CommandResult::Timeout, *inv);
+                Hoymiles.notifyCommandCompletion(*cmd, CommandResult::Timeout);
                 _commandQueue.pop();
                 _busyFlag = false;
 
@@ -91,17 +145,33 @@ void HoymilesRadio::handleReceivedPackage()
                     inv->RadioStats.RxFailCorruptData++;
                 }
 
+                onCommandCompleted(*cmd, CommandResult::Nok, *inv);
+                Hoymiles.notifyCommandCompletion(*cmd, CommandResult::Nok);
                 _commandQueue.pop();
                 _busyFlag = false;
 
             } else if (verifyResult > 0) {
-                // Perform Retransmit
-                Hoymiles.getMessageOutput()->print("Request retransmit: ");
-                Hoymiles.getMessageOutput()->println(verifyResult);
+                // Re-requesting the fragments one by one takes a round trip
+                // each. Once this takes longer than waiting for the whole
+                // response, all missing fragments are requested at once by
+                // resending the request. The fragments received are kept.
+                const uint8_t missing = inv->countMissingFragments();
+                const CommandAbstract* requestCmd = cmd->getRequestFrameCommand(verifyResult);
+                const bool resend = missing > 1 && nullptr != requestCmd
+                    && missing * inv->getReRequestRxTimeout(requestCmd->getTimeout()) >= cmd->getTimeout();
+
                 // Statistics: Count TX Re-Request Fragment
-                inv->RadioStats.TxReRequestFragment++;
+                inv->RadioStats.TxReRequestFragment += resend ? missing : 1;
 
-                sendRetransmitPacket(verifyResult);
+                if (resend) {
+                    Hoymiles.getMessageOutput()->printf("Request %" PRIu8 " missing fragments at once\r\n", missing);
+                    sendLastPacketAgain();
+                } else {
+                    // Perform Retransmit
+                    Hoymiles.getMessageOutput()->print("Request retransmit: ");
+                    Hoymiles.getMessageOutput()->println(verifyResult);
+                    sendRetransmitPacket(verifyResult);
+                }
 
             } else {
                 // Successful received all packages
@@ -110,7 +180,10 @@ void HoymilesRadio::handleReceivedPackage()
                 if (inv->RadioStats.TxRequestData > 0) {
                     inv->RadioStats.RxSuccess++;
                 }
+                inv->countResponse(*cmd);
 
+                onCommandCompleted(*cmd, CommandResult::Ok, *inv);
+                Hoymiles.notifyCommandCompletion(*cmd, CommandResult::Ok);
                 _commandQueue.pop();
                 _busyFlag = false;
             }
@@ -124,6 +197,7 @@ void HoymilesRadio::handleReceivedPackage()
     } else if (!_busyFlag) {
         // Currently in idle mode --> send packet if one is in the queue
         if (!isQueueEmpty()) {
+            _commandQueue.scheduleNext();
             CommandAbstract* cmd = _commandQueue.front().get();
 
             auto inv = Hoymiles.getInverterBySerial(cmd->getTargetAddress());
@@ -132,7 +206,11 @@ void HoymilesRadio::handleReceivedPackage()
                 // Statistics: TX Requests
                 inv->RadioStats.TxRequestData++;
 
-                sendEsbPacket(*cmd);
+                if (cmd->getFirstTxMillis() == 0) {
+                    cmd->setFirstTxMillis(millis());
+                }
+
+                transmit(*cmd, false);
             } else {
                 Hoymiles.getMessageOutput()->println("TX: Invalid inverter found");
                 _commandQueue.pop();
@@ -141,6 +219,25 @@ void HoymilesRadio::handleReceivedPackage()
     }
 }
 
+void HoymilesRadio::notifyDropped(CommandAbstract const& cmd)
+{
+    Hoymiles.notifyCommandCompletion(cmd, CommandResult::Dropped);
+}
+
+CommandPool& HoymilesRadio::getCommandPool(InverterAbstract* inv)
+{
+    return inv->getCommandPool();
+}
+
+void HoymilesRadio::countDroppedFragment(const fragment_t& fragment)
+{
+    std::shared_ptr<InverterAbstract> inv = Hoymiles.getInverterByFragment(fragment);
+    if (nullptr != inv) {
+        // Statistics: Count RX Dropped Fragments
+        inv->RadioStats.RxDroppedFragments++;
+    }
+}
+
 void HoymilesRadio::dumpBuf(const uint8_t buf[], const uint8_t len, const bool appendNewline)
 {
     for (uint8_t i = 0; i < len; i++) {
@@ -180,3 +277,8 @@ uint32_t HoymilesRadio::getQueueSize() const
 {
     return _commandQueue.size();
 }
+
+void HoymilesRadio::dumpQueueStats(Print* stream) const
+{
+    _commandQueue.dumpStats(stream);
+}
@@ -3,7 +3,9 @@
 
 #include "Arduino.h"
 #include "commands/CommandAbstract.h"
+#include "commands/CommandPool.h"
 #include "queue/CommandQueue.h"
+#include "queue/FragmentRingBuffer.h"
 #include "types.h"
 #include <TimeoutHelper.h>
 
@@ -15,14 +17,25 @@
 
 class HoymilesRadio {
 public:
+    // radios hold the fragment buffers of the radio path, which are kept in
+    // internal RAM, even if large allocations go to PSRAM otherwise.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+
     serial_u DtuSerial() const;
     virtual void setDtuSerial(const uint64_t serial);
 
     bool isIdle() const;
     bool isQueueEmpty() const;
     uint32_t getQueueSize() const;
+    void dumpQueueStats(Print* stream) const;
     bool isInitialized() const;
 
+    // powers the transceiver down while no command is pending, see
+    // HoymilesClass::setNightMode(). the loop does nothing in standby.
+    virtual void setStandby(const bool standby) = 0;
+    bool isStandby() const { return _standby; }
+
     void removeCommands(InverterAbstract* inv);
     uint8_t countSimilarCommands(std::shared_ptr<CommandAbstract> cmd);
 
@@ -30,6 +43,7 @@ public:
     {
         DEBUG_PRINT("Queue size before: %ld\r\n", _commandQueue.size());
         DEBUG_PRINT("Handling command %s with type %d\r\n", cmd.get()->getCommandName().c_str(), static_cast<uint8_t>(cmd.get()->getQueueInsertType()));
+        cmd->setEnqueueMillis(millis());
         switch (cmd.get()->getQueueInsertType()) {
         case QueueInsertType::RemoveOldest:
             _commandQueue.removeDuplicatedEntries(cmd);
@@ -49,6 +63,7 @@ public:
             // and drops the new one. The new one will not be inserted.
             if (_commandQueue.countSimilarCommands(cmd) > 0) {
                 DEBUG_PRINT("    ... new entry will be dropped\r\n");
+                notifyDropped(*cmd);
                 return;
             }
             break;
@@ -59,7 +74,7 @@ public:
 
         // Push the command into the queue if we reach this position of the code
         DEBUG_PRINT("    ... new entry will be appended\r\n");
-        _commandQueue.push(cmd);
+        _commandQueue.push(std::move(cmd));
 
         DEBUG_PRINT("Queue size after: %ld\r\n", _commandQueue.size());
     }
@@ -67,10 +82,15 @@ public:
     template <typename T>
     std::shared_ptr<T> prepareCommand(InverterAbstract* inv)
     {
-        return std::make_shared<T>(inv);
+        return getCommandPool(inv).acquire<T>(inv);
     }
 
 protected:
+    static void notifyDropped(CommandAbstract const& cmd);
+    static CommandPool& getCommandPool(InverterAbstract* inv);
+
+    // called when the radio is done with a command sent to the given inverter
+    virtual void onCommandCompleted(CommandAbstract&, const CommandResult, InverterAbstract&) { }
     static serial_u convertSerialToRadioId(const serial_u serial);
     static void dumpBuf(const uint8_t buf[], const uint8_t len, const bool appendNewline = true);
 
@@ -78,12 +98,21 @@ protected:
     virtual void sendEsbPacket(CommandAbstract& cmd) = 0;
     void sendRetransmitPacket(const uint8_t fragment_id);
     void sendLastPacketAgain();
+
+    // sends the packet. re-requested fragments are awaited as long as the
+    // inverter is known to take, see InverterAbstract::getReRequestRxTimeout()
+    void transmit(CommandAbstract& cmd, const bool reRequest);
+    void learnRoundTrip(InverterAbstract& inv) const;
     void handleReceivedPackage();
+    void countDroppedFragment(const fragment_t& fragment);
 
     serial_u _dtuSerial;
     CommandQueue _commandQueue;
     bool _isInitialized = false;
     bool _busyFlag = false;
+    bool _standby = false;
 
     TimeoutHelper _rxTimeout;
+    uint32_t _lastTxMillis = 0;
+    bool _lastTxReRequest = false;
 };
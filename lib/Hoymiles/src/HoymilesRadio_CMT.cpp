@@ -6,6 +6,7 @@
 #include "Hoymiles.h"
 #include "crc.h"
 #include <FunctionalInterrupt.h>
+#include <algorithm>
 #include <frozen/map.h>
 
 constexpr CountryFrequencyDefinition_t make_value(FrequencyBand_t Band, uint32_t Freq_Legal_Min, uint32_t Freq_Legal_Max, uint32_t Freq_Default, uint32_t Freq_StartUp)
@@ -115,7 +116,7 @@ void HoymilesRadio_CMT::init(const int8_t pin_sdio, const int8_t pin_clk, const
 
 void HoymilesRadio_CMT::loop()
 {
-    if (!_isInitialized) {
+    if (!_isInitialized || _standby) {
         return;
     }
 
@@ -128,31 +129,35 @@ void HoymilesRadio_CMT::loop()
     if (_packetReceived) {
         Hoymiles.getVerboseMessageOutput()->println("Interrupt received");
         while (_radio->available()) {
-            if (!(_rxBuffer.size() > FRAGMENT_BUFFER_SIZE)) {
-                fragment_t f;
-                memset(f.fragment, 0xcc, MAX_RF_PAYLOAD_SIZE);
-                f.len = _radio->getDynamicPayloadSize();
-                f.channel = _radio->getChannel();
-                f.rssi = _radio->getRssiDBm();
-                f.wasReceived = false;
-                f.mainCmd = 0x00;
-                if (f.len > MAX_RF_PAYLOAD_SIZE) {
-                    f.len = MAX_RF_PAYLOAD_SIZE;
-                }
-                _radio->read(f.fragment, f.len);
-                _rxBuffer.push(f);
-            } else {
+            fragment_t f;
+            memset(f.fragment, 0xcc, MAX_RF_PAYLOAD_SIZE);
+            f.len = _radio->getDynamicPayloadSize();
+            f.channel = _radio->getChannel();
+            f.rssi = _radio->getRssiDBm();
+            f.wasReceived = false;
+            f.mainCmd = 0x00;
+            if (f.len > MAX_RF_PAYLOAD_SIZE) {
+                f.len = MAX_RF_PAYLOAD_SIZE;
+            }
+            _radio->read(f.fragment, f.len);
+            Hoymiles.getRecorder().record(RadioRecorder::Direction::Rx, RadioRecorder::RadioType::Cmt,
+                f.channel, f.rssi, f.fragment, f.len);
+
+            // Read the fragment anyway to free the radio FIFO and to
+            // account the dropped fragment to the inverter.
+            if (!_rxBuffer.push(f)) {
                 Hoymiles.getMessageOutput()->println("CMT: Buffer full");
-                _radio->flush_rx();
+                countDroppedFragment(f);
             }
         }
         _radio->flush_rx();
         _packetReceived = false;
 
     } else {
-        // Perform package parsing only if no packages are received
-        if (!_rxBuffer.empty()) {
-            fragment_t f = _rxBuffer.back();
+        // Perform package parsing only if no packages are received.
+        // Fragments are handled in the order they were received.
+        fragment_t f;
+        while (!_packetReceived && _rxBuffer.pop(f)) {
             if (checkFragmentCrc(f)) {
 
                 const serial_u dtuId = convertSerialToRadioId(_dtuSerial);
@@ -170,6 +175,11 @@ void HoymilesRadio_CMT::loop()
                         Hoymiles.getVerboseMessageOutput()->printf("| %" PRId8 " dBm\r\n", f.rssi);
 
                         inv->addRxFragment(f.fragment, f.len, f.rssi);
+
+                        LinkQuality* quality = getLinkQuality(getFrequencyFromChannel(f.channel));
+                        if (quality != nullptr) {
+                            quality->Rssi = (quality->Rssi == 0) ? f.rssi : (3 * quality->Rssi + f.rssi) / 4;
+                        }
                     } else {
                         Hoymiles.getMessageOutput()->println("Inverter Not found!");
                     }
@@ -178,9 +188,6 @@ void HoymilesRadio_CMT::loop()
             } else {
                 Hoymiles.getMessageOutput()->println("Frame kaputt"); // ;-)
             }
-
-            // Remove paket from buffer even it was corrupted
-            _rxBuffer.pop();
         }
     }
 
@@ -200,8 +207,28 @@ void HoymilesRadio_CMT::setPALevel(const int8_t paLevel)
     }
 }
 
+void HoymilesRadio_CMT::setStandby(const bool standby)
+{
+    if (!_isInitialized || standby == _standby) {
+        return;
+    }
+
+    _standby = standby;
+    if (standby) {
+        _radio->stopListening(); // puts the chip to sleep
+        return;
+    }
+
+    _radio->startListening();
+}
+
 void HoymilesRadio_CMT::setInverterTargetFrequency(const uint32_t frequency)
 {
+    if (_isInitialized && frequency != _inverterTargetFrequency) {
+        _previousTargetFrequency = _inverterTargetFrequency;
+        _previousTargetMillis = millis();
+    }
+
     _inverterTargetFrequency = frequency;
     if (!_isInitialized) {
         return;
@@ -214,6 +241,134 @@ uint32_t HoymilesRadio_CMT::getInverterTargetFrequency() const
     return _inverterTargetFrequency;
 }
 
+void HoymilesRadio_CMT::setFrequencyAgility(const bool enabled)
+{
+    _frequencyAgility = enabled;
+}
+
+bool HoymilesRadio_CMT::isChannelChangeDue(InverterAbstract& inv)
+{
+    const uint32_t now = millis();
+    ChannelChangeState& state = _channelChange[inv.serial()];
+
+    if (state.Frequency == _inverterTargetFrequency) {
+        if (inv.isReachable()) {
+            state.BackoffMs = 0;
+            return false;
+        }
+
+        if (state.BackoffMs > 0 && now - state.LastMillis < state.BackoffMs) {
+            return false;
+        }
+    }
+
+    state.Frequency = _inverterTargetFrequency;
+    state.LastMillis = now;
+    state.BackoffMs = std::clamp(state.BackoffMs * 2, _channelChangeBackoffMinMs, _channelChangeBackoffMaxMs);
+    return true;
+}
+
+HoymilesRadio_CMT::LinkQuality* HoymilesRadio_CMT::getLinkQuality(const uint32_t frequency)
+{
+    const auto& definition = countryDefinition.at(_countryMode);
+    if (frequency < definition.Freq_Legal_Min || frequency > definition.Freq_Legal_Max) {
+        return nullptr;
+    }
+
+    const size_t step = (frequency - definition.Freq_Legal_Min) / getChannelWidth();
+    if (step >= _linkQuality.size()) {
+        return nullptr;
+    }
+    return &_linkQuality[step];
+}
+
+void HoymilesRadio_CMT::onCommandCompleted(CommandAbstract& cmd, const CommandResult result, InverterAbstract& inv)
+{
+    // the change channel command is never answered, and unreachable
+    // inverters are likely switched off rather than suffering from the link
+    if (isChannelChangeCommand(cmd) || !inv.isReachable()) {
+        return;
+    }
+
+    LinkQuality* quality = getLinkQuality(_inverterTargetFrequency);
+    if (quality == nullptr) {
+        return;
+    }
+
+    if (quality->Requests >= _linkWindow) {
+        quality->Requests /= 2;
+        quality->Answered /= 2;
+    }
+    quality->Requests++;
+    if (result != CommandResult::Timeout) {
+        quality->Answered++;
+    }
+
+    if (!_frequencyAgility
+        || quality->Requests < _linkMinRequests
+        || quality->Answered * 2 >= quality->Requests) {
+        return;
+    }
+
+    if (_lastMoveMillis != 0 && millis() - _lastMoveMillis < _moveHoldOffMs) {
+        return;
+    }
+
+    moveInverterTargetFrequency();
+}
+
+void HoymilesRadio_CMT::moveInverterTargetFrequency()
+{
+    const auto& definition = countryDefinition.at(_countryMode);
+    const uint32_t width = getChannelWidth();
+    const size_t steps = std::min<size_t>((definition.Freq_Legal_Max - definition.Freq_Legal_Min) / width + 1, _linkQuality.size());
+
+    LinkQuality* current = getLinkQuality(_inverterTargetFrequency);
+    if (current == nullptr || steps < 2) {
+        return;
+    }
+    const size_t currentStep = current - _linkQuality.data();
+    const float currentScore = static_cast<float>(current->Answered) / current->Requests;
+
+    // interference usually spans more than one step, so nearby steps are
+    // skipped. steps without enough requests are assumed to be fairly good,
+    // such that they are tried. the search starts above the current step,
+    // which spreads the attempts over the band.
+    static constexpr size_t minDistance = 4;
+    static constexpr float untriedScore = 0.75;
+
+    size_t bestStep = currentStep;
+    float bestScore = currentScore;
+    for (size_t i = 1; i < steps; i++) {
+        const size_t step = (currentStep + i) % steps;
+        const size_t distance = std::min(i, steps - i);
+        if (distance < minDistance && steps > 2 * minDistance) {
+            continue;
+        }
+
+        const LinkQuality& quality = _linkQuality[step];
+        const bool tried = quality.Requests >= _linkMinRequests;
+        const float score = tried ? static_cast<float>(quality.Answered) / quality.Requests : untriedScore;
+
+        const bool betterRssi = bestStep != currentStep && tried && quality.Rssi > _linkQuality[bestStep].Rssi;
+        if (score > bestScore || (score == bestScore && betterRssi)) {
+            bestStep = step;
+            bestScore = score;
+        }
+    }
+
+    if (bestStep == currentStep) {
+        return;
+    }
+
+    const uint32_t frequency = definition.Freq_Legal_Min + bestStep * width;
+    Hoymiles.getMessageOutput()->printf("CMT: %" PRIu8 " of %" PRIu8 " requests answered on %.2f MHz, moving to %.2f MHz\r\n",
+        current->Answered, current->Requests, _inverterTargetFrequency / 1000000.0, frequency / 1000000.0);
+
+    _lastMoveMillis = millis();
+    setInverterTargetFrequency(frequency);
+}
+
 bool HoymilesRadio_CMT::isConnected() const
 {
     if (!_isInitialized) {
@@ -239,6 +394,9 @@ CountryModeId_t HoymilesRadio_CMT::getCountryMode() const
 
 void HoymilesRadio_CMT::setCountryMode(const CountryModeId_t mode)
 {
+    if (mode != _countryMode) {
+        _linkQuality = {};
+    }
     _countryMode = mode;
     if (!_isInitialized) {
         return;
@@ -262,6 +420,11 @@ void ARDUINO_ISR_ATTR HoymilesRadio_CMT::handleInt2()
     _packetReceived = true;
 }
 
+bool HoymilesRadio_CMT::isChannelChangeCommand(CommandAbstract& cmd)
+{
+    return cmd.getDataPayload()[0] == 0x56; // @todo(tbnobody) Bad hack to identify ChannelChange Command
+}
+
 void HoymilesRadio_CMT::sendEsbPacket(CommandAbstract& cmd)
 {
     cmd.incrementSendCount();
@@ -270,17 +433,30 @@ void HoymilesRadio_CMT::sendEsbPacket(CommandAbstract& cmd)
 
     _radio->stopListening();
 
-    if (cmd.getDataPayload()[0] == 0x56) { // @todo(tbnobody) Bad hack to identify ChannelChange Command
-        cmtSwitchDtuFreq(getInvBootFrequency());
-    }
+    auto write = [this, &cmd]() {
+        Hoymiles.getVerboseMessageOutput()->printf("TX %s %.2f MHz --> ",
+            cmd.getCommandName().c_str(), getFrequencyFromChannel(_radio->getChannel()) / 1000000.0);
+        cmd.dumpDataPayload(Hoymiles.getVerboseMessageOutput());
+
+        Hoymiles.getRecorder().record(RadioRecorder::Direction::Tx, RadioRecorder::RadioType::Cmt,
+            _radio->getChannel(), 0, cmd.getDataPayload(), cmd.getDataSize());
+        if (!_radio->write(cmd.getDataPayload(), cmd.getDataSize())) {
+            Hoymiles.getMessageOutput()->println("TX SPI Timeout");
+        }
+    };
 
-    Hoymiles.getVerboseMessageOutput()->printf("TX %s %.2f MHz --> ",
-        cmd.getCommandName().c_str(), getFrequencyFromChannel(_radio->getChannel()) / 1000000.0);
-    cmd.dumpDataPayload(Hoymiles.getVerboseMessageOutput());
+    if (isChannelChangeCommand(cmd)) {
+        cmtSwitchDtuFreq(getInvBootFrequency());
+        write();
 
-    if (!_radio->write(cmd.getDataPayload(), cmd.getDataSize())) {
-        Hoymiles.getMessageOutput()->println("TX SPI Timeout");
+        if (_previousTargetFrequency != 0 && millis() - _previousTargetMillis < _previousTargetTimeoutMs) {
+            cmtSwitchDtuFreq(_previousTargetFrequency);
+            write();
+        }
+    } else {
+        write();
     }
+
     cmtSwitchDtuFreq(_inverterTargetFrequency);
     _radio->startListening();
     _busyFlag = true;
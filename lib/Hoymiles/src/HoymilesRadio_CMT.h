@@ -5,9 +5,10 @@
 #include "commands/CommandAbstract.h"
 #include "types.h"
 #include <Arduino.h>
+#include <array>
 #include <cmt2300wrapper.h>
+#include <map>
 #include <memory>
-#include <queue>
 #include <vector>
 
 // number of fragments hold in buffer
@@ -44,9 +45,19 @@ public:
     void init(const int8_t pin_sdio, const int8_t pin_clk, const int8_t pin_cs, const int8_t pin_fcs, const int8_t pin_gpio2, const int8_t pin_gpio3);
     void loop();
     void setPALevel(const int8_t paLevel);
+    void setStandby(const bool standby);
     void setInverterTargetFrequency(const uint32_t frequency);
     uint32_t getInverterTargetFrequency() const;
 
+    // moves the inverters to a better frequency of the legal band when
+    // the share of answered requests drops below half
+    void setFrequencyAgility(const bool enabled);
+
+    // true if the inverter shall be told the target frequency: if it
+    // was not told the current one yet, or if it is not reachable and
+    // the last request is longer ago than a backoff growing per request.
+    bool isChannelChangeDue(InverterAbstract& inv);
+
     bool isConnected() const;
 
     uint32_t getMinFrequency() const;
@@ -71,6 +82,8 @@ private:
     void ARDUINO_ISR_ATTR handleInt2();
 
     void sendEsbPacket(CommandAbstract& cmd);
+    void onCommandCompleted(CommandAbstract& cmd, const CommandResult result, InverterAbstract& inv) override;
+    static bool isChannelChangeCommand(CommandAbstract& cmd);
 
     std::unique_ptr<CMT2300A> _radio;
 
@@ -80,7 +93,7 @@ private:
     bool _gpio2_configured = false;
     bool _gpio3_configured = false;
 
-    std::queue<fragment_t> _rxBuffer;
+    FragmentRingBuffer<fragment_t, FRAGMENT_BUFFER_SIZE> _rxBuffer;
     TimeoutHelper _txTimeout;
 
     uint32_t _inverterTargetFrequency = HOYMILES_CMT_WORK_FREQ;
@@ -88,4 +101,38 @@ private:
     bool cmtSwitchDtuFreq(const uint32_t to_frequency);
 
     CountryModeId_t _countryMode;
+
+    // link quality per frequency step of the legal band. the counts only
+    // cover requests to reachable inverters and are halved regularly.
+    struct LinkQuality {
+        int8_t Rssi = 0; // dBm, smoothed, zero if nothing was received
+        uint8_t Requests = 0;
+        uint8_t Answered = 0;
+    };
+    static constexpr size_t _maxLinkSteps = 96;
+    static constexpr uint8_t _linkWindow = 32;
+    static constexpr uint8_t _linkMinRequests = 16;
+    std::array<LinkQuality, _maxLinkSteps> _linkQuality;
+    LinkQuality* getLinkQuality(const uint32_t frequency);
+    void moveInverterTargetFrequency();
+
+    bool _frequencyAgility = false;
+    uint32_t _lastMoveMillis = 0;
+    static constexpr uint32_t _moveHoldOffMs = 10 * 60 * 1000;
+
+    // inverters which were not told about a new target frequency yet keep
+    // listening on the previous one until they fall back to the boot
+    // frequency, so they are told on both.
+    uint32_t _previousTargetFrequency = 0;
+    uint32_t _previousTargetMillis = 0;
+    static constexpr uint32_t _previousTargetTimeoutMs = 15 * 60 * 1000;
+
+    struct ChannelChangeState {
+        uint32_t Frequency = 0; // the inverter was told last
+        uint32_t LastMillis = 0;
+        uint32_t BackoffMs = 0;
+    };
+    std::map<uint64_t, ChannelChangeState> _channelChange;
+    static constexpr uint32_t _channelChangeBackoffMinMs = 15 * 1000;
+    static constexpr uint32_t _channelChangeBackoffMaxMs = 2 * 60 * 1000;
 };
@@ -9,11 +9,16 @@
 #include <FunctionalInterrupt.h>
 
 void HoymilesRadio_NRF::init(SPIClass* initialisedSpiBus, const uint8_t pinCE, const uint8_t pinIRQ)
+{
+    init(std::shared_ptr<SPIClass>(initialisedSpiBus), pinCE, initialisedSpiBus->pinSS(), pinIRQ);
+}
+
+void HoymilesRadio_NRF::init(std::shared_ptr<SPIClass> spiBus, const uint8_t pinCE, const uint8_t pinCS, const uint8_t pinIRQ)
 {
     _dtuSerial.u64 = 0;
 
-    _spiPtr.reset(initialisedSpiBus);
-    _radio.reset(new RF24(pinCE, initialisedSpiBus->pinSS()));
+    _spiPtr = std::move(spiBus);
+    _radio.reset(new RF24(pinCE, pinCS));
 
     _radio->begin(_spiPtr.get());
 
@@ -38,7 +43,7 @@ void HoymilesRadio_NRF::init(SPIClass* initialisedSpiBus, const uint8_t pinCE, c
 
 void HoymilesRadio_NRF::loop()
 {
-    if (!_isInitialized) {
+    if (!_isInitialized || _standby) {
         return;
     }
 
@@ -50,37 +55,46 @@ void HoymilesRadio_NRF::loop()
     if (_packetReceived) {
         Hoymiles.getVerboseMessageOutput()->println("Interrupt received");
         while (_radio->available()) {
-            if (!(_rxBuffer.size() > FRAGMENT_BUFFER_SIZE)) {
-                fragment_t f;
-                memset(f.fragment, 0xcc, MAX_RF_PAYLOAD_SIZE);
-                f.len = _radio->getDynamicPayloadSize();
-                f.channel = _radio->getChannel();
-                f.rssi = _radio->testRPD() ? -30 : -80;
-                if (f.len > MAX_RF_PAYLOAD_SIZE)
-                    f.len = MAX_RF_PAYLOAD_SIZE;
-                _radio->read(f.fragment, f.len);
-                _rxBuffer.push(f);
-            } else {
+            fragment_t f;
+            memset(f.fragment, 0xcc, MAX_RF_PAYLOAD_SIZE);
+            f.len = _radio->getDynamicPayloadSize();
+            f.channel = _radio->getChannel();
+            f.rssi = _radio->testRPD() ? -30 : -80;
+            if (f.len > MAX_RF_PAYLOAD_SIZE)
+                f.len = MAX_RF_PAYLOAD_SIZE;
+            _radio->read(f.fragment, f.len);
+            Hoymiles.getRecorder().record(RadioRecorder::Direction::Rx, RadioRecorder::RadioType::Nrf,
+                f.channel, f.rssi, f.fragment, f.len);
+
+            // Read the fragment anyway to free the radio FIFO and to
+            // account the dropped fragment to the inverter.
+            if (!_rxBuffer.push(f)) {
                 Hoymiles.getMessageOutput()->println("NRF: Buffer full");
-                _radio->flush_rx();
+                countDroppedFragment(f);
             }
         }
         _packetReceived = false;
 
     } else {
-        // Perform package parsing only if no packages are received
-        if (!_rxBuffer.empty()) {
-            fragment_t f = _rxBuffer.back();
+        // Perform package parsing only if no packages are received.
+        // Fragments are handled in the order they were received.
+        fragment_t f;
+        while (!_packetReceived && _rxBuffer.pop(f)) {
             if (checkFragmentCrc(f)) {
                 std::shared_ptr<InverterAbstract> inv = Hoymiles.getInverterByFragment(f);
 
-                if (nullptr != inv) {
+                if (nullptr != inv && inv->getRadio() != this) {
+                    // The inverter answered a request of another radio
+                    // listening on the same channel.
+                    Hoymiles.getVerboseMessageOutput()->println("NRF: Fragment of other radio dropped");
+                } else if (nullptr != inv) {
                     // Save packet in inverter rx buffer
                     Hoymiles.getVerboseMessageOutput()->printf("RX Channel: %" PRId8 " --> ", f.channel);
                     dumpBuf(f.fragment, f.len, false);
                     Hoymiles.getVerboseMessageOutput()->printf("| %" PRId8 " dBm\r\n", f.rssi);
 
                     inv->addRxFragment(f.fragment, f.len, f.rssi);
+                    inv->countRxChannelFragment(f.channel);
                 } else {
                     Hoymiles.getMessageOutput()->println("Inverter Not found!");
                 }
@@ -88,9 +102,6 @@ void HoymilesRadio_NRF::loop()
             } else {
                 Hoymiles.getMessageOutput()->println("Frame kaputt");
             }
-
-            // Remove paket from buffer even it was corrupted
-            _rxBuffer.pop();
         }
     }
 
@@ -105,6 +116,23 @@ void HoymilesRadio_NRF::setPALevel(const rf24_pa_dbm_e paLevel)
     _radio->setPALevel(paLevel);
 }
 
+void HoymilesRadio_NRF::setStandby(const bool standby)
+{
+    if (!_isInitialized || standby == _standby) {
+        return;
+    }
+
+    _standby = standby;
+    if (standby) {
+        _radio->stopListening();
+        _radio->powerDown();
+        return;
+    }
+
+    _radio->powerUp();
+    _radio->startListening();
+}
+
 void HoymilesRadio_NRF::setDtuSerial(const uint64_t serial)
 {
     HoymilesRadio::setDtuSerial(serial);
@@ -131,6 +159,11 @@ bool HoymilesRadio_NRF::isPVariant() const
     return _radio->isPVariant();
 }
 
+std::shared_ptr<SPIClass> HoymilesRadio_NRF::getSpiBus() const
+{
+    return _spiPtr;
+}
+
 void HoymilesRadio_NRF::openReadingPipe()
 {
     const serial_u s = convertSerialToRadioId(_dtuSerial);
@@ -152,6 +185,7 @@ uint8_t HoymilesRadio_NRF::getRxNxtChannel()
 {
     if (++_rxChIdx >= sizeof(_rxChLst))
         _rxChIdx = 0;
+    _rxChDwellLeft = _rxChDwell[_rxChIdx] - 1;
     return _rxChLst[_rxChIdx];
 }
 
@@ -164,6 +198,11 @@ uint8_t HoymilesRadio_NRF::getTxNxtChannel()
 
 void HoymilesRadio_NRF::switchRxCh()
 {
+    if (_rxChDwellLeft > 0) {
+        _rxChDwellLeft--;
+        return;
+    }
+
     _radio->stopListening();
     _radio->setChannel(getRxNxtChannel());
     _radio->startListening();
@@ -186,10 +225,19 @@ void HoymilesRadio_NRF::sendEsbPacket(CommandAbstract& cmd)
     Hoymiles.getVerboseMessageOutput()->printf("TX %s Channel: %" PRId8 " --> ",
         cmd.getCommandName().c_str(), _radio->getChannel());
     cmd.dumpDataPayload(Hoymiles.getVerboseMessageOutput());
+    Hoymiles.getRecorder().record(RadioRecorder::Direction::Tx, RadioRecorder::RadioType::Nrf,
+        _radio->getChannel(), 0, cmd.getDataPayload(), cmd.getDataSize());
     _radio->write(cmd.getDataPayload(), cmd.getDataSize());
 
     _radio->setRetries(0, 0);
     openReadingPipe();
+
+    // listen longer on the channels this inverter answered on recently
+    auto inv = Hoymiles.getInverterBySerial(cmd.getTargetAddress());
+    for (uint8_t i = 0; i < sizeof(_rxChLst); i++) {
+        _rxChDwell[i] = (inv != nullptr) ? inv->getRxChannelDwell(_rxChLst[i]) : 1;
+    }
+
     _radio->setChannel(getRxNxtChannel());
     _radio->startListening();
     _busyFlag = true;
@@ -6,7 +6,6 @@
 #include <RF24.h>
 #include <memory>
 #include <nRF24L01.h>
-#include <queue>
 
 // number of fragments hold in buffer
 #define FRAGMENT_BUFFER_SIZE 30
@@ -14,14 +13,19 @@
 class HoymilesRadio_NRF : public HoymilesRadio {
 public:
     void init(SPIClass* initialisedSpiBus, const uint8_t pinCE, const uint8_t pinIRQ);
+    // Several radios may share one bus, each one using its own chip select
+    void init(std::shared_ptr<SPIClass> spiBus, const uint8_t pinCE, const uint8_t pinCS, const uint8_t pinIRQ);
     void loop();
     void setPALevel(const rf24_pa_dbm_e paLevel);
+    void setStandby(const bool standby);
 
     virtual void setDtuSerial(const uint64_t serial);
 
     bool isConnected() const;
     bool isPVariant() const;
 
+    std::shared_ptr<SPIClass> getSpiBus() const;
+
 private:
     void ARDUINO_ISR_ATTR handleIntr();
     uint8_t getRxNxtChannel();
@@ -32,15 +36,19 @@ private:
 
     void sendEsbPacket(CommandAbstract& cmd);
 
-    std::unique_ptr<SPIClass> _spiPtr;
+    std::shared_ptr<SPIClass> _spiPtr;
     std::unique_ptr<RF24> _radio;
     uint8_t _rxChLst[5] = { 3, 23, 40, 61, 75 };
     uint8_t _rxChIdx = 0;
 
+    // hops to listen per channel of _rxChLst, rated for the inverter addressed last
+    uint8_t _rxChDwell[5] = { 1, 1, 1, 1, 1 };
+    uint8_t _rxChDwellLeft = 0;
+
     uint8_t _txChLst[5] = { 3, 23, 40, 61, 75 };
     uint8_t _txChIdx = 0;
 
     volatile bool _packetReceived = false;
 
-    std::queue<fragment_t> _rxBuffer;
+    FragmentRingBuffer<fragment_t, FRAGMENT_BUFFER_SIZE> _rxBuffer;
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "RadioRecorder.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cstring>
+
+bool RadioRecorder::start(const size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _active = false;
+    _records.clear();
+    _records.shrink_to_fit();
+    _firstSequence = _nextSequence;
+
+    if (capacity == 0) {
+        return false;
+    }
+
+    try {
+        _records.resize(capacity);
+    } catch (std::bad_alloc const&) {
+        return false;
+    }
+
+    _active = true;
+    return true;
+}
+
+void RadioRecorder::stop()
+{
+    // the records are kept, such that they can still be downloaded
+    std::lock_guard<std::mutex> lock(_mutex);
+    _active = false;
+}
+
+bool RadioRecorder::isActive() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _active;
+}
+
+void RadioRecorder::record(const Direction dir, const RadioType radio, const uint8_t channel,
+    const int8_t rssi, const uint8_t data[], const uint8_t len)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_active) {
+        return;
+    }
+
+    auto& rec = _records[_nextSequence % _records.size()];
+    rec.Sequence = _nextSequence;
+    rec.Millis = millis();
+    rec.Dir = dir;
+    rec.Radio = radio;
+    rec.Channel = channel;
+    rec.Rssi = rssi;
+    rec.Len = std::min<uint8_t>(len, MAX_RF_PAYLOAD_SIZE);
+    memcpy(rec.Data, data, rec.Len);
+
+    ++_nextSequence;
+    if (_nextSequence - _firstSequence > _records.size()) {
+        ++_firstSequence;
+    }
+}
+
+size_t RadioRecorder::getCapacity() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _records.size();
+}
+
+uint32_t RadioRecorder::getFirstSequence() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _firstSequence;
+}
+
+uint32_t RadioRecorder::getNextSequence() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _nextSequence;
+}
+
+bool RadioRecorder::get(const uint32_t sequence, Record& record) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_records.empty() || sequence < _firstSequence || sequence >= _nextSequence) {
+        return false;
+    }
+
+    record = _records[sequence % _records.size()];
+    return true;
+}
+
+const char* RadioRecorder::getDirectionName(const Direction dir)
+{
+    return dir == Direction::Tx ? "tx" : "rx";
+}
+
+const char* RadioRecorder::getRadioName(const RadioType radio)
+{
+    return radio == RadioType::Nrf ? "nrf" : "cmt";
+}
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Records the raw fragments sent and received by the radios, with their
+// timestamps, into a ring buffer which keeps the most recent records. Used
+// to analyze the radio traffic, e.g., to reproduce timeouts in the field.
+class RadioRecorder {
+public:
+    enum class Direction : uint8_t {
+        Tx,
+        Rx
+    };
+
+    enum class RadioType : uint8_t {
+        Nrf,
+        Cmt
+    };
+
+    struct Record {
+        uint32_t Sequence; // incremented for every record
+        uint32_t Millis;
+        Direction Dir;
+        RadioType Radio;
+        uint8_t Channel;
+        int8_t Rssi; // only valid for received fragments
+        uint8_t Len;
+        uint8_t Data[MAX_RF_PAYLOAD_SIZE];
+    };
+
+    // allocates the buffer for the given number of records, previous
+    // records are discarded.
+    bool start(const size_t capacity);
+    void stop();
+    bool isActive() const;
+
+    void record(const Direction dir, const RadioType radio, const uint8_t channel,
+        const int8_t rssi, const uint8_t data[], const uint8_t len);
+
+    size_t getCapacity() const;
+
+    // range of sequence numbers of the records currently available
+    uint32_t getFirstSequence() const;
+    uint32_t getNextSequence() const;
+
+    // returns false if the record was overwritten or does not exist yet
+    bool get(const uint32_t sequence, Record& record) const;
+
+    static const char* getDirectionName(const Direction dir);
+    static const char* getRadioName(const RadioType radio);
+
+private:
+    mutable std::mutex _mutex;
+    std::vector<Record> _records;
+    uint32_t _nextSequence = 0;
+    uint32_t _firstSequence = 0;
+    bool _active = false;
+};
@@ -49,12 +49,6 @@ String ActivePowerControlCommand::getCommandName() const
     return buffer;
 }
 
-bool ActivePowerControlCommand::areSameParameter(CommandAbstract* other)
-{
-    return CommandAbstract::areSameParameter(other)
-        && this->getType() == static_cast<ActivePowerControlCommand*>(other)->getType();
-}
-
 void ActivePowerControlCommand::setActivePowerLimit(const float limit, const PowerLimitControlType type)
 {
     const uint16_t l = limit * 10;
@@ -87,6 +81,7 @@ bool ActivePowerControlCommand::handleResponse(const fragment_t fragment[], cons
         }
     }
     _inv->SystemConfigPara()->setLastUpdateCommand(millis());
+    _inv->SystemConfigPara()->setLastLimitCommandTimings({ getEnqueueMillis(), getFirstTxMillis(), millis() });
     std::shared_ptr<ActivePowerControlCommand> cmd(std::shared_ptr<ActivePowerControlCommand>(), this);
     if (_inv->getRadio()->countSimilarCommands(cmd) == 1) {
         _inv->SystemConfigPara()->setLastLimitCommandSuccess(CMD_OK);
@@ -16,7 +16,6 @@ public:
 
     virtual String getCommandName() const;
     virtual QueueInsertType getQueueInsertType() const { return QueueInsertType::RemoveOldest; }
-    virtual bool areSameParameter(CommandAbstract* other);
 
     virtual bool handleResponse(const fragment_t fragment[], const uint8_t max_fragment_id);
     virtual void gotTimeout();
@@ -24,4 +23,7 @@ public:
     void setActivePowerLimit(const float limit, const PowerLimitControlType type = RelativNonPersistent);
     float getLimit() const;
     PowerLimitControlType getType() const;
+
+protected:
+    virtual uint32_t getParameterKey() const { return getType(); }
 };
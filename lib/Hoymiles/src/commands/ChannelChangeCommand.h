@@ -18,4 +18,7 @@ public:
     virtual bool handleResponse(const fragment_t fragment[], const uint8_t max_fragment_id);
 
     virtual uint8_t getMaxResendCount();
+
+    // Has to be sent before any other command can reach the inverter
+    virtual CommandPriority getPriority() const { return CommandPriority::Control; }
 };
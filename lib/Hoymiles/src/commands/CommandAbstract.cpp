@@ -31,7 +31,10 @@ Source Address: 80 12 23 04
 #include <string.h>
 #include "../inverters/InverterAbstract.h"
 
+std::atomic<uint32_t> CommandAbstract::_lastId(0);
+
 CommandAbstract::CommandAbstract(InverterAbstract* inv, const uint64_t router_address)
+    : _id(++_lastId)
 {
     memset(_payload, 0, RF_LEN);
     _payload_size = 0;
@@ -110,6 +113,26 @@ uint8_t CommandAbstract::incrementSendCount()
     return _sendCount++;
 }
 
+void CommandAbstract::setEnqueueMillis(const uint32_t ms)
+{
+    _enqueueMillis = ms;
+}
+
+uint32_t CommandAbstract::getEnqueueMillis() const
+{
+    return _enqueueMillis;
+}
+
+void CommandAbstract::setFirstTxMillis(const uint32_t ms)
+{
+    _firstTxMillis = ms;
+}
+
+uint32_t CommandAbstract::getFirstTxMillis() const
+{
+    return _firstTxMillis;
+}
+
 CommandAbstract* CommandAbstract::getRequestFrameCommand(const uint8_t frame_no)
 {
     return nullptr;
@@ -141,6 +164,25 @@ uint8_t CommandAbstract::getMaxRetransmitCount() const
 
 bool CommandAbstract::areSameParameter(CommandAbstract* other)
 {
-    return this->getCommandName() == other->getCommandName()
+    return this->getSimilarityKey() == other->getSimilarityKey()
         && this->_targetAddress == other->getTargetAddress();
 }
+
+uint32_t CommandAbstract::getTypeKey()
+{
+    if (_typeKey == 0) {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        const String name = getCommandName();
+        for (size_t i = 0; i < name.length(); i++) {
+            hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619;
+        }
+        _typeKey = hash != 0 ? hash : 1;
+    }
+    return _typeKey;
+}
+
+uint32_t CommandAbstract::getSimilarityKey()
+{
+    return getTypeKey() ^ (getParameterKey() * 2654435761u);
+}
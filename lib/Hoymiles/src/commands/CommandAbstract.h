@@ -3,6 +3,7 @@
 
 #include "types.h"
 #include <Stream.h>
+#include <atomic>
 #include <cstdint>
 
 #define RF_LEN 32
@@ -23,6 +24,33 @@ enum class QueueInsertType {
     ReplaceExistent,
 };
 
+enum class CommandPriority : uint8_t {
+    // Commands which change the behavior of the inverter (limit, power on/off, restart)
+    Control = 0,
+
+    // Routine polling of data
+    Telemetry,
+};
+
+enum class CommandResult : uint8_t {
+    Ok = 0,
+    Timeout, // the inverter did not answer (completely)
+    Nok, // the inverter's answer could not be handled
+    Dropped, // a similar command was already waiting in the queue
+};
+
+// describes how a control command ended, see HoymilesClass::onCommandCompletion()
+struct CommandCompletion {
+    uint32_t Id;
+    uint64_t Serial;
+    String Command;
+    CommandResult Result;
+    uint32_t EnqueueMillis;
+    uint32_t FirstTxMillis; // zero if never sent
+    uint32_t CompletionMillis;
+    uint8_t SendCount; // the first transmission plus all resends
+};
+
 class CommandAbstract {
 public:
     explicit CommandAbstract(InverterAbstract* inv, const uint64_t router_address = 0);
@@ -43,10 +71,20 @@ public:
 
     virtual String getCommandName() const = 0;
 
+    // unique for the runtime of the firmware, never zero
+    uint32_t getId() const { return _id; }
+
     void setSendCount(const uint8_t count);
     uint8_t getSendCount() const;
     uint8_t incrementSendCount();
 
+    // Timestamps (millis) when the command was put into the queue and when
+    // it was transmitted for the first time. Zero if not (yet) happened.
+    void setEnqueueMillis(const uint32_t ms);
+    uint32_t getEnqueueMillis() const;
+    void setFirstTxMillis(const uint32_t ms);
+    uint32_t getFirstTxMillis() const;
+
     virtual CommandAbstract* getRequestFrameCommand(const uint8_t frame_no);
 
     virtual bool handleResponse(const fragment_t fragment[], const uint8_t max_fragment_id) = 0;
@@ -60,13 +98,28 @@ public:
 
     // Returns whether multiple instances of this command are allowed in the command queue.
     virtual QueueInsertType getQueueInsertType() const { return QueueInsertType::RemoveNewest; }
-    virtual bool areSameParameter(CommandAbstract* other);
+    bool areSameParameter(CommandAbstract* other);
+
+    // Hash of the command name, calculated once per command
+    uint32_t getTypeKey();
+
+    // Commands for the same inverter with the same similarity key are
+    // treated as duplicates by the command queue.
+    uint32_t getSimilarityKey();
+
+    // Commands of a higher priority class are sent before commands of a lower one
+    virtual CommandPriority getPriority() const { return CommandPriority::Telemetry; }
 
 protected:
+    // Distinguishes commands of the same type which must not replace each other
+    virtual uint32_t getParameterKey() const { return 0; }
+
     uint8_t _payload[RF_LEN];
     uint8_t _payload_size;
     uint32_t _timeout;
     uint8_t _sendCount;
+    uint32_t _enqueueMillis = 0;
+    uint32_t _firstTxMillis = 0;
 
     uint64_t _targetAddress;
     uint64_t _routerAddress;
@@ -74,6 +127,10 @@ protected:
     InverterAbstract* _inv;
 
 private:
+    uint32_t _id;
+    uint32_t _typeKey = 0;
+    static std::atomic<uint32_t> _lastId;
+
     void setTargetAddress(const uint64_t address);
     static void convertSerialToPacketId(uint8_t buffer[], const uint64_t serial);
 };
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "CommandAbstract.h"
+#include <array>
+#include <memory>
+#include <mutex>
+
+// Keeps the commands created for an inverter, such that routine polling
+// reuses them instead of allocating new ones every cycle. A command is
+// recycled once neither the queue nor the radio holds it anymore, i.e.,
+// after it was handled, timed out or was dropped.
+class CommandPool {
+public:
+    template <typename T>
+    std::shared_ptr<T> acquire(InverterAbstract* inv)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        Entry* unused = nullptr;
+        for (auto& entry : _entries) {
+            if (entry.Key == nullptr) {
+                if (unused == nullptr) {
+                    unused = &entry;
+                }
+                continue;
+            }
+
+            if (entry.Key != getKey<T>() || entry.Command.use_count() != 1) {
+                continue;
+            }
+
+            // the pool holds the only reference, so nobody else accesses it
+            auto cmd = std::static_pointer_cast<T>(entry.Command);
+            *cmd = T(inv);
+            return cmd;
+        }
+
+        auto cmd = std::make_shared<T>(inv);
+        if (unused != nullptr) {
+            unused->Key = getKey<T>();
+            unused->Command = cmd;
+        }
+        return cmd;
+    }
+
+private:
+    // an address unique per command type, without relying on RTTI
+    template <typename T>
+    static const void* getKey()
+    {
+        static const char key = 0;
+        return &key;
+    }
+
+    struct Entry {
+        const void* Key = nullptr;
+        std::shared_ptr<CommandAbstract> Command;
+    };
+
+    // enough for every command type plus a few waiting in the queue twice
+    static constexpr size_t _size = 12;
+
+    std::mutex _mutex;
+    std::array<Entry, _size> _entries;
+};
@@ -54,15 +54,7 @@ bool RealTimeRunDataCommand::handleResponse(const fragment_t fragment[], const u
         return false;
     }
 
-    // Move all fragments into target buffer
-    uint8_t offs = 0;
-    _inv->Statistics()->beginAppendFragment();
-    _inv->Statistics()->clearBuffer();
-    for (uint8_t i = 0; i < max_fragment_id; i++) {
-        _inv->Statistics()->appendFragment(offs, fragment[i].fragment, fragment[i].len);
-        offs += (fragment[i].len);
-    }
-    _inv->Statistics()->endAppendFragment();
+    _inv->Statistics()->decodeFragments(fragment, max_fragment_id);
     _inv->Statistics()->resetRxFailureCount();
     _inv->Statistics()->setLastUpdate(millis());
     return true;
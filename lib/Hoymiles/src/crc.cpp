@@ -3,15 +3,69 @@
  * Copyright (C) 2022 Thomas Basler and others
  */
 #include "crc.h"
+#include <array>
+#include <esp_attr.h>
 
-uint8_t crc8(const uint8_t buf[], const uint8_t len)
+namespace {
+
+// the lookup tables are generated at compile time and kept in DRAM, as
+// accessing flash is slow if the cache was evicted, e.g., by a flash write.
+constexpr std::array<uint8_t, 256> makeCrc8Table()
 {
-    uint8_t crc = CRC8_INIT;
-    for (uint8_t i = 0; i < len; i++) {
-        crc ^= buf[i];
+    std::array<uint8_t, 256> table = {};
+    for (uint16_t i = 0; i < 256; i++) {
+        uint8_t crc = i;
         for (uint8_t b = 0; b < 8; b++) {
             crc = (crc << 1) ^ ((crc & 0x80) ? CRC8_POLY : 0x00);
         }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 256> makeCrc16ModbusTable()
+{
+    std::array<uint16_t, 256> table = {};
+    for (uint16_t i = 0; i < 256; i++) {
+        uint16_t crc = i;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x0001) ? ((crc >> 1) ^ CRC16_MODBUS_POLYNOM) : (crc >> 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 256> makeCrc16Nrf24Table()
+{
+    std::array<uint16_t, 256> table = {};
+    for (uint16_t i = 0; i < 256; i++) {
+        uint16_t crc = i << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ CRC16_NRF24_POLYNOM) : (crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+DRAM_ATTR constexpr std::array<uint8_t, 256> crc8Table = makeCrc8Table();
+DRAM_ATTR constexpr std::array<uint16_t, 256> crc16ModbusTable = makeCrc16ModbusTable();
+DRAM_ATTR constexpr std::array<uint16_t, 256> crc16Nrf24Table = makeCrc16Nrf24Table();
+
+uint16_t crc16nrf24Bit(uint16_t crc, const uint8_t val, const uint8_t idx)
+{
+    crc ^= 0x8000 & (val << (8 + idx));
+    return (crc & 0x8000) ? ((crc << 1) ^ CRC16_NRF24_POLYNOM) : (crc << 1);
+}
+
+} // namespace
+
+uint8_t crc8(const uint8_t buf[], const uint8_t len)
+{
+    uint8_t crc = CRC8_INIT;
+    for (uint8_t i = 0; i < len; i++) {
+        crc = crc8Table[crc ^ buf[i]];
     }
     return crc;
 }
@@ -19,16 +73,8 @@ uint8_t crc8(const uint8_t buf[], const uint8_t len)
 uint16_t crc16(const uint8_t buf[], const uint8_t len, const uint16_t start)
 {
     uint16_t crc = start;
-    uint8_t shift = 0;
-
     for (uint8_t i = 0; i < len; i++) {
-        crc = crc ^ buf[i];
-        for (uint8_t bit = 0; bit < 8; bit++) {
-            shift = (crc & 0x0001);
-            crc = crc >> 1;
-            if (shift != 0)
-                crc = crc ^ 0xA001;
-        }
+        crc = (crc >> 8) ^ crc16ModbusTable[(crc ^ buf[i]) & 0xff];
     }
     return crc;
 }
@@ -36,15 +82,22 @@ uint16_t crc16(const uint8_t buf[], const uint8_t len, const uint16_t start)
 uint16_t crc16nrf24(const uint8_t buf[], const uint16_t lenBits, const uint16_t startBit, const uint16_t crcIn)
 {
     uint16_t crc = crcIn;
-    uint8_t idx, val = buf[(startBit >> 3)];
+    uint16_t bit = startBit;
 
-    for (uint16_t bit = startBit; bit < lenBits; bit++) {
-        idx = bit & 0x07;
-        if (0 == idx)
-            val = buf[(bit >> 3)];
-        crc ^= 0x8000 & (val << (8 + idx));
-        crc = (crc & 0x8000) ? ((crc << 1) ^ CRC16_NRF24_POLYNOM) : (crc << 1);
+    // leading bits up to the next byte boundary
+    for (; bit < lenBits && (bit & 0x07) != 0; bit++) {
+        crc = crc16nrf24Bit(crc, buf[bit >> 3], bit & 0x07);
+    }
+
+    // whole bytes
+    for (; bit + 8 <= lenBits; bit += 8) {
+        crc = (crc << 8) ^ crc16Nrf24Table[(crc >> 8) ^ buf[bit >> 3]];
+    }
+
+    // trailing bits
+    for (; bit < lenBits; bit++) {
+        crc = crc16nrf24Bit(crc, buf[bit >> 3], bit & 0x07);
     }
 
     return crc;
-}
\ No newline at end of file
+}
@@ -5,7 +5,7 @@
  */
 #include "HERF_1CH.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 6, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 10, 2, 10, false, 1 },
@@ -29,12 +29,14 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
-static const channelMetaData_t channelMetaData[] = {
+static constexpr channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A }
 };
 
+static constexpr inverterDescriptor_t descriptor = makeInverterDescriptor(byteAssignment, channelMetaData);
+
 HERF_1CH::HERF_1CH(HoymilesRadio* radio, const uint64_t serial)
-    : HM_Abstract(radio, serial)
+    : HM_Abstract(radio, serial, descriptor)
 {
 }
 
@@ -49,23 +51,3 @@ String HERF_1CH::typeName() const
 {
     return "HERF-300-1T";
 }
-
-const byteAssign_t* HERF_1CH::getByteAssignment() const
-{
-    return byteAssignment;
-}
-
-uint8_t HERF_1CH::getByteAssignmentSize() const
-{
-    return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
-}
-
-const channelMetaData_t* HERF_1CH::getChannelMetaData() const
-{
-    return channelMetaData;
-}
-
-uint8_t HERF_1CH::getChannelMetaDataSize() const
-{
-    return sizeof(channelMetaData) / sizeof(channelMetaData[0]);
-}
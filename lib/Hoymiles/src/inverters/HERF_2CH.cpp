@@ -5,7 +5,7 @@
  */
 #include "HERF_2CH.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 6, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 10, 2, 10, false, 1 },
@@ -36,13 +36,15 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
-static const channelMetaData_t channelMetaData[] = {
+static constexpr channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A },
     { CH1, MPPT_B }
 };
 
+static constexpr inverterDescriptor_t descriptor = makeInverterDescriptor(byteAssignment, channelMetaData);
+
 HERF_2CH::HERF_2CH(HoymilesRadio* radio, const uint64_t serial)
-    : HM_Abstract(radio, serial)
+    : HM_Abstract(radio, serial, descriptor)
 {
 }
 
@@ -57,23 +59,3 @@ String HERF_2CH::typeName() const
 {
     return "HERF-600/800-2T";
 }
-
-const byteAssign_t* HERF_2CH::getByteAssignment() const
-{
-    return byteAssignment;
-}
-
-uint8_t HERF_2CH::getByteAssignmentSize() const
-{
-    return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
-}
-
-const channelMetaData_t* HERF_2CH::getChannelMetaData() const
-{
-    return channelMetaData;
-}
-
-uint8_t HERF_2CH::getChannelMetaDataSize() const
-{
-    return sizeof(channelMetaData) / sizeof(channelMetaData[0]);
-}
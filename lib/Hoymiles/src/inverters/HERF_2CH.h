@@ -8,8 +8,4 @@ public:
     explicit HERF_2CH(HoymilesRadio* radio, const uint64_t serial);
     static bool isValidSerial(const uint64_t serial);
     String typeName() const;
-    const byteAssign_t* getByteAssignment() const;
-    uint8_t getByteAssignmentSize() const;
-    const channelMetaData_t* getChannelMetaData() const;
-    uint8_t getChannelMetaDataSize() const;
 };
@@ -4,7 +4,7 @@
  */
 #include "HMS_1CH.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 4, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 6, 2, 10, false, 1 },
@@ -28,12 +28,14 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
-static const channelMetaData_t channelMetaData[] = {
+static constexpr channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A }
 };
 
+static constexpr inverterDescriptor_t descriptor = makeInverterDescriptor(byteAssignment, channelMetaData);
+
 HMS_1CH::HMS_1CH(HoymilesRadio* radio, const uint64_t serial)
-    : HMS_Abstract(radio, serial)
+    : HMS_Abstract(radio, serial, descriptor)
 {
 }
 
@@ -48,23 +50,3 @@ String HMS_1CH::typeName() const
 {
     return "HMS-300/350/400/450/500-1T";
 }
-
-const byteAssign_t* HMS_1CH::getByteAssignment() const
-{
-    return byteAssignment;
-}
-
-uint8_t HMS_1CH::getByteAssignmentSize() const
-{
-    return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
-}
-
-const channelMetaData_t* HMS_1CH::getChannelMetaData() const
-{
-    return channelMetaData;
-}
-
-uint8_t HMS_1CH::getChannelMetaDataSize() const
-{
-    return sizeof(channelMetaData) / sizeof(channelMetaData[0]);
-}
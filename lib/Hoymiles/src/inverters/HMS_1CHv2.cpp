@@ -4,7 +4,7 @@
  */
 #include "HMS_1CHv2.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 6, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 10, 2, 10, false, 1 },
@@ -28,12 +28,14 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
-static const channelMetaData_t channelMetaData[] = {
+static constexpr channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A }
 };
 
+static constexpr inverterDescriptor_t descriptor = makeInverterDescriptor(byteAssignment, channelMetaData);
+
 HMS_1CHv2::HMS_1CHv2(HoymilesRadio* radio, const uint64_t serial)
-    : HMS_Abstract(radio, serial)
+    : HMS_Abstract(radio, serial, descriptor)
 {
 }
 
@@ -48,23 +50,3 @@ String HMS_1CHv2::typeName() const
 {
     return "HMS-450/500-1T v2";
 }
-
-const byteAssign_t* HMS_1CHv2::getByteAssignment() const
-{
-    return byteAssignment;
-}
-
-uint8_t HMS_1CHv2::getByteAssignmentSize() const
-{
-    return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
-}
-
-const channelMetaData_t* HMS_1CHv2::getChannelMetaData() const
-{
-    return channelMetaData;
-}
-
-uint8_t HMS_1CHv2::getChannelMetaDataSize() const
-{
-    return sizeof(channelMetaData) / sizeof(channelMetaData[0]);
-}
@@ -4,7 +4,7 @@
  */
 #include "HMS_2CH.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 6, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 10, 2, 10, false, 1 },
@@ -35,13 +35,15 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
-static const channelMetaData_t channelMetaData[] = {
+static constexpr channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A },
     { CH1, MPPT_B }
 };
 
+static constexpr inverterDescriptor_t descriptor = makeInverterDescriptor(byteAssignment, channelMetaData);
+
 HMS_2CH::HMS_2CH(HoymilesRadio* radio, const uint64_t serial)
-    : HMS_Abstract(radio, serial)
+    : HMS_Abstract(radio, serial, descriptor)
 {
 }
 
@@ -56,23 +58,3 @@ String HMS_2CH::typeName() const
 {
     return "HMS-600/700/800/900/1000-2T";
 }
-
-const byteAssign_t* HMS_2CH::getByteAssignment() const
-{
-    return byteAssignment;
-}
-
-uint8_t HMS_2CH::getByteAssignmentSize() const
-{
-    return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
-}
-
-const channelMetaData_t* HMS_2CH::getChannelMetaData() const
-{
-    return channelMetaData;
-}
-
-uint8_t HMS_2CH::getChannelMetaDataSize() const
-{
-    return sizeof(channelMetaData) / sizeof(channelMetaData[0]);
-}
@@ -4,7 +4,7 @@
  */
 #include "HMS_4CH.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 6, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 10, 2, 10, false, 1 },
@@ -49,15 +49,17 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
-static const channelMetaData_t channelMetaData[] = {
+static constexpr channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A },
     { CH1, MPPT_B },
     { CH2, MPPT_C },
     { CH3, MPPT_D }
 };
 
+static constexpr inverterDescriptor_t descriptor = makeInverterDescriptor(byteAssignment, channelMetaData);
+
 HMS_4CH::HMS_4CH(HoymilesRadio* radio, const uint64_t serial)
-    : HMS_Abstract(radio, serial)
+    : HMS_Abstract(radio, serial, descriptor)
 {
 }
 
@@ -73,29 +75,9 @@ String HMS_4CH::typeName() const
     return "HMS-1600/1800/2000-4T";
 }
 
-const byteAssign_t* HMS_4CH::getByteAssignment() const
-{
-    return byteAssignment;
-}
-
-uint8_t HMS_4CH::getByteAssignmentSize() const
-{
-    return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
-}
-
 bool HMS_4CH::supportsPowerDistributionLogic()
 {
     // This feature was added in inverter firmware version 01.01.12 and
     // will limit the AC output instead of limiting the DC inputs.
     return DevInfo()->getFwBuildVersion() >= 10112U;
 }
-
-const channelMetaData_t* HMS_4CH::getChannelMetaData() const
-{
-    return channelMetaData;
-}
-
-uint8_t HMS_4CH::getChannelMetaDataSize() const
-{
-    return sizeof(channelMetaData) / sizeof(channelMetaData[0]);
-}
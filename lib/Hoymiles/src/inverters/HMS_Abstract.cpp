@@ -7,8 +7,8 @@
 #include "HoymilesRadio_CMT.h"
 #include "commands/ChannelChangeCommand.h"
 
-HMS_Abstract::HMS_Abstract(HoymilesRadio* radio, const uint64_t serial)
-    : HM_Abstract(radio, serial)
+HMS_Abstract::HMS_Abstract(HoymilesRadio* radio, const uint64_t serial, const inverterDescriptor_t& descriptor)
+    : HM_Abstract(radio, serial, descriptor)
 {
 }
 
@@ -18,6 +18,10 @@ bool HMS_Abstract::sendChangeChannelRequest()
         return false;
     }
 
+    if (!Hoymiles.getRadioCmt()->isChannelChangeDue(*this)) {
+        return false;
+    }
+
     auto cmdChannel = _radio->prepareCommand<ChannelChangeCommand>(this);
     cmdChannel->setCountryMode(Hoymiles.getRadioCmt()->getCountryMode());
     cmdChannel->setChannel(Hoymiles.getRadioCmt()->getChannelFromFrequency(Hoymiles.getRadioCmt()->getInverterTargetFrequency()));
@@ -5,7 +5,7 @@
 
 class HMS_Abstract : public HM_Abstract {
 public:
-    explicit HMS_Abstract(HoymilesRadio* radio, const uint64_t serial);
+    explicit HMS_Abstract(HoymilesRadio* radio, const uint64_t serial, const inverterDescriptor_t& descriptor);
 
     virtual bool sendChangeChannelRequest();
 };
\ No newline at end of file
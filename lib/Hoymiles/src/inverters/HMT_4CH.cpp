@@ -4,7 +4,7 @@
  */
 #include "HMT_4CH.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 4, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 8, 2, 10, false, 1 },
@@ -58,15 +58,17 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
-static const channelMetaData_t channelMetaData[] = {
+static constexpr channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A },
     { CH1, MPPT_A },
     { CH2, MPPT_B },
     { CH3, MPPT_B }
 };
 
+static constexpr inverterDescriptor_t descriptor = makeInverterDescriptor(byteAssignment, channelMetaData);
+
 HMT_4CH::HMT_4CH(HoymilesRadio* radio, const uint64_t serial)
-    : HMT_Abstract(radio, serial)
+    : HMT_Abstract(radio, serial, descriptor)
 {
 }
 
@@ -81,23 +83,3 @@ String HMT_4CH::typeName() const
 {
     return "HMT-1600/1800/2000-4T";
 }
-
-const byteAssign_t* HMT_4CH::getByteAssignment() const
-{
-    return byteAssignment;
-}
-
-uint8_t HMT_4CH::getByteAssignmentSize() const
-{
-    return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
-}
-
-const channelMetaData_t* HMT_4CH::getChannelMetaData() const
-{
-    return channelMetaData;
-}
-
-uint8_t HMT_4CH::getChannelMetaDataSize() const
-{
-    return sizeof(channelMetaData) / sizeof(channelMetaData[0]);
-}
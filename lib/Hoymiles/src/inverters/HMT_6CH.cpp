@@ -4,7 +4,7 @@
  */
 #include "HMT_6CH.h"
 
-static const byteAssign_t byteAssignment[] = {
+static constexpr byteAssign_t byteAssignment[] = {
     { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
     { TYPE_DC, CH0, FLD_IDC, UNIT_A, 4, 2, 100, false, 2 },
     { TYPE_DC, CH0, FLD_PDC, UNIT_W, 8, 2, 10, false, 1 },
@@ -72,7 +72,7 @@ static const byteAssign_t byteAssignment[] = {
     { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
 };
 
-static const channelMetaData_t channelMetaData[] = {
+static constexpr channelMetaData_t channelMetaData[] = {
     { CH0, MPPT_A },
     { CH1, MPPT_A },
     { CH2, MPPT_B },
@@ -81,8 +81,10 @@ static const channelMetaData_t channelMetaData[] = {
     { CH5, MPPT_C }
 };
 
+static constexpr inverterDescriptor_t descriptor = makeInverterDescriptor(byteAssignment, channelMetaData);
+
 HMT_6CH::HMT_6CH(HoymilesRadio* radio, const uint64_t serial)
-    : HMT_Abstract(radio, serial)
+    : HMT_Abstract(radio, serial, descriptor)
 {
 }
 
@@ -97,23 +99,3 @@ String HMT_6CH::typeName() const
 {
     return "HMT-1800/2250-6T";
 }
-
-const byteAssign_t* HMT_6CH::getByteAssignment() const
-{
-    return byteAssignment;
-}
-
-uint8_t HMT_6CH::getByteAssignmentSize() const
-{
-    return sizeof(byteAssignment) / sizeof(byteAssignment[0]);
-}
-
-const channelMetaData_t* HMT_6CH::getChannelMetaData() const
-{
-    return channelMetaData;
-}
-
-uint8_t HMT_6CH::getChannelMetaDataSize() const
-{
-    return sizeof(channelMetaData) / sizeof(channelMetaData[0]);
-}
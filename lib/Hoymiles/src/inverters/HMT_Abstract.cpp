@@ -8,8 +8,8 @@
 #include "commands/ChannelChangeCommand.h"
 #include "parser/AlarmLogParser.h"
 
-HMT_Abstract::HMT_Abstract(HoymilesRadio* radio, const uint64_t serial)
-    : HM_Abstract(radio, serial)
+HMT_Abstract::HMT_Abstract(HoymilesRadio* radio, const uint64_t serial, const inverterDescriptor_t& descriptor)
+    : HM_Abstract(radio, serial, descriptor)
 {
     EventLog()->setMessageType(AlarmMessageType_t::HMT);
 }
@@ -20,6 +20,10 @@ bool HMT_Abstract::sendChangeChannelRequest()
         return false;
     }
 
+    if (!Hoymiles.getRadioCmt()->isChannelChangeDue(*this)) {
+        return false;
+    }
+
     auto cmdChannel = _radio->prepareCommand<ChannelChangeCommand>(this);
     cmdChannel->setCountryMode(Hoymiles.getRadioCmt()->getCountryMode());
     cmdChannel->setChannel(Hoymiles.getRadioCmt()->getChannelFromFrequency(Hoymiles.getRadioCmt()->getInverterTargetFrequency()));
@@ -5,7 +5,7 @@
 
 class HMT_Abstract : public HM_Abstract {
 public:
-    explicit HMT_Abstract(HoymilesRadio* radio, const uint64_t serial);
+    explicit HMT_Abstract(HoymilesRadio* radio, const uint64_t serial, const inverterDescriptor_t& descriptor);
 
     virtual bool sendChangeChannelRequest();
 };
\ No newline at end of file
@@ -13,8 +13,8 @@
 #include "commands/RealTimeRunDataCommand.h"
 #include "commands/SystemConfigParaCommand.h"
 
-HM_Abstract::HM_Abstract(HoymilesRadio* radio, const uint64_t serial)
-    : InverterAbstract(radio, serial)
+HM_Abstract::HM_Abstract(HoymilesRadio* radio, const uint64_t serial, const inverterDescriptor_t& descriptor)
+    : InverterAbstract(radio, serial, descriptor)
 {
 }
 
@@ -139,6 +139,7 @@ bool HM_Abstract::sendActivePowerControlRequest(float limit, const PowerLimitCon
     cmd->setActivePowerLimit(limit, type);
     SystemConfigPara()->setLastLimitCommandSuccess(CMD_PENDING);
     _radio->enqueCommand(cmd);
+    _lastControlCommandId = cmd->getId();
 
     return true;
 }
@@ -168,6 +169,7 @@ bool HM_Abstract::sendPowerControlRequest(const bool turnOn)
     cmd->setPowerOn(turnOn);
     PowerCommand()->setLastPowerCommandSuccess(CMD_PENDING);
     _radio->enqueCommand(cmd);
+    _lastControlCommandId = cmd->getId();
 
     return true;
 }
@@ -184,6 +186,7 @@ bool HM_Abstract::sendRestartControlRequest()
     cmd->setRestart();
     PowerCommand()->setLastPowerCommandSuccess(CMD_PENDING);
     _radio->enqueCommand(cmd);
+    _lastControlCommandId = cmd->getId();
 
     return true;
 }
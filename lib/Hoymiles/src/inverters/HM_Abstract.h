@@ -5,7 +5,7 @@
 
 class HM_Abstract : public InverterAbstract {
 public:
-    explicit HM_Abstract(HoymilesRadio* radio, const uint64_t serial);
+    explicit HM_Abstract(HoymilesRadio* radio, const uint64_t serial, const inverterDescriptor_t& descriptor);
     bool sendStatsRequest();
     bool sendAlarmLogRequest(const bool force = false);
     bool sendDevInfoRequest();
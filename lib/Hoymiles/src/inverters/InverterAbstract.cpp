@@ -5,9 +5,12 @@
 #include "InverterAbstract.h"
 #include "../Hoymiles.h"
 #include "crc.h"
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 
-InverterAbstract::InverterAbstract(HoymilesRadio* radio, const uint64_t serial)
+InverterAbstract::InverterAbstract(HoymilesRadio* radio, const uint64_t serial, const inverterDescriptor_t& descriptor)
+    : _descriptor(descriptor)
 {
     _serial.u64 = serial;
     _radio = radio;
@@ -28,11 +31,8 @@ InverterAbstract::InverterAbstract(HoymilesRadio* radio, const uint64_t serial)
 
 void InverterAbstract::init()
 {
-    // This has to be done here because:
-    // Not possible in constructor --> virtual function
-    // Not possible in verifyAllFragments --> Because no data if nothing is ever received
     // It has to be executed because otherwise the getChannelCount method in stats always returns 0
-    _statisticsParser.get()->setByteAssignment(getByteAssignment(), getByteAssignmentSize());
+    _statisticsParser.get()->setLayout(&_descriptor.statistics);
 }
 
 uint64_t InverterAbstract::serial() const
@@ -77,6 +77,84 @@ bool InverterAbstract::isReachable()
     return _enablePolling && Statistics()->getRxFailureCount() <= _reachableThreshold;
 }
 
+PollDemand InverterAbstract::getPollDemand()
+{
+    if (Statistics()->getLastUpdate() == 0) {
+        return PollDemand::High;
+    }
+
+    // pending or failed commands are (re-)sent as part of the poll cycle
+    if (SystemConfigPara()->getLastLimitCommandSuccess() != CMD_OK
+        || PowerCommand()->getLastPowerCommandSuccess() != CMD_OK) {
+        return PollDemand::High;
+    }
+
+    const uint32_t lastCommand = SystemConfigPara()->getLastUpdateCommand();
+    if (lastCommand > 0 && millis() - lastCommand < POLL_DEMAND_CONTROL_DURATION) {
+        return PollDemand::High;
+    }
+
+    if (Statistics()->getAcPowerSpread() > POLL_DEMAND_AC_POWER_SPREAD) {
+        return PollDemand::High;
+    }
+
+    if (!isProducing()) {
+        return PollDemand::Low;
+    }
+
+    return PollDemand::Normal;
+}
+
+bool InverterAbstract::isLimitReadbackRequired()
+{
+    if (!isReachable()) {
+        _lastUnreachable = millis();
+        return true;
+    }
+
+    const SystemConfigParaParser& para = *SystemConfigPara();
+    if (para.getLastLimitRequestSuccess() != CMD_OK || para.getLastLimitCommandSuccess() != CMD_OK) {
+        return true;
+    }
+
+    const uint32_t lastCommand = para.getLastUpdateCommand();
+    if (lastCommand == 0) {
+        return true;
+    }
+
+    // a restart reverts a non-persistent limit, the inverter is not
+    // reachable in the meantime
+    if (_lastUnreachable > 0 && _lastUnreachable - lastCommand < UINT32_MAX / 2) {
+        return true;
+    }
+
+    const uint16_t maxPower = DevInfo()->getMaxPower();
+    if (maxPower == 0) {
+        return true;
+    }
+
+    float totalAc = 0;
+    for (auto& c : Statistics()->getChannelsByType(TYPE_AC)) {
+        if (Statistics()->hasChannelFieldValue(TYPE_AC, c, FLD_PAC)) {
+            totalAc += Statistics()->getChannelFieldValue(TYPE_AC, c, FLD_PAC);
+        }
+    }
+
+    // producing less than the limit allows is expected, e.g., in low light
+    const float limit = para.getLimitPercent() * maxPower / 100;
+    return totalAc > limit * 1.1f + LIMIT_READBACK_TOLERANCE;
+}
+
+void InverterAbstract::setLastPoll(const uint32_t lastPoll)
+{
+    _lastPoll = lastPoll;
+}
+
+uint32_t InverterAbstract::getLastPoll() const
+{
+    return _lastPoll;
+}
+
 void InverterAbstract::setEnablePolling(const bool enabled)
 {
     _enablePolling = enabled;
@@ -152,6 +230,11 @@ HoymilesRadio* InverterAbstract::getRadio()
     return _radio;
 }
 
+void InverterAbstract::setRadio(HoymilesRadio* radio)
+{
+    _radio = radio;
+}
+
 AlarmLogParser* InverterAbstract::EventLog()
 {
     return _alarmLogParser.get();
@@ -193,6 +276,7 @@ void InverterAbstract::clearRxFragmentBuffer()
 void InverterAbstract::addRxFragment(const uint8_t fragment[], const uint8_t len, const int8_t rssi)
 {
     _lastRssi = rssi;
+    _lastRxFragmentMillis = millis();
 
     if (len < 11) {
         Hoymiles.getMessageOutput()->printf("FATAL: (%s, %d) fragment too short\r\n", __FILE__, __LINE__);
@@ -299,34 +383,190 @@ void InverterAbstract::resetRadioStats()
     RadioStats = {};
 }
 
+void InverterAbstract::countRxChannelFragment(const uint8_t channel)
+{
+    auto& channels = RadioStats.RxChannels;
+
+    uint8_t i = 0;
+    while (i < RadioStats.RxChannelCount && channels[i].Channel != channel) {
+        i++;
+    }
+
+    if (i == RadioStats.RxChannelCount) {
+        if (i >= MAX_RX_CHANNEL_STATS) {
+            return;
+        }
+        channels[i] = {};
+        channels[i].Channel = channel;
+        RadioStats.RxChannelCount++;
+    }
+
+    channels[i].Fragments++;
+
+    // keep the rating following changes of the interference
+    if (channels[i].Recent == UINT8_MAX) {
+        for (uint8_t c = 0; c < RadioStats.RxChannelCount; c++) {
+            channels[c].Recent /= 2;
+        }
+    }
+    channels[i].Recent++;
+}
+
+void InverterAbstract::countResponse(const CommandAbstract& cmd)
+{
+    auto add = [this](const RadioHistogram_t histogram, const int32_t value) {
+        auto& bounds = getRadioHistogramBounds(histogram);
+        auto& stats = RadioStats.Histograms[histogram];
+
+        uint8_t bucket = 0;
+        while (bucket < bounds.size() && value > bounds[bucket]) {
+            bucket++;
+        }
+
+        stats.Buckets[bucket]++;
+        stats.Sum += value;
+    };
+
+    add(HISTOGRAM_RSSI, _lastRssi);
+    add(HISTOGRAM_FRAGMENTS, _rxFragmentMaxPacketId);
+    add(HISTOGRAM_RETRANSMITS, _rxFragmentRetransmitCnt + std::max<int32_t>(cmd.getSendCount() - 1, 0));
+    if (cmd.getFirstTxMillis() > 0) {
+        add(HISTOGRAM_LATENCY, _lastRxFragmentMillis - cmd.getFirstTxMillis());
+    }
+}
+
+const std::array<int16_t, RADIO_HISTOGRAM_BUCKETS - 1>& InverterAbstract::getRadioHistogramBounds(const RadioHistogram_t histogram)
+{
+    static const std::array<int16_t, RADIO_HISTOGRAM_BUCKETS - 1> bounds[HISTOGRAM_CNT] = {
+        { { -90, -80, -75, -70, -65, -60, -50 } },
+        { { 1, 2, 3, 4, 6, 8, 10 } },
+        { { 0, 1, 2, 3, 4, 6, 8 } },
+        { { 50, 100, 200, 300, 500, 1000, 2000 } },
+    };
+    return bounds[histogram];
+}
+
+const char* InverterAbstract::getRadioHistogramName(const RadioHistogram_t histogram)
+{
+    static const char* const names[HISTOGRAM_CNT] = { "rssi", "fragments", "retransmits", "latency" };
+    return names[histogram];
+}
+
+uint8_t InverterAbstract::getRxChannelDwell(const uint8_t channel) const
+{
+    auto const& channels = RadioStats.RxChannels;
+
+    uint16_t total = 0;
+    uint8_t best = 0;
+    uint8_t recent = 0;
+    for (uint8_t i = 0; i < RadioStats.RxChannelCount; i++) {
+        total += channels[i].Recent;
+        best = std::max(best, channels[i].Recent);
+        if (channels[i].Channel == channel) {
+            recent = channels[i].Recent;
+        }
+    }
+
+    // hop evenly until there is enough data to rate the channels
+    if (total < 32) {
+        return 1;
+    }
+
+    // every channel keeps at least one hop, such that it can recover
+    return 1 + (MAX_RX_CHANNEL_DWELL - 1) * recent / best;
+}
+
+void InverterAbstract::learnReRequestRoundTrip(const uint32_t millis)
+{
+    if (_reRequestRttSamples == 0) {
+        _reRequestRttScaled = millis * 8;
+        _reRequestRttDevScaled = millis * 2;
+        _reRequestRttSamples = 1;
+        return;
+    }
+
+    const int32_t error = static_cast<int32_t>(millis) - static_cast<int32_t>(_reRequestRttScaled / 8);
+    _reRequestRttScaled += error;
+    _reRequestRttDevScaled += std::abs(error) - static_cast<int32_t>(_reRequestRttDevScaled / 4);
+
+    if (_reRequestRttSamples < UINT8_MAX) {
+        _reRequestRttSamples++;
+    }
+}
+
+uint32_t InverterAbstract::getReRequestRxTimeout(const uint32_t commandTimeout) const
+{
+    if (_reRequestRttSamples < MIN_ROUND_TRIP_SAMPLES) {
+        return commandTimeout;
+    }
+
+    uint32_t margin = 10;
+
+    // the RSSI of the NRF is either -30 or -80 dBm
+    if (_lastRssi <= -80) {
+        margin += 10;
+    }
+
+    // more than one re-requested fragment per four requests
+    if (RadioStats.TxReRequestFragment * 4 > RadioStats.TxRequestData) {
+        margin += 10;
+    }
+
+    const uint32_t timeout = _reRequestRttScaled / 8 + _reRequestRttDevScaled + margin;
+    return std::min(std::max(timeout, MIN_RX_TIMEOUT), commandTimeout);
+}
+
+uint8_t InverterAbstract::countMissingFragments() const
+{
+    const uint8_t last = (_rxFragmentMaxPacketId > 0) ? _rxFragmentMaxPacketId : _rxFragmentLastPacketId;
+
+    uint8_t missing = (_rxFragmentMaxPacketId > 0) ? 0 : 1;
+    for (uint8_t i = 0; i < last; i++) {
+        if (!_rxFragmentBuffer[i].wasReceived) {
+            missing++;
+        }
+    }
+    return missing;
+}
+
+uint32_t InverterAbstract::getLastRxFragmentMillis() const
+{
+    return _lastRxFragmentMillis;
+}
+
 std::vector<ChannelNum_t> InverterAbstract::getChannelsDC() const
 {
     std::vector<ChannelNum_t> l;
-    for (uint8_t i = 0; i < getChannelMetaDataSize(); i++) {
-        l.push_back(getChannelMetaData()[i].ch);
+    for (uint8_t i = 0; i < _descriptor.channelMetaDataSize; i++) {
+        l.push_back(_descriptor.channelMetaData[i].ch);
     }
     return l;
 }
 
 std::vector<MpptNum_t> InverterAbstract::getMppts() const
 {
-    std::vector<MpptNum_t> l;
-    for (uint8_t i = 0; i < getChannelMetaDataSize(); i++) {
-        auto m = getChannelMetaData()[i].mppt;
-        if (l.end() == std::find(l.begin(), l.end(), m)){
-            l.push_back(m);
-        }
-    }
-    return l;
+    const auto& topology = _descriptor.channelTopology;
+    return std::vector<MpptNum_t>(topology.mppts.begin(), topology.mppts.begin() + topology.mpptCount);
 }
 
 std::vector<ChannelNum_t> InverterAbstract::getChannelsDCByMppt(const MpptNum_t mppt) const
 {
-    std::vector<ChannelNum_t> l;
-    for (uint8_t i = 0; i < getChannelMetaDataSize(); i++) {
-        if (getChannelMetaData()[i].mppt == mppt) {
-            l.push_back(getChannelMetaData()[i].ch);
+    const auto& topology = _descriptor.channelTopology;
+    for (uint8_t i = 0; i < topology.mpptCount; i++) {
+        if (topology.mppts[i] == mppt) {
+            const auto& channels = topology.mpptChannels[i];
+            return std::vector<ChannelNum_t>(channels.begin(), channels.begin() + topology.mpptChannelCount[i]);
         }
     }
-    return l;
+    return {};
+}
+
+const inverterDescriptor_t& InverterAbstract::getDescriptor() const
+{
+    return _descriptor;
+}
+
+const channelTopology_t& InverterAbstract::getChannelTopology() const
+{
+    return _descriptor.channelTopology;
 }
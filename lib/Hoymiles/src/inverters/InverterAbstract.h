@@ -11,10 +11,23 @@
 #include "HoymilesRadio.h"
 #include "types.h"
 #include <Arduino.h>
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <list>
 
 #define MAX_NAME_LENGTH 32
+#define MAX_RX_CHANNEL_STATS 5
+#define RADIO_HISTOGRAM_BUCKETS 8
+
+// Distributions of successful responses, see InverterAbstract::RadioStats
+enum RadioHistogram_t {
+    HISTOGRAM_RSSI = 0, // dBm of the last fragment
+    HISTOGRAM_FRAGMENTS, // fragments per response
+    HISTOGRAM_RETRANSMITS, // resends and fragment re-requests per response
+    HISTOGRAM_LATENCY, // ms from the first transmission to the last fragment
+    HISTOGRAM_CNT
+};
 
 enum {
     FRAGMENT_ALL_MISSING_RESEND = 255,
@@ -38,28 +51,99 @@ typedef struct {
     MpptNum_t mppt; // mppt a - d (0 - 3)
 } channelMetaData_t;
 
+// input channels grouped by MPPT, such that they can be iterated without allocations
+typedef struct {
+    uint8_t channelCount; // number of DC input channels
+    uint8_t mpptCount;
+    std::array<MpptNum_t, MPPT_CNT> mppts; // in order of first appearance
+    std::array<uint8_t, MPPT_CNT> mpptChannelCount; // per entry in mppts
+    std::array<std::array<ChannelNum_t, CH_CNT>, MPPT_CNT> mpptChannels; // per entry in mppts
+} channelTopology_t;
+
+// everything static per inverter model, generated at compile time
+typedef struct {
+    statisticsLayout_t statistics;
+    const channelMetaData_t* channelMetaData;
+    uint8_t channelMetaDataSize;
+    channelTopology_t channelTopology;
+} inverterDescriptor_t;
+
+template <size_t N, size_t M>
+constexpr inverterDescriptor_t makeInverterDescriptor(const byteAssign_t (&byteAssignment)[N], const channelMetaData_t (&channelMetaData)[M])
+{
+    static_assert(M <= CH_CNT, "too many input channels");
+
+    inverterDescriptor_t descriptor {};
+    descriptor.statistics = makeStatisticsLayout(byteAssignment);
+    descriptor.channelMetaData = channelMetaData;
+    descriptor.channelMetaDataSize = M;
+
+    auto& topology = descriptor.channelTopology;
+    for (uint8_t i = 0; i < M; i++) {
+        const channelMetaData_t& meta = channelMetaData[i];
+        topology.channelCount++;
+
+        uint8_t m = 0;
+        while (m < topology.mpptCount && topology.mppts[m] != meta.mppt) {
+            m++;
+        }
+
+        if (m == topology.mpptCount) {
+            topology.mppts[m] = meta.mppt;
+            topology.mpptCount++;
+        }
+
+        topology.mpptChannels[m][topology.mpptChannelCount[m]++] = meta.ch;
+    }
+
+    return descriptor;
+}
+
 #define MAX_RF_FRAGMENT_COUNT 13
 
+// Inverters which received a limit command within this period are polled at the highest rate
+#define POLL_DEMAND_CONTROL_DURATION (60 * 1000)
+// Inverters whose AC power changed more than this (W) within the last updates are polled at the highest rate
+#define POLL_DEMAND_AC_POWER_SPREAD 10.0f
+// The AC power (W) may exceed the acknowledged limit by this much plus 10 % before the limit is read back
+#define LIMIT_READBACK_TOLERANCE 10.0f
+
+enum class PollDemand {
+    High, // actively controlled, output is changing or no data yet
+    Normal, // stable output
+    Low, // not producing (e.g. standby at night)
+};
+
 class CommandAbstract;
 
 class InverterAbstract {
 public:
-    explicit InverterAbstract(HoymilesRadio* radio, const uint64_t serial);
+    explicit InverterAbstract(HoymilesRadio* radio, const uint64_t serial, const inverterDescriptor_t& descriptor);
     void init();
     uint64_t serial() const;
     const String& serialString() const;
     void setName(const char* name);
     const char* name() const;
     virtual String typeName() const = 0;
-    virtual const byteAssign_t* getByteAssignment() const = 0;
-    virtual uint8_t getByteAssignmentSize() const = 0;
 
-    virtual const channelMetaData_t* getChannelMetaData() const = 0;
-    virtual uint8_t getChannelMetaDataSize() const = 0;
+    const inverterDescriptor_t& getDescriptor() const;
 
     bool isProducing();
     bool isReachable();
 
+    // How urgently the inverter needs to be polled, based on recent control
+    // commands and the history of its AC power
+    PollDemand getPollDemand();
+
+    // Whether the limit needs to be read back from the inverter. It does
+    // not while the last acknowledged limit command is still in effect,
+    // i.e., the inverter was reachable ever since, hence did not restart,
+    // and its output does not exceed the limit. Must be called on every poll.
+    bool isLimitReadbackRequired();
+
+    void setLastPoll(const uint32_t lastPoll);
+    uint32_t getLastPoll() const;
+
     void setEnablePolling(const bool enabled);
     bool getEnablePolling() const;
 
@@ -106,8 +190,59 @@ public:
 
         // RX Fail Corrupt Data
         uint32_t RxFailCorruptData;
+
+        // RX Fragments dropped because the receive buffer was full
+        uint32_t RxDroppedFragments;
+
+        // RX Fragments per receive channel, in the order of first reception.
+        // Recent is halved regularly and rates the channel, see getRxChannelDwell().
+        struct {
+            uint8_t Channel;
+            uint8_t Recent;
+            uint32_t Fragments;
+        } RxChannels[MAX_RX_CHANNEL_STATS];
+        uint8_t RxChannelCount;
+
+        // Counts per bucket, see getRadioHistogramBounds(), along with the
+        // sum of all samples, i.e. the layout of a Prometheus histogram.
+        struct {
+            uint32_t Buckets[RADIO_HISTOGRAM_BUCKETS];
+            int32_t Sum;
+        } Histograms[HISTOGRAM_CNT];
     } RadioStats = {};
 
+    void countRxChannelFragment(const uint8_t channel);
+
+    // Adds the successful response to the given command to the histograms
+    void countResponse(const CommandAbstract& cmd);
+
+    // Inclusive upper bounds of the buckets of the given histogram, the
+    // last bucket holds all samples beyond the last bound
+    static const std::array<int16_t, RADIO_HISTOGRAM_BUCKETS - 1>& getRadioHistogramBounds(const RadioHistogram_t histogram);
+    static const char* getRadioHistogramName(const RadioHistogram_t histogram);
+
+    // Number of hops the radio shall listen on the given channel while
+    // waiting for this inverter, between 1 and MAX_RX_CHANNEL_DWELL.
+    // Channels which delivered most fragments recently get the most.
+    uint8_t getRxChannelDwell(const uint8_t channel) const;
+    static constexpr uint8_t MAX_RX_CHANNEL_DWELL = 4;
+
+    // Learns the time from re-requesting a fragment to receiving it. Unlike
+    // for requests, the reply is a single fragment for every command type.
+    void learnReRequestRoundTrip(const uint32_t millis);
+
+    // Time to listen for a re-requested fragment, at most the given timeout
+    // of the command. Derived from the learned round trip time and its
+    // variation, plus a margin for links with a weak signal or frequent
+    // fragment loss.
+    uint32_t getReRequestRxTimeout(const uint32_t commandTimeout) const;
+
+    // Number of fragments missing from the response received so far. If the
+    // last fragment was not received yet, it counts as one.
+    uint8_t countMissingFragments() const;
+
+    uint32_t getLastRxFragmentMillis() const;
+
     virtual bool sendStatsRequest() = 0;
     virtual bool sendAlarmLogRequest(const bool force = false) = 0;
     virtual bool sendDevInfoRequest() = 0;
@@ -123,7 +258,16 @@ public:
     // This feature will limit the AC output instead of limiting the DC inputs.
     virtual bool supportsPowerDistributionLogic() = 0;
 
+    // The id of the command enqueued by the most recent successful call of
+    // one of the send*ControlRequest() methods, see CommandAbstract::getId().
+    uint32_t getLastControlCommandId() const { return _lastControlCommandId; }
+
     HoymilesRadio* getRadio();
+    // the caller has to remove pending commands from the previous radio
+    void setRadio(HoymilesRadio* radio);
+
+    // commands created for this inverter, see HoymilesRadio::prepareCommand()
+    CommandPool& getCommandPool() { return _commandPool; }
 
     AlarmLogParser* EventLog();
     DevInfoParser* DevInfo();
@@ -135,11 +279,14 @@ public:
     std::vector<MpptNum_t> getMppts() const;
     std::vector<ChannelNum_t> getChannelsDC() const;
     std::vector<ChannelNum_t> getChannelsDCByMppt(const MpptNum_t mppt) const;
+    const channelTopology_t& getChannelTopology() const;
 
 protected:
     HoymilesRadio* _radio;
+    std::atomic<uint32_t> _lastControlCommandId = 0;
 
 private:
+    const inverterDescriptor_t& _descriptor;
     serial_u _serial;
     String _serialString;
     char _name[MAX_NAME_LENGTH] = "";
@@ -158,6 +305,20 @@ private:
     bool _clearEventlogOnMidnight = false;
 
     int8_t _lastRssi = -127;
+    uint32_t _lastRxFragmentMillis = 0;
+
+    // Jacobson's estimators, see learnReRequestRoundTrip(). The smoothed
+    // time is scaled by 8 and the mean deviation by 4, like in TCP.
+    uint32_t _reRequestRttScaled = 0;
+    uint32_t _reRequestRttDevScaled = 0;
+    uint8_t _reRequestRttSamples = 0;
+    static constexpr uint8_t MIN_ROUND_TRIP_SAMPLES = 4;
+    static constexpr uint32_t MIN_RX_TIMEOUT = 20;
+
+    CommandPool _commandPool;
+
+    uint32_t _lastPoll = 0;
+    uint32_t _lastUnreachable = 0; // as seen by isLimitReadbackRequired()
 
     std::unique_ptr<AlarmLogParser> _alarmLogParser;
     std::unique_ptr<DevInfoParser> _devInfoParser;
@@ -29,8 +29,6 @@ enum class AlarmMessageLocale_t {
 };
 
 typedef struct {
-    AlarmMessageType_t InverterType;
-    uint16_t MessageId;
     const char* Message_en;
     const char* Message_de;
     const char* Message_fr;
@@ -41,10 +39,20 @@ public:
     AlarmLogParser();
     void clearBuffer();
     void appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len);
+    void endAppendFragment();
 
     uint8_t getEntryCount() const;
     void getLogEntry(const uint8_t entryId, AlarmLogEntry_t& entry, const AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN);
 
+    // every entry which was added or changed at its position in the log is
+    // assigned the next sequence number, such that clients can fetch the
+    // changes since the sequence number they know. sequence numbers restart
+    // at zero after a reboot.
+    uint32_t getEntrySequence(const uint8_t entryId) const;
+
+    // the sequence number of the most recent change of any entry
+    uint32_t getSequence() const;
+
     void setLastAlarmRequestSuccess(const LastCommandSuccess status);
     LastCommandSuccess getLastAlarmRequestSuccess() const;
 
@@ -57,9 +65,11 @@ private:
     uint8_t _payloadAlarmLog[ALARM_LOG_PAYLOAD_SIZE];
     uint8_t _alarmLogLength = 0;
 
+    uint8_t _previousEntries[ALARM_LOG_ENTRY_COUNT][ALARM_LOG_ENTRY_SIZE] = {};
+    std::array<uint32_t, ALARM_LOG_ENTRY_COUNT> _entrySequence = {};
+    uint32_t _sequence = 0;
+
     LastCommandSuccess _lastAlarmRequestSuccess = CMD_NOK; // Set to NOK to fetch at startup
 
     AlarmMessageType_t _messageType = AlarmMessageType_t::ALL;
-
-    static const std::array<const AlarmMessage_t, ALARM_MSG_COUNT> _alarmMessages;
 };
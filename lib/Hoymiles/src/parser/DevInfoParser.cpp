@@ -90,40 +90,65 @@ const devInfo_t devInfo[] = {
 DevInfoParser::DevInfoParser()
     : Parser()
 {
-    clearBufferSimple();
-    clearBufferAll();
 }
 
 void DevInfoParser::clearBufferAll()
 {
-    memset(_payloadDevInfoAll, 0, DEV_INFO_SIZE);
-    _devInfoAllLength = 0;
+    _payloadDevInfoAll.beginWrite();
 }
 
 void DevInfoParser::appendFragmentAll(const uint8_t offset, const uint8_t* payload, const uint8_t len)
 {
-    if (offset + len > DEV_INFO_SIZE) {
+    if (!_payloadDevInfoAll.append(offset, payload, len)) {
         Hoymiles.getMessageOutput()->printf("FATAL: (%s, %d) dev info all packet too large for buffer\r\n", __FILE__, __LINE__);
-        return;
     }
-    memcpy(&_payloadDevInfoAll[offset], payload, len);
-    _devInfoAllLength += len;
 }
 
 void DevInfoParser::clearBufferSimple()
 {
-    memset(_payloadDevInfoSimple, 0, DEV_INFO_SIZE);
-    _devInfoSimpleLength = 0;
+    _payloadDevInfoSimple.beginWrite();
 }
 
 void DevInfoParser::appendFragmentSimple(const uint8_t offset, const uint8_t* payload, const uint8_t len)
 {
-    if (offset + len > DEV_INFO_SIZE) {
+    if (!_payloadDevInfoSimple.append(offset, payload, len)) {
         Hoymiles.getMessageOutput()->printf("FATAL: (%s, %d) dev info Simple packet too large for buffer\r\n", __FILE__, __LINE__);
-        return;
     }
-    memcpy(&_payloadDevInfoSimple[offset], payload, len);
-    _devInfoSimpleLength += len;
+}
+
+void DevInfoParser::endAppendFragment()
+{
+    // only the payload which was assembled is published
+    _payloadDevInfoAll.publish();
+    _payloadDevInfoSimple.publish();
+    Parser::endAppendFragment();
+}
+
+std::vector<uint8_t> DevInfoParser::getRawDataAll() const
+{
+    const auto payload = _payloadDevInfoAll.read();
+    return std::vector<uint8_t>(payload.Data.begin(), payload.Data.begin() + payload.Length);
+}
+
+std::vector<uint8_t> DevInfoParser::getRawDataSimple() const
+{
+    const auto payload = _payloadDevInfoSimple.read();
+    return std::vector<uint8_t>(payload.Data.begin(), payload.Data.begin() + payload.Length);
+}
+
+bool DevInfoParser::setRawData(const uint8_t* all, const uint8_t allLen, const uint8_t* simple, const uint8_t simpleLen)
+{
+    if (allLen > DEV_INFO_SIZE || simpleLen > DEV_INFO_SIZE) {
+        return false;
+    }
+
+    beginAppendFragment();
+    clearBufferAll();
+    appendFragmentAll(0, all, allLen);
+    clearBufferSimple();
+    appendFragmentSimple(0, simple, simpleLen);
+    endAppendFragment();
+    return true;
 }
 
 uint32_t DevInfoParser::getLastUpdateAll() const
@@ -150,24 +175,23 @@ void DevInfoParser::setLastUpdateSimple(const uint32_t lastUpdate)
 
 uint16_t DevInfoParser::getFwBuildVersion() const
 {
-    HOY_SEMAPHORE_TAKE();
-    const uint16_t ret = (static_cast<uint16_t>(_payloadDevInfoAll[0]) << 8) | _payloadDevInfoAll[1];
-    HOY_SEMAPHORE_GIVE();
-    return ret;
+    const auto payload = _payloadDevInfoAll.read();
+    return (static_cast<uint16_t>(payload.Data[0]) << 8) | payload.Data[1];
 }
 
 time_t DevInfoParser::getFwBuildDateTime() const
 {
+    const auto payload = _payloadDevInfoAll.read();
+    const auto& data = payload.Data;
+
     struct tm timeinfo = {};
-    HOY_SEMAPHORE_TAKE();
-    timeinfo.tm_year = ((static_cast<uint16_t>(_payloadDevInfoAll[2]) << 8) | _payloadDevInfoAll[3]) - 1900;
+    timeinfo.tm_year = ((static_cast<uint16_t>(data[2]) << 8) | data[3]) - 1900;
 
-    timeinfo.tm_mon = ((static_cast<uint16_t>(_payloadDevInfoAll[4]) << 8) | _payloadDevInfoAll[5]) / 100 - 1;
-    timeinfo.tm_mday = ((static_cast<uint16_t>(_payloadDevInfoAll[4]) << 8) | _payloadDevInfoAll[5]) % 100;
+    timeinfo.tm_mon = ((static_cast<uint16_t>(data[4]) << 8) | data[5]) / 100 - 1;
+    timeinfo.tm_mday = ((static_cast<uint16_t>(data[4]) << 8) | data[5]) % 100;
 
-    timeinfo.tm_hour = ((static_cast<uint16_t>(_payloadDevInfoAll[6]) << 8) | _payloadDevInfoAll[7]) / 100;
-    timeinfo.tm_min = ((static_cast<uint16_t>(_payloadDevInfoAll[6]) << 8) | _payloadDevInfoAll[7]) % 100;
-    HOY_SEMAPHORE_GIVE();
+    timeinfo.tm_hour = ((static_cast<uint16_t>(data[6]) << 8) | data[7]) / 100;
+    timeinfo.tm_min = ((static_cast<uint16_t>(data[6]) << 8) | data[7]) % 100;
 
     return timegm(&timeinfo);
 }
@@ -182,28 +206,25 @@ String DevInfoParser::getFwBuildDateTimeStr() const
 
 uint16_t DevInfoParser::getFwBootloaderVersion() const
 {
-    HOY_SEMAPHORE_TAKE();
-    const uint16_t ret = (static_cast<uint16_t>(_payloadDevInfoAll[8]) << 8) | _payloadDevInfoAll[9];
-    HOY_SEMAPHORE_GIVE();
-    return ret;
+    const auto payload = _payloadDevInfoAll.read();
+    return (static_cast<uint16_t>(payload.Data[8]) << 8) | payload.Data[9];
 }
 
 uint32_t DevInfoParser::getHwPartNumber() const
 {
-    HOY_SEMAPHORE_TAKE();
-    const uint16_t hwpn_h = (static_cast<uint16_t>(_payloadDevInfoSimple[2]) << 8) | _payloadDevInfoSimple[3];
-    const uint16_t hwpn_l = (static_cast<uint16_t>(_payloadDevInfoSimple[4]) << 8) | _payloadDevInfoSimple[5];
-    HOY_SEMAPHORE_GIVE();
+    const auto payload = _payloadDevInfoSimple.read();
+    const auto& data = payload.Data;
+    const uint16_t hwpn_h = (static_cast<uint16_t>(data[2]) << 8) | data[3];
+    const uint16_t hwpn_l = (static_cast<uint16_t>(data[4]) << 8) | data[5];
 
     return (static_cast<uint32_t>(hwpn_h) << 16) | static_cast<uint32_t>(hwpn_l);
 }
 
 String DevInfoParser::getHwVersion() const
 {
+    const auto payload = _payloadDevInfoSimple.read();
     char buf[8];
-    HOY_SEMAPHORE_TAKE();
-    snprintf(buf, sizeof(buf), "%02d.%02d", _payloadDevInfoSimple[6], _payloadDevInfoSimple[7]);
-    HOY_SEMAPHORE_GIVE();
+    snprintf(buf, sizeof(buf), "%02d.%02d", payload.Data[6], payload.Data[7]);
     return buf;
 }
 
@@ -240,14 +261,15 @@ uint8_t DevInfoParser::getDevIdx() const
     uint8_t ret = 0xff;
     uint8_t pos;
 
-    HOY_SEMAPHORE_TAKE();
+    const auto payload = _payloadDevInfoSimple.read();
+    const auto& data = payload.Data;
 
     // Check for all 4 bytes first
     for (pos = 0; pos < sizeof(devInfo) / sizeof(devInfo_t); pos++) {
-        if (devInfo[pos].hwPart[0] == _payloadDevInfoSimple[2]
-            && devInfo[pos].hwPart[1] == _payloadDevInfoSimple[3]
-            && devInfo[pos].hwPart[2] == _payloadDevInfoSimple[4]
-            && devInfo[pos].hwPart[3] == _payloadDevInfoSimple[5]) {
+        if (devInfo[pos].hwPart[0] == data[2]
+            && devInfo[pos].hwPart[1] == data[3]
+            && devInfo[pos].hwPart[2] == data[4]
+            && devInfo[pos].hwPart[3] == data[5]) {
             ret = pos;
             break;
         }
@@ -256,17 +278,15 @@ uint8_t DevInfoParser::getDevIdx() const
     // Then only for 3 bytes but only if not already found
     if (ret == 0xff) {
         for (pos = 0; pos < sizeof(devInfo) / sizeof(devInfo_t); pos++) {
-            if (devInfo[pos].hwPart[0] == _payloadDevInfoSimple[2]
-                && devInfo[pos].hwPart[1] == _payloadDevInfoSimple[3]
-                && devInfo[pos].hwPart[2] == _payloadDevInfoSimple[4]) {
+            if (devInfo[pos].hwPart[0] == data[2]
+                && devInfo[pos].hwPart[1] == data[3]
+                && devInfo[pos].hwPart[2] == data[4]) {
                 ret = pos;
                 break;
             }
         }
     }
 
-    HOY_SEMAPHORE_GIVE();
-
     return ret;
 }
 
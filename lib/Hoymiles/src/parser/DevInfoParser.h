@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 #include "Parser.h"
+#include "PayloadBuffer.h"
+#include <vector>
 
 #define DEV_INFO_SIZE 20
 
@@ -13,6 +15,8 @@ public:
     void clearBufferSimple();
     void appendFragmentSimple(const uint8_t offset, const uint8_t* payload, const uint8_t len);
 
+    void endAppendFragment();
+
     uint32_t getLastUpdateAll() const;
     void setLastUpdateAll(const uint32_t lastUpdate);
 
@@ -32,6 +36,14 @@ public:
 
     bool containsValidData() const;
 
+    std::vector<uint8_t> getRawDataAll() const;
+    std::vector<uint8_t> getRawDataSimple() const;
+
+    // Restores payloads previously obtained by getRawDataAll() and
+    // getRawDataSimple(), e.g. from a cache. The last update timestamps are
+    // left untouched such that the data is still requested from the inverter.
+    bool setRawData(const uint8_t* all, const uint8_t allLen, const uint8_t* simple, const uint8_t simpleLen);
+
 private:
     static time_t timegm(const struct tm* tm);
     uint8_t getDevIdx() const;
@@ -39,9 +51,6 @@ private:
     uint32_t _lastUpdateAll = 0;
     uint32_t _lastUpdateSimple = 0;
 
-    uint8_t _payloadDevInfoAll[DEV_INFO_SIZE] = {};
-    uint8_t _devInfoAllLength = 0;
-
-    uint8_t _payloadDevInfoSimple[DEV_INFO_SIZE] = {};
-    uint8_t _devInfoSimpleLength = 0;
+    PayloadBuffer<DEV_INFO_SIZE> _payloadDevInfoAll;
+    PayloadBuffer<DEV_INFO_SIZE> _payloadDevInfoSimple;
 };
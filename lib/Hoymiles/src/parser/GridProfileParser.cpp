@@ -134,7 +134,7 @@ constexpr frozen::map<uint8_t, GridProfileItemDefinition_t, 0x42> itemDefinition
     { 0xff, make_value("Unkown Value", "", 1) },
 };
 
-const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> GridProfileParser::_profileValues = { {
+constexpr std::array<GridProfileValue_t, SECTION_VALUE_COUNT> profileValues = { {
     // Voltage (H/LVRT)
     // Version 0x00
     { 0x00, 0x00, 0x01 },
@@ -362,32 +362,111 @@ const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> GridProfileParse
     { 0xb0, 0x00, 0x38 },
 } };
 
+// the values of a section version are contiguous in profileValues, the
+// index holds the start and the number of values per section version,
+// sorted by section id and version, such that it is searched by bisection.
+struct GridProfileSectionIndex_t {
+    uint8_t Section;
+    uint8_t Version;
+    uint8_t Start;
+    uint8_t Size;
+};
+
+constexpr bool isSameSectionVersion(const GridProfileValue_t& a, const GridProfileValue_t& b)
+{
+    return a.Section == b.Section && a.Version == b.Version;
+}
+
+constexpr size_t countSectionVersions()
+{
+    size_t count = 0;
+    for (size_t i = 0; i < profileValues.size(); i++) {
+        if (i == 0 || !isSameSectionVersion(profileValues[i - 1], profileValues[i])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+constexpr auto makeSectionIndex()
+{
+    std::array<GridProfileSectionIndex_t, countSectionVersions()> index = {};
+    size_t entry = 0;
+    for (size_t i = 0; i < profileValues.size(); i++) {
+        if (i > 0 && isSameSectionVersion(profileValues[i - 1], profileValues[i])) {
+            index[entry - 1].Size++;
+            continue;
+        }
+        index[entry++] = { profileValues[i].Section, profileValues[i].Version, static_cast<uint8_t>(i), 1 };
+    }
+    return index;
+}
+
+constexpr auto sectionIndex = makeSectionIndex();
+
+constexpr bool isSectionIndexSorted()
+{
+    for (size_t i = 1; i < sectionIndex.size(); i++) {
+        const auto& a = sectionIndex[i - 1];
+        const auto& b = sectionIndex[i];
+        if (a.Section > b.Section || (a.Section == b.Section && a.Version >= b.Version)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(profileValues.size() <= UINT8_MAX, "section start does not fit the index");
+static_assert(isSectionIndexSorted(), "values of a section version must be contiguous and sorted by section and version");
+
+static const GridProfileSectionIndex_t* findSection(const uint8_t section_id, const uint8_t section_version)
+{
+    size_t low = 0;
+    size_t high = sectionIndex.size();
+    while (low < high) {
+        const size_t mid = (low + high) / 2;
+        const auto& entry = sectionIndex[mid];
+        if (entry.Section < section_id || (entry.Section == section_id && entry.Version < section_version)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < sectionIndex.size() && sectionIndex[low].Section == section_id && sectionIndex[low].Version == section_version) {
+        return &sectionIndex[low];
+    }
+    return nullptr;
+}
+
 GridProfileParser::GridProfileParser()
     : Parser()
 {
-    clearBuffer();
 }
 
 void GridProfileParser::clearBuffer()
 {
-    memset(_payloadGridProfile, 0, GRID_PROFILE_SIZE);
-    _gridProfileLength = 0;
+    _payloadGridProfile.beginWrite();
 }
 
 void GridProfileParser::appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len)
 {
-    if (offset + len > GRID_PROFILE_SIZE) {
+    if (!_payloadGridProfile.append(offset, payload, len)) {
         Hoymiles.getMessageOutput()->printf("FATAL: (%s, %d) grid profile packet too large for buffer\r\n", __FILE__, __LINE__);
-        return;
     }
-    memcpy(&_payloadGridProfile[offset], payload, len);
-    _gridProfileLength += len;
+}
+
+void GridProfileParser::endAppendFragment()
+{
+    _payloadGridProfile.publish();
+    Parser::endAppendFragment();
 }
 
 String GridProfileParser::getProfileName() const
 {
+    const auto payload = _payloadGridProfile.read();
     for (auto& ptype : _profileTypes) {
-        if (ptype.lIdx == _payloadGridProfile[0] && ptype.hIdx == _payloadGridProfile[1]) {
+        if (ptype.lIdx == payload.Data[0] && ptype.hIdx == payload.Data[1]) {
             return ptype.Name;
         }
     }
@@ -396,68 +475,76 @@ String GridProfileParser::getProfileName() const
 
 String GridProfileParser::getProfileVersion() const
 {
+    const auto payload = _payloadGridProfile.read();
+    const auto& data = payload.Data;
     char buffer[10];
-    HOY_SEMAPHORE_TAKE();
-    snprintf(buffer, sizeof(buffer), "%d.%d.%d", (_payloadGridProfile[2] >> 4) & 0x0f, _payloadGridProfile[2] & 0x0f, _payloadGridProfile[3]);
-    HOY_SEMAPHORE_GIVE();
+    snprintf(buffer, sizeof(buffer), "%d.%d.%d", (data[2] >> 4) & 0x0f, data[2] & 0x0f, data[3]);
     return buffer;
 }
 
 std::vector<uint8_t> GridProfileParser::getRawData() const
 {
-    std::vector<uint8_t> ret;
-    HOY_SEMAPHORE_TAKE();
-    for (uint8_t i = 0; i < _gridProfileLength; i++) {
-        ret.push_back(_payloadGridProfile[i]);
+    const auto payload = _payloadGridProfile.read();
+    return std::vector<uint8_t>(payload.Data.begin(), payload.Data.begin() + payload.Length);
+}
+
+bool GridProfileParser::setRawData(const uint8_t* data, const uint8_t len)
+{
+    if (len > GRID_PROFILE_SIZE) {
+        return false;
     }
-    HOY_SEMAPHORE_GIVE();
-    return ret;
+
+    beginAppendFragment();
+    clearBuffer();
+    appendFragment(0, data, len);
+    endAppendFragment();
+
+    setLastUpdate(millis());
+    return true;
 }
 
 std::list<GridProfileSection_t> GridProfileParser::getProfile() const
 {
     std::list<GridProfileSection_t> l;
 
-    if (_gridProfileLength > 4) {
-        uint16_t pos = 4;
-        do {
-            const uint8_t section_id = _payloadGridProfile[pos];
-            const uint8_t section_version = _payloadGridProfile[pos + 1];
-            const int16_t section_start = getSectionStart(section_id, section_version);
-            const uint8_t section_size = getSectionSize(section_id, section_version);
-            pos += 2;
+    const auto payload = _payloadGridProfile.read();
+    const auto& data = payload.Data;
 
-            GridProfileSection_t section;
-            try {
-                section.SectionName = profileSection.at(section_id).data();
-            } catch (const std::out_of_range&) {
-                section.SectionName = "Unknown";
-                break;
-            }
-
-            if (section_start == -1) {
-                section.SectionName = "Unknown";
-                break;
-            }
-
-            for (uint8_t val_id = 0; val_id < section_size; val_id++) {
-                auto itemDefinition = itemDefinitions.at(_profileValues[section_start + val_id].ItemDefinition);
+    uint16_t pos = 4;
+    while (pos + 1 < payload.Length) {
+        const uint8_t section_id = data[pos];
+        const uint8_t section_version = data[pos + 1];
+        pos += 2;
 
-                float value = static_cast<int16_t>((_payloadGridProfile[pos] << 8) | _payloadGridProfile[pos + 1]);
-                value /= itemDefinition.Divider;
+        const auto sectionName = profileSection.find(section_id);
+        const GridProfileSectionIndex_t* section_index = findSection(section_id, section_version);
+        if (sectionName == profileSection.end() || section_index == nullptr) {
+            break;
+        }
 
-                GridProfileItem_t v;
-                v.Name = itemDefinition.Name.data();
-                v.Unit = itemDefinition.Unit.data();
-                v.Value = value;
-                section.items.push_back(v);
+        GridProfileSection_t section;
+        section.SectionName = sectionName->second.data();
 
+        for (uint8_t val_id = 0; val_id < section_index->Size && pos + 1 < payload.Length; val_id++) {
+            const auto itemDefinition = itemDefinitions.find(profileValues[section_index->Start + val_id].ItemDefinition);
+            if (itemDefinition == itemDefinitions.end()) {
                 pos += 2;
+                continue;
             }
 
-            l.push_back(section);
+            float value = static_cast<int16_t>((data[pos] << 8) | data[pos + 1]);
+            value /= itemDefinition->second.Divider;
 
-        } while (pos < _gridProfileLength);
+            GridProfileItem_t v;
+            v.Name = itemDefinition->second.Name.data();
+            v.Unit = itemDefinition->second.Unit.data();
+            v.Value = value;
+            section.items.push_back(v);
+
+            pos += 2;
+        }
+
+        l.push_back(section);
     }
 
     return l;
@@ -465,28 +552,5 @@ std::list<GridProfileSection_t> GridProfileParser::getProfile() const
 
 bool GridProfileParser::containsValidData() const
 {
-    return _gridProfileLength > 6;
-}
-
-uint8_t GridProfileParser::getSectionSize(const uint8_t section_id, const uint8_t section_version)
-{
-    uint8_t count = 0;
-    for (auto& values : _profileValues) {
-        if (values.Section == section_id && values.Version == section_version) {
-            count++;
-        }
-    }
-    return count;
-}
-
-int16_t GridProfileParser::getSectionStart(const uint8_t section_id, const uint8_t section_version)
-{
-    int16_t count = -1;
-    for (auto& values : _profileValues) {
-        count++;
-        if (values.Section == section_id && values.Version == section_version) {
-            break;
-        }
-    }
-    return count;
+    return _payloadGridProfile.getLength() > 6;
 }
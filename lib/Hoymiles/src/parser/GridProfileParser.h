@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 #include "Parser.h"
+#include "PayloadBuffer.h"
 #include <list>
 
 #define GRID_PROFILE_SIZE 141
@@ -35,23 +36,22 @@ public:
     GridProfileParser();
     void clearBuffer();
     void appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len);
+    void endAppendFragment();
 
     String getProfileName() const;
     String getProfileVersion() const;
 
     std::vector<uint8_t> getRawData() const;
 
+    // Restores a profile previously obtained by getRawData(), e.g. from a cache
+    bool setRawData(const uint8_t* data, const uint8_t len);
+
     std::list<GridProfileSection_t> getProfile() const;
 
     bool containsValidData() const;
 
 private:
-    static uint8_t getSectionSize(const uint8_t section_id, const uint8_t section_version);
-    static int16_t getSectionStart(const uint8_t section_id, const uint8_t section_version);
-
-    uint8_t _payloadGridProfile[GRID_PROFILE_SIZE] = {};
-    uint8_t _gridProfileLength = 0;
+    PayloadBuffer<GRID_PROFILE_SIZE> _payloadGridProfile;
 
     static const std::array<const ProfileType_t, PROFILE_TYPE_COUNT> _profileTypes;
-    static const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> _profileValues;
 };
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// A payload which is assembled in a back buffer while readers keep accessing
+// the front buffer, which is swapped in once the payload is complete.
+// Readers never block, but retry if the buffer they copied was reused for
+// writing while they were copying it. Writers must be serialized, which the
+// parsers do using their semaphore.
+template <size_t N>
+class PayloadBuffer {
+public:
+    struct Payload {
+        std::array<uint8_t, N> Data;
+        uint8_t Length;
+    };
+
+    // starts writing a new payload into the back buffer, which is either
+    // cleared or initialized with the current payload.
+    void beginWrite(const bool keepContent = false)
+    {
+        _sequence.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        _back = _front.load(std::memory_order_relaxed) ^ 1;
+        if (keepContent) {
+            _buffers[_back] = _buffers[_back ^ 1];
+        } else {
+            _buffers[_back].Data.fill(0);
+            _buffers[_back].Length = 0;
+        }
+        _writing = true;
+    }
+
+    bool append(const uint8_t offset, const uint8_t* payload, const uint8_t len)
+    {
+        if (!_writing || offset + len > N) {
+            return false;
+        }
+        memcpy(&_buffers[_back].Data[offset], payload, len);
+        _buffers[_back].Length += len;
+        return true;
+    }
+
+    // the back buffer, only to be used in between beginWrite() and publish()
+    uint8_t* data() { return _buffers[_back].Data.data(); }
+
+    // makes the back buffer the front buffer, if a payload was written
+    void publish()
+    {
+        if (!_writing) {
+            return;
+        }
+        _writing = false;
+        _front.store(_back, std::memory_order_release);
+        _generation.fetch_add(1, std::memory_order_release);
+    }
+
+    // returns a consistent copy of the most recently published payload
+    Payload read() const
+    {
+        Payload copy;
+        uint32_t sequence;
+        do {
+            sequence = _sequence.load(std::memory_order_acquire);
+            copy = _buffers[_front.load(std::memory_order_acquire)];
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while (sequence != _sequence.load(std::memory_order_relaxed));
+        return copy;
+    }
+
+    uint8_t getLength() const { return read().Length; }
+
+    // incremented whenever a payload was published
+    uint32_t getGeneration() const { return _generation.load(std::memory_order_acquire); }
+
+private:
+    std::array<Payload, 2> _buffers = {};
+    std::atomic<uint8_t> _front = { 0 };
+    uint8_t _back = 1;
+    bool _writing = false;
+
+    std::atomic<uint32_t> _sequence = { 0 };
+    std::atomic<uint32_t> _generation = { 0 };
+};
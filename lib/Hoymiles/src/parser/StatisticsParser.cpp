@@ -4,6 +4,7 @@
  */
 #include "StatisticsParser.h"
 #include "../Hoymiles.h"
+#include <algorithm>
 
 static float calcTotalYieldTotal(StatisticsParser* iv, uint8_t arg0);
 static float calcTotalYieldDay(StatisticsParser* iv, uint8_t arg0);
@@ -56,23 +57,112 @@ const FieldId_t dailyProductionFields[] = {
     FLD_YD,
 };
 
+namespace {
+
+// reads the payload of consecutive fragments as if it was a single buffer
+class FragmentReader {
+public:
+    FragmentReader(const fragment_t fragment[], const uint8_t count)
+        : _fragment(fragment)
+        , _count(count)
+    {
+    }
+
+    // big endian, bytes past the end of the payload read as zero
+    uint32_t read(uint8_t offset, const uint8_t num) const
+    {
+        uint8_t i = 0;
+        uint32_t val = 0;
+        for (uint8_t n = 0; n < num; n++) {
+            while (i < _count && offset >= _fragment[i].len) {
+                offset -= _fragment[i].len;
+                i++;
+            }
+
+            val <<= 8;
+            if (i < _count) {
+                val |= _fragment[i].fragment[offset++];
+            }
+        }
+        return val;
+    }
+
+    uint8_t size() const
+    {
+        uint8_t size = 0;
+        for (uint8_t i = 0; i < _count; i++) {
+            size += _fragment[i].len;
+        }
+        return size;
+    }
+
+private:
+    const fragment_t* _fragment;
+    const uint8_t _count;
+};
+
+}; // namespace
+
+static const std::array<ChannelType_t, TYPE_CNT> channelTypes = { TYPE_AC, TYPE_DC, TYPE_INV };
+
+// used until a layout was set
+static const std::array<channelList_t, TYPE_CNT> noChannels = {};
+
 StatisticsParser::StatisticsParser()
     : Parser()
+    , _channelsByType(&noChannels)
 {
     clearBuffer();
 }
 
-void StatisticsParser::setByteAssignment(const byteAssign_t* byteAssignment, const uint8_t size)
+void StatisticsParser::setLayout(const statisticsLayout_t* layout)
 {
-    _byteAssignment = byteAssignment;
-    _byteAssignmentSize = size;
+    _byteAssignment = layout->byteAssignment;
+    _byteAssignmentSize = layout->byteAssignmentSize;
+    _expectedByteCount = layout->expectedByteCount;
+    _assignmentIndex = &layout->assignmentIndex;
+    _channelsByType = &layout->channelsByType;
+    _calculatedValid = false;
 
     for (uint8_t i = 0; i < _byteAssignmentSize; i++) {
-        if (_byteAssignment[i].div == CMD_CALC) {
-            continue;
+        const byteAssign_t& assignment = _byteAssignment[i];
+        _fieldSettings[i] = { assignment.type, assignment.ch, assignment.fieldId, 0 };
+    }
+}
+
+uint8_t StatisticsParser::getAssignmentIndex(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId) const
+{
+    if (_byteAssignmentSize == 0 || type >= TYPE_CNT || channel >= CH_CNT || fieldId >= FLD_CNT) {
+        return STATISTIC_MAX_ASSIGNMENTS;
+    }
+    return (*_assignmentIndex)[(type * CH_CNT + channel) * FLD_CNT + fieldId];
+}
+
+float StatisticsParser::decodeValue(const byteAssign_t& assignment, uint32_t raw)
+{
+    float result;
+    if (assignment.isSigned && assignment.num == 2) {
+        result = static_cast<float>(static_cast<int16_t>(raw));
+    } else if (assignment.isSigned && assignment.num == 4) {
+        result = static_cast<float>(static_cast<int32_t>(raw));
+    } else {
+        result = static_cast<float>(raw);
+    }
+
+    return result / static_cast<float>(assignment.div);
+}
+
+void StatisticsParser::updateCalculatedFields()
+{
+    // the calculations only read static fields
+    _calculatedValid = false;
+    for (uint8_t i = 0; i < _byteAssignmentSize; i++) {
+        const byteAssign_t* pos = &_byteAssignment[i];
+        if (pos->div == CMD_CALC) {
+            _values[i] = calcFunctions[pos->start].func(this, pos->num);
         }
-        _expectedByteCount = max<uint8_t>(_expectedByteCount, _byteAssignment[i].start + _byteAssignment[i].num);
     }
+    _calculatedValid = true;
 }
 
 uint8_t StatisticsParser::getExpectedByteCount()
@@ -82,26 +172,35 @@ uint8_t StatisticsParser::getExpectedByteCount()
 
 void StatisticsParser::clearBuffer()
 {
-    memset(_payloadStatistic, 0, STATISTIC_PACKET_SIZE);
     _statisticLength = 0;
+    _values.fill(0);
+    _calculatedValid = false;
 }
 
-void StatisticsParser::appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len)
+void StatisticsParser::decodeFragments(const fragment_t fragment[], const uint8_t count)
 {
-    if (offset + len > STATISTIC_PACKET_SIZE) {
-        Hoymiles.getMessageOutput()->printf("FATAL: (%s, %d) stats packet too large for buffer\r\n", __FILE__, __LINE__);
-        return;
+    const FragmentReader reader(fragment, count);
+
+    // decode all static fields once, rather than on every read
+    std::array<float, STATISTIC_MAX_ASSIGNMENTS> values = {};
+    for (uint8_t i = 0; i < _byteAssignmentSize; i++) {
+        const byteAssign_t& assignment = _byteAssignment[i];
+        if (assignment.div != CMD_CALC) {
+            values[i] = decodeValue(assignment, reader.read(assignment.start, assignment.num));
+        }
     }
-    memcpy(&_payloadStatistic[offset], payload, len);
-    _statisticLength += len;
-}
 
-void StatisticsParser::endAppendFragment()
-{
-    Parser::endAppendFragment();
+    beginAppendFragment();
+    _values = values;
+    _statisticLength = reader.size();
+    updateCalculatedFields();
+    endAppendFragment();
+
+    updateAcPowerHistory();
 
     if (!_enableYieldDayCorrection) {
         resetYieldDayCorrection();
+        notifyUpdate();
         return;
     }
 
@@ -118,65 +217,69 @@ void StatisticsParser::endAppendFragment()
             _lastYieldDay[static_cast<uint8_t>(c)] = getChannelFieldValue(TYPE_DC, c, FLD_YD);
         }
     }
+
+    notifyUpdate();
+}
+
+void StatisticsParser::updateAcPowerHistory()
+{
+    float totalAc = 0;
+    for (auto& c : getChannelsByType(TYPE_AC)) {
+        totalAc += getChannelFieldValue(TYPE_AC, c, FLD_PAC);
+    }
+
+    _acPowerHistory[_acPowerHistoryPos] = totalAc;
+    _acPowerHistoryPos = (_acPowerHistoryPos + 1) % STATISTIC_AC_POWER_HISTORY_SIZE;
+    _acPowerHistorySize = min<uint8_t>(_acPowerHistorySize + 1, STATISTIC_AC_POWER_HISTORY_SIZE);
+}
+
+float StatisticsParser::getAcPowerSpread() const
+{
+    if (_acPowerHistorySize == 0) {
+        return 0;
+    }
+
+    auto begin = _acPowerHistory.begin();
+    auto minmax = std::minmax_element(begin, begin + _acPowerHistorySize);
+    return *minmax.second - *minmax.first;
 }
 
 const byteAssign_t* StatisticsParser::getAssignmentByChannelField(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId) const
 {
-    for (uint8_t i = 0; i < _byteAssignmentSize; i++) {
-        if (_byteAssignment[i].type == type && _byteAssignment[i].ch == channel && _byteAssignment[i].fieldId == fieldId) {
-            return &_byteAssignment[i];
-        }
+    const uint8_t index = getAssignmentIndex(type, channel, fieldId);
+    if (index == STATISTIC_MAX_ASSIGNMENTS) {
+        return nullptr;
     }
-    return nullptr;
+    return &_byteAssignment[index];
 }
 
 fieldSettings_t* StatisticsParser::getSettingByChannelField(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
 {
-    for (auto& i : _fieldSettings) {
-        if (i.type == type && i.ch == channel && i.fieldId == fieldId) {
-            return &i;
-        }
+    const uint8_t index = getAssignmentIndex(type, channel, fieldId);
+    if (index == STATISTIC_MAX_ASSIGNMENTS) {
+        return nullptr;
     }
-    return nullptr;
+    return &_fieldSettings[index];
 }
 
 float StatisticsParser::getChannelFieldValue(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
 {
-    const byteAssign_t* pos = getAssignmentByChannelField(type, channel, fieldId);
-    if (pos == nullptr) {
+    const uint8_t index = getAssignmentIndex(type, channel, fieldId);
+    if (index == STATISTIC_MAX_ASSIGNMENTS) {
         return 0;
     }
 
-    uint8_t ptr = pos->start;
-    const uint8_t end = ptr + pos->num;
-    const uint16_t div = pos->div;
-
-    if (CMD_CALC != div) {
-        // Value is a static value
-        uint32_t val = 0;
-        HOY_SEMAPHORE_TAKE();
-        do {
-            val <<= 8;
-            val |= _payloadStatistic[ptr];
-        } while (++ptr != end);
-        HOY_SEMAPHORE_GIVE();
-
-        float result;
-        if (pos->isSigned && pos->num == 2) {
-            result = static_cast<float>(static_cast<int16_t>(val));
-        } else if (pos->isSigned && pos->num == 4) {
-            result = static_cast<float>(static_cast<int32_t>(val));
-        } else {
-            result = static_cast<float>(val);
-        }
-
-        result /= static_cast<float>(div);
+    const byteAssign_t* pos = &_byteAssignment[index];
 
-        const fieldSettings_t* setting = getSettingByChannelField(type, channel, fieldId);
-        if (setting != nullptr && _statisticLength > 0) {
-            result += setting->offset;
+    if (CMD_CALC != pos->div) {
+        // Value is a static value, decoded when the packet was received
+        float result = _values[index];
+        if (_statisticLength > 0) {
+            result += _fieldSettings[index].offset;
         }
         return result;
+    } else if (_calculatedValid) {
+        return _values[index];
     } else {
         // Value has to be calculated
         return calcFunctions[pos->start].func(this, pos->num);
@@ -187,23 +290,20 @@ float StatisticsParser::getChannelFieldValue(const ChannelType_t type, const Cha
 
 bool StatisticsParser::setChannelFieldValue(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, float value)
 {
-    const byteAssign_t* pos = getAssignmentByChannelField(type, channel, fieldId);
-    if (pos == nullptr) {
+    const uint8_t index = getAssignmentIndex(type, channel, fieldId);
+    if (index == STATISTIC_MAX_ASSIGNMENTS) {
         return false;
     }
 
-    uint8_t ptr = pos->start + pos->num - 1;
-    const uint8_t end = pos->start;
+    const byteAssign_t* pos = &_byteAssignment[index];
+
     const uint16_t div = pos->div;
 
     if (CMD_CALC == div) {
         return false;
     }
 
-    const fieldSettings_t* setting = getSettingByChannelField(type, channel, fieldId);
-    if (setting != nullptr) {
-        value -= setting->offset;
-    }
+    value -= _fieldSettings[index].offset;
     value *= static_cast<float>(div);
 
     uint32_t val = 0;
@@ -215,11 +315,14 @@ bool StatisticsParser::setChannelFieldValue(const ChannelType_t type, const Chan
         val = static_cast<uint32_t>(value);
     }
 
+    // limited to the size of the field as if it was received
+    if (pos->num < 4) {
+        val &= (1UL << (8 * pos->num)) - 1;
+    }
+
     HOY_SEMAPHORE_TAKE();
-    do {
-        _payloadStatistic[ptr] = val;
-        val >>= 8;
-    } while (--ptr >= end);
+    _values[index] = decodeValue(*pos, val);
+    _calculatedValid = false; // see zeroFields()
     HOY_SEMAPHORE_GIVE();
 
     return true;
@@ -268,20 +371,17 @@ float StatisticsParser::getChannelFieldOffset(const ChannelType_t type, const Ch
 void StatisticsParser::setChannelFieldOffset(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const float offset)
 {
     fieldSettings_t* setting = getSettingByChannelField(type, channel, fieldId);
-    if (setting != nullptr) {
+    if (setting != nullptr && setting->offset != offset) {
         setting->offset = offset;
-    } else {
-        _fieldSettings.push_back({ type, channel, fieldId, offset });
+        updateCalculatedFields();
     }
+
+    notifyUpdate();
 }
 
-std::list<ChannelType_t> StatisticsParser::getChannelTypes() const
+const std::array<ChannelType_t, TYPE_CNT>& StatisticsParser::getChannelTypes() const
 {
-    return {
-        TYPE_AC,
-        TYPE_DC,
-        TYPE_INV
-    };
+    return channelTypes;
 }
 
 const char* StatisticsParser::getChannelTypeName(const ChannelType_t type) const
@@ -289,16 +389,12 @@ const char* StatisticsParser::getChannelTypeName(const ChannelType_t type) const
     return channelsTypes[type];
 }
 
-std::list<ChannelNum_t> StatisticsParser::getChannelsByType(const ChannelType_t type) const
+const channelList_t& StatisticsParser::getChannelsByType(const ChannelType_t type) const
 {
-    std::list<ChannelNum_t> l;
-    for (uint8_t i = 0; i < _byteAssignmentSize; i++) {
-        if (_byteAssignment[i].type == type) {
-            l.push_back(_byteAssignment[i].ch);
-        }
+    if (type >= TYPE_CNT) {
+        return noChannels[0];
     }
-    l.unique();
-    return l;
+    return (*_channelsByType)[type];
 }
 
 uint16_t StatisticsParser::getStringMaxPower(const uint8_t channel) const
@@ -310,6 +406,10 @@ void StatisticsParser::setStringMaxPower(const uint8_t channel, const uint16_t p
 {
     if (channel < sizeof(_stringMaxPower) / sizeof(_stringMaxPower[0])) {
         _stringMaxPower[channel] = power;
+        if (_calculatedValid) {
+            updateCalculatedFields();
+        }
+        notifyUpdate();
     }
 }
 
@@ -364,6 +464,24 @@ void StatisticsParser::setYieldDayCorrection(const bool enabled)
     _enableYieldDayCorrection = enabled;
 }
 
+yieldDayCorrectionState_t StatisticsParser::getYieldDayCorrectionState()
+{
+    yieldDayCorrectionState_t state = {};
+    for (auto& c : getChannelsByType(TYPE_DC)) {
+        state.Offset[static_cast<uint8_t>(c)] = getChannelFieldOffset(TYPE_DC, c, FLD_YD);
+        state.LastYieldDay[static_cast<uint8_t>(c)] = _lastYieldDay[static_cast<uint8_t>(c)];
+    }
+    return state;
+}
+
+void StatisticsParser::setYieldDayCorrectionState(const yieldDayCorrectionState_t& state)
+{
+    for (auto& c : getChannelsByType(TYPE_DC)) {
+        setChannelFieldOffset(TYPE_DC, c, FLD_YD, state.Offset[static_cast<uint8_t>(c)]);
+        _lastYieldDay[static_cast<uint8_t>(c)] = state.LastYieldDay[static_cast<uint8_t>(c)];
+    }
+}
+
 void StatisticsParser::zeroFields(const FieldId_t* fields)
 {
     // Loop all channels
@@ -376,7 +494,21 @@ void StatisticsParser::zeroFields(const FieldId_t* fields)
             }
         }
     }
+    updateCalculatedFields();
     setLastUpdateFromInternal(millis());
+    notifyUpdate();
+}
+
+void StatisticsParser::setUpdateCallback(UpdateCallback callback)
+{
+    _updateCallback = std::move(callback);
+}
+
+void StatisticsParser::notifyUpdate()
+{
+    if (_updateCallback) {
+        _updateCallback();
+    }
 }
 
 void StatisticsParser::resetYieldDayCorrection()
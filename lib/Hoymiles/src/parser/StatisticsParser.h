@@ -1,10 +1,13 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
+#include "../types.h"
 #include "Parser.h"
+#include <array>
 #include <cstdint>
-#include <list>
+#include <functional>
 
-#define STATISTIC_PACKET_SIZE (7 * 16)
+#define STATISTIC_AC_POWER_HISTORY_SIZE 4
+#define STATISTIC_MAX_ASSIGNMENTS 64
 
 // units
 enum UnitId_t {
@@ -47,7 +50,8 @@ enum FieldId_t {
     FLD_UAC_31,
     FLD_IAC_1,
     FLD_IAC_2,
-    FLD_IAC_3
+    FLD_IAC_3,
+    FLD_CNT
 };
 const char* const fields[] = { "Voltage", "Current", "Power", "YieldDay", "YieldTotal",
     "Voltage", "Current", "Power", "Frequency", "Temperature", "PowerFactor", "Efficiency", "Irradiation", "ReactivePower", "EventLogCount",
@@ -79,7 +83,8 @@ enum ChannelNum_t {
 enum ChannelType_t {
     TYPE_AC = 0,
     TYPE_DC,
-    TYPE_INV
+    TYPE_INV,
+    TYPE_CNT
 };
 const char* const channelsTypes[] = { "AC", "DC", "INV" };
 
@@ -102,14 +107,86 @@ typedef struct {
     float offset; // offset (positive/negative) to be applied on the fetched value
 } fieldSettings_t;
 
+// Volatile state of the yield day correction, indexed by DC channel
+typedef struct {
+    float Offset[CH_CNT];
+    float LastYieldDay[CH_CNT];
+} yieldDayCorrectionState_t;
+
+// the channels of a type in the order of the byte assignment
+typedef struct {
+    std::array<ChannelNum_t, CH_CNT> channels;
+    uint8_t count;
+
+    const ChannelNum_t* begin() const { return channels.data(); }
+    const ChannelNum_t* end() const { return channels.data() + count; }
+    size_t size() const { return count; }
+} channelList_t;
+
+// maps (type, channel, field) to the index of the respective assignment,
+// STATISTIC_MAX_ASSIGNMENTS if the inverter does not provide the field
+using assignmentIndex_t = std::array<uint8_t, TYPE_CNT * CH_CNT * FLD_CNT>;
+
+// derived from the byte assignment of an inverter model at compile time
+typedef struct {
+    const byteAssign_t* byteAssignment;
+    uint8_t byteAssignmentSize;
+    uint8_t expectedByteCount;
+    assignmentIndex_t assignmentIndex;
+    std::array<channelList_t, TYPE_CNT> channelsByType;
+} statisticsLayout_t;
+
+template <size_t N>
+constexpr statisticsLayout_t makeStatisticsLayout(const byteAssign_t (&byteAssignment)[N])
+{
+    static_assert(N <= STATISTIC_MAX_ASSIGNMENTS, "too many byte assignments");
+
+    statisticsLayout_t layout {};
+    layout.byteAssignment = byteAssignment;
+    layout.byteAssignmentSize = N;
+
+    for (auto& index : layout.assignmentIndex) {
+        index = STATISTIC_MAX_ASSIGNMENTS;
+    }
+
+    for (uint8_t i = 0; i < N; i++) {
+        const byteAssign_t& assignment = byteAssignment[i];
+
+        // the first assignment of a field wins
+        uint8_t& index = layout.assignmentIndex[(assignment.type * CH_CNT + assignment.ch) * FLD_CNT + assignment.fieldId];
+        if (index == STATISTIC_MAX_ASSIGNMENTS) {
+            index = i;
+        }
+
+        // like std::list::unique(), only consecutive duplicates are dropped
+        channelList_t& list = layout.channelsByType[assignment.type];
+        if ((list.count == 0 || list.channels[list.count - 1] != assignment.ch) && list.count < CH_CNT) {
+            list.channels[list.count++] = assignment.ch;
+        }
+
+        if (assignment.div == CMD_CALC) {
+            continue;
+        }
+
+        uint8_t end = assignment.start + assignment.num;
+        if (end > layout.expectedByteCount) {
+            layout.expectedByteCount = end;
+        }
+    }
+
+    return layout;
+}
+
 class StatisticsParser : public Parser {
 public:
     StatisticsParser();
     void clearBuffer();
-    void appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len);
-    void endAppendFragment();
 
-    void setByteAssignment(const byteAssign_t* byteAssignment, const uint8_t size);
+    // decodes the fields right from the payload of the received fragments,
+    // which is not copied. the lock is only held to publish the values.
+    void decodeFragments(const fragment_t fragment[], const uint8_t count);
+
+    void setLayout(const statisticsLayout_t* layout);
 
     // Returns 1 based amount of expected bytes of statistic data
     uint8_t getExpectedByteCount();
@@ -129,9 +206,9 @@ public:
     float getChannelFieldOffset(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
     void setChannelFieldOffset(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const float offset);
 
-    std::list<ChannelType_t> getChannelTypes() const;
+    const std::array<ChannelType_t, TYPE_CNT>& getChannelTypes() const;
     const char* getChannelTypeName(const ChannelType_t type) const;
-    std::list<ChannelNum_t> getChannelsByType(const ChannelType_t type) const;
+    const channelList_t& getChannelsByType(const ChannelType_t type) const;
 
     uint16_t getStringMaxPower(const uint8_t channel) const;
     void setStringMaxPower(const uint8_t channel, const uint16_t power);
@@ -153,21 +230,64 @@ public:
 
     bool getYieldDayCorrection() const;
     void setYieldDayCorrection(const bool enabled);
+
+    // Allows to keep the yield day correction across reboots
+    yieldDayCorrectionState_t getYieldDayCorrectionState();
+    void setYieldDayCorrectionState(const yieldDayCorrectionState_t& state);
+
+    // Returns the difference between the highest and the lowest total AC
+    // power of the most recent updates received from the inverter
+    float getAcPowerSpread() const;
+
+    // the callback is invoked whenever the statistics changed, i.e., new
+    // data was received or the data was manipulated internally.
+    using UpdateCallback = std::function<void()>;
+    void setUpdateCallback(UpdateCallback callback);
+
 private:
+    void notifyUpdate();
+    void updateAcPowerHistory();
     void zeroFields(const FieldId_t* fields);
 
-    uint8_t _payloadStatistic[STATISTIC_PACKET_SIZE] = {};
-    uint8_t _statisticLength = 0;
-    uint16_t _stringMaxPower[CH_CNT];
+    // index of the assignment of the given field, or
+    // STATISTIC_MAX_ASSIGNMENTS if the inverter does not provide it
+    uint8_t getAssignmentIndex(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId) const;
+    static float decodeValue(const byteAssign_t& assignment, uint32_t raw);
+
+    // evaluates the calculated fields, which then read like static ones
+    void updateCalculatedFields();
+
+    uint8_t _statisticLength = 0; // of the last payload received
+    uint16_t _stringMaxPower[CH_CNT] = {};
 
-    const byteAssign_t* _byteAssignment;
-    uint8_t _byteAssignmentSize;
+    const byteAssign_t* _byteAssignment = nullptr;
+    uint8_t _byteAssignmentSize = 0;
     uint8_t _expectedByteCount = 0;
-    std::list<fieldSettings_t> _fieldSettings;
+
+    // lives in flash, shared by all inverters of the same model
+    const assignmentIndex_t* _assignmentIndex = nullptr;
+
+    const std::array<channelList_t, TYPE_CNT>* _channelsByType;
+
+    // the values of static fields, decoded once per packet without offset,
+    // and of calculated fields, evaluated once their inputs changed
+    std::array<float, STATISTIC_MAX_ASSIGNMENTS> _values = {};
+
+    // calculated fields are evaluated on every read while not set
+    bool _calculatedValid = false;
+
+    // the settings of the field of the assignment with the same index
+    std::array<fieldSettings_t, STATISTIC_MAX_ASSIGNMENTS> _fieldSettings = {};
 
     uint32_t _rxFailureCount = 0;
     uint32_t _lastUpdateFromInternal = 0;
 
     bool _enableYieldDayCorrection = false;
     float _lastYieldDay[CH_CNT] = {};
+
+    std::array<float, STATISTIC_AC_POWER_HISTORY_SIZE> _acPowerHistory = {};
+    uint8_t _acPowerHistoryPos = 0;
+    uint8_t _acPowerHistorySize = 0;
+
+    UpdateCallback _updateCallback;
 };
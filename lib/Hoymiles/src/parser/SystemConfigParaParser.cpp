@@ -23,30 +23,49 @@ ID   Source Addr   Target Addr   Idx  ?       Limit percent   ?       ?       ?
 SystemConfigParaParser::SystemConfigParaParser()
     : Parser()
 {
-    clearBuffer();
 }
 
 void SystemConfigParaParser::clearBuffer()
 {
-    memset(_payload, 0, SYSTEM_CONFIG_PARA_SIZE);
-    _payloadLength = 0;
+    _payload.beginWrite();
 }
 
 void SystemConfigParaParser::appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len)
 {
-    if (offset + len > (SYSTEM_CONFIG_PARA_SIZE)) {
+    if (!_payload.append(offset, payload, len)) {
         Hoymiles.getMessageOutput()->printf("FATAL: (%s, %d) stats packet too large for buffer\r\n", __FILE__, __LINE__);
-        return;
     }
-    memcpy(&_payload[offset], payload, len);
-    _payloadLength += len;
+}
+
+void SystemConfigParaParser::endAppendFragment()
+{
+    _payload.publish();
+    Parser::endAppendFragment();
+}
+
+std::vector<uint8_t> SystemConfigParaParser::getRawData() const
+{
+    const auto payload = _payload.read();
+    return std::vector<uint8_t>(payload.Data.begin(), payload.Data.begin() + payload.Length);
+}
+
+bool SystemConfigParaParser::setRawData(const uint8_t* data, const uint8_t len)
+{
+    if (len > SYSTEM_CONFIG_PARA_SIZE) {
+        return false;
+    }
+
+    beginAppendFragment();
+    clearBuffer();
+    appendFragment(0, data, len);
+    endAppendFragment();
+    return true;
 }
 
 float SystemConfigParaParser::getLimitPercent() const
 {
-    HOY_SEMAPHORE_TAKE();
-    const float ret = ((static_cast<uint16_t>(_payload[2]) << 8) | _payload[3]) / 10.0;
-    HOY_SEMAPHORE_GIVE();
+    const auto payload = _payload.read();
+    const float ret = ((static_cast<uint16_t>(payload.Data[2]) << 8) | payload.Data[3]) / 10.0;
 
     // don't pretend the inverter could produce more than its rated power,
     // even though it does process, accept, and even save limit values beyond
@@ -57,8 +76,10 @@ float SystemConfigParaParser::getLimitPercent() const
 void SystemConfigParaParser::setLimitPercent(const float value)
 {
     HOY_SEMAPHORE_TAKE();
-    _payload[2] = static_cast<uint16_t>(value * 10) >> 8;
-    _payload[3] = static_cast<uint16_t>(value * 10);
+    _payload.beginWrite(true);
+    _payload.data()[2] = static_cast<uint16_t>(value * 10) >> 8;
+    _payload.data()[3] = static_cast<uint16_t>(value * 10);
+    _payload.publish();
     HOY_SEMAPHORE_GIVE();
 }
 
@@ -83,6 +104,16 @@ void SystemConfigParaParser::setLastUpdateCommand(const uint32_t lastUpdate)
     setLastUpdate(lastUpdate);
 }
 
+LimitCommandTimings_t SystemConfigParaParser::getLastLimitCommandTimings() const
+{
+    return _lastLimitCommandTimings;
+}
+
+void SystemConfigParaParser::setLastLimitCommandTimings(const LimitCommandTimings_t& timings)
+{
+    _lastLimitCommandTimings = timings;
+}
+
 void SystemConfigParaParser::setLastLimitRequestSuccess(const LastCommandSuccess status)
 {
     _lastLimitRequestSuccess = status;
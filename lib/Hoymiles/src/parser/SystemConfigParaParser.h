@@ -1,14 +1,24 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 #include "Parser.h"
+#include "PayloadBuffer.h"
+#include <vector>
 
 #define SYSTEM_CONFIG_PARA_SIZE 16
 
+// Timestamps (millis) of the stages of the last acknowledged limit command
+typedef struct {
+    uint32_t Enqueued;
+    uint32_t FirstTx;
+    uint32_t Acknowledged;
+} LimitCommandTimings_t;
+
 class SystemConfigParaParser : public Parser {
 public:
     SystemConfigParaParser();
     void clearBuffer();
     void appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len);
+    void endAppendFragment();
 
     float getLimitPercent() const;
     void setLimitPercent(const float value);
@@ -18,21 +28,31 @@ public:
     uint32_t getLastUpdateCommand() const;
     void setLastUpdateCommand(const uint32_t lastUpdate);
 
+    LimitCommandTimings_t getLastLimitCommandTimings() const;
+    void setLastLimitCommandTimings(const LimitCommandTimings_t& timings);
+
     void setLastLimitRequestSuccess(const LastCommandSuccess status);
     LastCommandSuccess getLastLimitRequestSuccess() const;
     uint32_t getLastUpdateRequest() const;
     void setLastUpdateRequest(const uint32_t lastUpdate);
 
+    std::vector<uint8_t> getRawData() const;
+
+    // Restores a payload previously obtained by getRawData(), e.g. from a
+    // cache. The last update timestamps are left untouched such that the
+    // data is still requested from the inverter.
+    bool setRawData(const uint8_t* data, const uint8_t len);
+
     // Returns 1 based amount of expected bytes of data
     uint8_t getExpectedByteCount() const;
 
 private:
-    uint8_t _payload[SYSTEM_CONFIG_PARA_SIZE];
-    uint8_t _payloadLength;
+    PayloadBuffer<SYSTEM_CONFIG_PARA_SIZE> _payload;
 
     LastCommandSuccess _lastLimitCommandSuccess = CMD_OK; // Set to OK because we have to assume nothing is done at startup
     LastCommandSuccess _lastLimitRequestSuccess = CMD_NOK; // Set to NOK to fetch at startup
 
     uint32_t _lastUpdateCommand = 0;
+    LimitCommandTimings_t _lastLimitCommandTimings = {};
     uint32_t _lastUpdateRequest = 0;
 };
\ No newline at end of file
@@ -4,48 +4,228 @@
  */
 #include "CommandQueue.h"
 #include "../inverters/InverterAbstract.h"
+#include <Arduino.h>
 #include <algorithm>
 
+void CommandQueue::push(std::shared_ptr<CommandAbstract> cmd)
+{
+    // calculated outside the lock, the keys are cached by the command
+    cmd->getSimilarityKey();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    track(*cmd, true);
+    _queue.push_back(std::move(cmd));
+}
+
+std::optional<std::shared_ptr<CommandAbstract>> CommandQueue::pop()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_queue.empty()) {
+        return {};
+    }
+
+    std::shared_ptr<CommandAbstract> cmd = std::move(_queue.front());
+    _queue.pop_front();
+    track(*cmd, false);
+    return cmd;
+}
+
+void CommandQueue::track(CommandAbstract& cmd, const bool added)
+{
+    uint8_t& count = _similarCount[{ cmd.getTargetAddress(), cmd.getSimilarityKey() }];
+    if (added) {
+        count++;
+    } else if (count > 0) {
+        count--;
+    }
+
+    const uint32_t typeKey = cmd.getTypeKey();
+    TypeStats* stats = nullptr;
+    for (auto& entry : _typeStats) {
+        if (entry.Key == typeKey) {
+            stats = &entry;
+            break;
+        }
+        if (entry.Key == 0) {
+            entry.Key = typeKey;
+            entry.Name = cmd.getCommandName();
+            stats = &entry;
+            break;
+        }
+    }
+
+    if (stats == nullptr) {
+        return;
+    }
+
+    if (added) {
+        stats->Depth++;
+        stats->MaxDepth = std::max(stats->MaxDepth, stats->Depth);
+        return;
+    }
+
+    if (stats->Depth > 0) {
+        stats->Depth--;
+    }
+    const uint32_t dwell = millis() - cmd.getEnqueueMillis();
+    stats->Completed++;
+    stats->DwellMsTotal += dwell;
+    stats->DwellMsMax = std::max(stats->DwellMsMax, dwell);
+}
+
 void CommandQueue::removeAllEntriesForInverter(InverterAbstract* inv)
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
     auto it = std::remove_if(_queue.begin(), _queue.end(),
-        [&inv](std::shared_ptr<CommandAbstract> v) -> bool { return v.get()->getTargetAddress() == inv->serial(); });
+        [this, &inv](std::shared_ptr<CommandAbstract>& v) -> bool {
+            if (v->getTargetAddress() != inv->serial()) {
+                return false;
+            }
+            track(*v, false);
+            return true;
+        });
     _queue.erase(it, _queue.end());
+
+    // the inverter is gone, so are its keys
+    for (auto key = _similarCount.begin(); key != _similarCount.end();) {
+        if (key->first.first == inv->serial()) {
+            key = _similarCount.erase(key);
+        } else {
+            ++key;
+        }
+    }
 }
 
 void CommandQueue::removeDuplicatedEntries(std::shared_ptr<CommandAbstract> cmd)
 {
+    if (cmd->getQueueInsertType() != QueueInsertType::RemoveOldest) {
+        return;
+    }
+
+    const index_key_t key = { cmd->getTargetAddress(), cmd->getSimilarityKey() };
+
     std::lock_guard<std::mutex> lock(_mutex);
 
+    auto count = _similarCount.find(key);
+    if (count == _similarCount.end() || count->second == 0 || _queue.empty()) {
+        return;
+    }
+
     auto it = std::remove_if(_queue.begin() + 1, _queue.end(),
-        [&cmd](std::shared_ptr<CommandAbstract> v) -> bool {
-            return cmd->areSameParameter(v.get())
-                && cmd.get()->getQueueInsertType() == QueueInsertType::RemoveOldest;
+        [this, &cmd](std::shared_ptr<CommandAbstract>& v) -> bool {
+            if (!cmd->areSameParameter(v.get())) {
+                return false;
+            }
+            track(*v, false);
+            return true;
         });
     _queue.erase(it, _queue.end());
 }
 
 void CommandQueue::replaceEntries(std::shared_ptr<CommandAbstract> cmd)
 {
+    if (cmd->getQueueInsertType() != QueueInsertType::ReplaceExistent) {
+        return;
+    }
+
+    const index_key_t key = { cmd->getTargetAddress(), cmd->getSimilarityKey() };
+
     std::lock_guard<std::mutex> lock(_mutex);
 
-    std::replace_if(_queue.begin() + 1, _queue.end(),
-        [&cmd](std::shared_ptr<CommandAbstract> v)-> bool {
-            return cmd.get()->getQueueInsertType() == QueueInsertType::ReplaceExistent
-                && cmd->areSameParameter(v.get());
-            },
-        cmd
-    );
+    auto count = _similarCount.find(key);
+    if (count == _similarCount.end() || count->second == 0 || _queue.empty()) {
+        return;
+    }
+
+    for (auto it = _queue.begin() + 1; it != _queue.end(); ++it) {
+        if (cmd->areSameParameter(it->get())) {
+            track(**it, false);
+            track(*cmd, true);
+            *it = cmd;
+        }
+    }
 }
 
 uint8_t CommandQueue::countSimilarCommands(std::shared_ptr<CommandAbstract> cmd)
 {
+    const index_key_t key = { cmd->getTargetAddress(), cmd->getSimilarityKey() };
+
     std::lock_guard<std::mutex> lock(_mutex);
 
-    return std::count_if(_queue.begin(), _queue.end(),
-        [&cmd](std::shared_ptr<CommandAbstract> v) -> bool {
-            return cmd->areSameParameter(v.get());
-        });
+    auto count = _similarCount.find(key);
+    return count != _similarCount.end() ? count->second : 0;
+}
+
+void CommandQueue::scheduleNext()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_queue.empty()) {
+        return;
+    }
+
+    const uint32_t now = millis();
+
+    // Commands waiting for too long are promoted to the control class, so
+    // that telemetry is not starved by a constant stream of control commands.
+    auto getEffectivePriority = [now](CommandAbstract* cmd) -> CommandPriority {
+        if (now - cmd->getEnqueueMillis() > COMMAND_STARVATION_TIMEOUT) {
+            return CommandPriority::Control;
+        }
+        return cmd->getPriority();
+    };
+
+    // Within the telemetry class, the inverter which was not served for the
+    // longest time wins. Commands for the same inverter keep their order.
+    // Control commands keep the order they were issued in, such that a batch
+    // of limit commands is sent back-to-back in the order of the DPL.
+    auto getIdleTime = [this, now](CommandAbstract* cmd) -> uint32_t {
+        auto it = _lastScheduled.find(cmd->getTargetAddress());
+        if (it == _lastScheduled.end()) {
+            return UINT32_MAX;
+        }
+        return now - it->second;
+    };
+
+    auto best = _queue.begin();
+    CommandPriority bestPriority = getEffectivePriority(best->get());
+    uint32_t bestIdleTime = getIdleTime(best->get());
+
+    for (auto it = _queue.begin() + 1; it != _queue.end(); ++it) {
+        const CommandPriority priority = getEffectivePriority(it->get());
+        const uint32_t idleTime = getIdleTime(it->get());
+
+        const bool fairer = priority == CommandPriority::Telemetry && idleTime > bestIdleTime;
+
+        if (priority < bestPriority || (priority == bestPriority && fairer)) {
+            best = it;
+            bestPriority = priority;
+            bestIdleTime = idleTime;
+        }
+    }
+
+    _lastScheduled[(*best)->getTargetAddress()] = now;
+
+    if (best != _queue.begin()) {
+        std::shared_ptr<CommandAbstract> cmd = *best;
+        _queue.erase(best);
+        _queue.push_front(cmd);
+    }
+}
+
+void CommandQueue::dumpStats(Print* stream) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto const& stats : _typeStats) {
+        if (stats.Key == 0) {
+            break;
+        }
+        const uint32_t avg = stats.Completed > 0 ? stats.DwellMsTotal / stats.Completed : 0;
+        stream->printf("    %s: depth %" PRIu16 " (max %" PRIu16 "), %" PRIu32 " dequeued, dwell avg %" PRIu32 " ms, max %" PRIu32 " ms\r\n",
+            stats.Name.c_str(), stats.Depth, stats.MaxDepth, stats.Completed, avg, stats.DwellMsMax);
+    }
 }
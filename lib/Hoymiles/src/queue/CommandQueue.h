@@ -2,16 +2,60 @@
 #pragma once
 
 #include "../commands/CommandAbstract.h"
+#include <Print.h>
 #include <ThreadSafeQueue.h>
+#include <array>
+#include <map>
 #include <memory>
+#include <optional>
+
+// Commands waiting longer than this are treated like control commands
+#define COMMAND_STARVATION_TIMEOUT 10000
 
 class InverterAbstract;
 
+// Keeps the number of queued commands per inverter and similarity key (see
+// CommandAbstract::getSimilarityKey()), such that the checks for duplicates
+// done for every new command do not need to scan the queue.
 class CommandQueue : public ThreadSafeQueue<std::shared_ptr<CommandAbstract>> {
 public:
+    void push(std::shared_ptr<CommandAbstract> cmd);
+    std::optional<std::shared_ptr<CommandAbstract>> pop();
+
     void removeAllEntriesForInverter(InverterAbstract* inv);
     void removeDuplicatedEntries(std::shared_ptr<CommandAbstract> cmd);
     void replaceEntries(std::shared_ptr<CommandAbstract> cmd);
 
     uint8_t countSimilarCommands(std::shared_ptr<CommandAbstract> cmd);
+
+    // Moves the command which shall be sent next to the front of the queue.
+    // Must only be called while no command is in flight.
+    void scheduleNext();
+
+    // Prints the depth and the time spent in the queue per command type
+    void dumpStats(Print* stream) const;
+
+private:
+    using index_key_t = std::pair<uint64_t, uint32_t>; // target address, similarity key
+
+    // Must be called with the mutex held
+    void track(CommandAbstract& cmd, const bool added);
+
+    // Entries are kept when dropping to zero, so that steady-state polling
+    // does not allocate map nodes.
+    std::map<index_key_t, uint8_t> _similarCount;
+
+    struct TypeStats {
+        uint32_t Key = 0; // zero if unused
+        String Name;
+        uint16_t Depth = 0;
+        uint16_t MaxDepth = 0;
+        uint32_t Completed = 0;
+        uint64_t DwellMsTotal = 0;
+        uint32_t DwellMsMax = 0;
+    };
+    std::array<TypeStats, 16> _typeStats;
+
+    // Timestamp (millis) when a command was last scheduled per inverter serial
+    std::map<uint64_t, uint32_t> _lastScheduled;
 };
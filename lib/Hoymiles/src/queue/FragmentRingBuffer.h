@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Fixed-size single producer single consumer ring buffer. push() and pop()
+// may be called from different contexts without additional locking as long
+// as there is only one producer and one consumer. One slot is kept free to
+// distinguish a full from an empty buffer.
+template <typename T, size_t N>
+class FragmentRingBuffer {
+public:
+    bool push(const T& item)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        const size_t next = (head + 1) % (N + 1);
+        if (next == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        _buffer[head] = item;
+        _head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = _buffer[tail];
+        _tail.store((tail + 1) % (N + 1), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+    }
+
+    bool full() const
+    {
+        const size_t next = (_head.load(std::memory_order_acquire) + 1) % (N + 1);
+        return next == _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, N + 1> _buffer;
+    std::atomic<size_t> _head = 0;
+    std::atomic<size_t> _tail = 0;
+};
@@ -3,6 +3,8 @@
  * Copyright (C) 2022 Thomas Basler and others
  */
 #include "MqttSubscribeParser.h"
+#include <algorithm>
+#include <cstring>
 
 void MqttSubscribeParser::register_callback(const std::string& topic, uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb)
 {
@@ -11,6 +13,8 @@ void MqttSubscribeParser::register_callback(const std::string& topic, uint8_t qo
     cbf.qos = qos;
     cbf.cb = cb;
     _callbacks.push_back(cbf);
+
+    rebuild();
 }
 
 void MqttSubscribeParser::unregister_callback(const std::string& topic)
@@ -22,18 +26,8 @@ void MqttSubscribeParser::unregister_callback(const std::string& topic)
             ++it;
         }
     }
-}
 
-void MqttSubscribeParser::handle_message(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total)
-{
-    bool result = false;
-    for (const auto& cb : _callbacks) {
-        if (mosquitto_topic_matches_sub(cb.topic.c_str(), topic, &result) == MOSQ_ERR_SUCCESS) {
-            if (result) {
-                cb.cb(properties, topic, payload, len, index, total);
-            }
-        }
-    }
+    rebuild();
 }
 
 std::vector<cb_filter_t> MqttSubscribeParser::get_callbacks()
@@ -41,131 +35,145 @@ std::vector<cb_filter_t> MqttSubscribeParser::get_callbacks()
     return _callbacks;
 }
 
-/* Does a topic match a subscription? */
-int MqttSubscribeParser::mosquitto_topic_matches_sub(const char* sub, const char* topic, bool* result)
+void MqttSubscribeParser::rebuild()
 {
-    size_t spos;
+    auto spRoot = std::make_shared<Node>();
 
-    if (!result)
-        return MOSQ_ERR_INVAL;
-    *result = false;
-
-    if (!sub || !topic || sub[0] == 0 || topic[0] == 0) {
-        return MOSQ_ERR_INVAL;
+    for (size_t i = 0; i < _callbacks.size(); ++i) {
+        // invalid subscriptions never match, as before
+        insert(*spRoot, _callbacks[i].topic, { i, _callbacks[i].cb });
     }
 
-    if ((sub[0] == '$' && topic[0] != '$')
-        || (topic[0] == '$' && sub[0] != '$')) {
+    std::atomic_store(&_spRoot, std::shared_ptr<const Node>(std::move(spRoot)));
+}
 
-        return MOSQ_ERR_SUCCESS;
+bool MqttSubscribeParser::insert(Node& root, const std::string& topic, Entry entry)
+{
+    if (topic.empty()) {
+        return false;
     }
 
-    spos = 0;
+    Node* node = &root;
+    size_t start = 0;
 
-    while (sub[0] != 0) {
-        if (topic[0] == '+' || topic[0] == '#') {
-            return MOSQ_ERR_INVAL;
+    while (true) {
+        size_t end = topic.find('/', start);
+        bool last = end == std::string::npos;
+        if (last) {
+            end = topic.size();
         }
-        if (sub[0] != topic[0] || topic[0] == 0) { /* Check for wildcard matches */
-            if (sub[0] == '+') {
-                /* Check for bad "+foo" or "a/+foo" subscription */
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                /* Check for bad "foo+" or "foo+/a" subscription */
-                if (sub[1] != 0 && sub[1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                spos++;
-                sub++;
-                while (topic[0] != 0 && topic[0] != '/') {
-                    if (topic[0] == '+' || topic[0] == '#') {
-                        return MOSQ_ERR_INVAL;
-                    }
-                    topic++;
-                }
-                if (topic[0] == 0 && sub[0] == 0) {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-            } else if (sub[0] == '#') {
-                /* Check for bad "foo#" subscription */
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                /* Check for # not the final character of the sub, e.g. "#foo" */
-                if (sub[1] != 0) {
-                    return MOSQ_ERR_INVAL;
-                } else {
-                    while (topic[0] != 0) {
-                        if (topic[0] == '+' || topic[0] == '#') {
-                            return MOSQ_ERR_INVAL;
-                        }
-                        topic++;
-                    }
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-            } else {
-                /* Check for e.g. foo/bar matching foo/+/# */
-                if (topic[0] == 0
-                    && spos > 0
-                    && sub[-1] == '+'
-                    && sub[0] == '/'
-                    && sub[1] == '#') {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-
-                /* There is no match at this point, but is the sub invalid? */
-                while (sub[0] != 0) {
-                    if (sub[0] == '#' && sub[1] != 0) {
-                        return MOSQ_ERR_INVAL;
-                    }
-                    spos++;
-                    sub++;
-                }
-
-                /* Valid input, but no match */
-                return MOSQ_ERR_SUCCESS;
+
+        std::string level = topic.substr(start, end - start);
+
+        if (level == "#") {
+            if (!last) {
+                return false;
             }
-        } else {
-            /* sub[spos] == topic[tpos] */
-            if (topic[1] == 0) {
-                /* Check for e.g. foo matching foo/# */
-                if (sub[1] == '/'
-                    && sub[2] == '#'
-                    && sub[3] == 0) {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
+            node->hash.push_back(std::move(entry));
+            return true;
+        }
+
+        if (level.find_first_of("+#") != std::string::npos && level != "+") {
+            return false;
+        }
+
+        if (level == "+") {
+            if (!node->plus) {
+                node->plus = std::make_unique<Node>();
             }
-            spos++;
-            sub++;
-            topic++;
-            if (sub[0] == 0 && topic[0] == 0) {
-                *result = true;
-                return MOSQ_ERR_SUCCESS;
-            } else if (topic[0] == 0 && sub[0] == '+' && sub[1] == 0) {
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                spos++;
-                sub++;
-                *result = true;
-                return MOSQ_ERR_SUCCESS;
+            node = node->plus.get();
+        } else {
+            auto& children = node->children;
+            auto it = std::lower_bound(children.begin(), children.end(), level,
+                [](const auto& child, const std::string& l) { return child.first < l; });
+            if (it == children.end() || it->first != level) {
+                it = children.emplace(it, level, std::make_unique<Node>());
             }
+            node = it->second.get();
+        }
+
+        if (last) {
+            node->exact.push_back(std::move(entry));
+            return true;
         }
+
+        start = end + 1;
     }
-    if ((topic[0] != 0 || sub[0] != 0)) {
-        *result = false;
+}
+
+MqttSubscribeParser::Node const* MqttSubscribeParser::findChild(Node const& node, const char* level, size_t len)
+{
+    auto const& children = node.children;
+
+    // compares like std::string::compare(), without creating a string
+    auto less = [](const auto& child, std::pair<const char*, size_t> l) {
+        int res = child.first.compare(0, std::string::npos, l.first, l.second);
+        return res < 0;
+    };
+
+    auto it = std::lower_bound(children.begin(), children.end(), std::make_pair(level, len), less);
+    if (it == children.end() || it->first.compare(0, std::string::npos, level, len) != 0) {
+        return nullptr;
+    }
+
+    return it->second.get();
+}
+
+// topic points to the current level, unless end is set, in which case all
+// levels were consumed. wildcards in the first level do not match topics
+// starting with '$', as mandated by the MQTT specification.
+void MqttSubscribeParser::match(Node const& node, const char* topic, bool end, bool first, bool system, std::vector<Entry const*>& result)
+{
+    bool wildcards = !(first && system);
+
+    // "foo/#" also matches "foo" itself
+    if (wildcards) {
+        for (auto const& entry : node.hash) {
+            result.push_back(&entry);
+        }
     }
-    while (topic[0] != 0) {
-        if (topic[0] == '+' || topic[0] == '#') {
-            return MOSQ_ERR_INVAL;
+
+    if (end) {
+        for (auto const& entry : node.exact) {
+            result.push_back(&entry);
         }
-        topic++;
+        return;
+    }
+
+    const char* separator = strchr(topic, '/');
+    size_t len = separator ? separator - topic : strlen(topic);
+    const char* next = separator ? separator + 1 : nullptr;
+    bool nextEnd = separator == nullptr;
+
+    auto pChild = findChild(node, topic, len);
+    if (pChild) {
+        match(*pChild, next, nextEnd, false, system, result);
     }
 
-    return MOSQ_ERR_SUCCESS;
+    if (wildcards && node.plus) {
+        match(*node.plus, next, nextEnd, false, system, result);
+    }
+}
+
+void MqttSubscribeParser::handle_message(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total)
+{
+    // topics of published messages must not contain wildcards
+    if (!topic || topic[0] == 0 || strpbrk(topic, "+#") != nullptr) {
+        return;
+    }
+
+    auto spRoot = std::atomic_load(&_spRoot);
+    if (!spRoot) {
+        return;
+    }
+
+    std::vector<Entry const*> matches;
+    match(*spRoot, topic, false, true, topic[0] == '$', matches);
+
+    std::sort(matches.begin(), matches.end(),
+        [](Entry const* a, Entry const* b) { return a->order < b->order; });
+
+    for (auto pEntry : matches) {
+        pEntry->cb(properties, topic, payload, len, index, total);
+    }
 }
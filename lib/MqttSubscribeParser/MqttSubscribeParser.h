@@ -3,7 +3,9 @@
 
 #include <cstdint>
 #include <espMqttClient.h>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 struct cb_filter_t {
@@ -12,6 +14,12 @@ struct cb_filter_t {
     espMqttClientTypes::OnMessageCallback cb;
 };
 
+// dispatches incoming messages to the callbacks of matching subscriptions.
+// the subscriptions are arranged in a trie of topic levels, which is rebuilt
+// whenever a subscription is added or removed, such that matching a topic
+// only takes as many lookups as the topic has levels (and wildcards).
+// the trie is immutable once built and replaced atomically, so messages can
+// be dispatched from the MQTT task while subscriptions change.
 class MqttSubscribeParser {
 public:
     void register_callback(const std::string& topic, uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb);
@@ -20,12 +28,24 @@ public:
     std::vector<cb_filter_t> get_callbacks();
 
 private:
-    int mosquitto_topic_matches_sub(const char* sub, const char* topic, bool* result);
-
-    std::vector<cb_filter_t> _callbacks;
+    struct Entry {
+        size_t order; // callbacks are invoked in the order they were registered
+        espMqttClientTypes::OnMessageCallback cb;
+    };
 
-    enum mosq_err_t {
-        MOSQ_ERR_SUCCESS = 0,
-        MOSQ_ERR_INVAL = 3,
+    struct Node {
+        // sorted by level, such that no string is created to look up a level
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> children;
+        std::unique_ptr<Node> plus; // single-level wildcard
+        std::vector<Entry> exact; // subscriptions ending at this level
+        std::vector<Entry> hash; // subscriptions ending in a multi-level wildcard
     };
-};
\ No newline at end of file
+
+    void rebuild();
+    static bool insert(Node& root, const std::string& topic, Entry entry);
+    static Node const* findChild(Node const& node, const char* level, size_t len);
+    static void match(Node const& node, const char* topic, bool end, bool first, bool system, std::vector<Entry const*>& result);
+
+    std::vector<cb_filter_t> _callbacks;
+    std::shared_ptr<const Node> _spRoot;
+};
@@ -40,22 +40,7 @@ char logBuff[200];
   } while (0)
 #endif
 
-#define MAX_LIST_SIZE 80
-#define MAX_TREE_SIZE 10
-
-static sml_states_t currentState = SML_START;
-static char nodes[MAX_TREE_SIZE];
-static unsigned char currentLevel = 0;
-static unsigned short crc = 0xFFFF;
-static signed char sc;
-static unsigned short crcMine = 0xFFFF;
-static unsigned short crcReceived = 0x0000;
-static unsigned char len = 4;
-static unsigned char listBuffer[MAX_LIST_SIZE]; /* keeps a list
-                                                   as length + state + data  */
-static unsigned char listPos = 0;
-
-void crc16(unsigned char &byte)
+void SmlParser::crc16(unsigned char &byte)
 {
 #ifdef ARDUINO
   crc =
@@ -65,26 +50,26 @@ void crc16(unsigned char &byte)
 #endif
 }
 
-void setState(sml_states_t state, int byteLen)
+void SmlParser::setState(sml_states_t state, int byteLen)
 {
   currentState = state;
   len = byteLen;
 }
 
-void pushListBuffer(unsigned char byte)
+void SmlParser::pushListBuffer(unsigned char byte)
 {
   if (listPos < MAX_LIST_SIZE) {
     listBuffer[listPos++] = byte;
   }
 }
 
-void reduceList()
+void SmlParser::reduceList()
 {
   if (currentLevel < MAX_TREE_SIZE && nodes[currentLevel] > 0)
     nodes[currentLevel]--;
 }
 
-void smlNewList(unsigned char size)
+void SmlParser::smlNewList(unsigned char size)
 {
   reduceList();
   if (currentLevel < MAX_TREE_SIZE)
@@ -104,7 +89,7 @@ void smlNewList(unsigned char size)
   }
 }
 
-void checkMagicByte(unsigned char &byte)
+void SmlParser::checkMagicByte(unsigned char &byte)
 {
   unsigned int size = 0;
   while (currentLevel > 0 && nodes[currentLevel] == 0) {
@@ -189,13 +174,13 @@ void checkMagicByte(unsigned char &byte)
   }
 }
 
-void smlReset(void)
+void SmlParser::reset(void)
 {
   len = 4; // expect start sequence
   currentState = SML_START;
 }
 
-sml_states_t smlState(unsigned char currentByte)
+sml_states_t SmlParser::state(unsigned char currentByte)
 {
   unsigned char size;
   if (len > 0)
@@ -301,12 +286,21 @@ sml_states_t smlState(unsigned char currentByte)
   return currentState;
 }
 
-bool smlOBISCheck(const unsigned char *obis)
+bool SmlParser::getObis(uint64_t &obis) const
 {
-  return (memcmp(obis, &listBuffer[2], 6) == 0);
+  /* length and state of the first list entry, followed by the OBIS code */
+  if (listPos < 8 || listBuffer[0] != 6) {
+    return false;
+  }
+
+  obis = 0;
+  for (int i = 2; i < 8; i++) {
+    obis = (obis << 8) | listBuffer[i];
+  }
+  return true;
 }
 
-void smlOBISManufacturer(unsigned char *str, int maxSize)
+void SmlParser::getManufacturer(unsigned char *str, int maxSize) const
 {
   int i = 0, pos = 0, size = 0;
   while (i < listPos) {
@@ -323,7 +317,7 @@ void smlOBISManufacturer(unsigned char *str, int maxSize)
   }
 }
 
-void smlPow(float &val, signed char &scaler)
+static void smlPow(float &val, signed char scaler)
 {
   if (scaler < 0) {
     while (scaler++) {
@@ -337,11 +331,11 @@ void smlPow(float &val, signed char &scaler)
   }
 }
 
-void smlOBISByUnit(long long int &val, signed char &scaler, sml_units_t unit)
+bool SmlParser::getValue(sml_units_t unit, long long int &mantissa, signed char &scaler) const
 {
+  scaler = 0;
   unsigned char i = 0, pos = 0, size = 0, y = 0, skip = 0;
   sml_states_t type;
-  val = -1; /* unknown or error */
   while (i < listPos) {
     pos++;
     size = (int)listBuffer[i++];
@@ -358,70 +352,35 @@ void smlOBISByUnit(long long int &val, signed char &scaler, sml_units_t unit)
       size = 0;
     }
     if (pos == 4 && listBuffer[i] != unit) {
-      /* return unknown (-1) if unit does not match */
-      return;
+      /* unit does not match */
+      return false;
     }
     if (pos == 5) {
       scaler = listBuffer[i];
     }
     if (pos == 6) {
-      y = size;
       // initialize 64bit signed integer based on MSB from received value
-      val =
+      mantissa =
           (type == SML_DATA_SIGNED_INT && (listBuffer[i] & (1 << 7))) ? ~0 : 0;
       for (y = 0; y < size; y++) {
         // left shift received bytes to 64 bit signed integer
-        val = (val << 8) | listBuffer[i + y];
+        mantissa = (mantissa << 8) | listBuffer[i + y];
       }
+      return true;
     }
     i += size;
   }
+  return false;
 }
 
-void smlOBISWh(float &wh)
-{
-  long long int val;
-  smlOBISByUnit(val, sc, SML_WATT_HOUR);
-  wh = val;
-  smlPow(wh, sc);
-}
-
-void smlOBISW(float &w)
-{
-  long long int val;
-  smlOBISByUnit(val, sc, SML_WATT);
-  w = val;
-  smlPow(w, sc);
-}
-
-void smlOBISVolt(float &v)
+bool SmlParser::getValue(sml_units_t unit, float &value) const
 {
-  long long int val;
-  smlOBISByUnit(val, sc, SML_VOLT);
-  v = val;
-  smlPow(v, sc);
-}
-
-void smlOBISAmpere(float &a)
-{
-  long long int val;
-  smlOBISByUnit(val, sc, SML_AMPERE);
-  a = val;
-  smlPow(a, sc);
-}
-
-void smlOBISHertz(float &h)
-{
-  long long int val;
-  smlOBISByUnit(val, sc, SML_HERTZ);
-  h = val;
-  smlPow(h, sc);
-}
-
-void smlOBISDegree(float &d)
-{
-  long long int val;
-  smlOBISByUnit(val, sc, SML_DEGREE);
-  d = val;
-  smlPow(d, sc);
+  long long int mantissa = 0;
+  signed char scaler = 0;
+  if (!getValue(unit, mantissa, scaler)) {
+    return false;
+  }
+  value = mantissa;
+  smlPow(value, scaler);
+  return true;
 }
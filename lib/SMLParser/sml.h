@@ -2,6 +2,7 @@
 #define SML_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum {
   SML_START,
@@ -92,17 +93,47 @@ typedef enum {
   SML_COUNT = 255
 } sml_units_t;
 
-void smlReset(void);
-sml_states_t smlState(unsigned char byte);
-bool smlOBISCheck(const unsigned char *obis);
-void smlOBISManufacturer(unsigned char *str, int maxSize);
-void smlOBISByUnit(long long int &wh, signed char &scaler, sml_units_t unit);
+/* reentrant SML stream parser. all state is kept per instance, so multiple
+ * meters can be decoded concurrently. no heap memory is used. */
+class SmlParser {
+public:
+  void reset(void);
+  sml_states_t state(unsigned char byte);
 
-void smlOBISWh(float &wh);
-void smlOBISW(float &w);
-void smlOBISVolt(float &v);
-void smlOBISAmpere(float &a);
-void smlOBISHertz(float &h);
-void smlOBISDegree(float &d);
+  /* OBIS code of the list that was just completed (SML_LISTEND), packed
+   * as a big endian 48 bit integer. returns false if there is none. */
+  bool getObis(uint64_t &obis) const;
+
+  /* value of the completed list if its unit matches, scaled by the
+   * scaler transmitted along with the value. */
+  bool getValue(sml_units_t unit, float &value) const;
+
+  /* same as above, but the value is mantissa * 10^scaler as transmitted. */
+  bool getValue(sml_units_t unit, long long int &mantissa, signed char &scaler) const;
+
+  void getManufacturer(unsigned char *str, int maxSize) const;
+
+private:
+  static constexpr unsigned char MAX_LIST_SIZE = 80;
+  static constexpr unsigned char MAX_TREE_SIZE = 10;
+
+  void crc16(unsigned char &byte);
+  void setState(sml_states_t state, int byteLen);
+  void pushListBuffer(unsigned char byte);
+  void reduceList();
+  void smlNewList(unsigned char size);
+  void checkMagicByte(unsigned char &byte);
+
+  sml_states_t currentState = SML_START;
+  char nodes[MAX_TREE_SIZE] = {};
+  unsigned char currentLevel = 0;
+  unsigned short crc = 0xFFFF;
+  unsigned short crcMine = 0xFFFF;
+  unsigned short crcReceived = 0x0000;
+  unsigned char len = 4;
+  unsigned char listBuffer[MAX_LIST_SIZE] = {}; /* keeps a list
+                                                   as length + state + data */
+  unsigned char listPos = 0;
+};
 
 #endif
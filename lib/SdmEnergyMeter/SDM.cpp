@@ -113,6 +113,89 @@ float SDM::readVal(uint16_t reg, uint8_t node) {
   return (res);
 }
 
+uint16_t SDM::readVals(uint16_t reg, uint8_t count, float* values, uint8_t node) {
+  if (count == 0 || count > SDM_MAX_BATCH_VALUES) {
+    return SDM_ERR_ILLEGAL_DATA_VALUE;
+  }
+
+  const uint16_t points = count * 2;                                            //  each value spans two registers
+
+  uint8_t data[] = {
+    node,                     // Address
+    SDM_READ_INPUT_REGISTER,  // Modbus function
+    highByte(reg),            // Start address high byte
+    lowByte(reg),             // Start address low byte
+    highByte(points),         // Number of points high byte
+    lowByte(points),          // Number of points low byte
+    0,                        // Checksum low byte
+    0};                       // Checksum high byte
+
+  constexpr size_t messageLength = sizeof(data) / sizeof(data[0]);
+  modbusWrite(data, messageLength);
+
+  uint8_t reply[5 + SDM_MAX_BATCH_VALUES * 4];
+  const size_t expected = 5 + count * 4;                                        //  address, function, byte count, data, crc
+  size_t received = 0;
+  uint16_t readErr = SDM_ERR_NO_ERROR;
+
+  // collect the reply while it arrives, as it may not fit into the serial rx buffer at once
+  while (received < expected) {
+    while (sdmSer.available() > 0 && received < expected) {
+      reply[received++] = sdmSer.read();
+    }
+
+    if (received == expected) {
+      break;
+    }
+
+    if (received == 5 && (reply[1] & 0x80) && validChecksum(reply, 5)) {       //  exception response
+      readErr = reply[2];
+      break;
+    }
+
+    if ((millis() - resptime) > msturnaround) {
+      readErr = SDM_ERR_TIMEOUT;
+      break;
+    }
+
+    delay(1);
+  }
+
+  if (readErr == SDM_ERR_NO_ERROR) {
+    if (reply[0] != node ||
+        reply[1] != SDM_READ_INPUT_REGISTER ||
+        reply[2] != count * 4) {
+      readErr = SDM_ERR_WRONG_BYTES;
+    } else if (!validChecksum(reply, expected)) {
+      readErr = SDM_ERR_CRC_ERROR;
+    }
+  }
+
+  flush(mstimeout);                                                             //read serial if any old data is available and wait for RESPONSE_TIMEOUT (in ms)
+
+  if (sdmSer.available())                                                       //if serial rx buffer (after RESPONSE_TIMEOUT) still contains data then something spam rs485, check node(s) or increase RESPONSE_TIMEOUT
+    readErr = SDM_ERR_TIMEOUT;
+
+  if (readErr != SDM_ERR_NO_ERROR) {
+    readingerrcode = readErr;
+    readingerrcount++;
+    return readErr;
+  }
+
+  ++readingsuccesscount;
+
+  for (uint8_t i = 0; i < count; i++) {
+    const uint8_t* src = &reply[3 + i * 4];
+    uint8_t* dst = (uint8_t*)&values[i];
+    dst[3] = src[0];
+    dst[2] = src[1];
+    dst[1] = src[2];
+    dst[0] = src[3];
+  }
+
+  return SDM_ERR_NO_ERROR;
+}
+
 void SDM::startReadVal(uint16_t reg, uint8_t node, uint8_t functionCode) {
   uint8_t data[] = {
     node,             // Address
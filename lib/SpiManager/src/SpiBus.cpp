@@ -38,9 +38,9 @@ SpiBus::~SpiBus()
     ESP_ERROR_CHECK(spi_bus_free(host_device));
 }
 
-spi_device_handle_t SpiBus::add_device(const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config)
+spi_device_handle_t SpiBus::add_device(const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* device_name)
 {
-    if (!SpiCallback::patch(shared_from_this(), bus_config, device_config))
+    if (!SpiCallback::patch(shared_from_this(), bus_config, device_config, device_name))
         return nullptr;
 
     spi_device_handle_t device;
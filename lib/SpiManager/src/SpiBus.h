@@ -38,7 +38,7 @@ public:
         return host_device;
     }
 
-    spi_device_handle_t add_device(const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config);
+    spi_device_handle_t add_device(const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* device_name = "");
 
 private:
     void apply_config(SpiBusConfig* config);
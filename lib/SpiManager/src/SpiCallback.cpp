@@ -2,6 +2,8 @@
 #include "SpiCallback.h"
 
 #include "SpiBus.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
 #include <array>
 #include <optional>
 
@@ -12,14 +14,24 @@ namespace {
         std::shared_ptr<SpiBusConfig> config;
         transaction_cb_t inner_pre_cb;
         transaction_cb_t inner_post_cb;
+
+        std::string name;
+        int64_t start_us;
+        uint32_t transactions;
+        uint64_t busy_us;
+        uint32_t max_us;
     };
 
     std::array<std::optional<CallbackData>, SPI_MANAGER_CALLBACK_COUNT> instances;
 
+    // the callbacks are called from the SPI interrupt for queued transactions
+    portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
     template <int N>
     void IRAM_ATTR fn_pre_cb(spi_transaction_t* trans)
     {
         instances[N]->bus->require_config(instances[N]->config.get());
+        instances[N]->start_us = esp_timer_get_time();
         if (instances[N]->inner_pre_cb)
             instances[N]->inner_pre_cb(trans);
     }
@@ -29,6 +41,14 @@ namespace {
     {
         if (instances[N]->inner_post_cb)
             instances[N]->inner_post_cb(trans);
+
+        uint32_t duration = esp_timer_get_time() - instances[N]->start_us;
+        portENTER_CRITICAL_SAFE(&stats_mux);
+        instances[N]->transactions++;
+        instances[N]->busy_us += duration;
+        if (duration > instances[N]->max_us)
+            instances[N]->max_us = duration;
+        portEXIT_CRITICAL_SAFE(&stats_mux);
     }
 
     template <int N>
@@ -49,7 +69,7 @@ namespace {
     }
 }
 
-bool patch(const std::shared_ptr<SpiBus>& bus, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config)
+bool patch(const std::shared_ptr<SpiBus>& bus, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* device_name)
 {
     CallbackData* instance;
     transaction_cb_t pre_cb;
@@ -61,9 +81,34 @@ bool patch(const std::shared_ptr<SpiBus>& bus, const std::shared_ptr<SpiBusConfi
     instance->config = bus_config;
     instance->inner_pre_cb = device_config.pre_cb;
     instance->inner_post_cb = device_config.post_cb;
+    instance->name = device_name;
+    instance->start_us = 0;
+    instance->transactions = 0;
+    instance->busy_us = 0;
+    instance->max_us = 0;
     device_config.pre_cb = pre_cb;
     device_config.post_cb = post_cb;
 
     return true;
 }
+
+std::vector<DeviceStats> get_stats()
+{
+    std::vector<DeviceStats> stats;
+    for (auto const& instance : instances) {
+        if (!instance)
+            continue;
+
+        DeviceStats entry;
+        entry.name = instance->name;
+        entry.host_device = instance->bus->get_host_device();
+        portENTER_CRITICAL(&stats_mux);
+        entry.transactions = instance->transactions;
+        entry.busy_us = instance->busy_us;
+        entry.max_us = instance->max_us;
+        portEXIT_CRITICAL(&stats_mux);
+        stats.push_back(std::move(entry));
+    }
+    return stats;
+}
 }
@@ -3,6 +3,8 @@
 
 #include <driver/spi_master.h>
 #include <memory>
+#include <string>
+#include <vector>
 
 // Pre and post callbacks for 2 buses with 3 devices each
 #define SPI_MANAGER_CALLBACK_COUNT 6
@@ -11,5 +13,16 @@ class SpiBus;
 class SpiBusConfig;
 
 namespace SpiCallback {
-bool patch(const std::shared_ptr<SpiBus>& bus, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config);
+bool patch(const std::shared_ptr<SpiBus>& bus, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* device_name);
+
+// every transaction of a device is accounted in its callbacks
+struct DeviceStats {
+    std::string name;
+    spi_host_device_t host_device;
+    uint32_t transactions;
+    uint64_t busy_us; // time between pre and post callback
+    uint32_t max_us;
+};
+
+std::vector<DeviceStats> get_stats();
 }
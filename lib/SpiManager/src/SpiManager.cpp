@@ -76,13 +76,18 @@ std::optional<uint8_t> SpiManager::claim_bus_arduino()
 
 #endif
 
-spi_device_handle_t SpiManager::alloc_device(const std::string& bus_id, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config)
+spi_device_handle_t SpiManager::alloc_device(const std::string& bus_id, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* device_name)
 {
     std::shared_ptr<SpiBus> shared_bus = get_shared_bus(bus_id);
     if (!shared_bus)
         return nullptr;
 
-    return shared_bus->add_device(bus_config, device_config);
+    return shared_bus->add_device(bus_config, device_config, device_name);
+}
+
+std::vector<SpiCallback::DeviceStats> SpiManager::get_device_stats() const
+{
+    return SpiCallback::get_stats();
 }
 
 std::shared_ptr<SpiBus> SpiManager::get_shared_bus(const std::string& bus_id)
@@ -3,6 +3,7 @@
 
 #include "SpiBus.h"
 #include "SpiBusConfig.h"
+#include "SpiCallback.h"
 
 #include <driver/spi_master.h>
 
@@ -29,7 +30,10 @@ public:
     std::optional<uint8_t> claim_bus_arduino();
 #endif
 
-    spi_device_handle_t alloc_device(const std::string& bus_id, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config);
+    spi_device_handle_t alloc_device(const std::string& bus_id, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config, const char* device_name = "");
+
+    // transaction statistics of the devices on shared buses
+    std::vector<SpiCallback::DeviceStats> get_device_stats() const;
 
 private:
     std::shared_ptr<SpiBus> get_shared_bus(const std::string& bus_id);
@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// A FIFO queue with a fixed capacity, backed by a ring buffer, such that
+// pushing and popping never allocates. Items are moved in and out.
+//
+// A single consumer task may block in pop_wait() until an item arrives. It
+// is woken by a task notification, so that task must not wait for other
+// notifications while using pop_wait().
+template <typename T, size_t N>
+class BoundedThreadSafeQueue {
+    static_assert(N > 0, "the capacity must not be zero");
+
+public:
+    enum class OverflowPolicy {
+        Reject, // the new item is not queued
+        DropOldest // the oldest item is discarded to make room
+    };
+
+    explicit BoundedThreadSafeQueue(OverflowPolicy policy = OverflowPolicy::Reject)
+        : _policy(policy)
+    {
+    }
+
+    BoundedThreadSafeQueue(const BoundedThreadSafeQueue&) = delete;
+    BoundedThreadSafeQueue& operator=(const BoundedThreadSafeQueue&) = delete;
+
+    static constexpr size_t capacity() { return N; }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _count;
+    }
+
+    // the highest number of items queued at the same time
+    size_t highWaterMark() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _highWater;
+    }
+
+    // the number of items rejected or discarded due to overflows
+    uint32_t overflows() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _overflows;
+    }
+
+    // returns false if the item was rejected. with the DropOldest policy, a
+    // full queue discards its oldest item instead and true is returned.
+    bool try_push(T&& item)
+    {
+        TaskHandle_t waiter = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (_count == N) {
+                _overflows++;
+                if (_policy == OverflowPolicy::Reject) {
+                    return false;
+                }
+                _items[_head] = T();
+                _head = (_head + 1) % N;
+                _count--;
+            }
+
+            _items[(_head + _count) % N] = std::move(item);
+            _count++;
+            if (_count > _highWater) {
+                _highWater = _count;
+            }
+
+            waiter = _waiter;
+        }
+
+        if (waiter != nullptr) {
+            xTaskNotifyGive(waiter);
+        }
+
+        return true;
+    }
+
+    bool try_push(const T& item)
+    {
+        T copy = item;
+        return try_push(std::move(copy));
+    }
+
+    std::optional<T> pop()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return take();
+    }
+
+    // waits up to the timeout for an item, must only be called by a single
+    // consumer task
+    std::optional<T> pop_wait(TickType_t timeout)
+    {
+        TickType_t start = xTaskGetTickCount();
+
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                auto item = take();
+                if (item.has_value() || timeout == 0) {
+                    _waiter = nullptr;
+                    return item;
+                }
+                _waiter = xTaskGetCurrentTaskHandle();
+            }
+
+            // a notification given between releasing the mutex and waiting
+            // is still pending, so it is not missed.
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= timeout) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _waiter = nullptr;
+                return take();
+            }
+
+            ulTaskNotifyTake(pdTRUE, timeout - elapsed);
+        }
+    }
+
+private:
+    // must be called with the mutex held
+    std::optional<T> take()
+    {
+        if (_count == 0) {
+            return {};
+        }
+
+        T item = std::move(_items[_head]);
+        _items[_head] = T(); // releases resources held by the moved-from item
+        _head = (_head + 1) % N;
+        _count--;
+        return item;
+    }
+
+    const OverflowPolicy _policy;
+
+    std::array<T, N> _items = {};
+    size_t _head = 0;
+    size_t _count = 0;
+    size_t _highWater = 0;
+    uint32_t _overflows = 0;
+
+    TaskHandle_t _waiter = nullptr;
+
+    mutable std::mutex _mutex;
+};
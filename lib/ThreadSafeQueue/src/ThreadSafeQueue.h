@@ -4,6 +4,7 @@
 #include <mutex>
 #include <optional>
 #include <deque>
+#include <utility>
 
 template <typename T>
 class ThreadSafeQueue {
@@ -32,7 +33,7 @@ public:
         if (_queue.empty()) {
             return {};
         }
-        T tmp = _queue.front();
+        T tmp = std::move(_queue.front());
         _queue.pop_front();
         return tmp;
     }
@@ -43,6 +44,12 @@ public:
         _queue.push_back(item);
     }
 
+    void push(T&& item)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(std::move(item));
+    }
+
     T front()
     {
         std::lock_guard<std::mutex> lock(_mutex);
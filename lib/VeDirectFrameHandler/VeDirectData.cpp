@@ -1,4 +1,6 @@
 #include "VeDirectData.h"
+#include <frozen/unordered_map.h>
+#include <cstring>
 
 template<typename T, size_t L>
 static frozen::string const& getAsString(frozen::map<T, frozen::string, L> const& values, T val)
@@ -351,3 +353,79 @@ frozen::string const& VeDirectHexData::getRegisterAsString() const
 
 	return getAsString(values, addr);
 }
+
+static constexpr frozen::unordered_map<frozen::string, VeDirectTextLabel, 50> textLabels = {
+	{ "PID", VeDirectTextLabel::ProductId },
+	{ "SER", VeDirectTextLabel::SerialNumber },
+	{ "FW", VeDirectTextLabel::Firmware },
+	{ "FWE", VeDirectTextLabel::FirmwareExt },
+	{ "V", VeDirectTextLabel::BatteryVoltage },
+	{ "I", VeDirectTextLabel::BatteryCurrent },
+	{ "IL", VeDirectTextLabel::LoadCurrent },
+	{ "LOAD", VeDirectTextLabel::LoadOutputState },
+	{ "RELAY", VeDirectTextLabel::RelayState },
+	{ "CS", VeDirectTextLabel::CurrentState },
+	{ "ERR", VeDirectTextLabel::ErrorCode },
+	{ "OR", VeDirectTextLabel::OffReason },
+	{ "MPPT", VeDirectTextLabel::TrackerState },
+	{ "HSDS", VeDirectTextLabel::DaySequenceNr },
+	{ "VPV", VeDirectTextLabel::PanelVoltage },
+	{ "PPV", VeDirectTextLabel::PanelPower },
+	{ "H19", VeDirectTextLabel::YieldTotal },
+	{ "H20", VeDirectTextLabel::YieldToday },
+	{ "H21", VeDirectTextLabel::MaxPowerToday },
+	{ "H22", VeDirectTextLabel::YieldYesterday },
+	{ "H23", VeDirectTextLabel::MaxPowerYesterday },
+	{ "T", VeDirectTextLabel::Temperature },
+	{ "P", VeDirectTextLabel::Power },
+	{ "CE", VeDirectTextLabel::ConsumedAmpHours },
+	{ "SOC", VeDirectTextLabel::StateOfCharge },
+	{ "TTG", VeDirectTextLabel::TimeToGo },
+	{ "ALARM", VeDirectTextLabel::Alarm },
+	{ "AR", VeDirectTextLabel::AlarmReason },
+	{ "H1", VeDirectTextLabel::DeepestDischarge },
+	{ "H2", VeDirectTextLabel::LastDischarge },
+	{ "H3", VeDirectTextLabel::AverageDischarge },
+	{ "H4", VeDirectTextLabel::ChargeCycles },
+	{ "H5", VeDirectTextLabel::FullDischarges },
+	{ "H6", VeDirectTextLabel::CumulativeAmpHours },
+	{ "H7", VeDirectTextLabel::MinVoltage },
+	{ "H8", VeDirectTextLabel::MaxVoltage },
+	{ "H9", VeDirectTextLabel::SecondsSinceFullCharge },
+	{ "H10", VeDirectTextLabel::AutoSynchronizations },
+	{ "H11", VeDirectTextLabel::LowVoltageAlarms },
+	{ "H12", VeDirectTextLabel::HighVoltageAlarms },
+	{ "H13", VeDirectTextLabel::LowAuxVoltageAlarms },
+	{ "H14", VeDirectTextLabel::HighAuxVoltageAlarms },
+	{ "H15", VeDirectTextLabel::MinAuxVoltage },
+	{ "H16", VeDirectTextLabel::MaxAuxVoltage },
+	{ "H17", VeDirectTextLabel::DischargedEnergy },
+	{ "H18", VeDirectTextLabel::ChargedEnergy },
+	{ "VM", VeDirectTextLabel::MidPointVoltage },
+	{ "DM", VeDirectTextLabel::MidPointDeviation },
+	{ "BMV", VeDirectTextLabel::BmvModel },
+	{ "MON", VeDirectTextLabel::DcMonitorMode }
+};
+
+/*
+ * This function looks up the label of a text record using a perfect hash.
+ */
+VeDirectTextLabel getVeDirectTextLabel(char const* name)
+{
+	auto pos = textLabels.find(frozen::string(name, strlen(name)));
+	if (pos == textLabels.end()) { return VeDirectTextLabel::Unknown; }
+	return pos->second;
+}
+
+/*
+ * This function returns the name of a text record's label, used for logging.
+ */
+frozen::string const& getVeDirectTextLabelName(VeDirectTextLabel label)
+{
+	for (auto const& entry : textLabels) {
+		if (entry.second == label) { return entry.first; }
+	}
+
+	static constexpr frozen::string dummy("???");
+	return dummy;
+}
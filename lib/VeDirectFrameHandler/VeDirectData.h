@@ -6,6 +6,8 @@
 
 #define VE_MAX_VALUE_LEN 33 // VE.Direct Protocol: max value size is 33 including /0
 #define VE_MAX_HEX_LEN 100 // Maximum size of hex frame - max payload 34 byte (=68 char) + safe buffer
+#define VE_MAX_TEXT_RECORDS 32 // Maximum number of records of a text frame, the protocol specifies 22
+#define VE_MAX_TEXT_VALUES 256 // Buffer for the values of all records of a text frame
 
 typedef struct {
     uint16_t productID_PID = 0;             // product id
@@ -98,6 +100,66 @@ struct veShuntStruct : veStruct {
     int8_t dcMonitorMode_MON;       // DC monitor mode
 };
 
+// labels of records in text frames. the comments name the label as sent by
+// the device (converted to uppercase).
+enum class VeDirectTextLabel : uint8_t {
+    Unknown = 0,
+    ProductId,              // PID
+    SerialNumber,           // SER
+    Firmware,               // FW
+    FirmwareExt,            // FWE
+    BatteryVoltage,         // V
+    BatteryCurrent,         // I
+    LoadCurrent,            // IL
+    LoadOutputState,        // LOAD
+    RelayState,             // RELAY
+    CurrentState,           // CS
+    ErrorCode,              // ERR
+    OffReason,              // OR
+    TrackerState,           // MPPT
+    DaySequenceNr,          // HSDS
+    PanelVoltage,           // VPV
+    PanelPower,             // PPV
+    YieldTotal,             // H19
+    YieldToday,             // H20
+    MaxPowerToday,          // H21
+    YieldYesterday,         // H22
+    MaxPowerYesterday,      // H23
+    Temperature,            // T
+    Power,                  // P
+    ConsumedAmpHours,       // CE
+    StateOfCharge,          // SOC
+    TimeToGo,               // TTG
+    Alarm,                  // ALARM
+    AlarmReason,            // AR
+    DeepestDischarge,       // H1
+    LastDischarge,          // H2
+    AverageDischarge,       // H3
+    ChargeCycles,           // H4
+    FullDischarges,         // H5
+    CumulativeAmpHours,     // H6
+    MinVoltage,             // H7
+    MaxVoltage,             // H8
+    SecondsSinceFullCharge, // H9
+    AutoSynchronizations,   // H10
+    LowVoltageAlarms,       // H11
+    HighVoltageAlarms,      // H12
+    LowAuxVoltageAlarms,    // H13
+    HighAuxVoltageAlarms,   // H14
+    MinAuxVoltage,          // H15
+    MaxAuxVoltage,          // H16
+    DischargedEnergy,       // H17
+    ChargedEnergy,          // H18
+    MidPointVoltage,        // VM
+    MidPointDeviation,      // DM
+    BmvModel,               // BMV
+    DcMonitorMode           // MON
+};
+
+// looks up the label of a text record by its (uppercase) name
+VeDirectTextLabel getVeDirectTextLabel(char const* name);
+frozen::string const& getVeDirectTextLabelName(VeDirectTextLabel label);
+
 enum class VeDirectHexCommand : uint8_t {
     ENTER_BOOT = 0x0,
     PING = 0x1,
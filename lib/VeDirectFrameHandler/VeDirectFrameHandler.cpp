@@ -56,17 +56,20 @@ VeDirectFrameHandler<T>::VeDirectFrameHandler() :
 	_hexSize(0),
 	_name(""),
 	_value(""),
+	_label(VeDirectTextLabel::Unknown),
 	_debugIn(0),
-	_lastByteMillis(0)
+	_lastByteMillis(0),
+	_textRecordCount(0),
+	_textValuesLength(0),
+	_textDataOverflow(false)
 {
 }
 
 template<typename T>
 void VeDirectFrameHandler<T>::init(char const* who, int8_t rx, int8_t tx,
-		Print* msgOut, bool verboseLogging, uint8_t hwSerialPort)
+		Print* msgOut, bool verboseLogging, std::unique_ptr<HardwareSerial> upSerial)
 {
-	_vedirectSerial = std::make_unique<HardwareSerial>(hwSerialPort);
-	_vedirectSerial->setRxBufferSize(512); // increased from default (256) to 512 Byte to avoid overflow
+	_vedirectSerial = std::move(upSerial);
 	_vedirectSerial->end(); // make sure the UART will be re-initialized
 	_vedirectSerial->begin(19200, SERIAL_8N1, rx, tx);
 	_vedirectSerial->flush();
@@ -74,10 +77,21 @@ void VeDirectFrameHandler<T>::init(char const* who, int8_t rx, int8_t tx,
 	_msgOut = msgOut;
 	_verboseLogging = verboseLogging;
 	_debugIn = 0;
+	if (_verboseLogging && !_upDebugBuffer) {
+		_upDebugBuffer.reset(static_cast<uint8_t*>(heap_caps_malloc_prefer(_debugBufferSize, 2,
+				MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_DEFAULT)));
+	}
 	snprintf(_logId, sizeof(_logId), "[VE.Direct %s %d/%d]", who, rx, tx);
 	if (_verboseLogging) { _msgOut->printf("%s init complete\r\n", _logId); }
 }
 
+template<typename T>
+void VeDirectFrameHandler<T>::onReceive(std::function<void()> cb)
+{
+	if (!_vedirectSerial) { return; }
+	_vedirectSerial->onReceive(std::move(cb));
+}
+
 template<typename T>
 void VeDirectFrameHandler<T>::dumpDebugBuffer() {
 	_msgOut->printf("%s serial input (%d Bytes):", _logId, _debugIn);
@@ -85,7 +99,7 @@ void VeDirectFrameHandler<T>::dumpDebugBuffer() {
 		if (i % 16 == 0) {
 			_msgOut->printf("\r\n%s", _logId);
 		}
-		_msgOut->printf(" %02x", _debugBuffer[i]);
+		_msgOut->printf(" %02x", _upDebugBuffer[i]);
 	}
 	_msgOut->println("");
 	_debugIn = 0;
@@ -96,7 +110,9 @@ void VeDirectFrameHandler<T>::reset()
 {
 	_checksum = 0;
 	_state = State::IDLE;
-	_textData.clear();
+	_textRecordCount = 0;
+	_textValuesLength = 0;
+	_textDataOverflow = false;
 }
 
 template<typename T>
@@ -126,9 +142,9 @@ void VeDirectFrameHandler<T>::loop()
 template<typename T>
 void VeDirectFrameHandler<T>::rxData(uint8_t inbyte)
 {
-	if (_verboseLogging) {
-		_debugBuffer[_debugIn] = inbyte;
-		_debugIn = (_debugIn + 1) % _debugBuffer.size();
+	if (_verboseLogging && _upDebugBuffer) {
+		_upDebugBuffer[_debugIn] = inbyte;
+		_debugIn = (_debugIn + 1) % _debugBufferSize;
 		if (0 == _debugIn) {
 			_msgOut->printf("%s ERROR: debug buffer overrun!\r\n", _logId);
 		}
@@ -172,6 +188,10 @@ void VeDirectFrameHandler<T>::rxData(uint8_t inbyte)
 					_state = State::CHECKSUM;
 					break;
 				}
+				_label = getVeDirectTextLabel(_name);
+			}
+			else {
+				_label = VeDirectTextLabel::Unknown;
 			}
 			_textPointer = _value; /* Reset value pointer */
 			_state = State::RECORD_VALUE;
@@ -191,7 +211,7 @@ void VeDirectFrameHandler<T>::rxData(uint8_t inbyte)
 		case '\n':
 			if ( _textPointer < (_value + sizeof(_value)) ) {
 				*_textPointer = 0; // make zero ended
-				_textData.push_back({_name, _value});
+				addTextRecord();
 			}
 			_state = State::RECORD_BEGIN;
 			break;
@@ -207,9 +227,21 @@ void VeDirectFrameHandler<T>::rxData(uint8_t inbyte)
 	case State::CHECKSUM:
 	{
 		if (_verboseLogging) { dumpDebugBuffer(); }
-		if (_checksum == 0) {
-			for (auto const& event : _textData) {
-				processTextData(event.first, event.second);
+		if (_checksum == 0 && _textDataOverflow) {
+			_msgOut->printf("%s text frame exceeds buffers, ignoring\r\n", _logId);
+		}
+		else if (_checksum == 0) {
+			for (size_t i = 0; i < _textRecordCount; ++i) {
+				auto const& record = _textRecords[i];
+				char const* name = &_textValues[record.offset];
+				char const* value = name;
+				if (record.label == VeDirectTextLabel::Unknown) {
+					value += strlen(name) + 1;
+				}
+				else {
+					name = getVeDirectTextLabelName(record.label).data();
+				}
+				processTextData(record.label, name, value);
 			}
 			_lastUpdate = millis();
 			frameValidEvent();
@@ -227,52 +259,76 @@ void VeDirectFrameHandler<T>::rxData(uint8_t inbyte)
 }
 
 /*
- * This function is called every time a new name/value is successfully parsed.  It writes the values to the temporary buffer.
+ * This function buffers the name/value pair just received until the checksum
+ * of the frame was validated. Only the names of unknown labels are kept.
  */
 template<typename T>
-void VeDirectFrameHandler<T>::processTextData(std::string const& name, std::string const& value) {
-	if (_verboseLogging) {
-		_msgOut->printf("%s Text Data '%s' = '%s'\r\n",
-				_logId, name.c_str(), value.c_str());
-	}
+void VeDirectFrameHandler<T>::addTextRecord()
+{
+	if (_textDataOverflow) { return; }
 
-	if (processTextDataDerived(name, value)) { return; }
+	size_t valueLen = strlen(_value) + 1;
+	size_t nameLen = (_label == VeDirectTextLabel::Unknown) ? strlen(_name) + 1 : 0;
 
-	if (name == "PID") {
-		_tmpFrame.productID_PID = strtol(value.c_str(), nullptr, 0);
+	if (_textRecordCount >= _textRecords.size() ||
+			_textValuesLength + nameLen + valueLen > _textValues.size()) {
+		_textDataOverflow = true;
 		return;
 	}
 
-	if (name == "SER") {
-		strncpy(_tmpFrame.serialNr_SER, value.c_str(), sizeof(_tmpFrame.serialNr_SER));
-		return;
-	}
+	_textRecords[_textRecordCount++] = { _label, static_cast<uint16_t>(_textValuesLength) };
+	memcpy(&_textValues[_textValuesLength], _name, nameLen);
+	_textValuesLength += nameLen;
+	memcpy(&_textValues[_textValuesLength], _value, valueLen);
+	_textValuesLength += valueLen;
+}
 
-	if (name == "FW") {
-		_tmpFrame.firmwareVer_FWE[0] = '\0';
-		strncpy(_tmpFrame.firmwareVer_FW, value.c_str(), sizeof(_tmpFrame.firmwareVer_FW));
-		return;
+/*
+ * This function is called for every name/value of a valid frame. It writes the values to the temporary buffer.
+ */
+template<typename T>
+void VeDirectFrameHandler<T>::processTextData(VeDirectTextLabel label, char const* name, char const* value) {
+	if (_verboseLogging) {
+		_msgOut->printf("%s Text Data '%s' = '%s'\r\n",
+				_logId, name, value);
 	}
 
-	// some devices use "FWE" instead of "FW" for the firmware version.
-	if (name == "FWE") {
-		_tmpFrame.firmwareVer_FW[0] = '\0';
-		strncpy(_tmpFrame.firmwareVer_FWE, value.c_str(), sizeof(_tmpFrame.firmwareVer_FWE));
-		return;
-	}
+	if (processTextDataDerived(label, value)) { return; }
 
-	if (name == "V") {
-		_tmpFrame.batteryVoltage_V_mV = atol(value.c_str());
-		return;
-	}
+	switch (label) {
+		case VeDirectTextLabel::ProductId:
+			_tmpFrame.productID_PID = strtol(value, nullptr, 0);
+			return;
 
-	if (name == "I") {
-		_tmpFrame.batteryCurrent_I_mA = atol(value.c_str());
-		return;
+		case VeDirectTextLabel::SerialNumber:
+			strncpy(_tmpFrame.serialNr_SER, value, sizeof(_tmpFrame.serialNr_SER));
+			return;
+
+		case VeDirectTextLabel::Firmware:
+			_tmpFrame.firmwareVer_FWE[0] = '\0';
+			strncpy(_tmpFrame.firmwareVer_FW, value, sizeof(_tmpFrame.firmwareVer_FW));
+			return;
+
+		// some devices use "FWE" instead of "FW" for the firmware version.
+		case VeDirectTextLabel::FirmwareExt:
+			_tmpFrame.firmwareVer_FW[0] = '\0';
+			strncpy(_tmpFrame.firmwareVer_FWE, value, sizeof(_tmpFrame.firmwareVer_FWE));
+			return;
+
+		case VeDirectTextLabel::BatteryVoltage:
+			_tmpFrame.batteryVoltage_V_mV = atol(value);
+			return;
+
+		case VeDirectTextLabel::BatteryCurrent:
+			_tmpFrame.batteryCurrent_I_mA = atol(value);
+			return;
+
+		default:
+			break;
 	}
 
 	_msgOut->printf("%s Unknown text data '%s' (value '%s')\r\n",
-			_logId, name.c_str(), value.c_str());
+			_logId, name, value);
 }
 
 /*
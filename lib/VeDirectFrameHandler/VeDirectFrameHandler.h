@@ -13,10 +13,11 @@
 #pragma once
 
 #include <Arduino.h>
+#include <esp_heap_caps.h>
 #include <array>
+#include <functional>
 #include <memory>
 #include <utility>
-#include <deque>
 #include "VeDirectData.h"
 
 template<typename T>
@@ -28,11 +29,12 @@ public:
     T const& getData() const { return _tmpFrame; }
     bool sendHexCommand(VeDirectHexCommand cmd, VeDirectHexRegister addr, uint32_t value = 0, uint8_t valsize = 0);
     bool isStateIdle() const { return (_state == State::IDLE); }
+    void onReceive(std::function<void()> cb);         // called by the UART driver when data arrives
 
 protected:
     VeDirectFrameHandler();
     void init(char const* who, int8_t rx, int8_t tx, Print* msgOut,
-        bool verboseLogging, uint8_t hwSerialPort);
+        bool verboseLogging, std::unique_ptr<HardwareSerial> upSerial);
     virtual bool hexDataHandler(VeDirectHexData const &data) { return false; } // handles the disassembled hex response
 
     bool _verboseLogging;
@@ -48,8 +50,9 @@ private:
     void reset();
     void dumpDebugBuffer();
     void rxData(uint8_t inbyte);              // byte of serial data
-    void processTextData(std::string const& name, std::string const& value);
-    virtual bool processTextDataDerived(std::string const& name, std::string const& value) = 0;
+    void addTextRecord();
+    void processTextData(VeDirectTextLabel label, char const* name, char const* value);
+    virtual bool processTextDataDerived(VeDirectTextLabel label, char const* value) = 0;
     virtual void frameValidEvent() { }
     bool disassembleHexData(VeDirectHexData &data);     //return true if disassembling was possible
 
@@ -74,7 +77,13 @@ private:
     char _hexBuffer[VE_MAX_HEX_LEN];           // buffer for received hex frames
     char _name[VE_MAX_VALUE_LEN];              // buffer for the field name
     char _value[VE_MAX_VALUE_LEN];             // buffer for the field value
-    std::array<uint8_t, 512> _debugBuffer;
+    VeDirectTextLabel _label;                  // label of the field being received
+    // only allocated if verbose logging is enabled, in PSRAM if available
+    struct HeapCapsDeleter {
+        void operator()(uint8_t* ptr) const { heap_caps_free(ptr); }
+    };
+    static constexpr size_t _debugBufferSize = 512;
+    std::unique_ptr<uint8_t[], HeapCapsDeleter> _upDebugBuffer;
     unsigned _debugIn;
     uint32_t _lastByteMillis;                  // time of last parsed byte
 
@@ -82,12 +91,22 @@ private:
      * not every frame contains every value the device is communicating, i.e.,
      * a set of values can be fragmented across multiple frames. frames can be
      * invalid. in order to only process data from valid frames, we add data
-     * to this queue and only process it once the frame was found to be valid.
-     * this also handles fragmentation nicely, since there is no need to reset
-     * our data buffer. we simply update the interpreted data from this event
-     * queue, which is fine as we know the source frame was valid.
+     * to these buffers and only process it once the frame was found to be
+     * valid. this also handles fragmentation nicely, since there is no need
+     * to reset our data buffer. we simply update the interpreted data from
+     * the buffered records, which is fine as we know the source frame was
+     * valid. the values (and the names of unknown labels) are stored as
+     * consecutive zero-terminated strings in _textValues.
      */
-    std::deque<std::pair<std::string, std::string>> _textData;
+    struct TextRecord {
+        VeDirectTextLabel label;
+        uint16_t offset;                       // offset of the value (name for unknown labels)
+    };
+    std::array<TextRecord, VE_MAX_TEXT_RECORDS> _textRecords;
+    size_t _textRecordCount;
+    std::array<char, VE_MAX_TEXT_VALUES> _textValues;
+    size_t _textValuesLength;
+    bool _textDataOverflow;                    // frame did not fit the buffers
 };
 
 template class VeDirectFrameHandler<veMpptStruct>;
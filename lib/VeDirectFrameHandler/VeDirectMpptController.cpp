@@ -13,76 +13,65 @@
 //#define PROCESS_NETWORK_STATE
 
 void VeDirectMpptController::init(int8_t rx, int8_t tx, Print* msgOut,
-		bool verboseLogging, uint8_t hwSerialPort)
+		bool verboseLogging, std::unique_ptr<HardwareSerial> upSerial)
 {
 	VeDirectFrameHandler::init("MPPT", rx, tx, msgOut,
-			verboseLogging, hwSerialPort);
+			verboseLogging, std::move(upSerial));
 }
 
-bool VeDirectMpptController::processTextDataDerived(std::string const& name, std::string const& value)
+bool VeDirectMpptController::processTextDataDerived(VeDirectTextLabel label, char const* value)
 {
-	if (name == "IL") {
-		_tmpFrame.loadCurrent_IL_mA.second = atol(value.c_str());
-        _tmpFrame.loadCurrent_IL_mA.first = millis();
-		return true;
-	}
-	if (name == "LOAD") {
-		_tmpFrame.loadOutputState_LOAD.second = (value == "ON");
-        _tmpFrame.loadOutputState_LOAD.first = millis();
-		return true;
-	}
-    if (name == "RELAY") {
-		_tmpFrame.relayState_RELAY.second = (value == "ON");
-        _tmpFrame.relayState_RELAY.first = millis();
-		return true;
-	}
-	if (name == "CS") {
-		_tmpFrame.currentState_CS = atoi(value.c_str());
-		return true;
-	}
-	if (name == "ERR") {
-		_tmpFrame.errorCode_ERR = atoi(value.c_str());
-		return true;
-	}
-	if (name == "OR") {
-		_tmpFrame.offReason_OR = strtol(value.c_str(), nullptr, 0);
-		return true;
-	}
-	if (name == "MPPT") {
-		_tmpFrame.stateOfTracker_MPPT = atoi(value.c_str());
-		return true;
-	}
-	if (name == "HSDS") {
-		_tmpFrame.daySequenceNr_HSDS = atoi(value.c_str());
-		return true;
-	}
-	if (name == "VPV") {
-		_tmpFrame.panelVoltage_VPV_mV = atol(value.c_str());
-		return true;
-	}
-	if (name == "PPV") {
-		_tmpFrame.panelPower_PPV_W = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H19") {
-		_tmpFrame.yieldTotal_H19_Wh = atol(value.c_str()) * 10;
-		return true;
-	}
-	if (name == "H20") {
-		_tmpFrame.yieldToday_H20_Wh = atol(value.c_str()) * 10;
-		return true;
-	}
-	if (name == "H21") {
-		_tmpFrame.maxPowerToday_H21_W = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H22") {
-		_tmpFrame.yieldYesterday_H22_Wh = atol(value.c_str()) * 10;
-		return true;
-	}
-	if (name == "H23") {
-		_tmpFrame.maxPowerYesterday_H23_W = atoi(value.c_str());
-		return true;
+	switch (label) {
+		case VeDirectTextLabel::LoadCurrent:
+			_tmpFrame.loadCurrent_IL_mA.second = atol(value);
+			_tmpFrame.loadCurrent_IL_mA.first = millis();
+			return true;
+		case VeDirectTextLabel::LoadOutputState:
+			_tmpFrame.loadOutputState_LOAD.second = (strcmp(value, "ON") == 0);
+			_tmpFrame.loadOutputState_LOAD.first = millis();
+			return true;
+		case VeDirectTextLabel::RelayState:
+			_tmpFrame.relayState_RELAY.second = (strcmp(value, "ON") == 0);
+			_tmpFrame.relayState_RELAY.first = millis();
+			return true;
+		case VeDirectTextLabel::CurrentState:
+			_tmpFrame.currentState_CS = atoi(value);
+			return true;
+		case VeDirectTextLabel::ErrorCode:
+			_tmpFrame.errorCode_ERR = atoi(value);
+			return true;
+		case VeDirectTextLabel::OffReason:
+			_tmpFrame.offReason_OR = strtol(value, nullptr, 0);
+			return true;
+		case VeDirectTextLabel::TrackerState:
+			_tmpFrame.stateOfTracker_MPPT = atoi(value);
+			return true;
+		case VeDirectTextLabel::DaySequenceNr:
+			_tmpFrame.daySequenceNr_HSDS = atoi(value);
+			return true;
+		case VeDirectTextLabel::PanelVoltage:
+			_tmpFrame.panelVoltage_VPV_mV = atol(value);
+			return true;
+		case VeDirectTextLabel::PanelPower:
+			_tmpFrame.panelPower_PPV_W = atoi(value);
+			return true;
+		case VeDirectTextLabel::YieldTotal:
+			_tmpFrame.yieldTotal_H19_Wh = atol(value) * 10;
+			return true;
+		case VeDirectTextLabel::YieldToday:
+			_tmpFrame.yieldToday_H20_Wh = atol(value) * 10;
+			return true;
+		case VeDirectTextLabel::MaxPowerToday:
+			_tmpFrame.maxPowerToday_H21_W = atoi(value);
+			return true;
+		case VeDirectTextLabel::YieldYesterday:
+			_tmpFrame.yieldYesterday_H22_Wh = atol(value) * 10;
+			return true;
+		case VeDirectTextLabel::MaxPowerYesterday:
+			_tmpFrame.maxPowerYesterday_H23_W = atoi(value);
+			return true;
+		default:
+			break;
 	}
 
 	return false;
@@ -165,8 +154,10 @@ bool VeDirectMpptController::hexDataHandler(VeDirectHexData const &data) {
 	auto regLog = static_cast<uint16_t>(data.addr);
 
 	// we check whether the answer matches a previously asked query
-	if ((data.rsp == VeDirectHexResponse::GET) && (data.addr == _hexQueue[_sendQueueNr]._hexRegister)) {
-		_sendTimeout = 0;
+	if (data.rsp == VeDirectHexResponse::GET) {
+		for (auto& request : _hexQueue) {
+			if (request._hexRegister == data.addr) { request._pending = false; }
+		}
 	}
 
 	switch (data.addr) {
@@ -303,50 +294,72 @@ bool VeDirectMpptController::isHexCommandPossible(void) {
 }
 
 
+/*
+ * setHexReadPeriod()
+ * changes the period in which the given register is queried
+ */
+void VeDirectMpptController::setHexReadPeriod(VeDirectHexRegister reg, uint16_t periodMillis) {
+	for (auto& request : _hexQueue) {
+		if (request._hexRegister == reg) { request._readPeriod = periodMillis; }
+	}
+}
+
 /*
  * sendNextHexCommandFromQueue()
- * send one Hex Commands from the Hex Command Queue
+ * send the most urgent due query from the Hex Command Queue
  * handles the received hex data from the MPPT
  */
 void VeDirectMpptController::sendNextHexCommandFromQueue(void) {
 	// It seems some commands get lost if we send to fast the next command.
-	// maybe we produce an overflow on the MPPT receive buffer or we have to
-	// wait for the MPPT answer before we can send the next command. We only
-	// send a new query in VE.Direct idle state and if no query is pending. In
-	// case we do not get an answer we send the next query from the queue after
-	// a timeout of 500ms. NOTE: _sendTimeout will be set to 0 after receiving
-	// an answer, see function hexDataHandler().
+	// maybe we produce an overflow on the MPPT receive buffer. we therefore
+	// keep a minimum interval between queries and limit the amount of
+	// pending queries. NOTE: _pending will be reset after receiving an
+	// answer, see function hexDataHandler().
 	auto millisTime = millis();
-	if (isStateIdle() && ((millisTime - _hexQueue[_sendQueueNr]._lastSendTime) > _sendTimeout)) {
 
-		// we do 2 loops, first for high prio commands and second for low prio commands
-		bool prio = true;
-		for (auto idy = 0; idy < 2; ++idy) {
+	size_t pending = 0;
+	for (auto& request : _hexQueue) {
+		if (!request._pending) { continue; }
 
-			// we start searching the queue with the next queue index
-			auto idx = _sendQueueNr + 1;
-			if (idx >= _hexQueue.size()) { idx = 0; }
+		if ((millisTime - request._lastSendTime) > _responseTimeoutMillis) {
+			request._pending = false;
+			if (_verboseLogging) {
+				_msgOut->printf("%s Hex Query 0x%04X timed out\r\n", _logId,
+						static_cast<unsigned>(request._hexRegister));
+			}
+			continue;
+		}
 
-			do {
-				// we check if it is time to send the command again
-				if (((prio && (_hexQueue[idx]._readPeriod == HIGH_PRIO_COMMAND)) ||
-					(!prio && (_hexQueue[idx]._readPeriod != HIGH_PRIO_COMMAND))) &&
-					(millisTime - _hexQueue[idx]._lastSendTime) > (_hexQueue[idx]._readPeriod * 1000)) {
+		++pending;
+	}
 
-					sendHexCommand(VeDirectHexCommand::GET, _hexQueue[idx]._hexRegister);
-					_hexQueue[idx]._lastSendTime = millisTime;
+	if (pending >= _maxPendingRequests) { return; }
+	if ((millisTime - _lastHexSendTime) < _minSendIntervalMillis) { return; }
 
-					// we need this information to check if we get an answer, see hexDataHandler()
-					_sendTimeout = 500;
-					_sendQueueNr = idx;
-					return;
-				}
+	// among the due queries, we pick the one with the highest priority. if
+	// priorities are equal, we pick the one which is overdue the longest.
+	VeDirectHexRequest* pNext = nullptr;
+	uint32_t nextOverdue = 0;
+	for (auto& request : _hexQueue) {
+		if (request._pending) { continue; }
 
-				++idx;
-				if (idx == _hexQueue.size()) { idx = 0; }
-			} while (idx != _sendQueueNr);
+		uint32_t elapsed = millisTime - request._lastSendTime;
+		if (elapsed < request._readPeriod) { continue; }
 
-			prio = false; // second loop for low prio commands
+		uint32_t overdue = elapsed - request._readPeriod;
+		if (pNext != nullptr) {
+			if (request._priority < pNext->_priority) { continue; }
+			if (request._priority == pNext->_priority && overdue <= nextOverdue) { continue; }
 		}
+
+		pNext = &request;
+		nextOverdue = overdue;
 	}
+
+	if (pNext == nullptr) { return; }
+
+	sendHexCommand(VeDirectHexCommand::GET, pNext->_hexRegister);
+	pNext->_lastSendTime = millisTime;
+	pNext->_pending = true;
+	_lastHexSendTime = millisTime;
 }
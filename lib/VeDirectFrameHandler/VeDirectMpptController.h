@@ -36,10 +36,12 @@ private:
     size_t _count;
 };
 
-struct VeDirectHexQueue {
+struct VeDirectHexRequest {
     VeDirectHexRegister _hexRegister;   // hex register
-    uint8_t _readPeriod;                // time period in sec until we send the command again
+    uint8_t _priority;                  // due requests with higher priority are sent first
+    uint16_t _readPeriod;               // time period in milli sec until we send the command again
     uint32_t _lastSendTime;             // time stamp in milli sec of last send
+    bool _pending;                      // waiting for the response
 };
 
 class VeDirectMpptController : public VeDirectFrameHandler<veMpptStruct> {
@@ -47,28 +49,40 @@ public:
     VeDirectMpptController() = default;
 
     void init(int8_t rx, int8_t tx, Print* msgOut,
-        bool verboseLogging, uint8_t hwSerialPort);
+        bool verboseLogging, std::unique_ptr<HardwareSerial> upSerial);
 
     using data_t = veMpptStruct;
 
     void loop() final;
 
+    // changes the period in which the given register is queried
+    void setHexReadPeriod(VeDirectHexRegister reg, uint16_t periodMillis);
+
 private:
     bool hexDataHandler(VeDirectHexData const &data) final;
-    bool processTextDataDerived(std::string const& name, std::string const& value) final;
+    bool processTextDataDerived(VeDirectTextLabel label, char const* value) final;
     void frameValidEvent() final;
     void sendNextHexCommandFromQueue(void);
     bool isHexCommandPossible(void);
     MovingAverage<float, 5> _efficiency;
 
-    uint32_t _sendTimeout = 0;          // timeout until we send the next command from the queue
-    size_t _sendQueueNr = 0;            // actual queue position;
+    // we send a limited amount of queries without waiting for the respective
+    // answer, answers are matched by register. a query which was not
+    // answered in time is considered lost, so it does not block the others.
+    static constexpr size_t _maxPendingRequests = 2;
+    static constexpr uint32_t _responseTimeoutMillis = 500;
+    static constexpr uint32_t _minSendIntervalMillis = 50;
+    uint32_t _lastHexSendTime = 0;
 
-    // for slow changing values we use a send time period of 4 sec
-    #define HIGH_PRIO_COMMAND 1
-    std::array<VeDirectHexQueue, 5> _hexQueue { VeDirectHexRegister::NetworkTotalDcInputPower, HIGH_PRIO_COMMAND, 0,
-                                                VeDirectHexRegister::ChargeControllerTemperature, 4, 0,
-                                                VeDirectHexRegister::SmartBatterySenseTemperature, 4, 0,
-                                                VeDirectHexRegister::BatteryFloatVoltage, 4, 0,
-                                                VeDirectHexRegister::BatteryAbsorptionVoltage, 4, 0 };
+    // the registers used by the DPL are queried eight times as often as
+    // the registers for diagnostics.
+    static constexpr uint8_t HighPrio = 1;
+    static constexpr uint8_t LowPrio = 0;
+    std::array<VeDirectHexRequest, 5> _hexQueue {{
+        { VeDirectHexRegister::NetworkTotalDcInputPower, HighPrio, 500, 0, false },
+        { VeDirectHexRegister::BatteryFloatVoltage, HighPrio, 500, 0, false },
+        { VeDirectHexRegister::BatteryAbsorptionVoltage, HighPrio, 500, 0, false },
+        { VeDirectHexRegister::ChargeControllerTemperature, LowPrio, 4000, 0, false },
+        { VeDirectHexRegister::SmartBatterySenseTemperature, LowPrio, 4000, 0, false }
+    }};
 };
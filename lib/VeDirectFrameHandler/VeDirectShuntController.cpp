@@ -4,131 +4,107 @@
 VeDirectShuntController VeDirectShunt;
 
 void VeDirectShuntController::init(int8_t rx, int8_t tx, Print* msgOut,
-		bool verboseLogging, uint8_t hwSerialPort)
+		bool verboseLogging, std::unique_ptr<HardwareSerial> upSerial)
 {
 	VeDirectFrameHandler::init("SmartShunt", rx, tx, msgOut,
-			verboseLogging, hwSerialPort);
+			verboseLogging, std::move(upSerial));
 }
 
-bool VeDirectShuntController::processTextDataDerived(std::string const& name, std::string const& value)
+bool VeDirectShuntController::processTextDataDerived(VeDirectTextLabel label, char const* value)
 {
-	if (name == "T") {
-		_tmpFrame.T = atoi(value.c_str());
-		_tmpFrame.tempPresent = true;
-		return true;
-	}
-	if (name == "P") {
-		_tmpFrame.P = atoi(value.c_str());
-		return true;
-	}
-	if (name == "CE") {
-		_tmpFrame.CE = atoi(value.c_str());
-		return true;
-	}
-	if (name == "SOC") {
-		_tmpFrame.SOC = atoi(value.c_str());
-		return true;
-	}
-	if (name == "TTG") {
-		_tmpFrame.TTG = atoi(value.c_str());
-		return true;
-	}
-	if (name == "ALARM") {
-		_tmpFrame.ALARM = (value == "ON");
-		return true;
-	}
-	if (name == "AR") {
-		_tmpFrame.alarmReason_AR = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H1") {
-		_tmpFrame.H1 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H2") {
-		_tmpFrame.H2 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H3") {
-		_tmpFrame.H3 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H4") {
-		_tmpFrame.H4 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H5") {
-		_tmpFrame.H5 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H6") {
-		_tmpFrame.H6 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H7") {
-		_tmpFrame.H7 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H8") {
-		_tmpFrame.H8 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H9") {
-		_tmpFrame.H9 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H10") {
-		_tmpFrame.H10 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H11") {
-		_tmpFrame.H11 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H12") {
-		_tmpFrame.H12 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H13") {
-		_tmpFrame.H13 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H14") {
-		_tmpFrame.H14 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H15") {
-		_tmpFrame.H15 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H16") {
-		_tmpFrame.H16 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H17") {
-		_tmpFrame.H17 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "VM") {
-		_tmpFrame.VM = atoi(value.c_str());
-		return true;
-	}
-	if (name == "DM") {
-		_tmpFrame.DM = atoi(value.c_str());
-		return true;
-	}
-	if (name == "H18") {
-		_tmpFrame.H18 = atoi(value.c_str());
-		return true;
-	}
-	if (name == "BMV") {
-		// This field contains a textual description of the BMV model,
-		// for example 602S or 702. It is deprecated, refer to the field PID instead.
-		return true;
-	}
-	if (name == "MON") {
-		_tmpFrame.dcMonitorMode_MON = static_cast<int8_t>(atoi(value.c_str()));
-		return true;
+	switch (label) {
+		case VeDirectTextLabel::Temperature:
+			_tmpFrame.T = atoi(value);
+			_tmpFrame.tempPresent = true;
+			return true;
+		case VeDirectTextLabel::Power:
+			_tmpFrame.P = atoi(value);
+			return true;
+		case VeDirectTextLabel::ConsumedAmpHours:
+			_tmpFrame.CE = atoi(value);
+			return true;
+		case VeDirectTextLabel::StateOfCharge:
+			_tmpFrame.SOC = atoi(value);
+			return true;
+		case VeDirectTextLabel::TimeToGo:
+			_tmpFrame.TTG = atoi(value);
+			return true;
+		case VeDirectTextLabel::Alarm:
+			_tmpFrame.ALARM = (strcmp(value, "ON") == 0);
+			return true;
+		case VeDirectTextLabel::AlarmReason:
+			_tmpFrame.alarmReason_AR = atoi(value);
+			return true;
+		case VeDirectTextLabel::DeepestDischarge:
+			_tmpFrame.H1 = atoi(value);
+			return true;
+		case VeDirectTextLabel::LastDischarge:
+			_tmpFrame.H2 = atoi(value);
+			return true;
+		case VeDirectTextLabel::AverageDischarge:
+			_tmpFrame.H3 = atoi(value);
+			return true;
+		case VeDirectTextLabel::ChargeCycles:
+			_tmpFrame.H4 = atoi(value);
+			return true;
+		case VeDirectTextLabel::FullDischarges:
+			_tmpFrame.H5 = atoi(value);
+			return true;
+		case VeDirectTextLabel::CumulativeAmpHours:
+			_tmpFrame.H6 = atoi(value);
+			return true;
+		case VeDirectTextLabel::MinVoltage:
+			_tmpFrame.H7 = atoi(value);
+			return true;
+		case VeDirectTextLabel::MaxVoltage:
+			_tmpFrame.H8 = atoi(value);
+			return true;
+		case VeDirectTextLabel::SecondsSinceFullCharge:
+			_tmpFrame.H9 = atoi(value);
+			return true;
+		case VeDirectTextLabel::AutoSynchronizations:
+			_tmpFrame.H10 = atoi(value);
+			return true;
+		case VeDirectTextLabel::LowVoltageAlarms:
+			_tmpFrame.H11 = atoi(value);
+			return true;
+		case VeDirectTextLabel::HighVoltageAlarms:
+			_tmpFrame.H12 = atoi(value);
+			return true;
+		case VeDirectTextLabel::LowAuxVoltageAlarms:
+			_tmpFrame.H13 = atoi(value);
+			return true;
+		case VeDirectTextLabel::HighAuxVoltageAlarms:
+			_tmpFrame.H14 = atoi(value);
+			return true;
+		case VeDirectTextLabel::MinAuxVoltage:
+			_tmpFrame.H15 = atoi(value);
+			return true;
+		case VeDirectTextLabel::MaxAuxVoltage:
+			_tmpFrame.H16 = atoi(value);
+			return true;
+		case VeDirectTextLabel::DischargedEnergy:
+			_tmpFrame.H17 = atoi(value);
+			return true;
+		case VeDirectTextLabel::ChargedEnergy:
+			_tmpFrame.H18 = atoi(value);
+			return true;
+		case VeDirectTextLabel::MidPointVoltage:
+			_tmpFrame.VM = atoi(value);
+			return true;
+		case VeDirectTextLabel::MidPointDeviation:
+			_tmpFrame.DM = atoi(value);
+			return true;
+		case VeDirectTextLabel::BmvModel:
+			// This field contains a textual description of the BMV model,
+			// for example 602S or 702. It is deprecated, refer to the field PID instead.
+			return true;
+		case VeDirectTextLabel::DcMonitorMode:
+			_tmpFrame.dcMonitorMode_MON = static_cast<int8_t>(atoi(value));
+			return true;
+		default:
+			break;
 	}
+
 	return false;
 }
@@ -9,12 +9,12 @@ public:
     VeDirectShuntController() = default;
 
     void init(int8_t rx, int8_t tx, Print* msgOut,
-        bool verboseLogging, uint8_t hwSerialPort);
+        bool verboseLogging, std::unique_ptr<HardwareSerial> upSerial);
 
     using data_t = veShuntStruct;
 
 private:
-    bool processTextDataDerived(std::string const& name, std::string const& value) final;
+    bool processTextDataDerived(VeDirectTextLabel label, char const* value) final;
 };
 
 extern VeDirectShuntController VeDirectShunt;
@@ -1,8 +1,18 @@
 import os
+import gzip
 import hashlib
 import pickle
+import re
 import subprocess
 
+Import("env")
+
+def embedded_files():
+    files = env.GetProjectOption("board_build.embed_files", "")
+    if isinstance(files, str):
+        files = files.splitlines()
+    return [f.strip() for f in files if f.strip()]
+
 def check_files(directories, filepaths, hash_file):
     old_file_hashes = {}
     file_hashes = {}
@@ -27,6 +37,13 @@ def check_files(directories, filepaths, hash_file):
             update = True
             break
 
+    # artifacts of an older webapp build may lack files embedded by now,
+    # e.g., js/views.js.gz or sw.js.gz, even if the sources did not change.
+    missing = [f for f in embedded_files() if not os.path.exists(f)]
+    if missing:
+        print("INFO: webapp artifacts missing: %s" % (", ".join(missing)))
+        update = True
+
     if not update:
         print("INFO: webapp artifacts should be up-to-date")
         return
@@ -60,6 +77,56 @@ def check_files(directories, filepaths, hash_file):
     with open(hash_file, 'wb') as f:
         pickle.dump(file_hashes, f)
 
+def update_file_if_changed(filename, content):
+    try:
+        with open(filename, "rb") as fp:
+            if fp.read() == content:
+                return
+    except:
+        pass
+    with open(filename, "wb") as fp:
+        fp.write(content)
+
+def embed_constants():
+    missing = [f for f in embedded_files() if not os.path.exists(f)]
+    if missing:
+        raise Exception("webapp artifacts missing: %s. run 'yarn install "
+                        "--frozen-lockfile && yarn build' in webapp/." % (", ".join(missing)))
+
+    # the ETags of the embedded files are computed here rather than hashing
+    # hundreds of kilobytes on the ESP32 for every request.
+    etags = {
+        "INDEX_HTML": "webapp_dist/index.html.gz",
+        "ZONES_JSON": "webapp_dist/zones.json.gz",
+        "FAVICON_ICO": "webapp_dist/favicon.ico",
+        "FAVICON_PNG": "webapp_dist/favicon.png",
+        "APP_JS": "webapp_dist/js/app.js.gz",
+        "VIEWS_JS": "webapp_dist/js/views.js.gz",
+        "SITE_WEBMANIFEST": "webapp_dist/site.webmanifest",
+        "SW_JS": "webapp_dist/sw.js.gz",
+    }
+
+    lines = "/* Generated file within build process - Do NOT edit */\n"
+
+    for name, file_path in etags.items():
+        with open(file_path, 'rb') as f:
+            etag = hashlib.md5(f.read()).hexdigest()
+        lines += 'const char *__WEBAPP_ETAG_%s__ = "\\"%s\\"";\n' % (name, etag)
+
+    # the webapp build references app.js by a content-hashed path, which
+    # is served with an immutable cache policy. older builds of the webapp
+    # reference the plain path.
+    with gzip.open(etags["INDEX_HTML"], 'rt', encoding='utf-8') as f:
+        match = re.search(r'/js/app\.[0-9a-f]+\.js', f.read())
+    app_js_path = match.group(0) if match else "/js/app.js"
+    lines += 'const char *__WEBAPP_APP_JS_PATH__ = "%s";\n' % (app_js_path)
+
+    targetfile = os.path.join(env.subst("$BUILD_DIR"), "__webapp_constants.c")
+    os.makedirs(os.path.dirname(targetfile), exist_ok=True)
+    update_file_if_changed(targetfile, bytes(lines, "utf-8"))
+
+    env.AppendUnique(PIOBUILDFILES=[targetfile])
+
 def main():
     if os.getenv('GITHUB_ACTIONS') == 'true':
         print("INFO: not testing for up-to-date webapp artifacts when running as Github action")
@@ -76,3 +143,4 @@ def main():
     check_files(directories, files, hash_file)
 
 main()
+embed_constants()
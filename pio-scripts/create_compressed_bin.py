@@ -0,0 +1,29 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Creates a gzip-compressed copy of the firmware image, which can be
+# uploaded as an OTA update and is decompressed while it is being written.
+#
+import gzip
+import shutil
+from os.path import getsize
+
+Import("env")
+
+
+def create_compressed_bin(source, target, env):
+    firmware_name = env.subst("$BUILD_DIR/${PROGNAME}.bin")
+    compressed_name = firmware_name + ".gz"
+
+    # no file name nor time in the header, such that the output is reproducible
+    with open(firmware_name, "rb") as src, open(compressed_name, "wb") as raw:
+        with gzip.GzipFile(filename="", mode="wb", fileobj=raw, compresslevel=9, mtime=0) as dst:
+            shutil.copyfileobj(src, dst)
+
+    size = getsize(firmware_name)
+    compressed_size = getsize(compressed_name)
+    print("Compressed OTA image: %s (%d of %d bytes, %.0f%%)" % (
+        compressed_name, compressed_size, size, 100.0 * compressed_size / size))
+
+
+from SCons.Script import AlwaysBuild
+AlwaysBuild(env.AddPostAction("buildprog", create_compressed_bin))
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "AggregateBattery.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include <algorithm>
+
+bool AggregateBattery::init(bool verboseLogging)
+{
+    _verboseLogging = verboseLogging;
+
+    auto const& config = Configuration.get();
+
+    for (uint8_t i = 0; i < BATTERY_AGGREGATE_MAX_CHILDREN; ++i) {
+        auto const& childConfig = config.Battery.AggregateChildren[i];
+        if (!childConfig.Enabled) { continue; }
+
+        // the MQTT provider and the SmartShunt only exist once
+        auto provider = childConfig.Provider;
+        bool isSingleton = provider == 2 || provider == 3;
+        bool isDuplicate = std::any_of(_children.begin(), _children.end(),
+                [provider](Child const& c) { return c.Provider == provider; });
+
+        std::unique_ptr<BatteryProvider> upProvider = nullptr;
+        if (provider != 7 && !(isSingleton && isDuplicate)) {
+            upProvider = BatteryClass::createProvider(provider);
+        }
+
+        if (!upProvider) {
+            MessageOutput.printf("[AggregateBattery] Battery %d: provider %d "
+                    "not supported as part of an aggregate\r\n", i + 1, provider);
+            continue;
+        }
+
+        upProvider->setPinSet(i);
+        if (!upProvider->init(verboseLogging)) {
+            MessageOutput.printf("[AggregateBattery] Battery %d: failed to "
+                    "initialize provider %d\r\n", i + 1, provider);
+            continue;
+        }
+
+        _children.push_back({ std::move(upProvider), provider,
+                childConfig.CapacityAmpHours, nullptr });
+    }
+
+    MessageOutput.printf("[AggregateBattery] Combining %d batteries\r\n",
+            static_cast<int>(_children.size()));
+
+    return !_children.empty();
+}
+
+void AggregateBattery::deinit()
+{
+    for (auto& child : _children) { child.upProvider->deinit(); }
+    _children.clear();
+}
+
+std::vector<BatteryProvider::CanMessageStats> AggregateBattery::getCanMessageStats() const
+{
+    std::vector<CanMessageStats> res;
+    for (auto const& child : _children) {
+        auto childStats = child.upProvider->getCanMessageStats();
+        res.insert(res.end(), childStats.begin(), childStats.end());
+    }
+    return res;
+}
+
+void AggregateBattery::loop()
+{
+    bool updated = false;
+
+    for (auto& child : _children) {
+        child.upProvider->loop();
+
+        if (!child.upProvider->getStats()->updateAvailable(_lastMerge)) { continue; }
+
+        child.spSnapshot = child.upProvider->getSnapshot();
+        updated = true;
+    }
+
+    if (!updated) { return; }
+
+    _lastMerge = millis();
+    merge();
+}
+
+void AggregateBattery::merge()
+{
+    uint32_t now = millis();
+
+    // values are stamped with the time of the oldest contribution, such
+    // that stale data of one battery is noticed in the aggregate.
+    auto timestamp = [now](uint32_t ageSeconds) { return now - ageSeconds * 1000; };
+
+    float socWeighted = 0;
+    float socWeights = 0;
+    float socSum = 0;
+    uint8_t socCount = 0;
+    uint8_t socPrecision = 0;
+    uint32_t socAge = 0;
+
+    float voltageSum = 0;
+    uint8_t voltageCount = 0;
+    uint32_t voltageAge = 0;
+
+    float current = 0;
+    uint8_t currentCount = 0;
+    uint8_t currentPrecision = 0;
+    uint32_t currentAge = 0;
+
+    float dischargeCurrentLimit = FLT_MAX;
+    uint32_t dischargeCurrentLimitAge = 0;
+
+    bool chargeImmediately = false;
+    float chargeCurrentLimitation = FLT_MAX;
+
+    for (auto const& child : _children) {
+        auto const& spStats = child.spSnapshot;
+        if (!spStats) { continue; }
+
+        if (spStats->isSoCValid()) {
+            socWeighted += spStats->getSoC() * child.CapacityAmpHours;
+            socWeights += child.CapacityAmpHours;
+            socSum += spStats->getSoC();
+            ++socCount;
+            socPrecision = std::max(socPrecision, spStats->getSoCPrecision());
+            socAge = std::max(socAge, spStats->getSoCAgeSeconds());
+        }
+
+        if (spStats->isVoltageValid()) {
+            voltageSum += spStats->getVoltage();
+            ++voltageCount;
+            voltageAge = std::max(voltageAge, spStats->getVoltageAgeSeconds());
+        }
+
+        if (spStats->isCurrentValid()) {
+            current += spStats->getChargeCurrent();
+            ++currentCount;
+            currentPrecision = std::max(currentPrecision, spStats->getChargeCurrentPrecision());
+            currentAge = std::max(currentAge, spStats->getAgeSeconds());
+        }
+
+        if (spStats->isDischargeCurrentLimitValid()) {
+            dischargeCurrentLimit = std::min(dischargeCurrentLimit, spStats->getDischargeCurrentLimit());
+            dischargeCurrentLimitAge = std::max(dischargeCurrentLimitAge,
+                    spStats->getDischargeCurrentLimitAgeSeconds());
+        }
+
+        chargeImmediately |= spStats->getImmediateChargingRequest();
+        chargeCurrentLimitation = std::min(chargeCurrentLimitation,
+                spStats->getChargeCurrentLimitation());
+    }
+
+    _stats->setManufacturer("Aggregate");
+    _stats->_batteries = _children.size();
+    _stats->_chargeImmediately = chargeImmediately;
+    _stats->_chargeCurrentLimitation = chargeCurrentLimitation;
+
+    if (socCount > 0) {
+        // fall back to the plain mean if no capacities are configured
+        float soc = (socWeights > 0) ? (socWeighted / socWeights) : (socSum / socCount);
+        _stats->setSoC(soc, socPrecision, timestamp(socAge));
+    }
+
+    if (voltageCount > 0) {
+        _stats->setVoltage(voltageSum / voltageCount, timestamp(voltageAge));
+    }
+
+    if (currentCount > 0) {
+        _stats->setCurrent(current, currentPrecision, timestamp(currentAge));
+    }
+
+    if (dischargeCurrentLimit < FLT_MAX) {
+        _stats->setDischargeCurrentLimit(dischargeCurrentLimit,
+                timestamp(dischargeCurrentLimitAge));
+    }
+
+    // the setters above stamp the aggregate with the oldest contribution,
+    // but new data was merged just now.
+    _stats->_lastUpdate = now;
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[AggregateBattery] SoC %.1f %%, %.2f V, %.2f A "
+                "from %d batteries\r\n", _stats->getSoC(), _stats->getVoltage(),
+                _stats->getChargeCurrent(),
+                static_cast<int>(_children.size()));
+    }
+}
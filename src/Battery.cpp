@@ -1,6 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include "Battery.h"
+#include "EventBus.h"
+#include "TaskMonitor.h"
 #include "MessageOutput.h"
+#include "MetricsRegistry.h"
 #include "PylontechCanReceiver.h"
 #include "SBSCanReceiver.h"
 #include "JkBmsController.h"
@@ -8,29 +11,141 @@
 #include "VictronSmartShunt.h"
 #include "MqttBattery.h"
 #include "PytesCanReceiver.h"
+#include "AggregateBattery.h"
+#include <algorithm>
 
 BatteryClass Battery;
 
 std::shared_ptr<BatteryStats const> BatteryClass::getStats() const
 {
-    std::lock_guard<std::mutex> lock(_mutex);
+    auto spStats = std::atomic_load(&_spStats);
 
-    if (!_upProvider) {
+    if (!spStats) {
         static auto sspDummyStats = std::make_shared<BatteryStats>();
         return sspDummyStats;
     }
 
-    return _upProvider->getStats();
+    return spStats;
+}
+
+void BatteryClass::publishSnapshot()
+{
+    _lastSnapshot = millis();
+    auto spSnapshot = _upProvider->getSnapshot();
+    std::atomic_store(&_spStats, spSnapshot);
+    EventBus.publish(Events::BatterySnapshot{ *spSnapshot });
+}
+
+std::vector<BatteryProvider::CanMessageStats> BatteryClass::getCanMessageStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_upProvider) { return {}; }
+
+    return _upProvider->getCanMessageStats();
+}
+
+void BatteryClass::forwardElectricalSample()
+{
+    auto oSample = _upProvider->getElectricalSample();
+    if (!oSample || oSample->Millis == _electricalSampleMillis) { return; }
+
+    auto milliVolts = static_cast<uint32_t>(oSample->Volts * 1000);
+    auto milliAmps = static_cast<int32_t>(oSample->Amps * 1000);
+    _electricalSample = (static_cast<uint64_t>(milliVolts) << 32) | static_cast<uint32_t>(milliAmps);
+    _electricalSampleMillis = std::max<uint32_t>(oSample->Millis, 1);
+}
+
+std::optional<BatteryProvider::ElectricalSample> BatteryClass::getElectricalSample(uint32_t maxAgeMs) const
+{
+    uint32_t sampleMillis = _electricalSampleMillis;
+    if (sampleMillis == 0 || millis() - sampleMillis > maxAgeMs) { return std::nullopt; }
+
+    uint64_t packed = _electricalSample;
+    return BatteryProvider::ElectricalSample {
+        static_cast<float>(static_cast<uint32_t>(packed >> 32)) / 1000,
+        static_cast<float>(static_cast<int32_t>(packed & 0xFFFFFFFF)) / 1000,
+        sampleMillis
+    };
+}
+
+void BatteryClass::updateResistanceEstimate()
+{
+    std::optional<BatteryProvider::ElectricalSample> oSample = _upProvider->getElectricalSample();
+
+    if (!oSample) {
+        auto spStats = _upProvider->getStats();
+        uint32_t voltageMillis = spStats->getLastUpdateVoltage();
+        uint32_t currentMillis = spStats->getLastUpdateCurrent();
+        uint32_t skew = std::max(voltageMillis, currentMillis) - std::min(voltageMillis, currentMillis);
+        if (voltageMillis > 0 && currentMillis > 0 && skew <= _maxEstimatorSampleSkewMs) {
+            oSample = BatteryProvider::ElectricalSample { spStats->getVoltage(), spStats->getChargeCurrent(), std::max(voltageMillis, currentMillis) };
+        }
+    }
+
+    if (!oSample || oSample->Millis == _lastEstimatorSample) { return; }
+    _lastEstimatorSample = oSample->Millis;
+
+    _resistanceEstimator.addSample(oSample->Volts, oSample->Amps);
+    _internalResistance = _resistanceEstimator.getResistance().value_or(0);
+}
+
+std::optional<float> BatteryClass::getInternalResistance() const
+{
+    float resistance = _internalResistance;
+    if (resistance <= 0) { return std::nullopt; }
+    return resistance;
 }
 
 void BatteryClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&BatteryClass::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("Battery::loop", std::bind(&BatteryClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
     this->updateSettings();
+
+    registerMetrics();
+}
+
+void BatteryClass::registerMetrics()
+{
+    using Type = MetricsRegistryClass::Type;
+
+    auto fromStats = [this](auto getter) {
+        return [this, getter]() -> std::optional<float> {
+            if (!Configuration.get().Battery.Enabled) { return std::nullopt; }
+            return getter(*getStats());
+        };
+    };
+
+    MetricsRegistry.add("opendtu_battery_data_age", "Age of the battery data in s", Type::Gauge,
+        fromStats([](BatteryStats const& stats) -> std::optional<float> { return stats.getAgeSeconds(); }));
+
+    MetricsRegistry.add("opendtu_battery_soc", "Battery state of charge in %", Type::Gauge,
+        fromStats([](BatteryStats const& stats) -> std::optional<float> {
+            if (!stats.isSoCValid()) { return std::nullopt; }
+            return stats.getSoC();
+        }));
+
+    MetricsRegistry.add("opendtu_battery_voltage", "Battery voltage in V", Type::Gauge,
+        fromStats([](BatteryStats const& stats) -> std::optional<float> {
+            if (!stats.isVoltageValid()) { return std::nullopt; }
+            return stats.getVoltage();
+        }));
+
+    MetricsRegistry.add("opendtu_battery_current", "Battery charge current in A", Type::Gauge,
+        fromStats([](BatteryStats const& stats) -> std::optional<float> {
+            if (!stats.isCurrentValid()) { return std::nullopt; }
+            return stats.getChargeCurrent();
+        }));
+
+    MetricsRegistry.add("opendtu_battery_power", "Battery charge power in W", Type::Gauge,
+        fromStats([](BatteryStats const& stats) -> std::optional<float> {
+            if (!stats.isVoltageValid() || !stats.isCurrentValid()) { return std::nullopt; }
+            return stats.getVoltage() * stats.getChargeCurrent();
+        }));
 }
 
 void BatteryClass::updateSettings()
@@ -38,6 +153,11 @@ void BatteryClass::updateSettings()
     std::lock_guard<std::mutex> lock(_mutex);
 
     if (_upProvider) {
+        std::atomic_store(&_spStats, std::shared_ptr<BatteryStats const>(nullptr));
+        _electricalSampleMillis = 0;
+        _resistanceEstimator.reset();
+        _lastEstimatorSample = 0;
+        _internalResistance = 0;
         _upProvider->deinit();
         _upProvider = nullptr;
     }
@@ -47,34 +167,44 @@ void BatteryClass::updateSettings()
 
     bool verboseLogging = config.Battery.VerboseLogging;
 
-    switch (config.Battery.Provider) {
+    _upProvider = createProvider(config.Battery.Provider);
+    if (!_upProvider) {
+        MessageOutput.printf("[Battery] Unknown provider: %d\r\n", config.Battery.Provider);
+        return;
+    }
+
+    if (!_upProvider->init(verboseLogging)) {
+        _upProvider = nullptr;
+        return;
+    }
+
+    publishSnapshot();
+}
+
+std::unique_ptr<BatteryProvider> BatteryClass::createProvider(uint8_t provider)
+{
+    switch (provider) {
         case 0:
-            _upProvider = std::make_unique<PylontechCanReceiver>();
-            break;
+            return std::make_unique<PylontechCanReceiver>();
         case 1:
-            _upProvider = std::make_unique<JkBms::Controller>();
-            break;
+            return std::make_unique<JkBms::Controller>();
         case 2:
-            _upProvider = std::make_unique<MqttBattery>();
-            break;
+            return std::make_unique<MqttBattery>();
         case 3:
-            _upProvider = std::make_unique<VictronSmartShunt>();
-            break;
+            return std::make_unique<VictronSmartShunt>();
         case 4:
-            _upProvider = std::make_unique<PytesCanReceiver>();
-            break;
+            return std::make_unique<PytesCanReceiver>();
         case 5:
-            _upProvider = std::make_unique<SBSCanReceiver>();
-            break;
+            return std::make_unique<SBSCanReceiver>();
         case 6:
-            _upProvider = std::make_unique<JbdBms::Controller>();
-            break;
+            return std::make_unique<JbdBms::Controller>();
+        case 7:
+            return std::make_unique<AggregateBattery>();
         default:
-            MessageOutput.printf("[Battery] Unknown provider: %d\r\n", config.Battery.Provider);
-            return;
+            break;
     }
 
-    if (!_upProvider->init(verboseLogging)) { _upProvider = nullptr; }
+    return nullptr;
 }
 
 void BatteryClass::loop()
@@ -85,7 +215,14 @@ void BatteryClass::loop()
 
     _upProvider->loop();
 
-    _upProvider->getStats()->mqttLoop();
+    forwardElectricalSample();
+    updateResistanceEstimate();
+
+    auto spStats = _upProvider->getStats();
+
+    if (spStats->updateAvailable(_lastSnapshot)) { publishSnapshot(); }
+
+    spStats->mqttLoop();
 }
 
 float BatteryClass::getDischargeCurrentLimit()
@@ -94,18 +231,20 @@ float BatteryClass::getDischargeCurrentLimit()
 
     if (!config.Battery.EnableDischargeCurrentLimit) { return FLT_MAX; }
 
+    auto spStats = getStats();
+
     auto dischargeCurrentLimit = config.Battery.DischargeCurrentLimit;
     auto dischargeCurrentLimitValid = dischargeCurrentLimit > 0.0f;
     auto dischargeCurrentLimitBelowSoc = config.Battery.DischargeCurrentLimitBelowSoc;
     auto dischargeCurrentLimitBelowVoltage = config.Battery.DischargeCurrentLimitBelowVoltage;
-    auto statsSoCValid = getStats()->getSoCAgeSeconds() <= 60 && !config.PowerLimiter.IgnoreSoc;
-    auto statsSoC = statsSoCValid ? getStats()->getSoC() : 100.0; // fail open so we use voltage instead
-    auto statsVoltageValid = getStats()->getVoltageAgeSeconds() <= 60;
-    auto statsVoltage = statsVoltageValid ? getStats()->getVoltage() : 0.0; // fail closed
-    auto statsCurrentLimit = getStats()->getDischargeCurrentLimit();
+    auto statsSoCValid = spStats->getSoCAgeSeconds() <= 60 && !config.PowerLimiter.IgnoreSoc;
+    auto statsSoC = statsSoCValid ? spStats->getSoC() : 100.0; // fail open so we use voltage instead
+    auto statsVoltageValid = spStats->getVoltageAgeSeconds() <= 60;
+    auto statsVoltage = statsVoltageValid ? spStats->getVoltage() : 0.0; // fail closed
+    auto statsCurrentLimit = spStats->getDischargeCurrentLimit();
     auto statsLimitValid = config.Battery.UseBatteryReportedDischargeCurrentLimit
         && statsCurrentLimit >= 0.0f
-        && getStats()->getDischargeCurrentLimitAgeSeconds() <= 60;
+        && spStats->getDischargeCurrentLimitAgeSeconds() <= 60;
 
 
     if (statsSoC > dischargeCurrentLimitBelowSoc && statsVoltage > dischargeCurrentLimitBelowVoltage) {
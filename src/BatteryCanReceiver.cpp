@@ -3,6 +3,8 @@
 #include "MessageOutput.h"
 #include "PinMapping.h"
 #include <driver/twai.h>
+#include <algorithm>
+#include <limits>
 
 bool BatteryCanReceiver::init(bool verboseLogging, char const* providerName)
 {
@@ -12,145 +14,170 @@ bool BatteryCanReceiver::init(bool verboseLogging, char const* providerName)
     MessageOutput.printf("[%s] Initialize interface...\r\n",
             _providerName);
 
-    const PinMapping_t& pin = PinMapping.get();
-    MessageOutput.printf("[%s] Interface rx = %d, tx = %d\r\n",
-            _providerName, pin.battery_rx, pin.battery_tx);
+    _upCounters = std::make_unique<MessageCounters[]>(getMessageIds().Count);
+    _lastRateUpdate = millis();
 
-    if (pin.battery_rx < 0 || pin.battery_tx < 0) {
-        MessageOutput.printf("[%s] Invalid pin config\r\n",
+    _rxQueue = xQueueCreate(32, sizeof(twai_message_t));
+    if (_rxQueue == nullptr) {
+        MessageOutput.printf("[%s] Failed to create receive queue\r\n",
                 _providerName);
         return false;
     }
 
-    auto tx = static_cast<gpio_num_t>(pin.battery_tx);
-    auto rx = static_cast<gpio_num_t>(pin.battery_rx);
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(tx, rx, TWAI_MODE_NORMAL);
-
-    // interrupts at level 1 are in high demand, at least on ESP32-S3 boards,
-    // but only a limited amount can be allocated. failing to allocate an
-    // interrupt in the TWAI driver will cause a bootloop. we therefore
-    // register the TWAI driver's interrupt at level 2. level 2 interrupts
-    // should be available -- we don't really know. we would love to have the
-    // esp_intr_dump() function, but that's not available yet in our version
-    // of the underlying esp-idf.
-    g_config.intr_flags = ESP_INTR_FLAG_LEVEL2;
-
-    // Initialize configuration structures using macro initializers
-    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
-    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
-
-    // Install TWAI driver
-    esp_err_t twaiLastResult = twai_driver_install(&g_config, &t_config, &f_config);
-    switch (twaiLastResult) {
-        case ESP_OK:
-            MessageOutput.printf("[%s] Twai driver installed\r\n",
-                    _providerName);
-            break;
-        case ESP_ERR_INVALID_ARG:
-            MessageOutput.printf("[%s] Twai driver install - invalid arg\r\n",
-                    _providerName);
-            return false;
-            break;
-        case ESP_ERR_NO_MEM:
-            MessageOutput.printf("[%s] Twai driver install - no memory\r\n",
-                    _providerName);
-            return false;
-            break;
-        case ESP_ERR_INVALID_STATE:
-            MessageOutput.printf("[%s] Twai driver install - invalid state\r\n",
-                    _providerName);
-            return false;
-            break;
+    auto const pin = getPins();
+
+    _subscription = CanBus.subscribe({ _providerName,
+            pin.rx, pin.tx, 500/*kbit/s*/, getFilters(),
+            [this](twai_message_t const& rx_message) { onFrame(rx_message); }
+    });
+
+    return _subscription >= 0;
+}
+
+std::vector<CanBusClass::Filter> BatteryCanReceiver::getFilters() const
+{
+    auto messageIds = getMessageIds();
+
+    // the bits which are the same for all identifiers in the range [first,
+    // last) must match, all other bits are "don't care" bits.
+    auto makeFilter = [&messageIds](size_t first, size_t last) -> CanBusClass::Filter {
+        uint32_t andBits = 0x7FF;
+        uint32_t orBits = 0;
+        for (size_t i = first; i < last; ++i) {
+            andBits &= messageIds.Ids[i];
+            orBits |= messageIds.Ids[i];
+        }
+        return { andBits, andBits ^ orBits, false/*extended*/ };
+    };
+
+    if (messageIds.Count < 2) { return { makeFilter(0, messageIds.Count) }; }
+
+    // the controller supports two filters for standard frames. we split the
+    // sorted identifiers into two groups such that the number of "don't
+    // care" bits is minimal, which is a decent approximation of letting the
+    // least amount of unwanted frames pass.
+    std::vector<CanBusClass::Filter> res;
+    int bestCost = std::numeric_limits<int>::max();
+    for (size_t split = 1; split < messageIds.Count; ++split) {
+        auto a = makeFilter(0, split);
+        auto b = makeFilter(split, messageIds.Count);
+        int cost = __builtin_popcount(a.Mask) + __builtin_popcount(b.Mask);
+        if (cost >= bestCost) { continue; }
+        res = { a, b };
+        bestCost = cost;
     }
 
-    // Start TWAI driver
-    twaiLastResult = twai_start();
-    switch (twaiLastResult) {
-        case ESP_OK:
-            MessageOutput.printf("[%s] Twai driver started\r\n",
-                    _providerName);
-            break;
-        case ESP_ERR_INVALID_STATE:
-            MessageOutput.printf("[%s] Twai driver start - invalid state\r\n",
-                    _providerName);
-            return false;
-            break;
+    return res;
+}
+
+void BatteryCanReceiver::onFrame(twai_message_t const& rx_message)
+{
+    // the acceptance filters may let pass frames we are not interested in
+    int idx = findMessageIndex(rx_message);
+    if (idx < 0) { return; }
+
+    auto& counters = _upCounters[idx];
+    ++counters.Frames;
+
+    if (xQueueSend(_rxQueue, &rx_message, 0) != pdTRUE) {
+        ++counters.Dropped;
     }
+}
 
-    return true;
+int BatteryCanReceiver::findMessageIndex(twai_message_t const& rx_message) const
+{
+    // all receivers exclusively process standard frames
+    if (rx_message.extd) { return -1; }
+
+    auto messageIds = getMessageIds();
+    auto end = messageIds.Ids + messageIds.Count;
+    auto it = std::lower_bound(messageIds.Ids, end, rx_message.identifier);
+    if (it == end || *it != rx_message.identifier) { return -1; }
+    return it - messageIds.Ids;
 }
 
 void BatteryCanReceiver::deinit()
 {
-    // Stop TWAI driver
-    esp_err_t twaiLastResult = twai_stop();
-    switch (twaiLastResult) {
-        case ESP_OK:
-            MessageOutput.printf("[%s] Twai driver stopped\r\n",
-                    _providerName);
-            break;
-        case ESP_ERR_INVALID_STATE:
-            MessageOutput.printf("[%s] Twai driver stop - invalid state\r\n",
-                    _providerName);
-            break;
+    if (_subscription >= 0) {
+        CanBus.unsubscribe(_subscription);
+        _subscription = -1;
     }
 
-    // Uninstall TWAI driver
-    twaiLastResult = twai_driver_uninstall();
-    switch (twaiLastResult) {
-        case ESP_OK:
-            MessageOutput.printf("[%s] Twai driver uninstalled\r\n",
-                    _providerName);
-            break;
-        case ESP_ERR_INVALID_STATE:
-            MessageOutput.printf("[%s] Twai driver uninstall - invalid state\r\n",
-                    _providerName);
-            break;
+    if (_rxQueue != nullptr) {
+        vQueueDelete(_rxQueue);
+        _rxQueue = nullptr;
     }
 }
 
 void BatteryCanReceiver::loop()
 {
-    // Check for messages. twai_receive is blocking when there is no data so we return if there are no frames in the buffer
-    twai_status_info_t status_info;
-    esp_err_t twaiLastResult = twai_get_status_info(&status_info);
-    if (twaiLastResult != ESP_OK) {
-        switch (twaiLastResult) {
-            case ESP_ERR_INVALID_ARG:
-                MessageOutput.printf("[%s] Twai driver get status - invalid arg\r\n",
-                        _providerName);
-                break;
-            case ESP_ERR_INVALID_STATE:
-                MessageOutput.printf("[%s] Twai driver get status - invalid state\r\n",
-                        _providerName);
-                break;
+    if (_rxQueue == nullptr) { return; }
+
+    twai_message_t rx_message;
+    while (xQueueReceive(_rxQueue, &rx_message, 0) == pdTRUE) {
+        if (_verboseLogging) {
+            MessageOutput.printf("[%s] Received CAN message: 0x%04X -",
+                    _providerName, rx_message.identifier);
+
+            for (int i = 0; i < rx_message.data_length_code; i++) {
+                MessageOutput.printf(" %02X", rx_message.data[i]);
+            }
+
+            MessageOutput.printf("\r\n");
         }
-        return;
-    }
-    if (status_info.msgs_to_rx == 0) {
-        return;
+
+        onMessage(rx_message);
     }
 
-    // Wait for message to be received, function is blocking
-    twai_message_t rx_message;
-    if (twai_receive(&rx_message, pdMS_TO_TICKS(100)) != ESP_OK) {
-        MessageOutput.printf("[%s] Failed to receive message",
-                _providerName);
-        return;
+    updateRates();
+}
+
+void BatteryCanReceiver::updateRates()
+{
+    uint32_t constexpr interval = 10 * 1000;
+    uint32_t elapsed = millis() - _lastRateUpdate;
+    if (elapsed < interval) { return; }
+    _lastRateUpdate += elapsed;
+
+    uint32_t frames = 0;
+    uint32_t dropped = 0;
+    auto messageIds = getMessageIds();
+    for (size_t i = 0; i < messageIds.Count; ++i) {
+        auto& counters = _upCounters[i];
+        uint32_t total = counters.Frames;
+        counters.Rate = (total - counters.FramesAtLastRateUpdate) * 1000.0f / elapsed;
+        counters.FramesAtLastRateUpdate = total;
+        frames += total;
+        dropped += counters.Dropped;
     }
 
-    if (_verboseLogging) {
-        MessageOutput.printf("[%s] Received CAN message: 0x%04X -",
-                _providerName, rx_message.identifier);
+    if (!_verboseLogging) { return; }
 
-        for (int i = 0; i < rx_message.data_length_code; i++) {
-            MessageOutput.printf(" %02X", rx_message.data[i]);
-        }
+    twai_status_info_t status_info;
+    uint32_t missed = 0;
+    if (twai_get_status_info(&status_info) == ESP_OK) {
+        missed = status_info.rx_missed_count + status_info.rx_overrun_count;
+    }
 
-        MessageOutput.printf("\r\n");
+    MessageOutput.printf("[%s] frames: %" PRIu32 ", dropped: %" PRIu32
+            ", missed by driver: %" PRIu32 "\r\n",
+            _providerName, frames, dropped, missed);
+}
+
+std::vector<BatteryProvider::CanMessageStats> BatteryCanReceiver::getCanMessageStats() const
+{
+    std::vector<CanMessageStats> res;
+    if (!_upCounters) { return res; }
+
+    auto messageIds = getMessageIds();
+    res.reserve(messageIds.Count);
+    for (size_t i = 0; i < messageIds.Count; ++i) {
+        auto const& counters = _upCounters[i];
+        res.push_back({ messageIds.Ids[i], counters.Frames,
+                counters.Dropped, counters.Rate });
     }
 
-    onMessage(rx_message);
+    return res;
 }
 
 uint8_t BatteryCanReceiver::readUnsignedInt8(uint8_t *data)
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "BatteryResistanceEstimator.h"
+#include <cmath>
+
+void BatteryResistanceEstimator::reset()
+{
+    _initialized = false;
+    _updates = 0;
+    _lastAmps = 0;
+    _voc = 0;
+    _resistance = 0;
+
+    // large initial uncertainty, such that the first samples dominate
+    _p00 = 100;
+    _p01 = 0;
+    _p11 = 1;
+}
+
+void BatteryResistanceEstimator::addSample(float volts, float amps)
+{
+    if (!std::isfinite(volts) || !std::isfinite(amps) || volts <= 0) { return; }
+
+    if (!_initialized) {
+        _voc = volts;
+        _lastAmps = amps;
+        _initialized = true;
+        return;
+    }
+
+    if (std::fabs(amps - _lastAmps) < _minCurrentStep) { return; }
+    _lastAmps = amps;
+
+    // regressor is (1, I), hence P * phi is (p00 + p01 * I, p01 + p11 * I)
+    double const i = amps;
+    double const pPhi0 = _p00 + _p01 * i;
+    double const pPhi1 = _p01 + _p11 * i;
+    double const denominator = _forgettingFactor + pPhi0 + i * pPhi1;
+    double const k0 = pPhi0 / denominator;
+    double const k1 = pPhi1 / denominator;
+
+    double const error = volts - (_voc + _resistance * i);
+    _voc += k0 * error;
+    _resistance += k1 * error;
+
+    _p00 = (_p00 - k0 * pPhi0) / _forgettingFactor;
+    _p01 = (_p01 - k0 * pPhi1) / _forgettingFactor;
+    _p11 = (_p11 - k1 * pPhi1) / _forgettingFactor;
+
+    ++_updates;
+}
+
+std::optional<float> BatteryResistanceEstimator::getResistance() const
+{
+    if (_updates < _minUpdates) { return std::nullopt; }
+
+    if (_resistance <= 0 || _resistance > _maxResistance) { return std::nullopt; }
+
+    return static_cast<float>(_resistance);
+}
@@ -1,12 +1,13 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <map>
 #include "BatteryStats.h"
 #include "Configuration.h"
 #include "MqttSettings.h"
 #include "JkBmsDataPoints.h"
 #include "JbdBmsDataPoints.h"
-#include "MqttSettings.h"
 
 template<typename T>
 static void addLiveViewInSection(JsonVariant& root,
@@ -401,16 +402,167 @@ void JbdBmsBatteryStats::getJsonData(JsonVariant& root, bool verbose) const
     }
 }
 
+// remembers the last published value per battery topic. values are only
+// published again if they changed or if they were not published for the
+// current stats' full publish interval. in bundled mode, all values are
+// collected in a single JSON message, which is published if any of them is
+// due. only the battery task publishes, so no locking is needed.
+class BatteryMqttPublisher {
+    public:
+        void begin(uint32_t maxAgeMs, bool bundled) {
+            _maxAgeMs = maxAgeMs;
+            _bundled = bundled;
+            _bundleDue = false;
+            _bundle.clear();
+        }
+
+        void end() {
+            if (!_bundled || !_bundleDue) { return; }
+
+            String payload;
+            serializeJson(_bundle, payload);
+            MqttSettings.publish("battery/json", payload);
+        }
+
+        void reset() { _values.clear(); }
+
+        bool isBundled() const { return _bundled; }
+        JsonDocument& getBundle() { return _bundle; }
+        void setBundleDue() { _bundleDue = true; }
+
+        bool changed(char const* group, char const* subtopic, float value, float deadband) {
+            auto& entry = _values[{ group, subtopic }];
+
+            bool expired = !entry.Published || (millis() - entry.LastPublish) >= _maxAgeMs;
+            bool unchanged = (deadband > 0) ? (std::fabs(value - entry.Value) < deadband)
+                : (value == entry.Value);
+            if (!expired && unchanged) {
+                addToBundle(group, subtopic, entry.Payload, false);
+                return false;
+            }
+
+            entry.Value = value;
+            return true;
+        }
+
+        void publish(char const* group, char const* subtopic, String const& payload, bool numeric) {
+            auto& entry = _values[{ group, subtopic }];
+
+            bool expired = !entry.Published || (millis() - entry.LastPublish) >= _maxAgeMs;
+            bool unchanged = entry.Published && entry.Payload == payload;
+            if (!numeric && !expired && unchanged) {
+                addToBundle(group, subtopic, entry.Payload, false);
+                return;
+            }
+
+            entry.Payload = payload;
+            entry.LastPublish = millis();
+            entry.Published = true;
+            entry.Numeric = numeric;
+
+            if (_bundled) {
+                addToBundle(group, subtopic, payload, true);
+                return;
+            }
+
+            String topic("battery/");
+            if (group != nullptr) {
+                topic += group;
+                topic += "/";
+            }
+            topic += subtopic;
+            MqttSettings.publish(topic, payload);
+        }
+
+    private:
+        void addToBundle(char const* group, char const* subtopic, String const& payload, bool due) {
+            if (!_bundled) { return; }
+            _bundleDue |= due;
+
+            JsonObject root = _bundle.as<JsonObject>();
+            if (root.isNull()) { root = _bundle.to<JsonObject>(); }
+
+            bool numeric = _values[{ group, subtopic }].Numeric;
+            if (group == nullptr) {
+                setNested(root, subtopic, payload, numeric);
+                return;
+            }
+
+            setNested(getChild(root, group), subtopic, payload, numeric);
+        }
+
+        template<typename K>
+        static JsonObject getChild(JsonObject parent, K const& key) {
+            return parent[key].is<JsonObject>() ? parent[key].as<JsonObject>()
+                : parent[key].to<JsonObject>();
+        }
+
+        // subtopics like "settings/chargeVoltage" become nested objects
+        static void setNested(JsonObject target, char const* path, String const& payload, bool numeric) {
+            char const* slash = strchr(path, '/');
+            if (slash != nullptr) {
+                std::string key(path, slash - path);
+                setNested(getChild(target, key), slash + 1, payload, numeric);
+                return;
+            }
+
+            bool finite = payload != "nan" && payload != "inf" && payload != "-inf";
+            if (numeric && finite) {
+                target[path] = serialized(payload);
+            } else {
+                target[path] = payload;
+            }
+        }
+
+        struct Entry {
+            float Value = 0;
+            String Payload;
+            uint32_t LastPublish = 0;
+            bool Published = false;
+            bool Numeric = false;
+        };
+
+        std::map<std::pair<char const*, char const*>, Entry> _values;
+        uint32_t _maxAgeMs = 0;
+        bool _bundled = false;
+        bool _bundleDue = false;
+        JsonDocument _bundle;
+};
+
+static BatteryMqttPublisher sMqttPublisher;
+
+bool BatteryStats::mqttValueChanged(char const* group, char const* subtopic, float value, float deadband)
+{
+    return sMqttPublisher.changed(group, subtopic, value, deadband);
+}
+
+void BatteryStats::mqttPublishPayload(char const* group, char const* subtopic, String const& payload)
+{
+    sMqttPublisher.publish(group, subtopic, payload, true/*numeric*/);
+}
+
+void BatteryStats::publishGroupValue(char const* group, char const* subtopic, String const& value)
+{
+    sMqttPublisher.publish(group, subtopic, value, false/*numeric*/);
+}
+
 void BatteryStats::mqttLoop()
 {
     auto& config = Configuration.get();
 
-    if (!MqttSettings.getConnected()
-            || (millis() - _lastMqttPublish) < (config.Mqtt.PublishInterval * 1000)) {
+    if (!MqttSettings.getConnected()) {
+        // the broker might lose all values while we are disconnected
+        sMqttPublisher.reset();
         return;
     }
 
+    if ((millis() - _lastMqttPublish) < (config.Mqtt.PublishInterval * 1000)) {
+        return;
+    }
+
+    sMqttPublisher.begin(getMqttFullPublishIntervalMs(), config.Battery.MqttBundled);
     mqttPublish();
+    sMqttPublisher.end();
 
     _lastMqttPublish = millis();
 }
@@ -419,32 +571,31 @@ uint32_t BatteryStats::getMqttFullPublishIntervalMs() const
 {
     auto& config = Configuration.get();
 
-    // this is the default interval, see mqttLoop(). mqttPublish()
-    // implementations in derived classes may choose to publish some values
-    // with a lower frequency and hence implement this method with a different
-    // return value.
-    return config.Mqtt.PublishInterval * 1000;
+    // values which did not change are re-published at this interval, at
+    // most once per minute, but at least at the regular publish interval.
+    // implementations in derived classes may choose a different interval.
+    return std::max<uint32_t>(60 * 1000, config.Mqtt.PublishInterval * 1000);
 }
 
 void BatteryStats::mqttPublish() const
 {
-    MqttSettings.publish("battery/manufacturer", _manufacturer);
-    MqttSettings.publish("battery/dataAge", String(getAgeSeconds()));
+    publishValue("manufacturer", _manufacturer);
+    publishValue("dataAge", getAgeSeconds());
 
     if (isSoCValid()) {
-        MqttSettings.publish("battery/stateOfCharge", String(_soc));
+        publishValue("stateOfCharge", _soc);
     }
 
     if (isVoltageValid()) {
-        MqttSettings.publish("battery/voltage", String(_voltage));
+        publishValue("voltage", _voltage, 0.05/*deadband*/);
     }
 
     if (isCurrentValid()) {
-        MqttSettings.publish("battery/current", String(_current));
+        publishValue("current", _current, 0.1/*deadband*/);
     }
 
     if (isDischargeCurrentLimitValid()) {
-        MqttSettings.publish("battery/settings/dischargeCurrentLimitation", String(_dischargeCurrentLimit));
+        publishValue("settings/dischargeCurrentLimitation", _dischargeCurrentLimit);
     }
 }
 
@@ -452,115 +603,154 @@ void PylontechBatteryStats::mqttPublish() const
 {
     BatteryStats::mqttPublish();
 
-    MqttSettings.publish("battery/settings/chargeVoltage", String(_chargeVoltage));
-    MqttSettings.publish("battery/settings/chargeCurrentLimitation", String(_chargeCurrentLimitation));
-    MqttSettings.publish("battery/settings/dischargeVoltageLimitation", String(_dischargeVoltageLimitation));
-    MqttSettings.publish("battery/stateOfHealth", String(_stateOfHealth));
-    MqttSettings.publish("battery/temperature", String(_temperature));
-    MqttSettings.publish("battery/alarm/overCurrentDischarge", String(_alarmOverCurrentDischarge));
-    MqttSettings.publish("battery/alarm/overCurrentCharge", String(_alarmOverCurrentCharge));
-    MqttSettings.publish("battery/alarm/underTemperature", String(_alarmUnderTemperature));
-    MqttSettings.publish("battery/alarm/overTemperature", String(_alarmOverTemperature));
-    MqttSettings.publish("battery/alarm/underVoltage", String(_alarmUnderVoltage));
-    MqttSettings.publish("battery/alarm/overVoltage", String(_alarmOverVoltage));
-    MqttSettings.publish("battery/alarm/bmsInternal", String(_alarmBmsInternal));
-    MqttSettings.publish("battery/warning/highCurrentDischarge", String(_warningHighCurrentDischarge));
-    MqttSettings.publish("battery/warning/highCurrentCharge", String(_warningHighCurrentCharge));
-    MqttSettings.publish("battery/warning/lowTemperature", String(_warningLowTemperature));
-    MqttSettings.publish("battery/warning/highTemperature", String(_warningHighTemperature));
-    MqttSettings.publish("battery/warning/lowVoltage", String(_warningLowVoltage));
-    MqttSettings.publish("battery/warning/highVoltage", String(_warningHighVoltage));
-    MqttSettings.publish("battery/warning/bmsInternal", String(_warningBmsInternal));
-    MqttSettings.publish("battery/charging/chargeEnabled", String(_chargeEnabled));
-    MqttSettings.publish("battery/charging/dischargeEnabled", String(_dischargeEnabled));
-    MqttSettings.publish("battery/charging/chargeImmediately", String(_chargeImmediately));
-    MqttSettings.publish("battery/modulesTotal", String(_moduleCount));
+    publishValue("settings/chargeVoltage", _chargeVoltage);
+    publishValue("settings/chargeCurrentLimitation", _chargeCurrentLimitation);
+    publishValue("settings/dischargeVoltageLimitation", _dischargeVoltageLimitation);
+    publishValue("stateOfHealth", _stateOfHealth);
+    publishValue("temperature", _temperature, 0.5/*deadband*/);
+    publishValue("alarm/overCurrentDischarge", _alarmOverCurrentDischarge);
+    publishValue("alarm/overCurrentCharge", _alarmOverCurrentCharge);
+    publishValue("alarm/underTemperature", _alarmUnderTemperature);
+    publishValue("alarm/overTemperature", _alarmOverTemperature);
+    publishValue("alarm/underVoltage", _alarmUnderVoltage);
+    publishValue("alarm/overVoltage", _alarmOverVoltage);
+    publishValue("alarm/bmsInternal", _alarmBmsInternal);
+    publishValue("warning/highCurrentDischarge", _warningHighCurrentDischarge);
+    publishValue("warning/highCurrentCharge", _warningHighCurrentCharge);
+    publishValue("warning/lowTemperature", _warningLowTemperature);
+    publishValue("warning/highTemperature", _warningHighTemperature);
+    publishValue("warning/lowVoltage", _warningLowVoltage);
+    publishValue("warning/highVoltage", _warningHighVoltage);
+    publishValue("warning/bmsInternal", _warningBmsInternal);
+    publishValue("charging/chargeEnabled", _chargeEnabled);
+    publishValue("charging/dischargeEnabled", _dischargeEnabled);
+    publishValue("charging/chargeImmediately", _chargeImmediately);
+    publishValue("modulesTotal", _moduleCount);
 }
 
 void SBSBatteryStats::mqttPublish() const
 {
     BatteryStats::mqttPublish();
 
-    MqttSettings.publish("battery/settings/chargeVoltage", String(_chargeVoltage));
-    MqttSettings.publish("battery/settings/chargeCurrentLimitation", String(_chargeCurrentLimitation));
-    MqttSettings.publish("battery/stateOfHealth", String(_stateOfHealth));
-    MqttSettings.publish("battery/current", String(_current));
-    MqttSettings.publish("battery/temperature", String(_temperature));
-    MqttSettings.publish("battery/alarm/underVoltage", String(_alarmUnderVoltage));
-    MqttSettings.publish("battery/alarm/overVoltage", String(_alarmOverVoltage));
-    MqttSettings.publish("battery/alarm/bmsInternal", String(_alarmBmsInternal));
-    MqttSettings.publish("battery/warning/highCurrentDischarge", String(_warningHighCurrentDischarge));
-    MqttSettings.publish("battery/warning/highCurrentCharge", String(_warningHighCurrentCharge));
-    MqttSettings.publish("battery/charging/chargeEnabled", String(_chargeEnabled));
-    MqttSettings.publish("battery/charging/dischargeEnabled", String(_dischargeEnabled));
+    publishValue("settings/chargeVoltage", _chargeVoltage);
+    publishValue("settings/chargeCurrentLimitation", _chargeCurrentLimitation);
+    publishValue("stateOfHealth", _stateOfHealth);
+    publishValue("current", _current, 0.1/*deadband*/);
+    publishValue("temperature", _temperature, 0.5/*deadband*/);
+    publishValue("alarm/underVoltage", _alarmUnderVoltage);
+    publishValue("alarm/overVoltage", _alarmOverVoltage);
+    publishValue("alarm/bmsInternal", _alarmBmsInternal);
+    publishValue("warning/highCurrentDischarge", _warningHighCurrentDischarge);
+    publishValue("warning/highCurrentCharge", _warningHighCurrentCharge);
+    publishValue("charging/chargeEnabled", _chargeEnabled);
+    publishValue("charging/dischargeEnabled", _dischargeEnabled);
 }
 
 void PytesBatteryStats::mqttPublish() const
 {
     BatteryStats::mqttPublish();
 
-    MqttSettings.publish("battery/settings/chargeVoltage", String(_chargeVoltageLimit));
-    MqttSettings.publish("battery/settings/chargeCurrentLimitation", String(_chargeCurrentLimit));
-    MqttSettings.publish("battery/settings/dischargeVoltageLimitation", String(_dischargeVoltageLimit));
+    publishValue("settings/chargeVoltage", _chargeVoltageLimit);
+    publishValue("settings/chargeCurrentLimitation", _chargeCurrentLimit);
+    publishValue("settings/dischargeVoltageLimitation", _dischargeVoltageLimit);
 
-    MqttSettings.publish("battery/stateOfHealth", String(_stateOfHealth));
+    publishValue("stateOfHealth", _stateOfHealth);
     if (_chargeCycles != -1) {
-        MqttSettings.publish("battery/chargeCycles", String(_chargeCycles));
+        publishValue("chargeCycles", _chargeCycles);
     }
     if (_balance != -1) {
-        MqttSettings.publish("battery/balancingActive", String(_balance ? 1 : 0));
+        publishValue("balancingActive", _balance ? 1 : 0);
     }
-    MqttSettings.publish("battery/temperature", String(_temperature));
+    publishValue("temperature", _temperature, 0.5/*deadband*/);
 
     if (_chargedEnergy != -1) {
-        MqttSettings.publish("battery/chargedEnergy", String(_chargedEnergy));
+        publishValue("chargedEnergy", _chargedEnergy);
     }
 
     if (_dischargedEnergy != -1) {
-        MqttSettings.publish("battery/dischargedEnergy", String(_dischargedEnergy));
-    }
-
-    MqttSettings.publish("battery/capacity", String(_totalCapacity));
-    MqttSettings.publish("battery/availableCapacity", String(_availableCapacity));
-
-    MqttSettings.publish("battery/CellMinMilliVolt", String(_cellMinMilliVolt));
-    MqttSettings.publish("battery/CellMaxMilliVolt", String(_cellMaxMilliVolt));
-    MqttSettings.publish("battery/CellDiffMilliVolt", String(_cellMaxMilliVolt - _cellMinMilliVolt));
-    MqttSettings.publish("battery/CellMinTemperature", String(_cellMinTemperature));
-    MqttSettings.publish("battery/CellMaxTemperature", String(_cellMaxTemperature));
-    MqttSettings.publish("battery/CellMinVoltageName", String(_cellMinVoltageName));
-    MqttSettings.publish("battery/CellMaxVoltageName", String(_cellMaxVoltageName));
-    MqttSettings.publish("battery/CellMinTemperatureName", String(_cellMinTemperatureName));
-    MqttSettings.publish("battery/CellMaxTemperatureName", String(_cellMaxTemperatureName));
-
-    MqttSettings.publish("battery/modulesOnline", String(_moduleCountOnline));
-    MqttSettings.publish("battery/modulesOffline", String(_moduleCountOffline));
-    MqttSettings.publish("battery/modulesBlockingCharge", String(_moduleCountBlockingCharge));
-    MqttSettings.publish("battery/modulesBlockingDischarge", String(_moduleCountBlockingDischarge));
-
-    MqttSettings.publish("battery/alarm/overCurrentDischarge", String(_alarmOverCurrentDischarge));
-    MqttSettings.publish("battery/alarm/overCurrentCharge", String(_alarmOverCurrentCharge));
-    MqttSettings.publish("battery/alarm/underVoltage", String(_alarmUnderVoltage));
-    MqttSettings.publish("battery/alarm/overVoltage", String(_alarmOverVoltage));
-    MqttSettings.publish("battery/alarm/underTemperature", String(_alarmUnderTemperature));
-    MqttSettings.publish("battery/alarm/overTemperature", String(_alarmOverTemperature));
-    MqttSettings.publish("battery/alarm/underTemperatureCharge", String(_alarmUnderTemperatureCharge));
-    MqttSettings.publish("battery/alarm/overTemperatureCharge", String(_alarmOverTemperatureCharge));
-    MqttSettings.publish("battery/alarm/bmsInternal", String(_alarmInternalFailure));
-    MqttSettings.publish("battery/alarm/cellImbalance", String(_alarmCellImbalance));
-
-    MqttSettings.publish("battery/warning/highCurrentDischarge", String(_warningHighDischargeCurrent));
-    MqttSettings.publish("battery/warning/highCurrentCharge", String(_warningHighChargeCurrent));
-    MqttSettings.publish("battery/warning/lowVoltage", String(_warningLowVoltage));
-    MqttSettings.publish("battery/warning/highVoltage", String(_warningHighVoltage));
-    MqttSettings.publish("battery/warning/lowTemperature", String(_warningLowTemperature));
-    MqttSettings.publish("battery/warning/highTemperature", String(_warningHighTemperature));
-    MqttSettings.publish("battery/warning/lowTemperatureCharge", String(_warningLowTemperatureCharge));
-    MqttSettings.publish("battery/warning/highTemperatureCharge", String(_warningHighTemperatureCharge));
-    MqttSettings.publish("battery/warning/bmsInternal", String(_warningInternalFailure));
-    MqttSettings.publish("battery/warning/cellImbalance", String(_warningCellImbalance));
-
-    MqttSettings.publish("battery/charging/chargeImmediately", String(_chargeImmediately));
+        publishValue("dischargedEnergy", _dischargedEnergy);
+    }
+
+    publishValue("capacity", _totalCapacity);
+    publishValue("availableCapacity", _availableCapacity);
+
+    publishValue("CellMinMilliVolt", _cellMinMilliVolt);
+    publishValue("CellMaxMilliVolt", _cellMaxMilliVolt);
+    publishValue("CellDiffMilliVolt", _cellMaxMilliVolt - _cellMinMilliVolt);
+    publishValue("CellMinTemperature", _cellMinTemperature, 0.5/*deadband*/);
+    publishValue("CellMaxTemperature", _cellMaxTemperature, 0.5/*deadband*/);
+    publishValue("CellMinVoltageName", _cellMinVoltageName);
+    publishValue("CellMaxVoltageName", _cellMaxVoltageName);
+    publishValue("CellMinTemperatureName", _cellMinTemperatureName);
+    publishValue("CellMaxTemperatureName", _cellMaxTemperatureName);
+
+    publishValue("modulesOnline", _moduleCountOnline);
+    publishValue("modulesOffline", _moduleCountOffline);
+    publishValue("modulesBlockingCharge", _moduleCountBlockingCharge);
+    publishValue("modulesBlockingDischarge", _moduleCountBlockingDischarge);
+
+    publishValue("alarm/overCurrentDischarge", _alarmOverCurrentDischarge);
+    publishValue("alarm/overCurrentCharge", _alarmOverCurrentCharge);
+    publishValue("alarm/underVoltage", _alarmUnderVoltage);
+    publishValue("alarm/overVoltage", _alarmOverVoltage);
+    publishValue("alarm/underTemperature", _alarmUnderTemperature);
+    publishValue("alarm/overTemperature", _alarmOverTemperature);
+    publishValue("alarm/underTemperatureCharge", _alarmUnderTemperatureCharge);
+    publishValue("alarm/overTemperatureCharge", _alarmOverTemperatureCharge);
+    publishValue("alarm/bmsInternal", _alarmInternalFailure);
+    publishValue("alarm/cellImbalance", _alarmCellImbalance);
+
+    publishValue("warning/highCurrentDischarge", _warningHighDischargeCurrent);
+    publishValue("warning/highCurrentCharge", _warningHighChargeCurrent);
+    publishValue("warning/lowVoltage", _warningLowVoltage);
+    publishValue("warning/highVoltage", _warningHighVoltage);
+    publishValue("warning/lowTemperature", _warningLowTemperature);
+    publishValue("warning/highTemperature", _warningHighTemperature);
+    publishValue("warning/lowTemperatureCharge", _warningLowTemperatureCharge);
+    publishValue("warning/highTemperatureCharge", _warningHighTemperatureCharge);
+    publishValue("warning/bmsInternal", _warningInternalFailure);
+    publishValue("warning/cellImbalance", _warningCellImbalance);
+
+    publishValue("charging/chargeImmediately", _chargeImmediately);
+}
+
+// publishes the voltage of every cell which changed since it was last
+// published, or of all cells if fullPublish is set, and the cell extremes.
+// in bundled mode, the cell voltages are added as an array instead.
+static void mqttPublishCellVoltages(tCellVoltages const& cells,
+        tCellVoltages& published, bool fullPublish)
+{
+    auto publishExtreme = [](char const* subtopic, uint16_t milliVolt) {
+        if (!sMqttPublisher.changed(nullptr, subtopic, milliVolt, 0)) { return; }
+        sMqttPublisher.publish(nullptr, subtopic, String(milliVolt), true/*numeric*/);
+    };
+
+    publishExtreme("CellMinMilliVolt", cells.getMinMilliVolt());
+    publishExtreme("CellAvgMilliVolt", cells.getAvgMilliVolt());
+    publishExtreme("CellMaxMilliVolt", cells.getMaxMilliVolt());
+    publishExtreme("CellDiffMilliVolt", cells.getDeltaMilliVolt());
+
+    tCellVoltages previous = published;
+    published = cells;
+
+    if (sMqttPublisher.isBundled()) {
+        JsonArray array = sMqttPublisher.getBundle()["CellsMilliVolt"].to<JsonArray>();
+        for (auto const& cell : cells) { array.add(cell.second); }
+        if (fullPublish || previous != cells) { sMqttPublisher.setBundleDue(); }
+        return;
+    }
+
+    unsigned idx = 1;
+    for (auto iter = cells.cbegin(); iter != cells.cend(); ++iter, ++idx) {
+        bool changed = !previous.has(iter->first) || previous.get(iter->first) != iter->second;
+        if (!fullPublish && !changed) { continue; }
+
+        String topic("battery/Cell");
+        topic += String(idx);
+        topic += "MilliVolt";
+
+        MqttSettings.publish(topic, String(iter->second));
+    }
 }
 
 void JkBmsBatteryStats::mqttPublish() const
@@ -584,34 +774,22 @@ void JkBmsBatteryStats::mqttPublish() const
     bool intervalElapsed = _lastFullMqttPublish + getMqttFullPublishIntervalMs() < millis();
     bool fullPublish = neverFullyPublished || intervalElapsed;
 
+    // the bundled message must hold all data points, changed or not
+    bool bundled = Configuration.get().Battery.MqttBundled;
+
     for (auto iter = _dataPoints.cbegin(); iter != _dataPoints.cend(); ++iter) {
         // skip data points that did not change since last published
-        if (!fullPublish && iter->second.getTimestamp() < _lastMqttPublish) { continue; }
+        if (!fullPublish && !bundled && iter->second.getTimestamp() < _lastMqttPublish) { continue; }
 
         auto skipMatch = std::find(mqttSkip.begin(), mqttSkip.end(), iter->first);
         if (skipMatch != mqttSkip.end()) { continue; }
 
-        String topic((std::string("battery/") + iter->second.getLabelText()).c_str());
-        MqttSettings.publish(topic, iter->second.getValueText().c_str());
+        publishValue(iter->second.getLabelText(), String(iter->second.getValueText().c_str()));
     }
 
     auto oCellVoltages = _dataPoints.get<Label::CellsMilliVolt>();
-    if (oCellVoltages.has_value() && (fullPublish || _cellVoltageTimestamp > _lastMqttPublish)) {
-        unsigned idx = 1;
-        for (auto iter = oCellVoltages->cbegin(); iter != oCellVoltages->cend(); ++iter) {
-            String topic("battery/Cell");
-            topic += String(idx);
-            topic += "MilliVolt";
-
-            MqttSettings.publish(topic, String(iter->second));
-
-            ++idx;
-        }
-
-        MqttSettings.publish("battery/CellMinMilliVolt", String(_cellMinMilliVolt));
-        MqttSettings.publish("battery/CellAvgMilliVolt", String(_cellAvgMilliVolt));
-        MqttSettings.publish("battery/CellMaxMilliVolt", String(_cellMaxMilliVolt));
-        MqttSettings.publish("battery/CellDiffMilliVolt", String(_cellMaxMilliVolt - _cellMinMilliVolt));
+    if (oCellVoltages.has_value()) {
+        mqttPublishCellVoltages(*oCellVoltages, _publishedCellVoltages, fullPublish);
     }
 
     auto oAlarms = _dataPoints.get<Label::AlarmsBitmask>();
@@ -619,7 +797,7 @@ void JkBmsBatteryStats::mqttPublish() const
         for (auto iter = JkBms::AlarmBitTexts.begin(); iter != JkBms::AlarmBitTexts.end(); ++iter) {
             auto bit = iter->first;
             String value = (*oAlarms & static_cast<uint16_t>(bit))?"1":"0";
-            MqttSettings.publish(String("battery/alarms/") + iter->second.data(), value);
+            publishGroupValue("alarms", iter->second.data(), value);
         }
     }
 
@@ -628,7 +806,7 @@ void JkBmsBatteryStats::mqttPublish() const
         for (auto iter = JkBms::StatusBitTexts.begin(); iter != JkBms::StatusBitTexts.end(); ++iter) {
             auto bit = iter->first;
             String value = (*oStatus & static_cast<uint16_t>(bit))?"1":"0";
-            MqttSettings.publish(String("battery/status/") + iter->second.data(), value);
+            publishGroupValue("status", iter->second.data(), value);
         }
     }
 
@@ -653,34 +831,22 @@ void JbdBmsBatteryStats::mqttPublish() const
     bool intervalElapsed = _lastFullMqttPublish + getMqttFullPublishIntervalMs() < millis();
     bool fullPublish = neverFullyPublished || intervalElapsed;
 
+    // the bundled message must hold all data points, changed or not
+    bool bundled = Configuration.get().Battery.MqttBundled;
+
     for (auto iter = _dataPoints.cbegin(); iter != _dataPoints.cend(); ++iter) {
         // skip data points that did not change since last published
-        if (!fullPublish && iter->second.getTimestamp() < _lastMqttPublish) { continue; }
+        if (!fullPublish && !bundled && iter->second.getTimestamp() < _lastMqttPublish) { continue; }
 
         auto skipMatch = std::find(mqttSkip.begin(), mqttSkip.end(), iter->first);
         if (skipMatch != mqttSkip.end()) { continue; }
 
-        String topic((std::string("battery/") + iter->second.getLabelText()).c_str());
-        MqttSettings.publish(topic, iter->second.getValueText().c_str());
+        publishValue(iter->second.getLabelText(), String(iter->second.getValueText().c_str()));
     }
 
     auto oCellVoltages = _dataPoints.get<Label::CellsMilliVolt>();
-    if (oCellVoltages.has_value() && (fullPublish || _cellVoltageTimestamp > _lastMqttPublish)) {
-        unsigned idx = 1;
-        for (auto iter = oCellVoltages->cbegin(); iter != oCellVoltages->cend(); ++iter) {
-            String topic("battery/Cell");
-            topic += String(idx);
-            topic += "MilliVolt";
-
-            MqttSettings.publish(topic, String(iter->second));
-
-            ++idx;
-        }
-
-        MqttSettings.publish("battery/CellMinMilliVolt", String(_cellMinMilliVolt));
-        MqttSettings.publish("battery/CellAvgMilliVolt", String(_cellAvgMilliVolt));
-        MqttSettings.publish("battery/CellMaxMilliVolt", String(_cellMaxMilliVolt));
-        MqttSettings.publish("battery/CellDiffMilliVolt", String(_cellMaxMilliVolt - _cellMinMilliVolt));
+    if (oCellVoltages.has_value()) {
+        mqttPublishCellVoltages(*oCellVoltages, _publishedCellVoltages, fullPublish);
     }
 
     auto oAlarms = _dataPoints.get<Label::AlarmsBitmask>();
@@ -688,7 +854,7 @@ void JbdBmsBatteryStats::mqttPublish() const
         for (auto iter = JbdBms::AlarmBitTexts.begin(); iter != JbdBms::AlarmBitTexts.end(); ++iter) {
             auto bit = iter->first;
             String value = (*oAlarms & static_cast<uint16_t>(bit))?"1":"0";
-            MqttSettings.publish(String("battery/alarms/") + iter->second.data(), value);
+            publishGroupValue("alarms", iter->second.data(), value);
         }
     }
 
@@ -700,8 +866,14 @@ void JkBmsBatteryStats::updateFrom(JkBms::DataPointContainer const& dp)
 {
     using Label = JkBms::DataPointLabel;
 
-    setManufacturer("JKBMS");
-    auto oProductId = dp.get<Label::ProductId>();
+    // the same container is updated with every frame, so only the fields
+    // that actually changed since the last frame need to be processed.
+    bool productIdChanged = _dataPoints.hasChangedIn<Label::ProductId>(dp);
+    bool cellVoltagesChanged = _dataPoints.hasChangedIn<Label::CellsMilliVolt>(dp);
+    bool versionChanged = _dataPoints.hasChangedIn<Label::BmsSoftwareVersion>(dp);
+
+    if (productIdChanged || _lastUpdate == 0) { setManufacturer("JKBMS"); }
+    auto oProductId = productIdChanged ? dp.get<Label::ProductId>() : std::nullopt;
     if (oProductId.has_value()) {
         // the first twelve chars are expected to be the "User Private Data"
         // setting (see smartphone app). the remainder is expected be the BMS
@@ -738,21 +910,15 @@ void JkBmsBatteryStats::updateFrom(JkBms::DataPointContainer const& dp)
 
     _dataPoints.updateFrom(dp);
 
-    auto oCellVoltages = _dataPoints.get<Label::CellsMilliVolt>();
-    if (oCellVoltages.has_value()) {
-        for (auto iter = oCellVoltages->cbegin(); iter != oCellVoltages->cend(); ++iter) {
-            if (iter == oCellVoltages->cbegin()) {
-                _cellMinMilliVolt = _cellAvgMilliVolt = _cellMaxMilliVolt = iter->second;
-                continue;
-            }
-            _cellMinMilliVolt = std::min(_cellMinMilliVolt, iter->second);
-            _cellAvgMilliVolt = (_cellAvgMilliVolt + iter->second) / 2;
-            _cellMaxMilliVolt = std::max(_cellMaxMilliVolt, iter->second);
-        }
+    auto oCellVoltages = cellVoltagesChanged ? _dataPoints.get<Label::CellsMilliVolt>() : std::nullopt;
+    if (oCellVoltages.has_value() && !oCellVoltages->empty()) {
+        _cellMinMilliVolt = oCellVoltages->getMinMilliVolt();
+        _cellAvgMilliVolt = oCellVoltages->getAvgMilliVolt();
+        _cellMaxMilliVolt = oCellVoltages->getMaxMilliVolt();
         _cellVoltageTimestamp = millis();
     }
 
-    auto oVersion = _dataPoints.get<Label::BmsSoftwareVersion>();
+    auto oVersion = versionChanged ? _dataPoints.get<Label::BmsSoftwareVersion>() : std::nullopt;
     if (oVersion.has_value()) {
         // raw: "11.XW_S11.262H_"
         //   => Hardware "V11.XW" (displayed in Android app)
@@ -800,19 +966,15 @@ void JbdBmsBatteryStats::updateFrom(JbdBms::DataPointContainer const& dp)
                 oCurrentDataPoint->getTimestamp());
     }
 
+    bool cellVoltagesChanged = _dataPoints.hasChangedIn<Label::CellsMilliVolt>(dp);
+
     _dataPoints.updateFrom(dp);
 
-    auto oCellVoltages = _dataPoints.get<Label::CellsMilliVolt>();
-    if (oCellVoltages.has_value()) {
-        for (auto iter = oCellVoltages->cbegin(); iter != oCellVoltages->cend(); ++iter) {
-            if (iter == oCellVoltages->cbegin()) {
-                _cellMinMilliVolt = _cellAvgMilliVolt = _cellMaxMilliVolt = iter->second;
-                continue;
-            }
-            _cellMinMilliVolt = std::min(_cellMinMilliVolt, iter->second);
-            _cellAvgMilliVolt = (_cellAvgMilliVolt + iter->second) / 2;
-            _cellMaxMilliVolt = std::max(_cellMaxMilliVolt, iter->second);
-        }
+    auto oCellVoltages = cellVoltagesChanged ? _dataPoints.get<Label::CellsMilliVolt>() : std::nullopt;
+    if (oCellVoltages.has_value() && !oCellVoltages->empty()) {
+        _cellMinMilliVolt = oCellVoltages->getMinMilliVolt();
+        _cellAvgMilliVolt = oCellVoltages->getAvgMilliVolt();
+        _cellMaxMilliVolt = oCellVoltages->getMaxMilliVolt();
         _cellVoltageTimestamp = millis();
     }
 
@@ -883,12 +1045,24 @@ void VictronSmartShuntStats::getLiveViewData(JsonVariant& root) const {
 void VictronSmartShuntStats::mqttPublish() const {
     BatteryStats::mqttPublish();
 
-    MqttSettings.publish("battery/chargeCycles", String(_chargeCycles));
-    MqttSettings.publish("battery/chargedEnergy", String(_chargedEnergy));
-    MqttSettings.publish("battery/dischargedEnergy", String(_dischargedEnergy));
-    MqttSettings.publish("battery/instantaneousPower", String(_instantaneousPower));
-    MqttSettings.publish("battery/consumedAmpHours", String(_consumedAmpHours));
-    MqttSettings.publish("battery/lastFullCharge", String(_lastFullCharge));
-    MqttSettings.publish("battery/midpointVoltage", String(_midpointVoltage));
-    MqttSettings.publish("battery/midpointDeviation", String(_midpointDeviation));
+    publishValue("chargeCycles", _chargeCycles);
+    publishValue("chargedEnergy", _chargedEnergy);
+    publishValue("dischargedEnergy", _dischargedEnergy);
+    publishValue("instantaneousPower", _instantaneousPower, 5/*deadband*/);
+    publishValue("consumedAmpHours", _consumedAmpHours);
+    publishValue("lastFullCharge", _lastFullCharge);
+    publishValue("midpointVoltage", _midpointVoltage, 0.05/*deadband*/);
+    publishValue("midpointDeviation", _midpointDeviation);
+}
+
+void AggregateBatteryStats::getLiveViewData(JsonVariant& root) const
+{
+    BatteryStats::getLiveViewData(root);
+
+    // values go into the "Status" card of the web application
+    addLiveViewValue(root, "modules", _batteries, "", 0);
+    if (_chargeCurrentLimitation < FLT_MAX) {
+        addLiveViewValue(root, "chargeCurrentLimitation", _chargeCurrentLimitation, "A", 1);
+    }
+    addLiveViewTextValue(root, "chargeImmediately", (_chargeImmediately?"yes":"no"));
 }
@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#ifdef OPENDTU_BENCHMARK
+
+#include "Benchmark.h"
+#include "Configuration.h"
+#include "JkBmsDataPoints.h"
+#include "JsonArena.h"
+#include "MessageOutput.h"
+#include "MqttSettings.h"
+#include "Utils.h"
+#include "WebApi_prometheus.h"
+#include "WebApi_ws_live.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <crc.h>
+#include <limits>
+
+BenchmarkClass Benchmark;
+
+void BenchmarkClass::run()
+{
+    MessageOutput.printf("{\"benchmark\":\"start\",\"chip\":\"%s\",\"revision\":%u,"
+            "\"cpu_mhz\":%u,\"firmware\":\"%s\"}\r\n",
+            ESP.getChipModel(), ESP.getChipRevision(), ESP.getCpuFreqMHz(),
+            __COMPILED_GIT_HASH__);
+
+    benchmarkCrc();
+    benchmarkDataPoints();
+    benchmarkCellVoltages();
+    benchmarkLiveJson();
+    benchmarkPrometheus();
+    benchmarkMqttPublish();
+    benchmarkConfig();
+
+    MessageOutput.println("{\"benchmark\":\"done\"}");
+}
+
+// the operation is repeated in a couple of rounds, and the fastest round is
+// reported, as interrupts and other tasks add to the cycles of a round. the
+// cycle counter wraps after a couple of seconds, so the number of iterations
+// must keep a round short.
+template<typename F>
+void BenchmarkClass::measure(char const* name, uint32_t iterations, F&& op)
+{
+    constexpr uint8_t rounds = 5;
+    uint32_t best = std::numeric_limits<uint32_t>::max();
+    uint32_t heapBefore = ESP.getFreeHeap();
+
+    for (uint8_t round = 0; round < rounds; ++round) {
+        uint32_t start = ESP.getCycleCount();
+        for (uint32_t i = 0; i < iterations; ++i) { op(); }
+        best = std::min(best, ESP.getCycleCount() - start);
+
+        // lets the idle task run, which also frees memory of deleted tasks
+        vTaskDelay(1);
+    }
+
+    int32_t heapDelta = static_cast<int32_t>(ESP.getFreeHeap()) - static_cast<int32_t>(heapBefore);
+    float cyclesPerOp = static_cast<float>(best) / iterations;
+
+    MessageOutput.printf("{\"benchmark\":\"%s\",\"iterations\":%u,"
+            "\"cycles_per_op\":%.1f,\"ns_per_op\":%.1f,\"heap_delta\":%d}\r\n",
+            name, iterations, cyclesPerOp, cyclesPerOp * 1000 / ESP.getCpuFreqMHz(),
+            heapDelta);
+}
+
+void BenchmarkClass::benchmarkCrc()
+{
+    uint8_t buffer[256];
+    for (size_t i = 0; i < sizeof(buffer); ++i) { buffer[i] = esp_random(); }
+
+    volatile uint16_t sink;
+    // a fragment received from an inverter is up to 32 bytes
+    measure("crc8_32", 10000, [&]() { sink = crc8(buffer, 32); });
+    measure("crc16_32", 10000, [&]() { sink = crc16(buffer, 32); });
+    measure("crc16_255", 2000, [&]() { sink = crc16(buffer, 255); });
+    measure("crc16nrf24_32", 2000, [&]() { sink = crc16nrf24(buffer, 32 * 8); });
+    (void)sink;
+}
+
+void BenchmarkClass::benchmarkDataPoints()
+{
+    using Label = JkBms::DataPointLabel;
+    JkBms::DataPointContainer dataPoints;
+    JkBms::DataPointContainer mirror;
+    uint32_t value = 0;
+
+    measure("datapoints_add", 10000, [&]() {
+        dataPoints.add<Label::BatteryVoltageMilliVolt>(value++);
+        dataPoints.add<Label::BatteryCurrentMilliAmps>(static_cast<int32_t>(value));
+        dataPoints.add<Label::BatterySoCPercent>(static_cast<uint8_t>(value));
+    });
+
+    measure("datapoints_update_from", 2000, [&]() {
+        dataPoints.add<Label::BatteryVoltageMilliVolt>(value++);
+        mirror.updateFrom(dataPoints);
+    });
+}
+
+void BenchmarkClass::benchmarkCellVoltages()
+{
+    // a 16s pack, each update moves the minimum or maximum cell away from
+    // its extreme, which requires a rescan of all cells.
+    tCellVoltages cells;
+    for (uint8_t i = 0; i < 16; ++i) { cells.set(i, 3300 + i); }
+
+    volatile uint32_t sink;
+    uint16_t step = 0;
+    measure("cells_set_rescan_16", 10000, [&]() {
+        ++step;
+        cells.set(0, 3300 + (step & 1));
+        cells.set(15, 3315 - (step & 1));
+        sink = cells.getDeltaMilliVolt();
+    });
+
+    measure("cells_iterate_16", 10000, [&]() {
+        uint32_t sum = 0;
+        for (auto const& cell : cells) { sum += cell.second; }
+        sink = sum;
+    });
+    (void)sink;
+}
+
+void BenchmarkClass::benchmarkLiveJson()
+{
+    measure("live_json", 50, []() {
+        JsonArenaAllocator allocator;
+        JsonDocument doc(&allocator);
+        JsonVariant root = doc.to<JsonVariant>();
+
+        JsonArray invArray = root["inverters"].to<JsonArray>();
+        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); ++i) {
+            auto inv = Hoymiles.getInverterByPos(i);
+            JsonObject invObject = invArray.add<JsonObject>();
+            WebApiWsLiveClass::generateInverterCommonJsonResponse(invObject, inv);
+            WebApiWsLiveClass::generateInverterChannelJsonResponse(invObject, inv);
+        }
+
+        WebApiWsLiveClass::generateCommonJsonResponse(root);
+        Utils::serializeJsonShared(doc);
+    });
+}
+
+void BenchmarkClass::benchmarkPrometheus()
+{
+    WebApiPrometheusClass prometheus;
+    size_t size = 0;
+
+    measure("prometheus", 20, [&]() {
+        WebApiPrometheusClass::Generator gen;
+        uint8_t buffer[1436]; // TCP MSS
+        size = 0;
+        while (size_t len = prometheus.fillChunk(gen, buffer, sizeof(buffer))) { size += len; }
+    });
+
+    MessageOutput.printf("{\"benchmark\":\"prometheus_size\",\"bytes\":%u}\r\n", size);
+}
+
+void BenchmarkClass::benchmarkMqttPublish()
+{
+    // the messages are only queued, as the benchmark does not connect
+    // to the broker. older messages are dropped from the bounded outbox.
+    String subtopic = "116100000000/0/power";
+    measure("mqtt_publish", 1000, [&]() {
+        MqttSettings.publish(subtopic, String(123.4f, 1));
+    });
+}
+
+void BenchmarkClass::benchmarkConfig()
+{
+    measure("config_read", 10, []() { Configuration.read(); });
+
+    File f = LittleFS.open(CONFIG_FILENAME, "r", false);
+    if (!f) { return; }
+    std::vector<uint8_t> content(f.size());
+    f.read(content.data(), content.size());
+    f.close();
+
+    static constexpr char const* scratchFileName = "/benchmark.tmp";
+
+    measure("littlefs_write_config_size", 5, [&]() {
+        File out = LittleFS.open(scratchFileName, "w");
+        out.write(content.data(), content.size());
+        out.close();
+    });
+
+    measure("littlefs_read_config_size", 10, [&]() {
+        File in = LittleFS.open(scratchFileName, "r", false);
+        in.read(content.data(), content.size());
+        in.close();
+    });
+
+    LittleFS.remove(scratchFileName);
+}
+
+#endif
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "BootProfiler.h"
+#include <esp_timer.h>
+#include <algorithm>
+
+BootProfilerClass BootProfiler;
+
+void BootProfilerClass::beginStage(char const* name, bool deferred)
+{
+    endStage();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_count >= _maxStages) { return; }
+
+    _stages[_count] = { name, deferred, static_cast<uint32_t>(esp_timer_get_time()), 0 };
+    _running = true;
+}
+
+void BootProfilerClass::endStage()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_running) { return; }
+
+    auto& stage = _stages[_count++];
+    stage.Duration = static_cast<uint32_t>(esp_timer_get_time()) - stage.Start;
+    _running = false;
+}
+
+void BootProfilerClass::addStage(char const* name, bool deferred, uint32_t start, uint32_t duration)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_count + (_running ? 1 : 0) >= _maxStages) { return; }
+
+    // the current stage is kept behind the recorded ones
+    if (_running) { _stages[_count + 1] = _stages[_count]; }
+
+    _stages[_count++] = { name, deferred, start, duration };
+}
+
+void BootProfilerClass::serialize(JsonObject& target) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    uint32_t setupEnd = 0;
+    uint32_t end = 0;
+
+    JsonArray stages = target["stages"].to<JsonArray>();
+    for (size_t i = 0; i < _count; ++i) {
+        auto const& stage = _stages[i];
+        JsonObject obj = stages.add<JsonObject>();
+        obj["name"] = stage.Name;
+        obj["deferred"] = stage.Deferred;
+        obj["start_us"] = stage.Start;
+        obj["duration_us"] = stage.Duration;
+
+        uint32_t stageEnd = stage.Start + stage.Duration;
+        end = std::max(end, stageEnd);
+        if (!stage.Deferred) { setupEnd = std::max(setupEnd, stageEnd); }
+    }
+
+    target["setup_us"] = setupEnd;
+    target["total_us"] = end;
+}
@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "CanBus.h"
+#include "MessageOutput.h"
+#include <Arduino.h>
+
+CanBusClass CanBus;
+
+static bool getTimingConfig(uint16_t bitrateKbps, twai_timing_config_t& config)
+{
+    switch (bitrateKbps) {
+        case 125:
+            config = TWAI_TIMING_CONFIG_125KBITS();
+            return true;
+        case 250:
+            config = TWAI_TIMING_CONFIG_250KBITS();
+            return true;
+        case 500:
+            config = TWAI_TIMING_CONFIG_500KBITS();
+            return true;
+        case 1000:
+            config = TWAI_TIMING_CONFIG_1MBITS();
+            return true;
+    }
+
+    return false;
+}
+
+int CanBusClass::subscribe(Subscription subscription)
+{
+    std::lock_guard<std::mutex> configLock(_configMutex);
+
+    if (subscription.PinRx < 0 || subscription.PinTx < 0) {
+        MessageOutput.printf("[CanBus] %s: invalid pin config\r\n",
+                subscription.Name);
+        return -1;
+    }
+
+    twai_timing_config_t timing;
+    if (!getTimingConfig(subscription.BitrateKbps, timing)) {
+        MessageOutput.printf("[CanBus] %s: unsupported bitrate %u kbit/s\r\n",
+                subscription.Name, subscription.BitrateKbps);
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_subscriptions.empty()) {
+            auto const& other = _subscriptions.front().second;
+            if (other.PinRx != subscription.PinRx ||
+                    other.PinTx != subscription.PinTx ||
+                    other.BitrateKbps != subscription.BitrateKbps) {
+                MessageOutput.printf("[CanBus] %s: bus is in use by %s with "
+                        "rx = %d, tx = %d at %u kbit/s\r\n", subscription.Name,
+                        other.Name, other.PinRx, other.PinTx, other.BitrateKbps);
+                return -1;
+            }
+        }
+    }
+
+    // the acceptance filters can only be changed while the driver is
+    // uninstalled, so we restart the bus with the new set of subscriptions.
+    stop();
+
+    int handle;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        handle = _nextHandle++;
+        _subscriptions.emplace_back(handle, std::move(subscription));
+    }
+
+    if (!start()) {
+        unsubscribeLocked(handle);
+        return -1;
+    }
+
+    return handle;
+}
+
+void CanBusClass::unsubscribe(int handle)
+{
+    std::lock_guard<std::mutex> configLock(_configMutex);
+    unsubscribeLocked(handle);
+}
+
+void CanBusClass::unsubscribeLocked(int handle)
+{
+    stop();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _subscriptions.erase(std::remove_if(_subscriptions.begin(), _subscriptions.end(),
+                    [handle](auto const& entry) { return entry.first == handle; }),
+                _subscriptions.end());
+    }
+
+    start();
+}
+
+bool CanBusClass::start()
+{
+    twai_general_config_t g_config;
+    twai_timing_config_t t_config;
+    twai_filter_config_t f_config;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_subscriptions.empty()) { return true; }
+
+        auto const& first = _subscriptions.front().second;
+
+        MessageOutput.printf("[CanBus] rx = %d, tx = %d, %u kbit/s, %u subscriber(s)\r\n",
+                first.PinRx, first.PinTx, first.BitrateKbps,
+                static_cast<unsigned>(_subscriptions.size()));
+
+        auto tx = static_cast<gpio_num_t>(first.PinTx);
+        auto rx = static_cast<gpio_num_t>(first.PinRx);
+        g_config = TWAI_GENERAL_CONFIG_DEFAULT(tx, rx, TWAI_MODE_NORMAL);
+        getTimingConfig(first.BitrateKbps, t_config);
+        f_config = getFilterConfig();
+    }
+
+    // interrupts at level 1 are in high demand, at least on ESP32-S3 boards,
+    // but only a limited amount can be allocated. failing to allocate an
+    // interrupt in the TWAI driver will cause a bootloop. we therefore
+    // register the TWAI driver's interrupt at level 2. level 2 interrupts
+    // should be available -- we don't really know. we would love to have the
+    // esp_intr_dump() function, but that's not available yet in our version
+    // of the underlying esp-idf.
+    g_config.intr_flags = ESP_INTR_FLAG_LEVEL2;
+
+    // the receive task drains the driver's queue quickly, but we still
+    // want to be able to buffer a burst of frames.
+    g_config.rx_queue_len = 16;
+
+    if (twai_driver_install(&g_config, &t_config, &f_config) != ESP_OK) {
+        MessageOutput.print("[CanBus] failed to install driver\r\n");
+        return false;
+    }
+
+    if (twai_start() != ESP_OK) {
+        MessageOutput.print("[CanBus] failed to start driver\r\n");
+        twai_driver_uninstall();
+        return false;
+    }
+
+    _running = true;
+    _stopReceiving = false;
+    _receiveTaskDone = false;
+
+    uint32_t constexpr stackSize = 2048;
+    if (pdPASS != xTaskCreate(CanBusClass::receiveLoopHelper,
+                "CanBusRx", stackSize, this, 16/*prio*/, &_receiveTaskHandle)) {
+        MessageOutput.print("[CanBus] failed to start receive task\r\n");
+        _receiveTaskHandle = nullptr;
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+void CanBusClass::stop()
+{
+    if (_receiveTaskHandle != nullptr) {
+        _stopReceiving = true;
+        while (!_receiveTaskDone) { delay(10); }
+        _receiveTaskHandle = nullptr;
+    }
+
+    if (!_running) { return; }
+    _running = false;
+
+    if (twai_stop() != ESP_OK) {
+        MessageOutput.print("[CanBus] failed to stop driver\r\n");
+    }
+
+    if (twai_driver_uninstall() != ESP_OK) {
+        MessageOutput.print("[CanBus] failed to uninstall driver\r\n");
+    }
+}
+
+twai_filter_config_t CanBusClass::getFilterConfig() const
+{
+    std::vector<Filter const*> filters;
+    for (auto const& entry : _subscriptions) {
+        for (auto const& filter : entry.second.Filters) {
+            filters.push_back(&filter);
+        }
+    }
+
+    bool allStandard = std::all_of(filters.begin(), filters.end(),
+            [](Filter const* f) { return !f->Extended; });
+
+    twai_filter_config_t config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+
+    if (!filters.empty() && allStandard && filters.size() <= 2) {
+        // in dual filter mode, the identifier of standard frames is matched
+        // by bits 31..21 (first filter) and bits 15..5 (second filter). the
+        // RTR bit and the bits of the first data byte are "don't care" bits.
+        auto const& first = *filters.front();
+        auto const& second = *filters.back();
+        config.acceptance_code = ((first.Code & 0x7FF) << 21) | ((second.Code & 0x7FF) << 5);
+        config.acceptance_mask = ((first.Mask & 0x7FF) << 21) | 0x001F0000 |
+            ((second.Mask & 0x7FF) << 5) | 0x0000001F;
+        config.single_filter = false;
+    }
+    else if (filters.size() == 1 && filters.front()->Extended) {
+        // in single filter mode, the identifier of extended frames is matched
+        // by bits 31..3, the RTR bit is bit 2. bits 1..0 are unused.
+        auto const& filter = *filters.front();
+        config.acceptance_code = (filter.Code & 0x1FFFFFFF) << 3;
+        config.acceptance_mask = ((filter.Mask & 0x1FFFFFFF) << 3) | 0x7;
+        config.single_filter = true;
+    }
+
+    return config;
+}
+
+bool CanBusClass::matches(Filter const& filter, twai_message_t const& message)
+{
+    if (static_cast<bool>(message.extd) != filter.Extended) { return false; }
+    return ((message.identifier ^ filter.Code) & ~filter.Mask) == 0;
+}
+
+void CanBusClass::receiveLoopHelper(void* context)
+{
+    auto pInstance = static_cast<CanBusClass*>(context);
+    pInstance->receiveLoop();
+    pInstance->_receiveTaskDone = true;
+    vTaskDelete(nullptr);
+}
+
+void CanBusClass::receiveLoop()
+{
+    while (!_stopReceiving) {
+        twai_message_t message;
+
+        // the timeout only determines how quickly we notice that we shall stop
+        if (twai_receive(&message, pdMS_TO_TICKS(500)) != ESP_OK) { continue; }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto const& entry : _subscriptions) {
+            auto const& subscription = entry.second;
+            for (auto const& filter : subscription.Filters) {
+                if (!matches(filter, message)) { continue; }
+                subscription.OnFrame(message);
+                break;
+            }
+        }
+    }
+}
+
+bool CanBusClass::transmit(twai_message_t const& message, TickType_t timeout)
+{
+    if (!_running) { return false; }
+    return twai_transmit(&message, timeout) == ESP_OK;
+}
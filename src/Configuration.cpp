@@ -3,23 +3,56 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "Configuration.h"
+#include "FsWriteMonitor.h"
+#include "TaskMonitor.h"
 #include "MessageOutput.h"
 #include "NetworkSettings.h"
 #include "Utils.h"
+#include "__compiled_constants.h"
 #include "defaults.h"
 #include <LittleFS.h>
+#include <algorithm>
+#include <cstddef>
+#include <esp_rom_crc.h>
+#include <esp_attr.h>
+#include <memory>
 #include <nvs_flash.h>
+#include <type_traits>
 
-CONFIG_T config;
+// placed in PSRAM if the SDK allows .bss in external memory, as the config
+// grows with every inverter slot (INV_MAX_COUNT).
+EXT_RAM_ATTR CONFIG_T config;
 
 static std::condition_variable sWriterCv;
 static std::mutex sWriterMutex;
 static unsigned sWriterCount = 0;
 
+static_assert(std::is_trivially_copyable<CONFIG_T>::value,
+    "the binary config snapshot requires a trivially copyable CONFIG_T");
+
+static constexpr uint32_t SnapshotMagic = 0x4346474f; // "OGFC"
+
+struct ConfigSnapshotHeader {
+    uint32_t Magic;
+    uint32_t BuildId; // identifies the layout of CONFIG_T
+    uint32_t JsonSize; // size of config.json the snapshot belongs to
+    uint32_t PayloadCrc;
+};
+
+static constexpr uint32_t JournalMagic = 0x4c4e4a43; // "CJNL"
+
+// every journal entry is followed by the new content of the section
+struct ConfigJournalHeader {
+    uint32_t Magic;
+    uint32_t Section; // index into getSections()
+    uint32_t Size; // of the section
+    uint32_t Crc; // of the section's content
+};
+
 void ConfigurationClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&ConfigurationClass::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("Configuration::loop", std::bind(&ConfigurationClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
@@ -62,6 +95,7 @@ void ConfigurationClass::serializeSolarChargerConfig(SolarChargerConfig const& s
 void ConfigurationClass::serializeSolarChargerMqttConfig(SolarChargerMqttConfig const& source, JsonObject& target)
 {
     target["calculate_output_power"] = source.CalculateOutputPower;
+    target["combined_topic"] = source.CombinedTopic;
     target["power_topic"] = source.PowerTopic;
     target["power_path"] = source.PowerJsonPath;
     target["power_unit"] = source.PowerUnit;
@@ -91,6 +125,16 @@ void ConfigurationClass::serializePowerMeterSerialSdmConfig(PowerMeterSerialSdmC
 {
     target["address"] = source.Address;
     target["polling_interval"] = source.PollingInterval;
+
+    JsonArray subMeters = target["sub_meters"].to<JsonArray>();
+    for (size_t i = 0; i < POWERMETER_SDM_MAX_SUBMETERS; ++i) {
+        JsonObject t = subMeters.add<JsonObject>();
+        auto const& s = source.SubMeters[i];
+        t["address"] = s.Address;
+        t["three_phases"] = s.ThreePhases;
+        t["subtract"] = s.Subtract;
+        t["poll_divider"] = s.PollDivider;
+    }
 }
 
 void ConfigurationClass::serializePowerMeterHttpJsonConfig(PowerMeterHttpJsonConfig const& source, JsonObject& target)
@@ -118,6 +162,28 @@ void ConfigurationClass::serializePowerMeterHttpSmlConfig(PowerMeterHttpSmlConfi
     serializeHttpRequestConfig(source.HttpRequest, target);
 }
 
+void ConfigurationClass::serializePowerMeterUdpConfig(PowerMeterUdpConfig const& source, JsonObject& target)
+{
+    target["port"] = source.Port;
+    target["format"] = source.PayloadFormat;
+}
+
+void ConfigurationClass::serializePowerMeterFilterConfig(PowerMeterFilterConfig const& source, JsonObject& target)
+{
+    target["mode"] = source.FilterMode;
+    target["window"] = source.Window;
+    target["step_threshold"] = source.StepThreshold;
+}
+
+void ConfigurationClass::serializePowerMeterAdditionalConfig(PowerMeterAdditionalConfig const* source, JsonArray& target)
+{
+    for (size_t i = 0; i < POWERMETER_MAX_ADDITIONAL; ++i) {
+        JsonObject t = target.add<JsonObject>();
+        t["operation"] = source[i].Op;
+        t["source"] = source[i].Source;
+    }
+}
+
 void ConfigurationClass::serializeBatteryConfig(BatteryConfig const& source, JsonObject& target)
 {
     target["enabled"] = config.Battery.Enabled;
@@ -138,6 +204,17 @@ void ConfigurationClass::serializeBatteryConfig(BatteryConfig const& source, Jso
     target["mqtt_discharge_current_topic"] = config.Battery.MqttDischargeCurrentTopic;
     target["mqtt_discharge_current_json_path"] = config.Battery.MqttDischargeCurrentJsonPath;
     target["mqtt_amperage_unit"] = config.Battery.MqttAmperageUnit;
+    target["mqtt_bundled"] = source.MqttBundled;
+
+    JsonArray children = target["aggregate_children"].to<JsonArray>();
+    for (size_t i = 0; i < BATTERY_AGGREGATE_MAX_CHILDREN; ++i) {
+        JsonObject t = children.add<JsonObject>();
+        BatteryAggregateChildConfig const& s = source.AggregateChildren[i];
+
+        t["enabled"] = s.Enabled;
+        t["provider"] = s.Provider;
+        t["capacity"] = s.CapacityAmpHours;
+    }
 }
 
 void ConfigurationClass::serializePowerLimiterConfig(PowerLimiterConfig const& source, JsonObject& target)
@@ -164,6 +241,7 @@ void ConfigurationClass::serializePowerLimiterConfig(PowerLimiterConfig const& s
     target["voltage_start_threshold"] = roundedFloat(source.VoltageStartThreshold);
     target["voltage_stop_threshold"] = roundedFloat(source.VoltageStopThreshold);
     target["voltage_load_correction_factor"] = source.VoltageLoadCorrectionFactor;
+    target["voltage_load_correction_automatic"] = source.VoltageLoadCorrectionAutomatic;
     target["full_solar_passthrough_soc"] = source.FullSolarPassThroughSoc;
     target["full_solar_passthrough_start_voltage"] = roundedFloat(source.FullSolarPassThroughStartVoltage);
     target["full_solar_passthrough_stop_voltage"] = roundedFloat(source.FullSolarPassThroughStopVoltage);
@@ -171,6 +249,15 @@ void ConfigurationClass::serializePowerLimiterConfig(PowerLimiterConfig const& s
     target["inverter_channel_id_for_dc_voltage"] = source.InverterChannelIdForDcVoltage;
     target["inverter_restart_hour"] = source.RestartHour;
     target["total_upper_power_limit"] = source.TotalUpperPowerLimit;
+    target["export_guard_threshold"] = source.ExportGuardThreshold;
+    target["predictive_mode"] = source.PredictiveMode;
+    target["optimized_dispatch"] = source.OptimizedDispatch;
+    target["phase_mode"] = source.PhaseMode;
+    target["battery_discharge_plan"] = source.BatteryDischargePlan;
+    target["battery_capacity"] = source.BatteryCapacity;
+    target["battery_discharge_plan_reserve_soc"] = source.BatteryDischargePlanReserveSoc;
+    target["cluster"] = source.Cluster;
+    target["cluster_key"] = source.ClusterKey;
 
     JsonArray inverters = target["inverters"].to<JsonArray>();
     for (size_t i = 0; i < INV_MAX_COUNT; ++i) {
@@ -182,6 +269,7 @@ void ConfigurationClass::serializePowerLimiterConfig(PowerLimiterConfig const& s
         t["is_governed"] = s.IsGoverned;
         t["is_behind_power_meter"] = s.IsBehindPowerMeter;
         t["power_source"] = s.PowerSource;
+        t["phase"] = s.Phase;
         t["use_overscaling_to_compensate_shading"] = s.UseOverscaling;
         t["lower_power_limit"] = s.LowerPowerLimit;
         t["upper_power_limit"] = s.UpperPowerLimit;
@@ -206,8 +294,303 @@ void ConfigurationClass::serializeGridChargerConfig(GridChargerConfig const& sou
     target["target_power_consumption"] = source.Auto_Power_Target_Power_Consumption;
 }
 
+uint32_t ConfigurationClass::getBuildId()
+{
+    // any change of the struct layout comes with a new firmware build, so
+    // snapshots written by a different build are never trusted.
+    uint32_t const values[] = { CONFIG_VERSION, CONFIG_VERSION_ONBATTERY,
+        static_cast<uint32_t>(sizeof(CONFIG_T)) };
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(values), sizeof(values));
+
+    // local builds of uncommitted changes share the git hash, so the
+    // layout is part of the id as well: the sections and the members of
+    // the structs repeated per inverter.
+    for (auto const& section : getSections()) {
+        uint32_t const layout[] = { static_cast<uint32_t>(section.Offset), static_cast<uint32_t>(section.Size) };
+        crc = esp_rom_crc32_le(crc, reinterpret_cast<uint8_t const*>(layout), sizeof(layout));
+    }
+
+    uint32_t const members[] = {
+        offsetof(INVERTER_CONFIG_T, Name),
+        offsetof(INVERTER_CONFIG_T, Order),
+        offsetof(INVERTER_CONFIG_T, ReachableThreshold),
+        offsetof(INVERTER_CONFIG_T, NrfRadio),
+        offsetof(INVERTER_CONFIG_T, channel),
+        offsetof(CHANNEL_CONFIG_T, Name),
+        offsetof(CHANNEL_CONFIG_T, YieldTotalOffset),
+        sizeof(CHANNEL_CONFIG_T),
+        offsetof(PowerLimiterConfig, Inverters),
+        offsetof(PowerLimiterInverterConfig, LowerPowerLimit),
+        offsetof(PowerLimiterInverterConfig, UpperPowerLimit),
+        offsetof(PowerLimiterInverterConfig, PowerSource),
+        offsetof(PowerLimiterInverterConfig, Phase),
+        sizeof(PowerLimiterInverterConfig)
+    };
+    crc = esp_rom_crc32_le(crc, reinterpret_cast<uint8_t const*>(members), sizeof(members));
+
+    return esp_rom_crc32_le(crc, reinterpret_cast<uint8_t const*>(__COMPILED_GIT_HASH__), strlen(__COMPILED_GIT_HASH__));
+}
+
+uint32_t ConfigurationClass::getConfigCrc()
+{
+    return esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(&config), sizeof(config));
+}
+
+#define CONFIG_SECTION(member) { offsetof(CONFIG_T, member), sizeof(CONFIG_T::member) }
+
+std::vector<ConfigurationClass::Section> const& ConfigurationClass::getSections()
+{
+    static std::vector<Section> const sections = []() {
+        std::vector<Section> result = {
+            CONFIG_SECTION(Cfg),
+            CONFIG_SECTION(WiFi),
+            CONFIG_SECTION(Mdns),
+            CONFIG_SECTION(Syslog),
+            CONFIG_SECTION(Telemetry),
+            CONFIG_SECTION(MetricsPush),
+            CONFIG_SECTION(Modbus),
+            CONFIG_SECTION(Ntp),
+            CONFIG_SECTION(Mqtt),
+            CONFIG_SECTION(Dtu),
+            CONFIG_SECTION(Security),
+            CONFIG_SECTION(Display),
+            CONFIG_SECTION(Led_Single),
+            CONFIG_SECTION(SolarCharger),
+            CONFIG_SECTION(PowerMeter),
+            CONFIG_SECTION(PowerLimiter),
+            CONFIG_SECTION(Battery),
+            CONFIG_SECTION(Huawei),
+            CONFIG_SECTION(Dev_PinMapping)
+        };
+
+        // inverters are changed one at a time
+        for (size_t i = 0; i < INV_MAX_COUNT; ++i) {
+            result.push_back({ offsetof(CONFIG_T, Inverter) + i * sizeof(INVERTER_CONFIG_T),
+                sizeof(INVERTER_CONFIG_T) });
+        }
+
+        return result;
+    }();
+
+    return sections;
+}
+
+#undef CONFIG_SECTION
+
+std::vector<uint32_t> ConfigurationClass::getSectionCrcs()
+{
+    auto const& sections = getSections();
+    auto data = reinterpret_cast<uint8_t const*>(&config);
+
+    std::vector<uint32_t> crcs;
+    crcs.reserve(sections.size());
+    for (auto const& section : sections) {
+        crcs.push_back(esp_rom_crc32_le(0, data + section.Offset, section.Size));
+    }
+
+    return crcs;
+}
+
+bool ConfigurationClass::appendJournal()
+{
+    auto crcs = getSectionCrcs();
+    auto const& sections = getSections();
+    auto data = reinterpret_cast<uint8_t const*>(&config);
+
+    File f = LittleFS.open(CONFIG_JOURNAL_FILENAME, "a");
+    if (!f) {
+        return false;
+    }
+
+    size_t written = 0;
+    bool success = true;
+
+    for (size_t i = 0; i < sections.size() && success; ++i) {
+        if (crcs[i] == _persistedSectionCrcs[i]) { continue; }
+
+        auto const& section = sections[i];
+        ConfigJournalHeader header = { JournalMagic, static_cast<uint32_t>(i),
+            static_cast<uint32_t>(section.Size), crcs[i] };
+        success = f.write(reinterpret_cast<uint8_t const*>(&header), sizeof(header)) == sizeof(header)
+            && f.write(data + section.Offset, section.Size) == section.Size;
+        written += sizeof(header) + section.Size;
+    }
+
+    f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::Config, written);
+
+    // the journal is incomplete, config.json must be written instead
+    if (!success) {
+        LittleFS.remove(CONFIG_JOURNAL_FILENAME);
+        _persistedSectionCrcs.clear();
+        return false;
+    }
+
+    _persistedSectionCrcs = std::move(crcs);
+    _persistedCrc = getConfigCrc();
+    _journalSize += written;
+    _compactionDue = true;
+    _lastJournalWrite = millis();
+    return true;
+}
+
+void ConfigurationClass::replayJournal()
+{
+    _persistedSectionCrcs.clear();
+    _journalSize = 0;
+
+    File f = LittleFS.open(CONFIG_JOURNAL_FILENAME, "r", false);
+    if (!f) {
+        _persistedSectionCrcs = getSectionCrcs();
+        return;
+    }
+
+    auto const& sections = getSections();
+    auto data = reinterpret_cast<uint8_t*>(&config);
+    size_t entries = 0;
+
+    ConfigJournalHeader header;
+    while (f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header)) {
+        if (header.Magic != JournalMagic || header.Section >= sections.size()
+                || header.Size != sections[header.Section].Size) {
+            break;
+        }
+
+        // an entry is applied only if it was written completely
+        auto buffer = std::make_unique<uint8_t[]>(header.Size);
+        if (f.read(buffer.get(), header.Size) != header.Size
+                || esp_rom_crc32_le(0, buffer.get(), header.Size) != header.Crc) {
+            break;
+        }
+
+        memcpy(data + sections[header.Section].Offset, buffer.get(), header.Size);
+        _journalSize += sizeof(header) + header.Size;
+        ++entries;
+    }
+
+    bool complete = _journalSize == f.size();
+    f.close();
+
+    MessageOutput.printf("Applied %u configuration journal entries\r\n",
+            static_cast<unsigned>(entries));
+
+    _persistedCrc = getConfigCrc();
+
+    // config.json is outdated. appending to a damaged journal is not
+    // possible, in which case the next write rewrites all files.
+    _compactionDue = entries > 0 || !complete;
+    _lastJournalWrite = millis() - _compactionDelayMs;
+    if (complete) { _persistedSectionCrcs = getSectionCrcs(); }
+}
+
+bool ConfigurationClass::readSnapshot()
+{
+    File f = LittleFS.open(CONFIG_SNAPSHOT_FILENAME, "r", false);
+    if (!f) {
+        return false;
+    }
+
+    ConfigSnapshotHeader header;
+    if (f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header)
+            || header.Magic != SnapshotMagic || header.BuildId != getBuildId()) {
+        return false;
+    }
+
+    // config.json was replaced (e.g., uploaded) after the snapshot was taken
+    File json = LittleFS.open(CONFIG_FILENAME, "r", false);
+    if (!json || json.size() != header.JsonSize) {
+        return false;
+    }
+    json.close();
+
+    auto snapshot = std::make_unique<CONFIG_T>();
+    auto data = reinterpret_cast<uint8_t*>(snapshot.get());
+    if (f.read(data, sizeof(CONFIG_T)) != sizeof(CONFIG_T)
+            || esp_rom_crc32_le(0, data, sizeof(CONFIG_T)) != header.PayloadCrc) {
+        return false;
+    }
+
+    memcpy(&config, snapshot.get(), sizeof(CONFIG_T));
+    _persistedCrc = header.PayloadCrc;
+    return true;
+}
+
+void ConfigurationClass::writeSnapshot(uint32_t jsonSize)
+{
+    _persistedCrc = getConfigCrc();
+
+    // config.json incorporates all journal entries now
+    LittleFS.remove(CONFIG_JOURNAL_FILENAME);
+    _persistedSectionCrcs.clear();
+    _journalSize = 0;
+    _compactionDue = false;
+
+    File f = LittleFS.open(CONFIG_SNAPSHOT_FILENAME, "w");
+    if (!f) {
+        return;
+    }
+
+    ConfigSnapshotHeader header = { SnapshotMagic, getBuildId(), jsonSize, _persistedCrc };
+    bool success = f.write(reinterpret_cast<uint8_t const*>(&header), sizeof(header)) == sizeof(header)
+        && f.write(reinterpret_cast<uint8_t const*>(&config), sizeof(config)) == sizeof(config);
+    f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::Config, sizeof(header) + sizeof(config));
+
+    // an incomplete snapshot would be rejected anyway, but don't keep it
+    if (!success) {
+        LittleFS.remove(CONFIG_SNAPSHOT_FILENAME);
+        return;
+    }
+
+    _persistedSectionCrcs = getSectionCrcs();
+}
+
 bool ConfigurationClass::write()
 {
+    std::lock_guard<std::mutex> lock(_persistMutex);
+
+    // settings handlers write the config even if nothing was changed. the
+    // CRC is taken before the save count is incremented, so it only matches
+    // if the content is the same as the persisted one.
+    if (getConfigCrc() == _persistedCrc && LittleFS.exists(CONFIG_FILENAME)) {
+        return true;
+    }
+
+    // a few sections changed, typically only one. these are appended to the
+    // journal, which takes milliseconds rather than serializing everything.
+    if (!_persistedSectionCrcs.empty() && _journalSize < _maxJournalSize
+            && appendJournal()) {
+        return true;
+    }
+
+    return writeFull();
+}
+
+void ConfigurationClass::flush()
+{
+    // also called by the async_tcp task, e.g., before a download or an
+    // update. writers must not change the config while it is serialized.
+    // writers hold sWriterMutex while calling write(), hence this order.
+    std::lock_guard<std::mutex> writerLock(sWriterMutex);
+    std::lock_guard<std::mutex> lock(_persistMutex);
+    if (!_compactionDue) { return; }
+
+    if (!writeFull()) {
+        MessageOutput.println("Failed to compact configuration journal");
+        _lastJournalWrite = millis(); // retry later
+    }
+}
+
+bool ConfigurationClass::writeFull()
+{
+    // the snapshot must never outlive the JSON it was taken from, e.g.,
+    // if power is lost while writing the JSON file. the journal amends the
+    // snapshot, so it becomes void as well.
+    LittleFS.remove(CONFIG_SNAPSHOT_FILENAME);
+    _persistedSectionCrcs.clear();
+
     File f = LittleFS.open(CONFIG_FILENAME, "w");
     if (!f) {
         return false;
@@ -232,6 +615,7 @@ bool ConfigurationClass::write()
     wifi["dhcp"] = config.WiFi.Dhcp;
     wifi["hostname"] = config.WiFi.Hostname;
     wifi["aptimeout"] = config.WiFi.ApTimeout;
+    wifi["latency_mode"] = config.WiFi.LatencyMode;
 
     JsonObject mdns = doc["mdns"].to<JsonObject>();
     mdns["enabled"] = config.Mdns.Enabled;
@@ -241,6 +625,23 @@ bool ConfigurationClass::write()
     syslog["hostname"] = config.Syslog.Hostname;
     syslog["port"] = config.Syslog.Port;
 
+    JsonObject telemetry = doc["telemetry"].to<JsonObject>();
+    telemetry["enabled"] = config.Telemetry.Enabled;
+    telemetry["hostname"] = config.Telemetry.Hostname;
+    telemetry["port"] = config.Telemetry.Port;
+    telemetry["interval"] = config.Telemetry.Interval;
+
+    JsonObject metricsPush = doc["metrics_push"].to<JsonObject>();
+    metricsPush["enabled"] = config.MetricsPush.Enabled;
+    serializeHttpRequestConfig(config.MetricsPush.HttpRequest, metricsPush);
+    metricsPush["interval"] = config.MetricsPush.Interval;
+    metricsPush["push_interval"] = config.MetricsPush.PushInterval;
+
+    JsonObject modbus = doc["modbus"].to<JsonObject>();
+    modbus["enabled"] = config.Modbus.Enabled;
+    modbus["port"] = config.Modbus.Port;
+    modbus["allow_write"] = config.Modbus.AllowWrite;
+
     JsonObject ntp = doc["ntp"].to<JsonObject>();
     ntp["server"] = config.Ntp.Server;
     ntp["timezone"] = config.Ntp.Timezone;
@@ -262,6 +663,15 @@ bool ConfigurationClass::write()
     mqtt["publish_interval"] = config.Mqtt.PublishInterval;
     mqtt["clean_session"] = config.Mqtt.CleanSession;
 
+    JsonObject mqtt_deadband = mqtt["deadband"].to<JsonObject>();
+    mqtt_deadband["power"] = roundedFloat(config.Mqtt.Deadband.Power);
+    mqtt_deadband["voltage"] = roundedFloat(config.Mqtt.Deadband.Voltage);
+    mqtt_deadband["current"] = roundedFloat(config.Mqtt.Deadband.Current);
+    mqtt_deadband["frequency"] = roundedFloat(config.Mqtt.Deadband.Frequency);
+    mqtt_deadband["temperature"] = roundedFloat(config.Mqtt.Deadband.Temperature);
+    mqtt_deadband["power_factor"] = roundedFloat(config.Mqtt.Deadband.PowerFactor);
+    mqtt_deadband["percent"] = roundedFloat(config.Mqtt.Deadband.Percent);
+
     JsonObject mqtt_lwt = mqtt["lwt"].to<JsonObject>();
     mqtt_lwt["topic"] = config.Mqtt.Lwt.Topic;
     mqtt_lwt["value_online"] = config.Mqtt.Lwt.Value_Online;
@@ -286,10 +696,12 @@ bool ConfigurationClass::write()
     dtu["serial"] = config.Dtu.Serial;
     dtu["poll_interval"] = config.Dtu.PollInterval;
     dtu["verbose_logging"] = config.Dtu.VerboseLogging;
+    dtu["night_mode"] = config.Dtu.NightMode;
     dtu["nrf_pa_level"] = config.Dtu.Nrf.PaLevel;
     dtu["cmt_pa_level"] = config.Dtu.Cmt.PaLevel;
     dtu["cmt_frequency"] = config.Dtu.Cmt.Frequency;
     dtu["cmt_country_mode"] = config.Dtu.Cmt.CountryMode;
+    dtu["cmt_frequency_agility"] = config.Dtu.Cmt.FrequencyAgility;
 
     JsonObject security = doc["security"].to<JsonObject>();
     security["password"] = config.Security.Password;
@@ -328,6 +740,7 @@ bool ConfigurationClass::write()
         inv["zero_day"] = config.Inverter[i].ZeroYieldDayOnMidnight;
         inv["clear_eventlog"] = config.Inverter[i].ClearEventlogOnMidnight;
         inv["yieldday_correction"] = config.Inverter[i].YieldDayCorrection;
+        inv["nrf_radio"] = config.Inverter[i].NrfRadio;
 
         JsonArray channel = inv["channel"].to<JsonArray>();
         for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
@@ -361,6 +774,15 @@ bool ConfigurationClass::write()
     JsonObject powermeter_http_sml = powermeter["http_sml"].to<JsonObject>();
     serializePowerMeterHttpSmlConfig(config.PowerMeter.HttpSml, powermeter_http_sml);
 
+    JsonObject powermeter_udp = powermeter["udp"].to<JsonObject>();
+    serializePowerMeterUdpConfig(config.PowerMeter.Udp, powermeter_udp);
+
+    JsonObject powermeter_filter = powermeter["filter"].to<JsonObject>();
+    serializePowerMeterFilterConfig(config.PowerMeter.Filter, powermeter_filter);
+
+    JsonArray powermeter_additional = powermeter["additional"].to<JsonArray>();
+    serializePowerMeterAdditionalConfig(config.PowerMeter.Additional, powermeter_additional);
+
     JsonObject powerlimiter = doc["powerlimiter"].to<JsonObject>();
     serializePowerLimiterConfig(config.PowerLimiter, powerlimiter);
 
@@ -375,12 +797,17 @@ bool ConfigurationClass::write()
     }
 
     // Serialize JSON to file
-    if (serializeJson(doc, f) == 0) {
+    size_t jsonSize = serializeJson(doc, f);
+    if (jsonSize == 0) {
         MessageOutput.println("Failed to write file");
         return false;
     }
 
     f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::Config, jsonSize);
+
+    writeSnapshot(jsonSize);
     return true;
 }
 
@@ -406,6 +833,7 @@ void ConfigurationClass::deserializeSolarChargerConfig(JsonObject const& source,
 void ConfigurationClass::deserializeSolarChargerMqttConfig(JsonObject const& source, SolarChargerMqttConfig& target)
 {
     target.CalculateOutputPower = source["calculate_output_power"];
+    strlcpy(target.CombinedTopic, source["combined_topic"] | "", sizeof(target.CombinedTopic));
     strlcpy(target.PowerTopic, source["power_topic"] | "", sizeof(target.PowerTopic));
     strlcpy(target.PowerJsonPath, source["power_path"] | "", sizeof(target.PowerJsonPath));
     target.PowerUnit = source["power_unit"] | SolarChargerMqttConfig::WattageUnit::Watts;
@@ -434,6 +862,16 @@ void ConfigurationClass::deserializePowerMeterSerialSdmConfig(JsonObject const&
 {
     target.PollingInterval = source["polling_interval"] | POWERMETER_POLLING_INTERVAL;
     target.Address = source["address"] | POWERMETER_SDMADDRESS;
+
+    JsonArray subMeters = source["sub_meters"];
+    for (size_t i = 0; i < POWERMETER_SDM_MAX_SUBMETERS; ++i) {
+        JsonObject s = subMeters[i];
+        auto& t = target.SubMeters[i];
+        t.Address = s["address"] | 0;
+        t.ThreePhases = s["three_phases"] | false;
+        t.Subtract = s["subtract"] | false;
+        t.PollDivider = std::clamp<int>(s["poll_divider"] | POWERMETER_SDM_POLL_DIVIDER, 1, 60);
+    }
 }
 
 void ConfigurationClass::deserializePowerMeterHttpJsonConfig(JsonObject const& source, PowerMeterHttpJsonConfig& target)
@@ -463,6 +901,28 @@ void ConfigurationClass::deserializePowerMeterHttpSmlConfig(JsonObject const& so
     deserializeHttpRequestConfig(source["http_request"], target.HttpRequest);
 }
 
+void ConfigurationClass::deserializePowerMeterUdpConfig(JsonObject const& source, PowerMeterUdpConfig& target)
+{
+    target.Port = source["port"] | POWERMETER_UDP_PORT;
+    target.PayloadFormat = source["format"] | PowerMeterUdpConfig::Format::Text;
+}
+
+void ConfigurationClass::deserializePowerMeterFilterConfig(JsonObject const& source, PowerMeterFilterConfig& target)
+{
+    target.FilterMode = source["mode"] | static_cast<PowerMeterFilterConfig::Mode>(POWERMETER_FILTER_MODE);
+    target.Window = std::clamp<int>(source["window"] | POWERMETER_FILTER_WINDOW, 1, POWERMETER_FILTER_MAX_WINDOW);
+    target.StepThreshold = source["step_threshold"] | POWERMETER_FILTER_STEP_THRESHOLD;
+}
+
+void ConfigurationClass::deserializePowerMeterAdditionalConfig(JsonArray const& source, PowerMeterAdditionalConfig* target)
+{
+    for (size_t i = 0; i < POWERMETER_MAX_ADDITIONAL; ++i) {
+        JsonObject s = source[i];
+        target[i].Op = s["operation"] | PowerMeterAdditionalConfig::Operation::Disabled;
+        target[i].Source = s["source"] | POWERMETER_SOURCE;
+    }
+}
+
 void ConfigurationClass::deserializeBatteryConfig(JsonObject const& source, BatteryConfig& target)
 {
     target.Enabled = source["enabled"] | BATTERY_ENABLED;
@@ -483,6 +943,17 @@ void ConfigurationClass::deserializeBatteryConfig(JsonObject const& source, Batt
     strlcpy(target.MqttDischargeCurrentTopic, source["mqtt_discharge_current_topic"] | "", sizeof(config.Battery.MqttDischargeCurrentTopic));
     strlcpy(target.MqttDischargeCurrentJsonPath, source["mqtt_discharge_current_json_path"] | "", sizeof(config.Battery.MqttDischargeCurrentJsonPath));
     target.MqttAmperageUnit = source["mqtt_amperage_unit"] | BatteryAmperageUnit::Amps;
+    target.MqttBundled = source["mqtt_bundled"] | BATTERY_MQTT_BUNDLED;
+
+    JsonArray children = source["aggregate_children"].as<JsonArray>();
+    for (size_t i = 0; i < BATTERY_AGGREGATE_MAX_CHILDREN; ++i) {
+        BatteryAggregateChildConfig& t = target.AggregateChildren[i];
+        JsonObject s = children[i];
+
+        t.Enabled = s["enabled"] | false;
+        t.Provider = s["provider"] | BATTERY_PROVIDER;
+        t.CapacityAmpHours = s["capacity"] | BATTERY_AGGREGATE_CAPACITY;
+    }
 }
 
 void ConfigurationClass::deserializePowerLimiterConfig(JsonObject const& source, PowerLimiterConfig& target)
@@ -505,6 +976,7 @@ void ConfigurationClass::deserializePowerLimiterConfig(JsonObject const& source,
     target.VoltageStartThreshold = source["voltage_start_threshold"] | POWERLIMITER_VOLTAGE_START_THRESHOLD;
     target.VoltageStopThreshold = source["voltage_stop_threshold"] | POWERLIMITER_VOLTAGE_STOP_THRESHOLD;
     target.VoltageLoadCorrectionFactor = source["voltage_load_correction_factor"] | POWERLIMITER_VOLTAGE_LOAD_CORRECTION_FACTOR;
+    target.VoltageLoadCorrectionAutomatic = source["voltage_load_correction_automatic"] | POWERLIMITER_VOLTAGE_LOAD_CORRECTION_AUTOMATIC;
     target.FullSolarPassThroughSoc = source["full_solar_passthrough_soc"] | POWERLIMITER_FULL_SOLAR_PASSTHROUGH_SOC;
     target.FullSolarPassThroughStartVoltage = source["full_solar_passthrough_start_voltage"] | POWERLIMITER_FULL_SOLAR_PASSTHROUGH_START_VOLTAGE;
     target.FullSolarPassThroughStopVoltage = source["full_solar_passthrough_stop_voltage"] | POWERLIMITER_FULL_SOLAR_PASSTHROUGH_STOP_VOLTAGE;
@@ -512,6 +984,15 @@ void ConfigurationClass::deserializePowerLimiterConfig(JsonObject const& source,
     target.InverterChannelIdForDcVoltage = source["inverter_channel_id_for_dc_voltage"] | POWERLIMITER_INVERTER_CHANNEL_ID;
     target.RestartHour = source["inverter_restart_hour"] | POWERLIMITER_RESTART_HOUR;
     target.TotalUpperPowerLimit = source["total_upper_power_limit"] | POWERLIMITER_UPPER_POWER_LIMIT;
+    target.ExportGuardThreshold = source["export_guard_threshold"] | POWERLIMITER_EXPORT_GUARD_THRESHOLD;
+    target.PredictiveMode = source["predictive_mode"] | POWERLIMITER_PREDICTIVE_MODE;
+    target.OptimizedDispatch = source["optimized_dispatch"] | POWERLIMITER_OPTIMIZED_DISPATCH;
+    target.PhaseMode = source["phase_mode"] | static_cast<PowerLimiterConfig::PhaseModes>(POWERLIMITER_PHASE_MODE);
+    target.BatteryDischargePlan = source["battery_discharge_plan"] | POWERLIMITER_BATTERY_DISCHARGE_PLAN;
+    target.BatteryCapacity = source["battery_capacity"] | POWERLIMITER_BATTERY_CAPACITY;
+    target.BatteryDischargePlanReserveSoc = source["battery_discharge_plan_reserve_soc"] | POWERLIMITER_BATTERY_DISCHARGE_PLAN_RESERVE_SOC;
+    target.Cluster = source["cluster"] | POWERLIMITER_CLUSTER;
+    strlcpy(target.ClusterKey, source["cluster_key"] | POWERLIMITER_CLUSTER_KEY, sizeof(target.ClusterKey));
 
     JsonArray inverters = source["inverters"].as<JsonArray>();
     for (size_t i = 0; i < INV_MAX_COUNT; ++i) {
@@ -522,6 +1003,7 @@ void ConfigurationClass::deserializePowerLimiterConfig(JsonObject const& source,
         inv.IsGoverned = s["is_governed"] | false;
         inv.IsBehindPowerMeter = s["is_behind_power_meter"] | POWERLIMITER_IS_INVERTER_BEHIND_POWER_METER;
         inv.PowerSource = s["power_source"] | PowerLimiterInverterConfig::InverterPowerSource::Battery;
+        inv.Phase = std::min<uint8_t>(s["phase"] | 0, 3);
         inv.UseOverscaling = s["use_overscaling_to_compensate_shading"] | POWERLIMITER_USE_OVERSCALING;
         inv.LowerPowerLimit = s["lower_power_limit"] | POWERLIMITER_LOWER_POWER_LIMIT;
         inv.UpperPowerLimit = s["upper_power_limit"] | POWERLIMITER_UPPER_POWER_LIMIT;
@@ -548,6 +1030,15 @@ void ConfigurationClass::deserializeGridChargerConfig(JsonObject const& source,
 
 bool ConfigurationClass::read()
 {
+    if (readSnapshot()) {
+        MessageOutput.println("Using binary configuration snapshot");
+        replayJournal();
+        return true;
+    }
+
+    // without snapshot, a journal cannot be applied
+    LittleFS.remove(CONFIG_JOURNAL_FILENAME);
+
     File f = LittleFS.open(CONFIG_FILENAME, "r", false);
     Utils::skipBom(f);
 
@@ -619,6 +1110,7 @@ bool ConfigurationClass::read()
 
     config.WiFi.Dhcp = wifi["dhcp"] | WIFI_DHCP;
     config.WiFi.ApTimeout = wifi["aptimeout"] | ACCESS_POINT_TIMEOUT;
+    config.WiFi.LatencyMode = wifi["latency_mode"] | WIFI_LATENCY_MODE;
 
     JsonObject mdns = doc["mdns"];
     config.Mdns.Enabled = mdns["enabled"] | MDNS_ENABLED;
@@ -628,6 +1120,23 @@ bool ConfigurationClass::read()
     strlcpy(config.Syslog.Hostname, syslog["hostname"] | "", sizeof(config.Syslog.Hostname));
     config.Syslog.Port = syslog["port"] | SYSLOG_PORT;
 
+    JsonObject telemetry = doc["telemetry"];
+    config.Telemetry.Enabled = telemetry["enabled"] | TELEMETRY_ENABLED;
+    strlcpy(config.Telemetry.Hostname, telemetry["hostname"] | "", sizeof(config.Telemetry.Hostname));
+    config.Telemetry.Port = telemetry["port"] | TELEMETRY_PORT;
+    config.Telemetry.Interval = telemetry["interval"] | TELEMETRY_INTERVAL;
+
+    JsonObject metricsPush = doc["metrics_push"];
+    config.MetricsPush.Enabled = metricsPush["enabled"] | METRICS_PUSH_ENABLED;
+    deserializeHttpRequestConfig(metricsPush["http_request"], config.MetricsPush.HttpRequest);
+    config.MetricsPush.Interval = metricsPush["interval"] | METRICS_PUSH_INTERVAL;
+    config.MetricsPush.PushInterval = metricsPush["push_interval"] | METRICS_PUSH_PUSH_INTERVAL;
+
+    JsonObject modbus = doc["modbus"];
+    config.Modbus.Enabled = modbus["enabled"] | MODBUS_ENABLED;
+    config.Modbus.Port = modbus["port"] | MODBUS_PORT;
+    config.Modbus.AllowWrite = modbus["allow_write"] | MODBUS_ALLOW_WRITE;
+
     JsonObject ntp = doc["ntp"];
     strlcpy(config.Ntp.Server, ntp["server"] | NTP_SERVER, sizeof(config.Ntp.Server));
     strlcpy(config.Ntp.Timezone, ntp["timezone"] | NTP_TIMEZONE, sizeof(config.Ntp.Timezone));
@@ -649,6 +1158,15 @@ bool ConfigurationClass::read()
     config.Mqtt.PublishInterval = mqtt["publish_interval"] | MQTT_PUBLISH_INTERVAL;
     config.Mqtt.CleanSession = mqtt["clean_session"] | MQTT_CLEAN_SESSION;
 
+    JsonObject mqtt_deadband = mqtt["deadband"];
+    config.Mqtt.Deadband.Power = mqtt_deadband["power"] | MQTT_DEADBAND_POWER;
+    config.Mqtt.Deadband.Voltage = mqtt_deadband["voltage"] | MQTT_DEADBAND_VOLTAGE;
+    config.Mqtt.Deadband.Current = mqtt_deadband["current"] | MQTT_DEADBAND_CURRENT;
+    config.Mqtt.Deadband.Frequency = mqtt_deadband["frequency"] | MQTT_DEADBAND_FREQUENCY;
+    config.Mqtt.Deadband.Temperature = mqtt_deadband["temperature"] | MQTT_DEADBAND_TEMPERATURE;
+    config.Mqtt.Deadband.PowerFactor = mqtt_deadband["power_factor"] | MQTT_DEADBAND_POWER_FACTOR;
+    config.Mqtt.Deadband.Percent = mqtt_deadband["percent"] | MQTT_DEADBAND_PERCENT;
+
     JsonObject mqtt_lwt = mqtt["lwt"];
     strlcpy(config.Mqtt.Lwt.Topic, mqtt_lwt["topic"] | MQTT_LWT_TOPIC, sizeof(config.Mqtt.Lwt.Topic));
     strlcpy(config.Mqtt.Lwt.Value_Online, mqtt_lwt["value_online"] | MQTT_LWT_ONLINE, sizeof(config.Mqtt.Lwt.Value_Online));
@@ -673,10 +1191,12 @@ bool ConfigurationClass::read()
     config.Dtu.Serial = dtu["serial"] | DTU_SERIAL;
     config.Dtu.PollInterval = dtu["poll_interval"] | DTU_POLL_INTERVAL;
     config.Dtu.VerboseLogging = dtu["verbose_logging"] | VERBOSE_LOGGING;
+    config.Dtu.NightMode = dtu["night_mode"] | DTU_NIGHT_MODE;
     config.Dtu.Nrf.PaLevel = dtu["nrf_pa_level"] | DTU_NRF_PA_LEVEL;
     config.Dtu.Cmt.PaLevel = dtu["cmt_pa_level"] | DTU_CMT_PA_LEVEL;
     config.Dtu.Cmt.Frequency = dtu["cmt_frequency"] | DTU_CMT_FREQUENCY;
     config.Dtu.Cmt.CountryMode = dtu["cmt_country_mode"] | DTU_CMT_COUNTRY_MODE;
+    config.Dtu.Cmt.FrequencyAgility = dtu["cmt_frequency_agility"] | DTU_CMT_FREQUENCY_AGILITY;
 
     JsonObject security = doc["security"];
     strlcpy(config.Security.Password, security["password"] | ACCESS_POINT_PASSWORD, sizeof(config.Security.Password));
@@ -716,6 +1236,7 @@ bool ConfigurationClass::read()
         config.Inverter[i].ZeroYieldDayOnMidnight = inv["zero_day"] | false;
         config.Inverter[i].ClearEventlogOnMidnight = inv["clear_eventlog"] | false;
         config.Inverter[i].YieldDayCorrection = inv["yieldday_correction"] | false;
+        config.Inverter[i].NrfRadio = inv["nrf_radio"] | 0;
 
         JsonArray channel = inv["channel"];
         for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
@@ -742,14 +1263,28 @@ bool ConfigurationClass::read()
 
     deserializePowerMeterHttpSmlConfig(powermeter["http_sml"], config.PowerMeter.HttpSml);
 
+    deserializePowerMeterUdpConfig(powermeter["udp"], config.PowerMeter.Udp);
+
+    deserializePowerMeterFilterConfig(powermeter["filter"], config.PowerMeter.Filter);
+
+    deserializePowerMeterAdditionalConfig(powermeter["additional"], config.PowerMeter.Additional);
+
     deserializePowerLimiterConfig(doc["powerlimiter"], config.PowerLimiter);
 
     deserializeBatteryConfig(doc["battery"], config.Battery);
 
     deserializeGridChargerConfig(doc["huawei"], config.Huawei);
 
+    uint32_t jsonSize = f.size();
     f.close();
 
+    // take a snapshot of a current config for the next boot. outdated
+    // configs are written by migrate(), which also takes the snapshot.
+    if (!error && config.Cfg.Version == CONFIG_VERSION
+            && config.Cfg.VersionOnBattery == CONFIG_VERSION_ONBATTERY) {
+        writeSnapshot(jsonSize);
+    }
+
     // Check for default DTU serial
     MessageOutput.print("Check for default DTU serial... ");
     if (config.Dtu.Serial == DTU_SERIAL) {
@@ -1042,6 +1577,7 @@ void ConfigurationClass::deleteInverterById(const uint8_t id)
     config.Inverter[id].ZeroRuntimeDataIfUnrechable = false;
     config.Inverter[id].ZeroYieldDayOnMidnight = false;
     config.Inverter[id].YieldDayCorrection = false;
+    config.Inverter[id].NrfRadio = 0;
 
     for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
         config.Inverter[id].channel[c].MaxChannelPower = 0;
@@ -1052,6 +1588,11 @@ void ConfigurationClass::deleteInverterById(const uint8_t id)
 
 void ConfigurationClass::loop()
 {
+    // flush() keeps writers out while the config is serialized
+    if (_compactionDue && (millis() - _lastJournalWrite) >= _compactionDelayMs) {
+        flush();
+    }
+
     std::unique_lock<std::mutex> lock(sWriterMutex);
     if (sWriterCount == 0) { return; }
 
@@ -38,9 +38,9 @@ std::string dataPointValueToStr(tCellVoltages const& v) {
     res.reserve(v.size()*(2+2+1+4)); // separator, index, equal sign, value
     res += "(";
     std::string sep = "";
-    for(auto const& mapval : v) {
+    for(auto const& cell : v) {
         snprintf(conversionBuffer, sizeof(conversionBuffer), "%s%d=%d",
-                sep.c_str(), mapval.first, mapval.second);
+                sep.c_str(), cell.first, cell.second);
         res += conversionBuffer;
         sep = ", ";
     }
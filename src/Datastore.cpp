@@ -3,13 +3,16 @@
  * Copyright (C) 2023-2024 Thomas Basler and others
  */
 #include "Datastore.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
+#include "EventBus.h"
+#include "MetricsRegistry.h"
 #include <Hoymiles.h>
 
 DatastoreClass Datastore;
 
 DatastoreClass::DatastoreClass()
-    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&DatastoreClass::loop, this))
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("Datastore::loop", std::bind(&DatastoreClass::loop, this)))
 {
 }
 
@@ -17,40 +20,37 @@ void DatastoreClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
     _loopTask.enable();
+
+    registerMetrics();
 }
 
-void DatastoreClass::loop()
+void DatastoreClass::registerMetrics()
 {
-    if (!Hoymiles.isAllRadioIdle()) {
-        _loopTask.forceNextIteration();
-        return;
-    }
-
-    uint8_t isProducing = 0;
-    uint8_t isReachable = 0;
-    uint8_t pollEnabledCount = 0;
-
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    _totalAcYieldTotalEnabled = 0;
-    _totalAcYieldTotalDigits = 0;
-
-    _totalAcYieldDayEnabled = 0;
-    _totalAcYieldDayDigits = 0;
-
-    _totalAcPowerEnabled = 0;
-    _totalAcPowerDigits = 0;
+    using Type = MetricsRegistryClass::Type;
+
+    MetricsRegistry.add("opendtu_total_ac_power", "Total AC power of all enabled inverters in W", Type::Gauge,
+        [this]() -> std::optional<float> { return getTotals()->AcPowerEnabled; });
+    MetricsRegistry.add("opendtu_total_dc_power", "Total DC power of all enabled inverters in W", Type::Gauge,
+        [this]() -> std::optional<float> { return getTotals()->DcPowerEnabled; });
+    MetricsRegistry.add("opendtu_total_yield_day", "Total yield of the day of all enabled inverters in Wh", Type::Counter,
+        [this]() -> std::optional<float> { return getTotals()->AcYieldDayEnabled; });
+    MetricsRegistry.add("opendtu_total_yield_total", "Total yield of all enabled inverters in kWh", Type::Counter,
+        [this]() -> std::optional<float> { return getTotals()->AcYieldTotalEnabled; });
+}
 
-    _totalDcPowerEnabled = 0;
-    _totalDcPowerDigits = 0;
+bool DatastoreClass::syncInverters()
+{
+    size_t count = Hoymiles.getNumInverters();
 
-    _totalDcPowerIrradiation = 0;
-    _totalDcIrradiationInstalled = 0;
+    bool same = (count == _inverters.size());
+    for (uint8_t i = 0; same && i < count; i++) {
+        same = (Hoymiles.getInverterByPos(i) == _inverters[i].Inverter);
+    }
+    if (same) { return false; }
 
-    _isAllEnabledProducing = true;
-    _isAllEnabledReachable = true;
+    _inverters.clear();
 
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+    for (uint8_t i = 0; i < count; i++) {
         auto inv = Hoymiles.getInverterByPos(i);
         if (inv == nullptr) {
             continue;
@@ -61,155 +61,217 @@ void DatastoreClass::loop()
             continue;
         }
 
-        if (inv->getEnablePolling()) {
-            pollEnabledCount++;
-        }
+        InverterState state;
+        state.Inverter = inv;
+        state.Config = cfg;
+        state.spUpdated = std::make_shared<std::atomic<bool>>(true);
+
+        // the callback is invoked from within the Hoymiles library. it only
+        // raises a flag, the contribution is recalculated in our loop.
+        // the update is also published on the event bus.
+        std::weak_ptr<std::atomic<bool>> wpUpdated = state.spUpdated;
+        uint64_t serial = inv->serial();
+        inv->Statistics()->setUpdateCallback([wpUpdated, serial]() {
+            auto spUpdated = wpUpdated.lock();
+            if (spUpdated) { *spUpdated = true; }
+            EventBus.publish(Events::InverterStatsUpdated{ serial });
+        });
+
+        _inverters.push_back(std::move(state));
+    }
 
-        if (inv->isProducing()) {
-            isProducing++;
-        } else {
-            if (inv->getEnablePolling()) {
-                _isAllEnabledProducing = false;
-            }
+    return true;
+}
+
+void DatastoreClass::InverterState::updateContribution()
+{
+    auto stats = Inverter->Statistics();
+
+    AcYieldTotal = AcYieldDay = AcPower = DcPower = 0;
+    DcPowerIrradiation = DcIrradiationInstalled = 0;
+    AcYieldTotalDigits = AcYieldDayDigits = AcPowerDigits = DcPowerDigits = 0;
+
+    for (auto& c : stats->getChannelsByType(TYPE_INV)) {
+        if (ConfigPollEnabled) {
+            AcYieldTotal += stats->getChannelFieldValue(TYPE_INV, c, FLD_YT);
+            AcYieldDay += stats->getChannelFieldValue(TYPE_INV, c, FLD_YD);
+
+            AcYieldTotalDigits = max<unsigned int>(AcYieldTotalDigits, stats->getChannelFieldDigits(TYPE_INV, c, FLD_YT));
+            AcYieldDayDigits = max<unsigned int>(AcYieldDayDigits, stats->getChannelFieldDigits(TYPE_INV, c, FLD_YD));
         }
+    }
 
-        if (inv->isReachable()) {
-            isReachable++;
-        } else {
-            if (inv->getEnablePolling()) {
-                _isAllEnabledReachable = false;
-            }
+    for (auto& c : stats->getChannelsByType(TYPE_AC)) {
+        if (PollEnabled) {
+            AcPower += stats->getChannelFieldValue(TYPE_AC, c, FLD_PAC);
+            AcPowerDigits = max<unsigned int>(AcPowerDigits, stats->getChannelFieldDigits(TYPE_AC, c, FLD_PAC));
         }
+    }
 
-        for (auto& c : inv->Statistics()->getChannelsByType(TYPE_INV)) {
-            if (cfg->Poll_Enable) {
-                _totalAcYieldTotalEnabled += inv->Statistics()->getChannelFieldValue(TYPE_INV, c, FLD_YT);
-                _totalAcYieldDayEnabled += inv->Statistics()->getChannelFieldValue(TYPE_INV, c, FLD_YD);
+    for (auto& c : stats->getChannelsByType(TYPE_DC)) {
+        if (PollEnabled) {
+            DcPower += stats->getChannelFieldValue(TYPE_DC, c, FLD_PDC);
+            DcPowerDigits = max<unsigned int>(DcPowerDigits, stats->getChannelFieldDigits(TYPE_DC, c, FLD_PDC));
 
-                _totalAcYieldTotalDigits = max<unsigned int>(_totalAcYieldTotalDigits, inv->Statistics()->getChannelFieldDigits(TYPE_INV, c, FLD_YT));
-                _totalAcYieldDayDigits = max<unsigned int>(_totalAcYieldDayDigits, inv->Statistics()->getChannelFieldDigits(TYPE_INV, c, FLD_YD));
+            if (stats->getStringMaxPower(c) > 0) {
+                DcPowerIrradiation += stats->getChannelFieldValue(TYPE_DC, c, FLD_PDC);
+                DcIrradiationInstalled += stats->getStringMaxPower(c);
             }
         }
+    }
+}
 
-        for (auto& c : inv->Statistics()->getChannelsByType(TYPE_AC)) {
-            if (inv->getEnablePolling()) {
-                _totalAcPowerEnabled += inv->Statistics()->getChannelFieldValue(TYPE_AC, c, FLD_PAC);
-                _totalAcPowerDigits = max<unsigned int>(_totalAcPowerDigits, inv->Statistics()->getChannelFieldDigits(TYPE_AC, c, FLD_PAC));
-            }
-        }
+void DatastoreClass::loop()
+{
+    if (!Hoymiles.isAllRadioIdle()) {
+        _loopTask.forceNextIteration();
+        return;
+    }
 
-        for (auto& c : inv->Statistics()->getChannelsByType(TYPE_DC)) {
-            if (inv->getEnablePolling()) {
-                _totalDcPowerEnabled += inv->Statistics()->getChannelFieldValue(TYPE_DC, c, FLD_PDC);
-                _totalDcPowerDigits = max<unsigned int>(_totalDcPowerDigits, inv->Statistics()->getChannelFieldDigits(TYPE_DC, c, FLD_PDC));
+    bool changed = syncInverters();
 
-                if (inv->Statistics()->getStringMaxPower(c) > 0) {
-                    _totalDcPowerIrradiation += inv->Statistics()->getChannelFieldValue(TYPE_DC, c, FLD_PDC);
-                    _totalDcIrradiationInstalled += inv->Statistics()->getStringMaxPower(c);
-                }
-            }
+    // reachability and production depend on the time passed since the last
+    // update, so these are evaluated on every iteration. the contributions
+    // of inverters without new statistics are reused.
+    for (auto& state : _inverters) {
+        auto const& inv = state.Inverter;
+
+        bool pollEnabled = inv->getEnablePolling();
+        bool configPollEnabled = state.Config->Poll_Enable;
+        bool producing = inv->isProducing();
+        bool reachable = inv->isReachable();
+
+        bool updated = state.spUpdated->exchange(false);
+        updated |= (pollEnabled != state.PollEnabled);
+        updated |= (configPollEnabled != state.ConfigPollEnabled);
+
+        changed |= updated || (producing != state.Producing) || (reachable != state.Reachable);
+
+        state.PollEnabled = pollEnabled;
+        state.ConfigPollEnabled = configPollEnabled;
+        state.Producing = producing;
+        state.Reachable = reachable;
+
+        if (updated) { state.updateContribution(); }
+    }
+
+    if (!changed) { return; }
+
+    auto spTotals = std::make_shared<Totals>();
+    spTotals->IsAllEnabledProducing = true;
+    spTotals->IsAllEnabledReachable = true;
+
+    for (auto const& state : _inverters) {
+        spTotals->IsAtLeastOnePollEnabled |= state.PollEnabled;
+        spTotals->IsAtLeastOneProducing |= state.Producing;
+        spTotals->IsAtLeastOneReachable |= state.Reachable;
+
+        if (state.PollEnabled) {
+            spTotals->IsAllEnabledProducing &= state.Producing;
+            spTotals->IsAllEnabledReachable &= state.Reachable;
         }
+
+        spTotals->AcYieldTotalEnabled += state.AcYieldTotal;
+        spTotals->AcYieldDayEnabled += state.AcYieldDay;
+        spTotals->AcPowerEnabled += state.AcPower;
+        spTotals->DcPowerEnabled += state.DcPower;
+        spTotals->DcPowerIrradiation += state.DcPowerIrradiation;
+        spTotals->DcIrradiationInstalled += state.DcIrradiationInstalled;
+
+        spTotals->AcYieldTotalDigits = max<unsigned int>(spTotals->AcYieldTotalDigits, state.AcYieldTotalDigits);
+        spTotals->AcYieldDayDigits = max<unsigned int>(spTotals->AcYieldDayDigits, state.AcYieldDayDigits);
+        spTotals->AcPowerDigits = max<unsigned int>(spTotals->AcPowerDigits, state.AcPowerDigits);
+        spTotals->DcPowerDigits = max<unsigned int>(spTotals->DcPowerDigits, state.DcPowerDigits);
     }
 
-    _isAtLeastOneProducing = isProducing > 0;
-    _isAtLeastOneReachable = isReachable > 0;
-    _isAtLeastOnePollEnabled = pollEnabledCount > 0;
+    spTotals->DcIrradiation = spTotals->DcIrradiationInstalled > 0 ? spTotals->DcPowerIrradiation / spTotals->DcIrradiationInstalled * 100.0f : 0;
+
+    std::atomic_store(&_spTotals, std::shared_ptr<Totals const>(std::move(spTotals)));
 
-    _totalDcIrradiation = _totalDcIrradiationInstalled > 0 ? _totalDcPowerIrradiation / _totalDcIrradiationInstalled * 100.0f : 0;
+    for (auto const& callback : _updateCallbacks) { callback(); }
+}
+
+void DatastoreClass::onUpdate(UpdateCallback callback)
+{
+    _updateCallbacks.push_back(std::move(callback));
 }
 
 float DatastoreClass::getTotalAcYieldTotalEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcYieldTotalEnabled;
+    return getTotals()->AcYieldTotalEnabled;
 }
 
 float DatastoreClass::getTotalAcYieldDayEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcYieldDayEnabled;
+    return getTotals()->AcYieldDayEnabled;
 }
 
 float DatastoreClass::getTotalAcPowerEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcPowerEnabled;
+    return getTotals()->AcPowerEnabled;
 }
 
 float DatastoreClass::getTotalDcPowerEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcPowerEnabled;
+    return getTotals()->DcPowerEnabled;
 }
 
 float DatastoreClass::getTotalDcPowerIrradiation()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcPowerIrradiation;
+    return getTotals()->DcPowerIrradiation;
 }
 
 float DatastoreClass::getTotalDcIrradiationInstalled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcIrradiationInstalled;
+    return getTotals()->DcIrradiationInstalled;
 }
 
 float DatastoreClass::getTotalDcIrradiation()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcIrradiation;
+    return getTotals()->DcIrradiation;
 }
 
 uint32_t DatastoreClass::getTotalAcYieldTotalDigits()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcYieldTotalDigits;
+    return getTotals()->AcYieldTotalDigits;
 }
 
 uint32_t DatastoreClass::getTotalAcYieldDayDigits()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcYieldDayDigits;
+    return getTotals()->AcYieldDayDigits;
 }
 
 uint32_t DatastoreClass::getTotalAcPowerDigits()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalAcPowerDigits;
+    return getTotals()->AcPowerDigits;
 }
 
 uint32_t DatastoreClass::getTotalDcPowerDigits()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _totalDcPowerDigits;
+    return getTotals()->DcPowerDigits;
 }
 
 bool DatastoreClass::getIsAtLeastOneReachable()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAtLeastOneReachable;
+    return getTotals()->IsAtLeastOneReachable;
 }
 
 bool DatastoreClass::getIsAtLeastOneProducing()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAtLeastOneProducing;
+    return getTotals()->IsAtLeastOneProducing;
 }
 
 bool DatastoreClass::getIsAllEnabledProducing()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAllEnabledProducing;
+    return getTotals()->IsAllEnabledProducing;
 }
 
 bool DatastoreClass::getIsAllEnabledReachable()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAllEnabledReachable;
+    return getTotals()->IsAllEnabledReachable;
 }
 
 bool DatastoreClass::getIsAtLeastOnePollEnabled()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _isAtLeastOnePollEnabled;
+    return getTotals()->IsAtLeastOnePollEnabled;
 }
@@ -2,11 +2,13 @@
 /*
  * Copyright (C) 2023-2024 Thomas Basler and others
  */
+#ifndef OPENDTU_WITHOUT_DISPLAY
 #include "Display_Graphic.h"
 #include "Datastore.h"
 #include "I18n.h"
 #include "PowerMeter.h"
 #include "Configuration.h"
+#include "MessageOutput.h"
 #include <NetworkSettings.h>
 #include <map>
 #include <time.h>
@@ -41,7 +43,6 @@ static const char* const i18n_yield_total_mwh[] = { "total: %.0f kWh", "Ges.: %.
 static const char* const i18n_date_format[] = { "%m/%d/%Y %H:%M", "%d.%m.%Y %H:%M", "%d/%m/%Y %H:%M" };
 
 DisplayGraphicClass::DisplayGraphicClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&DisplayGraphicClass::loop, this))
 {
 }
 
@@ -64,10 +65,67 @@ void DisplayGraphicClass::init(Scheduler& scheduler, const DisplayType_t type, c
         setStatus(true);
         _diagram.init(scheduler, _display);
 
-        scheduler.addTask(_loopTask);
-        _loopTask.setInterval(_period);
-        _loopTask.enable();
+        uint32_t constexpr stackSize = 3072;
+        if (pdPASS != xTaskCreate(DisplayGraphicClass::renderLoopHelper, "Display",
+                    stackSize, this, tskIDLE_PRIORITY, &_renderTaskHandle)) {
+            MessageOutput.print("[DisplayGraphic] Failed to start render task\r\n");
+            _renderTaskHandle = nullptr;
+        }
+    }
+}
+
+void DisplayGraphicClass::renderLoopHelper(void* context)
+{
+    auto pInstance = static_cast<DisplayGraphicClass*>(context);
+    pInstance->renderLoop();
+}
+
+void DisplayGraphicClass::renderLoop()
+{
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(_period));
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        loop();
+    }
+}
+
+// compares the frame buffer to the frame last sent, tile by tile, and only
+// transfers the runs of changed tiles in each tile row.
+void DisplayGraphicClass::sendChangedTiles()
+{
+    uint8_t const* buffer = _display->getBufferPtr();
+    uint8_t const tileWidth = _display->getBufferTileWidth();
+    uint8_t const tileHeight = _display->getBufferTileHeight();
+    size_t const bufferSize = static_cast<size_t>(tileWidth) * tileHeight * 8;
+
+    if (_fullRefresh || _sentBuffer.size() != bufferSize) {
+        _display->sendBuffer();
+        _sentBuffer.assign(buffer, buffer + bufferSize);
+        _fullRefresh = false;
+        return;
     }
+
+    auto tileChanged = [&](uint8_t tx, uint8_t ty) {
+        size_t offset = (static_cast<size_t>(ty) * tileWidth + tx) * 8;
+        return memcmp(&buffer[offset], &_sentBuffer[offset], 8) != 0;
+    };
+
+    for (uint8_t ty = 0; ty < tileHeight; ty++) {
+        uint8_t tx = 0;
+        while (tx < tileWidth) {
+            if (!tileChanged(tx, ty)) {
+                ++tx;
+                continue;
+            }
+
+            uint8_t start = tx;
+            while (tx < tileWidth && tileChanged(tx, ty)) { ++tx; }
+            _display->updateDisplayArea(start, ty, tx - start, 1);
+        }
+    }
+
+    memcpy(_sentBuffer.data(), buffer, bufferSize);
 }
 
 void DisplayGraphicClass::calcLineHeights()
@@ -146,6 +204,8 @@ void DisplayGraphicClass::setOrientation(const uint8_t rotation)
         return;
     }
 
+    std::lock_guard<std::mutex> lock(_mutex);
+
     switch (rotation) {
     case 0:
         _display->setDisplayRotation(U8G2_R0);
@@ -163,10 +223,13 @@ void DisplayGraphicClass::setOrientation(const uint8_t rotation)
 
     _isLarge = (_display->getWidth() > 100);
     calcLineHeights();
+    _fullRefresh = true;
 }
 
 void DisplayGraphicClass::setLocale(const String& locale)
 {
+    std::lock_guard<std::mutex> lock(_mutex);
+
     _display_language = locale;
     uint8_t idx = I18N_LOCALE_EN;
     if (locale == "de") {
@@ -201,6 +264,8 @@ void DisplayGraphicClass::setLocale(const String& locale)
 
 void DisplayGraphicClass::setDiagramMode(DiagramMode_t mode)
 {
+    std::lock_guard<std::mutex> lock(_mutex);
+
     if (mode < DiagramMode_t::DisplayMode_Max) {
         _diagram_mode = mode;
     }
@@ -212,9 +277,12 @@ void DisplayGraphicClass::setStartupDisplay()
         return;
     }
 
+    std::lock_guard<std::mutex> lock(_mutex);
+
     _display->clearBuffer();
     printText("OpenDTU!", 0);
     _display->sendBuffer();
+    _fullRefresh = true;
 }
 
 DisplayGraphicDiagramClass& DisplayGraphicClass::Diagram()
@@ -224,8 +292,6 @@ DisplayGraphicDiagramClass& DisplayGraphicClass::Diagram()
 
 void DisplayGraphicClass::loop()
 {
-    _loopTask.setInterval(_period);
-
     _display->clearBuffer();
     bool displayPowerSave = false;
     bool showText = true;
@@ -327,7 +393,7 @@ void DisplayGraphicClass::loop()
         printText(_fmtText, 2);
     }
 
-    _display->sendBuffer();
+    sendChangedTiles();
 
     _mExtra++;
 
@@ -343,6 +409,8 @@ void DisplayGraphicClass::setContrast(const uint8_t contrast)
     if (!isValidDisplay()) {
         return;
     }
+
+    std::lock_guard<std::mutex> lock(_mutex);
     _display->setContrast(contrast * 2.55f);
 }
 
@@ -352,3 +420,5 @@ void DisplayGraphicClass::setStatus(const bool turnOn)
 }
 
 DisplayGraphicClass Display;
+
+#endif // OPENDTU_WITHOUT_DISPLAY
@@ -2,14 +2,15 @@
 /*
  * Copyright (C) 2023-2024 Thomas Basler and others
  */
+#ifndef OPENDTU_WITHOUT_DISPLAY
 #include "Display_Graphic_Diagram.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
-#include "Datastore.h"
 #include <algorithm>
+#include <ctime>
 
 DisplayGraphicDiagramClass::DisplayGraphicDiagramClass()
-    : _averageTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&DisplayGraphicDiagramClass::averageLoop, this))
-    , _dataPointTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&DisplayGraphicDiagramClass::dataPointLoop, this))
+    : _refreshTask(TASK_IMMEDIATE, TASK_FOREVER, TaskMonitor.wrap("DisplayGraphicDiagram::refreshLoop", std::bind(&DisplayGraphicDiagramClass::refreshLoop, this)))
 {
 }
 
@@ -17,49 +18,55 @@ void DisplayGraphicDiagramClass::init(Scheduler& scheduler, U8G2* display)
 {
     _display = display;
 
-    scheduler.addTask(_averageTask);
-    _averageTask.enable();
-
-    scheduler.addTask(_dataPointTask);
+    scheduler.addTask(_refreshTask);
     updatePeriod();
-    _dataPointTask.enable();
-}
-
-void DisplayGraphicDiagramClass::averageLoop()
-{
-    const float currentWatts = Datastore.getTotalAcPowerEnabled(); // get the current AC production
-    _iRunningAverage += currentWatts;
-    _iRunningAverageCnt++;
+    _refreshTask.enable();
 }
 
-void DisplayGraphicDiagramClass::dataPointLoop()
+void DisplayGraphicDiagramClass::refreshLoop()
 {
-    if (_graphValuesCount >= std::size(_graphValues)) {
-        for (uint8_t i = 0; i < std::size(_graphValues) - 1; i++) {
-            _graphValues[i] = _graphValues[i + 1];
-        }
-        _graphValuesCount = std::size(_graphValues) - 1;
+    uint8_t chartWidth;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        chartWidth = _chartWidth;
     }
-    if (_iRunningAverageCnt != 0) {
-        _graphValues[_graphValuesCount++] = _iRunningAverage / _iRunningAverageCnt;
-        _iRunningAverage = 0;
-        _iRunningAverageCnt = 0;
+
+    std::vector<TimeSeriesClass::Bucket> buckets;
+    uint32_t duration = Configuration.get().Display.Diagram.Duration;
+    uint32_t bucketWidth = std::max<uint32_t>(duration / chartWidth, 1);
+    uint32_t now = std::time(nullptr);
+
+    // align the buckets to their width, such that a bucket's samples do not
+    // shift from one refresh to the next.
+    uint32_t to = now - now % bucketWidth + bucketWidth;
+    uint32_t from = to - bucketWidth * chartWidth;
+
+    // without valid time information, there is no history to show
+    struct tm timeinfo;
+    if (getLocalTime(&timeinfo, 5)) {
+        TimeSeries.getBuckets("ac_power", TimeSeriesClass::selectTier(bucketWidth),
+                from, to, chartWidth, buckets);
     }
-}
 
-uint32_t DisplayGraphicDiagramClass::getSecondsPerDot()
-{
-    return Configuration.get().Display.Diagram.Duration / _chartWidth;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _buckets = std::move(buckets);
+    _bucketWidth = bucketWidth;
 }
 
 void DisplayGraphicDiagramClass::updatePeriod()
 {
-    //  Calculate seconds per datapoint
-    _dataPointTask.setInterval(Configuration.get().Display.Diagram.Duration * TASK_SECOND / MAX_DATAPOINTS);
+    // the newest bucket changes with every sample of the finest tier, while
+    // older buckets only change after a change of the diagram's duration.
+    uint32_t bucketWidth = Configuration.get().Display.Diagram.Duration / MAX_DATAPOINTS;
+    bucketWidth = std::max(bucketWidth, TimeSeriesClass::getTierInterval(0));
+    _refreshTask.setInterval(std::min<uint32_t>(bucketWidth, 60) * TASK_SECOND);
+    _refreshTask.forceNextIteration();
 }
 
 void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos, uint8_t yPos, uint8_t width, uint8_t height, bool isFullscreen)
 {
+    std::lock_guard<std::mutex> lock(_mutex);
+
     _chartWidth = width;
 
     // screenSaverOffsetX expected to be in range 0..6
@@ -83,7 +90,10 @@ void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos
 
     // draw AC value
     char fmtText[7];
-    const float maxWatts = *std::max_element(_graphValues.begin(), _graphValues.end());
+    float maxWatts = 0;
+    for (auto const& bucket : _buckets) {
+        if (bucket.Count > 0) { maxWatts = std::max(maxWatts, bucket.Avg); }
+    }
     if (maxWatts > 999) {
         snprintf(fmtText, sizeof(fmtText), "%2.1fkW", maxWatts / 1000);
     } else {
@@ -103,7 +113,9 @@ void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos
 
     // draw chart
     const float scaleFactorY = maxWatts / static_cast<float>(height);
-    const float scaleFactorX = static_cast<float>(MAX_DATAPOINTS) / static_cast<float>(_chartWidth);
+    // the chart's width changes with the diagram mode, until the buckets
+    // were refreshed their count might differ from the width.
+    const float scaleFactorX = static_cast<float>(_buckets.size()) / static_cast<float>(_chartWidth);
 
     if (maxWatts > 0 && isFullscreen) {
         // draw y axis ticks
@@ -117,20 +129,30 @@ void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos
         }
     }
 
-    uint8_t xAxisTicks = 1;
-    for (uint8_t i = 1; i < _graphValuesCount; i++) {
-        // draw one tick per hour to the x-axis
-        if (i * getSecondsPerDot() > (3600u * xAxisTicks)) {
-            _display->drawPixel((graphPosX + 1 + i) * scaleFactorX, graphPosY + height);
-            xAxisTicks++;
+    // draw one tick per hour to the x-axis, counted from the right edge
+    if (_bucketWidth > 0 && scaleFactorX > 0) {
+        const uint32_t bucketsPerTick = std::max<uint32_t>(3600u / _bucketWidth, 1);
+        for (uint32_t i = bucketsPerTick; i < _buckets.size(); i += bucketsPerTick) {
+            _display->drawPixel(graphPosX + (_buckets.size() - 1 - i) / scaleFactorX, graphPosY + height);
         }
+    }
 
-        if (scaleFactorY == 0 || scaleFactorX == 0) {
+    if (scaleFactorY == 0 || scaleFactorX == 0) {
+        return;
+    }
+
+    // buckets without samples leave a gap in the chart
+    for (size_t i = 1; i < _buckets.size(); i++) {
+        auto const& previous = _buckets[i - 1];
+        auto const& current = _buckets[i];
+        if (previous.Count == 0 || current.Count == 0) {
             continue;
         }
 
         _display->drawLine(
-            graphPosX + (i - 1) / scaleFactorX, horizontal_line_y - std::max<int16_t>(0, _graphValues[i - 1] / scaleFactorY - 0.5),
-            graphPosX + i / scaleFactorX, horizontal_line_y - std::max<int16_t>(0, _graphValues[i] / scaleFactorY - 0.5));
+            graphPosX + (i - 1) / scaleFactorX, horizontal_line_y - std::max<int16_t>(0, previous.Avg / scaleFactorY - 0.5),
+            graphPosX + i / scaleFactorX, horizontal_line_y - std::max<int16_t>(0, current.Avg / scaleFactorY - 0.5));
     }
 }
+
+#endif // OPENDTU_WITHOUT_DISPLAY
@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "DnsCache.h"
+#include "Configuration.h"
+#include "NetworkSettings.h"
+#include "TaskMonitor.h"
+#include <ESPmDNS.h>
+#include <WiFiGeneric.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+#include <vector>
+
+DnsCacheClass DnsCache;
+
+namespace {
+
+bool parseAddress(String const& host, IPAddress& address)
+{
+    IPAddress literal;
+    if (!literal.fromString(host)) { return false; }
+    address = literal;
+    return true;
+}
+
+struct Query {
+    String Host;
+};
+
+void onDnsFound(char const*, ip_addr_t const* ipaddr, void* arg)
+{
+    auto pQuery = static_cast<Query*>(arg);
+    bool success = ipaddr != nullptr && IP_IS_V4(ipaddr);
+    IPAddress address(success ? ip4_addr_get_u32(ip_2_ip4(ipaddr)) : static_cast<uint32_t>(INADDR_NONE));
+    DnsCache.onQueryResult(pQuery->Host, address, success);
+    delete pQuery;
+}
+
+// executed by the tcpip thread, as required by the lwIP resolver
+void runQuery(void* arg)
+{
+    auto pQuery = static_cast<Query*>(arg);
+    ip_addr_t ipaddr;
+    err_t err = dns_gethostbyname_addrtype(pQuery->Host.c_str(), &ipaddr,
+            &onDnsFound, pQuery, LWIP_DNS_ADDRTYPE_IPV4);
+    if (err == ERR_INPROGRESS) { return; } // onDnsFound() is called later
+
+    onDnsFound(pQuery->Host.c_str(), err == ERR_OK ? &ipaddr : nullptr, pQuery);
+}
+
+}; // namespace
+
+DnsCacheClass::DnsCacheClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("DnsCache::loop", std::bind(&DnsCacheClass::loop, this)))
+{
+}
+
+void DnsCacheClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+bool DnsCacheClass::lookup(String const& host, IPAddress& address)
+{
+    if (parseAddress(host, address)) { return true; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto pEntry = getEntry(host, millis());
+    if (pEntry == nullptr || pEntry->Address == INADDR_NONE) { return false; }
+
+    address = pEntry->Address;
+    return true;
+}
+
+bool DnsCacheClass::resolve(String const& host, IPAddress& address)
+{
+    if (parseAddress(host, address)) { return true; }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint32_t now = millis();
+        auto pEntry = getEntry(host, now);
+        if (pEntry != nullptr) {
+            // mDNS answers are not refreshed in the background, as the
+            // queries block, so they are refreshed by the client instead.
+            bool due = pEntry->Src == Source::Mdns && isRefreshDue(*pEntry, now);
+            if (pEntry->Address != INADDR_NONE && !due) {
+                address = pEntry->Address;
+                return true;
+            }
+
+            if (pEntry->Unresolvable && !isRefreshDue(*pEntry, now)) {
+                return false;
+            }
+        }
+    }
+
+    // try locally via mDNS first, then via DNS. WiFiGeneric::hostByName()
+    // will spam the console if done the other way around.
+    Source source = Source::Dns;
+    IPAddress resolved = INADDR_NONE;
+    if (Configuration.get().Mdns.Enabled) {
+        resolved = MDNS.queryHost(host); // INADDR_NONE if failed
+        if (resolved != INADDR_NONE) { source = Source::Mdns; }
+    }
+
+    bool success = resolved != INADDR_NONE
+        || (WiFiGenericClass::hostByName(host.c_str(), resolved) && resolved != INADDR_NONE);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto pEntry = getEntry(host, millis());
+    if (pEntry != nullptr) {
+        store(*pEntry, source, resolved, success);
+        pEntry->Unresolvable = !success;
+    }
+
+    if (success) {
+        address = resolved;
+        return true;
+    }
+
+    // a failed refresh of an mDNS answer keeps the previous address
+    if (pEntry != nullptr && pEntry->Address != INADDR_NONE) {
+        address = pEntry->Address;
+        return true;
+    }
+
+    return false;
+}
+
+void DnsCacheClass::onQueryResult(String const& host, IPAddress const& address, bool success)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(host);
+    if (it == _entries.end()) { return; }
+
+    auto& entry = it->second;
+    entry.Pending = false;
+    store(entry, Source::Dns, address, success);
+
+    // the name might still be resolved via mDNS by resolve()
+    if (!success && !Configuration.get().Mdns.Enabled) { entry.Unresolvable = true; }
+}
+
+void DnsCacheClass::loop()
+{
+    if (!NetworkSettings.isConnected()) { return; }
+
+    std::vector<String> hosts;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint32_t now = millis();
+        for (auto it = _entries.begin(); it != _entries.end(); ) {
+            auto& entry = it->second;
+            if (!entry.Pending && now - entry.LastUsedMillis > _unusedMillis) {
+                it = _entries.erase(it);
+                continue;
+            }
+
+            if (!entry.Pending && entry.Src == Source::Dns && isRefreshDue(entry, now)) {
+                entry.Pending = true;
+                hosts.push_back(it->first);
+            }
+
+            ++it;
+        }
+    }
+
+    for (auto const& host : hosts) {
+        auto pQuery = new Query { host };
+        if (tcpip_callback(&runQuery, pQuery) == ERR_OK) { continue; }
+
+        delete pQuery;
+        onQueryResult(host, INADDR_NONE, false);
+    }
+}
+
+DnsCacheClass::Entry* DnsCacheClass::getEntry(String const& host, uint32_t now)
+{
+    auto it = _entries.find(host);
+
+    if (it == _entries.end() && _entries.size() >= _maxEntries) {
+        // make room by forgetting the least recently used name
+        auto lru = _entries.end();
+        for (auto candidate = _entries.begin(); candidate != _entries.end(); ++candidate) {
+            if (candidate->second.Pending) { continue; }
+            if (lru == _entries.end() || now - candidate->second.LastUsedMillis > now - lru->second.LastUsedMillis) {
+                lru = candidate;
+            }
+        }
+        if (lru == _entries.end()) { return nullptr; }
+        _entries.erase(lru);
+    }
+
+    if (it == _entries.end()) {
+        it = _entries.emplace(host, Entry()).first;
+    }
+
+    it->second.LastUsedMillis = now;
+    return &it->second;
+}
+
+bool DnsCacheClass::isRefreshDue(Entry const& entry, uint32_t now) const
+{
+    if (!entry.Checked) { return true; }
+    return now - entry.CheckedMillis >= (entry.Failed ? _negativeTtlMillis : _refreshMillis);
+}
+
+void DnsCacheClass::store(Entry& entry, Source source, IPAddress const& address, bool success)
+{
+    entry.Checked = true;
+    entry.CheckedMillis = millis();
+    entry.Failed = !success;
+    if (!success) { return; }
+
+    entry.Unresolvable = false;
+    entry.Address = address;
+    entry.Src = source;
+}
@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#ifdef OPENDTU_DPL_SIMULATION
+
+#include "DplSimulation.h"
+#include "Configuration.h"
+#include "Logging.h"
+#include "MessageOutput.h"
+#include "PowerLimiter.h"
+#include "TaskMonitor.h"
+#include <LittleFS.h>
+#include <cmath>
+#include <limits>
+
+DplSimulationClass DplSimulation;
+
+static constexpr char const* recordingFilename = "/dplsim.csv";
+
+// after this long without any command, the DPL is considered to have settled
+// on a value outside of the hysteresis, e.g., because of the inverter limits.
+static constexpr uint32_t quietPeriodMs = 15 * 1000;
+
+static bool isDue(uint32_t now, uint32_t due)
+{
+    return (now - due) < std::numeric_limits<uint32_t>::max() / 2;
+}
+
+DplSimulationInverter::DplSimulationInverter(const uint64_t serial)
+    : HM_2CH(Hoymiles.getRadioNrf(), serial)
+{
+    // hardware part number of a HM-800-2T, such that the max power is known
+    uint8_t devInfo[14] = { 0x00, 0x00, 0x10, 0x11, 0x40, 0x00, 0x01, 0x00 };
+    DevInfo()->beginAppendFragment();
+    DevInfo()->clearBufferSimple();
+    DevInfo()->appendFragmentSimple(0, devInfo, sizeof(devInfo));
+    DevInfo()->endAppendFragment();
+    DevInfo()->setLastUpdateSimple(millis());
+
+    SystemConfigPara()->setLimitPercent(_limitPercent);
+    SystemConfigPara()->setLastLimitCommandSuccess(CMD_OK);
+    PowerCommand()->setLastPowerCommandSuccess(CMD_OK);
+
+    _outputAcWatts = _maxPowerWatts;
+}
+
+bool DplSimulationInverter::sendActivePowerControlRequest(float limit, const PowerLimitControlType type)
+{
+    if (type == AbsolutNonPersistent || type == AbsolutPersistent) {
+        limit = limit * 100 / _maxPowerWatts;
+    }
+
+    _pendingLimitPercent = std::min(limit, 100.0f);
+    _limitDue = millis() + _commandLatencyMs;
+    _limitPending = true;
+    ++_limitCommands;
+
+    SystemConfigPara()->setLastLimitCommandSuccess(CMD_PENDING);
+    return true;
+}
+
+bool DplSimulationInverter::sendPowerControlRequest(const bool turnOn)
+{
+    _pendingProducing = turnOn;
+    _powerDue = millis() + _commandLatencyMs;
+    _powerPending = true;
+    ++_powerCommands;
+
+    PowerCommand()->setLastPowerCommandSuccess(CMD_PENDING);
+    return true;
+}
+
+bool DplSimulationInverter::sendRestartControlRequest()
+{
+    return sendPowerControlRequest(true);
+}
+
+void DplSimulationInverter::update(uint32_t now, float dcVoltage)
+{
+    if (_limitPending && isDue(now, _limitDue)) {
+        _limitPending = false;
+        _limitPercent = _pendingLimitPercent;
+
+        auto sent = _limitDue - _commandLatencyMs;
+        SystemConfigPara()->setLimitPercent(_limitPercent);
+        SystemConfigPara()->setLastLimitCommandTimings({ sent, sent, now });
+        SystemConfigPara()->setLastUpdateCommand(now);
+        SystemConfigPara()->setLastLimitCommandSuccess(CMD_OK);
+    }
+
+    if (_powerPending && isDue(now, _powerDue)) {
+        _powerPending = false;
+        _producing = _pendingProducing;
+
+        PowerCommand()->setLastUpdateCommand(now);
+        PowerCommand()->setLastPowerCommandSuccess(CMD_OK);
+    }
+
+    _outputAcWatts = _producing ? _limitPercent * _maxPowerWatts / 100 : 0;
+
+    if (_lastStats == 0 || (now - _lastStats) >= _statsIntervalMs) {
+        publishStats(now, dcVoltage);
+    }
+}
+
+void DplSimulationInverter::publishStats(uint32_t now, float dcVoltage)
+{
+    auto pStats = Statistics();
+    float const dcPower = _outputAcWatts / 0.965f / 2;
+
+    pStats->setChannelFieldValue(TYPE_AC, CH0, FLD_PAC, _outputAcWatts);
+    pStats->setChannelFieldValue(TYPE_AC, CH0, FLD_UAC, 230);
+    pStats->setChannelFieldValue(TYPE_AC, CH0, FLD_IAC, _outputAcWatts / 230);
+    pStats->setChannelFieldValue(TYPE_AC, CH0, FLD_F, 50);
+
+    for (auto channel : { CH0, CH1 }) {
+        pStats->setChannelFieldValue(TYPE_DC, channel, FLD_UDC, dcVoltage);
+        pStats->setChannelFieldValue(TYPE_DC, channel, FLD_PDC, dcPower);
+        pStats->setChannelFieldValue(TYPE_DC, channel, FLD_IDC, dcVoltage > 0 ? dcPower / dcVoltage : 0);
+    }
+
+    pStats->resetRxFailureCount();
+    pStats->setLastUpdate(now);
+    _lastStats = now;
+}
+
+void DplSimulationClass::init(Scheduler& scheduler)
+{
+    if (!loadRecording()) { return; }
+
+    auto const& config = Configuration.get().PowerLimiter;
+
+    for (size_t i = 0; i < INV_MAX_COUNT; ++i) {
+        auto const& invConfig = config.Inverters[i];
+        if (invConfig.Serial == 0ULL || !invConfig.IsGoverned) { continue; }
+
+        String name = "Simulated";
+        auto spOriginal = Hoymiles.getInverterBySerial(invConfig.Serial);
+        if (spOriginal) {
+            name = spOriginal->name();
+            Hoymiles.removeInverterBySerial(invConfig.Serial);
+        }
+
+        auto spInverter = std::make_shared<DplSimulationInverter>(invConfig.Serial);
+        Hoymiles.addInverter(name.c_str(), spInverter);
+        _inverters.push_back(spInverter);
+        _behindPowerMeter.push_back(invConfig.IsBehindPowerMeter);
+    }
+
+    if (_inverters.empty()) {
+        DTU_LOGE("DplSim", "no governed inverters to simulate");
+        return;
+    }
+
+    DTU_LOGI("DplSim", "replaying %u samples to %u simulated inverters",
+            _samples.size(), _inverters.size());
+
+    // the DPL must use the simulated inverters
+    PowerLimiter.triggerReloadingConfig();
+
+    startPass();
+
+    scheduler.addTask(_loopTask);
+    _loopTask.setCallback(TaskMonitor.wrap("DplSimulation::loop", std::bind(&DplSimulationClass::loop, this)));
+    _loopTask.setIterations(TASK_FOREVER);
+    _loopTask.setInterval(100 * TASK_MILLISECOND);
+    _loopTask.enable();
+}
+
+bool DplSimulationClass::loadRecording()
+{
+    File f = LittleFS.open(recordingFilename, "r", false);
+    if (!f) {
+        DTU_LOGE("DplSim", "cannot open %s", recordingFilename);
+        return false;
+    }
+
+    char line[64];
+    while (f.available() && _samples.size() < _maxSamples) {
+        size_t len = f.readBytesUntil('\n', line, sizeof(line) - 1);
+        line[len] = '\0';
+        if (line[0] == '#') { continue; }
+
+        float seconds = 0;
+        int consumption = 0;
+        float dcVoltage = 0;
+        if (sscanf(line, "%f,%d,%f", &seconds, &consumption, &dcVoltage) < 2) { continue; }
+
+        uint32_t sampleMillis = static_cast<uint32_t>(seconds * 1000);
+        if (!_samples.empty() && sampleMillis < _samples.back().Millis) { continue; }
+
+        _samples.push_back({ sampleMillis, static_cast<int16_t>(consumption), dcVoltage });
+    }
+
+    f.close();
+
+    if (_samples.size() < 2) {
+        DTU_LOGE("DplSim", "%s contains less than two samples", recordingFilename);
+        return false;
+    }
+
+    return true;
+}
+
+void DplSimulationClass::startPass()
+{
+    ++_pass;
+    _passStart = _lastLoop = millis();
+    _sampleIdx = 0;
+
+    _importWh = _exportWh = 0;
+    _steps = _settledSteps = 0;
+    _settlingSumMs = _settlingMaxMs = 0;
+    _settling = false;
+    _lastCommands = 0;
+    _lastCommandMillis = _passStart;
+
+    for (auto& spInverter : _inverters) { spInverter->resetCommandCounters(); }
+}
+
+bool DplSimulationClass::getMeterReading(float& watts)
+{
+    std::lock_guard<std::mutex> lock(_meterMutex);
+    if (!_meterUpdated) { return false; }
+    watts = _meterWatts;
+    _meterUpdated = false;
+    return true;
+}
+
+void DplSimulationClass::loop()
+{
+    uint32_t now = millis();
+    uint32_t elapsed = now - _passStart;
+
+    if (elapsed > _samples.back().Millis) {
+        report();
+        startPass();
+        return;
+    }
+
+    size_t previousIdx = _sampleIdx;
+    while (_sampleIdx + 1 < _samples.size() && _samples[_sampleIdx + 1].Millis <= elapsed) {
+        ++_sampleIdx;
+    }
+    auto const& sample = _samples[_sampleIdx];
+
+    auto const& config = Configuration.get().PowerLimiter;
+    float const hysteresis = std::max<float>(config.TargetPowerConsumptionHysteresis, 10);
+
+    if (_sampleIdx != previousIdx &&
+            std::abs(sample.ConsumptionWatts - _samples[previousIdx].ConsumptionWatts) > 2 * hysteresis) {
+        ++_steps;
+        _settling = true;
+        _settlingStart = now;
+    }
+
+    float grid = sample.ConsumptionWatts;
+    uint32_t commands = 0;
+    for (size_t i = 0; i < _inverters.size(); ++i) {
+        _inverters[i]->update(now, sample.DcVoltage);
+        if (_behindPowerMeter[i]) { grid -= _inverters[i]->getOutputAcWatts(); }
+        commands += _inverters[i]->getLimitCommands() + _inverters[i]->getPowerCommands();
+    }
+
+    float hours = static_cast<float>(now - _lastLoop) / (3600 * 1000);
+    if (grid > 0) { _importWh += grid * hours; }
+    else { _exportWh -= grid * hours; }
+    _lastLoop = now;
+
+    if (commands != _lastCommands) {
+        _lastCommands = commands;
+        _lastCommandMillis = now;
+    }
+
+    if ((now - _lastMeterReading) < _meterIntervalMs) { return; }
+    _lastMeterReading = now;
+
+    {
+        std::lock_guard<std::mutex> lock(_meterMutex);
+        _meterWatts = grid;
+        _meterUpdated = true;
+    }
+
+    if (!_settling) { return; }
+
+    uint32_t settledAt = now;
+    if (std::abs(grid - config.TargetPowerConsumption) > hysteresis) {
+        if ((now - _lastCommandMillis) <= quietPeriodMs || (now - _settlingStart) <= quietPeriodMs) { return; }
+        settledAt = isDue(_lastCommandMillis, _settlingStart) ? _lastCommandMillis : _settlingStart;
+    }
+
+    uint32_t duration = settledAt - _settlingStart;
+    ++_settledSteps;
+    _settlingSumMs += duration;
+    _settlingMaxMs = std::max(_settlingMaxMs, duration);
+    _settling = false;
+}
+
+void DplSimulationClass::report()
+{
+    auto const& config = Configuration.get().PowerLimiter;
+
+    uint32_t limitCommands = 0;
+    uint32_t powerCommands = 0;
+    for (auto const& spInverter : _inverters) {
+        limitCommands += spInverter->getLimitCommands();
+        powerCommands += spInverter->getPowerCommands();
+    }
+
+    MessageOutput.printf("{\"dplsim\":%u,\"duration_s\":%u,"
+            "\"target_w\":%d,\"hysteresis_w\":%u,\"base_load_w\":%u,\"predictive\":%s,"
+            "\"import_wh\":%.1f,\"export_wh\":%.1f,"
+            "\"limit_commands\":%u,\"power_commands\":%u,"
+            "\"steps\":%u,\"settled\":%u,\"settling_avg_ms\":%u,\"settling_max_ms\":%u}\r\n",
+            _pass, (millis() - _passStart) / 1000,
+            config.TargetPowerConsumption, config.TargetPowerConsumptionHysteresis,
+            config.BaseLoadLimit, (config.PredictiveMode ? "true" : "false"),
+            _importWh, _exportWh, limitCommands, powerCommands,
+            _steps, _settledSteps, (_settledSteps > 0 ? _settlingSumMs / _settledSteps : 0),
+            _settlingMaxMs);
+}
+
+#endif
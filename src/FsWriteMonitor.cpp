@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "FsWriteMonitor.h"
+#include <Arduino.h>
+#include <algorithm>
+
+FsWriteMonitorClass FsWriteMonitor;
+
+namespace {
+
+constexpr char const* categoryNames[] = {
+    "config", "language_pack", "upload", "timeseries", "yield_checkpoint", "data_cache"
+};
+static_assert(sizeof(categoryNames) / sizeof(categoryNames[0]) == static_cast<size_t>(FsWriteMonitorClass::Category::Count));
+
+}; // namespace
+
+bool FsWriteMonitorClass::isDeferrable(Category category)
+{
+    switch (category) {
+        case Category::TimeSeries:
+        case Category::YieldCheckpoint:
+        case Category::DataCache:
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+// must be called with _mutex held
+void FsWriteMonitorClass::refill()
+{
+    uint32_t now = millis();
+    uint32_t elapsed = now - _lastRefillMillis;
+    int32_t tokens = static_cast<int64_t>(elapsed) * _budgetPerMinute / (60 * 1000);
+    if (tokens == 0) { return; }
+
+    _budget = std::min(_budgetCapacity, _budget + tokens);
+    _lastRefillMillis = now;
+}
+
+bool FsWriteMonitorClass::admit(Category category, size_t bytes)
+{
+    if (!isDeferrable(category)) { return true; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    refill();
+
+    if (_budget >= static_cast<int32_t>(bytes)) { return true; }
+
+    ++_counters[static_cast<size_t>(category)].Deferred;
+    return false;
+}
+
+void FsWriteMonitorClass::record(Category category, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    refill();
+
+    auto& counters = _counters[static_cast<size_t>(category)];
+    ++counters.Ops;
+    counters.Bytes += bytes;
+    counters.Erases += std::max<size_t>(1, (bytes + _blockSize - 1) / _blockSize);
+
+    // critical writes may overdraw the budget, which then defers the
+    // deferrable ones for longer.
+    _budget = std::max(-_budgetCapacity, _budget - static_cast<int32_t>(bytes));
+}
+
+void FsWriteMonitorClass::serialize(JsonObject& target) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    target["budget"] = _budget;
+    target["budget_capacity"] = _budgetCapacity;
+
+    JsonArray categories = target["categories"].to<JsonArray>();
+    for (size_t i = 0; i < _counters.size(); ++i) {
+        auto const& counters = _counters[i];
+        JsonObject category = categories.add<JsonObject>();
+        category["name"] = categoryNames[i];
+        category["ops"] = counters.Ops;
+        category["bytes"] = counters.Bytes;
+        category["erases"] = counters.Erases;
+        category["deferred"] = counters.Deferred;
+    }
+}
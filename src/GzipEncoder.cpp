@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "GzipEncoder.h"
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint16_t sLengthBase[] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static constexpr uint8_t sLengthExtra[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static constexpr uint16_t sDistanceBase[] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+static constexpr uint8_t sDistanceExtra[] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static uint32_t updateCrc(uint32_t crc, uint8_t const* data, size_t len)
+{
+    static constexpr uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    for (size_t i = 0; i < len; ++i) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+
+    return crc;
+}
+
+GzipEncoder::GzipEncoder()
+{
+    _head.fill(0);
+    _prev.fill(0);
+}
+
+void GzipEncoder::putBits(uint32_t value, uint8_t count, std::vector<uint8_t>& out)
+{
+    _bitBuffer |= value << _bitCount;
+    _bitCount += count;
+
+    while (_bitCount >= 8) {
+        out.push_back(_bitBuffer & 0xFF);
+        _bitBuffer >>= 8;
+        _bitCount -= 8;
+    }
+}
+
+// huffman codes are stored starting with their most significant bit
+void GzipEncoder::putHuffman(uint16_t code, uint8_t length, std::vector<uint8_t>& out)
+{
+    uint16_t reversed = 0;
+    for (uint8_t i = 0; i < length; ++i) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    putBits(reversed, length, out);
+}
+
+// the fixed literal/length code of RFC 1951, section 3.2.6
+void GzipEncoder::putLiteral(uint16_t symbol, std::vector<uint8_t>& out)
+{
+    if (symbol < 144) { return putHuffman(0x30 + symbol, 8, out); }
+    if (symbol < 256) { return putHuffman(0x190 + (symbol - 144), 9, out); }
+    if (symbol < 280) { return putHuffman(symbol - 256, 7, out); }
+    putHuffman(0xC0 + (symbol - 280), 8, out);
+}
+
+void GzipEncoder::putMatch(size_t length, size_t distance, std::vector<uint8_t>& out)
+{
+    size_t code = sizeof(sLengthBase) / sizeof(sLengthBase[0]) - 1;
+    while (sLengthBase[code] > length) { --code; }
+    putLiteral(257 + code, out);
+    putBits(length - sLengthBase[code], sLengthExtra[code], out);
+
+    code = sizeof(sDistanceBase) / sizeof(sDistanceBase[0]) - 1;
+    while (sDistanceBase[code] > distance) { --code; }
+    putHuffman(code, 5, out);
+    putBits(distance - sDistanceBase[code], sDistanceExtra[code], out);
+}
+
+void GzipEncoder::insertHash(size_t pos)
+{
+    uint32_t key = (_buffer[pos] << 16) | (_buffer[pos + 1] << 8) | _buffer[pos + 2];
+    uint16_t hash = (key * 2654435761u) >> (32 - _hashBits);
+    _prev[pos] = _head[hash];
+    _head[hash] = pos + 1;
+}
+
+size_t GzipEncoder::findMatch(size_t pos, size_t available, size_t& distance) const
+{
+    uint32_t key = (_buffer[pos] << 16) | (_buffer[pos + 1] << 8) | _buffer[pos + 2];
+    uint16_t hash = (key * 2654435761u) >> (32 - _hashBits);
+
+    size_t maxLength = std::min(available, _maxMatch);
+    size_t best = 0;
+
+    uint16_t candidate = _head[hash];
+    for (size_t chain = 0; candidate != 0 && chain < _maxChain; ++chain) {
+        size_t match = candidate - 1;
+        if (pos - match > _windowSize) { break; }
+
+        size_t length = 0;
+        while (length < maxLength && _buffer[match + length] == _buffer[pos + length]) {
+            ++length;
+        }
+
+        if (length > best) {
+            best = length;
+            distance = pos - match;
+            if (best == maxLength) { break; }
+        }
+
+        candidate = _prev[match];
+    }
+
+    return best;
+}
+
+// drops the older half of the buffer, which is outside the window by now
+void GzipEncoder::slide()
+{
+    memmove(_buffer.data(), _buffer.data() + _windowSize, _windowSize);
+    _pos -= _windowSize;
+    _end -= _windowSize;
+
+    auto shift = [](uint16_t v) -> uint16_t { return v > _windowSize ? v - _windowSize : 0; };
+
+    for (auto& head : _head) { head = shift(head); }
+    for (size_t i = 0; i < _windowSize; ++i) { _prev[i] = shift(_prev[i + _windowSize]); }
+    std::fill(_prev.begin() + _windowSize, _prev.end(), 0);
+}
+
+void GzipEncoder::compress(bool flush, std::vector<uint8_t>& out)
+{
+    while (_pos < _end) {
+        size_t available = _end - _pos;
+
+        // matches must be able to use the maximum length
+        if (!flush && available < _maxMatch) { return; }
+
+        size_t length = 0;
+        size_t distance = 0;
+        if (available >= _minMatch) {
+            length = findMatch(_pos, available, distance);
+        }
+
+        if (length < _minMatch) {
+            putLiteral(_buffer[_pos], out);
+            length = 1;
+        } else {
+            putMatch(length, distance, out);
+        }
+
+        for (size_t i = 0; i < length; ++i, ++_pos) {
+            if (_pos + _minMatch <= _end) { insertHash(_pos); }
+        }
+    }
+}
+
+void GzipEncoder::write(uint8_t const* data, size_t len, std::vector<uint8_t>& out)
+{
+    if (!_headerWritten) {
+        // magic, deflate, no flags, no time, no extra flags, unknown OS
+        static constexpr uint8_t header[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+        out.insert(out.end(), header, header + sizeof(header));
+
+        // a non-final block using the fixed codes, which is never closed
+        // before the end of the stream
+        putBits(0, 1, out);
+        putBits(1, 2, out);
+
+        _headerWritten = true;
+    }
+
+    _crc = updateCrc(_crc, data, len);
+    _size += len;
+
+    while (len > 0) {
+        if (_end == _buffer.size()) {
+            compress(false, out);
+            slide();
+        }
+
+        size_t chunk = std::min(len, _buffer.size() - _end);
+        memcpy(_buffer.data() + _end, data, chunk);
+        _end += chunk;
+        data += chunk;
+        len -= chunk;
+
+        compress(false, out);
+    }
+}
+
+void GzipEncoder::finish(std::vector<uint8_t>& out)
+{
+    write(nullptr, 0, out);
+    compress(true, out);
+    putLiteral(256, out); // end of block
+
+    // an empty final block, as the previous one was not marked final
+    putBits(1, 1, out);
+    putBits(1, 2, out);
+    putLiteral(256, out);
+
+    if (_bitCount > 0) { putBits(0, 8 - _bitCount, out); }
+
+    uint32_t crc = _crc ^ 0xFFFFFFFF;
+    for (uint8_t i = 0; i < 4; ++i) { out.push_back((crc >> (8 * i)) & 0xFF); }
+    for (uint8_t i = 0; i < 4; ++i) { out.push_back((_size >> (8 * i)) & 0xFF); }
+}
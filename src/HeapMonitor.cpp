@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "HeapMonitor.h"
+#include "MessageOutput.h"
+#include "TaskMonitor.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#ifdef HEAP_CALLSITE_TRACING
+#include <esp_heap_trace.h>
+#ifndef CONFIG_HEAP_TRACING_STANDALONE
+#error "HEAP_CALLSITE_TRACING requires CONFIG_HEAP_TRACING_STANDALONE"
+#endif
+
+// kept in static storage, as the tracing is meant to run until restart
+static constexpr size_t sHeapTraceRecords = 200;
+static heap_trace_record_t sHeapTraceBuffer[sHeapTraceRecords];
+#endif
+
+HeapMonitorClass HeapMonitor;
+
+void HeapMonitorClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.setCallback(TaskMonitor.wrap("HeapMonitor::loop", std::bind(&HeapMonitorClass::loop, this)));
+    _loopTask.setIterations(TASK_FOREVER);
+    _loopTask.setInterval(SamplingIntervalMillis * TASK_MILLISECOND);
+    _loopTask.enable();
+
+#ifdef HEAP_CALLSITE_TRACING
+    if (heap_trace_init_standalone(sHeapTraceBuffer, sHeapTraceRecords) != ESP_OK ||
+            heap_trace_start(HEAP_TRACE_LEAKS) != ESP_OK) {
+        MessageOutput.print("[HeapMonitor] failed to start heap tracing\r\n");
+    }
+#endif
+}
+
+uint8_t HeapMonitorClass::getFragmentation()
+{
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap == 0) { return 0; }
+    return 100 - static_cast<uint8_t>((100ULL * ESP.getMaxAllocHeap()) / freeHeap);
+}
+
+void HeapMonitorClass::loop()
+{
+    Sample sample = { ESP.getFreeHeap(), ESP.getMaxAllocHeap() };
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _recent.add(sample);
+
+    _currentHour.FreeHeap = std::min(_currentHour.FreeHeap, sample.FreeHeap);
+    _currentHour.MaxAllocHeap = std::min(_currentHour.MaxAllocHeap, sample.MaxAllocHeap);
+    if (++_samplesInCurrentHour >= _samplesPerHour) {
+        _hourly.add(_currentHour);
+        _currentHour = { UINT32_MAX, UINT32_MAX };
+        _samplesInCurrentHour = 0;
+    }
+
+#ifdef HEAP_CALLSITE_TRACING
+    collectCallSites();
+#endif
+}
+
+void HeapMonitorClass::recordAllocFailure(char const* function, uint16_t line)
+{
+    uint32_t uptime = esp_timer_get_time() / 1000000;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (size_t i = 0; i < _allocFailureSites; ++i) {
+        auto& failure = _allocFailures[i];
+        if (failure.Function != function || failure.Line != line) { continue; }
+        ++failure.Count;
+        failure.LastUptime = uptime;
+        return;
+    }
+
+    if (_allocFailureSites >= _maxAllocFailureSites) { return; }
+
+    _allocFailures[_allocFailureSites++] = { function, line, 1, uptime };
+}
+
+#ifdef HEAP_CALLSITE_TRACING
+void HeapMonitorClass::collectCallSites()
+{
+    // NOTE: the mutex is locked by the caller
+
+    // the records describe allocations made since the tracing was (re-)started
+    // which were not yet freed. we aggregate them and restart the tracing,
+    // such that the record buffer does not fill up with long-lived objects.
+    heap_trace_stop();
+
+    size_t count = heap_trace_get_count();
+    for (size_t i = 0; i < count; ++i) {
+        heap_trace_record_t record;
+        if (heap_trace_get(i, &record) != ESP_OK) { continue; }
+
+        std::array<void*, _callStackDepth> stack = {};
+        size_t depth = std::min<size_t>(_callStackDepth, CONFIG_HEAP_TRACING_STACK_DEPTH);
+        std::copy_n(record.alloced_by, depth, stack.begin());
+
+        auto end = _callSites.begin() + _callSiteCount;
+        auto it = std::find_if(_callSites.begin(), end,
+                [&stack](CallSite const& site) { return site.Stack == stack; });
+
+        if (it == end) {
+            if (_callSiteCount < _maxCallSites) {
+                it = _callSites.begin() + _callSiteCount++;
+            } else {
+                // replace the least significant call site
+                it = std::min_element(_callSites.begin(), end,
+                        [](CallSite const& a, CallSite const& b) { return a.Bytes < b.Bytes; });
+            }
+            *it = { stack, 0, 0 };
+        }
+
+        ++it->Allocations;
+        it->Bytes += record.size;
+    }
+
+    heap_trace_start(HEAP_TRACE_LEAKS);
+}
+#endif
+
+template<size_t N>
+void HeapMonitorClass::History<N>::serialize(JsonArray target) const
+{
+    size_t first = (Size < N) ? 0 : Next;
+    for (size_t i = 0; i < Size; ++i) {
+        auto const& sample = Samples[(first + i) % N];
+        JsonArray entry = target.add<JsonArray>();
+        entry.add(sample.FreeHeap);
+        entry.add(sample.MaxAllocHeap);
+    }
+}
+
+void HeapMonitorClass::serialize(JsonObject& target) const
+{
+    target["free"] = ESP.getFreeHeap();
+    target["max_alloc"] = ESP.getMaxAllocHeap();
+    target["min_free"] = ESP.getMinFreeHeap();
+    target["fragmentation"] = getFragmentation();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // samples are [free, max_alloc] pairs, oldest first
+    target["recent_interval_s"] = SamplingIntervalMillis / 1000;
+    _recent.serialize(target["recent"].to<JsonArray>());
+    target["hourly_interval_s"] = SamplingIntervalMillis / 1000 * _samplesPerHour;
+    _hourly.serialize(target["hourly"].to<JsonArray>());
+
+    JsonArray failures = target["alloc_failures"].to<JsonArray>();
+    for (size_t i = 0; i < _allocFailureSites; ++i) {
+        auto const& failure = _allocFailures[i];
+        JsonObject obj = failures.add<JsonObject>();
+        obj["function"] = failure.Function;
+        obj["line"] = failure.Line;
+        obj["count"] = failure.Count;
+        obj["last_uptime"] = failure.LastUptime;
+    }
+
+#ifdef HEAP_CALLSITE_TRACING
+    std::array<CallSite const*, _maxCallSites> sorted;
+    for (size_t i = 0; i < _callSiteCount; ++i) { sorted[i] = &_callSites[i]; }
+    std::sort(sorted.begin(), sorted.begin() + _callSiteCount,
+            [](CallSite const* a, CallSite const* b) { return a->Bytes > b->Bytes; });
+
+    JsonArray callSites = target["call_sites"].to<JsonArray>();
+    for (size_t i = 0; i < _callSiteCount; ++i) {
+        auto const& site = *sorted[i];
+        JsonObject obj = callSites.add<JsonObject>();
+        obj["allocations"] = site.Allocations;
+        obj["bytes"] = site.Bytes;
+        JsonArray stack = obj["stack"].to<JsonArray>();
+        for (void* address : site.Stack) {
+            if (address == nullptr) { break; }
+            char buf[11];
+            snprintf(buf, sizeof(buf), "0x%08" PRIx32, reinterpret_cast<uint32_t>(address));
+            stack.add(buf);
+        }
+    }
+#endif
+}
@@ -1,10 +1,56 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include "HttpGetter.h"
+#include "DnsCache.h"
+#include "NetworkSettings.h"
+#include "TlsMonitor.h"
 #include <WiFiClientSecure.h>
 #include "mbedtls/sha256.h"
 #include "mbedtls/md5.h"
+#include <StreamString.h>
 #include <base64.h>
-#include <ESPmDNS.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+
+static std::atomic<uint32_t> sNetworkGeneration { 0 };
+
+void HttpGetter::invalidateConnections()
+{
+    ++sNetworkGeneration;
+}
+
+// limits reading the response to its content length, such that the
+// connection can be used for the next request afterwards.
+class HttpBodyStream : public Stream {
+public:
+    HttpBodyStream(Stream& source, int size)
+        : _source(source)
+        , _remaining(size) { }
+
+    int available() final {
+        int available = _source.available();
+        if (_remaining < 0) { return available; }
+        return std::min(available, _remaining);
+    }
+
+    int read() final {
+        if (_remaining == 0) { return -1; }
+        int c = _source.read();
+        if (c >= 0 && _remaining > 0) { --_remaining; }
+        return c;
+    }
+
+    int peek() final {
+        if (_remaining == 0) { return -1; }
+        return _source.peek();
+    }
+
+    size_t write(uint8_t) final { return 0; }
+
+private:
+    Stream& _source;
+    int _remaining; // negative if the content length is unknown
+};
 
 template<typename... Args>
 void HttpGetter::logError(char const* format, Args... args) {
@@ -65,64 +111,163 @@ bool HttpGetter::init()
         _host = _host.substring(0, index); // up until colon
     }
 
-    if (_useHttps) {
+    _spConnection = getConnection(_useHttps, _host, _port);
+
+    return true;
+}
+
+sp_http_connection_t HttpGetter::getConnection(bool useHttps, String const& host, uint16_t port)
+{
+    static std::mutex sMutex;
+    static std::map<String, std::weak_ptr<HttpConnection>> sConnections;
+
+    String key = String(useHttps ? "https://" : "http://") + host + ":" + String(port);
+
+    std::lock_guard<std::mutex> lock(sMutex);
+
+    static bool sSubscribed = false;
+    if (!sSubscribed) {
+        NetworkSettings.onEvent([](network_event) { invalidateConnections(); },
+                network_event::NETWORK_INTERFACE_CHANGED);
+        sSubscribed = true;
+    }
+
+    auto spConnection = sConnections[key].lock();
+    if (spConnection) { return spConnection; }
+
+    spConnection = std::make_shared<HttpConnection>();
+
+    if (useHttps) {
         auto secureWifiClient = std::make_shared<WiFiClientSecure>();
         secureWifiClient->setInsecure();
-        _spWiFiClient = std::move(secureWifiClient);
+        spConnection->spWiFiClient = std::move(secureWifiClient);
     } else {
-        _spWiFiClient = std::make_shared<WiFiClient>();
+        spConnection->spWiFiClient = std::make_shared<WiFiClient>();
     }
 
-    return true;
+    sConnections[key] = spConnection;
+
+    // forget about connections which are no longer used by any getter
+    for (auto it = sConnections.begin(); it != sConnections.end(); ) {
+        if (it->second.expired()) {
+            it = sConnections.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return spConnection;
 }
 
-HttpRequestResult HttpGetter::performGetRequest()
+// must be called with the connection's mutex held
+void HttpGetter::closeIfStale()
+{
+    // a connection opened via the previous network interface would only
+    // fail after the timeout, as its packets are no longer routed.
+    uint32_t generation = sNetworkGeneration;
+    if (_spConnection->NetworkGeneration != generation) {
+        _spConnection->spWiFiClient->stop();
+        _spConnection->NetworkGeneration = generation;
+    }
+}
+
+// must be called with the connection's mutex held
+bool HttpGetter::resolveAddress()
 {
     // hostByName in WiFiGeneric fails to resolve local names. issue described at
     // https://github.com/espressif/arduino-esp32/issues/3822 and in analyzed in
     // depth at https://github.com/espressif/esp-idf/issues/2507#issuecomment-761836300
-    // in conclusion: we cannot rely on _upHttpClient->begin(*wifiClient, url) to resolve
-    // IP adresses. have to do it manually.
-    IPAddress ipaddr(static_cast<uint32_t>(0));
-
-    if (!ipaddr.fromString(_host)) {
-        // host is not an IP address, so try to resolve the name to an address.
-        // first try locally via mDNS, then via DNS. WiFiGeneric::hostByName()
-        // will spam the console if done the other way around.
-        ipaddr = INADDR_NONE;
-
-        if (Configuration.get().Mdns.Enabled) {
-            ipaddr = MDNS.queryHost(_host); // INADDR_NONE if failed
-        }
+    // in conclusion: we cannot rely on httpClient.begin(*wifiClient, url) to resolve
+    // IP adresses. have to do it manually. the cache avoids waiting for the DNS
+    // server each time the connection is opened.
+    IPAddress ipaddr;
+    if (!DnsCache.resolve(_host, ipaddr)) {
+        logError("failed to resolve host '%s'", _host.c_str());
+        return false;
+    }
 
-        if (ipaddr == INADDR_NONE && !WiFiGenericClass::hostByName(_host.c_str(), ipaddr)) {
-            logError("failed to resolve host '%s' via DNS", _host.c_str());
-            return { false };
-        }
+    _spConnection->Address = ipaddr.toString();
+    return true;
+}
+
+bool HttpGetter::prewarm()
+{
+    // another getter uses the connection, so it is open already
+    std::unique_lock<std::mutex> lock(_spConnection->Mutex, std::try_to_lock);
+    if (!lock.owns_lock()) { return true; }
+
+    auto& httpClient = _spConnection->HttpClient;
+
+    closeIfStale();
+    if (httpClient.connected()) { return true; }
+    if (!resolveAddress()) { return false; }
+
+    if (!httpClient.begin(*_spConnection->spWiFiClient, _spConnection->Address, _port, _uri, _useHttps)) {
+        return false;
+    }
+
+    httpClient.setReuse(true);
+    httpClient.setConnectTimeout(_config.Timeout);
+
+    uint32_t start = millis();
+    bool success = httpClient.connectNow();
+    if (_useHttps) {
+        TlsMonitor.recordHandshake(TlsMonitorClass::Client::Http, success, millis() - start);
     }
 
-    auto upTmpHttpClient = std::make_unique<HttpGetterClient>();
+    if (!success) { _spConnection->spWiFiClient->stop(); }
+    return success;
+}
+
+HttpRequestResult HttpGetter::performGetRequest()
+{
+    return performRequest("GET", nullptr, 0);
+}
 
-    // use HTTP1.0 to avoid problems with chunked transfer encoding when the
-    // stream is later used to read the server's response.
-    upTmpHttpClient->useHTTP10(true);
+HttpRequestResult HttpGetter::performPostRequest(uint8_t const* payload, size_t size)
+{
+    return performRequest("POST", payload, size);
+}
 
-    if (!upTmpHttpClient->begin(*_spWiFiClient, ipaddr.toString(), _port, _uri, _useHttps)) {
+HttpRequestResult HttpGetter::performRequest(char const* method, uint8_t const* payload, size_t size)
+{
+    std::unique_lock<std::mutex> lock(_spConnection->Mutex);
+    auto& httpClient = _spConnection->HttpClient;
+
+    // closes the connection as it is in an unknown state after a failure
+    auto fail = [this]() -> HttpRequestResult {
+        _spConnection->spWiFiClient->stop();
+        return { false };
+    };
+
+    closeIfStale();
+
+    // resolving the host is only necessary if no connection is open
+    if (!httpClient.connected() && !resolveAddress()) { return { false }; }
+
+    if (!httpClient.begin(*_spConnection->spWiFiClient, _spConnection->Address, _port, _uri, _useHttps)) {
         logError("HTTP client begin() failed for %s://%s",
                 (_useHttps ? "https" : "http"), _host.c_str());
-        return { false };
+        return fail();
     }
 
-    upTmpHttpClient->setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    upTmpHttpClient->setUserAgent("OpenDTU-OnBattery");
-    upTmpHttpClient->setConnectTimeout(_config.Timeout);
-    upTmpHttpClient->setTimeout(_config.Timeout);
+    // use HTTP/1.1 persistent connections. the response body is limited to
+    // its content length or decoded if it uses chunked transfer encoding.
+    httpClient.setReuse(true);
+
+    const char *headers[3] = {"WWW-Authenticate", "Connection", "Transfer-Encoding"};
+    httpClient.collectHeaders(headers, 3);
+
+    httpClient.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+    httpClient.setUserAgent("OpenDTU-OnBattery");
+    httpClient.setConnectTimeout(_config.Timeout);
+    httpClient.setTimeout(_config.Timeout);
     for (auto const& h : _additionalHeaders) {
-        upTmpHttpClient->addHeader(h.first.c_str(), h.second.c_str());
+        httpClient.addHeader(h.first.c_str(), h.second.c_str());
     }
 
     if (strlen(_config.HeaderKey) > 0) {
-        upTmpHttpClient->addHeader(_config.HeaderKey, _config.HeaderValue);
+        httpClient.addHeader(_config.HeaderKey, _config.HeaderValue);
     }
 
     using Auth_t = HttpRequestConfig::Auth;
@@ -132,78 +277,128 @@ HttpRequestResult HttpGetter::performGetRequest()
         case Auth_t::Basic: {
             String credentials = String(_config.Username) + ":" + _config.Password;
             String authorization = "Basic " + base64::encode(credentials);
-            upTmpHttpClient->addHeader("Authorization", authorization);
+            httpClient.addHeader("Authorization", authorization);
             break;
         }
         case Auth_t::Digest: {
-            // send "Connection: keep-alive" (despite using HTTP/1.0, where
-            // "Connection: close" is the default) so there is a chance to
-            // reuse the TCP connection when performing the second GET request.
-            upTmpHttpClient->setReuse(true);
-
-            const char *headers[2] = {"WWW-Authenticate", "Connection"};
-            upTmpHttpClient->collectHeaders(headers, 2);
-
             // try with new auth response based on previous WWW-Authenticate
             // header, which allows us to retrieve the resource without a
             // second GET request. if the server decides that we reused the
             // previous challenge too often, it will respond with HTTP401 and
             // a new challenge, which we handle as if we had no challenge yet.
-            auto authorization = getAuthDigest();
+            auto authorization = getAuthDigest(method);
             if (authorization.first) {
-                upTmpHttpClient->addHeader("Authorization", authorization.second);
+                httpClient.addHeader("Authorization", authorization.second);
             }
             break;
         }
     }
 
-    int httpCode = upTmpHttpClient->GET();
+    // the TLS handshake is performed ahead of the request, such that its
+    // cost is accounted for. it is skipped while a persistent connection is
+    // open, which is the case for all but the first of periodic requests.
+    auto handshake = [this, &httpClient]() -> bool {
+        if (!_useHttps || httpClient.connected()) { return true; }
+
+        uint32_t start = millis();
+        bool success = httpClient.connectNow();
+        TlsMonitor.recordHandshake(TlsMonitorClass::Client::Http, success, millis() - start);
+        if (!success) { logError("TLS connection to %s failed", _host.c_str()); }
+        return success;
+    };
+
+    auto send = [&]() -> int {
+        return httpClient.sendRequest(method, const_cast<uint8_t*>(payload), size);
+    };
+
+    bool reused = httpClient.connected();
+    if (!handshake()) { return fail(); }
+    int httpCode = send();
+
+    // the server might have closed the idle connection in the meantime. the
+    // http client closed the socket when failing, so it reconnects now.
+    if (httpCode <= 0 && httpCode != HTTPC_ERROR_READ_TIMEOUT && reused) {
+        if (!handshake()) { return fail(); }
+        httpCode = send();
+    }
 
     if (httpCode == HTTP_CODE_UNAUTHORIZED && _config.AuthType == Auth_t::Digest) {
         _wwwAuthenticate = "";
 
-        if (!upTmpHttpClient->hasHeader("WWW-Authenticate")) {
+        if (!httpClient.hasHeader("WWW-Authenticate")) {
             logError("Cannot perform digest authentication as server did "
                         "not send a WWW-Authenticate header");
-            return { false };
+            return fail();
         }
 
-        _wwwAuthenticate = upTmpHttpClient->header("WWW-Authenticate");
+        _wwwAuthenticate = httpClient.header("WWW-Authenticate");
 
         // using a new WWW-Authenticate challenge means
         // we never used the server's nonce in a response
         _nonceCounter = 0;
 
-        auto authorization = getAuthDigest();
+        auto authorization = getAuthDigest(method);
         if (!authorization.first) {
             logError("Digest Error: %s", authorization.second.c_str());
-            return { false };
+            return fail();
         }
-        upTmpHttpClient->addHeader("Authorization", authorization.second);
+        httpClient.addHeader("Authorization", authorization.second);
 
         // use a new TCP connection if the server sent "Connection: close".
         bool restart = true;
-        if (upTmpHttpClient->hasHeader("Connection")) {
-            String connection = upTmpHttpClient->header("Connection");
+        if (httpClient.hasHeader("Connection")) {
+            String connection = httpClient.header("Connection");
             connection.toLowerCase();
             restart = connection.indexOf("keep-alive") == -1;
         }
-        if (restart) { upTmpHttpClient->restartTCP(); }
+        if (restart) { httpClient.restartTCP(); }
 
-        httpCode = upTmpHttpClient->GET();
+        httpCode = send();
     }
 
     if (httpCode <= 0) {
-        logError("HTTP Error: %s", upTmpHttpClient->errorToString(httpCode).c_str());
-        return { false };
+        logError("HTTP Error: %s", httpClient.errorToString(httpCode).c_str());
+        return fail();
     }
 
-    if (httpCode != HTTP_CODE_OK) {
+    bool success = (strcmp(method, "GET") == 0) ? (httpCode == HTTP_CODE_OK)
+        : (httpCode >= HTTP_CODE_OK && httpCode < HTTP_CODE_MULTIPLE_CHOICES);
+    if (!success) {
         logError("Bad HTTP code: %d", httpCode);
+
+        // a short error body is discarded to keep the connection, as a new
+        // connection would cost another TLS handshake.
+        int size = httpClient.getSize();
+        auto pStream = httpClient.getStreamPtr();
+        if (size < 0 || size > 1024 || pStream == nullptr) { return fail(); }
+
+        uint8_t discard[64];
+        while (size > 0) {
+            size_t read = pStream->readBytes(discard, std::min<size_t>(size, sizeof(discard)));
+            if (read == 0) { return fail(); }
+            size -= read;
+        }
+
+        httpClient.end();
         return { false };
     }
 
-    return { true, std::move(upTmpHttpClient), _spWiFiClient };
+    std::unique_ptr<Stream> upBody = nullptr;
+
+    if (httpClient.header("Transfer-Encoding").equalsIgnoreCase("chunked")) {
+        // the http client decodes the chunks while copying the body
+        auto upBuffer = std::make_unique<StreamString>();
+        int res = httpClient.writeToStream(upBuffer.get());
+        if (res < 0) {
+            logError("HTTP Error: %s", httpClient.errorToString(res).c_str());
+            return fail();
+        }
+        upBody = std::move(upBuffer);
+    } else if (auto pStream = httpClient.getStreamPtr()) {
+        upBody = std::make_unique<HttpBodyStream>(*pStream, httpClient.getSize());
+    }
+
+    return { true, _spConnection, std::move(lock), std::move(upBody) };
 }
 
 template<size_t binLen>
@@ -275,7 +470,7 @@ static std::pair<bool, String> getAlgo(String const& authReq) {
     return { false, "unsupported digest algorithm" };
 }
 
-std::pair<bool, String> HttpGetter::getAuthDigest() {
+std::pair<bool, String> HttpGetter::getAuthDigest(char const* method) {
     if (_wwwAuthenticate.isEmpty()) { return { false, "no digest challenge yet" }; }
 
     // extracting required parameters for RFC 2617 Digest
@@ -291,7 +486,7 @@ std::pair<bool, String> HttpGetter::getAuthDigest() {
 
     auto hash = (algo.second == "SHA-256") ? &sha256 : &md5;
     String ha1 = hash(String(_config.Username) + ":" + realm + ":" + _config.Password);
-    String ha2 = hash("GET:" + _uri);
+    String ha2 = hash(String(method) + ":" + _uri);
     String response = hash(ha1 + ":" + nonce + ":" + String(nc) +
             ":" + cNonce + ":" + "auth" + ":" + ha2);
 
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "HttpPoller.h"
+#include "HttpGetter.h"
+#include "MessageOutput.h"
+#include <algorithm>
+
+HttpPollerClass HttpPoller;
+
+HttpPollerClass::job_id_t HttpPollerClass::add(Job job)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // started once the first provider needs it and kept running
+    if (_taskHandle == nullptr && pdPASS != xTaskCreate(HttpPollerClass::pollingLoopHelper,
+                "HttpPoller", _taskStackSize, this, 1/*prio*/, &_taskHandle)) {
+        _taskHandle = nullptr;
+        MessageOutput.println("[HttpPoller] Failed to create task");
+        return 0;
+    }
+
+    job_id_t id = _nextId++;
+    _entries.push_back({ id, std::move(job) });
+    _scheduleChanged = true;
+    _cv.notify_all();
+    return id;
+}
+
+void HttpPollerClass::remove(job_id_t id)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this, id] { return _runningId != id; });
+
+    _entries.remove_if([id](Entry const& entry) { return entry.Id == id; });
+    _scheduleChanged = true;
+    _cv.notify_all();
+}
+
+void HttpPollerClass::reschedule()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _scheduleChanged = true;
+    }
+    _cv.notify_all();
+}
+
+void HttpPollerClass::pollingLoopHelper(void* context)
+{
+    static_cast<HttpPollerClass*>(context)->pollingLoop();
+}
+
+void HttpPollerClass::pollingLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true) {
+        uint32_t now = millis();
+        uint32_t sleepMs = _idleMillis;
+        Entry* pDue = nullptr;
+        bool prewarm = false;
+
+        for (auto& entry : _entries) {
+            auto elapsedMillis = now - entry.LastPoll;
+            auto intervalMillis = entry.Callbacks.IntervalMillis();
+            if (entry.LastPoll == 0 || elapsedMillis >= intervalMillis) {
+                pDue = &entry;
+                break;
+            }
+
+            auto remainingMs = intervalMillis - elapsedMillis;
+
+            // if the server closed the connection, it is opened again shortly
+            // before the next poll, such that the sample is not delayed by
+            // the handshake. skipped after failed polls.
+            if (!entry.Prewarmed && remainingMs <= HttpGetter::PrewarmLeadMillis) {
+                pDue = &entry;
+                prewarm = true;
+                break;
+            }
+            if (!entry.Prewarmed) { remainingMs -= HttpGetter::PrewarmLeadMillis; }
+
+            sleepMs = std::min(sleepMs, remainingMs);
+        }
+
+        if (pDue == nullptr) {
+            _cv.wait_for(lock, std::chrono::milliseconds(sleepMs),
+                    [this] { return _scheduleChanged; }); // releases the mutex
+            _scheduleChanged = false;
+            continue;
+        }
+
+        _runningId = pDue->Id;
+
+        if (prewarm) {
+            pDue->Prewarmed = true;
+            lock.unlock();
+            pDue->Callbacks.Prewarm();
+            lock.lock();
+        } else {
+            pDue->LastPoll = millis();
+            lock.unlock(); // polling can take quite some time
+            bool success = pDue->Callbacks.Poll();
+            lock.lock();
+            pDue->Prewarmed = !success;
+        }
+
+        _runningId = 0;
+        _cv.notify_all(); // a job may be waiting to be removed
+    }
+}
@@ -3,11 +3,14 @@
  * Copyright (C) 2024 Thomas Basler and others
  */
 #include "I18n.h"
+#include "FsWriteMonitor.h"
 #include "MessageOutput.h"
 #include "Utils.h"
 #include "defaults.h"
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include <algorithm>
+#include <memory>
 
 I18nClass I18n;
 
@@ -38,6 +41,84 @@ String I18nClass::getFilenameByLocale(const String& locale) const
     }
 }
 
+// locates the value of the top-level key "display" within the language pack,
+// without deserializing the file. returns false if there is no such object.
+static bool findDisplayObject(File& f, size_t& offset, size_t& length)
+{
+    static constexpr char const* key = "display";
+
+    f.seek(0);
+
+    size_t pos = 0;
+    uint8_t depth = 0;
+    bool inString = false;
+    bool escape = false;
+    bool atKey = false; // the most recent string at depth 1 is the key
+    bool atValue = false; // the colon after the key was seen
+    size_t keyIdx = 0;
+    bool keyMatch = false;
+
+    uint8_t buffer[64];
+    size_t len;
+    while ((len = f.read(buffer, sizeof(buffer))) > 0) {
+        for (size_t i = 0; i < len; ++i, ++pos) {
+            char c = buffer[i];
+
+            if (inString) {
+                if (escape) {
+                    escape = false;
+                    keyMatch = false;
+                } else if (c == '\\') {
+                    escape = true;
+                } else if (c == '"') {
+                    inString = false;
+                    atKey = depth == 1 && keyMatch && key[keyIdx] == '\0';
+                } else {
+                    keyMatch = keyMatch && key[keyIdx] == c;
+                    if (keyMatch) { ++keyIdx; }
+                }
+                continue;
+            }
+
+            switch (c) {
+                case '"':
+                    inString = true;
+                    keyIdx = 0;
+                    keyMatch = true;
+                    atKey = false;
+                    break;
+                case ':':
+                    if (depth == 1) { atValue = atKey; }
+                    atKey = false;
+                    break;
+                case '{':
+                case '[':
+                    if (atValue && depth == 1) {
+                        if (c == '{') { offset = pos; } else { atValue = false; }
+                    }
+                    ++depth;
+                    break;
+                case '}':
+                case ']':
+                    if (depth == 0) { return false; }
+                    --depth;
+                    if (atValue && depth == 1) {
+                        length = pos + 1 - offset;
+                        return true;
+                    }
+                    break;
+                case ',':
+                    if (depth == 1) { atValue = false; }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    return false;
+}
+
 void I18nClass::readDisplayStrings(
     const String& locale,
     String& date_format,
@@ -47,96 +128,118 @@ void I18nClass::readDisplayStrings(
     String& yield_today_wh, String& yield_today_kwh,
     String& yield_total_kwh, String& yield_total_mwh)
 {
-    auto filename = getFilenameByLocale(locale);
-    if (filename == "") {
-        return;
-    }
-
-    JsonDocument filter;
-    filter["display"] = true;
-
-    File f = LittleFS.open(filename, "r", false);
-
-    JsonDocument doc;
-
-    // Deserialize the JSON document
-    const DeserializationError error = deserializeJson(doc, f, DeserializationOption::Filter(filter));
-    if (error) {
-        MessageOutput.printf("Failed to read file %s\r\n", filename.c_str());
-        f.close();
-        return;
-    }
+    auto it = std::find_if(_availLanguages.begin(), _availLanguages.end(), [locale](const LanguageInfo_t& elem) {
+        return elem.code == locale;
+    });
 
-    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+    if (it == _availLanguages.end()) {
         return;
     }
 
-    auto displayData = doc["display"];
-
-    if (displayData["date_format"].as<String>() != "null") {
-        date_format = displayData["date_format"].as<String>();
-    }
-
-    if (displayData["offline"].as<String>() != "null") {
-        offline = displayData["offline"].as<String>();
-    }
+    auto const& lang = *it;
 
-    if (displayData["power_w"].as<String>() != "null") {
-        power_w = displayData["power_w"].as<String>();
+    File f = LittleFS.open(lang.filename, "r", false);
+    if (!f) {
+        MessageOutput.printf("Failed to open file %s\r\n", lang.filename.c_str());
+        return;
     }
 
-    if (displayData["power_kw"].as<String>() != "null") {
-        power_kw = displayData["power_kw"].as<String>();
+    JsonDocument doc;
+    JsonVariant displayData;
+
+    // the indexed location of the display strings is only trusted as long
+    // as the file was not replaced
+    static constexpr size_t maxDisplayLength = 2048;
+    if (lang.displayLength > 0 && lang.displayLength <= maxDisplayLength && f.size() == lang.size) {
+        std::unique_ptr<char[]> buffer(new char[lang.displayLength]);
+        f.seek(lang.displayOffset);
+        size_t read = f.read(reinterpret_cast<uint8_t*>(buffer.get()), lang.displayLength);
+
+        if (read == lang.displayLength && !deserializeJson(doc, buffer.get(), read)) {
+            displayData = doc.as<JsonVariant>();
+        }
     }
 
-    if (displayData["meter_power_w"].as<String>() != "null") {
-        meter_power_w = displayData["meter_power_w"].as<String>();
-    }
+    if (displayData.isNull()) {
+        JsonDocument filter;
+        filter["display"] = true;
 
-    if (displayData["meter_power_kw"].as<String>() != "null") {
-        meter_power_kw = displayData["meter_power_kw"].as<String>();
-    }
+        f.seek(0);
 
-    if (displayData["yield_today_wh"].as<String>() != "null") {
-        yield_today_wh = displayData["yield_today_wh"].as<String>();
-    }
+        // Deserialize the JSON document
+        const DeserializationError error = deserializeJson(doc, f, DeserializationOption::Filter(filter));
+        if (error) {
+            MessageOutput.printf("Failed to read file %s\r\n", lang.filename.c_str());
+            f.close();
+            return;
+        }
 
-    if (displayData["yield_today_kwh"].as<String>() != "null") {
-        yield_today_kwh = displayData["yield_today_kwh"].as<String>();
+        displayData = doc["display"];
     }
 
-    if (displayData["yield_total_kwh"].as<String>() != "null") {
-        yield_total_kwh = displayData["yield_total_kwh"].as<String>();
-    }
+    f.close();
 
-    if (displayData["yield_total_mwh"].as<String>() != "null") {
-        yield_total_mwh = displayData["yield_total_mwh"].as<String>();
+    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+        return;
     }
 
-    f.close();
+    auto readString = [&displayData](char const* key, String& target) {
+        if (displayData[key].as<String>() != "null") {
+            target = displayData[key].as<String>();
+        }
+    };
+
+    readString("date_format", date_format);
+    readString("offline", offline);
+    readString("power_w", power_w);
+    readString("power_kw", power_kw);
+    readString("meter_power_w", meter_power_w);
+    readString("meter_power_kw", meter_power_kw);
+    readString("yield_today_wh", yield_today_wh);
+    readString("yield_today_kwh", yield_today_kwh);
+    readString("yield_total_kwh", yield_total_kwh);
+    readString("yield_total_mwh", yield_total_mwh);
 }
 
 void I18nClass::readLangPacks()
 {
+    if (readIndex(_availLanguages)) {
+        MessageOutput.printf("Read language pack index (%u packs)\r\n",
+            static_cast<unsigned>(_availLanguages.size()));
+        return;
+    }
+
+    // no (valid) index, e.g., after upgrading. the index is created once.
+    _availLanguages.clear();
+
     auto root = LittleFS.open("/");
     auto file = root.getNextFileName();
 
     while (file != "") {
         if (file.endsWith(LANG_PACK_SUFFIX)) {
             MessageOutput.printf("Read File %s\r\n", file.c_str());
-            readConfig(file);
+            LanguageInfo_t lang;
+            if (readConfig(file, lang)) {
+                _availLanguages.push_back(lang);
+            }
         }
         file = root.getNextFileName();
     }
     root.close();
+
+    writeIndex(_availLanguages);
 }
 
-void I18nClass::readConfig(String file)
+bool I18nClass::readConfig(const String& file, LanguageInfo_t& lang)
 {
     JsonDocument filter;
     filter["meta"] = true;
 
     File f = LittleFS.open(file, "r", false);
+    if (!f) {
+        MessageOutput.printf("Failed to open file %s\r\n", file.c_str());
+        return false;
+    }
 
     JsonDocument doc;
 
@@ -145,23 +248,136 @@ void I18nClass::readConfig(String file)
     if (error) {
         MessageOutput.printf("Failed to read file %s\r\n", file.c_str());
         f.close();
-        return;
+        return false;
     }
 
     if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
-        return;
+        f.close();
+        return false;
     }
 
-    LanguageInfo_t lang;
     lang.code = String(doc["meta"]["code"] | "");
     lang.name = String(doc["meta"]["name"] | "");
     lang.filename = file;
+    lang.size = f.size();
+    lang.displayOffset = 0;
+    lang.displayLength = 0;
 
-    if (lang.code != "" && lang.name != "") {
-        _availLanguages.push_back(lang);
-    } else {
+    if (!findDisplayObject(f, lang.displayOffset, lang.displayLength)) {
+        lang.displayOffset = lang.displayLength = 0;
+    }
+
+    f.close();
+
+    if (lang.code == "" || lang.name == "") {
         MessageOutput.printf("Invalid meta data\r\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool I18nClass::readIndex(std::list<LanguageInfo_t>& languages)
+{
+    File f = LittleFS.open(LANG_PACK_INDEX_FILENAME, "r", false);
+    if (!f) {
+        return false;
+    }
+
+    JsonDocument doc;
+    const DeserializationError error = deserializeJson(doc, f);
+    f.close();
+
+    if (error || !doc.is<JsonArray>() || !Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+        MessageOutput.printf("Failed to read file %s\r\n", LANG_PACK_INDEX_FILENAME);
+        return false;
+    }
+
+    std::list<LanguageInfo_t> result;
+    for (JsonObject entry : doc.as<JsonArray>()) {
+        LanguageInfo_t lang;
+        lang.code = String(entry["code"] | "");
+        lang.name = String(entry["name"] | "");
+        lang.filename = String(entry["file"] | "");
+        lang.size = entry["size"] | 0;
+        lang.displayOffset = entry["offset"] | 0;
+        lang.displayLength = entry["length"] | 0;
+
+        if (lang.code == "" || lang.name == "" || lang.filename == "") {
+            return false;
+        }
+
+        result.push_back(lang);
+    }
+
+    languages = std::move(result);
+    return true;
+}
+
+void I18nClass::writeIndex(const std::list<LanguageInfo_t>& languages)
+{
+    JsonDocument doc;
+    auto array = doc.to<JsonArray>();
+
+    for (auto const& lang : languages) {
+        auto entry = array.add<JsonObject>();
+        entry["code"] = lang.code;
+        entry["name"] = lang.name;
+        entry["file"] = lang.filename;
+        entry["size"] = lang.size;
+        entry["offset"] = lang.displayOffset;
+        entry["length"] = lang.displayLength;
+    }
+
+    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+        return;
     }
 
+    File f = LittleFS.open(LANG_PACK_INDEX_FILENAME, "w");
+    if (!f) {
+        MessageOutput.printf("Failed to write file %s\r\n", LANG_PACK_INDEX_FILENAME);
+        return;
+    }
+
+    size_t size = serializeJson(doc, f);
     f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::LanguagePack, size);
+}
+
+void I18nClass::updateIndex(const String& filename)
+{
+    std::lock_guard<std::mutex> lock(_indexMutex);
+
+    std::list<LanguageInfo_t> languages;
+    if (!readIndex(languages)) {
+        languages = _availLanguages;
+    }
+
+    languages.remove_if([&filename](const LanguageInfo_t& elem) {
+        return elem.filename == filename;
+    });
+
+    LanguageInfo_t lang;
+    if (readConfig(filename, lang)) {
+        languages.push_back(lang);
+    }
+
+    writeIndex(languages);
+}
+
+void I18nClass::removeFromIndex(const String& filename)
+{
+    std::lock_guard<std::mutex> lock(_indexMutex);
+
+    std::list<LanguageInfo_t> languages;
+    if (!readIndex(languages)) {
+        return;
+    }
+
+    languages.remove_if([&filename](const LanguageInfo_t& elem) {
+        return elem.filename == filename;
+    });
+
+    writeIndex(languages);
 }
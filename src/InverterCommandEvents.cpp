@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "InverterCommandEvents.h"
+#include "MqttSettings.h"
+
+InverterCommandEventsClass InverterCommandEvents;
+
+void InverterCommandEventsClass::init()
+{
+    Hoymiles.onCommandCompletion(std::bind(&InverterCommandEventsClass::onCompletion,
+        this, std::placeholders::_1));
+}
+
+char const* InverterCommandEventsClass::getResultName(CommandResult result)
+{
+    switch (result) {
+        case CommandResult::Ok: return "ok";
+        case CommandResult::Timeout: return "timeout";
+        case CommandResult::Nok: return "nok";
+        case CommandResult::Dropped: return "dropped";
+    }
+    return "unknown";
+}
+
+void InverterCommandEventsClass::serialize(CommandCompletion const& completion, JsonObject& target)
+{
+    char serial[17];
+    snprintf(serial, sizeof(serial), "%0" PRIx32 "%08" PRIx32,
+        static_cast<uint32_t>((completion.Serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(completion.Serial & 0xFFFFFFFF));
+
+    target["id"] = completion.Id;
+    target["serial"] = serial;
+    target["command"] = completion.Command;
+    target["result"] = getResultName(completion.Result);
+    target["latency_ms"] = completion.CompletionMillis - completion.EnqueueMillis;
+    if (completion.FirstTxMillis > 0) {
+        target["queued_ms"] = completion.FirstTxMillis - completion.EnqueueMillis;
+    }
+    target["retries"] = completion.SendCount > 1 ? completion.SendCount - 1 : 0;
+}
+
+void InverterCommandEventsClass::onCompletion(CommandCompletion const& completion)
+{
+    if (!MqttSettings.getConnected()) { return; }
+
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    serialize(completion, root);
+
+    String payload;
+    serializeJson(doc, payload);
+    MqttSettings.publish(root["serial"].as<String>() + "/cmd/completed", payload,
+        MqttPublishPriority::Control);
+}
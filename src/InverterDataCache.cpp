@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "InverterDataCache.h"
+#include "FsWriteMonitor.h"
+#include "MessageOutput.h"
+#include "TaskMonitor.h"
+#include <Hoymiles.h>
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+
+#define INVERTERDATACACHE_DIRECTORY "/invcache"
+
+InverterDataCacheClass InverterDataCache;
+
+namespace {
+
+constexpr char const* kindSuffix[] = { "di", "gp", "sc" };
+
+// the device info consists of two payloads, each preceded by its length
+std::vector<uint8_t> packDevInfo(std::vector<uint8_t> const& all, std::vector<uint8_t> const& simple)
+{
+    std::vector<uint8_t> data;
+    data.reserve(all.size() + simple.size() + 2);
+    data.push_back(all.size());
+    data.insert(data.end(), all.begin(), all.end());
+    data.push_back(simple.size());
+    data.insert(data.end(), simple.begin(), simple.end());
+    return data;
+}
+
+}; // namespace
+
+InverterDataCacheClass::InverterDataCacheClass()
+    : _loopTask(10 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("InverterDataCache::loop", std::bind(&InverterDataCacheClass::loop, this)))
+{
+}
+
+void InverterDataCacheClass::init(Scheduler& scheduler)
+{
+    if (!LittleFS.exists(INVERTERDATACACHE_DIRECTORY)) {
+        LittleFS.mkdir(INVERTERDATACACHE_DIRECTORY);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // restore right away, such that the DPL finds the data on its first
+        // iteration already.
+        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+            auto inv = Hoymiles.getInverterByPos(i);
+            if (inv == nullptr) { continue; }
+            restore(*inv, _states[inv->serial()]);
+        }
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void InverterDataCacheClass::loop()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    uint32_t now = millis();
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        // inverters added at runtime are restored when first seen
+        auto it = _states.find(inv->serial());
+        if (it == _states.end()) {
+            restore(*inv, _states[inv->serial()]);
+            continue;
+        }
+
+        auto& state = it->second;
+        std::vector<uint8_t> data;
+
+        // once the device info was confirmed by the inverter, entries written
+        // with another firmware are stale.
+        if (getConfirmedData(*inv, Kind::DevInfo, data)) {
+            uint16_t firmware = inv->DevInfo()->getFwBuildVersion();
+            if (firmware != state.Firmware) {
+                for (uint8_t kind = 0; kind < Kind::KindCount; kind++) {
+                    erase(inv->serial(), static_cast<Kind>(kind));
+                }
+                state = State();
+                state.Firmware = firmware;
+            }
+        }
+
+        for (uint8_t k = 0; k < Kind::KindCount; k++) {
+            auto kind = static_cast<Kind>(k);
+            if (!getConfirmedData(*inv, kind, data)) { continue; }
+
+            uint32_t crc = esp_rom_crc32_le(0, data.data(), data.size());
+            if (crc == state.Crc[kind]) { continue; }
+
+            if (kind == Kind::SystemConfigPara && state.Crc[kind] != 0
+                    && now - state.SavedMillis[kind] < _systemConfigSaveIntervalMs) {
+                continue;
+            }
+
+            if (write(inv->serial(), kind, data, state.Firmware, crc)) {
+                state.Crc[kind] = crc;
+                state.SavedMillis[kind] = now;
+            }
+        }
+    }
+}
+
+void InverterDataCacheClass::restore(InverterAbstract& inv, State& state)
+{
+    std::vector<uint8_t> data;
+    uint16_t firmware = 0;
+    uint32_t crc = 0;
+
+    // without a device info, the firmware of the other entries is unknown
+    if (!read(inv.serial(), Kind::DevInfo, data, firmware, crc)
+            || !restore(inv, Kind::DevInfo, data)) {
+        return;
+    }
+
+    state.Crc[Kind::DevInfo] = crc;
+    state.Firmware = firmware;
+
+    uint8_t count = 1;
+    for (uint8_t k = Kind::DevInfo + 1; k < Kind::KindCount; k++) {
+        auto kind = static_cast<Kind>(k);
+        uint16_t entryFirmware = 0;
+        if (!read(inv.serial(), kind, data, entryFirmware, crc)) { continue; }
+
+        if (entryFirmware != firmware || !restore(inv, kind, data)) {
+            erase(inv.serial(), kind);
+            continue;
+        }
+
+        state.Crc[kind] = crc;
+        count++;
+    }
+
+    MessageOutput.printf("[InverterDataCache] restored %u entries of inverter %s\r\n",
+        count, inv.serialString().c_str());
+}
+
+bool InverterDataCacheClass::restore(InverterAbstract& inv, Kind kind, std::vector<uint8_t> const& data)
+{
+    switch (kind) {
+        case Kind::DevInfo: {
+            // data was written by packDevInfo()
+            if (data.empty() || data.size() < data[0] + 2u) { return false; }
+            uint8_t allLen = data[0];
+            uint8_t simpleLen = data[allLen + 1];
+            if (data.size() != allLen + simpleLen + 2u) { return false; }
+            return inv.DevInfo()->setRawData(&data[1], allLen, &data[allLen + 2], simpleLen)
+                && inv.DevInfo()->containsValidData();
+        }
+        case Kind::GridProfile:
+            return inv.GridProfile()->setRawData(data.data(), data.size());
+        case Kind::SystemConfigPara:
+            return inv.SystemConfigPara()->setRawData(data.data(), data.size());
+        default:
+            break;
+    }
+    return false;
+}
+
+// provides the data of the given kind if it was received from the inverter
+// since boot, as opposed to being restored from the cache.
+bool InverterDataCacheClass::getConfirmedData(InverterAbstract& inv, Kind kind, std::vector<uint8_t>& data)
+{
+    switch (kind) {
+        case Kind::DevInfo: {
+            auto devInfo = inv.DevInfo();
+            if (devInfo->getLastUpdateAll() == 0 || devInfo->getLastUpdateSimple() == 0
+                    || !devInfo->containsValidData()) {
+                return false;
+            }
+            data = packDevInfo(devInfo->getRawDataAll(), devInfo->getRawDataSimple());
+            return true;
+        }
+        case Kind::GridProfile: {
+            auto gridProfile = inv.GridProfile();
+            if (gridProfile->getLastUpdate() == 0 || !gridProfile->containsValidData()) {
+                return false;
+            }
+            data = gridProfile->getRawData();
+            return true;
+        }
+        case Kind::SystemConfigPara: {
+            auto systemConfigPara = inv.SystemConfigPara();
+            bool requested = systemConfigPara->getLastUpdateRequest() > 0
+                && systemConfigPara->getLastLimitRequestSuccess() == CMD_OK;
+            bool commanded = systemConfigPara->getLastUpdateCommand() > 0
+                && systemConfigPara->getLastLimitCommandSuccess() == CMD_OK;
+            if (!requested && !commanded) { return false; }
+            data = systemConfigPara->getRawData();
+            return !data.empty();
+        }
+        default:
+            break;
+    }
+    return false;
+}
+
+bool InverterDataCacheClass::read(uint64_t serial, Kind kind, std::vector<uint8_t>& data, uint16_t& firmware, uint32_t& crc)
+{
+    auto filename = getFilename(serial, kind);
+    if (!LittleFS.exists(filename)) { return false; }
+
+    File f = LittleFS.open(filename, "r", false);
+    if (!f) { return false; }
+
+    Header header;
+    bool valid = f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header)
+        && header.Magic == _magic && header.Version == _version;
+    if (valid) {
+        data.resize(header.Length);
+        valid = f.read(data.data(), data.size()) == data.size()
+            && esp_rom_crc32_le(0, data.data(), data.size()) == header.Crc;
+    }
+    f.close();
+
+    if (!valid) {
+        MessageOutput.printf("[InverterDataCache] discarding invalid %s\r\n", filename.c_str());
+        LittleFS.remove(filename);
+        return false;
+    }
+
+    firmware = header.Firmware;
+    crc = header.Crc;
+    return true;
+}
+
+bool InverterDataCacheClass::write(uint64_t serial, Kind kind, std::vector<uint8_t> const& data, uint16_t firmware, uint32_t crc)
+{
+    if (data.size() > UINT8_MAX) { return false; }
+
+    size_t size = sizeof(Header) + data.size();
+    if (!FsWriteMonitor.admit(FsWriteMonitorClass::Category::DataCache, size)) { return false; }
+
+    auto filename = getFilename(serial, kind);
+    File f = LittleFS.open(filename, "w", true);
+    if (!f) {
+        MessageOutput.printf("[InverterDataCache] cannot create %s\r\n", filename.c_str());
+        return false;
+    }
+
+    Header header = { _magic, _version, static_cast<uint8_t>(data.size()), firmware, crc };
+    bool success = f.write(reinterpret_cast<uint8_t const*>(&header), sizeof(header)) == sizeof(header)
+        && f.write(data.data(), data.size()) == data.size();
+    f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::DataCache, size);
+
+    if (!success) {
+        MessageOutput.printf("[InverterDataCache] cannot write %s\r\n", filename.c_str());
+        LittleFS.remove(filename);
+    }
+
+    return success;
+}
+
+void InverterDataCacheClass::erase(uint64_t serial, Kind kind)
+{
+    auto filename = getFilename(serial, kind);
+    if (LittleFS.exists(filename)) {
+        LittleFS.remove(filename);
+    }
+}
+
+void InverterDataCacheClass::remove(uint64_t serial)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _states.erase(serial);
+
+    for (uint8_t kind = 0; kind < Kind::KindCount; kind++) {
+        erase(serial, static_cast<Kind>(kind));
+    }
+}
+
+String InverterDataCacheClass::getFilename(uint64_t serial, Kind kind)
+{
+    char buffer[sizeof(INVERTERDATACACHE_DIRECTORY) + 22];
+    snprintf(buffer, sizeof(buffer), INVERTERDATACACHE_DIRECTORY "/%0" PRIx32 "%08" PRIx32 ".%s",
+        static_cast<uint32_t>((serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(serial & 0xFFFFFFFF),
+        kindSuffix[kind]);
+    return buffer;
+}
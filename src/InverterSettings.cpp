@@ -3,9 +3,12 @@
  * Copyright (C) 2023-2024 Thomas Basler and others
  */
 #include "InverterSettings.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
 #include "MessageOutput.h"
 #include "PinMapping.h"
+#include "PowerManagement.h"
+#include "Scheduler.h"
 #include "SunPosition.h"
 #include <Hoymiles.h>
 #include <SpiManager.h>
@@ -13,8 +16,8 @@
 InverterSettingsClass InverterSettings;
 
 InverterSettingsClass::InverterSettingsClass()
-    : _settingsTask(INVERTER_UPDATE_SETTINGS_INTERVAL, TASK_FOREVER, std::bind(&InverterSettingsClass::settingsLoop, this))
-    , _hoyTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&InverterSettingsClass::hoyLoop, this))
+    : _settingsTask(INVERTER_UPDATE_SETTINGS_INTERVAL, TASK_FOREVER, TaskMonitor.wrap("InverterSettings::settingsLoop", std::bind(&InverterSettingsClass::settingsLoop, this)))
+    , _hoyTask(_hoyLoopIntervalMs * TASK_MILLISECOND, TASK_FOREVER, TaskMonitor.wrap("InverterSettings::hoyLoop", std::bind(&InverterSettingsClass::hoyLoop, this)))
 {
 }
 
@@ -37,23 +40,43 @@ void InverterSettingsClass::init(Scheduler& scheduler)
             SPIClass* spiClass = new SPIClass(*spi_bus);
             spiClass->begin(pin.nrf24_clk, pin.nrf24_miso, pin.nrf24_mosi, pin.nrf24_cs);
             Hoymiles.initNRF(spiClass, pin.nrf24_en, pin.nrf24_irq);
+
+            if (PinMapping.isValidNrf24Config(1)) {
+                MessageOutput.println("  Adding second NRF24 module... ");
+                Hoymiles.addNRF(pin.nrf24_en2, pin.nrf24_cs2, pin.nrf24_irq2);
+            }
+            if (PinMapping.isValidNrf24Config(1) && PinMapping.isValidNrf24Config(2)) {
+                MessageOutput.println("  Adding third NRF24 module... ");
+                Hoymiles.addNRF(pin.nrf24_en3, pin.nrf24_cs3, pin.nrf24_irq3);
+            }
         }
 
         if (PinMapping.isValidCmt2300Config()) {
             Hoymiles.initCMT(pin.cmt_sdio, pin.cmt_clk, pin.cmt_cs, pin.cmt_fcs, pin.cmt_gpio2, pin.cmt_gpio3);
-            MessageOutput.println("  Setting country mode... ");
-            Hoymiles.getRadioCmt()->setCountryMode(static_cast<CountryModeId_t>(config.Dtu.Cmt.CountryMode));
-            MessageOutput.println("  Setting CMT target frequency... ");
-            Hoymiles.getRadioCmt()->setInverterTargetFrequency(config.Dtu.Cmt.Frequency);
         }
 
-        MessageOutput.println("  Setting radio PA level... ");
-        Hoymiles.getRadioNrf()->setPALevel((rf24_pa_dbm_e)config.Dtu.Nrf.PaLevel);
-        Hoymiles.getRadioCmt()->setPALevel(config.Dtu.Cmt.PaLevel);
+        // locked like any later reconfiguration, see WebApiDtuClass
+        Hoymiles.withRadios([&config]() {
+            if (PinMapping.isValidCmt2300Config()) {
+                MessageOutput.println("  Setting country mode... ");
+                Hoymiles.getRadioCmt()->setCountryMode(static_cast<CountryModeId_t>(config.Dtu.Cmt.CountryMode));
+                MessageOutput.println("  Setting CMT target frequency... ");
+                Hoymiles.getRadioCmt()->setInverterTargetFrequency(config.Dtu.Cmt.Frequency);
+                Hoymiles.getRadioCmt()->setFrequencyAgility(config.Dtu.Cmt.FrequencyAgility);
+            }
+
+            MessageOutput.println("  Setting radio PA level... ");
+            for (uint8_t i = 0; i < Hoymiles.getNumRadiosNrf(); i++) {
+                Hoymiles.getRadioNrf(i)->setPALevel((rf24_pa_dbm_e)config.Dtu.Nrf.PaLevel);
+            }
+            Hoymiles.getRadioCmt()->setPALevel(config.Dtu.Cmt.PaLevel);
 
-        MessageOutput.println("  Setting DTU serial... ");
-        Hoymiles.getRadioNrf()->setDtuSerial(config.Dtu.Serial);
-        Hoymiles.getRadioCmt()->setDtuSerial(config.Dtu.Serial);
+            MessageOutput.println("  Setting DTU serial... ");
+            for (uint8_t i = 0; i < Hoymiles.getNumRadiosNrf(); i++) {
+                Hoymiles.getRadioNrf(i)->setDtuSerial(config.Dtu.Serial);
+            }
+            Hoymiles.getRadioCmt()->setDtuSerial(config.Dtu.Serial);
+        });
 
         MessageOutput.println("  Setting poll interval... ");
         Hoymiles.setPollInterval(config.Dtu.PollInterval);
@@ -69,7 +92,8 @@ void InverterSettingsClass::init(Scheduler& scheduler)
                     config.Inverter[i].Name);
                 auto inv = Hoymiles.addInverter(
                     config.Inverter[i].Name,
-                    config.Inverter[i].Serial);
+                    config.Inverter[i].Serial,
+                    config.Inverter[i].NrfRadio);
 
                 if (inv != nullptr) {
                     inv->setReachableThreshold(config.Inverter[i].ReachableThreshold);
@@ -90,6 +114,16 @@ void InverterSettingsClass::init(Scheduler& scheduler)
         MessageOutput.println("Invalid pin config");
     }
 
+    // the radios are serviced by a task of their own, such that long
+    // running scheduler tasks do not delay receiving and sending.
+    uint32_t constexpr stackSize = 6144;
+    if (pdPASS != xTaskCreatePinnedToCore(InverterSettingsClass::radioLoopHelper,
+                "Radio", stackSize, this, 5/*prio*/, &_radioTaskHandle,
+                CONTROL_PLANE_CORE)) {
+        MessageOutput.println("Failed to start radio task");
+        _radioTaskHandle = nullptr;
+    }
+
     scheduler.addTask(_hoyTask);
     _hoyTask.enable();
 
@@ -101,6 +135,7 @@ void InverterSettingsClass::settingsLoop()
 {
     const CONFIG_T& config = Configuration.get();
     const bool isDayPeriod = SunPosition.isDayPeriod();
+    bool anyReachable = false;
 
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
         auto const& inv_cfg = config.Inverter[i];
@@ -114,10 +149,53 @@ void InverterSettingsClass::settingsLoop()
 
         inv->setEnablePolling(inv_cfg.Poll_Enable && (isDayPeriod || inv_cfg.Poll_Enable_Night));
         inv->setEnableCommands(inv_cfg.Command_Enable && (isDayPeriod || inv_cfg.Command_Enable_Night));
+        anyReachable |= inv->isReachable();
+    }
+
+    updateNightMode(isDayPeriod, anyReachable);
+}
+
+void InverterSettingsClass::updateNightMode(const bool isDayPeriod, const bool anyReachable)
+{
+    // polling resumes a while before sunrise, such that the first answer
+    // is not delayed by the slow night probes
+    const bool isNight = !isDayPeriod && !SunPosition.isSunriseWithin(_nightModeSunriseLeadSeconds);
+
+    Hoymiles.setNightMode(Configuration.get().Dtu.NightMode && isNight && !anyReachable);
+
+    // the power management scales the CPU clock down once the radios are
+    // idle, if it is available
+    if (Hoymiles.getNightMode() && _cpuFrequencyMhz == 0 && !PowerManagement.isEnabled()) {
+        _cpuFrequencyMhz = getCpuFrequencyMhz();
+        if (_cpuFrequencyMhz > _nightCpuFrequencyMhz && setCpuFrequencyMhz(_nightCpuFrequencyMhz)) {
+            MessageOutput.printf("Night mode: CPU frequency reduced to %" PRIu32 " MHz\r\n", _nightCpuFrequencyMhz);
+        } else {
+            _cpuFrequencyMhz = 0;
+        }
+    }
+}
+
+void InverterSettingsClass::radioLoopHelper(void* context)
+{
+    static_cast<InverterSettingsClass*>(context)->radioLoop();
+}
+
+void InverterSettingsClass::radioLoop()
+{
+    while (true) {
+        Hoymiles.loop();
+        vTaskDelay(pdMS_TO_TICKS(_radioLoopIntervalMs));
     }
 }
 
 void InverterSettingsClass::hoyLoop()
 {
-    Hoymiles.loop();
+    Hoymiles.dispatchCommandCompletions();
+
+    // night mode ends as soon as an inverter answers
+    if (_cpuFrequencyMhz != 0 && !Hoymiles.getNightMode()) {
+        setCpuFrequencyMhz(_cpuFrequencyMhz);
+        MessageOutput.printf("Night mode: CPU frequency restored to %" PRIu32 " MHz\r\n", _cpuFrequencyMhz);
+        _cpuFrequencyMhz = 0;
+    }
 }
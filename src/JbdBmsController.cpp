@@ -1,4 +1,6 @@
 #include <Arduino.h>
+#include <algorithm>
+#include <cstdlib>
 #include <numeric>
 #include "Configuration.h"
 #include "HardwareSerial.h"
@@ -20,11 +22,11 @@ bool Controller::init(bool verboseLogging)
     if (Interface::Transceiver != getInterface()) { ifcType = "TTL-UART"; }
     MessageOutput.printf("[JBD BMS] Initialize %s interface...\r\n", ifcType.c_str());
 
-    const PinMapping_t& pin = PinMapping.get();
+    auto const pin = getPins();
     MessageOutput.printf("[JBD BMS] rx = %d, rxen = %d, tx = %d, txen = %d\r\n",
-            pin.battery_rx, pin.battery_rxen, pin.battery_tx, pin.battery_txen);
+            pin.rx, pin.rxen, pin.tx, pin.txen);
 
-    if (pin.battery_rx < 0 || pin.battery_tx < 0) {
+    if (pin.rx < 0 || pin.tx < 0) {
         MessageOutput.println("[JBD BMS] Invalid RX/TX pin config");
         return false;
     }
@@ -32,20 +34,20 @@ bool Controller::init(bool verboseLogging)
 #ifdef JBDBMS_DUMMY_SERIAL
     _upSerial = std::make_unique<DummySerial>();
 #else
-    auto oHwSerialPort = SerialPortManager.allocatePort(_serialPortOwner);
+    auto oHwSerialPort = SerialPortManager.allocatePort(getSerialPortOwner(_serialPortOwner));
     if (!oHwSerialPort) { return false; }
 
-    _upSerial = std::make_unique<HardwareSerial>(*oHwSerialPort);
+    _upSerial = SerialPortManager.createSerial(*oHwSerialPort);
 #endif
 
     _upSerial->end(); // make sure the UART will be re-initialized
-    _upSerial->begin(9600, SERIAL_8N1, pin.battery_rx, pin.battery_tx);
+    _upSerial->begin(9600, SERIAL_8N1, pin.rx, pin.tx);
     _upSerial->flush();
 
     if (Interface::Transceiver != getInterface()) { return true; }
 
-    _rxEnablePin = pin.battery_rxen;
-    _txEnablePin = pin.battery_txen;
+    _rxEnablePin = pin.rxen;
+    _txEnablePin = pin.txen;
 
     if (_rxEnablePin < 0 || _txEnablePin < 0) {
         MessageOutput.println("[JBD BMS] Invalid transceiver pin config");
@@ -65,7 +67,7 @@ void Controller::deinit()
     if (_rxEnablePin > 0) { pinMode(_rxEnablePin, INPUT); }
     if (_txEnablePin > 0) { pinMode(_txEnablePin, INPUT); }
 
-    SerialPortManager.freePort(_serialPortOwner);
+    SerialPortManager.freePort(getSerialPortOwner(_serialPortOwner));
 }
 
 Controller::Interface Controller::getInterface() const
@@ -106,37 +108,56 @@ void Controller::announceStatus(Controller::Status status)
     _lastStatusPrinted = millis();
 }
 
-void Controller::sendRequest(uint8_t pollInterval)
+uint32_t Controller::getPollIntervalMs() const
+{
+    auto const& config = Configuration.get();
+    uint32_t intervalMs = config.Battery.JkBmsPollingInterval * 1000;
+
+    if (static_cast<int32_t>(_fastPollingUntil - millis()) > 0) {
+        intervalMs = std::min(intervalMs, _fastPollIntervalMs);
+    }
+
+    return intervalMs;
+}
+
+void Controller::startCycle()
+{
+    _cycleLength = 0;
+    _cycleIndex = 0;
+
+    if (_cycleCounter % _hardwareVersionEveryNthCycle == 0) {
+        _cycle[_cycleLength++] = Command::ReadHardwareVersionNumber;
+    }
+
+    _cycle[_cycleLength++] = Command::ReadBasicInformation;
+
+    if (_cycleCounter % _cellVoltagesEveryNthCycle == 0) {
+        _cycle[_cycleLength++] = Command::ReadCellVoltages;
+    }
+
+    ++_cycleCounter;
+    _lastCycleStart = millis();
+}
+
+void Controller::sendRequest()
 {
     if (ReadState::Idle != _readState) {
         return announceStatus(Status::BusyReading);
     }
 
-    if ((millis() - _lastRequest) < pollInterval * 1000) {
-        return announceStatus(Status::WaitingForPollInterval);
+    if (_cycleIndex >= _cycleLength) {
+        if ((millis() - _lastCycleStart) < getPollIntervalMs()) {
+            return announceStatus(Status::WaitingForPollInterval);
+        }
+
+        startCycle();
     }
 
     if (!_upSerial->availableForWrite()) {
         return announceStatus(Status::HwSerialNotAvailableForWrite);
     }
 
-    SerialCommand::Command cmd;
-    switch (SerialCommand::getLastCommand()) {
-        case SerialCommand::Command::Init: // read only once
-            cmd = SerialCommand::Command::ReadHardwareVersionNumber;
-            break;
-        case SerialCommand::Command::ReadBasicInformation:
-            cmd = SerialCommand::Command::ReadCellVoltages;
-            break;
-        case SerialCommand::Command::ReadCellVoltages:
-            cmd = SerialCommand::Command::ReadBasicInformation;
-            break;
-        default:
-            cmd = SerialCommand::Command::ReadBasicInformation;
-            break;
-    }
-
-    SerialCommand readCmd(SerialCommand::Status::Read, cmd);
+    SerialCommand readCmd(SerialCommand::Status::Read, _cycle[_cycleIndex]);
 
     if (Interface::Transceiver == getInterface()) {
         digitalWrite(_rxEnablePin, HIGH); // disable reception (of our own data)
@@ -159,19 +180,17 @@ void Controller::sendRequest(uint8_t pollInterval)
 
 void Controller::loop()
 {
-    auto const& config = Configuration.get();
-    uint8_t pollInterval = config.Battery.JkBmsPollingInterval;
-
     while (_upSerial->available()) {
         rxData(_upSerial->read());
     }
 
-    sendRequest(pollInterval);
-
-    if (millis() > _lastRequest + 2 * pollInterval * 1000 + 250) {
+    if (ReadState::Idle != _readState && millis() - _lastRequest > _responseTimeoutMs) {
         reset();
+        abortCycle();
         return announceStatus(Status::Timeout);
     }
+
+    sendRequest();
 }
 
 void Controller::rxData(uint8_t inbyte)
@@ -247,26 +266,46 @@ void Controller::frameComplete()
     }
 
     auto pResponse = std::make_unique<SerialResponse>(std::move(_buffer));
+    bool expected = _cycleIndex < _cycleLength &&
+        pResponse->getCommand() == _cycle[_cycleIndex];
+
     if (pResponse->isValid()) {
         processDataPoints(pResponse->getDataPoints());
+        if (expected) { ++_cycleIndex; }
     } // if invalid, error message has been produced by SerialResponse c'tor
+    else if (expected) {
+        abortCycle(); // retry with the next cycle
+    }
 
     reset();
+
+    // send the next request of this cycle right away rather than waiting
+    // for the next loop iteration, as the BMS is ready to respond
+    if (expected && _cycleIndex < _cycleLength) { sendRequest(); }
 }
 
 void Controller::processDataPoints(DataPointContainer const& dataPoints)
 {
     _stats->updateFrom(dataPoints);
 
+    auto oCurrent = dataPoints.get<DataPointLabel::BatteryCurrentMilliAmps>();
+    if (oCurrent.has_value()) {
+        if (_oLastCurrentMilliAmps.has_value() &&
+                std::abs(*oCurrent - *_oLastCurrentMilliAmps) >= _fastPollingCurrentDeltaMilliAmps) {
+            _fastPollingUntil = millis() + _fastPollingDurationMs;
+        }
+        _oLastCurrentMilliAmps = *oCurrent;
+    }
+
     if (!_verboseLogging) { return; }
 
     auto iter = dataPoints.cbegin();
     while ( iter != dataPoints.cend() ) {
         MessageOutput.printf("[%11.3f] JBD BMS: %s: %s%s\r\n",
             static_cast<double>(iter->second.getTimestamp())/1000,
-            iter->second.getLabelText().c_str(),
+            iter->second.getLabelText(),
             iter->second.getValueText().c_str(),
-            iter->second.getUnitText().c_str());
+            iter->second.getUnitText());
         ++iter;
     }
 }
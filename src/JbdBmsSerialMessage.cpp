@@ -76,11 +76,11 @@ SerialResponse::SerialResponse(tData&& raw)
         else if (getCommand() == Command::ReadCellVoltages)
         {
             uint8_t cellAmount = getDataLength() / 2;
-            std::map<uint8_t, uint16_t> voltages;
+            tCellVoltages voltages;
             for (size_t cellCounter = 0; cellCounter < cellAmount; ++cellCounter) {
                 uint8_t idx = cellCounter;
                 auto cellMilliVolt = get<uint16_t>(pos);
-                voltages[idx] = cellMilliVolt;
+                voltages.set(idx, cellMilliVolt);
             }
             _dp.add<Label::CellsMilliVolt>(voltages);
         }
@@ -18,11 +18,11 @@ bool Controller::init(bool verboseLogging)
     if (Interface::Transceiver != getInterface()) { ifcType = "TTL-UART"; }
     MessageOutput.printf("[JK BMS] Initialize %s interface...\r\n", ifcType.c_str());
 
-    const PinMapping_t& pin = PinMapping.get();
+    auto const pin = getPins();
     MessageOutput.printf("[JK BMS] rx = %d, rxen = %d, tx = %d, txen = %d\r\n",
-            pin.battery_rx, pin.battery_rxen, pin.battery_tx, pin.battery_txen);
+            pin.rx, pin.rxen, pin.tx, pin.txen);
 
-    if (pin.battery_rx < 0 || pin.battery_tx < 0) {
+    if (pin.rx < 0 || pin.tx < 0) {
         MessageOutput.println("[JK BMS] Invalid RX/TX pin config");
         return false;
     }
@@ -30,20 +30,20 @@ bool Controller::init(bool verboseLogging)
 #ifdef JKBMS_DUMMY_SERIAL
     _upSerial = std::make_unique<DummySerial>();
 #else
-    auto oHwSerialPort = SerialPortManager.allocatePort(_serialPortOwner);
+    auto oHwSerialPort = SerialPortManager.allocatePort(getSerialPortOwner(_serialPortOwner));
     if (!oHwSerialPort) { return false; }
 
-    _upSerial = std::make_unique<HardwareSerial>(*oHwSerialPort);
+    _upSerial = SerialPortManager.createSerial(*oHwSerialPort);
 #endif
 
     _upSerial->end(); // make sure the UART will be re-initialized
-    _upSerial->begin(115200, SERIAL_8N1, pin.battery_rx, pin.battery_tx);
+    _upSerial->begin(115200, SERIAL_8N1, pin.rx, pin.tx);
     _upSerial->flush();
 
     if (Interface::Transceiver != getInterface()) { return true; }
 
-    _rxEnablePin = pin.battery_rxen;
-    _txEnablePin = pin.battery_txen;
+    _rxEnablePin = pin.rxen;
+    _txEnablePin = pin.txen;
 
     if (_rxEnablePin < 0 || _txEnablePin < 0) {
         MessageOutput.println("[JK BMS] Invalid transceiver pin config");
@@ -63,7 +63,7 @@ void Controller::deinit()
     if (_rxEnablePin > 0) { pinMode(_rxEnablePin, INPUT); }
     if (_txEnablePin > 0) { pinMode(_txEnablePin, INPUT); }
 
-    SerialPortManager.freePort(_serialPortOwner);
+    SerialPortManager.freePort(getSerialPortOwner(_serialPortOwner));
 }
 
 Controller::Interface Controller::getInterface() const
@@ -158,7 +158,8 @@ void Controller::loop()
 
 void Controller::rxData(uint8_t inbyte)
 {
-    _buffer.push_back(inbyte);
+    if (_bufferLength >= _buffer.size()) { return reset(); }
+    _buffer[_bufferLength++] = inbyte;
 
     switch(_readState) {
         case ReadState::Idle: // unsolicited message from BMS
@@ -178,6 +179,8 @@ void Controller::rxData(uint8_t inbyte)
             break;
         case ReadState::FrameLengthMsbReceived:
             _frameLength |= inbyte;
+            // the frame length does not include the start marker
+            if (_frameLength < 2 || _frameLength + 2 > _buffer.size()) { break; }
             _frameLength -= 2; // length field already read
             return setReadState(ReadState::ReadingFrame);
             break;
@@ -195,7 +198,7 @@ void Controller::rxData(uint8_t inbyte)
 
 void Controller::reset()
 {
-    _buffer.clear();
+    _bufferLength = 0;
     return setReadState(ReadState::Idle);
 }
 
@@ -206,8 +209,8 @@ void Controller::frameComplete()
     if (_verboseLogging) {
         double ts = static_cast<double>(millis())/1000;
         MessageOutput.printf("[%11.3f] JK BMS: raw data (%d Bytes):",
-            ts, _buffer.size());
-        for (size_t ctr = 0; ctr < _buffer.size(); ++ctr) {
+            ts, _bufferLength);
+        for (size_t ctr = 0; ctr < _bufferLength; ++ctr) {
             if (ctr % 16 == 0) {
                 MessageOutput.printf("\r\n[%11.3f] JK BMS:", ts);
             }
@@ -216,9 +219,10 @@ void Controller::frameComplete()
         MessageOutput.println();
     }
 
-    auto pResponse = std::make_unique<SerialResponse>(std::move(_buffer), _protocolVersion);
-    if (pResponse->isValid()) {
-        processDataPoints(pResponse->getDataPoints());
+    SerialResponse response(SerialMessage::tData(_buffer.data(), _bufferLength),
+            _dataPoints, _protocolVersion);
+    if (response.isValid()) {
+        processDataPoints(response.getDataPoints());
     } // if invalid, error message has been produced by SerialResponse c'tor
 
     reset();
@@ -239,9 +243,9 @@ void Controller::processDataPoints(DataPointContainer const& dataPoints)
     while ( iter != dataPoints.cend() ) {
         MessageOutput.printf("[%11.3f] JK BMS: %s: %s%s\r\n",
             static_cast<double>(iter->second.getTimestamp())/1000,
-            iter->second.getLabelText().c_str(),
+            iter->second.getLabelText(),
             iter->second.getValueText().c_str(),
-            iter->second.getUnitText().c_str());
+            iter->second.getUnitText());
         ++iter;
     }
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <numeric>
 
 #include "JkBmsSerialMessage.h"
@@ -6,22 +7,23 @@
 namespace JkBms {
 
 SerialCommand::SerialCommand(SerialCommand::Command cmd)
-    : SerialMessage(20, 0x00)
+    : SerialMessage(tData(_frame.data(), _frame.size()))
 {
-    set(_raw.begin(), startMarker);
-    set(_raw.begin() + 2, static_cast<uint16_t>(_raw.size() - 2)); // frame length
-    set(_raw.begin() + 8, static_cast<uint8_t>(cmd));
-    set(_raw.begin() + 9, static_cast<uint8_t>(Source::Host));
-    set(_raw.begin() + 10, static_cast<uint8_t>(Type::Command));
-    set(_raw.end() - 5, endMarker);
-    updateChecksum();
+    set(0, startMarker);
+    set(2, static_cast<uint16_t>(_frame.size() - 2)); // frame length
+    set(8, static_cast<uint8_t>(cmd));
+    set(9, static_cast<uint8_t>(Source::Host));
+    set(10, static_cast<uint8_t>(Type::Command));
+    set(_frame.size() - 5, endMarker);
+    set(_frame.size() - 2, calcChecksum());
 }
 
 using Label = JkBms::DataPointLabel;
 template<Label L> using Traits = DataPointLabelTraits<L>;
 
-SerialResponse::SerialResponse(tData&& raw, uint8_t protocolVersion)
-    : SerialMessage(std::move(raw))
+SerialResponse::SerialResponse(tData raw, DataPointContainer& dp, uint8_t protocolVersion)
+    : SerialMessage(raw)
+    , _dp(dp)
 {
     if (!isValid()) { return; }
 
@@ -40,13 +42,16 @@ SerialResponse::SerialResponse(tData&& raw, uint8_t protocolVersion)
             case 0x79:
             {
                 uint8_t cellAmount = *(pos++) / 3;
-                std::map<uint8_t, uint16_t> voltages;
+
+                // update the cell voltages in place, such that the
+                // extremes are only recalculated if they changed.
+                auto& voltages = _dp.update<Label::CellsMilliVolt>();
+                if (voltages.size() != cellAmount) { voltages.clear(); }
                 for (size_t cellCounter = 0; cellCounter < cellAmount; ++cellCounter) {
                     uint8_t idx = *(pos++);
                     auto cellMilliVolt = get<uint16_t>(pos);
-                    voltages[idx] = cellMilliVolt;
+                    voltages.set(idx, cellMilliVolt);
                 }
-                _dp.add<Label::CellsMilliVolt>(voltages);
                 break;
             }
             case 0x80:
@@ -277,18 +282,15 @@ std::string SerialMessage::getString(It&& pos, size_t len, bool replaceZeroes) c
     auto start = pos;
     pos += len;
 
+    std::string res(start, pos);
     if (replaceZeroes) {
-        std::vector<uint8_t> copy(start, pos);
-        for (auto& c : copy) {
-            if (c == 0) { c = 0x20; } // replace by ASCII space
-        }
-        return std::string(copy.cbegin(), copy.cend());
+        std::replace(res.begin(), res.end(), '\0', ' ');
     }
 
-    return std::string(start, pos);
+    return res;
 }
 
-void SerialMessage::processBatteryCurrent(SerialMessage::tData::const_iterator& pos, uint8_t protocolVersion)
+void SerialResponse::processBatteryCurrent(SerialMessage::tData::const_iterator& pos, uint8_t protocolVersion)
 {
     uint16_t raw = get<uint16_t>(pos);
 
@@ -307,13 +309,13 @@ void SerialMessage::processBatteryCurrent(SerialMessage::tData::const_iterator&
 }
 
 template<typename T>
-void SerialMessage::set(tData::iterator const& pos, T val)
+void SerialCommand::set(size_t offset, T val)
 {
     // avoid out-of-bound write
-    if (std::distance(pos, _raw.end()) < sizeof(T)) { return; }
+    if (offset + sizeof(T) > _frame.size()) { return; }
 
     for (unsigned i = 0; i < sizeof(T); ++i) {
-        *(pos+i) = static_cast<uint8_t>(val >> (sizeof(T)-1-i)*8);
+        _frame[offset + i] = static_cast<uint8_t>(val >> (sizeof(T)-1-i)*8);
     }
 }
 
@@ -322,12 +324,14 @@ uint16_t SerialMessage::calcChecksum() const
     return std::accumulate(_raw.cbegin(), _raw.cend()-4, 0);
 }
 
-void SerialMessage::updateChecksum()
-{
-    set(_raw.end()-2, calcChecksum());
-}
-
 bool SerialMessage::isValid() const {
+    // start marker, frame length, terminal id, command, source, type,
+    // record number, end marker and checksum make up 20 bytes
+    if (_raw.size() < 20) {
+        MessageOutput.printf("JkBms::SerialMessage: frame too short (%d Bytes)\r\n", _raw.size());
+        return false;
+    }
+
     uint16_t const actualStartMarker = get<uint16_t>(_raw.cbegin());
     if (actualStartMarker != startMarker) {
         MessageOutput.printf("JkBms::SerialMessage: invalid start marker %04x, expected 0x%04x\r\n",
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "JsonArena.h"
+#include "MemoryPolicy.h"
+#include "MessageOutput.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+JsonArenaClass JsonArena;
+
+void JsonArenaClass::init()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // without PSRAM, we cannot afford to permanently reserve as much memory
+    _psram = MemoryPolicy::hasPsram();
+    size_t count = _psram ? 4 : 2;
+    _blockSize = _psram ? 16 * 1024 : 6 * 1024;
+
+    for (size_t i = 0; i < count; ++i) {
+        void* block = MemoryPolicy::allocate(_blockSize, MemoryPolicy::Placement::Bulk);
+        if (block == nullptr) { break; }
+        _blocks[_blockCount++] = static_cast<uint8_t*>(block);
+    }
+
+    MessageOutput.printf("[JsonArena] %u blocks of %u bytes in %s\r\n",
+            _blockCount, _blockSize, _psram ? "PSRAM" : "internal RAM");
+}
+
+uint8_t* JsonArenaClass::acquire()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (size_t i = 0; i < _blockCount; ++i) {
+        if (_inUse[i]) { continue; }
+        _inUse[i] = true;
+        ++_acquisitions;
+        return _blocks[i];
+    }
+
+    if (_blockCount > 0) { ++_exhausted; }
+    return nullptr;
+}
+
+void JsonArenaClass::release(uint8_t* block)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (size_t i = 0; i < _blockCount; ++i) {
+        if (_blocks[i] == block) { _inUse[i] = false; }
+    }
+}
+
+void JsonArenaClass::countOverflow()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_overflows;
+}
+
+void JsonArenaClass::serialize(JsonObject& target) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    target["blocks"] = _blockCount;
+    target["block_size"] = _blockSize;
+    target["psram"] = _psram;
+    target["in_use"] = std::count(_inUse.begin(), _inUse.begin() + _blockCount, true);
+    target["acquisitions"] = _acquisitions;
+    target["exhausted"] = _exhausted;
+    target["overflows"] = _overflows;
+}
+
+JsonArenaAllocator::~JsonArenaAllocator()
+{
+    if (_block != nullptr) { JsonArena.release(_block); }
+}
+
+bool JsonArenaAllocator::owns(void* ptr) const
+{
+    auto p = static_cast<uint8_t*>(ptr);
+    return _block != nullptr && p >= _block && p < _block + JsonArena.getBlockSize();
+}
+
+size_t& JsonArenaAllocator::sizeOf(void* ptr)
+{
+    return *reinterpret_cast<size_t*>(static_cast<uint8_t*>(ptr) - _headerSize);
+}
+
+void* JsonArenaAllocator::allocateFromBlock(size_t size)
+{
+    if (!_blockRequested) {
+        _block = JsonArena.acquire();
+        _blockRequested = true;
+    }
+
+    if (_block == nullptr) { return nullptr; }
+
+    size_t total = (_headerSize + size + _alignment - 1) & ~(_alignment - 1);
+    if (_used + total > JsonArena.getBlockSize()) {
+        JsonArena.countOverflow();
+        return nullptr;
+    }
+
+    void* ptr = _block + _used + _headerSize;
+    sizeOf(ptr) = size;
+    _used += total;
+    _last = ptr;
+    return ptr;
+}
+
+void* JsonArenaAllocator::allocate(size_t size)
+{
+    void* ptr = allocateFromBlock(size);
+    if (ptr != nullptr) { return ptr; }
+    return MemoryPolicy::allocate(size, MemoryPolicy::Placement::Bulk);
+}
+
+void JsonArenaAllocator::deallocate(void* ptr)
+{
+    if (!owns(ptr)) {
+        MemoryPolicy::release(ptr);
+        return;
+    }
+
+    // memory within the block is only reclaimed if it was the most recent
+    // allocation, otherwise it is reclaimed once the block is released.
+    if (ptr == _last) {
+        _used = static_cast<uint8_t*>(ptr) - _headerSize - _block;
+        _last = nullptr;
+    }
+}
+
+void* JsonArenaAllocator::reallocate(void* ptr, size_t newSize)
+{
+    if (ptr == nullptr) { return allocate(newSize); }
+
+    if (!owns(ptr)) { return MemoryPolicy::reallocate(ptr, newSize, MemoryPolicy::Placement::Bulk); }
+
+    // the most recent allocation can be resized in place
+    if (ptr == _last) {
+        size_t offset = static_cast<uint8_t*>(ptr) - _block;
+        size_t total = (newSize + _alignment - 1) & ~(_alignment - 1);
+        if (offset + total <= JsonArena.getBlockSize()) {
+            sizeOf(ptr) = newSize;
+            _used = offset + total;
+            return ptr;
+        }
+    }
+
+    void* newPtr = allocate(newSize);
+    if (newPtr == nullptr) { return nullptr; }
+
+    memcpy(newPtr, ptr, std::min(sizeOf(ptr), newSize));
+    deallocate(ptr);
+    return newPtr;
+}
@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "JsonPath.h"
+#include <cstdlib>
+#include <cstring>
+
+JsonPath::JsonPath(String const& path)
+    : _path(path)
+{
+    int start = 0;
+    while (start <= static_cast<int>(path.length())) {
+        int end = path.indexOf('/', start);
+        if (end < 0) { end = path.length(); }
+
+        String key = path.substring(start, end);
+        start = end + 1;
+
+        // handle double forward slashes and paths starting or ending with a slash
+        if (key.isEmpty()) { continue; }
+
+        if (key[0] == '[' && key[key.length() - 1] == ']') {
+            _segments.push_back({ String(), static_cast<int32_t>(key.substring(1, key.length() - 1).toInt()) });
+            continue;
+        }
+
+        _segments.push_back({ key, -1 });
+    }
+}
+
+namespace {
+
+class Scanner {
+public:
+    Scanner(char const* json, size_t len)
+        : _p(json), _end(json + len) { }
+
+    bool atEnd() const { return _p >= _end; }
+    char peek() const { return atEnd() ? 0 : *_p; }
+    size_t position(char const* json) const { return _p - json; }
+
+    void skipWhitespace()
+    {
+        while (!atEnd() && (*_p == ' ' || *_p == '\t' || *_p == '\r' || *_p == '\n')) { ++_p; }
+    }
+
+    bool consume(char c)
+    {
+        skipWhitespace();
+        if (peek() != c) { return false; }
+        ++_p;
+        return true;
+    }
+
+    // reads the next character of a string, resolving escape sequences
+    // of characters in the ASCII range. other code points yield a
+    // character which does not occur in keys, which is good enough to
+    // compare keys. returns false at the closing quote.
+    bool nextStringChar(char& c)
+    {
+        if (atEnd() || *_p == '"') { return false; }
+
+        c = *_p++;
+        if (c != '\\' || atEnd()) { return true; }
+
+        c = *_p++;
+        switch (c) {
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'u': {
+                if (_end - _p < 4) { _p = _end; return false; }
+                char hex[5] = { _p[0], _p[1], _p[2], _p[3], 0 };
+                _p += 4;
+                long cp = strtol(hex, nullptr, 16);
+                c = (cp > 0 && cp < 0x80) ? static_cast<char>(cp) : 0;
+                break;
+            }
+            default: break; // '"', '\\' and '/' stand for themselves
+        }
+
+        return true;
+    }
+
+    // expects the opening quote and consumes the string including the
+    // closing quote. returns whether the string equals the given key.
+    bool compareString(String const& key)
+    {
+        ++_p;
+        size_t i = 0;
+        bool equal = true;
+        char c;
+        while (nextStringChar(c)) {
+            if (i >= key.length() || key[i] != c) { equal = false; }
+            ++i;
+        }
+        if (atEnd()) { return false; }
+        ++_p; // closing quote
+        return equal && i == key.length();
+    }
+
+    bool skipString()
+    {
+        ++_p;
+        char c;
+        while (nextStringChar(c)) { }
+        if (atEnd()) { return false; }
+        ++_p;
+        return true;
+    }
+
+    bool skipValue()
+    {
+        skipWhitespace();
+        if (atEnd()) { return false; }
+
+        if (*_p == '"') { return skipString(); }
+
+        if (*_p != '{' && *_p != '[') {
+            while (!atEnd() && strchr(",}] \t\r\n", *_p) == nullptr) { ++_p; }
+            return true;
+        }
+
+        size_t depth = 0;
+        while (!atEnd()) {
+            char c = *_p;
+            if (c == '"') {
+                if (!skipString()) { return false; }
+                continue;
+            }
+            ++_p;
+            if (c == '{' || c == '[') { ++depth; }
+            if (c == '}' || c == ']') {
+                if (--depth == 0) { return true; }
+            }
+        }
+
+        return false;
+    }
+
+    // positions the scanner at the value of the member with the given key
+    // of the object at the current position.
+    bool findMember(String const& key)
+    {
+        if (!consume('{')) { return false; }
+        if (consume('}')) { return false; }
+
+        do {
+            skipWhitespace();
+            if (peek() != '"') { return false; }
+            bool match = compareString(key);
+            if (!consume(':')) { return false; }
+            if (match) { skipWhitespace(); return true; }
+            if (!skipValue()) { return false; }
+        } while (consume(','));
+
+        return false;
+    }
+
+    // positions the scanner at the element with the given index of the
+    // array at the current position.
+    bool findElement(int32_t index)
+    {
+        if (!consume('[')) { return false; }
+        if (consume(']')) { return false; }
+        if (index < 0) { return false; }
+
+        for (int32_t i = 0; i < index; ++i) {
+            if (!skipValue()) { return false; }
+            if (!consume(',')) { return false; }
+        }
+
+        skipWhitespace();
+        return !atEnd();
+    }
+
+    // copies the number or the contents of the string at the current
+    // position into the given buffer. truncates long values, which is
+    // fine as no float has that many significant digits.
+    bool readScalar(char* buf, size_t size, bool& isString)
+    {
+        skipWhitespace();
+        isString = peek() == '"';
+        if (isString) { ++_p; }
+
+        size_t i = 0;
+        char c;
+        while (true) {
+            if (isString) {
+                if (!nextStringChar(c)) { break; }
+            } else {
+                if (atEnd() || strchr(",}] \t\r\n", *_p) != nullptr) { break; }
+                c = *_p++;
+            }
+            if (i + 1 < size) { buf[i++] = c; }
+        }
+
+        buf[i] = 0;
+        return i > 0 || isString;
+    }
+
+private:
+    char const* _p;
+    char const* _end;
+};
+
+} // namespace
+
+std::pair<float, String> JsonPath::getFloat(char const* json, size_t len) const
+{
+    size_t constexpr kErrBufferSize = 256;
+    char errBuffer[kErrBufferSize];
+
+    Scanner scanner(json, len);
+
+    for (auto const& segment : _segments) {
+        size_t position = scanner.position(json);
+
+        if (segment.Key.isEmpty()) {
+            if (scanner.findElement(segment.Index)) { continue; }
+            snprintf(errBuffer, kErrBufferSize, "Unable to access JSON "
+                    "array index %li (JSON path '%s', position %u)",
+                    static_cast<long>(segment.Index), _path.c_str(),
+                    static_cast<unsigned>(position));
+            return { 0, String(errBuffer) };
+        }
+
+        if (scanner.findMember(segment.Key)) { continue; }
+        snprintf(errBuffer, kErrBufferSize, "Unable to access JSON key "
+                "'%s' (JSON path '%s', position %u)", segment.Key.c_str(),
+                _path.c_str(), static_cast<unsigned>(position));
+        return { 0, String(errBuffer) };
+    }
+
+    char value[32];
+    bool isString = false;
+    if (!scanner.readScalar(value, sizeof(value), isString)) {
+        snprintf(errBuffer, kErrBufferSize, "No value at JSON path '%s'", _path.c_str());
+        return { 0, String(errBuffer) };
+    }
+
+    char* parsedEnd = nullptr;
+    float res = strtof(value, &parsedEnd);
+    if (parsedEnd == value || (!isString && *parsedEnd != 0 && !isEmpty())) {
+        snprintf(errBuffer, kErrBufferSize, "Value '%s' at JSON path '%s' "
+                "cannot be converted to float", value, _path.c_str());
+        return { 0, String(errBuffer) };
+    }
+
+    return { res, "" };
+}
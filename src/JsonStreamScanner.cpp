@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "JsonStreamScanner.h"
+#include <cstdlib>
+#include <cstring>
+
+JsonStreamScanner::JsonStreamScanner(std::vector<String> const& paths)
+{
+    for (auto const& path : paths) {
+        std::vector<String> keys;
+        int start = 0;
+        while (true) {
+            int end = path.indexOf('.', start);
+            keys.push_back(path.substring(start, end < 0 ? path.length() : end));
+            if (end < 0) { break; }
+            start = end + 1;
+        }
+        _paths.push_back(std::move(keys));
+    }
+
+    reset();
+}
+
+void JsonStreamScanner::reset()
+{
+    _state = State::Value;
+    _stringIsKey = false;
+    _escape = false;
+    _depth = 0;
+    _numberLength = 0;
+}
+
+bool JsonStreamScanner::feed(char const* data, size_t length, callback_t const& callback)
+{
+    if (_state == State::Error) { return false; }
+
+    for (size_t i = 0; i < length; ++i) {
+        if (consume(data[i], callback)) { continue; }
+        _state = State::Error;
+        return false;
+    }
+
+    return true;
+}
+
+bool JsonStreamScanner::consume(char c, callback_t const& callback)
+{
+    switch (_state) {
+        case State::String: {
+            if (!_escape && c == '"') {
+                _state = _stringIsKey ? State::Colon : State::AfterValue;
+                return true;
+            }
+
+            // escaped characters are kept as is, which suffices to tell keys apart
+            bool escape = !_escape && c == '\\';
+            _escape = escape;
+            if (escape || !_stringIsKey || _depth > _maxDepth) { return true; }
+
+            auto& level = _levels[_depth - 1];
+            if (level.KeyLength < _maxKeyLength) {
+                level.Key[level.KeyLength++] = c;
+            } else {
+                level.KeyOverflow = true;
+            }
+            return true;
+        }
+
+        case State::Number:
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+                if (_numberLength < sizeof(_number) - 1) { _number[_numberLength++] = c; }
+                return true;
+            }
+            endNumber(callback);
+            _state = State::AfterValue;
+            break; // the character terminating the number is processed below
+
+        case State::Literal:
+            if (c >= 'a' && c <= 'z') { return true; }
+            _state = State::AfterValue;
+            break;
+
+        default:
+            break;
+    }
+
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') { return true; }
+
+    switch (_state) {
+        case State::Value:
+            // an empty array
+            if (c == ']' && _depth > 0 && _depth <= _maxDepth && _levels[_depth - 1].IsArray) {
+                endContainer();
+                return true;
+            }
+            return beginValue(c);
+
+        case State::ObjectKey:
+            if (c == '}') {
+                endContainer();
+                return true;
+            }
+            if (c != '"') { return false; }
+            if (_depth <= _maxDepth) {
+                auto& level = _levels[_depth - 1];
+                level.KeyLength = 0;
+                level.KeyOverflow = false;
+            }
+            _stringIsKey = true;
+            _state = State::String;
+            return true;
+
+        case State::Colon:
+            if (c != ':') { return false; }
+            _state = State::Value;
+            return true;
+
+        case State::AfterValue: {
+            if (_depth == 0) { return false; }
+            bool isArray = _depth <= _maxDepth && _levels[_depth - 1].IsArray;
+            if (c == ',') {
+                _state = isArray ? State::Value : State::ObjectKey;
+                return true;
+            }
+            if (c == (isArray ? ']' : '}')) {
+                endContainer();
+                return true;
+            }
+            // too deeply nested to know the type of the container
+            if (_depth > _maxDepth && (c == ']' || c == '}')) {
+                endContainer();
+                return true;
+            }
+            return false;
+        }
+
+        default:
+            return false;
+    }
+}
+
+bool JsonStreamScanner::beginValue(char c)
+{
+    if (c == '{' || c == '[') {
+        if (_depth < _maxDepth) {
+            auto& level = _levels[_depth];
+            level.IsArray = c == '[';
+            level.KeyLength = 0;
+            level.KeyOverflow = false;
+        }
+        _depth++;
+        _state = (c == '{') ? State::ObjectKey : State::Value;
+        return true;
+    }
+
+    if (c == '"') {
+        _stringIsKey = false;
+        _state = State::String;
+        return true;
+    }
+
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        _number[0] = c;
+        _numberLength = 1;
+        _state = State::Number;
+        return true;
+    }
+
+    if (c == 't' || c == 'f' || c == 'n') {
+        _state = State::Literal;
+        return true;
+    }
+
+    return false;
+}
+
+void JsonStreamScanner::endContainer()
+{
+    _depth--;
+    _state = (_depth == 0) ? State::Done : State::AfterValue;
+}
+
+void JsonStreamScanner::endNumber(callback_t const& callback)
+{
+    _number[_numberLength] = '\0';
+    _numberLength = 0;
+
+    if (_depth == 0 || _depth > _maxDepth) { return; }
+
+    for (size_t p = 0; p < _paths.size(); ++p) {
+        auto const& keys = _paths[p];
+        if (keys.size() != _depth) { continue; }
+
+        bool match = true;
+        for (size_t i = 0; i < _depth && match; ++i) {
+            auto const& level = _levels[i];
+            match = !level.IsArray && !level.KeyOverflow
+                && keys[i].length() == level.KeyLength
+                && strncmp(keys[i].c_str(), level.Key, level.KeyLength) == 0;
+        }
+        if (!match) { continue; }
+
+        callback(p, strtof(_number, nullptr));
+    }
+}
@@ -3,6 +3,7 @@
  * Copyright (C) 2023-2024 Thomas Basler and others
  */
 #include "Led_Single.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
 #include "Datastore.h"
 #include "MqttSettings.h"
@@ -38,8 +39,8 @@ const uint8_t pwmTable[] = {
 #define LED_OFF 0
 
 LedSingleClass::LedSingleClass()
-    : _setTask(LEDSINGLE_UPDATE_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&LedSingleClass::setLoop, this))
-    , _outputTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&LedSingleClass::outputLoop, this))
+    : _setTask(LEDSINGLE_UPDATE_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, TaskMonitor.wrap("LedSingle::setLoop", std::bind(&LedSingleClass::setLoop, this)))
+    , _outputTask(TASK_IMMEDIATE, TASK_FOREVER, TaskMonitor.wrap("LedSingle::outputLoop", std::bind(&LedSingleClass::outputLoop, this)))
 {
 }
 
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "Measurement.h"
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr int8_t maxShift = 18; // 10^18 fits into int64_t
+
+constexpr std::array<int64_t, maxShift + 1> powersOfTen = [] {
+    std::array<int64_t, maxShift + 1> res = {};
+    res[0] = 1;
+    for (size_t i = 1; i < res.size(); ++i) { res[i] = res[i - 1] * 10; }
+    return res;
+}();
+
+int32_t saturate(int64_t value)
+{
+    if (value > std::numeric_limits<int32_t>::max()) { return std::numeric_limits<int32_t>::max(); }
+    if (value < std::numeric_limits<int32_t>::min()) { return std::numeric_limits<int32_t>::min(); }
+    return static_cast<int32_t>(value);
+}
+
+}; // namespace
+
+Measurement Measurement::fromScaled(int64_t mantissa, int8_t exponent, int8_t targetExponent)
+{
+    int shift = static_cast<int>(exponent) - targetExponent;
+
+    if (shift >= 0) {
+        if (mantissa == 0) { return { 0, targetExponent }; }
+
+        int64_t limit = std::numeric_limits<int64_t>::max();
+        if (shift <= maxShift) { limit /= powersOfTen[shift]; }
+        if (shift > maxShift || mantissa > limit || mantissa < -limit) {
+            auto extreme = mantissa > 0 ? std::numeric_limits<int32_t>::max() : std::numeric_limits<int32_t>::min();
+            return { extreme, targetExponent };
+        }
+        return { saturate(mantissa * powersOfTen[shift]), targetExponent };
+    }
+
+    if (-shift > maxShift) { return { 0, targetExponent }; }
+
+    int64_t divisor = powersOfTen[-shift];
+    int64_t quotient = mantissa / divisor;
+    int64_t remainder = mantissa % divisor;
+    if (remainder * 2 >= divisor) { ++quotient; }
+    if (remainder * 2 <= -divisor) { --quotient; }
+    return { saturate(quotient), targetExponent };
+}
+
+Measurement Measurement::fromFloat(float value, int8_t targetExponent)
+{
+    double scaled = std::round(static_cast<double>(value) * std::pow(10.0, -targetExponent));
+    if (!(scaled < static_cast<double>(std::numeric_limits<int32_t>::max()))) {
+        return { std::isnan(scaled) ? 0 : std::numeric_limits<int32_t>::max(), targetExponent };
+    }
+    if (scaled < std::numeric_limits<int32_t>::min()) {
+        return { std::numeric_limits<int32_t>::min(), targetExponent };
+    }
+    return { static_cast<int32_t>(scaled), targetExponent };
+}
+
+float Measurement::toFloat() const
+{
+    if (Exponent >= 0 && Exponent <= maxShift) {
+        return static_cast<float>(Mantissa * static_cast<double>(powersOfTen[Exponent]));
+    }
+    if (Exponent < 0 && -Exponent <= maxShift) {
+        return static_cast<float>(Mantissa / static_cast<double>(powersOfTen[-Exponent]));
+    }
+    return static_cast<float>(Mantissa * std::pow(10.0, Exponent));
+}
+
+size_t Measurement::format(char* buffer, size_t size) const
+{
+    if (size == 0) { return 0; }
+
+    // the digits of the magnitude, least significant first
+    char digits[10];
+    size_t count = 0;
+    uint32_t magnitude = Mantissa < 0 ? 0U - static_cast<uint32_t>(Mantissa) : Mantissa;
+    do {
+        digits[count++] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    bool negative = Mantissa < 0;
+    size_t fraction = Exponent < 0 ? -Exponent : 0;
+    size_t trailingZeros = Exponent > 0 ? Exponent : 0;
+    size_t integerDigits = count > fraction ? count - fraction : 1;
+
+    size_t length = negative + integerDigits + trailingZeros + (fraction > 0 ? 1 + fraction : 0);
+    if (length + 1 > size) {
+        buffer[0] = '\0';
+        return 0;
+    }
+
+    char* p = buffer;
+    if (negative) { *p++ = '-'; }
+
+    // digit i of the mantissa (from the least significant), zero beyond
+    auto digit = [&](size_t i) { return i < count ? digits[i] : '0'; };
+
+    for (size_t i = integerDigits; i > 0; --i) { *p++ = digit(i - 1 + fraction); }
+    for (size_t i = 0; i < trailingZeros; ++i) { *p++ = '0'; }
+
+    if (fraction > 0) {
+        *p++ = '.';
+        for (size_t i = fraction; i > 0; --i) { *p++ = digit(i - 1); }
+    }
+
+    *p = '\0';
+    return length;
+}
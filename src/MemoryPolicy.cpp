@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "MemoryPolicy.h"
+#include <esp_heap_caps.h>
+
+namespace {
+
+uint32_t getCaps(MemoryPolicy::Placement placement)
+{
+    if (placement == MemoryPolicy::Placement::Internal) {
+        return MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    }
+    return MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+}
+
+class BulkJsonAllocator : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override
+    {
+        return MemoryPolicy::allocate(size, MemoryPolicy::Placement::Bulk);
+    }
+
+    void deallocate(void* ptr) override
+    {
+        MemoryPolicy::release(ptr);
+    }
+
+    void* reallocate(void* ptr, size_t newSize) override
+    {
+        return MemoryPolicy::reallocate(ptr, newSize, MemoryPolicy::Placement::Bulk);
+    }
+};
+
+BulkJsonAllocator sBulkJsonAllocator;
+
+}; // namespace
+
+bool MemoryPolicy::hasPsram()
+{
+    return heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+}
+
+void* MemoryPolicy::allocate(size_t size, Placement placement)
+{
+    if (placement == Placement::Internal) {
+        return heap_caps_malloc(size, getCaps(placement));
+    }
+
+    // bulk memory falls back to internal RAM on boards without PSRAM
+    // and if the PSRAM is exhausted.
+    return heap_caps_malloc_prefer(size, 2, getCaps(placement), MALLOC_CAP_DEFAULT);
+}
+
+void* MemoryPolicy::reallocate(void* ptr, size_t size, Placement placement)
+{
+    if (placement == Placement::Internal) {
+        return heap_caps_realloc(ptr, size, getCaps(placement));
+    }
+
+    return heap_caps_realloc_prefer(ptr, size, 2, getCaps(placement), MALLOC_CAP_DEFAULT);
+}
+
+void MemoryPolicy::release(void* ptr)
+{
+    heap_caps_free(ptr);
+}
+
+ArduinoJson::Allocator* MemoryPolicy::getBulkJsonAllocator()
+{
+    return &sBulkJsonAllocator;
+}
@@ -4,29 +4,52 @@
  */
 #include <HardwareSerial.h>
 #include "MessageOutput.h"
+#include "Logging.h"
+#include "MemoryPolicy.h"
 #include "SyslogLogger.h"
+#include "WebApi_ws_hub.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstring>
 
 MessageOutputClass MessageOutput;
 
 MessageOutputClass::MessageOutputClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MessageOutputClass::loop, this))
+    : _defaultLogLevel(DTU_LOG_LEVEL_INFO)
+    , _maxLogLevel(DTU_LOG_LEVEL_INFO)
 {
+    // created as early as possible, such that messages written before the
+    // drain task is started are kept.
+    _ringBuffer = xRingbufferCreate(_ringBufferSize, RINGBUF_TYPE_NOSPLIT);
 }
 
 void MessageOutputClass::init(Scheduler& scheduler)
 {
-    scheduler.addTask(_loopTask);
-    _loopTask.enable();
+    if (_ringBuffer == nullptr) { return; }
+
+    // rarely read, so it may as well live in PSRAM
+    _backlog = static_cast<uint8_t*>(MemoryPolicy::allocate(_backlogSize, MemoryPolicy::Placement::Bulk));
+
+    // writing to the serial port may block, so the drain task must not
+    // keep more important tasks from running.
+    uint32_t constexpr stackSize = 4096;
+    if (pdPASS != xTaskCreate(MessageOutputClass::drainLoopHelper, "MessageOut",
+                stackSize, this, 1/*prio*/, &_drainTaskHandle)) {
+        _drainTaskHandle = nullptr;
+    }
 }
 
 void MessageOutputClass::register_ws_output(AsyncWebSocket* output)
 {
-    std::lock_guard<std::mutex> lock(_msgLock);
-
     _ws = output;
 }
 
-void MessageOutputClass::serialWrite(MessageOutputClass::message_t const& m)
+void MessageOutputClass::register_ws_hub(WebApiWsHubClass* hub)
+{
+    _wsHub = hub;
+}
+
+void MessageOutputClass::serialWrite(uint8_t const* data, size_t size)
 {
     // operator bool() of HWCDC returns false if the device is not attached to
     // a USB host. in general it makes sense to skip writing entirely if the
@@ -34,84 +57,322 @@ void MessageOutputClass::serialWrite(MessageOutputClass::message_t const& m)
     if (!Serial) { return; }
 
     size_t written = 0;
-    while (written < m.size()) {
-        written += Serial.write(m.data() + written, m.size() - written);
+    while (written < size) {
+        written += Serial.write(data + written, size - written);
     }
 }
 
-size_t MessageOutputClass::write(uint8_t c)
+MessageOutputClass::Slot* MessageOutputClass::acquireSlot()
 {
-    std::lock_guard<std::mutex> lock(_msgLock);
+    TaskHandle_t const task = xTaskGetCurrentTaskHandle();
 
-    auto res = _task_messages.emplace(xTaskGetCurrentTaskHandle(), message_t());
-    auto iter = res.first;
-    auto& message = iter->second;
+    for (auto& slot : _slots) {
+        if (slot.Owner.load(std::memory_order_acquire) == task) { return &slot; }
+    }
 
-    message.push_back(c);
+    for (auto& slot : _slots) {
+        TaskHandle_t expected = nullptr;
+        if (slot.Owner.compare_exchange_strong(expected, task, std::memory_order_acquire)) {
+            return &slot;
+        }
+    }
 
-    if (c == '\n') {
-        serialWrite(message);
-        _lines.emplace(std::move(message));
-        _task_messages.erase(iter);
+    return nullptr;
+}
+
+void MessageOutputClass::releaseSlot(Slot& slot)
+{
+    slot.Length = 0;
+    slot.Owner.store(nullptr, std::memory_order_release);
+}
+
+void MessageOutputClass::commitLine(Slot& slot)
+{
+    if (slot.Length == 0) { return; }
+
+    // without the ring buffer, we resort to writing synchronously
+    if (_ringBuffer == nullptr) {
+        serialWrite(slot.Data.data(), slot.Length);
+    } else if (xRingbufferSend(_ringBuffer, slot.Data.data(), slot.Length, 0) != pdTRUE) {
+        ++_droppedLines;
     }
 
-    return 1;
+    slot.Length = 0;
 }
 
-size_t MessageOutputClass::write(const uint8_t *buffer, size_t size)
+size_t MessageOutputClass::write(uint8_t c)
 {
-    std::lock_guard<std::mutex> lock(_msgLock);
+    return write(&c, 1);
+}
 
-    auto res = _task_messages.emplace(xTaskGetCurrentTaskHandle(), message_t());
-    auto iter = res.first;
-    auto& message = iter->second;
+size_t MessageOutputClass::write(const uint8_t *buffer, size_t size)
+{
+    Slot* pSlot = acquireSlot();
+    if (pSlot == nullptr) {
+        ++_droppedLines;
+        return size;
+    }
 
-    message.reserve(message.size() + size);
+    auto& slot = *pSlot;
 
     for (size_t idx = 0; idx < size; ++idx) {
         uint8_t c = buffer[idx];
 
-        message.push_back(c);
+        slot.Data[slot.Length++] = c;
 
-        if (c == '\n') {
-            serialWrite(message);
-            _lines.emplace(std::move(message));
-            message.clear();
-            message.reserve(size - idx - 1);
+        if (c == '\n' || slot.Length == slot.Data.size()) {
+            commitLine(slot);
         }
     }
 
-    if (message.empty()) { _task_messages.erase(iter); }
+    if (slot.Length == 0) { releaseSlot(slot); }
 
     return size;
 }
 
-void MessageOutputClass::loop()
+void MessageOutputClass::appendBacklog(uint8_t const* data, size_t size)
+{
+    if (_backlog == nullptr) { return; }
+
+    bool truncated = size > _backlogSize;
+    if (truncated) {
+        data += size - _backlogSize;
+        size = _backlogSize;
+    }
+
+    std::lock_guard<std::mutex> lock(_backlogMutex);
+
+    size_t end = (_backlogStart + _backlogLength) % _backlogSize;
+    size_t first = std::min(size, _backlogSize - end);
+    memcpy(_backlog + end, data, first);
+    memcpy(_backlog, data + first, size - first);
+
+    _backlogLength += size;
+    if (truncated || _backlogLength > _backlogSize) {
+        _backlogStart = (_backlogStart + _backlogLength - _backlogSize) % _backlogSize;
+        _backlogLength = _backlogSize;
+        _backlogWrapped = true;
+    }
+}
+
+std::shared_ptr<std::vector<uint8_t>> MessageOutputClass::getBacklog() const
+{
+    auto spBacklog = std::make_shared<std::vector<uint8_t>>();
+
+    std::lock_guard<std::mutex> lock(_backlogMutex);
+    if (_backlog == nullptr) { return spBacklog; }
+
+    // skip the remainder of the partially overwritten line
+    size_t skip = 0;
+    if (_backlogWrapped) {
+        while (skip < _backlogLength && _backlog[(_backlogStart + skip) % _backlogSize] != '\n') { ++skip; }
+        skip = std::min(skip + 1, _backlogLength);
+    }
+
+    size_t start = (_backlogStart + skip) % _backlogSize;
+    size_t length = _backlogLength - skip;
+    size_t first = std::min(length, _backlogSize - start);
+
+    spBacklog->reserve(length);
+    spBacklog->insert(spBacklog->end(), _backlog + start, _backlog + start + first);
+    spBacklog->insert(spBacklog->end(), _backlog, _backlog + (length - first));
+
+    return spBacklog;
+}
+
+void MessageOutputClass::output(uint8_t const* data, size_t size)
+{
+    serialWrite(data, size);
+
+    appendBacklog(data, size);
+
+    Syslog.write(data, size);
+
+    WebApiWsHubClass* hub = _wsHub;
+    if (hub != nullptr) { hub->publishText(WebApiWsHubClass::Topic::Console, data, size); }
+
+    AsyncWebSocket* ws = _ws;
+    if (ws == nullptr || ws->count() == 0) { return; }
+
+    // give slow websocket clients a moment before discarding the line
+    for (uint8_t attempt = 0; !ws->availableForWriteAll(); ++attempt) {
+        if (attempt == 10) { return; }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    ws->textAll(std::make_shared<message_t>(data, data + size));
+}
+
+void MessageOutputClass::releaseOrphanedSlots()
+{
+    // clean up (possibly filled) slots of deleted tasks
+    for (auto& slot : _slots) {
+        TaskHandle_t owner = slot.Owner.load(std::memory_order_acquire);
+        if (owner == nullptr || eTaskGetState(owner) != eDeleted) { continue; }
+        releaseSlot(slot);
+    }
+}
+
+void MessageOutputClass::drainLoopHelper(void* context)
 {
-    std::lock_guard<std::mutex> lock(_msgLock);
+    auto pInstance = static_cast<MessageOutputClass*>(context);
+    pInstance->drainLoop();
+}
+
+void MessageOutputClass::drainLoop()
+{
+    uint32_t lastCleanup = millis();
+
+    while (true) {
+        size_t size = 0;
+        size_t batched = 0;
+        auto pItem = static_cast<uint8_t*>(xRingbufferReceive(_ringBuffer, &size, pdMS_TO_TICKS(1000)));
+        while (pItem != nullptr) {
+            memcpy(_batch.data() + batched, pItem, size);
+            batched += size;
+            vRingbufferReturnItem(_ringBuffer, pItem);
+
+            // the next line might not fit, lines are at most _lineSize long
+            if (batched + _lineSize > _batch.size()) { break; }
 
-    // clean up (possibly filled) buffers of deleted tasks
-    auto map_iter = _task_messages.begin();
-    while (map_iter != _task_messages.end()) {
-        if (eTaskGetState(map_iter->first) == eDeleted) {
-            map_iter = _task_messages.erase(map_iter);
-            continue;
+            pItem = static_cast<uint8_t*>(xRingbufferReceive(_ringBuffer, &size, 0));
         }
 
-        ++map_iter;
+        if (batched > 0) { output(_batch.data(), batched); }
+
+        uint32_t dropped = _droppedLines;
+        if (dropped != _reportedDroppedLines) {
+            char line[64];
+            int len = snprintf(line, sizeof(line), "[MessageOutput] %u lines dropped\r\n",
+                    dropped - _reportedDroppedLines);
+            output(reinterpret_cast<uint8_t const*>(line), std::min<size_t>(len, sizeof(line) - 1));
+            _reportedDroppedLines = dropped;
+        }
+
+        if (millis() - lastCleanup > 1000) {
+            releaseOrphanedSlots();
+            lastCleanup = millis();
+        }
+    }
+}
+
+MessageOutputClass::LogTag const* MessageOutputClass::findLogTag(char const* tag) const
+{
+    size_t count = _logTagCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        if (strncmp(_logTags[i].Name.data(), tag, _maxLogTagLength) == 0) {
+            return &_logTags[i];
+        }
+    }
+
+    return nullptr;
+}
+
+bool MessageOutputClass::isLogLevelEnabled(char const* tag, uint8_t level) const
+{
+    // most messages are discarded here, without looking up the tag
+    if (level > _maxLogLevel.load(std::memory_order_relaxed)) { return false; }
+
+    return level <= getLogLevel(tag);
+}
+
+uint8_t MessageOutputClass::getLogLevel(char const* tag) const
+{
+    auto pTag = findLogTag(tag);
+    if (pTag == nullptr) { return _defaultLogLevel; }
+    return pTag->Level;
+}
+
+bool MessageOutputClass::setLogLevel(char const* tag, uint8_t level)
+{
+    std::lock_guard<std::mutex> lock(_logTagMutex);
+
+    level = std::min<uint8_t>(level, DTU_LOG_LEVEL_VERBOSE);
+
+    if (strcmp(tag, "*") == 0) {
+        _defaultLogLevel = level;
+    } else if (auto pTag = findLogTag(tag); pTag != nullptr) {
+        _logTags[pTag - _logTags.data()].Level = level;
+    } else {
+        size_t count = _logTagCount.load(std::memory_order_relaxed);
+        if (count == _logTags.size()) { return false; }
+
+        auto& newTag = _logTags[count];
+        strlcpy(newTag.Name.data(), tag, newTag.Name.size());
+        newTag.Level = level;
+        _logTagCount.store(count + 1, std::memory_order_release);
+    }
+
+    uint8_t maxLevel = _defaultLogLevel;
+    for (size_t i = 0; i < _logTagCount; ++i) {
+        maxLevel = std::max<uint8_t>(maxLevel, _logTags[i].Level);
+    }
+    _maxLogLevel = maxLevel;
+
+    return true;
+}
+
+void MessageOutputClass::printLogLevels()
+{
+    printf("[MessageOutput] default log level: %s\r\n", getLogLevelName(_defaultLogLevel));
+
+    size_t count = _logTagCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        printf("[MessageOutput] log level of '%s': %s\r\n",
+                _logTags[i].Name.data(), getLogLevelName(_logTags[i].Level));
     }
+}
 
-    if (!_ws) {
-        while (!_lines.empty()) {
-            Syslog.write(_lines.front().data(), _lines.front().size());
-            _lines.pop(); // do not hog memory
+void MessageOutputClass::log(uint8_t level, char const* tag, char const* format, ...)
+{
+    // reserve space for the line break, longer messages are truncated
+    char line[_lineSize];
+    size_t constexpr maxLen = sizeof(line) - 3;
+
+    int len = snprintf(line, maxLen + 1, "[%s] ", tag);
+    if (len < 0) { return; }
+    len = std::min<size_t>(len, maxLen);
+
+    va_list args;
+    va_start(args, format);
+    int msgLen = vsnprintf(line + len, maxLen + 1 - len, format, args);
+    va_end(args);
+    if (msgLen < 0) { return; }
+    len = std::min<size_t>(len + msgLen, maxLen);
+
+    line[len++] = '\r';
+    line[len++] = '\n';
+
+    write(reinterpret_cast<uint8_t const*>(line), len);
+}
+
+char const* MessageOutputClass::getLogLevelName(uint8_t level)
+{
+    switch (level) {
+        case DTU_LOG_LEVEL_NONE: return "none";
+        case DTU_LOG_LEVEL_ERROR: return "error";
+        case DTU_LOG_LEVEL_WARN: return "warn";
+        case DTU_LOG_LEVEL_INFO: return "info";
+        case DTU_LOG_LEVEL_DEBUG: return "debug";
+        case DTU_LOG_LEVEL_VERBOSE: return "verbose";
+    }
+
+    return "unknown";
+}
+
+bool MessageOutputClass::parseLogLevel(char const* name, uint8_t& level)
+{
+    for (uint8_t l = DTU_LOG_LEVEL_NONE; l <= DTU_LOG_LEVEL_VERBOSE; ++l) {
+        if (strcasecmp(name, getLogLevelName(l)) == 0) {
+            level = l;
+            return true;
         }
-        return;
     }
 
-    while (!_lines.empty() && _ws->availableForWriteAll()) {
-        Syslog.write(_lines.front().data(), _lines.front().size());
-        _ws->textAll(std::make_shared<message_t>(std::move(_lines.front())));
-        _lines.pop();
+    if (strlen(name) == 1 && name[0] >= '0' && name[0] <= '0' + DTU_LOG_LEVEL_VERBOSE) {
+        level = name[0] - '0';
+        return true;
     }
+
+    return false;
 }
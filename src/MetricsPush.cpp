@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "MetricsPush.h"
+#include "GzipEncoder.h"
+#include "MessageOutput.h"
+#include "MetricsRegistry.h"
+#include "NetworkSettings.h"
+#include "TaskMonitor.h"
+#include <sys/time.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+MetricsPushClass MetricsPush;
+
+namespace {
+
+// earlier timestamps mean the system time was not set, see getLocalTime()
+constexpr time_t minValidEpoch = (2016 - 1970) * 365 * 24 * 3600;
+
+// the amount of line protocol text compressed at once
+constexpr size_t encoderChunkSize = 512;
+
+}; // namespace
+
+void MetricsPushClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.setCallback(TaskMonitor.wrap("MetricsPush::loop", std::bind(&MetricsPushClass::loop, this)));
+    _loopTask.setIterations(TASK_FOREVER);
+    _loopTask.setInterval(1 * TASK_SECOND);
+    _loopTask.enable();
+
+    registerMetrics();
+}
+
+void MetricsPushClass::registerMetrics()
+{
+    using Type = MetricsRegistryClass::Type;
+
+    auto ifEnabled = [this](std::atomic<uint32_t> const& value) {
+        return [this, &value]() -> std::optional<float> {
+            if (!_enabled) { return std::nullopt; }
+            return value.load();
+        };
+    };
+
+    MetricsRegistry.add("opendtu_metrics_push_dropped_rounds", "Sampling rounds discarded as the push buffer was full",
+        Type::Counter, ifEnabled(_droppedRounds));
+    MetricsRegistry.add("opendtu_metrics_push_failures", "Failed pushes of metrics samples",
+        Type::Counter, ifEnabled(_pushFailures));
+    MetricsRegistry.add("opendtu_metrics_push_buffered_rounds", "Sampling rounds waiting to be pushed",
+        Type::Gauge, ifEnabled(_bufferedRounds));
+}
+
+void MetricsPushClass::loop()
+{
+    auto const& config = Configuration.get().MetricsPush;
+
+    if (config.Enabled != _enabled || memcmp(&config.HttpRequest, &_httpConfig, sizeof(_httpConfig)) != 0) {
+        updateSettings();
+    }
+
+    if (!_enabled || !_upHttpGetter) { return; }
+
+    uint32_t interval = std::max<uint32_t>(config.Interval, 1) * 1000;
+    if (_lastSampleMillis != 0 && (millis() - _lastSampleMillis) < interval) { return; }
+
+    sample();
+}
+
+void MetricsPushClass::updateSettings()
+{
+    auto const& config = Configuration.get().MetricsPush;
+
+    // waits for a push in progress, which uses the getter
+    if (_pollerJob != 0) {
+        HttpPoller.remove(_pollerJob);
+        _pollerJob = 0;
+    }
+    _upHttpGetter = nullptr;
+
+    _enabled = config.Enabled;
+    memcpy(&_httpConfig, &config.HttpRequest, sizeof(_httpConfig));
+
+    if (!_enabled) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rounds.clear();
+        _bufferedRounds = 0;
+        return;
+    }
+
+    auto upHttpGetter = std::make_unique<HttpGetter>(_httpConfig);
+    if (!upHttpGetter->init()) {
+        MessageOutput.printf("[MetricsPush] %s\r\n", upHttpGetter->getErrorText());
+        return;
+    }
+
+    upHttpGetter->addHeader("Content-Type", "text/plain; charset=utf-8");
+    upHttpGetter->addHeader("Content-Encoding", "gzip");
+    _upHttpGetter = std::move(upHttpGetter);
+
+    String hostname = NetworkSettings.getHostname();
+    _hostTag.clear();
+    appendEscaped(_hostTag, hostname.c_str(), hostname.length(), ",= ");
+
+    _pollerJob = HttpPoller.add({
+        [] { return std::max<uint32_t>(Configuration.get().MetricsPush.PushInterval, 1) * 1000; },
+        [this] { return push(); },
+        [this] { _upHttpGetter->prewarm(); }
+    });
+
+    MessageOutput.printf("[MetricsPush] pushing to %s\r\n", _httpConfig.Url);
+}
+
+void MetricsPushClass::sample()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < minValidEpoch) { return; }
+
+    _lastSampleMillis = millis();
+    MetricsRegistry.collect();
+
+    Round round = { 0, static_cast<int64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000, {} };
+    size_t count = MetricsRegistry.size();
+    round.Values.resize(count);
+
+    MetricsRegistryClass::Sample sample;
+    for (size_t i = 0; i < count; ++i) {
+        round.Values[i] = MetricsRegistry.getMetric(i, sample) ? sample.Value : NAN;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // the indices shift if metrics are registered after sampling started
+    if (!_rounds.empty() && _rounds.back().Values.size() != count) {
+        MessageOutput.println("[MetricsPush] metrics changed, discarding buffered samples");
+        _rounds.clear();
+    }
+
+    size_t maxRounds = std::max<size_t>(_maxBufferedValues / std::max<size_t>(count, 1), 1);
+    while (_rounds.size() >= maxRounds) {
+        _rounds.pop_front();
+        ++_droppedRounds;
+    }
+
+    round.Sequence = ++_sequence;
+    _rounds.push_back(std::move(round));
+    _bufferedRounds = _rounds.size();
+}
+
+bool MetricsPushClass::push()
+{
+    if (!NetworkSettings.isConnected()) { return false; }
+
+    auto upEncoder = std::make_unique<GzipEncoder>();
+    std::vector<uint8_t> body;
+    std::string lines;
+    size_t lineCount = 0;
+    uint32_t lastSequence = 0;
+
+    auto compress = [&]() {
+        upEncoder->write(reinterpret_cast<uint8_t const*>(lines.data()), lines.size(), body);
+        lines.clear();
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_rounds.empty()) { return true; }
+
+        size_t count = MetricsRegistry.size();
+        size_t rounds = 0;
+        MetricsRegistryClass::Sample sample;
+
+        for (auto const& round : _rounds) {
+            if (rounds++ >= _maxRoundsPerPush) { break; }
+            lastSequence = round.Sequence;
+
+            // sampled before the metrics changed
+            if (round.Values.size() != count) { continue; }
+
+            for (size_t i = 0; i < count; ++i) {
+                float value = round.Values[i];
+                if (!std::isfinite(value) || !MetricsRegistry.getMetric(i, sample)) { continue; }
+
+                appendLine(lines, _hostTag, sample.Name, sample.Labels, value, round.EpochMillis);
+                ++lineCount;
+
+                if (lines.size() >= encoderChunkSize) { compress(); }
+            }
+        }
+    }
+
+    bool success = true;
+
+    if (lineCount > 0) {
+        compress();
+        upEncoder->finish(body);
+        upEncoder = nullptr;
+
+        auto result = _upHttpGetter->performPostRequest(body.data(), body.size());
+        success = result;
+    }
+
+    if (!success) {
+        ++_pushFailures;
+        MessageOutput.printf("[MetricsPush] %s\r\n", _upHttpGetter->getErrorText());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    while (!_rounds.empty() && _rounds.front().Sequence <= lastSequence) {
+        _rounds.pop_front();
+    }
+    _bufferedRounds = _rounds.size();
+
+    return true;
+}
+
+void MetricsPushClass::appendEscaped(std::string& out, char const* text, size_t len, char const* special)
+{
+    for (size_t i = 0; i < len; ++i) {
+        if (strchr(special, text[i]) != nullptr) { out += '\\'; }
+        out += text[i];
+    }
+}
+
+void MetricsPushClass::appendLine(std::string& out, std::string const& hostTag,
+        char const* name, char const* labels, float value, int64_t epochMillis)
+{
+    appendEscaped(out, name, strlen(name), ", ");
+    out += ",host=";
+    out += hostTag;
+
+    // labels like lane="live",phase="1" become tags like lane=live,phase=1
+    char const* pos = labels;
+    while (pos != nullptr && *pos != '\0') {
+        char const* equals = strchr(pos, '=');
+        if (equals == nullptr || equals[1] != '"') { break; }
+
+        char const* begin = equals + 2;
+        char const* end = begin;
+        while (*end != '\0' && *end != '"') {
+            if (*end == '\\' && end[1] != '\0') { ++end; }
+            ++end;
+        }
+
+        // tags must not be empty
+        if (end > begin) {
+            out += ',';
+            appendEscaped(out, pos, equals - pos, ",= ");
+            out += '=';
+            appendEscaped(out, begin, end - begin, ",= ");
+        }
+
+        if (*end == '\0') { break; }
+        pos = end + 1;
+        if (*pos == ',') { ++pos; }
+    }
+
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), " value=%.9g %lld000000\n",
+            value, static_cast<long long>(epochMillis));
+    out += buffer;
+}
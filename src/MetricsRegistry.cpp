@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "MetricsRegistry.h"
+#include <Arduino.h>
+#include <cstring>
+#include <limits>
+
+MetricsRegistryClass MetricsRegistry;
+
+void MetricsRegistryClass::add(char const* name, char const* help, Type type, getter_t getter, char const* labels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // keeps the samples of a family together, exporters rely on it
+    size_t pos = _metrics.size();
+    for (size_t i = 0; i < _metrics.size(); ++i) {
+        if (strcmp(_metrics[i].Name, name) == 0) { pos = i + 1; }
+    }
+
+    _metrics.insert(_metrics.begin() + pos, { name, help, type, labels, std::move(getter) });
+    _values.insert(_values.begin() + pos, 0);
+    _valid.insert(_valid.begin() + pos, false);
+    _collected = false;
+}
+
+void MetricsRegistryClass::collect()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    uint32_t now = millis();
+    if (_collected && now - _lastCollectMillis < 1000) { return; }
+
+    for (size_t i = 0; i < _metrics.size(); ++i) {
+        auto oValue = _metrics[i].Getter();
+        _valid[i] = oValue.has_value();
+        _values[i] = oValue.value_or(0);
+    }
+
+    _lastCollectMillis = now;
+    _collected = true;
+}
+
+size_t MetricsRegistryClass::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _metrics.size();
+}
+
+bool MetricsRegistryClass::getSample(size_t index, Sample& sample) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (index >= _metrics.size() || !_valid[index]) { return false; }
+
+    auto const& metric = _metrics[index];
+    sample = { metric.Name, metric.Help, metric.MetricType, metric.Labels, _values[index] };
+    return true;
+}
+
+bool MetricsRegistryClass::getMetric(size_t index, Sample& sample) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (index >= _metrics.size()) { return false; }
+
+    auto const& metric = _metrics[index];
+    float value = _valid[index] ? _values[index] : std::numeric_limits<float>::quiet_NaN();
+    sample = { metric.Name, metric.Help, metric.MetricType, metric.Labels, value };
+    return true;
+}
+
+char const* MetricsRegistryClass::getTypeName(Type type)
+{
+    return (type == Type::Counter) ? "counter" : "gauge";
+}
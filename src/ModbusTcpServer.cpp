@@ -0,0 +1,359 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "ModbusTcpServer.h"
+#include "Battery.h"
+#include "Configuration.h"
+#include "Datastore.h"
+#include "MessageOutput.h"
+#include "NetworkSettings.h"
+#include "PowerLimiter.h"
+#include "PowerMeter.h"
+#include "TaskMonitor.h"
+#include <cmath>
+#include <cstring>
+
+ModbusTcpServerClass ModbusTcpServer;
+
+static constexpr uint8_t sIllegalFunction = 0x01;
+static constexpr uint8_t sIllegalDataAddress = 0x02;
+static constexpr uint8_t sIllegalDataValue = 0x03;
+static constexpr uint8_t sServerDeviceFailure = 0x04;
+
+static constexpr size_t sMbapSize = 7;
+
+namespace {
+
+class RegisterWriter {
+public:
+    explicit RegisterWriter(std::vector<uint16_t>& registers)
+        : _registers(registers) { }
+
+    void setUint16(size_t reg, uint32_t value)
+    {
+        _registers[reg] = std::min<uint32_t>(value, 0xFFFF);
+    }
+
+    void setUint64(size_t reg, uint64_t value)
+    {
+        for (size_t i = 0; i < 4; ++i) {
+            _registers[reg + i] = (value >> (16 * (3 - i))) & 0xFFFF;
+        }
+    }
+
+    void setFloat(size_t reg, float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        _registers[reg] = bits >> 16;
+        _registers[reg + 1] = bits & 0xFFFF;
+    }
+
+    void setField(size_t reg, StatisticsParser* stats, ChannelType_t type, ChannelNum_t channel, FieldId_t field)
+    {
+        setFloat(reg, stats->hasChannelFieldValue(type, channel, field)
+                ? stats->getChannelFieldValue(type, channel, field) : NAN);
+    }
+
+private:
+    std::vector<uint16_t>& _registers;
+};
+
+} // namespace
+
+void ModbusTcpServerClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.setCallback(TaskMonitor.wrap("ModbusTcpServer::loop", std::bind(&ModbusTcpServerClass::loop, this)));
+    _loopTask.setIterations(TASK_FOREVER);
+    _loopTask.setInterval(1 * TASK_SECOND);
+    _loopTask.enable();
+}
+
+void ModbusTcpServerClass::loop()
+{
+    auto const& config = Configuration.get().Modbus;
+
+    if (!config.Enabled || !NetworkSettings.isConnected()) {
+        stop();
+        return;
+    }
+
+    updateSnapshot();
+
+    if (_upServer && _port != config.Port) { stop(); }
+    if (!_upServer) { start(config.Port); }
+}
+
+void ModbusTcpServerClass::start(uint16_t port)
+{
+    _upServer = std::make_unique<AsyncServer>(port);
+    _upServer->onClient([this](void*, AsyncClient* client) { onClient(client); }, nullptr);
+    _upServer->setNoDelay(true);
+    _upServer->begin();
+    _port = port;
+
+    MessageOutput.printf("[ModbusTcpServer] Listening on port %u\r\n", port);
+}
+
+void ModbusTcpServerClass::stop()
+{
+    if (!_upServer) { return; }
+
+    _upServer->end();
+    _upServer.reset();
+
+    MessageOutput.println("[ModbusTcpServer] Stopped");
+}
+
+void ModbusTcpServerClass::updateSnapshot()
+{
+    uint8_t inverterCount = Hoymiles.getNumInverters();
+
+    auto spRegisters = std::make_shared<registers_t>(_inverterBase + inverterCount * _inverterSize, 0);
+    RegisterWriter w(*spRegisters);
+
+    w.setUint16(0, MapVersion);
+    w.setUint16(1, inverterCount);
+    w.setFloat(2, Datastore.getTotalAcPowerEnabled());
+    w.setFloat(4, Datastore.getTotalAcYieldDayEnabled());
+    w.setFloat(6, Datastore.getTotalAcYieldTotalEnabled());
+    w.setFloat(8, Datastore.getTotalDcPowerEnabled());
+    w.setUint16(10, (Datastore.getIsAllEnabledReachable() ? 0x01 : 0)
+            | (Datastore.getIsAtLeastOneProducing() ? 0x02 : 0));
+
+    auto const& config = Configuration.get();
+
+    auto spBattery = Battery.getStats();
+    bool battery = config.Battery.Enabled;
+    w.setFloat(20, (battery && spBattery->isSoCValid()) ? spBattery->getSoC() : NAN);
+    w.setFloat(22, (battery && spBattery->isVoltageValid()) ? spBattery->getVoltage() : NAN);
+    w.setFloat(24, (battery && spBattery->isCurrentValid()) ? spBattery->getChargeCurrent() : NAN);
+    w.setUint16(26, battery ? spBattery->getAgeSeconds() : 0xFFFF);
+
+    bool meter = config.PowerMeter.Enabled;
+    w.setFloat(30, meter ? PowerMeter.getPowerTotal() : NAN);
+    w.setUint16(32, (meter && PowerMeter.isDataValid()) ? 1 : 0);
+
+    w.setUint16(40, PowerLimiter.getPowerLimiterState());
+    w.setUint16(41, static_cast<uint16_t>(PowerLimiter.getMode()));
+    w.setUint16(42, std::max<int32_t>(PowerLimiter.getInverterOutput(), 0));
+    w.setUint16(43, PowerLimiter.getInverterUpdateTimeouts());
+
+    for (uint8_t i = 0; i < inverterCount; ++i) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        size_t base = _inverterBase + i * _inverterSize;
+        auto stats = inv->Statistics();
+
+        w.setUint64(base, inv->serial());
+        w.setUint16(base + 4, (inv->isReachable() ? 0x01 : 0) | (inv->isProducing() ? 0x02 : 0));
+        w.setUint16(base + 5, static_cast<uint32_t>(inv->SystemConfigPara()->getLimitPercent() * 10 + 0.5f));
+        w.setField(base + 6, stats, TYPE_AC, CH0, FLD_PAC);
+        w.setField(base + 8, stats, TYPE_AC, CH0, FLD_UAC);
+        w.setField(base + 10, stats, TYPE_AC, CH0, FLD_IAC);
+        w.setField(base + 12, stats, TYPE_AC, CH0, FLD_F);
+        w.setField(base + 14, stats, TYPE_AC, CH0, FLD_PF);
+        w.setField(base + 16, stats, TYPE_INV, CH0, FLD_T);
+        w.setField(base + 18, stats, TYPE_INV, CH0, FLD_EFF);
+        w.setField(base + 20, stats, TYPE_INV, CH0, FLD_YD);
+        w.setField(base + 22, stats, TYPE_INV, CH0, FLD_YT);
+        w.setField(base + 24, stats, TYPE_INV, CH0, FLD_PDC);
+        w.setUint16(base + 26, stats->getLastUpdate() > 0
+                ? (millis() - stats->getLastUpdate()) / 1000 : 0xFFFF);
+
+        for (auto& c : stats->getChannelsByType(TYPE_DC)) {
+            if (c >= 6) { break; }
+            size_t reg = base + 30 + 10 * c;
+            w.setField(reg, stats, TYPE_DC, c, FLD_PDC);
+            w.setField(reg + 2, stats, TYPE_DC, c, FLD_UDC);
+            w.setField(reg + 4, stats, TYPE_DC, c, FLD_IDC);
+            w.setField(reg + 6, stats, TYPE_DC, c, FLD_YD);
+            w.setField(reg + 8, stats, TYPE_DC, c, FLD_YT);
+        }
+    }
+
+    std::atomic_store(&_spRegisters, std::shared_ptr<registers_t const>(std::move(spRegisters)));
+}
+
+// executed by the AsyncTCP task, as all other methods below
+void ModbusTcpServerClass::onClient(AsyncClient* client)
+{
+    if (_clients >= _maxClients) {
+        client->close(true);
+        delete client;
+        return;
+    }
+
+    ++_clients;
+
+    auto rx = new std::vector<uint8_t>();
+
+    client->onData([this, rx](void*, AsyncClient* c, void* data, size_t len) {
+        onData(c, *rx, static_cast<uint8_t const*>(data), len);
+    }, nullptr);
+
+    client->onDisconnect([this, rx](void*, AsyncClient* c) {
+        --_clients;
+        delete rx;
+        delete c;
+    }, nullptr);
+
+    client->setRxTimeout(60);
+}
+
+void ModbusTcpServerClass::onData(AsyncClient* client, std::vector<uint8_t>& rx, uint8_t const* data, size_t len)
+{
+    rx.insert(rx.end(), data, data + len);
+
+    while (rx.size() >= sMbapSize) {
+        uint16_t protocol = (rx[2] << 8) | rx[3];
+        uint16_t length = (rx[4] << 8) | rx[5]; // unit id and PDU
+        if (protocol != 0 || length < 2 || length > 254) {
+            client->close();
+            return;
+        }
+
+        size_t frameSize = 6 + length;
+        if (rx.size() < frameSize) { return; } // wait for the rest
+
+        auto pdu = handleRequest(&rx[sMbapSize], length - 1);
+
+        std::vector<uint8_t> response(rx.begin(), rx.begin() + sMbapSize);
+        response[4] = (pdu.size() + 1) >> 8;
+        response[5] = (pdu.size() + 1) & 0xFF;
+        response.insert(response.end(), pdu.begin(), pdu.end());
+        client->write(reinterpret_cast<char const*>(response.data()), response.size());
+
+        rx.erase(rx.begin(), rx.begin() + frameSize);
+    }
+}
+
+std::vector<uint8_t> ModbusTcpServerClass::exception(uint8_t function, uint8_t code)
+{
+    return { static_cast<uint8_t>(function | 0x80), code };
+}
+
+std::vector<uint8_t> ModbusTcpServerClass::handleRequest(uint8_t const* pdu, size_t len)
+{
+    if (len < 1) { return exception(0, sIllegalFunction); }
+
+    uint8_t function = pdu[0];
+    auto getUint16 = [pdu](size_t offset) -> uint16_t {
+        return (pdu[offset] << 8) | pdu[offset + 1];
+    };
+
+    switch (function) {
+    case 0x03: // read holding registers
+    case 0x04: // read input registers
+        if (len != 5) { return exception(function, sIllegalDataValue); }
+        return handleRead(function, getUint16(1), getUint16(3));
+
+    case 0x06: { // write single register
+        if (len != 5) { return exception(function, sIllegalDataValue); }
+        uint16_t value = getUint16(3);
+        auto response = handleWrite(function, getUint16(1), &value, 1);
+        if (response.empty()) { return std::vector<uint8_t>(pdu, pdu + len); }
+        return response;
+    }
+
+    case 0x10: { // write multiple registers
+        if (len < 6) { return exception(function, sIllegalDataValue); }
+        uint16_t count = getUint16(3);
+        if (count < 1 || count > _maxWriteCount || pdu[5] != count * 2 || len != 6 + count * 2u) {
+            return exception(function, sIllegalDataValue);
+        }
+
+        std::vector<uint16_t> values(count);
+        for (uint16_t i = 0; i < count; ++i) { values[i] = getUint16(6 + i * 2); }
+
+        auto response = handleWrite(function, getUint16(1), values.data(), count);
+        if (response.empty()) { return std::vector<uint8_t>(pdu, pdu + 5); }
+        return response;
+    }
+
+    default:
+        return exception(function, sIllegalFunction);
+    }
+}
+
+std::vector<uint8_t> ModbusTcpServerClass::handleRead(uint8_t function, uint16_t address, uint16_t count)
+{
+    if (count < 1 || count > _maxReadCount) {
+        return exception(function, sIllegalDataValue);
+    }
+
+    auto spRegisters = std::atomic_load(&_spRegisters);
+    if (!spRegisters) { return exception(function, sServerDeviceFailure); }
+
+    if (static_cast<size_t>(address) + count > spRegisters->size()) {
+        return exception(function, sIllegalDataAddress);
+    }
+
+    std::vector<uint8_t> response = { function, static_cast<uint8_t>(count * 2) };
+    for (uint16_t i = 0; i < count; ++i) {
+        uint16_t value = (*spRegisters)[address + i];
+        response.push_back(value >> 8);
+        response.push_back(value & 0xFF);
+    }
+
+    return response;
+}
+
+// returns an empty vector on success, as the response depends on the function
+std::vector<uint8_t> ModbusTcpServerClass::handleWrite(uint8_t function, uint16_t address, uint16_t const* values, uint16_t count)
+{
+    if (!Configuration.get().Modbus.AllowWrite) {
+        return exception(function, sIllegalFunction);
+    }
+
+    // all registers written must be control registers of the same inverter
+    if (address < _inverterBase) { return exception(function, sIllegalDataAddress); }
+    uint16_t pos = (address - _inverterBase) / _inverterSize;
+    uint16_t offset = (address - _inverterBase) % _inverterSize;
+    if (offset < _controlOffset || offset + count > _controlOffset + _controlCount) {
+        return exception(function, sIllegalDataAddress);
+    }
+
+    auto inv = Hoymiles.getInverterByPos(pos);
+    if (inv == nullptr) { return exception(function, sIllegalDataAddress); }
+
+    for (uint16_t i = 0; i < count; ++i) {
+        uint8_t code = writeControlRegister(inv, offset + i, values[i]);
+        if (code != 0) { return exception(function, code); }
+    }
+
+    return {};
+}
+
+uint8_t ModbusTcpServerClass::writeControlRegister(std::shared_ptr<InverterAbstract> const& inv, uint16_t offset, uint16_t value)
+{
+    if (!inv->getEnableCommands()) { return sServerDeviceFailure; }
+
+    bool sent = false;
+
+    switch (offset - _controlOffset) {
+    case 0:
+        if (value > 1000) { return sIllegalDataValue; }
+        MessageOutput.printf("[ModbusTcpServer] Limit Non-Persistent: %.1f %%\r\n", value / 10.0);
+        sent = inv->sendActivePowerControlRequest(value / 10.0f, PowerLimitControlType::RelativNonPersistent);
+        break;
+    case 1:
+        MessageOutput.printf("[ModbusTcpServer] Limit Non-Persistent: %u W\r\n", value);
+        sent = inv->sendActivePowerControlRequest(value, PowerLimitControlType::AbsolutNonPersistent);
+        break;
+    case 2:
+        if (value > 1) { return sIllegalDataValue; }
+        MessageOutput.printf("[ModbusTcpServer] Set inverter to %s\r\n", value ? "on" : "off");
+        sent = inv->sendPowerControlRequest(value == 1);
+        break;
+    case 3:
+        if (value != 1) { return sIllegalDataValue; }
+        MessageOutput.println("[ModbusTcpServer] Restart inverter");
+        sent = inv->sendRestartControlRequest();
+        break;
+    default:
+        return sIllegalDataAddress;
+    }
+
+    return sent ? 0 : sServerDeviceFailure;
+}
@@ -67,6 +67,12 @@ bool MqttBattery::init(bool verboseLogging)
     return true;
 }
 
+std::shared_ptr<BatteryStats const> MqttBattery::getSnapshot()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats->clone();
+}
+
 void MqttBattery::deinit()
 {
     if (!_voltageTopic.isEmpty()) {
@@ -107,7 +113,10 @@ void MqttBattery::onMqttMessageSoC(espMqttClientTypes::MessageProperties const&
     }
     _socPrecision = std::max(_socPrecision, precision);
 
-    _stats->setSoC(*soc, _socPrecision, millis());
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats->setSoC(*soc, _socPrecision, millis());
+    }
 
     if (_verboseLogging) {
         MessageOutput.printf("MqttBattery: Updated SoC to %.*f from '%s'\r\n",
@@ -151,7 +160,10 @@ void MqttBattery::onMqttMessageVoltage(espMqttClientTypes::MessageProperties con
         return;
     }
 
-    _stats->setVoltage(*voltage, millis());
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats->setVoltage(*voltage, millis());
+    }
 
     if (_verboseLogging) {
         MessageOutput.printf("MqttBattery: Updated voltage to %.2f from '%s'\r\n",
@@ -186,7 +198,10 @@ void MqttBattery::onMqttMessageDischargeCurrentLimit(espMqttClientTypes::Message
         return;
     }
 
-    _stats->setDischargeCurrentLimit(*amperage, millis());
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats->setDischargeCurrentLimit(*amperage, millis());
+    }
 
     if (_verboseLogging) {
         MessageOutput.printf("MqttBattery: Updated amperage to %.2f from '%s'\r\n",
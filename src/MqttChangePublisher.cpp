@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "MqttChangePublisher.h"
+#include "MqttSettings.h"
+
+MqttChangePublisher::MqttChangePublisher(size_t count)
+    : _payloads(count)
+{
+}
+
+bool MqttChangePublisher::isRefreshDue() const
+{
+    return _refreshPending || (millis() - _lastRefresh) >= _refreshIntervalMs;
+}
+
+void MqttChangePublisher::beginRound()
+{
+    _refreshing = isRefreshDue();
+    if (!_refreshing) { return; }
+
+    _refreshPending = false;
+    _lastRefresh = millis();
+}
+
+void MqttChangePublisher::publish(size_t index, char const* subtopic, char const* payload)
+{
+    auto& last = _payloads[index];
+    if (!_refreshing && last == payload) { return; }
+
+    last = payload;
+    MqttSettings.publish(subtopic, last);
+}
@@ -1,9 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include "PylontechCanReceiver.h"
+#include "TaskMonitor.h"
 #include "Battery.h"
 #include "MqttHandleBatteryHass.h"
 #include "Configuration.h"
+#include "MemoryPolicy.h"
+#include "MqttHassPublisher.h"
 #include "MqttSettings.h"
 #include "MqttHandleHass.h"
 #include "Utils.h"
@@ -14,7 +17,7 @@ MqttHandleBatteryHassClass MqttHandleBatteryHass;
 void MqttHandleBatteryHassClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&MqttHandleBatteryHassClass::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("MqttHandleBatteryHass::loop", std::bind(&MqttHandleBatteryHassClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 }
@@ -38,6 +41,9 @@ void MqttHandleBatteryHassClass::loop()
     // to the MQTT broker or on config changes.
     if (!_doPublish) { return; }
 
+    // discovery messages are never dropped, so wait for the outbox to drain
+    if (!MqttSettings.hasOutboxRoom(MqttPublishPriority::Discovery)) { return; }
+
     // the MQTT battery provider does not re-publish the SoC under a different
     // known topic. we don't know the manufacture either. HASS auto-discovery
     // for that provider makes no sense.
@@ -252,6 +258,11 @@ void MqttHandleBatteryHassClass::loop()
             PBS("Reserved 3",                   "battery-alert-variant-outline", "Reserved3");
 #undef PBS
             break;
+        case 7: // aggregate of several batteries
+            publishSensor("Voltage", "mdi:battery-charging", "voltage", "voltage", "measurement", "V");
+            publishSensor("Current", "mdi:current-dc", "current", "current", "measurement", "A");
+            publishSensor("Discharge current limit", NULL, "settings/dischargeCurrentLimitation", "current", "measurement", "A");
+            break;
     }
 
     _doPublish = false;
@@ -276,7 +287,7 @@ void MqttHandleBatteryHassClass::publishSensor(const char* caption, const char*
     // statTopic.concat("/");
     statTopic.concat(subTopic);
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::getBulkJsonAllocator());
     root["name"] = caption;
     root["stat_t"] = statTopic;
     root["uniq_id"] = serial + "_" + sensorId;
@@ -332,7 +343,7 @@ void MqttHandleBatteryHassClass::publishBinarySensor(const char* caption, const
     // statTopic.concat("/");
     statTopic.concat(subTopic);
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::getBulkJsonAllocator());
 
     root["name"] = caption;
     root["uniq_id"] = serial + "_" + sensorId;
@@ -375,7 +386,5 @@ void MqttHandleBatteryHassClass::createDeviceInfo(JsonObject& object)
 
 void MqttHandleBatteryHassClass::publish(const String& subtopic, const String& payload)
 {
-    String topic = Configuration.get().Mqtt.Hass.Topic;
-    topic += subtopic;
-    MqttSettings.publishGeneric(topic.c_str(), payload.c_str(), Configuration.get().Mqtt.Hass.Retain);
+    MqttHassPublisher.publish(subtopic, payload);
 }
@@ -3,16 +3,18 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "MqttHandleDtu.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
 #include <Hoymiles.h>
 #include <CpuTemperature.h>
+#include <cinttypes>
 
 MqttHandleDtuClass MqttHandleDtu;
 
 MqttHandleDtuClass::MqttHandleDtuClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleDtuClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskMonitor.wrap("MqttHandleDtu::loop", std::bind(&MqttHandleDtuClass::loop, this)))
 {
 }
 
@@ -27,25 +29,53 @@ void MqttHandleDtuClass::loop()
 {
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
 
-    if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
+    if (!MqttSettings.getConnected()) {
+        _wasConnected = false;
         _loopTask.forceNextIteration();
         return;
     }
 
-    MqttSettings.publish("dtu/uptime", String(esp_timer_get_time() / 1000000));
-    MqttSettings.publish("dtu/ip", NetworkSettings.localIP().toString());
-    MqttSettings.publish("dtu/hostname", NetworkSettings.getHostname());
-    MqttSettings.publish("dtu/heap/size", String(ESP.getHeapSize()));
-    MqttSettings.publish("dtu/heap/free", String(ESP.getFreeHeap()));
-    MqttSettings.publish("dtu/heap/minfree", String(ESP.getMinFreeHeap()));
-    MqttSettings.publish("dtu/heap/maxalloc", String(ESP.getMaxAllocHeap()));
-    if (NetworkSettings.NetworkMode() == network_mode::WiFi) {
-        MqttSettings.publish("dtu/rssi", String(WiFi.RSSI()));
-        MqttSettings.publish("dtu/bssid", WiFi.BSSIDstr());
+    if (!Hoymiles.isAllRadioIdle()) {
+        _loopTask.forceNextIteration();
+        return;
+    }
+
+    // the broker might have lost all values while we were disconnected
+    if (!_wasConnected || _forceUpdate) {
+        _wasConnected = true;
+        _forceUpdate = false;
+        _publisher.reset();
     }
 
+    // the values are collected in a single pass before publishing any of
+    // them. values which rarely change, like the hostname, are skipped
+    // unless they changed or the refresh interval passed.
+    uint32_t uptime = esp_timer_get_time() / 1000000;
+    String ip = NetworkSettings.localIP().toString();
+    String hostname = NetworkSettings.getHostname();
+    uint32_t heapSize = ESP.getHeapSize();
+    uint32_t heapFree = ESP.getFreeHeap();
+    uint32_t heapMinFree = ESP.getMinFreeHeap();
+    uint32_t heapMaxAlloc = ESP.getMaxAllocHeap();
+    bool wifi = NetworkSettings.NetworkMode() == network_mode::WiFi;
+    int rssi = wifi ? WiFi.RSSI() : 0;
+    String bssid = wifi ? WiFi.BSSIDstr() : String();
     float temperature = CpuTemperature.read();
+
+    _publisher.beginRound();
+    _publisher.publishf(Value::Uptime, "dtu/uptime", "%" PRIu32, uptime);
+    _publisher.publish(Value::Ip, "dtu/ip", ip.c_str());
+    _publisher.publish(Value::Hostname, "dtu/hostname", hostname.c_str());
+    _publisher.publishf(Value::HeapSize, "dtu/heap/size", "%" PRIu32, heapSize);
+    _publisher.publishf(Value::HeapFree, "dtu/heap/free", "%" PRIu32, heapFree);
+    _publisher.publishf(Value::HeapMinFree, "dtu/heap/minfree", "%" PRIu32, heapMinFree);
+    _publisher.publishf(Value::HeapMaxAlloc, "dtu/heap/maxalloc", "%" PRIu32, heapMaxAlloc);
+    if (wifi) {
+        _publisher.publishf(Value::Rssi, "dtu/rssi", "%d", rssi);
+        _publisher.publish(Value::Bssid, "dtu/bssid", bssid.c_str());
+    }
+
     if (!std::isnan(temperature)) {
-        MqttSettings.publish("dtu/temperature", String(temperature));
+        _publisher.publishf(Value::Temperature, "dtu/temperature", "%.2f", temperature);
     }
 }
@@ -2,7 +2,9 @@
 /*
  * Copyright (C) 2022 Thomas Basler and others
  */
+#ifndef OPENDTU_WITHOUT_HUAWEI
 #include "MqttHandleHuawei.h"
+#include "TaskMonitor.h"
 #include "MessageOutput.h"
 #include "MqttSettings.h"
 #include <gridcharger/huawei/Controller.h>
@@ -14,7 +16,7 @@ MqttHandleHuaweiClass MqttHandleHuawei;
 void MqttHandleHuaweiClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&MqttHandleHuaweiClass::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("MqttHandleHuawei::loop", std::bind(&MqttHandleHuaweiClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
@@ -184,3 +186,5 @@ void MqttHandleHuaweiClass::onMqttMessage(Topic t,
             break;
     }
 }
+
+#endif // OPENDTU_WITHOUT_HUAWEI
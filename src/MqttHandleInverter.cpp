@@ -3,16 +3,44 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "MqttHandleInverter.h"
+#include "TaskMonitor.h"
 #include "MessageOutput.h"
 #include "MqttSettings.h"
+#include "defaults.h"
+#include <ArduinoJson.h>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
 #include <ctime>
 
+// values are published at least this often (ms), even if they did not change
 #define PUBLISH_MAX_INTERVAL 60000
 
 MqttHandleInverterClass MqttHandleInverter;
 
+namespace {
+
+// formats a value into a buffer on the stack, as opposed to String(...),
+// which allocates on the heap for every value published or compared.
+class Payload {
+public:
+    template<typename... Args>
+    explicit Payload(const char* format, Args... args)
+    {
+        snprintf(_buffer, sizeof(_buffer), format, args...);
+    }
+
+    operator const char*() const { return _buffer; }
+
+private:
+    char _buffer[24];
+};
+
+}; // namespace
+
 MqttHandleInverterClass::MqttHandleInverterClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleInverterClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskMonitor.wrap("MqttHandleInverter::loop", std::bind(&MqttHandleInverterClass::loop, this)))
+    , _limitBatchTask(100 * TASK_MILLISECOND, TASK_FOREVER, TaskMonitor.wrap("MqttHandleInverter::limitBatchLoop", std::bind(&MqttHandleInverterClass::limitBatchLoop, this)))
 {
 }
 
@@ -23,104 +51,276 @@ void MqttHandleInverterClass::init(Scheduler& scheduler)
     scheduler.addTask(_loopTask);
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
+
+    scheduler.addTask(_limitBatchTask);
+    _limitBatchTask.enable();
 }
 
 void MqttHandleInverterClass::loop()
 {
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
 
-    if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
+    if (!MqttSettings.getConnected()) {
+        _wasConnected = false;
         _loopTask.forceNextIteration();
         return;
     }
 
-    // Loop all inverters
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
+    // the broker might have lost all values while we were disconnected
+    if (!_wasConnected || _forceUpdate) {
+        _wasConnected = true;
+        _forceUpdate = false;
+        for (auto& cache : _cache) { cache = InverterCache(); }
+    }
 
-        const String subtopic = inv->serialString();
+    if (!Hoymiles.isAllRadioIdle()) {
+        _loopTask.forceNextIteration();
+        return;
+    }
 
-        // Name
-        MqttSettings.publish(subtopic + "/name", inv->name());
+    // publish one inverter per iteration such that other tasks can run in
+    // between. the interval only starts after the last inverter.
+    if (_nextInverter < Hoymiles.getNumInverters()) {
+        publishInverter(_nextInverter++);
+    }
 
-        // Radio Statistics
-        MqttSettings.publish(subtopic + "/radio/tx_request", String(inv->RadioStats.TxRequestData));
-        MqttSettings.publish(subtopic + "/radio/tx_re_request", String(inv->RadioStats.TxReRequestFragment));
-        MqttSettings.publish(subtopic + "/radio/rx_success", String(inv->RadioStats.RxSuccess));
-        MqttSettings.publish(subtopic + "/radio/rx_fail_nothing", String(inv->RadioStats.RxFailNoAnswer));
-        MqttSettings.publish(subtopic + "/radio/rx_fail_partial", String(inv->RadioStats.RxFailPartialAnswer));
-        MqttSettings.publish(subtopic + "/radio/rx_fail_corrupt", String(inv->RadioStats.RxFailCorruptData));
-        MqttSettings.publish(subtopic + "/radio/rssi", String(inv->getLastRssi()));
+    if (_nextInverter < Hoymiles.getNumInverters()) {
+        _loopTask.forceNextIteration();
+        return;
+    }
 
-        if (inv->DevInfo()->getLastUpdate() > 0) {
-            // Bootloader Version
-            MqttSettings.publish(subtopic + "/device/bootloaderversion", String(inv->DevInfo()->getFwBootloaderVersion()));
+    _nextInverter = 0;
+}
 
-            // Firmware Version
-            MqttSettings.publish(subtopic + "/device/fwbuildversion", String(inv->DevInfo()->getFwBuildVersion()));
+void MqttHandleInverterClass::publishInverter(const uint8_t idx)
+{
+    auto inv = Hoymiles.getInverterByPos(idx);
+    if (inv == nullptr) {
+        return;
+    }
 
-            // Firmware Build DateTime
-            MqttSettings.publish(subtopic + "/device/fwbuilddatetime", inv->DevInfo()->getFwBuildDateTimeStr());
+    if (idx >= _cache.size()) {
+        _cache.resize(idx + 1);
+        _lastPublishStats.resize(idx + 1, 0);
+    }
 
-            // Hardware part number
-            MqttSettings.publish(subtopic + "/device/hwpartnumber", String(inv->DevInfo()->getHwPartNumber()));
+    if (_cache[idx].Serial != inv->serial()) {
+        _cache[idx] = InverterCache();
+        _cache[idx].Serial = inv->serial();
+    }
 
-            // Hardware version
-            MqttSettings.publish(subtopic + "/device/hwversion", inv->DevInfo()->getHwVersion());
-        }
+    // Name
+    publishValue(getValue(idx, Value::Name, "/name"), inv->name());
 
-        if (inv->SystemConfigPara()->getLastUpdate() > 0) {
-            // Limit
-            MqttSettings.publish(subtopic + "/status/limit_relative", String(inv->SystemConfigPara()->getLimitPercent()));
+    // Radio Statistics
+    publishValue(getValue(idx, Value::TxRequest, "/radio/tx_request"), Payload("%" PRIu32, inv->RadioStats.TxRequestData));
+    publishValue(getValue(idx, Value::TxReRequest, "/radio/tx_re_request"), Payload("%" PRIu32, inv->RadioStats.TxReRequestFragment));
+    publishValue(getValue(idx, Value::RxSuccess, "/radio/rx_success"), Payload("%" PRIu32, inv->RadioStats.RxSuccess));
+    publishValue(getValue(idx, Value::RxFailNothing, "/radio/rx_fail_nothing"), Payload("%" PRIu32, inv->RadioStats.RxFailNoAnswer));
+    publishValue(getValue(idx, Value::RxFailPartial, "/radio/rx_fail_partial"), Payload("%" PRIu32, inv->RadioStats.RxFailPartialAnswer));
+    publishValue(getValue(idx, Value::RxFailCorrupt, "/radio/rx_fail_corrupt"), Payload("%" PRIu32, inv->RadioStats.RxFailCorruptData));
+    publishValue(getValue(idx, Value::RxDropped, "/radio/rx_dropped"), Payload("%" PRIu32, inv->RadioStats.RxDroppedFragments));
+    publishValue(getValue(idx, Value::Rssi, "/radio/rssi"), Payload("%d", inv->getLastRssi()));
 
-            uint16_t maxpower = inv->DevInfo()->getMaxPower();
-            if (maxpower > 0) {
-                MqttSettings.publish(subtopic + "/status/limit_absolute", String(inv->SystemConfigPara()->getLimitPercent() * maxpower / 100));
-            }
-        }
+    if (inv->DevInfo()->getLastUpdate() > 0) {
+        // Bootloader Version
+        publishValue(getValue(idx, Value::BootloaderVersion, "/device/bootloaderversion"), Payload("%u", inv->DevInfo()->getFwBootloaderVersion()));
 
-        MqttSettings.publish(subtopic + "/status/reachable", String(inv->isReachable()));
-        MqttSettings.publish(subtopic + "/status/producing", String(inv->isProducing()));
+        // Firmware Version
+        publishValue(getValue(idx, Value::FwBuildVersion, "/device/fwbuildversion"), Payload("%u", inv->DevInfo()->getFwBuildVersion()));
 
-        if (inv->Statistics()->getLastUpdate() > 0) {
-            MqttSettings.publish(subtopic + "/status/last_update", String(std::time(0) - (millis() - inv->Statistics()->getLastUpdate()) / 1000));
-        } else {
-            MqttSettings.publish(subtopic + "/status/last_update", String(0));
+        // Firmware Build DateTime
+        publishValue(getValue(idx, Value::FwBuildDateTime, "/device/fwbuilddatetime"), inv->DevInfo()->getFwBuildDateTimeStr());
+
+        // Hardware part number
+        publishValue(getValue(idx, Value::HwPartNumber, "/device/hwpartnumber"), Payload("%" PRIu32, inv->DevInfo()->getHwPartNumber()));
+
+        // Hardware version
+        publishValue(getValue(idx, Value::HwVersion, "/device/hwversion"), inv->DevInfo()->getHwVersion());
+    }
+
+    if (inv->SystemConfigPara()->getLastUpdate() > 0) {
+        // Limit
+        publishValue(getValue(idx, Value::LimitRelative, "/status/limit_relative"), Payload("%.2f", inv->SystemConfigPara()->getLimitPercent()));
+
+        uint16_t maxpower = inv->DevInfo()->getMaxPower();
+        if (maxpower > 0) {
+            publishValue(getValue(idx, Value::LimitAbsolute, "/status/limit_absolute"), Payload("%.2f", inv->SystemConfigPara()->getLimitPercent() * maxpower / 100));
         }
+    }
+
+    publishValue(getValue(idx, Value::Reachable, "/status/reachable"), Payload("%d", inv->isReachable()));
+    publishValue(getValue(idx, Value::Producing, "/status/producing"), Payload("%d", inv->isProducing()));
+
+    if (inv->Statistics()->getLastUpdate() > 0) {
+        publishValue(getValue(idx, Value::LastUpdate, "/status/last_update"), Payload("%lld", static_cast<long long>(std::time(0) - (millis() - inv->Statistics()->getLastUpdate()) / 1000)));
+    } else {
+        publishValue(getValue(idx, Value::LastUpdate, "/status/last_update"), "0");
+    }
+
+    const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
+    if (inv->Statistics()->getLastUpdate() > 0 && (lastUpdateInternal != _lastPublishStats[idx])) {
+        _lastPublishStats[idx] = lastUpdateInternal;
 
-        const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
-        if (inv->Statistics()->getLastUpdate() > 0 && (lastUpdateInternal != _lastPublishStats[i])) {
-            _lastPublishStats[i] = lastUpdateInternal;
+        std::array<float, _publishFieldCount> deadbands;
+        for (size_t f = 0; f < _publishFieldCount; f++) {
+            deadbands[f] = getDeadband(_publishFields[f]);
+        }
 
-            // Loop all channels
-            for (auto& t : inv->Statistics()->getChannelTypes()) {
-                for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                    if (t == TYPE_DC) {
-                        INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
-                        if (inv_cfg != nullptr) {
+        // Loop all channels
+        size_t pos = 0;
+        for (auto& t : inv->Statistics()->getChannelTypes()) {
+            for (auto& c : inv->Statistics()->getChannelsByType(t)) {
+                auto& channel = getChannel(idx, pos++, t, c);
+                if (t == TYPE_DC) {
+                    INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
+                    if (inv_cfg != nullptr) {
+                        if (!channel.Name.spTopic) {
                             // TODO(tbnobody)
-                            MqttSettings.publish(inv->serialString() + "/" + String(static_cast<uint8_t>(c) + 1) + "/name", inv_cfg->channel[c].Name);
+                            channel.Name.spTopic = makeTopic(inv->serialString() + "/" + String(static_cast<uint8_t>(c) + 1) + "/name");
                         }
+                        publishValue(channel.Name, inv_cfg->channel[c].Name);
                     }
-                    for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(FieldId_t); f++) {
-                        publishField(inv, t, c, _publishFields[f]);
-                    }
+                }
+                for (size_t f = 0; f < _publishFieldCount; f++) {
+                    publishField(channel.Fields[f], inv, t, c, _publishFields[f], deadbands[f]);
                 }
             }
         }
+    }
+}
+
+void MqttHandleInverterClass::publishField(PublishedField& field, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const float deadband)
+{
+    if (!inv->Statistics()->hasChannelFieldValue(type, channel, fieldId)) {
+        return;
+    }
 
-        yield();
+    if (!field.spTopic) {
+        field.spTopic = makeTopic(getTopic(inv, type, channel, fieldId));
     }
+
+    publishValue(field,
+        inv->Statistics()->getChannelFieldValue(type, channel, fieldId),
+        deadband,
+        inv->Statistics()->getChannelFieldDigits(type, channel, fieldId));
 }
 
-void MqttHandleInverterClass::publishField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
+MqttHandleInverterClass::PublishedValue& MqttHandleInverterClass::getValue(const uint8_t idx, const Value key, const char* subtopic)
 {
-    const String topic = getTopic(inv, type, channel, fieldId);
-    if (topic == "") {
+    auto& value = _cache[idx].Values[static_cast<size_t>(key)];
+    if (!value.spTopic) {
+        value.spTopic = makeTopic(Hoymiles.getInverterByPos(idx)->serialString() + subtopic);
+    }
+    return value;
+}
+
+// the channels of an inverter are always published in the same order, so
+// the cache entry at the position matches unless the inverter changed.
+MqttHandleInverterClass::ChannelCache& MqttHandleInverterClass::getChannel(const uint8_t idx, const size_t pos, const ChannelType_t type, const ChannelNum_t channel)
+{
+    auto& channels = _cache[idx].Channels;
+    if (pos >= channels.size()) {
+        channels.resize(pos + 1);
+    }
+
+    auto& entry = channels[pos];
+    if (entry.Type != type || entry.Channel != channel) {
+        entry = ChannelCache();
+        entry.Type = type;
+        entry.Channel = channel;
+    }
+    return entry;
+}
+
+// the cache is cleared whenever the MQTT settings change, hence the prefix
+// is part of the topic.
+std::shared_ptr<const String> MqttHandleInverterClass::makeTopic(const String& subtopic)
+{
+    return std::make_shared<const String>(MqttSettings.getPrefix() + subtopic);
+}
+
+bool MqttHandleInverterClass::isExpired(PublishedField const& field) const
+{
+    return !field.Published || (millis() - field.LastPublish) >= PUBLISH_MAX_INTERVAL;
+}
+
+void MqttHandleInverterClass::publishValue(PublishedValue& value, const char* payload)
+{
+    if (!isExpired(value) && value.Payload == payload) {
         return;
     }
 
-    MqttSettings.publish(topic, inv->Statistics()->getChannelFieldValueString(type, channel, fieldId));
+    MqttSettings.publishPrefixed(value.spTopic, payload);
+    value.Payload = payload;
+    markPublished(value);
+}
+
+// texts like the hardware version are trimmed, but compared as is
+void MqttHandleInverterClass::publishValue(PublishedValue& value, const String& payload)
+{
+    if (!isExpired(value) && value.Payload == payload) {
+        return;
+    }
+
+    String trimmed = payload;
+    trimmed.trim();
+
+    MqttSettings.publishPrefixed(value.spTopic, trimmed.c_str());
+    value.Payload = payload;
+    markPublished(value);
+}
+
+// numeric fields are compared by value, so no payload is kept for them
+void MqttHandleInverterClass::publishValue(PublishedField& field, const float numeric, const float deadband, const uint8_t digits)
+{
+    // compare against the last published value rather than the previous
+    // sample, such that slow drifts are published eventually.
+    if (!isExpired(field)) {
+        if (deadband > 0 && std::fabs(numeric - field.Value) < deadband) { return; }
+        if (deadband == 0 && numeric == field.Value) { return; }
+    }
+
+    MqttSettings.publishPrefixed(field.spTopic, Payload("%.*f", static_cast<int>(digits), numeric));
+    field.Value = numeric;
+    markPublished(field);
+}
+
+void MqttHandleInverterClass::markPublished(PublishedField& field)
+{
+    field.LastPublish = millis();
+    field.Published = true;
+}
+
+// minimum change of a field's value before it is published again. zero
+// means that every change is published.
+float MqttHandleInverterClass::getDeadband(const FieldId_t fieldId)
+{
+    auto const& deadband = Configuration.get().Mqtt.Deadband;
+
+    switch (fieldId) {
+        case FLD_PAC:
+        case FLD_PDC:
+        case FLD_Q:
+            return deadband.Power;
+        case FLD_UAC:
+        case FLD_UDC:
+            return deadband.Voltage;
+        case FLD_IAC:
+        case FLD_IDC:
+            return deadband.Current;
+        case FLD_F:
+            return deadband.Frequency;
+        case FLD_T:
+            return deadband.Temperature;
+        case FLD_PF:
+            return deadband.PowerFactor;
+        case FLD_EFF:
+        case FLD_IRR:
+            return deadband.Percent;
+        default:
+            return 0;
+    }
 }
 
 String MqttHandleInverterClass::getTopic(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
@@ -183,24 +383,37 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
         return;
     }
 
+    // the id allows to match the completion published to <serial>/cmd/completed
+    auto announce = [&inv, topic](bool sent) {
+        const char* command = strrchr(topic, '/') + 1;
+        JsonDocument doc;
+        doc["command"] = command;
+        if (sent) { doc["id"] = inv->getLastControlCommandId(); }
+
+        String payload;
+        serializeJson(doc, payload);
+        MqttSettings.publish(inv->serialString() + (sent ? "/cmd/accepted" : "/cmd/rejected"),
+            payload, MqttPublishPriority::Control);
+    };
+
     switch (t) {
     case Topic::LimitPersistentRelative:
         // Set inverter limit relative persistent
         MessageOutput.printf("Limit Persistent: %.1f %%\r\n", payload_val);
-        inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::RelativPersistent);
+        announce(inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::RelativPersistent));
         break;
 
     case Topic::LimitPersistentAbsolute:
         // Set inverter limit absolute persistent
         MessageOutput.printf("Limit Persistent: %.1f W\r\n", payload_val);
-        inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::AbsolutPersistent);
+        announce(inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::AbsolutPersistent));
         break;
 
     case Topic::LimitNonPersistentRelative:
         // Set inverter limit relative non persistent
         MessageOutput.printf("Limit Non-Persistent: %.1f %%\r\n", payload_val);
         if (!properties.retain) {
-            inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::RelativNonPersistent);
+            announce(inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::RelativNonPersistent));
         } else {
             MessageOutput.println("Ignored because retained");
         }
@@ -210,7 +423,7 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
         // Set inverter limit absolute non persistent
         MessageOutput.printf("Limit Non-Persistent: %.1f W\r\n", payload_val);
         if (!properties.retain) {
-            inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::AbsolutNonPersistent);
+            announce(inv->sendActivePowerControlRequest(payload_val, PowerLimitControlType::AbsolutNonPersistent));
         } else {
             MessageOutput.println("Ignored because retained");
         }
@@ -219,14 +432,14 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
     case Topic::Power:
         // Turn inverter on or off
         MessageOutput.printf("Set inverter power to: %" PRId32 "\r\n", static_cast<int32_t>(payload_val));
-        inv->sendPowerControlRequest(static_cast<int32_t>(payload_val) > 0);
+        announce(inv->sendPowerControlRequest(static_cast<int32_t>(payload_val) > 0));
         break;
 
     case Topic::Restart:
         // Restart inverter
         MessageOutput.printf("Restart inverter\r\n");
         if (!properties.retain && payload_val == 1) {
-            inv->sendRestartControlRequest();
+            announce(inv->sendRestartControlRequest());
         } else {
             MessageOutput.println("Ignored because retained or numeric value not '1'");
         }
@@ -259,6 +472,12 @@ void MqttHandleInverterClass::subscribeTopics()
     for (auto const& s : _subscriptions) {
         subscribe(s.first.data(), s.second);
     }
+
+    MqttSettings.subscribe((prefix + _limitBatchTopic.data()).c_str(), 0,
+        std::bind(&MqttHandleInverterClass::onLimitBatchMessage, this,
+            std::placeholders::_1, std::placeholders::_2,
+            std::placeholders::_3, std::placeholders::_4,
+            std::placeholders::_5, std::placeholders::_6));
 }
 
 void MqttHandleInverterClass::unsubscribeTopics()
@@ -267,4 +486,168 @@ void MqttHandleInverterClass::unsubscribeTopics()
     for (auto const& s : _subscriptions) {
         MqttSettings.unsubscribe(prefix + s.first.data());
     }
+
+    MqttSettings.unsubscribe(MqttSettings.getPrefix() + _limitBatchTopic.data());
+}
+
+// expects a JSON object like this, where "relative" and "persistent" are
+// optional and default to false:
+// {"id": "42", "limits": [{"serial": "116012345678", "limit": 300,
+//   "relative": false, "persistent": false}, ...]}
+void MqttHandleInverterClass::onLimitBatchMessage(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total)
+{
+    // fragments of large messages are not reassembled
+    if (index != 0 || len != total) { return; }
+
+    JsonDocument root;
+    const DeserializationError error = deserializeJson(root, payload, len);
+    String id = root["id"] | "";
+
+    if (error || !root["limits"].is<JsonArrayConst>()) {
+        return publishLimitBatchRejection(id, "payload is not a JSON object with a 'limits' array");
+    }
+
+    if (properties.retain) {
+        return publishLimitBatchRejection(id, "retained batches are ignored");
+    }
+
+    auto limits = root["limits"].as<JsonArrayConst>();
+    if (limits.size() == 0 || limits.size() > INV_MAX_COUNT) {
+        return publishLimitBatchRejection(id, "number of limits must be between 1 and " + String(INV_MAX_COUNT));
+    }
+
+    struct Request {
+        std::shared_ptr<InverterAbstract> spInverter;
+        float Limit;
+        PowerLimitControlType Type;
+    };
+    std::vector<Request> requests;
+
+    // the batch is only enqueued if every single limit can be applied
+    for (JsonObjectConst entry : limits) {
+        String serialStr = entry["serial"] | "";
+        const uint64_t serial = strtoull(serialStr.c_str(), 0, 16);
+        auto inv = Hoymiles.getInverterBySerial(serial);
+        if (serial == 0 || inv == nullptr) {
+            return publishLimitBatchRejection(id, "unknown inverter '" + serialStr + "'");
+        }
+
+        for (auto const& request : requests) {
+            if (request.spInverter == inv) {
+                return publishLimitBatchRejection(id, "duplicate inverter '" + serialStr + "'");
+            }
+        }
+
+        if (!entry["limit"].is<float>()) {
+            return publishLimitBatchRejection(id, "limit of inverter '" + serialStr + "' is not a number");
+        }
+
+        float limit = entry["limit"].as<float>();
+        bool relative = entry["relative"] | false;
+        bool persistent = entry["persistent"] | false;
+        float maxLimit = relative ? 100 : MAX_INVERTER_LIMIT;
+        if (limit < 0 || limit > maxLimit) {
+            return publishLimitBatchRejection(id, "limit of inverter '" + serialStr + "' must be between 0 and " + String(maxLimit, 0));
+        }
+
+        if (!inv->getEnableCommands()) {
+            return publishLimitBatchRejection(id, "inverter '" + serialStr + "' does not accept commands");
+        }
+
+        if (inv->SystemConfigPara()->getLastLimitCommandSuccess() == CMD_PENDING) {
+            return publishLimitBatchRejection(id, "inverter '" + serialStr + "' is busy with another limit command");
+        }
+
+        PowerLimitControlType type = relative
+            ? (persistent ? PowerLimitControlType::RelativPersistent : PowerLimitControlType::RelativNonPersistent)
+            : (persistent ? PowerLimitControlType::AbsolutPersistent : PowerLimitControlType::AbsolutNonPersistent);
+
+        requests.push_back({ inv, limit, type });
+    }
+
+    LimitBatch batch;
+    batch.Id = id;
+    batch.Started = millis();
+
+    for (auto const& request : requests) {
+        bool sent = request.spInverter->sendActivePowerControlRequest(request.Limit, request.Type);
+        uint32_t commandId = sent ? request.spInverter->getLastControlCommandId() : 0;
+        batch.Targets.push_back({ request.spInverter, commandId, sent ? CMD_PENDING : CMD_NOK });
+    }
+
+    MessageOutput.printf("MQTT handler: enqueued limit batch '%s' for %u inverters\r\n",
+        id.c_str(), static_cast<unsigned>(requests.size()));
+
+    std::lock_guard<std::mutex> lock(_limitBatchMutex);
+    _limitBatches.push_back(std::move(batch));
+}
+
+void MqttHandleInverterClass::limitBatchLoop()
+{
+    std::lock_guard<std::mutex> lock(_limitBatchMutex);
+
+    for (auto it = _limitBatches.begin(); it != _limitBatches.end();) {
+        bool complete = true;
+        for (auto& target : it->Targets) {
+            if (target.Result != CMD_PENDING) { continue; }
+            target.Result = target.spInverter->SystemConfigPara()->getLastLimitCommandSuccess();
+            if (target.Result == CMD_PENDING) { complete = false; }
+        }
+
+        bool timedOut = (millis() - it->Started) >= _limitBatchTimeoutMs;
+        if (!complete && !timedOut) {
+            ++it;
+            continue;
+        }
+
+        publishLimitBatchResult(*it, timedOut);
+        it = _limitBatches.erase(it);
+    }
+}
+
+void MqttHandleInverterClass::publishLimitBatchResult(LimitBatch const& batch, bool timedOut)
+{
+    JsonDocument root;
+    root["id"] = batch.Id;
+
+    bool success = true;
+    auto results = root["results"].to<JsonArray>();
+    for (auto const& target : batch.Targets) {
+        auto result = results.add<JsonObject>();
+        result["serial"] = target.spInverter->serialString();
+        if (target.CommandId != 0) { result["id"] = target.CommandId; }
+        switch (target.Result) {
+            case CMD_OK:
+                result["status"] = "ok";
+                break;
+            case CMD_PENDING:
+                result["status"] = "timeout";
+                success = false;
+                break;
+            default:
+                result["status"] = "failed";
+                success = false;
+                break;
+        }
+    }
+
+    root["status"] = success ? "ok" : (timedOut ? "timeout" : "failed");
+
+    String payload;
+    serializeJson(root, payload);
+    MqttSettings.publish(String(_limitBatchTopic.data()) + "/result", payload, MqttPublishPriority::Control);
+}
+
+void MqttHandleInverterClass::publishLimitBatchRejection(String const& id, String const& error)
+{
+    MessageOutput.printf("MQTT handler: rejected limit batch '%s': %s\r\n", id.c_str(), error.c_str());
+
+    JsonDocument root;
+    root["id"] = id;
+    root["status"] = "rejected";
+    root["error"] = error;
+
+    String payload;
+    serializeJson(root, payload);
+    MqttSettings.publish(String(_limitBatchTopic.data()) + "/result", payload, MqttPublishPriority::Control);
 }
@@ -3,6 +3,7 @@
  * Copyright (C) 2023-2024 Thomas Basler and others
  */
 #include "MqttHandleInverterTotal.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
 #include "Datastore.h"
 #include "MqttSettings.h"
@@ -11,7 +12,7 @@
 MqttHandleInverterTotalClass MqttHandleInverterTotal;
 
 MqttHandleInverterTotalClass::MqttHandleInverterTotalClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleInverterTotalClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskMonitor.wrap("MqttHandleInverterTotal::loop", std::bind(&MqttHandleInverterTotalClass::loop, this)))
 {
 }
 
@@ -20,6 +21,8 @@ void MqttHandleInverterTotalClass::init(Scheduler& scheduler)
     scheduler.addTask(_loopTask);
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
+
+    Datastore.onUpdate([this]() { _updated = true; });
 }
 
 void MqttHandleInverterTotalClass::loop()
@@ -27,16 +30,38 @@ void MqttHandleInverterTotalClass::loop()
     // Update interval from config
     _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
 
-    if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
+    if (!MqttSettings.getConnected()) {
+        _wasConnected = false;
+        _loopTask.forceNextIteration();
+        return;
+    }
+
+    // the broker might have lost all values while we were disconnected
+    if (!_wasConnected || _forceUpdate) {
+        _wasConnected = true;
+        _forceUpdate = false;
+        _publisher.reset();
+    }
+
+    if (!_updated && !_publisher.isRefreshDue()) { return; }
+
+    if (!Hoymiles.isAllRadioIdle()) {
         _loopTask.forceNextIteration();
         return;
     }
 
-    MqttSettings.publish("ac/power", String(Datastore.getTotalAcPowerEnabled(), Datastore.getTotalAcPowerDigits()));
-    MqttSettings.publish("ac/yieldtotal", String(Datastore.getTotalAcYieldTotalEnabled(), Datastore.getTotalAcYieldTotalDigits()));
-    MqttSettings.publish("ac/yieldday", String(Datastore.getTotalAcYieldDayEnabled(), Datastore.getTotalAcYieldDayDigits()));
-    MqttSettings.publish("ac/is_valid", String(Datastore.getIsAllEnabledReachable()));
-    MqttSettings.publish("dc/power", String(Datastore.getTotalDcPowerEnabled(), Datastore.getTotalDcPowerDigits()));
-    MqttSettings.publish("dc/irradiation", String(Datastore.getTotalDcIrradiation(), 3));
-    MqttSettings.publish("dc/is_valid", String(Datastore.getIsAllEnabledReachable()));
+    _updated = false;
+
+    // all values are taken from the same snapshot, such that, e.g., the AC
+    // and DC power published together belong to the same poll.
+    auto spTotals = Datastore.getTotals();
+
+    _publisher.beginRound();
+    _publisher.publishf(Value::AcPower, "ac/power", "%.*f", static_cast<int>(spTotals->AcPowerDigits), spTotals->AcPowerEnabled);
+    _publisher.publishf(Value::AcYieldTotal, "ac/yieldtotal", "%.*f", static_cast<int>(spTotals->AcYieldTotalDigits), spTotals->AcYieldTotalEnabled);
+    _publisher.publishf(Value::AcYieldDay, "ac/yieldday", "%.*f", static_cast<int>(spTotals->AcYieldDayDigits), spTotals->AcYieldDayEnabled);
+    _publisher.publishf(Value::AcIsValid, "ac/is_valid", "%d", spTotals->IsAllEnabledReachable);
+    _publisher.publishf(Value::DcPower, "dc/power", "%.*f", static_cast<int>(spTotals->DcPowerDigits), spTotals->DcPowerEnabled);
+    _publisher.publishf(Value::DcIrradiation, "dc/irradiation", "%.3f", spTotals->DcIrradiation);
+    _publisher.publishf(Value::DcIsValid, "dc/is_valid", "%d", spTotals->IsAllEnabledReachable);
 }
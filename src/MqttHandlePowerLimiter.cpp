@@ -3,6 +3,7 @@
  * Copyright (C) 2022 Thomas Basler, Malte Schmidt and others
  */
 #include "MessageOutput.h"
+#include "TaskMonitor.h"
 #include "MqttSettings.h"
 #include "MqttHandlePowerLimiter.h"
 #include "PowerLimiter.h"
@@ -14,7 +15,7 @@ MqttHandlePowerLimiterClass MqttHandlePowerLimiter;
 void MqttHandlePowerLimiterClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&MqttHandlePowerLimiterClass::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("MqttHandlePowerLimiter::loop", std::bind(&MqttHandlePowerLimiterClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
@@ -86,33 +87,33 @@ void MqttHandlePowerLimiterClass::loop()
     _lastPublish = millis();
 
     auto val = static_cast<unsigned>(PowerLimiter.getMode());
-    MqttSettings.publish("powerlimiter/status/mode", String(val));
+    MqttSettings.publish("powerlimiter/status/mode", String(val), MqttPublishPriority::Control);
 
-    MqttSettings.publish("powerlimiter/status/upper_power_limit", String(config.PowerLimiter.TotalUpperPowerLimit));
+    MqttSettings.publish("powerlimiter/status/upper_power_limit", String(config.PowerLimiter.TotalUpperPowerLimit), MqttPublishPriority::Control);
 
-    MqttSettings.publish("powerlimiter/status/target_power_consumption", String(config.PowerLimiter.TargetPowerConsumption));
+    MqttSettings.publish("powerlimiter/status/target_power_consumption", String(config.PowerLimiter.TargetPowerConsumption), MqttPublishPriority::Control);
 
-    MqttSettings.publish("powerlimiter/status/inverter_update_timeouts", String(PowerLimiter.getInverterUpdateTimeouts()));
+    MqttSettings.publish("powerlimiter/status/inverter_update_timeouts", String(PowerLimiter.getInverterUpdateTimeouts()), MqttPublishPriority::Control);
 
     // no thresholds are relevant for setups without a battery
     if (!PowerLimiter.usesBatteryPoweredInverter()) { return; }
 
-    MqttSettings.publish("powerlimiter/status/threshold/voltage/start", String(config.PowerLimiter.VoltageStartThreshold));
-    MqttSettings.publish("powerlimiter/status/threshold/voltage/stop", String(config.PowerLimiter.VoltageStopThreshold));
+    MqttSettings.publish("powerlimiter/status/threshold/voltage/start", String(config.PowerLimiter.VoltageStartThreshold), MqttPublishPriority::Control);
+    MqttSettings.publish("powerlimiter/status/threshold/voltage/stop", String(config.PowerLimiter.VoltageStopThreshold), MqttPublishPriority::Control);
 
     if (config.SolarCharger.Enabled) {
-        MqttSettings.publish("powerlimiter/status/full_solar_passthrough_active", String(PowerLimiter.getFullSolarPassThroughEnabled()));
-        MqttSettings.publish("powerlimiter/status/threshold/voltage/full_solar_passthrough_start", String(config.PowerLimiter.FullSolarPassThroughStartVoltage));
-        MqttSettings.publish("powerlimiter/status/threshold/voltage/full_solar_passthrough_stop", String(config.PowerLimiter.FullSolarPassThroughStopVoltage));
+        MqttSettings.publish("powerlimiter/status/full_solar_passthrough_active", String(PowerLimiter.getFullSolarPassThroughEnabled()), MqttPublishPriority::Control);
+        MqttSettings.publish("powerlimiter/status/threshold/voltage/full_solar_passthrough_start", String(config.PowerLimiter.FullSolarPassThroughStartVoltage), MqttPublishPriority::Control);
+        MqttSettings.publish("powerlimiter/status/threshold/voltage/full_solar_passthrough_stop", String(config.PowerLimiter.FullSolarPassThroughStopVoltage), MqttPublishPriority::Control);
     }
 
     if (!config.Battery.Enabled || config.PowerLimiter.IgnoreSoc) { return; }
 
-    MqttSettings.publish("powerlimiter/status/threshold/soc/start", String(config.PowerLimiter.BatterySocStartThreshold));
-    MqttSettings.publish("powerlimiter/status/threshold/soc/stop", String(config.PowerLimiter.BatterySocStopThreshold));
+    MqttSettings.publish("powerlimiter/status/threshold/soc/start", String(config.PowerLimiter.BatterySocStartThreshold), MqttPublishPriority::Control);
+    MqttSettings.publish("powerlimiter/status/threshold/soc/stop", String(config.PowerLimiter.BatterySocStopThreshold), MqttPublishPriority::Control);
 
     if (config.SolarCharger.Enabled) {
-        MqttSettings.publish("powerlimiter/status/threshold/soc/full_solar_passthrough", String(config.PowerLimiter.FullSolarPassThroughSoc));
+        MqttSettings.publish("powerlimiter/status/threshold/soc/full_solar_passthrough", String(config.PowerLimiter.FullSolarPassThroughSoc), MqttPublishPriority::Control);
     }
 }
 
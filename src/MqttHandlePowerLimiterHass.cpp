@@ -3,8 +3,11 @@
  * Copyright (C) 2022 Thomas Basler and others
  */
 #include "MqttHandlePowerLimiterHass.h"
+#include "TaskMonitor.h"
 #include "MqttHandleHass.h"
 #include "Configuration.h"
+#include "MemoryPolicy.h"
+#include "MqttHassPublisher.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
 #include "MessageOutput.h"
@@ -17,7 +20,7 @@ MqttHandlePowerLimiterHassClass MqttHandlePowerLimiterHass;
 void MqttHandlePowerLimiterHassClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&MqttHandlePowerLimiterHassClass::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("MqttHandlePowerLimiterHass::loop", std::bind(&MqttHandlePowerLimiterHassClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 }
@@ -27,19 +30,21 @@ void MqttHandlePowerLimiterHassClass::loop()
     if (!Configuration.get().PowerLimiter.Enabled) {
         return;
     }
-    if (_updateForced) {
-        publishConfig();
-        _updateForced = false;
-    }
 
     if (MqttSettings.getConnected() && !_wasConnected) {
         // Connection established
         _wasConnected = true;
-        publishConfig();
+        _updateForced = true;
     } else if (!MqttSettings.getConnected() && _wasConnected) {
         // Connection lost
         _wasConnected = false;
     }
+
+    // discovery messages are never dropped, so wait for the outbox to drain
+    if (_updateForced && MqttSettings.hasOutboxRoom(MqttPublishPriority::Discovery)) {
+        publishConfig();
+        _updateForced = false;
+    }
 }
 
 void MqttHandlePowerLimiterHassClass::forceUpdate()
@@ -119,7 +124,7 @@ void MqttHandlePowerLimiterHassClass::publishSelect(
     const String cmdTopic = MqttSettings.getPrefix() + "powerlimiter/cmd/" + commandTopic;
     const String statTopic = MqttSettings.getPrefix() + "powerlimiter/status/" + stateTopic;
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::getBulkJsonAllocator());
 
     root["name"] = caption;
     root["uniq_id"] = MqttHandleHass.getDtuUniqueId() + "_" + selectId;
@@ -160,7 +165,7 @@ void MqttHandlePowerLimiterHassClass::publishNumber(
     const String cmdTopic = MqttSettings.getPrefix() + "powerlimiter/cmd/" + commandTopic;
     const String statTopic = MqttSettings.getPrefix() + "powerlimiter/status/" + stateTopic;
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::getBulkJsonAllocator());
 
     root["name"] = caption;
     root["uniq_id"] = MqttHandleHass.getDtuUniqueId() + "_" + numberId;
@@ -205,7 +210,7 @@ void MqttHandlePowerLimiterHassClass::publishBinarySensor(
 
     const String statTopic = MqttSettings.getPrefix() + "powerlimiter/status/" + stateTopic;
 
-    JsonDocument root;
+    JsonDocument root(MemoryPolicy::getBulkJsonAllocator());
 
     root["name"] = caption;
     root["uniq_id"] = MqttHandleHass.getDtuUniqueId() + "_" + numberId;
@@ -247,7 +252,5 @@ void MqttHandlePowerLimiterHassClass::createDeviceInfo(JsonDocument& root)
 
 void MqttHandlePowerLimiterHassClass::publish(const String& subtopic, const String& payload)
 {
-    String topic = Configuration.get().Mqtt.Hass.Topic;
-    topic += subtopic;
-    MqttSettings.publishGeneric(topic.c_str(), payload.c_str(), Configuration.get().Mqtt.Hass.Retain);
+    MqttHassPublisher.publish(subtopic, payload);
 }
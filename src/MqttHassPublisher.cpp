@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "MqttHassPublisher.h"
+#include "TaskMonitor.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "MqttHandleBatteryHass.h"
+#include "MqttHandleHass.h"
+#include "MqttHandlePowerLimiterHass.h"
+#include "MqttSettings.h"
+#include <solarcharger/Controller.h>
+
+MqttHassPublisherClass MqttHassPublisher;
+
+MqttHassPublisherClass::MqttHassPublisherClass()
+    : _loopTask(TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("MqttHassPublisher::loop", std::bind(&MqttHassPublisherClass::loop, this)))
+{
+}
+
+void MqttHassPublisherClass::init(Scheduler& scheduler)
+{
+    subscribeTopics();
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void MqttHassPublisherClass::loop()
+{
+    // follow changes of the auto discovery topic
+    if (_birthTopic != String(Configuration.get().Mqtt.Hass.Topic) + "status") {
+        unsubscribeTopics();
+        subscribeTopics();
+    }
+
+    if (!_birthReceived) { return; }
+    _birthReceived = false;
+
+    MessageOutput.println("[MqttHassPublisher] Home Assistant is online, re-announcing all entities");
+
+    invalidate();
+
+    MqttHandleHass.forceUpdate();
+    MqttHandleBatteryHass.forceUpdate();
+    MqttHandlePowerLimiterHass.forceUpdate();
+    SolarCharger.forcePublishSensors();
+}
+
+void MqttHassPublisherClass::invalidate()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _payloadHashes.clear();
+}
+
+void MqttHassPublisherClass::subscribeTopics()
+{
+    _birthTopic = String(Configuration.get().Mqtt.Hass.Topic) + "status";
+
+    MqttSettings.subscribe(_birthTopic, 0,
+        [this](const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total) {
+            if (len == 6 && memcmp(payload, "online", len) == 0) {
+                _birthReceived = true;
+            }
+        });
+}
+
+void MqttHassPublisherClass::unsubscribeTopics()
+{
+    if (_birthTopic.isEmpty()) { return; }
+
+    MqttSettings.unsubscribe(_birthTopic);
+    _birthTopic = "";
+}
+
+void MqttHassPublisherClass::publish(const String& subtopic, const String& payload)
+{
+    String topic = Configuration.get().Mqtt.Hass.Topic;
+    topic += subtopic;
+
+    uint32_t topicHash = hash(topic);
+    uint32_t payloadHash = hash(payload);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _payloadHashes.find(topicHash);
+        if (iter != _payloadHashes.end() && iter->second == payloadHash) {
+            return;
+        }
+    }
+
+    // the hash is only recorded once the message reached the client, such
+    // that a message which was not published is published again next time
+    MqttSettings.publishGeneric(topic, payload, Configuration.get().Mqtt.Hass.Retain, 0, MqttPublishPriority::Discovery,
+        [this, topicHash, payloadHash]() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _payloadHashes[topicHash] = payloadHash;
+        });
+}
+
+// FNV-1a
+uint32_t MqttHassPublisherClass::hash(const String& value)
+{
+    uint32_t result = 2166136261u;
+    for (size_t i = 0; i < value.length(); ++i) {
+        result ^= static_cast<uint8_t>(value[i]);
+        result *= 16777619u;
+    }
+    return result;
+}
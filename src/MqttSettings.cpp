@@ -4,7 +4,10 @@
  */
 #include "MqttSettings.h"
 #include "Configuration.h"
+#include "DnsCache.h"
 #include "MessageOutput.h"
+#include "TlsMonitor.h"
+#include <algorithm>
 
 MqttSettingsClass::MqttSettingsClass()
 {
@@ -21,6 +24,15 @@ void MqttSettingsClass::NetworkEvent(network_event event)
         MessageOutput.println("Network lost connection");
         _mqttReconnectTimer.detach(); // ensure we don't reconnect to MQTT while reconnecting to Wi-Fi
         break;
+    case network_event::NETWORK_INTERFACE_CHANGED: {
+        // do not wait for the keep-alive to time out. we connect again as
+        // soon as the new interface got an address.
+        MessageOutput.println("Network interface changed");
+        _mqttReconnectTimer.detach();
+        std::lock_guard<std::mutex> lock(_clientLock);
+        if (_mqttClient != nullptr) { _mqttClient->disconnect(true); }
+        break;
+    }
     default:
         break;
     }
@@ -29,8 +41,14 @@ void MqttSettingsClass::NetworkEvent(network_event event)
 void MqttSettingsClass::onMqttConnect(const bool sessionPresent)
 {
     MessageOutput.println("Connected to MQTT.");
+
+    if (_tlsConnecting.exchange(false)) {
+        TlsMonitor.recordHandshake(TlsMonitorClass::Client::Mqtt, true, millis() - _connectStartMillis);
+    }
+    _reconnectDelay = _reconnectDelayMin;
+
     const CONFIG_T& config = Configuration.get();
-    publish(config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Online);
+    publish(config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Online, MqttPublishPriority::Control);
 
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient != nullptr) {
@@ -85,8 +103,16 @@ void MqttSettingsClass::onMqttDisconnect(espMqttClientTypes::DisconnectReason re
     default:
         MessageOutput.println("Unknown");
     }
+
+    uint32_t delay = _reconnectDelayMin;
+    if (_tlsConnecting.exchange(false)) {
+        TlsMonitor.recordHandshake(TlsMonitorClass::Client::Mqtt, false, millis() - _connectStartMillis);
+        delay = _reconnectDelay;
+        _reconnectDelay = std::min(delay * 2, _reconnectDelayMax);
+    }
+
     _mqttReconnectTimer.once(
-        2, +[](MqttSettingsClass* instance) { instance->performConnect(); }, this);
+        delay, +[](MqttSettingsClass* instance) { instance->performConnect(); }, this);
 }
 
 void MqttSettingsClass::onMqttMessage(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total)
@@ -118,6 +144,11 @@ void MqttSettingsClass::performConnect()
         _verboseLogging = config.Mqtt.VerboseLogging;
         const String willTopic = getPrefix() + config.Mqtt.Lwt.Topic;
         String clientId = getClientId();
+        // the cached address spares the client waiting for the DNS server.
+        // the name is required for TLS, where the lookup only keeps the
+        // name refreshed in the background, which warms the lwIP resolver.
+        IPAddress address;
+        bool cached = DnsCache.lookup(config.Mqtt.Hostname, address);
         if (config.Mqtt.Tls.Enabled) {
             static_cast<espMqttClientSecure*>(_mqttClient)->setCACert(config.Mqtt.Tls.RootCaCert);
             static_cast<espMqttClientSecure*>(_mqttClient)->setServer(config.Mqtt.Hostname, config.Mqtt.Port);
@@ -134,7 +165,11 @@ void MqttSettingsClass::performConnect()
             static_cast<espMqttClientSecure*>(_mqttClient)->onDisconnect(std::bind(&MqttSettingsClass::onMqttDisconnect, this, _1));
             static_cast<espMqttClientSecure*>(_mqttClient)->onMessage(std::bind(&MqttSettingsClass::onMqttMessage, this, _1, _2, _3, _4, _5, _6));
         } else {
-            static_cast<espMqttClient*>(_mqttClient)->setServer(config.Mqtt.Hostname, config.Mqtt.Port);
+            if (cached) {
+                static_cast<espMqttClient*>(_mqttClient)->setServer(address, config.Mqtt.Port);
+            } else {
+                static_cast<espMqttClient*>(_mqttClient)->setServer(config.Mqtt.Hostname, config.Mqtt.Port);
+            }
             static_cast<espMqttClient*>(_mqttClient)->setCredentials(config.Mqtt.Username, config.Mqtt.Password);
             static_cast<espMqttClient*>(_mqttClient)->setWill(willTopic.c_str(), config.Mqtt.Lwt.Qos, config.Mqtt.Retain, config.Mqtt.Lwt.Value_Offline);
             static_cast<espMqttClient*>(_mqttClient)->setClientId(clientId.c_str());
@@ -143,6 +178,8 @@ void MqttSettingsClass::performConnect()
             static_cast<espMqttClient*>(_mqttClient)->onDisconnect(std::bind(&MqttSettingsClass::onMqttDisconnect, this, _1));
             static_cast<espMqttClient*>(_mqttClient)->onMessage(std::bind(&MqttSettingsClass::onMqttMessage, this, _1, _2, _3, _4, _5, _6));
         }
+        _tlsConnecting = config.Mqtt.Tls.Enabled;
+        _connectStartMillis = millis();
         _mqttClient->connect();
     }
 }
@@ -150,7 +187,10 @@ void MqttSettingsClass::performConnect()
 void MqttSettingsClass::performDisconnect()
 {
     const CONFIG_T& config = Configuration.get();
-    publish(config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Offline);
+
+    // bypass the outbox, as the message must be sent before disconnecting
+    publishImmediately(getPrefix() + config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Offline, config.Mqtt.Retain, 0);
+
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient == nullptr) {
         return;
@@ -163,6 +203,7 @@ void MqttSettingsClass::performReconnect()
     performDisconnect();
 
     createMqttClientObject();
+    _reconnectDelay = _reconnectDelayMin;
 
     _mqttReconnectTimer.once(
         2, +[](MqttSettingsClass* instance) { instance->performConnect(); }, this);
@@ -191,7 +232,7 @@ String MqttSettingsClass::getClientId() const
     return clientId;
 }
 
-void MqttSettingsClass::publish(const String& subtopic, const String& payload)
+void MqttSettingsClass::publish(const String& subtopic, const String& payload, const MqttPublishPriority priority)
 {
     String topic = getPrefix();
     topic += subtopic;
@@ -199,16 +240,106 @@ void MqttSettingsClass::publish(const String& subtopic, const String& payload)
     String value = payload;
     value.trim();
 
-    publishGeneric(topic, value, Configuration.get().Mqtt.Retain, 0);
+    publishGeneric(topic, value, Configuration.get().Mqtt.Retain, 0, priority);
 }
 
-void MqttSettingsClass::publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos)
+void MqttSettingsClass::publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos,
+        const MqttPublishPriority priority, std::function<void()> onPublished)
+{
+    enqueue(std::make_shared<const String>(topic), payload, retain, qos, priority, std::move(onPublished));
+}
+
+void MqttSettingsClass::publishPrefixed(const std::shared_ptr<const String>& spTopic, const char* payload, const MqttPublishPriority priority)
+{
+    enqueue(spTopic, payload, Configuration.get().Mqtt.Retain, 0, priority);
+}
+
+void MqttSettingsClass::enqueue(std::shared_ptr<const String> spTopic, String payload, const bool retain, const uint8_t qos,
+        const MqttPublishPriority priority, std::function<void()> onPublished)
+{
+    {
+        std::lock_guard<std::mutex> lock(_outboxMutex);
+        auto& outbox = _outboxes[static_cast<size_t>(priority)];
+        auto limit = _outboxLimits[static_cast<size_t>(priority)];
+
+        outbox.Bytes += spTopic->length() + payload.length();
+        outbox.Messages.push_back({ std::move(spTopic), std::move(payload), retain, qos, std::move(onPublished) });
+
+        while (priority != MqttPublishPriority::Discovery && outbox.Bytes > limit && outbox.Messages.size() > 1) {
+            auto const& oldest = outbox.Messages.front();
+            outbox.Bytes -= oldest.spTopic->length() + oldest.Payload.length();
+            outbox.Messages.pop_front();
+            ++outbox.Dropped;
+        }
+    }
+
+    _outboxCv.notify_one();
+}
+
+bool MqttSettingsClass::publishImmediately(const String& topic, const String& payload, const bool retain, const uint8_t qos)
 {
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient == nullptr) {
-        return;
+        return false;
+    }
+    return _mqttClient->publish(topic.c_str(), qos, retain, payload.c_str()) != 0;
+}
+
+MqttSettingsClass::OutboxStats MqttSettingsClass::getOutboxStats(const MqttPublishPriority priority)
+{
+    std::lock_guard<std::mutex> lock(_outboxMutex);
+    auto const& outbox = _outboxes[static_cast<size_t>(priority)];
+    return { outbox.Messages.size(), outbox.Bytes, outbox.Published, outbox.Dropped };
+}
+
+bool MqttSettingsClass::hasOutboxRoom(const MqttPublishPriority priority)
+{
+    std::lock_guard<std::mutex> lock(_outboxMutex);
+    return _outboxes[static_cast<size_t>(priority)].Bytes < _outboxLimits[static_cast<size_t>(priority)];
+}
+
+void MqttSettingsClass::publishTaskHelper(void* context)
+{
+    static_cast<MqttSettingsClass*>(context)->publishTask();
+}
+
+void MqttSettingsClass::publishTask()
+{
+    std::unique_lock<std::mutex> lock(_outboxMutex);
+
+    while (true) {
+        auto iter = std::find_if(_outboxes.begin(), _outboxes.end(),
+                [](Outbox const& outbox) { return !outbox.Messages.empty(); });
+
+        if (iter == _outboxes.end()) {
+            _outboxCv.wait(lock); // releases the mutex
+            continue;
+        }
+
+        // keep the messages while the client is not connected. new
+        // messages will replace them once the outbox is full.
+        lock.unlock();
+        bool connected = getConnected();
+        lock.lock();
+
+        if (!connected) {
+            _outboxCv.wait_for(lock, std::chrono::seconds(1));
+            continue;
+        }
+
+        auto& outbox = *iter;
+        if (outbox.Messages.empty()) { continue; } // dropped in the meantime
+
+        OutboundMessage message = std::move(outbox.Messages.front());
+        outbox.Messages.pop_front();
+        outbox.Bytes -= message.spTopic->length() + message.Payload.length();
+        ++outbox.Published;
+
+        lock.unlock(); // publishing might take a while
+        bool published = publishImmediately(*message.spTopic, message.Payload, message.Retain, message.Qos);
+        if (published && message.OnPublished) { message.OnPublished(); }
+        lock.lock();
     }
-    _mqttClient->publish(topic.c_str(), qos, retain, payload.c_str());
 }
 
 void MqttSettingsClass::init()
@@ -217,6 +348,12 @@ void MqttSettingsClass::init()
     NetworkSettings.onEvent(std::bind(&MqttSettingsClass::NetworkEvent, this, _1));
 
     createMqttClientObject();
+
+    // pinned to the core of the network stack, as the other core polls the
+    // inverter radios.
+    uint32_t constexpr stackSize = 3072;
+    xTaskCreatePinnedToCore(MqttSettingsClass::publishTaskHelper, "MQTT:publish",
+            stackSize, this, 1/*prio*/, &_publishTaskHandle, 0/*core*/);
 }
 
 void MqttSettingsClass::createMqttClientObject()
@@ -3,18 +3,22 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "NetworkSettings.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
 #include "MessageOutput.h"
 #include "SyslogLogger.h"
 #include "PinMapping.h"
+#include "PowerLimiter.h"
 #include "Utils.h"
 #include "__compiled_constants.h"
 #include "defaults.h"
 #include <ESPmDNS.h>
 #include <ETH.h>
+#include <algorithm>
+#include <esp_task.h>
 
 NetworkSettingsClass::NetworkSettingsClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&NetworkSettingsClass::loop, this))
+    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, TaskMonitor.wrap("NetworkSettings::loop", std::bind(&NetworkSettingsClass::loop, this)))
     , _apIp(192, 168, 4, 1)
     , _apNetmask(255, 255, 255, 0)
 {
@@ -35,9 +39,9 @@ void NetworkSettingsClass::init(Scheduler& scheduler)
 
     if (PinMapping.isValidW5500Config()) {
         PinMapping_t& pin = PinMapping.get();
-        _w5500 = W5500::setup(pin.w5500_mosi, pin.w5500_miso, pin.w5500_sclk, pin.w5500_cs, pin.w5500_int, pin.w5500_rst);
+        _w5500 = W5500::setup(pin.w5500_mosi, pin.w5500_miso, pin.w5500_sclk, pin.w5500_cs, pin.w5500_int, pin.w5500_rst, pin.w5500_spi_mhz);
         if (_w5500)
-            MessageOutput.println("W5500: Connection successful");
+            MessageOutput.printf("W5500: Connection successful (SPI at %u MHz)\r\n", pin.w5500_spi_mhz);
         else
             MessageOutput.println("W5500: Connection error!!");
     }
@@ -216,13 +220,24 @@ void NetworkSettingsClass::loop()
             WiFi.mode(WIFI_MODE_NULL);
             setStaticIp();
             setHostname();
+            raiseEvent(network_event::NETWORK_INTERFACE_CHANGED);
+
+            // the address might have been assigned before we switched, in
+            // which case the event was ignored.
+            if (ETH.localIP()[0] != 0) {
+                raiseEvent(network_event::NETWORK_GOT_IP);
+            }
         }
     } else if (_networkMode != network_mode::WiFi) {
         // Do stuff when switching to Ethernet mode
         MessageOutput.println("Switch to WiFi mode");
+        bool wasEthernet = _networkMode == network_mode::Ethernet;
         _networkMode = network_mode::WiFi;
         enableAdminMode();
         applyConfig();
+        if (wasEthernet) {
+            raiseEvent(network_event::NETWORK_INTERFACE_CHANGED);
+        }
     }
 
     if (millis() - _lastTimerCall > 1000) {
@@ -235,6 +250,7 @@ void NetworkSettingsClass::loop()
         _connectTimeoutTimer++;
         _connectRedoTimer++;
         _lastTimerCall = millis();
+        handleLatencyMode();
     }
     if (_adminEnabled) {
         // Don't disable the admin mode when network is not available
@@ -279,6 +295,35 @@ void NetworkSettingsClass::loop()
     handleMDNS();
 }
 
+// the modem sleep of the WiFi station delays incoming packets until the next
+// DTIM beacon, which adds 100 ms and more of jitter to power meter readings
+// and MQTT messages. the async_tcp task, which is pinned to the core of the
+// WiFi and lwIP tasks (not the one polling the radios), is prioritized for
+// the same reason while low latency is requested.
+void NetworkSettingsClass::handleLatencyMode()
+{
+    auto mode = static_cast<LatencyMode>(Configuration.get().WiFi.LatencyMode);
+
+    bool lowLatency = mode == LatencyMode::LowLatency
+        || (mode == LatencyMode::Auto && PowerLimiter.isGoverningProducingInverters());
+
+    if (_lowLatency == lowLatency) { return; }
+    _lowLatency = lowLatency;
+
+    MessageOutput.printf("Network latency mode: %s\r\n", lowLatency ? "low latency" : "power saving");
+
+    WiFi.setSleep(lowLatency ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM);
+
+    TaskHandle_t const asyncTcp = xTaskGetHandle("async_tcp");
+    if (asyncTcp == nullptr) { return; }
+
+    if (_asyncTcpPriority == 0) { _asyncTcpPriority = uxTaskPriorityGet(asyncTcp); }
+
+    // stays below the lwIP task, which feeds the async_tcp task
+    UBaseType_t priority = std::max<UBaseType_t>(_asyncTcpPriority, ESP_TASK_TCPIP_PRIO - 1);
+    vTaskPrioritySet(asyncTcp, lowLatency ? priority : _asyncTcpPriority);
+}
+
 void NetworkSettingsClass::applyConfig()
 {
     setHostname();
@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "OtaInflater.h"
+#include <esp_rom_crc.h>
+#include <cstdlib>
+
+#if CONFIG_IDF_TARGET_ESP32
+#include <esp32/rom/miniz.h>
+#elif CONFIG_IDF_TARGET_ESP32S2
+#include <esp32s2/rom/miniz.h>
+#elif CONFIG_IDF_TARGET_ESP32C3
+#include <esp32c3/rom/miniz.h>
+#elif CONFIG_IDF_TARGET_ESP32S3
+#include <esp32s3/rom/miniz.h>
+#else
+#error Target CONFIG_IDF_TARGET is not supported
+#endif
+
+namespace {
+
+// flags of the gzip header, see RFC 1952
+constexpr uint8_t FHCRC = 0x02;
+constexpr uint8_t FEXTRA = 0x04;
+constexpr uint8_t FNAME = 0x08;
+constexpr uint8_t FCOMMENT = 0x10;
+
+uint32_t readLe32(uint8_t const* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+}; // namespace
+
+bool OtaInflater::begin(sink_t sink)
+{
+    end();
+
+    _pDecompressor = malloc(sizeof(tinfl_decompressor));
+    _pDictionary = static_cast<uint8_t*>(malloc(TINFL_LZ_DICT_SIZE));
+    if (_pDecompressor == nullptr || _pDictionary == nullptr) {
+        end();
+        return fail("Not enough memory to decompress the image");
+    }
+
+    tinfl_init(static_cast<tinfl_decompressor*>(_pDecompressor));
+
+    _sink = std::move(sink);
+    _dictionaryOffset = 0;
+    _stage = Stage::Header;
+    _flags = 0;
+    _fieldLength = 0;
+    _skip = 0;
+    _crc = 0;
+    _size = 0;
+    _error = "";
+    return true;
+}
+
+void OtaInflater::end()
+{
+    free(_pDecompressor);
+    _pDecompressor = nullptr;
+    free(_pDictionary);
+    _pDictionary = nullptr;
+    _sink = nullptr;
+}
+
+bool OtaInflater::fail(char const* error)
+{
+    _error = error;
+    _stage = Stage::Failed;
+    return false;
+}
+
+bool OtaInflater::write(uint8_t const* data, size_t len)
+{
+    if (_pDecompressor == nullptr && _stage != Stage::Failed) {
+        return fail("Decompression was not started");
+    }
+
+    while (len > 0) {
+        size_t consumed = 0;
+
+        switch (_stage) {
+            case Stage::Deflate:
+                consumed = inflate(data, len);
+                break;
+            case Stage::Trailer:
+                consumed = parseTrailer(data, len);
+                break;
+            case Stage::Done:
+                return fail("Unexpected data after the compressed image");
+            case Stage::Failed:
+                return false;
+            default:
+                consumed = parseHeader(data, len);
+                break;
+        }
+
+        if (_stage == Stage::Failed) { return false; }
+
+        data += consumed;
+        len -= consumed;
+    }
+
+    return true;
+}
+
+size_t OtaInflater::parseHeader(uint8_t const* data, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len && _stage != Stage::Deflate && _stage != Stage::Failed) {
+        uint8_t byte = data[i++];
+
+        switch (_stage) {
+            case Stage::Header:
+                _fieldBytes[_fieldLength++] = byte;
+                if (_fieldLength < 10) { break; }
+
+                // ID1, ID2 and the compression method, which is deflate
+                if (_fieldBytes[0] != 0x1f || _fieldBytes[1] != 0x8b || _fieldBytes[2] != 8) {
+                    fail("The image is not gzip-compressed");
+                    break;
+                }
+
+                _flags = _fieldBytes[3];
+                _fieldLength = 0;
+                _stage = Stage::Extra;
+                if ((_flags & FEXTRA) == 0) { _stage = Stage::Name; }
+                break;
+
+            case Stage::Extra:
+                if (_fieldLength < 2) {
+                    _fieldBytes[_fieldLength++] = byte;
+                    if (_fieldLength == 2) { _skip = _fieldBytes[0] | (_fieldBytes[1] << 8); }
+                } else {
+                    --_skip;
+                }
+                if (_fieldLength == 2 && _skip == 0) {
+                    _fieldLength = 0;
+                    _stage = Stage::Name;
+                }
+                break;
+
+            // absent fields do not consume the byte
+            case Stage::Name:
+                if ((_flags & FNAME) != 0 && byte != 0) { break; }
+                _stage = Stage::Comment;
+                if ((_flags & FNAME) == 0) { --i; }
+                break;
+
+            case Stage::Comment:
+                if ((_flags & FCOMMENT) != 0 && byte != 0) { break; }
+                _stage = Stage::HeaderCrc;
+                if ((_flags & FCOMMENT) == 0) { --i; }
+                break;
+
+            case Stage::HeaderCrc:
+                if ((_flags & FHCRC) != 0 && ++_fieldLength < 2) { break; }
+                _fieldLength = 0;
+                _stage = Stage::Deflate;
+                if ((_flags & FHCRC) == 0) { --i; }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return i;
+}
+
+size_t OtaInflater::inflate(uint8_t const* data, size_t len)
+{
+    auto pDecompressor = static_cast<tinfl_decompressor*>(_pDecompressor);
+    size_t consumed = 0;
+
+    while (true) {
+        size_t inBytes = len - consumed;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - _dictionaryOffset;
+        uint8_t* pOut = _pDictionary + _dictionaryOffset;
+
+        // the dictionary doubles as the output buffer and wraps around
+        tinfl_status status = tinfl_decompress(pDecompressor, data + consumed, &inBytes,
+                _pDictionary, pOut, &outBytes, TINFL_FLAG_HAS_MORE_INPUT);
+        consumed += inBytes;
+
+        if (outBytes > 0) {
+            _crc = esp_rom_crc32_le(_crc, pOut, outBytes);
+            _size += outBytes;
+            if (!_sink(pOut, outBytes)) {
+                fail("Could not write flash");
+                return consumed;
+            }
+            _dictionaryOffset = (_dictionaryOffset + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            fail("The compressed image is corrupt");
+            return consumed;
+        }
+
+        if (status == TINFL_STATUS_DONE) {
+            _fieldLength = 0;
+            _stage = Stage::Trailer;
+            return consumed;
+        }
+
+        // all input was consumed, and all output was flushed
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT && consumed == len) {
+            return consumed;
+        }
+    }
+}
+
+size_t OtaInflater::parseTrailer(uint8_t const* data, size_t len)
+{
+    size_t i = 0;
+    while (i < len && _fieldLength < 8) {
+        _fieldBytes[_fieldLength++] = data[i++];
+    }
+
+    if (_fieldLength < 8) { return i; }
+
+    if (readLe32(_fieldBytes) != _crc) {
+        fail("Checksum of the decompressed image mismatch");
+    } else if (readLe32(_fieldBytes + 4) != _size) {
+        fail("Size of the decompressed image mismatch");
+    } else {
+        _stage = Stage::Done;
+    }
+
+    return i;
+}
@@ -3,10 +3,12 @@
  * Copyright (C) 2022 - 2023 Thomas Basler and others
  */
 #include "PinMapping.h"
+#include "FsWriteMonitor.h"
 #include "MessageOutput.h"
 #include "Utils.h"
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include <esp_rom_crc.h>
 #include <string.h>
 
 #ifndef DISPLAY_TYPE
@@ -61,6 +63,30 @@
 #define HOYMILES_PIN_MOSI -1
 #endif
 
+#ifndef HOYMILES_PIN_CS2
+#define HOYMILES_PIN_CS2 -1
+#endif
+
+#ifndef HOYMILES_PIN_CE2
+#define HOYMILES_PIN_CE2 -1
+#endif
+
+#ifndef HOYMILES_PIN_IRQ2
+#define HOYMILES_PIN_IRQ2 -1
+#endif
+
+#ifndef HOYMILES_PIN_CS3
+#define HOYMILES_PIN_CS3 -1
+#endif
+
+#ifndef HOYMILES_PIN_CE3
+#define HOYMILES_PIN_CE3 -1
+#endif
+
+#ifndef HOYMILES_PIN_IRQ3
+#define HOYMILES_PIN_IRQ3 -1
+#endif
+
 #ifndef CMT_CLK
 #define CMT_CLK -1
 #endif
@@ -109,6 +135,12 @@
 #define W5500_RST -1
 #endif
 
+// stable with OpenDTU Fusion shield. the W5500 is specified up to 33 MHz,
+// but is known to work with up to 80 MHz given short traces.
+#ifndef W5500_SPI_MHZ
+#define W5500_SPI_MHZ 20
+#endif
+
 #if CONFIG_ETH_USE_ESP32_EMAC
 
 #ifndef ETH_PHY_ADDR
@@ -187,6 +219,38 @@
 #define BATTERY_PIN_TXEN -1
 #endif
 
+#ifndef BATTERY_PIN_RX2
+#define BATTERY_PIN_RX2 -1
+#endif
+
+#ifndef BATTERY_PIN_RXEN2
+#define BATTERY_PIN_RXEN2 -1
+#endif
+
+#ifndef BATTERY_PIN_TX2
+#define BATTERY_PIN_TX2 -1
+#endif
+
+#ifndef BATTERY_PIN_TXEN2
+#define BATTERY_PIN_TXEN2 -1
+#endif
+
+#ifndef BATTERY_PIN_RX3
+#define BATTERY_PIN_RX3 -1
+#endif
+
+#ifndef BATTERY_PIN_RXEN3
+#define BATTERY_PIN_RXEN3 -1
+#endif
+
+#ifndef BATTERY_PIN_TX3
+#define BATTERY_PIN_TX3 -1
+#endif
+
+#ifndef BATTERY_PIN_TXEN3
+#define BATTERY_PIN_TXEN3 -1
+#endif
+
 #ifndef HUAWEI_PIN_MISO
 #define HUAWEI_PIN_MISO -1
 #endif
@@ -250,6 +314,12 @@ PinMappingClass::PinMappingClass()
     _pinMapping.nrf24_irq = HOYMILES_PIN_IRQ;
     _pinMapping.nrf24_miso = HOYMILES_PIN_MISO;
     _pinMapping.nrf24_mosi = HOYMILES_PIN_MOSI;
+    _pinMapping.nrf24_cs2 = HOYMILES_PIN_CS2;
+    _pinMapping.nrf24_en2 = HOYMILES_PIN_CE2;
+    _pinMapping.nrf24_irq2 = HOYMILES_PIN_IRQ2;
+    _pinMapping.nrf24_cs3 = HOYMILES_PIN_CS3;
+    _pinMapping.nrf24_en3 = HOYMILES_PIN_CE3;
+    _pinMapping.nrf24_irq3 = HOYMILES_PIN_IRQ3;
 
     _pinMapping.cmt_clk = CMT_CLK;
     _pinMapping.cmt_cs = CMT_CS;
@@ -264,6 +334,7 @@ PinMappingClass::PinMappingClass()
     _pinMapping.w5500_cs = W5500_CS;
     _pinMapping.w5500_int = W5500_INT;
     _pinMapping.w5500_rst = W5500_RST;
+    _pinMapping.w5500_spi_mhz = W5500_SPI_MHZ;
 
 #if CONFIG_ETH_USE_ESP32_EMAC
 #ifdef OPENDTU_ETHERNET
@@ -303,6 +374,16 @@ PinMappingClass::PinMappingClass()
     _pinMapping.battery_tx = BATTERY_PIN_TX;
     _pinMapping.battery_txen = BATTERY_PIN_TXEN;
 
+    _pinMapping.battery_rx2 = BATTERY_PIN_RX2;
+    _pinMapping.battery_rxen2 = BATTERY_PIN_RXEN2;
+    _pinMapping.battery_tx2 = BATTERY_PIN_TX2;
+    _pinMapping.battery_txen2 = BATTERY_PIN_TXEN2;
+
+    _pinMapping.battery_rx3 = BATTERY_PIN_RX3;
+    _pinMapping.battery_rxen3 = BATTERY_PIN_RXEN3;
+    _pinMapping.battery_tx3 = BATTERY_PIN_TX3;
+    _pinMapping.battery_txen3 = BATTERY_PIN_TXEN3;
+
     _pinMapping.huawei_miso = HUAWEI_PIN_MISO;
     _pinMapping.huawei_mosi = HUAWEI_PIN_MOSI;
     _pinMapping.huawei_clk = HUAWEI_PIN_SCLK;
@@ -324,6 +405,34 @@ PinMapping_t& PinMappingClass::get()
     return _pinMapping;
 }
 
+BatteryPins_t PinMappingClass::getBatteryPins(uint8_t set) const
+{
+    switch (set) {
+        case 1:
+            return { _pinMapping.battery_rx2, _pinMapping.battery_rxen2,
+                _pinMapping.battery_tx2, _pinMapping.battery_txen2 };
+        case 2:
+            return { _pinMapping.battery_rx3, _pinMapping.battery_rxen3,
+                _pinMapping.battery_tx3, _pinMapping.battery_txen3 };
+        default:
+            break;
+    }
+
+    return { _pinMapping.battery_rx, _pinMapping.battery_rxen,
+        _pinMapping.battery_tx, _pinMapping.battery_txen };
+}
+
+static constexpr uint32_t CacheMagic = 0x4d50504f; // "OPPM"
+
+struct PinMappingCacheHeader {
+    uint32_t Magic;
+    uint32_t BuildId; // identifies the layout of PinMapping_t and the defaults
+    uint32_t JsonSize; // size of pin_mapping.json the record belongs to
+    uint32_t JsonTime; // last write of pin_mapping.json
+    uint32_t NameCrc; // of the selected device mapping
+    uint32_t PayloadCrc;
+};
+
 bool PinMappingClass::init(const String& deviceMapping)
 {
     File f = LittleFS.open(PINMAPPING_FILENAME, "r", false);
@@ -332,6 +441,13 @@ bool PinMappingClass::init(const String& deviceMapping)
         return false;
     }
 
+    uint32_t jsonSize = f.size();
+    uint32_t jsonTime = static_cast<uint32_t>(f.getLastWrite());
+    if (readCache(deviceMapping, jsonSize, jsonTime)) {
+        _mappingSelected = true;
+        return true;
+    }
+
     Utils::skipBom(f);
 
     JsonDocument doc;
@@ -353,6 +469,12 @@ bool PinMappingClass::init(const String& deviceMapping)
             _pinMapping.nrf24_irq = doc[i]["nrf24"]["irq"] | HOYMILES_PIN_IRQ;
             _pinMapping.nrf24_miso = doc[i]["nrf24"]["miso"] | HOYMILES_PIN_MISO;
             _pinMapping.nrf24_mosi = doc[i]["nrf24"]["mosi"] | HOYMILES_PIN_MOSI;
+            _pinMapping.nrf24_cs2 = doc[i]["nrf24"]["cs2"] | HOYMILES_PIN_CS2;
+            _pinMapping.nrf24_en2 = doc[i]["nrf24"]["en2"] | HOYMILES_PIN_CE2;
+            _pinMapping.nrf24_irq2 = doc[i]["nrf24"]["irq2"] | HOYMILES_PIN_IRQ2;
+            _pinMapping.nrf24_cs3 = doc[i]["nrf24"]["cs3"] | HOYMILES_PIN_CS3;
+            _pinMapping.nrf24_en3 = doc[i]["nrf24"]["en3"] | HOYMILES_PIN_CE3;
+            _pinMapping.nrf24_irq3 = doc[i]["nrf24"]["irq3"] | HOYMILES_PIN_IRQ3;
 
             _pinMapping.cmt_clk = doc[i]["cmt"]["clk"] | CMT_CLK;
             _pinMapping.cmt_cs = doc[i]["cmt"]["cs"] | CMT_CS;
@@ -367,6 +489,7 @@ bool PinMappingClass::init(const String& deviceMapping)
             _pinMapping.w5500_cs = doc[i]["w5500"]["cs"] | W5500_CS;
             _pinMapping.w5500_int = doc[i]["w5500"]["int"] | W5500_INT;
             _pinMapping.w5500_rst = doc[i]["w5500"]["rst"] | W5500_RST;
+            _pinMapping.w5500_spi_mhz = doc[i]["w5500"]["spi_mhz"] | W5500_SPI_MHZ;
 
 #if CONFIG_ETH_USE_ESP32_EMAC
 #ifdef OPENDTU_ETHERNET
@@ -403,6 +526,14 @@ bool PinMappingClass::init(const String& deviceMapping)
             _pinMapping.battery_rxen = doc[i]["battery"]["rxen"] | BATTERY_PIN_RXEN;
             _pinMapping.battery_tx = doc[i]["battery"]["tx"] | BATTERY_PIN_TX;
             _pinMapping.battery_txen = doc[i]["battery"]["txen"] | BATTERY_PIN_TXEN;
+            _pinMapping.battery_rx2 = doc[i]["battery"]["rx2"] | BATTERY_PIN_RX2;
+            _pinMapping.battery_rxen2 = doc[i]["battery"]["rxen2"] | BATTERY_PIN_RXEN2;
+            _pinMapping.battery_tx2 = doc[i]["battery"]["tx2"] | BATTERY_PIN_TX2;
+            _pinMapping.battery_txen2 = doc[i]["battery"]["txen2"] | BATTERY_PIN_TXEN2;
+            _pinMapping.battery_rx3 = doc[i]["battery"]["rx3"] | BATTERY_PIN_RX3;
+            _pinMapping.battery_rxen3 = doc[i]["battery"]["rxen3"] | BATTERY_PIN_RXEN3;
+            _pinMapping.battery_tx3 = doc[i]["battery"]["tx3"] | BATTERY_PIN_TX3;
+            _pinMapping.battery_txen3 = doc[i]["battery"]["txen3"] | BATTERY_PIN_TXEN3;
 
             _pinMapping.huawei_miso = doc[i]["huawei"]["miso"] | HUAWEI_PIN_MISO;
             _pinMapping.huawei_mosi = doc[i]["huawei"]["mosi"] | HUAWEI_PIN_MOSI;
@@ -419,6 +550,8 @@ bool PinMappingClass::init(const String& deviceMapping)
             _pinMapping.powermeter_rxen = doc[i]["powermeter"]["rxen"] | POWERMETER_PIN_RXEN;
             _pinMapping.powermeter_txen = doc[i]["powermeter"]["txen"] | POWERMETER_PIN_TXEN;
 
+            f.close();
+            writeCache(deviceMapping, jsonSize, jsonTime);
             return true;
         }
     }
@@ -426,6 +559,66 @@ bool PinMappingClass::init(const String& deviceMapping)
     return false;
 }
 
+uint32_t PinMappingClass::getBuildId()
+{
+    // pins missing in the JSON file take the defaults compiled into this
+    // build, hence a record written by a different build is never trusted.
+    static constexpr char build[] = __COMPILED_GIT_HASH__ " " __DATE__ " " __TIME__;
+    uint32_t const size = sizeof(PinMapping_t);
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(&size), sizeof(size));
+    return esp_rom_crc32_le(crc, reinterpret_cast<uint8_t const*>(build), sizeof(build) - 1);
+}
+
+bool PinMappingClass::readCache(const String& deviceMapping, uint32_t jsonSize, uint32_t jsonTime)
+{
+    File f = LittleFS.open(PINMAPPING_CACHE_FILENAME, "r", false);
+    if (!f) {
+        return false;
+    }
+
+    // pin_mapping.json was replaced or another device mapping was selected
+    PinMappingCacheHeader header;
+    if (f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header)
+            || header.Magic != CacheMagic || header.BuildId != getBuildId()
+            || header.JsonSize != jsonSize || header.JsonTime != jsonTime
+            || header.NameCrc != esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(deviceMapping.c_str()), deviceMapping.length())) {
+        return false;
+    }
+
+    PinMapping_t mapping;
+    auto data = reinterpret_cast<uint8_t*>(&mapping);
+    if (f.read(data, sizeof(mapping)) != sizeof(mapping)
+            || esp_rom_crc32_le(0, data, sizeof(mapping)) != header.PayloadCrc) {
+        return false;
+    }
+
+    _pinMapping = mapping;
+    return true;
+}
+
+void PinMappingClass::writeCache(const String& deviceMapping, uint32_t jsonSize, uint32_t jsonTime)
+{
+    File f = LittleFS.open(PINMAPPING_CACHE_FILENAME, "w");
+    if (!f) {
+        return;
+    }
+
+    auto data = reinterpret_cast<uint8_t const*>(&_pinMapping);
+    PinMappingCacheHeader header = { CacheMagic, getBuildId(), jsonSize, jsonTime,
+        esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(deviceMapping.c_str()), deviceMapping.length()),
+        esp_rom_crc32_le(0, data, sizeof(_pinMapping)) };
+    bool success = f.write(reinterpret_cast<uint8_t const*>(&header), sizeof(header)) == sizeof(header)
+        && f.write(data, sizeof(_pinMapping)) == sizeof(_pinMapping);
+    f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::DataCache, sizeof(header) + sizeof(_pinMapping));
+
+    // an incomplete record would be rejected anyway, but don't keep it
+    if (!success) {
+        LittleFS.remove(PINMAPPING_CACHE_FILENAME);
+    }
+}
+
 bool PinMappingClass::isValidNrf24Config() const
 {
     return _pinMapping.nrf24_clk >= 0
@@ -436,6 +629,26 @@ bool PinMappingClass::isValidNrf24Config() const
         && _pinMapping.nrf24_mosi >= 0;
 }
 
+bool PinMappingClass::isValidNrf24Config(const uint8_t index) const
+{
+    switch (index) {
+        case 0:
+            return isValidNrf24Config();
+        case 1:
+            return isValidNrf24Config()
+                && _pinMapping.nrf24_cs2 >= 0
+                && _pinMapping.nrf24_en2 >= 0
+                && _pinMapping.nrf24_irq2 >= 0;
+        case 2:
+            return isValidNrf24Config()
+                && _pinMapping.nrf24_cs3 >= 0
+                && _pinMapping.nrf24_en3 >= 0
+                && _pinMapping.nrf24_irq3 >= 0;
+        default:
+            return false;
+    }
+}
+
 bool PinMappingClass::isValidCmt2300Config() const
 {
     return _pinMapping.cmt_clk >= 0
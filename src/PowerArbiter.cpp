@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerArbiter.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "PowerMeter.h"
+#include <Arduino.h>
+#include <algorithm>
+
+PowerArbiterClass PowerArbiter;
+
+void PowerArbiterClass::setInverterState(bool governsBatteryPoweredInverters, float batteryInvertersOutputWatts)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _inverterActive = governsBatteryPoweredInverters;
+    _batteryInvertersOutputWatts = batteryInvertersOutputWatts;
+    _inverterStateMillis = millis();
+}
+
+void PowerArbiterClass::setChargerState(bool autoPowerControl, float inputPowerWatts)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _chargerActive = autoPowerControl;
+    _chargerInputWatts = inputPowerWatts;
+    _chargerStateMillis = millis();
+}
+
+bool PowerArbiterClass::isActiveUnlocked() const
+{
+    uint32_t now = millis();
+    return _inverterActive && (now - _inverterStateMillis) < _stateTimeoutMs
+        && _chargerActive && (now - _chargerStateMillis) < _stateTimeoutMs;
+}
+
+bool PowerArbiterClass::isActive()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return isActiveUnlocked();
+}
+
+void PowerArbiterClass::update()
+{
+    // NOTE: the mutex is locked by the caller
+
+    if (!isActiveUnlocked()) {
+        _mode = Mode::Discharge;
+        _chargerSetpoint = 0;
+        return;
+    }
+
+    if (!PowerMeter.isDataValid()) {
+        _chargerSetpoint = 0;
+        return;
+    }
+
+    auto sample = PowerMeter.getLastUpdate();
+    if (sample == _lastSample) { return; }
+    _lastSample = sample;
+
+    auto const& config = Configuration.get();
+
+    // the grid power if neither the charger nor the inverters were running
+    float basePower = PowerMeter.getPowerTotal() + _chargerInputWatts - _batteryInvertersOutputWatts;
+    float chargerShare = config.Huawei.Auto_Power_Target_Power_Consumption - basePower;
+    float inverterShare = basePower - config.PowerLimiter.TargetPowerConsumption;
+
+    uint32_t now = millis();
+    bool mayToggle = (now - _modeSinceMillis) >= _minModeDurationMs;
+
+    Mode mode = _mode;
+    if (mode == Mode::Discharge && chargerShare > _switchHysteresisWatts) { mode = Mode::Charge; }
+    if (mode == Mode::Charge && inverterShare > _switchHysteresisWatts) { mode = Mode::Discharge; }
+
+    if (mode != _mode && mayToggle) {
+        MessageOutput.printf("[PowerArbiter] base power %.0f W, switching to %s\r\n",
+                basePower, (mode == Mode::Charge ? "charging" : "discharging"));
+        _mode = mode;
+        _modeSinceMillis = now;
+    }
+
+    _chargerSetpoint = (_mode == Mode::Charge) ? std::max(0.0f, chargerShare) : 0;
+}
+
+PowerArbiterClass::Mode PowerArbiterClass::getMode()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    update();
+    return _mode;
+}
+
+float PowerArbiterClass::getChargerSetpoint()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    update();
+    return _chargerSetpoint;
+}
+
+float PowerArbiterClass::getChargerPowerToDisregard()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    update();
+    if (!isActiveUnlocked() || _mode != Mode::Discharge) { return 0; }
+    return _chargerInputWatts;
+}
@@ -4,17 +4,29 @@
  */
 
 #include "Battery.h"
+#include "EventBus.h"
+#include "TaskMonitor.h"
 #include "PowerMeter.h"
 #include "PowerLimiter.h"
+#include "PowerLimiterLatency.h"
+#include "PowerLimiterTrace.h"
+#include "PowerLimiterDischargePlan.h"
+#include "PowerLimiterCluster.h"
+#include "PowerArbiter.h"
+#include "RtcState.h"
 #include "Configuration.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
 #include <gridcharger/huawei/Controller.h>
 #include <solarcharger/Controller.h>
 #include "MessageOutput.h"
+#include "MetricsRegistry.h"
+#include <array>
+#include <algorithm>
 #include <ctime>
 #include <cmath>
 #include <limits>
+#include <numeric>
 #include <frozen/map.h>
 #include "SunPosition.h"
 
@@ -36,21 +48,66 @@ static auto sSmartBufferPoweredFilter = [](PowerLimiterInverter const& inv) {
 
 static const char sSmartBufferPoweredExpression[] = "smart-buffer-powered";
 
+// appended to the expressions above while regulating the phases
+static const char* const sPhaseGroupSuffixes[] = { " all-phase", " L1", " L2", " L3" };
+
 PowerLimiterClass PowerLimiter;
 
 void PowerLimiterClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&PowerLimiterClass::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("PowerLimiter::loop", std::bind(&PowerLimiterClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
+
+    EventBus.subscribe<Events::MeterSample>([this](Events::MeterSample const&) {
+        notifyPowerMeterUpdate();
+    });
+    EventBus.subscribe<Events::BatterySnapshot>([this](Events::BatterySnapshot const&) {
+        _slowInputsUpdatedFlag = true;
+    });
+
+    // resume where the DPL left off before a soft reset
+    auto oState = RtcState.getDplState();
+    if (oState) {
+        _mode = static_cast<Mode>(oState->Mode);
+        _batteryDischargeEnabled = oState->BatteryDischargeEnabled;
+        _nighttimeDischarging = oState->NighttimeDischarging;
+        _fullSolarPassThroughEnabled = oState->FullSolarPassThroughEnabled;
+    }
+
+    registerMetrics();
+}
+
+void PowerLimiterClass::registerMetrics()
+{
+    using Type = MetricsRegistryClass::Type;
+
+    MetricsRegistry.add("opendtu_dpl_enabled", "Dynamic power limiter is enabled", Type::Gauge,
+        []() -> std::optional<float> { return Configuration.get().PowerLimiter.Enabled ? 1 : 0; });
+
+    auto ifEnabled = [](auto getter) {
+        return [getter]() -> std::optional<float> {
+            if (!Configuration.get().PowerLimiter.Enabled) { return std::nullopt; }
+            return static_cast<float>(getter());
+        };
+    };
+
+    MetricsRegistry.add("opendtu_dpl_mode", "Dynamic power limiter mode (0: normal, 1: disabled, 2: full solar passthrough)", Type::Gauge,
+        ifEnabled([this]() { return static_cast<unsigned>(getMode()); }));
+    MetricsRegistry.add("opendtu_dpl_state", "Dynamic power limiter state", Type::Gauge,
+        ifEnabled([this]() { return getPowerLimiterState(); }));
+    MetricsRegistry.add("opendtu_dpl_inverter_output", "Expected output of the governed inverters in W", Type::Gauge,
+        ifEnabled([this]() { return getInverterOutput(); }));
+    MetricsRegistry.add("opendtu_dpl_inverter_update_timeouts", "Number of consecutive inverter update timeouts", Type::Gauge,
+        ifEnabled([this]() { return getInverterUpdateTimeouts(); }));
 }
 
 frozen::string const& PowerLimiterClass::getStatusText(PowerLimiterClass::Status status)
 {
     static const frozen::string missing = "programmer error: missing status text";
 
-    static const frozen::map<Status, frozen::string, 11> texts = {
+    static const frozen::map<Status, frozen::string, 12> texts = {
         { Status::Initializing, "initializing (should not see me)" },
         { Status::DisabledByConfig, "disabled by configuration" },
         { Status::DisabledByMqtt, "disabled by MQTT" },
@@ -62,6 +119,7 @@ frozen::string const& PowerLimiterClass::getStatusText(PowerLimiterClass::Status
         { Status::InverterStatsPending, "waiting for sufficiently recent inverter data" },
         { Status::UnconditionalSolarPassthrough, "unconditionally passing through all solar power (MQTT override)" },
         { Status::Stable, "the system is stable, the last power limit is still valid" },
+        { Status::ClusterSharePending, "waiting for the cluster leader to assign a share of the requested power" },
     };
 
     auto iter = texts.find(status);
@@ -72,6 +130,8 @@ frozen::string const& PowerLimiterClass::getStatusText(PowerLimiterClass::Status
 
 void PowerLimiterClass::announceStatus(PowerLimiterClass::Status status)
 {
+    PowerLimiterTrace.addStatus(static_cast<uint8_t>(status));
+
     // this method is called with high frequency. print the status text if
     // the status changed since we last printed the text of another one.
     // otherwise repeat the info with a fixed interval.
@@ -122,31 +182,46 @@ bool PowerLimiterClass::isDisabled()
     return true;
 }
 
-void PowerLimiterClass::reloadConfig()
+// applies changed settings. only inverter instances whose settings changed
+// are recreated, which loses their state. returns true if that happened (or
+// is still in progress), such that the DPL must start over. all other
+// settings are read by the DPL in every cycle and apply right away.
+bool PowerLimiterClass::reloadConfig()
 {
     auto const& config = Configuration.get();
 
     _verboseLogging = config.PowerLimiter.VerboseLogging;
 
-    // clean up all inverter instances. put inverters into
-    // standby if they will not be governed any more.
-    auto iter = _inverters.begin();
-    while (iter != _inverters.end()) {
-        bool stillGoverned = false;
-
+    auto findConfig = [&config](uint64_t serial) -> PowerLimiterInverterConfig const* {
         for (size_t i = 0; i < INV_MAX_COUNT; ++i) {
             auto const& inv = config.PowerLimiter.Inverters[i];
             if (inv.Serial == 0ULL) { break; }
-            stillGoverned = inv.Serial == (*iter)->getSerial() && inv.IsGoverned;
-            if (stillGoverned) { break; }
+            if (inv.Serial == serial && inv.IsGoverned) { return &inv; }
+        }
+        return nullptr;
+    };
+
+    bool recreated = false;
+
+    // clean up inverter instances whose settings changed. put inverters
+    // into standby if they will not be governed any more.
+    auto iter = _inverters.begin();
+    while (iter != _inverters.end()) {
+        auto pConfig = findConfig((*iter)->getSerial());
+
+        if (pConfig && (*iter)->matches(*pConfig)) {
+            (*iter)->setVerboseLogging(_verboseLogging);
+            ++iter;
+            continue;
         }
 
-        if (!stillGoverned) {
+        if (!pConfig) {
             (*iter)->standby();
-            if ((*iter)->update()) { return; }
+            if ((*iter)->update()) { return true; }
         }
 
         iter = _inverters.erase(iter);
+        recreated = true;
     }
 
     for (size_t i = 0; i < INV_MAX_COUNT; ++i) {
@@ -156,19 +231,29 @@ void PowerLimiterClass::reloadConfig()
 
         if (!invConfig.IsGoverned) { continue; }
 
+        bool exists = std::any_of(_inverters.begin(), _inverters.end(),
+                [&invConfig](auto const& upInv) { return upInv->getSerial() == invConfig.Serial; });
+        if (exists) { continue; }
+
         auto upInv = PowerLimiterInverter::create(_verboseLogging, invConfig);
         if (upInv) { _inverters.push_back(std::move(upInv)); }
+        recreated = true;
     }
 
     calcNextInverterRestart();
 
     _reloadConfigFlag = false;
+
+    return recreated;
 }
 
 void PowerLimiterClass::loop()
 {
     auto const& config = Configuration.get();
 
+    RtcState.setDplState({ static_cast<uint8_t>(_mode), _batteryDischargeEnabled,
+            _nighttimeDischarging, _fullSolarPassThroughEnabled });
+
     // we know that the Hoymiles library refuses to send any message to any
     // inverter until the system has valid time information. until then we can
     // do nothing, not even shutdown the inverter.
@@ -177,6 +262,8 @@ void PowerLimiterClass::loop()
         return announceStatus(Status::WaitingForValidTimestamp);
     }
 
+    applyExportGuard();
+
     // take care that the last requested power
     // limits and power states are actually reached
     if (updateInverters()) {
@@ -185,8 +272,7 @@ void PowerLimiterClass::loop()
 
     if (isDisabled()) { return; }
 
-    if (_reloadConfigFlag) {
-        reloadConfig();
+    if (_reloadConfigFlag && reloadConfig()) {
         return announceStatus(Status::ConfigReload);
     }
 
@@ -219,16 +305,50 @@ void PowerLimiterClass::loop()
     // arrives. this can be the case for readings provided by networked meter
     // readers, where a packet needs to travel through the network for some
     // time after the actual measurement was done by the reader.
-    if (PowerMeter.isDataValid() && PowerMeter.getLastUpdate() <= (latestInverterStats + 2000)) {
+    // followers in a cluster apply the share assigned by the leader and do
+    // not use their power meter.
+    bool isClusterLeader = PowerLimiterCluster.isLeader();
+
+    if (isClusterLeader && PowerMeter.isDataValid() && PowerMeter.getLastUpdate() <= (latestInverterStats + 2000)) {
         return announceStatus(Status::PowerMeterPending);
     }
 
     // since _lastCalculation and _calculationBackoffMs are initialized to
     // zero, this test is passed the first time the condition is checked.
-    if ((millis() - _lastCalculation) < _calculationBackoffMs) {
+    // a fresh power meter or solar charger reading bypasses the backoff, as
+    // the backoff is only meant to reduce the effort while nothing changes.
+    if ((millis() - _lastCalculation) < _calculationBackoffMs && !_inputUpdatedFlag) {
         return announceStatus(Status::Stable);
     }
 
+    _inputUpdatedFlag = false;
+
+    using Trace = PowerLimiterTraceClass;
+    Trace::Record trace = {};
+    trace.Millis = millis();
+    trace.Time = std::time(nullptr);
+    trace.Status = static_cast<uint8_t>(Status::Stable);
+    trace.Flags = Trace::Calculated | (isClusterLeader ? Trace::ClusterLeader : 0);
+    trace.BatterySoC = 255;
+    int64_t traceMark = esp_timer_get_time();
+
+    // the number of inverters is limited by the size of the trace record
+    auto traceInverters = [this, &trace](bool after) {
+        size_t i = 0;
+        for (auto const& upInv : _inverters) {
+            if (i >= Trace::MaxInverters) { break; }
+            auto& entry = trace.Inverters[i++];
+            if (after) {
+                entry.ExpectedAfterWatts = upInv->getExpectedOutputAcWatts();
+                continue;
+            }
+            entry.Serial = static_cast<uint32_t>(upInv->getSerial());
+            entry.OutputWatts = upInv->getCurrentOutputAcWatts();
+            entry.ExpectedBeforeWatts = upInv->getExpectedOutputAcWatts();
+        }
+        trace.InverterCount = i;
+    };
+
     auto autoRestartInverters = [this]() -> void {
         if (!_nextInverterRestart.first) { return; } // no automatic restarts
 
@@ -247,8 +367,6 @@ void PowerLimiterClass::loop()
         calcNextInverterRestart();
     };
 
-    autoRestartInverters();
-
     auto getBatteryPower = [this,&config]() -> bool {
         if (!usesBatteryPoweredInverter()) { return false; }
 
@@ -261,6 +379,13 @@ void PowerLimiterClass::loop()
 
         if (isStopThresholdReached()) { return false; }
 
+        // the discharge plan governs the whole night, until sunrise
+        PowerLimiterDischargePlan.update();
+        if (PowerLimiterDischargePlan.isActive()) {
+            _nighttimeDischarging = PowerLimiterDischargePlan.isDischargeAllowed();
+            return _nighttimeDischarging;
+        }
+
         if (isStartThresholdReached()) { return true; }
 
         // start a nighttime discharge cycle on a partially charged battery if
@@ -283,12 +408,26 @@ void PowerLimiterClass::loop()
         return _batteryDischargeEnabled;
     };
 
-    _batteryDischargeEnabled = getBatteryPower();
+    PowerArbiter.setInverterState(usesBatteryPoweredInverter(),
+            getBatteryInvertersOutputAcWatts());
+
+    bool evaluateSlowInputs = isSlowInputsEvaluationDue();
+    if (evaluateSlowInputs) {
+        trace.Flags |= Trace::SlowInputsEvaluated;
 
-    // re-calculate load-corrected voltage once (and only once) per DPL loop
-    _oLoadCorrectedVoltage = std::nullopt;
+        autoRestartInverters();
 
-    if (_verboseLogging && (usesBatteryPoweredInverter() || usesSmartBufferPoweredInverter())) {
+        // re-calculate load-corrected voltage once (and only once) per evaluation
+        _oLoadCorrectedVoltage = std::nullopt;
+
+        _batteryDischargeEnabled = getBatteryPower();
+
+        _slowInputs.FullSolarPassthroughActive = isFullSolarPassthroughActive();
+        _slowInputs.BelowStopThreshold = isBelowStopThreshold();
+        _slowInputs.BatteryDischargeLimit = getBatteryDischargeLimit();
+    }
+
+    if (evaluateSlowInputs && _verboseLogging && (usesBatteryPoweredInverter() || usesSmartBufferPoweredInverter())) {
         MessageOutput.printf("[DPL] up %lu s, %snext inverter restart at %d s (set to %d)\r\n",
                 millis()/1000,
                 (_nextInverterRestart.first?"":"NO "),
@@ -296,7 +435,7 @@ void PowerLimiterClass::loop()
                 config.PowerLimiter.RestartHour);
     }
 
-    if (_verboseLogging && usesBatteryPoweredInverter()) {
+    if (evaluateSlowInputs && _verboseLogging && usesBatteryPoweredInverter()) {
         MessageOutput.printf("[DPL] battery interface %sabled, SoC %.1f %% (%s), age %u s (%s)\r\n",
                 (config.Battery.Enabled?"en":"dis"),
                 Battery.getStats()->getSoC(),
@@ -310,6 +449,12 @@ void PowerLimiterClass::loop()
                 getBatteryInvertersOutputAcWatts(),
                 config.PowerLimiter.VoltageLoadCorrectionFactor);
 
+        auto oResistance = Battery.getInternalResistance();
+        if (config.PowerLimiter.VoltageLoadCorrectionAutomatic && oResistance) {
+            MessageOutput.printf("[DPL] estimated battery internal resistance %.1f mOhm\r\n",
+                    *oResistance * 1000);
+        }
+
         MessageOutput.printf("[DPL] battery discharge %s, start %.2f V or %u %%, stop %.2f V or %u %%\r\n",
                 (_batteryDischargeEnabled?"allowed":"restricted"),
                 config.PowerLimiter.VoltageStartThreshold,
@@ -319,7 +464,7 @@ void PowerLimiterClass::loop()
 
         if (isSolarPassThroughEnabled()) {
             MessageOutput.printf("[DPL] full solar-passthrough %s, start %.2f V or %u %%, stop %.2f V\r\n",
-                    (isFullSolarPassthroughActive()?"active":"dormant"),
+                    (_slowInputs.FullSolarPassthroughActive?"active":"dormant"),
                     config.PowerLimiter.FullSolarPassThroughStartVoltage,
                     config.PowerLimiter.FullSolarPassThroughSoc,
                     config.PowerLimiter.FullSolarPassThroughStopVoltage);
@@ -337,32 +482,134 @@ void PowerLimiterClass::loop()
             config.PowerLimiter.ConductionLosses);
     };
 
-    // this value is negative if we are exporting power to the grid
-    // from power sources other than DPL-governed inverters.
-    int16_t consumption = calcConsumption();
+    {
+        auto spStats = Battery.getStats();
+        if (spStats->isVoltageValid()) {
+            trace.BatteryCentiVolts = static_cast<uint16_t>(spStats->getVoltage() * 100 + 0.5f);
+        }
+        if (spStats->isSoCValid()) {
+            trace.BatterySoC = static_cast<uint8_t>(spStats->getSoC() + 0.5f);
+        }
+
+        auto oSolarOutput = SolarCharger.getStats()->getOutputPowerWatts();
+        trace.SolarWatts = oSolarOutput ? static_cast<uint16_t>(std::max(*oSolarOutput, 0.0f)) : 0;
+
+        if (_batteryDischargeEnabled) { trace.Flags |= Trace::BatteryDischarge; }
+        if (_nighttimeDischarging) { trace.Flags |= Trace::NighttimeDischarge; }
+        if (PowerMeter.isDataValid()) { trace.Flags |= Trace::MeterValid; }
+        trace.MeterWatts = static_cast<int16_t>(PowerMeter.getPowerTotal());
+    }
 
-    uint16_t inverterTotalPower = (consumption > 0) ? static_cast<uint16_t>(consumption) : 0;
+    int64_t now = esp_timer_get_time();
+    trace.InputsMicros = Trace::toMicros(traceMark, now);
+    traceMark = now;
 
+    uint16_t localMaxPower = 0;
+    uint16_t localBehindMeterOutput = 0;
+    for (auto const& upInv : _inverters) {
+        if (upInv->isReachable() && upInv->isSendingCommandsEnabled()) {
+            localMaxPower += upInv->getConfiguredMaxPowerWatts();
+        }
+        if (upInv->isBehindPowerMeter()) {
+            localBehindMeterOutput += upInv->getCurrentOutputAcWatts();
+        }
+    }
     auto totalAllowance = config.PowerLimiter.TotalUpperPowerLimit;
-    inverterTotalPower = std::min(inverterTotalPower, totalAllowance);
+    PowerLimiterCluster.setLocalSummary(localMaxPower, localBehindMeterOutput, totalAllowance);
+
+    if (_verboseLogging) { PowerLimiterCluster.debug(); }
+
+    uint16_t inverterTotalPower = 0;
+    std::optional<phase_power_t> oPhaseRequests = std::nullopt;
+
+    if (isClusterLeader) {
+        // this value is negative if we are exporting power to the grid
+        // from power sources other than DPL-governed inverters.
+        int16_t consumption = calcConsumption();
+        trace.ConsumptionWatts = consumption;
 
-    auto coveredBySolar = updateInverterLimits(inverterTotalPower, sSolarPoweredFilter, sSolarPoweredExpression);
-    auto remainingAfterSolar = (inverterTotalPower >= coveredBySolar) ? inverterTotalPower - coveredBySolar : 0;
-    auto coveredBySmartBuffer = updateInverterLimits(remainingAfterSolar, sSmartBufferPoweredFilter, sSmartBufferPoweredExpression);
-    auto remainingAfterSmartBuffer = (remainingAfterSolar >= coveredBySmartBuffer) ? remainingAfterSolar - coveredBySmartBuffer : 0;
-    auto powerBusUsage = calcPowerBusUsage(remainingAfterSmartBuffer);
-    auto coveredByBattery = updateInverterLimits(powerBusUsage, sBatteryPoweredFilter, sBatteryPoweredExpression);
+        inverterTotalPower = (consumption > 0) ? static_cast<uint16_t>(consumption) : 0;
+        // the cluster caps the request at the sum of the units' limits
+        inverterTotalPower = PowerLimiterCluster.distribute(inverterTotalPower);
+        inverterTotalPower = std::min(inverterTotalPower, totalAllowance);
+
+        oPhaseRequests = calcPhaseRequests(consumption, inverterTotalPower);
+    } else {
+        auto oShare = PowerLimiterCluster.getShare();
+        if (!oShare) {
+            trace.Status = static_cast<uint8_t>(Status::ClusterSharePending);
+            PowerLimiterTrace.addRecord(trace);
+            return announceStatus(Status::ClusterSharePending);
+        }
+
+        inverterTotalPower = std::min(*oShare, totalAllowance);
+    }
+
+    now = esp_timer_get_time();
+    trace.ConsumptionMicros = Trace::toMicros(traceMark, now);
+    traceMark = now;
+    // without regulating the phases, all inverters form group 0
+    phase_power_t requested = { inverterTotalPower, 0, 0, 0 };
+    if (oPhaseRequests) {
+        requested = *oPhaseRequests;
+        if (sum(requested) > totalAllowance) { requested = distribute(requested, totalAllowance); }
+        inverterTotalPower = sum(requested);
+    }
+
+    trace.RequestedWatts = inverterTotalPower;
+    traceInverters(false);
+
+    bool byPhase = oPhaseRequests.has_value();
+    auto dispatch = [this, byPhase](phase_power_t const& power,
+            inverter_filter_t const& filter, char const* expression) {
+        phase_power_t covered = {};
+        if (!byPhase) {
+            covered[0] = updateInverterLimits(power[0], filter, expression);
+            return covered;
+        }
+
+        for (uint8_t group = 0; group < covered.size(); ++group) {
+            covered[group] = updateInverterLimits(power[group],
+                    [&filter, group](PowerLimiterInverter const& inv) {
+                        return inv.getPhase() == group && filter(inv);
+                    }, std::string(expression) + sPhaseGroupSuffixes[group]);
+        }
+        return covered;
+    };
+
+    auto coveredBySolar = dispatch(requested, sSolarPoweredFilter, sSolarPoweredExpression);
+    auto remainingAfterSolar = remaining(requested, coveredBySolar);
+    auto coveredBySmartBuffer = dispatch(remainingAfterSolar, sSmartBufferPoweredFilter, sSmartBufferPoweredExpression);
+    auto remainingAfterSmartBuffer = remaining(remainingAfterSolar, coveredBySmartBuffer);
+    auto powerBusUsage = calcPowerBusUsage(sum(remainingAfterSmartBuffer));
+    auto coveredByBattery = dispatch(distribute(remainingAfterSmartBuffer, powerBusUsage),
+            sBatteryPoweredFilter, sBatteryPoweredExpression);
+
+    now = esp_timer_get_time();
+    trace.DispatchMicros = Trace::toMicros(traceMark, now);
+    traceMark = now;
+    trace.SolarCoveredWatts = sum(coveredBySolar);
+    trace.SmartBufferCoveredWatts = sum(coveredBySmartBuffer);
+    trace.PowerBusWatts = powerBusUsage;
+    trace.BatteryCoveredWatts = sum(coveredByBattery);
+    traceInverters(true);
 
     if (_verboseLogging) {
         for (auto const &upInv : _inverters) { upInv->debug(); }
     }
 
-    _lastExpectedInverterOutput = coveredBySolar + coveredByBattery;
+    _lastExpectedInverterOutput = sum(coveredBySolar) + sum(coveredByBattery);
 
     bool limitUpdated = updateInverters();
 
+    trace.UpdateMicros = Trace::toMicros(traceMark, esp_timer_get_time());
+    if (limitUpdated) { trace.Flags |= Trace::LimitUpdated; }
+    PowerLimiterTrace.addRecord(trace);
+
     _lastCalculation = millis();
 
+    EventBus.publish(Events::DplDecision{ _lastExpectedInverterOutput, limitUpdated });
+
     if (!limitUpdated) {
         // increase polling backoff if system seems to be stable
         _calculationBackoffMs = std::min<uint32_t>(1024, _calculationBackoffMs * 2);
@@ -396,7 +643,8 @@ std::pair<float, char const*> PowerLimiterClass::getInverterDcVoltage() {
  * accurate data is expected to be delivered by a BMS, if it's available. more
  * accurate and more recent than the inverter's voltage reading is the volage
  * at the charge controller's output, if it's available. only as a fallback
- * the voltage reported by the inverter is used.
+ * the voltage reported by the inverter is used. a recent voltage and current
+ * sample forwarded by the battery provider is preferred over the BMS stats.
  */
 float PowerLimiterClass::getBatteryVoltage(bool log) {
     auto const& config = Configuration.get();
@@ -421,6 +669,11 @@ float PowerLimiterClass::getBatteryVoltage(bool log) {
         res = bmsVoltage = stats->getVoltage();
     }
 
+    auto oSample = Battery.getElectricalSample(_electricalSampleMaxAgeMs);
+    if (config.Battery.Enabled && oSample) {
+        res = bmsVoltage = oSample->Volts;
+    }
+
     if (log) {
         MessageOutput.printf("[DPL] BMS: %.2f V, MPPT: %.2f V, "
                 "inverter %s: %.2f \r\n", bmsVoltage,
@@ -504,6 +757,63 @@ uint8_t PowerLimiterClass::getPowerLimiterState()
     return _batteryDischargeEnabled ? PL_UI_STATE_USE_SOLAR_AND_BATTERY : PL_UI_STATE_USE_SOLAR_ONLY;
 }
 
+// lowers the limits of the solar-powered inverters behind the power meter as
+// soon as the meter reports an export beyond the threshold, bypassing the
+// hysteresis and the calculation backoff. the commands are sent to all of
+// these inverters at once. the regular calculation refines their limits
+// after they reported new stats.
+void PowerLimiterClass::applyExportGuard()
+{
+    auto const& config = Configuration.get();
+    auto threshold = config.PowerLimiter.ExportGuardThreshold;
+    if (threshold == 0 || !config.PowerLimiter.Enabled || Mode::Normal != _mode) { return; }
+
+    if (_reloadConfigFlag || !PowerLimiterCluster.isLeader() || !PowerMeter.isDataValid()) { return; }
+
+    // each reading is evaluated once
+    auto meterMillis = PowerMeter.getLastUpdate();
+    if (meterMillis == _exportGuardMeterMillis) { return; }
+    _exportGuardMeterMillis = meterMillis;
+
+    float excess = config.PowerLimiter.TargetPowerConsumption - PowerMeter.getPowerTotal();
+    if (excess <= threshold) { return; }
+
+    std::vector<PowerLimiterInverter*> candidates;
+    for (auto const& upInv : _inverters) {
+        if (!upInv->isSolarPowered() || !upInv->isBehindPowerMeter()) { continue; }
+
+        // the reading must reflect the output reported by the inverter's
+        // stats, otherwise a reduction already in effect is applied again.
+        auto oStatsMillis = upInv->getLatestStatsMillis();
+        if (!oStatsMillis || meterMillis <= (*oStatsMillis + 2000)) { continue; }
+
+        candidates.push_back(upInv.get());
+    }
+
+    // the inverters which reached their last target state the fastest take
+    // the largest share. those which did not yet complete an update go last.
+    auto duration = [](PowerLimiterInverter const* pInv) -> uint32_t {
+        auto millis = pInv->getLastUpdateDurationMillis();
+        return (millis > 0) ? millis : std::numeric_limits<uint32_t>::max();
+    };
+    std::stable_sort(candidates.begin(), candidates.end(),
+            [&duration](PowerLimiterInverter const* a, PowerLimiterInverter const* b) {
+                return duration(a) < duration(b);
+            });
+
+    auto remaining = static_cast<uint16_t>(std::min<float>(excess, std::numeric_limits<uint16_t>::max()));
+    uint16_t curtailed = 0;
+    for (auto pInv : candidates) {
+        if (curtailed >= remaining) { break; }
+        curtailed += pInv->curtail(remaining - curtailed);
+    }
+
+    if (curtailed == 0) { return; }
+
+    MessageOutput.printf("[DPL] export guard: exporting %.0f W beyond the "
+            "target, curtailed %u W\r\n", excess, curtailed);
+}
+
 int16_t PowerLimiterClass::calcConsumption()
 {
     auto const& config = Configuration.get();
@@ -539,9 +849,237 @@ int16_t PowerLimiterClass::calcConsumption()
         }
     }
 
+    // the same applies to the inverters governed by other units of a cluster
+    consumption += PowerLimiterCluster.getPeersBehindMeterOutputWatts();
+
+    // the grid charger is being shut down in favor of the inverters, so its
+    // consumption must not be covered by them.
+    auto chargerPower = PowerArbiter.getChargerPowerToDisregard();
+    if (chargerPower > 0) {
+        consumption -= static_cast<int16_t>(chargerPower);
+        if (_verboseLogging) {
+            MessageOutput.printf("[DPL] disregarding %.0f W consumed by "
+                    "the grid charger\r\n", chargerPower);
+        }
+    }
+
+    if (config.PowerLimiter.PredictiveMode) {
+        consumption = predictConsumption(consumption);
+    }
+
     return consumption - targetConsumption;
 }
 
+/**
+ * splits the power requested from the inverters among the phase groups, or
+ * returns nothing if the total is to be regulated. the load of each phase is
+ * what the power meter reads on that phase plus the output of the inverters
+ * on that phase behind the power meter. everything else the consumption
+ * accounts for (target, inverters feeding all phases, grid charger,
+ * prediction and filtering) is spread evenly across the phases.
+ */
+std::optional<PowerLimiterClass::phase_power_t> PowerLimiterClass::calcPhaseRequests(
+        int16_t consumption, uint16_t totalRequested)
+{
+    auto const& config = Configuration.get().PowerLimiter;
+    if (config.PhaseMode == PowerLimiterConfig::PhaseModes::Total) { return std::nullopt; }
+
+    // the cluster leader distributes the total among the units
+    if (config.Cluster || !PowerMeter.isDataValid()) { return std::nullopt; }
+
+    auto oPhases = PowerMeter.getPowerPhases();
+    if (!oPhases) {
+        if (_verboseLogging) {
+            MessageOutput.println("[DPL] power meter does not read the power "
+                    "of each phase, regulating the total");
+        }
+        return std::nullopt;
+    }
+
+    PowerMeterProvider::phase_values_t load = *oPhases;
+    std::array<float, 4> capacity = {};
+    for (auto const& upInv : _inverters) {
+        auto group = upInv->getPhase();
+        if (group > 0 && upInv->isBehindPowerMeter()) {
+            load[group - 1] += upInv->getCurrentOutputAcWatts();
+        }
+        if (upInv->isReachable() && upInv->isSendingCommandsEnabled()) {
+            capacity[group] += upInv->getConfiguredMaxPowerWatts();
+        }
+    }
+
+    float offset = (consumption - std::accumulate(load.begin(), load.end(), 0.0f)) / load.size();
+    for (auto& l : load) { l += offset; }
+
+    std::array<float, 4> request = {};
+
+    if (config.PhaseMode == PowerLimiterConfig::PhaseModes::PerPhase) {
+        // the inverters feeding all phases must not cause export on any
+        // phase, the inverters on a phase cover the rest of its import.
+        float lowest = std::max(0.0f, *std::min_element(load.begin(), load.end()));
+        request[0] = std::min(capacity[0], lowest * load.size());
+        for (size_t p = 0; p < load.size(); ++p) {
+            request[p + 1] = std::max(0.0f, load[p] - request[0] / load.size());
+        }
+    } else {
+        // the inverters on the phases lower the phases with the highest
+        // import to a common level, the inverters feeding all phases cover
+        // what is left of the total.
+        std::array<float, 3> cap = { capacity[1], capacity[2], capacity[3] };
+        auto allocate = [&load, &cap](float level, size_t p) {
+            return std::clamp(load[p] - level, 0.0f, cap[p]);
+        };
+        auto allocated = [&](float level) {
+            return allocate(level, 0) + allocate(level, 1) + allocate(level, 2);
+        };
+
+        float total = totalRequested;
+        float lo = *std::min_element(load.begin(), load.end()) - total;
+        float hi = *std::max_element(load.begin(), load.end());
+        if (allocated(lo) <= total) {
+            hi = lo; // the inverters on the phases cannot cover the total
+        } else {
+            for (int i = 0; i < 24; ++i) {
+                float mid = (lo + hi) / 2;
+                if (allocated(mid) > total) { lo = mid; } else { hi = mid; }
+            }
+        }
+
+        for (size_t p = 0; p < load.size(); ++p) { request[p + 1] = allocate(hi, p); }
+        request[0] = std::min(capacity[0], total - allocated(hi));
+    }
+
+    phase_power_t result;
+    for (size_t group = 0; group < result.size(); ++group) {
+        result[group] = static_cast<uint16_t>(std::clamp(request[group] + 0.5f, 0.0f, 65535.0f));
+    }
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[DPL] phase loads are %.0f / %.0f / %.0f W, "
+                "requesting %u W from all-phase and %u / %u / %u W from "
+                "L1 / L2 / L3 inverters
+", load[0], load[1], load[2],
+                result[0], result[1], result[2], result[3]);
+    }
+
+    return result;
+}
+
+uint16_t PowerLimiterClass::sum(phase_power_t const& power)
+{
+    uint32_t total = std::accumulate(power.begin(), power.end(), 0u);
+    return static_cast<uint16_t>(std::min<uint32_t>(total, std::numeric_limits<uint16_t>::max()));
+}
+
+PowerLimiterClass::phase_power_t PowerLimiterClass::remaining(
+        phase_power_t const& requested, phase_power_t const& covered)
+{
+    phase_power_t result;
+    for (size_t group = 0; group < result.size(); ++group) {
+        result[group] = (requested[group] >= covered[group]) ? requested[group] - covered[group] : 0;
+    }
+    return result;
+}
+
+// splits the total among the groups in proportion to their weights. the
+// total goes to group 0 if all weights are zero.
+PowerLimiterClass::phase_power_t PowerLimiterClass::distribute(
+        phase_power_t const& weights, uint16_t total)
+{
+    phase_power_t result = {};
+    uint32_t weightSum = std::accumulate(weights.begin(), weights.end(), 0u);
+    if (weightSum == 0) {
+        result[0] = total;
+        return result;
+    }
+
+    uint32_t assigned = 0;
+    for (size_t group = 0; group < result.size(); ++group) {
+        result[group] = static_cast<uint16_t>(static_cast<uint32_t>(total) * weights[group] / weightSum);
+        assigned += result[group];
+    }
+
+    // the remainder of the integer division goes to the heaviest group
+    auto heaviest = std::max_element(weights.begin(), weights.end()) - weights.begin();
+    result[heaviest] += total - assigned;
+    return result;
+}
+
+/**
+ * extrapolates the trend of the recent consumption by the time it takes for a
+ * new limit to become effective, such that the limit targets the load at that
+ * time rather than the load measured now. the prediction never exceeds the
+ * range of consumption values observed recently.
+ */
+int16_t PowerLimiterClass::predictConsumption(int16_t consumption)
+{
+    // the timestamp of stale data does not belong to this consumption
+    if (!PowerMeter.isDataValid()) { return consumption; }
+
+    auto& history = _consumptionHistory;
+    auto sampleMillis = PowerMeter.getLastUpdate();
+    if (history.Size == 0 || history.back().first != sampleMillis) {
+        history.push_back({ sampleMillis, consumption });
+    }
+
+    while ((millis() - history.front().first) > _consumptionHistoryMaxAgeMs) {
+        history.pop_front();
+        if (history.Size == 0) { return consumption; }
+    }
+
+    if (history.Size < 3) { return consumption; }
+
+    // least squares fit of the consumption over time (in seconds)
+    auto const origin = history.front().first;
+    float meanT = 0, meanW = 0;
+    int16_t minW = consumption, maxW = consumption;
+    for (size_t i = 0; i < history.Size; ++i) {
+        auto const& [ts, watts] = history[i];
+        meanT += (ts - origin) / 1000.0f;
+        meanW += watts;
+        minW = std::min(minW, watts);
+        maxW = std::max(maxW, watts);
+    }
+    meanT /= history.Size;
+    meanW /= history.Size;
+
+    float num = 0, denom = 0;
+    for (size_t i = 0; i < history.Size; ++i) {
+        auto const& [ts, watts] = history[i];
+        float t = (ts - origin) / 1000.0f - meanT;
+        num += t * (watts - meanW);
+        denom += t * t;
+    }
+
+    if (denom < 0.001f) { return consumption; }
+
+    float slope = num / denom; // W/s
+
+    // the time from the DPL decision until the inverter reports the new
+    // output, as measured for previous limit updates, plus the age of the
+    // power meter reading.
+    using Stage = PowerLimiterLatencyClass::Stage;
+    auto total = PowerLimiterLatency.getSummary(Stage::Total);
+    auto meterToDecision = PowerLimiterLatency.getSummary(Stage::MeterToDecision);
+    uint32_t leadTimeMs = _predictionLeadTimeDefaultMs;
+    if (total.Count > 0 && total.P50 > meterToDecision.P50) {
+        leadTimeMs = total.P50 - meterToDecision.P50;
+    }
+    leadTimeMs += millis() - sampleMillis;
+
+    float range = maxW - minW;
+    float delta = std::clamp(slope * leadTimeMs / 1000.0f, -range, range);
+    auto predicted = static_cast<int16_t>(consumption + delta + (delta > 0 ? 0.5f : -0.5f));
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[DPL] predicting consumption of %d W in %u ms "
+                "(trend %.1f W/s over %u samples)\r\n", predicted,
+                leadTimeMs, slope, static_cast<unsigned>(history.Size));
+    }
+
+    return predicted;
+}
+
 /**
  * assigns new limits to all inverters matching the filter. returns the total
  * amount of power these inverters are expected to produce after the new limits
@@ -614,12 +1152,22 @@ uint16_t PowerLimiterClass::updateInverterLimits(uint16_t powerRequested,
                     return aReduction > bReduction;
                 });
 
-        for (auto pInv : matchingInverters) {
+        auto targets = matchingInverters;
+        if (config.PowerLimiter.OptimizedDispatch) {
+            targets = selectInverters(matchingInverters, reduction, hysteresis,
+                    [allowStandby](PowerLimiterInverter const& inv) {
+                        return inv.getMaxReductionWatts(allowStandby);
+                    },
+                    [allowStandby, reduction](PowerLimiterInverter const& inv) {
+                        return allowStandby && inv.getMaxReductionWatts(false) < reduction;
+                    });
+        }
+
+        for (auto pInv : targets) {
             auto maxReduction = pInv->getMaxReductionWatts(allowStandby);
             if (reduction >= hysteresis && maxReduction >= hysteresis) {
                 reduction -= pInv->applyReduction(reduction, allowStandby);
             }
-            covered += pInv->getExpectedOutputAcWatts();
         }
     }
     else {
@@ -630,15 +1178,29 @@ uint16_t PowerLimiterClass::updateInverterLimits(uint16_t powerRequested,
                     return a->getMaxIncreaseWatts() > b->getMaxIncreaseWatts();
                 });
 
-        for (auto pInv : matchingInverters) {
+        auto targets = matchingInverters;
+        if (config.PowerLimiter.OptimizedDispatch) {
+            targets = selectInverters(matchingInverters, increase, hysteresis,
+                    [](PowerLimiterInverter const& inv) {
+                        return inv.getMaxIncreaseWatts();
+                    },
+                    [](PowerLimiterInverter const& inv) {
+                        return !inv.isProducing();
+                    });
+        }
+
+        for (auto pInv : targets) {
             auto maxIncrease = pInv->getMaxIncreaseWatts();
             if (increase >= hysteresis && maxIncrease >= hysteresis) {
                 increase -= pInv->applyIncrease(increase);
             }
-            covered += pInv->getExpectedOutputAcWatts();
         }
     }
 
+    for (auto pInv : matchingInverters) {
+        covered += pInv->getExpectedOutputAcWatts();
+    }
+
     if (_verboseLogging) {
         MessageOutput.printf("[DPL] will cover %d W using "
                 "%d %s inverter%s\r\n", covered, matchingInverters.size(),
@@ -648,6 +1210,79 @@ uint16_t PowerLimiterClass::updateInverterLimits(uint16_t powerRequested,
     return covered;
 }
 
+// chooses the inverters to apply the change to, such that the fewest update
+// cycles (radio round trips) are started. among the sets of inverters that
+// cover the change, the one with the least cost is chosen, where inverters
+// that must be started or stopped, responded slowly recently or received more
+// commands than the others are more expensive. the candidates are expected to
+// be sorted by capacity, as are the returned inverters. the number of
+// candidates is small, so all sets are evaluated. for more candidates, or if
+// no set covers the change, all candidates are returned.
+std::vector<PowerLimiterInverter*> PowerLimiterClass::selectInverters(
+        std::vector<PowerLimiterInverter*> const& candidates, uint16_t change,
+        uint16_t hysteresis, inverter_capacity_t capacity, inverter_filter_t switchesPowerState)
+{
+    size_t const count = candidates.size();
+    if (count <= 1 || count > _maxOptimizedDispatchInverters) { return candidates; }
+
+    uint32_t minCycles = std::numeric_limits<uint32_t>::max();
+    for (auto const pInv : candidates) {
+        minCycles = std::min(minCycles, pInv->getUpdateCycles());
+    }
+
+    std::array<uint16_t, _maxOptimizedDispatchInverters> capacities;
+    std::array<uint32_t, _maxOptimizedDispatchInverters> costs;
+    for (size_t i = 0; i < count; ++i) {
+        auto const& inv = *candidates[i];
+
+        // inverters with too little headroom are not adjusted anyways
+        capacities[i] = capacity(inv);
+        if (capacities[i] < hysteresis) { capacities[i] = 0; }
+
+        costs[i] = 1000; // one update cycle
+        if (switchesPowerState(inv)) { costs[i] += 1000; }
+        costs[i] += std::min<uint32_t>(inv.getLastUpdateDurationMillis() / 100, 300);
+        costs[i] += std::min<uint32_t>(inv.getUpdateCycles() - minCycles, 200);
+    }
+
+    std::optional<uint32_t> bestSet = std::nullopt;
+    uint32_t bestCost = std::numeric_limits<uint32_t>::max();
+
+    for (uint32_t set = 1; set < (1UL << count); ++set) {
+        uint32_t covered = 0;
+        uint32_t cost = 0;
+        bool useless = false;
+
+        for (size_t i = 0; i < count; ++i) {
+            if ((set & (1UL << i)) == 0) { continue; }
+            if (capacities[i] == 0) { useless = true; break; }
+            covered += capacities[i];
+            cost += costs[i];
+        }
+
+        if (useless || covered < change || cost >= bestCost) { continue; }
+
+        bestSet = set;
+        bestCost = cost;
+    }
+
+    if (!bestSet) { return candidates; }
+
+    std::vector<PowerLimiterInverter*> selected;
+    for (size_t i = 0; i < count; ++i) {
+        if ((*bestSet & (1UL << i)) == 0) { continue; }
+        selected.push_back(candidates[i]);
+    }
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[DPL] optimized dispatch selected %u of %u "
+                "inverters (cost %u)\r\n", static_cast<unsigned>(selected.size()),
+                static_cast<unsigned>(count), bestCost);
+    }
+
+    return selected;
+}
+
 // calculates how much power the battery-powered inverters shall draw from the
 // power bus, which we call the part of the circuitry that is supplied by the
 // solar charge controller(s), possibly an AC charger, as well as the battery.
@@ -658,8 +1293,17 @@ uint16_t PowerLimiterClass::calcPowerBusUsage(uint16_t powerRequested)
     // battery-powered inverters kick in. The only case where this is not
     // desired is if the battery is over the Full Solar Passthrough Threshold.
     // In this case battery-powered inverters should produce power and the PSU
-    // will shut down as a consequence.
-    if (!isFullSolarPassthroughActive() && HuaweiCan.getAutoPowerStatus()) {
+    // will shut down as a consequence. if the power arbiter is active, it
+    // decides whether the PSU is used.
+#ifndef OPENDTU_WITHOUT_HUAWEI
+    bool chargerBlocks = PowerArbiter.isActive()
+        ? PowerArbiter.getMode() == PowerArbiterClass::Mode::Charge
+        : HuaweiCan.getAutoPowerStatus();
+#else
+    bool chargerBlocks = PowerArbiter.isActive()
+        && PowerArbiter.getMode() == PowerArbiterClass::Mode::Charge;
+#endif
+    if (!_slowInputs.FullSolarPassthroughActive && chargerBlocks) {
         if (_verboseLogging) {
             MessageOutput.println("[DPL] DC power bus usage blocked by "
                     "HuaweiCan auto power");
@@ -669,7 +1313,7 @@ uint16_t PowerLimiterClass::calcPowerBusUsage(uint16_t powerRequested)
 
     auto solarOutputDc = getSolarPassthroughPower();
     auto solarOutputAc = dcPowerBusToInverterAc(solarOutputDc);
-    if (isFullSolarPassthroughActive() && solarOutputAc > powerRequested) {
+    if (_slowInputs.FullSolarPassthroughActive && solarOutputAc > powerRequested) {
         if (_verboseLogging) {
             MessageOutput.printf("[DPL] using %u/%u W DC/AC from DC power bus "
                     "(full solar-passthrough)\r\n", solarOutputDc, solarOutputAc);
@@ -678,7 +1322,7 @@ uint16_t PowerLimiterClass::calcPowerBusUsage(uint16_t powerRequested)
         return solarOutputAc;
     }
 
-    auto oBatteryDischargeLimit = getBatteryDischargeLimit();
+    auto const& oBatteryDischargeLimit = _slowInputs.BatteryDischargeLimit;
     if (!oBatteryDischargeLimit) {
         if (_verboseLogging) {
             MessageOutput.printf("[DPL] granting %d W from DC power bus (no "
@@ -701,23 +1345,52 @@ uint16_t PowerLimiterClass::calcPowerBusUsage(uint16_t powerRequested)
     return std::min(powerRequested, allowance);
 }
 
+// the limits of all inverters are calculated before any command is sent.
+// this sends the commands of all inverters as one batch in the same DPL cycle,
+// which the radio then transmits back-to-back ahead of any telemetry request.
+// reductions go first, such that the total output does not overshoot while
+// the batch is processed.
 bool PowerLimiterClass::updateInverters()
 {
+    // this runs every loop, hence the batch is ordered in a fixed-size array
+    // rather than a std::vector (std::stable_partition would allocate, too).
+    std::array<PowerLimiterInverter*, INV_MAX_COUNT> batch;
+    size_t count = 0;
+    for (bool reductions : { true, false }) {
+        for (auto& upInv : _inverters) {
+            if (count >= batch.size()) { break; }
+            if (upInv->hasPendingReduction() != reductions) { continue; }
+            batch[count++] = upInv.get();
+        }
+    }
+
     bool busy = false;
 
-    for (auto& upInv : _inverters) {
-        if (upInv->update()) { busy = true; }
+    for (size_t i = 0; i < count; ++i) {
+        if (batch[i]->update()) { busy = true; }
     }
 
     return busy;
 }
 
+bool PowerLimiterClass::isSlowInputsEvaluationDue()
+{
+    // new battery snapshots raise the flag
+    bool due = _slowInputsUpdatedFlag.exchange(false)
+        || _slowInputsMillis == 0
+        || (millis() - _slowInputsMillis) >= _slowInputsMaxAgeMs;
+
+    if (due) { _slowInputsMillis = millis(); }
+
+    return due;
+}
+
 uint16_t PowerLimiterClass::getSolarPassthroughPower()
 {
     auto solarChargerOutput = SolarCharger.getStats()->getOutputPowerWatts();
 
     if (!isSolarPassThroughEnabled()
-            || isBelowStopThreshold()
+            || _slowInputs.BelowStopThreshold
             || !solarChargerOutput
             ) {
         return 0;
@@ -745,8 +1418,10 @@ std::optional<uint16_t> PowerLimiterClass::getBatteryDischargeLimit()
 {
     if (!_batteryDischargeEnabled) { return 0; }
 
+    auto oPlanLimit = PowerLimiterDischargePlan.getDischargeLimit();
+
     auto currentLimit = Battery.getDischargeCurrentLimit();
-    if (currentLimit == FLT_MAX) { return std::nullopt; }
+    if (currentLimit == FLT_MAX) { return oPlanLimit; }
 
     if (currentLimit <= 0) { currentLimit = -currentLimit; }
 
@@ -759,7 +1434,10 @@ std::optional<uint16_t> PowerLimiterClass::getBatteryDischargeLimit()
         return 0;
     }
 
-    return inverter.first * currentLimit;
+    uint16_t limit = inverter.first * currentLimit;
+    if (oPlanLimit) { limit = std::min(limit, *oPlanLimit); }
+
+    return limit;
 }
 
 float PowerLimiterClass::getLoadCorrectedVoltage()
@@ -768,8 +1446,25 @@ float PowerLimiterClass::getLoadCorrectedVoltage()
 
     auto const& config = Configuration.get();
 
-    // TODO(schlimmchen): use the battery's data if available,
-    // i.e., the current drawn from the battery as reported by the battery.
+    auto oCorrected = getResistanceCorrectedVoltage();
+    if (oCorrected) {
+        _oLoadCorrectedVoltage = *oCorrected;
+        return *_oLoadCorrectedVoltage;
+    }
+
+    // voltage and current measured together by the battery provider give
+    // the power drawn from the battery at the time the voltage was taken.
+    // the correction factor applies to that power just as well, as it is
+    // an approximation of the battery's internal resistance divided by its
+    // voltage. other than the inverters' output, this also accounts for
+    // charging and for other loads.
+    auto oSample = Battery.getElectricalSample(_electricalSampleMaxAgeMs);
+    if (config.Battery.Enabled && oSample && oSample->Volts > 0) {
+        float dischargePower = -oSample->Amps * oSample->Volts;
+        _oLoadCorrectedVoltage = oSample->Volts + (dischargePower * config.PowerLimiter.VoltageLoadCorrectionFactor);
+        return *_oLoadCorrectedVoltage;
+    }
+
     float acPower = getBatteryInvertersOutputAcWatts();
     float dcVoltage = getBatteryVoltage();
 
@@ -782,6 +1477,34 @@ float PowerLimiterClass::getLoadCorrectedVoltage()
     return *_oLoadCorrectedVoltage;
 }
 
+/**
+ * the voltage the battery would have if it was idle, calculated using the
+ * internal resistance estimated by the battery interface, if enabled. the
+ * estimate follows changes due to temperature and SoC, which a fixed load
+ * correction factor does not.
+ */
+std::optional<float> PowerLimiterClass::getResistanceCorrectedVoltage()
+{
+    auto const& config = Configuration.get();
+    if (!config.Battery.Enabled || !config.PowerLimiter.VoltageLoadCorrectionAutomatic) {
+        return std::nullopt;
+    }
+
+    auto oResistance = Battery.getInternalResistance();
+    if (!oResistance) { return std::nullopt; }
+
+    auto oSample = Battery.getElectricalSample(_electricalSampleMaxAgeMs);
+    if (oSample && oSample->Volts > 0) {
+        return oSample->Volts - (oSample->Amps * *oResistance);
+    }
+
+    auto stats = Battery.getStats();
+    if (!stats->isVoltageValid() || stats->getVoltageAgeSeconds() >= 60) { return std::nullopt; }
+    if (!stats->isCurrentValid() || (millis() - stats->getLastUpdateCurrent()) >= 60 * 1000) { return std::nullopt; }
+
+    return stats->getVoltage() - (stats->getChargeCurrent() * *oResistance);
+}
+
 bool PowerLimiterClass::testThreshold(float socThreshold, float voltThreshold,
         std::function<bool(float, float)> compare)
 {
@@ -936,6 +1659,16 @@ bool PowerLimiterClass::usesSmartBufferPoweredInverter()
     return false;
 }
 
+bool PowerLimiterClass::isGoverningProducingInverters() const
+{
+    if (_lastStatus == Status::DisabledByConfig || _lastStatus == Status::DisabledByMqtt) {
+        return false;
+    }
+
+    return std::any_of(_inverters.begin(), _inverters.end(),
+            [](auto const& upInv) { return upInv->isProducing(); });
+}
+
 bool PowerLimiterClass::isGovernedBatteryPoweredInverterProducing()
 {
     for (auto const& upInv : _inverters) {
@@ -21,7 +21,7 @@ uint16_t PowerLimiterBatteryInverter::getMaxIncreaseWatts() const
     if (isEligible() != Eligibility::Eligible) { return 0; }
 
     if (!isProducing()) {
-        return getConfiguredMaxPowerWatts();
+        return getModeledMaxOutputWatts();
     }
 
     // this should not happen for battery-powered inverters, but we want to
@@ -29,11 +29,16 @@ uint16_t PowerLimiterBatteryInverter::getMaxIncreaseWatts() const
     // case we did something wrong...).
     if (getCurrentLimitWatts() >= getConfiguredMaxPowerWatts()) { return 0; }
 
-    // we must not substract the current AC output here, but the current
-    // limit value, so we avoid trying to produce even more even if the
-    // inverter is already at the maximum limit value (the actual AC
-    // output may be less than the inverter's current power limit).
-    return getConfiguredMaxPowerWatts() - getCurrentLimitWatts();
+    // we must not substract the current AC output here, but the output the
+    // current limit results in, so we avoid trying to produce even more even
+    // if the inverter is already at the maximum limit value (the actual AC
+    // output may be less than the inverter's current power limit). the
+    // maximum output is lower than the limit while the inverter derates.
+    auto maxOutput = getModeledMaxOutputWatts();
+    auto output = getModeledOutputWatts();
+    if (output >= maxOutput) { return 0; }
+
+    return maxOutput - output;
 }
 
 uint16_t PowerLimiterBatteryInverter::applyReduction(uint16_t reduction, bool allowStandby)
@@ -51,8 +56,11 @@ uint16_t PowerLimiterBatteryInverter::applyReduction(uint16_t reduction, bool al
         return 0;
     }
 
-    if ((getCurrentLimitWatts() - _config.LowerPowerLimit) >= reduction) {
-        setAcOutput(getCurrentLimitWatts() - reduction);
+    // the output rather than the limit is reduced, as the limit exceeds
+    // the output while the inverter derates.
+    auto output = getModeledOutputWatts();
+    if (output >= _config.LowerPowerLimit && (output - _config.LowerPowerLimit) >= reduction) {
+        setAcOutput(output - reduction);
         return reduction;
     }
 
@@ -74,7 +82,7 @@ uint16_t PowerLimiterBatteryInverter::applyIncrease(uint16_t increase)
     // do not wake inverter up if it would produce too much power
     if (!isProducing() && _config.LowerPowerLimit > increase) { return 0; }
 
-    auto baseline = getCurrentLimitWatts();
+    auto baseline = getModeledOutputWatts();
 
     // battery-powered inverters in standby can have an arbitrary limit, yet
     // the baseline is 0 in case we are about to wake it up from standby.
@@ -98,7 +106,11 @@ void PowerLimiterBatteryInverter::setAcOutput(uint16_t expectedOutputWatts)
     expectedOutputWatts = std::min(expectedOutputWatts, getConfiguredMaxPowerWatts());
     expectedOutputWatts = std::max(expectedOutputWatts, _config.LowerPowerLimit);
 
-    setExpectedOutputAcWatts(expectedOutputWatts);
-    setTargetPowerLimitWatts(expectedOutputWatts);
+    // the limit which is expected to result in the requested output, as the
+    // inverter's output deviates from its limit.
+    auto limit = std::min(_responseModel.getLimitFor(expectedOutputWatts), getInverterMaxPowerWatts());
+
+    setExpectedOutputAcWatts(std::min(expectedOutputWatts, getModeledMaxOutputWatts()));
+    setTargetPowerLimitWatts(limit);
     setTargetPowerState(true);
 }
@@ -0,0 +1,372 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerLimiterCluster.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "NetworkSettings.h"
+#include "PowerLimiter.h"
+#include "TaskMonitor.h"
+#include <Arduino.h>
+#include <Hoymiles.h>
+#include <limits>
+#include <mbedtls/md.h>
+
+PowerLimiterClusterClass PowerLimiterCluster;
+
+static const IPAddress multicastIP(239, 255, 42, 44);
+static constexpr char sMagic[4] = { 'O', 'D', 'C', 'L' };
+static constexpr size_t sHeaderSize = 26;
+static constexpr size_t sInverterSize = 13;
+static constexpr size_t sShareSize = 10;
+
+static void putUint(std::vector<uint8_t>& out, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i) { out.push_back((value >> (8 * i)) & 0xFF); }
+}
+
+static uint64_t getUint(uint8_t const* p, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) { value |= static_cast<uint64_t>(p[i]) << (8 * i); }
+    return value;
+}
+
+void PowerLimiterClusterClass::init(Scheduler& scheduler)
+{
+    _nodeId = ESP.getEfuseMac() & 0xFFFFFFFFFFFFULL;
+
+    scheduler.addTask(_loopTask);
+    _loopTask.setCallback(TaskMonitor.wrap("PowerLimiterCluster::loop", std::bind(&PowerLimiterClusterClass::loop, this)));
+    _loopTask.setIterations(TASK_FOREVER);
+    _loopTask.setInterval(_announceIntervalMs * TASK_MILLISECOND);
+    _loopTask.enable();
+}
+
+void PowerLimiterClusterClass::loop()
+{
+    auto const& config = Configuration.get();
+
+    bool keyed = config.PowerLimiter.ClusterKey[0] != '\0';
+    bool keyMissing = config.PowerLimiter.Cluster && !keyed;
+    if (keyMissing && !_keyMissingLogged) {
+        MessageOutput.println("[PowerLimiterCluster] No cluster key configured");
+    }
+    _keyMissingLogged = keyMissing;
+
+    {
+        // the key is read by the AsyncUDP task, which must not access the config
+        std::lock_guard<std::mutex> lock(_mutex);
+        _key = config.PowerLimiter.ClusterKey;
+    }
+
+    if (!config.PowerLimiter.Cluster || !keyed || !NetworkSettings.isConnected()) {
+        if (!_listening) { return; }
+
+        _udp.close();
+        _listening = false;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _peers.clear();
+        _assignedShares.clear();
+        _oShare = std::nullopt;
+        return;
+    }
+
+    if (!_listening) {
+        if (!_udp.listenMulticast(multicastIP, _port)) {
+            MessageOutput.println("[PowerLimiterCluster] Failed to join multicast group");
+            return;
+        }
+
+        _udp.onPacket([this](AsyncUDPPacket& packet) {
+            onPacket(packet.data(), packet.length());
+        });
+
+        _listening = true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        expirePeers();
+    }
+
+    send();
+}
+
+// must be called with _mutex held
+void PowerLimiterClusterClass::expirePeers()
+{
+    for (auto it = _peers.begin(); it != _peers.end(); ) {
+        if (millis() - it->second.LastSeen > _peerTimeoutMs) {
+            MessageOutput.printf("[PowerLimiterCluster] lost node %012llx\r\n", it->first);
+            _assignedShares.erase(it->first);
+            it = _peers.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+bool PowerLimiterClusterClass::isLeader()
+{
+    if (!_listening) { return true; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto const& [id, node] : _peers) {
+        if (!node.DplEnabled || millis() - node.LastSeen > _peerTimeoutMs) { continue; }
+        if (id < _nodeId) { return false; }
+    }
+
+    return true;
+}
+
+uint16_t PowerLimiterClusterClass::distribute(uint16_t powerRequested)
+{
+    if (!_listening) { return powerRequested; }
+
+    bool changed = false;
+    uint16_t remaining = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        uint32_t totalMaxPower = _localMaxPowerWatts;
+        uint32_t totalUpperLimit = _localUpperLimitWatts;
+        for (auto const& [id, node] : _peers) {
+            if (!node.DplEnabled) { continue; }
+            totalMaxPower += node.MaxPowerWatts;
+            totalUpperLimit += node.UpperLimitWatts;
+        }
+
+        powerRequested = std::min<uint32_t>(powerRequested, totalUpperLimit);
+        remaining = powerRequested;
+
+        std::map<uint64_t, uint16_t> shares;
+        for (auto const& [id, node] : _peers) {
+            if (!node.DplEnabled || totalMaxPower == 0) { continue; }
+
+            uint32_t share = static_cast<uint32_t>(powerRequested) * node.MaxPowerWatts / totalMaxPower;
+            share = std::min<uint32_t>(share, std::min(node.MaxPowerWatts, node.UpperLimitWatts));
+            shares[id] = share;
+            remaining -= share;
+        }
+
+        changed = (shares != _assignedShares);
+        _assignedShares = std::move(shares);
+    }
+
+    // followers shall not wait for the next announcement
+    if (changed) { send(); }
+
+    return remaining;
+}
+
+std::optional<uint16_t> PowerLimiterClusterClass::getShare()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_oShare || millis() - _shareMillis > _peerTimeoutMs) {
+        return std::nullopt;
+    }
+
+    return _oShare;
+}
+
+void PowerLimiterClusterClass::setLocalSummary(uint16_t maxPowerWatts, uint16_t behindMeterOutputWatts,
+        uint16_t upperLimitWatts)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _localMaxPowerWatts = maxPowerWatts;
+    _localBehindMeterOutputWatts = behindMeterOutputWatts;
+    _localUpperLimitWatts = upperLimitWatts;
+}
+
+uint16_t PowerLimiterClusterClass::getPeersBehindMeterOutputWatts()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    uint32_t total = 0;
+    for (auto const& [id, node] : _peers) {
+        if (node.DplEnabled) { total += node.BehindMeterOutputWatts; }
+    }
+
+    return std::min<uint32_t>(total, std::numeric_limits<uint16_t>::max());
+}
+
+// must be called with _mutex held
+void PowerLimiterClusterClass::sign(uint8_t const* data, size_t length, uint8_t* mac)
+{
+    uint8_t full[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+        reinterpret_cast<uint8_t const*>(_key.data()), _key.size(), data, length, full);
+    memcpy(mac, full, _macSize);
+}
+
+void PowerLimiterClusterClass::send()
+{
+    auto const& config = Configuration.get();
+    bool dplEnabled = config.PowerLimiter.Enabled
+        && PowerLimiter.getMode() != PowerLimiterClass::Mode::Disabled;
+    bool leader = isLeader();
+
+    std::vector<Inverter> inverters;
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); ++i) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        inverters.push_back({
+            inv->serial(),
+            inv->isReachable(),
+            inv->isProducing(),
+            static_cast<uint16_t>(inv->Statistics()->getChannelFieldValue(TYPE_AC, CH0, FLD_PAC)),
+            static_cast<uint16_t>(inv->SystemConfigPara()->getLimitPercent() * 10)
+        });
+    }
+
+    std::vector<uint8_t> packet;
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_key.empty()) { return; }
+
+    packet.reserve(sHeaderSize + inverters.size() * sInverterSize
+            + _assignedShares.size() * sShareSize + _macSize);
+
+    packet.insert(packet.end(), sMagic, sMagic + sizeof(sMagic));
+    packet.push_back(_version);
+    packet.push_back((dplEnabled ? 0x01 : 0) | (leader ? 0x02 : 0));
+    putUint(packet, _nodeId, 8);
+    putUint(packet, ++_sequence, 4);
+    putUint(packet, _localMaxPowerWatts, 2);
+    putUint(packet, _localBehindMeterOutputWatts, 2);
+    putUint(packet, _localUpperLimitWatts, 2);
+    packet.push_back(inverters.size());
+    packet.push_back(leader ? _assignedShares.size() : 0);
+
+    for (auto const& inv : inverters) {
+        putUint(packet, inv.Serial, 8);
+        packet.push_back((inv.Reachable ? 0x01 : 0) | (inv.Producing ? 0x02 : 0));
+        putUint(packet, inv.OutputWatts, 2);
+        putUint(packet, inv.LimitPermille, 2);
+    }
+
+    if (leader) {
+        for (auto const& [id, share] : _assignedShares) {
+            putUint(packet, id, 8);
+            putUint(packet, share, 2);
+        }
+    }
+
+    size_t payloadSize = packet.size();
+    packet.resize(payloadSize + _macSize);
+    sign(packet.data(), payloadSize, packet.data() + payloadSize);
+
+    _udp.writeTo(packet.data(), packet.size(), multicastIP, _port);
+}
+
+// executed by the AsyncUDP task for every received datagram
+void PowerLimiterClusterClass::onPacket(uint8_t const* buffer, size_t length)
+{
+    if (length < sHeaderSize || memcmp(buffer, sMagic, sizeof(sMagic)) != 0
+            || buffer[4] != _version) {
+        return;
+    }
+
+    uint64_t id = getUint(&buffer[6], 8);
+    if (id == _nodeId) { return; } // our own announcement
+
+    size_t inverterCount = buffer[24];
+    size_t shareCount = buffer[25];
+    size_t payloadSize = sHeaderSize + inverterCount * sInverterSize + shareCount * sShareSize;
+    if (length != payloadSize + _macSize) { return; }
+
+    Node node;
+    node.LastSeen = millis();
+    node.Sequence = getUint(&buffer[14], 4);
+    node.DplEnabled = (buffer[5] & 0x01) != 0;
+    node.MaxPowerWatts = getUint(&buffer[18], 2);
+    node.BehindMeterOutputWatts = getUint(&buffer[20], 2);
+    node.UpperLimitWatts = getUint(&buffer[22], 2);
+
+    uint8_t const* p = &buffer[sHeaderSize];
+    for (size_t i = 0; i < inverterCount; ++i, p += sInverterSize) {
+        node.Inverters.push_back({
+            getUint(p, 8),
+            (p[8] & 0x01) != 0,
+            (p[8] & 0x02) != 0,
+            static_cast<uint16_t>(getUint(&p[9], 2)),
+            static_cast<uint16_t>(getUint(&p[11], 2))
+        });
+    }
+
+    bool shareChanged = false;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_key.empty()) { return; }
+
+        uint8_t mac[_macSize];
+        sign(buffer, payloadSize, mac);
+
+        // constant time comparison
+        uint8_t diff = 0;
+        for (size_t i = 0; i < _macSize; ++i) { diff |= mac[i] ^ buffer[payloadSize + i]; }
+        if (diff != 0) { return; }
+
+        auto known = _peers.find(id);
+        if (known == _peers.end()) {
+            MessageOutput.printf("[PowerLimiterCluster] found node %012llx\r\n", id);
+        } else if (node.Sequence <= known->second.Sequence) {
+            return; // replayed or reordered datagram
+        }
+        _peers[id] = std::move(node);
+
+        // only the leader as seen by this unit assigns shares
+        bool fromLeader = _peers[id].DplEnabled && id < _nodeId;
+        for (auto const& [otherId, other] : _peers) {
+            if (other.DplEnabled && otherId < id) { fromLeader = false; }
+        }
+
+        for (size_t i = 0; fromLeader && i < shareCount; ++i, p += sShareSize) {
+            if (getUint(p, 8) != _nodeId) { continue; }
+
+            uint16_t share = getUint(&p[8], 2);
+            shareChanged = (!_oShare || *_oShare != share);
+            _oShare = share;
+            _shareMillis = millis();
+        }
+    }
+
+    // the DPL shall act on the new share right away
+    if (shareChanged) { PowerLimiter.notifyPowerMeterUpdate(); }
+}
+
+void PowerLimiterClusterClass::debug()
+{
+    if (!_listening) { return; }
+
+    bool leader = isLeader();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    MessageOutput.printf("[PowerLimiterCluster] node %012llx is %s, %u W max, "
+            "%u W upper limit, %u W behind power meter, %d peers\r\n", _nodeId,
+            (leader ? "leader" : "follower"), _localMaxPowerWatts,
+            _localUpperLimitWatts, _localBehindMeterOutputWatts, _peers.size());
+
+    for (auto const& [id, node] : _peers) {
+        auto share = _assignedShares.find(id);
+        MessageOutput.printf("[PowerLimiterCluster]   node %012llx: DPL %sabled, "
+                "%u W max, %u W upper limit, %u W behind power meter, %d inverters, share %d W\r\n",
+                id, (node.DplEnabled ? "en" : "dis"), node.MaxPowerWatts,
+                node.UpperLimitWatts, node.BehindMeterOutputWatts, node.Inverters.size(),
+                (share != _assignedShares.end() ? share->second : -1));
+
+        for (auto const& inv : node.Inverters) {
+            MessageOutput.printf("[PowerLimiterCluster]     inverter %012llx: %sreachable, "
+                    "%sproducing, %u W, limit %.1f %%\r\n", inv.Serial,
+                    (inv.Reachable ? "" : "not "), (inv.Producing ? "" : "not "),
+                    inv.OutputWatts, inv.LimitPermille / 10.0);
+        }
+    }
+}
@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerLimiterDischargePlan.h"
+#include "Battery.h"
+#include "Configuration.h"
+#include "Logging.h"
+#include "SunPosition.h"
+#include "TimeSeries.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PowerLimiterDischargePlanClass PowerLimiterDischargePlan;
+
+static time_t getMidnight(time_t t)
+{
+    struct tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_sec = 0;
+    tm.tm_min = 0;
+    tm.tm_hour = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+void PowerLimiterDischargePlanClass::update()
+{
+    auto const& config = Configuration.get();
+
+    auto deactivate = [this]() -> void {
+        _active = false;
+        _lastSoc = -1;
+    };
+
+    if (!config.PowerLimiter.BatteryDischargePlan || !config.Battery.Enabled ||
+            config.PowerLimiter.BatteryCapacity == 0) {
+        return deactivate();
+    }
+
+    struct tm sunriseInfo;
+    if (!SunPosition.isSunsetAvailable() || SunPosition.isDayPeriod() ||
+            !SunPosition.sunriseTime(&sunriseInfo)) {
+        return deactivate();
+    }
+
+    auto spStats = Battery.getStats();
+    if (!spStats->isSoCValid() || spStats->getSoCAgeSeconds() > 60) {
+        return deactivate();
+    }
+
+    time_t now = time(nullptr);
+    time_t sunrise = mktime(&sunriseInfo);
+    if (sunrise <= now) { sunrise += 24 * 60 * 60; } // after sunset
+
+    float soc = spStats->getSoC();
+
+    // the plan is refined as the night progresses, and whenever the SoC
+    // changes, such that deviations from the plan are corrected.
+    bool due = !_active || (millis() - _lastUpdate) >= _updateIntervalMs ||
+        std::abs(soc - _lastSoc) >= 1;
+    if (!due) { return; }
+
+    calculate(now, sunrise, soc);
+
+    _active = true;
+    _lastUpdate = millis();
+    _lastSoc = soc;
+}
+
+void PowerLimiterDischargePlanClass::calculate(time_t now, time_t sunrise, float soc)
+{
+    auto const& config = Configuration.get().PowerLimiter;
+
+    float capacity = config.BatteryCapacity;
+    float stopSoc = config.BatterySocStopThreshold;
+    float reserveSoc = std::max<float>(stopSoc, config.BatteryDischargePlanReserveSoc);
+
+    // the battery may be discharged down to the stop threshold if the next
+    // day's yield is expected to recharge it, otherwise we keep a reserve.
+    _forecastYieldWh = forecastYield(now);
+    float rechargeWh = (100 - stopSoc) / 100 * capacity;
+    float coverage = 1;
+    if (rechargeWh > 0) { coverage = std::min(1.0f, _forecastYieldWh / rechargeWh); }
+    _targetSoc = reserveSoc - (reserveSoc - stopSoc) * coverage;
+
+    float availableWh = (soc - _targetSoc) / 100 * capacity;
+    _dischargeAllowed = availableWh > 0;
+
+    float hours = static_cast<float>(sunrise - now) / 3600;
+
+    if (!_dischargeAllowed) {
+        _oDischargeLimit = 0.0f;
+    } else {
+        auto profile = consumptionProfile(now, sunrise);
+        if (profile.empty()) {
+            // without history, the energy is spread evenly until sunrise
+            _oDischargeLimit = availableWh / std::max(hours, 0.25f);
+        } else {
+            _oDischargeLimit = waterLevel(std::move(profile), availableWh);
+        }
+    }
+
+    DTU_LOGI("DPL", "discharge plan: %.1f h until sunrise, expected yield "
+            "%.0f Wh, SoC %.1f %% -> %.1f %%, %.0f Wh available, limit %s%.0f W",
+            hours, _forecastYieldWh, soc, _targetSoc, std::max(availableWh, 0.0f),
+            (_oDischargeLimit ? "" : "none "),
+            (_oDischargeLimit ? *_oDischargeLimit : 0.0f));
+}
+
+std::optional<uint16_t> PowerLimiterDischargePlanClass::getDischargeLimit() const
+{
+    if (!_active) { return std::nullopt; }
+    if (!_dischargeAllowed) { return 0; }
+    if (!_oDischargeLimit) { return std::nullopt; }
+
+    auto constexpr maxLimit = std::numeric_limits<uint16_t>::max();
+    return static_cast<uint16_t>(std::min<float>(*_oDischargeLimit, maxLimit));
+}
+
+// the DC yield of the past days, weighted such that the most recent day
+// counts the most. only the daylight period of each day is taken into
+// account, such that battery-powered inverters producing at night do not
+// contribute. days with too little data are skipped.
+float PowerLimiterDischargePlanClass::forecastYield(time_t now) const
+{
+    struct tm sunriseInfo, sunsetInfo;
+    if (!SunPosition.sunriseTime(&sunriseInfo) || !SunPosition.sunsetTime(&sunsetInfo)) {
+        return 0;
+    }
+
+    time_t today = getMidnight(now);
+    time_t sunriseOffset = mktime(&sunriseInfo) - today;
+    time_t sunsetOffset = mktime(&sunsetInfo) - today;
+    if (sunsetOffset <= sunriseOffset) { return 0; }
+
+    size_t slots = (sunsetOffset - sunriseOffset) / _slotSeconds;
+    if (slots == 0) { return 0; }
+
+    float weightedSum = 0;
+    float weights = 0;
+
+    for (uint8_t d = 1; d <= _historyDays; ++d) {
+        time_t day = getMidnight(today - d * 24 * 60 * 60 + 12 * 60 * 60);
+        uint32_t from = day + sunriseOffset;
+        uint32_t to = from + slots * _slotSeconds;
+
+        std::vector<TimeSeriesClass::Bucket> buckets;
+        if (!TimeSeries.getBuckets("dc_power", TimeSeriesClass::selectTier(_slotSeconds),
+                    from, to, slots, buckets)) {
+            return 0;
+        }
+
+        float sum = 0;
+        size_t valid = 0;
+        for (auto const& bucket : buckets) {
+            if (bucket.Count == 0) { continue; }
+            sum += bucket.Avg;
+            ++valid;
+        }
+
+        if (valid < slots * 2 / 3) { continue; }
+
+        // gaps are filled with the average of the day
+        float yieldWh = sum / valid * slots * _slotSeconds / 3600;
+
+        float weight = _historyDays - d + 1;
+        weightedSum += weight * yieldWh;
+        weights += weight;
+    }
+
+    if (weights == 0) { return 0; }
+
+    return weightedSum / weights;
+}
+
+// the DC power the battery must supply in each slot from now until sunrise
+// to cover the consumption, based on the consumption of the past nights at
+// the same time. the consumption is the grid power plus the power produced
+// by all inverters. empty if no history is available.
+std::vector<float> PowerLimiterDischargePlanClass::consumptionProfile(time_t now, time_t sunrise) const
+{
+    size_t slots = (sunrise - now + _slotSeconds - 1) / _slotSeconds;
+    slots = std::min<size_t>(slots, 24 * 60 * 60 / _slotSeconds);
+    if (slots == 0) { return {}; }
+
+    std::vector<float> sums(slots, 0);
+    std::vector<uint8_t> counts(slots, 0);
+    uint8_t tier = TimeSeriesClass::selectTier(_slotSeconds);
+
+    for (uint8_t d = 1; d <= _historyDays; ++d) {
+        uint32_t from = now - d * 24 * 60 * 60;
+        uint32_t to = from + slots * _slotSeconds;
+
+        std::vector<TimeSeriesClass::Bucket> grid, ac;
+        if (!TimeSeries.getBuckets("grid_power", tier, from, to, slots, grid) ||
+                !TimeSeries.getBuckets("ac_power", tier, from, to, slots, ac)) {
+            return {};
+        }
+
+        for (size_t i = 0; i < slots; ++i) {
+            if (grid[i].Count == 0) { continue; }
+            float consumption = grid[i].Avg;
+            if (ac[i].Count > 0) { consumption += ac[i].Avg; }
+            sums[i] += std::max(consumption, 0.0f);
+            ++counts[i];
+        }
+    }
+
+    float knownSum = 0;
+    size_t known = 0;
+    for (size_t i = 0; i < slots; ++i) {
+        if (counts[i] == 0) { continue; }
+        sums[i] /= counts[i];
+        knownSum += sums[i];
+        ++known;
+    }
+
+    if (known == 0) { return {}; }
+
+    for (size_t i = 0; i < slots; ++i) {
+        if (counts[i] == 0) { sums[i] = knownSum / known; }
+        sums[i] /= _inverterEfficiency;
+    }
+
+    return sums;
+}
+
+// finds the lowest discharge power which, applied as a cap to the given
+// profile, still supplies the given energy. every slot below the cap is
+// covered entirely, all others are covered up to the cap. nullopt if the
+// energy suffices to cover the profile without a cap.
+std::optional<float> PowerLimiterDischargePlanClass::waterLevel(std::vector<float> profile, float energyWh)
+{
+    float const slotHours = static_cast<float>(_slotSeconds) / 3600;
+    float const energy = energyWh / slotHours; // in units of W * slots
+
+    std::sort(profile.begin(), profile.end());
+
+    float below = 0; // sum of all slots below the current one
+    size_t const count = profile.size();
+    for (size_t i = 0; i < count; ++i) {
+        size_t above = count - i;
+        if (below + profile[i] * above >= energy) {
+            return (energy - below) / above;
+        }
+        below += profile[i];
+    }
+
+    return std::nullopt;
+}
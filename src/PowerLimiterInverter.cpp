@@ -1,5 +1,6 @@
 #include "RestartHelper.h"
 #include "MessageOutput.h"
+#include "PowerMeter.h"
 #include "PowerLimiterInverter.h"
 #include "PowerLimiterBatteryInverter.h"
 #include "PowerLimiterSolarInverter.h"
@@ -41,6 +42,20 @@ PowerLimiterInverter::PowerLimiterInverter(bool verboseLogging, PowerLimiterInve
     snprintf(_logPrefix, sizeof(_logPrefix), "[DPL inverter %s]:", _serialStr);
 }
 
+bool PowerLimiterInverter::matches(PowerLimiterInverterConfig const& config) const
+{
+    return _config.Serial == config.Serial
+        && _config.IsGoverned == config.IsGoverned
+        && _config.IsBehindPowerMeter == config.IsBehindPowerMeter
+        && _config.UseOverscaling == config.UseOverscaling
+        && _config.LowerPowerLimit == config.LowerPowerLimit
+        && _config.UpperPowerLimit == config.UpperPowerLimit
+        && _config.ScalingThreshold == config.ScalingThreshold
+        && _config.PowerSource == config.PowerSource
+        && _config.Phase == config.Phase
+        && _spInverter == Hoymiles.getInverterBySerial(config.Serial);
+}
+
 PowerLimiterInverter::Eligibility PowerLimiterInverter::isEligible() const
 {
     if (!isReachable()) { return Eligibility::Unreachable; }
@@ -63,6 +78,9 @@ PowerLimiterInverter::Eligibility PowerLimiterInverter::isEligible() const
 
 bool PowerLimiterInverter::update()
 {
+    trackLatency();
+    trackResponse();
+
     auto reset = [this]() -> bool {
         _oTargetPowerState = std::nullopt;
         _oTargetPowerLimitWatts = std::nullopt;
@@ -98,6 +116,14 @@ bool PowerLimiterInverter::update()
 
     if (!_oUpdateStartMillis.has_value()) {
         _oUpdateStartMillis = millis();
+        ++_updateCycles;
+
+        // the update cycle starts right after the DPL decided on a new limit
+        _oLatency = PowerLimiterLatencyClass::Timestamps{};
+        _oLatency->Decision = *_oUpdateStartMillis;
+        if (PowerMeter.isDataValid()) {
+            _oLatency->MeterSample = PowerMeter.getLastUpdate();
+        }
     }
 
     if ((millis() - *_oUpdateStartMillis) > 30 * 1000) {
@@ -126,6 +152,7 @@ bool PowerLimiterInverter::update()
             RestartHelper.triggerRestart();
         }
 
+        _oLatency = std::nullopt;
         return reset();
     }
 
@@ -201,6 +228,15 @@ bool PowerLimiterInverter::update()
                         _logPrefix, newRelativeLimit, currentRelativeLimit);
             }
 
+            if (_oLatency) {
+                auto timings = _spInverter->SystemConfigPara()->getLastLimitCommandTimings();
+                _oLatency->Enqueued = timings.Enqueued;
+                _oLatency->FirstTx = timings.FirstTx;
+                _oLatency->Acknowledged = timings.Acknowledged;
+            }
+
+            _responseModel.onLimitApplied(lastLimitCommandMillis);
+
             _oTargetPowerLimitWatts = std::nullopt;
             return false;
         }
@@ -226,10 +262,52 @@ bool PowerLimiterInverter::update()
     if (switchPowerState(true)) { return true; }
 
     _updateTimeouts = 0;
+    _lastUpdateDurationMillis = millis() - *_oUpdateStartMillis;
 
     return reset();
 }
 
+uint16_t PowerLimiterInverter::curtail(uint16_t reduction)
+{
+    if (CMD_PENDING == _spInverter->SystemConfigPara()->getLastLimitCommandSuccess()) { return 0; }
+
+    auto actualReduction = applyReduction(reduction, false);
+    if (actualReduction == 0) { return 0; }
+
+    // a limit command completed in the current update cycle must not be
+    // mistaken to have set the new target limit.
+    _oUpdateStartMillis = std::nullopt;
+    update();
+
+    return actualReduction;
+}
+
+void PowerLimiterInverter::trackLatency()
+{
+    if (!_oLatency || _oLatency->Acknowledged == 0) { return; }
+
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    auto lastStatsMillis = _spInverter->Statistics()->getLastUpdate();
+    if ((lastStatsMillis - _oLatency->Acknowledged) > halfOfAllMillis) { return; }
+
+    _oLatency->Stats = lastStatsMillis;
+    PowerLimiterLatency.addSample(*_oLatency);
+    _oLatency = std::nullopt;
+}
+
+void PowerLimiterInverter::trackResponse()
+{
+    // the response model is used for battery-powered inverters only, whose
+    // output follows the limit unless the inverter derates.
+    if (!isBatteryPowered() || isEligible() != Eligibility::Eligible || !isProducing()) { return; }
+
+    // the known limit and the stats do not match while an update is pending
+    if (_oTargetPowerLimitWatts || _oTargetPowerState) { return; }
+
+    _responseModel.onStats(getCurrentLimitWatts(), getCurrentOutputAcWatts(),
+            _spInverter->Statistics()->getLastUpdate());
+}
+
 std::optional<uint32_t> PowerLimiterInverter::getLatestStatsMillis() const
 {
     uint32_t now = millis();
@@ -257,6 +335,13 @@ std::optional<uint32_t> PowerLimiterInverter::getLatestStatsMillis() const
             return std::nullopt;
         }
 
+        // stats collected while the output is still settling would make the
+        // DPL correct a change which is about to happen anyway
+        auto settleMillis = std::min(_responseModel.getSettleMillis(), _maxSettleWaitMillis);
+        if (lastStatsAge + settleMillis > lastUpdateCmdAge) {
+            return std::nullopt;
+        }
+
         _oStatsMillis = lastStatsMillis;
     }
 
@@ -288,6 +373,15 @@ uint16_t PowerLimiterInverter::getExpectedOutputAcWatts() const
     return _expectedOutputAcWatts;
 }
 
+bool PowerLimiterInverter::hasPendingReduction() const
+{
+    if (_oTargetPowerState.has_value() && !*_oTargetPowerState) { return true; }
+
+    if (!_oTargetPowerLimitWatts.has_value()) { return false; }
+
+    return *_oTargetPowerLimitWatts < getCurrentLimitWatts();
+}
+
 void PowerLimiterInverter::setMaxOutput()
 {
     _oTargetPowerState = true;
@@ -311,6 +405,22 @@ uint16_t PowerLimiterInverter::getCurrentLimitWatts() const
     return static_cast<uint16_t>(currentLimitPercent * getInverterMaxPowerWatts() / 100);
 }
 
+uint16_t PowerLimiterInverter::getModeledOutputWatts() const
+{
+    return std::min(_responseModel.getOutputFor(getCurrentLimitWatts()), getModeledMaxOutputWatts());
+}
+
+uint16_t PowerLimiterInverter::getModeledMaxOutputWatts() const
+{
+    uint16_t maxOutput = std::min(getConfiguredMaxPowerWatts(),
+            _responseModel.getOutputFor(getInverterMaxPowerWatts()));
+
+    auto oCeiling = _responseModel.getCeilingWatts();
+    if (oCeiling) { maxOutput = std::min(maxOutput, *oCeiling); }
+
+    return maxOutput;
+}
+
 void PowerLimiterInverter::debug() const
 {
     if (!_verboseLogging) { return; }
@@ -356,17 +466,25 @@ void PowerLimiterInverter::debug() const
         getUpdateTimeouts()
     );
 
+    if (isBatteryPowered()) {
+        auto oCeiling = _responseModel.getCeilingWatts();
+        MessageOutput.printf("    response: output/limit ratio %.3f, ceiling %i W, "
+                "settling within %u ms\r\n", _responseModel.getRatio(),
+                (oCeiling ? *oCeiling : -1), _responseModel.getSettleMillis());
+    }
+
     MessageOutput.printf("    MPPTs AC power:");
 
     auto pStats = _spInverter->Statistics();
     float inverterEfficiencyFactor = pStats->getChannelFieldValue(TYPE_INV, CH0, FLD_EFF) / 100;
-    std::vector<MpptNum_t> dcMppts = _spInverter->getMppts();
+    auto const& topology = _spInverter->getChannelTopology();
 
-    for (auto& m : dcMppts) {
+    for (uint8_t i = 0; i < topology.mpptCount; i++) {
+        auto m = topology.mppts[i];
         float mpptPowerAC = 0.0;
-        std::vector<ChannelNum_t> mpptChnls = _spInverter->getChannelsDCByMppt(m);
 
-        for (auto& c : mpptChnls) {
+        for (uint8_t j = 0; j < topology.mpptChannelCount[i]; j++) {
+            auto c = topology.mpptChannels[i][j];
             mpptPowerAC += pStats->getChannelFieldValue(TYPE_DC, c, FLD_PDC) * inverterEfficiencyFactor;
         }
 
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerLimiterLatency.h"
+#include <algorithm>
+#include <limits>
+
+PowerLimiterLatencyClass PowerLimiterLatency;
+
+void PowerLimiterLatencyClass::addDuration(Stage stage, uint32_t start, uint32_t end)
+{
+    // skip stages where one of the timestamps is unknown. we also ignore
+    // samples where the timestamps are not in order, as these indicate that
+    // the respective stage belongs to a different (older) command.
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    if (start == 0 || end == 0 || (end - start) > halfOfAllMillis) { return; }
+
+    auto& w = _windows[static_cast<size_t>(stage)];
+    w.Samples[w.Next] = end - start;
+    w.Next = (w.Next + 1) % _windowSize;
+    w.Size = std::min(w.Size + 1, _windowSize);
+}
+
+void PowerLimiterLatencyClass::addSample(Timestamps const& ts)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    addDuration(Stage::MeterToDecision, ts.MeterSample, ts.Decision);
+    addDuration(Stage::DecisionToEnqueue, ts.Decision, ts.Enqueued);
+    addDuration(Stage::EnqueueToTx, ts.Enqueued, ts.FirstTx);
+    addDuration(Stage::TxToAck, ts.FirstTx, ts.Acknowledged);
+    addDuration(Stage::AckToStats, ts.Acknowledged, ts.Stats);
+    addDuration(Stage::Total, ts.MeterSample, ts.Stats);
+}
+
+PowerLimiterLatencyClass::Summary PowerLimiterLatencyClass::getSummary(Stage stage) const
+{
+    std::array<uint32_t, _windowSize> sorted;
+    size_t size;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto const& w = _windows[static_cast<size_t>(stage)];
+        size = w.Size;
+        std::copy(w.Samples.begin(), w.Samples.begin() + size, sorted.begin());
+    }
+
+    if (size == 0) { return { 0, 0, 0, 0, 0 }; }
+
+    std::sort(sorted.begin(), sorted.begin() + size);
+
+    auto percentile = [&sorted,size](uint8_t p) -> uint32_t {
+        size_t idx = (size * p + 99) / 100; // nearest-rank method
+        return sorted[std::max<size_t>(idx, 1) - 1];
+    };
+
+    return { static_cast<uint32_t>(size), percentile(50),
+        percentile(95), percentile(99), sorted[size - 1] };
+}
+
+char const* PowerLimiterLatencyClass::getStageName(Stage stage)
+{
+    switch (stage) {
+        case Stage::MeterToDecision:
+            return "meter_to_decision";
+        case Stage::DecisionToEnqueue:
+            return "decision_to_enqueue";
+        case Stage::EnqueueToTx:
+            return "enqueue_to_tx";
+        case Stage::TxToAck:
+            return "tx_to_ack";
+        case Stage::AckToStats:
+            return "ack_to_stats";
+        case Stage::Total:
+            return "total";
+        case Stage::Count:
+            break;
+    }
+
+    return "unknown";
+}
+
+void PowerLimiterLatencyClass::serialize(JsonObject& target) const
+{
+    for (size_t i = 0; i < static_cast<size_t>(Stage::Count); ++i) {
+        auto stage = static_cast<Stage>(i);
+        auto summary = getSummary(stage);
+
+        JsonObject obj = target[getStageName(stage)].to<JsonObject>();
+        obj["count"] = summary.Count;
+        obj["p50"] = summary.P50;
+        obj["p95"] = summary.P95;
+        obj["p99"] = summary.P99;
+        obj["max"] = summary.Max;
+    }
+}
@@ -39,10 +39,9 @@ uint16_t PowerLimiterOverscalingInverter::scaleLimit(uint16_t expectedOutputWatt
     if (!isProducing()) { return expectedOutputWatts; }
 
     auto pStats = _spInverter->Statistics();
-    std::vector<ChannelNum_t> dcChnls = _spInverter->getChannelsDC();
-    std::vector<MpptNum_t> dcMppts = _spInverter->getMppts();
-    size_t dcTotalChnls = dcChnls.size();
-    size_t dcTotalMppts = dcMppts.size();
+    auto const& topology = _spInverter->getChannelTopology();
+    size_t dcTotalChnls = topology.channelCount;
+    size_t dcTotalMppts = topology.mpptCount;
 
     // if there is only one MPPT available, there is nothing we can do
     if (dcTotalMppts <= 1) { return expectedOutputWatts; }
@@ -73,11 +72,12 @@ uint16_t PowerLimiterOverscalingInverter::scaleLimit(uint16_t expectedOutputWatt
     size_t dcShadedMppts = 0;
     auto shadedChannelACPowerSum = 0.0;
 
-    for (auto& m : dcMppts) {
+    for (uint8_t i = 0; i < topology.mpptCount; i++) {
+        auto m = topology.mppts[i];
         float mpptPowerAC = 0.0;
-        std::vector<ChannelNum_t> mpptChnls = _spInverter->getChannelsDCByMppt(m);
 
-        for (auto& c : mpptChnls) {
+        for (uint8_t j = 0; j < topology.mpptChannelCount[i]; j++) {
+            auto c = topology.mpptChannels[i][j];
             mpptPowerAC += pStats->getChannelFieldValue(TYPE_DC, c, FLD_PDC) * inverterEfficiencyFactor;
         }
 
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerLimiterResponseModel.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void PowerLimiterResponseModel::onLimitApplied(uint32_t ackMillis)
+{
+    _settling = true;
+    _ackMillis = ackMillis;
+    _statsSinceAck = 0;
+}
+
+void PowerLimiterResponseModel::onStats(uint16_t limitWatts, uint16_t outputWatts, uint32_t statsMillis)
+{
+    if (statsMillis == _lastStatsMillis) { return; }
+
+    uint16_t previousOutputWatts = _lastOutputWatts;
+    _lastStatsMillis = statsMillis;
+    _lastOutputWatts = outputWatts;
+
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+
+    if (_settling) {
+        // stats collected before the limit was acknowledged
+        uint32_t elapsed = statsMillis - _ackMillis;
+        if (elapsed > halfOfAllMillis) { return; }
+
+        ++_statsSinceAck;
+
+        // the output either reached the expected value or stopped changing
+        bool onTarget = isNear(outputWatts, getOutputFor(limitWatts));
+        bool steady = _statsSinceAck > 1 && isNear(outputWatts, previousOutputWatts);
+        if (!onTarget && !steady && elapsed < _settleMaxMillis) { return; }
+
+        _settling = false;
+        if (elapsed >= _settleMaxMillis) { return; }
+
+        _settleMillis = (_settleMillis == 0) ? elapsed : (_settleMillis * 3 + elapsed) / 4;
+    }
+
+    if (limitWatts < _minLimitWatts) { return; }
+
+    float expected = limitWatts * _ratio;
+    float tolerance = std::max<float>(_toleranceWatts * 4, expected * 0.1f);
+    if (outputWatts + tolerance < expected) {
+        // the inverter cannot follow the limit
+        _oCeilingWatts = outputWatts;
+        _ceilingMillis = statsMillis;
+        return;
+    }
+
+    float ratio = std::clamp(static_cast<float>(outputWatts) / limitWatts, _ratioMin, _ratioMax);
+    _ratio += (ratio - _ratio) * _ratioWeight;
+
+    if (_oCeilingWatts && outputWatts > *_oCeilingWatts) { _oCeilingWatts.reset(); }
+}
+
+uint16_t PowerLimiterResponseModel::getLimitFor(uint16_t outputWatts) const
+{
+    return static_cast<uint16_t>(std::min(std::round(outputWatts / _ratio), 65535.0f));
+}
+
+uint16_t PowerLimiterResponseModel::getOutputFor(uint16_t limitWatts) const
+{
+    return static_cast<uint16_t>(std::min(std::round(limitWatts * _ratio), 65535.0f));
+}
+
+std::optional<uint16_t> PowerLimiterResponseModel::getCeilingWatts() const
+{
+    if (!_oCeilingWatts || (millis() - _ceilingMillis) > _ceilingMaxAgeMillis) { return std::nullopt; }
+    return _oCeilingWatts;
+}
+
+bool PowerLimiterResponseModel::isNear(uint16_t actual, uint16_t expected)
+{
+    int32_t tolerance = std::max<int32_t>(_toleranceWatts, expected / 50);
+    return std::abs(static_cast<int32_t>(actual) - static_cast<int32_t>(expected)) <= tolerance;
+}
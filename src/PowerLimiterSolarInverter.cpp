@@ -28,8 +28,8 @@ uint16_t PowerLimiterSolarInverter::getMaxIncreaseWatts() const
     int16_t maxTotalIncrease = getConfiguredMaxPowerWatts() - getCurrentOutputAcWatts();
 
     auto pStats = _spInverter->Statistics();
-    std::vector<MpptNum_t> dcMppts = _spInverter->getMppts();
-    size_t dcTotalMppts = dcMppts.size();
+    auto const& topology = _spInverter->getChannelTopology();
+    size_t dcTotalMppts = topology.mpptCount;
 
     float inverterEfficiencyFactor = pStats->getChannelFieldValue(TYPE_INV, CH0, FLD_EFF) / 100;
 
@@ -48,11 +48,12 @@ uint16_t PowerLimiterSolarInverter::getMaxIncreaseWatts() const
     size_t dcNonShadedMppts = 0;
     auto nonShadedMpptACPowerSum = 0.0;
 
-    for (auto& m : dcMppts) {
+    for (uint8_t i = 0; i < topology.mpptCount; i++) {
+        auto m = topology.mppts[i];
         float mpptPowerAC = 0.0;
-        std::vector<ChannelNum_t> mpptChnls = _spInverter->getChannelsDCByMppt(m);
 
-        for (auto& c : mpptChnls) {
+        for (uint8_t j = 0; j < topology.mpptChannelCount[i]; j++) {
+            auto c = topology.mpptChannels[i][j];
             mpptPowerAC += pStats->getChannelFieldValue(TYPE_DC, c, FLD_PDC) * inverterEfficiencyFactor;
         }
 
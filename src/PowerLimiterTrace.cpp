@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerLimiterTrace.h"
+#include "MemoryPolicy.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+PowerLimiterTraceClass PowerLimiterTrace;
+
+// must be called with _mutex held
+bool PowerLimiterTraceClass::allocate()
+{
+    if (_records != nullptr) { return true; }
+
+    // covers several minutes of regular operation with PSRAM
+    size_t capacity = MemoryPolicy::hasPsram() ? 512 : 48;
+    _records = static_cast<Record*>(MemoryPolicy::allocate(capacity * sizeof(Record),
+                MemoryPolicy::Placement::Bulk));
+    if (_records == nullptr) { return false; }
+
+    _capacity = capacity;
+    return true;
+}
+
+void PowerLimiterTraceClass::addRecord(Record const& record)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!allocate()) { return; }
+
+    _records[_next] = record;
+    _next = (_next + 1) % _capacity;
+    _size = std::min(_size + 1, _capacity);
+    _lastStatus = record.Status;
+}
+
+void PowerLimiterTraceClass::addStatus(uint8_t status)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (status == _lastStatus) { return; }
+    }
+
+    Record record = {};
+    record.Millis = millis();
+    std::time_t now = std::time(nullptr);
+    record.Time = now > 1600000000 ? static_cast<uint32_t>(now) : 0;
+    record.Status = status;
+    record.BatterySoC = 255;
+    addRecord(record);
+}
+
+std::shared_ptr<std::vector<uint8_t>> PowerLimiterTraceClass::serialize() const
+{
+    auto spData = std::make_shared<std::vector<uint8_t>>();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    spData->resize(12 + _size * sizeof(Record));
+    auto data = spData->data();
+
+    memcpy(data, "DPLT", 4);
+    data[4] = _version;
+    data[5] = sizeof(Record);
+    uint16_t count = _size;
+    memcpy(data + 6, &count, sizeof(count));
+    uint32_t now = millis();
+    memcpy(data + 8, &now, sizeof(now));
+
+    size_t first = (_next + _capacity - _size) % std::max<size_t>(_capacity, 1);
+    for (size_t i = 0; i < _size; ++i) {
+        memcpy(data + 12 + i * sizeof(Record), &_records[(first + i) % _capacity], sizeof(Record));
+    }
+
+    return spData;
+}
+
+uint16_t PowerLimiterTraceClass::toMicros(int64_t start, int64_t end)
+{
+    return static_cast<uint16_t>(std::clamp<int64_t>(end - start, 0, 0xFFFF));
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerManagement.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "MetricsRegistry.h"
+#include "NetworkSettings.h"
+#include "PowerLimiter.h"
+#include "TaskMonitor.h"
+#include <Hoymiles.h>
+#include <algorithm>
+
+PowerManagementClass PowerManagement;
+
+namespace {
+
+#if CONFIG_IDF_TARGET_ESP32
+using pm_config_t = esp_pm_config_esp32_t;
+#elif CONFIG_IDF_TARGET_ESP32S2
+using pm_config_t = esp_pm_config_esp32s2_t;
+#elif CONFIG_IDF_TARGET_ESP32C3
+using pm_config_t = esp_pm_config_esp32c3_t;
+#elif CONFIG_IDF_TARGET_ESP32S3
+using pm_config_t = esp_pm_config_esp32s3_t;
+#else
+#error Target CONFIG_IDF_TARGET is not supported
+#endif
+
+char const* const lockNames[] = { "radio", "dpl", "http" };
+
+}; // namespace
+
+PowerManagementClass::PowerManagementClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("PowerManagement::loop", std::bind(&PowerManagementClass::loop, this)))
+{
+}
+
+void PowerManagementClass::init(Scheduler& scheduler)
+{
+    using Type = MetricsRegistryClass::Type;
+    MetricsRegistry.add("opendtu_cpu_frequency_mhz", "Current CPU frequency in MHz", Type::Gauge,
+        []() -> std::optional<float> { return getCpuFrequencyMhz(); });
+
+#ifdef CONFIG_PM_ENABLE
+    for (size_t i = 0; i < _lockCount; ++i) {
+        if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, lockNames[i], &_locks[i]) != ESP_OK) {
+            MessageOutput.printf("[PowerManagement] Failed to create lock %s\r\n", lockNames[i]);
+            return;
+        }
+    }
+
+    // all subsystems are considered active until the first evaluation
+    for (size_t i = 0; i < _lockCount; ++i) { hold(static_cast<Lock>(i), true); }
+
+    pm_config_t config = {};
+    config.max_freq_mhz = getCpuFrequencyMhz();
+    config.min_freq_mhz = std::min(config.max_freq_mhz, static_cast<int>(_minFrequencyMhz));
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    // the Ethernet PHY does not keep the link while the chip sleeps
+    config.light_sleep_enable = NetworkSettings.NetworkMode() != network_mode::Ethernet;
+#endif
+
+    esp_err_t err = esp_pm_configure(&config);
+    if (err != ESP_OK) {
+        MessageOutput.printf("[PowerManagement] Not available: %s\r\n", esp_err_to_name(err));
+        return;
+    }
+
+    _enabled = true;
+    MessageOutput.printf("[PowerManagement] CPU frequency scaled between %d and %d MHz\r\n",
+            config.min_freq_mhz, config.max_freq_mhz);
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+#else
+    MessageOutput.println("[PowerManagement] Not available in this build");
+#endif
+}
+
+void PowerManagementClass::poke(Lock lock)
+{
+    if (!_enabled) { return; }
+
+    _lastPoke[static_cast<size_t>(lock)] = millis();
+    hold(lock, true);
+}
+
+void PowerManagementClass::hold(Lock lock, bool held)
+{
+    auto index = static_cast<size_t>(lock);
+
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (_held[index] == held || _locks[index] == nullptr) { return; }
+
+    esp_err_t err = held ? esp_pm_lock_acquire(_locks[index]) : esp_pm_lock_release(_locks[index]);
+    if (err == ESP_OK) { _held[index] = held; }
+}
+
+void PowerManagementClass::loop()
+{
+    hold(Lock::Radio, Hoymiles.getNumInverters() > 0 && !Hoymiles.getNightMode());
+
+    hold(Lock::Dpl, Configuration.get().PowerLimiter.Enabled
+            && PowerLimiter.isGoverningProducingInverters());
+
+    auto index = static_cast<size_t>(Lock::Http);
+    if (millis() - _lastPoke[index] > _pokeHoldMillis) { hold(Lock::Http, false); }
+}
@@ -1,94 +1,290 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include "PowerMeter.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
+#include "MessageOutput.h"
+#include "MetricsRegistry.h"
 #include "PowerMeterHttpJson.h"
+#include "PowerMeterEspNow.h"
 #include "PowerMeterHttpSml.h"
 #include "PowerMeterMqtt.h"
 #include "PowerMeterSerialSdm.h"
 #include "PowerMeterSerialSml.h"
+#include "PowerMeterShelly.h"
+#include "PowerMeterUdp.h"
 #include "PowerMeterUdpSmaHomeManager.h"
+#include "PowerMeterSimulation.h"
+#include <esp_rom_crc.h>
+#include <limits>
 
 PowerMeterClass PowerMeter;
 
 void PowerMeterClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&PowerMeterClass::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("PowerMeter::loop", std::bind(&PowerMeterClass::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
     updateSettings();
+
+    registerMetrics();
 }
 
-void PowerMeterClass::updateSettings()
+void PowerMeterClass::registerMetrics()
 {
-    std::lock_guard<std::mutex> l(_mutex);
+    using Type = MetricsRegistryClass::Type;
 
-    if (_upProvider) { _upProvider.reset(); }
+    auto ifEnabled = [](auto getter) {
+        return [getter]() -> std::optional<float> {
+            if (!Configuration.get().PowerMeter.Enabled) { return std::nullopt; }
+            return getter();
+        };
+    };
 
-    auto const& pmcfg = Configuration.get().PowerMeter;
+    MetricsRegistry.add("opendtu_power_meter_data_valid", "Power meter data is valid", Type::Gauge,
+        ifEnabled([this]() { return isDataValid() ? 1.0f : 0.0f; }));
+    MetricsRegistry.add("opendtu_power_meter_power", "Power meter total power in W", Type::Gauge,
+        ifEnabled([this]() { return getPowerTotal(); }));
+    MetricsRegistry.add("opendtu_power_meter_power_raw", "Power meter total power in W before filtering", Type::Gauge,
+        ifEnabled([this]() { return getPowerTotalRaw(); }));
+}
 
-    if (!pmcfg.Enabled) { return; }
+std::unique_ptr<PowerMeterProvider> PowerMeterClass::createProvider(PowerMeterProvider::Type type)
+{
+    auto const& pmcfg = Configuration.get().PowerMeter;
 
-    switch(static_cast<PowerMeterProvider::Type>(pmcfg.Source)) {
+    switch(type) {
         case PowerMeterProvider::Type::MQTT:
-            _upProvider = std::make_unique<PowerMeterMqtt>(pmcfg.Mqtt);
-            break;
+            return std::make_unique<PowerMeterMqtt>(pmcfg.Mqtt);
         case PowerMeterProvider::Type::SDM1PH:
-            _upProvider = std::make_unique<PowerMeterSerialSdm>(
+            return std::make_unique<PowerMeterSerialSdm>(
                     PowerMeterSerialSdm::Phases::One, pmcfg.SerialSdm);
-            break;
         case PowerMeterProvider::Type::SDM3PH:
-            _upProvider = std::make_unique<PowerMeterSerialSdm>(
+            return std::make_unique<PowerMeterSerialSdm>(
                     PowerMeterSerialSdm::Phases::Three, pmcfg.SerialSdm);
-            break;
         case PowerMeterProvider::Type::HTTP_JSON:
-            _upProvider = std::make_unique<PowerMeterHttpJson>(pmcfg.HttpJson);
-            break;
+            return std::make_unique<PowerMeterHttpJson>(pmcfg.HttpJson);
         case PowerMeterProvider::Type::SERIAL_SML:
-            _upProvider = std::make_unique<PowerMeterSerialSml>();
-            break;
+            return std::make_unique<PowerMeterSerialSml>();
         case PowerMeterProvider::Type::SMAHM2:
-            _upProvider = std::make_unique<PowerMeterUdpSmaHomeManager>();
-            break;
+            return std::make_unique<PowerMeterUdpSmaHomeManager>();
         case PowerMeterProvider::Type::HTTP_SML:
-            _upProvider = std::make_unique<PowerMeterHttpSml>(pmcfg.HttpSml);
-            break;
+            return std::make_unique<PowerMeterHttpSml>(pmcfg.HttpSml);
+        case PowerMeterProvider::Type::ESP_NOW:
+            return std::make_unique<PowerMeterEspNow>();
+        case PowerMeterProvider::Type::SHELLY:
+            return std::make_unique<PowerMeterShelly>();
+        case PowerMeterProvider::Type::UDP:
+            return std::make_unique<PowerMeterUdp>(pmcfg.Udp);
+    }
+
+    return nullptr;
+}
+
+// the CRC of all settings which are used when creating the providers, i.e.,
+// all settings except for the verbose logging and the filter.
+uint32_t PowerMeterClass::getProviderSettingsCrc()
+{
+    auto const& pmcfg = Configuration.get().PowerMeter;
+
+    auto add = [](uint32_t crc, auto const& value) -> uint32_t {
+        return esp_rom_crc32_le(crc, reinterpret_cast<uint8_t const*>(&value), sizeof(value));
+    };
+
+    uint32_t crc = add(0, pmcfg.Enabled);
+    crc = add(crc, pmcfg.Source);
+    crc = add(crc, pmcfg.Mqtt);
+    crc = add(crc, pmcfg.SerialSdm);
+    crc = add(crc, pmcfg.HttpJson);
+    crc = add(crc, pmcfg.HttpSml);
+    crc = add(crc, pmcfg.Udp);
+    return add(crc, pmcfg.Additional);
+}
+
+void PowerMeterClass::updateSettings()
+{
+    std::lock_guard<std::mutex> l(_mutex);
+
+    auto const& pmcfg = Configuration.get().PowerMeter;
+
+    uint32_t crc = getProviderSettingsCrc();
+    if (_oProviderSettingsCrc == crc && !_meters.empty()) {
+        for (auto const& meter : _meters) {
+            meter.upProvider->updateCommonSettings(pmcfg);
+        }
+        return;
+    }
+
+    _oProviderSettingsCrc = crc;
+    _meters.clear();
+    _active = 0;
+
+    if (!pmcfg.Enabled) { return; }
+
+#ifdef OPENDTU_DPL_SIMULATION
+    // the simulated grid power replaces all configured power meters
+    _meters.push_back({ 1.0f, false, static_cast<PowerMeterProvider::Type>(pmcfg.Source),
+            std::make_unique<PowerMeterSimulation>() });
+    return;
+#endif
+
+    auto primaryType = static_cast<PowerMeterProvider::Type>(pmcfg.Source);
+    auto upPrimary = createProvider(primaryType);
+    if (!upPrimary || !upPrimary->init()) { return; }
+    _meters.push_back({ 1.0f, false, primaryType, std::move(upPrimary) });
+
+    for (auto const& additional : pmcfg.Additional) {
+        if (additional.Op == PowerMeterAdditionalConfig::Operation::Disabled) { continue; }
+
+        auto type = static_cast<PowerMeterProvider::Type>(additional.Source);
+        auto upProvider = createProvider(type);
+        if (!upProvider || !upProvider->init()) {
+            // the virtual power meter would report nonsense without it
+            MessageOutput.printf("[PowerMeter] additional power meter of "
+                    "type %u failed to initialize\r\n", additional.Source);
+            _meters.clear();
+            return;
+        }
+
+        float sign = (additional.Op == PowerMeterAdditionalConfig::Operation::Subtract) ? -1.0f : 1.0f;
+        bool standby = (additional.Op == PowerMeterAdditionalConfig::Operation::Standby);
+        if (standby) { upProvider->setStandby(true); }
+        _meters.push_back({ sign, standby, type, std::move(upProvider) });
+    }
+}
+
+bool PowerMeterClass::isInUse(size_t index) const
+{
+    if (index == _active) { return true; }
+    return index != 0 && !_meters[index].Standby;
+}
+
+// must be called with _mutex held
+void PowerMeterClass::selectActive()
+{
+    size_t active = 0;
+    if (_meters.front().upProvider->isStale()) {
+        for (size_t i = 1; i < _meters.size(); ++i) {
+            if (_meters[i].Standby && !_meters[i].upProvider->isStale()) {
+                active = i;
+                break;
+            }
+        }
     }
 
-    if (!_upProvider->init()) {
-        _upProvider = nullptr;
+    // the standby meters poll at a low rate unless in use. the primary
+    // power meter keeps polling at its normal rate to recover quickly.
+    for (size_t i = 1; i < _meters.size(); ++i) {
+        auto const& meter = _meters[i];
+        bool standby = meter.Standby && i != active;
+        if (meter.upProvider->isStandby() != standby) { meter.upProvider->setStandby(standby); }
     }
+
+    if (active == _active) { return; }
+
+    if (active == 0) {
+        MessageOutput.print("[PowerMeter] primary power meter recovered\r\n");
+    } else {
+        MessageOutput.printf("[PowerMeter] primary power meter readings are stale, "
+                "using power meter %u instead\r\n", static_cast<unsigned>(active));
+    }
+
+    _active = active;
 }
 
 float PowerMeterClass::getPowerTotal() const
 {
     std::lock_guard<std::mutex> l(_mutex);
-    if (!_upProvider) { return 0.0; }
-    return _upProvider->getPowerTotal();
+    float total = 0.0;
+    for (size_t i = 0; i < _meters.size(); ++i) {
+        if (!isInUse(i)) { continue; }
+        total += _meters[i].Sign * _meters[i].upProvider->getPowerTotalFiltered();
+    }
+    return total;
+}
+
+float PowerMeterClass::getPowerTotalRaw() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    float total = 0.0;
+    for (size_t i = 0; i < _meters.size(); ++i) {
+        if (!isInUse(i)) { continue; }
+        total += _meters[i].Sign * _meters[i].upProvider->getPowerTotal();
+    }
+    return total;
+}
+
+std::optional<PowerMeterProvider::phase_values_t> PowerMeterClass::getPowerPhases() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    if (_meters.empty()) { return std::nullopt; }
+
+    PowerMeterProvider::phase_values_t phases = {};
+    for (size_t i = 0; i < _meters.size(); ++i) {
+        if (!isInUse(i)) { continue; }
+
+        auto oPhases = _meters[i].upProvider->getPowerPhases();
+        if (!oPhases) { return std::nullopt; }
+
+        for (size_t p = 0; p < phases.size(); ++p) {
+            phases[p] += _meters[i].Sign * (*oPhases)[p];
+        }
+    }
+    return phases;
 }
 
 uint32_t PowerMeterClass::getLastUpdate() const
 {
     std::lock_guard<std::mutex> l(_mutex);
-    if (!_upProvider) { return 0; }
-    return _upProvider->getLastUpdate();
+    if (_meters.empty()) { return 0; }
+
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    uint32_t latest = _meters[_active].upProvider->getLastUpdate();
+    for (size_t i = 0; i < _meters.size(); ++i) {
+        if (!isInUse(i)) { continue; }
+        uint32_t lastUpdate = _meters[i].upProvider->getLastUpdate();
+        if ((lastUpdate - latest) < halfOfAllMillis) { latest = lastUpdate; }
+    }
+    return latest;
 }
 
 bool PowerMeterClass::isDataValid() const
 {
     std::lock_guard<std::mutex> l(_mutex);
-    if (!_upProvider) { return false; }
-    return _upProvider->isDataValid();
+    if (_meters.empty()) { return false; }
+    for (size_t i = 0; i < _meters.size(); ++i) {
+        if (isInUse(i) && !_meters[i].upProvider->isDataValid()) { return false; }
+    }
+    return true;
+}
+
+std::vector<PowerMeterProvider::Metrics> PowerMeterClass::getMetrics() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    std::vector<PowerMeterProvider::Metrics> res;
+    res.reserve(_meters.size());
+    for (auto const& meter : _meters) {
+        res.push_back(meter.upProvider->getMetrics());
+    }
+    return res;
 }
 
 void PowerMeterClass::loop()
 {
     std::lock_guard<std::mutex> lock(_mutex);
-    if (!_upProvider) { return; }
-    _upProvider->loop();
+    if (_meters.empty()) { return; }
 
-    auto const& pmcfg = Configuration.get().PowerMeter;
-    if (pmcfg.Source == static_cast<uint8_t>(PowerMeterProvider::Type::MQTT)) { return; }
-    _upProvider->mqttLoop();
+    for (auto const& meter : _meters) {
+        meter.upProvider->loop();
+    }
+
+    selectActive();
+
+    // only the primary power meter (or the one substituting it) publishes
+    // its values, as the additional power meters would otherwise overwrite
+    // them in the same topics.
+    auto const& active = _meters[_active];
+    if (active.Type == PowerMeterProvider::Type::MQTT) { return; }
+    active.upProvider->mqttLoop();
 }
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerMeterEspNow.h"
+#include "MessageOutput.h"
+#include <Arduino.h>
+#include <esp_now.h>
+#include <esp_rom_crc.h>
+#include <esp_wifi.h>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// the ESP-NOW receive callback has no context argument
+std::mutex sInstanceMutex;
+PowerMeterEspNow* sInstance = nullptr;
+
+void onReceive(uint8_t const* mac, uint8_t const* data, int length)
+{
+    std::lock_guard<std::mutex> lock(sInstanceMutex);
+    if (sInstance != nullptr) { sInstance->onFrame(mac, data, length); }
+}
+
+// a sender that was silent for this long may have restarted, hence its
+// sequence numbers, as well as a different sender, are accepted again.
+constexpr uint32_t silenceMillis = 3000;
+
+constexpr uint32_t retryMillis = 5000;
+constexpr uint32_t statsLogMillis = 60 * 1000;
+
+}; // namespace
+
+static_assert(sizeof(PowerMeterEspNow::Frame) == 32, "ESP-NOW frame layout changed");
+
+PowerMeterEspNow::~PowerMeterEspNow()
+{
+    {
+        // waits for the callback to return if it is executing right now
+        std::lock_guard<std::mutex> lock(sInstanceMutex);
+        if (sInstance == this) { sInstance = nullptr; }
+    }
+
+    if (_started) {
+        esp_now_unregister_recv_cb();
+        esp_now_deinit();
+    }
+}
+
+bool PowerMeterEspNow::init()
+{
+    {
+        std::lock_guard<std::mutex> lock(sInstanceMutex);
+        sInstance = this;
+    }
+
+    start();
+    return true;
+}
+
+bool PowerMeterEspNow::start()
+{
+    _lastStartAttempt = millis();
+
+    wifi_mode_t mode;
+    if (esp_wifi_get_mode(&mode) != ESP_OK || mode == WIFI_MODE_NULL) { return false; }
+
+    esp_err_t err = esp_now_init();
+    if (err != ESP_OK) {
+        MessageOutput.printf("[PowerMeterEspNow] cannot initialize ESP-NOW: %s\r\n",
+                esp_err_to_name(err));
+        return false;
+    }
+
+    err = esp_now_register_recv_cb(&onReceive);
+    if (err != ESP_OK) {
+        MessageOutput.printf("[PowerMeterEspNow] cannot register receive callback: %s\r\n",
+                esp_err_to_name(err));
+        esp_now_deinit();
+        return false;
+    }
+
+    uint8_t channel = 0;
+    wifi_second_chan_t second;
+    esp_wifi_get_channel(&channel, &second);
+    MessageOutput.printf("[PowerMeterEspNow] listening on WiFi channel %u\r\n", channel);
+
+    _started = true;
+    return true;
+}
+
+void PowerMeterEspNow::loop()
+{
+    if (!_started && millis() - _lastStartAttempt >= retryMillis) { start(); }
+
+    if (!_verboseLogging || millis() - _lastStatsLog < statsLogMillis) { return; }
+    _lastStatsLog = millis();
+
+    std::lock_guard<std::mutex> l(_mutex);
+    MessageOutput.printf("[PowerMeterEspNow] sequence %u, lost %u, stale %u, "
+            "invalid %u frames\r\n", _sequence, _lostFrames, _staleFrames, _invalidFrames);
+}
+
+float PowerMeterEspNow::getPowerTotal() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _powerTotal;
+}
+
+std::optional<PowerMeterProvider::phase_values_t> PowerMeterEspNow::getPowerPhases() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    if (!_phasesValid) { return std::nullopt; }
+    return _powerPhases;
+}
+
+void PowerMeterEspNow::doMqttPublish() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    if (!_phasesValid) { return; }
+    mqttPublish("power1", _powerPhases[0]);
+    mqttPublish("power2", _powerPhases[1]);
+    mqttPublish("power3", _powerPhases[2]);
+}
+
+void PowerMeterEspNow::onFrame(uint8_t const* mac, uint8_t const* data, int length)
+{
+    uint32_t const receivedMillis = millis();
+
+    Frame frame;
+    if (mac == nullptr || length != sizeof(frame)) { return; }
+    memcpy(&frame, data, sizeof(frame));
+
+    // other ESP-NOW devices might be around, which are silently ignored
+    if (frame.Magic != FrameMagic) { return; }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    uint32_t crc = esp_rom_crc32_le(0, data, sizeof(frame) - sizeof(frame.Crc));
+    if (frame.Version != FrameVersion || frame.Crc != crc || !std::isfinite(frame.PowerTotal)) {
+        _invalidFrames++;
+        return;
+    }
+
+    bool silent = !_synced || receivedMillis - _lastFrameMillis >= silenceMillis;
+    bool sameSender = memcmp(_sender.data(), mac, _sender.size()) == 0;
+
+    if (!silent) {
+        int32_t diff = static_cast<int32_t>(frame.Sequence - _sequence);
+        if (!sameSender || diff <= 0) {
+            _staleFrames++;
+            return;
+        }
+        _lostFrames += diff - 1;
+    }
+
+    if (!sameSender) {
+        MessageOutput.printf("[PowerMeterEspNow] receiving from %02X:%02X:%02X:%02X:%02X:%02X\r\n",
+                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        memcpy(_sender.data(), mac, _sender.size());
+    }
+
+    _synced = true;
+    _sequence = frame.Sequence;
+    _lastFrameMillis = receivedMillis;
+
+    _powerTotal = frame.PowerTotal;
+    _phasesValid = (frame.Flags & FlagPhasesValid) != 0;
+    for (size_t i = 0; i < _powerPhases.size(); ++i) {
+        _powerPhases[i] = _phasesValid ? frame.PowerPhases[i] : 0.0f;
+    }
+
+    lock.unlock();
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[PowerMeterEspNow] #%u: %.1f W\r\n", frame.Sequence, frame.PowerTotal);
+    }
+
+    gotUpdate(receivedMillis);
+}
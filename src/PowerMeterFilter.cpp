@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerMeterFilter.h"
+#include <algorithm>
+#include <cmath>
+
+PowerMeterFilter::PowerMeterFilter(PowerMeterFilterConfig const& cfg)
+    : _cfg(cfg)
+{
+}
+
+void PowerMeterFilter::reset(float value)
+{
+    _next = 0;
+    _count = 0;
+    _filtered = value;
+    _pendingStep = 0;
+}
+
+void PowerMeterFilter::addSample(float value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_cfg.FilterMode == PowerMeterFilterConfig::Mode::None) {
+        _filtered = value;
+        return;
+    }
+
+    if (_count > 0 && _cfg.StepThreshold > 0) {
+        float delta = value - _filtered;
+        if (std::fabs(delta) > _cfg.StepThreshold) {
+            int8_t direction = (delta > 0) ? 1 : -1;
+
+            // first sample outside the band: assume it is a glitch
+            if (_pendingStep != direction) {
+                _pendingStep = direction;
+                return;
+            }
+
+            // second sample in a row deviating in the same direction:
+            // this is a real step, so drop the history and follow it.
+            reset(value);
+        }
+        else {
+            _pendingStep = 0;
+        }
+    }
+
+    size_t window = std::clamp<size_t>(_cfg.Window, 1, _samples.size());
+    _samples[_next] = value;
+    _next = (_next + 1) % window;
+    _count = std::min(_count + 1, window);
+
+    if (_cfg.FilterMode == PowerMeterFilterConfig::Mode::Ema) {
+        if (_count == 1) { _filtered = value; return; }
+        float alpha = 2.0f / (window + 1);
+        _filtered += alpha * (value - _filtered);
+        return;
+    }
+
+    // median of the (small, bounded) window
+    std::array<float, POWERMETER_FILTER_MAX_WINDOW> sorted;
+    std::copy(_samples.begin(), _samples.begin() + _count, sorted.begin());
+    auto middle = sorted.begin() + _count / 2;
+    std::nth_element(sorted.begin(), middle, sorted.begin() + _count);
+    _filtered = *middle;
+}
+
+void PowerMeterFilter::setConfig(PowerMeterFilterConfig const& cfg)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cfg = cfg;
+    reset(_filtered);
+}
+
+float PowerMeterFilter::getFiltered() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _filtered;
+}
@@ -10,18 +10,9 @@
 
 PowerMeterHttpJson::~PowerMeterHttpJson()
 {
-    _taskDone = false;
-
-    std::unique_lock<std::mutex> lock(_pollingMutex);
-    _stopPolling = true;
-    lock.unlock();
-
-    _cv.notify_all();
-
-    if (_taskHandle != nullptr) {
-        while (!_taskDone) { delay(10); }
-        _taskHandle = nullptr;
-    }
+    // waits for a poll in progress, which uses the workers
+    if (_pollerJob != 0) { HttpPoller.remove(_pollerJob); }
+    stopWorkers();
 }
 
 bool PowerMeterHttpJson::init()
@@ -30,6 +21,7 @@ bool PowerMeterHttpJson::init()
         auto const& valueConfig = _cfg.Values[i];
 
         _httpGetters[i] = nullptr;
+        _jsonFilters[i].clear();
 
         if (i == 0 || (_cfg.IndividualRequests && valueConfig.Enabled)) {
             _httpGetters[i] = std::make_unique<HttpGetter>(valueConfig.HttpRequest);
@@ -48,65 +40,135 @@ bool PowerMeterHttpJson::init()
         return false;
     }
 
+    for (uint8_t i = 0; i < POWERMETER_HTTP_JSON_MAX_VALUES; i++) {
+        auto const& valueConfig = _cfg.Values[i];
+        if (!valueConfig.Enabled) { continue; }
+
+        // values without an individual request use the first response
+        auto& filter = _jsonFilters[_httpGetters[i] ? i : 0];
+        Utils::addJsonPathToFilter(filter, valueConfig.JsonPath);
+    }
+
+    for (uint8_t i = 0; i < POWERMETER_HTTP_JSON_MAX_VALUES; i++) {
+        _jobs[i].pInstance = this;
+        _jobs[i].Index = i;
+
+        if (i == 0 || !_cfg.Values[i].Enabled || !_httpGetters[i]) { continue; }
+
+        startWorker(_jobs[i]);
+    }
+
     return true;
 }
 
 void PowerMeterHttpJson::loop()
 {
-    if (_taskHandle != nullptr) { return; }
+    if (_pollerJob != 0) { return; }
+
+    _pollerJob = HttpPoller.add({
+        [this] { return getPollingIntervalMillis(_cfg.PollingInterval); },
+        [this] { return pollAndPublish(); },
+        [this] { prewarm(); }
+    });
+}
+
+bool PowerMeterHttpJson::pollAndPublish()
+{
+    auto res = poll();
+
+    if (std::holds_alternative<String>(res)) {
+        MessageOutput.printf("[PowerMeterHttpJson] %s\r\n", std::get<String>(res).c_str());
+        return false;
+    }
+
+    MessageOutput.printf("[PowerMeterHttpJson] New total: %.2f\r\n", getPowerTotal());
 
-    std::unique_lock<std::mutex> lock(_pollingMutex);
-    _stopPolling = false;
-    lock.unlock();
+    gotUpdate();
+    return true;
+}
 
-    uint32_t constexpr stackSize = 3072;
-    xTaskCreate(PowerMeterHttpJson::pollingLoopHelper, "PM:HTTP+JSON",
-            stackSize, this, 1/*prio*/, &_taskHandle);
+void PowerMeterHttpJson::prewarm()
+{
+    for (auto const& upGetter : _httpGetters) {
+        if (upGetter) { upGetter->prewarm(); }
+    }
 }
 
-void PowerMeterHttpJson::pollingLoopHelper(void* context)
+void PowerMeterHttpJson::fetchLoopHelper(void* context)
 {
-    auto pInstance = static_cast<PowerMeterHttpJson*>(context);
-    pInstance->pollingLoop();
-    pInstance->_taskDone = true;
+    auto& job = *static_cast<FetchJob*>(context);
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (job.StopTask) { break; }
+
+        job.Error = job.pInstance->fetch(job.Index, job.Response);
+        xSemaphoreGive(job.Done);
+    }
+
+    xSemaphoreGive(job.Done); // the job must not be accessed after this
     vTaskDelete(nullptr);
 }
 
-void PowerMeterHttpJson::pollingLoop()
+void PowerMeterHttpJson::startWorker(FetchJob& job)
 {
-    std::unique_lock<std::mutex> lock(_pollingMutex);
-
-    while (!_stopPolling) {
-        auto elapsedMillis = millis() - _lastPoll;
-        auto intervalMillis = _cfg.PollingInterval * 1000;
-        if (_lastPoll > 0 && elapsedMillis < intervalMillis) {
-            auto sleepMs = intervalMillis - elapsedMillis;
-            _cv.wait_for(lock, std::chrono::milliseconds(sleepMs),
-                    [this] { return _stopPolling; }); // releases the mutex
-            continue;
-        }
+    job.StopTask = false;
+    job.Done = xSemaphoreCreateBinary();
+    if (job.Done != nullptr && xTaskCreate(PowerMeterHttpJson::fetchLoopHelper,
+                "PM:HTTP+JSON", _taskStackSize, &job, 1/*prio*/, &job.TaskHandle) == pdPASS) {
+        return;
+    }
 
-        _lastPoll = millis();
+    // the value is requested by the polling task instead
+    MessageOutput.printf("[PowerMeterHttpJson] failed to start worker for value %d\r\n", job.Index + 1);
+    if (job.Done != nullptr) {
+        vSemaphoreDelete(job.Done);
+        job.Done = nullptr;
+    }
+    job.TaskHandle = nullptr;
+}
 
-        lock.unlock(); // polling can take quite some time
-        auto res = poll();
-        lock.lock();
+void PowerMeterHttpJson::stopWorkers()
+{
+    for (auto& job : _jobs) {
+        if (job.TaskHandle == nullptr) { continue; }
+
+        job.StopTask = true;
+        xTaskNotifyGive(job.TaskHandle);
+        xSemaphoreTake(job.Done, portMAX_DELAY);
+        vSemaphoreDelete(job.Done);
+        job.Done = nullptr;
+        job.TaskHandle = nullptr;
+    }
+}
 
-        if (std::holds_alternative<String>(res)) {
-            MessageOutput.printf("[PowerMeterHttpJson] %s\r\n", std::get<String>(res).c_str());
-            continue;
-        }
+String PowerMeterHttpJson::fetch(uint8_t idx, JsonDocument& response)
+{
+    auto const& upGetter = _httpGetters[idx];
+
+    auto res = upGetter->performGetRequest();
+    if (!res) {
+        return upGetter->getErrorText();
+    }
 
-        MessageOutput.printf("[PowerMeterHttpJson] New total: %.2f\r\n", getPowerTotal());
+    auto pStream = res.getStream();
+    if (!pStream) {
+        return "Programmer error: HTTP request yields no stream";
+    }
 
-        gotUpdate();
+    const DeserializationError error = deserializeJson(response, *pStream,
+            DeserializationOption::Filter(_jsonFilters[idx]));
+    if (error) {
+        return String("Unable to parse server response as JSON: ") + error.c_str();
     }
+
+    return "";
 }
 
 PowerMeterHttpJson::poll_result_t PowerMeterHttpJson::poll()
 {
     power_values_t cache;
-    JsonDocument jsonResponse;
+    std::array<bool, POWERMETER_HTTP_JSON_MAX_VALUES> pending = {};
 
     auto prefixedError = [](uint8_t idx, char const* err) -> String {
         String res("Value ");
@@ -114,6 +176,30 @@ PowerMeterHttpJson::poll_result_t PowerMeterHttpJson::poll()
         return res + String(idx + 1) + ": " + err;
     };
 
+    // individual requests are performed concurrently, such that the values
+    // are sampled at about the same time and the latency of a sample set is
+    // the one of the slowest request rather than the sum of all requests.
+    // the first value is requested by this task while the others are pending.
+    for (uint8_t i = 1; i < POWERMETER_HTTP_JSON_MAX_VALUES; i++) {
+        if (!_cfg.Values[i].Enabled || _jobs[i].TaskHandle == nullptr) { continue; }
+        xTaskNotifyGive(_jobs[i].TaskHandle);
+        pending[i] = true;
+    }
+
+    if (_cfg.Values[0].Enabled) {
+        _jobs[0].Error = fetch(0, _jobs[0].Response);
+    }
+
+    for (uint8_t i = 1; i < POWERMETER_HTTP_JSON_MAX_VALUES; i++) {
+        auto& job = _jobs[i];
+        if (pending[i]) {
+            xSemaphoreTake(job.Done, portMAX_DELAY);
+        } else if (_cfg.Values[i].Enabled && _httpGetters[i]) {
+            // there is no worker for this value
+            job.Error = fetch(i, job.Response);
+        }
+    }
+
     for (uint8_t i = 0; i < POWERMETER_HTTP_JSON_MAX_VALUES; i++) {
         auto const& cfg = _cfg.Values[i];
 
@@ -122,27 +208,13 @@ PowerMeterHttpJson::poll_result_t PowerMeterHttpJson::poll()
             continue;
         }
 
-        auto const& upGetter = _httpGetters[i];
-
-        if (upGetter) {
-            auto res = upGetter->performGetRequest();
-            if (!res) {
-                return prefixedError(i, upGetter->getErrorText());
-            }
-
-            auto pStream = res.getStream();
-            if (!pStream) {
-                return prefixedError(i, "Programmer error: HTTP request yields no stream");
-            }
-
-            const DeserializationError error = deserializeJson(jsonResponse, *pStream);
-            if (error) {
-                String msg("Unable to parse server response as JSON: ");
-                return prefixedError(i, String(msg + error.c_str()).c_str());
-            }
+        // values without an individual request use the first response
+        auto const& job = _httpGetters[i] ? _jobs[i] : _jobs[0];
+        if (!job.Error.isEmpty()) {
+            return prefixedError(job.Index, job.Error.c_str());
         }
 
-        auto pathResolutionResult = Utils::getJsonValueByPath<float>(jsonResponse, cfg.JsonPath);
+        auto pathResolutionResult = Utils::getJsonValueByPath<float>(job.Response, cfg.JsonPath);
         if (!pathResolutionResult.second.isEmpty()) {
             return prefixedError(i, pathResolutionResult.second.c_str());
         }
@@ -177,10 +249,28 @@ float PowerMeterHttpJson::getPowerTotal() const
     return sum;
 }
 
+// a value per phase is expected if all values are enabled
+std::optional<PowerMeterProvider::phase_values_t> PowerMeterHttpJson::getPowerPhases() const
+{
+    static_assert(POWERMETER_HTTP_JSON_MAX_VALUES == 3);
+    for (auto const& value : _cfg.Values) {
+        if (!value.Enabled) { return std::nullopt; }
+    }
+
+    std::unique_lock<std::mutex> lock(_valueMutex);
+    return _powerValues;
+}
+
 bool PowerMeterHttpJson::isDataValid() const
 {
     uint32_t age = millis() - getLastUpdate();
-    return getLastUpdate() > 0 && (age < (3 * _cfg.PollingInterval * 1000));
+    return getLastUpdate() > 0 && (age < (3 * getPollingIntervalMillis(_cfg.PollingInterval)));
+}
+
+void PowerMeterHttpJson::setStandby(bool standby)
+{
+    PowerMeterProvider::setStandby(standby);
+    HttpPoller.reschedule(); // applies the polling interval right away
 }
 
 void PowerMeterHttpJson::doMqttPublish() const
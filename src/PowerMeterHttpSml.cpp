@@ -7,18 +7,7 @@
 
 PowerMeterHttpSml::~PowerMeterHttpSml()
 {
-    _taskDone = false;
-
-    std::unique_lock<std::mutex> lock(_pollingMutex);
-    _stopPolling = true;
-    lock.unlock();
-
-    _cv.notify_all();
-
-    if (_taskHandle != nullptr) {
-        while (!_taskDone) { delay(10); }
-        _taskHandle = nullptr;
-    }
+    if (_pollerJob != 0) { HttpPoller.remove(_pollerJob); }
 }
 
 bool PowerMeterHttpSml::init()
@@ -37,58 +26,38 @@ bool PowerMeterHttpSml::init()
 
 void PowerMeterHttpSml::loop()
 {
-    if (_taskHandle != nullptr) { return; }
-
-    std::unique_lock<std::mutex> lock(_pollingMutex);
-    _stopPolling = false;
-    lock.unlock();
+    if (_pollerJob != 0) { return; }
 
-    uint32_t constexpr stackSize = 3072;
-    xTaskCreate(PowerMeterHttpSml::pollingLoopHelper, "PM:HTTP+SML",
-            stackSize, this, 1/*prio*/, &_taskHandle);
+    _pollerJob = HttpPoller.add({
+        [this] { return getPollingIntervalMillis(_cfg.PollingInterval); },
+        [this] { return pollAndPublish(); },
+        [this] { if (_upHttpGetter) { _upHttpGetter->prewarm(); } }
+    });
 }
 
-void PowerMeterHttpSml::pollingLoopHelper(void* context)
+bool PowerMeterHttpSml::pollAndPublish()
 {
-    auto pInstance = static_cast<PowerMeterHttpSml*>(context);
-    pInstance->pollingLoop();
-    pInstance->_taskDone = true;
-    vTaskDelete(nullptr);
-}
+    auto res = poll();
 
-void PowerMeterHttpSml::pollingLoop()
-{
-    std::unique_lock<std::mutex> lock(_pollingMutex);
-
-    while (!_stopPolling) {
-        auto elapsedMillis = millis() - _lastPoll;
-        auto intervalMillis = _cfg.PollingInterval * 1000;
-        if (_lastPoll > 0 && elapsedMillis < intervalMillis) {
-            auto sleepMs = intervalMillis - elapsedMillis;
-            _cv.wait_for(lock, std::chrono::milliseconds(sleepMs),
-                    [this] { return _stopPolling; }); // releases the mutex
-            continue;
-        }
-
-        _lastPoll = millis();
-
-        lock.unlock(); // polling can take quite some time
-        auto res = poll();
-        lock.lock();
-
-        if (!res.isEmpty()) {
-            MessageOutput.printf("[PowerMeterHttpSml] %s\r\n", res.c_str());
-            continue;
-        }
-
-        gotUpdate();
+    if (!res.isEmpty()) {
+        MessageOutput.printf("[PowerMeterHttpSml] %s\r\n", res.c_str());
+        return false;
     }
+
+    gotUpdate();
+    return true;
 }
 
 bool PowerMeterHttpSml::isDataValid() const
 {
     uint32_t age = millis() - getLastUpdate();
-    return getLastUpdate() > 0 && (age < (3 * _cfg.PollingInterval * 1000));
+    return getLastUpdate() > 0 && (age < (3 * getPollingIntervalMillis(_cfg.PollingInterval)));
+}
+
+void PowerMeterHttpSml::setStandby(bool standby)
+{
+    PowerMeterProvider::setStandby(standby);
+    HttpPoller.reschedule(); // applies the polling interval right away
 }
 
 String PowerMeterHttpSml::poll()
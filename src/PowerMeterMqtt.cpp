@@ -2,27 +2,27 @@
 #include "PowerMeterMqtt.h"
 #include "MqttSettings.h"
 #include "MessageOutput.h"
-#include "ArduinoJson.h"
-#include "Utils.h"
 
 bool PowerMeterMqtt::init()
 {
-    auto subscribe = [this](PowerMeterMqttValue const& val, float* targetVariable) {
-        *targetVariable = 0;
+    auto subscribe = [this](size_t valueIndex) {
+        auto const& val = _cfg.Values[valueIndex];
+        _powerValues[valueIndex] = 0;
         char const* topic = val.Topic;
         if (strlen(topic) == 0) { return; }
+        _jsonPaths[valueIndex] = JsonPath(val.JsonPath);
         MqttSettings.subscribe(topic, 0,
                 std::bind(&PowerMeterMqtt::onMessage,
                     this, std::placeholders::_1, std::placeholders::_2,
                     std::placeholders::_3, std::placeholders::_4,
                     std::placeholders::_5, std::placeholders::_6,
-                    targetVariable, &val)
+                    valueIndex)
                 );
         _mqttSubscriptions.push_back(topic);
     };
 
     for (size_t i = 0; i < _powerValues.size(); ++i) {
-        subscribe(_cfg.Values[i], &_powerValues[i]);
+        subscribe(i);
     }
 
     return _mqttSubscriptions.size() > 0;
@@ -36,15 +36,30 @@ PowerMeterMqtt::~PowerMeterMqtt()
 
 void PowerMeterMqtt::onMessage(PowerMeterMqtt::MsgProperties const& properties,
         char const* topic, uint8_t const* payload, size_t len, size_t index,
-        size_t total, float* targetVariable, PowerMeterMqttValue const* cfg)
+        size_t total, size_t valueIndex)
 {
-    auto extracted = Utils::getNumericValueFromMqttPayload<float>("PowerMeterMqtt",
-            std::string(reinterpret_cast<const char*>(payload), len), topic,
-            cfg->JsonPath);
+    // MQTT 3.1.1 does not convey when the broker received a message, so
+    // the reading is timestamped as soon as it reaches us, before decoding.
+    uint32_t receivedMillis = millis();
+    uint32_t decodeStart = micros();
 
-    if (!extracted.has_value()) { return; }
+    // fragments of large messages are not reassembled
+    if (index != 0 || len != total) { return; }
 
-    float newValue = *extracted;
+    auto const* cfg = &_cfg.Values[valueIndex];
+
+    auto extracted = _jsonPaths[valueIndex].getFloat(
+            reinterpret_cast<char const*>(payload), len);
+
+    if (!extracted.second.isEmpty()) {
+        MessageOutput.printf("[PowerMeterMqtt] Topic '%s': %s\r\n",
+                topic, extracted.second.c_str());
+        return;
+    }
+
+    addDecodeDuration(micros() - decodeStart);
+
+    float newValue = extracted.first;
 
     using Unit_t = PowerMeterMqttValue::Unit;
     switch (cfg->PowerUnit) {
@@ -62,7 +77,7 @@ void PowerMeterMqtt::onMessage(PowerMeterMqtt::MsgProperties const& properties,
 
     {
         std::lock_guard<std::mutex> l(_mutex);
-        *targetVariable = newValue;
+        _powerValues[valueIndex] = newValue;
     }
 
     if (_verboseLogging) {
@@ -70,7 +85,7 @@ void PowerMeterMqtt::onMessage(PowerMeterMqtt::MsgProperties const& properties,
                 "total: %5.2f\r\n", topic, newValue, getPowerTotal());
     }
 
-    gotUpdate();
+    gotUpdate(receivedMillis);
 }
 
 float PowerMeterMqtt::getPowerTotal() const
@@ -80,3 +95,15 @@ float PowerMeterMqtt::getPowerTotal() const
     for (auto v: _powerValues) { sum += v; }
     return sum;
 }
+
+// a value per phase is expected if a topic is set for every value
+std::optional<PowerMeterProvider::phase_values_t> PowerMeterMqtt::getPowerPhases() const
+{
+    static_assert(POWERMETER_MQTT_MAX_VALUES == 3);
+    for (auto const& value : _cfg.Values) {
+        if (strlen(value.Topic) == 0) { return std::nullopt; }
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _powerValues;
+}
@@ -1,17 +1,84 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include "PowerMeterProvider.h"
+#include "EventBus.h"
 #include "MqttSettings.h"
+#include <algorithm>
+#include <cmath>
 
 bool PowerMeterProvider::isDataValid() const
 {
     return _lastUpdate > 0 && ((millis() - _lastUpdate) < (30 * 1000));
 }
 
+bool PowerMeterProvider::isStale() const
+{
+    if (!isDataValid()) { return true; }
+
+    uint32_t interval;
+    {
+        std::lock_guard<std::mutex> l(_metricsMutex);
+        interval = _lastInterval;
+    }
+
+    // the sample interval is not known before the second reading
+    if (interval == 0) { return false; }
+
+    return (millis() - _lastUpdate) > std::max<uint32_t>(2 * interval, 1000);
+}
+
+void PowerMeterProvider::gotUpdate(uint32_t receivedMillis)
+{
+    _filter.addSample(getPowerTotal());
+
+    {
+        std::lock_guard<std::mutex> l(_metricsMutex);
+
+        // the jitter is estimated like RFC 3550 does for RTP packets
+        uint32_t previous = _lastUpdate;
+        if (previous > 0) {
+            uint32_t interval = receivedMillis - previous;
+            if (_lastInterval > 0) {
+                float deviation = std::abs(static_cast<float>(interval) - _lastInterval);
+                _metrics.JitterMs += (deviation - _metrics.JitterMs) / 16;
+            }
+            _lastInterval = interval;
+        }
+        ++_metrics.Samples;
+    }
+
+    _lastUpdate = receivedMillis;
+    EventBus.publish(Events::MeterSample{ getPowerTotal(), receivedMillis });
+}
+
+void PowerMeterProvider::addDecodeDuration(uint32_t micros)
+{
+    std::lock_guard<std::mutex> l(_metricsMutex);
+    if (_metrics.DecodeMicros == 0) {
+        _metrics.DecodeMicros = micros;
+    } else {
+        _metrics.DecodeMicros += (micros - _metrics.DecodeMicros) / 16;
+    }
+    _metrics.DecodeMicrosMax = std::max(_metrics.DecodeMicrosMax, micros);
+}
+
+PowerMeterProvider::Metrics PowerMeterProvider::getMetrics() const
+{
+    std::lock_guard<std::mutex> l(_metricsMutex);
+    return _metrics;
+}
+
 void PowerMeterProvider::mqttPublish(String const& topic, float const& value) const
 {
     MqttSettings.publish("powermeter/" + topic, String(value));
 }
 
+void PowerMeterProvider::mqttPublish(String const& topic, Measurement const& value) const
+{
+    char text[Measurement::MaxTextSize];
+    value.format(text, sizeof(text));
+    MqttSettings.publish("powermeter/" + topic, text);
+}
+
 void PowerMeterProvider::mqttLoop() const
 {
     if (!MqttSettings.getConnected()) { return; }
@@ -23,6 +90,11 @@ void PowerMeterProvider::mqttLoop() const
 
     mqttPublish("powertotal", getPowerTotal());
 
+    auto const& cfg = Configuration.get().PowerMeter.Filter;
+    if (cfg.FilterMode != PowerMeterFilterConfig::Mode::None) {
+        mqttPublish("powertotal_filtered", getPowerTotalFiltered());
+    }
+
     doMqttPublish();
 
     _lastMqttPublish = millis();
@@ -2,6 +2,21 @@
 #include "PowerMeterSerialSdm.h"
 #include "PinMapping.h"
 #include "MessageOutput.h"
+#include <algorithm>
+#include <array>
+
+PowerMeterSerialSdm::PowerMeterSerialSdm(Phases phases, PowerMeterSerialSdmConfig const& cfg)
+    : _phases(phases)
+    , _cfg(cfg)
+{
+    _devices.push_back({ static_cast<uint8_t>(_cfg.Address), _phases == Phases::Three, 1.0f, 1 });
+
+    for (auto const& subMeter : _cfg.SubMeters) {
+        if (subMeter.Address == 0) { continue; }
+        _devices.push_back({ subMeter.Address, subMeter.ThreePhases,
+                subMeter.Subtract ? -1.0f : 1.0f, std::max<uint8_t>(subMeter.PollDivider, 1) });
+    }
+}
 
 PowerMeterSerialSdm::~PowerMeterSerialSdm()
 {
@@ -40,16 +55,29 @@ bool PowerMeterSerialSdm::init()
     _upSdmSerial = std::make_unique<SoftwareSerial>();
 
     if (pin.powermeter_rxen > -1 && pin.powermeter_txen > -1) {
-        _upSdm = std::make_unique<SDM>(*_upSdmSerial, 9600, pin.powermeter_rxen, pin.powermeter_txen,
+        _upSdm = std::make_unique<SDM>(*_upSdmSerial, _baud, pin.powermeter_rxen, pin.powermeter_txen,
             SWSERIAL_8N1, pin.powermeter_rx, pin.powermeter_tx);
     }
     else {
-        _upSdm = std::make_unique<SDM>(*_upSdmSerial, 9600, pin.powermeter_dere,
+        _upSdm = std::make_unique<SDM>(*_upSdmSerial, _baud, pin.powermeter_dere,
             SWSERIAL_8N1, pin.powermeter_rx, pin.powermeter_tx);
     }
 
     _upSdm->begin();
 
+    // Modbus RTU requires the bus to be silent for 3.5 characters (of 11
+    // bits) between frames, which is how long the library waits for stray
+    // bytes after each reply. its default of 10 ms is overly long at 9600
+    // baud and would add up with several devices on the bus. one more
+    // millisecond accounts for the granularity of millis().
+    uint32_t interFrameMillis = (35 * 11 * 1000 + 10 * _baud - 1) / (10 * _baud);
+    _upSdm->setMsTimeout(interFrameMillis + 1);
+
+    if (_devices.size() > 1) {
+        MessageOutput.printf("[PowerMeterSerialSdm] polling %u sub-meter(s) on the same bus\r\n",
+                static_cast<unsigned>(_devices.size() - 1));
+    }
+
     return true;
 }
 
@@ -69,28 +97,66 @@ void PowerMeterSerialSdm::loop()
 float PowerMeterSerialSdm::getPowerTotal() const
 {
     std::lock_guard<std::mutex> l(_valueMutex);
-    return _phase1Power + _phase2Power + _phase3Power;
+    float total = 0.0;
+    for (auto const& device : _devices) {
+        total += device.Sign * (device.Power[0] + device.Power[1] + device.Power[2]);
+    }
+    return total;
+}
+
+std::optional<PowerMeterProvider::phase_values_t> PowerMeterSerialSdm::getPowerPhases() const
+{
+    std::lock_guard<std::mutex> l(_valueMutex);
+
+    // the phase a single-phase sub-meter is connected to is unknown
+    phase_values_t phases = {};
+    for (auto const& device : _devices) {
+        if (!device.ThreePhases) { return std::nullopt; }
+        for (size_t p = 0; p < phases.size(); ++p) {
+            phases[p] += device.Sign * device.Power[p];
+        }
+    }
+    return phases;
 }
 
 bool PowerMeterSerialSdm::isDataValid() const
 {
+    uint32_t intervalMillis = 3 * getPollingIntervalMillis(_cfg.PollingInterval);
     uint32_t age = millis() - getLastUpdate();
-    return getLastUpdate() > 0 && (age < (3 * _cfg.PollingInterval * 1000));
+    if (getLastUpdate() == 0 || age >= intervalMillis) { return false; }
+
+    std::lock_guard<std::mutex> l(_valueMutex);
+    for (size_t i = 1; i < _devices.size(); ++i) {
+        auto const& device = _devices[i];
+        if (device.LastUpdate == 0) { return false; }
+        if (millis() - device.LastUpdate >= intervalMillis * device.PollDivider) { return false; }
+    }
+    return true;
+}
+
+void PowerMeterSerialSdm::setStandby(bool standby)
+{
+    {
+        std::lock_guard<std::mutex> lock(_pollingMutex);
+        PowerMeterProvider::setStandby(standby);
+    }
+    _cv.notify_all(); // applies the polling interval right away
 }
 
 void PowerMeterSerialSdm::doMqttPublish() const
 {
     std::lock_guard<std::mutex> l(_valueMutex);
-    mqttPublish("power1", _phase1Power);
-    mqttPublish("voltage1", _phase1Voltage);
+    auto const& grid = _devices.front();
+    mqttPublish("power1", grid.Power[0]);
+    mqttPublish("voltage1", grid.Voltage[0]);
     mqttPublish("import", _energyImport);
     mqttPublish("export", _energyExport);
 
     if (_phases == Phases::Three) {
-        mqttPublish("power2", _phase2Power);
-        mqttPublish("power3", _phase3Power);
-        mqttPublish("voltage2", _phase2Voltage);
-        mqttPublish("voltage3", _phase3Voltage);
+        mqttPublish("power2", grid.Power[1]);
+        mqttPublish("power3", grid.Power[2]);
+        mqttPublish("voltage2", grid.Voltage[1]);
+        mqttPublish("voltage3", grid.Voltage[2]);
     }
 }
 
@@ -102,10 +168,11 @@ void PowerMeterSerialSdm::pollingLoopHelper(void* context)
     vTaskDelete(nullptr);
 }
 
-bool PowerMeterSerialSdm::readValue(std::unique_lock<std::mutex>& lock, uint16_t reg, float& targetVar)
+bool PowerMeterSerialSdm::readValues(std::unique_lock<std::mutex>& lock, Device& device, uint16_t reg, uint8_t count, float* targets)
 {
     lock.unlock(); // reading values takes too long to keep holding the lock
-    float val = _upSdm->readVal(reg, _cfg.Address);
+    auto err = _upSdm->readVals(reg, count, targets, device.Address);
+    _upSdm->clearErrCode();
     lock.lock();
 
     // we additionally check in between each transaction whether or not we are
@@ -113,18 +180,23 @@ bool PowerMeterSerialSdm::readValue(std::unique_lock<std::mutex>& lock, uint16_t
     // this instance might need to wait for a whole while until the task ends.
     if (_stopPolling) { return false; }
 
-    auto err = _upSdm->getErrCode(true/*clear error code*/);
-
     switch (err) {
         case SDM_ERR_NO_ERROR:
             if (_verboseLogging) {
-                MessageOutput.printf("[PowerMeterSerialSdm]: read register %d "
-                        "(0x%04x) successfully\r\n", reg, reg);
+                MessageOutput.printf("[PowerMeterSerialSdm]: read %d value(s) "
+                        "from register %d (0x%04x) of device %u successfully\r\n", count, reg, reg, device.Address);
             }
-
-            targetVar = val;
             return true;
             break;
+        case SDM_ERR_ILLEGAL_FUNCTION:
+        case SDM_ERR_ILLEGAL_DATA_ADDRESS:
+            MessageOutput.printf("[PowerMeterSerialSdm]: meter rejected reading "
+                    "%d value(s) from register %d (0x%04x)\r\n", count, reg, reg);
+            if (count > 1) {
+                MessageOutput.println("[PowerMeterSerialSdm]: reading registers individually from now on");
+                device.BatchReads = false;
+            }
+            break;
         case SDM_ERR_CRC_ERROR:
             MessageOutput.printf("[PowerMeterSerialSdm]: CRC error "
                     "while reading register %d (0x%04x)\r\n", reg, reg);
@@ -139,7 +211,7 @@ bool PowerMeterSerialSdm::readValue(std::unique_lock<std::mutex>& lock, uint16_t
             break;
         case SDM_ERR_TIMEOUT:
             MessageOutput.printf("[PowerMeterSerialSdm]: timeout occured "
-                    "while reading register %d (0x%04x)\r\n", reg, reg);
+                    "while reading register %d (0x%04x) of device %u\r\n", reg, reg, device.Address);
             break;
         default:
             MessageOutput.printf("[PowerMeterSerialSdm]: unknown SDM error "
@@ -150,62 +222,141 @@ bool PowerMeterSerialSdm::readValue(std::unique_lock<std::mutex>& lock, uint16_t
     return false;
 }
 
+bool PowerMeterSerialSdm::readPowerValues(std::unique_lock<std::mutex>& lock, Device& device)
+{
+    // reading takes a "very long" time as each request is a synchronous
+    // exchange of serial messages. cache the values and write later to
+    // enforce consistent values.
+    std::array<float, 3> power = {};
+    std::array<float, 3> voltage = {};
+
+    bool success = false;
+
+    if (device.BatchReads) {
+        // voltages, currents and powers of all phases are consecutive input
+        // registers, so all of them are fetched using a single request.
+        std::array<float, 9> values = {};
+        uint8_t count = device.ThreePhases ? 9 : 7;
+        success = readValues(lock, device, SDM_PHASE_1_VOLTAGE, count, values.data());
+
+        // fall back to individual requests right away if the meter does not
+        // support reading several registers at once.
+        if (!success && device.BatchReads) { return false; }
+
+        auto value = [&values](uint16_t reg) { return values[(reg - SDM_PHASE_1_VOLTAGE) / 2]; };
+        if (success) {
+            voltage[0] = value(SDM_PHASE_1_VOLTAGE);
+            power[0] = value(SDM_PHASE_1_POWER);
+        }
+        if (success && device.ThreePhases) {
+            voltage[1] = value(SDM_PHASE_2_VOLTAGE);
+            voltage[2] = value(SDM_PHASE_3_VOLTAGE);
+            power[1] = value(SDM_PHASE_2_POWER);
+            power[2] = value(SDM_PHASE_3_POWER);
+        }
+    }
+
+    if (!success) {
+        success = readValue(lock, device, SDM_PHASE_1_POWER, power[0]) &&
+            readValue(lock, device, SDM_PHASE_1_VOLTAGE, voltage[0]);
+
+        if (success && device.ThreePhases) {
+            success = readValue(lock, device, SDM_PHASE_2_POWER, power[1]) &&
+                readValue(lock, device, SDM_PHASE_3_POWER, power[2]) &&
+                readValue(lock, device, SDM_PHASE_2_VOLTAGE, voltage[1]) &&
+                readValue(lock, device, SDM_PHASE_3_VOLTAGE, voltage[2]);
+        }
+    }
+
+    if (!success) { return false; }
+
+    std::lock_guard<std::mutex> l(_valueMutex);
+    device.Power = power;
+    device.Voltage = voltage;
+    device.LastUpdate = millis();
+    return true;
+}
+
+bool PowerMeterSerialSdm::readEnergyValues(std::unique_lock<std::mutex>& lock)
+{
+    auto& grid = _devices.front();
+    std::array<float, 2> values = {};
+
+    bool success = false;
+    if (grid.BatchReads) {
+        // import and export counters are consecutive input registers
+        success = readValues(lock, grid, SDM_IMPORT_ACTIVE_ENERGY, values.size(), values.data());
+        if (!success && grid.BatchReads) { return false; }
+    }
+
+    if (!success) {
+        success = readValue(lock, grid, SDM_IMPORT_ACTIVE_ENERGY, values[0]) &&
+            readValue(lock, grid, SDM_EXPORT_ACTIVE_ENERGY, values[1]);
+    }
+
+    if (!success) { return false; }
+
+    std::lock_guard<std::mutex> l(_valueMutex);
+    _energyImport = values[0];
+    _energyExport = values[1];
+    return true;
+}
+
+// reads the sub-meters due in this poll of the grid meter
+void PowerMeterSerialSdm::pollSubMeters(std::unique_lock<std::mutex>& lock)
+{
+    for (size_t i = 1; i < _devices.size() && !_stopPolling; ++i) {
+        auto& device = _devices[i];
+        if (device.SkipPolls > 0) {
+            device.SkipPolls--;
+            continue;
+        }
+
+        if (readPowerValues(lock, device)) {
+            device.Failures = 0;
+        } else if (device.Failures < UINT8_MAX) {
+            device.Failures++;
+        }
+
+        // a sub-meter which does not reply stalls the bus until the
+        // request times out, delaying the grid meter's next reading.
+        uint8_t factor = (device.Failures >= _failuresUntilBackoff) ? _backoffFactor : 1;
+        device.SkipPolls = std::min<uint32_t>(device.PollDivider * factor, UINT8_MAX) - 1;
+    }
+}
+
 void PowerMeterSerialSdm::pollingLoop()
 {
     std::unique_lock<std::mutex> lock(_pollingMutex);
 
     while (!_stopPolling) {
         auto elapsedMillis = millis() - _lastPoll;
-        auto intervalMillis = _cfg.PollingInterval * 1000;
+        auto intervalMillis = getPollingIntervalMillis(_cfg.PollingInterval);
         if (_lastPoll > 0 && elapsedMillis < intervalMillis) {
             auto sleepMs = intervalMillis - elapsedMillis;
+            bool standby = _standby;
             _cv.wait_for(lock, std::chrono::milliseconds(sleepMs),
-                    [this] { return _stopPolling; }); // releases the mutex
+                    [this, standby] { return _stopPolling || _standby != standby; }); // releases the mutex
             continue;
         }
 
         _lastPoll = millis();
 
-        // reading takes a "very long" time as each readVal() is a synchronous
-        // exchange of serial messages. cache the values and write later to
-        // enforce consistent values.
-        float phase1Power = 0.0;
-        float phase2Power = 0.0;
-        float phase3Power = 0.0;
-        float phase1Voltage = 0.0;
-        float phase2Voltage = 0.0;
-        float phase3Voltage = 0.0;
-        float energyImport = 0.0;
-        float energyExport = 0.0;
-
-        bool success = readValue(lock, SDM_PHASE_1_POWER, phase1Power) &&
-            readValue(lock, SDM_PHASE_1_VOLTAGE, phase1Voltage) &&
-            readValue(lock, SDM_IMPORT_ACTIVE_ENERGY, energyImport) &&
-            readValue(lock, SDM_EXPORT_ACTIVE_ENERGY, energyExport);
-
-        if (success && _phases == Phases::Three) {
-            success = readValue(lock, SDM_PHASE_2_POWER, phase2Power) &&
-                readValue(lock, SDM_PHASE_3_POWER, phase3Power) &&
-                readValue(lock, SDM_PHASE_2_VOLTAGE, phase2Voltage) &&
-                readValue(lock, SDM_PHASE_3_VOLTAGE, phase3Voltage);
-        }
-
-        if (!success) { continue; }
-
-        {
-            std::lock_guard<std::mutex> l(_valueMutex);
-            _phase1Power = static_cast<float>(phase1Power);
-            _phase2Power = static_cast<float>(phase2Power);
-            _phase3Power = static_cast<float>(phase3Power);
-            _phase1Voltage = static_cast<float>(phase1Voltage);
-            _phase2Voltage = static_cast<float>(phase2Voltage);
-            _phase3Voltage = static_cast<float>(phase3Voltage);
-            _energyImport = static_cast<float>(energyImport);
-            _energyExport = static_cast<float>(energyExport);
+        if (!readPowerValues(lock, _devices.front())) {
+            pollSubMeters(lock);
+            continue;
         }
 
         MessageOutput.printf("[PowerMeterSerialSdm] TotalPower: %5.2f\r\n", getPowerTotal());
 
+        // notify before reading the sub-meters and the energy counters, such
+        // that the DPL can act on the new power values as soon as possible.
         gotUpdate();
+
+        pollSubMeters(lock);
+
+        if (_lastEnergyPoll == 0 || (millis() - _lastEnergyPoll) >= _energyPollIntervalMillis) {
+            if (readEnergyValues(lock)) { _lastEnergyPoll = millis(); }
+        }
     }
 }
@@ -2,6 +2,8 @@
 #include "PowerMeterSerialSml.h"
 #include "PinMapping.h"
 #include "MessageOutput.h"
+#include "SerialPortManager.h"
+#include <esp_intr_alloc.h>
 
 bool PowerMeterSerialSml::init()
 {
@@ -15,20 +17,59 @@ bool PowerMeterSerialSml::init()
         return false;
     }
 
-    pinMode(pin.powermeter_rx, INPUT);
-    _upSmlSerial = std::make_unique<SoftwareSerial>();
-    _upSmlSerial->begin(_baud, SWSERIAL_8N1, pin.powermeter_rx, -1/*tx pin*/,
-            false/*invert*/, _bufCapacity, _isrCapacity);
-    _upSmlSerial->enableRx(true);
-    _upSmlSerial->enableTx(false);
-    _upSmlSerial->flush();
+    auto oHwSerialPort = SerialPortManager.allocatePort(_serialPortOwner, _rxBufferSize);
+    if (!oHwSerialPort) { return false; }
+
+    auto port = static_cast<uart_port_t>(*oHwSerialPort);
+    _oPort = port;
+
+    uart_config_t config = {};
+    config.baud_rate = _baud;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    config.source_clk = UART_SCLK_APB;
+
+    // the receive buffer is filled by the UART ISR, which keeps running
+    // while the flash cache is disabled (e.g., during LittleFS writes) if
+    // it resides in IRAM.
+    int intrFlags = 0;
+#ifdef CONFIG_UART_ISR_IN_IRAM
+    intrFlags = ESP_INTR_FLAG_IRAM;
+#endif
+
+    esp_err_t err = uart_driver_install(port,
+            SerialPortManager.getRxBufferSize(port), 0/*no tx buffer*/,
+            _eventQueueSize, &_uartQueue, intrFlags);
+    if (err == ESP_OK) { err = uart_param_config(port, &config); }
+    if (err == ESP_OK) {
+        err = uart_set_pin(port, UART_PIN_NO_CHANGE, pin.powermeter_rx,
+                UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+
+    // the start and end of an SML datagram is marked by four escape
+    // characters, which raise a pattern event with their position.
+    if (err == ESP_OK) {
+        err = uart_enable_pattern_det_baud_intr(port, _escapeChar,
+                _escapeCount, 9/*chr_tout*/, 0/*post_idle*/, 0/*pre_idle*/);
+    }
+    if (err == ESP_OK) { err = uart_pattern_queue_reset(port, _eventQueueSize); }
+
+    if (err != ESP_OK) {
+        MessageOutput.printf("[PowerMeterSerialSml] cannot set up HW UART "
+                "%d: %s\r\n", port, esp_err_to_name(err));
+        return false;
+    }
+
+    uart_flush_input(port);
 
     return true;
 }
 
 void PowerMeterSerialSml::loop()
 {
-    if (_taskHandle != nullptr) { return; }
+    if (_taskHandle != nullptr || _uartQueue == nullptr) { return; }
 
     std::unique_lock<std::mutex> lock(_pollingMutex);
     _stopPolling = false;
@@ -52,9 +93,11 @@ PowerMeterSerialSml::~PowerMeterSerialSml()
         _taskHandle = nullptr;
     }
 
-    if (_upSmlSerial) {
-        _upSmlSerial->end();
-        _upSmlSerial = nullptr;
+    if (_oPort) {
+        if (uart_is_driver_installed(*_oPort)) { uart_driver_delete(*_oPort); }
+        _uartQueue = nullptr;
+        SerialPortManager.freePort(_serialPortOwner);
+        _oPort = std::nullopt;
     }
 }
 
@@ -66,57 +109,93 @@ void PowerMeterSerialSml::pollingLoopHelper(void* context)
     vTaskDelete(nullptr);
 }
 
-void PowerMeterSerialSml::pollingLoop()
+void PowerMeterSerialSml::readBytes(size_t amount)
 {
-    int lastAvailable = 0;
-    uint32_t gapStartMillis = 0;
-    std::unique_lock<std::mutex> lock(_pollingMutex);
+    uint8_t buf[128];
 
-    while (!_stopPolling) {
-        lock.unlock();
+    while (amount > 0) {
+        int len = uart_read_bytes(*_oPort, buf, std::min(amount, sizeof(buf)), 0);
+        if (len <= 0) { return; }
 
-        // calling available() will decode bytes into the receive buffer and
-        // hence free data from the ISR buffer, so we need to call this rather
-        // frequenly.
-        int nowAvailable = _upSmlSerial->available();
+        SerialPortManager.countRx(*_oPort, len);
+        for (int i = 0; i < len; ++i) { processSmlByte(buf[i]); }
 
-        if (nowAvailable <= 0) {
-            // sleep, but at most until the software serial ISR
-            // buffer is potentially half full with transitions.
-            uint32_t constexpr delayMs = _isrCapacity * 1000 / _baud / 2;
+        amount -= len;
+    }
+}
 
-            delay(delayMs); // this yields so other tasks are scheduled
+// data was lost, so the datagram in progress cannot be trusted
+void PowerMeterSerialSml::recover()
+{
+    MessageOutput.println("[PowerMeterSerialSml] UART receive buffer "
+            "overflow, discarding datagram");
 
-            lock.lock();
-            continue;
-        }
+    uart_flush_input(*_oPort);
+    xQueueReset(_uartQueue);
+    uart_pattern_queue_reset(*_oPort, _eventQueueSize);
+    PowerMeterSml::reset();
+}
 
-        // sleep more if new data arrived in the meantime. process data only
-        // once a SML datagram seems to be complete (no new data arrived while
-        // we slept). this seems to be important as using read() while more
-        // data arrives causes trouble (we are missing bytes).
-        if (nowAvailable > lastAvailable) {
-            lastAvailable = nowAvailable;
-            delay(10);
-            gapStartMillis = millis();
-            lock.lock();
-            continue;
-        }
+void PowerMeterSerialSml::pollingLoop()
+{
+    bool receiving = false;
+    std::unique_lock<std::mutex> lock(_pollingMutex);
 
-        if ((millis() - gapStartMillis) < _datagramGapMillis) {
-            delay(10);
+    while (!_stopPolling) {
+        lock.unlock();
+
+        // the SML parser is reset in the gap between datagrams, making it
+        // resynchronize on the start escape sequence of the next one. the
+        // timeout also bounds the time until we notice being stopped.
+        uart_event_t event;
+        if (xQueueReceive(_uartQueue, &event, pdMS_TO_TICKS(_datagramGapMillis)) != pdTRUE) {
+            if (receiving) { PowerMeterSml::reset(); }
+            receiving = false;
             lock.lock();
             continue;
         }
 
-        while (_upSmlSerial->available() > 0) {
-            processSmlByte(_upSmlSerial->read());
+        switch (event.type) {
+            case UART_DATA:
+                readBytes(event.size);
+                receiving = true;
+                break;
+
+            case UART_PATTERN_DET: {
+                // bytes up to and including the escape sequence are
+                // processed right away, so the datagram is parsed as a
+                // whole as soon as its end sequence is received.
+                int pos = uart_pattern_pop_pos(*_oPort);
+                size_t buffered = 0;
+                uart_get_buffered_data_len(*_oPort, &buffered);
+                readBytes((pos < 0) ? buffered : pos + _escapeCount);
+                receiving = true;
+                break;
+            }
+
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                SerialPortManager.countError(*_oPort, SerialPortManagerClass::Error::Overrun);
+                recover();
+                receiving = false;
+                break;
+
+            case UART_FRAME_ERR:
+                SerialPortManager.countError(*_oPort, SerialPortManagerClass::Error::Framing);
+                break;
+
+            case UART_PARITY_ERR:
+                SerialPortManager.countError(*_oPort, SerialPortManagerClass::Error::Parity);
+                break;
+
+            case UART_BREAK:
+                SerialPortManager.countError(*_oPort, SerialPortManagerClass::Error::Break);
+                break;
+
+            default:
+                break;
         }
 
-        lastAvailable = 0;
-
-        PowerMeterSml::reset();
-
         lock.lock();
     }
 }
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerMeterShelly.h"
+#include "MessageOutput.h"
+#include "WebApi.h"
+#include <Arduino.h>
+
+namespace {
+
+// notifications carry the values in "params", responses to Shelly.GetStatus
+// in "result". the order of the keys matches PowerMeterShelly::Field.
+char const* const fieldKeys[] = {
+    "em:0.total_act_power",
+    "em:0.a_act_power",
+    "em:0.b_act_power",
+    "em:0.c_act_power",
+    "em1:0.act_power",
+    "em1:1.act_power",
+    "em1:2.act_power"
+};
+
+std::vector<String> getPaths()
+{
+    std::vector<String> paths;
+    for (char const* prefix : { "params.", "result." }) {
+        for (auto key : fieldKeys) { paths.push_back(String(prefix) + key); }
+    }
+    return paths;
+}
+
+}; // namespace
+
+PowerMeterShelly::PowerMeterShelly()
+    : _scanner(getPaths())
+{
+    static_assert(sizeof(fieldKeys) / sizeof(fieldKeys[0]) == _fieldCount, "keys do not match the fields");
+}
+
+PowerMeterShelly::~PowerMeterShelly()
+{
+    WebApi.getWsShelly().setHandler(nullptr);
+}
+
+bool PowerMeterShelly::init()
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+    using std::placeholders::_4;
+
+    WebApi.getWsShelly().setHandler(std::bind(&PowerMeterShelly::onChunk, this, _1, _2, _3, _4));
+    return true;
+}
+
+void PowerMeterShelly::loop()
+{
+    uint32_t now = millis();
+    if (now - getLastUpdate() < _statusRequestMillis) { return; }
+    if (now - _lastStatusRequest < _statusRequestMillis) { return; }
+    _lastStatusRequest = now;
+
+    auto request = String("{\"id\":") + String(++_requestId)
+        + ",\"src\":\"opendtu\",\"method\":\"Shelly.GetStatus\"}";
+    WebApi.getWsShelly().send(request);
+}
+
+float PowerMeterShelly::getPowerTotal() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _powerTotal;
+}
+
+std::optional<PowerMeterProvider::phase_values_t> PowerMeterShelly::getPowerPhases() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+
+    auto field = [this](Field f) { return _fields[static_cast<size_t>(f)]; };
+    if (_fieldsMask & (1 << static_cast<size_t>(Field::EmL1))) {
+        return phase_values_t{ field(Field::EmL1), field(Field::EmL2), field(Field::EmL3) };
+    }
+    if (_fieldsMask & (1 << static_cast<size_t>(Field::Em1Channel0))) {
+        return phase_values_t{ field(Field::Em1Channel0), field(Field::Em1Channel1), field(Field::Em1Channel2) };
+    }
+    return std::nullopt;
+}
+
+void PowerMeterShelly::doMqttPublish() const
+{
+    auto oPhases = getPowerPhases();
+    if (!oPhases) { return; }
+    mqttPublish("power1", (*oPhases)[0]);
+    mqttPublish("power2", (*oPhases)[1]);
+    mqttPublish("power3", (*oPhases)[2]);
+}
+
+void PowerMeterShelly::onValue(size_t pathIndex, float value)
+{
+    size_t field = pathIndex % _fieldCount;
+    _received[field] = value;
+    _receivedMask |= 1 << field;
+}
+
+void PowerMeterShelly::onChunk(uint8_t const* data, size_t len, bool first, bool last)
+{
+    uint32_t decodeStart = micros();
+
+    if (first) {
+        _scanner.reset();
+        _receivedMask = 0;
+        _receivedMillis = millis();
+        _decodeMicros = 0;
+    }
+
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    _scanner.feed(reinterpret_cast<char const*>(data), len,
+            std::bind(&PowerMeterShelly::onValue, this, _1, _2));
+
+    _decodeMicros += micros() - decodeStart;
+
+    // other notifications, e.g., of events, do not carry power values
+    if (!last || !_scanner.isComplete() || _receivedMask == 0) { return; }
+
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        for (size_t i = 0; i < _fieldCount; ++i) {
+            if (_receivedMask & (1 << i)) { _fields[i] = _received[i]; }
+        }
+        _fieldsMask |= _receivedMask;
+
+        auto field = [this](Field f) { return _fields[static_cast<size_t>(f)]; };
+        auto has = [this](Field f) { return (_fieldsMask & (1 << static_cast<size_t>(f))) != 0; };
+
+        if (has(Field::EmTotal) || has(Field::EmL1)) {
+            // a notification might only carry the phases which changed
+            bool totalReceived = _receivedMask & (1 << static_cast<size_t>(Field::EmTotal));
+            _powerTotal = totalReceived ? field(Field::EmTotal)
+                : field(Field::EmL1) + field(Field::EmL2) + field(Field::EmL3);
+        } else {
+            _powerTotal = field(Field::Em1Channel0) + field(Field::Em1Channel1) + field(Field::Em1Channel2);
+        }
+    }
+
+    addDecodeDuration(_decodeMicros);
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[PowerMeterShelly] %.1f W\r\n", getPowerTotal());
+    }
+
+    gotUpdate(_receivedMillis);
+}
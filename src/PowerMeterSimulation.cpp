@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#ifdef OPENDTU_DPL_SIMULATION
+
+#include "PowerMeterSimulation.h"
+#include "DplSimulation.h"
+
+void PowerMeterSimulation::loop()
+{
+    float watts = 0;
+    if (!DplSimulation.getMeterReading(watts)) { return; }
+
+    _powerTotal = watts;
+    gotUpdate();
+}
+
+#endif
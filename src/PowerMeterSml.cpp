@@ -1,63 +1,106 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include "PowerMeterSml.h"
 #include "MessageOutput.h"
+#include <frozen/map.h>
 
 float PowerMeterSml::getPowerTotal() const
 {
     std::lock_guard<std::mutex> l(_mutex);
-    if (_values.activePowerTotal.has_value()) { return *_values.activePowerTotal; }
-    return 0;
+    return _values.get(Field::ActivePowerTotal).value_or(0);
+}
+
+std::optional<PowerMeterProvider::phase_values_t> PowerMeterSml::getPowerPhases() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto l1 = _values.get(Field::ActivePowerL1);
+    auto l2 = _values.get(Field::ActivePowerL2);
+    auto l3 = _values.get(Field::ActivePowerL3);
+    if (!l1 || !l2 || !l3) { return std::nullopt; }
+    return phase_values_t { *l1, *l2, *l3 };
 }
 
 void PowerMeterSml::doMqttPublish() const
 {
-#define PUB(t, m) \
-    if (_values.m.has_value()) { mqttPublish(t, *_values.m); }
+#define PUB(t, f) \
+    if (auto value = _values.getMeasurement(Field::f)) { mqttPublish(t, *value); }
 
     std::lock_guard<std::mutex> l(_mutex);
-    PUB("power1", activePowerL1);
-    PUB("power2", activePowerL2);
-    PUB("power3", activePowerL3);
-    PUB("voltage1", voltageL1);
-    PUB("voltage2", voltageL2);
-    PUB("voltage3", voltageL3);
-    PUB("current1", currentL1);
-    PUB("current2", currentL2);
-    PUB("current3", currentL3);
-    PUB("import", energyImport);
-    PUB("export", energyExport);
+    PUB("power1", ActivePowerL1);
+    PUB("power2", ActivePowerL2);
+    PUB("power3", ActivePowerL3);
+    PUB("voltage1", VoltageL1);
+    PUB("voltage2", VoltageL2);
+    PUB("voltage3", VoltageL3);
+    PUB("current1", CurrentL1);
+    PUB("current2", CurrentL2);
+    PUB("current3", CurrentL3);
+    PUB("import", EnergyImport);
+    PUB("export", EnergyExport);
 
 #undef PUB
 }
 
+PowerMeterSml::OBISHandler const* PowerMeterSml::findHandler(uint64_t obis)
+{
+    static constexpr frozen::map<uint64_t, OBISHandler, 12> handlers = {
+        { 0x0100100700ff, { Field::ActivePowerTotal, SML_WATT, "active power total" } },
+        { 0x0100240700ff, { Field::ActivePowerL1, SML_WATT, "active power L1" } },
+        { 0x0100380700ff, { Field::ActivePowerL2, SML_WATT, "active power L2" } },
+        { 0x01004c0700ff, { Field::ActivePowerL3, SML_WATT, "active power L3" } },
+        { 0x0100200700ff, { Field::VoltageL1, SML_VOLT, "voltage L1" } },
+        { 0x0100340700ff, { Field::VoltageL2, SML_VOLT, "voltage L2" } },
+        { 0x0100480700ff, { Field::VoltageL3, SML_VOLT, "voltage L3" } },
+        { 0x01001f0700ff, { Field::CurrentL1, SML_AMPERE, "current L1" } },
+        { 0x0100330700ff, { Field::CurrentL2, SML_AMPERE, "current L2" } },
+        { 0x0100470700ff, { Field::CurrentL3, SML_AMPERE, "current L3" } },
+        { 0x0100010800ff, { Field::EnergyImport, SML_WATT_HOUR, "energy import" } },
+        { 0x0100020800ff, { Field::EnergyExport, SML_WATT_HOUR, "energy export" } }
+    };
+
+    auto it = handlers.find(obis);
+    if (it == handlers.end()) { return nullptr; }
+    return &it->second;
+}
+
 void PowerMeterSml::reset()
 {
-    smlReset();
-    _cache = { std::nullopt };
+    _parser.reset();
+    _cache.clear();
 }
 
 void PowerMeterSml::processSmlByte(uint8_t byte)
 {
-    switch (smlState(byte)) {
-        case SML_LISTEND:
-            for (auto& handler: smlHandlerList) {
-                if (!smlOBISCheck(handler.OBIS)) { continue; }
+    switch (_parser.state(byte)) {
+        case SML_LISTEND: {
+            uint64_t obis;
+            if (!_parser.getObis(obis)) { break; }
 
-                float helper = 0.0;
-                handler.decoder(helper);
+            auto pHandler = findHandler(obis);
+            if (pHandler == nullptr) { break; }
 
-                if (_verboseLogging) {
-                    MessageOutput.printf("[%s] decoded %s to %.2f\r\n",
-                            _user.c_str(), handler.name, helper);
-                }
+            long long int mantissa = 0;
+            signed char scaler = 0;
+            if (!_parser.getValue(pHandler->unit, mantissa, scaler)) { break; }
 
-                std::lock_guard<std::mutex> l(_mutex);
-                *handler.target = helper;
+            // rescaled right away, the transmitted value may exceed 32 bits
+            auto value = Measurement::fromScaled(mantissa, scaler, _cache.exponent(pHandler->target));
+            if (_verboseLogging) {
+                char text[Measurement::MaxTextSize];
+                value.format(text, sizeof(text));
+                MessageOutput.printf("[%s] decoded %s to %s\r\n",
+                        _user.c_str(), pHandler->name, text);
             }
+
+            std::lock_guard<std::mutex> l(_mutex);
+            _cache.set(pHandler->target, value);
             break;
+        }
         case SML_FINAL:
+            {
+                std::lock_guard<std::mutex> l(_mutex);
+                _values = _cache;
+            }
             gotUpdate();
-            _values = _cache;
             reset();
             MessageOutput.printf("[%s] TotalPower: %5.2f\r\n",
                     _user.c_str(), getPowerTotal());
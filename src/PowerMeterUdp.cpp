@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "PowerMeterUdp.h"
+#include "MessageOutput.h"
+#include <Arduino.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+bool isSeparator(char c)
+{
+    return c == ' ' || c == ',' || c == ';' || c == '&' || c == '\r' || c == '\n' || c == '\t';
+}
+
+// parses a number which is not necessarily followed by a null terminator
+bool parseNumber(char const* begin, char const* end, float& value)
+{
+    char buffer[24];
+    size_t length = end - begin;
+    if (length == 0 || length >= sizeof(buffer)) { return false; }
+
+    memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+
+    char* parsed = nullptr;
+    value = strtof(buffer, &parsed);
+    return parsed == buffer + length && std::isfinite(value);
+}
+
+bool keyEquals(char const* begin, char const* end, char const* key)
+{
+    size_t length = end - begin;
+    return strlen(key) == length && strncasecmp(begin, key, length) == 0;
+}
+
+}; // namespace
+
+PowerMeterUdp::~PowerMeterUdp()
+{
+    _udp.close();
+}
+
+bool PowerMeterUdp::init()
+{
+    if (!_udp.listen(_cfg.Port)) {
+        MessageOutput.printf("[PowerMeterUdp] cannot listen on port %u\r\n", _cfg.Port);
+        return false;
+    }
+
+    _udp.onPacket([this](AsyncUDPPacket& packet) {
+        onPacket(packet.data(), packet.length());
+    });
+
+    return true;
+}
+
+float PowerMeterUdp::getPowerTotal() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _powerTotal;
+}
+
+std::optional<PowerMeterProvider::phase_values_t> PowerMeterUdp::getPowerPhases() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    if (!_phasesValid) { return std::nullopt; }
+    return _powerPhases;
+}
+
+void PowerMeterUdp::doMqttPublish() const
+{
+    auto oPhases = getPowerPhases();
+    if (!oPhases) { return; }
+    mqttPublish("power1", (*oPhases)[0]);
+    mqttPublish("power2", (*oPhases)[1]);
+    mqttPublish("power3", (*oPhases)[2]);
+}
+
+void PowerMeterUdp::onPacket(uint8_t const* buffer, size_t length)
+{
+    uint32_t const receivedMillis = millis();
+    uint32_t const decodeStart = micros();
+
+    Reading reading;
+    bool success = (_cfg.PayloadFormat == PowerMeterUdpConfig::Format::Float32)
+        ? decodeFloat32(buffer, length, reading)
+        : decodeText(reinterpret_cast<char const*>(buffer), length, reading);
+
+    if (!success) {
+        if (_verboseLogging) {
+            MessageOutput.printf("[PowerMeterUdp] cannot decode datagram of %u bytes\r\n", length);
+        }
+        return;
+    }
+
+    // the total is derived from the phases if it is not provided
+    if (!reading.HasTotal) {
+        reading.Total = reading.Phases[0] + reading.Phases[1] + reading.Phases[2];
+    }
+
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _powerTotal = reading.Total;
+        _powerPhases = reading.Phases;
+        _phasesValid = reading.HasPhases;
+    }
+
+    addDecodeDuration(micros() - decodeStart);
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[PowerMeterUdp] %.1f W\r\n", reading.Total);
+    }
+
+    gotUpdate(receivedMillis);
+}
+
+bool PowerMeterUdp::decodeText(char const* text, size_t length, Reading& reading) const
+{
+    char const* end = text + length;
+    char const* pos = text;
+    size_t tokens = 0;
+    bool bare = false;
+
+    while (pos < end) {
+        while (pos < end && (isSeparator(*pos) || *pos == '\0')) { ++pos; }
+        if (pos == end) { break; }
+
+        char const* tokenEnd = pos;
+        while (tokenEnd < end && !isSeparator(*tokenEnd) && *tokenEnd != '\0') { ++tokenEnd; }
+
+        char const* equals = static_cast<char const*>(memchr(pos, '=', tokenEnd - pos));
+        float value;
+
+        // a payload consisting of a single number is the total power
+        if (equals == nullptr) {
+            if (tokens > 0 || !parseNumber(pos, tokenEnd, value)) { return false; }
+            reading.Total = value;
+            reading.HasTotal = true;
+            bare = true;
+        } else if (bare) {
+            return false;
+        } else if (parseNumber(equals + 1, tokenEnd, value)) {
+            if (keyEquals(pos, equals, "power")) {
+                reading.Total = value;
+                reading.HasTotal = true;
+            } else if (keyEquals(pos, equals, "power1")) {
+                reading.Phases[0] = value;
+                reading.HasPhases = true;
+            } else if (keyEquals(pos, equals, "power2")) {
+                reading.Phases[1] = value;
+                reading.HasPhases = true;
+            } else if (keyEquals(pos, equals, "power3")) {
+                reading.Phases[2] = value;
+                reading.HasPhases = true;
+            }
+        }
+
+        tokens++;
+        pos = tokenEnd;
+    }
+
+    return reading.HasTotal || reading.HasPhases;
+}
+
+bool PowerMeterUdp::decodeFloat32(uint8_t const* buffer, size_t length, Reading& reading) const
+{
+    float values[4];
+    if (length != sizeof(float) && length != sizeof(values)) { return false; }
+
+    // the ESP32 is little endian, as is the payload
+    memcpy(values, buffer, length);
+    size_t count = length / sizeof(float);
+    for (size_t i = 0; i < count; ++i) {
+        if (!std::isfinite(values[i])) { return false; }
+    }
+
+    reading.Total = values[0];
+    reading.HasTotal = true;
+
+    if (count == 4) {
+        reading.Phases = { values[1], values[2], values[3] };
+        reading.HasPhases = true;
+    }
+
+    return true;
+}
@@ -4,55 +4,137 @@
  */
 #include "PowerMeterUdpSmaHomeManager.h"
 #include <Arduino.h>
-#include <WiFiUdp.h>
 #include "MessageOutput.h"
 
 static constexpr unsigned int multicastPort = 9522;  // local port to listen on
 static const IPAddress multicastIP(239, 12, 255, 254);
-static WiFiUDP SMAUdp;
 
-constexpr uint32_t interval = 1000;
-
-void PowerMeterUdpSmaHomeManager::Soutput(int kanal, int index, int art, int tarif,
-        char const* name, float value, uint32_t timestamp)
+static uint32_t readUint32(uint8_t const* p)
 {
-    if (!_verboseLogging) { return; }
+    return (p[0] << 24) + (p[1] << 16) + (p[2] << 8) + p[3];
+}
 
+void PowerMeterUdpSmaHomeManager::Soutput(char const* name, float value, uint32_t timestamp) const
+{
     MessageOutput.printf("[PowerMeterUdpSmaHomeManager] %s = %.1f (timestamp %u)\r\n",
             name, value, timestamp);
 }
 
 bool PowerMeterUdpSmaHomeManager::init()
 {
-    SMAUdp.begin(multicastPort);
-    SMAUdp.beginMulticast(multicastIP, multicastPort);
+    if (!_udp.listenMulticast(multicastIP, multicastPort)) {
+        MessageOutput.println("[PowerMeterUdpSmaHomeManager] Failed to join multicast group");
+    }
+
+    _udp.onPacket([this](AsyncUDPPacket& packet) {
+        onPacket(packet.data(), packet.length());
+    });
+
     return true;
 }
 
 PowerMeterUdpSmaHomeManager::~PowerMeterUdpSmaHomeManager()
 {
-    SMAUdp.stop();
+    _udp.close();
+}
+
+float PowerMeterUdpSmaHomeManager::getPowerTotal() const
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _powerMeterPower;
 }
 
 void PowerMeterUdpSmaHomeManager::doMqttPublish() const
 {
+    std::lock_guard<std::mutex> l(_mutex);
     mqttPublish("power1", _powerMeterL1);
     mqttPublish("power2", _powerMeterL2);
     mqttPublish("power3", _powerMeterL3);
 }
 
-uint8_t* PowerMeterUdpSmaHomeManager::decodeGroup(uint8_t* offset, uint16_t grouplen)
+void PowerMeterUdpSmaHomeManager::onPacket(uint8_t const* buffer, size_t length)
 {
-    float Pbezug = 0;
-    float BezugL1 = 0;
-    float BezugL2 = 0;
-    float BezugL3 = 0;
-    float Peinspeisung = 0;
-    float EinspeisungL1 = 0;
-    float EinspeisungL2 = 0;
-    float EinspeisungL3 = 0;
+    if (length < 4 || buffer[0] != 'S' || buffer[1] != 'M' || buffer[2] != 'A') {
+        return;
+    }
+
+    values_t values;
+    uint32_t timestamp = 0;
+    if (!decodeFast(buffer, length, values, timestamp)
+            && !decodeFull(buffer, length, values, timestamp)) {
+        return;
+    }
+
+    auto diff = [&values](Channel import, Channel exp) -> float {
+        auto i = static_cast<float>(values[static_cast<size_t>(import)]);
+        auto e = static_cast<float>(values[static_cast<size_t>(exp)]);
+        return (i - e) * 0.1f;
+    };
+
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _powerMeterPower = diff(Channel::ImportTotal, Channel::ExportTotal);
+        _powerMeterL1 = diff(Channel::ImportL1, Channel::ExportL1);
+        _powerMeterL2 = diff(Channel::ImportL2, Channel::ExportL2);
+        _powerMeterL3 = diff(Channel::ImportL3, Channel::ExportL3);
+        _timestamp = timestamp;
+    }
+
+    gotUpdate();
+}
+
+bool PowerMeterUdpSmaHomeManager::decodeFast(uint8_t const* buffer,
+        size_t length, values_t& values, uint32_t& timestamp) const
+{
+    if (_layout.Length == 0 || length != _layout.Length) { return false; }
+
+    for (size_t c = 0; c < _channelCount; ++c) {
+        auto const& location = _layout.Channels[c];
+        if (readUint32(buffer + location.Offset - 4) != location.Header) { return false; }
+        values[c] = readUint32(buffer + location.Offset);
+    }
+
+    timestamp = readUint32(buffer + _layout.TimestampOffset);
+    return true;
+}
+
+bool PowerMeterUdpSmaHomeManager::decodeFull(uint8_t const* buffer,
+        size_t length, values_t& values, uint32_t& timestamp)
+{
+    Layout layout;
+    size_t found = 0;
+    uint8_t const* end = buffer + length;
+    uint8_t const* offset = buffer + 4; // skips the header 'SMA\0'
+
+    while (offset + 4 <= end) {
+        uint16_t grouplen = (offset[0] << 8) + offset[1];
+        uint16_t grouptag = (offset[2] << 8) + offset[3];
+        offset += 4;
+
+        if (grouplen == 0xffff || grouplen == 0 || offset + grouplen > end) { break; }
+
+        if (grouptag == 0x0010) {
+            decodeGroup(offset, offset + grouplen, buffer, values, timestamp, layout, found);
+        }
+
+        // the tag group (0x02A0) and unknown groups are skipped
+        offset += grouplen;
+    }
 
-    uint8_t* endOfGroup = offset + grouplen;
+    // not a (complete) datagram of an energy meter, e.g., one of an
+    // inverter, which uses the same multicast group.
+    if (found != (1 << _channelCount) - 1) { return false; }
+
+    layout.Length = length;
+    _layout = layout;
+    return true;
+}
+
+void PowerMeterUdpSmaHomeManager::decodeGroup(uint8_t const* offset,
+        uint8_t const* endOfGroup, uint8_t const* buffer, values_t& values,
+        uint32_t& timestamp, Layout& layout, size_t& found)
+{
+    if (offset + 12 > endOfGroup) { return; }
 
     // not used: uint16_t protocolID = (offset[0] << 8) + offset[1];
     offset += 2;
@@ -60,18 +142,19 @@ uint8_t* PowerMeterUdpSmaHomeManager::decodeGroup(uint8_t* offset, uint16_t grou
     // not used: uint16_t susyID = (offset[0] << 8) + offset[1];
     offset += 2;
 
-    _serial = (offset[0] << 24) + (offset[1] << 16) + (offset[2] << 8) + offset[3];
+    _serial = readUint32(offset);
     offset += 4;
 
-    uint32_t timestamp = (offset[0] << 24) + (offset[1] << 16) + (offset[2] << 8) + offset[3];
+    layout.TimestampOffset = offset - buffer;
+    timestamp = readUint32(offset);
     offset += 4;
 
-    unsigned count = 0;
-    while (offset < endOfGroup) {
+    while (offset + 4 <= endOfGroup) {
         uint8_t kanal = offset[0];
         uint8_t index = offset[1];
         uint8_t art = offset[2];
         uint8_t tarif = offset[3];
+        uint32_t header = readUint32(offset);
         offset += 4;
 
         if (kanal == 144) {
@@ -85,120 +168,57 @@ uint8_t* PowerMeterUdpSmaHomeManager::decodeGroup(uint8_t* offset, uint16_t grou
             continue;
         }
 
-        if (art == 4) {
-            uint32_t data = (offset[0] << 24) +
-                (offset[1] << 16) +
-                (offset[2] << 8) +
-                offset[3];
-            offset += 4;
+        if (art != 4) {
+            MessageOutput.printf("[PowerMeterUdpSmaHomeManager] Skipped unknown measurement: %d %d %d %d\r\n",
+                    kanal, index, art, tarif);
+            offset += art;
+            continue;
+        }
 
-            switch (index) {
-                case (1):
-                    Pbezug = data * 0.1;
-                    ++count;
-                    break;
-                case (2):
-                    Peinspeisung = data * 0.1;
-                    ++count;
-                    break;
-                case (21):
-                    BezugL1 = data * 0.1;
-                    ++count;
-                    break;
-                case (22):
-                    EinspeisungL1 = data * 0.1;
-                    ++count;
-                    break;
-                case (41):
-                    BezugL2 = data * 0.1;
-                    ++count;
-                    break;
-                case (42):
-                    EinspeisungL2 = data * 0.1;
-                    ++count;
-                    break;
-                case (61):
-                    BezugL3 = data * 0.1;
-                    ++count;
-                    break;
-                case (62):
-                    EinspeisungL3 = data * 0.1;
-                    ++count;
-                    break;
-                default:
-                    break;
-            }
-
-            if (count == 8) {
-                _powerMeterPower = Pbezug - Peinspeisung;
-                _powerMeterL1 = BezugL1 - EinspeisungL1;
-                _powerMeterL2 = BezugL2 - EinspeisungL2;
-                _powerMeterL3 = BezugL3 - EinspeisungL3;
-                Soutput(kanal, index, art, tarif, "Leistung", _powerMeterPower, timestamp);
-                Soutput(kanal, index, art, tarif, "Leistung L1", _powerMeterL1, timestamp);
-                Soutput(kanal, index, art, tarif, "Leistung L2", _powerMeterL2, timestamp);
-                Soutput(kanal, index, art, tarif, "Leistung L3", _powerMeterL3, timestamp);
-                count = 0;
-                gotUpdate();
-            }
+        if (offset + 4 > endOfGroup) { return; }
+
+        int channel = -1;
+        switch (index) {
+            case (1): channel = static_cast<int>(Channel::ImportTotal); break;
+            case (2): channel = static_cast<int>(Channel::ExportTotal); break;
+            case (21): channel = static_cast<int>(Channel::ImportL1); break;
+            case (22): channel = static_cast<int>(Channel::ExportL1); break;
+            case (41): channel = static_cast<int>(Channel::ImportL2); break;
+            case (42): channel = static_cast<int>(Channel::ExportL2); break;
+            case (61): channel = static_cast<int>(Channel::ImportL3); break;
+            case (62): channel = static_cast<int>(Channel::ExportL3); break;
+            default: break;
+        }
 
-            continue;
+        if (channel >= 0) {
+            values[channel] = readUint32(offset);
+            layout.Channels[channel] = { static_cast<uint16_t>(offset - buffer), header };
+            found |= 1 << channel;
         }
 
-        MessageOutput.printf("[PowerMeterUdpSmaHomeManager] Skipped unknown measurement: %d %d %d %d\r\n",
-                kanal, index, art, tarif);
-        offset += art;
+        offset += 4;
     }
-
-    return offset;
 }
 
 void PowerMeterUdpSmaHomeManager::loop()
 {
-    uint32_t currentMillis = millis();
-    if (currentMillis - _previousMillis < interval) { return; }
-
-    _previousMillis = currentMillis;
-
-    int packetSize = SMAUdp.parsePacket();
-    if (!packetSize) { return; }
-
-    uint8_t buffer[1024];
-    int rSize = SMAUdp.read(buffer, 1024);
-    if (buffer[0] != 'S' || buffer[1] != 'M' || buffer[2] != 'A') {
-        MessageOutput.println("[PowerMeterUdpSmaHomeManager] Not an SMA packet?");
-        return;
-    }
-
-    uint16_t grouplen;
-    uint16_t grouptag;
-    uint8_t* offset = buffer + 4; // skips the header 'SMA\0'
-
-    do {
-        grouplen = (offset[0] << 8) + offset[1];
-        grouptag = (offset[2] << 8) + offset[3];
-        offset += 4;
-
-        if (grouplen == 0xffff) return;
-
-        if (grouptag == 0x02A0 && grouplen == 4) {
-            offset += 4;
-            continue;
-        }
-
-        if (grouptag == 0x0010) {
-            offset = decodeGroup(offset, grouplen);
-            continue;
-        }
-
-        if (grouptag == 0) {
-            // end marker
-            offset += grouplen;
-            continue;
-        }
+    // the datagrams are decoded by the AsyncUDP task as they arrive. only
+    // the (optional) logging is done here, at most once per new datagram.
+    if (!_verboseLogging) { return; }
 
-        MessageOutput.printf("[PowerMeterUdpSmaHomeManager] Unhandled group 0x%04x with length %d\r\n",
-                grouptag, grouplen);
-        offset += grouplen;
-    } while (grouplen > 0 && offset + 4 < buffer + rSize);
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_timestamp == _lastLogged) { return; }
+    _lastLogged = _timestamp;
+
+    auto timestamp = _timestamp;
+    auto total = _powerMeterPower;
+    auto l1 = _powerMeterL1;
+    auto l2 = _powerMeterL2;
+    auto l3 = _powerMeterL3;
+    lock.unlock();
+
+    Soutput("Leistung", total, timestamp);
+    Soutput("Leistung L1", l1, timestamp);
+    Soutput("Leistung L2", l2, timestamp);
+    Soutput("Leistung L3", l3, timestamp);
 }
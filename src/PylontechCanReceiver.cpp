@@ -4,6 +4,7 @@
 #include "PinMapping.h"
 #include <driver/twai.h>
 #include <ctime>
+#include <iterator>
 
 bool PylontechCanReceiver::init(bool verboseLogging)
 {
@@ -13,98 +14,70 @@ bool PylontechCanReceiver::init(bool verboseLogging)
 
 void PylontechCanReceiver::onMessage(twai_message_t rx_message)
 {
-    switch (rx_message.identifier) {
-        case 0x351: {
-            _stats->_chargeVoltage = this->scaleValue(this->readUnsignedInt16(rx_message.data), 0.1);
-            _stats->_chargeCurrentLimitation = this->scaleValue(this->readSignedInt16(rx_message.data + 2), 0.1);
-            _stats->setDischargeCurrentLimit(this->scaleValue(this->readSignedInt16(rx_message.data + 4), 0.1), millis());
-            _stats->_dischargeVoltageLimitation = this->scaleValue(this->readUnsignedInt16(rx_message.data + 6), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] chargeVoltage: %f chargeCurrentLimitation: %f dischargeCurrentLimitation: %f dischargeVoltageLimitation: %f\r\n",
-                        _stats->_chargeVoltage, _stats->_chargeCurrentLimitation, _stats->getDischargeCurrentLimit(),
-                        _stats->_dischargeVoltageLimitation);
-            }
-            break;
-        }
-
-        case 0x355: {
-            _stats->setSoC(static_cast<uint8_t>(this->readUnsignedInt16(rx_message.data)), 0/*precision*/, millis());
-            _stats->_stateOfHealth = this->readUnsignedInt16(rx_message.data + 2);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] soc: %f soh: %d\r\n",
-                        _stats->getSoC(), _stats->_stateOfHealth);
-            }
-            break;
-        }
-
-        case 0x356: {
-            _stats->setVoltage(this->scaleValue(this->readSignedInt16(rx_message.data), 0.01), millis());
-            _stats->setCurrent(this->scaleValue(this->readSignedInt16(rx_message.data + 2), 0.1), 1/*precision*/, millis());
-            _stats->_temperature = this->scaleValue(this->readSignedInt16(rx_message.data + 4), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] voltage: %f current: %f temperature: %f\r\n",
-                        _stats->getVoltage(), _stats->getChargeCurrent(), _stats->_temperature);
-            }
-            break;
-        }
-
-        case 0x359: {
-            uint16_t alarmBits = rx_message.data[0];
-            _stats->_alarmOverCurrentDischarge = this->getBit(alarmBits, 7);
-            _stats->_alarmUnderTemperature = this->getBit(alarmBits, 4);
-            _stats->_alarmOverTemperature = this->getBit(alarmBits, 3);
-            _stats->_alarmUnderVoltage = this->getBit(alarmBits, 2);
-            _stats->_alarmOverVoltage= this->getBit(alarmBits, 1);
-
-            alarmBits = rx_message.data[1];
-            _stats->_alarmBmsInternal= this->getBit(alarmBits, 3);
-            _stats->_alarmOverCurrentCharge = this->getBit(alarmBits, 0);
+    using Stats = PylontechBatteryStats;
+    using Field = BatteryCanSchema::Field<Stats>;
+    using Frame = BatteryCanSchema::Frame<Stats>;
+    using E = BatteryCanSchema::Encoding;
+
+    static constexpr Field limits[] = {
+        { "chargeVoltage", E::U16, 0, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._chargeVoltage = v; } },
+        { "chargeCurrentLimitation", E::S16, 2, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._chargeCurrentLimitation = v; } },
+        { "dischargeCurrentLimitation", E::S16, 4, 0, 0.1f, 0, [](Stats& s, float v, uint32_t now) { s.setDischargeCurrentLimit(v, now); } },
+        { "dischargeVoltageLimitation", E::U16, 6, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._dischargeVoltageLimitation = v; } }
+    };
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] Alarms: %d %d %d %d %d %d %d\r\n",
-                        _stats->_alarmOverCurrentDischarge,
-                        _stats->_alarmUnderTemperature,
-                        _stats->_alarmOverTemperature,
-                        _stats->_alarmUnderVoltage,
-                        _stats->_alarmOverVoltage,
-                        _stats->_alarmBmsInternal,
-                        _stats->_alarmOverCurrentCharge);
-            }
+    static constexpr Field socSoh[] = {
+        { "soc", E::U16, 0, 0, 1, 0, [](Stats& s, float v, uint32_t now) { s.setSoC(static_cast<uint8_t>(v), 0/*precision*/, now); } },
+        { "soh", E::U16, 2, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._stateOfHealth = v; } }
+    };
 
-            uint16_t warningBits = rx_message.data[2];
-            _stats->_warningHighCurrentDischarge = this->getBit(warningBits, 7);
-            _stats->_warningLowTemperature = this->getBit(warningBits, 4);
-            _stats->_warningHighTemperature = this->getBit(warningBits, 3);
-            _stats->_warningLowVoltage = this->getBit(warningBits, 2);
-            _stats->_warningHighVoltage = this->getBit(warningBits, 1);
+    static constexpr Field measurements[] = {
+        { "voltage", E::S16, 0, 0, 0.01f, 0, [](Stats& s, float v, uint32_t now) { s.setVoltage(v, now); } },
+        { "current", E::S16, 2, 0, 0.1f, 0, [](Stats& s, float v, uint32_t now) { s.setCurrent(v, 1/*precision*/, now); } },
+        { "temperature", E::S16, 4, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._temperature = v; } }
+    };
 
-            warningBits = rx_message.data[3];
-            _stats->_warningBmsInternal= this->getBit(warningBits, 3);
-            _stats->_warningHighCurrentCharge = this->getBit(warningBits, 0);
+    static constexpr Field alarmsWarnings[] = {
+        { "alarmOverCurrentDischarge", E::Bit, 0, 7, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmOverCurrentDischarge = v; } },
+        { "alarmUnderTemperature", E::Bit, 0, 4, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmUnderTemperature = v; } },
+        { "alarmOverTemperature", E::Bit, 0, 3, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmOverTemperature = v; } },
+        { "alarmUnderVoltage", E::Bit, 0, 2, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmUnderVoltage = v; } },
+        { "alarmOverVoltage", E::Bit, 0, 1, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmOverVoltage = v; } },
+        { "alarmBmsInternal", E::Bit, 1, 3, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmBmsInternal = v; } },
+        { "alarmOverCurrentCharge", E::Bit, 1, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmOverCurrentCharge = v; } },
+        { "warningHighCurrentDischarge", E::Bit, 2, 7, 1, 0, [](Stats& s, float v, uint32_t) { s._warningHighCurrentDischarge = v; } },
+        { "warningLowTemperature", E::Bit, 2, 4, 1, 0, [](Stats& s, float v, uint32_t) { s._warningLowTemperature = v; } },
+        { "warningHighTemperature", E::Bit, 2, 3, 1, 0, [](Stats& s, float v, uint32_t) { s._warningHighTemperature = v; } },
+        { "warningLowVoltage", E::Bit, 2, 2, 1, 0, [](Stats& s, float v, uint32_t) { s._warningLowVoltage = v; } },
+        { "warningHighVoltage", E::Bit, 2, 1, 1, 0, [](Stats& s, float v, uint32_t) { s._warningHighVoltage = v; } },
+        { "warningBmsInternal", E::Bit, 3, 3, 1, 0, [](Stats& s, float v, uint32_t) { s._warningBmsInternal = v; } },
+        { "warningHighCurrentCharge", E::Bit, 3, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._warningHighCurrentCharge = v; } },
+        { "modules", E::U8, 4, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._moduleCount = v; } }
+    };
 
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] Warnings: %d %d %d %d %d %d %d\r\n",
-                        _stats->_warningHighCurrentDischarge,
-                        _stats->_warningLowTemperature,
-                        _stats->_warningHighTemperature,
-                        _stats->_warningLowVoltage,
-                        _stats->_warningHighVoltage,
-                        _stats->_warningBmsInternal,
-                        _stats->_warningHighCurrentCharge);
-            }
+    static constexpr Field chargeStatus[] = {
+        { "chargeEnabled", E::Bit, 0, 7, 1, 0, [](Stats& s, float v, uint32_t) { s._chargeEnabled = v; } },
+        { "dischargeEnabled", E::Bit, 0, 6, 1, 0, [](Stats& s, float v, uint32_t) { s._dischargeEnabled = v; } },
+        { "chargeImmediately", E::Bit, 0, 5, 1, 0, [](Stats& s, float v, uint32_t) { s._chargeImmediately = v; } }
+    };
 
-            _stats->_moduleCount = rx_message.data[4];
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] Modules: %d\r\n",
-                        _stats->_moduleCount);
-            }
+    static constexpr Frame frames[] = {
+        { 0x351, limits, std::size(limits) },
+        { 0x355, socSoh, std::size(socSoh) },
+        { 0x356, measurements, std::size(measurements) },
+        { 0x359, alarmsWarnings, std::size(alarmsWarnings) },
+        { 0x35C, chargeStatus, std::size(chargeStatus) }
+    };
+    static_assert(BatteryCanSchema::isSorted(frames), "frames must be sorted");
+    static_assert(BatteryCanSchema::fitsPayload(frames), "fields exceed payload");
+    static_assert(BatteryCanSchema::isSubsetOf(frames, _messageIds), "frame ids must be subscribed");
 
-            break;
-        }
+    if (decodeFrame(frames, *_stats, rx_message)) {
+        _stats->setLastUpdate(millis());
+        return;
+    }
 
+    switch (rx_message.identifier) {
         case 0x35E: {
             String manufacturer(reinterpret_cast<char*>(rx_message.data),
                     rx_message.data_length_code);
@@ -119,22 +92,6 @@ void PylontechCanReceiver::onMessage(twai_message_t rx_message)
             break;
         }
 
-        case 0x35C: {
-            uint16_t chargeStatusBits = rx_message.data[0];
-            _stats->_chargeEnabled = this->getBit(chargeStatusBits, 7);
-            _stats->_dischargeEnabled = this->getBit(chargeStatusBits, 6);
-            _stats->_chargeImmediately = this->getBit(chargeStatusBits, 5);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pylontech] chargeStatusBits: %d %d %d\r\n",
-                    _stats->_chargeEnabled,
-                    _stats->_dischargeEnabled,
-                    _stats->_chargeImmediately);
-            }
-
-            break;
-        }
-
         default:
             return; // do not update last update timestamp
             break;
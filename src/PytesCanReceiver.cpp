@@ -4,6 +4,7 @@
 #include "PinMapping.h"
 #include <driver/twai.h>
 #include <ctime>
+#include <iterator>
 
 namespace {
 
@@ -29,113 +30,135 @@ bool PytesCanReceiver::init(bool verboseLogging)
 
 void PytesCanReceiver::onMessage(twai_message_t rx_message)
 {
-    switch (rx_message.identifier) {
-        case 0x351:
-        case 0x400: {
-            _stats->_chargeVoltageLimit = this->scaleValue(this->readUnsignedInt16(rx_message.data), 0.1);
-            _stats->_chargeCurrentLimit = this->scaleValue(this->readUnsignedInt16(rx_message.data + 2), 0.1);
-            _stats->setDischargeCurrentLimit(this->scaleValue(this->readUnsignedInt16(rx_message.data + 4), 0.1), millis());
-            _stats->_dischargeVoltageLimit = this->scaleValue(this->readSignedInt16(rx_message.data + 6), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] chargeVoltageLimit: %f chargeCurrentLimit: %f dischargeCurrentLimit: %f dischargeVoltageLimit: %f\r\n",
-                        _stats->_chargeVoltageLimit, _stats->_chargeCurrentLimit,
-                        _stats->getDischargeCurrentLimit(), _stats->_dischargeVoltageLimit);
-            }
-            break;
-        }
-
-        case 0x355: {  // Victron protocol: SOC/SOH
-            _stats->setSoC(static_cast<uint8_t>(this->readUnsignedInt16(rx_message.data)), 0/*precision*/, millis());
-            _stats->_stateOfHealth = this->readUnsignedInt16(rx_message.data + 2);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] soc: %f soh: %d\r\n",
-                        _stats->getSoC(), _stats->_stateOfHealth);
-            }
-            break;
-        }
-
-        case 0x356:
-        case 0x405: {
-            _stats->setVoltage(this->scaleValue(this->readSignedInt16(rx_message.data), 0.01), millis());
-            _stats->setCurrent(this->scaleValue(this->readSignedInt16(rx_message.data + 2), 0.1), 1/*precision*/, millis());
-            _stats->_temperature = this->scaleValue(this->readSignedInt16(rx_message.data + 4), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] voltage: %f current: %f temperature: %f\r\n",
-                        _stats->getVoltage(), _stats->getChargeCurrent(), _stats->_temperature);
-            }
-            break;
-        }
-
-        case 0x35A: { // Victron protocol: Alarms and Warnings
-            uint16_t alarmBits = rx_message.data[0];
-            _stats->_alarmOverVoltage = this->getBit(alarmBits, 2);
-            _stats->_alarmUnderVoltage = this->getBit(alarmBits, 4);
-            _stats->_alarmOverTemperature = this->getBit(alarmBits, 6);
-
-            alarmBits = rx_message.data[1];
-            _stats->_alarmUnderTemperature = this->getBit(alarmBits, 0);
-            _stats->_alarmOverTemperatureCharge = this->getBit(alarmBits, 2);
-            _stats->_alarmUnderTemperatureCharge = this->getBit(alarmBits, 4);
-            _stats->_alarmOverCurrentDischarge = this->getBit(alarmBits, 6);
-
-            alarmBits = rx_message.data[2];
-            _stats->_alarmOverCurrentCharge = this->getBit(alarmBits, 0);
-            _stats->_alarmInternalFailure = this->getBit(alarmBits, 6);
-
-            alarmBits = rx_message.data[3];
-            _stats->_alarmCellImbalance = this->getBit(alarmBits, 0);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] Alarms: %d %d %d %d %d %d %d %d %d %d\r\n",
-                        _stats->_alarmOverVoltage,
-                        _stats->_alarmUnderVoltage,
-                        _stats->_alarmOverTemperature,
-                        _stats->_alarmUnderTemperature,
-                        _stats->_alarmOverTemperatureCharge,
-                        _stats->_alarmUnderTemperatureCharge,
-                        _stats->_alarmOverCurrentDischarge,
-                        _stats->_alarmOverCurrentCharge,
-                        _stats->_alarmInternalFailure,
-                        _stats->_alarmCellImbalance);
-            }
-
-            uint16_t warningBits = rx_message.data[4];
-            _stats->_warningHighVoltage = this->getBit(warningBits, 2);
-            _stats->_warningLowVoltage = this->getBit(warningBits, 4);
-            _stats->_warningHighTemperature = this->getBit(warningBits, 6);
-
-            warningBits = rx_message.data[5];
-            _stats->_warningLowTemperature = this->getBit(warningBits, 0);
-            _stats->_warningHighTemperatureCharge = this->getBit(warningBits, 2);
-            _stats->_warningLowTemperatureCharge = this->getBit(warningBits, 4);
-            _stats->_warningHighDischargeCurrent = this->getBit(warningBits, 6);
-
-            warningBits = rx_message.data[6];
-            _stats->_warningHighChargeCurrent = this->getBit(warningBits, 0);
-            _stats->_warningInternalFailure = this->getBit(warningBits, 6);
-
-            warningBits = rx_message.data[7];
-            _stats->_warningCellImbalance = this->getBit(warningBits, 0);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] Warnings: %d %d %d %d %d %d %d %d %d %d\r\n",
-                        _stats->_warningHighVoltage,
-                        _stats->_warningLowVoltage,
-                        _stats->_warningHighTemperature,
-                        _stats->_warningLowTemperature,
-                        _stats->_warningHighTemperatureCharge,
-                        _stats->_warningLowTemperatureCharge,
-                        _stats->_warningHighDischargeCurrent,
-                        _stats->_warningHighChargeCurrent,
-                        _stats->_warningInternalFailure,
-                        _stats->_warningCellImbalance);
-            }
-            break;
-        }
+    using Stats = PytesBatteryStats;
+    using Field = BatteryCanSchema::Field<Stats>;
+    using Frame = BatteryCanSchema::Frame<Stats>;
+    using E = BatteryCanSchema::Encoding;
+
+    static constexpr Field limits[] = {
+        { "chargeVoltageLimit", E::U16, 0, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._chargeVoltageLimit = v; } },
+        { "chargeCurrentLimit", E::U16, 2, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._chargeCurrentLimit = v; } },
+        { "dischargeCurrentLimit", E::U16, 4, 0, 0.1f, 0, [](Stats& s, float v, uint32_t now) { s.setDischargeCurrentLimit(v, now); } },
+        { "dischargeVoltageLimit", E::S16, 6, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._dischargeVoltageLimit = v; } }
+    };
+
+    static constexpr Field socSoh[] = {
+        { "soc", E::U16, 0, 0, 1, 0, [](Stats& s, float v, uint32_t now) { s.setSoC(static_cast<uint8_t>(v), 0/*precision*/, now); } },
+        { "soh", E::U16, 2, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._stateOfHealth = v; } }
+    };
+
+    static constexpr Field measurements[] = {
+        { "voltage", E::S16, 0, 0, 0.01f, 0, [](Stats& s, float v, uint32_t now) { s.setVoltage(v, now); } },
+        { "current", E::S16, 2, 0, 0.1f, 0, [](Stats& s, float v, uint32_t now) { s.setCurrent(v, 1/*precision*/, now); } },
+        { "temperature", E::S16, 4, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._temperature = v; } }
+    };
+
+    // Victron protocol
+    static constexpr Field alarmsWarnings[] = {
+        { "alarmOverVoltage", E::Bit, 0, 2, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmOverVoltage = v; } },
+        { "alarmUnderVoltage", E::Bit, 0, 4, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmUnderVoltage = v; } },
+        { "alarmOverTemperature", E::Bit, 0, 6, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmOverTemperature = v; } },
+        { "alarmUnderTemperature", E::Bit, 1, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmUnderTemperature = v; } },
+        { "alarmOverTemperatureCharge", E::Bit, 1, 2, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmOverTemperatureCharge = v; } },
+        { "alarmUnderTemperatureCharge", E::Bit, 1, 4, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmUnderTemperatureCharge = v; } },
+        { "alarmOverCurrentDischarge", E::Bit, 1, 6, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmOverCurrentDischarge = v; } },
+        { "alarmOverCurrentCharge", E::Bit, 2, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmOverCurrentCharge = v; } },
+        { "alarmInternalFailure", E::Bit, 2, 6, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmInternalFailure = v; } },
+        { "alarmCellImbalance", E::Bit, 3, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmCellImbalance = v; } },
+        { "warningHighVoltage", E::Bit, 4, 2, 1, 0, [](Stats& s, float v, uint32_t) { s._warningHighVoltage = v; } },
+        { "warningLowVoltage", E::Bit, 4, 4, 1, 0, [](Stats& s, float v, uint32_t) { s._warningLowVoltage = v; } },
+        { "warningHighTemperature", E::Bit, 4, 6, 1, 0, [](Stats& s, float v, uint32_t) { s._warningHighTemperature = v; } },
+        { "warningLowTemperature", E::Bit, 5, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._warningLowTemperature = v; } },
+        { "warningHighTemperatureCharge", E::Bit, 5, 2, 1, 0, [](Stats& s, float v, uint32_t) { s._warningHighTemperatureCharge = v; } },
+        { "warningLowTemperatureCharge", E::Bit, 5, 4, 1, 0, [](Stats& s, float v, uint32_t) { s._warningLowTemperatureCharge = v; } },
+        { "warningHighDischargeCurrent", E::Bit, 5, 6, 1, 0, [](Stats& s, float v, uint32_t) { s._warningHighDischargeCurrent = v; } },
+        { "warningHighChargeCurrent", E::Bit, 6, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._warningHighChargeCurrent = v; } },
+        { "warningInternalFailure", E::Bit, 6, 6, 1, 0, [](Stats& s, float v, uint32_t) { s._warningInternalFailure = v; } },
+        { "warningCellImbalance", E::Bit, 7, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._warningCellImbalance = v; } }
+    };
+
+    // Victron protocol, 0xff requests charging
+    static constexpr Field chargeRequest[] = {
+        { "chargeImmediately", E::U8, 0, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._chargeImmediately = v; } }
+    };
+
+    // Victron protocol
+    static constexpr Field bankInfo[] = {
+        { "moduleCountOnline", E::U16, 0, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._moduleCountOnline = v; } },
+        { "moduleCountBlockingCharge", E::U16, 2, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._moduleCountBlockingCharge = v; } },
+        { "moduleCountBlockingDischarge", E::U16, 4, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._moduleCountBlockingDischarge = v; } },
+        { "moduleCountOffline", E::U16, 6, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._moduleCountOffline = v; } }
+    };
+
+    // Victron protocol, temperatures in Kelvin
+    static constexpr Field cellInfo[] = {
+        { "lowestCellMilliVolt", E::U16, 0, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._cellMinMilliVolt = v; } },
+        { "highestCellMilliVolt", E::U16, 2, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._cellMaxMilliVolt = v; } },
+        { "minimumCellTemperature", E::U16, 4, 0, 1, -273, [](Stats& s, float v, uint32_t) { s._cellMinTemperature = v; } },
+        { "maximumCellTemperature", E::U16, 6, 0, 1, -273, [](Stats& s, float v, uint32_t) { s._cellMaxTemperature = v; } }
+    };
+
+    static constexpr Field energy[] = {
+        { "chargedEnergy", E::U32, 0, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._chargedEnergy = v; } },
+        { "dischargedEnergy", E::U32, 4, 0, 0.1f, 0, [](Stats& s, float v, uint32_t) { s._dischargedEnergy = v; } }
+    };
+
+    // installed Ah
+    static constexpr Field batterySize[] = {
+        { "totalCapacity", E::U16, 0, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._totalCapacity = v; } }
+    };
+
+    // Pytes protocol. the soc is not used, as message 0x409 provides
+    // it with a higher precision.
+    static constexpr Field sohCycles[] = {
+        { "soh", E::U16, 2, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._stateOfHealth = v; } },
+        { "cycles", E::U16, 6, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._chargeCycles = v; } }
+    };
+
+    // Pytes protocol, bit 15 of a 32 bit word
+    static constexpr Field alarms2[] = {
+        { "internalFailure", E::Bit, 1, 7, 1, 0, [](Stats& s, float v, uint32_t) { s._alarmInternalFailure = v; } }
+    };
+
+    static constexpr Field moduleCounts[] = {
+        { "moduleCountOnline", E::U8, 6, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._moduleCountOnline = v; } },
+        { "moduleCountOffline", E::U8, 7, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._moduleCountOffline = v; } }
+    };
+
+    // the unit is unknown, hence this is only published as active or
+    // inactive. it might be a percentage on a scale of 0 to 32768.
+    static constexpr Field balancing[] = {
+        { "balance", E::U16, 4, 0, 1, 0, [](Stats& s, float v, uint32_t) { s._balance = v; } }
+    };
+
+    static constexpr Frame frames[] = {
+        { 0x351, limits, std::size(limits) },
+        { 0x355, socSoh, std::size(socSoh) },
+        { 0x356, measurements, std::size(measurements) },
+        { 0x35A, alarmsWarnings, std::size(alarmsWarnings) },
+        { 0x360, chargeRequest, std::size(chargeRequest) },
+        { 0x372, bankInfo, std::size(bankInfo) },
+        { 0x373, cellInfo, std::size(cellInfo) },
+        { 0x378, energy, std::size(energy) },
+        { 0x379, batterySize, std::size(batterySize) },
+        { 0x400, limits, std::size(limits) },
+        { 0x404, sohCycles, std::size(sohCycles) },
+        { 0x405, measurements, std::size(measurements) },
+        { 0x406, alarms2, std::size(alarms2) },
+        { 0x40B, moduleCounts, std::size(moduleCounts) },
+        { 0x40D, balancing, std::size(balancing) },
+        { 0x41E, energy, std::size(energy) }
+    };
+    static_assert(BatteryCanSchema::isSorted(frames), "frames must be sorted");
+    static_assert(BatteryCanSchema::fitsPayload(frames), "fields exceed payload");
+    static_assert(BatteryCanSchema::isSubsetOf(frames, _messageIds), "frame ids must be subscribed");
+
+    if (decodeFrame(frames, *_stats, rx_message)) {
+        _stats->setLastUpdate(millis());
+        return;
+    }
 
+    switch (rx_message.identifier) {
         case 0x35E:
         case 0x40A: {
             String manufacturer(reinterpret_cast<char*>(rx_message.data),
@@ -165,43 +188,6 @@ void PytesCanReceiver::onMessage(twai_message_t rx_message)
             break;
         }
 
-        case 0x360: { // Victron protocol: Charging request
-            _stats->_chargeImmediately = rx_message.data[0]; // 0xff requests charging.
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] chargeImmediately: %d\r\n",
-                        _stats->_chargeImmediately);
-            }
-            break;
-        }
-
-        case 0x372: { // Victron protocol: BankInfo
-            _stats->_moduleCountOnline = this->readUnsignedInt16(rx_message.data);
-            _stats->_moduleCountBlockingCharge = this->readUnsignedInt16(rx_message.data + 2);
-            _stats->_moduleCountBlockingDischarge = this->readUnsignedInt16(rx_message.data + 4);
-            _stats->_moduleCountOffline = this->readUnsignedInt16(rx_message.data + 6);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] moduleCountOnline: %d moduleCountBlockingCharge: %d moduleCountBlockingDischarge: %d moduleCountOffline: %d\r\n",
-                        _stats->_moduleCountOnline, _stats->_moduleCountBlockingCharge,
-                        _stats->_moduleCountBlockingDischarge, _stats->_moduleCountOffline);
-            }
-            break;
-        }
-
-        case 0x373: { // Victron protocol: CellInfo
-            _stats->_cellMinMilliVolt = this->readUnsignedInt16(rx_message.data);
-            _stats->_cellMaxMilliVolt = this->readUnsignedInt16(rx_message.data + 2);
-            _stats->_cellMinTemperature = this->readUnsignedInt16(rx_message.data + 4) - 273;
-            _stats->_cellMaxTemperature = this->readUnsignedInt16(rx_message.data + 6) - 273;
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] lowestCellMilliVolt: %d highestCellMilliVolt: %d minimumCellTemperature: %f maximumCellTemperature: %f\r\n",
-                        _stats->_cellMinMilliVolt, _stats->_cellMaxMilliVolt,
-                        _stats->_cellMinTemperature, _stats->_cellMaxTemperature);
-            }
-            break;
-        }
-
         case 0x374: { // Victron protocol: Battery/Cell name (string) with "Lowest Cell Voltage"
             String cellMinVoltageName(reinterpret_cast<char*>(rx_message.data),
                     rx_message.data_length_code);
@@ -262,28 +248,6 @@ void PytesCanReceiver::onMessage(twai_message_t rx_message)
             break;
         }
 
-        case 0x378:
-        case 0x41e: { // History: Charged / Discharged Energy
-            _stats->_chargedEnergy = this->scaleValue(this->readUnsignedInt32(rx_message.data), 0.1);
-            _stats->_dischargedEnergy = this->scaleValue(this->readUnsignedInt32(rx_message.data + 4), 0.1);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] chargedEnergy: %f dischargedEnergy: %f\r\n",
-                        _stats->_chargedEnergy, _stats->_dischargedEnergy);
-            }
-            break;
-        }
-
-        case 0x379: { // BatterySize: Installed Ah
-            _stats->_totalCapacity = this->readUnsignedInt16(rx_message.data);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] totalCapacity: %f Ah\r\n",
-                        _stats->_totalCapacity);
-            }
-            break;
-        }
-
         case 0x380: { // Serialnumber - part 1
             String snPart1(reinterpret_cast<char*>(rx_message.data),
                     rx_message.data_length_code);
@@ -408,30 +372,6 @@ void PytesCanReceiver::onMessage(twai_message_t rx_message)
             break;
         }
 
-        case 0x404: { // Pytes protocol: SOC/SOH
-            // soc (byte 0+1) isn't used here since it is generated with higher
-            // precision in message 0x0409 below.
-            _stats->_stateOfHealth = this->readUnsignedInt16(rx_message.data + 2);
-            _stats->_chargeCycles = this->readUnsignedInt16(rx_message.data + 6);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] soh: %d cycles: %d\r\n",
-                        _stats->_stateOfHealth, _stats->_chargeCycles);
-            }
-            break;
-        }
-
-        case 0x406: { // Pytes protocol: alarms (part 2)
-            uint32_t alarmBits = this->readUnsignedInt32(rx_message.data);
-            _stats->_alarmInternalFailure = this->getBit(alarmBits, 15);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] internalFailure: %d (bits: %08x)\r\n",
-                        _stats->_alarmInternalFailure, alarmBits);
-            }
-            break;
-        }
-
         case 0x408: { // Pytes protocol: charge status
             bool chargeEnabled = rx_message.data[0];
             bool dischargeEnabled = rx_message.data[1];
@@ -462,30 +402,6 @@ void PytesCanReceiver::onMessage(twai_message_t rx_message)
             break;
         }
 
-        case 0x40b: { // Pytes protocol: online / offline module count
-            _stats->_moduleCountOnline = this->readUnsignedInt8(rx_message.data + 6);
-            _stats->_moduleCountOffline = this->readUnsignedInt8(rx_message.data + 7);
-
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] moduleCountOnline: %d moduleCountOffline: %d\r\n",
-                        _stats->_moduleCountOnline, _stats->_moduleCountOffline);
-            }
-            break;
-        }
-
-        case 0x40d: { // Pytes protocol: balancing info
-            // We don't know the exact unit for this yet, so we only use
-            // it to publish active / not active.
-            // It is somewhat likely that this is a percentage value on
-            // the scale of 0-32768, but that is just a theory.
-            _stats->_balance = this->readUnsignedInt16(rx_message.data + 4);
-            if (_verboseLogging) {
-                MessageOutput.printf("[Pytes] balance: %d\r\n",
-                        _stats->_balance);
-            }
-            break;
-        }
-
         default:
             return; // do not update last update timestamp
             break;
@@ -3,6 +3,8 @@
  * Copyright (C) 2024 Thomas Basler and others
  */
 #include "RestartHelper.h"
+#include "Configuration.h"
+#include "TaskMonitor.h"
 #include "Display_Graphic.h"
 #include "Led_Single.h"
 #include <Esp.h>
@@ -10,7 +12,7 @@
 RestartHelperClass RestartHelper;
 
 RestartHelperClass::RestartHelperClass()
-    : _rebootTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&RestartHelperClass::loop, this))
+    : _rebootTask(1 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("RestartHelper::loop", std::bind(&RestartHelperClass::loop, this)))
 {
 }
 
@@ -19,8 +21,9 @@ void RestartHelperClass::init(Scheduler& scheduler)
     scheduler.addTask(_rebootTask);
 }
 
-void RestartHelperClass::triggerRestart()
+void RestartHelperClass::triggerRestart(const bool persistConfig)
 {
+    _persistConfig = persistConfig;
     _rebootTask.enable();
     _rebootTask.restart();
 }
@@ -29,8 +32,13 @@ void RestartHelperClass::loop()
 {
     if (_rebootTask.isFirstIteration()) {
         LedSingle.turnAllOff();
+#ifndef OPENDTU_WITHOUT_DISPLAY
         Display.setStatus(false);
+#endif
     } else {
+        if (_persistConfig) {
+            Configuration.flush();
+        }
         ESP.restart();
     }
 }
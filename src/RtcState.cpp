@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "RtcState.h"
+#include "Configuration.h"
+#include "MessageOutput.h"
+#include "TaskMonitor.h"
+#include <Hoymiles.h>
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+#include <cstring>
+#include <ctime>
+
+RtcStateClass RtcState;
+
+namespace {
+
+struct TimeSection {
+    int64_t EpochMicros; // wall-clock time of the last save
+    uint32_t Crc;
+};
+
+struct InverterSection {
+    uint64_t Serial;
+    uint8_t Length;
+    uint8_t Data[SYSTEM_CONFIG_PARA_SIZE];
+    uint32_t Crc;
+};
+
+struct DplSection {
+    RtcDplState State;
+    uint32_t Crc;
+};
+
+struct Record {
+    uint32_t Magic;
+    uint32_t Layout;
+    TimeSection Time;
+    InverterSection Inverters[INV_MAX_COUNT];
+    DplSection Dpl;
+};
+
+// not initialized at boot, hence the contents of the previous run are
+// found here after a soft reset
+RTC_NOINIT_ATTR Record sRecord;
+
+// earlier timestamps mean the system time was not set, see getLocalTime()
+constexpr time_t minValidEpoch = (2016 - 1970) * 365 * 24 * 3600;
+
+template<typename T>
+uint32_t getCrc(T const& section)
+{
+    return esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(&section),
+            sizeof(section) - sizeof(section.Crc));
+}
+
+template<typename T>
+void seal(T& section)
+{
+    section.Crc = getCrc(section);
+}
+
+template<typename T>
+bool isSealed(T const& section)
+{
+    return section.Crc == getCrc(section);
+}
+
+uint32_t getLayout(uint8_t version)
+{
+    uint32_t const values[] = { version, static_cast<uint32_t>(sizeof(Record)) };
+    return esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(values), sizeof(values));
+}
+
+bool isSoftReset()
+{
+    switch (esp_reset_reason()) {
+        case ESP_RST_SW:
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+}; // namespace
+
+RtcStateClass::RtcStateClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("RtcState::loop", std::bind(&RtcStateClass::loop, this)))
+{
+}
+
+void RtcStateClass::init(Scheduler& scheduler)
+{
+    _valid = isSoftReset() && sRecord.Magic == _magic && sRecord.Layout == getLayout(_version);
+
+    if (_valid) {
+        restoreTime();
+        restoreInverters();
+        if (isSealed(sRecord.Dpl)) { _oDplState = sRecord.Dpl.State; }
+    } else {
+        memset(&sRecord, 0, sizeof(sRecord));
+        sRecord.Magic = _magic;
+        sRecord.Layout = getLayout(_version);
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void RtcStateClass::restoreTime()
+{
+    // the system time survives soft resets on some targets
+    if (time(nullptr) >= minValidEpoch || !isSealed(sRecord.Time)) { return; }
+
+    // the reset happened within a save interval after the last save. the
+    // time elapsed since is accounted for by the uptime.
+    int64_t micros = sRecord.Time.EpochMicros + esp_timer_get_time()
+        + _loopTask.getInterval() * 1000 / 2;
+
+    struct timeval tv;
+    tv.tv_sec = micros / 1000000;
+    tv.tv_usec = micros % 1000000;
+    settimeofday(&tv, nullptr);
+
+    MessageOutput.println("[RtcState] restored the time of day, NTP will correct it");
+}
+
+void RtcStateClass::restoreInverters()
+{
+    uint8_t count = 0;
+    for (auto const& section : sRecord.Inverters) {
+        if (section.Serial == 0 || !isSealed(section)) { continue; }
+
+        auto inv = Hoymiles.getInverterBySerial(section.Serial);
+        if (inv == nullptr) { continue; }
+
+        // provisional like the copy cached on LittleFS, the system config is
+        // still requested from the inverter.
+        if (inv->SystemConfigPara()->setRawData(section.Data, section.Length)) { count++; }
+    }
+
+    MessageOutput.printf("[RtcState] restored the limits of %u inverters\r\n", count);
+}
+
+void RtcStateClass::setDplState(RtcDplState const& state)
+{
+    if (state == _lastDplState && isSealed(sRecord.Dpl)) { return; }
+
+    sRecord.Dpl.State = state;
+    seal(sRecord.Dpl);
+    _lastDplState = state;
+}
+
+void RtcStateClass::loop()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec >= minValidEpoch) {
+        sRecord.Time.EpochMicros = static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+        seal(sRecord.Time);
+    }
+
+    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
+        auto& section = sRecord.Inverters[i];
+        auto inv = (i < Hoymiles.getNumInverters()) ? Hoymiles.getInverterByPos(i) : nullptr;
+
+        if (inv == nullptr) {
+            if (section.Serial != 0) {
+                section = {};
+                seal(section);
+            }
+            continue;
+        }
+
+        // only a limit confirmed by the inverter is kept, not the restored one
+        auto systemConfigPara = inv->SystemConfigPara();
+        bool requested = systemConfigPara->getLastUpdateRequest() > 0
+            && systemConfigPara->getLastLimitRequestSuccess() == CMD_OK;
+        bool commanded = systemConfigPara->getLastUpdateCommand() > 0
+            && systemConfigPara->getLastLimitCommandSuccess() == CMD_OK;
+        if (!requested && !commanded) { continue; }
+
+        auto data = systemConfigPara->getRawData();
+        if (data.empty() || data.size() > sizeof(section.Data)) { continue; }
+
+        if (section.Serial == inv->serial() && section.Length == data.size()
+                && memcmp(section.Data, data.data(), data.size()) == 0) {
+            continue;
+        }
+
+        section.Serial = inv->serial();
+        section.Length = data.size();
+        memcpy(section.Data, data.data(), data.size());
+        seal(section);
+    }
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "RtosTaskProfiler.h"
+#include "TaskMonitor.h"
+#include <algorithm>
+#include <cstring>
+
+RtosTaskProfilerClass RtosTaskProfiler;
+
+void RtosTaskProfilerClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.setCallback(TaskMonitor.wrap("RtosTaskProfiler::loop", std::bind(&RtosTaskProfilerClass::loop, this)));
+    _loopTask.setIterations(TASK_FOREVER);
+    _loopTask.setInterval(SamplingWindowMillis * TASK_MILLISECOND);
+    _loopTask.enable();
+}
+
+#if configUSE_TRACE_FACILITY == 1
+void RtosTaskProfilerClass::loop()
+{
+    // tasks might be created while we enumerate them, so leave some room
+    std::vector<TaskStatus_t> status(uxTaskGetNumberOfTasks() + 4);
+
+    uint32_t totalRunTime = 0;
+    status.resize(uxTaskGetSystemState(status.data(), status.size(), &totalRunTime));
+
+    std::vector<TaskInfo> tasks;
+    tasks.reserve(status.size());
+
+    std::vector<std::pair<UBaseType_t, uint32_t>> runTime;
+    runTime.reserve(status.size());
+
+    uint32_t totalRunTimeDelta = totalRunTime - _previousTotalRunTime;
+
+    for (auto const& s : status) {
+        TaskInfo info;
+        strlcpy(info.Name.data(), s.pcTaskName, info.Name.size());
+        info.Priority = s.uxCurrentPriority;
+        info.StackWatermark = s.usStackHighWaterMark;
+
+        BaseType_t affinity = xTaskGetAffinity(s.xHandle);
+        info.Core = (affinity == tskNO_AFFINITY) ? -1 : static_cast<int8_t>(affinity);
+
+        // the run-time counters are zero if the FreeRTOS configuration
+        // does not generate run-time statistics.
+        runTime.emplace_back(s.xTaskNumber, s.ulRunTimeCounter);
+        auto previous = std::find_if(_previousRunTime.begin(), _previousRunTime.end(),
+                [&s](auto const& entry) { return entry.first == s.xTaskNumber; });
+        if (totalRunTime > 0 && totalRunTimeDelta > 0 && previous != _previousRunTime.end()) {
+            uint32_t delta = s.ulRunTimeCounter - previous->second;
+            info.CpuShare = 100.0f * delta / totalRunTimeDelta;
+        }
+
+        tasks.push_back(info);
+    }
+
+    std::sort(tasks.begin(), tasks.end(), [](TaskInfo const& a, TaskInfo const& b) {
+        return strcmp(a.Name.data(), b.Name.data()) < 0;
+    });
+
+    _previousRunTime = std::move(runTime);
+    _previousTotalRunTime = totalRunTime;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks = std::move(tasks);
+}
+#else
+void RtosTaskProfilerClass::loop()
+{
+    // without the trace facility, tasks cannot be enumerated. we resort to
+    // the tasks whose names we know.
+    static std::array<char const*, 16> constexpr taskNames = {
+        "IDLE0", "IDLE1", "wifi", "tiT", "loopTask", "async_tcp", "mqttclient",
+        "HuaweiHwIfc", "HuaweiCtrl", "PM:SDM", "PM:HTTP+JSON", "PM:SML", "PM:HTTP+SML",
+        "Display", "OTA", "MessageOut"
+    };
+
+    std::vector<TaskInfo> tasks;
+
+    for (char const* taskName : taskNames) {
+        TaskHandle_t const handle = xTaskGetHandle(taskName);
+        if (!handle) { continue; }
+
+        TaskInfo info;
+        strlcpy(info.Name.data(), taskName, info.Name.size());
+        info.Priority = uxTaskPriorityGet(handle);
+        info.StackWatermark = uxTaskGetStackHighWaterMark(handle);
+        BaseType_t affinity = xTaskGetAffinity(handle);
+        info.Core = (affinity == tskNO_AFFINITY) ? -1 : static_cast<int8_t>(affinity);
+        tasks.push_back(info);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks = std::move(tasks);
+}
+#endif
+
+std::vector<RtosTaskProfilerClass::TaskInfo> RtosTaskProfilerClass::getTasks() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _tasks;
+}
@@ -3,5 +3,45 @@
  * Copyright (C) 2023 Thomas Basler and others
  */
 #include "Scheduler.h"
+#include "MessageOutput.h"
+#include "TaskMonitor.h"
 
-Scheduler scheduler;
\ No newline at end of file
+Scheduler scheduler;
+Scheduler controlScheduler;
+ControlPlaneClass ControlPlane;
+
+void ControlPlaneClass::init()
+{
+    // above the Arduino loop, such that the control plane is not delayed
+    // by it if both share a core
+    uint32_t constexpr stackSize = 8192;
+    if (pdPASS != xTaskCreatePinnedToCore(ControlPlaneClass::loopHelper,
+                "ControlPlane", stackSize, this, 3/*prio*/, &_taskHandle,
+                CONTROL_PLANE_CORE)) {
+        MessageOutput.println("[ControlPlane] failed to start task");
+        _taskHandle = nullptr;
+        return;
+    }
+
+    MessageOutput.printf("[ControlPlane] running on core %d\r\n", CONTROL_PLANE_CORE);
+}
+
+void ControlPlaneClass::loopHelper(void* context)
+{
+    static_cast<ControlPlaneClass*>(context)->loop();
+}
+
+void ControlPlaneClass::loop()
+{
+    TaskMonitor.addScheduler(controlScheduler);
+
+    while (true) {
+        controlScheduler.execute();
+
+        // blocks for a tick after every pass, even if tasks are still due.
+        // several control plane tasks run at TASK_IMMEDIATE, so execute()
+        // never reports an idle pass, and merely yielding would starve the
+        // idle task and all tasks of lower priority on this core.
+        vTaskDelay(1);
+    }
+}
@@ -4,6 +4,24 @@
 
 SerialPortManagerClass SerialPortManager;
 
+// counts the bytes the owner reads, as the UART driver does not
+class SerialPortManagerClass::CountingSerial : public HardwareSerial {
+public:
+    CountingSerial(uint8_t port, Counters& counters)
+        : HardwareSerial(port)
+        , _counters(counters) { }
+
+    int read() override
+    {
+        int res = HardwareSerial::read();
+        if (res >= 0) { ++_counters.RxBytes; }
+        return res;
+    }
+
+private:
+    Counters& _counters;
+};
+
 void SerialPortManagerClass::init()
 {
     if (ARDUINO_USB_CDC_ON_BOOT != 1) {
@@ -13,7 +31,8 @@ void SerialPortManagerClass::init()
     }
 }
 
-std::optional<uint8_t> SerialPortManagerClass::allocatePort(std::string const& owner)
+std::optional<uint8_t> SerialPortManagerClass::allocatePort(std::string const& owner,
+        size_t rxBufferSize)
 {
     for (size_t i = 0; i < _ports.size(); ++i) {
         if (_ports[i] != "") {
@@ -23,9 +42,18 @@ std::optional<uint8_t> SerialPortManagerClass::allocatePort(std::string const& o
         }
 
         _ports[i] = owner;
+        _rxBufferSizes[i] = rxBufferSize;
+
+        auto& counters = _counters[i];
+        counters.RxBytes = 0;
+        counters.Overruns = 0;
+        counters.FramingErrors = 0;
+        counters.ParityErrors = 0;
+        counters.Breaks = 0;
 
         MessageOutput.printf("[SerialPortManager] HW UART %d now in use "
-                "by '%s'\r\n", i, owner.c_str());
+                "by '%s' (RX buffer %u bytes)\r\n", i, owner.c_str(),
+                rxBufferSize);
 
         return i;
     }
@@ -47,6 +75,69 @@ void SerialPortManagerClass::freePort(std::string const& owner)
     }
 }
 
+std::unique_ptr<HardwareSerial> SerialPortManagerClass::createSerial(uint8_t port)
+{
+    auto upSerial = std::make_unique<CountingSerial>(port, _counters[port]);
+
+    // must be set before begin() is called
+    upSerial->setRxBufferSize(_rxBufferSizes[port]);
+
+    // registering the callback makes the driver's event task process the
+    // UART events, which also moves received data into the ring buffer
+    // right away rather than when the owner reads.
+    upSerial->onReceiveError([this, port](hardwareSerial_error_t error) {
+        switch (error) {
+            case UART_BREAK_ERROR: countError(port, Error::Break); break;
+            case UART_BUFFER_FULL_ERROR:
+            case UART_FIFO_OVF_ERROR: countError(port, Error::Overrun); break;
+            case UART_FRAME_ERROR: countError(port, Error::Framing); break;
+            case UART_PARITY_ERROR: countError(port, Error::Parity); break;
+            default: break;
+        }
+    });
+
+    return upSerial;
+}
+
+size_t SerialPortManagerClass::getRxBufferSize(uint8_t port) const
+{
+    if (port >= _num_controllers) { return _defaultRxBufferSize; }
+    return _rxBufferSizes[port];
+}
+
+void SerialPortManagerClass::countRx(uint8_t port, size_t bytes)
+{
+    if (port >= _num_controllers) { return; }
+    _counters[port].RxBytes += bytes;
+}
+
+void SerialPortManagerClass::countError(uint8_t port, Error error)
+{
+    if (port >= _num_controllers) { return; }
+
+    auto& counters = _counters[port];
+    switch (error) {
+        case Error::Overrun: ++counters.Overruns; break;
+        case Error::Framing: ++counters.FramingErrors; break;
+        case Error::Parity: ++counters.ParityErrors; break;
+        case Error::Break: ++counters.Breaks; break;
+    }
+}
+
+std::optional<SerialPortManagerClass::Stats> SerialPortManagerClass::getStats(uint8_t port) const
+{
+    if (port >= _num_controllers || _ports[port] == "") { return std::nullopt; }
+
+    auto const& counters = _counters[port];
+    return Stats {
+        counters.RxBytes,
+        counters.Overruns,
+        counters.FramingErrors,
+        counters.ParityErrors,
+        counters.Breaks
+    };
+}
+
 SerialPortManagerClass::allocations_t SerialPortManagerClass::getAllocations() const
 {
     allocations_t res;
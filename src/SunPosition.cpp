@@ -3,16 +3,15 @@
  * Copyright (C) 2023-2024 Thomas Basler and others
  */
 #include "SunPosition.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
 #include "Utils.h"
 #include <Arduino.h>
 
-#define CALC_UNIQUE_ID (((timeinfo.tm_year << 9) | (timeinfo.tm_mon << 5) | timeinfo.tm_mday) << 1 | timeinfo.tm_isdst)
-
 SunPositionClass SunPosition;
 
 SunPositionClass::SunPositionClass()
-    : _loopTask(5 * TASK_SECOND, TASK_FOREVER, std::bind(&SunPositionClass::loop, this))
+    : _loopTask(5 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("SunPosition::loop", std::bind(&SunPositionClass::loop, this)))
 {
 }
 
@@ -24,27 +23,45 @@ void SunPositionClass::init(Scheduler& scheduler)
 
 void SunPositionClass::loop()
 {
-    if (_doRecalc || checkRecalcDayChanged()) {
+    // the day changed if the local midnight passed, which includes the time
+    // being synchronized for the first time.
+    if (_doRecalc || time(nullptr) >= getEvents().DayEnd) {
         updateSunData();
     }
 }
 
+SunPositionClass::EventTable SunPositionClass::getEvents() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _events;
+}
+
 bool SunPositionClass::isDayPeriod() const
 {
-    if (!_isValidInfo) {
+    auto events = getEvents();
+    if (!events.IsValidInfo) {
         return true;
     }
 
-    struct tm timeinfo;
-    getLocalTime(&timeinfo, 5);
-    const uint32_t minutesPastMidnight = timeinfo.tm_hour * 60 + timeinfo.tm_min;
-    return (minutesPastMidnight >= _sunriseMinutes) && (minutesPastMidnight < _sunsetMinutes);
+    const time_t now = time(nullptr);
+    return (now >= events.Sunrise) && (now < events.Sunset);
+}
+
+bool SunPositionClass::isSunriseWithin(const uint32_t seconds) const
+{
+    auto events = getEvents();
+    if (!events.IsValidInfo) {
+        return false;
+    }
+
+    const time_t now = time(nullptr);
+    return (now < events.Sunrise) && (events.Sunrise - now <= static_cast<time_t>(seconds));
 }
 
 // Returns if sunset/sunrise exists (e.g. in norway sunset/sunrise don't happen in summer months)
 bool SunPositionClass::isSunsetAvailable() const
 {
-    return _isSunsetAvailable;
+    return getEvents().IsSunsetAvailable;
 }
 
 void SunPositionClass::setDoRecalc(const bool doRecalc)
@@ -52,32 +69,33 @@ void SunPositionClass::setDoRecalc(const bool doRecalc)
     _doRecalc = doRecalc;
 }
 
-bool SunPositionClass::checkRecalcDayChanged() const
-{
-    time_t now;
-    struct tm timeinfo;
-
-    time(&now);
-    localtime_r(&now, &timeinfo); // don't use getLocalTime() as there could be a delay of 10ms
-
-    const uint32_t ymd = CALC_UNIQUE_ID;
-
-    return _lastSunPositionCalculatedYMD != ymd;
-}
-
 void SunPositionClass::updateSunData()
 {
     struct tm timeinfo;
     const bool gotLocalTime = getLocalTime(&timeinfo, 5);
 
-    _lastSunPositionCalculatedYMD = CALC_UNIQUE_ID;
     setDoRecalc(false);
 
+    EventTable events;
+
+    // the given minutes past the local midnight of today
+    time_t now = time(nullptr);
+    auto getLocalMinutes = [now](int minutes) -> time_t {
+        struct tm tm;
+        localtime_r(&now, &tm);
+        tm.tm_sec = 0;
+        tm.tm_min = minutes;
+        tm.tm_hour = 0;
+        tm.tm_isdst = -1;
+        return mktime(&tm);
+    };
+
+    events.DayStart = getLocalMinutes(0);
+    events.DayEnd = getLocalMinutes(24 * 60);
+
     if (!gotLocalTime) {
-        _sunriseMinutes = 0;
-        _sunsetMinutes = 0;
-        _isSunsetAvailable = true;
-        _isValidInfo = false;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _events = events;
         return;
     }
 
@@ -111,44 +129,34 @@ void SunPositionClass::updateSunData()
     // If no sunset/sunrise exists (e.g. astronomical calculation in summer)
     // assume it's day period
     if (std::isnan(sunriseRaw) || std::isnan(sunsetRaw)) {
-        _sunriseMinutes = 0;
-        _sunsetMinutes = 0;
-        _isSunsetAvailable = false;
-        _isValidInfo = false;
-        return;
+        events.IsSunsetAvailable = false;
+    } else {
+        events.Sunrise = getLocalMinutes(static_cast<int>(sunriseRaw));
+        events.Sunset = getLocalMinutes(static_cast<int>(sunsetRaw));
+        events.IsValidInfo = true;
     }
 
-    _sunriseMinutes = static_cast<int>(sunriseRaw);
-    _sunsetMinutes = static_cast<int>(sunsetRaw);
-
-    _isSunsetAvailable = true;
-    _isValidInfo = true;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _events = events;
 }
 
-bool SunPositionClass::getSunTime(struct tm* info, const uint32_t offset) const
+bool SunPositionClass::getSunTime(struct tm* info, time_t event) const
 {
-    // Get today's date
-    time_t aTime = time(NULL);
-
-    // Set the time to midnight
-    struct tm tm;
-    localtime_r(&aTime, &tm);
-    tm.tm_sec = 0;
-    tm.tm_min = offset;
-    tm.tm_hour = 0;
-    tm.tm_isdst = -1;
-    const time_t midnight = mktime(&tm);
-
-    localtime_r(&midnight, info);
-    return _isValidInfo;
+    auto events = getEvents();
+
+    // without valid info, the event is reported as midnight of today
+    if (!events.IsValidInfo) { event = events.DayStart; }
+
+    localtime_r(&event, info);
+    return events.IsValidInfo;
 }
 
 bool SunPositionClass::sunsetTime(struct tm* info) const
 {
-    return getSunTime(info, _sunsetMinutes);
+    return getSunTime(info, getEvents().Sunset);
 }
 
 bool SunPositionClass::sunriseTime(struct tm* info) const
 {
-    return getSunTime(info, _sunriseMinutes);
+    return getSunTime(info, getEvents().Sunrise);
 }
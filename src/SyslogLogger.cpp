@@ -3,15 +3,16 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include <HardwareSerial.h>
-#include <ESPmDNS.h>
+#include "TaskMonitor.h"
 #include "defaults.h"
 #include "SyslogLogger.h"
 #include "Configuration.h"
+#include "DnsCache.h"
 #include "MessageOutput.h"
 #include "NetworkSettings.h"
 
 SyslogLogger::SyslogLogger()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&SyslogLogger::loop, this))
+    : _loopTask(_flushIntervalMillis * TASK_MILLISECOND, TASK_FOREVER, TaskMonitor.wrap("SyslogLogger::loop", std::bind(&SyslogLogger::loop, this)))
 {
 }
 
@@ -64,19 +65,70 @@ void SyslogLogger::write(const uint8_t *buffer, size_t size)
     }
     for (int i = 0; i < size; i++) {
         uint8_t c = buffer[i];
-        bool overflow = false;
         if (c != '\r' && c != '\n') {
             // Replace control and non-ASCII characters with '?'.
-            overflow = !_udp.write(c >= 0x20 && c < 0x7f ? c : '?');
+            _line[_lineLength++] = (c >= 0x20 && c < 0x7f) ? c : '?';
         }
-        if (c == '\n' || overflow) {
-            _udp.endPacket();
-            _udp.beginPacket(_address, _port);
-            _udp.print(_header);
+        if (c == '\n' || _lineLength == _line.size()) {
+            appendFrame(_line.data(), _lineLength);
+            _lineLength = 0;
         }
     }
 }
 
+void SyslogLogger::appendFrame(char const* message, size_t length)
+{
+    // frame: MSG-LEN SP SYSLOG-MSG, where SYSLOG-MSG is header and message
+    size_t msgLength = _header.length() + length;
+    char prefix[8];
+    size_t prefixLength = snprintf(prefix, sizeof(prefix), "%u ", msgLength);
+    size_t frameLength = prefixLength + msgLength;
+
+    if (_datagramLength + frameLength > _datagram.size()) { flush(); }
+
+    if (frameLength > _datagram.size()) {
+        ++_droppedFrames;
+        return;
+    }
+
+    char* dst = _datagram.data() + _datagramLength;
+    memcpy(dst, prefix, prefixLength);
+    dst += prefixLength;
+    memcpy(dst, _header.c_str(), _header.length());
+    dst += _header.length();
+    memcpy(dst, message, length);
+
+    _datagramLength += frameLength;
+    ++_datagramFrames;
+}
+
+void SyslogLogger::flush()
+{
+    if (_datagramLength == 0) { return; }
+
+    bool sent = _udp.beginPacket(_address, _port)
+        && _udp.write(reinterpret_cast<uint8_t const*>(_datagram.data()), _datagramLength) == _datagramLength
+        && _udp.endPacket();
+
+    if (!sent) { _droppedFrames += _datagramFrames; }
+
+    _datagramLength = 0;
+    _datagramFrames = 0;
+}
+
+void SyslogLogger::reportDropped(uint32_t dropped)
+{
+    // rate limited, as the report itself is sent to the syslog host as well
+    if (dropped == _reportedDroppedFrames || millis() - _lastDropReport < 10 * 1000) {
+        return;
+    }
+
+    MessageOutput.printf("[SyslogLogger] %u messages dropped\r\n",
+            dropped - _reportedDroppedFrames);
+    _reportedDroppedFrames = dropped;
+    _lastDropReport = millis();
+}
+
 void SyslogLogger::disable()
 {
     MessageOutput.println("[SyslogLogger] Disable");
@@ -84,6 +136,9 @@ void SyslogLogger::disable()
     if (_enabled) {
         _enabled = false;
         _address = INADDR_NONE;
+        _lineLength = 0;
+        _datagramLength = 0;
+        _datagramFrames = 0;
         _udp.stop();
     }
 }
@@ -102,37 +157,35 @@ void SyslogLogger::enable()
 
 bool SyslogLogger::resolveAndStart()
 {
-    if (Configuration.get().Mdns.Enabled) {
-        _address = MDNS.queryHost(_syslog_hostname); // INADDR_NONE if failed
-    }
-    if (_address != INADDR_NONE) {
-        if (!_udp.beginPacket(_address, _port)) {
-            return false;
-        }
-    } else {
-        if (!_udp.beginPacket(_syslog_hostname.c_str(), _port)) {
-            return false;
-        }
-        _address = _udp.remoteIP();  // Store resolved address.
+    if (!DnsCache.resolve(_syslog_hostname, _address)) {
+        return false;
     }
-    _udp.print(_header);
-    _udp.print("[SyslogLogger] Logging to ");
-    _udp.print(_syslog_hostname);
-    _udp.endPacket();
-    _udp.beginPacket(_address, _port);
-    _udp.print(_header);
+    String message = "[SyslogLogger] Logging to " + _syslog_hostname;
+    appendFrame(message.c_str(), message.length());
     return true;
 }
 
 void SyslogLogger::loop()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    if (!_enabled || !NetworkSettings.isConnected() || isResolved()) {
-        return;
-    }
-    if (!resolveAndStart()) {
-        _enabled = false;
+    uint32_t dropped;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_enabled) { return; }
+
+        if (isResolved()) {
+            // follows the cached address as it is refreshed
+            DnsCache.lookup(_syslog_hostname, _address);
+            flush();
+        } else if (NetworkSettings.isConnected() && !resolveAndStart()) {
+            _enabled = false;
+        }
+
+        dropped = _droppedFrames;
     }
+
+    // outside the lock, as the message is written to the syslog as well
+    reportDropped(dropped);
 }
 
 SyslogLogger Syslog;
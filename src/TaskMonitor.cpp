@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "TaskMonitor.h"
+#include "MessageOutput.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+TaskMonitorClass TaskMonitor;
+
+void TaskMonitorClass::init(Scheduler& scheduler)
+{
+    addScheduler(scheduler);
+
+    uint32_t constexpr stackSize = 2048;
+    if (pdPASS != xTaskCreate(TaskMonitorClass::watchdogLoopHelper,
+                "TaskWatchdog", stackSize, this, 1/*prio*/, nullptr)) {
+        MessageOutput.print("[TaskMonitor] failed to start watchdog task\r\n");
+    }
+}
+
+void TaskMonitorClass::addScheduler(Scheduler& scheduler)
+{
+    size_t idx = _planeCount;
+    if (idx >= _maxPlanes) { return; }
+
+    _planes[idx].pScheduler = &scheduler;
+    _planes[idx].Handle = xTaskGetCurrentTaskHandle();
+    _planeCount = idx + 1;
+}
+
+TaskMonitorClass::Plane* TaskMonitorClass::getPlane()
+{
+    TaskHandle_t handle = xTaskGetCurrentTaskHandle();
+    for (size_t idx = 0; idx < _planeCount; ++idx) {
+        if (_planes[idx].Handle == handle) { return &_planes[idx]; }
+    }
+    return nullptr;
+}
+
+TaskCallback TaskMonitorClass::wrap(char const* name, TaskCallback callback)
+{
+    size_t idx = _count.fetch_add(1);
+    if (idx >= _maxTasks) {
+        _count = _maxTasks;
+        return callback;
+    }
+
+    _entries[idx].Name = name;
+
+    return [this, idx, callback]() { execute(idx, callback); };
+}
+
+void TaskMonitorClass::execute(size_t idx, TaskCallback const& callback)
+{
+    // the lateness is the delay between the point in time the task was
+    // scheduled to run and the actual start of this invocation.
+    long lateness = 0;
+    Plane* pPlane = getPlane();
+    if (pPlane != nullptr) {
+        lateness = pPlane->pScheduler->currentTask().getStartDelay();
+        pPlane->CurrentStartMillis = millis();
+        pPlane->Current = static_cast<int>(idx);
+    }
+
+    int64_t start = esp_timer_get_time();
+    callback();
+    uint32_t duration = static_cast<uint32_t>(esp_timer_get_time() - start);
+
+    if (pPlane != nullptr) { pPlane->Current = _noTask; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& entry = _entries[idx];
+    ++entry.Invocations;
+    entry.TotalMicros += duration;
+    entry.LastMicros = duration;
+    entry.MaxMicros = std::max(entry.MaxMicros, duration);
+    if (lateness > 0) {
+        entry.MaxLatenessMillis = std::max(entry.MaxLatenessMillis, static_cast<uint32_t>(lateness));
+    }
+    if (duration > OverrunThresholdMillis * 1000) { ++entry.Overruns; }
+}
+
+void TaskMonitorClass::watchdogLoopHelper(void* context)
+{
+    auto pInstance = static_cast<TaskMonitorClass*>(context);
+    pInstance->watchdogLoop();
+}
+
+void TaskMonitorClass::watchdogLoop()
+{
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(OverrunThresholdMillis));
+
+        // report tasks which are still running, i.e., which block their
+        // scheduler at this very moment.
+        for (size_t p = 0; p < _planeCount; ++p) {
+            auto& plane = _planes[p];
+            int current = plane.Current;
+            uint32_t start = plane.CurrentStartMillis;
+            uint32_t running = millis() - start;
+            if (current != _noTask && running > OverrunThresholdMillis &&
+                    (current != plane.ReportedTask || start != plane.ReportedStart)) {
+                MessageOutput.printf("[TaskMonitor] task %s is running for %u ms\r\n",
+                        _entries[current].Name, running);
+                plane.ReportedTask = current;
+                plane.ReportedStart = start;
+            }
+        }
+
+        // report overruns of completed invocations
+        size_t count = std::min(_count.load(), _maxTasks);
+        for (size_t idx = 0; idx < count; ++idx) {
+            uint32_t overruns;
+            uint32_t lastMicros;
+            uint32_t maxMicros;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                overruns = _entries[idx].Overruns;
+                lastMicros = _entries[idx].LastMicros;
+                maxMicros = _entries[idx].MaxMicros;
+            }
+
+            if (overruns == _reportedOverruns[idx]) { continue; }
+
+            MessageOutput.printf("[TaskMonitor] task %s overran %u time(s), "
+                    "last run %u ms, max %u ms\r\n", _entries[idx].Name,
+                    overruns - _reportedOverruns[idx], lastMicros / 1000,
+                    maxMicros / 1000);
+            _reportedOverruns[idx] = overruns;
+        }
+    }
+}
+
+std::vector<TaskMonitorClass::TaskStats> TaskMonitorClass::getStats() const
+{
+    std::vector<TaskStats> res;
+
+    size_t count = std::min(_count.load(), _maxTasks);
+    res.reserve(count);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t idx = 0; idx < count; ++idx) {
+        auto const& entry = _entries[idx];
+        res.push_back({ entry.Name, entry.Invocations, entry.TotalMicros,
+                entry.MaxMicros, entry.MaxLatenessMillis, entry.Overruns });
+    }
+
+    return res;
+}
+
+void TaskMonitorClass::serialize(JsonArray& target) const
+{
+    for (auto const& stats : getStats()) {
+        JsonObject obj = target.add<JsonObject>();
+        obj["name"] = stats.Name;
+        obj["invocations"] = stats.Invocations;
+        obj["total_us"] = stats.TotalMicros;
+        obj["max_us"] = stats.MaxMicros;
+        obj["max_lateness_ms"] = stats.MaxLatenessMillis;
+        obj["overruns"] = stats.Overruns;
+    }
+}
@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "TelemetryStream.h"
+#include "Battery.h"
+#include "Configuration.h"
+#include "Datastore.h"
+#include "MessageOutput.h"
+#include "NetworkSettings.h"
+#include "PowerLimiter.h"
+#include "PowerMeter.h"
+#include "TaskMonitor.h"
+#include <ESPmDNS.h>
+#include <cmath>
+#include <cstring>
+
+TelemetryStreamClass TelemetryStream;
+
+static constexpr char sMagic[4] = { 'O', 'D', 'T', 'T' };
+
+// the values sent per channel, depending on the channel type
+static constexpr FieldId_t sChannelFields[][5] = {
+    { FLD_PAC, FLD_UAC, FLD_IAC, FLD_F, FLD_PF }, // TYPE_AC
+    { FLD_PDC, FLD_UDC, FLD_IDC, FLD_YD, FLD_YT }, // TYPE_DC
+    { FLD_PDC, FLD_YD, FLD_YT, FLD_T, FLD_EFF }, // TYPE_INV
+};
+
+void TelemetryStreamClass::init(Scheduler& scheduler)
+{
+    _datagram.reserve(_maxDatagramSize);
+
+    scheduler.addTask(_loopTask);
+    _loopTask.setCallback(TaskMonitor.wrap("TelemetryStream::loop", std::bind(&TelemetryStreamClass::loop, this)));
+    _loopTask.setIterations(TASK_FOREVER);
+    _loopTask.setInterval(TELEMETRY_INTERVAL * TASK_MILLISECOND);
+    _loopTask.enable();
+}
+
+void TelemetryStreamClass::loop()
+{
+    auto const& config = Configuration.get().Telemetry;
+
+    _loopTask.setInterval(std::max<uint32_t>(config.Interval, 100) * TASK_MILLISECOND);
+
+    if (!config.Enabled || !NetworkSettings.isConnected()) {
+        if (_started) {
+            _udp.stop();
+            _started = false;
+        }
+        return;
+    }
+
+    // settings changed, the collector is resolved again
+    if (_hostname != config.Hostname || _port != config.Port) {
+        _hostname = config.Hostname;
+        _port = config.Port;
+        _address = INADDR_NONE;
+    }
+
+    if (_address == INADDR_NONE && !resolve()) { return; }
+
+    if (!_started) {
+        // bind random source port
+        if (!_udp.begin(0)) {
+            MessageOutput.println("[TelemetryStream] No sockets available");
+            return;
+        }
+        _started = true;
+    }
+
+    send();
+}
+
+bool TelemetryStreamClass::resolve()
+{
+    if (_hostname.isEmpty()) { return false; }
+
+    if (Configuration.get().Mdns.Enabled) {
+        _address = MDNS.queryHost(_hostname); // INADDR_NONE if failed
+    }
+
+    if (_address == INADDR_NONE && !WiFi.hostByName(_hostname.c_str(), _address)) {
+        MessageOutput.printf("[TelemetryStream] Cannot resolve %s\r\n", _hostname.c_str());
+        _address = INADDR_NONE;
+        return false;
+    }
+
+    MessageOutput.printf("[TelemetryStream] Sending to %s:%u\r\n",
+            _address.toString().c_str(), _port);
+    return true;
+}
+
+void TelemetryStreamClass::putFloat(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    putUint(bits, sizeof(bits));
+}
+
+void TelemetryStreamClass::putUint(uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i) {
+        _record.push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+void TelemetryStreamClass::beginRecord(Record type)
+{
+    _record.clear();
+    _record.push_back(static_cast<uint8_t>(type));
+    _record.push_back(0); // length, set by endRecord()
+}
+
+void TelemetryStreamClass::endRecord()
+{
+    if (_record.size() > 255) { return; } // programmer error, never sent
+
+    _record[1] = _record.size();
+
+    if (_datagram.size() + _record.size() > _maxDatagramSize || _recordCount == 255) {
+        flush();
+    }
+
+    if (_datagram.empty()) {
+        _datagram.insert(_datagram.end(), sMagic, sMagic + sizeof(sMagic));
+        _datagram.push_back(SchemaVersion);
+        _datagram.push_back(0); // record count, set by flush()
+        _datagram.push_back(0); // reserved
+        _datagram.push_back(0);
+
+        uint32_t const values[] = { _sequence++, millis() };
+        for (auto value : values) {
+            for (size_t i = 0; i < sizeof(value); ++i) {
+                _datagram.push_back((value >> (8 * i)) & 0xFF);
+            }
+        }
+    }
+
+    _datagram.insert(_datagram.end(), _record.begin(), _record.end());
+    ++_recordCount;
+}
+
+void TelemetryStreamClass::flush()
+{
+    if (_datagram.empty()) { return; }
+
+    _datagram[5] = _recordCount;
+
+    if (_udp.beginPacket(_address, _port)) {
+        _udp.write(_datagram.data(), _datagram.size());
+        _udp.endPacket();
+    }
+
+    _datagram.clear();
+    _recordCount = 0;
+}
+
+void TelemetryStreamClass::addInverterRecord(std::shared_ptr<InverterAbstract> const& inv)
+{
+    auto stats = inv->Statistics();
+
+    beginRecord(Record::Inverter);
+    putUint(inv->serial(), 8);
+    _record.push_back((inv->isReachable() ? 0x01 : 0) | (inv->isProducing() ? 0x02 : 0));
+    putUint(stats->getLastUpdate() > 0 ? millis() - stats->getLastUpdate() : UINT32_MAX, 4);
+    putFloat(inv->SystemConfigPara()->getLimitPercent());
+
+    size_t countOffset = _record.size();
+    _record.push_back(0);
+
+    uint8_t count = 0;
+    for (auto& type : stats->getChannelTypes()) {
+        if (type > TYPE_INV) { continue; }
+
+        for (auto& channel : stats->getChannelsByType(type)) {
+            _record.push_back(type);
+            _record.push_back(channel);
+            for (auto field : sChannelFields[type]) {
+                putFloat(stats->hasChannelFieldValue(type, channel, field)
+                        ? stats->getChannelFieldValue(type, channel, field) : NAN);
+            }
+            ++count;
+        }
+    }
+
+    _record[countOffset] = count;
+    endRecord();
+}
+
+void TelemetryStreamClass::send()
+{
+    beginRecord(Record::Totals);
+    putFloat(Datastore.getTotalAcPowerEnabled());
+    putFloat(Datastore.getTotalAcYieldDayEnabled());
+    putFloat(Datastore.getTotalAcYieldTotalEnabled());
+    putFloat(Datastore.getTotalDcPowerEnabled());
+    _record.push_back((Datastore.getIsAllEnabledReachable() ? 0x01 : 0)
+            | (Datastore.getIsAtLeastOneProducing() ? 0x02 : 0));
+    endRecord();
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); ++i) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv != nullptr) { addInverterRecord(inv); }
+    }
+
+    auto const& config = Configuration.get();
+
+    if (config.Battery.Enabled) {
+        auto spStats = Battery.getStats();
+        beginRecord(Record::Battery);
+        putFloat(spStats->isSoCValid() ? spStats->getSoC() : NAN);
+        putFloat(spStats->isVoltageValid() ? spStats->getVoltage() : NAN);
+        putFloat(spStats->isCurrentValid() ? spStats->getChargeCurrent() : NAN);
+        putUint(spStats->getAgeSeconds(), 4);
+        endRecord();
+    }
+
+    if (config.PowerMeter.Enabled) {
+        beginRecord(Record::PowerMeter);
+        putFloat(PowerMeter.getPowerTotal());
+        putUint(millis() - PowerMeter.getLastUpdate(), 4);
+        _record.push_back(PowerMeter.isDataValid() ? 1 : 0);
+        endRecord();
+    }
+
+    if (config.PowerLimiter.Enabled) {
+        beginRecord(Record::PowerLimiter);
+        _record.push_back(PowerLimiter.getPowerLimiterState());
+        _record.push_back(static_cast<uint8_t>(PowerLimiter.getMode()));
+        putUint(PowerLimiter.getInverterOutput(), 2);
+        _record.push_back(PowerLimiter.getInverterUpdateTimeouts());
+        endRecord();
+    }
+
+    flush();
+}
@@ -0,0 +1,582 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "TimeSeries.h"
+#include "TaskMonitor.h"
+#include "Battery.h"
+#include "Configuration.h"
+#include "Datastore.h"
+#include "FsWriteMonitor.h"
+#include "MessageOutput.h"
+#include "PowerMeter.h"
+#include <solarcharger/Controller.h>
+#include <Hoymiles.h>
+#include <LittleFS.h>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+#define TIMESERIES_DIRECTORY "/ts"
+
+// free space on the file system which is left for other files
+#define TIMESERIES_FS_RESERVE (48 * 1024)
+
+TimeSeriesClass TimeSeries;
+
+namespace {
+
+uint32_t zigzagEncode(int32_t value)
+{
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+int32_t zigzagDecode(uint32_t value)
+{
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+// writes the value as varint and returns the number of bytes written
+size_t writeVarint(uint8_t* buffer, uint32_t value)
+{
+    size_t len = 0;
+    while (value >= 0x80) {
+        buffer[len++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    buffer[len++] = static_cast<uint8_t>(value);
+    return len;
+}
+
+// reads a varint starting at pos, which is advanced. returns false if the
+// varint is truncated.
+bool readVarint(uint8_t const* buffer, size_t length, size_t& pos, uint32_t& value)
+{
+    value = 0;
+    for (uint8_t shift = 0; shift < 35 && pos < length; shift += 7) {
+        uint8_t byte = buffer[pos++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) { return true; }
+    }
+    return false;
+}
+
+constexpr size_t MaxVarintLength = 5;
+
+template<typename T>
+void appendLittleEndian(std::vector<uint8_t>& target, T value)
+{
+    auto bytes = reinterpret_cast<uint8_t const*>(&value);
+    target.insert(target.end(), bytes, bytes + sizeof(value));
+}
+
+}; // namespace
+
+TimeSeriesClass::TimeSeriesClass()
+    : _loopTask(TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("TimeSeries::loop", std::bind(&TimeSeriesClass::loop, this)))
+{
+}
+
+void TimeSeriesClass::init(Scheduler& scheduler)
+{
+    if (!LittleFS.exists(TIMESERIES_DIRECTORY)) {
+        LittleFS.mkdir(TIMESERIES_DIRECTORY);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        addSeries("ac_power", "W", 1, []() -> std::optional<float> {
+            return Datastore.getTotalAcPowerEnabled();
+        });
+
+        addSeries("dc_power", "W", 1, []() -> std::optional<float> {
+            return Datastore.getTotalDcPowerEnabled();
+        });
+
+        addSeries("yield_day", "Wh", 1, []() -> std::optional<float> {
+            return Datastore.getTotalAcYieldDayEnabled();
+        });
+
+        addSeries("grid_power", "W", 1, []() -> std::optional<float> {
+            if (!PowerMeter.isDataValid()) { return std::nullopt; }
+            return PowerMeter.getPowerTotalRaw();
+        });
+
+        auto batteryValue = [](std::function<float(BatteryStats const&)> getter) {
+            return [getter]() -> std::optional<float> {
+                if (!Configuration.get().Battery.Enabled) { return std::nullopt; }
+                auto spStats = Battery.getStats();
+                if (spStats->getAgeSeconds() > 60) { return std::nullopt; }
+                return getter(*spStats);
+            };
+        };
+
+        addSeries("battery_soc", "%", 10, batteryValue(
+            [](BatteryStats const& stats) { return stats.getSoC(); }));
+
+        addSeries("battery_voltage", "V", 100, batteryValue(
+            [](BatteryStats const& stats) { return stats.getVoltage(); }));
+
+        addSeries("battery_current", "A", 100, batteryValue(
+            [](BatteryStats const& stats) { return stats.getChargeCurrent(); }));
+
+        addSeries("solarcharger_power", "W", 1, []() -> std::optional<float> {
+            if (!Configuration.get().SolarCharger.Enabled) { return std::nullopt; }
+            return SolarCharger.getStats()->getOutputPowerWatts();
+        });
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+uint32_t TimeSeriesClass::getTierInterval(uint8_t tier)
+{
+    switch (tier) {
+        case 0:
+            return 10;
+        case 1:
+            return 60;
+        default:
+            return 15 * 60;
+    }
+}
+
+// a segment holds 60 to 120 samples. tier 0 thus covers about an hour, tier 1
+// about a day and tier 2 about three days. all slots of a series add up to
+// 4 kB, which is the block size of the file system.
+size_t TimeSeriesClass::getSlotCount(uint8_t tier)
+{
+    switch (tier) {
+        case 0:
+            return 4;
+        case 1:
+            return 24;
+        default:
+            return 4;
+    }
+}
+
+size_t TimeSeriesClass::getSlotOffset(uint8_t tier)
+{
+    size_t offset = 0;
+    for (uint8_t t = 0; t < tier; ++t) { offset += getSlotCount(t); }
+    return offset;
+}
+
+void TimeSeriesClass::addSeries(String const& key, char const* unit, float scale, getter_t getter)
+{
+    auto upSeries = std::make_unique<Series>();
+    upSeries->Key = key;
+    upSeries->Unit = unit;
+    upSeries->Scale = scale;
+    upSeries->Getter = std::move(getter);
+
+    for (uint8_t t = 0; t < TierCount; ++t) {
+        upSeries->Tiers[t].Slot = findNextSlot(getFilename(*upSeries), t);
+    }
+
+    _series.push_back(std::move(upSeries));
+}
+
+void TimeSeriesClass::addMissingSeries()
+{
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); ++i) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) { continue; }
+
+        String prefix = inv->serialString();
+        auto exists = std::any_of(_series.begin(), _series.end(),
+                [&prefix](auto const& upSeries) { return upSeries->Key == prefix + "_ac_power"; });
+        if (exists) { continue; }
+
+        auto inverterValue = [](uint64_t serial, ChannelType_t type, FieldId_t field) {
+            return [serial, type, field]() -> std::optional<float> {
+                auto inv = Hoymiles.getInverterBySerial(serial);
+                if (inv == nullptr || inv->Statistics()->getLastUpdate() == 0) {
+                    return std::nullopt;
+                }
+                return inv->Statistics()->getChannelFieldValue(type, CH0, field);
+            };
+        };
+
+        addSeries(prefix + "_ac_power", "W", 1, inverterValue(inv->serial(), TYPE_AC, FLD_PAC));
+        addSeries(prefix + "_dc_power", "W", 1, inverterValue(inv->serial(), TYPE_INV, FLD_PDC));
+    }
+}
+
+void TimeSeriesClass::loop()
+{
+    // timestamps are stored as unix time, so we need valid time information
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) { return; }
+
+    uint32_t now = std::time(nullptr);
+    uint32_t timestamp = now - now % getTierInterval(0);
+    if (timestamp == _lastTimestamp) { return; }
+    _lastTimestamp = timestamp;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    addMissingSeries();
+
+    for (auto& upSeries : _series) {
+        addSample(*upSeries, timestamp, upSeries->Getter());
+    }
+
+    // persist the active segments from time to time, such that not more
+    // than a few minutes of data are lost on a restart.
+    if ((millis() - _lastPersist) > 15 * 60 * 1000) {
+        for (auto& upSeries : _series) {
+            for (uint8_t t = 0; t < TierCount; ++t) { persist(*upSeries, t, true); }
+        }
+        _lastPersist = millis();
+    }
+}
+
+void TimeSeriesClass::addSample(Series& series, uint32_t timestamp, std::optional<float> value)
+{
+    append(series, 0, timestamp, value);
+
+    // the coarser tiers store the average of all samples within their interval
+    for (uint8_t t = 1; t < TierCount; ++t) {
+        auto& tier = series.Tiers[t];
+        uint32_t bucketStart = timestamp - timestamp % getTierInterval(t);
+
+        if (bucketStart != tier.BucketStart) {
+            if (tier.BucketCount > 0) {
+                append(series, t, tier.BucketStart, tier.BucketSum / tier.BucketCount);
+            }
+
+            tier.BucketStart = bucketStart;
+            tier.BucketSum = 0;
+            tier.BucketCount = 0;
+        }
+
+        if (!value) { continue; }
+
+        tier.BucketSum += *value;
+        ++tier.BucketCount;
+    }
+}
+
+void TimeSeriesClass::append(Series& series, uint8_t tier, uint32_t timestamp, std::optional<float> value)
+{
+    auto& t = series.Tiers[tier];
+    auto& segment = t.Active;
+
+    // a gap in the data ends the segment, as the timestamps of the samples
+    // are implied by the segment's start time and the tier's interval.
+    if (!value) { return closeSegment(series, tier); }
+
+    if (segment.Count > 0) {
+        bool contiguous = timestamp == segment.Start + segment.Count * getTierInterval(tier);
+        bool full = segment.Length + MaxVarintLength > sizeof(segment.Data);
+        if (!contiguous || full) { closeSegment(series, tier); }
+    }
+
+    auto encoded = static_cast<int32_t>(std::lround(*value * series.Scale));
+
+    if (segment.Count == 0) {
+        segment.Start = timestamp;
+        segment.Length = writeVarint(segment.Data, zigzagEncode(encoded));
+    } else {
+        segment.Length += writeVarint(&segment.Data[segment.Length], zigzagEncode(encoded - t.LastValue));
+    }
+
+    t.LastValue = encoded;
+    ++segment.Count;
+    t.Dirty = true;
+}
+
+void TimeSeriesClass::closeSegment(Series& series, uint8_t tier)
+{
+    auto& t = series.Tiers[tier];
+    if (t.Active.Count == 0) { return; }
+
+    persist(series, tier);
+
+    t.Active = {};
+    t.Slot = (t.Slot + 1) % getSlotCount(tier);
+}
+
+void TimeSeriesClass::persist(Series& series, uint8_t tier, bool deferrable)
+{
+    auto& t = series.Tiers[tier];
+    if (!t.Dirty) { return; }
+
+    if (deferrable && !FsWriteMonitor.admit(FsWriteMonitorClass::Category::TimeSeries, sizeof(Segment))) {
+        return;
+    }
+
+    String filename = getFilename(series);
+
+    // the segment is kept in memory only if the file cannot be created
+    if (!LittleFS.exists(filename) && !createFile(filename)) { return; }
+
+    File f = LittleFS.open(filename, "r+");
+    if (!f) {
+        MessageOutput.printf("[TimeSeries] cannot open %s\r\n", filename.c_str());
+        return;
+    }
+
+    f.seek((getSlotOffset(tier) + t.Slot) * sizeof(Segment));
+    f.write(reinterpret_cast<uint8_t const*>(&t.Active), sizeof(Segment));
+    f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::TimeSeries, sizeof(Segment));
+
+    t.Dirty = false;
+}
+
+String TimeSeriesClass::getFilename(Series const& series)
+{
+    return String(TIMESERIES_DIRECTORY) + "/" + series.Key;
+}
+
+bool TimeSeriesClass::createFile(String const& filename)
+{
+    size_t fileSize = getSlotOffset(TierCount) * sizeof(Segment);
+    if (LittleFS.totalBytes() - LittleFS.usedBytes() < fileSize + TIMESERIES_FS_RESERVE) {
+        MessageOutput.printf("[TimeSeries] not enough space to create %s\r\n", filename.c_str());
+        return false;
+    }
+
+    File f = LittleFS.open(filename, "w", true);
+    if (!f) {
+        MessageOutput.printf("[TimeSeries] cannot create %s\r\n", filename.c_str());
+        return false;
+    }
+
+    Segment empty = {};
+    for (size_t i = 0; i < getSlotOffset(TierCount); ++i) {
+        f.write(reinterpret_cast<uint8_t const*>(&empty), sizeof(empty));
+    }
+    f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::TimeSeries, fileSize);
+
+    return true;
+}
+
+// returns the slot following the most recently written one
+size_t TimeSeriesClass::findNextSlot(String const& filename, uint8_t tier)
+{
+    File f = LittleFS.open(filename, "r", false);
+    if (!f) { return 0; }
+
+    size_t newestSlot = 0;
+    uint32_t newestStart = 0;
+    Segment segment;
+
+    f.seek(getSlotOffset(tier) * sizeof(Segment));
+    for (size_t i = 0; i < getSlotCount(tier); ++i) {
+        if (f.read(reinterpret_cast<uint8_t*>(&segment), sizeof(segment)) != sizeof(segment)) {
+            break;
+        }
+
+        if (segment.Start > newestStart) {
+            newestStart = segment.Start;
+            newestSlot = i;
+        }
+    }
+
+    f.close();
+
+    if (newestStart == 0) { return 0; }
+
+    return (newestSlot + 1) % getSlotCount(tier);
+}
+
+void TimeSeriesClass::decode(Segment const& segment, uint32_t interval, float scale,
+        std::function<void(uint32_t, float)> callback)
+{
+    size_t pos = 0;
+    int32_t value = 0;
+    size_t length = std::min<size_t>(segment.Length, sizeof(segment.Data));
+
+    for (uint16_t i = 0; i < segment.Count; ++i) {
+        uint32_t raw;
+        if (!readVarint(segment.Data, length, pos, raw)) { return; }
+
+        value = (i == 0) ? zigzagDecode(raw) : value + zigzagDecode(raw);
+        callback(segment.Start + i * interval, value / scale);
+    }
+}
+
+void TimeSeriesClass::serializeSeries(JsonArray& target) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto const& upSeries : _series) {
+        JsonObject obj = target.add<JsonObject>();
+        obj["key"] = upSeries->Key;
+        obj["unit"] = upSeries->Unit;
+    }
+}
+
+TimeSeriesClass::Series const* TimeSeriesClass::findSeries(String const& key) const
+{
+    auto it = std::find_if(_series.begin(), _series.end(),
+            [&key](auto const& upSeries) { return upSeries->Key == key; });
+    if (it == _series.end()) { return nullptr; }
+    return it->get();
+}
+
+// returns the persisted segments and the active segment of the given tier
+// which overlap with [from, to], sorted by their start time.
+MemoryPolicy::BulkVector<TimeSeriesClass::Segment> TimeSeriesClass::loadSegments(Series const& series,
+        uint8_t tier, uint32_t from, uint32_t to)
+{
+    auto const& t = series.Tiers[tier];
+    uint32_t interval = getTierInterval(tier);
+
+    MemoryPolicy::BulkVector<Segment> segments;
+
+    File f = LittleFS.open(getFilename(series), "r", false);
+    if (f) {
+        Segment segment;
+        f.seek(getSlotOffset(tier) * sizeof(Segment));
+        for (size_t i = 0; i < getSlotCount(tier); ++i) {
+            if (f.read(reinterpret_cast<uint8_t*>(&segment), sizeof(segment)) != sizeof(segment)) {
+                break;
+            }
+
+            // the slot of the active segment may hold an outdated copy of it
+            if (i == t.Slot || segment.Count == 0) { continue; }
+
+            // skip segments which do not overlap with the requested range
+            if (segment.Start > to || segment.Start + segment.Count * interval < from) { continue; }
+
+            segments.push_back(segment);
+        }
+        f.close();
+    }
+
+    if (t.Active.Count > 0) { segments.push_back(t.Active); }
+
+    std::sort(segments.begin(), segments.end(),
+            [](Segment const& a, Segment const& b) { return a.Start < b.Start; });
+
+    return segments;
+}
+
+bool TimeSeriesClass::query(String const& key, uint8_t tier, uint32_t from, uint32_t to,
+        size_t maxPoints, JsonArray& target, bool& truncated) const
+{
+    truncated = false;
+    if (tier >= TierCount) { return false; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto pSeries = findSeries(key);
+    if (pSeries == nullptr) { return false; }
+
+    auto const& series = *pSeries;
+    uint32_t interval = getTierInterval(tier);
+
+    size_t points = 0;
+    for (auto const& segment : loadSegments(series, tier, from, to)) {
+        decode(segment, interval, series.Scale, [&](uint32_t timestamp, float value) {
+            if (timestamp < from || timestamp > to) { return; }
+            if (points >= maxPoints) { truncated = true; return; }
+
+            JsonArray point = target.add<JsonArray>();
+            point.add(timestamp);
+            point.add(value);
+            ++points;
+        });
+    }
+
+    return true;
+}
+
+uint8_t TimeSeriesClass::selectTier(uint32_t bucketWidth)
+{
+    uint8_t tier = 0;
+    while (tier + 1 < TierCount && getTierInterval(tier + 1) <= bucketWidth) { ++tier; }
+    return tier;
+}
+
+bool TimeSeriesClass::getBuckets(String const& key, uint8_t tier, uint32_t from, uint32_t to,
+        size_t count, std::vector<Bucket>& target) const
+{
+    target.assign(count, Bucket { 0, 0, 0, 0 });
+    if (tier >= TierCount || count == 0 || to <= from) { return false; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto pSeries = findSeries(key);
+    if (pSeries == nullptr) { return false; }
+
+    auto const& series = *pSeries;
+    uint32_t interval = getTierInterval(tier);
+    uint32_t range = to - from;
+
+    for (auto const& segment : loadSegments(series, tier, from, to)) {
+        decode(segment, interval, series.Scale, [&](uint32_t timestamp, float value) {
+            if (timestamp < from || timestamp >= to) { return; }
+
+            auto& bucket = target[static_cast<uint64_t>(timestamp - from) * count / range];
+            if (bucket.Count == 0) {
+                bucket.Min = bucket.Max = value;
+            } else {
+                bucket.Min = std::min(bucket.Min, value);
+                bucket.Max = std::max(bucket.Max, value);
+            }
+            // the average is accumulated as sum until all samples are known
+            bucket.Avg += value;
+            ++bucket.Count;
+        });
+    }
+
+    for (auto& bucket : target) {
+        if (bucket.Count > 0) { bucket.Avg /= bucket.Count; }
+    }
+
+    return true;
+}
+
+bool TimeSeriesClass::getRange(String const& key, uint8_t tier, uint32_t from, uint32_t step,
+        size_t count, std::vector<uint8_t>& target) const
+{
+    if (count > UINT16_MAX || step == 0) { return false; }
+
+    std::vector<Bucket> buckets;
+    if (!getBuckets(key, tier, from, from + step * count, count, buckets)) { return false; }
+
+    float scale;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto pSeries = findSeries(key);
+        if (pSeries == nullptr) { return false; }
+        scale = pSeries->Scale;
+    }
+
+    target.clear();
+    target.reserve(16 + count * sizeof(int16_t));
+    appendLittleEndian<uint8_t>(target, RangeVersion);
+    appendLittleEndian<uint8_t>(target, tier);
+    appendLittleEndian<uint16_t>(target, count);
+    appendLittleEndian<uint32_t>(target, from);
+    appendLittleEndian<uint32_t>(target, step);
+    appendLittleEndian<float>(target, scale);
+
+    int32_t previous = 0;
+    for (auto const& bucket : buckets) {
+        if (bucket.Count == 0) {
+            appendLittleEndian<int16_t>(target, RangeGap);
+            continue;
+        }
+
+        auto encoded = static_cast<int32_t>(std::lround(bucket.Avg * scale));
+        int32_t delta = encoded - previous;
+        if (delta > RangeEscape && delta <= INT16_MAX) {
+            appendLittleEndian<int16_t>(target, delta);
+        } else {
+            appendLittleEndian<int16_t>(target, RangeEscape);
+            appendLittleEndian<int32_t>(target, encoded);
+        }
+        previous = encoded;
+    }
+
+    return true;
+}
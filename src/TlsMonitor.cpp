@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "TlsMonitor.h"
+#include <sdkconfig.h>
+#include <algorithm>
+
+TlsMonitorClass TlsMonitor;
+
+namespace {
+
+constexpr char const* clientNames[] = { "mqtt", "http" };
+static_assert(sizeof(clientNames) / sizeof(clientNames[0]) == static_cast<size_t>(TlsMonitorClass::Client::Count));
+
+#ifdef CONFIG_MBEDTLS_HARDWARE_AES
+constexpr bool hardwareAes = true;
+#else
+constexpr bool hardwareAes = false;
+#endif
+
+#ifdef CONFIG_MBEDTLS_HARDWARE_SHA
+constexpr bool hardwareSha = true;
+#else
+constexpr bool hardwareSha = false;
+#endif
+
+#ifdef CONFIG_MBEDTLS_HARDWARE_MPI
+constexpr bool hardwareMpi = true;
+#else
+constexpr bool hardwareMpi = false;
+#endif
+
+}; // namespace
+
+void TlsMonitorClass::recordHandshake(Client client, bool success, uint32_t durationMs)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& counters = _counters[static_cast<size_t>(client)];
+
+    if (!success) {
+        ++counters.Failures;
+        return;
+    }
+
+    ++counters.Handshakes;
+    counters.LastDurationMs = durationMs;
+    counters.MaxDurationMs = std::max(counters.MaxDurationMs, durationMs);
+    counters.TotalDurationMs += durationMs;
+}
+
+void TlsMonitorClass::serialize(JsonObject& target) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    target["hw_aes"] = hardwareAes;
+    target["hw_sha"] = hardwareSha;
+    target["hw_mpi"] = hardwareMpi;
+
+    JsonArray clients = target["clients"].to<JsonArray>();
+    for (size_t i = 0; i < _counters.size(); ++i) {
+        auto const& counters = _counters[i];
+        JsonObject client = clients.add<JsonObject>();
+        client["name"] = clientNames[i];
+        client["handshakes"] = counters.Handshakes;
+        client["failures"] = counters.Failures;
+        client["last_ms"] = counters.LastDurationMs;
+        client["max_ms"] = counters.MaxDurationMs;
+        client["avg_ms"] = counters.Handshakes > 0 ? counters.TotalDurationMs / counters.Handshakes : 0;
+    }
+}
@@ -4,6 +4,7 @@
  */
 
 #include "Utils.h"
+#include "HeapMonitor.h"
 #include "MessageOutput.h"
 #include "PinMapping.h"
 #include <LittleFS.h>
@@ -62,12 +63,83 @@ bool Utils::checkJsonAlloc(const JsonDocument& doc, const char* function, const
 {
     if (doc.overflowed()) {
         MessageOutput.printf("Alloc failed: %s, %" PRId16 "\r\n", function, line);
+        HeapMonitor.recordAllocFailure(function, line);
         return false;
     }
 
     return true;
 }
 
+std::shared_ptr<std::vector<uint8_t>> Utils::serializeJsonShared(const JsonDocument& doc)
+{
+    size_t len = measureJson(doc);
+
+    // one additional byte for the null terminator written by serializeJson()
+    auto buffer = std::make_shared<std::vector<uint8_t>>(len + 1);
+    serializeJson(doc, reinterpret_cast<char*>(buffer->data()), buffer->size());
+    buffer->resize(len);
+
+    return buffer;
+}
+
+// writes all values of current which differ from previous into delta, values
+// which are missing in current are set to null. returns true if there is any
+// difference.
+bool Utils::generateJsonMergePatch(JsonObjectConst previous, JsonObjectConst current, JsonObject delta)
+{
+    bool changed = false;
+
+    for (JsonPairConst kv : current) {
+        auto previousValue = previous[kv.key()];
+
+        if (kv.value().is<JsonObjectConst>() && previousValue.is<JsonObjectConst>()) {
+            auto child = delta[kv.key()].to<JsonObject>();
+            if (generateJsonMergePatch(previousValue.as<JsonObjectConst>(), kv.value().as<JsonObjectConst>(), child)) {
+                changed = true;
+            } else {
+                delta.remove(kv.key());
+            }
+            continue;
+        }
+
+        if (!previousValue.isNull() && previousValue == kv.value()) {
+            continue;
+        }
+
+        delta[kv.key()] = kv.value();
+        changed = true;
+    }
+
+    for (JsonPairConst kv : previous) {
+        if (current[kv.key()].isNull()) {
+            delta[kv.key()] = nullptr;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+void Utils::applyJsonMergePatch(JsonObject state, JsonObjectConst delta)
+{
+    for (JsonPairConst kv : delta) {
+        if (kv.value().isNull()) {
+            state.remove(kv.key());
+            continue;
+        }
+
+        if (kv.value().is<JsonObjectConst>()) {
+            if (!state[kv.key()].is<JsonObject>()) {
+                state[kv.key()].to<JsonObject>();
+            }
+            applyJsonMergePatch(state[kv.key()].as<JsonObject>(), kv.value().as<JsonObjectConst>());
+            continue;
+        }
+
+        state[kv.key()] = kv.value();
+    }
+}
+
 /// @brief Remove all files but the PINMAPPING_FILENAME
 void Utils::removeAllFiles()
 {
@@ -235,6 +307,43 @@ std::pair<T, String> Utils::getJsonValueByPath(JsonDocument const& root, String
 
 template std::pair<float, String> Utils::getJsonValueByPath(JsonDocument const& root, String const& path);
 
+static void addPathToFilter(JsonVariant node, String const& path, int start)
+{
+    // the filter already keeps everything below this node
+    if (node.is<bool>()) { return; }
+
+    int end = path.indexOf('/', start);
+    String key = (end < 0) ? path.substring(start) : path.substring(start, end);
+
+    // handle double forward slashes and paths starting or ending with a slash
+    if (key.isEmpty()) {
+        if (end < 0) { node.set(true); return; }
+        return addPathToFilter(node, path, end + 1);
+    }
+
+    auto getChild = [&node,&key]() -> JsonVariant {
+        if (key[0] == '[' && key[key.length() - 1] == ']') {
+            // filters apply their first array element to all elements
+            JsonArray array = node.is<JsonArray>() ? node.as<JsonArray>() : node.to<JsonArray>();
+            if (array.size() > 0) { return array[0]; }
+            return array.add<JsonVariant>();
+        }
+
+        JsonObject object = node.is<JsonObject>() ? node.as<JsonObject>() : node.to<JsonObject>();
+        if (!object[key].isNull()) { return object[key]; }
+        return object[key].to<JsonVariant>();
+    };
+
+    JsonVariant child = getChild();
+    if (end < 0) { child.set(true); return; }
+    addPathToFilter(child, path, end + 1);
+}
+
+void Utils::addJsonPathToFilter(JsonDocument& filter, String const& path)
+{
+    addPathToFilter(filter.as<JsonVariant>(), path, 0);
+}
+
 template <typename T>
 std::optional<T> Utils::getNumericValueFromMqttPayload(char const* client,
         std::string const& src, char const* topic, char const* jsonPath)
@@ -257,9 +366,13 @@ std::optional<T> Utils::getNumericValueFromMqttPayload(char const* client,
         return res;
     }
 
+    JsonDocument filter;
+    addJsonPathToFilter(filter, jsonPath);
+
     JsonDocument json;
 
-    const DeserializationError error = deserializeJson(json, src);
+    const DeserializationError error = deserializeJson(json, src,
+            DeserializationOption::Filter(filter));
     if (error) {
         return log("cannot parse payload '%s' as JSON", logValue.c_str());
     }
@@ -7,29 +7,30 @@
 
 void VictronSmartShunt::deinit()
 {
-    SerialPortManager.freePort(_serialPortOwner);
+    SerialPortManager.freePort(getSerialPortOwner(_serialPortOwner));
 }
 
 bool VictronSmartShunt::init(bool verboseLogging)
 {
     MessageOutput.println("[VictronSmartShunt] Initialize interface...");
 
-    const PinMapping_t& pin = PinMapping.get();
+    auto const pin = getPins();
     MessageOutput.printf("[VictronSmartShunt] Interface rx = %d, tx = %d\r\n",
-            pin.battery_rx, pin.battery_tx);
+            pin.rx, pin.tx);
 
-    if (pin.battery_rx < 0) {
+    if (pin.rx < 0) {
         MessageOutput.println("[VictronSmartShunt] Invalid pin config");
         return false;
     }
 
-    auto tx = static_cast<gpio_num_t>(pin.battery_tx);
-    auto rx = static_cast<gpio_num_t>(pin.battery_rx);
+    auto tx = static_cast<gpio_num_t>(pin.tx);
+    auto rx = static_cast<gpio_num_t>(pin.rx);
 
-    auto oHwSerialPort = SerialPortManager.allocatePort(_serialPortOwner);
+    auto oHwSerialPort = SerialPortManager.allocatePort(getSerialPortOwner(_serialPortOwner), _rxBufferSize);
     if (!oHwSerialPort) { return false; }
 
-    VeDirectShunt.init(rx, tx, &MessageOutput, verboseLogging, *oHwSerialPort);
+    VeDirectShunt.init(rx, tx, &MessageOutput, verboseLogging,
+            SerialPortManager.createSerial(*oHwSerialPort));
     return true;
 }
 
@@ -42,3 +43,17 @@ void VictronSmartShunt::loop()
     _stats->updateFrom(VeDirectShunt.getData());
     _lastUpdate = VeDirectShunt.getLastUpdate();
 }
+
+std::optional<BatteryProvider::ElectricalSample> VictronSmartShunt::getElectricalSample() const
+{
+    if (!VeDirectShunt.isDataValid()) { return std::nullopt; }
+
+    // V and I are part of the same text frame, which is only evaluated
+    // once its checksum was verified.
+    auto const& data = VeDirectShunt.getData();
+    return ElectricalSample {
+        static_cast<float>(data.batteryVoltage_V_mV) / 1000,
+        static_cast<float>(data.batteryCurrent_I_mA) / 1000,
+        VeDirectShunt.getLastUpdate()
+    };
+}
@@ -7,6 +7,8 @@
 
 #include <SpiManager.h>
 #include <driver/spi_master.h>
+#include <esp_task.h>
+#include <algorithm>
 
 // Internal Arduino functions from WiFiGeneric
 void tcpipInit();
@@ -22,10 +24,13 @@ W5500::W5500(spi_device_handle_t spi, gpio_num_t pin_int)
     ESP_ERROR_CHECK(tcpip_adapter_set_default_eth_handlers());
 
     eth_w5500_config_t w5500_config = ETH_W5500_DEFAULT_CONFIG(spi);
+    // the driver's RX task waits for the interrupt line, i.e., frames are
+    // not polled for. it must preempt the lwIP task to keep latency low.
     w5500_config.int_gpio_num = pin_int;
 
     eth_mac_config_t mac_config = ETH_MAC_DEFAULT_CONFIG();
     mac_config.rx_task_stack_size = 4096;
+    mac_config.rx_task_prio = ESP_TASK_TCPIP_PRIO + 1;
     esp_eth_mac_t* mac = esp_eth_mac_new_w5500(&w5500_config, &mac_config);
 
     eth_phy_config_t phy_config = ETH_PHY_DEFAULT_CONFIG();
@@ -56,7 +61,7 @@ W5500::~W5500()
     // TODO(LennartF22): support cleanup at some point?
 }
 
-std::unique_ptr<W5500> W5500::setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin_sclk, int8_t pin_cs, int8_t pin_int, int8_t pin_rst)
+std::unique_ptr<W5500> W5500::setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin_sclk, int8_t pin_cs, int8_t pin_int, int8_t pin_rst, uint8_t spi_mhz)
 {
     gpio_reset_pin(static_cast<gpio_num_t>(pin_rst));
     gpio_set_level(static_cast<gpio_num_t>(pin_rst), 0);
@@ -78,7 +83,7 @@ std::unique_ptr<W5500> W5500::setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin
         .duty_cycle_pos = 0,
         .cs_ena_pretrans = 0, // only 0 supported
         .cs_ena_posttrans = 0, // only 0 supported
-        .clock_speed_hz = 20000000, // stable with OpenDTU Fusion shield
+        .clock_speed_hz = std::clamp<int>(spi_mhz, 1, 80) * 1000000,
         .input_delay_ns = 0,
         .spics_io_num = pin_cs,
         .flags = 0,
@@ -87,7 +92,7 @@ std::unique_ptr<W5500> W5500::setup(int8_t pin_mosi, int8_t pin_miso, int8_t pin
         .post_cb = nullptr,
     };
 
-    spi_device_handle_t spi = SpiManagerInst.alloc_device("", bus_config, device_config);
+    spi_device_handle_t spi = SpiManagerInst.alloc_device("", bus_config, device_config, "w5500");
     if (!spi)
         return nullptr;
 
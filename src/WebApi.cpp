@@ -3,10 +3,53 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi.h"
+#include "WebApi_session.h"
 #include "Configuration.h"
+#include "GzipEncoder.h"
 #include "MessageOutput.h"
 #include "defaults.h"
 #include <AsyncJson.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// reads the chunks of a request body one after another
+class BodyChunksReader {
+public:
+    explicit BodyChunksReader(WebApiClass::body_chunks_t const& chunks)
+        : _chunks(chunks) { }
+
+    int read()
+    {
+        char c;
+        return (readBytes(&c, 1) == 1) ? static_cast<uint8_t>(c) : -1;
+    }
+
+    size_t readBytes(char* buffer, size_t length)
+    {
+        size_t copied = 0;
+        while (copied < length && _chunk < _chunks.size()) {
+            auto const& chunk = _chunks[_chunk];
+            size_t n = std::min(length - copied, chunk.size() - _offset);
+            memcpy(buffer + copied, chunk.data() + _offset, n);
+            copied += n;
+            _offset += n;
+            if (_offset == chunk.size()) {
+                ++_chunk;
+                _offset = 0;
+            }
+        }
+        return copied;
+    }
+
+private:
+    WebApiClass::body_chunks_t const& _chunks;
+    size_t _chunk = 0;
+    size_t _offset = 0;
+};
+
+}; // namespace
 
 WebApiClass::WebApiClass()
     : _server(HTTP_PORT)
@@ -15,6 +58,11 @@ WebApiClass::WebApiClass()
 
 void WebApiClass::init(Scheduler& scheduler)
 {
+    WebApiSession.reset();
+
+    _admission.init();
+    _server.addMiddleware(&_admission);
+
     _webApiDevice.init(_server, scheduler);
     _webApiDevInfo.init(_server, scheduler);
     _webApiDtu.init(_server, scheduler);
@@ -33,16 +81,22 @@ void WebApiClass::init(Scheduler& scheduler)
     _webApiPrometheus.init(_server, scheduler);
     _webApiSecurity.init(_server, scheduler);
     _webApiSysstatus.init(_server, scheduler);
+    _webApiTimeSeries.init(_server, scheduler);
     _webApiWebapp.init(_server, scheduler);
+    _webApiWsHub.init(_server, scheduler);
     _webApiWsConsole.init(_server, scheduler);
     _webApiWsLive.init(_server, scheduler);
+    _webApiWsShelly.init(_server, scheduler);
     _webApiBattery.init(_server, scheduler);
+    _webApiBootstrap.init(_server, scheduler);
     _webApiPowerMeter.init(_server, scheduler);
     _webApiPowerLimiter.init(_server, scheduler);
     _webApiWsSolarChargerLive.init(_server, scheduler);
     _webApiSolarCharger.init(_server, scheduler);
+#ifndef OPENDTU_WITHOUT_HUAWEI
     _webApiWsHuaweiLive.init(_server, scheduler);
     _webApiHuaweiClass.init(_server, scheduler);
+#endif
     _webApiWsBatteryLive.init(_server, scheduler);
 
     _server.begin();
@@ -50,15 +104,25 @@ void WebApiClass::init(Scheduler& scheduler)
 
 void WebApiClass::reload()
 {
+    WebApiSession.reset();
+
+    _webApiFirmware.reload();
+    _webApiWsHub.reload();
     _webApiWsConsole.reload();
     _webApiWsLive.reload();
     _webApiWsBatteryLive.reload();
     _webApiWsSolarChargerLive.reload();
+#ifndef OPENDTU_WITHOUT_HUAWEI
     _webApiWsHuaweiLive.reload();
+#endif
 }
 
-bool WebApiClass::checkCredentials(AsyncWebServerRequest* request)
+bool WebApiClass::checkCredentials(AsyncWebServerRequest* request, const bool acceptSessionToken)
 {
+    if (acceptSessionToken && WebApiSession.isValid(request)) {
+        return true;
+    }
+
     auto const& config = Configuration.get();
     if (request->authenticate(AUTH_USERNAME, config.Security.Password)) {
         return true;
@@ -85,6 +149,24 @@ bool WebApiClass::checkCredentialsReadonly(AsyncWebServerRequest* request)
     }
 }
 
+void WebApiClass::onRequestEnd(AsyncWebServerRequest* request, std::function<void()> callback)
+{
+    auto& callbacks = _requestEndCallbacks[request];
+    if (callbacks.empty()) {
+        request->onDisconnect([request]() {
+            auto& all = WebApi._requestEndCallbacks;
+            auto iter = all.find(request);
+            if (iter == all.end()) { return; }
+
+            auto pending = std::move(iter->second);
+            all.erase(iter);
+            for (auto& cb : pending) { cb(); }
+        });
+    }
+
+    callbacks.push_back(std::move(callback));
+}
+
 void WebApiClass::sendTooManyRequests(AsyncWebServerRequest* request)
 {
     auto response = request->beginResponse(429, "text/plain", "Too Many Requests");
@@ -109,15 +191,24 @@ bool WebApiClass::parseRequestData(AsyncWebServerRequest* request, AsyncJsonResp
     auto& retMsg = response->getRoot();
     retMsg["type"] = "warning";
 
-    if (!request->hasParam("data", true)) {
+    DeserializationError error = DeserializationError::EmptyInput;
+
+    auto iter = WebApi._requestBodies.find(request);
+    if (iter != WebApi._requestBodies.end()) {
+        if (!iter->second.Overflowed) {
+            BodyChunksReader reader(iter->second.Chunks);
+            error = deserializeJson(json_document, reader);
+        }
+        WebApi._requestBodies.erase(iter);
+    } else if (request->hasParam("data", true)) {
+        error = deserializeJson(json_document, request->getParam("data", true)->value());
+    } else {
         retMsg["message"] = "No values found!";
         retMsg["code"] = WebApiError::GenericNoValueFound;
         WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
         return false;
     }
 
-    const String json = request->getParam("data", true)->value();
-    const DeserializationError error = deserializeJson(json_document, json);
     if (error) {
         retMsg["message"] = "Failed to parse data!";
         retMsg["code"] = WebApiError::GenericParseError;
@@ -128,6 +219,26 @@ bool WebApiClass::parseRequestData(AsyncWebServerRequest* request, AsyncJsonResp
     return true;
 }
 
+void WebApiClass::onRequestBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total)
+{
+    auto& bodies = WebApi._requestBodies;
+
+    if (index == 0) {
+        // the body is dropped once the request is finished, no matter
+        // whether it was parsed
+        WebApi.onRequestEnd(request, [request]() { WebApi._requestBodies.erase(request); });
+
+        auto& body = bodies[request];
+        body.Overflowed = total > _maxRequestBodySize;
+    }
+
+    auto iter = bodies.find(request);
+    if (iter == bodies.end() || iter->second.Overflowed) { return; }
+
+    auto& chunks = iter->second.Chunks;
+    chunks.emplace_back(reinterpret_cast<char*>(data), reinterpret_cast<char*>(data) + len);
+}
+
 uint64_t WebApiClass::parseSerialFromRequest(AsyncWebServerRequest* request, String param_name)
 {
     if (request->hasParam(param_name)) {
@@ -153,9 +264,124 @@ bool WebApiClass::sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResp
         ret_val = false;
     }
 
+    if (ret_val && acceptsGzip(request)) {
+        auto& root = response->getRoot();
+        size_t len = measureJson(root);
+        if (len >= GzipMinSize) {
+            // one additional byte for the null terminator written by serializeJson()
+            std::vector<uint8_t> json(len + 1);
+            serializeJson(root, reinterpret_cast<char*>(json.data()), json.size());
+            json.resize(len);
+
+            delete response;
+            sendBuffer(request, "application/json", gzip(json), true);
+            return ret_val;
+        }
+    }
+
     response->setLength();
     request->send(response);
     return ret_val;
 }
 
+bool WebApiClass::acceptsGzip(AsyncWebServerRequest* request)
+{
+    if (!request->hasHeader("Accept-Encoding")) {
+        return false;
+    }
+
+    return request->getHeader("Accept-Encoding")->value().indexOf("gzip") >= 0;
+}
+
+std::shared_ptr<std::vector<uint8_t>> WebApiClass::gzip(std::vector<uint8_t> const& data)
+{
+    // too large for the stack of the web server task
+    auto upEncoder = std::make_unique<GzipEncoder>();
+
+    auto spCompressed = std::make_shared<std::vector<uint8_t>>();
+    spCompressed->reserve(data.size() / 4);
+    upEncoder->write(data.data(), data.size(), *spCompressed);
+    upEncoder->finish(*spCompressed);
+    spCompressed->shrink_to_fit();
+
+    return spCompressed;
+}
+
+void WebApiClass::sendBuffer(AsyncWebServerRequest* request, const char* contentType, std::shared_ptr<std::vector<uint8_t>> const& data, bool gzipped)
+{
+    auto response = request->beginResponse(contentType, data->size(),
+        [data](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            size_t len = std::min(maxLen, data->size() - index);
+            memcpy(buffer, data->data() + index, len);
+            return len;
+        });
+
+    if (gzipped) {
+        response->addHeader("Content-Encoding", "gzip");
+    }
+    response->addHeader("Vary", "Accept-Encoding");
+    request->send(response);
+}
+
+AsyncWebServerResponse* WebApiClass::beginChunkedResponse(AsyncWebServerRequest* request, const char* contentType, AwsResponseFiller filler)
+{
+    if (!acceptsGzip(request)) {
+        auto response = request->beginChunkedResponse(contentType, filler);
+        response->addHeader("Vary", "Accept-Encoding");
+        return response;
+    }
+
+    struct State {
+        AwsResponseFiller Source;
+        size_t SourceIndex = 0;
+        std::vector<uint8_t> Input;
+        std::unique_ptr<GzipEncoder> upEncoder;
+        std::vector<uint8_t> Pending; // compressed, not yet sent
+        size_t Offset = 0;
+    };
+
+    auto spState = std::make_shared<State>();
+    spState->Source = std::move(filler);
+    spState->Input.resize(1024);
+    spState->upEncoder = std::make_unique<GzipEncoder>();
+
+    auto response = request->beginChunkedResponse(contentType,
+        [spState](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            auto& state = *spState;
+
+            try {
+                while (state.Offset >= state.Pending.size()) {
+                    if (!state.upEncoder) { return 0; } // finished
+
+                    state.Pending.clear();
+                    state.Offset = 0;
+
+                    size_t len = state.Source(state.Input.data(), state.Input.size(), state.SourceIndex);
+                    if (len == RESPONSE_TRY_AGAIN) { return RESPONSE_TRY_AGAIN; }
+
+                    if (len == 0) {
+                        state.upEncoder->finish(state.Pending);
+                        state.upEncoder.reset();
+                        continue;
+                    }
+
+                    state.SourceIndex += len;
+                    state.upEncoder->write(state.Input.data(), len, state.Pending);
+                }
+            } catch (std::bad_alloc& bad_alloc) {
+                MessageOutput.printf("Compressing the response has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+                return 0;
+            }
+
+            size_t len = std::min(maxLen, state.Pending.size() - state.Offset);
+            memcpy(buffer, state.Pending.data() + state.Offset, len);
+            state.Offset += len;
+            return len;
+        });
+
+    response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("Vary", "Accept-Encoding");
+    return response;
+}
+
 WebApiClass WebApi;
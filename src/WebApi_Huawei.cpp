@@ -2,7 +2,9 @@
 /*
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
+#ifndef OPENDTU_WITHOUT_HUAWEI
 #include "WebApi_Huawei.h"
+#include "JsonArena.h"
 #include <gridcharger/huawei/Controller.h>
 #include "Configuration.h"
 #include "MessageOutput.h"
@@ -20,8 +22,8 @@ void WebApiHuaweiClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     _server->on("/api/huawei/status", HTTP_GET, std::bind(&WebApiHuaweiClass::onStatus, this, _1));
     _server->on("/api/huawei/config", HTTP_GET, std::bind(&WebApiHuaweiClass::onAdminGet, this, _1));
-    _server->on("/api/huawei/config", HTTP_POST, std::bind(&WebApiHuaweiClass::onAdminPost, this, _1));
-    _server->on("/api/huawei/limit/config", HTTP_POST, std::bind(&WebApiHuaweiClass::onPost, this, _1));
+    _server->on("/api/huawei/config", HTTP_POST, std::bind(&WebApiHuaweiClass::onAdminPost, this, _1), nullptr, WebApiClass::onRequestBody);
+    _server->on("/api/huawei/limit/config", HTTP_POST, std::bind(&WebApiHuaweiClass::onPost, this, _1), nullptr, WebApiClass::onRequestBody);
 }
 
 void WebApiHuaweiClass::onStatus(AsyncWebServerRequest* request)
@@ -45,7 +47,8 @@ void WebApiHuaweiClass::onPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -143,7 +146,8 @@ void WebApiHuaweiClass::onAdminPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -176,3 +180,5 @@ void WebApiHuaweiClass::onAdminPost(AsyncWebServerRequest* request)
 
     HuaweiCan.updateSettings();
 }
+
+#endif // OPENDTU_WITHOUT_HUAWEI
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_admission.h"
+#include "MetricsRegistry.h"
+#include "PowerManagement.h"
+#include "WebApi.h"
+
+void WebApiAdmissionMiddleware::init()
+{
+    using Type = MetricsRegistryClass::Type;
+
+    static char const* const laneLabels[_laneCount] = {
+        R"(lane="control")", R"(lane="static")", R"(lane="live")",
+        R"(lane="config")", R"(lane="metrics")"
+    };
+
+    for (size_t i = 0; i < _laneCount; ++i) {
+        if (_limits[i] == 0) { continue; }
+        MetricsRegistry.add("opendtu_http_busy_rejections", "HTTP requests rejected due to the concurrency limit", Type::Counter,
+            [this, i]() -> std::optional<float> { return _busyRejections[i].load(); }, laneLabels[i]);
+    }
+
+    MetricsRegistry.add("opendtu_http_heap_rejections", "HTTP requests rejected due to low memory", Type::Counter,
+        [this]() -> std::optional<float> { return _heapRejections.load(); });
+}
+
+WebApiAdmissionMiddleware::Lane WebApiAdmissionMiddleware::classify(AsyncWebServerRequest* request)
+{
+    String const& url = request->url();
+
+    if (url.startsWith("/api/limit/") || url.startsWith("/api/power/")) { return Lane::Control; }
+    if (!url.startsWith("/api/")) { return Lane::Static; }
+    if (url.startsWith("/api/prometheus/")) { return Lane::Metrics; }
+    if (url.indexOf("livedata/") >= 0 || url == "/api/bootstrap") { return Lane::Live; }
+    return Lane::Config;
+}
+
+void WebApiAdmissionMiddleware::reject(AsyncWebServerRequest* request, char const* retryAfter)
+{
+    auto response = request->beginResponse(503, "text/plain", "Service Unavailable");
+    response->addHeader("Retry-After", retryAfter);
+    request->send(response);
+}
+
+void WebApiAdmissionMiddleware::run(AsyncWebServerRequest* request, ArMiddlewareNext next)
+{
+    PowerManagement.poke(PowerManagementClass::Lock::Http);
+
+    if (request->hasHeader("Upgrade")) { return next(); }
+
+    Lane lane = classify(request);
+    if (lane == Lane::Control) { return next(); }
+
+    if (ESP.getMaxAllocHeap() < _minMaxAllocHeap) {
+        ++_heapRejections;
+        return reject(request, "5");
+    }
+
+    if (!admit(request, lane)) {
+        ++_busyRejections[static_cast<size_t>(lane)];
+        return reject(request, "1");
+    }
+
+    next();
+}
+
+bool WebApiAdmissionMiddleware::admit(AsyncWebServerRequest* request, Lane lane)
+{
+    expireStale();
+
+    auto index = static_cast<size_t>(lane);
+    if (_inFlight[index] >= _limits[index]) { return false; }
+
+    for (auto& slot : _slots) {
+        if (slot.Request != nullptr) { continue; }
+
+        slot.Request = request;
+        slot.RouteLane = lane;
+        slot.StartMillis = millis();
+        ++_inFlight[index];
+
+        WebApi.onRequestEnd(request, [this, request]() { release(request); });
+        return true;
+    }
+
+    return false;
+}
+
+void WebApiAdmissionMiddleware::release(AsyncWebServerRequest const* request)
+{
+    for (auto& slot : _slots) {
+        if (slot.Request != request) { continue; }
+
+        --_inFlight[static_cast<size_t>(slot.RouteLane)];
+        slot = {};
+        return;
+    }
+}
+
+void WebApiAdmissionMiddleware::expireStale()
+{
+    uint32_t now = millis();
+    for (auto& slot : _slots) {
+        if (slot.Request == nullptr || now - slot.StartMillis < _staleMillis) { continue; }
+
+        --_inFlight[static_cast<size_t>(slot.RouteLane)];
+        slot = {};
+    }
+}
@@ -4,6 +4,7 @@
  */
 
 #include "ArduinoJson.h"
+#include "JsonArena.h"
 #include "AsyncJson.h"
 #include "Battery.h"
 #include "Configuration.h"
@@ -22,7 +23,7 @@ void WebApiBatteryClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     _server->on("/api/battery/status", HTTP_GET, std::bind(&WebApiBatteryClass::onStatus, this, _1));
     _server->on("/api/battery/config", HTTP_GET, std::bind(&WebApiBatteryClass::onAdminGet, this, _1));
-    _server->on("/api/battery/config", HTTP_POST, std::bind(&WebApiBatteryClass::onAdminPost, this, _1));
+    _server->on("/api/battery/config", HTTP_POST, std::bind(&WebApiBatteryClass::onAdminPost, this, _1), nullptr, WebApiClass::onRequestBody);
 }
 
 void WebApiBatteryClass::onStatus(AsyncWebServerRequest* request)
@@ -56,7 +57,8 @@ void WebApiBatteryClass::onAdminPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
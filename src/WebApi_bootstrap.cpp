@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_bootstrap.h"
+#include "JsonArena.h"
+#include "MessageOutput.h"
+#include "Utils.h"
+#include "WebApi.h"
+#include <Hoymiles.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+void WebApiBootstrapClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+
+    server.on("/api/bootstrap", HTTP_GET, std::bind(&WebApiBootstrapClass::onBootstrap, this, _1));
+}
+
+void WebApiBootstrapClass::onBootstrap(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    using buffer_t = std::shared_ptr<std::vector<uint8_t>>;
+
+    try {
+        // shared with /api/livedata/status, hence not copied but streamed
+        // as is between the other parts of the response
+        buffer_t liveData = WebApi.getWsLive().getStatus();
+        if (!liveData) {
+            WebApi.sendTooManyRequests(request);
+            return;
+        }
+
+        JsonArenaAllocator allocator;
+        JsonDocument doc(&allocator);
+        WebApiLimitClass::generateStatus(doc["limit"].to<JsonObject>());
+        WebApiPowerClass::generateStatus(doc["power"].to<JsonObject>());
+
+        auto devInfo = doc["devinfo"].to<JsonObject>();
+        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+            auto inv = Hoymiles.getInverterByPos(i);
+            if (inv == nullptr) { continue; }
+            WebApiDevInfoClass::generateStatus(devInfo[inv->serialString()].to<JsonObject>(), *inv);
+        }
+
+        if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+            WebApi.sendTooManyRequests(request);
+            return;
+        }
+
+        // {"livedata":<live data>,<the members of doc>}
+        auto statuses = Utils::serializeJsonShared(doc);
+        (*statuses)[0] = ',';
+
+        static char const prefix[] = "{\"livedata\":";
+        auto head = std::make_shared<std::vector<uint8_t>>(prefix, prefix + strlen(prefix));
+
+        std::vector<buffer_t> parts = { head, liveData, statuses };
+
+        auto response = WebApi.beginChunkedResponse(request, "application/json",
+            [parts](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                size_t written = 0;
+                for (auto const& part : parts) {
+                    if (index >= part->size()) {
+                        index -= part->size();
+                        continue;
+                    }
+
+                    size_t len = std::min(maxLen - written, part->size() - index);
+                    memcpy(buffer + written, part->data() + index, len);
+                    written += len;
+                    index = 0;
+                    if (written == maxLen) { break; }
+                }
+                return written;
+            });
+
+        request->send(response);
+
+    } catch (const std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/bootstrap has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+        WebApi.sendTooManyRequests(request);
+    }
+}
@@ -3,6 +3,7 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_device.h"
+#include "JsonArena.h"
 #include "Configuration.h"
 #include "Display_Graphic.h"
 #include "PinMapping.h"
@@ -17,7 +18,7 @@ void WebApiDeviceClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_1;
 
     server.on("/api/device/config", HTTP_GET, std::bind(&WebApiDeviceClass::onDeviceAdminGet, this, _1));
-    server.on("/api/device/config", HTTP_POST, std::bind(&WebApiDeviceClass::onDeviceAdminPost, this, _1));
+    server.on("/api/device/config", HTTP_POST, std::bind(&WebApiDeviceClass::onDeviceAdminPost, this, _1), nullptr, WebApiClass::onRequestBody);
 }
 
 void WebApiDeviceClass::onDeviceAdminGet(AsyncWebServerRequest* request)
@@ -41,6 +42,12 @@ void WebApiDeviceClass::onDeviceAdminGet(AsyncWebServerRequest* request)
     nrfPinObj["irq"] = pin.nrf24_irq;
     nrfPinObj["miso"] = pin.nrf24_miso;
     nrfPinObj["mosi"] = pin.nrf24_mosi;
+    nrfPinObj["cs2"] = pin.nrf24_cs2;
+    nrfPinObj["en2"] = pin.nrf24_en2;
+    nrfPinObj["irq2"] = pin.nrf24_irq2;
+    nrfPinObj["cs3"] = pin.nrf24_cs3;
+    nrfPinObj["en3"] = pin.nrf24_en3;
+    nrfPinObj["irq3"] = pin.nrf24_irq3;
 
     auto cmtPinObj = curPin["cmt"].to<JsonObject>();
     cmtPinObj["clk"] = pin.cmt_clk;
@@ -57,6 +64,7 @@ void WebApiDeviceClass::onDeviceAdminGet(AsyncWebServerRequest* request)
     w5500PinObj["cs"] = pin.w5500_cs;
     w5500PinObj["int"] = pin.w5500_int;
     w5500PinObj["rst"] = pin.w5500_rst;
+    w5500PinObj["spi_mhz"] = pin.w5500_spi_mhz;
 
 #if CONFIG_ETH_USE_ESP32_EMAC
     auto ethPinObj = curPin["eth"].to<JsonObject>();
@@ -109,6 +117,14 @@ void WebApiDeviceClass::onDeviceAdminGet(AsyncWebServerRequest* request)
     batteryPinObj["rxen"] = pin.battery_rxen;
     batteryPinObj["tx"] = pin.battery_tx;
     batteryPinObj["txen"] = pin.battery_txen;
+    batteryPinObj["rx2"] = pin.battery_rx2;
+    batteryPinObj["rxen2"] = pin.battery_rxen2;
+    batteryPinObj["tx2"] = pin.battery_tx2;
+    batteryPinObj["txen2"] = pin.battery_txen2;
+    batteryPinObj["rx3"] = pin.battery_rx3;
+    batteryPinObj["rxen3"] = pin.battery_rxen3;
+    batteryPinObj["tx3"] = pin.battery_tx3;
+    batteryPinObj["txen3"] = pin.battery_txen3;
 
     auto huaweiPinObj = curPin["huawei"].to<JsonObject>();
     huaweiPinObj["miso"] = pin.huawei_miso;
@@ -137,7 +153,8 @@ void WebApiDeviceClass::onDeviceAdminPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -185,6 +202,7 @@ void WebApiDeviceClass::onDeviceAdminPost(AsyncWebServerRequest* request)
 
     auto const& config = Configuration.get();
 
+#ifndef OPENDTU_WITHOUT_DISPLAY
     Display.setDiagramMode(static_cast<DiagramMode_t>(config.Display.Diagram.Mode));
     Display.setOrientation(config.Display.Rotation);
     Display.enablePowerSafe = config.Display.PowerSafe;
@@ -192,6 +210,7 @@ void WebApiDeviceClass::onDeviceAdminPost(AsyncWebServerRequest* request)
     Display.setContrast(config.Display.Contrast);
     Display.setLocale(config.Display.Locale);
     Display.Diagram().updatePeriod();
+#endif
 
     WebApi.writeConfig(retMsg);
 
@@ -27,16 +27,21 @@ void WebApiDevInfoClass::onDevInfoStatus(AsyncWebServerRequest* request)
     auto inv = Hoymiles.getInverterBySerial(serial);
 
     if (inv != nullptr) {
-        root["valid_data"] = inv->DevInfo()->getLastUpdate() > 0;
-        root["fw_bootloader_version"] = inv->DevInfo()->getFwBootloaderVersion();
-        root["fw_build_version"] = inv->DevInfo()->getFwBuildVersion();
-        root["hw_part_number"] = inv->DevInfo()->getHwPartNumber();
-        root["hw_version"] = inv->DevInfo()->getHwVersion();
-        root["hw_model_name"] = inv->DevInfo()->getHwModelName();
-        root["max_power"] = inv->DevInfo()->getMaxPower();
-        root["fw_build_datetime"] = inv->DevInfo()->getFwBuildDateTimeStr();
-        root["pdl_supported"] = inv->supportsPowerDistributionLogic();
+        generateStatus(root.to<JsonObject>(), *inv);
     }
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
+
+void WebApiDevInfoClass::generateStatus(JsonObject root, InverterAbstract& inv)
+{
+    root["valid_data"] = inv.DevInfo()->getLastUpdate() > 0;
+    root["fw_bootloader_version"] = inv.DevInfo()->getFwBootloaderVersion();
+    root["fw_build_version"] = inv.DevInfo()->getFwBuildVersion();
+    root["hw_part_number"] = inv.DevInfo()->getHwPartNumber();
+    root["hw_version"] = inv.DevInfo()->getHwVersion();
+    root["hw_model_name"] = inv.DevInfo()->getHwModelName();
+    root["max_power"] = inv.DevInfo()->getMaxPower();
+    root["fw_build_datetime"] = inv.DevInfo()->getFwBuildDateTimeStr();
+    root["pdl_supported"] = inv.supportsPowerDistributionLogic();
+}
@@ -3,6 +3,8 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_dtu.h"
+#include "JsonArena.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
@@ -10,7 +12,7 @@
 #include <Hoymiles.h>
 
 WebApiDtuClass::WebApiDtuClass()
-    : _applyDataTask(TASK_IMMEDIATE, TASK_ONCE, std::bind(&WebApiDtuClass::applyDataTaskCb, this))
+    : _applyDataTask(TASK_IMMEDIATE, TASK_ONCE, TaskMonitor.wrap("WebApiDtu::applyDataTaskCb", std::bind(&WebApiDtuClass::applyDataTaskCb, this)))
 {
 }
 
@@ -19,21 +21,29 @@ void WebApiDtuClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_1;
 
     server.on("/api/dtu/config", HTTP_GET, std::bind(&WebApiDtuClass::onDtuAdminGet, this, _1));
-    server.on("/api/dtu/config", HTTP_POST, std::bind(&WebApiDtuClass::onDtuAdminPost, this, _1));
+    server.on("/api/dtu/config", HTTP_POST, std::bind(&WebApiDtuClass::onDtuAdminPost, this, _1), nullptr, WebApiClass::onRequestBody);
+    server.on("/api/dtu/capture", HTTP_GET, std::bind(&WebApiDtuClass::onCaptureGet, this, _1));
+    server.on("/api/dtu/capture", HTTP_POST, std::bind(&WebApiDtuClass::onCapturePost, this, _1), nullptr, WebApiClass::onRequestBody);
 
     scheduler.addTask(_applyDataTask);
 }
 
 void WebApiDtuClass::applyDataTaskCb()
 {
-    // Execute stuff in main thread to avoid busy SPI bus
+    // the radio task uses the SPI bus, hence the radios are only
+    // reconfigured while it is not executing.
     auto const& config = Configuration.get();
-    Hoymiles.getRadioNrf()->setPALevel((rf24_pa_dbm_e)config.Dtu.Nrf.PaLevel);
-    Hoymiles.getRadioCmt()->setPALevel(config.Dtu.Cmt.PaLevel);
-    Hoymiles.getRadioNrf()->setDtuSerial(config.Dtu.Serial);
-    Hoymiles.getRadioCmt()->setDtuSerial(config.Dtu.Serial);
-    Hoymiles.getRadioCmt()->setCountryMode(static_cast<CountryModeId_t>(config.Dtu.Cmt.CountryMode));
-    Hoymiles.getRadioCmt()->setInverterTargetFrequency(config.Dtu.Cmt.Frequency);
+    Hoymiles.withRadios([&config]() {
+        for (uint8_t i = 0; i < Hoymiles.getNumRadiosNrf(); i++) {
+            Hoymiles.getRadioNrf(i)->setPALevel((rf24_pa_dbm_e)config.Dtu.Nrf.PaLevel);
+            Hoymiles.getRadioNrf(i)->setDtuSerial(config.Dtu.Serial);
+        }
+        Hoymiles.getRadioCmt()->setPALevel(config.Dtu.Cmt.PaLevel);
+        Hoymiles.getRadioCmt()->setDtuSerial(config.Dtu.Serial);
+        Hoymiles.getRadioCmt()->setCountryMode(static_cast<CountryModeId_t>(config.Dtu.Cmt.CountryMode));
+        Hoymiles.getRadioCmt()->setInverterTargetFrequency(config.Dtu.Cmt.Frequency);
+        Hoymiles.getRadioCmt()->setFrequencyAgility(config.Dtu.Cmt.FrequencyAgility);
+    });
     Hoymiles.setPollInterval(config.Dtu.PollInterval);
 }
 
@@ -55,12 +65,14 @@ void WebApiDtuClass::onDtuAdminGet(AsyncWebServerRequest* request)
     root["serial"] = buffer;
     root["pollinterval"] = config.Dtu.PollInterval;
     root["verbose_logging"] = config.Dtu.VerboseLogging;
+    root["night_mode"] = config.Dtu.NightMode;
     root["nrf_enabled"] = Hoymiles.getRadioNrf()->isInitialized();
     root["nrf_palevel"] = config.Dtu.Nrf.PaLevel;
     root["cmt_enabled"] = Hoymiles.getRadioCmt()->isInitialized();
     root["cmt_palevel"] = config.Dtu.Cmt.PaLevel;
     root["cmt_frequency"] = config.Dtu.Cmt.Frequency;
     root["cmt_country"] = config.Dtu.Cmt.CountryMode;
+    root["cmt_frequency_agility"] = config.Dtu.Cmt.FrequencyAgility;
     root["cmt_chan_width"] = Hoymiles.getRadioCmt()->getChannelWidth();
 
     auto data = root["country_def"].to<JsonArray>();
@@ -84,7 +96,8 @@ void WebApiDtuClass::onDtuAdminPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -94,10 +107,12 @@ void WebApiDtuClass::onDtuAdminPost(AsyncWebServerRequest* request)
     if (!(root["serial"].is<String>()
             && root["pollinterval"].is<uint32_t>()
             && root["verbose_logging"].is<bool>()
+            && root["night_mode"].is<bool>()
             && root["nrf_palevel"].is<uint8_t>()
             && root["cmt_palevel"].is<int8_t>()
             && root["cmt_frequency"].is<uint32_t>()
-            && root["cmt_country"].is<uint8_t>())) {
+            && root["cmt_country"].is<uint8_t>()
+            && root["cmt_frequency_agility"].is<bool>())) {
         retMsg["message"] = "Values are missing!";
         retMsg["code"] = WebApiError::GenericValueMissing;
         WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
@@ -161,10 +176,12 @@ void WebApiDtuClass::onDtuAdminPost(AsyncWebServerRequest* request)
         config.Dtu.Serial = serial;
         config.Dtu.PollInterval = root["pollinterval"].as<uint32_t>();
         config.Dtu.VerboseLogging = root["verbose_logging"].as<bool>();
+        config.Dtu.NightMode = root["night_mode"].as<bool>();
         config.Dtu.Nrf.PaLevel = root["nrf_palevel"].as<uint8_t>();
         config.Dtu.Cmt.PaLevel = root["cmt_palevel"].as<int8_t>();
         config.Dtu.Cmt.Frequency = root["cmt_frequency"].as<uint32_t>();
         config.Dtu.Cmt.CountryMode = root["cmt_country"].as<CountryModeId_t>();
+        config.Dtu.Cmt.FrequencyAgility = root["cmt_frequency_agility"].as<bool>();
     }
 
     WebApi.writeConfig(retMsg);
@@ -174,3 +191,101 @@ void WebApiDtuClass::onDtuAdminPost(AsyncWebServerRequest* request)
     _applyDataTask.enable();
     _applyDataTask.restart();
 }
+
+// one line per record: <millis> <tx|rx> <nrf|cmt> <channel> <rssi> <hex data>
+void WebApiDtuClass::onCaptureGet(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    auto& recorder = Hoymiles.getRecorder();
+
+    // records added while downloading are not included
+    struct Cursor {
+        uint32_t Next;
+        uint32_t End;
+    };
+    auto spCursor = std::make_shared<Cursor>(Cursor { recorder.getFirstSequence(), recorder.getNextSequence() });
+
+    auto response = request->beginChunkedResponse("text/plain; charset=utf-8",
+        [spCursor, &recorder](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            // a line takes at most 96 characters
+            size_t len = 0;
+            RadioRecorder::Record rec;
+            while (spCursor->Next < spCursor->End && maxLen - len >= 96) {
+                // skip records which were overwritten in the meantime
+                if (!recorder.get(spCursor->Next++, rec)) {
+                    continue;
+                }
+
+                char* line = reinterpret_cast<char*>(buffer + len);
+                int n = snprintf(line, maxLen - len, "%" PRIu32 " %s %s %" PRIu8 " %" PRId8 " ",
+                    rec.Millis, RadioRecorder::getDirectionName(rec.Dir),
+                    RadioRecorder::getRadioName(rec.Radio), rec.Channel, rec.Rssi);
+                for (uint8_t i = 0; i < rec.Len; ++i) {
+                    n += snprintf(line + n, maxLen - len - n, "%02X", rec.Data[i]);
+                }
+                line[n++] = '\n';
+                len += n;
+            }
+            return len;
+        });
+
+    response->addHeader("Cache-Control", "no-cache");
+    response->addHeader("Content-Disposition", "attachment; filename=\"radio_capture.txt\"");
+    request->send(response);
+}
+
+void WebApiDtuClass::onCapturePost(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
+    if (!WebApi.parseRequestData(request, response, root)) {
+        return;
+    }
+
+    auto& retMsg = response->getRoot();
+
+    if (!root["enabled"].is<bool>()) {
+        retMsg["message"] = "Values are missing!";
+        retMsg["code"] = WebApiError::GenericValueMissing;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
+    auto& recorder = Hoymiles.getRecorder();
+
+    if (!root["enabled"].as<bool>()) {
+        recorder.stop();
+    } else {
+        size_t size = root["size"] | 1000;
+        if (size == 0 || size > _maxCaptureSize) {
+            retMsg["message"] = "Invalid capture size!";
+            retMsg["code"] = WebApiError::DtuInvalidCaptureSize;
+            retMsg["param"]["max"] = _maxCaptureSize;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        if (!recorder.start(size)) {
+            retMsg["message"] = "Not enough memory for the capture!";
+            retMsg["code"] = WebApiError::GenericInternalServerError;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+    }
+
+    retMsg["type"] = "success";
+    retMsg["message"] = "Settings saved!";
+    retMsg["code"] = WebApiError::GenericSuccess;
+    retMsg["capacity"] = recorder.getCapacity();
+    retMsg["records"] = recorder.getNextSequence() - recorder.getFirstSequence();
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
@@ -3,9 +3,9 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_eventlog.h"
+#include "MessageOutput.h"
 #include "WebApi.h"
-#include <AsyncJson.h>
-#include <Hoymiles.h>
+#include <ArduinoJson.h>
 
 void WebApiEventlogClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
@@ -14,14 +14,17 @@ void WebApiEventlogClass::init(AsyncWebServer& server, Scheduler& scheduler)
     server.on("/api/eventlog/status", HTTP_GET, std::bind(&WebApiEventlogClass::onEventlogStatus, this, _1));
 }
 
+// returns the event log of the inverter. if parameter "since" is given, only
+// the entries which changed after the given sequence number are returned,
+// along with their position in the log. the client is expected to truncate
+// its copy of the log to "count" entries. if the sequence number is larger
+// than the current one, i.e., the DTU rebooted, all entries are returned.
 void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
 {
     if (!WebApi.checkCredentialsReadonly(request)) {
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
     auto serial = WebApi.parseSerialFromRequest(request);
 
     AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN;
@@ -36,26 +39,112 @@ void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
         }
     }
 
-    auto inv = Hoymiles.getInverterBySerial(serial);
+    uint32_t since = 0;
+    if (request->hasParam("since")) {
+        since = strtoul(request->getParam("since")->value().c_str(), nullptr, 10);
+    }
+
+    try {
+        auto spGenerator = std::make_shared<Generator>();
+
+        auto inv = Hoymiles.getInverterBySerial(serial);
+        if (inv != nullptr) {
+            auto eventLog = inv->EventLog();
+
+            spGenerator->Count = eventLog->getEntryCount();
+            spGenerator->Sequence = eventLog->getSequence();
+            if (since > spGenerator->Sequence) {
+                since = 0;
+            }
+
+            for (uint8_t logEntry = 0; logEntry < spGenerator->Count; logEntry++) {
+                uint32_t sequence = eventLog->getEntrySequence(logEntry);
+                if (sequence <= since) {
+                    continue;
+                }
+
+                Event event;
+                event.Index = logEntry;
+                event.Sequence = sequence;
+                eventLog->getLogEntry(logEntry, event.Entry, locale);
+                spGenerator->Events.push_back(std::move(event));
+            }
+        }
 
-    if (inv != nullptr) {
-        uint8_t logEntryCount = inv->EventLog()->getEntryCount();
+        auto response = WebApi.beginChunkedResponse(request, "application/json",
+            [spGenerator](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                return fillChunk(*spGenerator, buffer, maxLen);
+            });
 
-        root["count"] = logEntryCount;
-        JsonArray eventsArray = root["events"].to<JsonArray>();
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
 
-        for (uint8_t logEntry = 0; logEntry < logEntryCount; logEntry++) {
-            JsonObject eventsObject = eventsArray.add<JsonObject>();
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/eventlog/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
 
-            AlarmLogEntry_t entry;
-            inv->EventLog()->getLogEntry(logEntry, entry, locale);
+        WebApi.sendTooManyRequests(request);
+    }
+}
 
-            eventsObject["message_id"] = entry.MessageId;
-            eventsObject["message"] = entry.Message;
-            eventsObject["start_time"] = entry.StartTime;
-            eventsObject["end_time"] = entry.EndTime;
+size_t WebApiEventlogClass::fillChunk(Generator& gen, uint8_t* buffer, size_t maxLen)
+{
+    try {
+        while (gen.Offset >= gen.Pending.length()) {
+            gen.Pending = ""; // keeps the allocated buffer
+            gen.Offset = 0;
+            if (!generateNext(gen)) { return 0; }
         }
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/eventlog/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+        return 0;
     }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+    size_t len = std::min(maxLen, gen.Pending.length() - gen.Offset);
+    memcpy(buffer, gen.Pending.c_str() + gen.Offset, len);
+    gen.Offset += len;
+    return len;
+}
+
+// generates the next part of the response into gen.Pending. returns false
+// once the response is complete.
+bool WebApiEventlogClass::generateNext(Generator& gen)
+{
+    if (gen.Done) {
+        return false;
+    }
+
+    if (!gen.HeaderDone) {
+        gen.HeaderDone = true;
+        gen.Pending += "{\"count\":";
+        gen.Pending += gen.Count;
+        gen.Pending += ",\"sequence\":";
+        gen.Pending += gen.Sequence;
+        gen.Pending += ",\"events\":[";
+        return true;
+    }
+
+    if (gen.NextEvent >= gen.Events.size()) {
+        gen.Done = true;
+        gen.Pending += "]}";
+        return true;
+    }
+
+    auto const& event = gen.Events[gen.NextEvent];
+
+    JsonDocument doc;
+    doc["index"] = event.Index;
+    doc["sequence"] = event.Sequence;
+    doc["message_id"] = event.Entry.MessageId;
+    doc["message"] = event.Entry.Message;
+    doc["start_time"] = event.Entry.StartTime;
+    doc["end_time"] = event.Entry.EndTime;
+
+    String serialized;
+    serializeJson(doc, serialized);
+
+    if (gen.NextEvent++ > 0) {
+        gen.Pending += ",";
+    }
+    gen.Pending += serialized;
+    return true;
 }
@@ -3,11 +3,17 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_file.h"
+#include "JsonArena.h"
 #include "Configuration.h"
+#include "FsWriteMonitor.h"
+#include "I18n.h"
+#include "MessageOutput.h"
+#include "PinMapping.h"
 #include "RestartHelper.h"
 #include "Utils.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
+#include "defaults.h"
 #include <AsyncJson.h>
 #include <LittleFS.h>
 
@@ -21,12 +27,16 @@ void WebApiFileClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_6;
 
     server.on("/api/file/get", HTTP_GET, std::bind(&WebApiFileClass::onFileGet, this, _1));
-    server.on("/api/file/delete", HTTP_POST, std::bind(&WebApiFileClass::onFileDelete, this, _1));
-    server.on("/api/file/delete_all", HTTP_POST, std::bind(&WebApiFileClass::onFileDeleteAll, this, _1));
+    server.on("/api/file/delete", HTTP_POST, std::bind(&WebApiFileClass::onFileDelete, this, _1), nullptr, WebApiClass::onRequestBody);
+    server.on("/api/file/delete_all", HTTP_POST, std::bind(&WebApiFileClass::onFileDeleteAll, this, _1), nullptr, WebApiClass::onRequestBody);
     server.on("/api/file/list", HTTP_GET, std::bind(&WebApiFileClass::onFileListGet, this, _1));
     server.on("/api/file/upload", HTTP_POST,
         std::bind(&WebApiFileClass::onFileUploadFinish, this, _1),
         std::bind(&WebApiFileClass::onFileUpload, this, _1, _2, _3, _4, _5, _6));
+
+    uint32_t constexpr stackSize = 4096;
+    xTaskCreate(WebApiFileClass::writerLoopHelper, "FileUpload",
+            stackSize, this, 1/*prio*/, &_writerTaskHandle);
 }
 
 void WebApiFileClass::onFileListGet(AsyncWebServerRequest* request)
@@ -73,6 +83,10 @@ void WebApiFileClass::onFileGet(AsyncWebServerRequest* request)
         }
     }
 
+    if (requestFile == CONFIG_FILENAME) {
+        Configuration.flush();
+    }
+
     request->send(LittleFS, requestFile, String(), true);
 }
 
@@ -83,7 +97,8 @@ void WebApiFileClass::onFileDelete(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -105,6 +120,14 @@ void WebApiFileClass::onFileDelete(AsyncWebServerRequest* request)
 
     LittleFS.remove(name);
 
+    if (name == PINMAPPING_FILENAME) {
+        LittleFS.remove(PINMAPPING_CACHE_FILENAME);
+    }
+
+    if (name.endsWith(LANG_PACK_SUFFIX)) {
+        I18n.removeFromIndex(name);
+    }
+
     retMsg["type"] = "success";
     retMsg["message"] = "File deleted";
     retMsg["code"] = WebApiError::FileDeleteSuccess;
@@ -119,7 +142,8 @@ void WebApiFileClass::onFileDeleteAll(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -147,7 +171,7 @@ void WebApiFileClass::onFileDeleteAll(AsyncWebServerRequest* request)
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
     Utils::removeAllFiles();
-    RestartHelper.triggerRestart();
+    RestartHelper.triggerRestart(false);
 }
 
 void WebApiFileClass::onFileUpload(AsyncWebServerRequest* request, String filename, size_t index, uint8_t* data, size_t len, bool final)
@@ -156,24 +180,130 @@ void WebApiFileClass::onFileUpload(AsyncWebServerRequest* request, String filena
         return;
     }
 
+    std::unique_lock<std::mutex> lock(_uploadMutex);
+
     if (!index) {
-        // open the file on first call and store the file handle in the request object
         if (!request->hasParam("file")) {
             request->send(500);
             return;
         }
-        const String name = "/" + request->getParam("file")->value();
-        request->_tempFile = LittleFS.open(name, "w");
+
+        if (_spUpload && !_spUpload->Done) {
+            request->send(409);
+            return;
+        }
+
+        _spUpload = std::make_shared<Upload>();
+        _spUpload->Request = request;
+        _spUpload->Name = "/" + request->getParam("file")->value();
+
+        WebApi.onRequestEnd(request, [this, request]() {
+            std::lock_guard<std::mutex> lock(_uploadMutex);
+            if (!_spUpload || _spUpload->Request != request) { return; }
+            _spUpload->Request = nullptr;
+            _spUpload->Complete = true;
+            _uploadCv.notify_all();
+        });
     }
 
+    auto spUpload = _spUpload;
+    if (!spUpload || spUpload->Request != request) { return; }
+
+    // throttles the client, as the TCP stack cannot deliver more data
+    // while we wait. this only happens if the flash is slower than the
+    // network and takes no longer than writing one chunk.
+    _uploadCv.wait(lock, [&spUpload, len]() {
+        return spUpload->QueuedBytes == 0
+            || spUpload->QueuedBytes + len <= _maxQueuedBytes
+            || spUpload->Request == nullptr;
+    });
+
     if (len) {
-        // stream the incoming chunk to the opened file
-        request->_tempFile.write(data, len);
+        spUpload->Chunks.emplace_back(data, data + len);
+        spUpload->QueuedBytes += len;
+    }
+
+    if (final) { spUpload->Complete = true; }
+
+    _uploadCv.notify_all();
+}
+
+void WebApiFileClass::writerLoopHelper(void* context)
+{
+    static_cast<WebApiFileClass*>(context)->writerLoop();
+}
+
+void WebApiFileClass::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(_uploadMutex);
+
+    while (true) {
+        _uploadCv.wait(lock, [this]() {
+            return _spUpload && !_spUpload->Done
+                && (!_spUpload->Chunks.empty() || _spUpload->Complete);
+        });
+
+        auto spUpload = _spUpload;
+
+        if (spUpload->Chunks.empty()) {
+            bool aborted = spUpload->Request == nullptr;
+            lock.unlock();
+            finishUpload(*spUpload, aborted);
+            lock.lock();
+            spUpload->Done = true;
+            _uploadCv.notify_all();
+            continue;
+        }
+
+        auto chunk = std::move(spUpload->Chunks.front());
+        spUpload->Chunks.pop_front();
+
+        lock.unlock();
+        bool success = writeChunk(*spUpload, chunk);
+        lock.lock();
+
+        spUpload->QueuedBytes -= chunk.size();
+        if (!success) { spUpload->Failed = true; }
+        _uploadCv.notify_all();
+    }
+}
+
+bool WebApiFileClass::writeChunk(Upload& upload, std::vector<uint8_t> const& chunk)
+{
+    if (upload.Failed) { return false; }
+
+    if (!upload.F) {
+        if (upload.Name == CONFIG_FILENAME) {
+            LittleFS.remove(CONFIG_SNAPSHOT_FILENAME);
+            LittleFS.remove(CONFIG_JOURNAL_FILENAME);
+        }
+        if (upload.Name == PINMAPPING_FILENAME) {
+            LittleFS.remove(PINMAPPING_CACHE_FILENAME);
+        }
+        upload.F = LittleFS.open(upload.Name, "w");
+        if (!upload.F) { return false; }
+    }
+
+    size_t written = upload.F.write(chunk.data(), chunk.size());
+
+    FsWriteMonitor.record(upload.Name.endsWith(LANG_PACK_SUFFIX)
+            ? FsWriteMonitorClass::Category::LanguagePack
+            : FsWriteMonitorClass::Category::Upload, written);
+
+    return written == chunk.size();
+}
+
+void WebApiFileClass::finishUpload(Upload& upload, bool aborted)
+{
+    if (upload.F) { upload.F.close(); }
+
+    if (upload.Failed || aborted) {
+        MessageOutput.printf("[WebApiFile] upload of %s failed\r\n", upload.Name.c_str());
+        return;
     }
 
-    if (final) {
-        // close the file handle as the upload is now done
-        request->_tempFile.close();
+    if (upload.Name.endsWith(LANG_PACK_SUFFIX)) {
+        I18n.updateIndex(upload.Name);
     }
 }
 
@@ -183,12 +313,33 @@ void WebApiFileClass::onFileUploadFinish(AsyncWebServerRequest* request)
         return;
     }
 
-    // the request handler is triggered after the upload has finished...
-    // create the response, add header, and send response
+    std::shared_ptr<Upload> spUpload;
+    {
+        std::lock_guard<std::mutex> lock(_uploadMutex);
+        if (_spUpload && _spUpload->Request == request) { spUpload = _spUpload; }
+    }
+
+    if (!spUpload) {
+        request->send(500);
+        return;
+    }
 
-    AsyncWebServerResponse* response = request->beginResponse(200, "text/plain", "OK");
+    // the request handler is triggered after the upload was received. the
+    // response is held back until the writer task wrote all of it.
+    auto response = request->beginChunkedResponse("text/plain",
+        [this, spUpload](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            {
+                std::lock_guard<std::mutex> lock(_uploadMutex);
+                if (!spUpload->Done) { return RESPONSE_TRY_AGAIN; }
+            }
+
+            if (index > 0 || maxLen < 2) { return 0; }
+
+            memcpy(buffer, "OK", 2);
+            RestartHelper.triggerRestart(false); // config.json might be replaced
+            return 2;
+        });
     response->addHeader("Connection", "close");
     response->addHeader("Access-Control-Allow-Origin", "*");
     request->send(response);
-    RestartHelper.triggerRestart();
 }
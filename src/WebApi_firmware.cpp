@@ -4,13 +4,27 @@
  */
 #include "WebApi_firmware.h"
 #include "Configuration.h"
+#include "JsonArena.h"
+#include "MessageOutput.h"
 #include "RestartHelper.h"
+#include "TaskMonitor.h"
+#include "Utils.h"
 #include "WebApi.h"
+#include "defaults.h"
 #include "helper.h"
 #include <AsyncJson.h>
+#include <MD5Builder.h>
 #include <Update.h>
+#include <vector>
+#include "esp_ota_ops.h"
 #include "esp_partition.h"
 
+WebApiFirmwareClass::WebApiFirmwareClass()
+    : _ws("/firmwareupdate")
+    , _progressTask(500 * TASK_MILLISECOND, TASK_FOREVER, TaskMonitor.wrap("WebApiFirmware::progressLoop", std::bind(&WebApiFirmwareClass::progressLoop, this)))
+{
+}
+
 void WebApiFirmwareClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
@@ -25,6 +39,27 @@ void WebApiFirmwareClass::init(AsyncWebServer& server, Scheduler& scheduler)
         std::bind(&WebApiFirmwareClass::onFirmwareUpdateUpload, this, _1, _2, _3, _4, _5, _6));
 
     server.on("/api/firmware/status", HTTP_GET, std::bind(&WebApiFirmwareClass::onFirmwareStatus, this, _1));
+
+    server.addHandler(&_ws);
+
+    scheduler.addTask(_progressTask);
+    _progressTask.enable();
+
+    _simpleDigestAuth.setUsername(AUTH_USERNAME);
+    _simpleDigestAuth.setRealm("firmware update websocket");
+
+    reload();
+}
+
+void WebApiFirmwareClass::reload()
+{
+    // the progress of an update is never shown to readonly users
+    _ws.removeMiddleware(&_simpleDigestAuth);
+    _ws.enable(false);
+    _simpleDigestAuth.setPassword(Configuration.get().Security.Password);
+    _ws.addMiddleware(&_simpleDigestAuth);
+    _ws.closeAll();
+    _ws.enable(true);
 }
 
 bool WebApiFirmwareClass::otaSupported() const
@@ -40,14 +75,47 @@ void WebApiFirmwareClass::onFirmwareUpdateFinish(AsyncWebServerRequest* request)
         return;
     }
 
-    // the request handler is triggered after the upload has finished...
-    // create the response, add header, and send response
+    // the upload handler already responded
+    if (!otaSupported()) {
+        return;
+    }
 
-    AsyncWebServerResponse* response = request->beginResponse((Update.hasError()) ? 500 : 200, "text/plain", (Update.hasError()) ? "FAIL" : "OK");
+    if (request != _uploadRequest) {
+        return request->send(409, "text/plain", "OTA update already in progress");
+    }
+    _uploadRequest = nullptr;
+
+    // the request handler is triggered after the upload has finished, but
+    // the writer task might still be busy writing and verifying the image.
+    // the web server must not wait for that, so the result is sent by the
+    // progress websocket and the restart is triggered by progressLoop().
+    State state = _state;
+    if ((state == State::Receiving || state == State::Verifying)
+            && xSemaphoreTake(_writerDone, pdMS_TO_TICKS(_finishWaitMillis)) != pdTRUE) {
+        _restartOnDone = true;
+        AsyncWebServerResponse* response = request->beginResponse(202, "text/plain", "Verifying");
+        response->addHeader("Access-Control-Allow-Origin", "*");
+        return request->send(response);
+    }
+
+    bool success = _state == State::Done;
+
+    AsyncWebServerResponse* response = request->beginResponse(success ? 200 : 500, "text/plain", success ? "OK" : _error.load());
     response->addHeader("Connection", "close");
     response->addHeader("Access-Control-Allow-Origin", "*");
     request->send(response);
-    RestartHelper.triggerRestart();
+
+    if (success) {
+        RestartHelper.triggerRestart();
+    }
+}
+
+void WebApiFirmwareClass::fail(char const* error)
+{
+    _error = error;
+    _state = State::Failed;
+    _durationMillis = millis() - _startMillis;
+    MessageOutput.printf("[WebApiFirmware] %s\r\n", error);
 }
 
 void WebApiFirmwareClass::onFirmwareUpdateUpload(AsyncWebServerRequest* request, String filename, size_t index, uint8_t* data, size_t len, bool final)
@@ -60,37 +128,259 @@ void WebApiFirmwareClass::onFirmwareUpdateUpload(AsyncWebServerRequest* request,
         return request->send(500, "text/plain", "OTA updates not supported");
     }
 
+    // from here on, errors are reported by onFirmwareUpdateFinish(), which
+    // is called once the upload is complete.
+
     // Upload handler chunks in data
     if (!index) {
+        State state = _state;
+        if (state == State::Receiving || state == State::Verifying) {
+            return;
+        }
+
+        _uploadRequest = request;
+        _startMillis = millis();
+
         if (!request->hasParam("MD5", true)) {
-            return request->send(400, "text/plain", "MD5 parameter missing");
+            return fail("MD5 parameter missing");
         }
 
-        if (!Update.setMD5(request->getParam("MD5", true)->value().c_str())) {
-            return request->send(400, "text/plain", "MD5 parameter invalid");
+        _compressed = OtaInflater::isCompressed(data, len);
+        _uploadMd5 = request->getParam("MD5", true)->value();
+
+        if (_uploadMd5.length() != 32 || (!_compressed && !Update.setMD5(_uploadMd5.c_str()))) {
+            return fail("MD5 parameter invalid");
         }
 
+        // the new firmware discards the configuration journal
+        Configuration.flush();
+
         if (!Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH)) { // Start with max available size
             Update.printError(Serial);
-            return request->send(400, "text/plain", "OTA could not begin");
+            return fail("OTA could not begin");
+        }
+
+        if (!startWriter(request->contentLength())) {
+            Update.abort();
+            return fail("OTA could not start flash writer");
         }
     }
 
-    // Write chunked data to the free sketch space
-    if (len) {
-        if (Update.write(data, len) != len) {
-            return request->send(400, "text/plain", "OTA could not begin");
+    if (request != _uploadRequest || _state != State::Receiving) {
+        return;
+    }
+
+    // blocks while the writer task is busy and the buffer is full, which
+    // slows down the upload by means of TCP flow control.
+    size_t sent = 0;
+    uint32_t lastProgress = millis();
+    while (sent < len && _state == State::Receiving) {
+        size_t chunk = xStreamBufferSend(_streamBuffer, data + sent, len - sent, pdMS_TO_TICKS(100));
+        if (chunk > 0) {
+            sent += chunk;
+            lastProgress = millis();
+        } else if (millis() - lastProgress > _writerIdleTimeoutMillis) {
+            abortWriter();
+            return fail("Flash writer stalled");
         }
     }
+    _received += sent;
 
     if (final) { // if the final flag is set then this is the last frame of data
-        if (!Update.end(true)) { // true to set the size to the current progress
-            Update.printError(Serial);
-            return request->send(400, "text/plain", "Could not end OTA");
+        _uploadComplete = true;
+    }
+}
+
+bool WebApiFirmwareClass::startWriter(size_t expectedSize)
+{
+    if (_streamBuffer == nullptr) {
+        _streamBuffer = xStreamBufferCreate(_streamBufferSize, 1);
+    }
+
+    if (_writerDone == nullptr) {
+        _writerDone = xSemaphoreCreateBinary();
+    }
+
+    if (_streamBuffer == nullptr || _writerDone == nullptr) { return false; }
+
+    xStreamBufferReset(_streamBuffer);
+    xSemaphoreTake(_writerDone, 0);
+
+    _uploadComplete = false;
+    _abortRequested = false;
+    _restartOnDone = false;
+    _expectedSize = expectedSize;
+    _received = 0;
+    _written = 0;
+    _durationMillis = 0;
+    _error = "";
+    _state = State::Receiving;
+
+    // Update.end() verifies the whole image, which requires some stack
+    uint32_t constexpr stackSize = 6144;
+    if (pdPASS != xTaskCreate(WebApiFirmwareClass::writerLoopHelper, "OTA",
+                stackSize, this, 1/*prio*/, &_writerTaskHandle)) {
+        _writerTaskHandle = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void WebApiFirmwareClass::abortWriter()
+{
+    _abortRequested = true;
+}
+
+void WebApiFirmwareClass::writerLoopHelper(void* context)
+{
+    auto pInstance = static_cast<WebApiFirmwareClass*>(context);
+    pInstance->writerLoop();
+    pInstance->_inflater.end();
+    xSemaphoreGive(pInstance->_writerDone);
+    pInstance->_writerTaskHandle = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void WebApiFirmwareClass::writerLoop()
+{
+    // the updater erases and writes the flash sector by sector
+    std::vector<uint8_t> chunk(SPI_FLASH_SEC_SIZE);
+    uint32_t lastData = millis();
+
+    MD5Builder md5;
+    md5.begin();
+
+    bool compressed = _compressed;
+    if (compressed && !_inflater.begin([](uint8_t const* data, size_t len) {
+                return Update.write(const_cast<uint8_t*>(data), len) == len;
+            })) {
+        Update.abort();
+        return fail(_inflater.getError());
+    }
+
+    while (true) {
+        size_t len = xStreamBufferReceive(_streamBuffer, chunk.data(), chunk.size(), pdMS_TO_TICKS(100));
+
+        if (_abortRequested) {
+            Update.abort();
+            if (_state != State::Failed) { fail("OTA aborted"); }
+            return;
         }
-    } else {
-        return;
+
+        if (len > 0) {
+            if (compressed) {
+                md5.add(chunk.data(), len);
+                if (!_inflater.write(chunk.data(), len)) {
+                    Update.printError(Serial);
+                    fail(_inflater.getError());
+                    Update.abort();
+                    return;
+                }
+            } else if (Update.write(chunk.data(), len) != len) {
+                Update.printError(Serial);
+                fail("Could not write flash");
+                Update.abort();
+                return;
+            }
+            _written += len; // of the uploaded file
+            lastData = millis();
+            continue;
+        }
+
+        // the flag is set after the last chunk was put into the buffer
+        if (_uploadComplete && xStreamBufferIsEmpty(_streamBuffer) == pdTRUE) {
+            break;
+        }
+
+        // the client went away without completing the upload
+        if (millis() - lastData > _writerIdleTimeoutMillis) {
+            Update.abort();
+            return fail("Upload stalled");
+        }
+    }
+
+    _state = State::Verifying;
+
+    if (compressed) {
+        md5.calculate();
+        if (!_inflater.isComplete()) {
+            Update.abort();
+            return fail("The compressed image is incomplete");
+        }
+        if (!md5.toString().equalsIgnoreCase(_uploadMd5)) {
+            Update.abort();
+            return fail("MD5 check failed");
+        }
+        _inflater.end(); // releases its buffers before verifying the image
+    }
+
+    if (!Update.end(true)) { // true to set the size to the current progress
+        Update.printError(Serial);
+        return fail(Update.errorString());
+    }
+
+    _durationMillis = millis() - _startMillis;
+    _state = State::Done;
+}
+
+char const* WebApiFirmwareClass::getStateName(State state)
+{
+    switch (state) {
+        case State::Idle:
+            return "idle";
+        case State::Receiving:
+            return "receiving";
+        case State::Verifying:
+            return "verifying";
+        case State::Done:
+            return "done";
+        case State::Failed:
+            return "failed";
     }
+    return "unknown";
+}
+
+void WebApiFirmwareClass::progressLoop()
+{
+    _ws.cleanupClients();
+
+    State state = _state;
+    bool finished = state != State::Receiving && state != State::Verifying;
+
+    // once the update ended, its final state is sent only once
+    if (_ws.count() > 0 && (!finished || state != _lastSentState)) {
+        sendProgress();
+        _lastSentState = state;
+    }
+
+    // the writer finished after onFirmwareUpdateFinish() replied
+    if (finished && _restartOnDone.exchange(false) && state == State::Done) {
+        RestartHelper.triggerRestart();
+    }
+}
+
+void WebApiFirmwareClass::sendProgress()
+{
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
+
+    State state = _state;
+    uint32_t written = _written;
+    uint32_t elapsed = (state == State::Receiving || state == State::Verifying)
+        ? millis() - _startMillis : _durationMillis.load();
+
+    root["state"] = getStateName(state);
+    root["expected"] = _expectedSize.load();
+    root["received"] = _received.load();
+    root["written"] = written;
+    root["elapsed_ms"] = elapsed;
+    root["throughput"] = (elapsed > 0) ? static_cast<uint64_t>(written) * 1000 / elapsed : 0; // bytes per second
+    if (state == State::Failed) { root["error"] = _error.load(); }
+
+    if (!Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) { return; }
+
+    _ws.textAll(Utils::serializeJsonShared(root));
 }
 
 void WebApiFirmwareClass::onFirmwareStatus(AsyncWebServerRequest* request)
@@ -104,5 +394,50 @@ void WebApiFirmwareClass::onFirmwareStatus(AsyncWebServerRequest* request)
 
     root["ota_supported"] = otaSupported();
 
+    // the bootloader falls back to the previous image if the new one does
+    // not boot, in which case the new one is marked invalid.
+    auto getImageStateName = [](esp_ota_img_states_t state) -> char const* {
+        switch (state) {
+            case ESP_OTA_IMG_NEW:
+                return "new";
+            case ESP_OTA_IMG_PENDING_VERIFY:
+                return "pending_verify";
+            case ESP_OTA_IMG_VALID:
+                return "valid";
+            case ESP_OTA_IMG_INVALID:
+                return "invalid";
+            case ESP_OTA_IMG_ABORTED:
+                return "aborted";
+            default:
+                return "undefined";
+        }
+    };
+
+    esp_partition_t const* pRunning = esp_ota_get_running_partition();
+    esp_partition_t const* pBoot = esp_ota_get_boot_partition();
+    esp_partition_t const* pInvalid = esp_ota_get_last_invalid_partition();
+
+    auto partitionObj = root["partitions"].to<JsonObject>();
+    partitionObj["running"] = (pRunning != nullptr) ? pRunning->label : "";
+    partitionObj["boot"] = (pBoot != nullptr) ? pBoot->label : "";
+
+    esp_ota_img_states_t imageState;
+    if (pRunning != nullptr && esp_ota_get_state_partition(pRunning, &imageState) == ESP_OK) {
+        partitionObj["running_state"] = getImageStateName(imageState);
+    }
+
+    root["rolled_back"] = pInvalid != nullptr;
+    if (pInvalid != nullptr) {
+        partitionObj["invalid"] = pInvalid->label;
+    }
+
+    // the most recent update attempt since boot
+    State state = _state;
+    auto updateObj = root["last_update"].to<JsonObject>();
+    updateObj["state"] = getStateName(state);
+    updateObj["written"] = _written.load();
+    updateObj["duration_ms"] = _durationMillis.load();
+    if (state == State::Failed) { updateObj["error"] = _error.load(); }
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
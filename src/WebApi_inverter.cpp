@@ -3,7 +3,10 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_inverter.h"
+#include "JsonArena.h"
 #include "Configuration.h"
+#include "InverterDataCache.h"
+#include "MessageOutput.h"
 #include "MqttHandleHass.h"
 #include "PowerLimiter.h"
 #include "WebApi.h"
@@ -18,10 +21,10 @@ void WebApiInverterClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_1;
 
     server.on("/api/inverter/list", HTTP_GET, std::bind(&WebApiInverterClass::onInverterList, this, _1));
-    server.on("/api/inverter/add", HTTP_POST, std::bind(&WebApiInverterClass::onInverterAdd, this, _1));
-    server.on("/api/inverter/edit", HTTP_POST, std::bind(&WebApiInverterClass::onInverterEdit, this, _1));
-    server.on("/api/inverter/del", HTTP_POST, std::bind(&WebApiInverterClass::onInverterDelete, this, _1));
-    server.on("/api/inverter/order", HTTP_POST, std::bind(&WebApiInverterClass::onInverterOrder, this, _1));
+    server.on("/api/inverter/add", HTTP_POST, std::bind(&WebApiInverterClass::onInverterAdd, this, _1), nullptr, WebApiClass::onRequestBody);
+    server.on("/api/inverter/edit", HTTP_POST, std::bind(&WebApiInverterClass::onInverterEdit, this, _1), nullptr, WebApiClass::onRequestBody);
+    server.on("/api/inverter/del", HTTP_POST, std::bind(&WebApiInverterClass::onInverterDelete, this, _1), nullptr, WebApiClass::onRequestBody);
+    server.on("/api/inverter/order", HTTP_POST, std::bind(&WebApiInverterClass::onInverterOrder, this, _1), nullptr, WebApiClass::onRequestBody);
     server.on("/api/inverter/stats_reset", HTTP_GET, std::bind(&WebApiInverterClass::onInverterStatReset, this, _1));
 }
 
@@ -31,56 +34,120 @@ void WebApiInverterClass::onInverterList(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
-    JsonArray data = root["inverter"].to<JsonArray>();
+    try {
+        auto spGenerator = std::make_shared<Generator>();
 
-    const CONFIG_T& config = Configuration.get();
+        auto response = WebApi.beginChunkedResponse(request, "application/json",
+            [spGenerator](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                return fillChunk(*spGenerator, buffer, maxLen);
+            });
 
-    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        if (config.Inverter[i].Serial > 0) {
-            JsonObject obj = data.add<JsonObject>();
-            obj["id"] = i;
-            obj["name"] = String(config.Inverter[i].Name);
-            obj["order"] = config.Inverter[i].Order;
-
-            // Inverter Serial is read as HEX
-            char buffer[sizeof(uint64_t) * 8 + 1];
-            snprintf(buffer, sizeof(buffer), "%0" PRIx32 "%08" PRIx32,
-                static_cast<uint32_t>((config.Inverter[i].Serial >> 32) & 0xFFFFFFFF),
-                static_cast<uint32_t>(config.Inverter[i].Serial & 0xFFFFFFFF));
-            obj["serial"] = buffer;
-            obj["poll_enable"] = config.Inverter[i].Poll_Enable;
-            obj["poll_enable_night"] = config.Inverter[i].Poll_Enable_Night;
-            obj["command_enable"] = config.Inverter[i].Command_Enable;
-            obj["command_enable_night"] = config.Inverter[i].Command_Enable_Night;
-            obj["reachable_threshold"] = config.Inverter[i].ReachableThreshold;
-            obj["zero_runtime"] = config.Inverter[i].ZeroRuntimeDataIfUnrechable;
-            obj["zero_day"] = config.Inverter[i].ZeroYieldDayOnMidnight;
-            obj["clear_eventlog"] = config.Inverter[i].ClearEventlogOnMidnight;
-            obj["yieldday_correction"] = config.Inverter[i].YieldDayCorrection;
-
-            auto inv = Hoymiles.getInverterBySerial(config.Inverter[i].Serial);
-            uint8_t max_channels;
-            if (inv == nullptr) {
-                obj["type"] = "Unknown";
-                max_channels = INV_MAX_CHAN_COUNT;
-            } else {
-                obj["type"] = inv->typeName();
-                max_channels = inv->Statistics()->getChannelsByType(TYPE_DC).size();
-            }
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
 
-            JsonArray channel = obj["channel"].to<JsonArray>();
-            for (uint8_t c = 0; c < max_channels; c++) {
-                JsonObject chanData = channel.add<JsonObject>();
-                chanData["name"] = config.Inverter[i].channel[c].Name;
-                chanData["max_power"] = config.Inverter[i].channel[c].MaxChannelPower;
-                chanData["yield_total_offset"] = config.Inverter[i].channel[c].YieldTotalOffset;
-            }
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/inverter/list has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+
+        WebApi.sendTooManyRequests(request);
+    }
+}
+
+size_t WebApiInverterClass::fillChunk(Generator& gen, uint8_t* buffer, size_t maxLen)
+{
+    try {
+        while (gen.Offset >= gen.Pending.length()) {
+            gen.Pending = ""; // keeps the allocated buffer
+            gen.Offset = 0;
+            if (!generateNext(gen)) { return 0; }
         }
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/inverter/list has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+        return 0;
     }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+    size_t len = std::min(maxLen, gen.Pending.length() - gen.Offset);
+    memcpy(buffer, gen.Pending.c_str() + gen.Offset, len);
+    gen.Offset += len;
+    return len;
+}
+
+// generates the next part of the response into gen.Pending. returns false
+// once the response is complete.
+bool WebApiInverterClass::generateNext(Generator& gen)
+{
+    if (gen.Done) {
+        return false;
+    }
+
+    if (!gen.HeaderDone) {
+        gen.HeaderDone = true;
+        gen.Pending += "{\"inverter\":[";
+        return true;
+    }
+
+    const CONFIG_T& config = Configuration.get();
+
+    while (gen.NextInverter < INV_MAX_COUNT && config.Inverter[gen.NextInverter].Serial == 0) {
+        gen.NextInverter++;
+    }
+
+    if (gen.NextInverter >= INV_MAX_COUNT) {
+        gen.Done = true;
+        gen.Pending += "]}";
+        return true;
+    }
+
+    const uint8_t i = gen.NextInverter++;
+
+    JsonDocument doc;
+    JsonObject obj = doc.to<JsonObject>();
+    obj["id"] = i;
+    obj["name"] = String(config.Inverter[i].Name);
+    obj["order"] = config.Inverter[i].Order;
+
+    // Inverter Serial is read as HEX
+    char buffer[sizeof(uint64_t) * 8 + 1];
+    snprintf(buffer, sizeof(buffer), "%0" PRIx32 "%08" PRIx32,
+        static_cast<uint32_t>((config.Inverter[i].Serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(config.Inverter[i].Serial & 0xFFFFFFFF));
+    obj["serial"] = buffer;
+    obj["poll_enable"] = config.Inverter[i].Poll_Enable;
+    obj["poll_enable_night"] = config.Inverter[i].Poll_Enable_Night;
+    obj["command_enable"] = config.Inverter[i].Command_Enable;
+    obj["command_enable_night"] = config.Inverter[i].Command_Enable_Night;
+    obj["reachable_threshold"] = config.Inverter[i].ReachableThreshold;
+    obj["zero_runtime"] = config.Inverter[i].ZeroRuntimeDataIfUnrechable;
+    obj["zero_day"] = config.Inverter[i].ZeroYieldDayOnMidnight;
+    obj["clear_eventlog"] = config.Inverter[i].ClearEventlogOnMidnight;
+    obj["yieldday_correction"] = config.Inverter[i].YieldDayCorrection;
+    obj["nrf_radio"] = config.Inverter[i].NrfRadio;
+
+    auto inv = Hoymiles.getInverterBySerial(config.Inverter[i].Serial);
+    uint8_t max_channels;
+    if (inv == nullptr) {
+        obj["type"] = "Unknown";
+        max_channels = INV_MAX_CHAN_COUNT;
+    } else {
+        obj["type"] = inv->typeName();
+        max_channels = inv->Statistics()->getChannelsByType(TYPE_DC).size();
+    }
+
+    JsonArray channel = obj["channel"].to<JsonArray>();
+    for (uint8_t c = 0; c < max_channels; c++) {
+        JsonObject chanData = channel.add<JsonObject>();
+        chanData["name"] = config.Inverter[i].channel[c].Name;
+        chanData["max_power"] = config.Inverter[i].channel[c].MaxChannelPower;
+        chanData["yield_total_offset"] = config.Inverter[i].channel[c].YieldTotalOffset;
+    }
+
+    String serialized;
+    serializeJson(doc, serialized);
+
+    if (gen.Count++ > 0) {
+        gen.Pending += ",";
+    }
+    gen.Pending += serialized;
+    return true;
 }
 
 void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
@@ -90,7 +157,8 @@ void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -142,7 +210,7 @@ void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
-    auto inv = Hoymiles.addInverter(inverter->Name, inverter->Serial);
+    auto inv = Hoymiles.addInverter(inverter->Name, inverter->Serial, inverter->NrfRadio);
 
     if (inv != nullptr) {
         for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
@@ -162,7 +230,8 @@ void WebApiInverterClass::onInverterEdit(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -233,6 +302,7 @@ void WebApiInverterClass::onInverterEdit(AsyncWebServerRequest* request)
         inverter.ZeroYieldDayOnMidnight = root["zero_day"] | false;
         inverter.ClearEventlogOnMidnight = root["clear_eventlog"] | false;
         inverter.YieldDayCorrection = root["yieldday_correction"] | false;
+        inverter.NrfRadio = root["nrf_radio"] | 0;
 
         uint8_t arrayCount = 0;
         for (JsonVariant channel : channelArray) {
@@ -253,13 +323,15 @@ void WebApiInverterClass::onInverterEdit(AsyncWebServerRequest* request)
     if (inv != nullptr && new_serial != old_serial) {
         // Valid inverter exists but serial changed --> remove it and insert new one
         Hoymiles.removeInverterBySerial(old_serial);
-        inv = Hoymiles.addInverter(inverter.Name, inverter.Serial);
+        InverterDataCache.remove(old_serial);
+        inv = Hoymiles.addInverter(inverter.Name, inverter.Serial, inverter.NrfRadio);
     } else if (inv != nullptr && new_serial == old_serial) {
-        // Valid inverter exists and serial stays the same --> update name
+        // Valid inverter exists and serial stays the same --> update name and radio
         inv->setName(inverter.Name);
+        Hoymiles.setInverterRadioNrf(inverter.Serial, inverter.NrfRadio);
     } else if (inv == nullptr) {
         // Valid inverter did not exist --> try to create one
-        inv = Hoymiles.addInverter(inverter.Name, inverter.Serial);
+        inv = Hoymiles.addInverter(inverter.Name, inverter.Serial, inverter.NrfRadio);
     }
 
     if (inv != nullptr) {
@@ -288,7 +360,8 @@ void WebApiInverterClass::onInverterDelete(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -313,6 +386,7 @@ void WebApiInverterClass::onInverterDelete(AsyncWebServerRequest* request)
     INVERTER_CONFIG_T const& inverter = Configuration.get().Inverter[inverter_id];
 
     Hoymiles.removeInverterBySerial(inverter.Serial);
+    InverterDataCache.remove(inverter.Serial);
 
     Configuration.deleteInverterById(inverter_id);
 
@@ -332,7 +406,8 @@ void WebApiInverterClass::onInverterOrder(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -3,6 +3,7 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_limit.h"
+#include "JsonArena.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
 #include "defaults.h"
@@ -15,7 +16,7 @@ void WebApiLimitClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_1;
 
     server.on("/api/limit/status", HTTP_GET, std::bind(&WebApiLimitClass::onLimitStatus, this, _1));
-    server.on("/api/limit/config", HTTP_POST, std::bind(&WebApiLimitClass::onLimitPost, this, _1));
+    server.on("/api/limit/config", HTTP_POST, std::bind(&WebApiLimitClass::onLimitPost, this, _1), nullptr, WebApiClass::onRequestBody);
 }
 
 void WebApiLimitClass::onLimitStatus(AsyncWebServerRequest* request)
@@ -25,8 +26,13 @@ void WebApiLimitClass::onLimitStatus(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
+    generateStatus(response->getRoot().to<JsonObject>());
 
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiLimitClass::generateStatus(JsonObject root)
+{
     for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
         auto inv = Hoymiles.getInverterByPos(i);
 
@@ -46,8 +52,6 @@ void WebApiLimitClass::onLimitStatus(AsyncWebServerRequest* request)
         }
         root[serial]["limit_set_status"] = limitStatus;
     }
-
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
 void WebApiLimitClass::onLimitPost(AsyncWebServerRequest* request)
@@ -57,7 +61,8 @@ void WebApiLimitClass::onLimitPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -113,7 +118,10 @@ void WebApiLimitClass::onLimitPost(AsyncWebServerRequest* request)
         return;
     }
 
-    inv->sendActivePowerControlRequest(limit, type);
+    // completion is announced with this id via MQTT and the live websocket
+    if (inv->sendActivePowerControlRequest(limit, type)) {
+        retMsg["command_id"] = inv->getLastControlCommandId();
+    }
 
     retMsg["type"] = "success";
     retMsg["message"] = "Settings saved!";
@@ -3,13 +3,17 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_mqtt.h"
+#include "JsonArena.h"
 #include "Configuration.h"
 #include "MqttHandleBatteryHass.h"
 #include "MqttHandleHass.h"
 #include "MqttHandlePowerLimiterHass.h"
+#include "MqttHandleDtu.h"
 #include "MqttHandleInverter.h"
+#include "MqttHandleInverterTotal.h"
 #include "MqttHandleHuawei.h"
 #include "MqttHandlePowerLimiter.h"
+#include "MqttHassPublisher.h"
 #include "MqttSettings.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
@@ -25,7 +29,7 @@ void WebApiMqttClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     server.on("/api/mqtt/status", HTTP_GET, std::bind(&WebApiMqttClass::onMqttStatus, this, _1));
     server.on("/api/mqtt/config", HTTP_GET, std::bind(&WebApiMqttClass::onMqttAdminGet, this, _1));
-    server.on("/api/mqtt/config", HTTP_POST, std::bind(&WebApiMqttClass::onMqttAdminPost, this, _1));
+    server.on("/api/mqtt/config", HTTP_POST, std::bind(&WebApiMqttClass::onMqttAdminPost, this, _1), nullptr, WebApiClass::onRequestBody);
 }
 
 void WebApiMqttClass::onMqttStatus(AsyncWebServerRequest* request)
@@ -60,6 +64,19 @@ void WebApiMqttClass::onMqttStatus(AsyncWebServerRequest* request)
     root["mqtt_hass_topic"] = config.Mqtt.Hass.Topic;
     root["mqtt_hass_individualpanels"] = config.Mqtt.Hass.IndividualPanels;
 
+    auto outboxObj = root["mqtt_outbox"].to<JsonObject>();
+    auto addOutbox = [&outboxObj](const char* name, MqttPublishPriority priority) {
+        auto stats = MqttSettings.getOutboxStats(priority);
+        auto obj = outboxObj[name].to<JsonObject>();
+        obj["queued"] = stats.Queued;
+        obj["queued_bytes"] = stats.QueuedBytes;
+        obj["published"] = stats.Published;
+        obj["dropped"] = stats.Dropped;
+    };
+    addOutbox("control", MqttPublishPriority::Control);
+    addOutbox("discovery", MqttPublishPriority::Discovery);
+    addOutbox("telemetry", MqttPublishPriority::Telemetry);
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
@@ -93,6 +110,13 @@ void WebApiMqttClass::onMqttAdminGet(AsyncWebServerRequest* request)
     root["mqtt_lwt_qos"] = config.Mqtt.Lwt.Qos;
     root["mqtt_publish_interval"] = config.Mqtt.PublishInterval;
     root["mqtt_clean_session"] = config.Mqtt.CleanSession;
+    root["mqtt_deadband_power"] = config.Mqtt.Deadband.Power;
+    root["mqtt_deadband_voltage"] = config.Mqtt.Deadband.Voltage;
+    root["mqtt_deadband_current"] = config.Mqtt.Deadband.Current;
+    root["mqtt_deadband_frequency"] = config.Mqtt.Deadband.Frequency;
+    root["mqtt_deadband_temperature"] = config.Mqtt.Deadband.Temperature;
+    root["mqtt_deadband_power_factor"] = config.Mqtt.Deadband.PowerFactor;
+    root["mqtt_deadband_percent"] = config.Mqtt.Deadband.Percent;
     root["mqtt_hass_enabled"] = config.Mqtt.Hass.Enabled;
     root["mqtt_hass_expire"] = config.Mqtt.Hass.Expire;
     root["mqtt_hass_retain"] = config.Mqtt.Hass.Retain;
@@ -109,7 +133,8 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -135,6 +160,13 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
             && root["mqtt_lwt_qos"].is<uint8_t>()
             && root["mqtt_publish_interval"].is<uint32_t>()
             && root["mqtt_clean_session"].is<bool>()
+            && root["mqtt_deadband_power"].is<float>()
+            && root["mqtt_deadband_voltage"].is<float>()
+            && root["mqtt_deadband_current"].is<float>()
+            && root["mqtt_deadband_frequency"].is<float>()
+            && root["mqtt_deadband_temperature"].is<float>()
+            && root["mqtt_deadband_power_factor"].is<float>()
+            && root["mqtt_deadband_percent"].is<float>()
             && root["mqtt_hass_enabled"].is<bool>()
             && root["mqtt_hass_expire"].is<bool>()
             && root["mqtt_hass_retain"].is<bool>()
@@ -263,6 +295,17 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
             return;
         }
 
+        for (auto key : { "mqtt_deadband_power", "mqtt_deadband_voltage", "mqtt_deadband_current",
+                    "mqtt_deadband_frequency", "mqtt_deadband_temperature",
+                    "mqtt_deadband_power_factor", "mqtt_deadband_percent" }) {
+            if (root[key].as<float>() < 0) {
+                retMsg["message"] = "Deadbands must not be negative!";
+                retMsg["code"] = WebApiError::MqttDeadband;
+                WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+                return;
+            }
+        }
+
         if (root["mqtt_hass_enabled"].as<bool>()) {
             if (root["mqtt_hass_topic"].as<String>().length() > MQTT_MAX_TOPIC_STRLEN) {
                 retMsg["message"] = "Hass topic must not be longer than " STR(MQTT_MAX_TOPIC_STRLEN) " characters!";
@@ -304,6 +347,13 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
         config.Mqtt.Lwt.Qos = root["mqtt_lwt_qos"].as<uint8_t>();
         config.Mqtt.PublishInterval = root["mqtt_publish_interval"].as<uint32_t>();
         config.Mqtt.CleanSession = root["mqtt_clean_session"].as<bool>();
+        config.Mqtt.Deadband.Power = root["mqtt_deadband_power"].as<float>();
+        config.Mqtt.Deadband.Voltage = root["mqtt_deadband_voltage"].as<float>();
+        config.Mqtt.Deadband.Current = root["mqtt_deadband_current"].as<float>();
+        config.Mqtt.Deadband.Frequency = root["mqtt_deadband_frequency"].as<float>();
+        config.Mqtt.Deadband.Temperature = root["mqtt_deadband_temperature"].as<float>();
+        config.Mqtt.Deadband.PowerFactor = root["mqtt_deadband_power_factor"].as<float>();
+        config.Mqtt.Deadband.Percent = root["mqtt_deadband_percent"].as<float>();
         config.Mqtt.Hass.Enabled = root["mqtt_hass_enabled"].as<bool>();
         config.Mqtt.Hass.Expire = root["mqtt_hass_expire"].as<bool>();
         config.Mqtt.Hass.Retain = root["mqtt_hass_retain"].as<bool>();
@@ -313,13 +363,17 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
         // Check if base topic was changed
         if (strcmp(config.Mqtt.Topic, root["mqtt_topic"].as<String>().c_str())) {
             MqttHandleInverter.unsubscribeTopics();
+#ifndef OPENDTU_WITHOUT_HUAWEI
             MqttHandleHuawei.unsubscribeTopics();
+#endif
             MqttHandlePowerLimiter.unsubscribeTopics();
 
             strlcpy(config.Mqtt.Topic, root["mqtt_topic"].as<String>().c_str(), sizeof(config.Mqtt.Topic));
 
             MqttHandleInverter.subscribeTopics();
+#ifndef OPENDTU_WITHOUT_HUAWEI
             MqttHandleHuawei.subscribeTopics();
+#endif
             MqttHandlePowerLimiter.subscribeTopics();
         }
     }
@@ -330,11 +384,17 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
 
     MqttSettings.performReconnect();
 
+    MqttHassPublisher.invalidate();
     MqttHandleBatteryHass.forceUpdate();
     MqttHandleHass.forceUpdate();
     MqttHandlePowerLimiterHass.forceUpdate();
 
+    MqttHandleDtu.forceUpdate();
+#ifndef OPENDTU_WITHOUT_HUAWEI
     MqttHandleHuawei.forceUpdate();
+#endif
+    MqttHandleInverter.forceUpdate();
+    MqttHandleInverterTotal.forceUpdate();
     MqttHandlePowerLimiter.forceUpdate();
 
     SolarCharger.updateSettings();
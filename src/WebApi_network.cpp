@@ -3,15 +3,18 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_network.h"
+#include "JsonArena.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
 #include "NetworkSettings.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
+#include "defaults.h"
 #include "helper.h"
 #include <AsyncJson.h>
 
 WebApiNetworkClass::WebApiNetworkClass()
-    : _applyDataTask(500 * TASK_MILLISECOND, TASK_ONCE, std::bind(&WebApiNetworkClass::applyDataTaskCb, this))
+    : _applyDataTask(500 * TASK_MILLISECOND, TASK_ONCE, TaskMonitor.wrap("WebApiNetwork::applyDataTaskCb", std::bind(&WebApiNetworkClass::applyDataTaskCb, this)))
 {
 }
 
@@ -21,7 +24,7 @@ void WebApiNetworkClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     server.on("/api/network/status", HTTP_GET, std::bind(&WebApiNetworkClass::onNetworkStatus, this, _1));
     server.on("/api/network/config", HTTP_GET, std::bind(&WebApiNetworkClass::onNetworkAdminGet, this, _1));
-    server.on("/api/network/config", HTTP_POST, std::bind(&WebApiNetworkClass::onNetworkAdminPost, this, _1));
+    server.on("/api/network/config", HTTP_POST, std::bind(&WebApiNetworkClass::onNetworkAdminPost, this, _1), nullptr, WebApiClass::onRequestBody);
 
     scheduler.addTask(_applyDataTask);
 }
@@ -76,10 +79,24 @@ void WebApiNetworkClass::onNetworkAdminGet(AsyncWebServerRequest* request)
     root["ssid"] = config.WiFi.Ssid;
     root["password"] = config.WiFi.Password;
     root["aptimeout"] = config.WiFi.ApTimeout;
+    root["latency_mode"] = config.WiFi.LatencyMode;
     root["mdnsenabled"] = config.Mdns.Enabled;
     root["syslogenabled"] = config.Syslog.Enabled;
     root["sysloghostname"] = config.Syslog.Hostname;
     root["syslogport"] = config.Syslog.Port;
+    root["telemetryenabled"] = config.Telemetry.Enabled;
+    root["telemetryhostname"] = config.Telemetry.Hostname;
+    root["telemetryport"] = config.Telemetry.Port;
+    root["telemetryinterval"] = config.Telemetry.Interval;
+    auto metricsPush = root["metricspush"].to<JsonObject>();
+    metricsPush["enabled"] = config.MetricsPush.Enabled;
+    metricsPush["interval"] = config.MetricsPush.Interval;
+    metricsPush["push_interval"] = config.MetricsPush.PushInterval;
+    auto metricsPushHttp = metricsPush["http_request"].to<JsonObject>();
+    Configuration.serializeHttpRequestConfig(config.MetricsPush.HttpRequest, metricsPushHttp);
+    root["modbusenabled"] = config.Modbus.Enabled;
+    root["modbusport"] = config.Modbus.Port;
+    root["modbusallowwrite"] = config.Modbus.AllowWrite;
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -91,7 +108,8 @@ void WebApiNetworkClass::onNetworkAdminPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -190,6 +208,57 @@ void WebApiNetworkClass::onNetworkAdminPost(AsyncWebServerRequest* request)
         }
 
     }
+    if (root["telemetryenabled"].as<bool>()) {
+        if (root["telemetryhostname"].as<String>().length() == 0 || root["telemetryhostname"].as<String>().length() > TELEMETRY_MAX_HOSTNAME_STRLEN) {
+            retMsg["message"] = "Telemetry collector must between 1 and " STR(TELEMETRY_MAX_HOSTNAME_STRLEN) " characters long!";
+            retMsg["code"] = WebApiError::NetworkTelemetryHostnameLength;
+            retMsg["param"]["max"] = TELEMETRY_MAX_HOSTNAME_STRLEN;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        if (root["telemetryport"].as<uint>() == 0 || root["telemetryport"].as<uint>() > 65535) {
+            retMsg["message"] = "Port must be a number between 1 and 65535!";
+            retMsg["code"] = WebApiError::NetworkTelemetryPort;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        if (root["telemetryinterval"].as<uint>() < 100 || root["telemetryinterval"].as<uint>() > 3600000) {
+            retMsg["message"] = "Interval must be a number between 100 and 3600000!";
+            retMsg["code"] = WebApiError::NetworkTelemetryInterval;
+            retMsg["param"]["min"] = 100;
+            retMsg["param"]["max"] = 3600000;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+    }
+    if (root["modbusenabled"].as<bool>()) {
+        if (root["modbusport"].as<uint>() == 0 || root["modbusport"].as<uint>() > 65535) {
+            retMsg["message"] = "Port must be a number between 1 and 65535!";
+            retMsg["code"] = WebApiError::NetworkModbusPort;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+    }
+    JsonObject metricsPush = root["metricspush"];
+    if (metricsPush["enabled"].as<bool>()) {
+        String url = metricsPush["http_request"]["url"].as<String>();
+        if (!url.startsWith("http://") && !url.startsWith("https://")) {
+            retMsg["message"] = "URL must either start with http:// or https://!";
+            retMsg["code"] = WebApiError::NetworkMetricsPushUrl;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        if (metricsPush["interval"].as<uint>() < 1 || metricsPush["interval"].as<uint>() > 3600
+                || metricsPush["push_interval"].as<uint>() < 10 || metricsPush["push_interval"].as<uint>() > 3600) {
+            retMsg["message"] = "Intervals must be numbers between 1 (10 for pushing) and 3600!";
+            retMsg["code"] = WebApiError::NetworkMetricsPushInterval;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+    }
 
     {
         auto guard = Configuration.getWriteGuard();
@@ -224,11 +293,28 @@ void WebApiNetworkClass::onNetworkAdminPost(AsyncWebServerRequest* request)
             config.WiFi.Dhcp = false;
         }
         config.WiFi.ApTimeout = root["aptimeout"].as<uint>();
+        config.WiFi.LatencyMode = std::min<uint8_t>(root["latency_mode"] | WIFI_LATENCY_MODE, 2);
         config.Mdns.Enabled = root["mdnsenabled"].as<bool>();
 
         config.Syslog.Enabled = root["syslogenabled"].as<bool>();
         strlcpy(config.Syslog.Hostname, root["sysloghostname"].as<String>().c_str(), sizeof(config.Syslog.Hostname));
         config.Syslog.Port = root["syslogport"].as<uint>();
+
+        config.Telemetry.Enabled = root["telemetryenabled"].as<bool>();
+        strlcpy(config.Telemetry.Hostname, root["telemetryhostname"].as<String>().c_str(), sizeof(config.Telemetry.Hostname));
+        config.Telemetry.Port = root["telemetryport"] | TELEMETRY_PORT;
+        config.Telemetry.Interval = root["telemetryinterval"] | TELEMETRY_INTERVAL;
+
+        if (!metricsPush.isNull()) {
+            config.MetricsPush.Enabled = metricsPush["enabled"].as<bool>();
+            config.MetricsPush.Interval = metricsPush["interval"] | METRICS_PUSH_INTERVAL;
+            config.MetricsPush.PushInterval = metricsPush["push_interval"] | METRICS_PUSH_PUSH_INTERVAL;
+            Configuration.deserializeHttpRequestConfig(metricsPush["http_request"], config.MetricsPush.HttpRequest);
+        }
+
+        config.Modbus.Enabled = root["modbusenabled"].as<bool>();
+        config.Modbus.Port = root["modbusport"] | MODBUS_PORT;
+        config.Modbus.AllowWrite = root["modbusallowwrite"].as<bool>();
     }
 
     WebApi.writeConfig(retMsg);
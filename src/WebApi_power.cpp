@@ -3,6 +3,7 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_power.h"
+#include "JsonArena.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
 #include <AsyncJson.h>
@@ -13,7 +14,7 @@ void WebApiPowerClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_1;
 
     server.on("/api/power/status", HTTP_GET, std::bind(&WebApiPowerClass::onPowerStatus, this, _1));
-    server.on("/api/power/config", HTTP_POST, std::bind(&WebApiPowerClass::onPowerPost, this, _1));
+    server.on("/api/power/config", HTTP_POST, std::bind(&WebApiPowerClass::onPowerPost, this, _1), nullptr, WebApiClass::onRequestBody);
 }
 
 void WebApiPowerClass::onPowerStatus(AsyncWebServerRequest* request)
@@ -23,8 +24,13 @@ void WebApiPowerClass::onPowerStatus(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
+    generateStatus(response->getRoot().to<JsonObject>());
 
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiPowerClass::generateStatus(JsonObject root)
+{
     for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
         auto inv = Hoymiles.getInverterByPos(i);
 
@@ -39,8 +45,6 @@ void WebApiPowerClass::onPowerStatus(AsyncWebServerRequest* request)
         }
         root[inv->serialString()]["power_set_status"] = limitStatus;
     }
-
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
 void WebApiPowerClass::onPowerPost(AsyncWebServerRequest* request)
@@ -50,7 +54,8 @@ void WebApiPowerClass::onPowerPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -84,15 +89,21 @@ void WebApiPowerClass::onPowerPost(AsyncWebServerRequest* request)
         return;
     }
 
+    bool sent = false;
     if (root["power"].is<bool>()) {
         bool power = root["power"].as<bool>();
-        inv->sendPowerControlRequest(power);
+        sent = inv->sendPowerControlRequest(power);
     } else {
         if (root["restart"].as<bool>()) {
-            inv->sendRestartControlRequest();
+            sent = inv->sendRestartControlRequest();
         }
     }
 
+    // completion is announced with this id via MQTT and the live websocket
+    if (sent) {
+        retMsg["command_id"] = inv->getLastControlCommandId();
+    }
+
     retMsg["type"] = "success";
     retMsg["message"] = "Settings saved!";
     retMsg["code"] = WebApiError::GenericSuccess;
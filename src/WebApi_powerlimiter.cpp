@@ -3,11 +3,15 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_powerlimiter.h"
+#include "JsonArena.h"
 #include "ArduinoJson.h"
 #include "AsyncJson.h"
 #include "Configuration.h"
+#include "MessageOutput.h"
 #include "MqttHandlePowerLimiterHass.h"
 #include "PowerLimiter.h"
+#include "PowerLimiterLatency.h"
+#include "PowerLimiterTrace.h"
 #include "WebApi.h"
 #include "helper.h"
 #include "WebApi_errors.h"
@@ -21,8 +25,10 @@ void WebApiPowerLimiterClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     _server->on("/api/powerlimiter/status", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onStatus, this, _1));
     _server->on("/api/powerlimiter/config", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onAdminGet, this, _1));
-    _server->on("/api/powerlimiter/config", HTTP_POST, std::bind(&WebApiPowerLimiterClass::onAdminPost, this, _1));
+    _server->on("/api/powerlimiter/config", HTTP_POST, std::bind(&WebApiPowerLimiterClass::onAdminPost, this, _1), nullptr, WebApiClass::onRequestBody);
     _server->on("/api/powerlimiter/metadata", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onMetaData, this, _1));
+    _server->on("/api/powerlimiter/latency", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onLatency, this, _1));
+    _server->on("/api/powerlimiter/trace", HTTP_GET, std::bind(&WebApiPowerLimiterClass::onTrace, this, _1));
 }
 
 void WebApiPowerLimiterClass::onStatus(AsyncWebServerRequest* request)
@@ -38,41 +44,138 @@ void WebApiPowerLimiterClass::onStatus(AsyncWebServerRequest* request)
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
+void WebApiPowerLimiterClass::onLatency(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto root = response->getRoot().as<JsonObject>();
+    PowerLimiterLatency.serialize(root);
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+// the binary format is described in PowerLimiterTrace.h
+void WebApiPowerLimiterClass::onTrace(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    try {
+        WebApi.sendBuffer(request, "application/octet-stream", PowerLimiterTrace.serialize(), false);
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/powerlimiter/trace has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+
+        WebApi.sendTooManyRequests(request);
+    }
+}
+
 void WebApiPowerLimiterClass::onMetaData(AsyncWebServerRequest* request)
 {
     if (!WebApi.checkCredentials(request)) { return; }
 
+    try {
+        auto spGenerator = std::make_shared<Generator>();
+
+        auto response = WebApi.beginChunkedResponse(request, "application/json",
+            [spGenerator](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                return fillChunk(*spGenerator, buffer, maxLen);
+            });
+
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
+
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/powerlimiter/metadata has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+
+        WebApi.sendTooManyRequests(request);
+    }
+}
+
+size_t WebApiPowerLimiterClass::fillChunk(Generator& gen, uint8_t* buffer, size_t maxLen)
+{
+    try {
+        while (gen.Offset >= gen.Pending.length()) {
+            gen.Pending = ""; // keeps the allocated buffer
+            gen.Offset = 0;
+            if (!generateNext(gen)) { return 0; }
+        }
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/powerlimiter/metadata has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+        return 0;
+    }
+
+    size_t len = std::min(maxLen, gen.Pending.length() - gen.Offset);
+    memcpy(buffer, gen.Pending.c_str() + gen.Offset, len);
+    gen.Offset += len;
+    return len;
+}
+
+// generates the next part of the metadata into gen.Pending. returns false
+// once the response is complete.
+bool WebApiPowerLimiterClass::generateNext(Generator& gen)
+{
+    if (gen.Done) { return false; }
+
     auto const& config = Configuration.get();
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
-
-    root["power_meter_enabled"] = config.PowerMeter.Enabled;
-    root["battery_enabled"] = config.Battery.Enabled;
-    root["charge_controller_enabled"] = config.SolarCharger.Enabled;
-
-    JsonArray inverters = root["inverters"].to<JsonArray>();
-    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        auto inv = Hoymiles.getInverterBySerial(config.Inverter[i].Serial);
-        if (!inv) { continue; }
-
-        JsonObject obj = inverters.add<JsonObject>();
-        obj["serial"] = inv->serialString();
-        obj["pos"] = i;
-        obj["order"] = config.Inverter[i].Order;
-        obj["name"] = String(config.Inverter[i].Name);
-        obj["poll_enable"] = config.Inverter[i].Poll_Enable;
-        obj["poll_enable_night"] = config.Inverter[i].Poll_Enable_Night;
-        obj["command_enable"] = config.Inverter[i].Command_Enable;
-        obj["command_enable_night"] = config.Inverter[i].Command_Enable_Night;
-        obj["max_power"] = inv->DevInfo()->getMaxPower(); // okay if zero/unknown
-        obj["type"] = inv->typeName();
-        auto channels = inv->Statistics()->getChannelsByType(TYPE_DC);
-        obj["channels"] = channels.size();
-        obj["pdl_supported"] = inv->supportsPowerDistributionLogic();
+    if (!gen.HeaderDone) {
+        gen.HeaderDone = true;
+
+        JsonDocument doc;
+        doc["power_meter_enabled"] = config.PowerMeter.Enabled;
+        doc["battery_enabled"] = config.Battery.Enabled;
+        doc["charge_controller_enabled"] = config.SolarCharger.Enabled;
+
+        // the inverters array is appended to the object, i.e., the closing
+        // brace of the serialized object is replaced
+        String serialized;
+        serializeJson(doc, serialized);
+        serialized.remove(serialized.length() - 1);
+        gen.Pending += serialized;
+        gen.Pending += ",\"inverters\":[";
+        return true;
     }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+    std::shared_ptr<InverterAbstract> inv = nullptr;
+    while (gen.NextInverter < INV_MAX_COUNT && !inv) {
+        inv = Hoymiles.getInverterBySerial(config.Inverter[gen.NextInverter++].Serial);
+    }
+
+    if (!inv) {
+        gen.Done = true;
+        gen.Pending += "]}";
+        return true;
+    }
+
+    const uint8_t i = gen.NextInverter - 1;
+
+    JsonDocument doc;
+    JsonObject obj = doc.to<JsonObject>();
+    obj["serial"] = inv->serialString();
+    obj["pos"] = i;
+    obj["order"] = config.Inverter[i].Order;
+    obj["name"] = String(config.Inverter[i].Name);
+    obj["poll_enable"] = config.Inverter[i].Poll_Enable;
+    obj["poll_enable_night"] = config.Inverter[i].Poll_Enable_Night;
+    obj["command_enable"] = config.Inverter[i].Command_Enable;
+    obj["command_enable_night"] = config.Inverter[i].Command_Enable_Night;
+    obj["max_power"] = inv->DevInfo()->getMaxPower(); // okay if zero/unknown
+    obj["type"] = inv->typeName();
+    auto channels = inv->Statistics()->getChannelsByType(TYPE_DC);
+    obj["channels"] = channels.size();
+    obj["pdl_supported"] = inv->supportsPowerDistributionLogic();
+
+    String serialized;
+    serializeJson(doc, serialized);
+
+    if (gen.Count++ > 0) {
+        gen.Pending += ",";
+    }
+    gen.Pending += serialized;
+    return true;
 }
 
 void WebApiPowerLimiterClass::onAdminGet(AsyncWebServerRequest* request)
@@ -91,7 +194,8 @@ void WebApiPowerLimiterClass::onAdminPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -3,6 +3,7 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_powermeter.h"
+#include "JsonArena.h"
 #include "ArduinoJson.h"
 #include "AsyncJson.h"
 #include "Configuration.h"
@@ -14,6 +15,8 @@
 #include "PowerMeterHttpSml.h"
 #include "WebApi.h"
 #include "helper.h"
+#include <algorithm>
+#include <vector>
 
 void WebApiPowerMeterClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
@@ -23,9 +26,9 @@ void WebApiPowerMeterClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     _server->on("/api/powermeter/status", HTTP_GET, std::bind(&WebApiPowerMeterClass::onStatus, this, _1));
     _server->on("/api/powermeter/config", HTTP_GET, std::bind(&WebApiPowerMeterClass::onAdminGet, this, _1));
-    _server->on("/api/powermeter/config", HTTP_POST, std::bind(&WebApiPowerMeterClass::onAdminPost, this, _1));
-    _server->on("/api/powermeter/testhttpjsonrequest", HTTP_POST, std::bind(&WebApiPowerMeterClass::onTestHttpJsonRequest, this, _1));
-    _server->on("/api/powermeter/testhttpsmlrequest", HTTP_POST, std::bind(&WebApiPowerMeterClass::onTestHttpSmlRequest, this, _1));
+    _server->on("/api/powermeter/config", HTTP_POST, std::bind(&WebApiPowerMeterClass::onAdminPost, this, _1), nullptr, WebApiClass::onRequestBody);
+    _server->on("/api/powermeter/testhttpjsonrequest", HTTP_POST, std::bind(&WebApiPowerMeterClass::onTestHttpJsonRequest, this, _1), nullptr, WebApiClass::onRequestBody);
+    _server->on("/api/powermeter/testhttpsmlrequest", HTTP_POST, std::bind(&WebApiPowerMeterClass::onTestHttpSmlRequest, this, _1), nullptr, WebApiClass::onRequestBody);
 }
 
 void WebApiPowerMeterClass::onStatus(AsyncWebServerRequest* request)
@@ -54,6 +57,15 @@ void WebApiPowerMeterClass::onStatus(AsyncWebServerRequest* request)
     auto httpSml = root["http_sml"].to<JsonObject>();
     Configuration.serializePowerMeterHttpSmlConfig(config.PowerMeter.HttpSml, httpSml);
 
+    auto udp = root["udp"].to<JsonObject>();
+    Configuration.serializePowerMeterUdpConfig(config.PowerMeter.Udp, udp);
+
+    auto filter = root["filter"].to<JsonObject>();
+    Configuration.serializePowerMeterFilterConfig(config.PowerMeter.Filter, filter);
+
+    auto additional = root["additional"].to<JsonArray>();
+    Configuration.serializePowerMeterAdditionalConfig(config.PowerMeter.Additional, additional);
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
@@ -73,7 +85,8 @@ void WebApiPowerMeterClass::onAdminPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -116,7 +129,52 @@ void WebApiPowerMeterClass::onAdminPost(AsyncWebServerRequest* request)
         return true;
     };
 
-    if (static_cast<PowerMeterProvider::Type>(root["source"].as<uint8_t>()) == PowerMeterProvider::Type::HTTP_JSON) {
+    using Type = PowerMeterProvider::Type;
+    std::vector<Type> sources = { static_cast<Type>(root["source"].as<uint8_t>()) };
+
+    // every provider type has a single configuration, and the serial
+    // power meters share the same pins.
+    auto isSerial = [](Type t) {
+        return t == Type::SDM1PH || t == Type::SDM3PH || t == Type::SERIAL_SML;
+    };
+
+    for (JsonObject additional : root["additional"].as<JsonArray>()) {
+        if (additional["operation"].as<uint8_t>() == PowerMeterAdditionalConfig::Operation::Disabled) {
+            continue;
+        }
+
+        if (additional["operation"].as<uint8_t>() > PowerMeterAdditionalConfig::Operation::Standby) {
+            retMsg["message"] = "Invalid additional power meter operation!";
+            response->setLength();
+            request->send(response);
+            return;
+        }
+
+        auto source = static_cast<Type>(additional["source"].as<uint8_t>());
+        if (additional["source"].as<uint8_t>() > static_cast<uint8_t>(Type::UDP)) {
+            retMsg["message"] = "Invalid additional power meter type!";
+            response->setLength();
+            request->send(response);
+            return;
+        }
+
+        for (auto other : sources) {
+            if (other == source || (isSerial(other) && isSerial(source))) {
+                retMsg["message"] = "Each power meter type can only be used once, and only one serial power meter can be used!";
+                response->setLength();
+                request->send(response);
+                return;
+            }
+        }
+
+        sources.push_back(source);
+    }
+
+    auto isUsed = [&sources](Type t) {
+        return std::find(sources.begin(), sources.end(), t) != sources.end();
+    };
+
+    if (isUsed(Type::HTTP_JSON)) {
         JsonObject httpJson = root["http_json"];
         JsonArray valueConfigs = httpJson["values"];
         for (uint8_t i = 0; i < valueConfigs.size(); i++) {
@@ -142,13 +200,42 @@ void WebApiPowerMeterClass::onAdminPost(AsyncWebServerRequest* request)
         }
     }
 
-    if (static_cast<PowerMeterProvider::Type>(root["source"].as<uint8_t>()) == PowerMeterProvider::Type::HTTP_SML) {
+    if (isUsed(Type::HTTP_SML)) {
         JsonObject httpSml = root["http_sml"];
         if (!checkHttpConfig(httpSml["http_request"].as<JsonObject>())) {
             return;
         }
     }
 
+    if (isUsed(Type::SDM1PH) || isUsed(Type::SDM3PH)) {
+        JsonObject serialSdm = root["serial_sdm"];
+        std::vector<uint8_t> addresses = { serialSdm["address"].as<uint8_t>() };
+        for (JsonObject subMeter : serialSdm["sub_meters"].as<JsonArray>()) {
+            auto address = subMeter["address"].as<uint8_t>();
+            if (address == 0) { continue; }
+
+            if (address > 247 || std::find(addresses.begin(), addresses.end(), address) != addresses.end()) {
+                retMsg["message"] = "Each SDM sub-meter needs a unique Modbus address (1 to 247)!";
+                response->setLength();
+                request->send(response);
+                return;
+            }
+
+            addresses.push_back(address);
+        }
+    }
+
+    if (isUsed(Type::UDP)) {
+        JsonObject udp = root["udp"];
+        if (udp["port"].as<uint16_t>() == 0
+                || udp["format"].as<uint8_t>() > PowerMeterUdpConfig::Format::Float32) {
+            retMsg["message"] = "Invalid UDP port or payload format!";
+            response->setLength();
+            request->send(response);
+            return;
+        }
+    }
+
     {
         auto guard = Configuration.getWriteGuard();
         auto& config = guard.getConfig();
@@ -167,6 +254,15 @@ void WebApiPowerMeterClass::onAdminPost(AsyncWebServerRequest* request)
 
         Configuration.deserializePowerMeterHttpSmlConfig(root["http_sml"].as<JsonObject>(),
                 config.PowerMeter.HttpSml);
+
+        Configuration.deserializePowerMeterUdpConfig(root["udp"].as<JsonObject>(),
+                config.PowerMeter.Udp);
+
+        Configuration.deserializePowerMeterFilterConfig(root["filter"].as<JsonObject>(),
+                config.PowerMeter.Filter);
+
+        Configuration.deserializePowerMeterAdditionalConfig(root["additional"].as<JsonArray>(),
+                config.PowerMeter.Additional);
     }
 
     WebApi.writeConfig(retMsg);
@@ -183,7 +279,8 @@ void WebApiPowerMeterClass::onTestHttpJsonRequest(AsyncWebServerRequest* request
     }
 
     AsyncJsonResponse* asyncJsonResponse = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, asyncJsonResponse, root)) {
         return;
     }
@@ -224,7 +321,8 @@ void WebApiPowerMeterClass::onTestHttpSmlRequest(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* asyncJsonResponse = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, asyncJsonResponse, root)) {
         return;
     }
@@ -1,14 +1,23 @@
-
 // SPDX-License-Identifier: GPL-2.0-or-later
 /*
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_prometheus.h"
+#include "Battery.h"
 #include "Configuration.h"
+#include "HeapMonitor.h"
 #include "MessageOutput.h"
+#include "MetricsRegistry.h"
 #include "NetworkSettings.h"
+#include "PowerLimiterLatency.h"
+#include "PowerMeter.h"
+#include "RtosTaskProfiler.h"
+#include "TaskMonitor.h"
 #include "WebApi.h"
 #include <Hoymiles.h>
+#include <SpiManager.h>
+#include <algorithm>
+#include <cstdarg>
 #include "__compiled_constants.h"
 
 void WebApiPrometheusClass::init(AsyncWebServer& server, Scheduler& scheduler)
@@ -25,157 +34,478 @@ void WebApiPrometheusClass::onPrometheusMetricsGet(AsyncWebServerRequest* reques
     }
 
     try {
-        auto stream = request->beginResponseStream("text/plain; charset=utf-8", 4096 * INV_MAX_COUNT); // TODO(helge) check if this calculation is correct
+        auto spGenerator = std::make_shared<Generator>();
+        spGenerator->Pending.reserve(1024);
 
-        stream->print("# HELP opendtu_build Build info\n");
-        stream->print("# TYPE opendtu_build gauge\n");
-        stream->printf("opendtu_build{name=\"%s\",id=\"%s\",version=\"%d.%d.%d\"} 1\n",
-            NetworkSettings.getHostname().c_str(), __COMPILED_GIT_HASH__, CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
+        auto response = WebApi.beginChunkedResponse(request, "text/plain; charset=utf-8",
+            [this, spGenerator](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                return fillChunk(*spGenerator, buffer, maxLen);
+            });
 
-        stream->print("# HELP opendtu_platform Platform info\n");
-        stream->print("# TYPE opendtu_platform gauge\n");
-        stream->printf("opendtu_platform{arch=\"%s\",mac=\"%s\"} 1\n", ESP.getChipModel(), NetworkSettings.macAddress().c_str());
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
 
-        stream->print("# HELP opendtu_uptime Uptime in seconds\n");
-        stream->print("# TYPE opendtu_uptime counter\n");
-        stream->printf("opendtu_uptime %lld\n", esp_timer_get_time() / 1000000);
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/prometheus/metrics has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
 
-        stream->print("# HELP opendtu_heap_size System memory size\n");
-        stream->print("# TYPE opendtu_heap_size gauge\n");
-        stream->printf("opendtu_heap_size %" PRId32 "\n", ESP.getHeapSize());
+        WebApi.sendTooManyRequests(request);
+    }
+}
 
-        stream->print("# HELP opendtu_free_heap_size System free memory\n");
-        stream->print("# TYPE opendtu_free_heap_size gauge\n");
-        stream->printf("opendtu_free_heap_size %" PRId32 "\n", ESP.getFreeHeap());
+size_t WebApiPrometheusClass::fillChunk(Generator& gen, uint8_t* buffer, size_t maxLen)
+{
+    try {
+        while (gen.Offset >= gen.Pending.length()) {
+            gen.Pending = ""; // keeps the allocated buffer
+            gen.Offset = 0;
+            if (!generateNext(gen)) { return 0; }
+        }
+    } catch (std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/prometheus/metrics has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+        return 0;
+    }
 
-        stream->print("# HELP opendtu_biggest_heap_block Biggest free heap block\n");
-        stream->print("# TYPE opendtu_biggest_heap_block gauge\n");
-        stream->printf("opendtu_biggest_heap_block %" PRId32 "\n", ESP.getMaxAllocHeap());
+    size_t len = std::min(maxLen, gen.Pending.length() - gen.Offset);
+    memcpy(buffer, gen.Pending.c_str() + gen.Offset, len);
+    gen.Offset += len;
+    return len;
+}
 
-        stream->print("# HELP opendtu_heap_min_free Minimum free memory since boot\n");
-        stream->print("# TYPE opendtu_heap_min_free gauge\n");
-        stream->printf("opendtu_heap_min_free %" PRId32 "\n", ESP.getMinFreeHeap());
+// generates the metrics of the next section into gen.Pending. returns false
+// once all metrics were generated.
+bool WebApiPrometheusClass::generateNext(Generator& gen)
+{
+    switch (gen.NextStep) {
+        case Step::System:
+            addSystemMetrics(gen);
+            gen.NextStep = Step::Latency;
+            return true;
+        case Step::Latency:
+            addLatencyMetrics(gen);
+            gen.NextStep = Step::Tasks;
+            return true;
+        case Step::Tasks:
+            addTaskMetrics(gen);
+            gen.NextStep = Step::RtosTasks;
+            return true;
+        case Step::RtosTasks:
+            addRtosTaskMetrics(gen);
+            gen.NextStep = Step::Registry;
+            return true;
+        case Step::Registry:
+            if (!addRegistryMetrics(gen)) { gen.NextStep = Step::Battery; }
+            return true;
+        case Step::Battery:
+            addBatteryMetrics(gen);
+            gen.NextStep = Step::PowerMeter;
+            return true;
+        case Step::PowerMeter:
+            addPowerMeterMetrics(gen);
+            gen.NextStep = Step::Inverters;
+            return true;
+        case Step::Inverters:
+            if (gen.NextInverter >= Hoymiles.getNumInverters()) {
+                gen.NextStep = Step::Done;
+                return false;
+            }
+            addInverterMetrics(gen, gen.NextInverter++);
+            return true;
+        case Step::Done:
+            break;
+    }
 
-        stream->print("# HELP wifi_rssi WiFi RSSI\n");
-        stream->print("# TYPE wifi_rssi gauge\n");
-        stream->printf("wifi_rssi %" PRId8 "\n", WiFi.RSSI());
+    return false;
+}
 
-        stream->print("# HELP wifi_station WiFi Station info\n");
-        stream->print("# TYPE wifi_station gauge\n");
-        stream->printf("wifi_station{bssid=\"%s\"} 1\n", WiFi.BSSIDstr().c_str());
+void WebApiPrometheusClass::appendf(String& out, const char* format, ...)
+{
+    char buffer[256];
 
-        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-            auto inv = Hoymiles.getInverterByPos(i);
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
 
-            String serial = inv->serialString();
-            const char* name = inv->name();
-            if (i == 0) {
-                stream->print("# HELP opendtu_last_update last update from inverter in s\n");
-                stream->print("# TYPE opendtu_last_update gauge\n");
-            }
-            stream->printf("opendtu_last_update{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"} %" PRId32 "\n",
-                serial.c_str(), i, name, inv->Statistics()->getLastUpdate() / 1000);
+    if (len < 0) { return; }
 
-            if (i == 0) {
-                stream->print("# HELP opendtu_inverter_limit_relative current relative limit of the inverter\n");
-                stream->print("# TYPE opendtu_inverter_limit_relative gauge\n");
-            }
-            stream->printf("opendtu_inverter_limit_relative{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"} %f\n",
-                serial.c_str(), i, name, inv->SystemConfigPara()->getLimitPercent() / 100.0);
+    if (static_cast<size_t>(len) < sizeof(buffer)) {
+        out.concat(buffer, len);
+        return;
+    }
 
-            if (inv->DevInfo()->getMaxPower() > 0) {
-                if (i == 0) {
-                    stream->print("# HELP opendtu_inverter_limit_absolute current relative limit of the inverter\n");
-                    stream->print("# TYPE opendtu_inverter_limit_absolute gauge\n");
-                }
-                stream->printf("opendtu_inverter_limit_absolute{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"} %f\n",
-                    serial.c_str(), i, name, inv->SystemConfigPara()->getLimitPercent() * inv->DevInfo()->getMaxPower() / 100.0);
-            }
+    // rare case: line does not fit into the stack buffer
+    std::unique_ptr<char[]> upBuffer(new char[len + 1]);
+    va_start(args, format);
+    vsnprintf(upBuffer.get(), len + 1, format, args);
+    va_end(args);
+    out.concat(upBuffer.get(), len);
+}
+
+// adds the HELP and TYPE lines of a metric family, once per response
+void WebApiPrometheusClass::addHeader(Generator& gen, const char* name, const char* help, const char* type)
+{
+    if (!gen.Families.insert(name).second) { return; }
+
+    appendf(gen.Pending, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void WebApiPrometheusClass::addSystemMetrics(Generator& gen)
+{
+    auto& out = gen.Pending;
+
+    addHeader(gen, "opendtu_build", "Build info", "gauge");
+    appendf(out, "opendtu_build{name=\"%s\",id=\"%s\",version=\"%d.%d.%d\"} 1\n",
+        NetworkSettings.getHostname().c_str(), __COMPILED_GIT_HASH__, CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
+
+    addHeader(gen, "opendtu_platform", "Platform info", "gauge");
+    appendf(out, "opendtu_platform{arch=\"%s\",mac=\"%s\"} 1\n", ESP.getChipModel(), NetworkSettings.macAddress().c_str());
+
+    addHeader(gen, "opendtu_uptime", "Uptime in seconds", "counter");
+    appendf(out, "opendtu_uptime %lld\n", esp_timer_get_time() / 1000000);
+
+    addHeader(gen, "opendtu_heap_size", "System memory size", "gauge");
+    appendf(out, "opendtu_heap_size %" PRId32 "\n", ESP.getHeapSize());
+
+    addHeader(gen, "opendtu_free_heap_size", "System free memory", "gauge");
+    appendf(out, "opendtu_free_heap_size %" PRId32 "\n", ESP.getFreeHeap());
+
+    addHeader(gen, "opendtu_biggest_heap_block", "Biggest free heap block", "gauge");
+    appendf(out, "opendtu_biggest_heap_block %" PRId32 "\n", ESP.getMaxAllocHeap());
+
+    addHeader(gen, "opendtu_heap_min_free", "Minimum free memory since boot", "gauge");
+    appendf(out, "opendtu_heap_min_free %" PRId32 "\n", ESP.getMinFreeHeap());
+
+    addHeader(gen, "opendtu_heap_fragmentation", "Share of free memory not part of the biggest free heap block in %", "gauge");
+    appendf(out, "opendtu_heap_fragmentation %" PRIu8 "\n", HeapMonitorClass::getFragmentation());
+
+    addHeader(gen, "wifi_rssi", "WiFi RSSI", "gauge");
+    appendf(out, "wifi_rssi %" PRId8 "\n", WiFi.RSSI());
+
+    addHeader(gen, "wifi_station", "WiFi Station info", "gauge");
+    appendf(out, "wifi_station{bssid=\"%s\"} 1\n", WiFi.BSSIDstr().c_str());
+
+    // samples of a metric family must not be interleaved with other families
+    auto spiStats = SpiManagerInst.get_device_stats();
+    if (spiStats.empty()) { return; }
+
+    addHeader(gen, "opendtu_spi_transactions", "Number of SPI transactions of a device on a shared bus", "counter");
+    for (auto const& dev : spiStats) {
+        appendf(out, "opendtu_spi_transactions{device=\"%s\",host=\"%d\"} %" PRIu32 "\n",
+            dev.name.c_str(), static_cast<int>(dev.host_device), dev.transactions);
+    }
+
+    addHeader(gen, "opendtu_spi_busy_seconds", "Time the shared SPI bus was busy with transactions of a device", "counter");
+    for (auto const& dev : spiStats) {
+        appendf(out, "opendtu_spi_busy_seconds{device=\"%s\",host=\"%d\"} %.6f\n",
+            dev.name.c_str(), static_cast<int>(dev.host_device), dev.busy_us / 1000000.0);
+    }
+
+    addHeader(gen, "opendtu_spi_max_transaction_us", "Longest SPI transaction of a device in microseconds", "gauge");
+    for (auto const& dev : spiStats) {
+        appendf(out, "opendtu_spi_max_transaction_us{device=\"%s\",host=\"%d\"} %" PRIu32 "\n",
+            dev.name.c_str(), static_cast<int>(dev.host_device), dev.max_us);
+    }
+}
+
+void WebApiPrometheusClass::addLatencyMetrics(Generator& gen)
+{
+    using Stage = PowerLimiterLatencyClass::Stage;
+    auto& out = gen.Pending;
+
+    addHeader(gen, "opendtu_dpl_latency_ms", "Duration of control loop stages in ms (rolling window)", "summary");
+
+    for (size_t i = 0; i < static_cast<size_t>(Stage::Count); ++i) {
+        auto stage = static_cast<Stage>(i);
+        auto name = PowerLimiterLatencyClass::getStageName(stage);
+        auto summary = PowerLimiterLatency.getSummary(stage);
+
+        appendf(out, "opendtu_dpl_latency_ms{stage=\"%s\",quantile=\"0.5\"} %" PRIu32 "\n", name, summary.P50);
+        appendf(out, "opendtu_dpl_latency_ms{stage=\"%s\",quantile=\"0.95\"} %" PRIu32 "\n", name, summary.P95);
+        appendf(out, "opendtu_dpl_latency_ms{stage=\"%s\",quantile=\"0.99\"} %" PRIu32 "\n", name, summary.P99);
+        appendf(out, "opendtu_dpl_latency_ms_count{stage=\"%s\"} %" PRIu32 "\n", name, summary.Count);
+    }
+}
+
+void WebApiPrometheusClass::addTaskMetrics(Generator& gen)
+{
+    auto& out = gen.Pending;
+    auto stats = TaskMonitor.getStats();
+
+    addHeader(gen, "opendtu_task_invocations", "Number of invocations of the scheduler task", "counter");
+    for (auto const& task : stats) {
+        appendf(out, "opendtu_task_invocations{task=\"%s\"} %" PRIu32 "\n", task.Name, task.Invocations);
+    }
+
+    addHeader(gen, "opendtu_task_runtime_us", "Cumulative runtime of the scheduler task in us", "counter");
+    for (auto const& task : stats) {
+        appendf(out, "opendtu_task_runtime_us{task=\"%s\"} %" PRIu64 "\n", task.Name, task.TotalMicros);
+    }
+
+    addHeader(gen, "opendtu_task_runtime_max_us", "Maximum runtime of a single invocation of the scheduler task in us", "gauge");
+    for (auto const& task : stats) {
+        appendf(out, "opendtu_task_runtime_max_us{task=\"%s\"} %" PRIu32 "\n", task.Name, task.MaxMicros);
+    }
+
+    addHeader(gen, "opendtu_task_lateness_max_ms", "Maximum delay of an invocation of the scheduler task versus its schedule in ms", "gauge");
+    for (auto const& task : stats) {
+        appendf(out, "opendtu_task_lateness_max_ms{task=\"%s\"} %" PRIu32 "\n", task.Name, task.MaxLatenessMillis);
+    }
+
+    addHeader(gen, "opendtu_task_overruns", "Number of invocations of the scheduler task which overran", "counter");
+    for (auto const& task : stats) {
+        appendf(out, "opendtu_task_overruns{task=\"%s\"} %" PRIu32 "\n", task.Name, task.Overruns);
+    }
+}
+
+void WebApiPrometheusClass::addRtosTaskMetrics(Generator& gen)
+{
+    auto& out = gen.Pending;
+    auto tasks = RtosTaskProfiler.getTasks();
+
+    addHeader(gen, "opendtu_rtos_task_stack_watermark", "Minimum amount of free stack of the FreeRTOS task in bytes", "gauge");
+    for (auto const& task : tasks) {
+        appendf(out, "opendtu_rtos_task_stack_watermark{task=\"%s\",core=\"%d\"} %" PRIu32 "\n",
+                task.Name.data(), task.Core, task.StackWatermark);
+    }
+
+    addHeader(gen, "opendtu_rtos_task_priority", "Priority of the FreeRTOS task", "gauge");
+    for (auto const& task : tasks) {
+        appendf(out, "opendtu_rtos_task_priority{task=\"%s\",core=\"%d\"} %u\n",
+                task.Name.data(), task.Core, static_cast<unsigned>(task.Priority));
+    }
+
+    bool cpuShareAvailable = std::any_of(tasks.begin(), tasks.end(),
+            [](auto const& task) { return task.CpuShare.has_value(); });
+    if (!cpuShareAvailable) { return; }
 
-            // Loop all channels if Statistics have been updated at least once since DTU boot
-            if (inv->Statistics()->getLastUpdate() > 0) {
-                for (auto& t : inv->Statistics()->getChannelTypes()) {
-                    for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                        addPanelInfo(stream, serial, i, inv, t, c);
-                        for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(_publishFields[0]); f++) {
-                            if (t == TYPE_INV && _publishFields[f].field == FLD_PDC) {
-                                addField(stream, serial, i, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type], "PowerDC");
-                            } else {
-                                addField(stream, serial, i, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type]);
-                            }
-                        }
-                    }
+    addHeader(gen, "opendtu_rtos_task_cpu_share", "Share of CPU time of one core used by the FreeRTOS task in % (sampling window)", "gauge");
+    for (auto const& task : tasks) {
+        if (!task.CpuShare) { continue; }
+        appendf(out, "opendtu_rtos_task_cpu_share{task=\"%s\",core=\"%d\"} %.2f\n",
+                task.Name.data(), task.Core, *task.CpuShare);
+    }
+}
+
+// the metrics of the registry, a limited number of them per chunk. returns
+// false once all of them were added.
+bool WebApiPrometheusClass::addRegistryMetrics(Generator& gen)
+{
+    static constexpr size_t metricsPerChunk = 16;
+
+    if (gen.NextMetric == 0) { MetricsRegistry.collect(); }
+
+    size_t count = MetricsRegistry.size();
+    size_t last = std::min(gen.NextMetric + metricsPerChunk, count);
+
+    MetricsRegistryClass::Sample sample;
+    for (; gen.NextMetric < last; ++gen.NextMetric) {
+        if (!MetricsRegistry.getSample(gen.NextMetric, sample)) { continue; }
+
+        addHeader(gen, sample.Name, sample.Help, MetricsRegistryClass::getTypeName(sample.MetricType));
+
+        if (sample.Labels != nullptr) {
+            appendf(gen.Pending, "%s{%s} %.7g\n", sample.Name, sample.Labels, sample.Value);
+        } else {
+            appendf(gen.Pending, "%s %.7g\n", sample.Name, sample.Value);
+        }
+    }
+
+    return gen.NextMetric < count;
+}
+
+void WebApiPrometheusClass::addBatteryMetrics(Generator& gen)
+{
+    if (!Configuration.get().Battery.Enabled) { return; }
+
+    auto& out = gen.Pending;
+
+    auto canStats = Battery.getCanMessageStats();
+    if (canStats.empty()) { return; }
+
+    addHeader(gen, "opendtu_battery_can_frames", "Number of CAN frames received from the battery", "counter");
+    for (auto const& stats : canStats) {
+        appendf(out, "opendtu_battery_can_frames{id=\"0x%03" PRIX32 "\"} %" PRIu32 "\n", stats.Id, stats.Frames);
+    }
+
+    addHeader(gen, "opendtu_battery_can_frames_dropped", "Number of CAN frames dropped as the receive queue was full", "counter");
+    for (auto const& stats : canStats) {
+        appendf(out, "opendtu_battery_can_frames_dropped{id=\"0x%03" PRIX32 "\"} %" PRIu32 "\n", stats.Id, stats.Dropped);
+    }
+
+    addHeader(gen, "opendtu_battery_can_frame_rate", "Rate of CAN frames received from the battery in 1/s", "gauge");
+    for (auto const& stats : canStats) {
+        appendf(out, "opendtu_battery_can_frame_rate{id=\"0x%03" PRIX32 "\"} %f\n", stats.Id, stats.Rate);
+    }
+}
+
+void WebApiPrometheusClass::addPowerMeterMetrics(Generator& gen)
+{
+    if (!Configuration.get().PowerMeter.Enabled) { return; }
+
+    auto& out = gen.Pending;
+
+    auto metrics = PowerMeter.getMetrics();
+
+    addHeader(gen, "opendtu_power_meter_samples", "Number of readings received from the power meter", "counter");
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        appendf(out, "opendtu_power_meter_samples{meter=\"%u\"} %" PRIu32 "\n", static_cast<unsigned>(i), metrics[i].Samples);
+    }
+
+    addHeader(gen, "opendtu_power_meter_jitter_ms", "Mean deviation between consecutive power meter sample intervals in ms", "gauge");
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        appendf(out, "opendtu_power_meter_jitter_ms{meter=\"%u\"} %f\n", static_cast<unsigned>(i), metrics[i].JitterMs);
+    }
+
+    addHeader(gen, "opendtu_power_meter_decode_us", "Average time to decode a power meter reading in us", "gauge");
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        if (metrics[i].DecodeMicros == 0) { continue; }
+        appendf(out, "opendtu_power_meter_decode_us{meter=\"%u\"} %f\n", static_cast<unsigned>(i), metrics[i].DecodeMicros);
+    }
+
+    addHeader(gen, "opendtu_power_meter_decode_us_max", "Longest time to decode a power meter reading in us", "gauge");
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        if (metrics[i].DecodeMicros == 0) { continue; }
+        appendf(out, "opendtu_power_meter_decode_us_max{meter=\"%u\"} %" PRIu32 "\n", static_cast<unsigned>(i), metrics[i].DecodeMicrosMax);
+    }
+}
+
+void WebApiPrometheusClass::addInverterMetrics(Generator& gen, const uint8_t idx)
+{
+    auto inv = Hoymiles.getInverterByPos(idx);
+    if (inv == nullptr) { return; }
+
+    auto& out = gen.Pending;
+
+    auto const& labels = getInverterLabels(inv, idx);
+
+    addHeader(gen, "opendtu_last_update", "last update from inverter in s", "gauge");
+    appendf(out, "opendtu_last_update{%s} %" PRId32 "\n", labels.c_str(), inv->Statistics()->getLastUpdate() / 1000);
+
+    addHeader(gen, "opendtu_inverter_limit_relative", "current relative limit of the inverter", "gauge");
+    appendf(out, "opendtu_inverter_limit_relative{%s} %f\n", labels.c_str(), inv->SystemConfigPara()->getLimitPercent() / 100.0);
+
+    if (inv->DevInfo()->getMaxPower() > 0) {
+        addHeader(gen, "opendtu_inverter_limit_absolute", "current relative limit of the inverter", "gauge");
+        appendf(out, "opendtu_inverter_limit_absolute{%s} %f\n", labels.c_str(), inv->SystemConfigPara()->getLimitPercent() * inv->DevInfo()->getMaxPower() / 100.0);
+    }
+
+    addRadioHistograms(gen, labels, inv);
+
+    // Loop all channels if Statistics have been updated at least once since DTU boot
+    if (inv->Statistics()->getLastUpdate() == 0) { return; }
+
+    for (auto& t : inv->Statistics()->getChannelTypes()) {
+        for (auto& c : inv->Statistics()->getChannelsByType(t)) {
+            addPanelInfo(gen, labels, inv, t, c);
+            for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(_publishFields[0]); f++) {
+                if (t == TYPE_INV && _publishFields[f].field == FLD_PDC) {
+                    addField(gen, labels, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type], "PowerDC");
+                } else {
+                    addField(gen, labels, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type]);
                 }
             }
         }
-        stream->addHeader("Cache-Control", "no-cache");
-        request->send(stream);
+    }
+}
 
-    } catch (std::bad_alloc& bad_alloc) {
-        MessageOutput.printf("Calling /api/prometheus/metrics has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+// only called by the web server task, which generates one inverter at a time
+const String& WebApiPrometheusClass::getInverterLabels(std::shared_ptr<InverterAbstract> inv, const uint8_t idx)
+{
+    if (_inverterLabels.size() <= idx) { _inverterLabels.resize(idx + 1); }
 
-        WebApi.sendTooManyRequests(request);
+    auto& cached = _inverterLabels[idx];
+    if (cached.Serial != inv->serial() || cached.Name != inv->name()) {
+        cached.Serial = inv->serial();
+        cached.Name = inv->name();
+        cached.Labels = "";
+        appendf(cached.Labels, "serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\"", inv->serialString().c_str(), idx, inv->name());
     }
+
+    return cached.Labels;
 }
 
-void WebApiPrometheusClass::addField(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName)
+void WebApiPrometheusClass::addRadioHistograms(Generator& gen, const String& labels, std::shared_ptr<InverterAbstract> inv)
 {
-    if (inv->Statistics()->hasChannelFieldValue(type, channel, fieldId)) {
-        const char* chanName = (channelName == nullptr) ? inv->Statistics()->getChannelFieldName(type, channel, fieldId) : channelName;
-        if (idx == 0 && type == TYPE_AC && channel == 0) {
-            stream->printf("# HELP opendtu_%s in %s\n", chanName, inv->Statistics()->getChannelFieldUnit(type, channel, fieldId));
-            stream->printf("# TYPE opendtu_%s %s\n", chanName, metricName);
+    static const char* const help[HISTOGRAM_CNT] = {
+        "RSSI of successful responses in dBm",
+        "fragments per successful response",
+        "resends and fragment re-requests per successful response",
+        "latency from the first transmission to the last fragment of successful responses in ms",
+    };
+
+    auto& out = gen.Pending;
+
+    for (uint8_t h = 0; h < HISTOGRAM_CNT; h++) {
+        auto histogram = static_cast<RadioHistogram_t>(h);
+        auto const& stats = inv->RadioStats.Histograms[h];
+        auto const& bounds = InverterAbstract::getRadioHistogramBounds(histogram);
+
+        String name = String("opendtu_radio_") + InverterAbstract::getRadioHistogramName(histogram);
+        addHeader(gen, name.c_str(), help[h], "histogram");
+
+        // buckets of Prometheus histograms are cumulative
+        uint32_t count = 0;
+        for (size_t b = 0; b < RADIO_HISTOGRAM_BUCKETS; b++) {
+            count += stats.Buckets[b];
+            if (b < bounds.size()) {
+                appendf(out, "%s_bucket{%s,le=\"%" PRId16 "\"} %" PRIu32 "\n", name.c_str(), labels.c_str(), bounds[b], count);
+            } else {
+                appendf(out, "%s_bucket{%s,le=\"+Inf\"} %" PRIu32 "\n", name.c_str(), labels.c_str(), count);
+            }
         }
-        stream->printf("opendtu_%s{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",type=\"%s\",channel=\"%d\"} %s\n",
-            chanName,
-            serial.c_str(),
-            idx,
-            inv->name(),
-            inv->Statistics()->getChannelTypeName(type),
-            channel,
-            inv->Statistics()->getChannelFieldValueString(type, channel, fieldId).c_str());
+        appendf(out, "%s_sum{%s} %" PRId32 "\n", name.c_str(), labels.c_str(), stats.Sum);
+        appendf(out, "%s_count{%s} %" PRIu32 "\n", name.c_str(), labels.c_str(), count);
     }
 }
 
-void WebApiPrometheusClass::addPanelInfo(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel)
+void WebApiPrometheusClass::addField(Generator& gen, const String& labels, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName)
+{
+    if (!inv->Statistics()->hasChannelFieldValue(type, channel, fieldId)) {
+        return;
+    }
+
+    const char* chanName = (channelName == nullptr) ? inv->Statistics()->getChannelFieldName(type, channel, fieldId) : channelName;
+
+    String name = String("opendtu_") + chanName;
+    String help = String("in ") + inv->Statistics()->getChannelFieldUnit(type, channel, fieldId);
+    addHeader(gen, name.c_str(), help.c_str(), metricName);
+
+    appendf(gen.Pending, "%s{%s,type=\"%s\",channel=\"%d\"} %s\n",
+        name.c_str(),
+        labels.c_str(),
+        inv->Statistics()->getChannelTypeName(type),
+        channel,
+        inv->Statistics()->getChannelFieldValueString(type, channel, fieldId).c_str());
+}
+
+void WebApiPrometheusClass::addPanelInfo(Generator& gen, const String& labels, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel)
 {
     if (type != TYPE_DC) {
         return;
     }
 
     const auto& config = Configuration.getInverterConfig(inv->serial());
-
-    const bool printHelp = (idx == 0 && channel == 0);
-    if (printHelp) {
-        stream->print("# HELP opendtu_PanelInfo panel information\n");
-        stream->print("# TYPE opendtu_PanelInfo gauge\n");
+    if (config == nullptr) {
+        return;
     }
-    stream->printf("opendtu_PanelInfo{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",channel=\"%d\",panelname=\"%s\"} 1\n",
-        serial.c_str(),
-        idx,
-        inv->name(),
+
+    auto& out = gen.Pending;
+
+    addHeader(gen, "opendtu_PanelInfo", "panel information", "gauge");
+    appendf(out, "opendtu_PanelInfo{%s,channel=\"%d\",panelname=\"%s\"} 1\n",
+        labels.c_str(),
         channel,
         config->channel[channel].Name);
 
-    if (printHelp) {
-        stream->print("# HELP opendtu_MaxPower panel maximum output power\n");
-        stream->print("# TYPE opendtu_MaxPower gauge\n");
-    }
-    stream->printf("opendtu_MaxPower{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",channel=\"%d\"} %d\n",
-        serial.c_str(),
-        idx,
-        inv->name(),
+    addHeader(gen, "opendtu_MaxPower", "panel maximum output power", "gauge");
+    appendf(out, "opendtu_MaxPower{%s,channel=\"%d\"} %d\n",
+        labels.c_str(),
         channel,
         config->channel[channel].MaxChannelPower);
 
-    if (printHelp) {
-        stream->print("# HELP opendtu_YieldTotalOffset panel yield offset (for used inverters)\n");
-        stream->print("# TYPE opendtu_YieldTotalOffset gauge\n");
-    }
-    stream->printf("opendtu_YieldTotalOffset{serial=\"%s\",unit=\"%" PRId8 "\",name=\"%s\",channel=\"%" PRId16 "\"} %f\n",
-        serial.c_str(),
-        idx,
-        inv->name(),
+    addHeader(gen, "opendtu_YieldTotalOffset", "panel yield offset (for used inverters)", "gauge");
+    appendf(out, "opendtu_YieldTotalOffset{%s,channel=\"%" PRId16 "\"} %f\n",
+        labels.c_str(),
         channel,
         config->channel[channel].YieldTotalOffset);
 }
@@ -3,9 +3,11 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_security.h"
+#include "JsonArena.h"
 #include "Configuration.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
+#include "WebApi_session.h"
 #include "helper.h"
 #include <AsyncJson.h>
 
@@ -14,7 +16,7 @@ void WebApiSecurityClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_1;
 
     server.on("/api/security/config", HTTP_GET, std::bind(&WebApiSecurityClass::onSecurityGet, this, _1));
-    server.on("/api/security/config", HTTP_POST, std::bind(&WebApiSecurityClass::onSecurityPost, this, _1));
+    server.on("/api/security/config", HTTP_POST, std::bind(&WebApiSecurityClass::onSecurityPost, this, _1), nullptr, WebApiClass::onRequestBody);
     server.on("/api/security/authenticate", HTTP_GET, std::bind(&WebApiSecurityClass::onAuthenticateGet, this, _1));
 }
 
@@ -36,12 +38,15 @@ void WebApiSecurityClass::onSecurityGet(AsyncWebServerRequest* request)
 
 void WebApiSecurityClass::onSecurityPost(AsyncWebServerRequest* request)
 {
-    if (!WebApi.checkCredentials(request)) {
+    // changing the password requires the current one, otherwise a leaked
+    // token would grant access forever, see onAuthenticateGet().
+    if (!WebApi.checkCredentials(request, false)) {
         return;
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -81,7 +86,9 @@ void WebApiSecurityClass::onSecurityPost(AsyncWebServerRequest* request)
 
 void WebApiSecurityClass::onAuthenticateGet(AsyncWebServerRequest* request)
 {
-    if (!WebApi.checkCredentials(request)) {
+    // a token must not be renewed by presenting a token, otherwise a
+    // token leaked once would grant access forever.
+    if (!WebApi.checkCredentials(request, false)) {
         return;
     }
 
@@ -91,5 +98,9 @@ void WebApiSecurityClass::onAuthenticateGet(AsyncWebServerRequest* request)
     retMsg["message"] = "Authentication successful!";
     retMsg["code"] = WebApiError::SecurityAuthSuccess;
 
+    // to be sent as bearer token instead of the password from now on
+    retMsg["token"] = WebApiSession.issue();
+    retMsg["token_lifetime"] = WebApiSession.LifetimeSeconds;
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_session.h"
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <mbedtls/md.h>
+
+WebApiSessionClass WebApiSession;
+
+void WebApiSessionClass::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    esp_fill_random(_key.data(), _key.size());
+    for (auto& entry : _cache) { entry.Expiry = 0; }
+}
+
+uint32_t WebApiSessionClass::getUptimeSeconds()
+{
+    // unlike millis(), this does not wrap within the lifetime of a token
+    return static_cast<uint32_t>(esp_timer_get_time() / 1000000) + 1;
+}
+
+bool WebApiSessionClass::equalConstantTime(uint8_t const* a, uint8_t const* b, size_t len)
+{
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; ++i) { diff |= a[i] ^ b[i]; }
+    return diff == 0;
+}
+
+void WebApiSessionClass::sign(token_t& token) const
+{
+    uint8_t mac[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+        _key.data(), _key.size(), token.data(), _payloadSize, mac);
+    memcpy(token.data() + _payloadSize, mac, _macSize);
+}
+
+String WebApiSessionClass::issue()
+{
+    token_t token;
+
+    uint32_t expiry = getUptimeSeconds() + LifetimeSeconds;
+    memcpy(token.data(), &expiry, sizeof(expiry));
+    esp_fill_random(token.data() + sizeof(expiry), _payloadSize - sizeof(expiry));
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        sign(token);
+    }
+
+    char hex[_tokenSize * 2 + 1];
+    for (size_t i = 0; i < _tokenSize; ++i) {
+        snprintf(&hex[i * 2], 3, "%02x", token[i]);
+    }
+
+    return String(hex);
+}
+
+bool WebApiSessionClass::validate(String const& hex)
+{
+    if (hex.length() != _tokenSize * 2) { return false; }
+
+    token_t token;
+    for (size_t i = 0; i < _tokenSize; ++i) {
+        char byte[3] = { hex[i * 2], hex[i * 2 + 1], 0 };
+        char* end = nullptr;
+        token[i] = strtoul(byte, &end, 16);
+        if (end != &byte[2]) { return false; }
+    }
+
+    uint32_t now = getUptimeSeconds();
+    uint32_t expiry;
+    memcpy(&expiry, token.data(), sizeof(expiry));
+    if (now >= expiry || expiry - now > LifetimeSeconds) { return false; }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    bool cached = false;
+    for (auto& entry : _cache) {
+        if (entry.Expiry == 0) { continue; }
+        if (!equalConstantTime(entry.Token.data(), token.data(), _tokenSize)) { continue; }
+        entry.LastUse = now;
+        cached = true;
+    }
+    if (cached) { return true; }
+
+    token_t expected = token;
+    sign(expected);
+    if (!equalConstantTime(expected.data() + _payloadSize,
+            token.data() + _payloadSize, _macSize)) {
+        return false;
+    }
+
+    // replace an expired entry or the least recently used one
+    auto victim = _cache.begin();
+    for (auto it = _cache.begin(); it != _cache.end(); ++it) {
+        if (it->Expiry <= now) { victim = it; break; }
+        if (it->LastUse < victim->LastUse) { victim = it; }
+    }
+    victim->Token = token;
+    victim->Expiry = expiry;
+    victim->LastUse = now;
+
+    return true;
+}
+
+bool WebApiSessionClass::isValid(AsyncWebServerRequest* request, const bool acceptQueryParam)
+{
+    if (request->hasHeader("X-Session-Token")) {
+        if (validate(request->getHeader("X-Session-Token")->value())) { return true; }
+    }
+
+    if (request->hasHeader("Authorization")) {
+        String const& value = request->getHeader("Authorization")->value();
+        if (value.startsWith("Bearer ")) {
+            return validate(value.substring(7));
+        }
+    }
+
+    if (acceptQueryParam && request->hasParam("token")) {
+        return validate(request->getParam("token")->value());
+    }
+
+    return false;
+}
+
+void WebApiSessionMiddleware::run(AsyncWebServerRequest* request, ArMiddlewareNext next)
+{
+    if (WebApiSession.isValid(request, true)) {
+        return next();
+    }
+
+    _fallback.run(request, next);
+}
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include "WebApi_solarcharger.h"
+#include "JsonArena.h"
 #include "ArduinoJson.h"
 #include "AsyncJson.h"
 #include "Configuration.h"
@@ -16,7 +17,7 @@ void WebApiSolarChargerlass::init(AsyncWebServer& server, Scheduler& scheduler)
     _server = &server;
 
     _server->on("/api/solarcharger/config", HTTP_GET, std::bind(&WebApiSolarChargerlass::onAdminGet, this, _1));
-    _server->on("/api/solarcharger/config", HTTP_POST, std::bind(&WebApiSolarChargerlass::onAdminPost, this, _1));
+    _server->on("/api/solarcharger/config", HTTP_POST, std::bind(&WebApiSolarChargerlass::onAdminPost, this, _1), nullptr, WebApiClass::onRequestBody);
 }
 
 void WebApiSolarChargerlass::onAdminGet(AsyncWebServerRequest* request)
@@ -44,7 +45,8 @@ void WebApiSolarChargerlass::onAdminPost(AsyncWebServerRequest* request)
     }
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
-    JsonDocument root;
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
     if (!WebApi.parseRequestData(request, response, root)) {
         return;
     }
@@ -3,9 +3,16 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_sysstatus.h"
+#include "BootProfiler.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
+#include "FsWriteMonitor.h"
+#include "TlsMonitor.h"
+#include "HeapMonitor.h"
+#include "JsonArena.h"
 #include "NetworkSettings.h"
 #include "PinMapping.h"
+#include "RtosTaskProfiler.h"
 #include "SerialPortManager.h"
 #include "WebApi.h"
 #include "__compiled_constants.h"
@@ -20,6 +27,24 @@ void WebApiSysstatusClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_1;
 
     server.on("/api/system/status", HTTP_GET, std::bind(&WebApiSysstatusClass::onSystemStatus, this, _1));
+    server.on("/api/system/heap", HTTP_GET, std::bind(&WebApiSysstatusClass::onHeapStatus, this, _1));
+}
+
+void WebApiSysstatusClass::onHeapStatus(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto root = response->getRoot().to<JsonObject>();
+
+    HeapMonitor.serialize(root);
+
+    JsonObject arena = root["json_arena"].to<JsonObject>();
+    JsonArena.serialize(arena);
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
 void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
@@ -54,17 +79,13 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
     root["flashsize"] = ESP.getFlashChipSize();
 
     JsonArray taskDetails = root["task_details"].to<JsonArray>();
-    static std::array<char const*, 13> constexpr task_names = {
-        "IDLE0", "IDLE1", "wifi", "tiT", "loopTask", "async_tcp", "mqttclient",
-        "HuaweiHwIfc", "HuaweiTwai", "PM:SDM", "PM:HTTP+JSON", "PM:SML", "PM:HTTP+SML"
-    };
-    for (char const* task_name : task_names) {
-        TaskHandle_t const handle = xTaskGetHandle(task_name);
-        if (!handle) { continue; }
+    for (auto const& info : RtosTaskProfiler.getTasks()) {
         JsonObject task = taskDetails.add<JsonObject>();
-        task["name"] = task_name;
-        task["stack_watermark"] = uxTaskGetStackHighWaterMark(handle);
-        task["priority"] = uxTaskPriorityGet(handle);
+        task["name"] = info.Name.data();
+        task["stack_watermark"] = info.StackWatermark;
+        task["priority"] = info.Priority;
+        task["core"] = info.Core;
+        if (info.CpuShare) { task["cpu_share"] = *info.CpuShare; }
     }
 
     String reason;
@@ -84,21 +105,55 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
     root["git_branch"] = __COMPILED_GIT_BRANCH__;
     root["pioenv"] = PIOENV;
 
+    // subsystems compiled out by the build flags of the env
+    JsonArray omitted = root["omitted_subsystems"].to<JsonArray>();
+#ifdef OPENDTU_WITHOUT_HUAWEI
+    omitted.add("huawei");
+#endif
+#ifdef OPENDTU_WITHOUT_DISPLAY
+    omitted.add("display");
+#endif
+
     root["uptime"] = esp_timer_get_time() / 1000000;
 
     root["nrf_configured"] = PinMapping.isValidNrf24Config();
-    root["nrf_connected"] = Hoymiles.getRadioNrf()->isConnected();
-    root["nrf_pvariant"] = Hoymiles.getRadioNrf()->isPVariant();
-
     root["cmt_configured"] = PinMapping.isValidCmt2300Config();
-    root["cmt_connected"] = Hoymiles.getRadioCmt()->isConnected();
+
+    // querying the chips uses the SPI bus
+    Hoymiles.withRadios([&root]() {
+        root["nrf_connected"] = Hoymiles.getRadioNrf()->isConnected();
+        root["nrf_pvariant"] = Hoymiles.getRadioNrf()->isPVariant();
+        root["cmt_connected"] = Hoymiles.getRadioCmt()->isConnected();
+    });
 
     JsonArray uarts = root["uarts"].to<JsonArray>();
     for (auto const& allocation : SerialPortManager.getAllocations()) {
         JsonObject uart = uarts.add<JsonObject>();
         uart["port"] = allocation.first;
         uart["owner"] = allocation.second;
+
+        if (allocation.first < 0) { continue; }
+        auto oStats = SerialPortManager.getStats(allocation.first);
+        if (!oStats) { continue; }
+
+        uart["rx_bytes"] = oStats->RxBytes;
+        uart["overruns"] = oStats->Overruns;
+        uart["framing_errors"] = oStats->FramingErrors;
+        uart["parity_errors"] = oStats->ParityErrors;
+        uart["breaks"] = oStats->Breaks;
     }
 
+    JsonObject fsWrites = root["fs_writes"].to<JsonObject>();
+    FsWriteMonitor.serialize(fsWrites);
+
+    JsonObject tls = root["tls"].to<JsonObject>();
+    TlsMonitor.serialize(tls);
+
+    JsonObject boot = root["boot"].to<JsonObject>();
+    BootProfiler.serialize(boot);
+
+    JsonArray tasks = root["tasks"].to<JsonArray>();
+    TaskMonitor.serialize(tasks);
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_timeseries.h"
+#include "TimeSeries.h"
+#include "WebApi.h"
+#include "WebApi_errors.h"
+#include <AsyncJson.h>
+#include <ctime>
+
+void WebApiTimeSeriesClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+
+    server.on("/api/timeseries/list", HTTP_GET, std::bind(&WebApiTimeSeriesClass::onSeriesList, this, _1));
+    server.on("/api/timeseries/query", HTTP_GET, std::bind(&WebApiTimeSeriesClass::onQuery, this, _1));
+    server.on("/api/timeseries/range", HTTP_GET, std::bind(&WebApiTimeSeriesClass::onRange, this, _1));
+}
+
+void WebApiTimeSeriesClass::onSeriesList(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& root = response->getRoot();
+
+    JsonArray tiers = root["tiers"].to<JsonArray>();
+    for (uint8_t t = 0; t < TimeSeriesClass::TierCount; ++t) {
+        tiers.add(TimeSeriesClass::getTierInterval(t));
+    }
+
+    JsonArray series = root["series"].to<JsonArray>();
+    TimeSeries.serializeSeries(series);
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiTimeSeriesClass::onQuery(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& root = response->getRoot();
+
+    if (!request->hasParam("series")) {
+        root["type"] = "warning";
+        root["message"] = "Series missing!";
+        root["code"] = WebApiError::GenericValueMissing;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
+    auto getParam = [request](char const* name, uint32_t fallback) -> uint32_t {
+        if (!request->hasParam(name)) { return fallback; }
+        return request->getParam(name)->value().toInt();
+    };
+
+    static constexpr uint32_t maxPoints = 1440;
+
+    uint32_t now = std::time(nullptr);
+    String key = request->getParam("series")->value();
+    uint8_t tier = getParam("tier", 1);
+    uint32_t from = getParam("from", now - 24 * 60 * 60);
+    uint32_t to = getParam("to", now);
+    uint32_t limit = std::min(getParam("limit", maxPoints), maxPoints);
+
+    // with the buckets parameter, the range is split into buckets of equal
+    // width holding the min, max and average value, and the tier is chosen
+    // according to the bucket width unless requested explicitly.
+    if (request->hasParam("buckets")) {
+        uint32_t count = std::min(getParam("buckets", 0), maxPoints);
+        if (count > 0 && to > from && !request->hasParam("tier")) {
+            tier = TimeSeriesClass::selectTier((to - from) / count);
+        }
+
+        std::vector<TimeSeriesClass::Bucket> buckets;
+        if (!TimeSeries.getBuckets(key, tier, from, to, count, buckets)) {
+            root["type"] = "warning";
+            root["message"] = "Unknown series, tier or invalid range!";
+            root["code"] = WebApiError::GenericNoValueFound;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
+        JsonArray target = root["buckets"].to<JsonArray>();
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            JsonArray bucket = target.add<JsonArray>();
+            bucket.add(from + static_cast<uint64_t>(to - from) * i / count);
+            if (buckets[i].Count == 0) { continue; }
+            bucket.add(buckets[i].Min);
+            bucket.add(buckets[i].Max);
+            bucket.add(buckets[i].Avg);
+        }
+
+        root["series"] = key;
+        root["tier"] = tier;
+        root["interval"] = TimeSeriesClass::getTierInterval(tier);
+        root["bucket_width"] = (to - from) / count;
+
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
+    JsonArray points = root["points"].to<JsonArray>();
+    bool truncated = false;
+    if (!TimeSeries.query(key, tier, from, to, limit, points, truncated)) {
+        root.clear();
+        root["type"] = "warning";
+        root["message"] = "Unknown series or tier!";
+        root["code"] = WebApiError::GenericNoValueFound;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
+    root["series"] = key;
+    root["tier"] = tier;
+    root["interval"] = TimeSeriesClass::getTierInterval(tier);
+    root["truncated"] = truncated;
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+// the averages of the range split into the given number of buckets in the
+// binary form of TimeSeriesClass::getRange(), meant for the charts of the
+// web application: 720 points of a day take less than 1.5 kB.
+void WebApiTimeSeriesClass::onRange(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    auto sendError = [request](char const* message, WebApiError code) {
+        AsyncJsonResponse* response = new AsyncJsonResponse();
+        auto& root = response->getRoot();
+        root["type"] = "warning";
+        root["message"] = message;
+        root["code"] = code;
+        response->setCode(400);
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+    };
+
+    if (!request->hasParam("series")) {
+        sendError("Series missing!", WebApiError::GenericValueMissing);
+        return;
+    }
+
+    auto getParam = [request](char const* name, uint32_t fallback) -> uint32_t {
+        if (!request->hasParam(name)) { return fallback; }
+        return request->getParam(name)->value().toInt();
+    };
+
+    static constexpr uint32_t maxPoints = 1440;
+
+    uint32_t now = std::time(nullptr);
+    String key = request->getParam("series")->value();
+    uint32_t from = getParam("from", now - 24 * 60 * 60);
+    uint32_t to = getParam("to", now);
+    uint32_t count = std::min(getParam("points", 720), maxPoints);
+
+    if (count == 0 || to <= from) {
+        sendError("Invalid range!", WebApiError::GenericValueMissing);
+        return;
+    }
+
+    // the buckets are of integral width, the range is extended accordingly
+    uint32_t step = std::max<uint32_t>((to - from + count - 1) / count, 1);
+    uint8_t tier = request->hasParam("tier") ? getParam("tier", 0) : TimeSeriesClass::selectTier(step);
+
+    auto data = std::make_shared<std::vector<uint8_t>>();
+    if (!TimeSeries.getRange(key, tier, from, step, count, *data)) {
+        sendError("Unknown series or tier!", WebApiError::GenericNoValueFound);
+        return;
+    }
+
+    WebApi.sendBuffer(request, "application/octet-stream", data, false);
+}
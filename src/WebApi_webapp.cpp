@@ -3,38 +3,32 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_webapp.h"
-#include <MD5Builder.h>
+#include "__webapp_constants.h"
 
 extern const uint8_t file_index_html_start[] asm("_binary_webapp_dist_index_html_gz_start");
 extern const uint8_t file_favicon_ico_start[] asm("_binary_webapp_dist_favicon_ico_start");
 extern const uint8_t file_favicon_png_start[] asm("_binary_webapp_dist_favicon_png_start");
 extern const uint8_t file_zones_json_start[] asm("_binary_webapp_dist_zones_json_gz_start");
 extern const uint8_t file_app_js_start[] asm("_binary_webapp_dist_js_app_js_gz_start");
+extern const uint8_t file_views_js_start[] asm("_binary_webapp_dist_js_views_js_gz_start");
 extern const uint8_t file_site_webmanifest_start[] asm("_binary_webapp_dist_site_webmanifest_start");
+extern const uint8_t file_sw_js_start[] asm("_binary_webapp_dist_sw_js_gz_start");
 
 extern const uint8_t file_index_html_end[] asm("_binary_webapp_dist_index_html_gz_end");
 extern const uint8_t file_favicon_ico_end[] asm("_binary_webapp_dist_favicon_ico_end");
 extern const uint8_t file_favicon_png_end[] asm("_binary_webapp_dist_favicon_png_end");
 extern const uint8_t file_zones_json_end[] asm("_binary_webapp_dist_zones_json_gz_end");
 extern const uint8_t file_app_js_end[] asm("_binary_webapp_dist_js_app_js_gz_end");
+extern const uint8_t file_views_js_end[] asm("_binary_webapp_dist_js_views_js_gz_end");
 extern const uint8_t file_site_webmanifest_end[] asm("_binary_webapp_dist_site_webmanifest_end");
+extern const uint8_t file_sw_js_end[] asm("_binary_webapp_dist_sw_js_gz_end");
 
-void WebApiWebappClass::responseBinaryDataWithETagCache(AsyncWebServerRequest *request, const String &contentType, const String &contentEncoding, const uint8_t *content, size_t len)
+void WebApiWebappClass::responseBinaryDataWithETagCache(AsyncWebServerRequest *request, const String &contentType, const String &contentEncoding, const uint8_t *content, size_t len, const char* eTag, const char* cacheControl)
 {
-    auto md5 = MD5Builder();
-    md5.begin();
-    md5.add(const_cast<uint8_t *>(content), len);
-    md5.calculate();
-
-    String expectedEtag;
-    expectedEtag = "\"";
-    expectedEtag += md5.toString();
-    expectedEtag += "\"";
-
     bool eTagMatch = false;
     if (request->hasHeader("If-None-Match")) {
         const AsyncWebHeader* h = request->getHeader("If-None-Match");
-        eTagMatch = h->value().equals(expectedEtag);
+        eTagMatch = h->value().equals(eTag);
     }
 
     // begin response 200 or 304
@@ -49,8 +43,8 @@ void WebApiWebappClass::responseBinaryDataWithETagCache(AsyncWebServerRequest *r
     }
 
     // HTTP requires cache headers in 200 and 304 to be identical
-    response->addHeader("Cache-Control", "public, must-revalidate");
-    response->addHeader("ETag", expectedEtag);
+    response->addHeader("Cache-Control", cacheControl);
+    response->addHeader("ETag", eTag);
 
     request->send(response);
 }
@@ -63,34 +57,53 @@ void WebApiWebappClass::init(AsyncWebServer& server, Scheduler& scheduler)
     */
 
     server.on("/", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "text/html", "gzip", file_index_html_start, file_index_html_end - file_index_html_start);
+        responseBinaryDataWithETagCache(request, "text/html", "gzip", file_index_html_start, file_index_html_end - file_index_html_start, __WEBAPP_ETAG_INDEX_HTML__);
     });
 
     server.onNotFound([&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "text/html", "gzip", file_index_html_start, file_index_html_end - file_index_html_start);
+        responseBinaryDataWithETagCache(request, "text/html", "gzip", file_index_html_start, file_index_html_end - file_index_html_start, __WEBAPP_ETAG_INDEX_HTML__);
     });
 
     server.on("/index.html", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "text/html", "gzip", file_index_html_start, file_index_html_end - file_index_html_start);
+        responseBinaryDataWithETagCache(request, "text/html", "gzip", file_index_html_start, file_index_html_end - file_index_html_start, __WEBAPP_ETAG_INDEX_HTML__);
     });
 
     server.on("/favicon.ico", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "image/x-icon", "", file_favicon_ico_start, file_favicon_ico_end - file_favicon_ico_start);
+        responseBinaryDataWithETagCache(request, "image/x-icon", "", file_favicon_ico_start, file_favicon_ico_end - file_favicon_ico_start, __WEBAPP_ETAG_FAVICON_ICO__);
     });
 
     server.on("/favicon.png", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "image/png", "", file_favicon_png_start, file_favicon_png_end - file_favicon_png_start);
+        responseBinaryDataWithETagCache(request, "image/png", "", file_favicon_png_start, file_favicon_png_end - file_favicon_png_start, __WEBAPP_ETAG_FAVICON_PNG__);
     });
 
     server.on("/zones.json", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "application/json", "gzip", file_zones_json_start, file_zones_json_end - file_zones_json_start);
+        responseBinaryDataWithETagCache(request, "application/json", "gzip", file_zones_json_start, file_zones_json_end - file_zones_json_start, __WEBAPP_ETAG_ZONES_JSON__);
     });
 
     server.on("/site.webmanifest", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "application/json", "", file_site_webmanifest_start, file_site_webmanifest_end - file_site_webmanifest_start);
+        responseBinaryDataWithETagCache(request, "application/json", "", file_site_webmanifest_start, file_site_webmanifest_end - file_site_webmanifest_start, __WEBAPP_ETAG_SITE_WEBMANIFEST__);
     });
 
     server.on("/js/app.js", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, "text/javascript", "gzip", file_app_js_start, file_app_js_end - file_app_js_start);
+        responseBinaryDataWithETagCache(request, "text/javascript", "gzip", file_app_js_start, file_app_js_end - file_app_js_start, __WEBAPP_ETAG_APP_JS__);
+    });
+
+    // the views other than the dashboard, loaded on demand by the web app
+    server.on("/js/views.js", HTTP_GET, [&](AsyncWebServerRequest* request) {
+        responseBinaryDataWithETagCache(request, "text/javascript", "gzip", file_views_js_start, file_views_js_end - file_views_js_start, __WEBAPP_ETAG_VIEWS_JS__);
     });
+
+    // caches the files above in the browser, which then only checks whether
+    // this worker changed, i.e., whether the firmware was updated.
+    server.on("/sw.js", HTTP_GET, [&](AsyncWebServerRequest* request) {
+        responseBinaryDataWithETagCache(request, "text/javascript", "gzip", file_sw_js_start, file_sw_js_end - file_sw_js_start, __WEBAPP_ETAG_SW_JS__);
+    });
+
+    // the content-hashed path changes with the content, hence browsers never
+    // need to revalidate it.
+    if (strcmp(__WEBAPP_APP_JS_PATH__, "/js/app.js") != 0) {
+        server.on(__WEBAPP_APP_JS_PATH__, HTTP_GET, [&](AsyncWebServerRequest* request) {
+            responseBinaryDataWithETagCache(request, "text/javascript", "gzip", file_app_js_start, file_app_js_end - file_app_js_start, __WEBAPP_ETAG_APP_JS__, ImmutableCacheControl);
+        });
+    }
 }
@@ -2,10 +2,14 @@
 /*
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
+#ifndef OPENDTU_WITHOUT_HUAWEI
 #include "WebApi_ws_Huawei.h"
+#include "JsonArena.h"
+#include "TaskMonitor.h"
 #include "AsyncJson.h"
 #include "Configuration.h"
 #include <gridcharger/huawei/Controller.h>
+#include "Logging.h"
 #include "MessageOutput.h"
 #include "Utils.h"
 #include "WebApi.h"
@@ -32,13 +36,13 @@ void WebApiWsHuaweiLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
     _ws.onEvent(std::bind(&WebApiWsHuaweiLiveClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
 
     scheduler.addTask(_wsCleanupTask);
-    _wsCleanupTask.setCallback(std::bind(&WebApiWsHuaweiLiveClass::wsCleanupTaskCb, this));
+    _wsCleanupTask.setCallback(TaskMonitor.wrap("WebApiWsHuaweiLive::wsCleanupTaskCb", std::bind(&WebApiWsHuaweiLiveClass::wsCleanupTaskCb, this)));
     _wsCleanupTask.setIterations(TASK_FOREVER);
     _wsCleanupTask.setInterval(1 * TASK_SECOND);
     _wsCleanupTask.enable();
 
     scheduler.addTask(_sendDataTask);
-    _sendDataTask.setCallback(std::bind(&WebApiWsHuaweiLiveClass::sendDataTaskCb, this));
+    _sendDataTask.setCallback(TaskMonitor.wrap("WebApiWsHuaweiLive::sendDataTaskCb", std::bind(&WebApiWsHuaweiLiveClass::sendDataTaskCb, this)));
     _sendDataTask.setIterations(TASK_FOREVER);
     _sendDataTask.setInterval(1 * TASK_SECOND);
     _sendDataTask.enable();
@@ -51,7 +55,7 @@ void WebApiWsHuaweiLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
 void WebApiWsHuaweiLiveClass::reload()
 {
-    _ws.removeMiddleware(&_simpleDigestAuth);
+    _ws.removeMiddleware(&_sessionAuth);
 
     auto const& config = Configuration.get();
 
@@ -59,7 +63,7 @@ void WebApiWsHuaweiLiveClass::reload()
 
     _ws.enable(false);
     _simpleDigestAuth.setPassword(config.Security.Password);
-    _ws.addMiddleware(&_simpleDigestAuth);
+    _ws.addMiddleware(&_sessionAuth);
     _ws.closeAll();
     _ws.enable(true);
 }
@@ -72,23 +76,25 @@ void WebApiWsHuaweiLiveClass::wsCleanupTaskCb()
 
 void WebApiWsHuaweiLiveClass::sendDataTaskCb()
 {
+    auto& hub = WebApi.getWsHub();
+
     // do nothing if no WS client is connected
-    if (_ws.count() == 0) {
+    if (_ws.count() == 0 && !hub.hasSubscribers(WebApiWsHubClass::Topic::Huawei)) {
         return;
     }
 
     try {
         std::lock_guard<std::mutex> lock(_mutex);
-        JsonDocument root;
+        JsonArenaAllocator rootAllocator;
+        JsonDocument root(&rootAllocator);
         JsonVariant var = root;
 
         generateCommonJsonResponse(var);
 
         if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
-            String buffer;
-            serializeJson(root, buffer);
-
-            _ws.textAll(buffer);
+            auto buffer = Utils::serializeJsonShared(root);
+            _flow.textAll(buffer);
+            hub.publish(WebApiWsHubClass::Topic::Huawei, buffer);
         }
     } catch (std::bad_alloc& bad_alloc) {
         MessageOutput.printf("Calling /api/huaweilivedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
@@ -104,16 +110,12 @@ void WebApiWsHuaweiLiveClass::generateCommonJsonResponse(JsonVariant& root)
 
 void WebApiWsHuaweiLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
+    _flow.onEvent(client, type);
+
     if (type == WS_EVT_CONNECT) {
-        char str[64];
-        snprintf(str, sizeof(str), "Websocket: [%s][%u] connect", server->url(), client->id());
-        Serial.println(str);
-        MessageOutput.println(str);
+        DTU_LOGD("Websocket", "[%s][%u] connect", server->url(), client->id());
     } else if (type == WS_EVT_DISCONNECT) {
-        char str[64];
-        snprintf(str, sizeof(str), "Websocket: [%s][%u] disconnect", server->url(), client->id());
-        Serial.println(str);
-        MessageOutput.println(str);
+        DTU_LOGD("Websocket", "[%s][%u] disconnect", server->url(), client->id());
     }
 }
 
@@ -138,4 +140,6 @@ void WebApiWsHuaweiLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
         MessageOutput.printf("Unknown exception in /api/huaweilivedata/status. Reason: \"%s\".\r\n", exc.what());
         WebApi.sendTooManyRequests(request);
     }
-}
\ No newline at end of file
+}
+
+#endif // OPENDTU_WITHOUT_HUAWEI
@@ -3,9 +3,12 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_ws_battery.h"
+#include "JsonArena.h"
+#include "TaskMonitor.h"
 #include "AsyncJson.h"
 #include "Configuration.h"
 #include "Battery.h"
+#include "Logging.h"
 #include "MessageOutput.h"
 #include "WebApi.h"
 #include "defaults.h"
@@ -32,17 +35,23 @@ void WebApiWsBatteryLiveClass::init(AsyncWebServer& server, Scheduler& scheduler
     _ws.onEvent(std::bind(&WebApiWsBatteryLiveClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
 
     scheduler.addTask(_wsCleanupTask);
-    _wsCleanupTask.setCallback(std::bind(&WebApiWsBatteryLiveClass::wsCleanupTaskCb, this));
+    _wsCleanupTask.setCallback(TaskMonitor.wrap("WebApiWsBatteryLive::wsCleanupTaskCb", std::bind(&WebApiWsBatteryLiveClass::wsCleanupTaskCb, this)));
     _wsCleanupTask.setIterations(TASK_FOREVER);
     _wsCleanupTask.setInterval(1 * TASK_SECOND);
     _wsCleanupTask.enable();
 
     scheduler.addTask(_sendDataTask);
-    _sendDataTask.setCallback(std::bind(&WebApiWsBatteryLiveClass::sendDataTaskCb, this));
+    _sendDataTask.setCallback(TaskMonitor.wrap("WebApiWsBatteryLive::sendDataTaskCb", std::bind(&WebApiWsBatteryLiveClass::sendDataTaskCb, this)));
     _sendDataTask.setIterations(TASK_FOREVER);
     _sendDataTask.setInterval(1 * TASK_SECOND);
     _sendDataTask.enable();
 
+    auto& hub = WebApi.getWsHub();
+    hub.onSubscribe(WebApiWsHubClass::Topic::Battery, std::bind(&WebApiWsBatteryLiveClass::requestHubSnapshot, this, _1));
+    hub.onMessage(WebApiWsHubClass::Topic::Battery, [this](uint32_t clientId, char const* text) {
+        if (strcmp(text, "resync") == 0) { requestHubSnapshot(clientId); }
+    });
+
     _simpleDigestAuth.setUsername(AUTH_USERNAME);
     _simpleDigestAuth.setRealm("battery websocket");
 
@@ -51,7 +60,7 @@ void WebApiWsBatteryLiveClass::init(AsyncWebServer& server, Scheduler& scheduler
 
 void WebApiWsBatteryLiveClass::reload()
 {
-    _ws.removeMiddleware(&_simpleDigestAuth);
+    _ws.removeMiddleware(&_sessionAuth);
 
     auto const& config = Configuration.get();
 
@@ -59,7 +68,7 @@ void WebApiWsBatteryLiveClass::reload()
 
     _ws.enable(false);
     _simpleDigestAuth.setPassword(config.Security.Password);
-    _ws.addMiddleware(&_simpleDigestAuth);
+    _ws.addMiddleware(&_sessionAuth);
     _ws.closeAll();
     _ws.enable(true);
 }
@@ -70,38 +79,67 @@ void WebApiWsBatteryLiveClass::wsCleanupTaskCb()
      _ws.cleanupClients();
 }
 
+// like the live data websocket, this one transmits changes only. a client
+// first receives the complete live view ({"type":"full","seq":n,...}),
+// afterwards the values which changed with the next battery snapshot
+// ({"type":"delta","seq":n+1,...}) as a JSON merge patch. the data age is
+// part of every message. a client which misses a sequence number sends
+// "resync" to receive the complete live view again.
 void WebApiWsBatteryLiveClass::sendDataTaskCb()
 {
+    auto& hub = WebApi.getWsHub();
+
     // do nothing if no WS client is connected
-    if (_ws.count() == 0) {
+    if (_ws.count() == 0 && !hub.hasSubscribers(WebApiWsHubClass::Topic::Battery)) {
         return;
     }
 
-    if (!Battery.getStats()->updateAvailable(_lastUpdateCheck)) { return; }
-    _lastUpdateCheck = millis();
+    std::vector<uint32_t> snapshotClients;
+    std::vector<uint32_t> hubSnapshotClients;
+    {
+        std::lock_guard<std::mutex> lock(_snapshotMutex);
+        snapshotClients.swap(_snapshotClients);
+        hubSnapshotClients.swap(_hubSnapshotClients);
+    }
 
     try {
         std::lock_guard<std::mutex> lock(_mutex);
-        JsonDocument root;
-        JsonVariant var = root;
-        
-        generateCommonJsonResponse(var);
 
-        if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
+        JsonArenaAllocator deltaAllocator;
+        JsonDocument delta(&deltaAllocator);
+        auto deltaObj = delta.to<JsonObject>();
+        bool changed = updateState(deltaObj);
+
+        // battery provider does not generate a card, e.g., MQTT provider
+        bool hasCard = _state.as<JsonObjectConst>().size() > 0;
+
+        // send an empty delta from time to time as a keepalive
+        if (changed || (hasCard && (millis() - _lastPublish) > 10 * 1000)) {
+            delta["type"] = "delta";
+            delta["seq"] = ++_sequence;
+            if (hasCard) { delta["data_age"] = _spStateStats->getAgeSeconds(); }
 
-            // battery provider does not generate a card, e.g., MQTT provider
-            if (root.isNull()) { return; }
+            if (Utils::checkJsonAlloc(delta, __FUNCTION__, __LINE__)) {
+                auto buffer = Utils::serializeJsonShared(delta);
 
-            String buffer;
-            serializeJson(root, buffer);
+                if (Configuration.get().Security.AllowReadonly) {
+                    _ws.setAuthentication("", "");
+                } else {
+                    _ws.setAuthentication(AUTH_USERNAME, Configuration.get().Security.Password);
+                }
 
-            if (Configuration.get().Security.AllowReadonly) {
-                _ws.setAuthentication("", "");
-            } else {
-                _ws.setAuthentication(AUTH_USERNAME, Configuration.get().Security.Password);
+                _flow.textAll(buffer);
+                hub.publish(WebApiWsHubClass::Topic::Battery, buffer);
+                _lastPublish = millis();
             }
+        }
+
+        // clients which skipped deltas continue with the current state
+        auto resyncClients = _flow.takeResync();
+        snapshotClients.insert(snapshotClients.end(), resyncClients.begin(), resyncClients.end());
 
-            _ws.textAll(buffer);
+        if (!snapshotClients.empty() || !hubSnapshotClients.empty()) {
+            sendSnapshot(snapshotClients, hubSnapshotClients);
         }
     } catch (std::bad_alloc& bad_alloc) {
         MessageOutput.printf("Calling /api/batterylivedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
@@ -110,17 +148,88 @@ void WebApiWsBatteryLiveClass::sendDataTaskCb()
     }
 }
 
-void WebApiWsBatteryLiveClass::generateCommonJsonResponse(JsonVariant& root)
+bool WebApiWsBatteryLiveClass::updateState(JsonObject delta)
+{
+    auto spStats = Battery.getStats();
+    if (spStats == _spStateStats) { return false; }
+
+    JsonArenaAllocator currentAllocator;
+    JsonDocument current(&currentAllocator);
+    JsonVariant var = current;
+    spStats->getLiveViewData(var);
+
+    // try again during the next round
+    if (!Utils::checkJsonAlloc(current, __FUNCTION__, __LINE__)) { return false; }
+
+    if (!_state.is<JsonObject>()) { _state.to<JsonObject>(); }
+
+    bool changed = Utils::generateJsonMergePatch(_state.as<JsonObjectConst>(), current.as<JsonObjectConst>(), delta);
+    Utils::applyJsonMergePatch(_state.as<JsonObject>(), delta);
+    _spStateStats = spStats;
+
+    return changed;
+}
+
+void WebApiWsBatteryLiveClass::addState(JsonObject root)
+{
+    for (JsonPairConst kv : _state.as<JsonObjectConst>()) {
+        root[kv.key()] = kv.value();
+    }
+
+    if (_spStateStats) { root["data_age"] = _spStateStats->getAgeSeconds(); }
+}
+
+void WebApiWsBatteryLiveClass::sendSnapshot(std::vector<uint32_t> const& clientIds, std::vector<uint32_t> const& hubClientIds)
 {
-    Battery.getStats()->getLiveViewData(root);
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
+    root["type"] = "full";
+    root["seq"] = _sequence;
+    addState(root.as<JsonObject>());
+
+    if (!Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
+        return;
+    }
+
+    auto buffer = Utils::serializeJsonShared(root);
+
+    for (auto id : clientIds) {
+        auto client = _ws.client(id);
+        if (client != nullptr) { client->text(buffer); }
+    }
+
+    for (auto id : hubClientIds) {
+        WebApi.getWsHub().send(id, WebApiWsHubClass::Topic::Battery, buffer);
+    }
+}
+
+void WebApiWsBatteryLiveClass::requestHubSnapshot(uint32_t clientId)
+{
+    std::lock_guard<std::mutex> lock(_snapshotMutex);
+    _hubSnapshotClients.push_back(clientId);
 }
 
 void WebApiWsBatteryLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
+    _flow.onEvent(client, type);
+
     if (type == WS_EVT_CONNECT) {
-        MessageOutput.printf("Websocket: [%s][%u] connect\r\n", server->url(), client->id());
+        DTU_LOGD("Websocket", "[%s][%u] connect", server->url(), client->id());
+
+        std::lock_guard<std::mutex> lock(_snapshotMutex);
+        _snapshotClients.push_back(client->id());
+    } else if (type == WS_EVT_DATA) {
+        auto info = static_cast<AwsFrameInfo*>(arg);
+        if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+            return;
+        }
+
+        if (len == 6 && memcmp(data, "resync", len) == 0) {
+            std::lock_guard<std::mutex> lock(_snapshotMutex);
+            _snapshotClients.push_back(client->id());
+        }
     } else if (type == WS_EVT_DISCONNECT) {
-        MessageOutput.printf("Websocket: [%s][%u] disconnect\r\n", server->url(), client->id());
+        DTU_LOGD("Websocket", "[%s][%u] disconnect", server->url(), client->id());
     }
 }
 
@@ -133,7 +242,14 @@ void WebApiWsBatteryLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
         std::lock_guard<std::mutex> lock(_mutex);
         AsyncJsonResponse* response = new AsyncJsonResponse();
         auto& root = response->getRoot();
-        generateCommonJsonResponse(root);
+
+        // the cached live view is only reused while it is current, as it
+        // must not advance past the delta sequence.
+        if (_spStateStats && _spStateStats == Battery.getStats()) {
+            addState(root.to<JsonObject>());
+        } else {
+            Battery.getStats()->getLiveViewData(root);
+        }
 
         WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
     } catch (std::bad_alloc& bad_alloc) {
@@ -3,22 +3,46 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_ws_console.h"
+#include "TaskMonitor.h"
 #include "Configuration.h"
 #include "MessageOutput.h"
 #include "WebApi.h"
 #include "defaults.h"
+#include <cstring>
 
 WebApiWsConsoleClass::WebApiWsConsoleClass()
     : _ws("/console")
-    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsConsoleClass::wsCleanupTaskCb, this))
+    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("WebApiWsConsole::wsCleanupTaskCb", std::bind(&WebApiWsConsoleClass::wsCleanupTaskCb, this)))
 {
 }
 
 void WebApiWsConsoleClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+    using std::placeholders::_4;
+    using std::placeholders::_5;
+    using std::placeholders::_6;
+
     server.addHandler(&_ws);
+    _ws.onEvent(std::bind(&WebApiWsConsoleClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
     MessageOutput.register_ws_output(&_ws);
 
+    auto& hub = WebApi.getWsHub();
+    MessageOutput.register_ws_hub(&hub);
+    hub.onMessage(WebApiWsHubClass::Topic::Console, [this](uint32_t, char const* text) {
+        char command[64];
+        if (strlen(text) >= sizeof(command)) { return; }
+        strcpy(command, text);
+        handleCommand(command);
+    });
+    hub.onSubscribe(WebApiWsHubClass::Topic::Console, [&hub](uint32_t clientId) {
+        auto spBacklog = MessageOutput.getBacklog();
+        if (spBacklog->empty()) { return; }
+        hub.sendText(clientId, WebApiWsHubClass::Topic::Console, spBacklog->data(), spBacklog->size());
+    });
+
     scheduler.addTask(_wsCleanupTask);
     _wsCleanupTask.enable();
 
@@ -30,7 +54,7 @@ void WebApiWsConsoleClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
 void WebApiWsConsoleClass::reload()
 {
-    _ws.removeMiddleware(&_simpleDigestAuth);
+    _ws.removeMiddleware(&_sessionAuth);
 
     auto const& config = Configuration.get();
 
@@ -38,7 +62,7 @@ void WebApiWsConsoleClass::reload()
 
     _ws.enable(false);
     _simpleDigestAuth.setPassword(config.Security.Password);
-    _ws.addMiddleware(&_simpleDigestAuth);
+    _ws.addMiddleware(&_sessionAuth);
     _ws.closeAll();
     _ws.enable(true);
 }
@@ -48,3 +72,60 @@ void WebApiWsConsoleClass::wsCleanupTaskCb()
     // see: https://github.com/me-no-dev/ESPAsyncWebServer#limiting-the-number-of-web-socket-clients
     _ws.cleanupClients();
 }
+
+void WebApiWsConsoleClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
+{
+    // replay the recent output, such that a newly connected client sees
+    // what happened before, e.g., while the device booted.
+    if (type == WS_EVT_CONNECT) {
+        auto spBacklog = MessageOutput.getBacklog();
+        if (!spBacklog->empty()) { client->text(spBacklog); }
+        return;
+    }
+
+    if (type != WS_EVT_DATA) { return; }
+
+    auto info = static_cast<AwsFrameInfo*>(arg);
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+        return;
+    }
+
+    // the web application regularly sends "ping", which is ignored
+    char command[64];
+    if (len >= sizeof(command)) { return; }
+    memcpy(command, data, len);
+    command[len] = '\0';
+
+    handleCommand(command);
+}
+
+// "loglevel" lists the log levels, "loglevel <tag> <level>" changes the level
+// of the respective tag, where tag "*" changes the default level.
+void WebApiWsConsoleClass::handleCommand(char* command)
+{
+    char* savePtr = nullptr;
+    char const* name = strtok_r(command, " ", &savePtr);
+    if (name == nullptr || strcmp(name, "loglevel") != 0) { return; }
+
+    char const* tag = strtok_r(nullptr, " ", &savePtr);
+    char const* levelName = strtok_r(nullptr, " ", &savePtr);
+
+    if (tag == nullptr) {
+        MessageOutput.printLogLevels();
+        return;
+    }
+
+    uint8_t level;
+    if (levelName == nullptr || !MessageOutputClass::parseLogLevel(levelName, level)) {
+        MessageOutput.println("[Console] usage: loglevel [<tag> none|error|warn|info|debug|verbose]");
+        return;
+    }
+
+    if (!MessageOutput.setLogLevel(tag, level)) {
+        MessageOutput.printf("[Console] cannot set log level of '%s': too many tags\r\n", tag);
+        return;
+    }
+
+    MessageOutput.printf("[Console] log level of '%s' set to %s\r\n",
+            tag, MessageOutputClass::getLogLevelName(level));
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_ws_flow.h"
+#include "Logging.h"
+#include <algorithm>
+
+WebApiWsFlowControl::WebApiWsFlowControl(AsyncWebSocket& ws, bool resync)
+    : _ws(ws)
+    , _resync(resync)
+{
+}
+
+void WebApiWsFlowControl::onEvent(AsyncWebSocketClient* client, AwsEventType type)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    uint32_t id = client->id();
+    auto it = std::find_if(_clients.begin(), _clients.end(),
+            [id](Client const& c) { return c.Id == id; });
+
+    if (type == WS_EVT_CONNECT && it == _clients.end()) {
+        _clients.push_back({ id, millis(), 0, false });
+    } else if (type == WS_EVT_DISCONNECT && it != _clients.end()) {
+        _clients.erase(it);
+    }
+}
+
+void WebApiWsFlowControl::textAll(std::shared_ptr<std::vector<uint8_t>> const& message)
+{
+    std::vector<uint32_t> evictions;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint32_t now = millis();
+
+        for (auto it = _clients.begin(); it != _clients.end(); ) {
+            auto client = _ws.client(it->Id);
+            if (client == nullptr) {
+                it = _clients.erase(it);
+                continue;
+            }
+
+            if (client->queueLen() > 0 || it->AwaitingResync) {
+                ++it->Skipped;
+                if (now - it->LastDeliveryMillis > _maxLagMillis) {
+                    DTU_LOGW("Websocket", "[%s][%u] disconnecting, skipped %u messages",
+                            _ws.url(), it->Id, it->Skipped);
+                    evictions.push_back(it->Id);
+                    it = _clients.erase(it);
+                    continue;
+                }
+                ++it;
+                continue;
+            }
+
+            if (_resync && it->Skipped > 0) {
+                it->AwaitingResync = true;
+                _resyncIds.push_back(it->Id);
+                ++it;
+                continue;
+            }
+
+            client->text(message);
+            it->LastDeliveryMillis = now;
+            it->Skipped = 0;
+            ++it;
+        }
+    }
+
+    // closing raises the disconnect event, which locks the mutex
+    for (auto id : evictions) {
+        auto client = _ws.client(id);
+        if (client != nullptr) { client->close(); }
+    }
+}
+
+std::vector<uint32_t> WebApiWsFlowControl::takeResync()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t now = millis();
+
+    for (auto& c : _clients) {
+        if (!c.AwaitingResync) { continue; }
+        c.AwaitingResync = false;
+        c.Skipped = 0;
+        c.LastDeliveryMillis = now;
+    }
+
+    std::vector<uint32_t> ids;
+    ids.swap(_resyncIds);
+    return ids;
+}
@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_ws_hub.h"
+#include "Configuration.h"
+#include "Logging.h"
+#include "TaskMonitor.h"
+#include "Utils.h"
+#include "defaults.h"
+#include <ArduinoJson.h>
+#include <cstring>
+#include <string>
+
+namespace {
+
+constexpr char const* topicNames[] = { "livedata", "battery", "solarcharger", "huawei", "console" };
+static_assert(sizeof(topicNames) / sizeof(topicNames[0]) == static_cast<size_t>(WebApiWsHubClass::Topic::Count));
+
+constexpr uint8_t topicBit(WebApiWsHubClass::Topic topic)
+{
+    return 1 << static_cast<uint8_t>(topic);
+}
+
+}; // namespace
+
+WebApiWsHubClass::WebApiWsHubClass()
+    : _ws("/ws")
+    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("WebApiWsHub::wsCleanupTaskCb", std::bind(&WebApiWsHubClass::wsCleanupTaskCb, this)))
+{
+}
+
+void WebApiWsHubClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+    using std::placeholders::_4;
+    using std::placeholders::_5;
+    using std::placeholders::_6;
+
+    server.addHandler(&_ws);
+    _ws.onEvent(std::bind(&WebApiWsHubClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
+
+    scheduler.addTask(_wsCleanupTask);
+    _wsCleanupTask.enable();
+
+    _simpleDigestAuth.setUsername(AUTH_USERNAME);
+    _simpleDigestAuth.setRealm("hub websocket");
+
+    reload();
+}
+
+void WebApiWsHubClass::reload()
+{
+    _ws.removeMiddleware(&_sessionAuth);
+
+    auto const& config = Configuration.get();
+
+    if (config.Security.AllowReadonly) { return; }
+
+    _ws.enable(false);
+    _simpleDigestAuth.setPassword(config.Security.Password);
+    _ws.addMiddleware(&_sessionAuth);
+    _ws.closeAll();
+    _ws.enable(true);
+}
+
+void WebApiWsHubClass::wsCleanupTaskCb()
+{
+    // see: https://github.com/me-no-dev/ESPAsyncWebServer#limiting-the-number-of-web-socket-clients
+    _ws.cleanupClients();
+}
+
+bool WebApiWsHubClass::hasSubscribers(Topic topic) const
+{
+    return (_topics & topicBit(topic)) != 0;
+}
+
+void WebApiWsHubClass::publish(Topic topic, std::shared_ptr<std::vector<uint8_t>> const& json)
+{
+    if (!hasSubscribers(topic)) { return; }
+
+    auto message = wrap(topic, *json);
+    for (auto id : getSubscribers(topic)) {
+        auto client = _ws.client(id);
+        if (client != nullptr) { client->text(message); }
+    }
+}
+
+void WebApiWsHubClass::send(uint32_t clientId, Topic topic, std::shared_ptr<std::vector<uint8_t>> const& json)
+{
+    auto client = _ws.client(clientId);
+    if (client != nullptr) { client->text(wrap(topic, *json)); }
+}
+
+void WebApiWsHubClass::publishText(Topic topic, uint8_t const* text, size_t len)
+{
+    if (!hasSubscribers(topic)) { return; }
+
+    auto message = wrapText(topic, text, len);
+    if (!message) { return; }
+
+    for (auto id : getSubscribers(topic)) {
+        // slow clients miss this message rather than stalling the producer
+        auto client = _ws.client(id);
+        if (client != nullptr && client->canSend()) { client->text(message); }
+    }
+}
+
+void WebApiWsHubClass::sendText(uint32_t clientId, Topic topic, uint8_t const* text, size_t len)
+{
+    auto client = _ws.client(clientId);
+    if (client == nullptr) { return; }
+
+    auto message = wrapText(topic, text, len);
+    if (message) { client->text(message); }
+}
+
+void WebApiWsHubClass::onSubscribe(Topic topic, SubscribeHandler handler)
+{
+    _subscribeHandlers[static_cast<size_t>(topic)] = std::move(handler);
+}
+
+void WebApiWsHubClass::onMessage(Topic topic, MessageHandler handler)
+{
+    _messageHandlers[static_cast<size_t>(topic)] = std::move(handler);
+}
+
+void WebApiWsHubClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
+{
+    if (type == WS_EVT_CONNECT) {
+        DTU_LOGD("Websocket", "[%s][%u] connect", server->url(), client->id());
+    } else if (type == WS_EVT_DATA) {
+        auto info = static_cast<AwsFrameInfo*>(arg);
+        if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+            return;
+        }
+        handleMessage(client->id(), data, len);
+    } else if (type == WS_EVT_DISCONNECT) {
+        DTU_LOGD("Websocket", "[%s][%u] disconnect", server->url(), client->id());
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _subscriptions.erase(client->id());
+        updateTopics();
+    }
+}
+
+void WebApiWsHubClass::handleMessage(uint32_t clientId, uint8_t const* data, size_t len)
+{
+    // the web application regularly sends "ping", which is ignored
+    if (len > _maxMessageSize || len == 0 || data[0] != '{') { return; }
+
+    JsonDocument doc;
+    if (deserializeJson(doc, data, len) != DeserializationError::Ok) { return; }
+
+    Topic topic;
+    if (parseTopic(doc["topic"] | "", topic)) {
+        auto const& handler = _messageHandlers[static_cast<size_t>(topic)];
+        char const* text = doc["data"] | "";
+        if (handler) { handler(clientId, text); }
+        return;
+    }
+
+    uint8_t subscribed = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto& bits = _subscriptions[clientId];
+        uint8_t previous = bits;
+
+        for (JsonVariantConst name : doc["subscribe"].as<JsonArrayConst>()) {
+            if (parseTopic(name | "", topic)) { bits |= topicBit(topic); }
+        }
+
+        for (JsonVariantConst name : doc["unsubscribe"].as<JsonArrayConst>()) {
+            if (parseTopic(name | "", topic)) { bits &= ~topicBit(topic); }
+        }
+
+        subscribed = bits & ~previous;
+        if (bits == 0) { _subscriptions.erase(clientId); }
+        updateTopics();
+    }
+
+    for (uint8_t t = 0; t < static_cast<uint8_t>(Topic::Count); t++) {
+        auto const& handler = _subscribeHandlers[t];
+        if ((subscribed & (1 << t)) != 0 && handler) { handler(clientId); }
+    }
+}
+
+// must be called with _mutex held
+void WebApiWsHubClass::updateTopics()
+{
+    uint8_t topics = 0;
+    for (auto const& [id, bits] : _subscriptions) { topics |= bits; }
+    _topics = topics;
+}
+
+std::vector<uint32_t> WebApiWsHubClass::getSubscribers(Topic topic)
+{
+    std::vector<uint32_t> ids;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto const& [id, bits] : _subscriptions) {
+        if ((bits & topicBit(topic)) != 0) { ids.push_back(id); }
+    }
+
+    return ids;
+}
+
+char const* WebApiWsHubClass::getTopicName(Topic topic)
+{
+    return topicNames[static_cast<size_t>(topic)];
+}
+
+bool WebApiWsHubClass::parseTopic(char const* name, Topic& topic)
+{
+    for (uint8_t t = 0; t < static_cast<uint8_t>(Topic::Count); t++) {
+        if (strcmp(name, topicNames[t]) == 0) {
+            topic = static_cast<Topic>(t);
+            return true;
+        }
+    }
+    return false;
+}
+
+// nullptr if the text does not fit. not reported, as this is called with
+// the console output.
+std::shared_ptr<std::vector<uint8_t>> WebApiWsHubClass::wrapText(Topic topic, uint8_t const* text, size_t len)
+{
+    JsonDocument doc;
+    doc["topic"] = getTopicName(topic);
+    doc["data"] = std::string(reinterpret_cast<char const*>(text), len);
+
+    if (doc.overflowed()) { return nullptr; }
+
+    return Utils::serializeJsonShared(doc);
+}
+
+// the payload is embedded as is, it is serialized JSON already
+std::shared_ptr<std::vector<uint8_t>> WebApiWsHubClass::wrap(Topic topic, std::vector<uint8_t> const& json)
+{
+    static constexpr char prefix[] = "{\"topic\":\"";
+    static constexpr char infix[] = "\",\"data\":";
+    char const* name = getTopicName(topic);
+
+    auto message = std::make_shared<std::vector<uint8_t>>();
+    message->reserve(sizeof(prefix) + strlen(name) + sizeof(infix) + json.size());
+    message->insert(message->end(), prefix, prefix + sizeof(prefix) - 1);
+    message->insert(message->end(), name, name + strlen(name));
+    message->insert(message->end(), infix, infix + sizeof(infix) - 1);
+    message->insert(message->end(), json.begin(), json.end());
+    message->push_back('}');
+
+    return message;
+}
@@ -3,7 +3,12 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_ws_live.h"
+#include "JsonArena.h"
+#include "TaskMonitor.h"
 #include "Datastore.h"
+#include "EventBus.h"
+#include "InverterCommandEvents.h"
+#include "Logging.h"
 #include "MessageOutput.h"
 #include "Utils.h"
 #include "WebApi.h"
@@ -18,10 +23,23 @@
     #define PIN_MAPPING_REQUIRED 0
 #endif
 
+namespace {
+
+uint32_t getHuaweiGeneration()
+{
+#ifndef OPENDTU_WITHOUT_HUAWEI
+    return HuaweiCan.getDataGeneration();
+#else
+    return 0;
+#endif
+}
+
+}; // namespace
+
 WebApiWsLiveClass::WebApiWsLiveClass()
     : _ws("/livedata")
-    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsLiveClass::wsCleanupTaskCb, this))
-    , _sendDataTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsLiveClass::sendDataTaskCb, this))
+    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("WebApiWsLive::wsCleanupTaskCb", std::bind(&WebApiWsLiveClass::wsCleanupTaskCb, this)))
+    , _sendDataTask(1 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("WebApiWsLive::sendDataTaskCb", std::bind(&WebApiWsLiveClass::sendDataTaskCb, this)))
 {
 }
 
@@ -44,6 +62,25 @@ void WebApiWsLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     scheduler.addTask(_sendDataTask);
     _sendDataTask.enable();
+
+    Hoymiles.onCommandCompletion(std::bind(&WebApiWsLiveClass::onCommandCompletion, this, _1));
+
+    EventBus.subscribe<Events::InverterStatsUpdated>([this](Events::InverterStatsUpdated const&) {
+        _inverterStatsUpdated = true;
+    });
+    EventBus.subscribe<Events::BatterySnapshot>([this](Events::BatterySnapshot const&) {
+        _batteryUpdated = true;
+    });
+    EventBus.subscribe<Events::MeterSample>([this](Events::MeterSample const&) {
+        _powerMeterUpdated = true;
+    });
+
+    auto& hub = WebApi.getWsHub();
+    hub.onSubscribe(WebApiWsHubClass::Topic::LiveData, std::bind(&WebApiWsLiveClass::requestHubSnapshot, this, _1));
+    hub.onMessage(WebApiWsHubClass::Topic::LiveData, [this](uint32_t clientId, char const* text) {
+        if (strcmp(text, "resync") == 0) { requestHubSnapshot(clientId); }
+    });
+
     _simpleDigestAuth.setUsername(AUTH_USERNAME);
     _simpleDigestAuth.setRealm("live websocket");
 
@@ -52,7 +89,7 @@ void WebApiWsLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
 void WebApiWsLiveClass::reload()
 {
-    _ws.removeMiddleware(&_simpleDigestAuth);
+    _ws.removeMiddleware(&_sessionAuth);
 
     auto const& config = Configuration.get();
 
@@ -60,7 +97,7 @@ void WebApiWsLiveClass::reload()
 
     _ws.enable(false);
     _simpleDigestAuth.setPassword(config.Security.Password);
-    _ws.addMiddleware(&_simpleDigestAuth);
+    _ws.addMiddleware(&_sessionAuth);
     _ws.closeAll();
     _ws.enable(true);
 }
@@ -74,7 +111,6 @@ void WebApiWsLiveClass::wsCleanupTaskCb()
 void WebApiWsLiveClass::generateOnBatteryJsonResponse(JsonVariant& root, bool all)
 {
     auto const& config = Configuration.get();
-    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
 
     auto solarChargerAge = SolarCharger.getStats()->getAgeMillis();
     if (all || (solarChargerAge > 0 && (millis() - _lastPublishSolarCharger) > solarChargerAge)) {
@@ -110,8 +146,10 @@ void WebApiWsLiveClass::generateOnBatteryJsonResponse(JsonVariant& root, bool al
         if (!all) { _lastPublishSolarCharger = millis(); }
     }
 
-    if (all || (HuaweiCan.getDataPoints().getLastUpdate() - _lastPublishHuawei) < halfOfAllMillis ) {
+    auto huaweiGeneration = getHuaweiGeneration();
+    if (all || huaweiGeneration != _lastPublishHuawei) {
         auto huaweiObj = root["huawei"].to<JsonObject>();
+#ifndef OPENDTU_WITHOUT_HUAWEI
         huaweiObj["enabled"] = config.Huawei.Enabled;
 
         if (config.Huawei.Enabled) {
@@ -121,12 +159,17 @@ void WebApiWsLiveClass::generateOnBatteryJsonResponse(JsonVariant& root, bool al
                 addTotalField(huaweiObj, "Power", *oInputPower, "W", 2);
             }
         }
+#else
+        huaweiObj["enabled"] = false;
+#endif
 
-        if (!all) { _lastPublishHuawei = millis(); }
+        if (!all) { _lastPublishHuawei = huaweiGeneration; }
     }
 
-    auto spStats = Battery.getStats();
-    if (all || spStats->updateAvailable(_lastPublishBattery)) {
+    // the flags are left raised for the websocket if all sections are
+    // generated, e.g., for the REST API
+    if (all || _batteryUpdated.exchange(false)) {
+        auto spStats = Battery.getStats();
         auto batteryObj = root["battery"].to<JsonObject>();
         batteryObj["enabled"] = config.Battery.Enabled;
 
@@ -147,93 +190,205 @@ void WebApiWsLiveClass::generateOnBatteryJsonResponse(JsonVariant& root, bool al
                 addTotalField(batteryObj, "power", spStats->getVoltage() * spStats->getChargeCurrent(), "W", 1);
             }
         }
-
-        if (!all) { _lastPublishBattery = millis(); }
     }
 
-    if (all || (PowerMeter.getLastUpdate() - _lastPublishPowerMeter) < halfOfAllMillis) {
+    if (all || _powerMeterUpdated.exchange(false)) {
         auto powerMeterObj = root["power_meter"].to<JsonObject>();
         powerMeterObj["enabled"] = config.PowerMeter.Enabled;
 
         if (config.PowerMeter.Enabled) {
             addTotalField(powerMeterObj, "Power", PowerMeter.getPowerTotal(), "W", 1);
         }
-
-        if (!all) { _lastPublishPowerMeter = millis(); }
-    }
-}
-
-void WebApiWsLiveClass::sendOnBatteryStats()
-{
-    JsonDocument root;
-    JsonVariant var = root;
-
-    bool all = (millis() - _lastPublishOnBatteryFull) > 10 * 1000;
-    if (all) { _lastPublishOnBatteryFull = millis(); }
-    generateOnBatteryJsonResponse(var, all);
-
-    if (root.isNull()) { return; }
-
-    if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
-        String buffer;
-        serializeJson(root, buffer);
-
-        _ws.textAll(buffer);;
     }
 }
 
+// the websocket only transmits changes. a client first receives a snapshot
+// of the complete state ({"type":"full","seq":n,...}), afterwards only the
+// values which changed ({"type":"delta","seq":n+1,...}) following the rules
+// of a JSON merge patch, i.e., removed values are set to null. inverters are
+// keyed by their serial in both message types. a client which misses a
+// sequence number sends "resync" to receive a new snapshot.
 void WebApiWsLiveClass::sendDataTaskCb()
 {
+    auto& hub = WebApi.getWsHub();
+
     // do nothing if no WS client is connected
-    if (_ws.count() == 0) {
+    if (_ws.count() == 0 && !hub.hasSubscribers(WebApiWsHubClass::Topic::LiveData)) {
         return;
     }
 
-    sendOnBatteryStats();
+    std::vector<uint32_t> snapshotClients;
+    std::vector<uint32_t> hubSnapshotClients;
+    {
+        std::lock_guard<std::mutex> lock(_snapshotMutex);
+        snapshotClients.swap(_snapshotClients);
+        hubSnapshotClients.swap(_hubSnapshotClients);
+    }
 
-    // Loop all inverters
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
-        if (inv == nullptr) {
-            continue;
-        }
+    // a snapshot requires all sections to be up to date
+    bool snapshot = !snapshotClients.empty() || !hubSnapshotClients.empty();
 
-        const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
-        if (!((lastUpdateInternal > 0 && lastUpdateInternal > _lastPublishStats[i]) || (millis() - _lastPublishStats[i] > (10 * 1000)))) {
-            continue;
+    try {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_state.is<JsonObject>()) {
+            _state.to<JsonObject>();
         }
 
-        _lastPublishStats[i] = millis();
+        JsonArenaAllocator currentAllocator;
+        JsonDocument current(&currentAllocator);
+        JsonVariant var = current;
+
+        bool all = snapshot || (millis() - _lastPublishOnBatteryFull) > 10 * 1000;
+        if (all) { _lastPublishOnBatteryFull = millis(); }
+        generateOnBatteryJsonResponse(var, all);
+
+        bool inverterUpdated = false;
+        auto invObject = var["inverters"].to<JsonObject>();
+
+        _lastPublishStats.resize(Hoymiles.getNumInverters(), 0);
 
-        try {
-            std::lock_guard<std::mutex> lock(_mutex);
-            JsonDocument root;
-            JsonVariant var = root;
+        // the inverters are only visited if one of them published new
+        // statistics, and every 10 seconds to refresh them all.
+        bool statsUpdated = _inverterStatsUpdated.exchange(false);
+        bool statsRefresh = (millis() - _lastStatsRefresh) > (10 * 1000);
+        if (statsRefresh) { _lastStatsRefresh = millis(); }
 
-            auto invArray = var["inverters"].to<JsonArray>();
-            auto invObject = invArray.add<JsonObject>();
+        // Loop all inverters
+        for (uint8_t i = 0; (snapshot || statsUpdated || statsRefresh) && i < Hoymiles.getNumInverters(); i++) {
+            auto inv = Hoymiles.getInverterByPos(i);
+            if (inv == nullptr) {
+                continue;
+            }
+
+            const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
+            if (!snapshot && !statsRefresh && !(lastUpdateInternal > 0 && lastUpdateInternal > _lastPublishStats[i])) {
+                continue;
+            }
+
+            _lastPublishStats[i] = millis();
 
+            auto obj = invObject[inv->serialString()].to<JsonObject>();
+            addInverterJsonResponse(obj, inv);
+            inverterUpdated = true;
+        }
+
+        if (all || inverterUpdated) {
             generateCommonJsonResponse(var);
-            generateInverterCommonJsonResponse(invObject, inv);
-            generateInverterChannelJsonResponse(invObject, inv);
+        }
 
-            if (!Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
+        if (!Utils::checkJsonAlloc(current, __FUNCTION__, __LINE__)) {
+            // try again during the next round
+            std::lock_guard<std::mutex> snapshotLock(_snapshotMutex);
+            _snapshotClients.insert(_snapshotClients.end(), snapshotClients.begin(), snapshotClients.end());
+            _hubSnapshotClients.insert(_hubSnapshotClients.end(), hubSnapshotClients.begin(), hubSnapshotClients.end());
+            return;
+        }
+
+        // sections are replaced as a whole, hence values missing in a
+        // regenerated section were removed. sections which were not
+        // regenerated are left untouched.
+        JsonArenaAllocator deltaAllocator;
+        JsonDocument delta(&deltaAllocator);
+        auto deltaObj = delta.to<JsonObject>();
+        bool changed = false;
+
+        for (JsonPairConst section : current.as<JsonObjectConst>()) {
+            if (section.key() != "inverters") {
+                auto sectionDelta = deltaObj[section.key()].to<JsonObject>();
+                if (Utils::generateJsonMergePatch(_state[section.key()].as<JsonObjectConst>(), section.value().as<JsonObjectConst>(), sectionDelta)) {
+                    changed = true;
+                } else {
+                    deltaObj.remove(section.key());
+                }
                 continue;
             }
 
-            String buffer;
-            serializeJson(root, buffer);
+            auto invDelta = deltaObj["inverters"].to<JsonObject>();
+            for (JsonPairConst inv : section.value().as<JsonObjectConst>()) {
+                auto serialDelta = invDelta[inv.key()].to<JsonObject>();
+                if (Utils::generateJsonMergePatch(_state["inverters"][inv.key()].as<JsonObjectConst>(), inv.value().as<JsonObjectConst>(), serialDelta)) {
+                    changed = true;
+                } else {
+                    invDelta.remove(inv.key());
+                }
+            }
+        }
+
+        // inverters which were deleted
+        for (JsonPairConst inv : _state["inverters"].as<JsonObjectConst>()) {
+            if (Hoymiles.getInverterBySerial(strtoull(inv.key().c_str(), nullptr, 16)) == nullptr) {
+                deltaObj["inverters"][inv.key()] = nullptr;
+                changed = true;
+            }
+        }
+
+        if (deltaObj["inverters"].as<JsonObjectConst>().size() == 0) {
+            deltaObj.remove("inverters");
+        }
+
+        Utils::applyJsonMergePatch(_state.as<JsonObject>(), deltaObj);
 
-            _ws.textAll(buffer);
+        // send an empty delta from time to time as a keepalive
+        if (changed || (millis() - _lastPublish) > 10 * 1000) {
+            delta["type"] = "delta";
+            delta["seq"] = ++_sequence;
 
-        } catch (const std::bad_alloc& bad_alloc) {
-            MessageOutput.printf("Calling /api/livedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
-        } catch (const std::exception& exc) {
-            MessageOutput.printf("Unknown exception in /api/livedata/status. Reason: \"%s\".\r\n", exc.what());
+            if (Utils::checkJsonAlloc(delta, __FUNCTION__, __LINE__)) {
+                auto buffer = Utils::serializeJsonShared(delta);
+                _flow.textAll(buffer);
+                hub.publish(WebApiWsHubClass::Topic::LiveData, buffer);
+                _lastPublish = millis();
+            }
+        }
+
+        // clients which skipped deltas continue with the current state
+        auto resyncClients = _flow.takeResync();
+        snapshotClients.insert(snapshotClients.end(), resyncClients.begin(), resyncClients.end());
+
+        if (!snapshotClients.empty() || !hubSnapshotClients.empty()) {
+            sendSnapshot(snapshotClients, hubSnapshotClients);
         }
+
+    } catch (const std::bad_alloc& bad_alloc) {
+        MessageOutput.printf("Calling /api/livedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+    } catch (const std::exception& exc) {
+        MessageOutput.printf("Unknown exception in /api/livedata/status. Reason: \"%s\".\r\n", exc.what());
+    }
+}
+
+void WebApiWsLiveClass::sendSnapshot(std::vector<uint32_t> const& clientIds, std::vector<uint32_t> const& hubClientIds)
+{
+    JsonArenaAllocator rootAllocator;
+    JsonDocument root(&rootAllocator);
+    root["type"] = "full";
+    root["seq"] = _sequence;
+
+    for (JsonPairConst section : _state.as<JsonObjectConst>()) {
+        root[section.key()] = section.value();
+    }
+
+    if (!Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
+        return;
+    }
+
+    auto buffer = Utils::serializeJsonShared(root);
+
+    for (auto id : clientIds) {
+        auto client = _ws.client(id);
+        if (client != nullptr) { client->text(buffer); }
+    }
+
+    for (auto id : hubClientIds) {
+        WebApi.getWsHub().send(id, WebApiWsHubClass::Topic::LiveData, buffer);
     }
 }
 
+void WebApiWsLiveClass::requestHubSnapshot(uint32_t clientId)
+{
+    std::lock_guard<std::mutex> lock(_snapshotMutex);
+    _hubSnapshotClients.push_back(clientId);
+}
+
 void WebApiWsLiveClass::generateCommonJsonResponse(JsonVariant& root)
 {
     auto totalObj = root["total"].to<JsonObject>();
@@ -244,12 +399,70 @@ void WebApiWsLiveClass::generateCommonJsonResponse(JsonVariant& root)
     JsonObject hintObj = root["hints"].to<JsonObject>();
     struct tm timeinfo;
     hintObj["time_sync"] = !getLocalTime(&timeinfo, 5);
-    hintObj["radio_problem"] = (Hoymiles.getRadioNrf()->isInitialized() && (!Hoymiles.getRadioNrf()->isConnected() || !Hoymiles.getRadioNrf()->isPVariant())) || (Hoymiles.getRadioCmt()->isInitialized() && (!Hoymiles.getRadioCmt()->isConnected()));
+    bool radioProblem = false;
+    Hoymiles.withRadios([&radioProblem]() {
+        radioProblem = Hoymiles.getRadioCmt()->isInitialized() && !Hoymiles.getRadioCmt()->isConnected();
+        for (uint8_t i = 0; i < Hoymiles.getNumRadiosNrf(); i++) {
+            auto radio = Hoymiles.getRadioNrf(i);
+            radioProblem |= radio->isInitialized() && (!radio->isConnected() || !radio->isPVariant());
+        }
+    });
+    hintObj["radio_problem"] = radioProblem;
     hintObj["default_password"] = strcmp(Configuration.get().Security.Password, ACCESS_POINT_PASSWORD) == 0;
 
     hintObj["pin_mapping_issue"] = PIN_MAPPING_REQUIRED && !PinMapping.isMappingSelected();
 }
 
+WebApiWsLiveClass::inverter_cache_key_t WebApiWsLiveClass::getInverterCacheKey(InverterAbstract& inv)
+{
+    // every poll sends a request, also if the inverter does not answer,
+    // which changes the radio statistics.
+    return { inv.Statistics()->getLastUpdate(), inv.SystemConfigPara()->getLastUpdate(),
+        inv.DevInfo()->getLastUpdate(), inv.EventLog()->getLastUpdate(),
+        inv.RadioStats.TxRequestData, inv.getEnablePolling() };
+}
+
+void WebApiWsLiveClass::addInverterJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv)
+{
+    // forget about inverters which were deleted
+    if (_inverterCache.size() > Hoymiles.getNumInverters()) {
+        for (auto it = _inverterCache.begin(); it != _inverterCache.end(); ) {
+            if (Hoymiles.getInverterBySerial(it->first) == nullptr) {
+                it = _inverterCache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    auto& cache = _inverterCache[inv->serial()];
+    auto key = getInverterCacheKey(*inv);
+
+    // the max age covers changes of the settings, e.g., the name
+    if (cache.Key != key || cache.Doc.isNull() || millis() - cache.Millis > _inverterCacheMaxAge) {
+        cache.Doc.clear();
+        auto obj = cache.Doc.to<JsonObject>();
+        generateInverterCommonJsonResponse(obj, inv);
+        generateInverterChannelJsonResponse(obj, inv);
+
+        if (cache.Doc.overflowed()) {
+            cache.Doc.clear();
+            generateInverterCommonJsonResponse(root, inv);
+            generateInverterChannelJsonResponse(root, inv);
+            return;
+        }
+
+        cache.Key = key;
+        cache.Millis = millis();
+    }
+
+    root.set(cache.Doc.as<JsonObjectConst>());
+
+    if (root["data_age_ms"].isNull()) { return; }
+    root["data_age_ms"] = millis() - inv->Statistics()->getLastUpdate();
+    root["reachable"] = inv->isReachable();
+}
+
 void WebApiWsLiveClass::generateInverterCommonJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv)
 {
     const INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
@@ -276,7 +489,31 @@ void WebApiWsLiveClass::generateInverterCommonJsonResponse(JsonObject& root, std
     root["radio_stats"]["rx_fail_nothing"] = inv->RadioStats.RxFailNoAnswer;
     root["radio_stats"]["rx_fail_partial"] = inv->RadioStats.RxFailPartialAnswer;
     root["radio_stats"]["rx_fail_corrupt"] = inv->RadioStats.RxFailCorruptData;
+    root["radio_stats"]["rx_dropped"] = inv->RadioStats.RxDroppedFragments;
     root["radio_stats"]["rssi"] = inv->getLastRssi();
+
+    JsonArray rxChannels = root["radio_stats"]["rx_channels"].to<JsonArray>();
+    for (uint8_t i = 0; i < inv->RadioStats.RxChannelCount; i++) {
+        JsonObject rxChannel = rxChannels.add<JsonObject>();
+        rxChannel["channel"] = inv->RadioStats.RxChannels[i].Channel;
+        rxChannel["fragments"] = inv->RadioStats.RxChannels[i].Fragments;
+    }
+
+    JsonObject histograms = root["radio_stats"]["histograms"].to<JsonObject>();
+    for (uint8_t h = 0; h < HISTOGRAM_CNT; h++) {
+        auto histogram = static_cast<RadioHistogram_t>(h);
+        JsonObject obj = histograms[InverterAbstract::getRadioHistogramName(histogram)].to<JsonObject>();
+
+        JsonArray bounds = obj["bounds"].to<JsonArray>();
+        for (auto bound : InverterAbstract::getRadioHistogramBounds(histogram)) {
+            bounds.add(bound);
+        }
+
+        JsonArray buckets = obj["buckets"].to<JsonArray>();
+        for (auto count : inv->RadioStats.Histograms[h].Buckets) {
+            buckets.add(count);
+        }
+    }
 }
 
 void WebApiWsLiveClass::generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv)
@@ -318,7 +555,31 @@ void WebApiWsLiveClass::generateInverterChannelJsonResponse(JsonObject& root, st
     }
 
     if (inv->Statistics()->hasChannelFieldValue(TYPE_INV, CH0, FLD_EVT_LOG)) {
-        root["events"] = inv->EventLog()->getEntryCount();
+        auto eventLog = inv->EventLog();
+        uint8_t eventCount = eventLog->getEntryCount();
+        root["events"] = eventCount;
+        root["event_sequence"] = eventLog->getSequence();
+
+        // push the most recently added or changed event, such that clients
+        // learn about new alarms without polling the event log.
+        uint8_t latest = eventCount;
+        for (uint8_t i = 0; i < eventCount; i++) {
+            if (latest == eventCount || eventLog->getEntrySequence(i) > eventLog->getEntrySequence(latest)) {
+                latest = i;
+            }
+        }
+        if (latest < eventCount) {
+            AlarmLogEntry_t entry;
+            eventLog->getLogEntry(latest, entry);
+
+            auto lastEvent = root["last_event"].to<JsonObject>();
+            lastEvent["index"] = latest;
+            lastEvent["sequence"] = eventLog->getEntrySequence(latest);
+            lastEvent["message_id"] = entry.MessageId;
+            lastEvent["message"] = entry.Message;
+            lastEvent["start_time"] = entry.StartTime;
+            lastEvent["end_time"] = entry.EndTime;
+        }
     } else {
         root["events"] = -1;
     }
@@ -350,11 +611,99 @@ void WebApiWsLiveClass::addTotalField(JsonObject& root, const String& name, cons
 
 void WebApiWsLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
+    _flow.onEvent(client, type);
+
     if (type == WS_EVT_CONNECT) {
-        MessageOutput.printf("Websocket: [%s][%u] connect\r\n", server->url(), client->id());
+        DTU_LOGD("Websocket", "[%s][%u] connect", server->url(), client->id());
+
+        std::lock_guard<std::mutex> lock(_snapshotMutex);
+        _snapshotClients.push_back(client->id());
+    } else if (type == WS_EVT_DATA) {
+        auto info = static_cast<AwsFrameInfo*>(arg);
+        if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+            return;
+        }
+
+        if (len == 6 && memcmp(data, "resync", len) == 0) {
+            std::lock_guard<std::mutex> lock(_snapshotMutex);
+            _snapshotClients.push_back(client->id());
+        }
     } else if (type == WS_EVT_DISCONNECT) {
-        MessageOutput.printf("Websocket: [%s][%u] disconnect\r\n", server->url(), client->id());
+        DTU_LOGD("Websocket", "[%s][%u] disconnect", server->url(), client->id());
+    }
+}
+
+void WebApiWsLiveClass::onCommandCompletion(CommandCompletion const& completion)
+{
+    auto& hub = WebApi.getWsHub();
+    if (_ws.count() == 0 && !hub.hasSubscribers(WebApiWsHubClass::Topic::LiveData)) { return; }
+
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    root["type"] = "command";
+    InverterCommandEvents.serialize(completion, root);
+
+    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) { return; }
+
+    auto buffer = Utils::serializeJsonShared(doc);
+    _flow.textAll(buffer);
+    hub.publish(WebApiWsHubClass::Topic::LiveData, buffer);
+}
+
+bool WebApiWsLiveClass::isStatusCacheValid() const
+{
+    auto const& cache = _statusCache;
+    if (cache.Data == nullptr || millis() - cache.Millis > _statusCacheMaxAge) {
+        return false;
+    }
+
+    // true if the timestamp was taken after the cache was generated
+    auto isNewer = [&cache](uint32_t timestamp) {
+        return timestamp - cache.Millis < std::numeric_limits<uint32_t>::max() / 2;
+    };
+
+    if (cache.NumInverters != Hoymiles.getNumInverters()) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) {
+            continue;
+        }
+
+        if (isNewer(inv->Statistics()->getLastUpdate())
+            || isNewer(inv->SystemConfigPara()->getLastUpdate())
+            || isNewer(inv->DevInfo()->getLastUpdate())) {
+            return false;
+        }
+    }
+
+    auto solarChargerAge = SolarCharger.getStats()->getAgeMillis();
+    if (solarChargerAge > 0 && isNewer(millis() - solarChargerAge)) {
+        return false;
+    }
+
+    return cache.HuaweiGeneration == getHuaweiGeneration()
+        && !Battery.getStats()->updateAvailable(cache.Millis)
+        && !isNewer(PowerMeter.getLastUpdate());
+}
+
+void WebApiWsLiveClass::sendStatus(AsyncWebServerRequest* request, std::shared_ptr<std::vector<uint8_t>> const& data)
+{
+    if (data->size() < WebApi.GzipMinSize || !WebApi.acceptsGzip(request)) {
+        return WebApi.sendBuffer(request, "application/json", data, false);
+    }
+
+    // the compressed buffer is cached along with the plain one, such that
+    // polling clients do not compress the same response over and over.
+    if (_statusCache.Data != data || !_statusCache.Gzip) {
+        auto gzipped = WebApi.gzip(*data);
+        if (_statusCache.Data == data) { _statusCache.Gzip = gzipped; }
+        return WebApi.sendBuffer(request, "application/json", gzipped, true);
     }
+
+    WebApi.sendBuffer(request, "application/json", _statusCache.Gzip, true);
 }
 
 void WebApiWsLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
@@ -365,36 +714,13 @@ void WebApiWsLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
 
     try {
         std::lock_guard<std::mutex> lock(_mutex);
-        AsyncJsonResponse* response = new AsyncJsonResponse();
-        auto& root = response->getRoot();
-        auto invArray = root["inverters"].to<JsonArray>();
-        auto serial = WebApi.parseSerialFromRequest(request);
-
-        if (serial > 0) {
-            auto inv = Hoymiles.getInverterBySerial(serial);
-            if (inv != nullptr) {
-                JsonObject invObject = invArray.add<JsonObject>();
-                generateInverterCommonJsonResponse(invObject, inv);
-                generateInverterChannelJsonResponse(invObject, inv);
-            }
-        } else {
-            // Loop all inverters
-            for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-                auto inv = Hoymiles.getInverterByPos(i);
-                if (inv == nullptr) {
-                    continue;
-                }
-
-                JsonObject invObject = invArray.add<JsonObject>();
-                generateInverterCommonJsonResponse(invObject, inv);
-            }
+        auto data = generateStatus(WebApi.parseSerialFromRequest(request));
+        if (!data) {
+            WebApi.sendTooManyRequests(request);
+            return;
         }
 
-        generateCommonJsonResponse(root);
-
-        generateOnBatteryJsonResponse(root, true);
-
-        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        sendStatus(request, data);
 
     } catch (const std::bad_alloc& bad_alloc) {
         MessageOutput.printf("Calling /api/livedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
@@ -404,3 +730,58 @@ void WebApiWsLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
         WebApi.sendTooManyRequests(request);
     }
 }
+
+std::shared_ptr<std::vector<uint8_t>> WebApiWsLiveClass::getStatus()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return generateStatus(0);
+}
+
+std::shared_ptr<std::vector<uint8_t>> WebApiWsLiveClass::generateStatus(uint64_t serial)
+{
+    if (serial == 0 && isStatusCacheValid()) { return _statusCache.Data; }
+
+    JsonArenaAllocator rootAllocator;
+    JsonDocument doc(&rootAllocator);
+    JsonVariant root = doc.to<JsonVariant>();
+    auto invArray = root["inverters"].to<JsonArray>();
+
+    // taken before the values are read, such that values updated while
+    // generating the response invalidate the cache
+    uint32_t generated = millis();
+
+    if (serial > 0) {
+        auto inv = Hoymiles.getInverterBySerial(serial);
+        if (inv != nullptr) {
+            JsonObject invObject = invArray.add<JsonObject>();
+            addInverterJsonResponse(invObject, inv);
+        }
+    } else {
+        // Loop all inverters
+        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+            auto inv = Hoymiles.getInverterByPos(i);
+            if (inv == nullptr) {
+                continue;
+            }
+
+            JsonObject invObject = invArray.add<JsonObject>();
+            generateInverterCommonJsonResponse(invObject, inv);
+        }
+    }
+
+    generateCommonJsonResponse(root);
+
+    generateOnBatteryJsonResponse(root, true);
+
+    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+        return nullptr;
+    }
+
+    auto data = Utils::serializeJsonShared(doc);
+
+    if (serial == 0) {
+        _statusCache = { data, nullptr, generated, Hoymiles.getNumInverters(), getHuaweiGeneration() };
+    }
+
+    return data;
+}
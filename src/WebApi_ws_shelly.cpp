@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "WebApi_ws_shelly.h"
+#include "Logging.h"
+#include "TaskMonitor.h"
+
+WebApiWsShellyClass::WebApiWsShellyClass()
+    : _ws("/shelly")
+{
+}
+
+void WebApiWsShellyClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+    using std::placeholders::_4;
+    using std::placeholders::_5;
+    using std::placeholders::_6;
+
+    server.addHandler(&_ws);
+    _ws.onEvent(std::bind(&WebApiWsShellyClass::onWebsocketEvent, this, _1, _2, _3, _4, _5, _6));
+
+    scheduler.addTask(_wsCleanupTask);
+    _wsCleanupTask.setCallback(TaskMonitor.wrap("WebApiWsShelly::wsCleanupTaskCb", std::bind(&WebApiWsShellyClass::wsCleanupTaskCb, this)));
+    _wsCleanupTask.setIterations(TASK_FOREVER);
+    _wsCleanupTask.setInterval(1 * TASK_SECOND);
+    _wsCleanupTask.enable();
+}
+
+void WebApiWsShellyClass::wsCleanupTaskCb()
+{
+    _ws.cleanupClients();
+}
+
+// the websocket is not used while holding _mutex, as it takes its own
+// locks, also while calling onWebsocketEvent().
+void WebApiWsShellyClass::setHandler(Handler handler)
+{
+    uint32_t clientId = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _handler = std::move(handler);
+        if (_handler) { return; }
+
+        std::swap(clientId, _clientId);
+    }
+
+    if (clientId != 0) { _ws.close(clientId); }
+}
+
+bool WebApiWsShellyClass::send(String const& text)
+{
+    uint32_t clientId = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        clientId = _clientId;
+    }
+    if (clientId == 0) { return false; }
+
+    auto client = _ws.client(clientId);
+    if (client == nullptr || !client->canSend()) { return false; }
+
+    client->text(text);
+    return true;
+}
+
+void WebApiWsShellyClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (type == WS_EVT_CONNECT) {
+        if (!_handler) {
+            lock.unlock();
+            client->close();
+            return;
+        }
+
+        DTU_LOGI("Shelly", "connected from %s", client->remoteIP().toString().c_str());
+
+        uint32_t previous = _clientId;
+        _clientId = client->id();
+        lock.unlock();
+
+        if (previous != 0 && previous != client->id()) { _ws.close(previous); }
+    } else if (type == WS_EVT_DATA) {
+        auto info = static_cast<AwsFrameInfo*>(arg);
+        if (client->id() != _clientId || !_handler || info->message_opcode != WS_TEXT) { return; }
+
+        bool first = info->num == 0 && info->index == 0;
+        bool last = info->final && info->index + len == info->len;
+        _handler(data, len, first, last);
+    } else if (type == WS_EVT_DISCONNECT) {
+        if (client->id() != _clientId) { return; }
+        DTU_LOGI("Shelly", "disconnected");
+        _clientId = 0;
+    }
+}
@@ -3,12 +3,16 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_ws_solarcharger_live.h"
+#include "JsonArena.h"
+#include <TaskMonitor.h>
 #include "AsyncJson.h"
 #include "Configuration.h"
+#include "Logging.h"
 #include "MessageOutput.h"
 #include "Utils.h"
 #include "WebApi.h"
 #include "defaults.h"
+#include "EventBus.h"
 #include "PowerLimiter.h"
 #include <solarcharger/Controller.h>
 
@@ -34,17 +38,22 @@ void WebApiWsSolarChargerLiveClass::init(AsyncWebServer& server, Scheduler& sche
 
 
     scheduler.addTask(_wsCleanupTask);
-    _wsCleanupTask.setCallback(std::bind(&WebApiWsSolarChargerLiveClass::wsCleanupTaskCb, this));
+    _wsCleanupTask.setCallback(TaskMonitor.wrap("WebApiWsSolarChargerLive::wsCleanupTaskCb", std::bind(&WebApiWsSolarChargerLiveClass::wsCleanupTaskCb, this)));
     _wsCleanupTask.setIterations(TASK_FOREVER);
     _wsCleanupTask.setInterval(1 * TASK_SECOND);
     _wsCleanupTask.enable();
 
     scheduler.addTask(_sendDataTask);
-    _sendDataTask.setCallback(std::bind(&WebApiWsSolarChargerLiveClass::sendDataTaskCb, this));
+    _sendDataTask.setCallback(TaskMonitor.wrap("WebApiWsSolarChargerLive::sendDataTaskCb", std::bind(&WebApiWsSolarChargerLiveClass::sendDataTaskCb, this)));
     _sendDataTask.setIterations(TASK_FOREVER);
     _sendDataTask.setInterval(500 * TASK_MILLISECOND);
     _sendDataTask.enable();
 
+    // the DPL's state and limit are part of the solar charger's live data
+    EventBus.subscribe<Events::DplDecision>([this](Events::DplDecision const&) {
+        _dplDecided = true;
+    });
+
     _simpleDigestAuth.setUsername(AUTH_USERNAME);
     _simpleDigestAuth.setRealm("solarcharger websocket");
 
@@ -53,7 +62,7 @@ void WebApiWsSolarChargerLiveClass::init(AsyncWebServer& server, Scheduler& sche
 
 void WebApiWsSolarChargerLiveClass::reload()
 {
-    _ws.removeMiddleware(&_simpleDigestAuth);
+    _ws.removeMiddleware(&_sessionAuth);
 
     auto const& config = Configuration.get();
 
@@ -61,7 +70,7 @@ void WebApiWsSolarChargerLiveClass::reload()
 
     _ws.enable(false);
     _simpleDigestAuth.setPassword(config.Security.Password);
-    _ws.addMiddleware(&_simpleDigestAuth);
+    _ws.addMiddleware(&_sessionAuth);
     _ws.closeAll();
     _ws.enable(true);
 }
@@ -75,27 +84,29 @@ void WebApiWsSolarChargerLiveClass::wsCleanupTaskCb()
 void WebApiWsSolarChargerLiveClass::sendDataTaskCb()
 {
     // do nothing if no WS client is connected
-    if (_ws.count() == 0) { return; }
+    auto& hub = WebApi.getWsHub();
+    if (_ws.count() == 0 && !hub.hasSubscribers(WebApiWsHubClass::Topic::SolarCharger)) { return; }
 
     // Update on ve.direct change or at least after 10 seconds
     bool fullUpdate = (millis() - _lastFullPublish > (10 * 1000));
 
     auto publishAgeMillis = millis() - _lastPublish;
     bool updateAvailable = SolarCharger.getStats()->getAgeMillis() < publishAgeMillis;
+    updateAvailable = _dplDecided.exchange(false) || updateAvailable;
 
     if (fullUpdate || updateAvailable) {
         try {
             std::lock_guard<std::mutex> lock(_mutex);
-            JsonDocument root;
+            JsonArenaAllocator rootAllocator;
+            JsonDocument root(&rootAllocator);
             JsonVariant var = root;
 
             generateCommonJsonResponse(var, fullUpdate);
 
             if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
-                String buffer;
-                serializeJson(root, buffer);
-
-                _ws.textAll(buffer);;
+                auto buffer = Utils::serializeJsonShared(root);
+                _flow.textAll(buffer);
+                hub.publish(WebApiWsHubClass::Topic::SolarCharger, buffer);
             }
         } catch (std::bad_alloc& bad_alloc) {
             MessageOutput.printf("Calling /api/solarchargerlivedata/status has temporarily run out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
@@ -117,16 +128,12 @@ void WebApiWsSolarChargerLiveClass::generateCommonJsonResponse(JsonVariant& root
 
 void WebApiWsSolarChargerLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
+    _flow.onEvent(client, type);
+
     if (type == WS_EVT_CONNECT) {
-        char str[64];
-        snprintf(str, sizeof(str), "Websocket: [%s][%u] connect", server->url(), client->id());
-        Serial.println(str);
-        MessageOutput.println(str);
+        DTU_LOGD("Websocket", "[%s][%u] connect", server->url(), client->id());
     } else if (type == WS_EVT_DISCONNECT) {
-        char str[64];
-        snprintf(str, sizeof(str), "Websocket: [%s][%u] disconnect", server->url(), client->id());
-        Serial.println(str);
-        MessageOutput.println(str);
+        DTU_LOGD("Websocket", "[%s][%u] disconnect", server->url(), client->id());
     }
 }
 
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "YieldCheckpoint.h"
+#include "FsWriteMonitor.h"
+#include "MessageOutput.h"
+#include "TaskMonitor.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <cstddef>
+#include <ctime>
+
+#define YIELDCHECKPOINT_FILENAME "/yield.ckp"
+
+YieldCheckpointClass YieldCheckpoint;
+
+YieldCheckpointClass::YieldCheckpointClass()
+    : _loopTask(10 * TASK_SECOND, TASK_FOREVER, TaskMonitor.wrap("YieldCheckpoint::loop", std::bind(&YieldCheckpointClass::loop, this)))
+{
+}
+
+void YieldCheckpointClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void YieldCheckpointClass::loop()
+{
+    // checkpoints are only valid on the day they were written
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) { return; }
+
+    uint32_t day = (timeinfo.tm_year + 1900) * 1000 + timeinfo.tm_yday;
+
+    if (!_restored) {
+        restore(day);
+        _restored = true;
+        return;
+    }
+
+    write(day);
+}
+
+void YieldCheckpointClass::restore(uint32_t day)
+{
+    if (!LittleFS.exists(YIELDCHECKPOINT_FILENAME)) { return; }
+
+    File f = LittleFS.open(YIELDCHECKPOINT_FILENAME, "r", false);
+    if (!f) { return; }
+
+    // find the valid slot with the highest sequence number
+    Slot slot;
+    Slot latest = {};
+    for (size_t i = 0; i < _slotCount; ++i) {
+        if (f.read(reinterpret_cast<uint8_t*>(&slot), sizeof(slot)) != sizeof(slot)) { break; }
+        if (slot.Magic != _magic || slot.Sequence == 0 || slot.Crc != getCrc(slot)) { continue; }
+        if (slot.Sequence <= latest.Sequence) { continue; }
+        latest = slot;
+        _nextSlot = (i + 1) % _slotCount;
+    }
+    f.close();
+
+    _sequence = latest.Sequence;
+
+    if (latest.Sequence == 0 || latest.Day != day) { return; }
+
+    uint8_t count = 0;
+    for (uint32_t i = 0; i < latest.Count && i < INV_MAX_COUNT; ++i) {
+        auto const& entry = latest.Entries[i];
+        auto inv = Hoymiles.getInverterBySerial(entry.Serial);
+        if (inv == nullptr || !inv->Statistics()->getYieldDayCorrection()) { continue; }
+
+        inv->Statistics()->setYieldDayCorrectionState(entry.State);
+        count++;
+    }
+
+    _lastCrc = getCrc(latest);
+    _lastOffsetsCrc = getOffsetsCrc(latest);
+    _lastWriteMillis = millis();
+
+    MessageOutput.printf("[YieldCheckpoint] restored yield day correction of %u inverters\r\n", count);
+}
+
+void YieldCheckpointClass::write(uint32_t day)
+{
+    Slot slot = {};
+    slot.Magic = _magic;
+    slot.Day = day;
+    collect(slot);
+
+    // the sequence number is not part of the content
+    uint32_t crc = getCrc(slot);
+    if (crc == _lastCrc) { return; }
+
+    // a detected yield reset is written right away, as opposed to the yield
+    // increasing in the course of the day.
+    uint32_t offsetsCrc = getOffsetsCrc(slot);
+    if (offsetsCrc == _lastOffsetsCrc && millis() - _lastWriteMillis < _intervalMs) { return; }
+
+    if (!FsWriteMonitor.admit(FsWriteMonitorClass::Category::YieldCheckpoint, sizeof(slot))) { return; }
+
+    if (!LittleFS.exists(YIELDCHECKPOINT_FILENAME) && !createFile()) { return; }
+
+    File f = LittleFS.open(YIELDCHECKPOINT_FILENAME, "r+");
+    if (!f) {
+        MessageOutput.printf("[YieldCheckpoint] cannot open %s\r\n", YIELDCHECKPOINT_FILENAME);
+        return;
+    }
+
+    slot.Sequence = ++_sequence;
+    slot.Crc = getCrc(slot);
+
+    f.seek(_nextSlot * sizeof(Slot));
+    bool success = f.write(reinterpret_cast<uint8_t const*>(&slot), sizeof(slot)) == sizeof(slot);
+    f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::YieldCheckpoint, sizeof(slot));
+
+    if (!success) {
+        MessageOutput.printf("[YieldCheckpoint] cannot write %s\r\n", YIELDCHECKPOINT_FILENAME);
+        return;
+    }
+
+    _nextSlot = (_nextSlot + 1) % _slotCount;
+    _lastCrc = crc;
+    _lastOffsetsCrc = offsetsCrc;
+    _lastWriteMillis = millis();
+}
+
+void YieldCheckpointClass::collect(Slot& slot)
+{
+    slot.Count = 0;
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters() && slot.Count < INV_MAX_COUNT; i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr || !inv->Statistics()->getYieldDayCorrection()) { continue; }
+
+        auto& entry = slot.Entries[slot.Count++];
+        entry.Serial = inv->serial();
+        entry.State = inv->Statistics()->getYieldDayCorrectionState();
+    }
+}
+
+// covers the day and the entries, but not the sequence number
+uint32_t YieldCheckpointClass::getCrc(Slot const& slot)
+{
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(&slot.Day), sizeof(slot.Day));
+    crc = esp_rom_crc32_le(crc, reinterpret_cast<uint8_t const*>(&slot.Count), sizeof(slot.Count));
+    return esp_rom_crc32_le(crc, reinterpret_cast<uint8_t const*>(slot.Entries), sizeof(slot.Entries));
+}
+
+uint32_t YieldCheckpointClass::getOffsetsCrc(Slot const& slot)
+{
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<uint8_t const*>(&slot.Day), sizeof(slot.Day));
+    for (uint32_t i = 0; i < slot.Count; ++i) {
+        auto const& entry = slot.Entries[i];
+        crc = esp_rom_crc32_le(crc, reinterpret_cast<uint8_t const*>(&entry.Serial), sizeof(entry.Serial));
+        crc = esp_rom_crc32_le(crc, reinterpret_cast<uint8_t const*>(entry.State.Offset), sizeof(entry.State.Offset));
+    }
+    return crc;
+}
+
+bool YieldCheckpointClass::createFile()
+{
+    File f = LittleFS.open(YIELDCHECKPOINT_FILENAME, "w", true);
+    if (!f) {
+        MessageOutput.printf("[YieldCheckpoint] cannot create %s\r\n", YIELDCHECKPOINT_FILENAME);
+        return false;
+    }
+
+    Slot empty = {};
+    for (size_t i = 0; i < _slotCount; ++i) {
+        f.write(reinterpret_cast<uint8_t const*>(&empty), sizeof(empty));
+    }
+    f.close();
+
+    FsWriteMonitor.record(FsWriteMonitorClass::Category::YieldCheckpoint, _slotCount * sizeof(empty));
+
+    return true;
+}
@@ -2,17 +2,22 @@
 /*
  * Copyright (C) 2023 Malte Schmidt and others
  */
+#ifndef OPENDTU_WITHOUT_HUAWEI
 #include "Battery.h"
+#include "TaskMonitor.h"
 #include <gridcharger/huawei/Controller.h>
 #include <gridcharger/huawei/MCP2515.h>
 #include <gridcharger/huawei/TWAI.h>
 #include "MessageOutput.h"
+#include "MetricsRegistry.h"
 #include "PowerMeter.h"
 #include "PowerLimiter.h"
+#include "PowerArbiter.h"
 #include "Configuration.h"
 
 #include <functional>
 #include <algorithm>
+#include <cmath>
 
 GridCharger::Huawei::Controller HuaweiCan;
 
@@ -28,11 +33,44 @@ void Controller::init(Scheduler& scheduler)
     MessageOutput.print("Initialize Huawei AC charger interface...\r\n");
 
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&Controller::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("Huawei::loop", std::bind(&Controller::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
+    uint32_t constexpr stackSize = 3072;
+    if (pdPASS != xTaskCreate(Controller::controlLoopHelper, "HuaweiCtrl",
+                stackSize, this, 2/*prio*/, &_controlTaskHandle)) {
+        MessageOutput.print("[Huawei::Controller] Failed to start control task\r\n");
+        _controlTaskHandle = nullptr;
+    }
+
     updateSettings();
+
+    registerMetrics();
+}
+
+void Controller::registerMetrics()
+{
+    using Type = MetricsRegistryClass::Type;
+
+    auto add = [this](char const* name, char const* help, auto getter) {
+        MetricsRegistry.add(name, help, Type::Gauge, [this, getter]() -> std::optional<float> {
+            if (!Configuration.get().Huawei.Enabled) { return std::nullopt; }
+            return getter(getDataPoints());
+        });
+    };
+
+    add("opendtu_huawei_input_power", "Grid charger input power in W", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::InputPower>(); });
+    add("opendtu_huawei_input_voltage", "Grid charger input voltage in V", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::InputVoltage>(); });
+    add("opendtu_huawei_input_current", "Grid charger input current in A", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::InputCurrent>(); });
+    add("opendtu_huawei_input_frequency", "Grid charger input frequency in Hz", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::InputFrequency>(); });
+    add("opendtu_huawei_output_power", "Grid charger output power in W", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::OutputPower>(); });
+    add("opendtu_huawei_output_voltage", "Grid charger output voltage in V", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::OutputVoltage>(); });
+    add("opendtu_huawei_output_current", "Grid charger output current in A", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::OutputCurrent>(); });
+    add("opendtu_huawei_output_current_max", "Grid charger maximum output current in A", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::OutputCurrentMax>(); });
+    add("opendtu_huawei_efficiency", "Grid charger efficiency", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::Efficiency>(); });
+    add("opendtu_huawei_input_temperature", "Grid charger input temperature in °C", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::InputTemperature>(); });
+    add("opendtu_huawei_output_temperature", "Grid charger output temperature in °C", [](DataPointContainer const& dp) { return dp.get<DataPointLabel::OutputTemperature>(); });
 }
 
 void Controller::enableOutput()
@@ -88,6 +126,10 @@ void Controller::updateSettings()
         _mode = HUAWEI_MODE_AUTO_INT;
     }
 
+    resetAutoPowerControl();
+    _oLastSetpoint = std::nullopt;
+    _upHardwareInterface->setDataConsumer(_controlTaskHandle);
+
     MessageOutput.print("[Huawei::Controller] Hardware Interface initialized successfully\r\n");
 }
 
@@ -99,16 +141,10 @@ void Controller::loop()
 
     auto const& config = Configuration.get();
 
-    bool verboseLogging = config.Huawei.VerboseLogging;
-
-    auto upNewData = _upHardwareInterface->getCurrentData();
-    if (upNewData) {
-        _dataPoints.updateFrom(*upNewData);
-    }
+    _inverterProducing = PowerLimiter.isGovernedBatteryPoweredInverterProducing();
 
     auto oOutputCurrent = _dataPoints.get<DataPointLabel::OutputCurrent>();
     auto oOutputVoltage = _dataPoints.get<DataPointLabel::OutputVoltage>();
-    auto oOutputPower = _dataPoints.get<DataPointLabel::OutputPower>();
     auto oEfficiency = _dataPoints.get<DataPointLabel::Efficiency>();
     auto efficiency = oEfficiency ? (*oEfficiency > 0.5 ? *oEfficiency : 1.0) : 1.0;
 
@@ -150,6 +186,7 @@ void Controller::loop()
         }
 
         _batteryEmergencyCharging = true;
+        resetAutoPowerControl();
 
         // Set output current
         float outputCurrent = efficiency * (config.Huawei.Auto_Power_Upper_Power_Limit / *oOutputVoltage);
@@ -169,120 +206,219 @@ void Controller::loop()
         }
         return;
     }
+}
 
-    // ***********************
-    // Automatic power control
-    // ***********************
-    if (_mode == HUAWEI_MODE_AUTO_INT ) {
-        // Check if we should run automatic power calculation at all.
-        // We may have set a value recently and still wait for output stabilization
-        if (_autoModeBlockedTillMillis > millis()) {
-            return;
-        }
+void Controller::controlLoopHelper(void* context)
+{
+    auto pInstance = static_cast<Controller*>(context);
+    pInstance->controlLoop();
+}
 
-        if (!oOutputVoltage || !oOutputPower || !oOutputCurrent) {
-            MessageOutput.print("[Huawei::Controller] Cannot perform auto power "
-                    "control while critical PSU values are still unknown\r\n");
-            _autoModeBlockedTillMillis = millis() + 1000;
-            return;
+void Controller::controlLoop()
+{
+    static auto constexpr resetNotificationValue = pdTRUE;
+    static auto constexpr notificationTimeout = pdMS_TO_TICKS(1000);
+
+    while (true) {
+        ulTaskNotifyTake(resetNotificationValue, notificationTimeout);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_upHardwareInterface) { continue; }
+
+        bool autoMode = _mode == HUAWEI_MODE_AUTO_INT && !_batteryEmergencyCharging;
+
+        _upHardwareInterface->setDataRequestInterval(autoMode ?
+                AutoModeDataRequestIntervalMillis :
+                HardwareInterface::DataRequestIntervalMillis);
+
+        auto pNewData = _upHardwareInterface->getCurrentData();
+        if (pNewData == nullptr) { continue; }
+
+        _dataPoints.updateFrom(*pNewData);
+        ++_dataGeneration;
+
+        auto oInputPower = _dataPoints.get<DataPointLabel::InputPower>();
+        PowerArbiter.setChargerState(autoMode, oInputPower.value_or(0));
+
+        if (!autoMode) {
+            resetAutoPowerControl();
+            continue;
         }
 
-        // Re-enable automatic power control if the output voltage has dropped below threshold
-        if (oOutputVoltage && *oOutputVoltage < config.Huawei.Auto_Power_Enable_Voltage_Limit ) {
-            _autoPowerEnabledCounter = 10;
+        autoPowerControl();
+    }
+}
+
+void Controller::resetAutoPowerControl()
+{
+    _oAutoPowerSetpoint = std::nullopt;
+    _lastPowerError = 0;
+}
+
+void Controller::autoPowerControl()
+{
+    // NOTE: the mutex is locked by the control loop calling this method
+
+    auto const& config = Configuration.get();
+
+    bool verboseLogging = config.Huawei.VerboseLogging;
+
+    auto oOutputCurrent = _dataPoints.get<DataPointLabel::OutputCurrent>();
+    auto oOutputVoltage = _dataPoints.get<DataPointLabel::OutputVoltage>();
+    auto oOutputPower = _dataPoints.get<DataPointLabel::OutputPower>();
+    auto oEfficiency = _dataPoints.get<DataPointLabel::Efficiency>();
+    auto efficiency = oEfficiency ? (*oEfficiency > 0.5 ? *oEfficiency : 1.0) : 1.0;
+
+    if (!oOutputVoltage || !oOutputPower || !oOutputCurrent) {
+        MessageOutput.print("[Huawei::Controller] Cannot perform auto power "
+                "control while critical PSU values are still unknown\r\n");
+        return;
+    }
+
+    // Re-enable automatic power control if the output voltage has dropped below threshold
+    if (*oOutputVoltage < config.Huawei.Auto_Power_Enable_Voltage_Limit) {
+        _autoPowerEnabledCounter = 10;
+    }
+
+    // the power arbiter, if active, decides whether the battery is charged
+    // or discharged. otherwise the PSU yields to producing inverters.
+    bool arbitrated = PowerArbiter.isActive();
+    bool chargingBlocked = arbitrated
+        ? PowerArbiter.getMode() != PowerArbiterClass::Mode::Charge
+        : _inverterProducing;
+
+    if (chargingBlocked) {
+        if (!_oLastSetpoint || *_oLastSetpoint > 0) {
+            MessageOutput.printf("[Huawei::Controller] %s, disable PSU\r\n",
+                    (arbitrated ? "Battery is being discharged" : "Inverter is active"));
         }
+        resetAutoPowerControl();
+        setOutputCurrent(0.0);
+        return;
+    }
 
-        if (PowerLimiter.isGovernedBatteryPoweredInverterProducing()) {
-            _setParameter(0.0, Setting::OnlineCurrent);
-            // Don't run auto mode for a second now. Otherwise we may send too much over the CAN bus
-            _autoModeBlockedTillMillis = millis() + 1000;
-            MessageOutput.printf("[Huawei::Controller] Inverter is active, disable PSU\r\n");
-            return;
+    if (_autoPowerEnabledCounter == 0) { return; }
+
+    // the controller's error only changes with a new power meter value, so
+    // the PI controller advances only then. the battery's current limit is
+    // enforced with every new set of values from the PSU, though.
+    bool newPowerMeterValue = PowerMeter.getLastUpdate() != _lastPowerMeterUpdateReceivedMillis;
+    if (newPowerMeterValue) {
+        _lastPowerMeterUpdateReceivedMillis = PowerMeter.getLastUpdate();
+
+        float error = config.Huawei.Auto_Power_Target_Power_Consumption - PowerMeter.getPowerTotal();
+
+        // start from the PSU's actual input power
+        if (!_oAutoPowerSetpoint) {
+            _oAutoPowerSetpoint = *oOutputPower / efficiency;
+            _lastPowerError = error;
         }
 
-        if (PowerMeter.getLastUpdate() > _lastPowerMeterUpdateReceivedMillis &&
-                _autoPowerEnabledCounter > 0) {
-            // We have received a new PowerMeter value. Also we're _autoPowerEnabled
-            // So we're good to calculate a new limit
+        float setpoint = *_oAutoPowerSetpoint;
+        setpoint += AutoPowerKp * (error - _lastPowerError) + AutoPowerKi * error;
 
-            _lastPowerMeterUpdateReceivedMillis = PowerMeter.getLastUpdate();
+        // the arbiter calculates the input power which makes the grid power
+        // match the target in one step.
+        if (arbitrated) { setpoint = PowerArbiter.getChargerSetpoint(); }
 
-            // Calculate new power limit
-            float newPowerLimit = -1 * round(PowerMeter.getPowerTotal());
+        _oAutoPowerSetpoint = std::clamp(setpoint, 0.0f, config.Huawei.Auto_Power_Upper_Power_Limit);
+        _lastPowerError = error;
 
-            // Powerlimit is the requested output power + permissable Grid consumption factoring in the efficiency factor
-            newPowerLimit += *oOutputPower + config.Huawei.Auto_Power_Target_Power_Consumption / efficiency;
+        if (verboseLogging) {
+            MessageOutput.printf("[Huawei::Controller] error: %.0f W, "
+                "newPowerLimit: %.0f, output_power: %.01f\r\n",
+                error, *_oAutoPowerSetpoint, *oOutputPower);
+        }
+    }
 
-            if (verboseLogging) {
-                MessageOutput.printf("[Huawei::Controller] newPowerLimit: %.0f, "
-                    "output_power: %.01f\r\n", newPowerLimit, *oOutputPower);
+    if (!_oAutoPowerSetpoint) { return; }
+
+    // Check whether the battery SoC limit setting is enabled
+    if (config.Battery.Enabled && config.Huawei.Auto_Power_BatterySoC_Limits_Enabled) {
+        uint8_t _batterySoC = Battery.getStats()->getSoC();
+        // Sets power limit to 0 if the BMS reported SoC reaches or exceeds the user configured value
+        if (_batterySoC >= config.Huawei.Auto_Power_Stop_BatterySoC_Threshold) {
+            _oAutoPowerSetpoint = 0;
+            if (verboseLogging && newPowerMeterValue) {
+                MessageOutput.printf("[Huawei::Controller] Current battery SoC %i reached "
+                        "stop threshold %i, set newPowerLimit to 0\r\n", _batterySoC,
+                        config.Huawei.Auto_Power_Stop_BatterySoC_Threshold);
             }
+        }
+    }
 
-            // Check whether the battery SoC limit setting is enabled
-            if (config.Battery.Enabled && config.Huawei.Auto_Power_BatterySoC_Limits_Enabled) {
-                uint8_t _batterySoC = Battery.getStats()->getSoC();
-                // Sets power limit to 0 if the BMS reported SoC reaches or exceeds the user configured value
-                if (_batterySoC >= config.Huawei.Auto_Power_Stop_BatterySoC_Threshold) {
-                    newPowerLimit = 0;
-                    if (verboseLogging) {
-                        MessageOutput.printf("[Huawei::Controller] Current battery SoC %i reached "
-                                "stop threshold %i, set newPowerLimit to %f \r\n", _batterySoC,
-                                config.Huawei.Auto_Power_Stop_BatterySoC_Threshold, newPowerLimit);
-                    }
-                }
-            }
+    using Setting = HardwareInterface::Setting;
+
+    float newPowerLimit = *_oAutoPowerSetpoint;
+
+    if (newPowerLimit <= config.Huawei.Auto_Power_Lower_Power_Limit) {
+        // requested PL is below minium. Set current to 0
+        _autoPowerEnabled = false;
+        setOutputCurrent(0.0);
+        return;
+    }
 
-            if (newPowerLimit > config.Huawei.Auto_Power_Lower_Power_Limit) {
-
-                // Check if the output power has dropped below the lower limit (i.e. the battery is full)
-                // and if the PSU should be turned off. Also we use a simple counter mechanism here to be able
-                // to ramp up from zero output power when starting up
-                if (*oOutputPower < config.Huawei.Auto_Power_Lower_Power_Limit) {
-                    MessageOutput.print("[Huawei::Controller] Power and "
-                        "voltage limit reached. Disabling automatic power "
-                        "control.\r\n");
-                    _autoPowerEnabledCounter--;
-                    if (_autoPowerEnabledCounter == 0) {
-                        _autoPowerEnabled = false;
-                        _setParameter(0.0, Setting::OnlineCurrent);
-                        return;
-                    }
-                } else {
-                    _autoPowerEnabledCounter = 10;
-                }
-
-                // Limit power to maximum
-                if (newPowerLimit > config.Huawei.Auto_Power_Upper_Power_Limit) {
-                    newPowerLimit = config.Huawei.Auto_Power_Upper_Power_Limit;
-                }
-
-                // Calculate output current
-                float calculatedCurrent = efficiency * (newPowerLimit / *oOutputVoltage);
-
-                // Limit output current to value requested by BMS
-                float permissableCurrent = stats->getChargeCurrentLimitation() - (stats->getChargeCurrent() - *oOutputCurrent); // BMS current limit - current from other sources, e.g. Victron MPPT charger
-                float outputCurrent = std::min(calculatedCurrent, permissableCurrent);
-                outputCurrent= outputCurrent > 0 ? outputCurrent : 0;
-
-                if (verboseLogging) {
-                    MessageOutput.printf("[Huawei::Controller] Setting output "
-                        "current to %.2fA. This is the lower value of "
-                        "calculated %.2fA and BMS permissable %.2fA "
-                        "currents\r\n", outputCurrent, calculatedCurrent,
-                        permissableCurrent);
-                }
-                _autoPowerEnabled = true;
-                _setParameter(outputCurrent, Setting::OnlineCurrent);
-
-                // Don't run auto mode some time to allow for output stabilization after issuing a new value
-                _autoModeBlockedTillMillis = millis() + 2 * HardwareInterface::DataRequestIntervalMillis;
-            } else {
-                // requested PL is below minium. Set current to 0
+    // Check if the output power has dropped below the lower limit (i.e. the battery is full)
+    // and if the PSU should be turned off. Also we use a simple counter mechanism here to be able
+    // to ramp up from zero output power when starting up
+    if (newPowerMeterValue) {
+        if (*oOutputPower < config.Huawei.Auto_Power_Lower_Power_Limit) {
+            MessageOutput.print("[Huawei::Controller] Power and "
+                "voltage limit reached. Disabling automatic power "
+                "control.\r\n");
+            _autoPowerEnabledCounter--;
+            if (_autoPowerEnabledCounter == 0) {
                 _autoPowerEnabled = false;
+                resetAutoPowerControl();
                 _setParameter(0.0, Setting::OnlineCurrent);
+                return;
             }
+        } else {
+            _autoPowerEnabledCounter = 10;
         }
     }
+
+    // Calculate output current
+    float calculatedCurrent = efficiency * (newPowerLimit / *oOutputVoltage);
+
+    // Limit output current to value requested by BMS
+    auto stats = Battery.getStats();
+    float permissableCurrent = stats->getChargeCurrentLimitation() - (stats->getChargeCurrent() - *oOutputCurrent); // BMS current limit - current from other sources, e.g. Victron MPPT charger
+    float outputCurrent = std::min(calculatedCurrent, permissableCurrent);
+    outputCurrent = outputCurrent > 0 ? outputCurrent : 0;
+
+    // do not let the PI controller wind up while the current is limited
+    if (calculatedCurrent > outputCurrent) {
+        _oAutoPowerSetpoint = outputCurrent * *oOutputVoltage / efficiency;
+    }
+
+    if (verboseLogging && newPowerMeterValue) {
+        MessageOutput.printf("[Huawei::Controller] Setting output "
+            "current to %.2fA. This is the lower value of "
+            "calculated %.2fA and BMS permissable %.2fA "
+            "currents\r\n", outputCurrent, calculatedCurrent,
+            permissableCurrent);
+    }
+
+    _autoPowerEnabled = true;
+    setOutputCurrent(outputCurrent);
+}
+
+void Controller::setOutputCurrent(float current)
+{
+    // NOTE: the mutex is locked by any method calling this private method
+
+    if (_oLastSetpoint) {
+        uint32_t elapsed = millis() - _lastSetpointMillis;
+        bool toZero = current == 0 && *_oLastSetpoint > 0;
+        bool changed = std::abs(current - *_oLastSetpoint) >= SetpointDeadbandAmps;
+
+        if (!toZero && elapsed < MinSetpointIntervalMillis) { return; }
+        if (!toZero && !changed && elapsed < SetpointRefreshMillis) { return; }
+    }
+
+    _setParameter(current, HardwareInterface::Setting::OnlineCurrent);
 }
 
 void Controller::setParameter(float val, HardwareInterface::Setting setting)
@@ -318,6 +454,11 @@ void Controller::_setParameter(float val, HardwareInterface::Setting setting)
         _outputCurrentOnSinceMillis = millis();
     }
 
+    if (setting == Setting::OnlineCurrent) {
+        _oLastSetpoint = val;
+        _lastSetpointMillis = millis();
+    }
+
     _upHardwareInterface->setParameter(setting, val);
 }
 
@@ -346,6 +487,7 @@ void Controller::setMode(uint8_t mode) {
 
     if (_mode == HUAWEI_MODE_AUTO_INT && mode != HUAWEI_MODE_AUTO_INT) {
         _autoPowerEnabled = false;
+        resetAutoPowerControl();
         _setParameter(0, HardwareInterface::Setting::OnlineCurrent);
     }
 
@@ -386,6 +528,15 @@ void Controller::getJsonData(JsonVariant& root) const
         root["efficiency"]["v"] = *_dataPoints.get<Label::Efficiency>() * 100;
         root["efficiency"]["u"] = oEfficiency->getUnitText();
     }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_upHardwareInterface) {
+        auto receiveStats = _upHardwareInterface->getReceiveStats();
+        root["rx_frames"] = receiveStats.Frames;
+        root["rx_overruns"] = receiveStats.Overruns;
+    }
 }
 
 } // namespace GridCharger::Huawei
+
+#endif // OPENDTU_WITHOUT_HUAWEI
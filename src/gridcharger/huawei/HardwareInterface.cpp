@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
+#ifndef OPENDTU_WITHOUT_HUAWEI
 
 #include <Arduino.h>
 #include <Configuration.h>
 #include <MessageOutput.h>
 #include <gridcharger/huawei/HardwareInterface.h>
+#include <algorithm>
 
 namespace GridCharger::Huawei {
 
@@ -67,7 +69,11 @@ void HardwareInterface::loop()
 
         if ((msg.valueId & 0xFF00FFFF) != 0x01000000) { continue; }
 
-        if (!_upDataInFlight) { _upDataInFlight = std::make_unique<DataPointContainer>(); }
+        auto& dataInFlight = _dataBuffers[_writeBuffer];
+        if (!_dataInFlight) {
+            dataInFlight.clear();
+            _dataInFlight = true;
+        }
 
         auto label = static_cast<DataPointLabel>((msg.valueId & 0x00FF0000) >> 16);
 
@@ -75,52 +81,50 @@ void HardwareInterface::loop()
         float value = static_cast<float>(msg.value)/divisor;
         switch (label) {
             case DataPointLabel::InputPower:
-                _upDataInFlight->add<DataPointLabel::InputPower>(value);
+                dataInFlight.add<DataPointLabel::InputPower>(value);
                 break;
             case DataPointLabel::InputFrequency:
-                _upDataInFlight->add<DataPointLabel::InputFrequency>(value);
+                dataInFlight.add<DataPointLabel::InputFrequency>(value);
                 break;
             case DataPointLabel::InputCurrent:
-                _upDataInFlight->add<DataPointLabel::InputCurrent>(value);
+                dataInFlight.add<DataPointLabel::InputCurrent>(value);
                 break;
             case DataPointLabel::OutputPower:
-                _upDataInFlight->add<DataPointLabel::OutputPower>(value);
+                dataInFlight.add<DataPointLabel::OutputPower>(value);
                 break;
             case DataPointLabel::Efficiency:
-                _upDataInFlight->add<DataPointLabel::Efficiency>(value);
+                dataInFlight.add<DataPointLabel::Efficiency>(value);
                 break;
             case DataPointLabel::OutputVoltage:
-                _upDataInFlight->add<DataPointLabel::OutputVoltage>(value);
+                dataInFlight.add<DataPointLabel::OutputVoltage>(value);
                 break;
             case DataPointLabel::OutputCurrentMax:
-                _upDataInFlight->add<DataPointLabel::OutputCurrentMax>(value);
+                dataInFlight.add<DataPointLabel::OutputCurrentMax>(value);
                 break;
             case DataPointLabel::InputVoltage:
-                _upDataInFlight->add<DataPointLabel::InputVoltage>(value);
+                dataInFlight.add<DataPointLabel::InputVoltage>(value);
                 break;
             case DataPointLabel::OutputTemperature:
-                _upDataInFlight->add<DataPointLabel::OutputTemperature>(value);
+                dataInFlight.add<DataPointLabel::OutputTemperature>(value);
                 break;
             case DataPointLabel::InputTemperature:
-                _upDataInFlight->add<DataPointLabel::InputTemperature>(value);
+                dataInFlight.add<DataPointLabel::InputTemperature>(value);
                 break;
             case DataPointLabel::OutputCurrent:
-                _upDataInFlight->add<DataPointLabel::OutputCurrent>(value);
+                dataInFlight.add<DataPointLabel::OutputCurrent>(value);
                 break;
         }
 
         // the OutputCurent value is the last value in a data request's answer
         // among all values we process into the data point container, so we
         // make the in-flight container the current container.
-        if (label == DataPointLabel::OutputCurrent) {
-            _upDataCurrent = std::move(_upDataInFlight);
-        }
+        if (label == DataPointLabel::OutputCurrent) { publishData(); }
     }
 
     size_t queueSize = _sendQueue.size();
     for (size_t i = 0; i < queueSize; ++i) {
         auto [setting, val] = _sendQueue.front();
-        _sendQueue.pop();
+        _sendQueue.pop_front();
 
         std::array<uint8_t, 8> data = {
             0x01, static_cast<uint8_t>(setting), 0x00, 0x00,
@@ -130,7 +134,7 @@ void HardwareInterface::loop()
 
         if (!sendMessage(0x108180FE, data)) {
             MessageOutput.print("[Huawei::HwIfc] Failed to set parameter\r\n");
-            _sendQueue.push({setting, val});
+            _sendQueue.push_back({setting, val});
         }
     }
 
@@ -140,17 +144,30 @@ void HardwareInterface::loop()
             MessageOutput.print("[Huawei::HwIfc] Failed to send data request\r\n");
         }
 
-        _nextRequestMillis = millis() + DataRequestIntervalMillis;
+        _nextRequestMillis = millis() + _dataRequestIntervalMillis;
 
         // this should be redundant, as every answer to a data request should
         // have the OutputCurrent value, which is supposed to be the last value
         // in the answer, and it already triggers moving the data in flight.
-        if (_upDataInFlight) {
-            _upDataCurrent = std::move(_upDataInFlight);
-        }
+        if (_dataInFlight) { publishData(); }
     }
 }
 
+void HardwareInterface::publishData()
+{
+    // NOTE: called by the hardware interface's task with the mutex locked
+
+    // hand the in-flight container over, and continue writing into the
+    // container previously holding the latest data, which is either stale
+    // or was already retrieved by the consumer.
+    auto previous = _readyBuffer.exchange(_writeBuffer | FreshDataFlag);
+    _writeBuffer = previous & ~FreshDataFlag;
+    _dataInFlight = false;
+    ++_generation;
+
+    if (_dataConsumer != nullptr) { xTaskNotifyGive(_dataConsumer); }
+}
+
 void HardwareInterface::setParameter(HardwareInterface::Setting setting, float val)
 {
     std::lock_guard<std::mutex> lock(_mutex);
@@ -168,35 +185,59 @@ void HardwareInterface::setParameter(HardwareInterface::Setting setting, float v
             break;
     }
 
-    _sendQueue.push({setting, static_cast<uint16_t>(val)});
+    // replace a value for the same setting which was not yet sent, as
+    // only the most recent value is relevant.
+    auto it = std::find_if(_sendQueue.begin(), _sendQueue.end(),
+            [setting](auto const& entry) { return entry.first == setting; });
+    if (it != _sendQueue.end()) {
+        it->second = static_cast<uint16_t>(val);
+    } else {
+        _sendQueue.push_back({setting, static_cast<uint16_t>(val)});
+    }
+
     _nextRequestMillis = millis() - 1; // request param feedback immediately
 
     xTaskNotifyGive(_taskHandle);
 }
 
-std::unique_ptr<DataPointContainer> HardwareInterface::getCurrentData()
+void HardwareInterface::setDataConsumer(TaskHandle_t task)
 {
-    std::unique_ptr<DataPointContainer> upData = nullptr;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _dataConsumer = task;
+}
 
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        upData = std::move(_upDataCurrent);
-    }
+void HardwareInterface::setDataRequestInterval(uint32_t intervalMillis)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_dataRequestIntervalMillis == intervalMillis) { return; }
+
+    _dataRequestIntervalMillis = intervalMillis;
+    _nextRequestMillis = millis() - 1;
+}
+
+DataPointContainer const* HardwareInterface::getCurrentData()
+{
+    if ((_readyBuffer & FreshDataFlag) == 0) { return nullptr; }
+
+    auto previous = _readyBuffer.exchange(_readBuffer);
+    _readBuffer = previous & ~FreshDataFlag;
+    auto const& data = _dataBuffers[_readBuffer];
 
     auto const& config = Configuration.get();
-    if (upData && config.Huawei.VerboseLogging) {
-        auto iter = upData->cbegin();
-        while (iter != upData->cend()) {
+    if (config.Huawei.VerboseLogging) {
+        for (auto const& [label, dataPoint] : data) {
             MessageOutput.printf("[Huawei::HwIfc] [%.3f] %s: %s%s\r\n",
-                static_cast<float>(iter->second.getTimestamp())/1000,
-                iter->second.getLabelText().c_str(),
-                iter->second.getValueText().c_str(),
-                iter->second.getUnitText().c_str());
-            ++iter;
+                static_cast<float>(dataPoint.getTimestamp())/1000,
+                dataPoint.getLabelText(),
+                dataPoint.getValueText().c_str(),
+                dataPoint.getUnitText());
         }
     }
 
-    return std::move(upData);
+    return &data;
 }
 
 } // namespace GridCharger::Huawei
+
+#endif // OPENDTU_WITHOUT_HUAWEI
@@ -2,6 +2,7 @@
 /*
  * Copyright (C) 2023 Malte Schmidt and others
  */
+#ifndef OPENDTU_WITHOUT_HUAWEI
 #include <gridcharger/huawei/MCP2515.h>
 #include "MessageOutput.h"
 #include "PinMapping.h"
@@ -9,6 +10,26 @@
 
 namespace GridCharger::Huawei {
 
+namespace {
+    // see the MCP2515 datasheet, section 12 (SPI interface)
+    constexpr uint8_t InstructionReadRxBuffer0 = 0x90; // starting at RXB0SIDH
+    constexpr uint8_t InstructionReadRxBuffer1 = 0x94; // starting at RXB1SIDH
+    constexpr uint8_t InstructionRead = 0x03;
+    constexpr uint8_t InstructionBitModify = 0x05;
+    constexpr uint8_t InstructionReadStatus = 0xA0;
+
+    constexpr uint8_t RegisterEFLG = 0x2D;
+    constexpr uint8_t RegisterRXB0CTRL = 0x60;
+
+    constexpr uint8_t StatusRx0If = 0x01;
+    constexpr uint8_t StatusRx1If = 0x02;
+    constexpr uint8_t EflgRx0Ovr = 0x40;
+    constexpr uint8_t EflgRx1Ovr = 0x80;
+    constexpr uint8_t Rxb0CtrlBukt = 0x04; // rollover into RXB1 if RXB0 is full
+
+    SPISettings const sSpiSettings(10000000, MSBFIRST, SPI_MODE0);
+}
+
 TaskHandle_t sIsrTaskHandle = nullptr;
 
 void mcp2515Isr()
@@ -81,6 +102,12 @@ bool MCP2515::init()
     _upCAN->init_Filt(0, 1, myFilter);
     _upCAN->init_Mask(1, 1, myMask);
 
+    _huaweiCs = pin.huawei_cs;
+
+    // a frame arriving while RXB0 is still occupied is moved to RXB1
+    // rather than being discarded, so a burst of two frames survives.
+    spiBitModify(RegisterRXB0CTRL, Rxb0CtrlBukt, Rxb0CtrlBukt);
+
     // Change to normal mode to allow messages to be transmitted
     _upCAN->setMode(MCP_NORMAL);
 
@@ -105,30 +132,117 @@ bool MCP2515::init()
     return true;
 }
 
-bool MCP2515::getMessage(HardwareInterface::can_message_t& msg)
+void MCP2515::spiBegin()
 {
-    if (!_upCAN) { return false; }
+    _upSPI->beginTransaction(sSpiSettings);
+    digitalWrite(_huaweiCs, LOW);
+}
+
+void MCP2515::spiEnd()
+{
+    digitalWrite(_huaweiCs, HIGH);
+    _upSPI->endTransaction();
+}
+
+uint8_t MCP2515::spiReadStatus()
+{
+    spiBegin();
+    _upSPI->transfer(InstructionReadStatus);
+    uint8_t status = _upSPI->transfer(0x00);
+    spiEnd();
+    return status;
+}
+
+uint8_t MCP2515::spiReadRegister(uint8_t address)
+{
+    spiBegin();
+    _upSPI->transfer(InstructionRead);
+    _upSPI->transfer(address);
+    uint8_t value = _upSPI->transfer(0x00);
+    spiEnd();
+    return value;
+}
+
+void MCP2515::spiBitModify(uint8_t address, uint8_t mask, uint8_t data)
+{
+    spiBegin();
+    _upSPI->transfer(InstructionBitModify);
+    _upSPI->transfer(address);
+    _upSPI->transfer(mask);
+    _upSPI->transfer(data);
+    spiEnd();
+}
+
+void MCP2515::spiReadRxBuffer(uint8_t instruction)
+{
+    // instruction, SIDH, SIDL, EID8, EID0, DLC and eight data bytes. the
+    // controller clears the buffer's interrupt flag when CS is released.
+    std::array<uint8_t, 14> tx = { instruction };
+    std::array<uint8_t, 14> rx = {};
+    spiBegin();
+    _upSPI->transferBytes(tx.data(), rx.data(), rx.size());
+    spiEnd();
+
+    ++_rxFrameCount;
+
+    uint8_t const* raw = rx.data() + 1;
+    bool extended = (raw[1] & 0x08) != 0;
+    uint8_t len = raw[4] & 0x0F;
+
+    // all frames of interest are extended frames with eight data bytes
+    if (!extended || len != 8) { return; }
+
+    uint32_t canId = (static_cast<uint32_t>(raw[0]) << 3) | (raw[1] >> 5);
+    canId = (canId << 2) | (raw[1] & 0x03);
+    canId = (canId << 16) | (raw[2] << 8) | raw[3];
+
+    uint8_t const* data = raw + 5;
+    auto& msg = _rxFrames[_rxFramesPending++];
+    msg.canId = canId;
+    msg.valueId = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+    msg.value = data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7];
+}
 
-    INT32U rxId;
-    unsigned char len = 0;
-    unsigned char rxBuf[8];
+size_t MCP2515::drainRxBuffers()
+{
+    _rxFramesPending = 0;
+    _rxFramesConsumed = 0;
+    size_t buffersRead = 0;
 
-    while (!digitalRead(_huaweiIrq)) {
-        _upCAN->readMsgBuf(&rxId, &len, rxBuf); // Read data: len = data length, buf = data byte(s)
+    // at most two frames are read per iteration, and frames might keep
+    // arriving while we read, so we stop once our buffer is (almost) full.
+    while (_rxFramesPending + 2 <= _rxFrames.size()) {
+        uint8_t status = spiReadStatus();
+        if ((status & (StatusRx0If | StatusRx1If)) == 0) { break; }
 
-        // Determine if ID is standard (11 bits) or extended (29 bits)
-        if ((rxId & 0x80000000) != 0x80000000) { continue; }
+        // with rollover enabled, RXB0 holds the older frame
+        if (status & StatusRx0If) { spiReadRxBuffer(InstructionReadRxBuffer0); ++buffersRead; }
+        if (status & StatusRx1If) { spiReadRxBuffer(InstructionReadRxBuffer1); ++buffersRead; }
+    }
 
-        if (len != 8) { continue; }
+    uint8_t eflg = spiReadRegister(RegisterEFLG);
+    uint8_t overruns = eflg & (EflgRx0Ovr | EflgRx1Ovr);
+    if (overruns != 0) {
+        _rxOverrunCount += __builtin_popcount(overruns);
+        spiBitModify(RegisterEFLG, overruns, 0x00);
+    }
+
+    return buffersRead;
+}
 
-        msg.canId = rxId;
-        msg.valueId = rxBuf[0] << 24 | rxBuf[1] << 16 | rxBuf[2] << 8 | rxBuf[3];
-        msg.value = rxBuf[4] << 24 | rxBuf[5] << 16 | rxBuf[6] << 8 | rxBuf[7];
+bool MCP2515::getMessage(HardwareInterface::can_message_t& msg)
+{
+    if (!_upCAN) { return false; }
 
-        return true;
+    // frames we are not interested in are discarded while draining, so we
+    // keep draining while the interrupt line signals pending frames.
+    while (_rxFramesConsumed >= _rxFramesPending) {
+        if (digitalRead(_huaweiIrq)) { return false; }
+        if (drainRxBuffers() == 0) { return false; }
     }
 
-    return false;
+    msg = _rxFrames[_rxFramesConsumed++];
+    return true;
 }
 
 bool MCP2515::sendMessage(uint32_t canId, std::array<uint8_t, 8> const& data)
@@ -142,3 +256,5 @@ bool MCP2515::sendMessage(uint32_t canId, std::array<uint8_t, 8> const& data)
 }
 
 } // namespace GridCharger::Huawei
+
+#endif // OPENDTU_WITHOUT_HUAWEI
@@ -2,13 +2,24 @@
 /*
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
+#include "Benchmark.h"
+#include "DplSimulation.h"
+#include "BootProfiler.h"
 #include "Configuration.h"
 #include "Datastore.h"
+#include "RtcState.h"
+#include "DnsCache.h"
 #include "Display_Graphic.h"
+#include "HeapMonitor.h"
+#include "JsonArena.h"
 #include "I18n.h"
+#include "InverterCommandEvents.h"
+#include "InverterDataCache.h"
 #include "InverterSettings.h"
 #include "Led_Single.h"
 #include "MessageOutput.h"
+#include "MetricsPush.h"
+#include "ModbusTcpServer.h"
 #include "SerialPortManager.h"
 #include "Battery.h"
 #include <gridcharger/huawei/Controller.h>
@@ -20,17 +31,25 @@
 #include "MqttHandleHuawei.h"
 #include "MqttHandlePowerLimiter.h"
 #include "MqttHandlePowerLimiterHass.h"
+#include "MqttHassPublisher.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
 #include "NtpSettings.h"
 #include "PinMapping.h"
+#include "PowerManagement.h"
 #include "RestartHelper.h"
+#include "RtosTaskProfiler.h"
 #include "Scheduler.h"
 #include "SunPosition.h"
+#include "TelemetryStream.h"
+#include "TaskMonitor.h"
+#include "TimeSeries.h"
 #include "Utils.h"
 #include "WebApi.h"
+#include "YieldCheckpoint.h"
 #include "PowerMeter.h"
 #include "PowerLimiter.h"
+#include "PowerLimiterCluster.h"
 #include "defaults.h"
 #include <solarcharger/Controller.h>
 #include <Arduino.h>
@@ -38,10 +57,68 @@
 #include <SpiManager.h>
 #include <TaskScheduler.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+// stages which are not required to control the inverters are executed once
+// the main loop is running, such that the radios start polling as early as
+// possible after a restart.
+static void deferredSetup()
+{
+    auto const& config = Configuration.get();
+    const auto& pin = PinMapping.get();
+
+    // Read languate pack
+    BootProfiler.beginStage("i18n", true);
+    MessageOutput.print("Reading language pack... ");
+    I18n.init(scheduler);
+    MessageOutput.println("done");
+
+#ifndef OPENDTU_WITHOUT_DISPLAY
+    // Initialize Display
+    BootProfiler.beginStage("display", true);
+    MessageOutput.print("Initialize Display... ");
+    Display.init(
+        scheduler,
+        static_cast<DisplayType_t>(pin.display_type),
+        pin.display_data,
+        pin.display_clk,
+        pin.display_cs,
+        pin.display_reset);
+    Display.setDiagramMode(static_cast<DiagramMode_t>(config.Display.Diagram.Mode));
+    Display.setOrientation(config.Display.Rotation);
+    Display.enablePowerSafe = config.Display.PowerSafe;
+    Display.enableScreensaver = config.Display.ScreenSaver;
+    Display.setContrast(config.Display.Contrast);
+    Display.setLocale(config.Display.Locale);
+    Display.setStartupDisplay();
+    MessageOutput.println("done");
+#endif
+
+    BootProfiler.beginStage("hass", true);
+    MqttHassPublisher.init(scheduler);
+    MqttHandleHass.init(scheduler);
+    MqttHandleBatteryHass.init(scheduler);
+    MqttHandlePowerLimiterHass.init(scheduler);
+
+    BootProfiler.endStage();
+}
+
+// tasks must only be added to a scheduler by the FreeRTOS task executing it
+static void deferredControlSetup()
+{
+    auto start = static_cast<uint32_t>(esp_timer_get_time());
+    Battery.init(controlScheduler);
+    BootProfiler.addStage("battery", true, start,
+            static_cast<uint32_t>(esp_timer_get_time()) - start);
+}
+
+static Task sDeferredSetupTask(TASK_IMMEDIATE, TASK_ONCE, TaskMonitor.wrap("deferredSetup", &deferredSetup));
+static Task sDeferredControlSetupTask(TASK_IMMEDIATE, TASK_ONCE, TaskMonitor.wrap("deferredControlSetup", &deferredControlSetup));
 
 void setup()
 {
-    // Move all dynamic allocations >512byte to psram (if available)
+    // Move all dynamic allocations >512byte to psram (if available). see
+    // MemoryPolicy for buffers placed regardless of their size.
     heap_caps_malloc_extmem_enable(512);
 
     // Initialize SpiManager
@@ -51,6 +128,7 @@ void setup()
 #endif
 
     // Initialize serial output
+    BootProfiler.beginStage("serial");
     Serial.begin(SERIAL_BAUDRATE);
 #if !ARDUINO_USB_CDC_ON_BOOT
     // Only wait for serial interface to be set up when not using CDC
@@ -60,8 +138,13 @@ void setup()
     MessageOutput.init(scheduler);
     MessageOutput.println();
     MessageOutput.println("Starting OpenDTU");
+    TaskMonitor.init(scheduler);
+    RtosTaskProfiler.init(scheduler);
+    HeapMonitor.init(scheduler);
+    JsonArena.init();
 
     // Initialize file system
+    BootProfiler.beginStage("filesystem");
     MessageOutput.print("Initialize FS... ");
     if (!LittleFS.begin(false)) { // Do not format if mount failed
         MessageOutput.print("failed... trying to format...");
@@ -75,6 +158,7 @@ void setup()
     }
 
     // Read configuration values
+    BootProfiler.beginStage("configuration");
     Configuration.init(scheduler);
     MessageOutput.print("Reading configuration... ");
     if (!Configuration.read()) {
@@ -92,94 +176,117 @@ void setup()
         Configuration.migrateOnBattery();
         MessageOutput.print("migrated OpenDTU-OnBattery-specific config... ");
     }
-    auto& config = Configuration.get();
     MessageOutput.println("done");
 
-    // Read languate pack
-    MessageOutput.print("Reading language pack... ");
-    I18n.init(scheduler);
-    MessageOutput.println("done");
+#ifdef OPENDTU_BENCHMARK
+    // only the monitoring tasks are run after the benchmarks
+    Benchmark.run();
+    return;
+#endif
 
     // Load PinMapping
+    BootProfiler.beginStage("pinmapping");
     MessageOutput.print("Reading PinMapping... ");
     if (PinMapping.init(Configuration.get().Dev_PinMapping)) {
         MessageOutput.print("found valid mapping ");
     } else {
         MessageOutput.print("using default config ");
     }
-    const auto& pin = PinMapping.get();
     MessageOutput.println("done");
 
     SerialPortManager.init();
 
     // Initialize Network
+    BootProfiler.beginStage("network");
     MessageOutput.print("Initialize Network... ");
     NetworkSettings.init(scheduler);
+    DnsCache.init(scheduler);
     MessageOutput.println("done");
     NetworkSettings.applyConfig();
 
     // Initialize NTP
+    BootProfiler.beginStage("ntp");
     MessageOutput.print("Initialize NTP... ");
     NtpSettings.init();
     MessageOutput.println("done");
 
     // Initialize SunPosition
+    BootProfiler.beginStage("sunposition");
     MessageOutput.print("Initialize SunPosition... ");
     SunPosition.init(scheduler);
     MessageOutput.println("done");
 
     // Initialize MqTT
+    BootProfiler.beginStage("mqtt");
     MessageOutput.print("Initialize MqTT... ");
     MqttSettings.init();
     MqttHandleDtu.init(scheduler);
     MqttHandleInverter.init(scheduler);
     MqttHandleInverterTotal.init(scheduler);
-    MqttHandleHass.init(scheduler);
-    MqttHandleBatteryHass.init(scheduler);
-    MqttHandleHuawei.init(scheduler);
-    MqttHandlePowerLimiter.init(scheduler);
-    MqttHandlePowerLimiterHass.init(scheduler);
+    // these execute the commands received via MQTT, which must happen in
+    // the control plane
+#ifndef OPENDTU_WITHOUT_HUAWEI
+    MqttHandleHuawei.init(controlScheduler);
+#endif
+    MqttHandlePowerLimiter.init(controlScheduler);
     MessageOutput.println("done");
 
+    BootProfiler.beginStage("inverters");
+    InverterSettings.init(scheduler);
+    InverterCommandEvents.init();
+    InverterDataCache.init(scheduler);
+    RtcState.init(scheduler);
+    YieldCheckpoint.init(scheduler);
+
+    BootProfiler.beginStage("datastore");
+    Datastore.init(scheduler);
+    TimeSeries.init(scheduler);
+    RestartHelper.init(scheduler);
+
+    // OpenDTU-OnBattery-specific initializations go below
+    BootProfiler.beginStage("solarcharger");
+    SolarCharger.init(controlScheduler);
+    BootProfiler.beginStage("powermeter");
+    PowerMeter.init(controlScheduler);
+    BootProfiler.beginStage("powerlimiter");
+    PowerLimiter.init(controlScheduler);
+    PowerLimiterCluster.init(controlScheduler);
+    TelemetryStream.init(scheduler);
+    MetricsPush.init(scheduler);
+    ModbusTcpServer.init(scheduler);
+#ifdef OPENDTU_DPL_SIMULATION
+    DplSimulation.init(controlScheduler);
+#endif
+#ifndef OPENDTU_WITHOUT_HUAWEI
+    BootProfiler.beginStage("gridcharger");
+    HuaweiCan.init(controlScheduler);
+#endif
+
     // Initialize WebApi
+    BootProfiler.beginStage("webapi");
     MessageOutput.print("Initialize WebApi... ");
     WebApi.init(scheduler);
     MessageOutput.println("done");
 
-    // Initialize Display
-    MessageOutput.print("Initialize Display... ");
-    Display.init(
-        scheduler,
-        static_cast<DisplayType_t>(pin.display_type),
-        pin.display_data,
-        pin.display_clk,
-        pin.display_cs,
-        pin.display_reset);
-    Display.setDiagramMode(static_cast<DiagramMode_t>(config.Display.Diagram.Mode));
-    Display.setOrientation(config.Display.Rotation);
-    Display.enablePowerSafe = config.Display.PowerSafe;
-    Display.enableScreensaver = config.Display.ScreenSaver;
-    Display.setContrast(config.Display.Contrast);
-    Display.setLocale(config.Display.Locale);
-    Display.setStartupDisplay();
-    MessageOutput.println("done");
-
     // Initialize Single LEDs
+    BootProfiler.beginStage("leds");
     MessageOutput.print("Initialize LEDs... ");
     LedSingle.init(scheduler);
     MessageOutput.println("done");
 
-    InverterSettings.init(scheduler);
+    // once all subsystems which hold power management locks are running
+    BootProfiler.beginStage("powermanagement");
+    PowerManagement.init(scheduler);
 
-    Datastore.init(scheduler);
-    RestartHelper.init(scheduler);
+    BootProfiler.endStage();
 
-    // OpenDTU-OnBattery-specific initializations go below
-    SolarCharger.init(scheduler);
-    PowerMeter.init(scheduler);
-    PowerLimiter.init(scheduler);
-    HuaweiCan.init(scheduler);
-    Battery.init(scheduler);
+    scheduler.addTask(sDeferredSetupTask);
+    sDeferredSetupTask.enable();
+
+    controlScheduler.addTask(sDeferredControlSetupTask);
+    sDeferredControlSetupTask.enable();
+
+    ControlPlane.init();
 }
 
 void loop()
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <Configuration.h>
+#include <TaskMonitor.h>
 #include <MessageOutput.h>
+#include <MetricsRegistry.h>
 #include <MqttSettings.h>
 #include <solarcharger/Controller.h>
 #include <solarcharger/DummyStats.h>
@@ -14,11 +16,40 @@ namespace SolarChargers {
 void Controller::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&Controller::loop, this));
+    _loopTask.setCallback(TaskMonitor.wrap("SolarCharger::loop", std::bind(&Controller::loop, this)));
     _loopTask.setIterations(TASK_FOREVER);
     _loopTask.enable();
 
     this->updateSettings();
+
+    registerMetrics();
+}
+
+void Controller::registerMetrics()
+{
+    using Type = MetricsRegistryClass::Type;
+
+    auto fromStats = [this](auto getter) {
+        return [this, getter]() -> std::optional<float> {
+            if (!Configuration.get().SolarCharger.Enabled) { return std::nullopt; }
+            auto oValue = getter(*getStats());
+            if (!oValue) { return std::nullopt; }
+            return static_cast<float>(*oValue);
+        };
+    };
+
+    MetricsRegistry.add("opendtu_solarcharger_data_age", "Age of the solar charger data in ms", Type::Gauge,
+        fromStats([](Stats const& stats) { return std::optional<uint32_t>(stats.getAgeMillis()); }));
+    MetricsRegistry.add("opendtu_solarcharger_output_power", "Solar charger output power in W", Type::Gauge,
+        fromStats([](Stats const& stats) { return stats.getOutputPowerWatts(); }));
+    MetricsRegistry.add("opendtu_solarcharger_output_voltage", "Solar charger output voltage in V", Type::Gauge,
+        fromStats([](Stats const& stats) { return stats.getOutputVoltage(); }));
+    MetricsRegistry.add("opendtu_solarcharger_panel_power", "Solar charger panel power in W", Type::Gauge,
+        fromStats([](Stats const& stats) { return stats.getPanelPowerWatts(); }));
+    MetricsRegistry.add("opendtu_solarcharger_yield_day", "Solar charger yield of the day in Wh", Type::Counter,
+        fromStats([](Stats const& stats) { return stats.getYieldDay(); }));
+    MetricsRegistry.add("opendtu_solarcharger_yield_total", "Solar charger total yield in kWh", Type::Counter,
+        fromStats([](Stats const& stats) { return stats.getYieldTotal(); }));
 }
 
 void Controller::updateSettings()
@@ -84,6 +115,9 @@ void Controller::loop()
     auto const& config = Configuration.get();
     if (!config.Mqtt.Hass.Enabled) { return; }
 
+    // discovery messages are never dropped, so wait for the outbox to drain
+    if (_forcePublishSensors && !MqttSettings.hasOutboxRoom(MqttPublishPriority::Discovery)) { return; }
+
     _upProvider->getStats()->mqttPublishSensors(_forcePublishSensors);
 
     _forcePublishSensors = false;
@@ -3,10 +3,62 @@
 #include <Configuration.h>
 #include <MqttSettings.h>
 #include <MessageOutput.h>
+#include <PowerLimiter.h>
 #include <Utils.h>
 
 namespace SolarChargers::Mqtt {
 
+namespace {
+
+float toWatts(float value)
+{
+    using Unit_t = SolarChargerMqttConfig::WattageUnit;
+    switch (Configuration.get().SolarCharger.Mqtt.PowerUnit) {
+        case Unit_t::MilliWatts:
+            return value / 1000;
+        case Unit_t::KiloWatts:
+            return value * 1000;
+        default:
+            return value;
+    }
+}
+
+float toVolts(float value)
+{
+    using Unit_t = SolarChargerMqttConfig::VoltageUnit;
+    switch (Configuration.get().SolarCharger.Mqtt.VoltageTopicUnit) {
+        case Unit_t::DeciVolts:
+            return value / 10;
+        case Unit_t::CentiVolts:
+            return value / 100;
+        case Unit_t::MilliVolts:
+            return value / 1000;
+        default:
+            return value;
+    }
+}
+
+float toAmps(float value)
+{
+    using Unit_t = SolarChargerMqttConfig::AmperageUnit;
+    switch (Configuration.get().SolarCharger.Mqtt.CurrentUnit) {
+        case Unit_t::MilliAmps:
+            return value / 1000;
+        default:
+            return value;
+    }
+}
+
+// since this project is revolving around Hoymiles microinverters, which can
+// only handle up to 65V of input voltage at best, it is safe to assume that
+// an even higher voltage is implausible.
+bool isPlausibleVoltage(float voltage)
+{
+    return voltage >= 0 && voltage <= 65;
+}
+
+} // namespace
+
 bool Provider::init(bool verboseLogging)
 {
     _verboseLogging = verboseLogging;
@@ -16,6 +68,8 @@ bool Provider::init(bool verboseLogging)
     _outputCurrentTopic = config.CurrentTopic;
     _outputVoltageTopic = config.VoltageTopic;
 
+    if (strlen(config.CombinedTopic) > 0) { return initCombined(); }
+
     bool configValid = !config.CalculateOutputPower && !_outputPowerTopic.isEmpty();
     if (config.CalculateOutputPower) {
         configValid = !_outputCurrentTopic.isEmpty() && !_outputVoltageTopic.isEmpty();
@@ -88,6 +142,45 @@ bool Provider::init(bool verboseLogging)
     return true;
 }
 
+bool Provider::initCombined()
+{
+    auto const& config = Configuration.get().SolarCharger.Mqtt;
+
+    // the paths are parsed once rather than with every message
+    _powerPath = JsonPath(config.CalculateOutputPower ? "" : config.PowerJsonPath);
+    _voltagePath = JsonPath(config.VoltageJsonPath);
+    _currentPath = JsonPath(config.CalculateOutputPower ? config.CurrentJsonPath : "");
+
+    bool configValid = config.CalculateOutputPower
+        ? (!_voltagePath.isEmpty() && !_currentPath.isEmpty())
+        : !_powerPath.isEmpty();
+
+    if (!configValid) {
+        MessageOutput.printf("[SolarChargers::Mqtt]: Init failed. "
+               "switch 'calculate output power' %s, JSON paths of the "
+               "combined topic incomplete\r\n",
+               config.CalculateOutputPower ? "enabled" : "disabled");
+        return false;
+    }
+
+    String topic = config.CombinedTopic;
+    _subscribedTopics.push_back(topic);
+
+    MqttSettings.subscribe(topic, 0/*QoS*/,
+            std::bind(&Provider::onMqttMessageCombined,
+                this, std::placeholders::_1, std::placeholders::_2,
+                std::placeholders::_3, std::placeholders::_4,
+                std::placeholders::_5, std::placeholders::_6)
+            );
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[SolarChargers::Mqtt]: Subscribed to '%s' for all readings\r\n",
+            topic.c_str());
+    }
+
+    return true;
+}
+
 void Provider::deinit()
 {
     for (auto const& topic : _subscribedTopics) {
@@ -106,18 +199,7 @@ void Provider::onMqttMessageOutputPower(espMqttClientTypes::MessageProperties co
 
     if (!outputPower.has_value()) { return; }
 
-    auto const& config = Configuration.get().SolarCharger.Mqtt;
-    using Unit_t = SolarChargerMqttConfig::WattageUnit;
-    switch (config.PowerUnit) {
-        case Unit_t::MilliWatts:
-            *outputPower /= 1000;
-            break;
-        case Unit_t::KiloWatts:
-            *outputPower *= 1000;
-            break;
-        default:
-            break;
-    }
+    *outputPower = toWatts(*outputPower);
 
     if (*outputPower < 0) {
         MessageOutput.printf("[SolarChargers::Mqtt]: Implausible output_power '%.1f' in topic '%s'\r\n",
@@ -143,26 +225,9 @@ void Provider::onMqttMessageOutputVoltage(espMqttClientTypes::MessageProperties
 
     if (!outputVoltage.has_value()) { return; }
 
-    auto const& config = Configuration.get().SolarCharger.Mqtt;
-    using Unit_t = SolarChargerMqttConfig::VoltageUnit;
-    switch (config.VoltageTopicUnit) {
-        case Unit_t::DeciVolts:
-            *outputVoltage /= 10;
-            break;
-        case Unit_t::CentiVolts:
-            *outputVoltage /= 100;
-            break;
-        case Unit_t::MilliVolts:
-            *outputVoltage /= 1000;
-            break;
-        default:
-            break;
-    }
+    *outputVoltage = toVolts(*outputVoltage);
 
-    // since this project is revolving around Hoymiles microinverters, which can
-    // only handle up to 65V of input voltage at best, it is safe to assume that
-    // an even higher voltage is implausible.
-    if (*outputVoltage < 0 || *outputVoltage > 65) {
+    if (!isPlausibleVoltage(*outputVoltage)) {
         MessageOutput.printf("[SolarChargers::Mqtt]: Implausible output_voltage '%.2f' in topic '%s'\r\n",
                 *outputVoltage, topic);
         return;
@@ -186,15 +251,7 @@ void Provider::onMqttMessageOutputCurrent(espMqttClientTypes::MessageProperties
 
     if (!outputCurrent.has_value()) { return; }
 
-    auto const& config = Configuration.get().SolarCharger.Mqtt;
-    using Unit_t = SolarChargerMqttConfig::AmperageUnit;
-    switch (config.CurrentUnit) {
-        case Unit_t::MilliAmps:
-            *outputCurrent /= 1000;
-            break;
-        default:
-            break;
-    }
+    *outputCurrent = toAmps(*outputCurrent);
 
     _stats->setOutputCurrent(*outputCurrent);
 
@@ -210,4 +267,68 @@ void Provider::onMqttMessageOutputCurrent(espMqttClientTypes::MessageProperties
     }
 }
 
+void Provider::onMqttMessageCombined(espMqttClientTypes::MessageProperties const& properties,
+            char const* topic, uint8_t const* payload, size_t len, size_t index, size_t total) const
+{
+    // fragments of large messages are not reassembled
+    if (index != 0 || len != total) { return; }
+
+    auto json = reinterpret_cast<char const*>(payload);
+
+    auto extract = [&](JsonPath const& path, char const* name) -> std::optional<float> {
+        if (path.isEmpty()) { return std::nullopt; }
+
+        auto extracted = path.getFloat(json, len);
+        if (!extracted.second.isEmpty()) {
+            MessageOutput.printf("[SolarChargers::Mqtt]: %s in topic '%s': %s\r\n",
+                    name, topic, extracted.second.c_str());
+            return std::nullopt;
+        }
+
+        return extracted.first;
+    };
+
+    auto outputPower = extract(_powerPath, "output_power");
+    if (outputPower) {
+        *outputPower = toWatts(*outputPower);
+        if (*outputPower < 0) {
+            MessageOutput.printf("[SolarChargers::Mqtt]: Implausible output_power '%.1f' in topic '%s'\r\n",
+                    *outputPower, topic);
+            outputPower = std::nullopt;
+        }
+    }
+
+    auto outputVoltage = extract(_voltagePath, "output_voltage");
+    if (outputVoltage) {
+        *outputVoltage = toVolts(*outputVoltage);
+        if (!isPlausibleVoltage(*outputVoltage)) {
+            MessageOutput.printf("[SolarChargers::Mqtt]: Implausible output_voltage '%.2f' in topic '%s'\r\n",
+                    *outputVoltage, topic);
+            outputVoltage = std::nullopt;
+        }
+    }
+
+    auto outputCurrent = extract(_currentPath, "output_current");
+    if (outputCurrent) {
+        *outputCurrent = toAmps(*outputCurrent);
+        if (*outputCurrent < 0) {
+            MessageOutput.printf("[SolarChargers::Mqtt]: Implausible output_current '%.2f' in topic '%s'\r\n",
+                    *outputCurrent, topic);
+            outputCurrent = std::nullopt;
+        }
+    }
+
+    if (!outputPower && !outputVoltage && !outputCurrent) { return; }
+
+    _stats->setOutputValues(outputPower, outputVoltage, outputCurrent);
+
+    // solar passthrough follows the new reading right away
+    PowerLimiter.notifySolarChargerUpdate();
+
+    if (_verboseLogging) {
+        MessageOutput.printf("[SolarChargers::Mqtt]: Updated output from '%s' to %.1f W, %.2f V, %.2f A\r\n",
+                topic, outputPower.value_or(NAN), outputVoltage.value_or(NAN), outputCurrent.value_or(NAN));
+    }
+}
+
 } // namespace SolarChargers::Mqtt
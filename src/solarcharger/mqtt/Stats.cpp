@@ -40,6 +40,36 @@ void Stats::setOutputCurrent(const float current) {
     }
 }
 
+void Stats::setOutputValues(std::optional<float> powerWatts,
+        std::optional<float> voltage, std::optional<float> current)
+{
+    uint32_t now = millis();
+
+    if (voltage) {
+        _outputVoltage = *voltage;
+        _lastUpdateOutputVoltage = now;
+    }
+
+    if (current) {
+        _outputCurrent = *current;
+        _lastUpdateOutputCurrent = now;
+    }
+
+    // voltage and current of the same message, rather than the most recent
+    // value of the respective other topic.
+    if (Configuration.get().SolarCharger.Mqtt.CalculateOutputPower) {
+        powerWatts = std::nullopt;
+        if (voltage && current) { powerWatts = *voltage * *current; }
+    }
+
+    if (powerWatts) {
+        _outputPowerWatts = *powerWatts;
+        _lastUpdateOutputPowerWatts = now;
+    }
+
+    _lastUpdate = now;
+}
+
 std::optional<float> Stats::getValueIfNotOutdated(const uint32_t lastUpdate, const float value) const {
     // never updated or older than 60 seconds
     if (lastUpdate == 0
@@ -31,6 +31,10 @@ void Provider::deinit()
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
+    for (auto const& upController : _controllers) {
+        stopReader(*upController);
+    }
+
     _controllers.clear();
     for (auto const& o: _serialPortOwners) {
         SerialPortManager.freePort(o.c_str());
@@ -51,30 +55,106 @@ bool Provider::initController(int8_t rx, int8_t tx, bool logging,
 
     String owner("Victron MPPT ");
     owner += String(instance);
-    auto oHwSerialPort = SerialPortManager.allocatePort(owner.c_str());
+    auto oHwSerialPort = SerialPortManager.allocatePort(owner.c_str(), _rxBufferSize);
     if (!oHwSerialPort) { return false; }
 
     _serialPortOwners.push_back(owner);
 
-    auto upController = std::make_unique<VeDirectMpptController>();
-    upController->init(rx, tx, &MessageOutput, logging, *oHwSerialPort);
+    auto upController = std::make_unique<Controller>();
+    upController->upMppt = std::make_unique<VeDirectMpptController>();
+    upController->upMppt->init(rx, tx, &MessageOutput, logging,
+            SerialPortManager.createSerial(*oHwSerialPort));
+
+    String taskName("VE.Direct ");
+    taskName += String(instance);
+
+    uint32_t constexpr stackSize = 3072;
+    if (pdPASS != xTaskCreate(Provider::readerLoopHelper, taskName.c_str(),
+                stackSize, upController.get(), 2/*prio*/, &upController->TaskHandle)) {
+        MessageOutput.printf("[VictronMppt Instance %d] failed to start reader task\r\n", instance);
+        return false;
+    }
+
+    auto* pController = upController.get();
+    upController->upMppt->onReceive([pController]() {
+        if (pController->TaskHandle == nullptr) { return; }
+        xTaskNotifyGive(pController->TaskHandle);
+    });
+
+    std::lock_guard<std::mutex> lock(_mutex);
     _controllers.push_back(std::move(upController));
     return true;
 }
 
+void Provider::stopReader(Controller& controller)
+{
+    controller.upMppt->onReceive(nullptr);
+
+    if (controller.TaskHandle == nullptr) { return; }
+
+    controller.StopTask = true;
+    xTaskNotifyGive(controller.TaskHandle);
+    while (!controller.TaskDone) { delay(10); }
+    controller.TaskHandle = nullptr;
+}
+
+void Provider::readerLoopHelper(void* context)
+{
+    auto& controller = *static_cast<Controller*>(context);
+    readerLoop(controller);
+    controller.TaskDone = true;
+    vTaskDelete(nullptr);
+}
+
+void Provider::readerLoop(Controller& controller)
+{
+    auto& mppt = *controller.upMppt;
+    uint32_t publishedUpdate = 0;
+    bool publishedValid = false;
+
+    while (!controller.StopTask) {
+        // the timeout makes sure we send hex commands and detect stalled
+        // frames even if no data arrives.
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+
+        mppt.loop();
+
+        // a new snapshot is published with every valid text frame, which
+        // also includes all hex data received since the previous frame.
+        bool valid = mppt.isDataValid();
+        uint32_t lastUpdate = mppt.getLastUpdate();
+        if (lastUpdate == publishedUpdate && valid == publishedValid) { continue; }
+
+        auto spSnapshot = std::make_shared<Snapshot const>(Snapshot{
+                mppt.getData(), valid, lastUpdate });
+        std::atomic_store(&controller.spSnapshot, spSnapshot);
+
+        publishedUpdate = lastUpdate;
+        publishedValid = valid;
+    }
+}
+
 void Provider::loop()
 {
     std::lock_guard<std::mutex> lock(_mutex);
 
-    for (auto const& upController : _controllers) {
-        upController->loop();
+    bool updated = false;
 
-        if(upController->isDataValid()) {
-            _stats->update(upController->getData().serialNr_SER, upController->getData(), upController->getLastUpdate());
+    for (auto const& upController : _controllers) {
+        auto spSnapshot = std::atomic_load(&upController->spSnapshot);
+        if (!spSnapshot || spSnapshot == upController->spProcessed) { continue; }
+        upController->spProcessed = spSnapshot;
+        updated = true;
+
+        auto const& data = spSnapshot->Data;
+        if (spSnapshot->Valid) {
+            _stats->update(data.serialNr_SER, data, spSnapshot->LastUpdate);
         } else {
-            _stats->update(upController->getData().serialNr_SER, std::nullopt, upController->getLastUpdate());
+            _stats->update(data.serialNr_SER, std::nullopt, spSnapshot->LastUpdate);
         }
     }
+
+    if (updated) { _stats->updateAggregate(); }
 }
 
 } // namespace SolarChargers::Victron
@@ -3,6 +3,7 @@
 #include <MqttSettings.h>
 #include <MessageOutput.h>
 #include <solarcharger/victron/Stats.h>
+#include <limits>
 
 namespace SolarChargers::Victron {
 
@@ -13,147 +14,189 @@ void Stats::update(const String serial, const std::optional<VeDirectMpptControll
 
     _data[serial] = mpptData;
     _lastUpdate[serial] = lastUpdate;
-}
-
-uint32_t Stats::getAgeMillis() const
-{
-    uint32_t age = 0;
-    auto now = millis();
-
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        if (!_lastUpdate[entry.first]) { continue; }
 
-        age = std::max<uint32_t>(age, now - _lastUpdate[entry.first]);
+    if (!mpptData) {
+        _powerSamples.erase(serial);
+        return;
     }
 
-    return age;
+    PowerSample sample = { lastUpdate, static_cast<float>(mpptData->batteryOutputPower_W),
+        static_cast<float>(mpptData->panelPower_PPV_W) };
 
+    auto iter = _powerSamples.find(serial);
+    if (iter == _powerSamples.end()) {
+        _powerSamples[serial] = { sample, sample };
+    } else if (iter->second[1].Millis != lastUpdate) {
+        iter->second = { iter->second[1], sample };
+    }
 }
 
-std::optional<float> Stats::getOutputPowerWatts() const
+Stats::PowerSample Stats::extrapolate(std::array<PowerSample, 2> const& samples, uint32_t at)
 {
-    float sum = 0;
-    auto data = false;
-
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        data = true;
-        sum += entry.second->batteryOutputPower_W;
+    auto const& previous = samples[0];
+    auto const& latest = samples[1];
+
+    uint32_t interval = latest.Millis - previous.Millis;
+    uint32_t lag = at - latest.Millis;
+    if (interval == 0 || interval > _maxExtrapolationGapMillis || lag > interval) {
+        // no trend known, or not reliable that far ahead
+        return { at, latest.OutputPowerWatts, latest.PanelPowerWatts };
     }
 
-    if (!data) { return std::nullopt; }
+    float factor = static_cast<float>(lag) / interval;
+    auto project = [factor](float from, float to) {
+        return std::max(0.0f, to + (to - from) * factor);
+    };
 
-    return sum;
+    return { at, project(previous.OutputPowerWatts, latest.OutputPowerWatts),
+        project(previous.PanelPowerWatts, latest.PanelPowerWatts) };
 }
 
-std::optional<float> Stats::getOutputVoltage() const
+void Stats::updateAggregate() const
 {
-    float min = -1;
+    auto constexpr halfOfAllMillis = std::numeric_limits<uint32_t>::max() / 2;
+    Aggregate aggregate;
+
+    float outputPower = 0;
+    float minVoltage = -1;
+    float panelPower = 0;
+    std::optional<uint16_t> networkPanelPower;
+    float yieldTotal = 0;
+    float yieldDay = 0;
+    bool data = false;
+
+    // the common point in time the power of all charge controllers refers to
+    std::optional<uint32_t> newestUpdate;
+    for (auto const& entry : _powerSamples) {
+        uint32_t sampleMillis = entry.second[1].Millis;
+        if (!newestUpdate || sampleMillis - *newestUpdate < halfOfAllMillis) { newestUpdate = sampleMillis; }
+    }
+    bool skewed = false;
 
     for (auto const& entry : _data) {
         if (!entry.second) { continue; }
+        auto const& mpptData = *entry.second;
 
-        float volts = entry.second->batteryVoltage_V_mV / 1000.0;
-        if (min == -1) { min = volts; }
-        min = std::min(min, volts);
-    }
-
-    if (min == -1) { return std::nullopt; }
+        auto lastUpdate = _lastUpdate[entry.first];
+        if (lastUpdate && (!aggregate.OldestUpdate || lastUpdate - *aggregate.OldestUpdate > halfOfAllMillis)) {
+            aggregate.OldestUpdate = lastUpdate;
+        }
 
-    return min;
-}
+        data = true;
 
-std::optional<uint16_t> Stats::getPanelPowerWatts() const
-{
-    uint16_t sum = 0;
-    auto data = false;
+        auto samples = _powerSamples.find(entry.first);
+        if (samples != _powerSamples.end() && newestUpdate) {
+            if (*newestUpdate - samples->second[1].Millis > _maxSkewMillis) { skewed = true; }
+            auto aligned = extrapolate(samples->second, *newestUpdate);
+            outputPower += aligned.OutputPowerWatts;
+            panelPower += aligned.PanelPowerWatts;
+        }
 
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        data = true;
+        float volts = mpptData.batteryVoltage_V_mV / 1000.0;
+        if (minVoltage == -1) { minVoltage = volts; }
+        minVoltage = std::min(minVoltage, volts);
 
         // if any charge controller is part of a VE.Smart network, and if the
         // charge controller is connected in a way that allows to send
         // requests, we should have the "network total DC input power" available.
-        auto networkPower = entry.second->NetworkTotalDcInputPowerMilliWatts;
-        if (networkPower.first > 0) {
-            return static_cast<int32_t>(networkPower.second / 1000.0);
+        auto networkPower = mpptData.NetworkTotalDcInputPowerMilliWatts;
+        if (!networkPanelPower && networkPower.first > 0) {
+            networkPanelPower = static_cast<int32_t>(networkPower.second / 1000.0);
         }
 
-        sum += entry.second->panelPower_PPV_W;
-    }
+        yieldTotal += mpptData.yieldTotal_H19_Wh / 1000.0;
+        yieldDay += mpptData.yieldToday_H20_Wh;
+
+        if (!aggregate.State) {
+            // see victron protocol documentation for CS values
+            switch (mpptData.currentState_CS) {
+                case 0: aggregate.State = Stats::StateOfOperation::Off; break;
+                case 3: aggregate.State = Stats::StateOfOperation::Bulk; break;
+                case 246:
+                case 4: aggregate.State = Stats::StateOfOperation::Absorption; break;
+                case 5: aggregate.State = Stats::StateOfOperation::Float; break;
+                default: aggregate.State = Stats::StateOfOperation::Various; break;
+            }
+        }
 
-    if (!data) { return std::nullopt; }
+        // only use valid and not outdated values
+        auto floatVoltage = mpptData.BatteryFloatMilliVolt;
+        if (!aggregate.FloatVoltage && floatVoltage.first > 0) {
+            aggregate.FloatVoltage = floatVoltage.second / 1000.0;
+        }
 
-    return sum;
-}
+        auto absorptionVoltage = mpptData.BatteryAbsorptionMilliVolt;
+        if (!aggregate.AbsorptionVoltage && absorptionVoltage.first > 0) {
+            aggregate.AbsorptionVoltage = absorptionVoltage.second / 1000.0;
+        }
+    }
 
-std::optional<float> Stats::getYieldTotal() const
-{
-    float sum = 0;
+    aggregate.YieldTotal = yieldTotal;
+    aggregate.YieldDay = yieldDay;
 
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
+    // the sum of a stale and a fresh value is not reported, as the DPL
+    // would overshoot if the lagging charge controller's power dropped.
+    if (data && !skewed) {
+        aggregate.OutputPowerWatts = outputPower;
+        aggregate.PanelPowerWatts = networkPanelPower.value_or(static_cast<uint16_t>(panelPower + 0.5f));
+    }
 
-        sum += entry.second->yieldTotal_H19_Wh / 1000.0;
+    if (skewed && !_skewReported) {
+        MessageOutput.printf("[SolarChargers::Victron] a charge controller lags behind by more "
+                "than %" PRIu32 " ms, withholding the total power\r\n", _maxSkewMillis);
     }
+    _skewReported = skewed;
+
+    if (minVoltage != -1) { aggregate.OutputVoltage = minVoltage; }
 
-    return sum;
+    std::atomic_store(&_spAggregate, std::make_shared<Aggregate const>(aggregate));
 }
 
-std::optional<float> Stats::getYieldDay() const
+uint32_t Stats::getAgeMillis() const
 {
-    float sum = 0;
+    auto oOldestUpdate = getAggregate()->OldestUpdate;
+    if (!oOldestUpdate) { return 0; }
+    return millis() - *oOldestUpdate;
+}
 
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
+std::optional<float> Stats::getOutputPowerWatts() const
+{
+    return getAggregate()->OutputPowerWatts;
+}
 
-        sum += entry.second->yieldToday_H20_Wh;
-    }
+std::optional<float> Stats::getOutputVoltage() const
+{
+    return getAggregate()->OutputVoltage;
+}
+
+std::optional<uint16_t> Stats::getPanelPowerWatts() const
+{
+    return getAggregate()->PanelPowerWatts;
+}
 
-    return sum;
+std::optional<float> Stats::getYieldTotal() const
+{
+    return getAggregate()->YieldTotal;
+}
+
+std::optional<float> Stats::getYieldDay() const
+{
+    return getAggregate()->YieldDay;
 }
 
 std::optional<Stats::StateOfOperation> Stats::getStateOfOperation() const
 {
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        // see victron protocol documentation for CS values
-        switch (entry.second->currentState_CS) {
-            case 0: return Stats::StateOfOperation::Off;
-            case 3: return Stats::StateOfOperation::Bulk;
-            case 246:
-            case 4: return Stats::StateOfOperation::Absorption;
-            case 5: return Stats::StateOfOperation::Float;
-            default: return Stats::StateOfOperation::Various;
-        }
-    }
-    return std::nullopt;
+    return getAggregate()->State;
 }
 
 std::optional<float> Stats::getFloatVoltage() const
 {
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        auto voltage = entry.second->BatteryFloatMilliVolt;
-        if (voltage.first > 0) { // only return valid and not outdated value
-            return voltage.second / 1000.0;
-        }
-    }
-    return std::nullopt;
+    return getAggregate()->FloatVoltage;
 }
 
 std::optional<float> Stats::getAbsorptionVoltage() const
 {
-    for (auto const& entry : _data) {
-        if (!entry.second) { continue; }
-        auto voltage = entry.second->BatteryAbsorptionMilliVolt;
-        if (voltage.first > 0) { // only return valid and not outdated value
-            return voltage.second / 1000.0;
-        }
-    }
-    return std::nullopt;
+    return getAggregate()->AbsorptionVoltage;
 }
 
 void Stats::getLiveViewData(JsonVariant& root, const boolean fullUpdate, const uint32_t lastPublish) const
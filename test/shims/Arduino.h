@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// the parts of the Arduino core and of FreeRTOS used by the code under test
+
+#include "Print.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#define ARDUINO_ISR_ATTR
+
+using std::max;
+using std::min;
+
+inline uint32_t millis()
+{
+    static auto const start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+class String {
+public:
+    String(char const* str = "")
+        : _str(str)
+    {
+    }
+
+    String(std::string str)
+        : _str(std::move(str))
+    {
+    }
+
+    String(float value, unsigned int decimalPlaces = 2)
+    {
+        char buffer[33];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+        _str = buffer;
+    }
+
+    char const* c_str() const { return _str.c_str(); }
+    unsigned int length() const { return _str.length(); }
+
+    bool operator==(String const& other) const { return _str == other._str; }
+    bool operator!=(String const& other) const { return _str != other._str; }
+    String& operator+=(String const& other)
+    {
+        _str += other._str;
+        return *this;
+    }
+
+private:
+    std::string _str;
+};
+
+// a mutex of FreeRTOS may be given while it is not taken, which the
+// Hoymiles library does once after creating it
+struct Semaphore {
+    std::mutex Mutex;
+    std::condition_variable Available;
+    bool Taken = false;
+};
+using SemaphoreHandle_t = Semaphore*;
+
+#define portMAX_DELAY UINT32_MAX
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    // never freed, like most semaphores on the target
+    return new Semaphore();
+}
+
+inline int xSemaphoreTake(SemaphoreHandle_t semaphore, uint32_t)
+{
+    std::unique_lock<std::mutex> lock(semaphore->Mutex);
+    semaphore->Available.wait(lock, [semaphore]() { return !semaphore->Taken; });
+    semaphore->Taken = true;
+    return pdTRUE;
+}
+
+inline int xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    {
+        std::lock_guard<std::mutex> lock(semaphore->Mutex);
+        semaphore->Taken = false;
+    }
+    semaphore->Available.notify_one();
+    return pdTRUE;
+}
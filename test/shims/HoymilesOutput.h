@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// the parsers log through the message output of the library singleton.
+// defining the singleton would pull in the radio drivers, so its symbol names
+// storage which is never constructed, as getMessageOutput() does not touch it.
+// include once per test, after the parser sources.
+#include <Hoymiles.h>
+
+#define HOYMILES_SYMBOL_STRING(prefix) #prefix
+#define HOYMILES_SYMBOL(prefix, name) HOYMILES_SYMBOL_STRING(prefix) name
+
+alignas(HoymilesClass) unsigned char sHoymiles[sizeof(HoymilesClass)] __asm__(HOYMILES_SYMBOL(__USER_LABEL_PREFIX__, "Hoymiles"));
+
+Print* HoymilesClass::getMessageOutput()
+{
+    return &Serial;
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// discards all output unless a test prints it deliberately
+class Print {
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t) { return 1; }
+
+    size_t printf(char const* format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        for (int i = 0; i < len && i < static_cast<int>(sizeof(buffer)) - 1; ++i) {
+            write(static_cast<uint8_t>(buffer[i]));
+        }
+        return len;
+    }
+
+    size_t print(char const* str) { return printf("%s", str); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t println(char const* str = "") { return printf("%s\r\n", str); }
+    size_t println(int value) { return printf("%d\r\n", value); }
+};
+
+class Stream : public Print {
+};
+
+class HardwareSerial : public Stream {
+};
+
+inline HardwareSerial Serial;
@@ -0,0 +1,6 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// placement attributes of ESP-IDF, without meaning on the host
+#define DRAM_ATTR
+#define IRAM_ATTR
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <BatteryResistanceEstimator.cpp>
+#include <cstdlib>
+#include <unity.h>
+
+namespace {
+
+// uniformly distributed in [-amplitude, amplitude]
+float noise(float amplitude)
+{
+    return amplitude * (2.0f * rand() / RAND_MAX - 1.0f);
+}
+
+// alternates between charging and discharging currents
+float current(int i)
+{
+    return (i % 2 == 0) ? 10.0f + noise(5) : -15.0f + noise(5);
+}
+
+}; // namespace
+
+void setUp() { srand(42); }
+void tearDown() { }
+
+void test_no_estimate_without_samples()
+{
+    BatteryResistanceEstimator estimator;
+    TEST_ASSERT_FALSE(estimator.getResistance().has_value());
+
+    estimator.addSample(52.0, 10.0);
+    estimator.addSample(52.1, 11.0);
+    TEST_ASSERT_FALSE(estimator.getResistance().has_value());
+}
+
+void test_constant_current_is_ignored()
+{
+    BatteryResistanceEstimator estimator;
+    for (int i = 0; i < 100; i++) {
+        estimator.addSample(52.0 + noise(0.1), 10.0 + noise(0.4));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, estimator.getUpdateCount());
+    TEST_ASSERT_FALSE(estimator.getResistance().has_value());
+}
+
+void test_invalid_samples_are_ignored()
+{
+    BatteryResistanceEstimator estimator;
+    estimator.addSample(NAN, 10.0);
+    estimator.addSample(52.0, INFINITY);
+    estimator.addSample(0.0, 10.0);
+    estimator.addSample(52.0, 10.0);
+    estimator.addSample(52.2, 20.0);
+    TEST_ASSERT_EQUAL_UINT32(1, estimator.getUpdateCount());
+}
+
+void test_estimate_with_noise()
+{
+    constexpr float voc = 52.0;
+    constexpr float resistance = 0.02;
+
+    BatteryResistanceEstimator estimator;
+    for (int i = 0; i < 200; i++) {
+        float amps = current(i);
+        estimator.addSample(voc + resistance * amps + noise(0.02), amps);
+    }
+
+    auto estimate = estimator.getResistance();
+    TEST_ASSERT_TRUE(estimate.has_value());
+    TEST_ASSERT_FLOAT_WITHIN(0.003, resistance, *estimate);
+}
+
+void test_estimate_follows_soc_drift_and_step()
+{
+    constexpr float resistance = 0.015;
+    constexpr float coldResistance = 0.04;
+
+    BatteryResistanceEstimator estimator;
+    float voc = 51.0;
+    for (int i = 0; i < 300; i++) {
+        float amps = current(i);
+        voc += 0.002;
+        estimator.addSample(voc + resistance * amps + noise(0.01), amps);
+    }
+
+    auto estimate = estimator.getResistance();
+    TEST_ASSERT_TRUE(estimate.has_value());
+    TEST_ASSERT_FLOAT_WITHIN(0.003, resistance, *estimate);
+
+    for (int i = 0; i < 500; i++) {
+        float amps = current(i);
+        voc -= 0.002;
+        estimator.addSample(voc + coldResistance * amps + noise(0.01), amps);
+    }
+
+    estimate = estimator.getResistance();
+    TEST_ASSERT_TRUE(estimate.has_value());
+    TEST_ASSERT_FLOAT_WITHIN(0.003, coldResistance, *estimate);
+}
+
+void test_implausible_estimate_is_rejected()
+{
+    BatteryResistanceEstimator estimator;
+    for (int i = 0; i < 50; i++) {
+        float amps = current(i);
+        // voltage rising while discharging
+        estimator.addSample(52.0 - 0.05 * amps, amps);
+    }
+    TEST_ASSERT_FALSE(estimator.getResistance().has_value());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_estimate_without_samples);
+    RUN_TEST(test_constant_current_is_ignored);
+    RUN_TEST(test_invalid_samples_are_ignored);
+    RUN_TEST(test_estimate_with_noise);
+    RUN_TEST(test_estimate_follows_soc_drift_and_step);
+    RUN_TEST(test_implausible_estimate_is_rejected);
+    return UNITY_END();
+}
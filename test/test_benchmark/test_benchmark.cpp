@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <PowerLimiterResponseModel.cpp>
+#include <crc.cpp>
+#include <parser/Parser.cpp>
+#include <parser/StatisticsParser.cpp>
+#include <sml.cpp>
+#include <HoymilesOutput.h>
+#include <unity.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <vector>
+
+// the host counterpart of the benchmark firmware (OPENDTU_BENCHMARK): reports
+// the time and the heap allocations per operation of the parsers and of the
+// per-inverter work of a DPL iteration. the times depend on the host and are
+// only reported, while the hot paths are required not to allocate.
+
+namespace {
+
+std::atomic<uint64_t> sAllocations { 0 };
+
+}; // namespace
+
+void* operator new(std::size_t size)
+{
+    ++sAllocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Result {
+    double NsPerOp;
+    double AllocsPerOp;
+};
+
+// the operation is repeated in a couple of rounds, and the fastest round is
+// reported, as other processes add to the time of a round
+template <typename F>
+Result measure(char const* name, uint32_t iterations, F&& op)
+{
+    constexpr uint8_t rounds = 5;
+    auto best = std::chrono::nanoseconds::max();
+    uint64_t allocationsBefore = sAllocations;
+
+    for (uint8_t round = 0; round < rounds; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i) { op(); }
+        best = std::min(best, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start));
+    }
+
+    Result result;
+    result.NsPerOp = static_cast<double>(best.count()) / iterations;
+    result.AllocsPerOp = static_cast<double>(sAllocations - allocationsBefore) / (rounds * iterations);
+
+    printf("{\"benchmark\":\"%s\",\"iterations\":%u,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f}\n",
+        name, iterations, result.NsPerOp, result.AllocsPerOp);
+    return result;
+}
+
+// as in test_statistics_parser, see there
+constexpr byteAssign_t hm600Assignment[] = {
+    { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
+    { TYPE_DC, CH0, FLD_IDC, UNIT_A, 4, 2, 100, false, 2 },
+    { TYPE_DC, CH0, FLD_PDC, UNIT_W, 6, 2, 10, false, 1 },
+    { TYPE_DC, CH0, FLD_YD, UNIT_WH, 22, 2, 1, false, 0 },
+    { TYPE_DC, CH0, FLD_YT, UNIT_KWH, 14, 4, 1000, false, 3 },
+    { TYPE_DC, CH0, FLD_IRR, UNIT_PCT, CALC_CH_IRR, CH0, CMD_CALC, false, 3 },
+
+    { TYPE_DC, CH1, FLD_UDC, UNIT_V, 8, 2, 10, false, 1 },
+    { TYPE_DC, CH1, FLD_IDC, UNIT_A, 10, 2, 100, false, 2 },
+    { TYPE_DC, CH1, FLD_PDC, UNIT_W, 12, 2, 10, false, 1 },
+    { TYPE_DC, CH1, FLD_YD, UNIT_WH, 24, 2, 1, false, 0 },
+    { TYPE_DC, CH1, FLD_YT, UNIT_KWH, 18, 4, 1000, false, 3 },
+    { TYPE_DC, CH1, FLD_IRR, UNIT_PCT, CALC_CH_IRR, CH1, CMD_CALC, false, 3 },
+
+    { TYPE_AC, CH0, FLD_UAC, UNIT_V, 26, 2, 10, false, 1 },
+    { TYPE_AC, CH0, FLD_IAC, UNIT_A, 34, 2, 100, false, 2 },
+    { TYPE_AC, CH0, FLD_PAC, UNIT_W, 30, 2, 10, false, 1 },
+    { TYPE_AC, CH0, FLD_Q, UNIT_VAR, 32, 2, 10, false, 1 },
+    { TYPE_AC, CH0, FLD_F, UNIT_HZ, 28, 2, 100, false, 2 },
+    { TYPE_AC, CH0, FLD_PF, UNIT_NONE, 36, 2, 1000, false, 3 },
+
+    { TYPE_INV, CH0, FLD_T, UNIT_C, 38, 2, 10, true, 1 },
+    { TYPE_INV, CH0, FLD_EVT_LOG, UNIT_NONE, 40, 2, 1, false, 0 },
+
+    { TYPE_INV, CH0, FLD_YD, UNIT_WH, CALC_TOTAL_YD, 0, CMD_CALC, false, 0 },
+    { TYPE_INV, CH0, FLD_YT, UNIT_KWH, CALC_TOTAL_YT, 0, CMD_CALC, false, 3 },
+    { TYPE_INV, CH0, FLD_PDC, UNIT_W, CALC_TOTAL_PDC, 0, CMD_CALC, false, 1 },
+    { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
+};
+
+constexpr statisticsLayout_t hm600Layout = makeStatisticsLayout(hm600Assignment);
+
+const uint8_t hm600Payload[] = {
+    0x00, 0x01, 0x01, 0x4f, 0x02, 0x00, 0x06, 0xb3, 0x01, 0x55, 0x01, 0xf2, 0x06, 0xa2,
+    0x00, 0x12, 0xd6, 0x87, 0x00, 0x12, 0x48, 0x83, 0x03, 0x4d, 0x03, 0x3e,
+    0x09, 0x0a, 0x13, 0x89, 0x0c, 0xb8, 0x00, 0x00, 0x00, 0x8d, 0x03, 0xe8,
+    0xff, 0xe7, 0x00, 0x0c
+};
+
+// as in test_sml, see there
+const uint8_t smlPowerFrame[] = {
+    0x1b, 0x1b, 0x1b, 0x1b, 0x01, 0x01, 0x01, 0x01,
+    0x77, 0x07, 0x01, 0x00, 0x10, 0x07, 0x00, 0xff, 0x01, 0x01,
+    0x62, 0x1b, 0x52, 0xff, 0x53, 0x01, 0x23, 0x01, 0x00, 0x00,
+    0x1b, 0x1b, 0x1b, 0x1b, 0x1a, 0x01, 0x25, 0xfa
+};
+
+}; // namespace
+
+void setUp() { }
+void tearDown() { }
+
+void test_benchmark_crc()
+{
+    uint8_t buffer[32];
+    for (size_t i = 0; i < sizeof(buffer); ++i) { buffer[i] = rand(); }
+
+    volatile uint16_t sink;
+    auto crc16Result = measure("crc16_32", 100000, [&]() { sink = crc16(buffer, sizeof(buffer)); });
+    auto nrf24Result = measure("crc16nrf24_32", 20000, [&]() { sink = crc16nrf24(buffer, sizeof(buffer) * 8); });
+    (void)sink;
+
+    TEST_ASSERT_EQUAL_FLOAT(0, crc16Result.AllocsPerOp);
+    TEST_ASSERT_EQUAL_FLOAT(0, nrf24Result.AllocsPerOp);
+}
+
+void test_benchmark_sml()
+{
+    SmlParser parser;
+    float value = 0;
+    auto result = measure("sml_power_frame", 20000, [&]() {
+        for (uint8_t byte : smlPowerFrame) {
+            if (parser.state(byte) == SML_LISTEND) {
+                parser.getValue(SML_WATT, value);
+            }
+        }
+    });
+
+    TEST_ASSERT_EQUAL_FLOAT(0, result.AllocsPerOp);
+}
+
+void test_benchmark_statistics_parser()
+{
+    fragment_t fragments[3] = {};
+    uint8_t count = 0;
+    for (uint8_t offset = 0; offset < sizeof(hm600Payload); offset += 16) {
+        fragment_t& f = fragments[count++];
+        f.len = std::min<uint8_t>(16, sizeof(hm600Payload) - offset);
+        memcpy(f.fragment, hm600Payload + offset, f.len);
+    }
+
+    StatisticsParser parser;
+    parser.setLayout(&hm600Layout);
+    parser.setYieldDayCorrection(true);
+
+    auto decodeResult = measure("statistics_decode_hm600", 20000, [&]() {
+        parser.decodeFragments(fragments, count);
+    });
+
+    volatile float sink;
+    auto readResult = measure("statistics_read_hm600", 20000, [&]() {
+        for (auto& type : parser.getChannelTypes()) {
+            for (auto& channel : parser.getChannelsByType(type)) {
+                for (uint8_t field = 0; field < FLD_CNT; ++field) {
+                    sink = parser.getChannelFieldValue(type, channel, static_cast<FieldId_t>(field));
+                }
+            }
+        }
+    });
+    (void)sink;
+
+    TEST_ASSERT_EQUAL_FLOAT(0, decodeResult.AllocsPerOp);
+    TEST_ASSERT_EQUAL_FLOAT(0, readResult.AllocsPerOp);
+}
+
+// the response models of all inverters learn from their new stats and choose
+// the next limit in every DPL iteration
+void test_benchmark_dpl_response_models()
+{
+    for (size_t inverters : { 1, 4, 12 }) {
+        std::vector<PowerLimiterResponseModel> models(inverters);
+        uint32_t now = millis() - 10 * 1000;
+
+        char name[32];
+        snprintf(name, sizeof(name), "dpl_response_models_%zu", inverters);
+
+        volatile uint16_t sink;
+        auto result = measure(name, 20000, [&]() {
+            now += 1000;
+            for (size_t i = 0; i < models.size(); ++i) {
+                uint16_t output = 300 + (now / 1000 + i) % 40;
+                models[i].onStats(400, output, now);
+                sink = models[i].getLimitFor(output + 20);
+                sink = models[i].getCeilingWatts().value_or(0);
+            }
+        });
+        (void)sink;
+
+        TEST_ASSERT_EQUAL_FLOAT(0, result.AllocsPerOp);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_benchmark_crc);
+    RUN_TEST(test_benchmark_sml);
+    RUN_TEST(test_benchmark_statistics_parser);
+    RUN_TEST(test_benchmark_dpl_response_models);
+    return UNITY_END();
+}
@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <atomic>
+#include <parser/PayloadBuffer.h>
+#include <queue/FragmentRingBuffer.h>
+#include <thread>
+#include <unity.h>
+
+void setUp() { }
+void tearDown() { }
+
+void test_ring_buffer_fifo()
+{
+    FragmentRingBuffer<int, 3> ring;
+    int item = 0;
+
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_FALSE(ring.pop(item));
+
+    TEST_ASSERT_TRUE(ring.push(1));
+    TEST_ASSERT_TRUE(ring.push(2));
+    TEST_ASSERT_TRUE(ring.push(3));
+    TEST_ASSERT_TRUE(ring.full());
+    TEST_ASSERT_FALSE(ring.push(4));
+
+    TEST_ASSERT_TRUE(ring.pop(item));
+    TEST_ASSERT_EQUAL(1, item);
+    TEST_ASSERT_FALSE(ring.full());
+    TEST_ASSERT_TRUE(ring.push(4));
+
+    for (int expected = 2; expected <= 4; expected++) {
+        TEST_ASSERT_TRUE(ring.pop(item));
+        TEST_ASSERT_EQUAL(expected, item);
+    }
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_ring_buffer_wraps_around()
+{
+    FragmentRingBuffer<int, 4> ring;
+    int item = 0;
+
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_TRUE(ring.push(i));
+        TEST_ASSERT_TRUE(ring.push(i + 1000));
+        TEST_ASSERT_TRUE(ring.pop(item));
+        TEST_ASSERT_EQUAL(i, item);
+        TEST_ASSERT_TRUE(ring.pop(item));
+        TEST_ASSERT_EQUAL(i + 1000, item);
+    }
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_ring_buffer_two_threads()
+{
+    constexpr int count = 100000;
+    FragmentRingBuffer<int, 8> ring;
+
+    std::thread producer([&ring]() {
+        for (int i = 0; i < count; i++) {
+            while (!ring.push(i)) { std::this_thread::yield(); }
+        }
+    });
+
+    int expected = 0;
+    while (expected < count) {
+        int item;
+        if (!ring.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item != expected) { break; }
+        ++expected;
+    }
+
+    producer.join();
+    TEST_ASSERT_EQUAL(count, expected);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_payload_buffer_publish()
+{
+    PayloadBuffer<16> buffer;
+    const uint8_t first[] = { 1, 2, 3, 4 };
+    const uint8_t second[] = { 5, 6 };
+
+    TEST_ASSERT_EQUAL(0, buffer.getLength());
+    TEST_ASSERT_FALSE(buffer.append(0, first, sizeof(first)));
+
+    buffer.beginWrite();
+    TEST_ASSERT_TRUE(buffer.append(4, second, sizeof(second)));
+    TEST_ASSERT_TRUE(buffer.append(0, first, sizeof(first)));
+
+    // not visible before it was published
+    TEST_ASSERT_EQUAL(0, buffer.getLength());
+    TEST_ASSERT_EQUAL_UINT32(0, buffer.getGeneration());
+
+    buffer.publish();
+    TEST_ASSERT_EQUAL_UINT32(1, buffer.getGeneration());
+
+    auto payload = buffer.read();
+    const uint8_t expected[] = { 1, 2, 3, 4, 5, 6 };
+    TEST_ASSERT_EQUAL(sizeof(expected), payload.Length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, payload.Data.data(), sizeof(expected));
+
+    // publishing again without writing does nothing
+    buffer.publish();
+    TEST_ASSERT_EQUAL_UINT32(1, buffer.getGeneration());
+}
+
+void test_payload_buffer_bounds()
+{
+    PayloadBuffer<8> buffer;
+    const uint8_t data[] = { 1, 2, 3, 4 };
+
+    buffer.beginWrite();
+    TEST_ASSERT_TRUE(buffer.append(4, data, sizeof(data)));
+    TEST_ASSERT_FALSE(buffer.append(5, data, sizeof(data)));
+}
+
+void test_payload_buffer_keep_content()
+{
+    PayloadBuffer<8> buffer;
+    const uint8_t data[] = { 1, 2, 3, 4 };
+    const uint8_t patch = 9;
+
+    buffer.beginWrite();
+    buffer.append(0, data, sizeof(data));
+    buffer.publish();
+
+    buffer.beginWrite(true);
+    buffer.data()[1] = patch;
+    buffer.publish();
+
+    auto payload = buffer.read();
+    const uint8_t expected[] = { 1, 9, 3, 4 };
+    TEST_ASSERT_EQUAL(sizeof(expected), payload.Length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, payload.Data.data(), sizeof(expected));
+
+    // without keeping the content, the back buffer starts out empty
+    buffer.beginWrite();
+    buffer.publish();
+    TEST_ASSERT_EQUAL(0, buffer.getLength());
+    TEST_ASSERT_EQUAL_UINT8(0, buffer.read().Data[1]);
+}
+
+void test_payload_buffer_no_torn_reads()
+{
+    constexpr uint32_t publishes = 200000;
+    constexpr size_t size = 64;
+    PayloadBuffer<size> buffer;
+    std::atomic<bool> done = { false };
+
+    // every payload is filled with a single value, so a torn read shows as
+    // a payload with differing bytes
+    std::thread writer([&]() {
+        uint8_t data[size];
+        for (uint32_t i = 0; i < publishes; i++) {
+            memset(data, i & 0xff, sizeof(data));
+            buffer.beginWrite();
+            buffer.append(0, data, sizeof(data));
+            buffer.publish();
+        }
+        done = true;
+    });
+
+    uint32_t torn = 0;
+    while (!done) {
+        auto payload = buffer.read();
+        for (size_t i = 1; i < payload.Length; i++) {
+            if (payload.Data[i] != payload.Data[0]) {
+                ++torn;
+                break;
+            }
+        }
+    }
+
+    writer.join();
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(publishes, buffer.getGeneration());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_buffer_fifo);
+    RUN_TEST(test_ring_buffer_wraps_around);
+    RUN_TEST(test_ring_buffer_two_threads);
+    RUN_TEST(test_payload_buffer_publish);
+    RUN_TEST(test_payload_buffer_bounds);
+    RUN_TEST(test_payload_buffer_keep_content);
+    RUN_TEST(test_payload_buffer_no_torn_reads);
+    return UNITY_END();
+}
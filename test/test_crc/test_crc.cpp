@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <crc.cpp>
+#include <cstdlib>
+#include <unity.h>
+
+namespace {
+
+// the bitwise implementations replaced by the lookup tables
+uint8_t referenceCrc8(const uint8_t buf[], const uint8_t len)
+{
+    uint8_t crc = CRC8_INIT;
+    for (uint8_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc << 1) ^ ((crc & 0x80) ? CRC8_POLY : 0x00);
+        }
+    }
+    return crc;
+}
+
+uint16_t referenceCrc16(const uint8_t buf[], const uint8_t len, const uint16_t start)
+{
+    uint16_t crc = start;
+    for (uint8_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x0001) ? ((crc >> 1) ^ CRC16_MODBUS_POLYNOM) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t referenceCrc16nrf24(const uint8_t buf[], const uint16_t lenBits, const uint16_t startBit, const uint16_t crcIn)
+{
+    uint16_t crc = crcIn;
+    uint8_t idx, val = buf[(startBit >> 3)];
+
+    for (uint16_t bit = startBit; bit < lenBits; bit++) {
+        idx = bit & 0x07;
+        if (0 == idx) {
+            val = buf[(bit >> 3)];
+        }
+        crc ^= 0x8000 & (val << (8 + idx));
+        crc = (crc & 0x8000) ? ((crc << 1) ^ CRC16_NRF24_POLYNOM) : (crc << 1);
+    }
+    return crc;
+}
+
+const uint8_t checkInput[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+void fillRandom(uint8_t* buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand() & 0xff;
+    }
+}
+
+}; // namespace
+
+void setUp() { srand(42); }
+void tearDown() { }
+
+void test_crc16_check_value()
+{
+    // CRC-16/MODBUS
+    TEST_ASSERT_EQUAL_HEX16(0x4b37, crc16(checkInput, sizeof(checkInput)));
+}
+
+void test_crc8_matches_reference()
+{
+    uint8_t buf[255];
+    for (int round = 0; round < 200; round++) {
+        fillRandom(buf, sizeof(buf));
+        uint8_t len = rand() % sizeof(buf);
+        TEST_ASSERT_EQUAL_HEX8(referenceCrc8(buf, len), crc8(buf, len));
+    }
+}
+
+void test_crc16_matches_reference()
+{
+    uint8_t buf[255];
+    for (int round = 0; round < 200; round++) {
+        fillRandom(buf, sizeof(buf));
+        uint8_t len = rand() % sizeof(buf);
+        uint16_t start = rand() & 0xffff;
+        TEST_ASSERT_EQUAL_HEX16(referenceCrc16(buf, len, start), crc16(buf, len, start));
+        TEST_ASSERT_EQUAL_HEX16(referenceCrc16(buf, len, 0xffff), crc16(buf, len));
+    }
+}
+
+void test_crc16nrf24_matches_reference()
+{
+    // covers unaligned leading and trailing bits
+    uint8_t buf[64];
+    for (int round = 0; round < 500; round++) {
+        fillRandom(buf, sizeof(buf));
+        uint16_t lenBits = rand() % (sizeof(buf) * 8 + 1);
+        uint16_t startBit = lenBits > 0 ? rand() % lenBits : 0;
+        uint16_t crcIn = rand() & 0xffff;
+        TEST_ASSERT_EQUAL_HEX16(referenceCrc16nrf24(buf, lenBits, startBit, crcIn),
+            crc16nrf24(buf, lenBits, startBit, crcIn));
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc16_check_value);
+    RUN_TEST(test_crc8_matches_reference);
+    RUN_TEST(test_crc16_matches_reference);
+    RUN_TEST(test_crc16nrf24_matches_reference);
+    return UNITY_END();
+}
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <PowerLimiterResponseModel.cpp>
+#include <unity.h>
+
+namespace {
+
+// feeds stats one second apart. the stats start 100 seconds in the past, such
+// that they are neither outdated nor from the future.
+class Feed {
+public:
+    explicit Feed(PowerLimiterResponseModel& model)
+        : _model(model)
+        , _now(millis() - 100 * 1000)
+    {
+    }
+
+    void stats(uint16_t limitWatts, uint16_t outputWatts, uint8_t count = 1)
+    {
+        for (uint8_t i = 0; i < count; ++i) {
+            _now += 1000;
+            _model.onStats(limitWatts, outputWatts, _now);
+        }
+    }
+
+    uint32_t now() const { return _now; }
+
+private:
+    PowerLimiterResponseModel& _model;
+    uint32_t _now;
+};
+
+}; // namespace
+
+void setUp() { }
+void tearDown() { }
+
+void test_untrained_model_is_identity()
+{
+    PowerLimiterResponseModel model;
+
+    TEST_ASSERT_EQUAL_FLOAT(1.0, model.getRatio());
+    TEST_ASSERT_EQUAL_UINT16(300, model.getLimitFor(300));
+    TEST_ASSERT_EQUAL_UINT16(300, model.getOutputFor(300));
+    TEST_ASSERT_FALSE(model.getCeilingWatts().has_value());
+    TEST_ASSERT_EQUAL_UINT32(0, model.getSettleMillis());
+}
+
+void test_learns_ratio()
+{
+    PowerLimiterResponseModel model;
+    Feed feed(model);
+
+    // the inverter produces 5 % less than its limit
+    feed.stats(400, 380, 30);
+
+    TEST_ASSERT_FLOAT_WITHIN(0.002, 0.95, model.getRatio());
+    TEST_ASSERT_UINT16_WITHIN(1, 400, model.getLimitFor(380));
+    TEST_ASSERT_UINT16_WITHIN(1, 285, model.getOutputFor(300));
+}
+
+void test_ratio_is_bounded()
+{
+    PowerLimiterResponseModel model;
+    Feed feed(model);
+
+    feed.stats(400, 440, 50);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1.05, model.getRatio());
+}
+
+void test_ignores_low_limits_and_repeated_stats()
+{
+    PowerLimiterResponseModel model;
+    Feed feed(model);
+
+    feed.stats(40, 30, 10);
+    TEST_ASSERT_EQUAL_FLOAT(1.0, model.getRatio());
+
+    // the same stats are reported once per DPL iteration
+    feed.stats(400, 380);
+    float ratio = model.getRatio();
+    model.onStats(400, 380, feed.now());
+    model.onStats(400, 380, feed.now());
+    TEST_ASSERT_EQUAL_FLOAT(ratio, model.getRatio());
+}
+
+void test_ceiling()
+{
+    PowerLimiterResponseModel model;
+    Feed feed(model);
+
+    // the panels only deliver 420 W
+    feed.stats(600, 420);
+    TEST_ASSERT_TRUE(model.getCeilingWatts().has_value());
+    TEST_ASSERT_EQUAL_UINT16(420, *model.getCeilingWatts());
+
+    // not learned as ratio
+    TEST_ASSERT_EQUAL_FLOAT(1.0, model.getRatio());
+
+    // the inverter follows a lower limit and still produces more
+    feed.stats(440, 440);
+    TEST_ASSERT_FALSE(model.getCeilingWatts().has_value());
+}
+
+void test_settle_time()
+{
+    PowerLimiterResponseModel model;
+    Feed feed(model);
+
+    model.onLimitApplied(feed.now());
+    feed.stats(500, 200); // still ramping up
+    feed.stats(500, 350);
+    feed.stats(500, 495);
+    TEST_ASSERT_EQUAL_UINT32(3000, model.getSettleMillis());
+
+    // smoothed with the previous settle times
+    model.onLimitApplied(feed.now());
+    feed.stats(300, 400);
+    TEST_ASSERT_EQUAL_UINT32(3000, model.getSettleMillis());
+    feed.stats(300, 302);
+    TEST_ASSERT_EQUAL_UINT32((3000 * 3 + 2000) / 4, model.getSettleMillis());
+}
+
+void test_settles_on_steady_output()
+{
+    PowerLimiterResponseModel model;
+    Feed feed(model);
+
+    // the output stops changing short of the limit
+    model.onLimitApplied(feed.now());
+    feed.stats(800, 500);
+    feed.stats(800, 600);
+    feed.stats(800, 601);
+    TEST_ASSERT_EQUAL_UINT32(3000, model.getSettleMillis());
+}
+
+void test_ignores_stats_from_before_the_acknowledge()
+{
+    PowerLimiterResponseModel model;
+    Feed feed(model);
+
+    feed.stats(500, 500);
+    model.onLimitApplied(feed.now() + 5000);
+    feed.stats(300, 300);
+    TEST_ASSERT_EQUAL_UINT32(0, model.getSettleMillis());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_untrained_model_is_identity);
+    RUN_TEST(test_learns_ratio);
+    RUN_TEST(test_ratio_is_bounded);
+    RUN_TEST(test_ignores_low_limits_and_repeated_stats);
+    RUN_TEST(test_ceiling);
+    RUN_TEST(test_settle_time);
+    RUN_TEST(test_settles_on_steady_output);
+    RUN_TEST(test_ignores_stats_from_before_the_acknowledge);
+    return UNITY_END();
+}
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <sml.cpp>
+#include <unity.h>
+#include <vector>
+
+namespace {
+
+// an SML file with a single list for OBIS 1-0:16.7.0 (active power),
+// unit W, scaler -1 and the signed value 0x0123
+const std::vector<uint8_t> powerFrame = {
+    0x1b, 0x1b, 0x1b, 0x1b, 0x01, 0x01, 0x01, 0x01,
+    0x77, 0x07, 0x01, 0x00, 0x10, 0x07, 0x00, 0xff, 0x01, 0x01,
+    0x62, 0x1b, 0x52, 0xff, 0x53, 0x01, 0x23, 0x01, 0x00, 0x00,
+    0x1b, 0x1b, 0x1b, 0x1b, 0x1a, 0x01, 0x25, 0xfa
+};
+
+// same list with scaler 0 and the negative value 0xff38
+const std::vector<uint8_t> negativeFrame = {
+    0x1b, 0x1b, 0x1b, 0x1b, 0x01, 0x01, 0x01, 0x01,
+    0x77, 0x07, 0x01, 0x00, 0x10, 0x07, 0x00, 0xff, 0x01, 0x01,
+    0x62, 0x1b, 0x52, 0x00, 0x53, 0xff, 0x38, 0x01, 0x00, 0x00,
+    0x1b, 0x1b, 0x1b, 0x1b, 0x1a, 0x01, 0x93, 0xcf
+};
+
+constexpr uint64_t obisActivePower = 0x0100100700ffULL;
+
+struct Result {
+    bool listEnd = false;
+    uint64_t obis = 0;
+    float value = 0;
+    bool valueValid = false;
+    sml_states_t last = SML_START;
+};
+
+Result parse(SmlParser& parser, std::vector<uint8_t> const& frame)
+{
+    Result result;
+    for (uint8_t byte : frame) {
+        result.last = parser.state(byte);
+        if (result.last == SML_LISTEND && !result.listEnd) {
+            result.listEnd = parser.getObis(result.obis);
+            result.valueValid = parser.getValue(SML_WATT, result.value);
+        }
+    }
+    return result;
+}
+
+}; // namespace
+
+void setUp() { }
+void tearDown() { }
+
+void test_sml_decodes_value()
+{
+    SmlParser parser;
+    auto result = parse(parser, powerFrame);
+
+    TEST_ASSERT_EQUAL(SML_FINAL, result.last);
+    TEST_ASSERT_TRUE(result.listEnd);
+    TEST_ASSERT_TRUE(obisActivePower == result.obis);
+    TEST_ASSERT_TRUE(result.valueValid);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 29.1, result.value);
+}
+
+void test_sml_decodes_negative_value()
+{
+    SmlParser parser;
+    auto result = parse(parser, negativeFrame);
+
+    TEST_ASSERT_EQUAL(SML_FINAL, result.last);
+    TEST_ASSERT_TRUE(result.valueValid);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, -200, result.value);
+}
+
+void test_sml_unit_mismatch()
+{
+    SmlParser parser;
+    bool matched = true;
+    for (uint8_t byte : powerFrame) {
+        if (parser.state(byte) == SML_LISTEND) {
+            float value;
+            matched = parser.getValue(SML_WATT_HOUR, value);
+            break;
+        }
+    }
+    TEST_ASSERT_FALSE(matched);
+}
+
+void test_sml_checksum_error()
+{
+    SmlParser parser;
+    auto frame = powerFrame;
+    frame[24] ^= 0x01;
+    TEST_ASSERT_EQUAL(SML_CHECKSUM_ERROR, parse(parser, frame).last);
+}
+
+void test_sml_consecutive_frames()
+{
+    // the parser resynchronizes on the next start sequence
+    SmlParser parser;
+    auto frame = powerFrame;
+    frame[24] ^= 0x01;
+    parse(parser, frame);
+
+    auto result = parse(parser, negativeFrame);
+    TEST_ASSERT_EQUAL(SML_FINAL, result.last);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, -200, result.value);
+}
+
+void test_sml_parsers_are_independent()
+{
+    // bytes of two meters interleaved, each parser keeps its own state
+    SmlParser first;
+    SmlParser second;
+    sml_states_t firstState = SML_START;
+    sml_states_t secondState = SML_START;
+    float firstValue = 0;
+    float secondValue = 0;
+
+    for (size_t i = 0; i < powerFrame.size(); i++) {
+        firstState = first.state(powerFrame[i]);
+        if (firstState == SML_LISTEND) { first.getValue(SML_WATT, firstValue); }
+        secondState = second.state(negativeFrame[i]);
+        if (secondState == SML_LISTEND) { second.getValue(SML_WATT, secondValue); }
+    }
+
+    TEST_ASSERT_EQUAL(SML_FINAL, firstState);
+    TEST_ASSERT_EQUAL(SML_FINAL, secondState);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 29.1, firstValue);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, -200, secondValue);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sml_decodes_value);
+    RUN_TEST(test_sml_decodes_negative_value);
+    RUN_TEST(test_sml_unit_mismatch);
+    RUN_TEST(test_sml_checksum_error);
+    RUN_TEST(test_sml_consecutive_frames);
+    RUN_TEST(test_sml_parsers_are_independent);
+    return UNITY_END();
+}
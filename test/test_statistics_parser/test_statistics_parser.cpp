@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <parser/Parser.cpp>
+#include <parser/StatisticsParser.cpp>
+#include <HoymilesOutput.h>
+#include <unity.h>
+
+namespace {
+
+// the byte assignment of HM_2CH.cpp (HM-600, HM-700, HM-800)
+constexpr byteAssign_t byteAssignment[] = {
+    { TYPE_DC, CH0, FLD_UDC, UNIT_V, 2, 2, 10, false, 1 },
+    { TYPE_DC, CH0, FLD_IDC, UNIT_A, 4, 2, 100, false, 2 },
+    { TYPE_DC, CH0, FLD_PDC, UNIT_W, 6, 2, 10, false, 1 },
+    { TYPE_DC, CH0, FLD_YD, UNIT_WH, 22, 2, 1, false, 0 },
+    { TYPE_DC, CH0, FLD_YT, UNIT_KWH, 14, 4, 1000, false, 3 },
+    { TYPE_DC, CH0, FLD_IRR, UNIT_PCT, CALC_CH_IRR, CH0, CMD_CALC, false, 3 },
+
+    { TYPE_DC, CH1, FLD_UDC, UNIT_V, 8, 2, 10, false, 1 },
+    { TYPE_DC, CH1, FLD_IDC, UNIT_A, 10, 2, 100, false, 2 },
+    { TYPE_DC, CH1, FLD_PDC, UNIT_W, 12, 2, 10, false, 1 },
+    { TYPE_DC, CH1, FLD_YD, UNIT_WH, 24, 2, 1, false, 0 },
+    { TYPE_DC, CH1, FLD_YT, UNIT_KWH, 18, 4, 1000, false, 3 },
+    { TYPE_DC, CH1, FLD_IRR, UNIT_PCT, CALC_CH_IRR, CH1, CMD_CALC, false, 3 },
+
+    { TYPE_AC, CH0, FLD_UAC, UNIT_V, 26, 2, 10, false, 1 },
+    { TYPE_AC, CH0, FLD_IAC, UNIT_A, 34, 2, 100, false, 2 },
+    { TYPE_AC, CH0, FLD_PAC, UNIT_W, 30, 2, 10, false, 1 },
+    { TYPE_AC, CH0, FLD_Q, UNIT_VAR, 32, 2, 10, false, 1 },
+    { TYPE_AC, CH0, FLD_F, UNIT_HZ, 28, 2, 100, false, 2 },
+    { TYPE_AC, CH0, FLD_PF, UNIT_NONE, 36, 2, 1000, false, 3 },
+
+    { TYPE_INV, CH0, FLD_T, UNIT_C, 38, 2, 10, true, 1 },
+    { TYPE_INV, CH0, FLD_EVT_LOG, UNIT_NONE, 40, 2, 1, false, 0 },
+
+    { TYPE_INV, CH0, FLD_YD, UNIT_WH, CALC_TOTAL_YD, 0, CMD_CALC, false, 0 },
+    { TYPE_INV, CH0, FLD_YT, UNIT_KWH, CALC_TOTAL_YT, 0, CMD_CALC, false, 3 },
+    { TYPE_INV, CH0, FLD_PDC, UNIT_W, CALC_TOTAL_PDC, 0, CMD_CALC, false, 1 },
+    { TYPE_INV, CH0, FLD_EFF, UNIT_PCT, CALC_TOTAL_EFF, 0, CMD_CALC, false, 3 }
+};
+
+constexpr statisticsLayout_t layout = makeStatisticsLayout(byteAssignment);
+
+// the payload of an HM-600 statistics response at noon, as the radio
+// delivers it in fragments of 16 bytes. the yield total of the first
+// string spans the first two fragments.
+const uint8_t payload[] = {
+    0x00, 0x01, // data version
+    0x01, 0x4f, 0x02, 0x00, 0x06, 0xb3, // CH0: 33.5 V, 5.12 A, 171.5 W
+    0x01, 0x55, 0x01, 0xf2, 0x06, 0xa2, // CH1: 34.1 V, 4.98 A, 169.8 W
+    0x00, 0x12, 0xd6, 0x87, 0x00, 0x12, 0x48, 0x83, // 1234.567 kWh, 1198.211 kWh
+    0x03, 0x4d, 0x03, 0x3e, // 845 Wh, 830 Wh
+    0x09, 0x0a, 0x13, 0x89, 0x0c, 0xb8, // 231.4 V, 50.01 Hz, 325.6 W
+    0x00, 0x00, 0x00, 0x8d, 0x03, 0xe8, // 0 var, 1.41 A, power factor 1
+    0xff, 0xe7, 0x00, 0x0c // -2.5 °C, 12 events
+};
+
+struct Fragments {
+    fragment_t Fragment[3] = {};
+    uint8_t Count = 0;
+};
+
+Fragments fragment(const uint8_t data[], const uint8_t len)
+{
+    Fragments result;
+    for (uint8_t offset = 0; offset < len; offset += 16) {
+        fragment_t& f = result.Fragment[result.Count++];
+        f.len = std::min<uint8_t>(16, len - offset);
+        f.wasReceived = true;
+        memcpy(f.fragment, data + offset, f.len);
+    }
+    return result;
+}
+
+void decode(StatisticsParser& parser, const uint8_t data[], const uint8_t len)
+{
+    auto fragments = fragment(data, len);
+    parser.decodeFragments(fragments.Fragment, fragments.Count);
+}
+
+// the payload with other values for the yield day and the AC power
+std::array<uint8_t, sizeof(payload)> withYieldDayAndPower(const uint16_t yieldDay0, const uint16_t power)
+{
+    std::array<uint8_t, sizeof(payload)> result;
+    std::copy(std::begin(payload), std::end(payload), result.begin());
+    result[22] = yieldDay0 >> 8;
+    result[23] = yieldDay0 & 0xff;
+    result[30] = power >> 8;
+    result[31] = power & 0xff;
+    return result;
+}
+
+}; // namespace
+
+void setUp() { }
+void tearDown() { }
+
+void test_layout()
+{
+    TEST_ASSERT_EQUAL_UINT8(42, layout.expectedByteCount);
+    TEST_ASSERT_EQUAL_UINT8(sizeof(byteAssignment) / sizeof(byteAssignment[0]), layout.byteAssignmentSize);
+    TEST_ASSERT_EQUAL_size_t(1, layout.channelsByType[TYPE_AC].size());
+    TEST_ASSERT_EQUAL_size_t(2, layout.channelsByType[TYPE_DC].size());
+    TEST_ASSERT_EQUAL_size_t(1, layout.channelsByType[TYPE_INV].size());
+    TEST_ASSERT_EQUAL_UINT8(STATISTIC_MAX_ASSIGNMENTS, layout.assignmentIndex[(TYPE_DC * CH_CNT + CH2) * FLD_CNT + FLD_UDC]);
+}
+
+void test_decodes_static_fields()
+{
+    StatisticsParser parser;
+    parser.setLayout(&layout);
+    decode(parser, payload, sizeof(payload));
+
+    TEST_ASSERT_EQUAL_UINT8(sizeof(payload), parser.getExpectedByteCount());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 33.5, parser.getChannelFieldValue(TYPE_DC, CH0, FLD_UDC));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 5.12, parser.getChannelFieldValue(TYPE_DC, CH0, FLD_IDC));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 169.8, parser.getChannelFieldValue(TYPE_DC, CH1, FLD_PDC));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1234.567, parser.getChannelFieldValue(TYPE_DC, CH0, FLD_YT));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1198.211, parser.getChannelFieldValue(TYPE_DC, CH1, FLD_YT));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 830, parser.getChannelFieldValue(TYPE_DC, CH1, FLD_YD));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 231.4, parser.getChannelFieldValue(TYPE_AC, CH0, FLD_UAC));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 50.01, parser.getChannelFieldValue(TYPE_AC, CH0, FLD_F));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 325.6, parser.getChannelFieldValue(TYPE_AC, CH0, FLD_PAC));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1.0, parser.getChannelFieldValue(TYPE_AC, CH0, FLD_PF));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, -2.5, parser.getChannelFieldValue(TYPE_INV, CH0, FLD_T));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 12, parser.getChannelFieldValue(TYPE_INV, CH0, FLD_EVT_LOG));
+
+    // not provided by this model
+    TEST_ASSERT_FALSE(parser.hasChannelFieldValue(TYPE_DC, CH2, FLD_UDC));
+    TEST_ASSERT_EQUAL_FLOAT(0, parser.getChannelFieldValue(TYPE_DC, CH2, FLD_UDC));
+    TEST_ASSERT_NULL(parser.getSettingByChannelField(TYPE_AC, CH0, FLD_UAC_1N));
+}
+
+void test_decodes_calculated_fields()
+{
+    StatisticsParser parser;
+    parser.setLayout(&layout);
+    parser.setStringMaxPower(0, 400);
+    decode(parser, payload, sizeof(payload));
+
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 341.3, parser.getChannelFieldValue(TYPE_INV, CH0, FLD_PDC));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1675, parser.getChannelFieldValue(TYPE_INV, CH0, FLD_YD));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 2432.778, parser.getChannelFieldValue(TYPE_INV, CH0, FLD_YT));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 325.6 / 341.3 * 100, parser.getChannelFieldValue(TYPE_INV, CH0, FLD_EFF));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 171.5 / 400 * 100, parser.getChannelFieldValue(TYPE_DC, CH0, FLD_IRR));
+
+    // without a configured string power
+    TEST_ASSERT_EQUAL_FLOAT(0, parser.getChannelFieldValue(TYPE_DC, CH1, FLD_IRR));
+}
+
+void test_short_payload_reads_zero()
+{
+    StatisticsParser parser;
+    parser.setLayout(&layout);
+    decode(parser, payload, 32);
+
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 325.6, parser.getChannelFieldValue(TYPE_AC, CH0, FLD_PAC));
+    TEST_ASSERT_EQUAL_FLOAT(0, parser.getChannelFieldValue(TYPE_AC, CH0, FLD_IAC));
+    TEST_ASSERT_EQUAL_FLOAT(0, parser.getChannelFieldValue(TYPE_INV, CH0, FLD_T));
+}
+
+void test_field_strings_and_units()
+{
+    StatisticsParser parser;
+    parser.setLayout(&layout);
+    decode(parser, payload, sizeof(payload));
+
+    TEST_ASSERT_EQUAL_STRING("231.4", parser.getChannelFieldValueString(TYPE_AC, CH0, FLD_UAC).c_str());
+    TEST_ASSERT_EQUAL_STRING("1234.567", parser.getChannelFieldValueString(TYPE_DC, CH0, FLD_YT).c_str());
+    TEST_ASSERT_EQUAL_STRING("kWh", parser.getChannelFieldUnit(TYPE_DC, CH0, FLD_YT));
+    TEST_ASSERT_EQUAL_STRING("Frequency", parser.getChannelFieldName(TYPE_AC, CH0, FLD_F));
+    TEST_ASSERT_EQUAL_UINT8(2, parser.getChannelFieldDigits(TYPE_AC, CH0, FLD_F));
+}
+
+void test_set_value_is_limited_to_field()
+{
+    StatisticsParser parser;
+    parser.setLayout(&layout);
+    decode(parser, payload, sizeof(payload));
+
+    TEST_ASSERT_TRUE(parser.setChannelFieldValue(TYPE_AC, CH0, FLD_PAC, 100.5));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 100.5, parser.getChannelFieldValue(TYPE_AC, CH0, FLD_PAC));
+
+    // 6553.6 W do not fit into two bytes at a divisor of 10
+    TEST_ASSERT_TRUE(parser.setChannelFieldValue(TYPE_AC, CH0, FLD_PAC, 6553.6));
+    TEST_ASSERT_EQUAL_FLOAT(0, parser.getChannelFieldValue(TYPE_AC, CH0, FLD_PAC));
+
+    TEST_ASSERT_TRUE(parser.setChannelFieldValue(TYPE_INV, CH0, FLD_T, -12.3));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, -12.3, parser.getChannelFieldValue(TYPE_INV, CH0, FLD_T));
+
+    // calculated fields can not be set
+    TEST_ASSERT_FALSE(parser.setChannelFieldValue(TYPE_INV, CH0, FLD_PDC, 1));
+}
+
+void test_yield_day_correction()
+{
+    StatisticsParser parser;
+    parser.setLayout(&layout);
+    parser.setYieldDayCorrection(true);
+
+    auto before = withYieldDayAndPower(845, 3256);
+    decode(parser, before.data(), before.size());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 845, parser.getChannelFieldValue(TYPE_DC, CH0, FLD_YD));
+
+    // the inverter restarted during the day and counts from zero again
+    auto after = withYieldDayAndPower(0, 3256);
+    decode(parser, after.data(), after.size());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 845, parser.getChannelFieldValue(TYPE_DC, CH0, FLD_YD));
+
+    auto later = withYieldDayAndPower(20, 3256);
+    decode(parser, later.data(), later.size());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 865, parser.getChannelFieldValue(TYPE_DC, CH0, FLD_YD));
+
+    parser.resetYieldDayCorrection();
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 20, parser.getChannelFieldValue(TYPE_DC, CH0, FLD_YD));
+}
+
+void test_ac_power_spread()
+{
+    StatisticsParser parser;
+    parser.setLayout(&layout);
+    TEST_ASSERT_EQUAL_FLOAT(0, parser.getAcPowerSpread());
+
+    const uint16_t powers[] = { 3000, 3100, 2950, 3050, 3040 };
+    for (auto power : powers) {
+        auto data = withYieldDayAndPower(845, power);
+        decode(parser, data.data(), data.size());
+    }
+
+    // the oldest value dropped out of the history
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 15, parser.getAcPowerSpread());
+}
+
+void test_update_callback()
+{
+    StatisticsParser parser;
+    parser.setLayout(&layout);
+
+    uint32_t updates = 0;
+    parser.setUpdateCallback([&updates]() { ++updates; });
+
+    decode(parser, payload, sizeof(payload));
+    TEST_ASSERT_GREATER_THAN(0, updates);
+
+    uint32_t const first = updates;
+    decode(parser, payload, sizeof(payload));
+    TEST_ASSERT_GREATER_THAN(first, updates);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_layout);
+    RUN_TEST(test_decodes_static_fields);
+    RUN_TEST(test_decodes_calculated_fields);
+    RUN_TEST(test_short_payload_reads_zero);
+    RUN_TEST(test_field_strings_and_units);
+    RUN_TEST(test_set_value_is_limited_to_field);
+    RUN_TEST(test_yield_day_correction);
+    RUN_TEST(test_ac_power_spread);
+    RUN_TEST(test_update_callback);
+    return UNITY_END();
+}
@@ -4,6 +4,7 @@ import App from './App.vue';
 import { tooltip } from './plugins/bootstrap';
 import router from './router';
 import { i18n } from './i18n';
+import { registerServiceWorker } from './utils/serviceWorker';
 
 import 'bootstrap';
 import './scss/styles.scss';
@@ -19,3 +20,5 @@ app.use(router);
 app.use(i18n);
 
 app.mount('#app');
+
+registerServiceWorker();
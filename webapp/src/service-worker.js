@@ -0,0 +1,60 @@
+/* global self, caches, fetch, URL */
+
+// caches the shell of the web application, such that the device only
+// serves the API and the websockets while the firmware does not change. the
+// placeholders are filled in by the build, see serviceWorker() in
+// vite.config.ts. a new firmware brings a different version, hence a new
+// worker, which replaces the cache once it took over.
+const version = '__SHELL_VERSION__';
+const files = __SHELL_FILES__;
+const cacheName = 'shell-' + version;
+
+self.addEventListener('install', (event) => {
+    event.waitUntil(caches.open(cacheName).then((cache) => cache.addAll(files)));
+});
+
+self.addEventListener('activate', (event) => {
+    event.waitUntil(
+        caches
+            .keys()
+            .then((keys) =>
+                Promise.all(
+                    keys.filter((key) => key.startsWith('shell-') && key !== cacheName).map((key) => caches.delete(key))
+                )
+            )
+            .then(() => self.clients.claim())
+    );
+});
+
+// sent by the web application once this worker is installed, which then
+// reloads itself, see registerServiceWorker()
+self.addEventListener('message', (event) => {
+    if (event.data === 'skipWaiting') {
+        self.skipWaiting();
+    }
+});
+
+self.addEventListener('fetch', (event) => {
+    const request = event.request;
+    if (request.method !== 'GET') {
+        return;
+    }
+
+    const url = new URL(request.url);
+    if (url.origin !== self.location.origin || url.pathname.startsWith('/api/')) {
+        return;
+    }
+
+    // the firmware serves index.html for all routes of the web application
+    const path = request.mode === 'navigate' ? '/' : url.pathname;
+    if (!files.includes(path)) {
+        return;
+    }
+
+    event.respondWith(
+        caches
+            .open(cacheName)
+            .then((cache) => cache.match(path))
+            .then((response) => response ?? fetch(request))
+    );
+});
@@ -1,3 +1,9 @@
+export interface BatteryAggregateChildConfig {
+    enabled: boolean;
+    provider: number;
+    capacity: number;
+}
+
 export interface BatteryConfig {
     enabled: boolean;
     verbose_logging: boolean;
@@ -17,4 +23,6 @@ export interface BatteryConfig {
     mqtt_discharge_current_topic: string;
     mqtt_discharge_current_json_path: string;
     mqtt_amperage_unit: number;
+    mqtt_bundled: boolean;
+    aggregate_children: BatteryAggregateChildConfig[];
 }
@@ -0,0 +1,14 @@
+import type { DevInfoStatus } from '@/types/DevInfoStatus';
+import type { LimitStatus } from '@/types/LimitStatus';
+import type { LiveData } from '@/types/LiveDataStatus';
+
+export interface PowerStatus {
+    power_set_status: string;
+}
+
+export interface BootstrapData {
+    livedata: LiveData;
+    limit: Record<string, LimitStatus>;
+    power: Record<string, PowerStatus>;
+    devinfo: Record<string, DevInfoStatus>;
+}
@@ -10,12 +10,14 @@ export interface DtuConfig {
     serial: number;
     pollinterval: number;
     verbose_logging: boolean;
+    night_mode: boolean;
     nrf_enabled: boolean;
     nrf_palevel: number;
     cmt_enabled: boolean;
     cmt_palevel: number;
     cmt_frequency: number;
     cmt_country: number;
+    cmt_frequency_agility: boolean;
     country_def: Array<CountryDef>;
     cmt_chan_width: number;
 }
@@ -1,4 +1,6 @@
 export interface EventlogItem {
+    index: number;
+    sequence: number;
     message_id: number;
     message: string;
     start_time: number;
@@ -7,5 +9,6 @@ export interface EventlogItem {
 
 export interface EventlogItems {
     count: number;
+    sequence: number;
     events: Array<EventlogItem>;
 }
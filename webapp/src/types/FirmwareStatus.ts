@@ -1,3 +1,26 @@
 export interface FirmwareStatus {
     ota_supported: boolean;
+    partitions: {
+        running: string;
+        boot: string;
+        running_state?: string;
+        invalid?: string;
+    };
+    rolled_back: boolean;
+    last_update: {
+        state: string;
+        written: number;
+        duration_ms: number;
+        error?: string;
+    };
+}
+
+export interface FirmwareUpdateProgress {
+    state: string;
+    expected: number;
+    received: number;
+    written: number;
+    elapsed_ms: number;
+    throughput: number;
+    error?: string;
 }
@@ -1,3 +1,5 @@
+import type { EventlogItem } from '@/types/EventlogStatus';
+
 export interface ValueObject {
     v: number; // value
     u: string; // unit
@@ -21,6 +23,16 @@ export interface InverterStatistics {
     Irradiation?: ValueObject;
 }
 
+export interface RadioChannelStatistics {
+    channel: number;
+    fragments: number;
+}
+
+export interface RadioHistogram {
+    bounds: number[];
+    buckets: number[];
+}
+
 export interface RadioStatistics {
     tx_request: number;
     tx_re_request: number;
@@ -28,7 +40,10 @@ export interface RadioStatistics {
     rx_fail_nothing: number;
     rx_fail_partial: number;
     rx_fail_corrupt: number;
+    rx_dropped: number;
     rssi: number;
+    rx_channels: RadioChannelStatistics[];
+    histograms: Record<string, RadioHistogram>;
 }
 
 export interface Inverter {
@@ -42,6 +57,8 @@ export interface Inverter {
     limit_relative: number;
     limit_absolute: number;
     events: number;
+    event_sequence?: number;
+    last_event?: EventlogItem;
     AC: InverterStatistics[];
     DC: InverterStatistics[];
     INV: InverterStatistics[];
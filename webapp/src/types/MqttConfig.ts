@@ -9,6 +9,13 @@ export interface MqttConfig {
     mqtt_topic: string;
     mqtt_publish_interval: number;
     mqtt_clean_session: boolean;
+    mqtt_deadband_power: number;
+    mqtt_deadband_voltage: number;
+    mqtt_deadband_current: number;
+    mqtt_deadband_frequency: number;
+    mqtt_deadband_temperature: number;
+    mqtt_deadband_power_factor: number;
+    mqtt_deadband_percent: number;
     mqtt_retain: boolean;
     mqtt_tls: boolean;
     mqtt_root_ca_cert: string;
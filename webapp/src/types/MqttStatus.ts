@@ -1,3 +1,10 @@
+export interface MqttOutboxStats {
+    queued: number;
+    queued_bytes: number;
+    published: number;
+    dropped: number;
+}
+
 export interface MqttStatus {
     mqtt_enabled: boolean;
     mqtt_verbose_logging: boolean;
@@ -19,4 +26,5 @@ export interface MqttStatus {
     mqtt_hass_retain: boolean;
     mqtt_hass_topic: string;
     mqtt_hass_individualpanels: boolean;
+    mqtt_outbox: Record<'control' | 'discovery' | 'telemetry', MqttOutboxStats>;
 }
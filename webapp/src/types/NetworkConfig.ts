@@ -1,3 +1,12 @@
+import type { HttpRequestConfig } from '@/types/HttpRequestConfig';
+
+export interface MetricsPushConfig {
+    enabled: boolean;
+    interval: number;
+    push_interval: number;
+    http_request: HttpRequestConfig;
+}
+
 export interface NetworkConfig {
     ssid: string;
     password: string;
@@ -9,8 +18,17 @@ export interface NetworkConfig {
     dns1: string;
     dns2: string;
     aptimeout: number;
+    latency_mode: number;
     mdnsenabled: boolean;
     syslogenabled: boolean;
     sysloghostname: string;
     syslogport: number;
+    telemetryenabled: boolean;
+    telemetryhostname: string;
+    telemetryport: number;
+    telemetryinterval: number;
+    metricspush: MetricsPushConfig;
+    modbusenabled: boolean;
+    modbusport: number;
+    modbusallowwrite: boolean;
 }
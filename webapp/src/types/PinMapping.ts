@@ -5,6 +5,12 @@ export interface Nrf24 {
     irq: number;
     en: number;
     cs: number;
+    cs2: number;
+    en2: number;
+    irq2: number;
+    cs3: number;
+    en3: number;
+    irq3: number;
 }
 
 export interface Cmt2300 {
@@ -27,6 +27,7 @@ export interface PowerLimiterInverterConfig {
     is_governed: boolean;
     is_behind_power_meter: boolean;
     power_source: number;
+    phase: number;
     use_overscaling_to_compensate_shading: boolean;
     lower_power_limit: number;
     upper_power_limit: number;
@@ -48,6 +49,7 @@ export interface PowerLimiterConfig {
     voltage_start_threshold: number;
     voltage_stop_threshold: number;
     voltage_load_correction_factor: number;
+    voltage_load_correction_automatic: boolean;
     inverter_restart_hour: number;
     full_solar_passthrough_soc: number;
     full_solar_passthrough_start_voltage: number;
@@ -56,5 +58,14 @@ export interface PowerLimiterConfig {
     inverter_channel_id_for_dc_voltage: number;
     restart_hour: number;
     total_upper_power_limit: number;
+    export_guard_threshold: number;
+    predictive_mode: boolean;
+    optimized_dispatch: boolean;
+    phase_mode: number;
+    cluster: boolean;
+    cluster_key: string;
+    battery_discharge_plan: boolean;
+    battery_capacity: number;
+    battery_discharge_plan_reserve_soc: number;
     inverters: PowerLimiterInverterConfig[];
 }
@@ -11,9 +11,17 @@ export interface PowerMeterMqttConfig {
     values: Array<PowerMeterMqttValue>;
 }
 
+export interface PowerMeterSdmSubMeterConfig {
+    address: number;
+    three_phases: boolean;
+    subtract: boolean;
+    poll_divider: number;
+}
+
 export interface PowerMeterSerialSdmConfig {
     polling_interval: number;
     address: number;
+    sub_meters: Array<PowerMeterSdmSubMeterConfig>;
 }
 
 export interface PowerMeterHttpJsonValue {
@@ -35,6 +43,22 @@ export interface PowerMeterHttpSmlConfig {
     http_request: HttpRequestConfig;
 }
 
+export interface PowerMeterUdpConfig {
+    port: number;
+    format: number;
+}
+
+export interface PowerMeterFilterConfig {
+    mode: number;
+    window: number;
+    step_threshold: number;
+}
+
+export interface PowerMeterAdditionalConfig {
+    operation: number;
+    source: number;
+}
+
 export interface PowerMeterConfig {
     enabled: boolean;
     verbose_logging: boolean;
@@ -44,4 +68,7 @@ export interface PowerMeterConfig {
     serial_sdm: PowerMeterSerialSdmConfig;
     http_json: PowerMeterHttpJsonConfig;
     http_sml: PowerMeterHttpSmlConfig;
+    udp: PowerMeterUdpConfig;
+    filter: PowerMeterFilterConfig;
+    additional: Array<PowerMeterAdditionalConfig>;
 }
@@ -1,5 +1,6 @@
 export interface SolarChargerMqttConfig {
     calculate_output_power: boolean;
+    combined_topic: string;
     power_topic: string;
     power_path: string;
     power_unit: number;
@@ -7,6 +7,55 @@ export interface TaskDetail {
 export interface UartAllocation {
     port: number;
     owner: string;
+    // only present for allocated ports
+    rx_bytes?: number;
+    overruns?: number;
+    framing_errors?: number;
+    parity_errors?: number;
+    breaks?: number;
+}
+
+export interface BootStage {
+    name: string;
+    deferred: boolean;
+    start_us: number;
+    duration_us: number;
+}
+
+export interface BootProfile {
+    stages: BootStage[];
+    setup_us: number;
+    total_us: number;
+}
+
+export interface FsWriteCategory {
+    name: string;
+    ops: number;
+    bytes: number;
+    erases: number;
+    deferred: number;
+}
+
+export interface FsWrites {
+    budget: number;
+    budget_capacity: number;
+    categories: FsWriteCategory[];
+}
+
+export interface TlsClient {
+    name: string;
+    handshakes: number;
+    failures: number;
+    last_ms: number;
+    avg_ms: number;
+    max_ms: number;
+}
+
+export interface TlsInfo {
+    hw_aes: boolean;
+    hw_sha: boolean;
+    hw_mpi: boolean;
+    clients: TlsClient[];
 }
 
 export interface SystemStatus {
@@ -28,6 +77,7 @@ export interface SystemStatus {
     git_is_hash: boolean;
     git_branch: string;
     pioenv: string;
+    omitted_subsystems: string[];
     resetreason_0: string;
     resetreason_1: string;
     cfgsavecount: number;
@@ -54,4 +104,10 @@ export interface SystemStatus {
     cmt_connected: boolean;
     // UARTs
     uarts: UartAllocation[];
+    // FsWrites
+    fs_writes: FsWrites;
+    // TlsInfo
+    tls: TlsInfo;
+    // BootStages
+    boot: BootProfile;
 }
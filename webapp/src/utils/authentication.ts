@@ -15,9 +15,22 @@ export function authHeader(): Headers {
     if (user && user.authdata) {
         headers.append('Authorization', 'Basic ' + user.authdata);
     }
+    if (user && user.token && user.token_expiry > Date.now()) {
+        // much cheaper to validate than the credentials, which are only
+        // checked if the token is not valid (anymore), e.g., after a reboot
+        headers.append('X-Session-Token', user.token);
+    }
     return new Headers(headers);
 }
 
+// for POST requests sending the settings as JSON body rather than as form
+// data, which the firmware does not need to hold in one piece
+export function authJsonHeader(): Headers {
+    const headers = authHeader();
+    headers.append('Content-Type', 'application/json');
+    return headers;
+}
+
 export function authUrl(): string {
     let user = null;
     try {
@@ -58,6 +71,10 @@ export function login(username: string, password: string) {
                 // store user details and basic auth credentials in local storage
                 // to keep user logged in between page refreshes
                 retVal.authdata = btoa(unescape(encodeURIComponent(username + ':' + password)));
+                if (retVal.token) {
+                    // stop using the token shortly before it expires
+                    retVal.token_expiry = Date.now() + (retVal.token_lifetime - 60) * 1000;
+                }
                 localStorage.setItem('user', JSON.stringify(retVal));
             }
 
@@ -0,0 +1,148 @@
+import { authUrl } from './authentication';
+
+export type TopicHandler = (data: unknown) => void;
+export type ConnectionHandler = (connected: boolean) => void;
+
+interface Subscription {
+    topic: string;
+    onData: TopicHandler;
+    onConnection?: ConnectionHandler;
+}
+
+// All live views share a single websocket. A view subscribes to the topics
+// it shows, the socket is opened with the first subscription and closed with
+// the last one. Messages are {"topic":"...","data":...}.
+class LiveSocket {
+    private socket: WebSocket | null = null;
+    private subscriptions: Subscription[] = [];
+    private heartInterval = 0;
+    private reconnectTimeout = 0;
+
+    subscribe(topic: string, onData: TopicHandler, onConnection?: ConnectionHandler): () => void {
+        const subscription: Subscription = { topic, onData, onConnection };
+        const isNewTopic = !this.hasTopic(topic);
+        this.subscriptions.push(subscription);
+
+        if (this.socket === null) {
+            this.connect();
+        } else if (this.socket.readyState === WebSocket.OPEN) {
+            if (isNewTopic) {
+                this.sendJson({ subscribe: [topic] });
+            }
+            onConnection?.(true);
+        }
+
+        return () => this.unsubscribe(subscription);
+    }
+
+    // sends text to the topic, e.g., "resync" of the live data
+    send(topic: string, data: string) {
+        if (this.socket?.readyState === WebSocket.OPEN) {
+            this.sendJson({ topic, data });
+        }
+    }
+
+    // reconnects, e.g., after the credentials changed
+    reconnect() {
+        this.disconnect();
+        if (this.subscriptions.length > 0) {
+            this.connect();
+        }
+    }
+
+    private unsubscribe(subscription: Subscription) {
+        const idx = this.subscriptions.indexOf(subscription);
+        if (idx == -1) {
+            return;
+        }
+        this.subscriptions.splice(idx, 1);
+
+        if (this.subscriptions.length == 0) {
+            this.disconnect();
+        } else if (!this.hasTopic(subscription.topic) && this.socket?.readyState === WebSocket.OPEN) {
+            this.sendJson({ unsubscribe: [subscription.topic] });
+        }
+    }
+
+    private hasTopic(topic: string): boolean {
+        return this.subscriptions.some((s) => s.topic === topic);
+    }
+
+    private connect() {
+        console.log('Starting connection to WebSocket Server');
+
+        const { protocol, host } = location;
+        const authString = authUrl();
+        const webSocketUrl = `${protocol === 'https:' ? 'wss' : 'ws'}://${authString}${host}/ws`;
+
+        const socket = new WebSocket(webSocketUrl);
+        this.socket = socket;
+
+        socket.onopen = () => {
+            console.log('Successfully connected to the websocket server...');
+            const topics = [...new Set(this.subscriptions.map((s) => s.topic))];
+            this.sendJson({ subscribe: topics });
+            this.subscriptions.forEach((s) => s.onConnection?.(true));
+            this.heartCheck();
+        };
+
+        socket.onmessage = (event) => {
+            let message;
+            try {
+                message = JSON.parse(event.data);
+            } catch {
+                return;
+            }
+
+            this.subscriptions.filter((s) => s.topic === message.topic).forEach((s) => s.onData(message.data));
+            this.heartCheck(); // Reset heartbeat detection
+        };
+
+        socket.onclose = () => {
+            console.log('Connection to websocket closed...');
+            if (this.socket !== socket) {
+                return;
+            }
+            this.socket = null;
+            this.subscriptions.forEach((s) => s.onConnection?.(false));
+
+            // Breakpoint reconnection
+            if (this.subscriptions.length > 0) {
+                this.reconnectTimeout = setTimeout(() => this.connect(), 5 * 1000);
+            }
+        };
+    }
+
+    private disconnect() {
+        if (this.heartInterval) {
+            clearInterval(this.heartInterval);
+            this.heartInterval = 0;
+        }
+        if (this.reconnectTimeout) {
+            clearTimeout(this.reconnectTimeout);
+            this.reconnectTimeout = 0;
+        }
+
+        const socket = this.socket;
+        this.socket = null;
+        socket?.close();
+    }
+
+    // Send heartbeat packets regularly * 59s Send a heartbeat
+    private heartCheck() {
+        if (this.heartInterval) {
+            clearInterval(this.heartInterval);
+        }
+        this.heartInterval = setInterval(() => {
+            if (this.socket?.readyState === WebSocket.OPEN) {
+                this.socket.send('ping');
+            }
+        }, 59 * 1000);
+    }
+
+    private sendJson(message: object) {
+        this.socket?.send(JSON.stringify(message));
+    }
+}
+
+export const liveSocket = new LiveSocket();
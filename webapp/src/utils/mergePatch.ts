@@ -0,0 +1,18 @@
+export type JsonObject = { [key: string]: unknown };
+
+function isObject(value: unknown): value is JsonObject {
+    return typeof value === 'object' && value !== null && !Array.isArray(value);
+}
+
+// applies a JSON merge patch (RFC 7386) to target in place
+export function mergePatch(target: JsonObject, patch: JsonObject) {
+    for (const [key, value] of Object.entries(patch)) {
+        if (value === null) {
+            delete target[key];
+        } else if (isObject(value) && isObject(target[key])) {
+            mergePatch(target[key] as JsonObject, value);
+        } else {
+            target[key] = value;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+// registers the worker caching the web application, see service-worker.js.
+// browsers only provide service workers in secure contexts, i.e., if the
+// device is accessed through HTTPS or as localhost. otherwise, the web
+// application is loaded from the device as before.
+export function registerServiceWorker() {
+    if (!import.meta.env.PROD || !('serviceWorker' in navigator)) {
+        return;
+    }
+
+    // the first worker takes over a page loaded from the device, which
+    // does not need to be reloaded
+    const hadController = navigator.serviceWorker.controller !== null;
+    let reloading = false;
+    navigator.serviceWorker.addEventListener('controllerchange', () => {
+        if (!hadController || reloading) {
+            return;
+        }
+        reloading = true;
+        window.location.reload();
+    });
+
+    // a new firmware brings a new worker, which takes over right away,
+    // such that the shell matches the firmware's API
+    const activate = (worker: ServiceWorker | null) => worker?.postMessage('skipWaiting');
+
+    navigator.serviceWorker
+        .register('/sw.js')
+        .then((registration) => {
+            activate(registration.waiting);
+            registration.addEventListener('updatefound', () => {
+                const worker = registration.installing;
+                worker?.addEventListener('statechange', () => {
+                    if (worker.state === 'installed' && navigator.serviceWorker.controller !== null) {
+                        activate(worker);
+                    }
+                });
+            });
+        })
+        .catch((error) => {
+            console.log('Registering the service worker failed:', error);
+        });
+}
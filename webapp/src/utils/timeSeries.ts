@@ -0,0 +1,63 @@
+import { authHeader } from './authentication';
+
+export interface TimeSeriesRange {
+    from: number; // unix time of the first bucket
+    step: number; // bucket width in seconds
+    values: (number | null)[]; // null if the bucket has no samples
+}
+
+// see TimeSeriesClass::getRange() for the encoding
+const RangeVersion = 1;
+const RangeGap = -32768;
+const RangeEscape = -32767;
+
+export function decodeTimeSeriesRange(buffer: ArrayBuffer): TimeSeriesRange {
+    const view = new DataView(buffer);
+    if (view.byteLength < 16 || view.getUint8(0) != RangeVersion) {
+        throw new Error('unsupported time series range');
+    }
+
+    const count = view.getUint16(2, true);
+    const from = view.getUint32(4, true);
+    const step = view.getUint32(8, true);
+    const scale = view.getFloat32(12, true);
+
+    const values: (number | null)[] = [];
+    let previous = 0;
+    let pos = 16;
+    while (values.length < count && pos + 2 <= view.byteLength) {
+        const delta = view.getInt16(pos, true);
+        pos += 2;
+
+        if (delta == RangeGap) {
+            values.push(null);
+            continue;
+        }
+
+        if (delta == RangeEscape) {
+            previous = view.getInt32(pos, true);
+            pos += 4;
+        } else {
+            previous += delta;
+        }
+        values.push(previous / scale);
+    }
+
+    return { from, step, values };
+}
+
+export function fetchTimeSeriesRange(series: string, from: number, to: number, points: number): Promise<TimeSeriesRange> {
+    const params = new URLSearchParams({
+        series,
+        from: from.toString(),
+        to: to.toString(),
+        points: points.toString(),
+    });
+
+    return fetch('/api/timeseries/range?' + params.toString(), { headers: authHeader() }).then((response) => {
+        if (!response.ok) {
+            return Promise.reject({ status: response.status });
+        }
+        return response.arrayBuffer().then(decodeTimeSeriesRange);
+    });
+}
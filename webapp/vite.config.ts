@@ -7,7 +7,111 @@ import viteCompression from 'vite-plugin-compression';
 import cssInjectedByJsPlugin from 'vite-plugin-css-injected-by-js'
 import VueI18nPlugin from '@intlify/unplugin-vue-i18n/vite'
 
+import fs from 'node:fs'
 import path from 'path'
+import { createHash } from 'node:crypto'
+import type { Plugin, Rollup } from 'vite'
+
+// the firmware embeds a fixed set of files. the views loaded on demand by
+// the router, and the modules only they use, hence go into a single chunk
+// js/views.js, while everything the entry imports statically stays in
+// js/app.js.
+const reachableFromEntry = new Map<string, boolean>();
+function isReachableFromEntry(id: string, getModuleInfo: Rollup.GetModuleInfo, visiting = new Set<string>()): boolean {
+    const known = reachableFromEntry.get(id);
+    if (known !== undefined) {
+        return known;
+    }
+    if (visiting.has(id)) {
+        return false;
+    }
+    visiting.add(id);
+
+    const info = getModuleInfo(id);
+    const reachable = info !== null && (info.isEntry
+        || info.importers.some((importer) => isReachableFromEntry(importer, getModuleInfo, visiting)));
+
+    visiting.delete(id);
+    if (reachable || visiting.size === 0) {
+        reachableFromEntry.set(id, reachable);
+    }
+    return reachable;
+}
+
+function embeddedChunksOnly(): Plugin {
+    const embedded = ['js/app.js', 'js/views.js'];
+    return {
+        name: 'embedded-chunks-only',
+        enforce: 'post',
+        generateBundle(_options, bundle) {
+            const chunks = Object.values(bundle).filter((file) => file.type === 'chunk').map((chunk) => chunk.fileName);
+            const unexpected = chunks.filter((name) => !embedded.includes(name));
+            if (unexpected.length > 0) {
+                this.error(`chunks not embedded by the firmware: ${unexpected.join(', ')}`);
+            }
+        },
+    };
+}
+
+// the firmware embeds the bundle as js/app.js, but index.html references it
+// by a content-hashed path, such that the firmware can serve it as immutable.
+function hashedEntryReference(): Plugin {
+    return {
+        name: 'hashed-entry-reference',
+        enforce: 'post',
+        generateBundle(_options, bundle) {
+            const entry = bundle['js/app.js'];
+            const html = bundle['index.html'];
+            if (entry?.type !== 'chunk' || html?.type !== 'asset') {
+                return;
+            }
+
+            const hash = createHash('md5').update(entry.code).digest('hex').substring(0, 8);
+            html.source = html.source.toString().replace('/js/app.js', `/js/app.${hash}.js`);
+        },
+    };
+}
+
+// emits sw.js from src/service-worker.js. the worker caches the files of the
+// shell, which are versioned by their contents, i.e., with the firmware.
+function serviceWorker(): Plugin {
+    const publicFiles = ['zones.json', 'favicon.ico', 'favicon.png', 'site.webmanifest'];
+    return {
+        name: 'service-worker',
+        enforce: 'post',
+        generateBundle(_options, bundle) {
+            const html = bundle['index.html'];
+            if (html?.type !== 'asset') {
+                return;
+            }
+
+            const htmlSource = html.source.toString();
+            const appJs = htmlSource.match(/\/js\/app(\.[0-9a-f]+)?\.js/)?.[0] ?? '/js/app.js';
+
+            const hash = createHash('md5').update(htmlSource);
+            for (const file of Object.values(bundle)) {
+                if (file.type === 'chunk') {
+                    hash.update(file.code);
+                }
+            }
+            const publicDir = path.resolve(path.dirname(fileURLToPath(import.meta.url)), 'public');
+            for (const file of publicFiles) {
+                hash.update(fs.readFileSync(path.join(publicDir, file)));
+            }
+
+            const files = ['/', appJs, '/js/views.js', ...publicFiles.map((file) => '/' + file)];
+            const template = fs.readFileSync(path.resolve(path.dirname(fileURLToPath(import.meta.url)), 'src/service-worker.js'), 'utf-8');
+
+            this.emitFile({
+                type: 'asset',
+                fileName: 'sw.js',
+                source: template
+                    .replace('__SHELL_VERSION__', hash.digest('hex').substring(0, 8))
+                    .replace('__SHELL_FILES__', JSON.stringify(files)),
+            });
+        },
+    };
+}
 
 // example 'vite.user.ts': export const proxy_target = '192.168.16.107'
 let proxy_target;
@@ -24,6 +128,9 @@ export default defineConfig(({ command }) => { return {
     vue(),
     viteCompression({ deleteOriginFile: true, threshold: 0 }),
     cssInjectedByJsPlugin(),
+    hashedEntryReference(),
+    serviceWorker(),
+    embeddedChunksOnly(),
     VueI18nPlugin({
         /* options */
         include: path.resolve(path.dirname(fileURLToPath(import.meta.url)), './src/locales/**.json'),
@@ -45,13 +152,17 @@ export default defineConfig(({ command }) => { return {
     outDir: '../webapp_dist',
     emptyOutDir: true,
     minify: 'terser',
+    // the views are a single chunk, which is not worth preloading
+    modulePreload: false,
     chunkSizeWarningLimit: 1024,
     rollupOptions: {
       output: {
-        // Only create one js file
-        inlineDynamicImports: true,
-        // Get rid of hash on js file
+        manualChunks(id, { getModuleInfo }) {
+            return isReachableFromEntry(id, getModuleInfo) ? undefined : 'views';
+        },
+        // Get rid of hash on js files
         entryFileNames: 'js/app.js',
+        chunkFileNames: 'js/[name].js',
         // Get rid of hash on css file
         assetFileNames: "assets/[name].[ext]",
       },
@@ -90,6 +201,11 @@ export default defineConfig(({ command }) => { return {
         target: 'ws://' + proxy_target,
         ws: true,
         changeOrigin: true
+      },
+      '^/ws$': {
+        target: 'ws://' + proxy_target,
+        ws: true,
+        changeOrigin: true
       }
     }
   }